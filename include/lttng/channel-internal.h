@@ -23,6 +23,8 @@ struct lttng_channel_extended {
 	uint64_t lost_packets;
 	uint64_t monitor_timer_interval;
 	int64_t blocking_timeout;
+	uint32_t compression;
+	uint8_t huge_pages;
 } LTTNG_PACKED;
 
 #endif /* LTTNG_CHANNEL_INTERNAL_H */
@@ -26,6 +26,14 @@
 extern "C" {
 #endif
 
+/*
+ * Compression of the packets of a channel by the consumer daemon.
+ */
+enum lttng_channel_compression {
+	LTTNG_CHANNEL_COMPRESSION_NONE = 0,
+	LTTNG_CHANNEL_COMPRESSION_ZLIB = 1,
+};
+
 /*
  * Tracer channel attributes. For both kernel and user-space.
  *
@@ -68,6 +76,32 @@ struct lttng_channel {
 	char padding[LTTNG_CHANNEL_PADDING1];
 };
 
+/*
+ * Consumption statistics of a stream (buffer of one CPU) of a channel.
+ *
+ * Bucket 0 of the write latency histogram counts the sub-buffers consumed in
+ * less than 1 usec and bucket i (i > 0) those consumed in [2^(i-1), 2^i)
+ * usec. The last bucket also counts the slower sub-buffers.
+ *
+ * The structures should be initialized to zero before use.
+ */
+#define LTTNG_STREAM_STATS_LATENCY_BUCKETS	16
+#define LTTNG_STREAM_STATS_PADDING1		64
+struct lttng_stream_stats {
+	int32_t cpu;
+	uint32_t align_to_64;
+	uint64_t bytes_consumed;
+	uint64_t subbufs_consumed;
+	uint64_t write_latency_hist[LTTNG_STREAM_STATS_LATENCY_BUCKETS];
+	/* Delay between the consumer wakeup and the consumption (nsec). */
+	uint64_t wakeup_delay_total;
+	uint64_t wakeup_delay_max;
+	/* Bytes produced but not yet consumed at the time of the listing. */
+	uint64_t lag_bytes;
+
+	char padding[LTTNG_STREAM_STATS_PADDING1];
+};
+
 /*
  */
 extern struct lttng_channel *lttng_channel_create(struct lttng_domain *domain);
@@ -87,6 +121,18 @@ extern void lttng_channel_destroy(struct lttng_channel *channel);
 extern int lttng_list_channels(struct lttng_handle *handle,
 		struct lttng_channel **channels);
 
+/*
+ * List the consumption statistics of the streams of a channel of a session.
+ * The streams only exist once the session has been started.
+ *
+ * The handle and channel name CAN NOT be NULL.
+ *
+ * Return the size (number of entries) of the "lttng_stream_stats" array.
+ * Caller must free stats. On error, a negative LTTng error code is returned.
+ */
+extern int lttng_list_stream_stats(struct lttng_handle *handle,
+		const char *channel_name, struct lttng_stream_stats **stats);
+
 /*
  * Create or enable a channel.
  *
@@ -144,6 +190,45 @@ extern int lttng_channel_get_blocking_timeout(struct lttng_channel *chan,
 extern int lttng_channel_set_blocking_timeout(struct lttng_channel *chan,
 		int64_t blocking_timeout);
 
+/*
+ * Get the packet compression of a specific LTTng channel.
+ *
+ * Returns 0 on success, or a negative LTTng error code on error.
+ */
+extern int lttng_channel_get_compression(struct lttng_channel *chan,
+		enum lttng_channel_compression *compression);
+
+/*
+ * Set the packet compression of a specific LTTng channel. The packets of a
+ * compressed channel are compressed by the consumer daemon before being
+ * written to the trace files or sent to the relay daemon. Compression
+ * requires the mmap output and is not supported by live sessions.
+ *
+ * Returns 0 on success, or a negative LTTng error code on error.
+ */
+extern int lttng_channel_set_compression(struct lttng_channel *chan,
+		enum lttng_channel_compression compression);
+
+/*
+ * Get whether the ring buffers of a specific LTTng channel are requested to
+ * be backed by huge pages.
+ *
+ * Returns 0 on success, or a negative LTTng error code on error.
+ */
+extern int lttng_channel_get_huge_pages(struct lttng_channel *chan,
+		int *huge_pages);
+
+/*
+ * Request the ring buffers of a specific LTTng channel to be backed by
+ * transparent huge pages. Only supported by user space channels. The
+ * consumer daemon falls back to regular pages when huge pages are not
+ * available.
+ *
+ * Returns 0 on success, or a negative LTTng error code on error.
+ */
+extern int lttng_channel_set_huge_pages(struct lttng_channel *chan,
+		int huge_pages);
+
 #ifdef __cplusplus
 }
 #endif
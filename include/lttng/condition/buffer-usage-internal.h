@@ -36,10 +36,20 @@ struct lttng_condition_buffer_usage {
 	} threshold_ratio;
 	char *session_name;
 	char *channel_name;
+	/*
+	 * The names point into the buffer the condition was created from,
+	 * instead of being owned by the condition.
+	 */
+	bool names_borrowed;
 	struct {
 		bool set;
 		enum lttng_domain_type type;
 	} domain;
+	struct {
+		bool set;
+		double value;
+	} hysteresis_ratio;
+	uint64_t min_notification_interval_us;
 };
 
 struct lttng_condition_buffer_usage_comm {
@@ -56,6 +66,10 @@ struct lttng_condition_buffer_usage_comm {
 	uint32_t channel_name_len;
 	/* enum lttng_domain_type */
 	int8_t domain_type;
+	/* Mapped as the threshold ratio, 0 if unset. */
+	uint32_t hysteresis;
+	/* usec */
+	uint64_t min_notification_interval;
 	/* session and channel names. */
 	char names[];
 } LTTNG_PACKED;
@@ -79,12 +93,12 @@ struct lttng_evaluation *lttng_evaluation_buffer_usage_create(
 LTTNG_HIDDEN
 ssize_t lttng_condition_buffer_usage_low_create_from_buffer(
 		const struct lttng_buffer_view *view,
-		struct lttng_condition **condition);
+		struct lttng_condition **condition, bool borrow);
 
 LTTNG_HIDDEN
 ssize_t lttng_condition_buffer_usage_high_create_from_buffer(
 		const struct lttng_buffer_view *view,
-		struct lttng_condition **condition);
+		struct lttng_condition **condition, bool borrow);
 
 LTTNG_HIDDEN
 ssize_t lttng_evaluation_buffer_usage_low_create_from_buffer(
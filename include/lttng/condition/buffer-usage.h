@@ -73,6 +73,13 @@ lttng_condition_buffer_usage_get_channel_name(
 		const struct lttng_condition *condition,
 		const char **channel_name);
 
+/*
+ * The channel name may be a globbing pattern, for instance "*" to match every
+ * channel of the session. Such a condition is evaluated once for the session:
+ * it is notified when it is met by a first matching channel, and again once
+ * no matching channel meets it anymore. The minimum notification interval
+ * does not apply to it.
+ */
 extern enum lttng_condition_status
 lttng_condition_buffer_usage_set_channel_name(
 		struct lttng_condition *condition,
@@ -88,6 +95,38 @@ lttng_condition_buffer_usage_set_domain_type(
 		struct lttng_condition *condition,
 		enum lttng_domain_type type);
 
+/*
+ * Once met, the condition is not notified again before the usage leaves the
+ * hysteresis band around the threshold, expressed as a ratio of the buffer
+ * capacity in [0.0, 1.0]: below (threshold - band) for a high buffer usage
+ * condition, above (threshold + band) for a low one.
+ */
+extern enum lttng_condition_status
+lttng_condition_buffer_usage_get_hysteresis_ratio(
+		const struct lttng_condition *condition,
+		double *hysteresis_ratio);
+
+extern enum lttng_condition_status
+lttng_condition_buffer_usage_set_hysteresis_ratio(
+		struct lttng_condition *condition,
+		double hysteresis_ratio);
+
+/*
+ * Minimum interval between two notifications of the condition for a
+ * channel, in microseconds. 0, the default, means no minimum. A
+ * notification suppressed by the interval is sent by the first sample
+ * meeting the condition once the interval has elapsed.
+ */
+extern enum lttng_condition_status
+lttng_condition_buffer_usage_get_min_notification_interval(
+		const struct lttng_condition *condition,
+		uint64_t *interval_us);
+
+extern enum lttng_condition_status
+lttng_condition_buffer_usage_set_min_notification_interval(
+		struct lttng_condition *condition,
+		uint64_t interval_us);
+
 
 /* LTTng Condition Evaluation */
 extern enum lttng_evaluation_status
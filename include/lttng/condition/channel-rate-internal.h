@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License, version 2.1 only,
+ * as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef LTTNG_CONDITION_CHANNEL_RATE_INTERNAL_H
+#define LTTNG_CONDITION_CHANNEL_RATE_INTERNAL_H
+
+#include <lttng/condition/channel-rate.h>
+#include <lttng/condition/condition-internal.h>
+#include <lttng/condition/evaluation-internal.h>
+#include <lttng/domain.h>
+#include "common/buffer-view.h"
+
+struct lttng_condition_channel_rate {
+	struct lttng_condition parent;
+	enum lttng_condition_channel_rate_metric metric;
+	struct {
+		bool set;
+		uint64_t value;
+	} threshold;
+	char *session_name;
+	char *channel_name;
+	/*
+	 * The names point into the buffer the condition was created from,
+	 * instead of being owned by the condition.
+	 */
+	bool names_borrowed;
+	struct {
+		bool set;
+		enum lttng_domain_type type;
+	} domain;
+};
+
+struct lttng_condition_channel_rate_comm {
+	/* enum lttng_condition_channel_rate_metric */
+	int8_t metric;
+	/* Units of the metric per second. */
+	uint64_t threshold;
+	/* Both lengths include the trailing \0. */
+	uint32_t session_name_len;
+	uint32_t channel_name_len;
+	/* enum lttng_domain_type */
+	int8_t domain_type;
+	/* session and channel names. */
+	char names[];
+} LTTNG_PACKED;
+
+struct lttng_evaluation_channel_rate {
+	struct lttng_evaluation parent;
+	enum lttng_condition_channel_rate_metric metric;
+	double rate;
+};
+
+struct lttng_evaluation_channel_rate_comm {
+	/* enum lttng_condition_channel_rate_metric */
+	int8_t metric;
+	/* Rate in thousandths of units of the metric per second. */
+	uint64_t rate;
+} LTTNG_PACKED;
+
+LTTNG_HIDDEN
+struct lttng_evaluation *lttng_evaluation_channel_rate_create(
+		enum lttng_condition_type type,
+		enum lttng_condition_channel_rate_metric metric, double rate);
+
+LTTNG_HIDDEN
+ssize_t lttng_condition_channel_rate_low_create_from_buffer(
+		const struct lttng_buffer_view *view,
+		struct lttng_condition **condition, bool borrow);
+
+LTTNG_HIDDEN
+ssize_t lttng_condition_channel_rate_high_create_from_buffer(
+		const struct lttng_buffer_view *view,
+		struct lttng_condition **condition, bool borrow);
+
+LTTNG_HIDDEN
+ssize_t lttng_evaluation_channel_rate_low_create_from_buffer(
+		const struct lttng_buffer_view *view,
+		struct lttng_evaluation **evaluation);
+
+LTTNG_HIDDEN
+ssize_t lttng_evaluation_channel_rate_high_create_from_buffer(
+		const struct lttng_buffer_view *view,
+		struct lttng_evaluation **evaluation);
+
+#endif /* LTTNG_CONDITION_CHANNEL_RATE_INTERNAL_H */
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License, version 2.1 only,
+ * as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef LTTNG_CONDITION_CHANNEL_RATE_H
+#define LTTNG_CONDITION_CHANNEL_RATE_H
+
+#include <lttng/condition/evaluation.h>
+#include <lttng/condition/condition.h>
+#include <stdint.h>
+#include <lttng/domain.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct lttng_condition;
+struct lttng_evaluation;
+
+/*
+ * Per-channel counters whose rate of change can be monitored. The rates are
+ * computed by the session daemon from two consecutive monitoring samples of
+ * the channel, hence the monitor timer of the channel must be enabled.
+ */
+enum lttng_condition_channel_rate_metric {
+	LTTNG_CONDITION_CHANNEL_RATE_METRIC_UNKNOWN = -1,
+	/* Bytes consumed from the ring buffers per second. */
+	LTTNG_CONDITION_CHANNEL_RATE_METRIC_CONSUMED_BYTES = 0,
+	/* Events discarded per second (discard mode). */
+	LTTNG_CONDITION_CHANNEL_RATE_METRIC_DISCARDED_EVENTS = 1,
+	/* Packets lost per second (overwrite mode). */
+	LTTNG_CONDITION_CHANNEL_RATE_METRIC_LOST_PACKETS = 2,
+};
+
+/*
+ * A high channel rate condition evaluates to "true" when the rate of its
+ * metric rises above the threshold, a low one when the rate falls below it.
+ */
+extern struct lttng_condition *
+lttng_condition_channel_rate_low_create(void);
+
+extern struct lttng_condition *
+lttng_condition_channel_rate_high_create(void);
+
+extern enum lttng_condition_status
+lttng_condition_channel_rate_get_metric(
+		const struct lttng_condition *condition,
+		enum lttng_condition_channel_rate_metric *metric);
+
+extern enum lttng_condition_status
+lttng_condition_channel_rate_set_metric(
+		struct lttng_condition *condition,
+		enum lttng_condition_channel_rate_metric metric);
+
+/* threshold expressed in units of the metric per second. */
+extern enum lttng_condition_status
+lttng_condition_channel_rate_get_threshold(
+		const struct lttng_condition *condition,
+		uint64_t *threshold);
+
+/* threshold expressed in units of the metric per second. */
+extern enum lttng_condition_status
+lttng_condition_channel_rate_set_threshold(
+		struct lttng_condition *condition,
+		uint64_t threshold);
+
+extern enum lttng_condition_status
+lttng_condition_channel_rate_get_session_name(
+		const struct lttng_condition *condition,
+		const char **session_name);
+
+extern enum lttng_condition_status
+lttng_condition_channel_rate_set_session_name(
+		struct lttng_condition *condition,
+		const char *session_name);
+
+extern enum lttng_condition_status
+lttng_condition_channel_rate_get_channel_name(
+		const struct lttng_condition *condition,
+		const char **channel_name);
+
+/*
+ * As for the buffer usage conditions, the channel name may be a globbing
+ * pattern evaluated once for the matching channels of the session.
+ */
+extern enum lttng_condition_status
+lttng_condition_channel_rate_set_channel_name(
+		struct lttng_condition *condition,
+		const char *channel_name);
+
+extern enum lttng_condition_status
+lttng_condition_channel_rate_get_domain_type(
+		const struct lttng_condition *condition,
+		enum lttng_domain_type *type);
+
+extern enum lttng_condition_status
+lttng_condition_channel_rate_set_domain_type(
+		struct lttng_condition *condition,
+		enum lttng_domain_type type);
+
+
+/* Channel rate evaluation */
+
+/*
+ * Get the sampled rate, in units of the metric per second, which caused the
+ * associated condition to evaluate to "true".
+ */
+extern enum lttng_evaluation_status
+lttng_evaluation_channel_rate_get_rate(
+		const struct lttng_evaluation *evaluation,
+		double *rate);
+
+extern enum lttng_evaluation_status
+lttng_evaluation_channel_rate_get_metric(
+		const struct lttng_evaluation *evaluation,
+		enum lttng_condition_channel_rate_metric *metric);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LTTNG_CONDITION_CHANNEL_RATE_H */
@@ -33,7 +33,7 @@ typedef bool (*condition_equal_cb)(const struct lttng_condition *a,
 		const struct lttng_condition *b);
 typedef ssize_t (*condition_create_from_buffer_cb)(
 		const struct lttng_buffer_view *view,
-		struct lttng_condition **condition);
+		struct lttng_condition **condition, bool borrow);
 
 struct lttng_condition {
 	enum lttng_condition_type type;
@@ -61,6 +61,17 @@ ssize_t lttng_condition_create_from_buffer(
 		const struct lttng_buffer_view *buffer,
 		struct lttng_condition **condition);
 
+/*
+ * Same as lttng_condition_create_from_buffer(), but the strings of the
+ * condition are borrowed from the buffer instead of being copied. The buffer
+ * must outlive the condition. Changing a string of the condition makes it
+ * copy its strings.
+ */
+LTTNG_HIDDEN
+ssize_t lttng_condition_create_from_buffer_borrowed(
+		const struct lttng_buffer_view *buffer,
+		struct lttng_condition **condition);
+
 LTTNG_HIDDEN
 ssize_t lttng_condition_serialize(const struct lttng_condition *condition,
 		char *buf);
@@ -30,6 +30,8 @@ enum lttng_condition_type {
 	LTTNG_CONDITION_TYPE_UNKNOWN = -1,
 	LTTNG_CONDITION_TYPE_BUFFER_USAGE_LOW = 102,
 	LTTNG_CONDITION_TYPE_BUFFER_USAGE_HIGH = 101,
+	LTTNG_CONDITION_TYPE_CHANNEL_RATE_HIGH = 103,
+	LTTNG_CONDITION_TYPE_CHANNEL_RATE_LOW = 104,
 };
 
 enum lttng_condition_status {
@@ -342,6 +342,26 @@ extern int lttng_event_get_exclusion_name(struct lttng_event *event,
 extern int lttng_list_tracepoints(struct lttng_handle *handle,
 		struct lttng_event **events);
 
+/*
+ * List a page of the available tracepoints of the UST domain.
+ *
+ * A page holds the tracepoints of the applications following the one of pid
+ * "*pid_cursor", 0 for the first page, in increasing order of pid. The
+ * applications are added to the page until it holds at least "page_len"
+ * tracepoints; the tracepoints of an application are never split across
+ * pages. "*pid_cursor" is then set to the pid of the last application of the
+ * page.
+ *
+ * The handle CAN NOT be NULL and page_len CAN NOT be 0.
+ *
+ * Return the size (number of entries) of the "lttng_event" array, 0 once
+ * every application is listed. Caller must free events. On error a negative
+ * LTTng error code is returned.
+ */
+extern int lttng_list_tracepoints_page(struct lttng_handle *handle,
+		pid_t *pid_cursor, unsigned int page_len,
+		struct lttng_event **events);
+
 /*
  * List the available tracepoints fields of a specific lttng domain.
  *
@@ -354,6 +374,22 @@ extern int lttng_list_tracepoints(struct lttng_handle *handle,
 extern int lttng_list_tracepoint_fields(struct lttng_handle *handle,
 		struct lttng_event_field **fields);
 
+/*
+ * List a page of the available tracepoint fields of the UST domain.
+ *
+ * The pages are formed as for lttng_list_tracepoints_page(); the fields of an
+ * application are never split across pages.
+ *
+ * The handle CAN NOT be NULL and page_len CAN NOT be 0.
+ *
+ * Return the size (number of entries) of the "lttng_event_field" array, 0
+ * once every application is listed. Caller must free fields. On error a
+ * negative LTTng error code is returned.
+ */
+extern int lttng_list_tracepoint_fields_page(struct lttng_handle *handle,
+		pid_t *pid_cursor, unsigned int page_len,
+		struct lttng_event_field **fields);
+
 /*
  * List the available kernel syscall.
  *
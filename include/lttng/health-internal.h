@@ -22,11 +22,15 @@
 #include <assert.h>
 #include <common/compat/time.h>
 #include <pthread.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <urcu/system.h>
 #include <urcu/tls-compat.h>
 #include <urcu/uatomic.h>
 #include <urcu/list.h>
 #include <lttng/health.h>
 #include <common/macros.h>
+#include <common/time.h>
 
 /*
  * These are the value added to the current state depending of the position in
@@ -37,6 +41,23 @@
 
 #define HEALTH_IS_IN_POLL(x)	((x) & HEALTH_POLL_VALUE)
 
+/*
+ * Bucket of the latency histogram of a loop iteration of "ns": the first one
+ * counts the iterations under 1 us, the nth one those in [2^(n-1), 2^n) us
+ * and the last one the longer ones.
+ */
+static inline unsigned int health_latency_bucket(uint64_t ns)
+{
+	uint64_t us = ns / 1000;
+	unsigned int bucket = 0;
+
+	while (us && bucket < LTTNG_HEALTH_LATENCY_NR_BUCKETS - 1) {
+		us >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
 struct health_app;
 
 enum health_flags {
@@ -59,6 +80,17 @@ struct health_state {
 	int type;			/* Indicates the nature of the thread. */
 	/* Node of the global TLS state list. */
 	struct cds_list_head node;
+
+	/*
+	 * Time of the last poll() entry or exit, time spent out of and in
+	 * poll(), and latency histogram of the loop iterations, from a poll()
+	 * exit to the next entry. Only updated by the owner thread, the
+	 * health check thread reads them as statistics.
+	 */
+	uint64_t last_poll_ns;
+	uint64_t busy_ns;
+	uint64_t idle_ns;
+	uint64_t latency[LTTNG_HEALTH_LATENCY_NR_BUCKETS];
 };
 
 enum health_cmd {
@@ -73,6 +105,22 @@ struct health_comm_reply {
 	uint64_t ret_code;	/* bitmask of threads in bad health */
 } LTTNG_PACKED;
 
+/*
+ * Statistics following the reply to HEALTH_CMD_CHECK, aggregated over the
+ * threads of each type. Older daemons close the socket after the reply.
+ */
+struct health_comm_type_stats {
+	uint64_t busy_ns;
+	uint64_t idle_ns;
+	uint64_t latency[LTTNG_HEALTH_LATENCY_NR_BUCKETS];
+} LTTNG_PACKED;
+
+struct health_comm_stats {
+	uint32_t nr_types;
+	uint32_t nr_buckets;	/* LTTNG_HEALTH_LATENCY_NR_BUCKETS */
+	struct health_comm_type_stats types[];
+} LTTNG_PACKED;
+
 /* Declare TLS health state. */
 extern DECLARE_URCU_TLS(struct health_state, health_state);
 
@@ -83,11 +131,19 @@ extern DECLARE_URCU_TLS(struct health_state, health_state);
  */
 static inline void health_poll_entry(void)
 {
+	struct health_state *state = &URCU_TLS(health_state);
+	uint64_t now = lttng_monotonic_time_ns(), busy;
+
 	/* Code MUST be in code execution state which is an even number. */
-	assert(!(uatomic_read(&URCU_TLS(health_state).current)
-				& HEALTH_POLL_VALUE));
+	assert(!(uatomic_read(&state->current) & HEALTH_POLL_VALUE));
+
+	busy = now - state->last_poll_ns;
+	CMM_STORE_SHARED(state->busy_ns, state->busy_ns + busy);
+	CMM_STORE_SHARED(state->latency[health_latency_bucket(busy)],
+			state->latency[health_latency_bucket(busy)] + 1);
+	CMM_STORE_SHARED(state->last_poll_ns, now);
 
-	uatomic_add(&URCU_TLS(health_state).current, HEALTH_POLL_VALUE);
+	uatomic_add(&state->current, HEALTH_POLL_VALUE);
 }
 
 /*
@@ -97,11 +153,17 @@ static inline void health_poll_entry(void)
  */
 static inline void health_poll_exit(void)
 {
+	struct health_state *state = &URCU_TLS(health_state);
+	uint64_t now = lttng_monotonic_time_ns();
+
 	/* Code MUST be in poll execution state which is an odd number. */
-	assert(uatomic_read(&URCU_TLS(health_state).current)
-				& HEALTH_POLL_VALUE);
+	assert(uatomic_read(&state->current) & HEALTH_POLL_VALUE);
 
-	uatomic_add(&URCU_TLS(health_state).current, HEALTH_POLL_VALUE);
+	CMM_STORE_SHARED(state->idle_ns,
+			state->idle_ns + now - state->last_poll_ns);
+	CMM_STORE_SHARED(state->last_poll_ns, now);
+
+	uatomic_add(&state->current, HEALTH_POLL_VALUE);
 }
 
 /*
@@ -124,7 +186,17 @@ static inline void health_error(void)
 struct health_app *health_app_create(int nr_types);
 void health_app_destroy(struct health_app *ha);
 int health_check_state(struct health_app *ha, int type);
+uint64_t health_check_all(struct health_app *ha);
 void health_register(struct health_app *ha, int type);
 void health_unregister(struct health_app *ha);
 
+/*
+ * Allocate the statistics of every thread type, sent after the reply to
+ * HEALTH_CMD_CHECK.
+ *
+ * Return the size of "*stats", to free, or a negative value on error.
+ */
+ssize_t health_create_stats(struct health_app *ha,
+		struct health_comm_stats **stats);
+
 #endif /* HEALTH_INTERNAL_H */
@@ -19,6 +19,8 @@
  * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -26,6 +28,13 @@ extern "C" {
 struct lttng_health;
 struct lttng_health_thread;
 
+/*
+ * Buckets of the loop iteration latency histograms: the first one counts the
+ * iterations under 1 us, the nth one those in [2^(n-1), 2^n) us and the last
+ * one the longer ones.
+ */
+#define LTTNG_HEALTH_LATENCY_NR_BUCKETS	24
+
 enum lttng_health_consumerd {
 	LTTNG_HEALTH_CONSUMERD_UST_32,
 	LTTNG_HEALTH_CONSUMERD_UST_64,
@@ -128,6 +137,38 @@ int lttng_health_thread_state(const struct lttng_health_thread *thread);
  */
 const char *lttng_health_thread_name(const struct lttng_health_thread *thread);
 
+/**
+ * lttng_health_thread_get_busy_time - Get thread busy and idle times
+ * @thread: thread health
+ * @busy_ns: time spent out of poll() by the threads of this type (output)
+ * @idle_ns: time spent in poll() by the threads of this type (output)
+ *
+ * The times are cumulative since the threads started: the busy ratio over an
+ * interval is the ratio of the differences between two queries.
+ *
+ * Return 0 on success, else negative value, for instance if the component
+ * does not report statistics.
+ */
+int lttng_health_thread_get_busy_time(const struct lttng_health_thread *thread,
+		uint64_t *busy_ns, uint64_t *idle_ns);
+
+/**
+ * lttng_health_thread_get_latency_histogram - Get loop latency histogram
+ * @thread: thread health
+ * @buckets: iteration counts, of LTTNG_HEALTH_LATENCY_NR_BUCKETS (output)
+ *
+ * A loop iteration lasts from a poll() exit to the next poll() entry. The
+ * counts are cumulative since the threads started. The "buckets" array
+ * should not be freed by the caller, and can be used until
+ * lttng_health_destroy() is called.
+ *
+ * Return 0 on success, else negative value, for instance if the component
+ * does not report statistics.
+ */
+int lttng_health_thread_get_latency_histogram(
+		const struct lttng_health_thread *thread,
+		const uint64_t **buckets);
+
 #ifdef __cplusplus
 }
 #endif
@@ -19,6 +19,8 @@
 #ifndef LTTNG_LOAD_H
 #define LTTNG_LOAD_H
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -201,6 +203,24 @@ int lttng_load_session_attr_set_override_session_name(
  */
 int lttng_load_session(struct lttng_load_session_attr *attr);
 
+/*
+ * Load the session(s) of a session configuration document of "size" bytes,
+ * in the format written by lttng_save_session(), with a single session daemon
+ * command.
+ *
+ * The session daemon validates the whole document before creating any
+ * session. A session of the document that fails to be created is destroyed.
+ * If overwrite is true, the existing sessions of the same names are destroyed
+ * and replaced by the loaded ones.
+ *
+ * The command is refused unless the client runs as the same user as the
+ * session daemon.
+ *
+ * Returns 0 on success or a negative LTTNG_ERR value on error.
+ */
+int lttng_load_session_definition(const char *definition, size_t size,
+		int overwrite);
+
 #ifdef __cplusplus
 }
 #endif
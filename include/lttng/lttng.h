@@ -39,6 +39,7 @@
 #include <lttng/action/notify.h>
 #include <lttng/condition/condition.h>
 #include <lttng/condition/buffer-usage.h>
+#include <lttng/condition/channel-rate.h>
 #include <lttng/condition/evaluation.h>
 #include <lttng/notification/channel.h>
 #include <lttng/notification/notification.h>
@@ -54,7 +55,8 @@ enum lttng_calibrate_type {
 
 /* Machine interface output type */
 enum lttng_mi_output_type {
-	LTTNG_MI_XML                          = 1 /* XML output */
+	LTTNG_MI_XML                          = 1, /* XML output */
+	LTTNG_MI_JSON                         = 2, /* JSON output */
 };
 
 #define LTTNG_CALIBRATE_PADDING1           16
@@ -72,6 +74,23 @@ struct lttng_calibrate {
  */
 extern int lttng_session_daemon_alive(void);
 
+/*
+ * Keep a connection to the session daemon open for the following commands of
+ * the calling thread instead of connecting for each of them, until
+ * lttng_persistent_connection_close() is called. A command failing to reach
+ * the session daemon closes the connection: the next command opens a new
+ * persistent connection.
+ *
+ * Return 0 on success else a negative LTTng error code.
+ */
+extern int lttng_persistent_connection_open(void);
+
+/*
+ * Close the persistent connection of the calling thread, if any. The
+ * following commands connect to the session daemon for each command.
+ */
+extern void lttng_persistent_connection_close(void);
+
 /*
  * Set the tracing group for the *current* flow of execution.
  *
@@ -188,6 +207,23 @@ extern int lttng_regenerate_metadata(const char *session_name);
  */
 extern int lttng_regenerate_statedump(const char *session_name);
 
+/*
+ * Rotate a session: switch all its streams to a new trace chunk directory at
+ * a packet boundary, without stopping the tracing. Once this returns, the
+ * previous trace chunk is not written anymore and can be moved away.
+ *
+ * The new trace chunk is written in the absolute path "path" or, if NULL, in
+ * the path of the first trace chunk suffixed with "-N" for the Nth rotation.
+ * Only the user space sessions written locally are supported.
+ *
+ * On success, if chunk_path is not NULL, it is set to the path of the new
+ * trace chunk, which must be freed by the caller.
+ *
+ * Return 0 on success, a negative LTTng error code on error.
+ */
+extern int lttng_rotate_session(const char *session_name, const char *path,
+		char **chunk_path);
+
 #ifdef __cplusplus
 }
 #endif
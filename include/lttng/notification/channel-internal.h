@@ -89,6 +89,11 @@ struct lttng_notification_channel {
 		struct cds_list_head list;
 	} pending_notifications;
 	struct lttng_dynamic_buffer reception_buffer;
+	/*
+	 * Set on a protocol error met after notifications were received, which
+	 * are returned first. The channel can't be used anymore.
+	 */
+	bool error;
 	/* Sessiond notification protocol version. */
 	struct {
 		bool set;
@@ -48,6 +48,23 @@ lttng_notification_channel_get_next_notification(
 		struct lttng_notification_channel *channel,
 		struct lttng_notification **notification);
 
+/*
+ * Get up to "max_count" notifications at once in the "notifications" array.
+ * All the notifications already received from the session daemon are read in
+ * one go: this call only blocks until a first notification is available.
+ *
+ * On success, "count" is set to the number of notifications returned, which
+ * the caller must destroy. LTTNG_NOTIFICATION_CHANNEL_STATUS_NOTIFICATIONS_DROPPED
+ * is returned, along with the notifications received, if notifications were
+ * dropped in between. On error, no notification is returned: an error met
+ * after notifications were received is reported by the next call.
+ */
+extern enum lttng_notification_channel_status
+lttng_notification_channel_get_next_notifications(
+		struct lttng_notification_channel *channel,
+		struct lttng_notification **notifications,
+		unsigned int max_count, unsigned int *count);
+
 extern enum lttng_notification_channel_status
 lttng_notification_channel_subscribe(
 		struct lttng_notification_channel *channel,
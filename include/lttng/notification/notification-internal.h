@@ -43,6 +43,11 @@ struct lttng_notification {
 	 * to use its serialization facilities.
 	 */
 	bool owns_elements;
+	/*
+	 * Copy of the serialized notification from which the condition of a
+	 * notification created from a buffer borrows its strings.
+	 */
+	char *payload;
 };
 
 struct lttng_notification_comm {
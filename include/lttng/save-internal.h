@@ -38,6 +38,8 @@ struct lttng_save_session_attr {
 	uint8_t omit_name;
 	/* Omit the sessions' output(s). */
 	uint8_t omit_output;
+	/* Save in the compact binary format rather than in XML. */
+	uint8_t binary;
 } LTTNG_PACKED;
 
 #endif /* LTTNG_SAVE_INTERNAL_ABI_H */
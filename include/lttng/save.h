@@ -71,6 +71,12 @@ int lttng_save_session_attr_get_omit_name(
  */
 int lttng_save_session_attr_get_omit_output(
 	struct lttng_save_session_attr *attr);
+/*
+ * Return the binary configuration attribute. This attribute indicates
+ * whether or not the sessions are saved in the compact binary format.
+ */
+int lttng_save_session_attr_get_binary(
+	struct lttng_save_session_attr *attr);
 
 /*
  * Save session attribute setter family functions.
@@ -110,6 +116,12 @@ int lttng_save_session_attr_set_omit_name(
  */
 int lttng_save_session_attr_set_omit_output(
 	struct lttng_save_session_attr *attr, int omit_output);
+/*
+ * Set the binary attribute. If set to true, the session configuration files
+ * are written in a compact binary format, loaded faster than the XML one.
+ */
+int lttng_save_session_attr_set_binary(
+	struct lttng_save_session_attr *attr, int binary);
 
 /*
  * Save session configuration(s).
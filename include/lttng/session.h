@@ -42,6 +42,31 @@ struct lttng_session {
 	char padding[LTTNG_SESSION_PADDING1];
 };
 
+/*
+ * Memory used by the session daemon for a session of the UST domain, either
+ * for an application (pid >= 0) or for the registry shared by the
+ * applications of a user with per UID buffers (pid is -1).
+ *
+ * The filter bytes are those of the filters of the events of the
+ * application, which can be shared with other applications.
+ *
+ * The structures should be initialized to zero before use.
+ */
+#define LTTNG_MEMORY_USAGE_PADDING1		64
+struct lttng_memory_usage {
+	int32_t pid;
+	uint32_t uid;
+	/* Channel, event and enumeration descriptions of the registry. */
+	uint64_t registry_bytes;
+	/* Metadata buffer of the registry. */
+	uint64_t metadata_bytes;
+	/* Channels, streams, events and contexts of the application. */
+	uint64_t object_bytes;
+	uint64_t filter_bytes;
+
+	char padding[LTTNG_MEMORY_USAGE_PADDING1];
+};
+
 /*
  * Create a tracing session using a name and an optional URL.
  *
@@ -149,6 +174,32 @@ extern int lttng_track_pid(struct lttng_handle *handle, int pid);
  */
 extern int lttng_untrack_pid(struct lttng_handle *handle, int pid);
 
+/*
+ * Range of PIDs, from start to end included.
+ */
+struct lttng_pid_range {
+	int32_t start;
+	int32_t end;
+};
+
+/*
+ * Add the PIDs of nb_ranges ranges to the session tracker in a single
+ * command. The PIDs of the ranges already tracked are ignored.
+ *
+ * Return 0 on success else a negative LTTng error code.
+ */
+extern int lttng_track_pid_ranges(struct lttng_handle *handle,
+		const struct lttng_pid_range *ranges, unsigned int nb_ranges);
+
+/*
+ * Remove the PIDs of nb_ranges ranges from the session tracker in a single
+ * command. The PIDs of the ranges which are not tracked are ignored.
+ *
+ * Return 0 on success else a negative LTTng error code.
+ */
+extern int lttng_untrack_pid_ranges(struct lttng_handle *handle,
+		const struct lttng_pid_range *ranges, unsigned int nb_ranges);
+
 /*
  * List PIDs in the tracker.
  *
@@ -162,6 +213,17 @@ extern int lttng_untrack_pid(struct lttng_handle *handle, int pid);
 extern int lttng_list_tracker_pids(struct lttng_handle *handle,
 		int *enabled, int32_t **pids, size_t *nr_pids);
 
+/*
+ * List the memory used by the session daemon for the applications of a
+ * session, per application and per UID registry. Only the UST domain is
+ * supported.
+ *
+ * Return the size (number of entries) of the "lttng_memory_usage" array.
+ * Caller must free usage. On error, a negative LTTng error code is returned.
+ */
+extern int lttng_list_memory_usage(struct lttng_handle *handle,
+		struct lttng_memory_usage **usage);
+
 #ifdef __cplusplus
 }
 #endif
@@ -138,6 +138,17 @@ void lttng_snapshot_output_list_destroy(struct lttng_snapshot_output_list *list)
 int lttng_snapshot_record(const char *session_name,
 		struct lttng_snapshot_output *output, int wait);
 
+/*
+ * Same as lttng_snapshot_record() but only write the packets produced since
+ * the last snapshot recorded to the same output. The first incremental
+ * snapshot to an output, or one following packets overwritten by the tracer
+ * in between, writes the whole available content of the streams.
+ *
+ * Return 0 on success or else a negative LTTNG_ERR value.
+ */
+int lttng_snapshot_record_incremental(const char *session_name,
+		struct lttng_snapshot_output *output, int wait);
+
 #ifdef __cplusplus
 }
 #endif
@@ -41,6 +41,15 @@ LTTNG_HIDDEN
 ssize_t lttng_trigger_create_from_buffer(const struct lttng_buffer_view *view,
 		struct lttng_trigger **trigger);
 
+/*
+ * Same as lttng_trigger_create_from_buffer(), but the condition borrows its
+ * strings from the buffer, which must outlive the trigger.
+ */
+LTTNG_HIDDEN
+ssize_t lttng_trigger_create_from_buffer_borrowed(
+		const struct lttng_buffer_view *view,
+		struct lttng_trigger **trigger);
+
 LTTNG_HIDDEN
 ssize_t lttng_trigger_serialize(struct lttng_trigger *trigger, char *buf);
 
@@ -309,21 +309,24 @@ restart:
 		assert(msg.cmd == HEALTH_CMD_CHECK);
 
 		memset(&reply, 0, sizeof(reply));
-		for (i = 0; i < NR_HEALTH_CONSUMERD_TYPES; i++) {
-			/*
-			 * health_check_state return 0 if thread is in
-			 * error.
-			 */
-			if (!health_check_state(health_consumerd, i)) {
-				reply.ret_code |= 1ULL << i;
-			}
-		}
+		/* Bit i is set if the threads of type i are in bad health. */
+		reply.ret_code = health_check_all(health_consumerd);
 
 		DBG("Health check return value %" PRIx64, reply.ret_code);
 
 		ret = send_unix_sock(new_sock, (void *) &reply, sizeof(reply));
 		if (ret < 0) {
 			ERR("Failed to send health data back to client");
+		} else {
+			struct health_comm_stats *stats;
+			ssize_t stats_len;
+
+			stats_len = health_create_stats(health_consumerd, &stats);
+			if (stats_len > 0) {
+				/* Older clients close without reading them. */
+				(void) send_unix_sock(new_sock, stats, stats_len);
+				free(stats);
+			}
 		}
 
 		/* End of transmission */
@@ -27,6 +27,8 @@ enum health_type_consumerd {
 	HEALTH_CONSUMERD_TYPE_DATA		= 2,
 	HEALTH_CONSUMERD_TYPE_SESSIOND		= 3,
 	HEALTH_CONSUMERD_TYPE_METADATA_TIMER	= 4,
+	HEALTH_CONSUMERD_TYPE_WRITEBACK		= 5,
+	HEALTH_CONSUMERD_TYPE_SPOOL		= 6,
 
 	NR_HEALTH_CONSUMERD_TYPES,
 };
@@ -18,6 +18,7 @@
 
 #define _LGPL_SOURCE
 #include <fcntl.h>
+#include <inttypes.h>
 #include <getopt.h>
 #include <grp.h>
 #include <limits.h>
@@ -44,9 +45,16 @@
 #include <common/common.h>
 #include <common/consumer/consumer.h>
 #include <common/consumer/consumer-timer.h>
+#include <common/compat/io-uring.h>
+#include <common/consumer/consumer-writeback.h>
+#include <common/consumer/consumer-spool.h>
+#include <common/consumer/consumer-numa.h>
+#include <common/consumer/consumer-sched.h>
+#include <common/consumer/consumer-priority.h>
 #include <common/compat/poll.h>
 #include <common/compat/getenv.h>
 #include <common/sessiond-comm/sessiond-comm.h>
+#include <common/stripe.h>
 #include <common/utils.h>
 
 #include "lttng-consumerd.h"
@@ -54,9 +62,21 @@
 
 /* threads (channel handling, poll, metadata, sessiond) */
 
-static pthread_t channel_thread, data_thread, metadata_thread,
+static pthread_t channel_thread,
 		sessiond_thread, metadata_timer_thread, health_thread;
 static bool metadata_timer_thread_online;
+static pthread_t writeback_thread;
+static bool writeback_thread_online;
+static pthread_t spool_thread;
+static bool spool_thread_online;
+
+/* One data thread per data shard. */
+static pthread_t *data_threads;
+static unsigned int nr_data_threads_online;
+
+/* One metadata thread per metadata shard. */
+static pthread_t *metadata_threads;
+static unsigned int nr_metadata_threads_online;
 
 /* to count the number of times the user pressed ctrl+c */
 static int sigintcount = 0;
@@ -71,6 +91,27 @@ static const char *progname;
 static char command_sock_path[PATH_MAX]; /* Global command socket path */
 static char error_sock_path[PATH_MAX]; /* Global error path */
 static enum lttng_consumer_type opt_type = LTTNG_CONSUMER_KERNEL;
+static unsigned int opt_data_threads;
+static int opt_io_uring_depth = -1;
+static int64_t opt_batch_bytes = -1;
+static int opt_async_writeback;
+static int opt_preallocate;
+static int opt_direct_io;
+static int opt_numa_affine;
+static unsigned int opt_snapshot_threads;
+static int opt_snapshot_splice;
+static int64_t opt_wakeup_batch_period = -1;
+static int opt_switch_skip_max = -1;
+static unsigned int opt_relayd_data_connections;
+static const char *opt_backpressure;
+static int opt_relayd_compression;
+static int opt_relayd_zerocopy;
+static const char *opt_spool_dir;
+static int64_t opt_spool_size = -1;
+static int opt_metadata_cache_trim;
+static int opt_sparse_padding;
+static int opt_thread_sched;
+static int opt_channel_priority;
 
 /* the liblttngconsumerd context */
 static struct lttng_consumer_local_data *ctx;
@@ -167,6 +208,111 @@ static void usage(FILE *fp)
 			"Specify the tracing group name. (default: tracing)\n");
 	fprintf(fp, "  -k, --kernel                       "
 			"Consumer kernel buffers (default).\n");
+	fprintf(fp, "      --data-threads NUM             "
+			"Number of data consumption threads. (default: %d)\n",
+			DEFAULT_CONSUMERD_DATA_THREADS);
+	fprintf(fp, "      --io-uring-depth NUM           "
+			"Write local mmap data with io_uring, NUM writes in flight\n"
+			"                                     "
+			"per stream. 0 disables it. (default: %d)\n",
+			DEFAULT_CONSUMERD_IO_URING_DEPTH);
+	fprintf(fp, "      --batch-bytes SIZE             "
+			"Consume up to SIZE bytes of a local data stream per\n"
+			"                                     "
+			"write. 0 disables batching. (default: %d)\n",
+			DEFAULT_CONSUMERD_BATCH_BYTES);
+	fprintf(fp, "      --async-writeback              "
+			"Start the writeback of the trace files and evict them\n"
+			"                                     "
+			"from the page cache in a dedicated thread.\n");
+	fprintf(fp, "      --preallocate                  "
+			"Preallocate the local data trace files up to the\n"
+			"                                     "
+			"tracefile size of their channel.\n");
+	fprintf(fp, "      --direct-io                    "
+			"Write the local mmap data with direct I/O.\n");
+	fprintf(fp, "      --numa-affine                  "
+			"Bind the data threads to the NUMA nodes and consume\n"
+			"                                     "
+			"each per-CPU stream on the node of its CPU.\n");
+	fprintf(fp, "      --snapshot-threads NUM         "
+			"Number of threads capturing the streams of a channel\n"
+			"                                     "
+			"snapshot. (default: %d)\n",
+			DEFAULT_CONSUMERD_SNAPSHOT_THREADS);
+	fprintf(fp, "      --snapshot-splice              "
+			"Splice the snapshots written locally from the ring\n"
+			"                                     "
+			"buffers instead of copying them.\n");
+	fprintf(fp, "      --wakeup-batch-period USEC     "
+			"Poll the data streams every USEC under load instead of\n"
+			"                                     "
+			"on every wakeup. 0 disables it. (default: %d)\n",
+			DEFAULT_CONSUMERD_WAKEUP_BATCH_PERIOD);
+	fprintf(fp, "      --switch-skip-max NUM          "
+			"Run the switch timer of the UST data channels and skip\n"
+			"                                     "
+			"up to NUM periods of the quiet streams. 0 leaves it to\n"
+			"                                     "
+			"the tracer. (default: %d)\n",
+			DEFAULT_CONSUMERD_SWITCH_SKIP_MAX);
+	fprintf(fp, "      --relayd-data-connections NUM  "
+			"Number of data connections opened to each relay\n"
+			"                                     "
+			"daemon. (default: %d)\n",
+			DEFAULT_CONSUMERD_RELAYD_DATA_CONNECTIONS);
+	fprintf(fp, "      --relayd-backpressure POLICY   "
+			"React to the backpressure of the relay daemons: none,\n"
+			"                                     "
+			"throttle or discard. (default: %s)\n",
+			DEFAULT_CONSUMERD_BACKPRESSURE);
+	fprintf(fp, "      --relayd-compression           "
+			"Compress the data packets sent to the relay daemons\n"
+			"                                     "
+			"supporting it.%s\n",
+#ifdef HAVE_LIBZ
+			""
+#else
+			" (support not compiled in)"
+#endif
+			);
+	fprintf(fp, "      --relayd-zerocopy              "
+			"Send the data packets to the relay daemons without\n"
+			"                                     "
+			"copying them (MSG_ZEROCOPY).%s\n",
+#ifdef MSG_ZEROCOPY
+			""
+#else
+			" (support not compiled in)"
+#endif
+			);
+	fprintf(fp, "      --spool-dir PATH               "
+			"Spool the packets of the stalled relay daemon data\n"
+			"                                     "
+			"connections in PATH.\n");
+	fprintf(fp, "      --spool-size SIZE              "
+			"Spool up to SIZE bytes per relay daemon session.\n"
+			"                                     "
+			"(default: %d)\n",
+			DEFAULT_CONSUMERD_SPOOL_SIZE);
+	fprintf(fp, "      --metadata-cache-trim          "
+			"Release the UST metadata committed to the metadata\n"
+			"                                     "
+			"channels from their cache.\n");
+	fprintf(fp, "      --sparse-padding               "
+			"Leave the padding of the packets written to the\n"
+			"                                     "
+			"local tracefiles as holes.\n");
+	fprintf(fp, "      --thread-sched SPEC            "
+			"Set the scheduling policy and CPU affinity of the\n"
+			"                                     "
+			"consumer threads, as TYPE=POLICY[:PRIO][@CPUS]\n"
+			"                                     "
+			"entries separated by ';'.\n");
+	fprintf(fp, "      --channel-priority SPEC        "
+			"Set the consumption priority of the channels, as\n"
+			"                                     "
+			"PATTERN=PRIO entries separated by ';'.\n");
 	fprintf(fp, "  -u, --ust                          "
 			"Consumer UST buffers.%s\n",
 #ifdef HAVE_LIBLTTNG_UST_CTL
@@ -177,6 +323,549 @@ static void usage(FILE *fp)
 			);
 }
 
+/*
+ * Parse an unsigned integer, between "min" and "max".
+ *
+ * Return 0 on success or else -1.
+ */
+static int parse_uint(const char *str, unsigned int min, unsigned int max,
+		unsigned int *value)
+{
+	char *end;
+	unsigned long val;
+
+	errno = 0;
+	val = strtoul(str, &end, 10);
+	if (errno != 0 || end == str || *end != '\0' || val < min ||
+			val > max) {
+		return -1;
+	}
+
+	*value = (unsigned int) val;
+	return 0;
+}
+
+/*
+ * Get the number of data threads to launch from the command line or, if
+ * unset, the environment.
+ */
+static unsigned int get_nr_data_threads(void)
+{
+	const char *env;
+	unsigned int nr_threads = DEFAULT_CONSUMERD_DATA_THREADS;
+
+	if (opt_data_threads) {
+		return opt_data_threads;
+	}
+
+	env = lttng_secure_getenv(DEFAULT_CONSUMERD_DATA_THREADS_ENV);
+	if (env && parse_uint(env, 1, DEFAULT_CONSUMERD_MAX_DATA_THREADS,
+			&nr_threads)) {
+		WARN("Invalid value for %s: %s. Using %d data thread(s).",
+				DEFAULT_CONSUMERD_DATA_THREADS_ENV, env,
+				DEFAULT_CONSUMERD_DATA_THREADS);
+		nr_threads = DEFAULT_CONSUMERD_DATA_THREADS;
+	}
+	return nr_threads;
+}
+
+/*
+ * Get the number of snapshot threads from the command line or, if unset, the
+ * environment.
+ */
+static unsigned int get_nr_snapshot_threads(void)
+{
+	const char *env;
+	unsigned int nr_threads = DEFAULT_CONSUMERD_SNAPSHOT_THREADS;
+
+	if (opt_snapshot_threads) {
+		return opt_snapshot_threads;
+	}
+
+	env = lttng_secure_getenv(DEFAULT_CONSUMERD_SNAPSHOT_THREADS_ENV);
+	if (env && parse_uint(env, 1, DEFAULT_CONSUMERD_MAX_SNAPSHOT_THREADS,
+			&nr_threads)) {
+		WARN("Invalid value for %s: %s. Using %d snapshot thread(s).",
+				DEFAULT_CONSUMERD_SNAPSHOT_THREADS_ENV, env,
+				DEFAULT_CONSUMERD_SNAPSHOT_THREADS);
+		nr_threads = DEFAULT_CONSUMERD_SNAPSHOT_THREADS;
+	}
+	return nr_threads;
+}
+
+/*
+ * Get the number of metadata threads to launch from the environment.
+ */
+static unsigned int get_nr_metadata_threads(void)
+{
+	const char *env;
+	unsigned int nr_threads = DEFAULT_CONSUMERD_METADATA_THREADS;
+
+	env = lttng_secure_getenv(DEFAULT_CONSUMERD_METADATA_THREADS_ENV);
+	if (env && parse_uint(env, 1,
+			DEFAULT_CONSUMERD_MAX_METADATA_THREADS, &nr_threads)) {
+		WARN("Invalid value for %s: %s. Using %d metadata thread(s).",
+				DEFAULT_CONSUMERD_METADATA_THREADS_ENV, env,
+				DEFAULT_CONSUMERD_METADATA_THREADS);
+		nr_threads = DEFAULT_CONSUMERD_METADATA_THREADS;
+	}
+	return nr_threads;
+}
+
+/*
+ * Get the number of stream setup threads from the environment.
+ */
+static unsigned int get_nr_setup_threads(void)
+{
+	const char *env;
+	unsigned int nr_threads = DEFAULT_CONSUMERD_SETUP_THREADS;
+
+	env = lttng_secure_getenv(DEFAULT_CONSUMERD_SETUP_THREADS_ENV);
+	if (env && parse_uint(env, 1, DEFAULT_CONSUMERD_MAX_SETUP_THREADS,
+			&nr_threads)) {
+		WARN("Invalid value for %s: %s. Using %d setup thread(s).",
+				DEFAULT_CONSUMERD_SETUP_THREADS_ENV, env,
+				DEFAULT_CONSUMERD_SETUP_THREADS);
+		nr_threads = DEFAULT_CONSUMERD_SETUP_THREADS;
+	}
+	return nr_threads;
+}
+
+/*
+ * Get the number of data connections opened to each relayd from the command
+ * line or, if unset, the environment.
+ */
+static unsigned int get_nr_relayd_data_connections(void)
+{
+	const char *env;
+	unsigned int nr_conns = DEFAULT_CONSUMERD_RELAYD_DATA_CONNECTIONS;
+
+	if (opt_relayd_data_connections) {
+		return opt_relayd_data_connections;
+	}
+
+	env = lttng_secure_getenv(DEFAULT_CONSUMERD_RELAYD_DATA_CONNECTIONS_ENV);
+	if (env && parse_uint(env, 1,
+			DEFAULT_CONSUMERD_MAX_RELAYD_DATA_CONNECTIONS, &nr_conns)) {
+		WARN("Invalid value for %s: %s. Using %d relayd data connection(s).",
+				DEFAULT_CONSUMERD_RELAYD_DATA_CONNECTIONS_ENV, env,
+				DEFAULT_CONSUMERD_RELAYD_DATA_CONNECTIONS);
+		nr_conns = DEFAULT_CONSUMERD_RELAYD_DATA_CONNECTIONS;
+	}
+	return nr_conns;
+}
+
+/*
+ * Parse a relayd backpressure policy.
+ *
+ * Return 0 on success or else -1.
+ */
+static int parse_backpressure_policy(const char *str,
+		enum consumer_backpressure_policy *policy)
+{
+	if (!strcmp(str, "none")) {
+		*policy = CONSUMER_BACKPRESSURE_NONE;
+	} else if (!strcmp(str, "throttle")) {
+		*policy = CONSUMER_BACKPRESSURE_THROTTLE;
+	} else if (!strcmp(str, "discard")) {
+		*policy = CONSUMER_BACKPRESSURE_DISCARD;
+	} else {
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Get the relayd backpressure policy from the command line or, if unset, the
+ * environment. The command line value is validated while parsing it.
+ */
+static enum consumer_backpressure_policy get_backpressure_policy(void)
+{
+	const char *env;
+	enum consumer_backpressure_policy policy = CONSUMER_BACKPRESSURE_NONE;
+
+	if (opt_backpressure) {
+		(void) parse_backpressure_policy(opt_backpressure, &policy);
+		return policy;
+	}
+
+	env = lttng_secure_getenv(DEFAULT_CONSUMERD_BACKPRESSURE_ENV);
+	if (env && parse_backpressure_policy(env, &policy)) {
+		WARN("Invalid value for %s: %s. Using the %s backpressure policy.",
+				DEFAULT_CONSUMERD_BACKPRESSURE_ENV, env,
+				DEFAULT_CONSUMERD_BACKPRESSURE);
+		(void) parse_backpressure_policy(DEFAULT_CONSUMERD_BACKPRESSURE,
+				&policy);
+	}
+	return policy;
+}
+
+/*
+ * Parse an io_uring queue depth.
+ *
+ * Return 0 on success or else -1.
+ */
+static int parse_io_uring_depth(const char *str, int *depth)
+{
+	unsigned int val;
+
+	if (parse_uint(str, 0, DEFAULT_CONSUMERD_MAX_IO_URING_DEPTH, &val)) {
+		return -1;
+	}
+
+	*depth = (int) val;
+	return 0;
+}
+
+/*
+ * Get the io_uring queue depth of the data streams from the command line or,
+ * if unset, the environment. io_uring is disabled if the kernel does not
+ * support it.
+ */
+static unsigned int get_io_uring_depth(void)
+{
+	int ret;
+	const char *env;
+	int depth = DEFAULT_CONSUMERD_IO_URING_DEPTH;
+
+	if (opt_io_uring_depth >= 0) {
+		depth = opt_io_uring_depth;
+	} else {
+		env = lttng_secure_getenv(DEFAULT_CONSUMERD_IO_URING_DEPTH_ENV);
+		if (env && parse_io_uring_depth(env, &depth)) {
+			WARN("Invalid value for %s: %s. Using an io_uring depth of %d.",
+					DEFAULT_CONSUMERD_IO_URING_DEPTH_ENV, env,
+					DEFAULT_CONSUMERD_IO_URING_DEPTH);
+			depth = DEFAULT_CONSUMERD_IO_URING_DEPTH;
+		}
+	}
+
+	if (depth) {
+		ret = lttng_io_uring_probe();
+		if (ret < 0) {
+			WARN("io_uring is not supported (%s), using blocking writes",
+					strerror(-ret));
+			depth = 0;
+		}
+	}
+	return (unsigned int) depth;
+}
+
+/*
+ * Parse a batch byte budget. Size suffixes (k, M, G) are accepted.
+ *
+ * Return 0 on success or else -1.
+ */
+static int parse_batch_bytes(const char *str, int64_t *batch_bytes)
+{
+	uint64_t val;
+
+	if (utils_parse_size_suffix(str, &val) < 0 ||
+			val > DEFAULT_CONSUMERD_MAX_BATCH_BYTES) {
+		return -1;
+	}
+
+	*batch_bytes = (int64_t) val;
+	return 0;
+}
+
+/*
+ * Get the batch byte budget of the data streams from the command line or, if
+ * unset, the environment.
+ */
+static unsigned long get_batch_bytes(void)
+{
+	const char *env;
+	int64_t batch_bytes = DEFAULT_CONSUMERD_BATCH_BYTES;
+
+	if (opt_batch_bytes >= 0) {
+		return (unsigned long) opt_batch_bytes;
+	}
+
+	env = lttng_secure_getenv(DEFAULT_CONSUMERD_BATCH_BYTES_ENV);
+	if (env && parse_batch_bytes(env, &batch_bytes)) {
+		WARN("Invalid value for %s: %s. Using a batch size of %d bytes.",
+				DEFAULT_CONSUMERD_BATCH_BYTES_ENV, env,
+				DEFAULT_CONSUMERD_BATCH_BYTES);
+		batch_bytes = DEFAULT_CONSUMERD_BATCH_BYTES;
+	}
+	return (unsigned long) batch_bytes;
+}
+
+/*
+ * Parse a wakeup batching period in usec.
+ *
+ * Return 0 on success or else -1.
+ */
+static int parse_wakeup_batch_period(const char *str, int64_t *period)
+{
+	unsigned int val;
+
+	if (parse_uint(str, 0, DEFAULT_CONSUMERD_MAX_WAKEUP_BATCH_PERIOD,
+			&val)) {
+		return -1;
+	}
+
+	*period = (int64_t) val;
+	return 0;
+}
+
+/*
+ * Get the adaptive wakeup batching period of the data threads from the
+ * command line or, if unset, the environment.
+ */
+static unsigned int get_wakeup_batch_period(void)
+{
+	const char *env;
+	int64_t period = DEFAULT_CONSUMERD_WAKEUP_BATCH_PERIOD;
+
+	if (opt_wakeup_batch_period >= 0) {
+		return (unsigned int) opt_wakeup_batch_period;
+	}
+
+	env = lttng_secure_getenv(DEFAULT_CONSUMERD_WAKEUP_BATCH_PERIOD_ENV);
+	if (env && parse_wakeup_batch_period(env, &period)) {
+		WARN("Invalid value for %s: %s. Using a wakeup batching period of %d usec.",
+				DEFAULT_CONSUMERD_WAKEUP_BATCH_PERIOD_ENV, env,
+				DEFAULT_CONSUMERD_WAKEUP_BATCH_PERIOD);
+		period = DEFAULT_CONSUMERD_WAKEUP_BATCH_PERIOD;
+	}
+	return (unsigned int) period;
+}
+
+/*
+ * Parse a maximal number of skipped switch timer periods.
+ *
+ * Return 0 on success or else -1.
+ */
+static int parse_switch_skip_max(const char *str, int *skip_max)
+{
+	unsigned int val;
+
+	if (parse_uint(str, 0, DEFAULT_CONSUMERD_MAX_SWITCH_SKIP_MAX, &val)) {
+		return -1;
+	}
+
+	*skip_max = (int) val;
+	return 0;
+}
+
+/*
+ * Get the maximal number of consecutive switch timer periods skipped for a
+ * quiet stream from the command line or, if unset, the environment.
+ */
+static unsigned int get_switch_skip_max(void)
+{
+	const char *env;
+	int skip_max = DEFAULT_CONSUMERD_SWITCH_SKIP_MAX;
+
+	if (opt_switch_skip_max >= 0) {
+		return (unsigned int) opt_switch_skip_max;
+	}
+
+	env = lttng_secure_getenv(DEFAULT_CONSUMERD_SWITCH_SKIP_MAX_ENV);
+	if (env && parse_switch_skip_max(env, &skip_max)) {
+		WARN("Invalid value for %s: %s. Using %d skipped switch periods.",
+				DEFAULT_CONSUMERD_SWITCH_SKIP_MAX_ENV, env,
+				DEFAULT_CONSUMERD_SWITCH_SKIP_MAX);
+		skip_max = DEFAULT_CONSUMERD_SWITCH_SKIP_MAX;
+	}
+	return (unsigned int) skip_max;
+}
+
+/*
+ * Enable the relayd spool if a spool directory is set on the command line or
+ * in the environment.
+ *
+ * Return 1 if the spool is enabled or else 0.
+ */
+static int setup_spool(void)
+{
+	const char *dir, *env;
+	uint64_t size = DEFAULT_CONSUMERD_SPOOL_SIZE;
+
+	dir = opt_spool_dir;
+	if (!dir) {
+		dir = lttng_secure_getenv(DEFAULT_CONSUMERD_SPOOL_DIR_ENV);
+		if (!dir || *dir == '\0') {
+			return 0;
+		}
+	}
+
+	if (opt_spool_size >= 0) {
+		size = (uint64_t) opt_spool_size;
+	} else {
+		env = lttng_secure_getenv(DEFAULT_CONSUMERD_SPOOL_SIZE_ENV);
+		if (env && utils_parse_size_suffix(env, &size) < 0) {
+			WARN("Invalid value for %s: %s. Spooling up to %d bytes.",
+					DEFAULT_CONSUMERD_SPOOL_SIZE_ENV, env,
+					DEFAULT_CONSUMERD_SPOOL_SIZE);
+			size = DEFAULT_CONSUMERD_SPOOL_SIZE;
+		}
+	}
+	if (!size) {
+		return 0;
+	}
+
+	if (consumer_spool_enable(dir, size)) {
+		WARN("Relayd spool disabled");
+		return 0;
+	}
+	DBG("Spooling up to %" PRIu64 " bytes per relayd in %s", size, dir);
+	return 1;
+}
+
+/*
+ * Stripe the tracefiles written locally if stripe roots are set in the
+ * environment.
+ */
+static void setup_stripe(void)
+{
+	const char *paths;
+
+	paths = lttng_secure_getenv(DEFAULT_CONSUMERD_STRIPE_PATHS_ENV);
+	if (!paths || *paths == '\0') {
+		return;
+	}
+	if (stripe_set_roots(paths)) {
+		WARN("Striped output disabled");
+		return;
+	}
+	DBG("Striping the tracefiles under %s", paths);
+}
+
+/*
+ * Set the scheduling of the consumer threads from the environment, unless it
+ * was set on the command line, where it is validated while parsing it.
+ */
+static void setup_thread_sched(void)
+{
+	const char *spec;
+
+	if (opt_thread_sched) {
+		return;
+	}
+	spec = lttng_secure_getenv(DEFAULT_CONSUMERD_THREAD_SCHED_ENV);
+	if (spec && consumer_sched_parse(spec)) {
+		WARN("Invalid value for %s: %s. Using the default thread scheduling.",
+				DEFAULT_CONSUMERD_THREAD_SCHED_ENV, spec);
+	}
+}
+
+/*
+ * Set the consumption priority of the channels from the environment, unless
+ * it was set on the command line, where it is validated while parsing it.
+ */
+static void setup_channel_priority(void)
+{
+	const char *spec;
+
+	if (opt_channel_priority) {
+		return;
+	}
+	spec = lttng_secure_getenv(DEFAULT_CONSUMERD_CHANNEL_PRIORITY_ENV);
+	if (spec && consumer_priority_parse(spec)) {
+		WARN("Invalid value for %s: %s. Using the default channel priority.",
+				DEFAULT_CONSUMERD_CHANNEL_PRIORITY_ENV, spec);
+	}
+}
+
+/*
+ * Enable the asynchronous writeback if requested on the command line or in
+ * the environment, along with its tuning from the environment.
+ *
+ * Return 1 if the asynchronous writeback is enabled or else 0.
+ */
+static int setup_async_writeback(void)
+{
+	const char *env;
+	uint64_t coalesce_bytes = DEFAULT_CONSUMERD_WRITEBACK_COALESCE_BYTES;
+	unsigned long evict_lag = DEFAULT_CONSUMERD_WRITEBACK_EVICT_LAG;
+
+	if (!opt_async_writeback) {
+		env = lttng_secure_getenv(DEFAULT_CONSUMERD_ASYNC_WRITEBACK_ENV);
+		if (!env || strcmp(env, "1")) {
+			return 0;
+		}
+	}
+
+	env = lttng_secure_getenv(DEFAULT_CONSUMERD_WRITEBACK_COALESCE_ENV);
+	if (env && (utils_parse_size_suffix(env, &coalesce_bytes) < 0 ||
+			coalesce_bytes > ULONG_MAX)) {
+		WARN("Invalid value for %s: %s. Coalescing up to %d bytes.",
+				DEFAULT_CONSUMERD_WRITEBACK_COALESCE_ENV, env,
+				DEFAULT_CONSUMERD_WRITEBACK_COALESCE_BYTES);
+		coalesce_bytes = DEFAULT_CONSUMERD_WRITEBACK_COALESCE_BYTES;
+	}
+
+	env = lttng_secure_getenv(DEFAULT_CONSUMERD_WRITEBACK_EVICT_LAG_ENV);
+	if (env) {
+		char *end;
+
+		errno = 0;
+		evict_lag = strtoul(env, &end, 10);
+		if (errno != 0 || end == env || *end != '\0' ||
+				evict_lag > UINT_MAX) {
+			WARN("Invalid value for %s: %s. Using an eviction lag of %d sub-buffer(s).",
+					DEFAULT_CONSUMERD_WRITEBACK_EVICT_LAG_ENV, env,
+					DEFAULT_CONSUMERD_WRITEBACK_EVICT_LAG);
+			evict_lag = DEFAULT_CONSUMERD_WRITEBACK_EVICT_LAG;
+		}
+	}
+
+	consumer_writeback_enable((unsigned long) coalesce_bytes,
+			(unsigned int) evict_lag);
+	DBG("Asynchronous writeback enabled (coalescing: %" PRIu64
+			" bytes, eviction lag: %lu sub-buffer(s))",
+			coalesce_bytes, evict_lag);
+	return 1;
+}
+
+/*
+ * Return 1 if a boolean setting is enabled on the command line ("opt") or
+ * set to 1 in the environment variable "env_name", or else 0.
+ */
+static int get_bool_setting(int opt, const char *env_name)
+{
+	const char *env;
+
+	if (opt) {
+		return 1;
+	}
+	env = lttng_secure_getenv(env_name);
+	return env && !strcmp(env, "1");
+}
+
+/*
+ * Enable the NUMA affinity of the data threads if requested and if the host
+ * has more than one NUMA node. At least one data thread is then launched per
+ * node.
+ */
+static void setup_numa_affinity(unsigned int *nr_data_threads)
+{
+	int ret;
+
+	if (!get_bool_setting(opt_numa_affine, DEFAULT_CONSUMERD_NUMA_AFFINE_ENV)) {
+		return;
+	}
+
+	ret = consumer_numa_init();
+	if (ret < 0) {
+		WARN("NUMA topology unavailable, data threads are not bound");
+		return;
+	}
+	if (ret == 1) {
+		DBG("Single NUMA node, data threads are not bound");
+		return;
+	}
+
+	consumer_data.numa_affine = 1;
+	if (*nr_data_threads < (unsigned int) ret) {
+		*nr_data_threads = (unsigned int) ret;
+	}
+	DBG("NUMA affinity enabled over %d node(s)", ret);
+}
+
 /*
  * daemon argument parsing
  */
@@ -194,6 +883,27 @@ static int parse_args(int argc, char **argv)
 		{ "verbose", 0, 0, 'v' },
 		{ "version", 0, 0, 'V' },
 		{ "kernel", 0, 0, 'k' },
+		{ "data-threads", 1, 0, 'T' },
+		{ "io-uring-depth", 1, 0, 'I' },
+		{ "batch-bytes", 1, 0, 'B' },
+		{ "async-writeback", 0, 0, 'W' },
+		{ "preallocate", 0, 0, 'P' },
+		{ "direct-io", 0, 0, 'D' },
+		{ "numa-affine", 0, 0, 'N' },
+		{ "snapshot-threads", 1, 0, 'S' },
+		{ "snapshot-splice", 0, 0, 'Z' },
+		{ "wakeup-batch-period", 1, 0, 'A' },
+		{ "switch-skip-max", 1, 0, 'J' },
+		{ "relayd-data-connections", 1, 0, 'K' },
+		{ "relayd-backpressure", 1, 0, 'R' },
+		{ "relayd-compression", 0, 0, 'X' },
+		{ "relayd-zerocopy", 0, 0, 'Y' },
+		{ "spool-dir", 1, 0, 'O' },
+		{ "spool-size", 1, 0, 'Q' },
+		{ "metadata-cache-trim", 0, 0, 'M' },
+		{ "sparse-padding", 0, 0, 'L' },
+		{ "thread-sched", 1, 0, 'H' },
+		{ "channel-priority", 1, 0, 'F' },
 #ifdef HAVE_LIBLTTNG_UST_CTL
 		{ "ust", 0, 0, 'u' },
 #endif
@@ -260,6 +970,138 @@ static int parse_args(int argc, char **argv)
 		case 'k':
 			opt_type = LTTNG_CONSUMER_KERNEL;
 			break;
+		case 'T':
+			ret = parse_uint(optarg, 1,
+					DEFAULT_CONSUMERD_MAX_DATA_THREADS,
+					&opt_data_threads);
+			if (ret) {
+				ERR("Invalid number of data threads: %s", optarg);
+				goto end;
+			}
+			break;
+		case 'I':
+			ret = parse_io_uring_depth(optarg, &opt_io_uring_depth);
+			if (ret) {
+				ERR("Invalid io_uring depth: %s", optarg);
+				goto end;
+			}
+			break;
+		case 'B':
+			ret = parse_batch_bytes(optarg, &opt_batch_bytes);
+			if (ret) {
+				ERR("Invalid batch size: %s", optarg);
+				goto end;
+			}
+			break;
+		case 'W':
+			opt_async_writeback = 1;
+			break;
+		case 'P':
+			opt_preallocate = 1;
+			break;
+		case 'D':
+			opt_direct_io = 1;
+			break;
+		case 'N':
+			opt_numa_affine = 1;
+			break;
+		case 'S':
+			ret = parse_uint(optarg, 1,
+					DEFAULT_CONSUMERD_MAX_SNAPSHOT_THREADS,
+					&opt_snapshot_threads);
+			if (ret) {
+				ERR("Invalid number of snapshot threads: %s", optarg);
+				goto end;
+			}
+			break;
+		case 'Z':
+			opt_snapshot_splice = 1;
+			break;
+		case 'A':
+			ret = parse_wakeup_batch_period(optarg,
+					&opt_wakeup_batch_period);
+			if (ret) {
+				ERR("Invalid wakeup batching period: %s", optarg);
+				goto end;
+			}
+			break;
+		case 'J':
+			ret = parse_switch_skip_max(optarg, &opt_switch_skip_max);
+			if (ret) {
+				ERR("Invalid number of skipped switch periods: %s",
+						optarg);
+				goto end;
+			}
+			break;
+		case 'K':
+			ret = parse_uint(optarg, 1,
+					DEFAULT_CONSUMERD_MAX_RELAYD_DATA_CONNECTIONS,
+					&opt_relayd_data_connections);
+			if (ret) {
+				ERR("Invalid number of relayd data connections: %s",
+						optarg);
+				goto end;
+			}
+			break;
+		case 'R':
+		{
+			enum consumer_backpressure_policy policy;
+
+			ret = parse_backpressure_policy(optarg, &policy);
+			if (ret) {
+				ERR("Invalid relayd backpressure policy: %s", optarg);
+				goto end;
+			}
+			opt_backpressure = optarg;
+			break;
+		}
+		case 'X':
+			opt_relayd_compression = 1;
+			break;
+		case 'Y':
+			opt_relayd_zerocopy = 1;
+			break;
+		case 'O':
+			if (lttng_is_setuid_setgid()) {
+				WARN("Getting '%s' argument from setuid/setgid binary refused for security reasons.",
+					"--spool-dir");
+			} else {
+				opt_spool_dir = optarg;
+			}
+			break;
+		case 'Q':
+		{
+			uint64_t size;
+
+			if (utils_parse_size_suffix(optarg, &size) < 0 ||
+					size > INT64_MAX) {
+				ERR("Invalid spool size: %s", optarg);
+				ret = -1;
+				goto end;
+			}
+			opt_spool_size = (int64_t) size;
+			break;
+		}
+		case 'M':
+			opt_metadata_cache_trim = 1;
+			break;
+		case 'L':
+			opt_sparse_padding = 1;
+			break;
+		case 'H':
+			if (consumer_sched_parse(optarg)) {
+				ret = -1;
+				goto end;
+			}
+			opt_thread_sched = 1;
+			break;
+		case 'F':
+			if (consumer_priority_parse(optarg)) {
+				ret = -1;
+				goto end;
+			}
+			opt_channel_priority = 1;
+			break;
 #ifdef HAVE_LIBLTTNG_UST_CTL
 		case 'u':
 # if (CAA_BITS_PER_LONG == 64)
@@ -307,6 +1149,7 @@ int main(int argc, char **argv)
 {
 	int ret = 0, retval = 0;
 	void *status;
+	unsigned int i, nr_data_threads;
 	struct lttng_consumer_local_data *tmp_ctx;
 
 	rcu_register_thread();
@@ -415,13 +1258,92 @@ int main(int argc, char **argv)
 		goto exit_init_data;
 	}
 
+	nr_data_threads = get_nr_data_threads();
+	setup_numa_affinity(&nr_data_threads);
+	setup_thread_sched();
+	setup_channel_priority();
+
 	/* create the consumer instance with and assign the callbacks */
 	ctx = lttng_consumer_create(opt_type, lttng_consumer_read_subbuffer,
-		NULL, lttng_consumer_on_recv_stream, NULL);
+		NULL, lttng_consumer_on_recv_stream, NULL,
+		nr_data_threads, get_nr_metadata_threads());
 	if (!ctx) {
 		retval = -1;
 		goto exit_init_data;
 	}
+	DBG("Using %u data thread(s)", ctx->nr_data_shards);
+	DBG("Using %u metadata thread(s)", ctx->nr_metadata_shards);
+
+	consumer_data.io_uring_depth = get_io_uring_depth();
+	DBG("Using an io_uring depth of %u", consumer_data.io_uring_depth);
+	consumer_data.batch_bytes = get_batch_bytes();
+	DBG("Using a batch size of %lu bytes", consumer_data.batch_bytes);
+	consumer_data.preallocate = get_bool_setting(opt_preallocate,
+			DEFAULT_CONSUMERD_PREALLOCATE_ENV);
+	consumer_data.direct_io = get_bool_setting(opt_direct_io,
+			DEFAULT_CONSUMERD_DIRECT_IO_ENV);
+	DBG("Trace file preallocation %s, direct I/O %s",
+			consumer_data.preallocate ? "enabled" : "disabled",
+			consumer_data.direct_io ? "enabled" : "disabled");
+	consumer_data.snapshot_threads = get_nr_snapshot_threads();
+	DBG("Using %u snapshot thread(s)", consumer_data.snapshot_threads);
+	consumer_data.setup_threads = get_nr_setup_threads();
+	DBG("Using %u stream setup thread(s)", consumer_data.setup_threads);
+	consumer_data.snapshot_splice = get_bool_setting(opt_snapshot_splice,
+			DEFAULT_CONSUMERD_SNAPSHOT_SPLICE_ENV);
+	consumer_data.wakeup_batch_period_us = get_wakeup_batch_period();
+	DBG("Using a wakeup batching period of %u usec",
+			consumer_data.wakeup_batch_period_us);
+	consumer_data.switch_skip_max = get_switch_skip_max();
+	DBG("Skipping up to %u switch periods of the quiet streams",
+			consumer_data.switch_skip_max);
+	consumer_data.relayd_data_connections = get_nr_relayd_data_connections();
+	DBG("Opening %u data connection(s) per relayd",
+			consumer_data.relayd_data_connections);
+	consumer_data.backpressure_policy = get_backpressure_policy();
+	DBG("Using the relayd backpressure policy %d",
+			consumer_data.backpressure_policy);
+	if (get_bool_setting(opt_relayd_compression,
+			DEFAULT_CONSUMERD_RELAYD_COMPRESSION_ENV)) {
+#ifdef HAVE_LIBZ
+		consumer_data.relayd_compression = 1;
+		DBG("Compressing the data packets sent to the relayds");
+#else
+		WARN("Relayd compression support not compiled in, ignoring");
+#endif
+	}
+	if (get_bool_setting(opt_relayd_zerocopy,
+			DEFAULT_CONSUMERD_RELAYD_ZEROCOPY_ENV)) {
+#ifdef MSG_ZEROCOPY
+		consumer_data.relayd_zerocopy = 1;
+		DBG("Sending the data packets to the relayds without copy");
+#else
+		WARN("Zero-copy send support not compiled in, ignoring");
+#endif
+	}
+	consumer_data.metadata_cache_trim = get_bool_setting(
+			opt_metadata_cache_trim,
+			DEFAULT_CONSUMERD_METADATA_CACHE_TRIM_ENV);
+	DBG("Metadata cache trimming %s",
+			consumer_data.metadata_cache_trim ? "enabled" : "disabled");
+	consumer_data.sparse_padding = get_bool_setting(opt_sparse_padding,
+			DEFAULT_CONSUMERD_SPARSE_PADDING_ENV);
+	DBG("Sparse packet padding %s",
+			consumer_data.sparse_padding ? "enabled" : "disabled");
+
+	data_threads = zmalloc(ctx->nr_data_shards * sizeof(*data_threads));
+	if (!data_threads) {
+		PERROR("zmalloc data threads");
+		retval = -1;
+		goto exit_init_data;
+	}
+	metadata_threads = zmalloc(ctx->nr_metadata_shards *
+			sizeof(*metadata_threads));
+	if (!metadata_threads) {
+		PERROR("zmalloc metadata threads");
+		retval = -1;
+		goto exit_init_data;
+	}
 
 	lttng_consumer_set_command_sock_path(ctx, command_sock_path);
 	if (*error_sock_path == '\0') {
@@ -473,10 +1395,11 @@ int main(int argc, char **argv)
 	lttng_consumer_set_error_sock(ctx, ret);
 
 	/*
-	 * Block RT signals used for UST periodical metadata flush and the live
-	 * timer in main, and create a dedicated thread to handle these signals.
+	 * Initialize the timer wheel used for UST periodical metadata flush, the
+	 * live timer and channel monitoring. Its dedicated thread is created
+	 * below.
 	 */
-	if (consumer_signal_init()) {
+	if (consumer_timer_init()) {
 		retval = -1;
 		goto exit_init_data;
 	}
@@ -521,6 +1444,34 @@ int main(int argc, char **argv)
 	}
 	metadata_timer_thread_online = true;
 
+	setup_stripe();
+
+	/* Create the thread handling the writeback of the trace files. */
+	if (setup_async_writeback()) {
+		ret = pthread_create(&writeback_thread, default_pthread_attr(),
+				consumer_thread_writeback, NULL);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_create writeback");
+			retval = -1;
+			goto exit_writeback_thread;
+		}
+		writeback_thread_online = true;
+	}
+
+	/* Create the thread replaying the spooled relayd packets. */
+	if (setup_spool()) {
+		ret = pthread_create(&spool_thread, default_pthread_attr(),
+				consumer_thread_spool, NULL);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_create spool");
+			retval = -1;
+			goto exit_spool_thread;
+		}
+		spool_thread_online = true;
+	}
+
 	/* Create thread to manage channels */
 	ret = pthread_create(&channel_thread, default_pthread_attr(),
 			consumer_thread_channel_poll,
@@ -532,25 +1483,48 @@ int main(int argc, char **argv)
 		goto exit_channel_thread;
 	}
 
-	/* Create thread to manage the polling/writing of trace metadata */
-	ret = pthread_create(&metadata_thread, default_pthread_attr(),
-			consumer_thread_metadata_poll,
-			(void *) ctx);
-	if (ret) {
-		errno = ret;
-		PERROR("pthread_create");
-		retval = -1;
-		goto exit_metadata_thread;
+	/*
+	 * Create the threads to manage the polling/writing of trace metadata,
+	 * one per metadata shard.
+	 */
+	for (i = 0; i < ctx->nr_metadata_shards; i++) {
+		ret = pthread_create(&metadata_threads[i], default_pthread_attr(),
+				consumer_thread_metadata_poll,
+				(void *) &ctx->metadata_shards[i]);
+		if (ret) {
+			unsigned int j;
+
+			errno = ret;
+			PERROR("pthread_create");
+			retval = -1;
+			/*
+			 * No data thread will close the metadata pipes, let the
+			 * metadata threads already launched exit.
+			 */
+			for (j = 0; j < ctx->nr_metadata_shards; j++) {
+				(void) lttng_pipe_write_close(
+						ctx->metadata_shards[j].metadata_pipe);
+			}
+			goto exit_metadata_thread;
+		}
+		nr_metadata_threads_online++;
 	}
 
-	/* Create thread to manage the polling/writing of trace data */
-	ret = pthread_create(&data_thread, default_pthread_attr(),
-			consumer_thread_data_poll, (void *) ctx);
-	if (ret) {
-		errno = ret;
-		PERROR("pthread_create");
-		retval = -1;
-		goto exit_data_thread;
+	/*
+	 * Create the threads to manage the polling/writing of trace data, one
+	 * per data shard.
+	 */
+	for (i = 0; i < ctx->nr_data_shards; i++) {
+		ret = pthread_create(&data_threads[i], default_pthread_attr(),
+				consumer_thread_data_poll,
+				(void *) &ctx->data_shards[i]);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_create");
+			retval = -1;
+			goto exit_data_thread;
+		}
+		nr_data_threads_online++;
 	}
 
 	/* Create the thread to manage the reception of fds */
@@ -586,21 +1560,27 @@ int main(int argc, char **argv)
 	}
 exit_sessiond_thread:
 
-	ret = pthread_join(data_thread, &status);
-	if (ret) {
-		errno = ret;
-		PERROR("pthread_join data_thread");
-		retval = -1;
-	}
 exit_data_thread:
-
-	ret = pthread_join(metadata_thread, &status);
-	if (ret) {
-		errno = ret;
-		PERROR("pthread_join metadata_thread");
-		retval = -1;
+	for (i = 0; i < nr_data_threads_online; i++) {
+		ret = pthread_join(data_threads[i], &status);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_join data_thread");
+			retval = -1;
+		}
 	}
+	nr_data_threads_online = 0;
+
 exit_metadata_thread:
+	for (i = 0; i < nr_metadata_threads_online; i++) {
+		ret = pthread_join(metadata_threads[i], &status);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_join metadata_thread");
+			retval = -1;
+		}
+	}
+	nr_metadata_threads_online = 0;
 
 	ret = pthread_join(channel_thread, &status);
 	if (ret) {
@@ -610,6 +1590,8 @@ exit_metadata_thread:
 	}
 exit_channel_thread:
 
+exit_spool_thread:
+exit_writeback_thread:
 exit_metadata_timer_thread:
 
 	ret = pthread_join(health_thread, &status);
@@ -624,6 +1606,20 @@ exit_health_thread:
 exit_health_pipe:
 
 exit_init_data:
+	if (spool_thread_online) {
+		/*
+		 * The relayds are destroyed by lttng_consumer_cleanup(), which
+		 * sends what is left in their spools.
+		 */
+		consumer_spool_stop();
+		ret = pthread_join(spool_thread, &status);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_join spool_thread");
+			retval = -1;
+		}
+		spool_thread_online = false;
+	}
 	/*
 	 * Wait for all pending call_rcu work to complete before tearing
 	 * down data structures. call_rcu worker may be trying to
@@ -643,7 +1639,7 @@ exit_init_data:
 		 * threads are gone, because it is required to perform timer
 		 * teardown synchronization.
 		 */
-		kill(getpid(), LTTNG_CONSUMER_SIG_EXIT);
+		consumer_timer_thread_quit();
 		ret = pthread_join(metadata_timer_thread, &status);
 		if (ret) {
 			errno = ret;
@@ -652,10 +1648,26 @@ exit_init_data:
 		}
 		metadata_timer_thread_online = false;
 	}
+	if (writeback_thread_online) {
+		/*
+		 * The writeback thread processes every queued range before
+		 * exiting. No other thread can queue ranges at this point.
+		 */
+		consumer_writeback_stop();
+		ret = pthread_join(writeback_thread, &status);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_join writeback_thread");
+			retval = -1;
+		}
+		writeback_thread_online = false;
+	}
 	tmp_ctx = ctx;
 	ctx = NULL;
 	cmm_barrier();	/* Clear ctx for signal handler. */
 	lttng_consumer_destroy(tmp_ctx);
+	free(data_threads);
+	free(metadata_threads);
 
 	if (health_consumerd) {
 		health_app_destroy(health_consumerd);
@@ -25,6 +25,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
+#include <sys/uio.h>
 #include <fcntl.h>
 #include <sys/wait.h>
 #include <unistd.h>
@@ -33,15 +34,20 @@
 #include <byteswap.h>
 #include <inttypes.h>
 #include <stdbool.h>
+#include <pthread.h>
 
 #include <version.h>
 #include <lttng/lttng.h>
 #include <common/common.h>
 #include <common/utils.h>
+#include <common/compat/endian.h>
+#include <common/index/index.h>
 
 #define DEFAULT_VIEWER "babeltrace"
 
 #define COPY_BUFLEN		4096
+/* Packets written by a single writev(). */
+#define PACKET_BATCH_LEN	64
 #define RB_CRASH_DUMP_ABI_LEN	32
 
 #define RB_CRASH_DUMP_ABI_MAGIC_LEN	16
@@ -196,10 +202,23 @@ static char *progname,
 
 static char *input_path;
 
+/* Number of threads extracting the buffer files of a trace. */
+static unsigned long opt_jobs = 1;
+
+/* Time range of the packets to extract, in trace clock cycles. */
+static uint64_t opt_begin = 0, opt_end = UINT64_MAX;
+
+/* Channels to extract, all of them if there is none. */
+static char **opt_channels;
+static unsigned int opt_nr_channels;
+
 int lttng_opt_quiet, lttng_opt_verbose, lttng_opt_mi;
 
 enum {
 	OPT_DUMP_OPTIONS,
+	OPT_BEGIN,
+	OPT_END,
+	OPT_CHANNEL,
 };
 
 /* Getopt options. No first level command. */
@@ -209,6 +228,10 @@ static struct option long_options[] = {
 	{ "verbose",		0, NULL, 'v' },
 	{ "viewer",		1, NULL, 'e' },
 	{ "extract",		1, NULL, 'x' },
+	{ "jobs",		1, NULL, 'j' },
+	{ "begin",		1, NULL, OPT_BEGIN },
+	{ "end",		1, NULL, OPT_END },
+	{ "channel",		1, NULL, OPT_CHANNEL },
 	{ "list-options",	0, NULL, OPT_DUMP_OPTIONS },
 	{ NULL, 0, NULL, 0 },
 };
@@ -256,6 +279,38 @@ static void list_options(FILE *ofp)
 	}
 }
 
+static int parse_timestamp(const char *arg, uint64_t *timestamp)
+{
+	char *endptr;
+
+	errno = 0;
+	*timestamp = strtoull(arg, &endptr, 0);
+	if (errno != 0 || !isdigit(arg[0]) || *endptr != '\0') {
+		return -1;
+	}
+	return 0;
+}
+
+static int add_channel(const char *name)
+{
+	char **new_channels;
+
+	new_channels = realloc(opt_channels,
+		(opt_nr_channels + 1) * sizeof(*new_channels));
+	if (!new_channels) {
+		PERROR("realloc channels");
+		return -1;
+	}
+	opt_channels = new_channels;
+	opt_channels[opt_nr_channels] = strdup(name);
+	if (!opt_channels[opt_nr_channels]) {
+		PERROR("strdup channel");
+		return -1;
+	}
+	opt_nr_channels++;
+	return 0;
+}
+
 /*
  * Parse command line arguments.
  *
@@ -270,7 +325,7 @@ static int parse_args(int argc, char **argv)
 		exit(EXIT_FAILURE);
 	}
 
-	while ((opt = getopt_long(argc, argv, "+Vhve:x:", long_options, NULL)) != -1) {
+	while ((opt = getopt_long(argc, argv, "+Vhve:x:j:", long_options, NULL)) != -1) {
 		switch (opt) {
 		case 'V':
 			version(stdout);
@@ -294,6 +349,36 @@ static int parse_args(int argc, char **argv)
 			free(opt_output_path);
 			opt_output_path = strdup(optarg);
 			break;
+		case 'j':
+		{
+			char *endptr;
+
+			errno = 0;
+			opt_jobs = strtoul(optarg, &endptr, 10);
+			if (errno != 0 || !isdigit(optarg[0]) || *endptr != '\0' ||
+					opt_jobs == 0) {
+				ERR("Wrong value in --jobs parameter: %s", optarg);
+				goto error;
+			}
+			break;
+		}
+		case OPT_BEGIN:
+			if (parse_timestamp(optarg, &opt_begin)) {
+				ERR("Wrong value in --begin parameter: %s", optarg);
+				goto error;
+			}
+			break;
+		case OPT_END:
+			if (parse_timestamp(optarg, &opt_end)) {
+				ERR("Wrong value in --end parameter: %s", optarg);
+				goto error;
+			}
+			break;
+		case OPT_CHANNEL:
+			if (add_channel(optarg)) {
+				goto error;
+			}
+			break;
 		case OPT_DUMP_OPTIONS:
 			list_options(stdout);
 			ret = 1;
@@ -308,6 +393,11 @@ static int parse_args(int argc, char **argv)
 		opt_viewer_path = DEFAULT_VIEWER;
 	}
 
+	if (opt_begin > opt_end) {
+		ERR("The --begin timestamp is after the --end one");
+		goto error;
+	}
+
 	/* No leftovers, or more than one input path, print usage and quit */
 	if (argc - optind != 1) {
 		ERR("Command-line error: Specify exactly one input path");
@@ -631,16 +721,199 @@ uint64_t subbuffer_id_get_index(uint32_t mode, uint64_t id,
 		return id;
 }
 
+/*
+ * Packets of a buffer file queued to be written to the output file, straight
+ * from the mapping of the buffer file.
+ */
+struct packet_batch {
+	int fd;
+	int count;
+	struct iovec iov[PACKET_BATCH_LEN];
+	/* Output file offset of the next queued packet. */
+	uint64_t file_offset;
+	/* Output directory and file name, for the index. */
+	char *output_path;
+	char *name;
+	/* Index of the output file, NULL until a packet is indexed. */
+	struct lttng_index_file *index_file;
+};
+
+static
+int flush_packet_batch(struct packet_batch *batch)
+{
+	struct iovec *iov = batch->iov;
+	int count = batch->count;
+
+	while (count) {
+		ssize_t writelen;
+
+		writelen = writev(batch->fd, iov, count);
+		if (writelen < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			PERROR("Error writing to output file");
+			return -1;
+		}
+		/* Skip what was written, on a partial write. */
+		while (count && writelen >= iov->iov_len) {
+			writelen -= iov->iov_len;
+			iov++;
+			count--;
+		}
+		if (count) {
+			iov->iov_base = (char *) iov->iov_base + writelen;
+			iov->iov_len -= writelen;
+		}
+	}
+	batch->count = 0;
+	return 0;
+}
+
+static
+int queue_packet(struct packet_batch *batch, char *packet, uint64_t len)
+{
+	if (batch->count == PACKET_BATCH_LEN && flush_packet_batch(batch)) {
+		return -1;
+	}
+	batch->iov[batch->count].iov_base = packet;
+	batch->iov[batch->count].iov_len = len;
+	batch->count++;
+	batch->file_offset += len;
+	return 0;
+}
+
+/*
+ * Packet header and context of the lttng-ust ring buffer clients, up to
+ * packet_seq_num, which is followed by the events_discarded unsigned long of
+ * the application. The crash ABI only describes the content_size and
+ * packet_size fields, so the other fields are only read when content_size is
+ * where this layout puts it.
+ */
+struct ust_packet_header {
+	uint32_t magic;
+	uint8_t uuid[16];
+	uint32_t stream_id;
+	uint64_t stream_instance_id;
+	struct {
+		uint64_t timestamp_begin;
+		uint64_t timestamp_end;
+		uint64_t content_size;
+		uint64_t packet_size;
+		uint64_t packet_seq_num;
+	} __attribute__((packed)) ctx;
+} __attribute__((packed));
+
+#define ust_packet_get_field(layout, packet, name)			\
+	_crash_get_field(layout,					\
+		(packet) + offsetof(struct ust_packet_header, name),	\
+		member_sizeof(struct ust_packet_header, name))
+
+static
+bool has_ust_packet_header(const struct lttng_crash_layout *layout)
+{
+	return layout->length.content_size ==
+			member_sizeof(struct ust_packet_header, ctx.content_size) &&
+		layout->offset.content_size ==
+			offsetof(struct ust_packet_header, ctx.content_size);
+}
+
+/*
+ * Check whether a packet overlaps the time range to extract. The end
+ * timestamp is only written when a packet is complete; a partial packet is
+ * considered to extend to the end of the trace.
+ */
+static
+bool packet_in_time_range(const struct lttng_crash_layout *layout,
+		const char *packet, bool complete)
+{
+	uint64_t timestamp_begin, timestamp_end = UINT64_MAX;
+
+	if (opt_begin == 0 && opt_end == UINT64_MAX) {
+		return true;
+	}
+	if (!has_ust_packet_header(layout)) {
+		/* No timestamps to compare; keep the packet. */
+		return true;
+	}
+	timestamp_begin = ust_packet_get_field(layout, packet,
+		ctx.timestamp_begin);
+	if (complete) {
+		timestamp_end = ust_packet_get_field(layout, packet,
+			ctx.timestamp_end);
+	}
+	return timestamp_begin <= opt_end && timestamp_end >= opt_begin;
+}
+
+/*
+ * Append the index entry of a packet queued at "file_offset" of the output
+ * file, creating the index file with the first entry. Sizes are in bytes.
+ *
+ * The end timestamp of a partial packet is not written yet; its entry ends
+ * where it begins.
+ */
+static
+int index_packet(const struct lttng_crash_layout *layout,
+		struct packet_batch *batch, const char *packet, bool complete,
+		uint64_t file_offset, uint64_t packet_size,
+		uint64_t content_size)
+{
+	struct ctf_packet_index index;
+	uint64_t timestamp_begin, timestamp_end;
+
+	if (!batch->index_file) {
+		batch->index_file = lttng_index_file_create(batch->output_path,
+			batch->name, -1, -1, 0, 0, CTF_INDEX_MAJOR,
+			CTF_INDEX_MINOR);
+		if (!batch->index_file) {
+			ERR("Cannot create the index of '%s'", batch->name);
+			return -1;
+		}
+	}
+
+	timestamp_begin = ust_packet_get_field(layout, packet,
+		ctx.timestamp_begin);
+	if (complete) {
+		timestamp_end = ust_packet_get_field(layout, packet,
+			ctx.timestamp_end);
+	} else {
+		timestamp_end = timestamp_begin;
+	}
+
+	index.offset = htobe64(file_offset);
+	index.packet_size = htobe64(packet_size * CHAR_BIT);
+	index.content_size = htobe64(content_size * CHAR_BIT);
+	index.timestamp_begin = htobe64(timestamp_begin);
+	index.timestamp_end = htobe64(timestamp_end);
+	index.events_discarded = htobe64(_crash_get_field(layout,
+		packet + sizeof(struct ust_packet_header),
+		layout->word_size));
+	index.stream_id = htobe64(ust_packet_get_field(layout, packet,
+		stream_id));
+	index.stream_instance_id = htobe64(ust_packet_get_field(layout,
+		packet, stream_instance_id));
+	index.packet_seq_num = htobe64(ust_packet_get_field(layout, packet,
+		ctx.packet_seq_num));
+	/* The crash ABI does not describe the events count of a packet. */
+	index.events_count = htobe64(-1ULL);
+	return lttng_index_file_write(batch->index_file, &index);
+}
+
+/*
+ * Queue the packet of the sub-buffer at "offset" into "batch".
+ *
+ * Return 0 on success, 1 if the packet is out of the time range, -ENODATA if
+ * the sub-buffer holds no data or else a negative value.
+ */
 static
 int copy_crash_subbuf(const struct lttng_crash_layout *layout,
-		int fd_dest, char *buf, uint64_t offset)
+		struct packet_batch *batch, char *buf, uint64_t offset)
 {
 	uint64_t buf_size, subbuf_size, num_subbuf, sbidx, id,
 		sb_bindex, rpages_offset, p_offset, seq_cc,
 		committed, commit_count_mask, consumed_cur,
-		packet_size;
+		packet_size, content_size, file_offset;
 	char *subbuf_ptr;
-	ssize_t writelen;
 
 	/*
 	 * Get the current subbuffer by applying the proper mask to
@@ -710,6 +983,12 @@ int copy_crash_subbuf(const struct lttng_crash_layout *layout,
 		sb_backend_p_offset);
 	subbuf_ptr = buf + p_offset;
 
+	if (!packet_in_time_range(layout, subbuf_ptr,
+			committed == subbuf_size)) {
+		DBG("Packet out of the time range, skipping");
+		return 1;
+	}
+
 	if (committed == subbuf_size) {
 		/*
 		 * Packet header can be used.
@@ -725,13 +1004,20 @@ int copy_crash_subbuf(const struct lttng_crash_layout *layout,
 		} else {
 			packet_size = subbuf_size;
 		}
+		if (layout->length.content_size) {
+			content_size = _crash_get_field(layout,
+				subbuf_ptr + layout->offset.content_size,
+				layout->length.content_size) / CHAR_BIT;
+		} else {
+			content_size = packet_size;
+		}
 	} else {
 		uint64_t patch_size;
 
 		/*
 		 * Find where to patch the sub-buffer header with actual
 		 * readable data len and packet len, derived from seq
-		 * cc. Patch it in our in-memory copy.
+		 * cc. Patch it in our private mapping or copy.
 		 */
 		patch_size = committed * CHAR_BIT;
 		if (layout->reverse_byte_order) {
@@ -746,14 +1032,19 @@ int copy_crash_subbuf(const struct lttng_crash_layout *layout,
 				&patch_size, layout->length.packet_size);
 		}
 		packet_size = committed;
+		content_size = committed;
 	}
 
 	/*
-	 * Copy packet into fd_dest.
+	 * Queue packet for fd_dest.
 	 */
-	writelen = lttng_write(fd_dest, subbuf_ptr, packet_size);
-	if (writelen < packet_size) {
-		PERROR("Error writing to output file");
+	file_offset = batch->file_offset;
+	if (queue_packet(batch, subbuf_ptr, packet_size)) {
+		return -1;
+	}
+	if (batch->output_path && index_packet(layout, batch, subbuf_ptr,
+			committed == subbuf_size, file_offset, packet_size,
+			content_size)) {
 		return -1;
 	}
 	DBG("Copied %" PRIu64 " bytes of data", packet_size);
@@ -763,32 +1054,53 @@ nodata:
 	return -ENODATA;
 }
 
+/*
+ * Copy the packets of a buffer file to "fd_dest", the file "name" of the
+ * directory "output_path", and write its index next to it.
+ */
 static
 int copy_crash_data(const struct lttng_crash_layout *layout, int fd_dest,
-		int fd_src)
+		int fd_src, char *output_path, char *name)
 {
 	char *buf;
-	int ret = 0, has_data = 0;
+	int ret = 0, has_data = 0, mapped = 0;
 	struct stat statbuf;
 	size_t src_file_len;
 	uint64_t prod_offset, consumed_offset;
 	uint64_t offset, subbuf_size;
-	ssize_t readlen;
+	struct packet_batch batch;
 
 	ret = fstat(fd_src, &statbuf);
 	if (ret) {
 		return ret;
 	}
 	src_file_len = layout->mmap_length;
-	buf = zmalloc(src_file_len);
-	if (!buf) {
-		return -1;
-	}
-	readlen = lttng_read(fd_src, buf, src_file_len);
-	if (readlen < 0) {
-		PERROR("Error reading input file");
-		ret = -1;
-		goto end;
+	if ((uint64_t) statbuf.st_size >= src_file_len) {
+		/*
+		 * The packets are written straight from a private mapping,
+		 * in which the headers of the partial packets are patched.
+		 */
+		buf = mmap(NULL, src_file_len, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE, fd_src, 0);
+		if (buf == MAP_FAILED) {
+			PERROR("Mapping file");
+			return -1;
+		}
+		mapped = 1;
+	} else {
+		ssize_t readlen;
+
+		/* A truncated file is read into a zeroed copy. */
+		buf = zmalloc(src_file_len);
+		if (!buf) {
+			return -1;
+		}
+		readlen = lttng_read(fd_src, buf, src_file_len);
+		if (readlen < 0) {
+			PERROR("Error reading input file");
+			ret = -1;
+			goto end;
+		}
 	}
 
 	prod_offset = crash_get_field(layout, buf, prod_offset);
@@ -797,18 +1109,44 @@ int copy_crash_data(const struct lttng_crash_layout *layout, int fd_dest,
 	DBG("consumed_offset: 0x%" PRIx64, consumed_offset);
 	subbuf_size = layout->subbuf_size;
 
+	memset(&batch, 0, sizeof(batch));
+	batch.fd = fd_dest;
+	batch.name = name;
+	/* The fields of the index are only known in the lttng-ust layout. */
+	if (has_ust_packet_header(layout)) {
+		batch.output_path = output_path;
+	}
 	for (offset = consumed_offset; offset < prod_offset;
 			offset += subbuf_size) {
-		ret = copy_crash_subbuf(layout, fd_dest, buf, offset);
+		ret = copy_crash_subbuf(layout, &batch, buf, offset);
 		if (!ret) {
 			has_data = 1;
 		}
+		if (ret > 0) {
+			/* Packet out of the time range. */
+			ret = 0;
+			continue;
+		}
 		if (ret) {
-			goto end;
+			break;
+		}
+	}
+	if (!ret || ret == -ENODATA) {
+		if (flush_packet_batch(&batch)) {
+			ret = -1;
 		}
 	}
+	if (batch.index_file) {
+		lttng_index_file_put(batch.index_file);
+	}
 end:
-	free(buf);
+	if (mapped) {
+		if (munmap(buf, src_file_len)) {
+			PERROR("munmap");
+		}
+	} else {
+		free(buf);
+	}
 	if (ret && ret != -ENODATA) {
 		return ret;
 	}
@@ -820,8 +1158,9 @@ end:
 }
 
 static
-int extract_file(int output_dir_fd, const char *output_file,
-		int input_dir_fd, const char *input_file)
+int extract_file(char *output_path, int output_dir_fd,
+		char *output_file, int input_dir_fd,
+		const char *input_file)
 {
 	int fd_dest, fd_src, ret = 0, closeret;
 	struct lttng_crash_layout layout;
@@ -853,7 +1192,8 @@ int extract_file(int output_dir_fd, const char *output_file,
 		goto close_src;
 	}
 
-	ret = copy_crash_data(&layout, fd_dest, fd_src);
+	ret = copy_crash_data(&layout, fd_dest, fd_src, output_path,
+			output_file);
 	if (ret) {
 		goto close_dest;
 	}
@@ -878,6 +1218,84 @@ end:
 	return ret;
 }
 
+/*
+ * Check whether a buffer file, named "<channel>_<cpu>", belongs to one of the
+ * channels to extract.
+ */
+static
+bool is_selected_channel_file(const char *name)
+{
+	unsigned int i;
+
+	if (!opt_nr_channels) {
+		return true;
+	}
+	for (i = 0; i < opt_nr_channels; i++) {
+		size_t len = strlen(opt_channels[i]);
+		const char *p = name + len;
+
+		if (strncmp(name, opt_channels[i], len) || *p != '_' ||
+				!isdigit(p[1])) {
+			continue;
+		}
+		for (p++; isdigit(*p); p++) {
+		}
+		if (*p == '\0') {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * Files of a trace directory extracted by the extraction threads.
+ */
+struct extract_files {
+	char output_path[PATH_MAX];
+	int input_dir_fd, output_dir_fd;
+	char **names;
+	size_t count;
+	pthread_mutex_t lock;
+	/* Index of the next file to extract. Protected by lock. */
+	size_t next;
+	/* First error, which stops the extraction. Protected by lock. */
+	int ret;
+};
+
+static
+void *extract_files_thread(void *data)
+{
+	struct extract_files *files = data;
+
+	for (;;) {
+		char *name;
+		int ret;
+
+		pthread_mutex_lock(&files->lock);
+		if (files->ret < 0 || files->next == files->count) {
+			pthread_mutex_unlock(&files->lock);
+			break;
+		}
+		name = files->names[files->next++];
+		pthread_mutex_unlock(&files->lock);
+
+		ret = extract_file(files->output_path, files->output_dir_fd,
+			name, files->input_dir_fd, name);
+		if (ret == -ENODATA) {
+			DBG("No data in file '%s', skipping", name);
+		} else if (ret < 0) {
+			pthread_mutex_lock(&files->lock);
+			if (!files->ret) {
+				files->ret = ret;
+			}
+			pthread_mutex_unlock(&files->lock);
+		} else if (ret > 0) {
+			DBG("Skipping file '%s'", name);
+		}
+	}
+	return NULL;
+}
+
 static
 int extract_all_files(const char *output_path,
 		const char *input_path)
@@ -885,6 +1303,11 @@ int extract_all_files(const char *output_path,
 	DIR *input_dir, *output_dir;
 	int input_dir_fd, output_dir_fd, ret = 0, closeret;
 	struct dirent *entry;	/* input */
+	struct extract_files files;
+	pthread_t *threads = NULL;
+	size_t nbmem = 0, i, nr_threads = 0;
+
+	memset(&files, 0, sizeof(files));
 
 	/* Open input directory */
 	input_dir = opendir(input_path);
@@ -914,20 +1337,75 @@ int extract_all_files(const char *output_path,
 		if (!strcmp(entry->d_name, ".")
 				|| !strcmp(entry->d_name, ".."))
 			continue;
-		ret = extract_file(output_dir_fd, entry->d_name,
-			input_dir_fd, entry->d_name);
-		if (ret == -ENODATA) {
-			DBG("No data in file '%s', skipping", entry->d_name);
-			ret = 0;
+		if (!is_selected_channel_file(entry->d_name)) {
+			DBG("Skipping file '%s' of an unselected channel",
+				entry->d_name);
 			continue;
-		} else if (ret < 0) {
+		}
+		if (files.count == nbmem) {
+			char **new_names;
+			size_t new_nbmem = max_t(size_t, nbmem << 1, 16);
+
+			new_names = realloc(files.names,
+				new_nbmem * sizeof(*new_names));
+			if (!new_names) {
+				PERROR("realloc file names");
+				ret = -1;
+				goto end;
+			}
+			files.names = new_names;
+			nbmem = new_nbmem;
+		}
+		files.names[files.count] = strdup(entry->d_name);
+		if (!files.names[files.count]) {
+			PERROR("strdup file name");
+			ret = -1;
+			goto end;
+		}
+		files.count++;
+	}
+
+	files.input_dir_fd = input_dir_fd;
+	files.output_dir_fd = output_dir_fd;
+	strncpy(files.output_path, output_path, sizeof(files.output_path));
+	files.output_path[sizeof(files.output_path) - 1] = '\0';
+	pthread_mutex_init(&files.lock, NULL);
+
+	/* The calling thread extracts files as well. */
+	if (opt_jobs > 1 && files.count > 1) {
+		nr_threads = min_t(size_t, opt_jobs, files.count) - 1;
+		threads = zmalloc(nr_threads * sizeof(*threads));
+		if (!threads) {
+			PERROR("zmalloc extraction threads");
+			nr_threads = 0;
+		}
+	}
+	for (i = 0; i < nr_threads; i++) {
+		ret = pthread_create(&threads[i], NULL, extract_files_thread,
+			&files);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_create");
+			nr_threads = i;
 			break;
-		} else if (ret > 0) {
-			DBG("Skipping file '%s'", entry->d_name);
-			ret = 0;
-			continue;
 		}
 	}
+	extract_files_thread(&files);
+	for (i = 0; i < nr_threads; i++) {
+		ret = pthread_join(threads[i], NULL);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_join");
+		}
+	}
+	pthread_mutex_destroy(&files.lock);
+	ret = files.ret;
+end:
+	for (i = 0; i < files.count; i++) {
+		free(files.names[i]);
+	}
+	free(files.names);
+	free(threads);
 	closeret = closedir(output_dir);
 	if (closeret) {
 		PERROR("closedir");
@@ -24,6 +24,7 @@
 #include "connection.h"
 #include "stream.h"
 #include "viewer-session.h"
+#include "viewer-subscription.h"
 
 bool connection_get(struct relay_connection *conn)
 {
@@ -69,6 +70,8 @@ struct relay_connection *connection_create(struct lttcomm_sock *sock,
 	urcu_ref_init(&conn->ref);
 	conn->type = type;
 	conn->sock = sock;
+	CDS_INIT_LIST_HEAD(&conn->subscriptions);
+	CDS_INIT_LIST_HEAD(&conn->stats_node);
 	lttng_ht_node_init_ulong(&conn->sock_n, (unsigned long) conn->sock->fd);
 end:
 	return conn;
@@ -80,6 +83,7 @@ static void rcu_free_connection(struct rcu_head *head)
 		caa_container_of(head, struct relay_connection, rcu_node);
 
 	lttcomm_destroy_sock(conn->sock);
+	free(conn->recv_ahead.buf);
 	if (conn->viewer_session) {
 		viewer_session_destroy(conn->viewer_session);
 		conn->viewer_session = NULL;
@@ -115,6 +119,12 @@ static void connection_release(struct urcu_ref *ref)
 	if (conn->viewer_session) {
 		viewer_session_close(conn->viewer_session);
 	}
+	viewer_subscriptions_destroy(&conn->subscriptions);
+	if (conn->last_stream) {
+		stream_put(conn->last_stream);
+		conn->last_stream = NULL;
+	}
+	relay_stats_unregister_connection(conn);
 	destroy_connection(conn);
 }
 
@@ -31,6 +31,9 @@
 #include <common/sessiond-comm/sessiond-comm.h>
 
 #include "session.h"
+#include "stats.h"
+
+struct relay_stream;
 
 enum connection_type {
 	RELAY_CONNECTION_UNKNOWN    = 0,
@@ -49,7 +52,7 @@ enum connection_type {
  * from the live worker thread.
  *
  * The connections between the consumerd/sessiond and the relayd are only
- * handled by the "main" worker thread (as in, the worker thread in main.c).
+ * handled by the worker thread of main.c the connection was dispatched to.
  *
  * This is why there are no back references to connections from the
  * sessions and session list.
@@ -68,6 +71,11 @@ struct relay_connection {
 	 * connection type.
 	 */
 	struct relay_viewer_session *viewer_session;
+	/*
+	 * Sessions a RELAY_VIEWER_NOTIFICATION connection is subscribed to,
+	 * struct viewer_subscription.
+	 */
+	struct cds_list_head subscriptions;
 
 	/*
 	 * Protocol version to use for this connection. Only valid for
@@ -75,6 +83,40 @@ struct relay_connection {
 	 */
 	uint32_t major;
 	uint32_t minor;
+	/*
+	 * Features used on this connection, negotiated with RELAYD_VERSION,
+	 * enum lttcomm_relayd_feature, for the RELAY_CONTROL connection type
+	 * and with LTTNG_VIEWER_CONNECT, enum lttng_viewer_feature, for the
+	 * viewer connection types.
+	 */
+	uint64_t features;
+
+	/*
+	 * Receive-ahead buffer of a RELAY_DATA connection. Holds the bytes
+	 * received from the socket but not processed yet, from "off" to "len".
+	 * Allocated on first use.
+	 */
+	struct {
+		char *buf;
+		size_t off;
+		size_t len;
+		/* Payload size of the last data packet received. */
+		uint32_t last_data_size;
+	} recv_ahead;
+	/*
+	 * Stream of the last data packet received on a RELAY_DATA connection.
+	 * Holds a reference on the stream until the connection receives data
+	 * for another stream, the stream is closed or the connection is
+	 * released.
+	 */
+	struct relay_stream *last_stream;
+
+	/*
+	 * Statistics of a RELAY_DATA connection and node in the list of the
+	 * connections part of the statistics dumps.
+	 */
+	struct relay_stats stats;
+	struct cds_list_head stats_node;
 
 	struct urcu_ref ref;
 
@@ -134,6 +134,11 @@ struct ctf_trace *ctf_trace_get_by_path_or_create(struct relay_session *session,
 	struct lttng_ht_iter iter;
 	struct ctf_trace *trace = NULL;
 
+	/*
+	 * The session lock serializes the lookup and creation of a trace by
+	 * the workers handling the control connections of a session.
+	 */
+	pthread_mutex_lock(&session->lock);
 	rcu_read_lock();
 	lttng_ht_lookup(session->ctf_traces_ht, (void *) path_name, &iter);
 	node = lttng_ht_iter_get_node_str(&iter);
@@ -151,6 +156,7 @@ end:
 		/* Try to create */
 		trace = ctf_trace_create(session, path_name);
 	}
+	pthread_mutex_unlock(&session->lock);
 	return trace;
 }
 
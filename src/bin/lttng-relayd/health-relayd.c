@@ -50,11 +50,16 @@
 
 #include "lttng-relayd.h"
 #include "health-relayd.h"
+#include "stats.h"
 
 /* Global health check unix path */
 static
 char health_unix_sock_path[PATH_MAX];
 
+/* Global statistics unix path */
+static
+char stats_unix_sock_path[PATH_MAX];
+
 int health_quit_pipe[2];
 
 /*
@@ -132,7 +137,7 @@ error:
 static
 int parse_health_env(void)
 {
-	const char *health_path;
+	const char *health_path, *stats_path;
 
 	health_path = lttng_secure_getenv(LTTNG_RELAYD_HEALTH_ENV);
 	if (health_path) {
@@ -141,6 +146,12 @@ int parse_health_env(void)
 		health_unix_sock_path[PATH_MAX - 1] = '\0';
 	}
 
+	stats_path = lttng_secure_getenv(LTTNG_RELAYD_STATS_ENV);
+	if (stats_path) {
+		strncpy(stats_unix_sock_path, stats_path, PATH_MAX);
+		stats_unix_sock_path[PATH_MAX - 1] = '\0';
+	}
+
 	return 0;
 }
 
@@ -201,21 +212,33 @@ int setup_health_path(void)
 	}
 
 	if (is_root) {
-		if (strlen(health_unix_sock_path) != 0) {
-			goto end;
+		if (strlen(health_unix_sock_path) == 0) {
+			snprintf(health_unix_sock_path,
+				sizeof(health_unix_sock_path),
+				DEFAULT_GLOBAL_RELAY_HEALTH_UNIX_SOCK,
+				(int) getpid());
+		}
+		if (strlen(stats_unix_sock_path) == 0) {
+			snprintf(stats_unix_sock_path,
+				sizeof(stats_unix_sock_path),
+				DEFAULT_GLOBAL_RELAY_STATS_UNIX_SOCK,
+				(int) getpid());
 		}
-		snprintf(health_unix_sock_path, sizeof(health_unix_sock_path),
-			DEFAULT_GLOBAL_RELAY_HEALTH_UNIX_SOCK,
-			(int) getpid());
 	} else {
 		/* Set health check Unix path */
-		if (strlen(health_unix_sock_path) != 0) {
-			goto end;
+		if (strlen(health_unix_sock_path) == 0) {
+			snprintf(health_unix_sock_path,
+				sizeof(health_unix_sock_path),
+				DEFAULT_HOME_RELAY_HEALTH_UNIX_SOCK,
+				home_path, (int) getpid());
+		}
+		/* Set statistics Unix path */
+		if (strlen(stats_unix_sock_path) == 0) {
+			snprintf(stats_unix_sock_path,
+				sizeof(stats_unix_sock_path),
+				DEFAULT_HOME_RELAY_STATS_UNIX_SOCK,
+				home_path, (int) getpid());
 		}
-
-		snprintf(health_unix_sock_path, sizeof(health_unix_sock_path),
-			DEFAULT_HOME_RELAY_HEALTH_UNIX_SOCK,
-			home_path, (int) getpid());
 	}
 
 end:
@@ -224,12 +247,87 @@ end:
 	return ret;
 }
 
+/*
+ * Create a unix socket accessible to the tracing group and listen on it.
+ *
+ * Return the socket or else a negative value.
+ */
+static int create_client_sock(const char *path)
+{
+	int sock, ret;
+
+	sock = lttcomm_create_unix_sock(path);
+	if (sock < 0) {
+		ERR("Unable to create Unix socket %s", path);
+		goto error;
+	}
+
+	if (!getuid()) {
+		ret = chown(path, 0, utils_get_group_id(tracing_group_name));
+		if (ret < 0) {
+			ERR("Unable to set group on %s", path);
+			PERROR("chown");
+			goto error_close;
+		}
+
+		ret = chmod(path, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+		if (ret < 0) {
+			ERR("Unable to set permissions on %s", path);
+			PERROR("chmod");
+			goto error_close;
+		}
+	}
+
+	/*
+	 * Set the CLOEXEC flag. Return code is useless because either way, the
+	 * show must go on.
+	 */
+	(void) utils_set_fd_cloexec(sock);
+
+	ret = lttcomm_listen_unix_sock(sock);
+	if (ret < 0) {
+		goto error_close;
+	}
+	return sock;
+
+error_close:
+	ret = close(sock);
+	if (ret) {
+		PERROR("close");
+	}
+error:
+	return -1;
+}
+
+/*
+ * Send the statistics to a client of the statistics socket.
+ */
+static void handle_stats_client(int sock)
+{
+	int ret, new_sock;
+
+	new_sock = lttcomm_accept_unix_sock(sock);
+	if (new_sock < 0) {
+		return;
+	}
+	(void) utils_set_fd_cloexec(new_sock);
+
+	if (relay_stats_dump(new_sock)) {
+		DBG("Failed to send statistics to client");
+	}
+
+	ret = close(new_sock);
+	if (ret) {
+		PERROR("close");
+	}
+}
+
 /*
  * Thread managing health check socket.
  */
 void *thread_manage_health(void *data)
 {
-	int sock = -1, new_sock = -1, ret, i, pollfd, err = -1;
+	int sock = -1, stats_sock = -1, new_sock = -1, ret, i, pollfd, err = -1;
 	uint32_t revents, nb_fd;
 	struct lttng_poll_event events;
 	struct health_comm_msg msg;
@@ -286,8 +384,14 @@ void *thread_manage_health(void *data)
 		goto error;
 	}
 
+	/* The statistics are optional, the health check is not. */
+	stats_sock = create_client_sock(stats_unix_sock_path);
+	if (stats_sock < 0) {
+		WARN("Relay daemon statistics are not available");
+	}
+
 	/* Size is set to 1 for the consumer_channel pipe */
-	ret = lttng_poll_create(&events, 2, LTTNG_CLOEXEC);
+	ret = lttng_poll_create(&events, 3, LTTNG_CLOEXEC);
 	if (ret < 0) {
 		ERR("Poll set creation failed");
 		goto error;
@@ -304,9 +408,18 @@ void *thread_manage_health(void *data)
 		goto error;
 	}
 
+	if (stats_sock >= 0) {
+		ret = lttng_poll_add(&events, stats_sock, LPOLLIN | LPOLLPRI);
+		if (ret < 0) {
+			goto error;
+		}
+	}
+
 	lttng_relay_notify_ready();
 
 	while (1) {
+		bool health_client = false;
+
 		DBG("Health check ready");
 
 		/* Inifinite blocking call, waiting for transmission */
@@ -344,6 +457,7 @@ restart:
 			/* Event on the registration socket */
 			if (pollfd == sock) {
 				if (revents & LPOLLIN) {
+					health_client = true;
 					continue;
 				} else if (revents & (LPOLLERR | LPOLLHUP | LPOLLRDHUP)) {
 					ERR("Health socket poll error");
@@ -353,6 +467,24 @@ restart:
 					goto error;
 				}
 			}
+
+			/* Event on the statistics socket */
+			if (pollfd == stats_sock) {
+				if (revents & LPOLLIN) {
+					handle_stats_client(stats_sock);
+					continue;
+				} else if (revents & (LPOLLERR | LPOLLHUP | LPOLLRDHUP)) {
+					ERR("Statistics socket poll error");
+					goto error;
+				} else {
+					ERR("Unexpected poll events %u for sock %d", revents, pollfd);
+					goto error;
+				}
+			}
+		}
+
+		if (!health_client) {
+			continue;
 		}
 
 		new_sock = lttcomm_accept_unix_sock(sock);
@@ -383,21 +515,24 @@ restart:
 		assert(msg.cmd == HEALTH_CMD_CHECK);
 
 		memset(&reply, 0, sizeof(reply));
-		for (i = 0; i < NR_HEALTH_RELAYD_TYPES; i++) {
-			/*
-			 * health_check_state return 0 if thread is in
-			 * error.
-			 */
-			if (!health_check_state(health_relayd, i)) {
-				reply.ret_code |= 1ULL << i;
-			}
-		}
+		/* Bit i is set if the threads of type i are in bad health. */
+		reply.ret_code = health_check_all(health_relayd);
 
 		DBG2("Health check return value %" PRIx64, reply.ret_code);
 
 		ret = send_unix_sock(new_sock, (void *) &reply, sizeof(reply));
 		if (ret < 0) {
 			ERR("Failed to send health data back to client");
+		} else {
+			struct health_comm_stats *stats;
+			ssize_t stats_len;
+
+			stats_len = health_create_stats(health_relayd, &stats);
+			if (stats_len > 0) {
+				/* Older clients close without reading them. */
+				(void) send_unix_sock(new_sock, stats, stats_len);
+				free(stats);
+			}
 		}
 
 		/* End of transmission */
@@ -422,6 +557,13 @@ exit:
 			PERROR("close");
 		}
 	}
+	if (stats_sock >= 0) {
+		unlink(stats_unix_sock_path);
+		ret = close(stats_sock);
+		if (ret) {
+			PERROR("close");
+		}
+	}
 
 	/*
 	 * We do NOT rmdir rundir nor the relayd path because there are
@@ -23,6 +23,7 @@
 #include <lttng/health-internal.h>
 
 #define LTTNG_RELAYD_HEALTH_ENV		"LTTNG_RELAYD_HEALTH"
+#define LTTNG_RELAYD_STATS_ENV		"LTTNG_RELAYD_STATS"
 
 enum health_type_relayd {
 	HEALTH_RELAYD_TYPE_DISPATCHER		= 0,
@@ -31,6 +32,7 @@ enum health_type_relayd {
 	HEALTH_RELAYD_TYPE_LIVE_DISPATCHER	= 3,
 	HEALTH_RELAYD_TYPE_LIVE_WORKER		= 4,
 	HEALTH_RELAYD_TYPE_LIVE_LISTENER	= 5,
+	HEALTH_RELAYD_TYPE_TRACEFILE_MANAGER	= 6,
 
 	NR_HEALTH_RELAYD_TYPES,
 };
@@ -21,11 +21,19 @@
 #include <assert.h>
 
 #include <common/common.h>
+#include <common/time.h>
 #include <common/utils.h>
 
+#include "ctf-trace.h"
+#include "live.h"
 #include "lttng-relayd.h"
+#include "session.h"
 #include "stream.h"
 #include "index.h"
+#include "utils.h"
+
+/* Maximum time an index waits in the batch of its stream. */
+#define RELAY_INDEX_BATCH_DELAY_NS	(100 * NSEC_PER_MSEC)
 
 /*
  * Allocate a new relay index object. Pass the stream in which it is
@@ -64,6 +72,48 @@ end:
 	return index;
 }
 
+/*
+ * Take the slot of a new relay index in the given stream. Same as
+ * relay_index_create(), without allocation.
+ *
+ * Called with stream mutex held.
+ * Return the index or else NULL if its slot is busy.
+ */
+static struct relay_index *relay_index_take_slot(struct relay_stream *stream,
+		uint64_t net_seq_num)
+{
+	struct relay_index *index;
+
+	if (!stream->index_slots) {
+		stream->index_slots = zmalloc(RELAY_INDEX_SLOTS *
+				sizeof(*stream->index_slots));
+		if (!stream->index_slots) {
+			PERROR("zmalloc index slots");
+			return NULL;
+		}
+	}
+	index = &stream->index_slots[net_seq_num % RELAY_INDEX_SLOTS];
+	if (index->in_slot) {
+		return NULL;
+	}
+	if (!stream_get(stream)) {
+		ERR("Cannot get stream");
+		return NULL;
+	}
+
+	DBG2("Taking relay index slot for stream id %" PRIu64 " and seqnum %" PRIu64,
+			stream->stream_handle, net_seq_num);
+
+	memset(index, 0, sizeof(*index));
+	index->stream = stream;
+	index->in_slot = true;
+	lttng_ht_node_init_u64(&index->index_n, net_seq_num);
+	pthread_mutex_init(&index->lock, NULL);
+	urcu_ref_init(&index->ref);
+	stream->indexes_in_flight++;
+	return index;
+}
+
 /*
  * Add unique relay index to the given hash table. In case of a collision, the
  * already existing object is put in the given _index variable.
@@ -122,13 +172,28 @@ struct relay_index *relay_index_get_by_id_or_create(struct relay_stream *stream,
 			stream->stream_handle, net_seq_num);
 
 	rcu_read_lock();
-	lttng_ht_lookup(stream->indexes_ht, &net_seq_num, &iter);
-	node = lttng_ht_iter_get_node_u64(&iter);
-	if (node) {
-		index = caa_container_of(node, struct relay_index, index_n);
-	} else {
+	if (stream->index_slots) {
+		index = &stream->index_slots[net_seq_num % RELAY_INDEX_SLOTS];
+		if (index->in_slot && index->index_n.key == net_seq_num) {
+			goto end;
+		}
+		index = NULL;
+	}
+	if (stream->indexes_in_ht) {
+		lttng_ht_lookup_fast_u64(stream->indexes_ht, net_seq_num,
+				&iter);
+		node = lttng_ht_iter_get_node_u64(&iter);
+		if (node) {
+			index = caa_container_of(node, struct relay_index,
+					index_n);
+			goto end;
+		}
+	}
+	index = relay_index_take_slot(stream, net_seq_num);
+	if (!index) {
 		struct relay_index *oldindex;
 
+		/* The slot is busy, fall back on the hash table. */
 		index = relay_index_create(stream, net_seq_num);
 		if (!index) {
 			ERR("Cannot create index for stream id %" PRIu64 " and seq_num %" PRIu64,
@@ -145,6 +210,7 @@ struct relay_index *relay_index_get_by_id_or_create(struct relay_stream *stream,
 			}
 		} else {
 			stream->indexes_in_flight++;
+			stream->indexes_in_ht++;
 			index->in_hash_table = true;
 		}
 	}
@@ -228,12 +294,26 @@ static void index_release(struct urcu_ref *ref)
 		ret = lttng_ht_del(stream->indexes_ht, &iter);
 		assert(!ret);
 		stream->indexes_in_flight--;
+		stream->indexes_in_ht--;
+	}
+
+	if (index->in_slot) {
+		/*
+		 * Free the slot before putting the stream reference, which
+		 * may be the last one. The slots are only used with the
+		 * stream lock held, the slot can be reused right away.
+		 */
+		index->in_slot = false;
+		stream->indexes_in_flight--;
+		index->stream = NULL;
+		stream_put(stream);
+		return;
 	}
 
 	stream_put(index->stream);
 	index->stream = NULL;
 
-	call_rcu(&index->rcu_node, index_destroy_rcu);
+	lttng_ht_defer_free(&index->rcu_node, index_destroy_rcu);
 }
 
 /*
@@ -259,9 +339,188 @@ void relay_index_put(struct relay_index *index)
 	rcu_read_unlock();
 }
 
+/*
+ * Copy a published index of a live stream, of sequence number
+ * index_received_seqcount, to the index ring of the stream.
+ *
+ * Stream lock must be held by the caller.
+ */
+static void index_ring_add(struct relay_stream *stream, const char *index,
+		size_t len)
+{
+	struct ctf_packet_index *entry;
+
+	if (!opt_index_ring || !stream->trace->session->live_timer) {
+		return;
+	}
+	if (!stream->index_ring) {
+		stream->index_ring = zmalloc(opt_index_ring *
+				sizeof(*stream->index_ring));
+		if (!stream->index_ring) {
+			PERROR("zmalloc index ring");
+			return;
+		}
+	}
+	entry = &stream->index_ring[stream->index_received_seqcount %
+			opt_index_ring];
+	memset(entry, 0, sizeof(*entry));
+	memcpy(entry, index, min_t(size_t, len, sizeof(*entry)));
+}
+
+/*
+ * Get the published index of sequence number "seq" of a stream from its
+ * index ring.
+ *
+ * Stream lock must be held by the caller.
+ * Return 0 on success or else a negative value if the ring does not hold
+ * it anymore, in which case it has to be read from the index file.
+ */
+int relay_index_ring_read(struct relay_stream *stream, uint64_t seq,
+		struct ctf_packet_index *index)
+{
+	uint64_t received = stream->index_received_seqcount;
+
+	if (!stream->index_ring || seq >= received ||
+			received - seq > opt_index_ring) {
+		return -1;
+	}
+	*index = stream->index_ring[seq % opt_index_ring];
+	return 0;
+}
+
+/*
+ * Write the batched indexes of a stream to their index file with a single
+ * write and account for them in the stream. A failed write drops the batch.
+ * The queued writes of the stream data are completed first so that an index
+ * never points to data not yet written.
+ *
+ * Stream lock must be held by the caller.
+ * Return 0 on success or else a negative value.
+ */
+int relay_index_batch_flush(struct relay_stream *stream)
+{
+	int ret;
+	unsigned int i;
+	size_t len;
+	ssize_t write_ret;
+	uint64_t start_ns;
+	struct relay_index_batch *batch = &stream->index_batch;
+
+	ret = stream_drain_writes(stream);
+	if (!batch->count) {
+		goto end;
+	}
+	if (ret) {
+		goto reset;
+	}
+
+	len = batch->count * batch->index_file->element_len;
+	DBG2("Writing %u batched index(es) for stream ID %" PRIu64 " on fd %d",
+			batch->count, stream->stream_handle,
+			batch->index_file->fd);
+	if (batch->index_file->fd < 0) {
+		ret = -1;
+		goto reset;
+	}
+	start_ns = lttng_monotonic_time_ns();
+	write_ret = lttng_write(batch->index_file->fd, batch->buf, len);
+	if (write_ret < len) {
+		PERROR("writing index file");
+		ret = -1;
+		goto reset;
+	}
+	stream->stats.index_flushes++;
+	stream->stats.index_flush_ns += lttng_monotonic_time_ns() - start_ns;
+	for (i = 0; i < batch->count; i++) {
+		const struct ctf_packet_index *index =
+				(const struct ctf_packet_index *) (batch->buf +
+					i * batch->index_file->element_len);
+
+		lttng_index_file_account(batch->index_file, index);
+		stream->last_index_ts_end = be64toh(index->timestamp_end);
+		index_ring_add(stream, batch->buf +
+				i * batch->index_file->element_len,
+				batch->index_file->element_len);
+		tracefile_array_commit_seq(stream->tfa);
+		stream->index_received_seqcount++;
+	}
+	live_notify_subscribers();
+reset:
+	batch->count = 0;
+	lttng_index_file_put(batch->index_file);
+	batch->index_file = NULL;
+end:
+	return ret;
+}
+
+/*
+ * Flush the batched indexes of a stream and release the batch buffer.
+ *
+ * Called when the stream is released, thus without the stream lock.
+ */
+void relay_index_batch_fini(struct relay_stream *stream)
+{
+	(void) relay_index_batch_flush(stream);
+	free(stream->index_batch.buf);
+	stream->index_batch.buf = NULL;
+}
+
+/*
+ * Add an index to the batch of its stream. The batch is written once it
+ * holds opt_index_batch entries, when its oldest entry is older than
+ * RELAY_INDEX_BATCH_DELAY_NS or when an index of another index file (after
+ * a tracefile rotation) is added.
+ *
+ * Stream lock must be held by the caller.
+ * Return 0 on success or else a negative value.
+ */
+static int relay_index_batch_add(struct relay_stream *stream,
+		struct lttng_index_file *index_file,
+		const struct ctf_packet_index *data)
+{
+	int ret = 0;
+	uint64_t now;
+	struct relay_index_batch *batch = &stream->index_batch;
+
+	if (batch->index_file != index_file) {
+		ret = relay_index_batch_flush(stream);
+		if (ret) {
+			goto end;
+		}
+	}
+	if (!batch->buf) {
+		batch->buf = zmalloc(opt_index_batch * sizeof(*data));
+		if (!batch->buf) {
+			PERROR("zmalloc index batch");
+			ret = -1;
+			goto end;
+		}
+	}
+	if (!batch->index_file) {
+		lttng_index_file_get(index_file);
+		batch->index_file = index_file;
+	}
+
+	now = lttng_monotonic_time_ns();
+	if (!batch->count) {
+		batch->first_ns = now;
+	}
+	memcpy(batch->buf + batch->count * index_file->element_len, data,
+			index_file->element_len);
+	batch->count++;
+
+	if (batch->count >= opt_index_batch ||
+			now - batch->first_ns >= RELAY_INDEX_BATCH_DELAY_NS) {
+		ret = relay_index_batch_flush(stream);
+	}
+end:
+	return ret;
+}
+
 /*
  * Try to flush index to disk. Releases self-reference to index once
- * flush succeeds.
+ * flush succeeds. The index is written with the batch of its stream, see
+ * relay_index_batch_add().
  *
  * Stream lock must be held by the caller.
  * Return 0 on successful flush, a negative value on error, or positive
@@ -287,7 +546,8 @@ int relay_index_try_flush(struct relay_index *index)
 			index->index_n.key, fd);
 	flushed = true;
 	index->flushed = true;
-	ret = lttng_index_file_write(index->index_file, &index->index_data);
+	ret = relay_index_batch_add(index->stream, index->index_file,
+			&index->index_data);
 skip:
 	pthread_mutex_unlock(&index->lock);
 
@@ -306,8 +566,16 @@ void relay_index_close_all(struct relay_stream *stream)
 {
 	struct lttng_ht_iter iter;
 	struct relay_index *index;
+	unsigned int i;
 
 	rcu_read_lock();
+	for (i = 0; stream->index_slots && i < RELAY_INDEX_SLOTS; i++) {
+		index = &stream->index_slots[i];
+		if (index->in_slot) {
+			/* Put self-ref from index. */
+			relay_index_put(index);
+		}
+	}
 	cds_lfht_for_each_entry(stream->indexes_ht->ht, &iter.iter,
 			index, index_n.node) {
 		/* Put self-ref from index. */
@@ -320,8 +588,16 @@ void relay_index_close_partial_fd(struct relay_stream *stream)
 {
 	struct lttng_ht_iter iter;
 	struct relay_index *index;
+	unsigned int i;
 
 	rcu_read_lock();
+	for (i = 0; stream->index_slots && i < RELAY_INDEX_SLOTS; i++) {
+		index = &stream->index_slots[i];
+		if (index->in_slot && index->index_file) {
+			/* Partial index, put self-ref from index. */
+			relay_index_put(index);
+		}
+	}
 	cds_lfht_for_each_entry(stream->indexes_ht->ht, &iter.iter,
 			index, index_n.node) {
 		if (!index->index_file) {
@@ -342,8 +618,16 @@ uint64_t relay_index_find_last(struct relay_stream *stream)
 	struct lttng_ht_iter iter;
 	struct relay_index *index;
 	uint64_t net_seq_num = -1ULL;
+	unsigned int i;
 
 	rcu_read_lock();
+	for (i = 0; stream->index_slots && i < RELAY_INDEX_SLOTS; i++) {
+		index = &stream->index_slots[i];
+		if (index->in_slot && (net_seq_num == -1ULL ||
+				index->index_n.key > net_seq_num)) {
+			net_seq_num = index->index_n.key;
+		}
+	}
 	cds_lfht_for_each_entry(stream->indexes_ht->ht, &iter.iter,
 			index, index_n.node) {
 		if (net_seq_num == -1ULL ||
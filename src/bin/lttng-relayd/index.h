@@ -30,6 +30,27 @@
 
 struct relay_stream;
 
+/*
+ * Number of index slots of a stream. The index of sequence number "seq" is
+ * kept in slot seq % RELAY_INDEX_SLOTS while it is in flight, unless that
+ * slot is busy, in which case it goes in the indexes_ht of the stream.
+ */
+#define RELAY_INDEX_SLOTS	64
+
+/*
+ * Indexes of a stream accepted for writing but not yet written to its index
+ * file. Protected by the stream lock.
+ */
+struct relay_index_batch {
+	/* Index file of the batched entries. Holds a reference. */
+	struct lttng_index_file *index_file;
+	/* Entries of index_file->element_len bytes each. */
+	char *buf;
+	unsigned int count;
+	/* Monotonic time (nsec) at which the first entry was batched. */
+	uint64_t first_ns;
+};
+
 struct relay_index {
 	/*
 	 * index lock nests inside stream lock.
@@ -50,11 +71,13 @@ struct relay_index {
 	bool has_index_data;
 	bool flushed;
 	bool in_hash_table;
+	/* The index is a slot of stream->index_slots. */
+	bool in_slot;
 
 	/*
 	 * Node within indexes_ht that corresponds to this struct
 	 * relay_index. Indexed by net_seq_num, which is unique for this
-	 * index across the stream.
+	 * index across the stream. The key is also set for the slots.
 	 */
 	struct lttng_ht_node_u64 index_n;
 	struct rcu_head rcu_node;	/* For call_rcu teardown. */
@@ -70,6 +93,11 @@ int relay_index_set_data(struct relay_index *index,
                 const struct ctf_packet_index *data);
 int relay_index_try_flush(struct relay_index *index);
 
+int relay_index_batch_flush(struct relay_stream *stream);
+int relay_index_ring_read(struct relay_stream *stream, uint64_t seq,
+		struct ctf_packet_index *index);
+void relay_index_batch_fini(struct relay_stream *stream);
+
 void relay_index_close_all(struct relay_stream *stream);
 void relay_index_close_partial_fd(struct relay_stream *stream);
 uint64_t relay_index_find_last(struct relay_stream *stream);
@@ -29,6 +29,7 @@
 #include <sys/mman.h>
 #include <sys/mount.h>
 #include <sys/resource.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -66,23 +67,52 @@
 #include "ctf-trace.h"
 #include "connection.h"
 #include "viewer-session.h"
+#include "viewer-subscription.h"
+#include "metadata-cache.h"
 
 #define SESSION_BUF_DEFAULT_COUNT	16
 
+/* Features advertised to the viewers asking for them when connecting. */
+#define LIVE_FEATURES	(LTTNG_VIEWER_FEATURE_NEXT_INDEXES | \
+		LTTNG_VIEWER_FEATURE_SUBSCRIBE | \
+		LTTNG_VIEWER_FEATURE_ATTACH_FILTER | \
+		LTTNG_VIEWER_FEATURE_ATTACH_SESSIONS)
+
 static struct lttng_uri *live_uri;
 
 /*
- * This pipe is used to inform the worker thread that a command is queued and
- * ready to be processed.
+ * Worker thread handling the viewer connections handed to it by the
+ * dispatcher. A relay session can only be attached to one viewer session,
+ * itself owned by a single connection, so the state of a viewer session and
+ * of its viewer streams is only used by the worker of its connection.
  */
-static int live_conn_pipe[2] = { -1, -1 };
+struct live_worker {
+	pthread_t thread;
+	/*
+	 * This pipe is used to inform the worker thread that a connection is
+	 * ready to be handled.
+	 */
+	int conn_pipe[2];
+	/*
+	 * This pipe is used to wake the worker thread up when new indexes are
+	 * available for the viewers subscribed to sessions. Set if a wake up
+	 * is pending.
+	 */
+	int notify_pipe[2];
+	int notify_pending;
+};
+
+static struct live_worker *live_workers;
+static unsigned int nr_live_workers;
+static unsigned int nr_live_workers_started;
+/* Set while the notify pipes of the live workers can be written to. */
+static bool live_notify_enabled;
 
 /* Shared between threads */
 static int live_dispatch_thread_exit;
 
 static pthread_t live_listener_thread;
 static pthread_t live_dispatcher_thread;
-static pthread_t live_worker_thread;
 
 /*
  * Relay command queue.
@@ -102,8 +132,23 @@ static pthread_mutex_t last_relay_viewer_session_id_lock =
 static
 void cleanup_relayd_live(void)
 {
+	unsigned int i;
+
 	DBG("Cleaning up");
 
+	if (live_workers) {
+		/* Wait for the relay workers notifying the live workers. */
+		CMM_STORE_SHARED(live_notify_enabled, false);
+		synchronize_rcu();
+		for (i = nr_live_workers_started; i < nr_live_workers; i++) {
+			utils_close_pipe(live_workers[i].conn_pipe);
+		}
+		for (i = 0; i < nr_live_workers; i++) {
+			utils_close_pipe(live_workers[i].notify_pipe);
+		}
+		free(live_workers);
+		live_workers = NULL;
+	}
 	free(live_uri);
 }
 
@@ -153,6 +198,19 @@ ssize_t send_response(struct lttcomm_sock *sock, void *buf, size_t size)
 	return ret;
 }
 
+/*
+ * live_relay_unknown_command: send -1 if received unknown command
+ */
+static
+void live_relay_unknown_command(struct relay_connection *conn)
+{
+	struct lttcomm_relayd_generic_reply reply;
+
+	memset(&reply, 0, sizeof(reply));
+	reply.ret_code = htobe32(LTTNG_ERR_UNK);
+	(void) send_response(conn->sock, &reply, sizeof(reply));
+}
+
 /*
  * Atomically check if new streams got added in one of the sessions attached
  * and reset the flag to 0.
@@ -641,6 +699,7 @@ void *thread_dispatcher(void *data)
 {
 	int err = -1;
 	ssize_t ret;
+	unsigned int next_worker = 0;
 	struct cds_wfcq_node *node;
 	struct relay_connection *conn = NULL;
 
@@ -677,8 +736,8 @@ void *thread_dispatcher(void *data)
 				break;
 			}
 			conn = caa_container_of(node, struct relay_connection, qnode);
-			DBG("Dispatching viewer request waiting on sock %d",
-					conn->sock->fd);
+			DBG("Dispatching viewer request waiting on sock %d to worker %u",
+					conn->sock->fd, next_worker);
 
 			/*
 			 * Inform worker thread of the new request. This
@@ -686,7 +745,9 @@ void *thread_dispatcher(void *data)
 			 * the data will be read at some point in time
 			 * or wait to the end of the world :)
 			 */
-			ret = lttng_write(live_conn_pipe[1], &conn, sizeof(conn));
+			ret = lttng_write(live_workers[next_worker].conn_pipe[1],
+					&conn, sizeof(conn));
+			next_worker = (next_worker + 1) % nr_live_workers;
 			if (ret < 0) {
 				PERROR("write conn pipe");
 				connection_put(conn);
@@ -726,6 +787,7 @@ static
 int viewer_connect(struct relay_connection *conn)
 {
 	int ret;
+	bool send_features;
 	struct lttng_viewer_connect reply, msg;
 
 	conn->version_check_done = 1;
@@ -771,6 +833,12 @@ int viewer_connect(struct relay_connection *conn)
 		goto end;
 	}
 
+	send_features = be64toh(msg.viewer_session_id) ==
+			LTTNG_VIEWER_FEATURES_MAGIC;
+	if (send_features) {
+		reply.minor |= LTTNG_VIEWER_FEATURES_FLAG;
+	}
+
 	reply.major = htobe32(reply.major);
 	reply.minor = htobe32(reply.minor);
 	if (conn->type == RELAY_VIEWER_COMMAND) {
@@ -792,9 +860,23 @@ int viewer_connect(struct relay_connection *conn)
 		goto end;
 	}
 
+	conn->features = 0;
+	if (send_features) {
+		struct lttng_viewer_features features;
+
+		memset(&features, 0, sizeof(features));
+		features.features = htobe64(LIVE_FEATURES);
+		ret = send_response(conn->sock, &features, sizeof(features));
+		if (ret < 0) {
+			goto end;
+		}
+		conn->features = LIVE_FEATURES;
+	}
+
 	health_code_update();
 
-	DBG("Version check done using protocol %u.%u", conn->major, conn->minor);
+	DBG("Version check done using protocol %u.%u with features 0x%" PRIx64,
+			conn->major, conn->minor, conn->features);
 	ret = 0;
 
 end:
@@ -1001,83 +1083,76 @@ error:
 }
 
 /*
- * Send the viewer the list of current sessions.
+ * Attach the viewer session of a connection to a relay session and create
+ * the viewer streams of the session with the seek type.
+ *
+ * On return, "*status" holds the attach status in host byte order and, if
+ * the streams of the session have to be sent to the viewer, "*session" holds
+ * a reference on the session and "*nb_streams" their number.
+ *
+ * Return 0 on success or else a negative value.
  */
 static
-int viewer_attach_session(struct relay_connection *conn)
+int attach_one_session(struct relay_connection *conn, uint64_t session_id,
+		uint32_t seek, uint32_t *status, uint32_t *nb_streams,
+		struct relay_session **session)
 {
-	int send_streams = 0;
-	ssize_t ret;
-	uint32_t nb_streams = 0;
+	int ret;
 	enum lttng_viewer_seek seek_type;
-	struct lttng_viewer_attach_session_request request;
-	struct lttng_viewer_attach_session_response response;
-	struct relay_session *session = NULL;
+	struct relay_session *attach_session;
 	bool closed = false;
 
-	assert(conn);
-
-	health_code_update();
-
-	/* Receive the request from the connected client. */
-	ret = recv_request(conn->sock, &request, sizeof(request));
-	if (ret < 0) {
-		goto error;
-	}
-
-	health_code_update();
-
-	memset(&response, 0, sizeof(response));
+	*session = NULL;
+	*nb_streams = 0;
 
 	if (!conn->viewer_session) {
 		DBG("Client trying to attach before creating a live viewer session");
-		response.status = htobe32(LTTNG_VIEWER_ATTACH_NO_SESSION);
-		goto send_reply;
+		*status = LTTNG_VIEWER_ATTACH_NO_SESSION;
+		ret = 0;
+		goto end;
 	}
 
-	session = session_get_by_id(be64toh(request.session_id));
-	if (!session) {
-		DBG("Relay session %" PRIu64 " not found",
-				be64toh(request.session_id));
-		response.status = htobe32(LTTNG_VIEWER_ATTACH_UNK);
-		goto send_reply;
+	attach_session = session_get_by_id(session_id);
+	if (!attach_session) {
+		DBG("Relay session %" PRIu64 " not found", session_id);
+		*status = LTTNG_VIEWER_ATTACH_UNK;
+		ret = 0;
+		goto end;
 	}
-	DBG("Attach session ID %" PRIu64 " received",
-		be64toh(request.session_id));
+	DBG("Attach session ID %" PRIu64 " received", session_id);
 
-	if (session->live_timer == 0) {
+	if (attach_session->live_timer == 0) {
 		DBG("Not live session");
-		response.status = htobe32(LTTNG_VIEWER_ATTACH_NOT_LIVE);
-		goto send_reply;
+		*status = LTTNG_VIEWER_ATTACH_NOT_LIVE;
+		ret = 0;
+		goto end_put_session;
 	}
 
-	send_streams = 1;
-	ret = viewer_session_attach(conn->viewer_session, session);
+	ret = viewer_session_attach(conn->viewer_session, attach_session);
 	if (ret) {
 		DBG("Already a viewer attached");
-		response.status = htobe32(LTTNG_VIEWER_ATTACH_ALREADY);
-		goto send_reply;
+		*status = LTTNG_VIEWER_ATTACH_ALREADY;
+		ret = 0;
+		goto end_put_session;
 	}
 
-	switch (be32toh(request.seek)) {
+	switch (seek) {
 	case LTTNG_VIEWER_SEEK_BEGINNING:
 	case LTTNG_VIEWER_SEEK_LAST:
-		response.status = htobe32(LTTNG_VIEWER_ATTACH_OK);
-		seek_type = be32toh(request.seek);
+		*status = LTTNG_VIEWER_ATTACH_OK;
+		seek_type = seek;
 		break;
 	default:
 		ERR("Wrong seek parameter");
-		response.status = htobe32(LTTNG_VIEWER_ATTACH_SEEK_ERR);
-		send_streams = 0;
-		goto send_reply;
+		*status = LTTNG_VIEWER_ATTACH_SEEK_ERR;
+		goto end_put_session;
 	}
 
-	ret = make_viewer_streams(session, seek_type, &nb_streams, NULL,
+	ret = make_viewer_streams(attach_session, seek_type, nb_streams, NULL,
 			NULL, &closed);
 	if (ret < 0) {
 		goto end_put_session;
 	}
-	response.streams_count = htobe32(nb_streams);
 
 	/*
 	 * If the session is closed when the viewer is attaching, it
@@ -1086,13 +1161,80 @@ int viewer_attach_session(struct relay_connection *conn)
 	 * streams available.
 	 */
 	if (closed) {
-		send_streams = 0;
-		response.streams_count = 0;
-		response.status = htobe32(LTTNG_VIEWER_NEW_STREAMS_HUP);
-		goto send_reply;
+		*nb_streams = 0;
+		*status = LTTNG_VIEWER_NEW_STREAMS_HUP;
+		goto end_put_session;
 	}
 
-send_reply:
+	*session = attach_session;
+	goto end;
+
+end_put_session:
+	session_put(attach_session);
+end:
+	return ret;
+}
+
+/*
+ * Send the viewer the list of current sessions.
+ */
+static
+int viewer_attach_session(struct lttng_viewer_cmd *recv_hdr,
+		struct relay_connection *conn)
+{
+	ssize_t ret;
+	uint32_t status, nb_streams = 0;
+	struct lttng_viewer_attach_session_request request;
+	struct lttng_viewer_attach_filter filter;
+	struct lttng_viewer_attach_session_response response;
+	struct relay_session *session = NULL;
+
+	assert(conn);
+
+	health_code_update();
+
+	/* Receive the request from the connected client. */
+	ret = recv_request(conn->sock, &request, sizeof(request));
+	if (ret < 0) {
+		goto error;
+	}
+	memset(&filter, 0, sizeof(filter));
+	if (be64toh(recv_hdr->data_size) == sizeof(request) + sizeof(filter)) {
+		if (!(conn->features & LTTNG_VIEWER_FEATURE_ATTACH_FILTER)) {
+			ERR("Viewer attach filter not negotiated");
+			live_relay_unknown_command(conn);
+			ret = -1;
+			goto error;
+		}
+		ret = recv_request(conn->sock, &filter, sizeof(filter));
+		if (ret < 0) {
+			goto error;
+		}
+	}
+
+	health_code_update();
+
+	ret = attach_one_session(conn, be64toh(request.session_id),
+			be32toh(request.seek), &status, &nb_streams, &session);
+	if (ret < 0) {
+		goto error;
+	}
+
+	if (status == LTTNG_VIEWER_ATTACH_OK) {
+		conn->viewer_session->filter_window = be64toh(filter.window);
+		conn->viewer_session->filter_sample_interval =
+				be64toh(filter.sample_interval);
+		DBG("Viewer packet filter of session %" PRIu64 ": window %" PRIu64
+				", sample interval %" PRIu64,
+				be64toh(request.session_id),
+				conn->viewer_session->filter_window,
+				conn->viewer_session->filter_sample_interval);
+	}
+
+	memset(&response, 0, sizeof(response));
+	response.status = htobe32(status);
+	response.streams_count = htobe32(nb_streams);
+
 	health_code_update();
 	ret = send_response(conn->sock, &response, sizeof(response));
 	if (ret < 0) {
@@ -1104,7 +1246,7 @@ send_reply:
 	 * Unknown or empty session, just return gracefully, the viewer
 	 * knows what is happening.
 	 */
-	if (!send_streams || !nb_streams) {
+	if (!session || !nb_streams) {
 		ret = 0;
 		goto end_put_session;
 	}
@@ -1124,79 +1266,313 @@ error:
 }
 
 /*
- * Open the index file if needed for the given vstream.
+ * Attach several sessions at once, sending for each of them its attach status
+ * followed by its streams.
  *
- * If an index file is successfully opened, the vstream will set it as its
- * current index file.
- *
- * Return 0 on success, a negative value on error (-ENOENT if not ready yet).
- *
- * Called with rstream lock held.
+ * Return 0 on success or else a negative value.
  */
-static int try_open_index(struct relay_viewer_stream *vstream,
-		struct relay_stream *rstream)
+static
+int viewer_attach_sessions(struct lttng_viewer_cmd *recv_hdr,
+		struct relay_connection *conn)
 {
-	int ret = 0;
+	int ret;
+	uint32_t i, nb_sessions;
+	uint64_t *session_ids = NULL;
+	size_t session_ids_len;
+	struct lttng_viewer_attach_sessions_request request;
+	struct lttng_viewer_attach_sessions_response response;
 
-	if (vstream->index_file) {
+	assert(conn);
+
+	DBG("Viewer attach sessions received");
+
+	health_code_update();
+
+	ret = recv_request(conn->sock, &request, sizeof(request));
+	if (ret < 0) {
+		goto end;
+	}
+	nb_sessions = be32toh(request.sessions_count);
+	session_ids_len = nb_sessions * sizeof(*session_ids);
+	if (nb_sessions > LTTNG_VIEWER_ATTACH_SESSIONS_MAX ||
+			be64toh(recv_hdr->data_size) !=
+				sizeof(request) + session_ids_len) {
+		ERR("Viewer requested to attach %" PRIu32 " sessions",
+				nb_sessions);
+		ret = -1;
 		goto end;
 	}
+	if (nb_sessions) {
+		session_ids = zmalloc(session_ids_len);
+		if (!session_ids) {
+			PERROR("zmalloc attach sessions ids");
+			ret = -1;
+			goto end;
+		}
+		ret = recv_request(conn->sock, session_ids, session_ids_len);
+		if (ret < 0) {
+			goto end;
+		}
+	}
+	health_code_update();
 
-	/*
-	 * First time, we open the index file and at least one index is ready.
-	 */
-	if (rstream->index_received_seqcount == 0) {
-		ret = -ENOENT;
+	memset(&response, 0, sizeof(response));
+	response.sessions_count = htobe32(nb_sessions);
+	ret = send_response(conn->sock, &response, sizeof(response));
+	if (ret < 0) {
 		goto end;
 	}
-	vstream->index_file = lttng_index_file_open(vstream->path_name,
-			vstream->channel_name,
-			vstream->stream->tracefile_count,
-			vstream->current_tracefile_id);
-	if (!vstream->index_file) {
-		ret = -1;
+
+	for (i = 0; i < nb_sessions; i++) {
+		struct lttng_viewer_attached_session attached;
+		struct relay_session *session;
+		uint32_t status, nb_streams;
+
+		health_code_update();
+
+		ret = attach_one_session(conn, be64toh(session_ids[i]),
+				be32toh(request.seek), &status, &nb_streams,
+				&session);
+		if (ret < 0) {
+			goto end;
+		}
+
+		memset(&attached, 0, sizeof(attached));
+		attached.session_id = session_ids[i];
+		attached.status = htobe32(status);
+		attached.streams_count = htobe32(nb_streams);
+		ret = send_response(conn->sock, &attached, sizeof(attached));
+		if (ret < 0 || !session || !nb_streams) {
+			goto next;
+		}
+		ret = send_viewer_streams(conn->sock, session, 1);
+next:
+		if (session) {
+			session_put(session);
+		}
+		if (ret < 0) {
+			goto end;
+		}
 	}
+	ret = 0;
 
 end:
+	free(session_ids);
 	return ret;
 }
 
 /*
- * Check the status of the index for the given stream. This function
- * updates the index structure if needed and can put (close) the vstream
- * in the HUP situation.
- *
- * Return 0 means that we can proceed with the index. A value of 1 means
- * that the index has been updated and is ready to be sent to the
- * client. A negative value indicates an error that can't be handled.
+ * Get the changes of a session attached to a viewer, as
+ * LTTNG_VIEWER_FLAG_* flags, without consuming them.
+ */
+static
+uint32_t get_session_changes(struct relay_session *session)
+{
+	uint32_t flags = 0;
+	struct lttng_ht_iter iter;
+	struct ctf_trace *ctf_trace;
+
+	pthread_mutex_lock(&session->lock);
+	if (session->connection_closed) {
+		flags |= LTTNG_VIEWER_FLAG_SESSION_CLOSED;
+	}
+
+	rcu_read_lock();
+	cds_lfht_for_each_entry(session->ctf_traces_ht->ht, &iter.iter, ctf_trace,
+			node.node) {
+		struct relay_stream *stream;
+
+		health_code_update();
+
+		cds_list_for_each_entry_rcu(stream, &ctf_trace->stream_list,
+				stream_node) {
+			struct relay_viewer_stream *vstream;
+
+			/* stream published is protected by the session lock. */
+			if (!stream->published) {
+				continue;
+			}
+			vstream = viewer_stream_get_by_id(stream->stream_handle);
+			if (!vstream) {
+				flags |= LTTNG_VIEWER_FLAG_NEW_STREAM;
+				continue;
+			}
+			pthread_mutex_lock(&stream->lock);
+			if (!vstream->sent_flag) {
+				flags |= LTTNG_VIEWER_FLAG_NEW_STREAM;
+			} else if (stream->is_metadata &&
+					stream->metadata_received >
+						vstream->metadata_sent) {
+				flags |= LTTNG_VIEWER_FLAG_NEW_METADATA;
+			}
+			pthread_mutex_unlock(&stream->lock);
+			viewer_stream_put(vstream);
+		}
+	}
+	rcu_read_unlock();
+	pthread_mutex_unlock(&session->lock);
+	return flags;
+}
+
+/*
+ * Send the viewer the sessions attached to its viewer session having new
+ * streams or new metadata, or being closed.
  *
- * Called with rstream lock held.
+ * Return 0 on success or else a negative value.
  */
-static int check_index_status(struct relay_viewer_stream *vstream,
-		struct relay_stream *rstream, struct ctf_trace *trace,
-		struct lttng_viewer_index *index)
+static
+int viewer_get_sessions_changes(struct relay_connection *conn)
 {
 	int ret;
+	uint32_t i, nb_changes = 0, alloc_changes = 0;
+	struct relay_session *session;
+	struct lttng_viewer_session_changes *changes = NULL;
+	struct lttng_viewer_sessions_changes_response response;
 
-	if ((trace->session->connection_closed || rstream->closed)
-			&& rstream->index_received_seqcount
-				== vstream->index_sent_seqcount) {
-		/*
-		 * Last index sent and session connection or relay
-		 * stream are closed.
-		 */
-		index->status = htobe32(LTTNG_VIEWER_INDEX_HUP);
-		goto hup;
-	} else if (rstream->beacon_ts_end != -1ULL &&
-			rstream->index_received_seqcount
-				== vstream->index_sent_seqcount) {
-		/*
-		 * We've received a synchronization beacon and the last index
-		 * available has been sent, the index for now is inactive.
-		 *
-		 * In this case, we have received a beacon which allows us to
-		 * inform the client of a time interval during which we can
-		 * guarantee that there are no events to read (and never will
+	assert(conn);
+
+	DBG("Viewer get sessions changes received");
+
+	memset(&response, 0, sizeof(response));
+	if (!conn->viewer_session) {
+		response.status = htobe32(LTTNG_VIEWER_SESSIONS_CHANGES_ERR);
+		goto send_reply;
+	}
+
+	rcu_read_lock();
+	cds_list_for_each_entry_rcu(session,
+			&conn->viewer_session->session_list,
+			viewer_session_node) {
+		uint32_t flags;
+
+		if (!session_get(session)) {
+			continue;
+		}
+		flags = get_session_changes(session);
+		if (flags && nb_changes == alloc_changes) {
+			struct lttng_viewer_session_changes *new_changes;
+			uint32_t new_alloc = max_t(uint32_t, alloc_changes << 1, 16);
+
+			new_changes = realloc(changes,
+					new_alloc * sizeof(*changes));
+			if (!new_changes) {
+				PERROR("realloc sessions changes");
+				session_put(session);
+				rcu_read_unlock();
+				ret = -1;
+				goto end;
+			}
+			changes = new_changes;
+			alloc_changes = new_alloc;
+		}
+		if (flags) {
+			struct lttng_viewer_session_changes *entry =
+					&changes[nb_changes++];
+
+			memset(entry, 0, sizeof(*entry));
+			entry->session_id = htobe64(session->id);
+			entry->flags = htobe32(flags);
+		}
+		session_put(session);
+	}
+	rcu_read_unlock();
+	response.status = htobe32(LTTNG_VIEWER_SESSIONS_CHANGES_OK);
+	response.sessions_count = htobe32(nb_changes);
+
+send_reply:
+	health_code_update();
+	ret = send_response(conn->sock, &response, sizeof(response));
+	if (ret < 0) {
+		goto end;
+	}
+	for (i = 0; i < nb_changes; i++) {
+		ret = send_response(conn->sock, &changes[i], sizeof(changes[i]));
+		if (ret < 0) {
+			goto end;
+		}
+	}
+	health_code_update();
+	ret = 0;
+end:
+	free(changes);
+	return ret;
+}
+
+/*
+ * Open the index file if needed for the given vstream.
+ *
+ * If an index file is successfully opened, the vstream will set it as its
+ * current index file.
+ *
+ * Return 0 on success, a negative value on error (-ENOENT if not ready yet).
+ *
+ * Called with rstream lock held.
+ */
+static int try_open_index(struct relay_viewer_stream *vstream,
+		struct relay_stream *rstream)
+{
+	int ret = 0;
+
+	if (vstream->index_file) {
+		goto end;
+	}
+
+	/*
+	 * First time, we open the index file and at least one index is ready.
+	 */
+	if (rstream->index_received_seqcount == 0) {
+		ret = -ENOENT;
+		goto end;
+	}
+	vstream->index_file_skip = 0;
+	vstream->index_file = lttng_index_file_open(vstream->path_name,
+			vstream->channel_name,
+			vstream->stream->tracefile_count,
+			vstream->current_tracefile_id);
+	if (!vstream->index_file) {
+		ret = -1;
+	}
+
+end:
+	return ret;
+}
+
+/*
+ * Check the status of the index for the given stream. This function
+ * updates the index structure if needed and can put (close) the vstream
+ * in the HUP situation.
+ *
+ * Return 0 means that we can proceed with the index. A value of 1 means
+ * that the index has been updated and is ready to be sent to the
+ * client. A negative value indicates an error that can't be handled.
+ *
+ * Called with rstream lock held.
+ */
+static int check_index_status(struct relay_viewer_stream *vstream,
+		struct relay_stream *rstream, struct ctf_trace *trace,
+		struct lttng_viewer_index *index)
+{
+	int ret;
+
+	if ((trace->session->connection_closed || rstream->closed)
+			&& rstream->index_received_seqcount
+				== vstream->index_sent_seqcount) {
+		/*
+		 * Last index sent and session connection or relay
+		 * stream are closed.
+		 */
+		index->status = htobe32(LTTNG_VIEWER_INDEX_HUP);
+		goto hup;
+	} else if (rstream->beacon_ts_end != -1ULL &&
+			rstream->index_received_seqcount
+				== vstream->index_sent_seqcount) {
+		/*
+		 * We've received a synchronization beacon and the last index
+		 * available has been sent, the index for now is inactive.
+		 *
+		 * In this case, we have received a beacon which allows us to
+		 * inform the client of a time interval during which we can
+		 * guarantee that there are no events to read (and never will
 		 * be).
 		 */
 		index->status = htobe32(LTTNG_VIEWER_INDEX_INACTIVE);
@@ -1268,46 +1644,97 @@ index_ready:
 }
 
 /*
- * Send the next index for a stream.
+ * Read the next index of a viewer stream from the index ring of its stream
+ * if it still holds it, or else from its index file.
  *
+ * Called with rstream lock held.
  * Return 0 on success or else a negative value.
  */
-static
-int viewer_get_next_index(struct relay_connection *conn)
+static int read_next_index(struct relay_viewer_stream *vstream,
+		struct ctf_packet_index *index)
 {
 	int ret;
-	struct lttng_viewer_get_next_index request_index;
-	struct lttng_viewer_index viewer_index;
-	struct ctf_packet_index packet_index;
-	struct relay_viewer_stream *vstream = NULL;
-	struct relay_stream *rstream = NULL;
-	struct ctf_trace *ctf_trace = NULL;
-	struct relay_viewer_stream *metadata_viewer_stream = NULL;
+	struct lttng_index_file *index_file = vstream->index_file;
 
-	assert(conn);
-
-	DBG("Viewer get next index");
+	if (!relay_index_ring_read(vstream->stream,
+			vstream->index_sent_seqcount, index)) {
+		vstream->index_file_skip++;
+		ret = 0;
+		goto end;
+	}
 
-	memset(&viewer_index, 0, sizeof(viewer_index));
-	health_code_update();
+	/* Catch up with the indexes sent from the ring. */
+	if (vstream->index_file_skip) {
+		off_t lseek_ret;
 
-	ret = recv_request(conn->sock, &request_index, sizeof(request_index));
-	if (ret < 0) {
-		goto end;
+		lseek_ret = lseek(index_file->fd, (off_t)
+				(vstream->index_file_skip * index_file->element_len),
+				SEEK_CUR);
+		if (lseek_ret < 0) {
+			PERROR("lseek index file %d", index_file->fd);
+			ret = -1;
+			goto end;
+		}
+		vstream->index_file_skip = 0;
 	}
-	health_code_update();
+	ret = lttng_index_file_read(index_file, index);
+end:
+	return ret;
+}
 
-	vstream = viewer_stream_get_by_id(be64toh(request_index.stream_id));
-	if (!vstream) {
-		DBG("Client requested index of unknown stream id %" PRIu64,
-				be64toh(request_index.stream_id));
-		viewer_index.status = htobe32(LTTNG_VIEWER_INDEX_ERR);
-		goto send_reply;
+/*
+ * Check whether the packet of an index is filtered out by the attach filter
+ * of the viewer session, updating the sampling state of the viewer stream
+ * otherwise.
+ *
+ * Called with rstream lock held.
+ */
+static bool viewer_index_filtered(struct relay_viewer_session *vsession,
+		struct relay_viewer_stream *vstream,
+		const struct ctf_packet_index *index)
+{
+	uint64_t ts_begin = be64toh(index->timestamp_begin);
+	uint64_t ts_end = be64toh(index->timestamp_end);
+	uint64_t last_ts_end = vstream->stream->last_index_ts_end;
+
+	if (!vsession) {
+		return false;
+	}
+	if (vsession->filter_window && last_ts_end > vsession->filter_window &&
+			ts_end < last_ts_end - vsession->filter_window) {
+		return true;
+	}
+	if (vsession->filter_sample_interval) {
+		if (vstream->last_sampled_ts != -1ULL &&
+				ts_begin >= vstream->last_sampled_ts &&
+				ts_begin - vstream->last_sampled_ts <
+					vsession->filter_sample_interval) {
+			return true;
+		}
+		vstream->last_sampled_ts = ts_begin;
 	}
+	return false;
+}
 
+/*
+ * Get the next index of a viewer stream in "viewer_index", its flags being
+ * left in host byte order. If "packet_fd" is not NULL and an index is
+ * available, a reference on the tracefile holding the packet is returned in
+ * it.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static int get_next_index(struct relay_connection *conn,
+		struct relay_viewer_stream *vstream,
+		struct lttng_viewer_index *viewer_index,
+		struct stream_fd **packet_fd)
+{
+	int ret;
+	struct ctf_packet_index packet_index;
 	/* Use back. ref. Protected by refcounts. */
-	rstream = vstream->stream;
-	ctf_trace = rstream->trace;
+	struct relay_stream *rstream = vstream->stream;
+	struct ctf_trace *ctf_trace = rstream->trace;
+	struct relay_viewer_stream *metadata_viewer_stream;
 
 	/* metadata_viewer_stream may be NULL. */
 	metadata_viewer_stream =
@@ -1319,8 +1746,14 @@ int viewer_get_next_index(struct relay_connection *conn)
 	 * The viewer should not ask for index on metadata stream.
 	 */
 	if (rstream->is_metadata) {
-		viewer_index.status = htobe32(LTTNG_VIEWER_INDEX_HUP);
-		goto send_reply;
+		viewer_index->status = htobe32(LTTNG_VIEWER_INDEX_HUP);
+		goto end_status;
+	}
+
+	/* Make the indexes received so far visible to the viewer. */
+	if (relay_index_batch_flush(rstream)) {
+		ERR("Failed to write the batched indexes of stream %" PRIu64,
+				rstream->stream_handle);
 	}
 
 	/* Try to open an index if one is needed for that stream. */
@@ -1332,23 +1765,23 @@ int viewer_get_next_index(struct relay_connection *conn)
 			 * packet arrives, it might not be ready at the
 			 * beginning of the session
 			 */
-			viewer_index.status = htobe32(LTTNG_VIEWER_INDEX_RETRY);
+			viewer_index->status = htobe32(LTTNG_VIEWER_INDEX_RETRY);
 		} else {
 			/* Unhandled error. */
-			viewer_index.status = htobe32(LTTNG_VIEWER_INDEX_ERR);
+			viewer_index->status = htobe32(LTTNG_VIEWER_INDEX_ERR);
 		}
-		goto send_reply;
+		goto end_status;
 	}
 
-	ret = check_index_status(vstream, rstream, ctf_trace, &viewer_index);
+	ret = check_index_status(vstream, rstream, ctf_trace, viewer_index);
 	if (ret < 0) {
-		goto error_put;
+		goto end_unlock;
 	} else if (ret == 1) {
 		/*
 		 * We have no index to send and check_index_status has populated
 		 * viewer_index's status.
 		 */
-		goto send_reply;
+		goto end_status;
 	}
 	/* At this point, ret is 0 thus we will be able to read the index. */
 	assert(!ret);
@@ -1374,40 +1807,62 @@ int viewer_get_next_index(struct relay_connection *conn)
 					vstream->channel_name);
 		}
 		if (ret < 0) {
-			goto error_put;
+			goto end_unlock;
 		}
 		ret = open(fullpath, O_RDONLY);
 		if (ret < 0) {
 			PERROR("Relay opening trace file");
-			goto error_put;
+			goto end_unlock;
 		}
 		vstream->stream_fd = stream_fd_create(ret);
 		if (!vstream->stream_fd) {
 			if (close(ret)) {
 				PERROR("close");
 			}
-			goto error_put;
+			ret = -1;
+			goto end_unlock;
 		}
 	}
 
 	ret = check_new_streams(conn);
 	if (ret < 0) {
-		viewer_index.status = htobe32(LTTNG_VIEWER_INDEX_ERR);
-		goto send_reply;
+		viewer_index->status = htobe32(LTTNG_VIEWER_INDEX_ERR);
+		goto end_status;
 	} else if (ret == 1) {
-		viewer_index.flags |= LTTNG_VIEWER_FLAG_NEW_STREAM;
+		viewer_index->flags |= LTTNG_VIEWER_FLAG_NEW_STREAM;
 	}
 
-	ret = lttng_index_file_read(vstream->index_file, &packet_index);
-	if (ret) {
-		ERR("Relay error reading index file %d",
-				vstream->index_file->fd);
-		viewer_index.status = htobe32(LTTNG_VIEWER_INDEX_ERR);
-		goto send_reply;
-	} else {
-		viewer_index.status = htobe32(LTTNG_VIEWER_INDEX_OK);
+	for (;;) {
+		ret = read_next_index(vstream, &packet_index);
+		if (ret) {
+			ERR("Relay error reading index file %d",
+					vstream->index_file->fd);
+			viewer_index->status = htobe32(LTTNG_VIEWER_INDEX_ERR);
+			goto end_status;
+		}
 		vstream->index_sent_seqcount++;
+		if (!viewer_index_filtered(conn->viewer_session, vstream,
+				&packet_index)) {
+			break;
+		}
+		/*
+		 * Skip the packet, and report the range skipped once no index
+		 * can be read without a rotation.
+		 */
+		if (vstream->index_sent_seqcount ==
+					rstream->index_received_seqcount ||
+				!tracefile_array_seq_in_file(rstream->tfa,
+					vstream->current_tracefile_id,
+					vstream->index_sent_seqcount)) {
+			viewer_index->status =
+					htobe32(LTTNG_VIEWER_INDEX_INACTIVE);
+			viewer_index->timestamp_end =
+					packet_index.timestamp_end;
+			viewer_index->stream_id = packet_index.stream_id;
+			goto end_status;
+		}
 	}
+	viewer_index->status = htobe32(LTTNG_VIEWER_INDEX_OK);
 
 	/*
 	 * Indexes are stored in big endian, no need to switch before sending.
@@ -1415,33 +1870,83 @@ int viewer_get_next_index(struct relay_connection *conn)
 	DBG("Sending viewer index for stream %" PRIu64 " offset %" PRIu64,
 		rstream->stream_handle,
 		be64toh(packet_index.offset));
-	viewer_index.offset = packet_index.offset;
-	viewer_index.packet_size = packet_index.packet_size;
-	viewer_index.content_size = packet_index.content_size;
-	viewer_index.timestamp_begin = packet_index.timestamp_begin;
-	viewer_index.timestamp_end = packet_index.timestamp_end;
-	viewer_index.events_discarded = packet_index.events_discarded;
-	viewer_index.stream_id = packet_index.stream_id;
+	viewer_index->offset = packet_index.offset;
+	viewer_index->packet_size = packet_index.packet_size;
+	viewer_index->content_size = packet_index.content_size;
+	viewer_index->timestamp_begin = packet_index.timestamp_begin;
+	viewer_index->timestamp_end = packet_index.timestamp_end;
+	viewer_index->events_discarded = packet_index.events_discarded;
+	viewer_index->stream_id = packet_index.stream_id;
 
-send_reply:
-	if (rstream) {
-		pthread_mutex_unlock(&rstream->lock);
+	if (packet_fd) {
+		*packet_fd = vstream->stream_fd;
+		stream_fd_get(*packet_fd);
 	}
 
+end_status:
+	ret = 0;
+end_unlock:
+	pthread_mutex_unlock(&rstream->lock);
+
 	if (metadata_viewer_stream) {
-		pthread_mutex_lock(&metadata_viewer_stream->stream->lock);
-		DBG("get next index metadata check: recv %" PRIu64
-				" sent %" PRIu64,
-			metadata_viewer_stream->stream->metadata_received,
-			metadata_viewer_stream->metadata_sent);
-		if (!metadata_viewer_stream->stream->metadata_received ||
-				metadata_viewer_stream->stream->metadata_received >
-					metadata_viewer_stream->metadata_sent) {
-			viewer_index.flags |= LTTNG_VIEWER_FLAG_NEW_METADATA;
+		if (!ret) {
+			pthread_mutex_lock(&metadata_viewer_stream->stream->lock);
+			DBG("get next index metadata check: recv %" PRIu64
+					" sent %" PRIu64,
+				metadata_viewer_stream->stream->metadata_received,
+				metadata_viewer_stream->metadata_sent);
+			if (!metadata_viewer_stream->stream->metadata_received ||
+					metadata_viewer_stream->stream->metadata_received >
+						metadata_viewer_stream->metadata_sent) {
+				viewer_index->flags |= LTTNG_VIEWER_FLAG_NEW_METADATA;
+			}
+			pthread_mutex_unlock(&metadata_viewer_stream->stream->lock);
 		}
-		pthread_mutex_unlock(&metadata_viewer_stream->stream->lock);
+		viewer_stream_put(metadata_viewer_stream);
 	}
+	return ret;
+}
+
+/*
+ * Send the next index for a stream.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static
+int viewer_get_next_index(struct relay_connection *conn)
+{
+	int ret;
+	struct lttng_viewer_get_next_index request_index;
+	struct lttng_viewer_index viewer_index;
+	struct relay_viewer_stream *vstream = NULL;
 
+	assert(conn);
+
+	DBG("Viewer get next index");
+
+	memset(&viewer_index, 0, sizeof(viewer_index));
+	health_code_update();
+
+	ret = recv_request(conn->sock, &request_index, sizeof(request_index));
+	if (ret < 0) {
+		goto end;
+	}
+	health_code_update();
+
+	vstream = viewer_stream_get_by_id(be64toh(request_index.stream_id));
+	if (!vstream) {
+		DBG("Client requested index of unknown stream id %" PRIu64,
+				be64toh(request_index.stream_id));
+		viewer_index.status = htobe32(LTTNG_VIEWER_INDEX_ERR);
+		goto send_reply;
+	}
+
+	ret = get_next_index(conn, vstream, &viewer_index, NULL);
+	if (ret < 0) {
+		goto end;
+	}
+
+send_reply:
 	viewer_index.flags = htobe32(viewer_index.flags);
 	health_code_update();
 
@@ -1457,20 +1962,129 @@ send_reply:
 				vstream->stream->stream_handle);
 	}
 end:
-	if (metadata_viewer_stream) {
-		viewer_stream_put(metadata_viewer_stream);
-	}
 	if (vstream) {
 		viewer_stream_put(vstream);
 	}
 	return ret;
+}
 
-error_put:
-	pthread_mutex_unlock(&rstream->lock);
-	if (metadata_viewer_stream) {
-		viewer_stream_put(metadata_viewer_stream);
+/*
+ * Set once sendfile() failed to send a packet, in which case the packets
+ * sent by the worker are read and sent from user space.
+ */
+static DEFINE_URCU_TLS(bool, sendfile_unsupported);
+
+/*
+ * Read "len" bytes at "offset" of a tracefile in a newly allocated buffer
+ * returned in "data".
+ *
+ * Return 0 on success or else a negative value.
+ */
+static int read_packet(int fd, off_t offset, size_t len, char **data)
+{
+	int ret = 0;
+	size_t done = 0;
+	char *buf;
+
+	buf = zmalloc(len);
+	if (!buf) {
+		PERROR("relay data zmalloc");
+		ret = -1;
+		goto end;
 	}
-	viewer_stream_put(vstream);
+	while (done < len) {
+		ssize_t read_len;
+
+		read_len = pread(fd, buf + done, len - done, offset + done);
+		if (read_len < 0 && errno == EINTR) {
+			continue;
+		} else if (read_len <= 0) {
+			PERROR("Relay reading trace file, fd: %d, offset: %jd",
+					fd, (intmax_t) offset);
+			free(buf);
+			ret = -1;
+			goto end;
+		}
+		done += read_len;
+	}
+	*data = buf;
+end:
+	return ret;
+}
+
+/*
+ * Send "len" bytes at "offset" of a tracefile on a viewer socket without
+ * copying them through user space.
+ *
+ * Return 0 on success, 1 if sendfile() cannot be used and nothing was sent,
+ * or else a negative value.
+ */
+static int sendfile_packet(struct lttcomm_sock *sock, int fd, off_t offset,
+		size_t len)
+{
+	int ret = 0;
+	size_t sent = 0;
+
+	while (sent < len) {
+		ssize_t sent_len;
+
+		sent_len = sendfile(sock->fd, fd, &offset, len - sent);
+		if (sent_len < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (!sent && (errno == EINVAL || errno == ENOSYS)) {
+				DBG("sendfile not supported on fd %d, copying the packets",
+						fd);
+				ret = 1;
+				goto end;
+			}
+			PERROR("sendfile to viewer sock %d", sock->fd);
+			ret = -1;
+			goto end;
+		} else if (sent_len == 0) {
+			ERR("Trace file fd %d truncated at offset %jd", fd,
+					(intmax_t) offset);
+			ret = -1;
+			goto end;
+		}
+		sent += sent_len;
+		health_code_update();
+	}
+end:
+	return ret;
+}
+
+/*
+ * Send "len" bytes at "offset" of a tracefile on a viewer socket, with
+ * sendfile() unless it is known not to work.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static int send_packet(struct lttcomm_sock *sock, int fd, off_t offset,
+		size_t len)
+{
+	int ret;
+	char *data = NULL;
+
+	if (!URCU_TLS(sendfile_unsupported)) {
+		ret = sendfile_packet(sock, fd, offset, len);
+		if (ret <= 0) {
+			goto end;
+		}
+		URCU_TLS(sendfile_unsupported) = true;
+	}
+	ret = read_packet(fd, offset, len, &data);
+	if (ret < 0) {
+		goto end;
+	}
+	ret = send_response(sock, data, len);
+	if (ret < 0) {
+		goto end;
+	}
+	ret = 0;
+end:
+	free(data);
 	return ret;
 }
 
@@ -1485,7 +2099,9 @@ int viewer_get_packet(struct relay_connection *conn)
 	int ret, send_data = 0;
 	char *data = NULL;
 	uint32_t len = 0;
-	ssize_t read_len;
+	off_t offset;
+	struct stat st;
+	struct stream_fd *packet_fd = NULL;
 	struct lttng_viewer_get_packet get_packet_info;
 	struct lttng_viewer_trace_packet reply;
 	struct relay_viewer_stream *vstream = NULL;
@@ -1515,67 +2131,372 @@ int viewer_get_packet(struct relay_connection *conn)
 	pthread_mutex_lock(&vstream->stream->lock);
 
 	len = be32toh(get_packet_info.len);
-	data = zmalloc(len);
-	if (!data) {
-		PERROR("relay data zmalloc");
-		goto error;
+	offset = (off_t) be64toh(get_packet_info.offset);
+
+	if (URCU_TLS(sendfile_unsupported)) {
+		if (read_packet(vstream->stream_fd->fd, offset, len, &data)) {
+			goto error;
+		}
+	} else {
+		/*
+		 * The packet is sent once the stream is unlocked. Make sure it
+		 * is complete and keep the tracefile opened meanwhile: the
+		 * written part of a tracefile is never modified.
+		 */
+		ret = fstat(vstream->stream_fd->fd, &st);
+		if (ret < 0) {
+			PERROR("fstat fd %d", vstream->stream_fd->fd);
+			goto error;
+		}
+		if (st.st_size < offset + (off_t) len) {
+			ERR("Relay reading trace file, fd: %d, offset: %" PRIu64
+					", packet beyond the end of file",
+					vstream->stream_fd->fd,
+					be64toh(get_packet_info.offset));
+			goto error;
+		}
+		packet_fd = vstream->stream_fd;
+		stream_fd_get(packet_fd);
 	}
+	reply.status = htobe32(LTTNG_VIEWER_GET_PACKET_OK);
+	reply.len = htobe32(len);
+	send_data = 1;
+	goto send_reply;
+
+error:
+	reply.status = htobe32(LTTNG_VIEWER_GET_PACKET_ERR);
 
-	ret = lseek(vstream->stream_fd->fd, be64toh(get_packet_info.offset),
-			SEEK_SET);
+send_reply:
+	if (vstream) {
+		pthread_mutex_unlock(&vstream->stream->lock);
+	}
+send_reply_nolock:
+	reply.flags = htobe32(reply.flags);
+
+	health_code_update();
+
+	ret = send_response(conn->sock, &reply, sizeof(reply));
 	if (ret < 0) {
-		PERROR("lseek fd %d to offset %" PRIu64, vstream->stream_fd->fd,
-			be64toh(get_packet_info.offset));
-		goto error;
+		goto end_free;
 	}
-	read_len = lttng_read(vstream->stream_fd->fd, data, len);
-	if (read_len < len) {
-		PERROR("Relay reading trace file, fd: %d, offset: %" PRIu64,
-				vstream->stream_fd->fd,
-				be64toh(get_packet_info.offset));
-		goto error;
+	health_code_update();
+
+	if (send_data) {
+		health_code_update();
+		if (packet_fd) {
+			ret = send_packet(conn->sock, packet_fd->fd, offset,
+					len);
+			if (ret < 0) {
+				goto end_free;
+			}
+		} else {
+			ret = send_response(conn->sock, data, len);
+			if (ret < 0) {
+				goto end_free;
+			}
+		}
+		health_code_update();
+	}
+
+	DBG("Sent %u bytes for stream %" PRIu64, len,
+			be64toh(get_packet_info.stream_id));
+
+end_free:
+	free(data);
+	if (packet_fd) {
+		stream_fd_put(packet_fd);
+	}
+end:
+	if (vstream) {
+		viewer_stream_put(vstream);
+	}
+	return ret;
+}
+
+/* Next index of a stream in the reply to get_next_indexes. */
+struct next_index {
+	struct relay_viewer_stream *vstream;
+	struct lttng_viewer_stream_index reply;
+	/* Tracefile holding the packet sent along the index, if any. */
+	struct stream_fd *packet_fd;
+	uint32_t packet_len;
+};
+
+/*
+ * Add the next index entry of a viewer stream, NULL if the stream is unknown,
+ * to an array of entries, growing it as needed.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static int add_next_index(struct next_index **indexes, uint32_t *nb_indexes,
+		uint32_t *alloc_indexes, uint64_t id,
+		struct relay_viewer_stream *vstream)
+{
+	struct next_index *entry;
+
+	if (*nb_indexes == *alloc_indexes) {
+		struct next_index *new_indexes;
+		uint32_t new_alloc = max_t(uint32_t, *alloc_indexes << 1, 16);
+
+		new_indexes = realloc(*indexes, new_alloc * sizeof(**indexes));
+		if (!new_indexes) {
+			PERROR("realloc next indexes");
+			return -1;
+		}
+		*indexes = new_indexes;
+		*alloc_indexes = new_alloc;
+	}
+	entry = &(*indexes)[(*nb_indexes)++];
+	memset(entry, 0, sizeof(*entry));
+	entry->vstream = vstream;
+	entry->reply.id = htobe64(id);
+	return 0;
+}
+
+/*
+ * Add the next index entries of every viewer stream of a session already
+ * sent to the viewer, except its metadata streams.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static int add_session_next_indexes(struct relay_session *session,
+		struct next_index **indexes, uint32_t *nb_indexes,
+		uint32_t *alloc_indexes)
+{
+	int ret = 0;
+	struct lttng_ht_iter iter;
+	struct relay_viewer_stream *vstream;
+
+	rcu_read_lock();
+	cds_lfht_for_each_entry(viewer_streams_ht->ht, &iter.iter, vstream,
+			stream_n.node) {
+		bool skip;
+
+		health_code_update();
+
+		if (!viewer_stream_get(vstream)) {
+			continue;
+		}
+
+		pthread_mutex_lock(&vstream->stream->lock);
+		skip = vstream->stream->trace->session->id != session->id ||
+				!vstream->sent_flag ||
+				vstream->stream->is_metadata;
+		pthread_mutex_unlock(&vstream->stream->lock);
+		if (skip) {
+			viewer_stream_put(vstream);
+			continue;
+		}
+
+		ret = add_next_index(indexes, nb_indexes, alloc_indexes,
+				vstream->stream->stream_handle, vstream);
+		if (ret < 0) {
+			viewer_stream_put(vstream);
+			goto end;
+		}
+	}
+end:
+	rcu_read_unlock();
+	return ret;
+}
+
+/*
+ * Send the next index of several streams of a session, and along them the
+ * packets they describe within the byte budget of the request.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static
+int viewer_get_next_indexes(struct lttng_viewer_cmd *recv_hdr,
+		struct relay_connection *conn)
+{
+	int ret;
+	uint32_t i, nb_streams, nb_indexes = 0, alloc_indexes = 0;
+	uint64_t budget, *stream_ids = NULL;
+	size_t stream_ids_len;
+	struct lttng_viewer_get_next_indexes request;
+	struct lttng_viewer_next_indexes response;
+	struct relay_session *session = NULL;
+	struct next_index *indexes = NULL;
+
+	assert(conn);
+
+	DBG("Viewer get next indexes");
+
+	health_code_update();
+
+	ret = recv_request(conn->sock, &request, sizeof(request));
+	if (ret < 0) {
+		goto end;
+	}
+	nb_streams = be32toh(request.streams_count);
+	stream_ids_len = nb_streams * sizeof(*stream_ids);
+	if (nb_streams > LTTNG_VIEWER_NEXT_INDEXES_MAX ||
+			be64toh(recv_hdr->data_size) !=
+				sizeof(request) + stream_ids_len) {
+		ERR("Viewer requested the indexes of %" PRIu32 " streams",
+				nb_streams);
+		ret = -1;
+		goto end;
+	}
+	if (nb_streams) {
+		stream_ids = zmalloc(stream_ids_len);
+		if (!stream_ids) {
+			PERROR("zmalloc next indexes stream ids");
+			ret = -1;
+			goto end;
+		}
+		ret = recv_request(conn->sock, stream_ids, stream_ids_len);
+		if (ret < 0) {
+			goto end;
+		}
+	}
+	health_code_update();
+
+	memset(&response, 0, sizeof(response));
+
+	session = session_get_by_id(be64toh(request.session_id));
+	if (!session) {
+		DBG("Relay session %" PRIu64 " not found",
+				be64toh(request.session_id));
+		response.status = htobe32(LTTNG_VIEWER_NEXT_INDEXES_UNK);
+		goto send_reply;
+	}
+
+	if (!viewer_session_is_attached(conn->viewer_session, session)) {
+		response.status = htobe32(LTTNG_VIEWER_NEXT_INDEXES_ERR);
+		goto send_reply;
+	}
+
+	if (nb_streams) {
+		for (i = 0; i < nb_streams; i++) {
+			uint64_t id = be64toh(stream_ids[i]);
+			struct relay_viewer_stream *vstream;
+
+			vstream = viewer_stream_get_by_id(id);
+			if (vstream && vstream->stream->trace->session != session) {
+				viewer_stream_put(vstream);
+				vstream = NULL;
+			}
+			if (!vstream) {
+				DBG("Client requested index of unknown stream id %" PRIu64,
+						id);
+			}
+			ret = add_next_index(&indexes, &nb_indexes,
+					&alloc_indexes, id, vstream);
+			if (ret < 0) {
+				if (vstream) {
+					viewer_stream_put(vstream);
+				}
+				goto end;
+			}
+		}
+	} else {
+		ret = add_session_next_indexes(session, &indexes, &nb_indexes,
+				&alloc_indexes);
+		if (ret < 0) {
+			goto end;
+		}
 	}
-	reply.status = htobe32(LTTNG_VIEWER_GET_PACKET_OK);
-	reply.len = htobe32(len);
-	send_data = 1;
-	goto send_reply;
 
-error:
-	reply.status = htobe32(LTTNG_VIEWER_GET_PACKET_ERR);
+	budget = be64toh(request.packet_budget);
+	for (i = 0; i < nb_indexes; i++) {
+		struct next_index *entry = &indexes[i];
+		struct lttng_viewer_index *index = &entry->reply.index;
+		uint64_t packet_len;
+		struct stat st;
 
-send_reply:
-	if (vstream) {
-		pthread_mutex_unlock(&vstream->stream->lock);
+		health_code_update();
+
+		if (!entry->vstream) {
+			index->status = htobe32(LTTNG_VIEWER_INDEX_ERR);
+			continue;
+		}
+
+		ret = get_next_index(conn, entry->vstream, index,
+				budget ? &entry->packet_fd : NULL);
+		if (ret < 0) {
+			goto end;
+		}
+		if (!entry->packet_fd) {
+			goto next;
+		}
+
+		/*
+		 * Only send the packets fitting in the remaining budget and
+		 * complete in the tracefile. The viewer gets the other ones
+		 * with get_packet.
+		 */
+		packet_len = be64toh(index->packet_size) / CHAR_BIT;
+		if (packet_len > budget || packet_len > UINT32_MAX) {
+			goto put_packet;
+		}
+		ret = fstat(entry->packet_fd->fd, &st);
+		if (ret < 0) {
+			PERROR("fstat fd %d", entry->packet_fd->fd);
+			goto put_packet;
+		}
+		if (st.st_size < (off_t) (be64toh(index->offset) + packet_len)) {
+			goto put_packet;
+		}
+		entry->packet_len = packet_len;
+		budget -= packet_len;
+		index->flags |= LTTNG_VIEWER_FLAG_PACKET_DATA;
+		goto next;
+put_packet:
+		stream_fd_put(entry->packet_fd);
+		entry->packet_fd = NULL;
+next:
+		index->flags = htobe32(index->flags);
 	}
-send_reply_nolock:
-	reply.flags = htobe32(reply.flags);
 
-	health_code_update();
+	response.status = htobe32(LTTNG_VIEWER_NEXT_INDEXES_OK);
+	response.indexes_count = htobe32(nb_indexes);
 
-	ret = send_response(conn->sock, &reply, sizeof(reply));
+send_reply:
+	health_code_update();
+	ret = send_response(conn->sock, &response, sizeof(response));
 	if (ret < 0) {
-		goto end_free;
+		goto end;
 	}
 	health_code_update();
 
-	if (send_data) {
-		health_code_update();
-		ret = send_response(conn->sock, data, len);
+	for (i = 0; i < nb_indexes; i++) {
+		struct next_index *entry = &indexes[i];
+
+		ret = send_response(conn->sock, &entry->reply,
+				sizeof(entry->reply));
 		if (ret < 0) {
-			goto end_free;
+			goto end;
+		}
+		if (entry->packet_fd) {
+			ret = send_packet(conn->sock, entry->packet_fd->fd,
+					be64toh(entry->reply.index.offset),
+					entry->packet_len);
+			if (ret < 0) {
+				goto end;
+			}
 		}
 		health_code_update();
 	}
+	DBG("Sent %" PRIu32 " indexes of session %" PRIu64, nb_indexes,
+			be64toh(request.session_id));
+	ret = 0;
 
-	DBG("Sent %u bytes for stream %" PRIu64, len,
-			be64toh(get_packet_info.stream_id));
-
-end_free:
-	free(data);
 end:
-	if (vstream) {
-		viewer_stream_put(vstream);
+	for (i = 0; i < nb_indexes; i++) {
+		if (indexes[i].packet_fd) {
+			stream_fd_put(indexes[i].packet_fd);
+		}
+		if (indexes[i].vstream) {
+			viewer_stream_put(indexes[i].vstream);
+		}
 	}
+	free(indexes);
+	if (session) {
+		session_put(session);
+	}
+	free(stream_ids);
 	return ret;
 }
 
@@ -1591,9 +2512,11 @@ int viewer_get_metadata(struct relay_connection *conn)
 	ssize_t read_len;
 	uint64_t len = 0;
 	char *data = NULL;
+	char *payload = NULL;
 	struct lttng_viewer_get_metadata request;
 	struct lttng_viewer_metadata_packet reply;
 	struct relay_viewer_stream *vstream = NULL;
+	struct relay_metadata_cache *cache = NULL;
 
 	assert(conn);
 
@@ -1638,6 +2561,13 @@ int viewer_get_metadata(struct relay_connection *conn)
 		goto send_reply;
 	}
 
+	cache = metadata_cache_get(vstream->stream);
+	if (cache) {
+		/* The cache holds everything received. */
+		payload = cache->data + vstream->metadata_sent;
+		goto payload_ready;
+	}
+
 	/* first time, we open the metadata file */
 	if (!vstream->stream_fd) {
 		char fullpath[PATH_MAX];
@@ -1659,9 +2589,14 @@ int viewer_get_metadata(struct relay_connection *conn)
 			}
 			goto error;
 		}
+		/* Skip the metadata already sent from the cache, if any. */
+		if (lseek(vstream->stream_fd->fd, vstream->metadata_sent,
+				SEEK_SET) < 0) {
+			PERROR("Relay seeking metadata file");
+			goto error;
+		}
 	}
 
-	reply.len = htobe64(len);
 	data = zmalloc(len);
 	if (!data) {
 		PERROR("viewer metadata zmalloc");
@@ -1673,7 +2608,11 @@ int viewer_get_metadata(struct relay_connection *conn)
 		PERROR("Relay reading metadata file");
 		goto error;
 	}
-	vstream->metadata_sent += read_len;
+	payload = data;
+
+payload_ready:
+	reply.len = htobe64(len);
+	vstream->metadata_sent += len;
 	if (vstream->metadata_sent == vstream->stream->metadata_received
 			&& vstream->stream->closed) {
 		/* Release ownership for the viewer metadata stream. */
@@ -1686,6 +2625,7 @@ int viewer_get_metadata(struct relay_connection *conn)
 
 error:
 	reply.status = htobe32(LTTNG_VIEWER_METADATA_ERR);
+	len = 0;
 
 send_reply:
 	health_code_update();
@@ -1699,7 +2639,8 @@ send_reply:
 	health_code_update();
 
 	if (len > 0) {
-		ret = send_response(conn->sock, data, len);
+		/* Bytes below the length of the cache are never modified. */
+		ret = send_response(conn->sock, payload, len);
 		if (ret < 0) {
 			goto end_free;
 		}
@@ -1712,6 +2653,7 @@ send_reply:
 
 end_free:
 	free(data);
+	metadata_cache_put(cache);
 end:
 	if (vstream) {
 		viewer_stream_put(vstream);
@@ -1828,16 +2770,179 @@ end:
 }
 
 /*
- * live_relay_unknown_command: send -1 if received unknown command
+ * Notify a subscribed viewer of the streams of its sessions having new
+ * indexes, or having been closed, since they were last notified, as long
+ * as the subscriptions have credits.
+ *
+ * Return 0 on success or else a negative value.
  */
 static
-void live_relay_unknown_command(struct relay_connection *conn)
+int send_notifications(struct relay_connection *conn)
 {
-	struct lttcomm_relayd_generic_reply reply;
+	int ret = 0;
+	struct viewer_subscription *sub;
 
-	memset(&reply, 0, sizeof(reply));
-	reply.ret_code = htobe32(LTTNG_ERR_UNK);
-	(void) send_response(conn->sock, &reply, sizeof(reply));
+	cds_list_for_each_entry(sub, &conn->subscriptions, node) {
+		struct lttng_ht_iter iter;
+		struct relay_viewer_stream *vstream;
+
+		if (!sub->credits) {
+			continue;
+		}
+
+		rcu_read_lock();
+		cds_lfht_for_each_entry(viewer_streams_ht->ht, &iter.iter,
+				vstream, stream_n.node) {
+			struct relay_stream *rstream;
+			struct lttng_viewer_notification notification;
+			bool notify = false;
+
+			health_code_update();
+
+			if (!viewer_stream_get(vstream)) {
+				continue;
+			}
+
+			rstream = vstream->stream;
+			pthread_mutex_lock(&rstream->lock);
+			if (rstream->trace->session == sub->session &&
+					vstream->sent_flag &&
+					!rstream->is_metadata) {
+				uint64_t seqcount = max(vstream->index_sent_seqcount,
+						vstream->index_notified_seqcount);
+
+				if (rstream->index_received_seqcount > seqcount) {
+					vstream->index_notified_seqcount =
+							rstream->index_received_seqcount;
+					notify = true;
+				}
+				if (rstream->closed && !vstream->close_notified) {
+					vstream->close_notified = true;
+					notify = true;
+				}
+			}
+			pthread_mutex_unlock(&rstream->lock);
+
+			if (notify) {
+				memset(&notification, 0, sizeof(notification));
+				notification.session_id = htobe64(sub->session->id);
+				notification.stream_id =
+						htobe64(rstream->stream_handle);
+				notification.type =
+						htobe32(LTTNG_VIEWER_NOTIFICATION_INDEX);
+				ret = send_response(conn->sock, &notification,
+						sizeof(notification));
+				sub->credits--;
+			}
+			viewer_stream_put(vstream);
+			if (ret < 0) {
+				rcu_read_unlock();
+				goto end;
+			}
+			if (!sub->credits) {
+				break;
+			}
+		}
+		rcu_read_unlock();
+	}
+	ret = 0;
+end:
+	return ret;
+}
+
+/*
+ * Subscribe a viewer notification connection to a session, or grant more
+ * credits to an existing subscription. There is no reply, unless the
+ * subscription is refused.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static
+int viewer_subscribe(struct relay_connection *conn)
+{
+	int ret;
+	struct lttng_viewer_subscribe request;
+	struct relay_session *session = NULL;
+
+	DBG("Viewer subscribe received");
+
+	assert(conn);
+
+	health_code_update();
+
+	ret = recv_request(conn->sock, &request, sizeof(request));
+	if (ret < 0) {
+		goto end;
+	}
+	if (conn->type != RELAY_VIEWER_NOTIFICATION) {
+		ERR("Viewer subscribe received on a command connection");
+		ret = -1;
+		goto end;
+	}
+
+	session = session_get_by_id(be64toh(request.session_id));
+	if (session) {
+		bool attached;
+
+		pthread_mutex_lock(&session->lock);
+		attached = session->viewer_attached;
+		pthread_mutex_unlock(&session->lock);
+		if (!attached) {
+			session_put(session);
+			session = NULL;
+		}
+	}
+	if (!session) {
+		struct lttng_viewer_notification notification;
+
+		DBG("Relay session %" PRIu64 " not found or not attached",
+				be64toh(request.session_id));
+		memset(&notification, 0, sizeof(notification));
+		notification.session_id = request.session_id;
+		notification.type = htobe32(LTTNG_VIEWER_NOTIFICATION_ERR);
+		health_code_update();
+		ret = send_response(conn->sock, &notification,
+				sizeof(notification));
+		goto end;
+	}
+
+	ret = viewer_subscription_add(&conn->subscriptions, session,
+			be32toh(request.credits));
+	session_put(session);
+	if (ret < 0) {
+		goto end;
+	}
+
+	/* Notify of the indexes already available. */
+	ret = send_notifications(conn);
+end:
+	return ret;
+}
+
+/*
+ * Return true if the viewer command "cmd" is part of the protocol or of the
+ * features negotiated on the connection.
+ */
+static
+bool viewer_command_negotiated(struct relay_connection *conn, uint32_t cmd)
+{
+	uint64_t feature;
+
+	switch (cmd) {
+	case LTTNG_VIEWER_GET_NEXT_INDEXES:
+		feature = LTTNG_VIEWER_FEATURE_NEXT_INDEXES;
+		break;
+	case LTTNG_VIEWER_SUBSCRIBE:
+		feature = LTTNG_VIEWER_FEATURE_SUBSCRIBE;
+		break;
+	case LTTNG_VIEWER_ATTACH_SESSIONS:
+	case LTTNG_VIEWER_GET_SESSIONS_CHANGES:
+		feature = LTTNG_VIEWER_FEATURE_ATTACH_SESSIONS;
+		break;
+	default:
+		return true;
+	}
+	return conn->features & feature;
 }
 
 /*
@@ -1862,6 +2967,24 @@ int process_control(struct lttng_viewer_cmd *recv_hdr,
 		goto end;
 	}
 
+	/* Notification connections are only used to subscribe to sessions. */
+	if (conn->type == RELAY_VIEWER_NOTIFICATION &&
+			msg_value != LTTNG_VIEWER_CONNECT &&
+			msg_value != LTTNG_VIEWER_SUBSCRIBE) {
+		ERR("Viewer command %" PRIu32 " on a notification connection",
+				msg_value);
+		ret = -1;
+		goto end;
+	}
+
+	/* The extensions are refused unless negotiated. */
+	if (!viewer_command_negotiated(conn, msg_value)) {
+		ERR("Viewer command %" PRIu32 " not negotiated", msg_value);
+		live_relay_unknown_command(conn);
+		ret = -1;
+		goto end;
+	}
+
 	switch (msg_value) {
 	case LTTNG_VIEWER_CONNECT:
 		ret = viewer_connect(conn);
@@ -1870,7 +2993,7 @@ int process_control(struct lttng_viewer_cmd *recv_hdr,
 		ret = viewer_list_sessions(conn);
 		break;
 	case LTTNG_VIEWER_ATTACH_SESSION:
-		ret = viewer_attach_session(conn);
+		ret = viewer_attach_session(recv_hdr, conn);
 		break;
 	case LTTNG_VIEWER_GET_NEXT_INDEX:
 		ret = viewer_get_next_index(conn);
@@ -1890,6 +3013,18 @@ int process_control(struct lttng_viewer_cmd *recv_hdr,
 	case LTTNG_VIEWER_DETACH_SESSION:
 		ret = viewer_detach_session(conn);
 		break;
+	case LTTNG_VIEWER_GET_NEXT_INDEXES:
+		ret = viewer_get_next_indexes(recv_hdr, conn);
+		break;
+	case LTTNG_VIEWER_SUBSCRIBE:
+		ret = viewer_subscribe(conn);
+		break;
+	case LTTNG_VIEWER_ATTACH_SESSIONS:
+		ret = viewer_attach_sessions(recv_hdr, conn);
+		break;
+	case LTTNG_VIEWER_GET_SESSIONS_CHANGES:
+		ret = viewer_get_sessions_changes(conn);
+		break;
 	default:
 		ERR("Received unknown viewer command (%u)",
 				be32toh(recv_hdr->cmd));
@@ -1915,6 +3050,47 @@ void cleanup_connection_pollfd(struct lttng_poll_event *events, int pollfd)
 	}
 }
 
+/*
+ * Send the pending notifications of the subscribed viewer connections of a
+ * live worker, closing the connections failing to receive them.
+ */
+static
+void notify_connections(struct live_worker *worker,
+		struct lttng_poll_event *events,
+		struct lttng_ht *viewer_connections_ht)
+{
+	char buf[64];
+	struct lttng_ht_iter iter;
+	struct relay_connection *conn;
+
+	/*
+	 * Clear the pending wake up before looking at the streams: a relay
+	 * worker publishing indexes from now on wakes this thread up again.
+	 */
+	uatomic_set(&worker->notify_pending, 0);
+	cmm_smp_mb();
+	while (read(worker->notify_pipe[0], buf, sizeof(buf)) > 0) {
+	}
+
+	rcu_read_lock();
+	cds_lfht_for_each_entry(viewer_connections_ht->ht, &iter.iter, conn,
+			sock_n.node) {
+		health_code_update();
+
+		if (conn->type != RELAY_VIEWER_NOTIFICATION ||
+				cds_list_empty(&conn->subscriptions)) {
+			continue;
+		}
+		if (send_notifications(conn) < 0) {
+			cleanup_connection_pollfd(events, conn->sock->fd);
+			/* Put "create" ownership reference. */
+			connection_put(conn);
+			DBG("Viewer notification conn closed");
+		}
+	}
+	rcu_read_unlock();
+}
+
 /*
  * This thread does the actual work
  */
@@ -1928,10 +3104,13 @@ void *thread_worker(void *data)
 	struct lttng_ht_iter iter;
 	struct lttng_viewer_cmd recv_hdr;
 	struct relay_connection *destroy_conn;
+	struct live_worker *worker = data;
 
-	DBG("[thread] Live viewer relay worker started");
+	DBG("[thread] Live viewer relay worker %u started",
+			(unsigned int) (worker - live_workers));
 
 	rcu_register_thread();
+	lttng_ht_thread_batch_start();
 
 	health_register(health_relayd, HEALTH_RELAYD_TYPE_LIVE_WORKER);
 
@@ -1945,12 +3124,17 @@ void *thread_worker(void *data)
 		goto viewer_connections_ht_error;
 	}
 
-	ret = create_thread_poll_set(&events, 2);
+	ret = create_thread_poll_set(&events, 3);
 	if (ret < 0) {
 		goto error_poll_create;
 	}
 
-	ret = lttng_poll_add(&events, live_conn_pipe[0], LPOLLIN | LPOLLRDHUP);
+	ret = lttng_poll_add(&events, worker->conn_pipe[0], LPOLLIN | LPOLLRDHUP);
+	if (ret < 0) {
+		goto error;
+	}
+
+	ret = lttng_poll_add(&events, worker->notify_pipe[0], LPOLLIN);
 	if (ret < 0) {
 		goto error;
 	}
@@ -1961,6 +3145,9 @@ restart:
 
 		health_code_update();
 
+		/* Release the objects freed since the last wait at once. */
+		lttng_ht_thread_batch_flush();
+
 		/* Infinite blocking call, waiting for transmission */
 		DBG3("Relayd live viewer worker thread polling...");
 		health_poll_entry();
@@ -2003,11 +3190,11 @@ restart:
 			}
 
 			/* Inspect the relay conn pipe for new connection. */
-			if (pollfd == live_conn_pipe[0]) {
+			if (pollfd == worker->conn_pipe[0]) {
 				if (revents & LPOLLIN) {
 					struct relay_connection *conn;
 
-					ret = lttng_read(live_conn_pipe[0],
+					ret = lttng_read(worker->conn_pipe[0],
 							&conn, sizeof(conn));
 					if (ret < 0) {
 						goto error;
@@ -2023,6 +3210,14 @@ restart:
 					ERR("Unexpected poll events %u for sock %d", revents, pollfd);
 					goto error;
 				}
+			} else if (pollfd == worker->notify_pipe[0]) {
+				if (revents & LPOLLIN) {
+					notify_connections(worker, &events,
+							viewer_connections_ht);
+				} else {
+					ERR("Relay live notify pipe error");
+					goto error;
+				}
 			} else {
 				/* Connection activity. */
 				struct relay_connection *conn;
@@ -2083,7 +3278,7 @@ error_poll_create:
 	lttng_ht_destroy(viewer_connections_ht);
 viewer_connections_ht_error:
 	/* Close relay conn pipes */
-	utils_close_pipe(live_conn_pipe);
+	utils_close_pipe(worker->conn_pipe);
 	if (err) {
 		DBG("Viewer worker thread exited with error");
 	}
@@ -2097,17 +3292,95 @@ error_testpoint:
 	if (lttng_relay_stop_threads()) {
 		ERR("Error stopping threads");
 	}
+	lttng_ht_thread_batch_stop();
 	rcu_unregister_thread();
 	return NULL;
 }
 
 /*
- * Create the relay command pipe to wake thread_manage_apps.
- * Closed in cleanup().
+ * Allocate the live workers and create their connection pipes. The pipe of a
+ * worker is closed by the worker thread, or in cleanup_relayd_live() if it is
+ * not started.
+ */
+static int create_live_workers(unsigned int nr_workers)
+{
+	int ret = 0;
+	unsigned int i;
+
+	live_workers = zmalloc(nr_workers * sizeof(*live_workers));
+	if (!live_workers) {
+		PERROR("zmalloc live workers");
+		ret = -1;
+		goto end;
+	}
+	nr_live_workers = nr_workers;
+
+	for (i = 0; i < nr_workers; i++) {
+		live_workers[i].conn_pipe[0] = live_workers[i].conn_pipe[1] = -1;
+		live_workers[i].notify_pipe[0] =
+				live_workers[i].notify_pipe[1] = -1;
+	}
+	for (i = 0; i < nr_workers; i++) {
+		ret = utils_create_pipe_cloexec(live_workers[i].conn_pipe);
+		if (ret) {
+			goto end;
+		}
+		ret = utils_create_pipe_cloexec_nonblock(
+				live_workers[i].notify_pipe);
+		if (ret) {
+			goto end;
+		}
+	}
+end:
+	return ret;
+}
+
+/*
+ * Join the started live worker threads.
+ *
+ * Return 0 on success or else a negative value.
  */
-static int create_conn_pipe(void)
+static int join_live_workers(void)
+{
+	int ret, retval = 0;
+	unsigned int i;
+	void *status;
+
+	for (i = 0; i < nr_live_workers_started; i++) {
+		ret = pthread_join(live_workers[i].thread, &status);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_join live worker");
+			retval = -1;
+		}
+	}
+	return retval;
+}
+
+void live_notify_subscribers(void)
 {
-	return utils_create_pipe_cloexec(live_conn_pipe);
+	unsigned int i;
+
+	if (!viewer_subscriptions_active()) {
+		return;
+	}
+
+	rcu_read_lock();
+	if (!CMM_LOAD_SHARED(live_notify_enabled)) {
+		goto end;
+	}
+	for (i = 0; i < nr_live_workers; i++) {
+		struct live_worker *worker = &live_workers[i];
+
+		if (uatomic_cmpxchg(&worker->notify_pending, 0, 1)) {
+			/* Already woken up. */
+			continue;
+		}
+		/* A full pipe already wakes the worker up. */
+		(void) lttng_write(worker->notify_pipe[1], "!", 1);
+	}
+end:
+	rcu_read_unlock();
 }
 
 int relayd_live_join(void)
@@ -2122,10 +3395,7 @@ int relayd_live_join(void)
 		retval = -1;
 	}
 
-	ret = pthread_join(live_worker_thread, &status);
-	if (ret) {
-		errno = ret;
-		PERROR("pthread_join live worker");
+	if (join_live_workers()) {
 		retval = -1;
 	}
 
@@ -2144,9 +3414,10 @@ int relayd_live_join(void)
 /*
  * main
  */
-int relayd_live_create(struct lttng_uri *uri)
+int relayd_live_create(struct lttng_uri *uri, unsigned int nr_workers)
 {
 	int ret = 0, retval = 0;
+	unsigned int i;
 	void *status;
 	int is_root;
 
@@ -2167,11 +3438,12 @@ int relayd_live_create(struct lttng_uri *uri)
 		}
 	}
 
-	/* Setup the thread apps communication pipe. */
-	if (create_conn_pipe()) {
+	/* Setup the worker threads communication pipes. */
+	if (create_live_workers(nr_workers)) {
 		retval = -1;
 		goto exit_init_data;
 	}
+	CMM_STORE_SHARED(live_notify_enabled, true);
 
 	/* Init relay command queue. */
 	cds_wfcq_init(&viewer_conn_queue.head, &viewer_conn_queue.tail);
@@ -2192,15 +3464,22 @@ int relayd_live_create(struct lttng_uri *uri)
 		goto exit_dispatcher_thread;
 	}
 
-	/* Setup the worker thread */
-	ret = pthread_create(&live_worker_thread, default_pthread_attr(),
-			thread_worker, NULL);
-	if (ret) {
-		errno = ret;
-		PERROR("pthread_create viewer worker");
-		retval = -1;
-		goto exit_worker_thread;
+	/* Setup the worker threads */
+	for (i = 0; i < nr_workers; i++) {
+		ret = pthread_create(&live_workers[i].thread,
+				default_pthread_attr(), thread_worker,
+				&live_workers[i]);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_create viewer worker");
+			retval = -1;
+			/* Stop the dispatcher and the workers already started. */
+			(void) lttng_relay_stop_threads();
+			goto exit_worker_thread;
+		}
+		nr_live_workers_started++;
 	}
+	DBG("Started %u live worker thread(s)", nr_workers);
 
 	/* Setup the listener thread */
 	ret = pthread_create(&live_listener_thread, default_pthread_attr(),
@@ -2223,14 +3502,10 @@ int relayd_live_create(struct lttng_uri *uri)
 	 */
 
 exit_listener_thread:
-
-	ret = pthread_join(live_worker_thread, &status);
-	if (ret) {
-		errno = ret;
-		PERROR("pthread_join live worker");
+exit_worker_thread:
+	if (join_live_workers()) {
 		retval = -1;
 	}
-exit_worker_thread:
 
 	ret = pthread_join(live_dispatcher_thread, &status);
 	if (ret) {
@@ -24,9 +24,14 @@
 
 #include "lttng-relayd.h"
 
-int relayd_live_create(struct lttng_uri *live_uri);
+int relayd_live_create(struct lttng_uri *live_uri, unsigned int nr_workers);
 int relayd_live_stop(void);
 int relayd_live_join(void);
+/*
+ * Wake the live workers up to notify the subscribed viewers of the new
+ * indexes and closed streams.
+ */
+void live_notify_subscribers(void);
 
 struct relay_viewer_stream *live_find_viewer_stream_by_id(uint64_t stream_id);
 
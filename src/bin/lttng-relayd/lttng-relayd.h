@@ -45,6 +45,8 @@ extern struct lttng_ht *relay_streams_ht;
 extern struct lttng_ht *viewer_streams_ht;
 
 extern char *opt_output_path;
+extern unsigned int opt_index_batch;
+extern unsigned int opt_index_ring;
 extern const char *tracing_group_name;
 extern const char * const config_section_name;
 
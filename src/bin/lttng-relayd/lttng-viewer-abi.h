@@ -32,12 +32,52 @@
 #define LTTNG_VIEWER_NAME_MAX		255
 #define LTTNG_VIEWER_HOST_NAME_MAX	64
 
+/*
+ * The extensions of the protocol are negotiated as features, see enum
+ * lttng_viewer_feature, apart from the minor version numbers which belong to
+ * the upstream releases. A viewer asking for the features sets the
+ * viewer_session_id of its struct lttng_viewer_connect to
+ * LTTNG_VIEWER_FEATURES_MAGIC, ignored by the relayds unaware of them. Such a
+ * relayd flags the minor version of its reply with LTTNG_VIEWER_FEATURES_FLAG
+ * and follows it with a struct lttng_viewer_features of the features usable
+ * on the connection. The other relayds refuse the extensions.
+ */
+#define LTTNG_VIEWER_FEATURES_MAGIC	0x4c54544e47564945ULL
+#define LTTNG_VIEWER_FEATURES_FLAG	(1U << 31)
+
+/* Optional features of a relayd, see struct lttng_viewer_features. */
+enum lttng_viewer_feature {
+	/* The relayd accepts LTTNG_VIEWER_GET_NEXT_INDEXES. */
+	LTTNG_VIEWER_FEATURE_NEXT_INDEXES	= (1ULL << 0),
+	/* The relayd accepts LTTNG_VIEWER_SUBSCRIBE. */
+	LTTNG_VIEWER_FEATURE_SUBSCRIBE		= (1ULL << 1),
+	/*
+	 * The relayd accepts a struct lttng_viewer_attach_filter following
+	 * the LTTNG_VIEWER_ATTACH_SESSION request.
+	 */
+	LTTNG_VIEWER_FEATURE_ATTACH_FILTER	= (1ULL << 2),
+	/*
+	 * The relayd accepts LTTNG_VIEWER_ATTACH_SESSIONS and
+	 * LTTNG_VIEWER_GET_SESSIONS_CHANGES.
+	 */
+	LTTNG_VIEWER_FEATURE_ATTACH_SESSIONS	= (1ULL << 3),
+};
+
+/* Maximal number of streams of a LTTNG_VIEWER_GET_NEXT_INDEXES request. */
+#define LTTNG_VIEWER_NEXT_INDEXES_MAX	4096
+/* Maximal number of sessions of a LTTNG_VIEWER_ATTACH_SESSIONS request. */
+#define LTTNG_VIEWER_ATTACH_SESSIONS_MAX	4096
+
 /* Flags in reply to get_next_index and get_packet. */
 enum {
 	/* New metadata is required to read this packet. */
 	LTTNG_VIEWER_FLAG_NEW_METADATA	= (1 << 0),
 	/* New stream got added to the trace. */
 	LTTNG_VIEWER_FLAG_NEW_STREAM	= (1 << 1),
+	/* The packet follows the index in the reply to get_next_indexes. */
+	LTTNG_VIEWER_FLAG_PACKET_DATA	= (1 << 2),
+	/* The session is closed, in reply to get_sessions_changes. */
+	LTTNG_VIEWER_FLAG_SESSION_CLOSED	= (1 << 3),
 };
 
 enum lttng_viewer_command {
@@ -50,6 +90,10 @@ enum lttng_viewer_command {
 	LTTNG_VIEWER_GET_NEW_STREAMS	= 7,
 	LTTNG_VIEWER_CREATE_SESSION	= 8,
 	LTTNG_VIEWER_DETACH_SESSION	= 9,
+	LTTNG_VIEWER_GET_NEXT_INDEXES	= 10,
+	LTTNG_VIEWER_SUBSCRIBE		= 11,
+	LTTNG_VIEWER_ATTACH_SESSIONS	= 12,
+	LTTNG_VIEWER_GET_SESSIONS_CHANGES	= 13,
 };
 
 enum lttng_viewer_attach_return_code {
@@ -70,6 +114,17 @@ enum lttng_viewer_next_index_return_code {
 	LTTNG_VIEWER_INDEX_EOF		= 6, /* End of index file. */
 };
 
+enum lttng_viewer_next_indexes_return_code {
+	LTTNG_VIEWER_NEXT_INDEXES_OK	= 1, /* The indexes follow. */
+	LTTNG_VIEWER_NEXT_INDEXES_UNK	= 2, /* The session ID is unknown. */
+	LTTNG_VIEWER_NEXT_INDEXES_ERR	= 3, /* Not attached or error. */
+};
+
+enum lttng_viewer_sessions_changes_return_code {
+	LTTNG_VIEWER_SESSIONS_CHANGES_OK	= 1, /* The changes follow. */
+	LTTNG_VIEWER_SESSIONS_CHANGES_ERR	= 2, /* No viewer session created. */
+};
+
 enum lttng_viewer_get_packet_return_code {
 	LTTNG_VIEWER_GET_PACKET_OK	= 1,
 	LTTNG_VIEWER_GET_PACKET_RETRY	= 2,
@@ -83,6 +138,13 @@ enum lttng_viewer_get_metadata_return_code {
 	LTTNG_VIEWER_METADATA_ERR	= 3,
 };
 
+enum lttng_viewer_notification_type {
+	/* New indexes are available or the stream is closed. */
+	LTTNG_VIEWER_NOTIFICATION_INDEX	= 1,
+	/* The session ID is unknown or the session is not attached. */
+	LTTNG_VIEWER_NOTIFICATION_ERR	= 2,
+};
+
 enum lttng_viewer_connection_type {
 	LTTNG_VIEWER_CLIENT_COMMAND		= 1,
 	LTTNG_VIEWER_CLIENT_NOTIFICATION	= 2,
@@ -147,6 +209,13 @@ struct lttng_viewer_connect {
 	uint32_t type;		/* enum lttng_viewer_connection_type */
 } LTTNG_PACKED;
 
+/*
+ * Follows the LTTNG_VIEWER_CONNECT reply flagged LTTNG_VIEWER_FEATURES_FLAG.
+ */
+struct lttng_viewer_features {
+	uint64_t features;	/* enum lttng_viewer_feature */
+} LTTNG_PACKED;
+
 /*
  * LTTNG_VIEWER_LIST_SESSIONS payload.
  */
@@ -164,6 +233,29 @@ struct lttng_viewer_attach_session_request {
 	uint32_t seek;		/* enum lttng_viewer_seek */
 } LTTNG_PACKED;
 
+/*
+ * Optional LTTNG_VIEWER_ATTACH_SESSION payload following the request, sent
+ * when the data size of the command accounts for it. It applies to every
+ * session attached to the viewer session until the next attach. The times
+ * are in the units of the packet timestamps.
+ *
+ * The relay daemon sends, instead of the indexes of the packets filtered
+ * out, an LTTNG_VIEWER_INDEX_INACTIVE index ending at the end of the last
+ * packet skipped.
+ */
+struct lttng_viewer_attach_filter {
+	/*
+	 * Only send the packets ending within this window before the end of
+	 * the last packet received on their stream, 0 to send them all.
+	 */
+	uint64_t window;
+	/*
+	 * Minimal interval between the beginning of two packets sent on a
+	 * stream, 0 to send them all.
+	 */
+	uint64_t sample_interval;
+} LTTNG_PACKED;
+
 struct lttng_viewer_attach_session_response {
 	/* enum lttng_viewer_attach_return_code */
 	uint32_t status;
@@ -172,6 +264,30 @@ struct lttng_viewer_attach_session_response {
 	char stream_list[];
 } LTTNG_PACKED;
 
+/*
+ * LTTNG_VIEWER_ATTACH_SESSIONS payload.
+ */
+struct lttng_viewer_attach_sessions_request {
+	uint32_t seek;		/* enum lttng_viewer_seek */
+	uint32_t sessions_count;
+	uint64_t session_ids[];
+} LTTNG_PACKED;
+
+struct lttng_viewer_attached_session {
+	uint64_t session_id;
+	/* enum lttng_viewer_attach_return_code */
+	uint32_t status;
+	uint32_t streams_count;
+	/* struct lttng_viewer_stream */
+	char stream_list[];
+} LTTNG_PACKED;
+
+struct lttng_viewer_attach_sessions_response {
+	uint32_t sessions_count;
+	/* struct lttng_viewer_attached_session, in the order of the request */
+	char session_list[];
+} LTTNG_PACKED;
+
 /*
  * LTTNG_VIEWER_GET_NEXT_INDEX payload.
  */
@@ -191,6 +307,39 @@ struct lttng_viewer_index {
 	uint32_t flags;		/* LTTNG_VIEWER_FLAG_* */
 } __attribute__ ((__packed__));
 
+/*
+ * LTTNG_VIEWER_GET_NEXT_INDEXES payload.
+ */
+struct lttng_viewer_get_next_indexes {
+	uint64_t session_id;
+	/*
+	 * Maximal number of bytes of packets sent along with the indexes, 0
+	 * to only send the indexes.
+	 */
+	uint64_t packet_budget;
+	/* Number of stream IDs following, 0 for every stream of the session. */
+	uint32_t streams_count;
+	uint64_t stream_ids[];
+} LTTNG_PACKED;
+
+struct lttng_viewer_stream_index {
+	uint64_t id;		/* ID of the viewer stream. */
+	struct lttng_viewer_index index;
+	/*
+	 * If LTTNG_VIEWER_FLAG_PACKET_DATA is set in the index flags, followed
+	 * by the packet_size / CHAR_BIT bytes of the packet.
+	 */
+	char data[];
+} LTTNG_PACKED;
+
+struct lttng_viewer_next_indexes {
+	/* enum lttng_viewer_next_indexes_return_code */
+	uint32_t status;
+	uint32_t indexes_count;
+	/* struct lttng_viewer_stream_index */
+	char index_list[];
+} LTTNG_PACKED;
+
 /*
  * LTTNG_VIEWER_GET_PACKET payload.
  */
@@ -252,4 +401,36 @@ struct lttng_viewer_detach_session_response {
 	uint32_t status;
 } LTTNG_PACKED;
 
+/*
+ * LTTNG_VIEWER_GET_SESSIONS_CHANGES payload. The request is empty.
+ */
+struct lttng_viewer_session_changes {
+	uint64_t session_id;
+	uint32_t flags;		/* LTTNG_VIEWER_FLAG_* */
+} LTTNG_PACKED;
+
+struct lttng_viewer_sessions_changes_response {
+	/* enum lttng_viewer_sessions_changes_return_code */
+	uint32_t status;
+	uint32_t sessions_count;
+	/* struct lttng_viewer_session_changes */
+	char session_list[];
+} LTTNG_PACKED;
+
+/*
+ * LTTNG_VIEWER_SUBSCRIBE payload, only valid on a notification connection.
+ */
+struct lttng_viewer_subscribe {
+	uint64_t session_id;
+	/* Number of notifications added to the remaining ones. */
+	uint32_t credits;
+} LTTNG_PACKED;
+
+/* Sent by the relay on a notification connection. */
+struct lttng_viewer_notification {
+	uint64_t session_id;
+	uint64_t stream_id;	/* Unused for LTTNG_VIEWER_NOTIFICATION_ERR. */
+	uint32_t type;		/* enum lttng_viewer_notification_type */
+} LTTNG_PACKED;
+
 #endif /* LTTNG_VIEWER_ABI_H */
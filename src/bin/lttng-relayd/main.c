@@ -45,16 +45,22 @@
 #include <common/compat/poll.h>
 #include <common/compat/socket.h>
 #include <common/compat/endian.h>
+#include <common/compat/fcntl.h>
 #include <common/compat/getenv.h>
+#include <common/compat/io-uring.h>
+#include <common/compat/string.h>
 #include <common/defaults.h>
 #include <common/daemonize.h>
 #include <common/futex.h>
 #include <common/sessiond-comm/sessiond-comm.h>
 #include <common/sessiond-comm/inet.h>
 #include <common/sessiond-comm/relayd.h>
+#include <common/stripe.h>
+#include <common/time.h>
 #include <common/uri.h>
 #include <common/utils.h>
 #include <common/config/session-config.h>
+#include <common/self-tracing/self-tracing.h>
 #include <urcu/rculist.h>
 
 #include "cmd.h"
@@ -70,6 +76,18 @@
 #include "stream.h"
 #include "connection.h"
 #include "tracefile-array.h"
+#include "tracefile-manager.h"
+#include "stats.h"
+#include "wire-compress.h"
+#include "metadata-store.h"
+#include "metadata-cache.h"
+
+/*
+ * Features advertised to the peers asking for them in RELAYD_VERSION: all of
+ * them, the wire compression needing zlib.
+ */
+#define RELAY_FEATURES	(RELAY_WIRE_FEATURES | (RELAYD_FEATURES_KNOWN & \
+		~RELAYD_FEATURE_WIRE_COMPRESSION))
 
 static const char *help_msg =
 #ifdef LTTNG_EMBED_HELP
@@ -82,6 +100,15 @@ NULL
 /* command line options */
 char *opt_output_path;
 static int opt_daemon, opt_background;
+static unsigned int opt_workers = DEFAULT_RELAYD_WORKERS;
+static unsigned int opt_listeners = DEFAULT_RELAYD_LISTENERS;
+static unsigned int opt_live_workers = DEFAULT_RELAYD_LIVE_WORKERS;
+unsigned int opt_index_batch = DEFAULT_RELAYD_INDEX_BATCH;
+unsigned int opt_index_ring = DEFAULT_RELAYD_INDEX_RING;
+static unsigned int opt_io_uring_depth = DEFAULT_RELAYD_IO_URING_DEPTH;
+static unsigned int opt_backpressure_lag = DEFAULT_RELAYD_BACKPRESSURE_LAG;
+static int opt_metadata_dedup;
+static char *opt_stripe_paths;
 
 /*
  * We need to wait for listener and live listener threads, as well as
@@ -93,6 +120,14 @@ static int lttng_relay_ready = NR_LTTNG_RELAY_READY;
 /* Size of receive buffer. */
 #define RECV_DATA_BUFFER_SIZE		65536
 
+/* Size of the receive-ahead buffer of the data connections. */
+#define RECV_AHEAD_BUFFER_SIZE		65536
+/*
+ * Maximal number of packets of a data connection processed with read-ahead
+ * on a single wakeup of its worker.
+ */
+#define RECV_AHEAD_MAX_PACKETS		64
+
 static int recv_child_signal;	/* Set to 1 when a SIGUSR1 signal is received. */
 static pid_t child_ppid;	/* Internal parent PID use with daemonize. */
 
@@ -114,18 +149,44 @@ const char * const config_section_name = "relayd";
 int thread_quit_pipe[2] = { -1, -1 };
 
 /*
- * This pipe is used to inform the worker thread that a command is queued and
- * ready to be processed.
+ * Worker thread handling the control and data connections handed to it by the
+ * dispatcher.
+ */
+struct relay_worker {
+	pthread_t thread;
+	/*
+	 * This pipe is used to inform the worker thread that a connection is
+	 * ready to be handled.
+	 */
+	int conn_pipe[2];
+};
+
+static struct relay_worker *workers;
+static unsigned int nr_workers_started;
+
+/*
+ * Listener thread accepting the control and data connections. With several
+ * listeners, each one has its own sockets bound to the ports with
+ * SO_REUSEPORT and hands its connections directly to its own subset of the
+ * workers: the workers of index id, id + opt_listeners, and so on.
  */
-static int relay_conn_pipe[2] = { -1, -1 };
+struct relay_listener {
+	pthread_t thread;
+	unsigned int id;
+	/* Next worker of the subset, for each connection type. */
+	unsigned int next_control_worker;
+	unsigned int next_data_worker;
+};
+
+static struct relay_listener *listeners;
+static unsigned int nr_listeners_started;
 
 /* Shared between threads */
 static int dispatch_thread_exit;
 
-static pthread_t listener_thread;
 static pthread_t dispatcher_thread;
-static pthread_t worker_thread;
 static pthread_t health_thread;
+static pthread_t tracefile_manager_thread_id;
 
 /*
  * last_relay_stream_id_lock protects last_relay_stream_id increment
@@ -142,9 +203,21 @@ static uint64_t last_relay_stream_id;
  */
 static struct relay_conn_queue relay_conn_queue;
 
-/* buffer allocated at startup, used to store the trace data */
-static char *data_buffer;
-static unsigned int data_buffer_size;
+/* Buffer of each worker thread used to store the received metadata. */
+static DEFINE_URCU_TLS(char *, worker_data_buffer);
+static DEFINE_URCU_TLS(unsigned int, worker_data_buffer_size);
+
+/*
+ * Pipe of each worker thread used to splice the received trace data to the
+ * stream files. Created on first use.
+ */
+struct relay_splice_pipe {
+	int fds[2];
+	bool created;
+	/* Splicing from the data sockets failed with EINVAL or ENOSYS. */
+	bool unsupported;
+};
+static DEFINE_URCU_TLS(struct relay_splice_pipe, worker_splice_pipe);
 
 /* Global relay stream hash table. */
 struct lttng_ht *relay_streams_ht;
@@ -162,19 +235,50 @@ static struct option long_options[] = {
 	{ "control-port", 1, 0, 'C', },
 	{ "data-port", 1, 0, 'D', },
 	{ "live-port", 1, 0, 'L', },
+	{ "live-workers", 1, 0, 'l', },
+	{ "listeners", 1, 0, 'n', },
 	{ "daemonize", 0, 0, 'd', },
 	{ "background", 0, 0, 'b', },
 	{ "group", 1, 0, 'g', },
+	{ "index-batch", 1, 0, 'i', },
+	{ "io-uring", 1, 0, 'u', },
 	{ "help", 0, 0, 'h', },
 	{ "output", 1, 0, 'o', },
+	{ "backpressure-lag", 1, 0, 'p', },
+	{ "index-ring", 1, 0, 'r', },
+	{ "metadata-dedup", 0, 0, 'm', },
+	{ "stripe-paths", 1, 0, 's', },
 	{ "verbose", 0, 0, 'v', },
 	{ "config", 1, 0, 'f' },
 	{ "version", 0, 0, 'V' },
+	{ "workers", 1, 0, 'w' },
 	{ NULL, 0, 0, 0, },
 };
 
 static const char *config_ignore_options[] = { "help", "config", "version" };
 
+/*
+ * Parse an unsigned integer option argument, between "min" and "max".
+ *
+ * Return 0 on success or else -1.
+ */
+static int parse_bounded_uint(const char *arg, unsigned long min,
+		unsigned long max, unsigned int *value)
+{
+	char *end;
+	unsigned long val;
+
+	errno = 0;
+	val = strtoul(arg, &end, 10);
+	if (errno != 0 || end == arg || *end != '\0' || val < min ||
+			val > max) {
+		return -1;
+	}
+
+	*value = (unsigned int) val;
+	return 0;
+}
+
 /*
  * Take an option from the getopt output and set it in the right variable to be
  * used later.
@@ -243,6 +347,9 @@ static int set_option(int opt, const char *arg, const char *optname)
 	case 'b':
 		opt_background = 1;
 		break;
+	case 'm':
+		opt_metadata_dedup = 1;
+		break;
 	case 'g':
 		if (lttng_is_setuid_setgid()) {
 			WARN("Getting '%s' argument from setuid/setgid binary refused for security reasons.",
@@ -280,6 +387,77 @@ static int set_option(int opt, const char *arg, const char *optname)
 			}
 		}
 		break;
+	case 's':
+		if (lttng_is_setuid_setgid()) {
+			WARN("Getting '%s' argument from setuid/setgid binary refused for security reasons.",
+				"-s, --stripe-paths");
+		} else {
+			free(opt_stripe_paths);
+			opt_stripe_paths = strdup(arg);
+			if (!opt_stripe_paths) {
+				ret = -errno;
+				PERROR("strdup opt_stripe_paths");
+				goto end;
+			}
+		}
+		break;
+	case 'w':
+		if (parse_bounded_uint(arg, 1, DEFAULT_RELAYD_MAX_WORKERS,
+				&opt_workers)) {
+			ERR("Invalid number of worker threads: %s", arg);
+			ret = -1;
+			goto end;
+		}
+		break;
+	case 'l':
+		if (parse_bounded_uint(arg, 1, DEFAULT_RELAYD_MAX_WORKERS,
+				&opt_live_workers)) {
+			ERR("Invalid number of live worker threads: %s", arg);
+			ret = -1;
+			goto end;
+		}
+		break;
+	case 'n':
+		if (parse_bounded_uint(arg, 1, DEFAULT_RELAYD_MAX_WORKERS,
+				&opt_listeners)) {
+			ERR("Invalid number of listener threads: %s", arg);
+			ret = -1;
+			goto end;
+		}
+		break;
+	case 'i':
+		if (parse_bounded_uint(arg, 1, DEFAULT_RELAYD_MAX_INDEX_BATCH,
+				&opt_index_batch)) {
+			ERR("Invalid index batch size: %s", arg);
+			ret = -1;
+			goto end;
+		}
+		break;
+	case 'p':
+		if (parse_bounded_uint(arg, 0,
+				DEFAULT_RELAYD_MAX_BACKPRESSURE_LAG,
+				&opt_backpressure_lag)) {
+			ERR("Invalid backpressure write lag: %s", arg);
+			ret = -1;
+			goto end;
+		}
+		break;
+	case 'r':
+		if (parse_bounded_uint(arg, 0, DEFAULT_RELAYD_MAX_INDEX_RING,
+				&opt_index_ring)) {
+			ERR("Invalid index ring size: %s", arg);
+			ret = -1;
+			goto end;
+		}
+		break;
+	case 'u':
+		if (parse_bounded_uint(arg, 0, DEFAULT_RELAYD_MAX_IO_URING_DEPTH,
+				&opt_io_uring_depth)) {
+			ERR("Invalid io_uring depth: %s", arg);
+			ret = -1;
+			goto end;
+		}
+		break;
 	case 'v':
 		/* Verbose level can increase using multiple -v */
 		if (arg) {
@@ -512,6 +690,7 @@ static void relayd_cleanup(void)
 
 	/* free the dynamically allocated opt_output_path */
 	free(opt_output_path);
+	free(opt_stripe_paths);
 
 	/* Close thread quit pipes */
 	utils_close_pipe(thread_quit_pipe);
@@ -746,6 +925,18 @@ static struct lttcomm_sock *relay_socket_create(struct lttng_uri *uri)
 	}
 	DBG("Listening on sock %d", sock->fd);
 
+	if (opt_listeners > 1) {
+		int val = 1;
+
+		/* The kernel balances the connections among the listeners. */
+		ret = setsockopt(sock->fd, SOL_SOCKET, SO_REUSEPORT, &val,
+				sizeof(val));
+		if (ret < 0) {
+			PERROR("setsockopt SO_REUSEPORT");
+			goto error;
+		}
+	}
+
 	ret = sock->ops->bind(sock);
 	if (ret < 0) {
 		goto error;
@@ -766,6 +957,70 @@ error:
 	return NULL;
 }
 
+/*
+ * Hand a new connection to a worker thread. The connection is released on
+ * error.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static int dispatch_connection(struct relay_worker *worker,
+		struct relay_connection *conn)
+{
+	ssize_t ret;
+
+	DBG("Dispatching request waiting on sock %d to worker %u",
+			conn->sock->fd, (unsigned int) (worker - workers));
+
+	/*
+	 * Inform worker thread of the new request. This
+	 * call is blocking so we can be assured that
+	 * the data will be read at some point in time
+	 * or wait to the end of the world :)
+	 */
+	ret = lttng_write(worker->conn_pipe[1], &conn, sizeof(conn));
+	if (ret < 0) {
+		PERROR("write connection pipe");
+		connection_put(conn);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Hand a new connection to the next worker of the subset of a listener, when
+ * several listeners run, or else to the dispatcher thread.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static int listener_queue_connection(struct relay_listener *listener,
+		struct relay_connection *conn)
+{
+	unsigned int *next, worker_idx, nr_subset_workers;
+
+	if (opt_listeners == 1) {
+		/* Enqueue request for the dispatcher thread. */
+		cds_wfcq_enqueue(&relay_conn_queue.head, &relay_conn_queue.tail,
+				 &conn->qnode);
+
+		/*
+		 * Wake the dispatch queue futex.
+		 * Implicit memory barrier with the
+		 * exchange in cds_wfcq_enqueue.
+		 */
+		futex_nto1_wake(&relay_conn_queue.futex);
+		return 0;
+	}
+
+	/* The listeners are never more than the workers. */
+	nr_subset_workers = (opt_workers - listener->id + opt_listeners - 1) /
+			opt_listeners;
+	next = conn->type == RELAY_DATA ? &listener->next_data_worker :
+			&listener->next_control_worker;
+	worker_idx = listener->id + *next * opt_listeners;
+	*next = (*next + 1) % nr_subset_workers;
+	return dispatch_connection(&workers[worker_idx], conn);
+}
+
 /*
  * This thread manages the listening for new connections on the network
  */
@@ -775,8 +1030,9 @@ static void *relay_thread_listener(void *data)
 	uint32_t revents, nb_fd;
 	struct lttng_poll_event events;
 	struct lttcomm_sock *control_sock, *data_sock;
+	struct relay_listener *listener = data;
 
-	DBG("[thread] Relay listener started");
+	DBG("[thread] Relay listener %u started", listener->id);
 
 	health_register(health_relayd, HEALTH_RELAYD_TYPE_LISTENER);
 
@@ -905,16 +1161,10 @@ restart:
 					goto error;
 				}
 
-				/* Enqueue request for the dispatcher thread. */
-				cds_wfcq_enqueue(&relay_conn_queue.head, &relay_conn_queue.tail,
-						 &new_conn->qnode);
-
-				/*
-				 * Wake the dispatch queue futex.
-				 * Implicit memory barrier with the
-				 * exchange in cds_wfcq_enqueue.
-				 */
-				futex_nto1_wake(&relay_conn_queue.futex);
+				ret = listener_queue_connection(listener, new_conn);
+				if (ret < 0) {
+					goto error;
+				}
 			} else if (revents & (LPOLLERR | LPOLLHUP | LPOLLRDHUP)) {
 				ERR("socket poll error");
 				goto error;
@@ -966,6 +1216,7 @@ static void *relay_thread_dispatcher(void *data)
 	ssize_t ret;
 	struct cds_wfcq_node *node;
 	struct relay_connection *new_conn = NULL;
+	unsigned int next_control_worker = 0, next_data_worker = 0;
 
 	DBG("[thread] Relay dispatcher started");
 
@@ -988,6 +1239,8 @@ static void *relay_thread_dispatcher(void *data)
 		}
 
 		do {
+			struct relay_worker *worker;
+
 			health_code_update();
 
 			/* Dequeue commands */
@@ -1000,18 +1253,22 @@ static void *relay_thread_dispatcher(void *data)
 			}
 			new_conn = caa_container_of(node, struct relay_connection, qnode);
 
-			DBG("Dispatching request waiting on sock %d", new_conn->sock->fd);
-
 			/*
-			 * Inform worker thread of the new request. This
-			 * call is blocking so we can be assured that
-			 * the data will be read at some point in time
-			 * or wait to the end of the world :)
+			 * Spread the control and the data connections separately
+			 * so that the data connections, which carry most of the
+			 * load, are balanced among the workers.
 			 */
-			ret = lttng_write(relay_conn_pipe[1], &new_conn, sizeof(new_conn));
+			if (new_conn->type == RELAY_DATA) {
+				worker = &workers[next_data_worker];
+				next_data_worker = (next_data_worker + 1) % opt_workers;
+			} else {
+				worker = &workers[next_control_worker];
+				next_control_worker = (next_control_worker + 1) %
+						opt_workers;
+			}
+
+			ret = dispatch_connection(worker, new_conn);
 			if (ret < 0) {
-				PERROR("write connection pipe");
-				connection_put(new_conn);
 				goto error;
 			}
 		} while (node != NULL);
@@ -1041,7 +1298,7 @@ error_testpoint:
  * Set index data from the control port to a given index object.
  */
 static int set_index_control_data(struct relay_index *index,
-		struct lttcomm_relayd_index *data,
+		const struct lttcomm_relayd_index *data,
 		struct relay_connection *conn)
 {
 	struct ctf_packet_index index_data;
@@ -1063,6 +1320,9 @@ static int set_index_control_data(struct relay_index *index,
 		index->index_data.stream_instance_id = data->stream_instance_id;
 		index->index_data.packet_seq_num = data->packet_seq_num;
 	}
+	if (conn->features & RELAYD_FEATURE_INDEX_EVENTS) {
+		index->index_data.events_count = data->events_count;
+	}
 
 	return relay_index_set_data(index, &index_data);
 }
@@ -1103,7 +1363,7 @@ static int relay_create_session(struct lttcomm_relayd_hdr *recv_hdr,
 	}
 
 	session = session_create(session_name, hostname, live_timer,
-			snapshot, conn->major, conn->minor);
+			snapshot, conn->major, conn->minor, conn->features);
 	if (!session) {
 		ret = -1;
 		goto send_reply;
@@ -1160,6 +1420,43 @@ static void publish_connection_local_streams(struct relay_connection *conn)
 	pthread_mutex_unlock(&session->lock);
 }
 
+/*
+ * Create a stream of the session, passing it the ownership of path_name and
+ * channel_name, and set its handle in "stream_handle".
+ *
+ * Return the new stream or NULL on error.
+ */
+static struct relay_stream *add_session_stream(struct relay_session *session,
+		char *path_name, char *channel_name, uint64_t tracefile_size,
+		uint64_t tracefile_count, uint64_t *stream_handle)
+{
+	struct relay_stream *stream;
+	struct ctf_trace *trace;
+
+	trace = ctf_trace_get_by_path_or_create(session, path_name);
+	if (!trace) {
+		free(path_name);
+		free(channel_name);
+		return NULL;
+	}
+	/* This stream here has one reference on the trace. */
+
+	pthread_mutex_lock(&last_relay_stream_id_lock);
+	*stream_handle = ++last_relay_stream_id;
+	pthread_mutex_unlock(&last_relay_stream_id_lock);
+
+	/* We pass ownership of path_name and channel_name. */
+	stream = stream_create(trace, *stream_handle, path_name,
+			channel_name, tracefile_size, tracefile_count);
+
+	/*
+	 * Streams are the owners of their trace. Reference to trace is
+	 * kept within stream_create().
+	 */
+	ctf_trace_put(trace);
+	return stream;
+}
+
 /*
  * relay_add_stream: allocate a new stream for a session
  */
@@ -1171,7 +1468,6 @@ static int relay_add_stream(struct lttcomm_relayd_hdr *recv_hdr,
 	struct relay_session *session = conn->session;
 	struct relay_stream *stream = NULL;
 	struct lttcomm_relayd_status_stream reply;
-	struct ctf_trace *trace = NULL;
 	uint64_t stream_handle = -1ULL;
 	char *path_name = NULL, *channel_name = NULL;
 	uint64_t tracefile_size = 0, tracefile_count = 0;
@@ -1197,28 +1493,11 @@ static int relay_add_stream(struct lttcomm_relayd_hdr *recv_hdr,
 		goto send_reply;
 	}
 
-	trace = ctf_trace_get_by_path_or_create(session, path_name);
-	if (!trace) {
-		goto send_reply;
-	}
-	/* This stream here has one reference on the trace. */
-
-	pthread_mutex_lock(&last_relay_stream_id_lock);
-	stream_handle = ++last_relay_stream_id;
-	pthread_mutex_unlock(&last_relay_stream_id_lock);
-
-	/* We pass ownership of path_name and channel_name. */
-	stream = stream_create(trace, stream_handle, path_name,
-			channel_name, tracefile_size, tracefile_count);
+	stream = add_session_stream(session, path_name, channel_name,
+			tracefile_size, tracefile_count, &stream_handle);
 	path_name = NULL;
 	channel_name = NULL;
 
-	/*
-	 * Streams are the owners of their trace. Reference to trace is
-	 * kept within stream_create().
-	 */
-	ctf_trace_put(trace);
-
 send_reply:
 	memset(&reply, 0, sizeof(reply));
 	reply.handle = htobe64(stream_handle);
@@ -1242,42 +1521,18 @@ end_no_session:
 }
 
 /*
- * relay_close_stream: close a specific stream
+ * Close the stream of id "stream_id" whose last packet has the sequence
+ * number "last_net_seq_num".
+ *
+ * Return 0 on success or else -1 if the stream is unknown.
  */
-static int relay_close_stream(struct lttcomm_relayd_hdr *recv_hdr,
-		struct relay_connection *conn)
+static int close_session_stream(uint64_t stream_id, uint64_t last_net_seq_num)
 {
-	int ret, send_ret;
-	struct relay_session *session = conn->session;
-	struct lttcomm_relayd_close_stream stream_info;
-	struct lttcomm_relayd_generic_reply reply;
 	struct relay_stream *stream;
 
-	DBG("Close stream received");
-
-	if (!session || conn->version_check_done == 0) {
-		ERR("Trying to close a stream before version check");
-		ret = -1;
-		goto end_no_session;
-	}
-
-	ret = conn->sock->ops->recvmsg(conn->sock, &stream_info,
-			sizeof(struct lttcomm_relayd_close_stream), 0);
-	if (ret < sizeof(struct lttcomm_relayd_close_stream)) {
-		if (ret == 0) {
-			/* Orderly shutdown. Not necessary to print an error. */
-			DBG("Socket %d did an orderly shutdown", conn->sock->fd);
-		} else {
-			ERR("Relay didn't receive valid add_stream struct size : %d", ret);
-		}
-		ret = -1;
-		goto end_no_session;
-	}
-
-	stream = stream_get_by_id(be64toh(stream_info.stream_id));
+	stream = stream_get_by_id(stream_id);
 	if (!stream) {
-		ret = -1;
-		goto end;
+		return -1;
 	}
 
 	/*
@@ -1285,7 +1540,7 @@ static int relay_close_stream(struct lttcomm_relayd_hdr *recv_hdr,
 	 * pending check.
 	 */
 	pthread_mutex_lock(&stream->lock);
-	stream->last_net_seq_num = be64toh(stream_info.last_net_seq_num);
+	stream->last_net_seq_num = last_net_seq_num;
 	pthread_mutex_unlock(&stream->lock);
 
 	/*
@@ -1316,92 +1571,44 @@ static int relay_close_stream(struct lttcomm_relayd_hdr *recv_hdr,
 		}
 	}
 	stream_put(stream);
-
-end:
-	memset(&reply, 0, sizeof(reply));
-	if (ret < 0) {
-		reply.ret_code = htobe32(LTTNG_ERR_UNK);
-	} else {
-		reply.ret_code = htobe32(LTTNG_OK);
-	}
-	send_ret = conn->sock->ops->sendmsg(conn->sock, &reply,
-			sizeof(struct lttcomm_relayd_generic_reply), 0);
-	if (send_ret < 0) {
-		ERR("Relay sending stream id");
-		ret = send_ret;
-	}
-
-end_no_session:
-	return ret;
+	return 0;
 }
 
 /*
- * relay_reset_metadata: reset a metadata stream
+ * relay_close_stream: close a specific stream
  */
-static
-int relay_reset_metadata(struct lttcomm_relayd_hdr *recv_hdr,
+static int relay_close_stream(struct lttcomm_relayd_hdr *recv_hdr,
 		struct relay_connection *conn)
 {
 	int ret, send_ret;
 	struct relay_session *session = conn->session;
-	struct lttcomm_relayd_reset_metadata stream_info;
+	struct lttcomm_relayd_close_stream stream_info;
 	struct lttcomm_relayd_generic_reply reply;
-	struct relay_stream *stream;
 
-	DBG("Reset metadata received");
+	DBG("Close stream received");
 
 	if (!session || conn->version_check_done == 0) {
-		ERR("Trying to reset a metadata stream before version check");
+		ERR("Trying to close a stream before version check");
 		ret = -1;
 		goto end_no_session;
 	}
 
 	ret = conn->sock->ops->recvmsg(conn->sock, &stream_info,
-			sizeof(struct lttcomm_relayd_reset_metadata), 0);
-	if (ret < sizeof(struct lttcomm_relayd_reset_metadata)) {
+			sizeof(struct lttcomm_relayd_close_stream), 0);
+	if (ret < sizeof(struct lttcomm_relayd_close_stream)) {
 		if (ret == 0) {
 			/* Orderly shutdown. Not necessary to print an error. */
 			DBG("Socket %d did an orderly shutdown", conn->sock->fd);
 		} else {
-			ERR("Relay didn't receive valid reset_metadata struct "
-					"size : %d", ret);
+			ERR("Relay didn't receive valid add_stream struct size : %d", ret);
 		}
 		ret = -1;
 		goto end_no_session;
 	}
-	DBG("Update metadata to version %" PRIu64, be64toh(stream_info.version));
-
-	/* Unsupported for live sessions for now. */
-	if (session->live_timer != 0) {
-		ret = -1;
-		goto end;
-	}
-
-	stream = stream_get_by_id(be64toh(stream_info.stream_id));
-	if (!stream) {
-		ret = -1;
-		goto end;
-	}
-	pthread_mutex_lock(&stream->lock);
-	if (!stream->is_metadata) {
-		ret = -1;
-		goto end_unlock;
-	}
 
-	ret = utils_rotate_stream_file(stream->path_name, stream->channel_name,
-			0, 0, -1, -1, stream->stream_fd->fd, NULL,
-			&stream->stream_fd->fd);
-	if (ret < 0) {
-		ERR("Failed to rotate metadata file %s of channel %s",
-				stream->path_name, stream->channel_name);
-		goto end_unlock;
-	}
+	ret = close_session_stream(be64toh(stream_info.stream_id),
+			be64toh(stream_info.last_net_seq_num));
 
-end_unlock:
-	pthread_mutex_unlock(&stream->lock);
-	stream_put(stream);
-
-end:
 	memset(&reply, 0, sizeof(reply));
 	if (ret < 0) {
 		reply.ret_code = htobe32(LTTNG_ERR_UNK);
@@ -1411,7 +1618,7 @@ end:
 	send_ret = conn->sock->ops->sendmsg(conn->sock, &reply,
 			sizeof(struct lttcomm_relayd_generic_reply), 0);
 	if (send_ret < 0) {
-		ERR("Relay sending reset metadata reply");
+		ERR("Relay sending stream id");
 		ret = send_ret;
 	}
 
@@ -1420,7 +1627,297 @@ end_no_session:
 }
 
 /*
- * relay_unknown_command: send -1 if received unknown command
+ * Receive the "len" bytes of the payload of a bulk streams command.
+ *
+ * Return 0 on success or else -1.
+ */
+static int recv_bulk_payload(struct relay_connection *conn, void *buf,
+		size_t len)
+{
+	ssize_t ret;
+
+	ret = conn->sock->ops->recvmsg(conn->sock, buf, len, 0);
+	if (ret < 0 || ret != len) {
+		if (ret == 0) {
+			/* Orderly shutdown. Not necessary to print an error. */
+			DBG("Socket %d did an orderly shutdown", conn->sock->fd);
+		} else {
+			ERR("Relay didn't receive the bulk streams payload");
+		}
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Add the streams of a channel, sharing the same path and tracefile settings,
+ * as many relay_add_stream() in a single message.
+ *
+ * Reply the status of each stream, in the order of the entries.
+ */
+static int relay_add_streams(struct lttcomm_relayd_hdr *recv_hdr,
+		struct relay_connection *conn)
+{
+	int ret;
+	ssize_t send_ret;
+	uint32_t i, nb_streams;
+	size_t len, entries_len;
+	bool valid_path = true;
+	struct relay_session *session = conn->session;
+	struct lttcomm_relayd_add_streams msg;
+	struct lttcomm_relayd_add_streams_entry *entries = NULL;
+	struct lttcomm_relayd_status_stream *replies = NULL;
+
+	DBG("Add streams received");
+
+	if (!session || conn->version_check_done == 0) {
+		ERR("Trying to add streams before version check");
+		ret = -1;
+		goto end;
+	}
+
+	ret = recv_bulk_payload(conn, &msg, sizeof(msg));
+	if (ret < 0) {
+		goto end;
+	}
+
+	nb_streams = be32toh(msg.nb_streams);
+	entries_len = nb_streams * sizeof(*entries);
+	if (nb_streams > RELAYD_BULK_STREAMS_MAX ||
+			be64toh(recv_hdr->data_size) != sizeof(msg) + entries_len) {
+		ERR("Relay received an invalid number of streams to add: %" PRIu32,
+				nb_streams);
+		ret = -1;
+		goto end;
+	}
+	if (!nb_streams) {
+		ret = 0;
+		goto end;
+	}
+
+	entries = zmalloc(entries_len);
+	replies = zmalloc(nb_streams * sizeof(*replies));
+	if (!entries || !replies) {
+		PERROR("zmalloc add streams");
+		ret = -1;
+		goto end;
+	}
+	ret = recv_bulk_payload(conn, entries, entries_len);
+	if (ret < 0) {
+		goto end;
+	}
+
+	/* Ensure that NULL-terminated and fits in local filename length. */
+	len = lttng_strnlen(msg.pathname, sizeof(msg.pathname));
+	if (len == sizeof(msg.pathname) || len >= LTTNG_NAME_MAX) {
+		ERR("Path name too long");
+		valid_path = false;
+	}
+
+	for (i = 0; i < nb_streams; i++) {
+		struct relay_stream *stream = NULL;
+		uint64_t stream_handle = -1ULL;
+		char *path_name = NULL, *channel_name = NULL;
+
+		len = lttng_strnlen(entries[i].channel_name,
+				sizeof(entries[i].channel_name));
+		if (!valid_path || len == sizeof(entries[i].channel_name)) {
+			ERR("Channel name too long");
+			goto reply;
+		}
+		path_name = create_output_path(msg.pathname);
+		channel_name = strdup(entries[i].channel_name);
+		if (!path_name || !channel_name) {
+			PERROR("Stream names allocation");
+			free(path_name);
+			free(channel_name);
+			goto reply;
+		}
+
+		/* We pass ownership of path_name and channel_name. */
+		stream = add_session_stream(session, path_name, channel_name,
+				be64toh(msg.tracefile_size),
+				be64toh(msg.tracefile_count), &stream_handle);
+reply:
+		replies[i].handle = htobe64(stream_handle);
+		replies[i].ret_code = htobe32(stream ? LTTNG_OK : LTTNG_ERR_UNK);
+	}
+
+	send_ret = conn->sock->ops->sendmsg(conn->sock, replies,
+			nb_streams * sizeof(*replies), 0);
+	if (send_ret < 0) {
+		ERR("Relay sending streams id");
+		ret = (int) send_ret;
+	} else {
+		ret = 0;
+	}
+
+end:
+	free(entries);
+	free(replies);
+	return ret;
+}
+
+/*
+ * Close many streams, as many relay_close_stream() in a single message.
+ *
+ * Reply LTTNG_OK if all the streams are closed.
+ */
+static int relay_close_streams(struct lttcomm_relayd_hdr *recv_hdr,
+		struct relay_connection *conn)
+{
+	int ret, close_ret = 0;
+	ssize_t send_ret;
+	uint32_t i, nb_streams;
+	size_t streams_len;
+	struct lttcomm_relayd_close_streams msg;
+	struct lttcomm_relayd_close_stream *streams = NULL;
+	struct lttcomm_relayd_generic_reply reply;
+
+	DBG("Close streams received");
+
+	if (!conn->session || conn->version_check_done == 0) {
+		ERR("Trying to close streams before version check");
+		ret = -1;
+		goto end;
+	}
+
+	ret = recv_bulk_payload(conn, &msg, sizeof(msg));
+	if (ret < 0) {
+		goto end;
+	}
+
+	nb_streams = be32toh(msg.nb_streams);
+	streams_len = nb_streams * sizeof(*streams);
+	if (nb_streams > RELAYD_BULK_STREAMS_MAX ||
+			be64toh(recv_hdr->data_size) != sizeof(msg) + streams_len) {
+		ERR("Relay received an invalid number of streams to close: %" PRIu32,
+				nb_streams);
+		ret = -1;
+		goto end;
+	}
+
+	if (nb_streams) {
+		streams = zmalloc(streams_len);
+		if (!streams) {
+			PERROR("zmalloc close streams");
+			ret = -1;
+			goto end;
+		}
+		ret = recv_bulk_payload(conn, streams, streams_len);
+		if (ret < 0) {
+			goto end;
+		}
+	}
+
+	for (i = 0; i < nb_streams; i++) {
+		if (close_session_stream(be64toh(streams[i].stream_id),
+				be64toh(streams[i].last_net_seq_num))) {
+			close_ret = -1;
+		}
+	}
+
+	memset(&reply, 0, sizeof(reply));
+	reply.ret_code = htobe32(close_ret ? LTTNG_ERR_UNK : LTTNG_OK);
+	send_ret = conn->sock->ops->sendmsg(conn->sock, &reply, sizeof(reply), 0);
+	if (send_ret < 0) {
+		ERR("Relay sending close streams reply");
+		ret = (int) send_ret;
+	} else {
+		ret = 0;
+	}
+
+end:
+	free(streams);
+	return ret;
+}
+
+/*
+ * relay_reset_metadata: reset a metadata stream
+ */
+static
+int relay_reset_metadata(struct lttcomm_relayd_hdr *recv_hdr,
+		struct relay_connection *conn)
+{
+	int ret, send_ret;
+	struct relay_session *session = conn->session;
+	struct lttcomm_relayd_reset_metadata stream_info;
+	struct lttcomm_relayd_generic_reply reply;
+	struct relay_stream *stream;
+
+	DBG("Reset metadata received");
+
+	if (!session || conn->version_check_done == 0) {
+		ERR("Trying to reset a metadata stream before version check");
+		ret = -1;
+		goto end_no_session;
+	}
+
+	ret = conn->sock->ops->recvmsg(conn->sock, &stream_info,
+			sizeof(struct lttcomm_relayd_reset_metadata), 0);
+	if (ret < sizeof(struct lttcomm_relayd_reset_metadata)) {
+		if (ret == 0) {
+			/* Orderly shutdown. Not necessary to print an error. */
+			DBG("Socket %d did an orderly shutdown", conn->sock->fd);
+		} else {
+			ERR("Relay didn't receive valid reset_metadata struct "
+					"size : %d", ret);
+		}
+		ret = -1;
+		goto end_no_session;
+	}
+	DBG("Update metadata to version %" PRIu64, be64toh(stream_info.version));
+
+	/* Unsupported for live sessions for now. */
+	if (session->live_timer != 0) {
+		ret = -1;
+		goto end;
+	}
+
+	stream = stream_get_by_id(be64toh(stream_info.stream_id));
+	if (!stream) {
+		ret = -1;
+		goto end;
+	}
+	pthread_mutex_lock(&stream->lock);
+	if (!stream->is_metadata) {
+		ret = -1;
+		goto end_unlock;
+	}
+
+	ret = utils_rotate_stream_file(stream->path_name, stream->channel_name,
+			0, 0, -1, -1, stream->stream_fd->fd, NULL,
+			&stream->stream_fd->fd);
+	if (ret < 0) {
+		ERR("Failed to rotate metadata file %s of channel %s",
+				stream->path_name, stream->channel_name);
+		goto end_unlock;
+	}
+
+end_unlock:
+	pthread_mutex_unlock(&stream->lock);
+	stream_put(stream);
+
+end:
+	memset(&reply, 0, sizeof(reply));
+	if (ret < 0) {
+		reply.ret_code = htobe32(LTTNG_ERR_UNK);
+	} else {
+		reply.ret_code = htobe32(LTTNG_OK);
+	}
+	send_ret = conn->sock->ops->sendmsg(conn->sock, &reply,
+			sizeof(struct lttcomm_relayd_generic_reply), 0);
+	if (send_ret < 0) {
+		ERR("Relay sending reset metadata reply");
+		ret = send_ret;
+	}
+
+end_no_session:
+	return ret;
+}
+
+/*
+ * relay_unknown_command: send -1 if received unknown command
  */
 static void relay_unknown_command(struct relay_connection *conn)
 {
@@ -1463,31 +1960,66 @@ static int relay_start(struct lttcomm_relayd_hdr *recv_hdr,
 	return ret;
 }
 
+/* Shared source of the padding written out when it cannot be a hole. */
+static const char padding_zeros[4096];
+
+/*
+ * Extend the file pointed by the file descriptor fd from "offset", its
+ * current end, by "size" bytes of padding left as a hole, and move the file
+ * position to the new end.
+ *
+ * Return 0 on success or else a negative value, in which case the padding
+ * must be written out.
+ */
+static int extend_file_sparse(int fd, off_t offset, uint32_t size)
+{
+	int ret;
+	off_t end = offset + size;
+
+	ret = ftruncate(fd, end);
+	if (ret) {
+		PERROR("ftruncate padding hole, writing it out");
+		goto end;
+	}
+	if (lseek(fd, end, SEEK_SET) != end) {
+		PERROR("lseek past padding hole");
+		ret = -1;
+	}
+end:
+	return ret;
+}
+
 /*
  * Append padding to the file pointed by the file descriptor fd.
  */
 static int write_padding_to_file(int fd, uint32_t size)
 {
 	ssize_t ret = 0;
-	char *zeros;
+	off_t offset;
+	uint32_t done = 0;
 
 	if (size == 0) {
 		goto end;
 	}
 
-	zeros = zmalloc(size);
-	if (zeros == NULL) {
-		PERROR("zmalloc zeros for padding");
-		ret = -1;
+	offset = lseek(fd, 0, SEEK_CUR);
+	if (offset >= 0 && !extend_file_sparse(fd, offset, size)) {
+		ret = size;
 		goto end;
 	}
 
-	ret = lttng_write(fd, zeros, size);
-	if (ret < size) {
-		PERROR("write padding to file");
-	}
+	while (done < size) {
+		size_t len = min_t(size_t, size - done, sizeof(padding_zeros));
 
-	free(zeros);
+		ret = lttng_write(fd, padding_zeros, len);
+		if (ret < (ssize_t) len) {
+			PERROR("write padding to file");
+			ret = -1;
+			goto end;
+		}
+		done += len;
+	}
+	ret = size;
 
 end:
 	return ret;
@@ -1520,23 +2052,26 @@ static int relay_recv_metadata(struct lttcomm_relayd_hdr *recv_hdr,
 	}
 	payload_size -= sizeof(struct lttcomm_relayd_metadata_payload);
 
-	if (data_buffer_size < data_size) {
+	if (URCU_TLS(worker_data_buffer_size) < data_size) {
 		/* In case the realloc fails, we can free the memory */
 		char *tmp_data_ptr;
 
-		tmp_data_ptr = realloc(data_buffer, data_size);
+		tmp_data_ptr = realloc(URCU_TLS(worker_data_buffer), data_size);
 		if (!tmp_data_ptr) {
 			ERR("Allocating data buffer");
-			free(data_buffer);
+			free(URCU_TLS(worker_data_buffer));
+			URCU_TLS(worker_data_buffer) = NULL;
+			URCU_TLS(worker_data_buffer_size) = 0;
 			ret = -1;
 			goto end;
 		}
-		data_buffer = tmp_data_ptr;
-		data_buffer_size = data_size;
+		URCU_TLS(worker_data_buffer) = tmp_data_ptr;
+		URCU_TLS(worker_data_buffer_size) = data_size;
 	}
-	memset(data_buffer, 0, data_size);
+	memset(URCU_TLS(worker_data_buffer), 0, data_size);
 	DBG2("Relay receiving metadata, waiting for %" PRIu64 " bytes", data_size);
-	size_ret = conn->sock->ops->recvmsg(conn->sock, data_buffer, data_size, 0);
+	size_ret = conn->sock->ops->recvmsg(conn->sock,
+			URCU_TLS(worker_data_buffer), data_size, 0);
 	if (size_ret < 0 || size_ret != data_size) {
 		if (size_ret == 0) {
 			/* Orderly shutdown. Not necessary to print an error. */
@@ -1547,7 +2082,8 @@ static int relay_recv_metadata(struct lttcomm_relayd_hdr *recv_hdr,
 		ret = -1;
 		goto end;
 	}
-	metadata_struct = (struct lttcomm_relayd_metadata_payload *) data_buffer;
+	metadata_struct = (struct lttcomm_relayd_metadata_payload *)
+			URCU_TLS(worker_data_buffer);
 
 	metadata_stream = stream_get_by_id(be64toh(metadata_struct->stream_id));
 	if (!metadata_stream) {
@@ -1571,6 +2107,9 @@ static int relay_recv_metadata(struct lttcomm_relayd_hdr *recv_hdr,
 		goto end_put;
 	}
 
+	metadata_cache_append(metadata_stream, metadata_struct->payload,
+			payload_size, be32toh(metadata_struct->padding_size));
+
 	metadata_stream->metadata_received +=
 		payload_size + be32toh(metadata_struct->padding_size);
 	DBG2("Relay metadata written. Updated metadata_received %" PRIu64,
@@ -1590,6 +2129,7 @@ static int relay_send_version(struct lttcomm_relayd_hdr *recv_hdr,
 		struct relay_connection *conn)
 {
 	int ret;
+	bool send_features;
 	struct lttcomm_relayd_version reply, msg;
 
 	conn->version_check_done = 1;
@@ -1628,16 +2168,47 @@ static int relay_send_version(struct lttcomm_relayd_hdr *recv_hdr,
 		conn->minor = be32toh(msg.minor);
 	}
 
+	send_features = be64toh(recv_hdr->circuit_id) ==
+			RELAYD_VERSION_FEATURES_MAGIC;
+	if (send_features) {
+		reply.minor |= RELAYD_VERSION_FEATURES_FLAG;
+	}
+
 	reply.major = htobe32(reply.major);
 	reply.minor = htobe32(reply.minor);
 	ret = conn->sock->ops->sendmsg(conn->sock, &reply,
 			sizeof(struct lttcomm_relayd_version), 0);
 	if (ret < 0) {
 		ERR("Relay sending version");
+		goto end;
+	}
+
+	conn->features = 0;
+	if (send_features) {
+		struct lttcomm_relayd_version_features features;
+
+		memset(&features, 0, sizeof(features));
+		features.features = htobe64(RELAY_FEATURES);
+		ret = conn->sock->ops->sendmsg(conn->sock, &features,
+				sizeof(features), 0);
+		if (ret < 0) {
+			ERR("Relay sending version features");
+			goto end;
+		}
+
+		/* Features used by the peer on this connection. */
+		ret = conn->sock->ops->recvmsg(conn->sock, &features,
+				sizeof(features), 0);
+		if (ret < 0 || ret != sizeof(features)) {
+			ERR("Relay failed to receive the features used");
+			ret = -1;
+			goto end;
+		}
+		conn->features = be64toh(features.features) & RELAY_FEATURES;
 	}
 
-	DBG("Version check done using protocol %u.%u", conn->major,
-			conn->minor);
+	DBG("Version check done using protocol %u.%u with features 0x%"
+			PRIx64, conn->major, conn->minor, conn->features);
 
 end:
 	return ret;
@@ -1696,6 +2267,11 @@ static int relay_data_pending(struct lttcomm_relayd_hdr *recv_hdr,
 	if (((int64_t) (stream->prev_seq - last_net_seq_num)) >= 0) {
 		/* Data has in fact been written and is NOT pending */
 		ret = 0;
+		/* Neither are its indexes. */
+		if (relay_index_batch_flush(stream)) {
+			ERR("Failed to write the batched indexes of stream %" PRIu64,
+					stream->stream_handle);
+		}
 	} else {
 		/* Data still being streamed thus pending */
 		ret = 1;
@@ -1779,26 +2355,25 @@ end_no_session:
 }
 
 /*
- * Initialize a data pending command. This means that a consumer is about
- * to ask for data pending for each stream it holds. Simply iterate over
- * all streams of a session and set the data_pending_check_done flag.
+ * Check for data pending for many streams of the session, as done by
+ * relay_data_pending() for data streams and relay_quiescent_control() for
+ * metadata streams.
  *
- * This command returns to the client a LTTNG_OK code.
+ * Reply 1 if data is pending on at least one stream or else 0.
  */
-static int relay_begin_data_pending(struct lttcomm_relayd_hdr *recv_hdr,
+static int relay_streams_data_pending(struct lttcomm_relayd_hdr *recv_hdr,
 		struct relay_connection *conn)
 {
-	int ret;
-	struct lttng_ht_iter iter;
-	struct lttcomm_relayd_begin_data_pending msg;
+	int ret, send_ret, pending = 0;
+	uint32_t i, nb_streams;
+	size_t streams_len;
+	struct lttcomm_relayd_streams_data_pending msg;
+	struct lttcomm_relayd_stream_data_pending *streams = NULL;
 	struct lttcomm_relayd_generic_reply reply;
-	struct relay_stream *stream;
-	uint64_t session_id;
 
-	assert(recv_hdr);
 	assert(conn);
 
-	DBG("Init streams for data pending");
+	DBG("Streams data pending command received");
 
 	if (!conn->session || conn->version_check_done == 0) {
 		ERR("Trying to check for data before version check");
@@ -1812,38 +2387,152 @@ static int relay_begin_data_pending(struct lttcomm_relayd_hdr *recv_hdr,
 			/* Orderly shutdown. Not necessary to print an error. */
 			DBG("Socket %d did an orderly shutdown", conn->sock->fd);
 		} else {
-			ERR("Relay didn't receive valid begin data_pending struct size: %d",
+			ERR("Relay didn't receive valid streams data_pending struct size : %d",
 					ret);
 		}
 		ret = -1;
 		goto end_no_session;
 	}
 
-	session_id = be64toh(msg.session_id);
+	nb_streams = be32toh(msg.nb_streams);
+	streams_len = nb_streams * sizeof(*streams);
+	if (nb_streams > RELAYD_STREAMS_DATA_PENDING_MAX ||
+			be64toh(recv_hdr->data_size) != sizeof(msg) + streams_len) {
+		ERR("Relay received an invalid number of streams: %" PRIu32,
+				nb_streams);
+		ret = -1;
+		goto end_no_session;
+	}
+	if (!nb_streams) {
+		goto end;
+	}
 
-	/*
-	 * Iterate over all streams to set the begin data pending flag.
-	 * For now, the streams are indexed by stream handle so we have
-	 * to iterate over all streams to find the one associated with
-	 * the right session_id.
-	 */
-	rcu_read_lock();
-	cds_lfht_for_each_entry(relay_streams_ht->ht, &iter.iter, stream,
-			node.node) {
-		if (!stream_get(stream)) {
+	streams = zmalloc(streams_len);
+	if (!streams) {
+		PERROR("zmalloc streams data pending");
+		ret = -1;
+		goto end_no_session;
+	}
+	ret = conn->sock->ops->recvmsg(conn->sock, streams, streams_len, 0);
+	if (ret < 0 || ret != streams_len) {
+		if (ret == 0) {
+			/* Orderly shutdown. Not necessary to print an error. */
+			DBG("Socket %d did an orderly shutdown", conn->sock->fd);
+		} else {
+			ERR("Relay didn't receive the streams data pending");
+		}
+		ret = -1;
+		goto end_no_session;
+	}
+
+	for (i = 0; i < nb_streams; i++) {
+		struct relay_stream *stream;
+		uint64_t last_net_seq_num;
+
+		stream = stream_get_by_id(be64toh(streams[i].stream_id));
+		if (!stream) {
+			/* Same as an unknown stream of RELAYD_DATA_PENDING. */
 			continue;
 		}
-		if (stream->trace->session->id == session_id) {
-			pthread_mutex_lock(&stream->lock);
-			stream->data_pending_check_done = false;
-			pthread_mutex_unlock(&stream->lock);
-			DBG("Set begin data pending flag to stream %" PRIu64,
-					stream->stream_handle);
+		last_net_seq_num = be64toh(streams[i].last_net_seq_num);
+
+		pthread_mutex_lock(&stream->lock);
+		/* Avoid wrapping issue */
+		if (!streams[i].metadata &&
+				((int64_t) (stream->prev_seq - last_net_seq_num)) < 0) {
+			DBG("Data pending for stream id %" PRIu64 " prev_seq %"
+					PRIu64 " and last_seq %" PRIu64,
+					stream->stream_handle, stream->prev_seq,
+					last_net_seq_num);
+			pending = 1;
+		}
+		stream->data_pending_check_done = true;
+		pthread_mutex_unlock(&stream->lock);
+		stream_put(stream);
+	}
+
+end:
+	memset(&reply, 0, sizeof(reply));
+	reply.ret_code = htobe32(pending);
+	send_ret = conn->sock->ops->sendmsg(conn->sock, &reply, sizeof(reply), 0);
+	if (send_ret < 0) {
+		ERR("Relay streams data pending ret code failed");
+		ret = send_ret;
+	} else {
+		ret = 0;
+	}
+
+end_no_session:
+	free(streams);
+	return ret;
+}
+
+/*
+ * Initialize a data pending command. This means that a consumer is about
+ * to ask for data pending for each stream it holds. Simply iterate over
+ * the streams of the session and set the data_pending_check_done flag.
+ *
+ * This command returns to the client a LTTNG_OK code.
+ */
+static int relay_begin_data_pending(struct lttcomm_relayd_hdr *recv_hdr,
+		struct relay_connection *conn)
+{
+	int ret;
+	struct lttcomm_relayd_begin_data_pending msg;
+	struct lttcomm_relayd_generic_reply reply;
+	struct relay_session *session;
+	struct relay_stream *stream;
+	uint64_t session_id;
+
+	assert(recv_hdr);
+	assert(conn);
+
+	DBG("Init streams for data pending");
+
+	if (!conn->session || conn->version_check_done == 0) {
+		ERR("Trying to check for data before version check");
+		ret = -1;
+		goto end_no_session;
+	}
+
+	ret = conn->sock->ops->recvmsg(conn->sock, &msg, sizeof(msg), 0);
+	if (ret < sizeof(msg)) {
+		if (ret == 0) {
+			/* Orderly shutdown. Not necessary to print an error. */
+			DBG("Socket %d did an orderly shutdown", conn->sock->fd);
+		} else {
+			ERR("Relay didn't receive valid begin data_pending struct size: %d",
+					ret);
+		}
+		ret = -1;
+		goto end_no_session;
+	}
+
+	session_id = be64toh(msg.session_id);
+
+	session = session_get_by_id(session_id);
+	if (!session) {
+		goto reply;
+	}
+
+	/* Iterate over the streams of the session to set the flag. */
+	rcu_read_lock();
+	cds_list_for_each_entry_rcu(stream, &session->stream_list,
+			session_node) {
+		if (!stream_get(stream)) {
+			continue;
 		}
+		pthread_mutex_lock(&stream->lock);
+		stream->data_pending_check_done = false;
+		pthread_mutex_unlock(&stream->lock);
+		DBG("Set begin data pending flag to stream %" PRIu64,
+				stream->stream_handle);
 		stream_put(stream);
 	}
 	rcu_read_unlock();
+	session_put(session);
 
+reply:
 	memset(&reply, 0, sizeof(reply));
 	/* All good, send back reply. */
 	reply.ret_code = htobe32(LTTNG_OK);
@@ -1870,9 +2559,9 @@ static int relay_end_data_pending(struct lttcomm_relayd_hdr *recv_hdr,
 		struct relay_connection *conn)
 {
 	int ret;
-	struct lttng_ht_iter iter;
 	struct lttcomm_relayd_end_data_pending msg;
 	struct lttcomm_relayd_generic_reply reply;
+	struct relay_session *session;
 	struct relay_stream *stream;
 	uint64_t session_id;
 	uint32_t is_data_inflight = 0;
@@ -1900,21 +2589,26 @@ static int relay_end_data_pending(struct lttcomm_relayd_hdr *recv_hdr,
 
 	session_id = be64toh(msg.session_id);
 
+	session = session_get_by_id(session_id);
+	if (!session) {
+		goto reply;
+	}
+
 	/*
-	 * Iterate over all streams to see if the begin data pending
-	 * flag is set.
+	 * Iterate over the streams of the session to see if the begin data
+	 * pending flag is set.
 	 */
 	rcu_read_lock();
-	cds_lfht_for_each_entry(relay_streams_ht->ht, &iter.iter, stream,
-			node.node) {
+	cds_list_for_each_entry_rcu(stream, &session->stream_list,
+			session_node) {
 		if (!stream_get(stream)) {
 			continue;
 		}
-		if (stream->trace->session->id != session_id) {
-			stream_put(stream);
-			continue;
-		}
 		pthread_mutex_lock(&stream->lock);
+		if (relay_index_batch_flush(stream)) {
+			ERR("Failed to write the batched indexes of stream %" PRIu64,
+					stream->stream_handle);
+		}
 		if (!stream->data_pending_check_done) {
 			if (!stream->closed || !(((int64_t) (stream->prev_seq - stream->last_net_seq_num)) >= 0)) {
 				is_data_inflight = 1;
@@ -1929,7 +2623,9 @@ static int relay_end_data_pending(struct lttcomm_relayd_hdr *recv_hdr,
 		stream_put(stream);
 	}
 	rcu_read_unlock();
+	session_put(session);
 
+reply:
 	memset(&reply, 0, sizeof(reply));
 	/* All good, send back reply. */
 	reply.ret_code = htobe32(is_data_inflight);
@@ -1944,51 +2640,80 @@ end_no_session:
 }
 
 /*
- * Receive an index for a specific stream.
+ * Handle a live beacon: the stream has no data up to timestamp_end.
  *
- * Return 0 on success else a negative value.
+ * Called with the stream lock held.
  */
-static int relay_recv_index(struct lttcomm_relayd_hdr *recv_hdr,
-		struct relay_connection *conn)
+static void handle_live_beacon(struct relay_stream *stream,
+		uint64_t timestamp_end)
 {
-	int ret, send_ret;
-	struct relay_session *session = conn->session;
-	struct lttcomm_relayd_index index_info;
-	struct relay_index *index;
-	struct lttcomm_relayd_generic_reply reply;
-	struct relay_stream *stream;
-	uint64_t net_seq_num;
-	size_t msg_len;
+	DBG("Received live beacon for stream %" PRIu64, stream->stream_handle);
 
-	assert(conn);
-
-	DBG("Relay receiving index");
+	/* The viewer must see every index received before the beacon. */
+	if (relay_index_batch_flush(stream)) {
+		ERR("Failed to write the batched indexes of stream %" PRIu64,
+				stream->stream_handle);
+	}
 
-	if (!session || conn->version_check_done == 0) {
-		ERR("Trying to close a stream before version check");
-		ret = -1;
-		goto end_no_session;
+	/*
+	 * Only flag a stream inactive when it has already
+	 * received data and no indexes are in flight.
+	 */
+	if (stream->index_received_seqcount > 0
+			&& stream->indexes_in_flight == 0) {
+		stream->beacon_ts_end = timestamp_end;
 	}
+}
 
-	msg_len = lttcomm_relayd_index_len(
-			lttng_to_index_major(conn->major, conn->minor),
-			lttng_to_index_minor(conn->major, conn->minor));
-	ret = conn->sock->ops->recvmsg(conn->sock, &index_info,
-			msg_len, 0);
-	if (ret < msg_len) {
-		if (ret == 0) {
-			/* Orderly shutdown. Not necessary to print an error. */
-			DBG("Socket %d did an orderly shutdown", conn->sock->fd);
-		} else {
-			ERR("Relay didn't receive valid index struct size : %d", ret);
-		}
-		ret = -1;
-		goto end_no_session;
+/*
+ * Backpressure level of a session from its write lag and the threshold set
+ * by --backpressure-lag.
+ */
+static enum lttcomm_relayd_backpressure session_backpressure(
+		uint64_t write_lag_ns)
+{
+	uint64_t threshold_ns = (uint64_t) opt_backpressure_lag * NSEC_PER_MSEC;
+
+	if (!threshold_ns || write_lag_ns < threshold_ns) {
+		return RELAYD_BACKPRESSURE_NONE;
+	}
+	if (write_lag_ns < 4 * threshold_ns) {
+		return RELAYD_BACKPRESSURE_SLOW;
 	}
+	return RELAYD_BACKPRESSURE_SATURATED;
+}
+
+/*
+ * Update the write lag of a session with the time taken to write one of its
+ * packets. The lag is a moving average of weight 1/8. The streams of a
+ * session may be written by several workers concurrently: a lost update only
+ * delays the average.
+ */
+static void session_update_write_lag(struct relay_session *session,
+		uint64_t write_ns)
+{
+	uint64_t lag = CMM_LOAD_SHARED(session->write_lag_ns);
+
+	CMM_STORE_SHARED(session->write_lag_ns,
+			lag - (lag >> 3) + (write_ns >> 3));
+}
+
+/*
+ * Handle the index of a packet received on a control connection.
+ *
+ * Return 0 on success else a negative value.
+ */
+static int process_index(struct relay_connection *conn,
+		const struct lttcomm_relayd_index *index_info)
+{
+	int ret;
+	struct relay_index *index;
+	struct relay_stream *stream;
+	uint64_t net_seq_num;
 
-	net_seq_num = be64toh(index_info.net_seq_num);
+	net_seq_num = be64toh(index_info->net_seq_num);
 
-	stream = stream_get_by_id(be64toh(index_info.relay_stream_id));
+	stream = stream_get_by_id(be64toh(index_info->relay_stream_id));
 	if (!stream) {
 		ERR("stream_get_by_id not found");
 		ret = -1;
@@ -1997,19 +2722,8 @@ static int relay_recv_index(struct lttcomm_relayd_hdr *recv_hdr,
 	pthread_mutex_lock(&stream->lock);
 
 	/* Live beacon handling */
-	if (index_info.packet_size == 0) {
-		DBG("Received live beacon for stream %" PRIu64,
-				stream->stream_handle);
-
-		/*
-		 * Only flag a stream inactive when it has already
-		 * received data and no indexes are in flight.
-		 */
-		if (stream->index_received_seqcount > 0
-				&& stream->indexes_in_flight == 0) {
-			stream->beacon_ts_end =
-				be64toh(index_info.timestamp_end);
-		}
+	if (index_info->packet_size == 0) {
+		handle_live_beacon(stream, be64toh(index_info->timestamp_end));
 		ret = 0;
 		goto end_stream_put;
 	} else {
@@ -2017,7 +2731,7 @@ static int relay_recv_index(struct lttcomm_relayd_hdr *recv_hdr,
 	}
 
 	if (stream->ctf_stream_id == -1ULL) {
-		stream->ctf_stream_id = be64toh(index_info.stream_id);
+		stream->ctf_stream_id = be64toh(index_info->stream_id);
 	}
 	index = relay_index_get_by_id_or_create(stream, net_seq_num);
 	if (!index) {
@@ -2025,18 +2739,15 @@ static int relay_recv_index(struct lttcomm_relayd_hdr *recv_hdr,
 		ERR("relay_index_get_by_id_or_create index NULL");
 		goto end_stream_put;
 	}
-	if (set_index_control_data(index, &index_info, conn)) {
+	if (set_index_control_data(index, index_info, conn)) {
 		ERR("set_index_control_data error");
 		relay_index_put(index);
 		ret = -1;
 		goto end_stream_put;
 	}
 	ret = relay_index_try_flush(index);
-	if (ret == 0) {
-		tracefile_array_commit_seq(stream->tfa);
-		stream->index_received_seqcount++;
-	} else if (ret > 0) {
-		/* no flush. */
+	if (ret >= 0) {
+		/* Flushed or no flush. */
 		ret = 0;
 	} else {
 		ERR("relay_index_try_flush error %d", ret);
@@ -2047,8 +2758,22 @@ static int relay_recv_index(struct lttcomm_relayd_hdr *recv_hdr,
 end_stream_put:
 	pthread_mutex_unlock(&stream->lock);
 	stream_put(stream);
-
 end:
+	return ret;
+}
+
+/*
+ * Send the reply to RELAYD_SEND_INDEX or RELAYD_SEND_INDEXES, "ret" being
+ * the result of the command.
+ *
+ * Return "ret", or a negative value if the reply cannot be sent.
+ */
+static int send_index_reply(struct relay_connection *conn, int ret)
+{
+	int send_ret;
+	struct lttcomm_relayd_index_reply reply;
+	uint64_t write_lag_ns;
+	size_t reply_len;
 
 	memset(&reply, 0, sizeof(reply));
 	if (ret < 0) {
@@ -2056,219 +2781,871 @@ end:
 	} else {
 		reply.ret_code = htobe32(LTTNG_OK);
 	}
-	send_ret = conn->sock->ops->sendmsg(conn->sock, &reply, sizeof(reply), 0);
+	if (conn->features & RELAYD_FEATURE_BACKPRESSURE) {
+		write_lag_ns = CMM_LOAD_SHARED(conn->session->write_lag_ns);
+		reply.backpressure = htobe32(session_backpressure(write_lag_ns));
+		reply.write_lag_ns = htobe64(write_lag_ns);
+		reply_len = sizeof(reply);
+	} else {
+		reply_len = sizeof(struct lttcomm_relayd_generic_reply);
+	}
+	send_ret = conn->sock->ops->sendmsg(conn->sock, &reply, reply_len, 0);
 	if (send_ret < 0) {
 		ERR("Relay sending close index id reply");
 		ret = send_ret;
 	}
+	return ret;
+}
+
+/*
+ * Receive an index for a specific stream.
+ *
+ * Return 0 on success else a negative value.
+ */
+static int relay_recv_index(struct lttcomm_relayd_hdr *recv_hdr,
+		struct relay_connection *conn)
+{
+	int ret;
+	struct relay_session *session = conn->session;
+	struct lttcomm_relayd_index index_info;
+	size_t msg_len;
+
+	assert(conn);
+
+	DBG("Relay receiving index");
+
+	if (!session || conn->version_check_done == 0) {
+		ERR("Trying to close a stream before version check");
+		ret = -1;
+		goto end_no_session;
+	}
+
+	msg_len = lttcomm_relayd_index_len(
+			lttng_to_index_major(conn->major, conn->minor),
+			lttcomm_relayd_index_minor(conn->major, conn->minor,
+				conn->features));
+	ret = conn->sock->ops->recvmsg(conn->sock, &index_info,
+			msg_len, 0);
+	if (ret < msg_len) {
+		if (ret == 0) {
+			/* Orderly shutdown. Not necessary to print an error. */
+			DBG("Socket %d did an orderly shutdown", conn->sock->fd);
+		} else {
+			ERR("Relay didn't receive valid index struct size : %d", ret);
+		}
+		ret = -1;
+		goto end_no_session;
+	}
+
+	ret = process_index(conn, &index_info);
+	ret = send_index_reply(conn, ret);
 
 end_no_session:
 	return ret;
 }
 
 /*
- * Receive the streams_sent message.
+ * Receive the indexes of many packets, handled in order like as many
+ * RELAYD_SEND_INDEX messages.
  *
  * Return 0 on success else a negative value.
  */
-static int relay_streams_sent(struct lttcomm_relayd_hdr *recv_hdr,
+static int relay_recv_indexes(struct lttcomm_relayd_hdr *recv_hdr,
 		struct relay_connection *conn)
 {
-	int ret, send_ret;
-	struct lttcomm_relayd_generic_reply reply;
+	int ret = 0;
+	uint32_t i, nb_indexes;
+	size_t indexes_len;
+	struct lttcomm_relayd_indexes msg;
+	struct lttcomm_relayd_index *indexes = NULL;
 
 	assert(conn);
 
-	DBG("Relay receiving streams_sent");
+	DBG("Relay receiving indexes");
 
 	if (!conn->session || conn->version_check_done == 0) {
-		ERR("Trying to close a stream before version check");
+		ERR("Trying to send indexes before version check");
 		ret = -1;
 		goto end_no_session;
 	}
 
-	/*
-	 * Publish every pending stream in the connection recv list which are
-	 * now ready to be used by the viewer.
-	 */
-	publish_connection_local_streams(conn);
+	ret = conn->sock->ops->recvmsg(conn->sock, &msg, sizeof(msg), 0);
+	if (ret < sizeof(msg)) {
+		if (ret == 0) {
+			/* Orderly shutdown. Not necessary to print an error. */
+			DBG("Socket %d did an orderly shutdown", conn->sock->fd);
+		} else {
+			ERR("Relay didn't receive valid indexes struct size : %d", ret);
+		}
+		ret = -1;
+		goto end_no_session;
+	}
 
-	memset(&reply, 0, sizeof(reply));
-	reply.ret_code = htobe32(LTTNG_OK);
-	send_ret = conn->sock->ops->sendmsg(conn->sock, &reply, sizeof(reply), 0);
-	if (send_ret < 0) {
-		ERR("Relay sending sent_stream reply");
-		ret = send_ret;
-	} else {
-		/* Success. */
+	nb_indexes = be32toh(msg.nb_indexes);
+	indexes_len = nb_indexes * sizeof(*indexes);
+	if (nb_indexes > RELAYD_INDEXES_MAX ||
+			be64toh(recv_hdr->data_size) != sizeof(msg) + indexes_len) {
+		ERR("Relay received an invalid number of indexes: %" PRIu32,
+				nb_indexes);
+		ret = -1;
+		goto end_no_session;
+	}
+	if (!nb_indexes) {
 		ret = 0;
+		goto end;
+	}
+
+	indexes = zmalloc(indexes_len);
+	if (!indexes) {
+		PERROR("zmalloc indexes");
+		ret = -1;
+		goto end_no_session;
 	}
+	ret = conn->sock->ops->recvmsg(conn->sock, indexes, indexes_len, 0);
+	if (ret < 0 || ret != indexes_len) {
+		if (ret == 0) {
+			/* Orderly shutdown. Not necessary to print an error. */
+			DBG("Socket %d did an orderly shutdown", conn->sock->fd);
+		} else {
+			ERR("Relay didn't receive the indexes");
+		}
+		ret = -1;
+		goto end_no_session;
+	}
+
+	ret = 0;
+	for (i = 0; i < nb_indexes; i++) {
+		/* Keep handling the other indexes on error. */
+		if (process_index(conn, &indexes[i])) {
+			ret = -1;
+		}
+	}
+
+end:
+	ret = send_index_reply(conn, ret);
+
+end_no_session:
+	free(indexes);
+	return ret;
+}
+
+/*
+ * Receive the live beacons of many streams.
+ */
+static int relay_recv_beacons(struct lttcomm_relayd_hdr *recv_hdr,
+		struct relay_connection *conn)
+{
+	int ret, send_ret;
+	uint32_t i, nb_beacons;
+	size_t beacons_len;
+	struct lttcomm_relayd_beacons msg;
+	struct lttcomm_relayd_beacon *beacons = NULL;
+	struct lttcomm_relayd_generic_reply reply;
+
+	assert(conn);
+
+	DBG("Relay receiving beacons");
+
+	if (!conn->session || conn->version_check_done == 0) {
+		ERR("Trying to send beacons before version check");
+		ret = -1;
+		goto end_no_session;
+	}
+
+	ret = conn->sock->ops->recvmsg(conn->sock, &msg, sizeof(msg), 0);
+	if (ret < sizeof(msg)) {
+		if (ret == 0) {
+			/* Orderly shutdown. Not necessary to print an error. */
+			DBG("Socket %d did an orderly shutdown", conn->sock->fd);
+		} else {
+			ERR("Relay didn't receive valid beacons struct size : %d", ret);
+		}
+		ret = -1;
+		goto end_no_session;
+	}
+
+	nb_beacons = be32toh(msg.nb_beacons);
+	beacons_len = nb_beacons * sizeof(*beacons);
+	if (nb_beacons > RELAYD_BEACONS_MAX ||
+			be64toh(recv_hdr->data_size) != sizeof(msg) + beacons_len) {
+		ERR("Relay received an invalid number of beacons: %" PRIu32,
+				nb_beacons);
+		ret = -1;
+		goto end_no_session;
+	}
+	if (!nb_beacons) {
+		ret = 0;
+		goto end;
+	}
+
+	beacons = zmalloc(beacons_len);
+	if (!beacons) {
+		PERROR("zmalloc beacons");
+		ret = -1;
+		goto end_no_session;
+	}
+	ret = conn->sock->ops->recvmsg(conn->sock, beacons, beacons_len, 0);
+	if (ret < 0 || ret != beacons_len) {
+		if (ret == 0) {
+			/* Orderly shutdown. Not necessary to print an error. */
+			DBG("Socket %d did an orderly shutdown", conn->sock->fd);
+		} else {
+			ERR("Relay didn't receive the beacons");
+		}
+		ret = -1;
+		goto end_no_session;
+	}
+
+	for (i = 0; i < nb_beacons; i++) {
+		struct relay_stream *stream;
+
+		stream = stream_get_by_id(be64toh(beacons[i].relay_stream_id));
+		if (!stream) {
+			/* The stream may have been closed meanwhile. */
+			DBG("Beacon for unknown stream %" PRIu64,
+					be64toh(beacons[i].relay_stream_id));
+			continue;
+		}
+		pthread_mutex_lock(&stream->lock);
+		handle_live_beacon(stream, be64toh(beacons[i].timestamp_end));
+		pthread_mutex_unlock(&stream->lock);
+		stream_put(stream);
+	}
+	ret = 0;
+
+end:
+	memset(&reply, 0, sizeof(reply));
+	reply.ret_code = htobe32(LTTNG_OK);
+	send_ret = conn->sock->ops->sendmsg(conn->sock, &reply, sizeof(reply), 0);
+	if (send_ret < 0) {
+		ERR("Relay sending beacons reply");
+		ret = send_ret;
+	}
+
+end_no_session:
+	free(beacons);
+	return ret;
+}
+
+/*
+ * Receive the streams_sent message.
+ *
+ * Return 0 on success else a negative value.
+ */
+static int relay_streams_sent(struct lttcomm_relayd_hdr *recv_hdr,
+		struct relay_connection *conn)
+{
+	int ret, send_ret;
+	struct lttcomm_relayd_generic_reply reply;
+
+	assert(conn);
+
+	DBG("Relay receiving streams_sent");
+
+	if (!conn->session || conn->version_check_done == 0) {
+		ERR("Trying to close a stream before version check");
+		ret = -1;
+		goto end_no_session;
+	}
+
+	/*
+	 * Publish every pending stream in the connection recv list which are
+	 * now ready to be used by the viewer.
+	 */
+	publish_connection_local_streams(conn);
+
+	memset(&reply, 0, sizeof(reply));
+	reply.ret_code = htobe32(LTTNG_OK);
+	send_ret = conn->sock->ops->sendmsg(conn->sock, &reply, sizeof(reply), 0);
+	if (send_ret < 0) {
+		ERR("Relay sending sent_stream reply");
+		ret = send_ret;
+	} else {
+		/* Success. */
+		ret = 0;
+	}
+
+end_no_session:
+	return ret;
+}
+
+/*
+ * Process the commands received on the control socket
+ */
+static int relay_process_control(struct lttcomm_relayd_hdr *recv_hdr,
+		struct relay_connection *conn)
+{
+	int ret = 0;
+
+	switch (be32toh(recv_hdr->cmd)) {
+	case RELAYD_CREATE_SESSION:
+		ret = relay_create_session(recv_hdr, conn);
+		break;
+	case RELAYD_ADD_STREAM:
+		ret = relay_add_stream(recv_hdr, conn);
+		break;
+	case RELAYD_START_DATA:
+		ret = relay_start(recv_hdr, conn);
+		break;
+	case RELAYD_SEND_METADATA:
+		ret = relay_recv_metadata(recv_hdr, conn);
+		break;
+	case RELAYD_VERSION:
+		ret = relay_send_version(recv_hdr, conn);
+		break;
+	case RELAYD_CLOSE_STREAM:
+		ret = relay_close_stream(recv_hdr, conn);
+		break;
+	case RELAYD_DATA_PENDING:
+		ret = relay_data_pending(recv_hdr, conn);
+		break;
+	case RELAYD_QUIESCENT_CONTROL:
+		ret = relay_quiescent_control(recv_hdr, conn);
+		break;
+	case RELAYD_BEGIN_DATA_PENDING:
+		ret = relay_begin_data_pending(recv_hdr, conn);
+		break;
+	case RELAYD_END_DATA_PENDING:
+		ret = relay_end_data_pending(recv_hdr, conn);
+		break;
+	case RELAYD_SEND_INDEX:
+		ret = relay_recv_index(recv_hdr, conn);
+		break;
+	case RELAYD_SEND_INDEXES:
+		ret = relay_recv_indexes(recv_hdr, conn);
+		break;
+	case RELAYD_STREAMS_SENT:
+		ret = relay_streams_sent(recv_hdr, conn);
+		break;
+	case RELAYD_RESET_METADATA:
+		ret = relay_reset_metadata(recv_hdr, conn);
+		break;
+	case RELAYD_SEND_BEACONS:
+		ret = relay_recv_beacons(recv_hdr, conn);
+		break;
+	case RELAYD_STREAMS_DATA_PENDING:
+		ret = relay_streams_data_pending(recv_hdr, conn);
+		break;
+	case RELAYD_ADD_STREAMS:
+		ret = relay_add_streams(recv_hdr, conn);
+		break;
+	case RELAYD_CLOSE_STREAMS:
+		ret = relay_close_streams(recv_hdr, conn);
+		break;
+	case RELAYD_UPDATE_SYNC_INFO:
+	default:
+		ERR("Received unknown command (%u)", be32toh(recv_hdr->cmd));
+		relay_unknown_command(conn);
+		ret = -1;
+		goto end;
+	}
+
+end:
+	return ret;
+}
+
+/*
+ * Handle index for a data stream.
+ *
+ * Called with the stream lock held.
+ *
+ * Return 0 on success else a negative value.
+ */
+static int handle_index_data(struct relay_stream *stream, uint64_t net_seq_num,
+		int rotate_index)
+{
+	int ret = 0;
+	uint64_t data_offset;
+	struct relay_index *index;
+
+	/* Get data offset because we are about to update the index. */
+	data_offset = htobe64(stream->tracefile_size_current);
+
+	DBG("handle_index_data: stream %" PRIu64 " net_seq_num %" PRIu64 " data offset %" PRIu64,
+			stream->stream_handle, net_seq_num, stream->tracefile_size_current);
+
+	/*
+	 * Lookup for an existing index for that stream id/sequence
+	 * number. If it exists, the control thread has already received the
+	 * data for it, thus we need to write it to disk.
+	 */
+	index = relay_index_get_by_id_or_create(stream, net_seq_num);
+	if (!index) {
+		ret = -1;
+		goto end;
+	}
+
+	if (rotate_index || !stream->index_file) {
+		uint32_t major, minor;
+		uint64_t features;
+
+		/* Put ref on previous index_file. */
+		if (stream->index_file) {
+			lttng_index_file_put(stream->index_file);
+			stream->index_file = NULL;
+		}
+		major = stream->trace->session->major;
+		minor = stream->trace->session->minor;
+		features = stream->trace->session->features;
+		stream->index_file = lttng_index_file_create(stream->path_name,
+				stream->channel_name,
+			        -1, -1, stream->tracefile_size,
+				tracefile_array_get_file_index_head(stream->tfa),
+				lttng_to_index_major(major, minor),
+				lttcomm_relayd_index_minor(major, minor,
+					features));
+		if (!stream->index_file) {
+			ret = -1;
+			/* Put self-ref for this index due to error. */
+			relay_index_put(index);
+			index = NULL;
+			goto end;
+		}
+	}
+
+	if (relay_index_set_file(index, stream->index_file, data_offset)) {
+		ret = -1;
+		/* Put self-ref for this index due to error. */
+		relay_index_put(index);
+		index = NULL;
+		goto end;
+	}
+
+	ret = relay_index_try_flush(index);
+	if (ret >= 0) {
+		/* Flushed or no flush. */
+		ret = 0;
+	} else {
+		/* Put self-ref for this index due to error. */
+		relay_index_put(index);
+		index = NULL;
+		ret = -1;
+	}
+end:
+	return ret;
+}
+
+/*
+ * Return the number of bytes of the receive-ahead buffer of a data connection
+ * not processed yet.
+ */
+static size_t recv_ahead_pending(struct relay_connection *conn)
+{
+	return conn->recv_ahead.len - conn->recv_ahead.off;
+}
+
+/*
+ * Receive in the empty receive-ahead buffer of a data connection the bytes
+ * already available on its socket, without blocking.
+ *
+ * Return the number of bytes received, 0 on orderly shutdown, -EAGAIN if no
+ * byte is available or else -1.
+ */
+static ssize_t recv_ahead_fill(struct relay_connection *conn)
+{
+	ssize_t ret;
+
+	assert(!recv_ahead_pending(conn));
+
+	if (!conn->recv_ahead.buf) {
+		conn->recv_ahead.buf = zmalloc(RECV_AHEAD_BUFFER_SIZE);
+		if (!conn->recv_ahead.buf) {
+			PERROR("zmalloc receive-ahead buffer");
+			ret = -1;
+			goto end;
+		}
+	}
+	conn->recv_ahead.off = conn->recv_ahead.len = 0;
+
+	do {
+		ret = recv(conn->sock->fd, conn->recv_ahead.buf,
+				RECV_AHEAD_BUFFER_SIZE, MSG_DONTWAIT);
+	} while (ret < 0 && errno == EINTR);
+	if (ret < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			ret = -EAGAIN;
+		} else {
+			PERROR("recv on sock %d", conn->sock->fd);
+			ret = -1;
+		}
+		goto end;
+	}
+	conn->recv_ahead.len = ret;
+end:
+	return ret;
+}
+
+/*
+ * Receive "len" bytes from a data connection, starting with the bytes of its
+ * receive-ahead buffer. If "read_ahead" is set, an empty buffer is first
+ * refilled with all the bytes available on the socket so that the following
+ * packets can be processed without any system call.
+ *
+ * Return len on success, 0 on orderly shutdown or else a negative value.
+ */
+static ssize_t data_conn_recv(struct relay_connection *conn, void *buf,
+		size_t len, bool read_ahead)
+{
+	ssize_t ret;
+	size_t done = 0;
+
+	while (done < len) {
+		size_t pending = recv_ahead_pending(conn);
+
+		if (pending) {
+			size_t copy_len = min(pending, len - done);
+
+			memcpy((char *) buf + done,
+					conn->recv_ahead.buf + conn->recv_ahead.off,
+					copy_len);
+			conn->recv_ahead.off += copy_len;
+			done += copy_len;
+			continue;
+		}
+
+		if (read_ahead) {
+			ret = recv_ahead_fill(conn);
+			if (ret > 0) {
+				continue;
+			} else if (ret == 0 || ret == -1) {
+				goto end;
+			}
+			/* Nothing available yet, wait for the rest below. */
+		}
+
+		ret = conn->sock->ops->recvmsg(conn->sock, (char *) buf + done,
+				len - done, 0);
+		if (ret <= 0) {
+			goto end;
+		}
+		done += ret;
+	}
+	ret = len;
+end:
+	return ret;
+}
+
+/*
+ * Append "len" bytes of "buf" to the current tracefile of a data stream. The
+ * write is only queued if the stream has an io_uring writer; it is completed
+ * by stream_drain_writes().
+ *
+ * Called with the stream lock held.
+ * Return 0 on success or else a negative value.
+ */
+static int write_stream_data(struct relay_stream *stream, const void *buf,
+		size_t len)
+{
+	int ret = 0;
+	ssize_t size_ret;
+	int fd = stream->stream_fd->fd;
+
+	if (stream->io_uring) {
+		size_ret = lttng_io_uring_write(stream->io_uring, fd, buf, len,
+				(off_t) stream->tracefile_size_current);
+	} else {
+		size_ret = lttng_write(fd, buf, len);
+	}
+	if (size_ret < (ssize_t) len) {
+		ERR("Relay error writing data to file");
+		ret = -1;
+		goto end;
+	}
+	stream->tracefile_size_current += len;
+	DBG2("Relay wrote %zu bytes to tracefile fd %d", len, fd);
+end:
+	return ret;
+}
+
+/*
+ * Append "size" bytes of padding to the current tracefile of a data stream.
+ *
+ * Called with the stream lock held.
+ * Return 0 on success or else a negative value.
+ */
+static int write_stream_padding(struct relay_stream *stream, uint32_t size)
+{
+	int ret = 0;
+
+	if (size == 0) {
+		goto end;
+	}
+
+	/*
+	 * The io_uring writes are queued at explicit offsets below the end of
+	 * the tracefile, extending it does not race with them.
+	 */
+	if (!extend_file_sparse(stream->stream_fd->fd,
+			(off_t) stream->tracefile_size_current, size)) {
+		stream->tracefile_size_current += size;
+		goto end;
+	}
+
+	while (size) {
+		size_t len = min_t(size_t, size, sizeof(padding_zeros));
+
+		ret = write_stream_data(stream, padding_zeros, len);
+		if (ret < 0) {
+			goto end;
+		}
+		size -= len;
+	}
+end:
+	return ret;
+}
+
+/*
+ * Write to the output file of a data stream the bytes of the payload of a
+ * data packet already received in the receive-ahead buffer of its
+ * connection, up to "*len" bytes. "*len" is decremented by the number of
+ * bytes written.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static int recv_ahead_write_to_file(struct relay_connection *conn,
+		struct relay_stream *stream, size_t *len)
+{
+	int ret = 0;
+	size_t write_len = min(recv_ahead_pending(conn), *len);
+
+	if (!write_len) {
+		goto end;
+	}
+
+	ret = write_stream_data(stream,
+			conn->recv_ahead.buf + conn->recv_ahead.off, write_len);
+	if (ret < 0) {
+		goto end;
+	}
+	conn->recv_ahead.off += write_len;
+	*len -= write_len;
+end:
+	return ret;
+}
+
+/*
+ * Move "len" bytes of trace data received on a data connection to the output
+ * file of a data stream through the worker's splice pipe, without copying
+ * them through user space. The data of the streams written with io_uring is
+ * not spliced.
+ *
+ * Return 0 on success, 1 if the data could not be spliced but nothing was
+ * consumed from the socket, in which case the caller copies it, or else a
+ * negative value.
+ */
+static int splice_data_to_file(struct relay_connection *conn,
+		struct relay_stream *stream, size_t len)
+{
+	int ret = 0;
+	bool consumed = false;
+	int fd = stream->stream_fd->fd;
+	struct relay_splice_pipe *sp = &URCU_TLS(worker_splice_pipe);
+
+	if (sp->unsupported || stream->io_uring) {
+		ret = 1;
+		goto end;
+	}
+	if (!sp->created) {
+		ret = utils_create_pipe_cloexec(sp->fds);
+		if (ret) {
+			ret = 1;
+			goto end;
+		}
+		sp->created = true;
+	}
+
+	while (len > 0) {
+		ssize_t in;
+
+		in = splice(conn->sock->fd, NULL, sp->fds[1], NULL, len,
+				SPLICE_F_MOVE | SPLICE_F_MORE);
+		if (in < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (!consumed) {
+				if (errno == EINVAL || errno == ENOSYS) {
+					DBG("Splice not supported on sock %d, copying the data",
+							conn->sock->fd);
+					sp->unsupported = true;
+				}
+				ret = 1;
+				goto end;
+			}
+			PERROR("splice from sock %d", conn->sock->fd);
+			ret = -1;
+			goto end;
+		} else if (in == 0) {
+			/* Orderly shutdown. Not necessary to print an error. */
+			DBG("Socket %d did an orderly shutdown", conn->sock->fd);
+			ret = -1;
+			goto end;
+		}
+		consumed = true;
+		len -= in;
+
+		while (in > 0) {
+			ssize_t out;
+
+			out = splice(sp->fds[0], NULL, fd, NULL, in,
+					SPLICE_F_MOVE | SPLICE_F_MORE);
+			if (out < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				PERROR("splice to stream fd %d", fd);
+				/* The pipe holds stale data, recreate it on next use. */
+				utils_close_pipe(sp->fds);
+				sp->created = false;
+				ret = -1;
+				goto end;
+			}
+			in -= out;
+			stream->tracefile_size_current += out;
+		}
+	}
+end:
+	return ret;
+}
+
+/*
+ * Copy "len" bytes of trace data received on a data connection to the output
+ * file of a data stream.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static int copy_data_to_file(struct relay_connection *conn,
+		struct relay_stream *stream, size_t len)
+{
+	int ret = 0;
+	size_t chunk_size = RECV_DATA_BUFFER_SIZE;
+	size_t recv_off = 0;
+	char data_buffer[chunk_size];
+
+	for (recv_off = 0; recv_off < len; recv_off += chunk_size) {
+		size_t recv_size = min(len - recv_off, chunk_size);
+
+		ret = conn->sock->ops->recvmsg(conn->sock, data_buffer, recv_size, 0);
+		if (ret <= 0) {
+			if (ret == 0) {
+				/* Orderly shutdown. Not necessary to print an error. */
+				DBG("Socket %d did an orderly shutdown", conn->sock->fd);
+			} else {
+				ERR("Socket %d error %d", conn->sock->fd, ret);
+			}
+			ret = -1;
+			goto end;
+		}
 
-end_no_session:
+		/* Write data to stream output fd. */
+		ret = write_stream_data(stream, data_buffer, recv_size);
+		if (ret < 0) {
+			goto end;
+		}
+	}
+	ret = 0;
+end:
 	return ret;
 }
 
 /*
- * Process the commands received on the control socket
+ * Release the stream of the last data packet received on a data connection.
  */
-static int relay_process_control(struct lttcomm_relayd_hdr *recv_hdr,
-		struct relay_connection *conn)
+static void data_conn_put_stream(struct relay_connection *conn)
 {
-	int ret = 0;
+	if (conn->last_stream) {
+		stream_put(conn->last_stream);
+		conn->last_stream = NULL;
+	}
+}
 
-	switch (be32toh(recv_hdr->cmd)) {
-	case RELAYD_CREATE_SESSION:
-		ret = relay_create_session(recv_hdr, conn);
-		break;
-	case RELAYD_ADD_STREAM:
-		ret = relay_add_stream(recv_hdr, conn);
-		break;
-	case RELAYD_START_DATA:
-		ret = relay_start(recv_hdr, conn);
-		break;
-	case RELAYD_SEND_METADATA:
-		ret = relay_recv_metadata(recv_hdr, conn);
-		break;
-	case RELAYD_VERSION:
-		ret = relay_send_version(recv_hdr, conn);
-		break;
-	case RELAYD_CLOSE_STREAM:
-		ret = relay_close_stream(recv_hdr, conn);
-		break;
-	case RELAYD_DATA_PENDING:
-		ret = relay_data_pending(recv_hdr, conn);
-		break;
-	case RELAYD_QUIESCENT_CONTROL:
-		ret = relay_quiescent_control(recv_hdr, conn);
-		break;
-	case RELAYD_BEGIN_DATA_PENDING:
-		ret = relay_begin_data_pending(recv_hdr, conn);
-		break;
-	case RELAYD_END_DATA_PENDING:
-		ret = relay_end_data_pending(recv_hdr, conn);
-		break;
-	case RELAYD_SEND_INDEX:
-		ret = relay_recv_index(recv_hdr, conn);
-		break;
-	case RELAYD_STREAMS_SENT:
-		ret = relay_streams_sent(recv_hdr, conn);
-		break;
-	case RELAYD_RESET_METADATA:
-		ret = relay_reset_metadata(recv_hdr, conn);
-		break;
-	case RELAYD_UPDATE_SYNC_INFO:
-	default:
-		ERR("Received unknown command (%u)", be32toh(recv_hdr->cmd));
-		relay_unknown_command(conn);
-		ret = -1;
+/*
+ * Get the stream of a data packet received on a data connection. Consecutive
+ * packets of a stream skip the stream lookup: the connection keeps a
+ * reference on the stream of the last packet, which is also the reference
+ * the caller uses.
+ *
+ * Return the stream or NULL if it is not found.
+ */
+static struct relay_stream *data_conn_get_stream(struct relay_connection *conn,
+		uint64_t stream_id)
+{
+	struct relay_stream *stream = conn->last_stream;
+
+	if (stream && stream->stream_handle == stream_id) {
 		goto end;
 	}
-
+	data_conn_put_stream(conn);
+	stream = stream_get_by_id(stream_id);
+	conn->last_stream = stream;
 end:
-	return ret;
+	return stream;
 }
 
 /*
- * Handle index for a data stream.
+ * Receive the compressed packet frame of "len" bytes of a data packet flagged
+ * RELAYD_DATA_COMPRESSED and inflate it. On success, "content" points to the
+ * packet content, valid until the next packet of the worker.
  *
- * Called with the stream lock held.
- *
- * Return 0 on success else a negative value.
+ * Return the packet content size or else a negative value.
  */
-static int handle_index_data(struct relay_stream *stream, uint64_t net_seq_num,
-		int rotate_index)
+static ssize_t recv_compressed_packet(struct relay_connection *conn,
+		size_t len, bool read_ahead, const void **content)
 {
-	int ret = 0;
-	uint64_t data_offset;
-	struct relay_index *index;
-
-	/* Get data offset because we are about to update the index. */
-	data_offset = htobe64(stream->tracefile_size_current);
-
-	DBG("handle_index_data: stream %" PRIu64 " net_seq_num %" PRIu64 " data offset %" PRIu64,
-			stream->stream_handle, net_seq_num, stream->tracefile_size_current);
+	ssize_t ret;
+	void *frame;
 
-	/*
-	 * Lookup for an existing index for that stream id/sequence
-	 * number. If it exists, the control thread has already received the
-	 * data for it, thus we need to write it to disk.
-	 */
-	index = relay_index_get_by_id_or_create(stream, net_seq_num);
-	if (!index) {
+	frame = relay_wire_frame_buffer(len);
+	if (!frame) {
+		ERR("Cannot receive a compressed packet of %zu bytes on sock %d",
+				len, conn->sock->fd);
 		ret = -1;
 		goto end;
 	}
 
-	if (rotate_index || !stream->index_file) {
-		uint32_t major, minor;
-
-		/* Put ref on previous index_file. */
-		if (stream->index_file) {
-			lttng_index_file_put(stream->index_file);
-			stream->index_file = NULL;
-		}
-		major = stream->trace->session->major;
-		minor = stream->trace->session->minor;
-		stream->index_file = lttng_index_file_create(stream->path_name,
-				stream->channel_name,
-			        -1, -1, stream->tracefile_size,
-				tracefile_array_get_file_index_head(stream->tfa),
-				lttng_to_index_major(major, minor),
-				lttng_to_index_minor(major, minor));
-		if (!stream->index_file) {
-			ret = -1;
-			/* Put self-ref for this index due to error. */
-			relay_index_put(index);
-			index = NULL;
-			goto end;
+	ret = data_conn_recv(conn, frame, len, read_ahead);
+	if (ret <= 0) {
+		if (ret == 0) {
+			/* Orderly shutdown. Not necessary to print an error. */
+			DBG("Socket %d did an orderly shutdown", conn->sock->fd);
+		} else {
+			ERR("Socket %d error %zd", conn->sock->fd, ret);
 		}
-	}
-
-	if (relay_index_set_file(index, stream->index_file, data_offset)) {
 		ret = -1;
-		/* Put self-ref for this index due to error. */
-		relay_index_put(index);
-		index = NULL;
 		goto end;
 	}
 
-	ret = relay_index_try_flush(index);
-	if (ret == 0) {
-		tracefile_array_commit_seq(stream->tfa);
-		stream->index_received_seqcount++;
-	} else if (ret > 0) {
-		/* No flush. */
-		ret = 0;
-	} else {
-		/* Put self-ref for this index due to error. */
-		relay_index_put(index);
-		index = NULL;
-		ret = -1;
-	}
+	ret = relay_wire_inflate(frame, len, content);
 end:
 	return ret;
 }
 
 /*
  * relay_process_data: Process the data received on the data socket
+ *
+ * With "read_ahead", the packets following this one may be received at the
+ * same time in the receive-ahead buffer of the connection, unless the packets
+ * of the connection are too large to benefit from it; their payload is then
+ * better spliced.
  */
-static int relay_process_data(struct relay_connection *conn)
+static int relay_process_data(struct relay_connection *conn, bool read_ahead)
 {
 	int ret = 0, rotate_index = 0;
-	ssize_t size_ret;
+	size_t payload_left;
 	struct relay_stream *stream;
 	struct lttcomm_relayd_data_hdr data_hdr;
 	uint64_t stream_id;
 	uint64_t net_seq_num;
 	uint32_t data_size;
+	uint64_t start_ns, elapsed_ns;
 	struct relay_session *session;
 	bool new_stream = false, close_requested = false;
-	size_t chunk_size = RECV_DATA_BUFFER_SIZE;
-	size_t recv_off = 0;
-	char data_buffer[chunk_size];
+	const void *content = NULL;
 
-	ret = conn->sock->ops->recvmsg(conn->sock, &data_hdr,
-			sizeof(struct lttcomm_relayd_data_hdr), 0);
+	read_ahead = read_ahead && conn->recv_ahead.last_data_size <
+			RECV_AHEAD_BUFFER_SIZE / 4;
+	ret = data_conn_recv(conn, &data_hdr,
+			sizeof(struct lttcomm_relayd_data_hdr), read_ahead);
 	if (ret <= 0) {
 		if (ret == 0) {
 			/* Orderly shutdown. Not necessary to print an error. */
@@ -2281,7 +3658,7 @@ static int relay_process_data(struct relay_connection *conn)
 	}
 
 	stream_id = be64toh(data_hdr.stream_id);
-	stream = stream_get_by_id(stream_id);
+	stream = data_conn_get_stream(conn, stream_id);
 	if (!stream) {
 		ERR("relay_process_data: Cannot find stream %" PRIu64, stream_id);
 		ret = -1;
@@ -2289,35 +3666,64 @@ static int relay_process_data(struct relay_connection *conn)
 	}
 	session = stream->trace->session;
 	data_size = be32toh(data_hdr.data_size);
+	conn->recv_ahead.last_data_size = data_size;
 
 	net_seq_num = be64toh(data_hdr.net_seq_num);
 
 	DBG3("Receiving data of size %u for stream id %" PRIu64 " seqnum %" PRIu64,
 		data_size, stream_id, net_seq_num);
 
+	if (be64toh(data_hdr.flags) & RELAYD_DATA_COMPRESSED) {
+		ssize_t content_size;
+
+		/* Inflated outside of the stream lock, in a worker buffer. */
+		content_size = recv_compressed_packet(conn, data_size,
+				read_ahead, &content);
+		if (content_size < 0) {
+			ret = -1;
+			goto end;
+		}
+		/* The tracefile and the index see the inflated packet. */
+		data_size = content_size;
+	}
+
 	pthread_mutex_lock(&stream->lock);
 
+	/* The cached stream may have been closed since the last packet. */
+	if (stream->closed) {
+		pthread_mutex_unlock(&stream->lock);
+		data_conn_put_stream(conn);
+		ERR("relay_process_data: Cannot find stream %" PRIu64, stream_id);
+		ret = -1;
+		goto end;
+	}
+
 	/* Check if a rotation is needed. */
 	if (stream->tracefile_size > 0 &&
 			(stream->tracefile_size_current + data_size) >
 			stream->tracefile_size) {
-		uint64_t old_id, new_id;
+		uint64_t old_id;
+
+		/* The batched indexes belong to the current tracefile. */
+		ret = relay_index_batch_flush(stream);
+		if (ret < 0) {
+			ERR("Failed to write the batched indexes of stream %" PRIu64,
+					stream->stream_handle);
+			goto end_stream_unlock;
+		}
 
 		old_id = tracefile_array_get_file_index_head(stream->tfa);
 		tracefile_array_file_rotate(stream->tfa);
 
-		/* new_id is updated by utils_rotate_stream_file. */
-		new_id = old_id;
-
-		ret = utils_rotate_stream_file(stream->path_name,
-				stream->channel_name, stream->tracefile_size,
-				stream->tracefile_count, -1,
-			        -1, stream->stream_fd->fd,
-				&new_id, &stream->stream_fd->fd);
+		start_ns = lttng_monotonic_time_ns();
+		ret = tracefile_manager_rotate(stream, old_id);
 		if (ret < 0) {
 			ERR("Rotating stream output file");
 			goto end_stream_unlock;
 		}
+		stream->stats.rotations++;
+		stream->stats.rotation_ns +=
+				lttng_monotonic_time_ns() - start_ns;
 		/*
 		 * Reset current size because we just performed a stream
 		 * rotation.
@@ -2325,12 +3731,15 @@ static int relay_process_data(struct relay_connection *conn)
 		stream->tracefile_size_current = 0;
 		rotate_index = 1;
 	}
+	/* Have the next tracefile ready before this one is full. */
+	tracefile_manager_prepare(stream);
 
 	/*
-	 * Index are handled in protocol version 2.4 and above. Also,
-	 * snapshot and index are NOT supported.
+	 * Index are handled in protocol version 2.4 and above, and for the
+	 * snapshot sessions with RELAYD_FEATURE_SNAPSHOT_INDEX.
 	 */
-	if (session->minor >= 4 && !session->snapshot) {
+	if (session->minor >= 4 && (!session->snapshot ||
+			(session->features & RELAYD_FEATURE_SNAPSHOT_INDEX))) {
 		ret = handle_index_data(stream, net_seq_num, rotate_index);
 		if (ret < 0) {
 			ERR("handle_index_data: fail stream %" PRIu64 " net_seq_num %" PRIu64 " ret %d",
@@ -2339,43 +3748,49 @@ static int relay_process_data(struct relay_connection *conn)
 		}
 	}
 
-	for (recv_off = 0; recv_off < data_size; recv_off += chunk_size) {
-		size_t recv_size = min(data_size - recv_off, chunk_size);
+	if (opt_io_uring_depth && stream->prev_seq == -1ULL &&
+			!stream->io_uring) {
+		/* Fall back to blocking writes on error. */
+		stream->io_uring = lttng_io_uring_create(opt_io_uring_depth);
+	}
 
-		ret = conn->sock->ops->recvmsg(conn->sock, data_buffer, recv_size, 0);
-		if (ret <= 0) {
-			if (ret == 0) {
-				/* Orderly shutdown. Not necessary to print an error. */
-				DBG("Socket %d did an orderly shutdown", conn->sock->fd);
-			} else {
-				ERR("Socket %d error %d", conn->sock->fd, ret);
-			}
-			ret = -1;
+	start_ns = lttng_monotonic_time_ns();
+	payload_left = data_size;
+	if (content) {
+		ret = write_stream_data(stream, content, data_size);
+		if (ret < 0) {
 			goto end_stream_unlock;
 		}
-
-		/* Write data to stream output fd. */
-		size_ret = lttng_write(stream->stream_fd->fd, data_buffer,
-				recv_size);
-		if (size_ret < recv_size) {
-			ERR("Relay error writing data to file");
-			ret = -1;
+		payload_left = 0;
+	}
+	ret = recv_ahead_write_to_file(conn, stream, &payload_left);
+	if (ret < 0) {
+		goto end_stream_unlock;
+	}
+	if (payload_left) {
+		ret = splice_data_to_file(conn, stream, payload_left);
+		if (ret > 0) {
+			ret = copy_data_to_file(conn, stream, payload_left);
+		}
+		if (ret < 0) {
 			goto end_stream_unlock;
 		}
-
-		DBG2("Relay wrote %zd bytes to tracefile for stream id %" PRIu64,
-				size_ret, stream->stream_handle);
 	}
+	DBG2("Relay wrote %" PRIu32 " bytes to tracefile for stream id %" PRIu64,
+			data_size, stream->stream_handle);
 
-	ret = write_padding_to_file(stream->stream_fd->fd,
-			be32toh(data_hdr.padding_size));
+	ret = write_stream_padding(stream, be32toh(data_hdr.padding_size));
 	if (ret < 0) {
-		ERR("write_padding_to_file: fail stream %" PRIu64 " net_seq_num %" PRIu64 " ret %d",
+		ERR("write_stream_padding: fail stream %" PRIu64 " net_seq_num %" PRIu64 " ret %d",
 				stream->stream_handle, net_seq_num, ret);
 		goto end_stream_unlock;
 	}
-	stream->tracefile_size_current +=
-			data_size + be32toh(data_hdr.padding_size);
+	elapsed_ns = lttng_monotonic_time_ns() - start_ns;
+	self_tracepoint(relayd_data_packet, stream_id, net_seq_num, data_size,
+			elapsed_ns);
+	relay_stats_add_packet(&stream->stats, data_size, elapsed_ns);
+	relay_stats_add_packet(&conn->stats, data_size, elapsed_ns);
+	session_update_write_lag(session, elapsed_ns);
 	if (stream->prev_seq == -1ULL) {
 		new_stream = true;
 	}
@@ -2385,16 +3800,16 @@ static int relay_process_data(struct relay_connection *conn)
 end_stream_unlock:
 	close_requested = stream->close_requested;
 	pthread_mutex_unlock(&stream->lock);
-	if (close_requested) {
-		try_stream_close(stream);
-	}
-
 	if (new_stream) {
 		pthread_mutex_lock(&session->lock);
 		uatomic_set(&session->new_streams, 1);
 		pthread_mutex_unlock(&session->lock);
 	}
-	stream_put(stream);
+	if (close_requested) {
+		try_stream_close(stream);
+		/* Don't keep a closing stream alive. */
+		data_conn_put_stream(conn);
+	}
 end:
 	return ret;
 }
@@ -2438,10 +3853,13 @@ static void relay_thread_close_connection(struct lttng_poll_event *events,
 }
 
 /*
- * This thread does the actual work
+ * This thread does the actual work on the connections handed to it by the
+ * dispatcher. Several workers can run concurrently; the sessions and streams
+ * they share are refcounted and protected by their own locks.
  */
 static void *relay_thread_worker(void *data)
 {
+	struct relay_worker *worker = data;
 	int ret, err = -1, last_seen_data_fd = -1;
 	uint32_t nb_fd;
 	struct lttng_poll_event events;
@@ -2453,6 +3871,7 @@ static void *relay_thread_worker(void *data)
 	DBG("[thread] Relay worker started");
 
 	rcu_register_thread();
+	lttng_ht_thread_batch_start();
 
 	health_register(health_relayd, HEALTH_RELAYD_TYPE_WORKER);
 
@@ -2473,7 +3892,7 @@ static void *relay_thread_worker(void *data)
 		goto error_poll_create;
 	}
 
-	ret = lttng_poll_add(&events, relay_conn_pipe[0], LPOLLIN | LPOLLRDHUP);
+	ret = lttng_poll_add(&events, worker->conn_pipe[0], LPOLLIN | LPOLLRDHUP);
 	if (ret < 0) {
 		goto error;
 	}
@@ -2484,6 +3903,9 @@ restart:
 
 		health_code_update();
 
+		/* Release the objects freed since the last wait at once. */
+		lttng_ht_thread_batch_flush();
+
 		/* Infinite blocking call, waiting for transmission */
 		DBG3("Relayd worker thread polling...");
 		health_poll_entry();
@@ -2529,17 +3951,21 @@ restart:
 			}
 
 			/* Inspect the relay conn pipe for new connection */
-			if (pollfd == relay_conn_pipe[0]) {
+			if (pollfd == worker->conn_pipe[0]) {
 				if (revents & LPOLLIN) {
 					struct relay_connection *conn;
 
-					ret = lttng_read(relay_conn_pipe[0], &conn, sizeof(conn));
+					ret = lttng_read(worker->conn_pipe[0], &conn,
+							sizeof(conn));
 					if (ret < 0) {
 						goto error;
 					}
 					lttng_poll_add(&events, conn->sock->fd,
 							LPOLLIN | LPOLLRDHUP);
 					connection_ht_add(relay_connections_ht, conn);
+					if (conn->type == RELAY_DATA) {
+						relay_stats_register_connection(conn);
+					}
 					DBG("Connection socket %d added", conn->sock->fd);
 				} else if (revents & (LPOLLERR | LPOLLHUP | LPOLLRDHUP)) {
 					ERR("Relay connection pipe error");
@@ -2637,7 +4063,7 @@ restart:
 			}
 
 			/* Skip the command pipe. It's handled in the first loop. */
-			if (pollfd == relay_conn_pipe[0]) {
+			if (pollfd == worker->conn_pipe[0]) {
 				continue;
 			}
 
@@ -2652,7 +4078,19 @@ restart:
 			assert(data_conn->type == RELAY_DATA);
 
 			if (revents & LPOLLIN) {
-				ret = relay_process_data(data_conn);
+				unsigned int nb_packets = 0;
+
+				/*
+				 * Process the packets already received in the
+				 * receive-ahead buffer of the connection, which poll
+				 * cannot report, before polling again. The buffer is
+				 * not refilled after RECV_AHEAD_MAX_PACKETS packets
+				 * so the other connections are not starved.
+				 */
+				do {
+					ret = relay_process_data(data_conn,
+							nb_packets++ < RECV_AHEAD_MAX_PACKETS);
+				} while (ret >= 0 && recv_ahead_pending(data_conn));
 				/* Connection closed */
 				if (ret < 0) {
 					relay_thread_close_connection(&events, pollfd,
@@ -2711,7 +4149,12 @@ error_poll_create:
 	lttng_ht_destroy(relay_connections_ht);
 relay_connections_ht_error:
 	/* Close relay conn pipes */
-	utils_close_pipe(relay_conn_pipe);
+	utils_close_pipe(worker->conn_pipe);
+	free(URCU_TLS(worker_data_buffer));
+	relay_wire_compress_fini();
+	if (URCU_TLS(worker_splice_pipe).created) {
+		utils_close_pipe(URCU_TLS(worker_splice_pipe).fds);
+	}
 	if (err) {
 		DBG("Thread exited with error");
 	}
@@ -2722,21 +4165,38 @@ error_testpoint:
 		ERR("Health error occurred in %s", __func__);
 	}
 	health_unregister(health_relayd);
+	lttng_ht_thread_batch_stop();
 	rcu_unregister_thread();
 	lttng_relay_stop_threads();
 	return NULL;
 }
 
 /*
- * Create the relay command pipe to wake thread_manage_apps.
- * Closed in cleanup().
+ * Allocate the workers and create their connection pipes. The pipe of a worker
+ * is closed by the worker thread, or in main() if it is not started.
  */
-static int create_relay_conn_pipe(void)
+static int create_relay_workers(void)
 {
-	int ret;
+	int ret = 0;
+	unsigned int i;
 
-	ret = utils_create_pipe_cloexec(relay_conn_pipe);
+	workers = zmalloc(opt_workers * sizeof(*workers));
+	if (!workers) {
+		PERROR("zmalloc relay workers");
+		ret = -1;
+		goto end;
+	}
 
+	for (i = 0; i < opt_workers; i++) {
+		workers[i].conn_pipe[0] = workers[i].conn_pipe[1] = -1;
+	}
+	for (i = 0; i < opt_workers; i++) {
+		ret = utils_create_pipe_cloexec(workers[i].conn_pipe);
+		if (ret) {
+			goto end;
+		}
+	}
+end:
 	return ret;
 }
 
@@ -2746,6 +4206,7 @@ static int create_relay_conn_pipe(void)
 int main(int argc, char **argv)
 {
 	int ret = 0, retval = 0;
+	unsigned int i;
 	void *status;
 
 	/* Parse arguments */
@@ -2777,6 +4238,16 @@ int main(int argc, char **argv)
 		}
 	}
 
+	if (opt_stripe_paths && stripe_set_roots(opt_stripe_paths)) {
+		retval = -1;
+		goto exit_options;
+	}
+
+	if (opt_metadata_dedup && metadata_store_enable()) {
+		retval = -1;
+		goto exit_options;
+	}
+
 	/* Daemonize */
 	if (opt_daemon || opt_background) {
 		int i;
@@ -2812,8 +4283,31 @@ int main(int argc, char **argv)
 		goto exit_init_data;
 	}
 
-	/* Setup the thread apps communication pipe. */
-	if (create_relay_conn_pipe()) {
+	if (opt_io_uring_depth) {
+		ret = lttng_io_uring_probe();
+		if (ret < 0) {
+			WARN("io_uring is not supported (%s), using blocking writes",
+					strerror(-ret));
+			opt_io_uring_depth = 0;
+		}
+	}
+
+	if (opt_listeners > opt_workers) {
+		WARN("Limiting the listener threads to the %u worker thread(s)",
+				opt_workers);
+		opt_listeners = opt_workers;
+	}
+	if (opt_listeners > 1 && (control_uri->dtype == LTTNG_DST_UNIX ||
+			data_uri->dtype == LTTNG_DST_UNIX)) {
+		/* A Unix socket path can't be shared by several listeners. */
+		WARN("Using a single listener thread for the Unix sockets");
+		opt_listeners = 1;
+	}
+	/* Each listener notifies its readiness. */
+	lttng_relay_ready += opt_listeners - 1;
+
+	/* Setup the worker threads communication pipes. */
+	if (create_relay_workers()) {
 		retval = -1;
 		goto exit_init_data;
 	}
@@ -2826,21 +4320,21 @@ int main(int argc, char **argv)
 	lttcomm_inet_init();
 
 	/* tables of sessions indexed by session ID */
-	sessions_ht = lttng_ht_new(0, LTTNG_HT_TYPE_U64);
+	sessions_ht = lttng_ht_new(0, LTTNG_HT_TYPE_FAST_U64);
 	if (!sessions_ht) {
 		retval = -1;
 		goto exit_init_data;
 	}
 
 	/* tables of streams indexed by stream ID */
-	relay_streams_ht = lttng_ht_new(0, LTTNG_HT_TYPE_U64);
+	relay_streams_ht = lttng_ht_new(0, LTTNG_HT_TYPE_FAST_U64);
 	if (!relay_streams_ht) {
 		retval = -1;
 		goto exit_init_data;
 	}
 
 	/* tables of streams indexed by stream ID */
-	viewer_streams_ht = lttng_ht_new(0, LTTNG_HT_TYPE_U64);
+	viewer_streams_ht = lttng_ht_new(0, LTTNG_HT_TYPE_FAST_U64);
 	if (!viewer_streams_ht) {
 		retval = -1;
 		goto exit_init_data;
@@ -2862,6 +4356,17 @@ int main(int argc, char **argv)
 		goto exit_health_thread;
 	}
 
+	/* Setup the tracefile manager thread */
+	tracefile_manager_init();
+	ret = pthread_create(&tracefile_manager_thread_id, default_pthread_attr(),
+			tracefile_manager_thread, (void *) NULL);
+	if (ret) {
+		errno = ret;
+		PERROR("pthread_create tracefile manager");
+		retval = -1;
+		goto exit_tracefile_manager_thread;
+	}
+
 	/* Setup the dispatcher thread */
 	ret = pthread_create(&dispatcher_thread, default_pthread_attr(),
 			relay_thread_dispatcher, (void *) NULL);
@@ -2872,27 +4377,45 @@ int main(int argc, char **argv)
 		goto exit_dispatcher_thread;
 	}
 
-	/* Setup the worker thread */
-	ret = pthread_create(&worker_thread, default_pthread_attr(),
-			relay_thread_worker, NULL);
-	if (ret) {
-		errno = ret;
-		PERROR("pthread_create worker");
-		retval = -1;
-		goto exit_worker_thread;
+	/* Setup the worker threads */
+	for (i = 0; i < opt_workers; i++) {
+		ret = pthread_create(&workers[i].thread, default_pthread_attr(),
+				relay_thread_worker, &workers[i]);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_create worker");
+			retval = -1;
+			/* Stop the dispatcher and the workers already started. */
+			(void) lttng_relay_stop_threads();
+			goto exit_worker_thread;
+		}
+		nr_workers_started++;
 	}
+	DBG("Started %u worker thread(s)", opt_workers);
 
-	/* Setup the listener thread */
-	ret = pthread_create(&listener_thread, default_pthread_attr(),
-			relay_thread_listener, (void *) NULL);
-	if (ret) {
-		errno = ret;
-		PERROR("pthread_create listener");
+	/* Setup the listener threads */
+	listeners = zmalloc(opt_listeners * sizeof(*listeners));
+	if (!listeners) {
+		PERROR("zmalloc relay listeners");
 		retval = -1;
+		(void) lttng_relay_stop_threads();
 		goto exit_listener_thread;
 	}
+	for (i = 0; i < opt_listeners; i++) {
+		listeners[i].id = i;
+		ret = pthread_create(&listeners[i].thread, default_pthread_attr(),
+				relay_thread_listener, &listeners[i]);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_create listener");
+			retval = -1;
+			(void) lttng_relay_stop_threads();
+			goto exit_listener_thread;
+		}
+		nr_listeners_started++;
+	}
 
-	ret = relayd_live_create(live_uri);
+	ret = relayd_live_create(live_uri, opt_live_workers);
 	if (ret) {
 		ERR("Starting live viewer threads");
 		retval = -1;
@@ -2910,22 +4433,27 @@ int main(int argc, char **argv)
 	}
 exit_live:
 
-	ret = pthread_join(listener_thread, &status);
-	if (ret) {
-		errno = ret;
-		PERROR("pthread_join listener_thread");
-		retval = -1;
-	}
-
 exit_listener_thread:
-	ret = pthread_join(worker_thread, &status);
-	if (ret) {
-		errno = ret;
-		PERROR("pthread_join worker_thread");
-		retval = -1;
+	for (i = 0; i < nr_listeners_started; i++) {
+		ret = pthread_join(listeners[i].thread, &status);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_join listener_thread");
+			retval = -1;
+		}
 	}
+	free(listeners);
 
 exit_worker_thread:
+	for (i = 0; i < nr_workers_started; i++) {
+		ret = pthread_join(workers[i].thread, &status);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_join worker_thread");
+			retval = -1;
+		}
+	}
+
 	ret = pthread_join(dispatcher_thread, &status);
 	if (ret) {
 		errno = ret;
@@ -2934,6 +4462,16 @@ exit_worker_thread:
 	}
 exit_dispatcher_thread:
 
+	/* No worker can request tracefiles anymore. */
+	tracefile_manager_stop();
+	ret = pthread_join(tracefile_manager_thread_id, &status);
+	if (ret) {
+		errno = ret;
+		PERROR("pthread_join tracefile_manager_thread");
+		retval = -1;
+	}
+exit_tracefile_manager_thread:
+
 	ret = pthread_join(health_thread, &status);
 	if (ret) {
 		errno = ret;
@@ -2946,6 +4484,12 @@ exit_health_thread:
 exit_health_quit_pipe:
 
 exit_init_data:
+	if (workers) {
+		for (i = nr_workers_started; i < opt_workers; i++) {
+			utils_close_pipe(workers[i].conn_pipe);
+		}
+		free(workers);
+	}
 	health_app_destroy(health_relayd);
 exit_health_app_create:
 exit_options:
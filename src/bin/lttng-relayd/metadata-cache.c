@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <string.h>
+
+#include <common/common.h>
+
+#include "ctf-trace.h"
+#include "metadata-cache.h"
+
+/* Initial size of the cache of a stream. */
+#define METADATA_CACHE_MIN_LEN		4096
+
+static void metadata_cache_release(struct urcu_ref *ref)
+{
+	struct relay_metadata_cache *cache =
+		caa_container_of(ref, struct relay_metadata_cache, ref);
+
+	free(cache);
+}
+
+void metadata_cache_put(struct relay_metadata_cache *cache)
+{
+	if (!cache) {
+		return;
+	}
+	urcu_ref_put(&cache->ref, metadata_cache_release);
+}
+
+/*
+ * Replace the cache of a stream by a copy able to hold "len" bytes.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static int metadata_cache_grow(struct relay_stream *stream, size_t len)
+{
+	size_t alloc_len = METADATA_CACHE_MIN_LEN;
+	struct relay_metadata_cache *old = stream->metadata_cache, *cache;
+
+	if (old) {
+		alloc_len = max_t(size_t, alloc_len, old->alloc_len << 1);
+	}
+	alloc_len = max_t(size_t, alloc_len, len);
+
+	cache = malloc(sizeof(*cache) + alloc_len);
+	if (!cache) {
+		PERROR("malloc metadata cache");
+		return -1;
+	}
+	urcu_ref_init(&cache->ref);
+	cache->alloc_len = alloc_len;
+	cache->len = 0;
+	if (old) {
+		memcpy(cache->data, old->data, old->len);
+		cache->len = old->len;
+	}
+
+	stream->metadata_cache = cache;
+	metadata_cache_put(old);
+	return 0;
+}
+
+void metadata_cache_append(struct relay_stream *stream, const char *buf,
+		size_t len, size_t padding)
+{
+	struct relay_metadata_cache *cache;
+
+	if (!stream->trace->session->live_timer ||
+			stream->metadata_cache_disabled) {
+		return;
+	}
+
+	cache = stream->metadata_cache;
+	if (!cache || cache->len + len + padding > cache->alloc_len) {
+		if (metadata_cache_grow(stream, (cache ? cache->len : 0) +
+				len + padding)) {
+			DBG("Serving stream %" PRIu64 " metadata from its file",
+					stream->stream_handle);
+			metadata_cache_put(stream->metadata_cache);
+			stream->metadata_cache = NULL;
+			stream->metadata_cache_disabled = true;
+			return;
+		}
+		cache = stream->metadata_cache;
+	}
+
+	/* The viewers only read below the current length. */
+	memcpy(cache->data + cache->len, buf, len);
+	memset(cache->data + cache->len + len, 0, padding);
+	cache->len += len + padding;
+}
+
+struct relay_metadata_cache *metadata_cache_get(struct relay_stream *stream)
+{
+	struct relay_metadata_cache *cache = stream->metadata_cache;
+
+	if (cache) {
+		urcu_ref_get(&cache->ref);
+	}
+	return cache;
+}
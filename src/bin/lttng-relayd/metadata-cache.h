@@ -0,0 +1,64 @@
+#ifndef _METADATA_CACHE_H
+#define _METADATA_CACHE_H
+
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stddef.h>
+#include <urcu/ref.h>
+
+#include "stream.h"
+
+/*
+ * The metadata cache keeps the metadata of the live streams in memory so
+ * that the live viewers are served without reading the metadata file.
+ *
+ * The cache is append-only: the bytes below its length are never modified.
+ * When it has to grow, it is copied to a larger cache which replaces it in
+ * the stream, the viewers sending from the previous one keeping it alive
+ * through their reference.
+ */
+struct relay_metadata_cache {
+	struct urcu_ref ref;
+	/* Bytes of metadata in data. */
+	size_t len;
+	size_t alloc_len;
+	char data[];
+};
+
+/*
+ * Append "len" bytes of metadata and "padding" zeroes to the cache of a
+ * metadata stream, if it belongs to a live session. A stream whose cache
+ * can't grow is served from its metadata file from then on.
+ *
+ * Called with the stream lock held.
+ */
+void metadata_cache_append(struct relay_stream *stream, const char *buf,
+		size_t len, size_t padding);
+
+/*
+ * Get a reference on the cache of a metadata stream, released with
+ * metadata_cache_put().
+ *
+ * Called with the stream lock held.
+ * Return the cache or NULL if the stream has none.
+ */
+struct relay_metadata_cache *metadata_cache_get(struct relay_stream *stream);
+
+void metadata_cache_put(struct relay_metadata_cache *cache);
+
+#endif /* _METADATA_CACHE_H */
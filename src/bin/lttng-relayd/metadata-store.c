@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <common/common.h>
+#include <common/defaults.h>
+#include <common/utils.h>
+
+#include "metadata-store.h"
+#include "utils.h"
+
+#define METADATA_STORE_CHUNK	4096
+
+/* FNV-1a, 64-bit. */
+#define FNV64_OFFSET_BASIS	0xcbf29ce484222325ULL
+#define FNV64_PRIME		0x100000001b3ULL
+
+static char *store_path;
+
+int metadata_store_enable(void)
+{
+	int ret;
+
+	store_path = create_output_path(DEFAULT_RELAYD_METADATA_STORE_DIR);
+	if (!store_path) {
+		ret = -1;
+		goto end;
+	}
+	ret = utils_mkdir_recursive(store_path, S_IRWXU | S_IRWXG, -1, -1);
+	if (ret < 0) {
+		ERR("Unable to create the metadata store %s", store_path);
+		free(store_path);
+		store_path = NULL;
+	}
+end:
+	return ret;
+}
+
+/*
+ * Hash the content of a file.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static int hash_file(int fd, uint64_t *hash)
+{
+	ssize_t ret;
+	uint64_t h = FNV64_OFFSET_BASIS;
+	unsigned char buf[METADATA_STORE_CHUNK];
+
+	for (;;) {
+		ssize_t i;
+
+		ret = read(fd, buf, sizeof(buf));
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			PERROR("read metadata file");
+			return -1;
+		}
+		if (ret == 0) {
+			break;
+		}
+		for (i = 0; i < ret; i++) {
+			h ^= buf[i];
+			h *= FNV64_PRIME;
+		}
+	}
+	*hash = h;
+	return 0;
+}
+
+/*
+ * Return 1 if the files "fd_a" and "fd_b" of "size" bytes have the same
+ * content, 0 if they don't or else a negative value.
+ */
+static int same_content(int fd_a, int fd_b, off_t size)
+{
+	off_t offset;
+	char buf_a[METADATA_STORE_CHUNK], buf_b[METADATA_STORE_CHUNK];
+
+	for (offset = 0; offset < size; offset += sizeof(buf_a)) {
+		size_t len = min_t(off_t, size - offset, sizeof(buf_a));
+
+		if (pread(fd_a, buf_a, len, offset) != len ||
+				pread(fd_b, buf_b, len, offset) != len) {
+			PERROR("pread metadata file");
+			return -1;
+		}
+		if (memcmp(buf_a, buf_b, len)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+ * Replace the file "path" by a hard link to the stored file "stored_path",
+ * atomically so that a reader never misses the file.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static int link_stored_file(const char *stored_path, const char *path)
+{
+	int ret;
+	char tmp_path[PATH_MAX];
+
+	ret = snprintf(tmp_path, sizeof(tmp_path), "%s.dedup", path);
+	if (ret < 0 || ret >= sizeof(tmp_path)) {
+		ret = -1;
+		goto end;
+	}
+	(void) unlink(tmp_path);
+	ret = link(stored_path, tmp_path);
+	if (ret < 0) {
+		PERROR("link %s to %s", stored_path, tmp_path);
+		goto end;
+	}
+	ret = rename(tmp_path, path);
+	if (ret < 0) {
+		PERROR("rename %s to %s", tmp_path, path);
+		(void) unlink(tmp_path);
+	}
+end:
+	return ret;
+}
+
+void metadata_store_dedup(struct relay_stream *stream)
+{
+	int ret, fd = -1, stored_fd = -1;
+	uint64_t hash;
+	struct stat st, stored_st;
+	char path[PATH_MAX], stored_path[PATH_MAX];
+
+	if (!store_path || !stream->is_metadata || stream->tracefile_size) {
+		goto end;
+	}
+
+	ret = utils_stream_file_name(path, stream->path_name,
+			stream->channel_name, 0, 0, NULL);
+	if (ret < 0) {
+		goto end;
+	}
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		PERROR("open metadata file %s", path);
+		goto end;
+	}
+	if (fstat(fd, &st) < 0) {
+		PERROR("fstat metadata file %s", path);
+		goto end;
+	}
+	if (st.st_size == 0 || hash_file(fd, &hash)) {
+		goto end;
+	}
+
+	/* The size disambiguates most hash collisions, the content the rest. */
+	ret = snprintf(stored_path, sizeof(stored_path), "%s/%016" PRIx64 "-%" PRIu64,
+			store_path, hash, (uint64_t) st.st_size);
+	if (ret < 0 || ret >= sizeof(stored_path)) {
+		goto end;
+	}
+
+	ret = link(path, stored_path);
+	if (!ret) {
+		DBG("Metadata file %s stored as %s", path, stored_path);
+		goto end;
+	}
+	if (errno != EEXIST) {
+		PERROR("link %s to %s", path, stored_path);
+		goto end;
+	}
+
+	stored_fd = open(stored_path, O_RDONLY);
+	if (stored_fd < 0) {
+		PERROR("open stored metadata file %s", stored_path);
+		goto end;
+	}
+	if (fstat(stored_fd, &stored_st) < 0) {
+		PERROR("fstat stored metadata file %s", stored_path);
+		goto end;
+	}
+	if (stored_st.st_ino == st.st_ino && stored_st.st_dev == st.st_dev) {
+		goto end;
+	}
+	if (stored_st.st_size != st.st_size ||
+			same_content(fd, stored_fd, st.st_size) != 1) {
+		DBG("Metadata file %s collides with %s, not deduplicated",
+				path, stored_path);
+		goto end;
+	}
+
+	if (!link_stored_file(stored_path, path)) {
+		DBG("Metadata file %s deduplicated to %s", path, stored_path);
+	}
+end:
+	if (fd >= 0 && close(fd)) {
+		PERROR("close metadata file");
+	}
+	if (stored_fd >= 0 && close(stored_fd)) {
+		PERROR("close stored metadata file");
+	}
+}
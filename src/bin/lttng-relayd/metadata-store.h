@@ -0,0 +1,46 @@
+#ifndef _METADATA_STORE_H
+#define _METADATA_STORE_H
+
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stream.h"
+
+/*
+ * The metadata store deduplicates the metadata files of the traces written
+ * by the relayd. Once a metadata stream is closed, its file is looked up by
+ * content in the store directory of the output path: the first file of a
+ * given content is linked in the store and the identical files of the later
+ * sessions are replaced by hard links to it, so that fleets of identical
+ * services share a single metadata inode.
+ */
+
+/*
+ * Create the store directory. MUST be called before any worker thread is
+ * launched.
+ *
+ * Return 0 on success or else a negative value.
+ */
+int metadata_store_enable(void);
+
+/*
+ * Deduplicate the metadata file of a closed metadata stream. This is best
+ * effort: the file is left as is on error.
+ */
+void metadata_store_dedup(struct relay_stream *stream);
+
+#endif /* _METADATA_STORE_H */
@@ -37,7 +37,8 @@ static pthread_mutex_t last_relay_session_id_lock = PTHREAD_MUTEX_INITIALIZER;
  */
 struct relay_session *session_create(const char *session_name,
 		const char *hostname, uint32_t live_timer,
-		bool snapshot, uint32_t major, uint32_t minor)
+		bool snapshot, uint32_t major, uint32_t minor,
+		uint64_t features)
 {
 	struct relay_session *session;
 
@@ -65,9 +66,11 @@ struct relay_session *session_create(const char *session_name,
 
 	session->major = major;
 	session->minor = minor;
+	session->features = features;
 	lttng_ht_node_init_u64(&session->session_n, session->id);
 	urcu_ref_init(&session->ref);
 	CDS_INIT_LIST_HEAD(&session->recv_list);
+	CDS_INIT_LIST_HEAD(&session->stream_list);
 	pthread_mutex_init(&session->lock, NULL);
 	pthread_mutex_init(&session->recv_list_lock, NULL);
 
@@ -102,7 +105,7 @@ struct relay_session *session_get_by_id(uint64_t id)
 	struct lttng_ht_iter iter;
 
 	rcu_read_lock();
-	lttng_ht_lookup(sessions_ht, &id, &iter);
+	lttng_ht_lookup_fast_u64(sessions_ht, id, &iter);
 	node = lttng_ht_iter_get_node_u64(&iter);
 	if (!node) {
 		DBG("Session find by ID %" PRIu64 " id NOT found", id);
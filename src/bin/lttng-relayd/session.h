@@ -29,6 +29,8 @@
 #include <lttng/constant.h>
 #include <common/hashtable/hashtable.h>
 
+#include "stats.h"
+
 /*
  * Represents a session for the relay point of view
  */
@@ -60,6 +62,11 @@ struct relay_session {
 	/* major/minor version used for this session. */
 	uint32_t major;
 	uint32_t minor;
+	/*
+	 * Features negotiated by the connection creating the session, enum
+	 * lttcomm_relayd_feature.
+	 */
+	uint64_t features;
 
 	bool viewer_attached;
 	/* Tell if the session connection has been closed on the streaming side. */
@@ -75,6 +82,19 @@ struct relay_session {
 	/* Contains ctf_trace object of that session indexed by path name. */
 	struct lttng_ht *ctf_traces_ht;
 
+	/*
+	 * Statistics of the unpublished streams of the session. Protected by
+	 * the session lock.
+	 */
+	struct relay_stats stats;
+
+	/*
+	 * Moving average of the time taken to write a data packet of the
+	 * session (nsec), advertised to the consumers as backpressure.
+	 * Accessed without lock by the workers.
+	 */
+	uint64_t write_lag_ns;
+
 	/*
 	 * This contains streams that are received on that connection.
 	 * It's used to store them until we get the streams sent
@@ -89,6 +109,14 @@ struct relay_session {
 	uint32_t stream_count;
 	pthread_mutex_t recv_list_lock;
 
+	/*
+	 * Streams of the session found in the global stream hash table, so
+	 * that the session commands don't scan the streams of every session.
+	 * Updates are protected by the recv_list_lock. Traversals are
+	 * protected by RCU.
+	 */
+	struct cds_list_head stream_list;	/* RCU list. */
+
 	/*
 	 * Flag checked and exchanged with uatomic_cmpxchg to tell the
 	 * viewer-side if new streams got added since the last check.
@@ -110,7 +138,8 @@ struct relay_session {
 
 struct relay_session *session_create(const char *session_name,
 		const char *hostname, uint32_t live_timer,
-		bool snapshot, uint32_t major, uint32_t minor);
+		bool snapshot, uint32_t major, uint32_t minor,
+		uint64_t features);
 struct relay_session *session_get_by_id(uint64_t id);
 bool session_get(struct relay_session *session);
 void session_put(struct relay_session *session);
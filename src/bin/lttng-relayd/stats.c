@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include <pthread.h>
+#include <stdio.h>
+#include <urcu/list.h>
+#include <urcu/rculist.h>
+
+#include <common/common.h>
+#include <common/time.h>
+
+#include "connection.h"
+#include "ctf-trace.h"
+#include "lttng-relayd.h"
+#include "session.h"
+#include "stats.h"
+#include "stream.h"
+#include "utils.h"
+
+/* Connections part of the dumps. Protected by connections_lock. */
+static CDS_LIST_HEAD(connections);
+static pthread_mutex_t connections_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void relay_stats_add(struct relay_stats *dst, const struct relay_stats *src)
+{
+	dst->bytes += src->bytes;
+	dst->packets += src->packets;
+	dst->write_ns += src->write_ns;
+	dst->write_max_ns = max(dst->write_max_ns, src->write_max_ns);
+	dst->index_flushes += src->index_flushes;
+	dst->index_flush_ns += src->index_flush_ns;
+	dst->rotations += src->rotations;
+	dst->rotation_ns += src->rotation_ns;
+}
+
+void relay_stats_add_packet(struct relay_stats *stats, uint64_t len,
+		uint64_t elapsed_ns)
+{
+	stats->bytes += len;
+	stats->packets++;
+	stats->write_ns += elapsed_ns;
+	if (elapsed_ns > stats->write_max_ns) {
+		stats->write_max_ns = elapsed_ns;
+	}
+}
+
+void relay_stats_register_connection(struct relay_connection *conn)
+{
+	pthread_mutex_lock(&connections_lock);
+	cds_list_add_tail(&conn->stats_node, &connections);
+	pthread_mutex_unlock(&connections_lock);
+}
+
+void relay_stats_unregister_connection(struct relay_connection *conn)
+{
+	pthread_mutex_lock(&connections_lock);
+	if (!cds_list_empty(&conn->stats_node)) {
+		cds_list_del_init(&conn->stats_node);
+	}
+	pthread_mutex_unlock(&connections_lock);
+}
+
+static int print_stats(int fd, const struct relay_stats *stats)
+{
+	int ret;
+
+	ret = dprintf(fd, " bytes=%" PRIu64 " packets=%" PRIu64
+			" write_ns=%" PRIu64 " write_max_ns=%" PRIu64
+			" index_flushes=%" PRIu64 " index_flush_ns=%" PRIu64
+			" rotations=%" PRIu64 " rotation_ns=%" PRIu64 "\n",
+			CMM_LOAD_SHARED(stats->bytes),
+			CMM_LOAD_SHARED(stats->packets),
+			CMM_LOAD_SHARED(stats->write_ns),
+			CMM_LOAD_SHARED(stats->write_max_ns),
+			CMM_LOAD_SHARED(stats->index_flushes),
+			CMM_LOAD_SHARED(stats->index_flush_ns),
+			CMM_LOAD_SHARED(stats->rotations),
+			CMM_LOAD_SHARED(stats->rotation_ns));
+	return ret < 0 ? -1 : 0;
+}
+
+static int dump_connections(int fd)
+{
+	int ret = 0;
+	struct relay_connection *conn;
+
+	pthread_mutex_lock(&connections_lock);
+	cds_list_for_each_entry(conn, &connections, stats_node) {
+		ret = dprintf(fd, "connection sock=%d", conn->sock->fd);
+		if (ret < 0) {
+			break;
+		}
+		ret = print_stats(fd, &conn->stats);
+		if (ret < 0) {
+			break;
+		}
+	}
+	pthread_mutex_unlock(&connections_lock);
+	return ret < 0 ? -1 : 0;
+}
+
+/*
+ * Dump the streams of a session and the session, whose statistics are the
+ * ones of its streams, including the unpublished ones.
+ *
+ * Called with the RCU read lock held.
+ */
+static int dump_session(int fd, struct relay_session *session)
+{
+	int ret;
+	struct lttng_ht_iter iter;
+	struct ctf_trace *trace;
+	struct relay_stats stats;
+
+	pthread_mutex_lock(&session->lock);
+	stats = session->stats;
+	pthread_mutex_unlock(&session->lock);
+
+	cds_lfht_for_each_entry(session->ctf_traces_ht->ht, &iter.iter, trace,
+			node.node) {
+		struct relay_stream *stream;
+
+		cds_list_for_each_entry_rcu(stream, &trace->stream_list,
+				stream_node) {
+			ret = dprintf(fd, "stream id=%" PRIu64
+					" session=%" PRIu64 " path=%s channel=%s",
+					stream->stream_handle, session->id,
+					stream->path_name, stream->channel_name);
+			if (ret < 0) {
+				goto end;
+			}
+			ret = print_stats(fd, &stream->stats);
+			if (ret < 0) {
+				goto end;
+			}
+			relay_stats_add(&stats, &stream->stats);
+		}
+	}
+
+	ret = dprintf(fd, "session id=%" PRIu64 " name=%s hostname=%s",
+			session->id, session->session_name, session->hostname);
+	if (ret < 0) {
+		goto end;
+	}
+	ret = print_stats(fd, &stats);
+end:
+	return ret < 0 ? -1 : 0;
+}
+
+int relay_stats_dump(int fd)
+{
+	int ret;
+	struct lttng_ht_iter iter;
+	struct relay_session *session;
+
+	ret = dprintf(fd, "time_ns=%" PRIu64 "\n", lttng_monotonic_time_ns());
+	if (ret < 0) {
+		goto end;
+	}
+
+	ret = dump_connections(fd);
+	if (ret < 0) {
+		goto end;
+	}
+
+	rcu_read_lock();
+	cds_lfht_for_each_entry(sessions_ht->ht, &iter.iter, session,
+			session_n.node) {
+		if (!session_get(session)) {
+			continue;
+		}
+		ret = dump_session(fd, session);
+		session_put(session);
+		if (ret < 0) {
+			break;
+		}
+	}
+	rcu_read_unlock();
+end:
+	return ret < 0 ? -1 : 0;
+}
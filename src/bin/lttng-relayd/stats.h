@@ -0,0 +1,71 @@
+#ifndef _RELAYD_STATS_H
+#define _RELAYD_STATS_H
+
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <inttypes.h>
+
+struct relay_connection;
+
+/*
+ * Cumulative throughput and latency counters of a data connection, session
+ * or stream. They are updated by the single thread handling the connection
+ * or holding the stream lock, and read without synchronization when the
+ * statistics are dumped: a dump may be slightly behind but is never torn
+ * on 64-bit architectures.
+ */
+struct relay_stats {
+	/* Trace data received and written. */
+	uint64_t bytes;
+	uint64_t packets;
+	/* Time spent receiving and writing the data packets. */
+	uint64_t write_ns;
+	uint64_t write_max_ns;
+	/* Index batches written and time spent writing them. */
+	uint64_t index_flushes;
+	uint64_t index_flush_ns;
+	/* Tracefile rotations and time spent rotating. */
+	uint64_t rotations;
+	uint64_t rotation_ns;
+};
+
+void relay_stats_add(struct relay_stats *dst, const struct relay_stats *src);
+
+/*
+ * Account for a data packet of "len" bytes received and written in
+ * "elapsed_ns".
+ */
+void relay_stats_add_packet(struct relay_stats *stats, uint64_t len,
+		uint64_t elapsed_ns);
+
+/*
+ * Make the statistics of a data connection part of the dumps, until it is
+ * unregistered.
+ */
+void relay_stats_register_connection(struct relay_connection *conn);
+void relay_stats_unregister_connection(struct relay_connection *conn);
+
+/*
+ * Write the statistics of the connections, sessions and streams on a file
+ * descriptor as text, one line per object.
+ *
+ * Return 0 on success or else a negative value.
+ */
+int relay_stats_dump(int fd);
+
+#endif /* _RELAYD_STATS_H */
@@ -24,9 +24,13 @@
 #include <urcu/rculist.h>
 #include <sys/stat.h>
 
+#include "live.h"
 #include "lttng-relayd.h"
+#include "metadata-store.h"
+#include "metadata-cache.h"
 #include "index.h"
 #include "stream.h"
+#include "tracefile-manager.h"
 #include "viewer-stream.h"
 
 /* Should be called with RCU read-side lock held. */
@@ -47,7 +51,7 @@ struct relay_stream *stream_get_by_id(uint64_t stream_id)
 	struct relay_stream *stream = NULL;
 
 	rcu_read_lock();
-	lttng_ht_lookup(relay_streams_ht, &stream_id, &iter);
+	lttng_ht_lookup_fast_u64(relay_streams_ht, stream_id, &iter);
 	node = lttng_ht_iter_get_node_u64(&iter);
 	if (!node) {
 		DBG("Relay stream %" PRIu64 " not found", stream_id);
@@ -85,6 +89,9 @@ struct relay_stream *stream_create(struct ctf_trace *trace,
 	stream->prev_seq = -1ULL;
 	stream->last_net_seq_num = -1ULL;
 	stream->ctf_stream_id = -1ULL;
+	stream->next_tracefile_fd = -1;
+	stream->next_tracefile_id = -1ULL;
+	stream->dir_fd = -1;
 	stream->tracefile_size = tracefile_size;
 	stream->tracefile_count = tracefile_count;
 	stream->path_name = path_name;
@@ -95,7 +102,7 @@ struct relay_stream *stream_create(struct ctf_trace *trace,
 	ctf_trace_get(trace);
 	stream->trace = trace;
 
-	stream->indexes_ht = lttng_ht_new(0, LTTNG_HT_TYPE_U64);
+	stream->indexes_ht = lttng_ht_new(0, LTTNG_HT_TYPE_FAST_U64);
 	if (!stream->indexes_ht) {
 		ERR("Cannot created indexes_ht");
 		ret = -1;
@@ -134,6 +141,9 @@ struct relay_stream *stream_create(struct ctf_trace *trace,
 	}
 	if (stream->tracefile_size) {
 		DBG("Tracefile %s/%s_0 created", stream->path_name, stream->channel_name);
+		/* Not fatal, the tracefiles are then rotated by path. */
+		stream->dir_fd = utils_open_stream_dir(stream->path_name,
+				-1, -1);
 	} else {
 		DBG("Tracefile %s/%s created", stream->path_name, stream->channel_name);
 	}
@@ -151,7 +161,6 @@ struct relay_stream *stream_create(struct ctf_trace *trace,
 	pthread_mutex_lock(&session->recv_list_lock);
 	cds_list_add_rcu(&stream->recv_node, &session->recv_list);
 	session->stream_count++;
-	pthread_mutex_unlock(&session->recv_list_lock);
 
 	/*
 	 * Both in the ctf_trace object and the global stream ht since the data
@@ -159,6 +168,8 @@ struct relay_stream *stream_create(struct ctf_trace *trace,
 	 */
 	lttng_ht_add_unique_u64(relay_streams_ht, &stream->node);
 	stream->in_stream_ht = true;
+	cds_list_add_rcu(&stream->session_node, &session->stream_list);
+	pthread_mutex_unlock(&session->recv_list_lock);
 
 	DBG("Relay new stream added %s with ID %" PRIu64, stream->channel_name,
 			stream->stream_handle);
@@ -224,17 +235,28 @@ static void stream_unpublish(struct relay_stream *stream)
 	if (stream->in_stream_ht) {
 		struct lttng_ht_iter iter;
 		int ret;
+		struct relay_session *session = stream->trace->session;
 
 		iter.iter.node = &stream->node.node;
 		ret = lttng_ht_del(relay_streams_ht, &iter);
 		assert(!ret);
+		pthread_mutex_lock(&session->recv_list_lock);
+		cds_list_del_rcu(&stream->session_node);
 		stream->in_stream_ht = false;
+		pthread_mutex_unlock(&session->recv_list_lock);
 	}
 	if (stream->published) {
+		struct relay_session *session = stream->trace->session;
+
 		pthread_mutex_lock(&stream->trace->stream_list_lock);
 		cds_list_del_rcu(&stream->stream_node);
 		pthread_mutex_unlock(&stream->trace->stream_list_lock);
 		stream->published = false;
+
+		/* Keep the statistics of the stream in its session. */
+		pthread_mutex_lock(&session->lock);
+		relay_stats_add(&session->stats, &stream->stats);
+		pthread_mutex_unlock(&session->lock);
 	}
 }
 
@@ -248,9 +270,13 @@ static void stream_destroy(struct relay_stream *stream)
 		 */
 		lttng_ht_destroy(stream->indexes_ht);
 	}
+	free(stream->index_slots);
 	if (stream->tfa) {
 		tracefile_array_destroy(stream->tfa);
 	}
+	if (stream->dir_fd >= 0 && close(stream->dir_fd)) {
+		PERROR("close stream directory");
+	}
 	free(stream->path_name);
 	free(stream->channel_name);
 	free(stream);
@@ -292,6 +318,14 @@ static void stream_release(struct urcu_ref *ref)
 		stream_fd_put(stream->stream_fd);
 		stream->stream_fd = NULL;
 	}
+	relay_index_batch_fini(stream);
+	free(stream->index_ring);
+	stream->index_ring = NULL;
+	metadata_cache_put(stream->metadata_cache);
+	stream->metadata_cache = NULL;
+	tracefile_manager_discard(stream);
+	lttng_io_uring_destroy(stream->io_uring);
+	stream->io_uring = NULL;
 	if (stream->index_file) {
 		lttng_index_file_put(stream->index_file);
 		stream->index_file = NULL;
@@ -301,7 +335,7 @@ static void stream_release(struct urcu_ref *ref)
 		stream->trace = NULL;
 	}
 
-	call_rcu(&stream->rcu_node, stream_destroy_rcu);
+	lttng_ht_defer_free(&stream->rcu_node, stream_destroy_rcu);
 }
 
 void stream_put(struct relay_stream *stream)
@@ -399,19 +433,60 @@ void try_stream_close(struct relay_stream *stream)
 	 */
 	stream_unpublish(stream);
 	stream->closed = true;
+	if (relay_index_batch_flush(stream)) {
+		ERR("Failed to write the batched indexes of stream %" PRIu64,
+				stream->stream_handle);
+	}
 	/* Relay indexes are only used by the "consumer/sessiond" end. */
 	relay_index_close_all(stream);
 	pthread_mutex_unlock(&stream->lock);
+	/* A closed stream is no longer written, not even by a reset. */
+	metadata_store_dedup(stream);
+	live_notify_subscribers();
 	DBG("Succeeded in closing stream %" PRIu64, stream->stream_handle);
 	stream_put(stream);
 }
 
+/*
+ * Wait for the queued writes of the stream data to complete. This MUST be
+ * done before the indexes of the data are written and before the stream
+ * output file is closed or replaced.
+ *
+ * Called with the stream lock held.
+ * Return 0 on success or else a negative value.
+ */
+int stream_drain_writes(struct relay_stream *stream)
+{
+	int ret = 0;
+
+	if (!stream->io_uring) {
+		goto end;
+	}
+	ret = lttng_io_uring_drain(stream->io_uring);
+	if (ret < 0) {
+		ERR("Writing the data of stream %" PRIu64 " failed",
+				stream->stream_handle);
+		ret = -1;
+	}
+end:
+	return ret;
+}
+
 static void print_stream_indexes(struct relay_stream *stream)
 {
 	struct lttng_ht_iter iter;
 	struct relay_index *index;
+	unsigned int i;
 
 	rcu_read_lock();
+	for (i = 0; stream->index_slots && i < RELAY_INDEX_SLOTS; i++) {
+		index = &stream->index_slots[i];
+		if (!index->in_slot) {
+			continue;
+		}
+		DBG("index slot %u net_seq_num %" PRIu64 " stream %" PRIu64,
+				i, index->index_n.key, stream->stream_handle);
+	}
 	cds_lfht_for_each_entry(stream->indexes_ht->ht, &iter.iter, index,
 			index_n.node) {
 		DBG("index %p net_seq_num %" PRIu64 " refcount %ld"
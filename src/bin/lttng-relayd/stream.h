@@ -26,11 +26,16 @@
 #include <urcu/list.h>
 
 #include <common/hashtable/hashtable.h>
+#include <common/compat/io-uring.h>
 
+#include "index.h"
+#include "stats.h"
 #include "session.h"
 #include "stream-fd.h"
 #include "tracefile-array.h"
 
+struct relay_metadata_cache;
+
 /*
  * Represents a stream in the relay
  */
@@ -52,6 +57,8 @@ struct relay_stream {
 
 	/* FD on which to write the stream data. */
 	struct stream_fd *stream_fd;
+	/* Asynchronous writer of the stream data, NULL if not used. */
+	struct lttng_io_uring *io_uring;
 	/* index file on which to write the index data. */
 	struct lttng_index_file *index_file;
 
@@ -62,6 +69,20 @@ struct relay_stream {
 	uint64_t tracefile_size;
 	uint64_t tracefile_size_current;
 	uint64_t tracefile_count;
+	/*
+	 * Next tracefile, created ahead of time by the tracefile manager
+	 * under a temporary name. next_tracefile_id is the id of the
+	 * requested tracefile (-1ULL if none) and next_tracefile_fd is -1
+	 * until it is ready.
+	 */
+	int next_tracefile_fd;
+	uint64_t next_tracefile_id;
+	/*
+	 * Directory of the tracefiles of a stream with a tracefile size,
+	 * relative to which they are created, renamed and unlinked. -1 when
+	 * unused. Immutable once the stream is created.
+	 */
+	int dir_fd;
 
 	/*
 	 * Counts the number of received indexes. The "tag" associated
@@ -83,11 +104,34 @@ struct relay_stream {
 	bool close_requested;	/* Close command has been received. */
 
 	/*
-	 * Counts number of indexes in indexes_ht. Redundant info.
-	 * Protected by stream lock.
+	 * Counts number of indexes in index_slots and indexes_ht. Redundant
+	 * info. Protected by stream lock.
 	 */
 	int indexes_in_flight;
+	/*
+	 * In flight indexes, see RELAY_INDEX_SLOTS. The slots are allocated
+	 * on first use, the indexes_ht only holds the indexes whose slot
+	 * was busy. Protected by stream lock.
+	 */
+	struct relay_index *index_slots;
+	unsigned int indexes_in_ht;
 	struct lttng_ht *indexes_ht;
+	/*
+	 * Flushed indexes waiting to be written to the index file. The
+	 * index_received_seqcount and the tracefile array only account for
+	 * an index once it is written. Protected by stream lock.
+	 */
+	struct relay_index_batch index_batch;
+	/*
+	 * Last published indexes of a live stream, from which the viewers
+	 * are served without reading the index file. The index of sequence
+	 * number "seq" is at index_ring[seq % opt_index_ring]. Allocated on
+	 * first use. Protected by stream lock.
+	 */
+	struct ctf_packet_index *index_ring;
+
+	/* Protected by stream lock. */
+	struct relay_stats stats;
 
 	/*
 	 * If the stream is inactive, this field is updated with the
@@ -95,6 +139,8 @@ struct relay_stream {
 	 * field == -1ULL.
 	 */
 	uint64_t beacon_ts_end;
+	/* End timestamp of the last index received, 0 if none. */
+	uint64_t last_index_ts_end;
 
 	/* CTF stream ID, -1ULL when unset (first packet not received yet). */
 	uint64_t ctf_stream_id;
@@ -106,6 +152,12 @@ struct relay_stream {
 	int32_t is_metadata;
 	/* Amount of metadata received (bytes). */
 	uint64_t metadata_received;
+	/*
+	 * Metadata of a live stream, from which the viewers are served. See
+	 * metadata-cache.h. Protected by stream lock.
+	 */
+	struct relay_metadata_cache *metadata_cache;
+	bool metadata_cache_disabled;
 
 	/*
 	 * Member of the stream list in struct ctf_trace.
@@ -128,6 +180,12 @@ struct relay_stream {
 	 */
 	struct lttng_ht_node_u64 node;
 	bool in_stream_ht;		/* is stream in stream hash table. */
+	/*
+	 * Member of the stream list of the session, as long as the stream is
+	 * in the global stream hash table. Updates are protected by the
+	 * session recv_list_lock. Traversals are protected by RCU.
+	 */
+	struct cds_list_head session_node;
 	struct rcu_head rcu_node;	/* For call_rcu teardown. */
 };
 
@@ -140,6 +198,7 @@ struct relay_stream *stream_get_by_id(uint64_t stream_id);
 bool stream_get(struct relay_stream *stream);
 void stream_put(struct relay_stream *stream);
 void try_stream_close(struct relay_stream *stream);
+int stream_drain_writes(struct relay_stream *stream);
 void stream_publish(struct relay_stream *stream);
 void print_relay_streams(void);
 
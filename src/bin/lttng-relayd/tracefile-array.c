@@ -158,3 +158,57 @@ bool tracefile_array_seq_in_file(struct tracefile_array *tfa,
 		return false;
 	}
 }
+
+bool tracefile_array_find_seq(struct tracefile_array *tfa, uint64_t seq,
+		uint64_t *file_index, uint64_t *index_in_file)
+{
+	uint64_t low, high;
+
+	if (seq == -1ULL || tfa->seq_head == -1ULL || seq > tfa->seq_head ||
+			seq < tfa->seq_tail) {
+		return false;
+	}
+	if (!tfa->count) {
+		/* Not in tracefile rotation mode, a single file holds all. */
+		*file_index = 0;
+		*index_in_file = seq;
+		return true;
+	}
+
+	/*
+	 * The files hold consecutive ranges of sequence numbers, increasing
+	 * from the tail file to the head file: bisect over their positions
+	 * relative to the tail. A file without index yet is skipped towards
+	 * the tail.
+	 */
+	low = 0;
+	high = (tfa->file_head + tfa->count - tfa->file_tail) % tfa->count;
+	while (low <= high) {
+		uint64_t mid = low + (high - low) / 2, pos = mid, file;
+
+		for (;;) {
+			file = (tfa->file_tail + pos) % tfa->count;
+			if (tfa->tf[file].seq_tail != -1ULL || pos == low) {
+				break;
+			}
+			pos--;
+		}
+		if (tfa->tf[file].seq_tail == -1ULL) {
+			low = mid + 1;
+			continue;
+		}
+		if (seq < tfa->tf[file].seq_tail) {
+			if (!pos) {
+				break;
+			}
+			high = pos - 1;
+		} else if (seq > tfa->tf[file].seq_head) {
+			low = mid + 1;
+		} else {
+			*file_index = file;
+			*index_in_file = seq - tfa->tf[file].seq_tail;
+			return true;
+		}
+	}
+	return false;
+}
@@ -61,5 +61,12 @@ uint64_t tracefile_array_get_seq_tail(struct tracefile_array *tfa);
 
 bool tracefile_array_seq_in_file(struct tracefile_array *tfa,
 		uint64_t file_index, uint64_t seq);
+/*
+ * Find the tracefile holding the index of sequence number "seq", and the
+ * number of indexes preceding it in that file. Returns false if the index was
+ * overwritten or not received yet.
+ */
+bool tracefile_array_find_seq(struct tracefile_array *tfa, uint64_t seq,
+		uint64_t *file_index, uint64_t *index_in_file);
 
 #endif /* _STREAM_H */
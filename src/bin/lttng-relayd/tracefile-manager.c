@@ -0,0 +1,345 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include <limits.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <urcu.h>
+#include <urcu/wfcqueue.h>
+
+#include <common/common.h>
+#include <common/futex.h>
+#include <common/stripe.h>
+#include <common/utils.h>
+
+#include "health-relayd.h"
+#include "tracefile-manager.h"
+
+/* Request of the creation of the next tracefile of a stream. */
+struct tracefile_request {
+	/* Holds a reference on the stream. */
+	struct relay_stream *stream;
+	uint64_t id;
+	struct cds_wfcq_node node;
+};
+
+/*
+ * Queue of tracefile requests. Protected by a futex with a scheme N wakers /
+ * 1 waiter. See futex.c/.h
+ */
+static struct tracefile_queue {
+	int32_t futex;
+	struct cds_wfcq_head head;
+	struct cds_wfcq_tail tail;
+} tracefile_queue;
+
+static int tracefile_manager_running;
+static int tracefile_manager_quit;
+
+void tracefile_manager_init(void)
+{
+	cds_wfcq_init(&tracefile_queue.head, &tracefile_queue.tail);
+}
+
+void tracefile_manager_stop(void)
+{
+	CMM_STORE_SHARED(tracefile_manager_quit, 1);
+	futex_nto1_prepare(&tracefile_queue.futex);
+	futex_nto1_wake(&tracefile_queue.futex);
+}
+
+/*
+ * Return the id of the tracefile following the tracefile "cur_id" of a
+ * stream, as utils_rotate_stream_file() does.
+ */
+static uint64_t next_tracefile_id(struct relay_stream *stream,
+		uint64_t cur_id)
+{
+	if (stream->tracefile_count > 0) {
+		return (cur_id + 1) % stream->tracefile_count;
+	}
+	return cur_id + 1;
+}
+
+/*
+ * Get the temporary name of the tracefiles of a stream created ahead of
+ * time. The leading dot hides the files from the trace readers. The name
+ * must be freed by the caller.
+ *
+ * Return the name or NULL on error.
+ */
+static char *tmp_tracefile_name(struct relay_stream *stream)
+{
+	int ret;
+	char *name;
+
+	ret = asprintf(&name, ".%s", stream->channel_name);
+	if (ret < 0) {
+		PERROR("asprintf temporary tracefile name");
+		name = NULL;
+	}
+	return name;
+}
+
+static void unlink_tmp_tracefile(struct relay_stream *stream, uint64_t id)
+{
+	char *tmp_name;
+
+	tmp_name = tmp_tracefile_name(stream);
+	if (!tmp_name) {
+		return;
+	}
+	(void) utils_unlink_stream_file_at(stream->dir_fd, stream->path_name,
+			tmp_name, stream->tracefile_size, id, -1, -1, NULL);
+	free(tmp_name);
+}
+
+static void process_request(struct tracefile_request *req, int quit)
+{
+	int fd = -1, ret;
+	char *tmp_name = NULL;
+	struct relay_stream *stream = req->stream;
+
+	if (quit) {
+		goto end;
+	}
+
+	tmp_name = tmp_tracefile_name(stream);
+	if (!tmp_name) {
+		goto end;
+	}
+	/* The path and name of a stream are immutable. */
+	fd = utils_create_stream_file_at(stream->dir_fd, stream->path_name,
+			tmp_name, stream->tracefile_size, req->id, -1, -1, NULL);
+	if (fd < 0) {
+		goto end;
+	}
+
+	pthread_mutex_lock(&stream->lock);
+	if (!stream->closed && stream->next_tracefile_id == req->id &&
+			stream->next_tracefile_fd < 0) {
+		stream->next_tracefile_fd = fd;
+		fd = -1;
+		DBG("Tracefile %" PRIu64 " of stream %" PRIu64 " ready",
+				req->id, stream->stream_handle);
+	}
+	pthread_mutex_unlock(&stream->lock);
+
+	if (fd >= 0) {
+		/* The stream rotated or closed meanwhile. */
+		ret = close(fd);
+		if (ret) {
+			PERROR("close temporary tracefile");
+		}
+		(void) utils_unlink_stream_file_at(stream->dir_fd,
+				stream->path_name, tmp_name,
+				stream->tracefile_size, req->id, -1, -1, NULL);
+	}
+end:
+	free(tmp_name);
+	stream_put(stream);
+	free(req);
+}
+
+void *tracefile_manager_thread(void *data)
+{
+	rcu_register_thread();
+
+	health_register(health_relayd, HEALTH_RELAYD_TYPE_TRACEFILE_MANAGER);
+
+	health_code_update();
+
+	DBG("[thread] Tracefile manager started");
+
+	CMM_STORE_SHARED(tracefile_manager_running, 1);
+
+	for (;;) {
+		int quit;
+		struct cds_wfcq_node *node;
+
+		health_code_update();
+
+		futex_nto1_prepare(&tracefile_queue.futex);
+		quit = CMM_LOAD_SHARED(tracefile_manager_quit);
+
+		while ((node = cds_wfcq_dequeue_blocking(&tracefile_queue.head,
+				&tracefile_queue.tail))) {
+			health_code_update();
+			process_request(caa_container_of(node,
+					struct tracefile_request, node), quit);
+		}
+
+		if (quit) {
+			break;
+		}
+
+		health_poll_entry();
+		futex_nto1_wait(&tracefile_queue.futex);
+		health_poll_exit();
+	}
+
+	CMM_STORE_SHARED(tracefile_manager_running, 0);
+
+	health_unregister(health_relayd);
+	DBG("Tracefile manager exiting");
+	rcu_unregister_thread();
+	return NULL;
+}
+
+void tracefile_manager_prepare(struct relay_stream *stream)
+{
+	uint64_t id;
+	struct tracefile_request *req;
+
+	if (!stream->tracefile_size ||
+			!CMM_LOAD_SHARED(tracefile_manager_running)) {
+		return;
+	}
+
+	id = next_tracefile_id(stream,
+			tracefile_array_get_file_index_head(stream->tfa));
+	if (stream->next_tracefile_id == id) {
+		/* Already requested. */
+		return;
+	}
+	tracefile_manager_discard(stream);
+
+	req = zmalloc(sizeof(*req));
+	if (!req) {
+		PERROR("zmalloc tracefile request");
+		return;
+	}
+	/* The caller holds a reference on the stream. */
+	if (!stream_get(stream)) {
+		free(req);
+		return;
+	}
+	req->stream = stream;
+	req->id = id;
+	cds_wfcq_node_init(&req->node);
+	stream->next_tracefile_id = id;
+
+	cds_wfcq_enqueue(&tracefile_queue.head, &tracefile_queue.tail,
+			&req->node);
+	futex_nto1_wake(&tracefile_queue.futex);
+}
+
+void tracefile_manager_discard(struct relay_stream *stream)
+{
+	int ret;
+
+	if (stream->next_tracefile_fd >= 0) {
+		ret = close(stream->next_tracefile_fd);
+		if (ret) {
+			PERROR("close temporary tracefile");
+		}
+		stream->next_tracefile_fd = -1;
+		unlink_tmp_tracefile(stream, stream->next_tracefile_id);
+	}
+	stream->next_tracefile_id = -1ULL;
+}
+
+/*
+ * Rename the tracefile of a stream created ahead of time to its final name.
+ * For a stream in tracefile count mode, this replaces the old tracefile of
+ * the same id as utils_rotate_stream_file() would by unlinking it: a live
+ * reader having it opened keeps its content.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static int rename_tmp_tracefile(struct relay_stream *stream, uint64_t id)
+{
+	int ret;
+	char *tmp_name;
+	const char *dir_path;
+	char tmp_path[PATH_MAX], path[PATH_MAX];
+
+	tmp_name = tmp_tracefile_name(stream);
+	if (!tmp_name) {
+		ret = -1;
+		goto end;
+	}
+	/* Relative to the stream directory when it is opened. */
+	dir_path = stream->dir_fd >= 0 ? NULL : stream->path_name;
+	ret = utils_stream_file_name(tmp_path, dir_path, tmp_name,
+			stream->tracefile_size, id, NULL);
+	if (ret < 0) {
+		goto end;
+	}
+	ret = utils_stream_file_name(path, dir_path,
+			stream->channel_name, stream->tracefile_size, id, NULL);
+	if (ret < 0) {
+		goto end;
+	}
+	if (stripe_tracefile(stream->channel_name, NULL)) {
+		char full_path[PATH_MAX];
+
+		/* The replaced tracefile may link a striped file. */
+		ret = utils_stream_file_name(full_path, stream->path_name,
+				stream->channel_name, stream->tracefile_size,
+				id, NULL);
+		if (ret < 0) {
+			goto end;
+		}
+		stripe_unlink_target(full_path, -1, -1);
+	}
+	if (stream->dir_fd >= 0) {
+		ret = renameat(stream->dir_fd, tmp_path, stream->dir_fd, path);
+	} else {
+		ret = rename(tmp_path, path);
+	}
+	if (ret < 0) {
+		PERROR("rename tracefile %s to %s", tmp_path, path);
+	}
+end:
+	free(tmp_name);
+	return ret;
+}
+
+int tracefile_manager_rotate(struct relay_stream *stream, uint64_t cur_id)
+{
+	int ret;
+	uint64_t id = next_tracefile_id(stream, cur_id);
+
+	if (stream->next_tracefile_fd < 0 || stream->next_tracefile_id != id ||
+			rename_tmp_tracefile(stream, id)) {
+		uint64_t new_id = cur_id;
+
+		DBG("Tracefile %" PRIu64 " of stream %" PRIu64 " not ready, creating it",
+				id, stream->stream_handle);
+		tracefile_manager_discard(stream);
+		ret = utils_rotate_stream_file_at(stream->dir_fd,
+				stream->path_name,
+				stream->channel_name, stream->tracefile_size,
+				stream->tracefile_count, -1, -1,
+				stream->stream_fd->fd, &new_id,
+				&stream->stream_fd->fd);
+		goto end;
+	}
+
+	ret = close(stream->stream_fd->fd);
+	if (ret < 0) {
+		PERROR("Closing tracefile");
+	}
+	stream->stream_fd->fd = stream->next_tracefile_fd;
+	stream->next_tracefile_fd = -1;
+	stream->next_tracefile_id = -1ULL;
+	ret = 0;
+end:
+	return ret;
+}
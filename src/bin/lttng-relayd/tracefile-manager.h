@@ -0,0 +1,72 @@
+#ifndef _TRACEFILE_MANAGER_H
+#define _TRACEFILE_MANAGER_H
+
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stream.h"
+
+/*
+ * The tracefile manager creates the next tracefile of the streams in
+ * tracefile rotation mode ahead of time, under a temporary hidden name, so
+ * that the data path only has to rename it and swap the file descriptors
+ * when the current tracefile is full.
+ */
+
+/*
+ * MUST be called before the tracefile manager thread is launched.
+ */
+void tracefile_manager_init(void);
+
+/*
+ * Tracefile manager thread. It exits once tracefile_manager_stop() is
+ * called.
+ */
+void *tracefile_manager_thread(void *data);
+
+/*
+ * Ask the tracefile manager thread to exit. MUST be called once no worker
+ * can request tracefiles anymore.
+ */
+void tracefile_manager_stop(void);
+
+/*
+ * Request the creation of the tracefile following the current tracefile of
+ * a stream, unless it is already requested.
+ *
+ * Called with the stream lock held.
+ */
+void tracefile_manager_prepare(struct relay_stream *stream);
+
+/*
+ * Switch the output of a stream from its tracefile "cur_id" to the next
+ * one, using the file created ahead of time if it is ready or else creating
+ * it inline.
+ *
+ * Called with the stream lock held.
+ * Return 0 on success or else a negative value.
+ */
+int tracefile_manager_rotate(struct relay_stream *stream, uint64_t cur_id);
+
+/*
+ * Remove the unused tracefile created ahead of time for a stream, if any.
+ *
+ * Called with the stream lock held or when the stream is released.
+ */
+void tracefile_manager_discard(struct relay_stream *stream);
+
+#endif /* _TRACEFILE_MANAGER_H */
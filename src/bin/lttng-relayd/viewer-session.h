@@ -39,6 +39,12 @@ struct relay_viewer_session {
 	 */
 	struct cds_list_head session_list;	/* RCU list. */
 	pthread_mutex_t session_list_lock;	/* Protects list updates. */
+	/*
+	 * Packet filter of the last attach, see struct
+	 * lttng_viewer_attach_filter. Only used by the connection thread.
+	 */
+	uint64_t filter_window;
+	uint64_t filter_sample_interval;
 };
 
 struct relay_viewer_session *viewer_session_create(void);
@@ -68,9 +68,16 @@ struct relay_viewer_stream *viewer_stream_create(struct relay_stream *stream,
 		goto error;
 	}
 	vstream->stream = stream;
+	vstream->last_sampled_ts = -1ULL;
 
 	pthread_mutex_lock(&stream->lock);
 
+	/* Seek among every index received so far. */
+	if (relay_index_batch_flush(stream)) {
+		ERR("Failed to write the batched indexes of stream %" PRIu64,
+				stream->stream_handle);
+	}
+
 	if (stream->is_metadata && stream->trace->viewer_metadata_stream) {
 		ERR("Cannot attach viewer metadata stream to trace (busy).");
 		goto error_unlock;
@@ -191,7 +198,7 @@ static void viewer_stream_release(struct urcu_ref *ref)
 		stream_put(vstream->stream);
 		vstream->stream = NULL;
 	}
-	call_rcu(&vstream->rcu_node, viewer_stream_destroy_rcu);
+	lttng_ht_defer_free(&vstream->rcu_node, viewer_stream_destroy_rcu);
 }
 
 /* Must be called with RCU read-side lock held. */
@@ -212,7 +219,7 @@ struct relay_viewer_stream *viewer_stream_get_by_id(uint64_t id)
 	struct relay_viewer_stream *vstream = NULL;
 
 	rcu_read_lock();
-	lttng_ht_lookup(viewer_streams_ht, &id, &iter);
+	lttng_ht_lookup_fast_u64(viewer_streams_ht, id, &iter);
 	node = lttng_ht_iter_get_node_u64(&iter);
 	if (!node) {
 		DBG("Relay viewer stream %" PRIu64 " not found", id);
@@ -244,7 +251,7 @@ int viewer_stream_rotate(struct relay_viewer_stream *vstream)
 {
 	int ret;
 	struct relay_stream *stream = vstream->stream;
-	uint64_t new_id;
+	uint64_t new_id, index_in_file = 0;
 
 	/* Detect the last tracefile to open. */
 	if (stream->index_received_seqcount
@@ -261,13 +268,19 @@ int viewer_stream_rotate(struct relay_viewer_stream *vstream)
 	}
 
 	/*
-	 * Try to move to the next file.
+	 * Try to move to the next file. When the viewer lags by more than a
+	 * file, jump straight to the file and index of its next sequence
+	 * number rather than through every file in between.
 	 */
 	new_id = (vstream->current_tracefile_id + 1)
 			% stream->tracefile_count;
 	if (tracefile_array_seq_in_file(stream->tfa, new_id,
 			vstream->index_sent_seqcount)) {
 		vstream->current_tracefile_id = new_id;
+	} else if (tracefile_array_find_seq(stream->tfa,
+			vstream->index_sent_seqcount, &new_id,
+			&index_in_file)) {
+		vstream->current_tracefile_id = new_id;
 	} else {
 		uint64_t seq_tail = tracefile_array_get_seq_tail(stream->tfa);
 
@@ -302,6 +315,8 @@ int viewer_stream_rotate(struct relay_viewer_stream *vstream)
 		ret = -1;
 		goto end;
 	} else {
+		/* The next index is read after the ones of older packets. */
+		vstream->index_file_skip = index_in_file;
 		ret = 0;
 	}
 end:
@@ -67,6 +67,23 @@ struct relay_viewer_stream {
 	 * updated when catching up with the producer.
 	 */
 	uint64_t index_sent_seqcount;
+	/*
+	 * Number of indexes sent from the index ring of the stream since the
+	 * position of index_file was last updated.
+	 */
+	uint64_t index_file_skip;
+	/*
+	 * Beginning timestamp of the last packet sent with a sample interval
+	 * filter, -1ULL if none.
+	 */
+	uint64_t last_sampled_ts;
+	/*
+	 * index_received_seqcount of the stream when the subscribed viewer
+	 * was last notified of new indexes, and whether it was notified of
+	 * the stream closing.
+	 */
+	uint64_t index_notified_seqcount;
+	bool close_notified;
 
 	/* Indicates if this stream has been sent to a viewer client. */
 	bool sent_flag;
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include <common/common.h>
+#include <urcu/uatomic.h>
+
+#include "viewer-subscription.h"
+
+/* Number of subscriptions of all the viewer notification connections. */
+static unsigned long nr_subscriptions;
+
+int viewer_subscription_add(struct cds_list_head *subscriptions,
+		struct relay_session *session, uint32_t credits)
+{
+	int ret = 0;
+	struct viewer_subscription *sub;
+
+	cds_list_for_each_entry(sub, subscriptions, node) {
+		if (sub->session == session) {
+			sub->credits = min_t(uint64_t,
+					(uint64_t) sub->credits + credits,
+					UINT32_MAX);
+			goto end;
+		}
+	}
+
+	if (!session_get(session)) {
+		ret = -1;
+		goto end;
+	}
+	sub = zmalloc(sizeof(*sub));
+	if (!sub) {
+		PERROR("zmalloc viewer subscription");
+		session_put(session);
+		ret = -1;
+		goto end;
+	}
+	sub->session = session;
+	sub->credits = credits;
+	cds_list_add_tail(&sub->node, subscriptions);
+	uatomic_inc(&nr_subscriptions);
+	DBG("Viewer subscribed to session %" PRIu64, session->id);
+end:
+	return ret;
+}
+
+void viewer_subscriptions_destroy(struct cds_list_head *subscriptions)
+{
+	struct viewer_subscription *sub, *tmp;
+
+	cds_list_for_each_entry_safe(sub, tmp, subscriptions, node) {
+		cds_list_del(&sub->node);
+		session_put(sub->session);
+		free(sub);
+		uatomic_dec(&nr_subscriptions);
+	}
+}
+
+bool viewer_subscriptions_active(void)
+{
+	return uatomic_read(&nr_subscriptions) != 0;
+}
@@ -0,0 +1,63 @@
+#ifndef _VIEWER_SUBSCRIPTION_H
+#define _VIEWER_SUBSCRIPTION_H
+
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <urcu/list.h>
+
+#include "session.h"
+
+/*
+ * Subscription of a live viewer notification connection to a session. The
+ * relay notifies the viewer when new indexes of the streams of the session
+ * are available, each notification consuming one of the credits granted by
+ * the viewer.
+ *
+ * Subscriptions are only accessed by the live worker owning their
+ * connection.
+ */
+struct viewer_subscription {
+	/* Holds a reference on the session. */
+	struct relay_session *session;
+	/* Number of notifications the relay may still send. */
+	uint32_t credits;
+	struct cds_list_head node;
+};
+
+/*
+ * Subscribe to a session, or grant more credits to an existing subscription
+ * to that session.
+ *
+ * Return 0 on success or else a negative value.
+ */
+int viewer_subscription_add(struct cds_list_head *subscriptions,
+		struct relay_session *session, uint32_t credits);
+
+/*
+ * Release every subscription of a list.
+ */
+void viewer_subscriptions_destroy(struct cds_list_head *subscriptions);
+
+/*
+ * Return true if any viewer is subscribed to a session.
+ */
+bool viewer_subscriptions_active(void);
+
+#endif /* _VIEWER_SUBSCRIPTION_H */
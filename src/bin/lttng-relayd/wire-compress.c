@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include "wire-compress.h"
+
+#ifdef HAVE_LIBZ
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <urcu/tls-compat.h>
+#include <zlib.h>
+
+#include <common/common.h>
+#include <common/compat/endian.h>
+#include <common/consumer/consumer-compress.h>
+
+struct relay_wire_inflater {
+	z_stream zstream;
+	bool initialized;
+	/* Received frame. */
+	char *frame;
+	size_t frame_alloc_len;
+	/* Inflated packet content. */
+	char *content;
+	size_t content_alloc_len;
+};
+
+static DEFINE_URCU_TLS(struct relay_wire_inflater, worker_inflater);
+
+/*
+ * Grow "*buf" to at least "len" bytes.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static int grow_buffer(char **buf, size_t *alloc_len, size_t len)
+{
+	char *new_buf;
+
+	if (len <= *alloc_len) {
+		return 0;
+	}
+	new_buf = realloc(*buf, len);
+	if (!new_buf) {
+		PERROR("realloc inflate buffer");
+		return -1;
+	}
+	*buf = new_buf;
+	*alloc_len = len;
+	return 0;
+}
+
+void *relay_wire_frame_buffer(size_t len)
+{
+	struct relay_wire_inflater *inflater = &URCU_TLS(worker_inflater);
+
+	if (grow_buffer(&inflater->frame, &inflater->frame_alloc_len, len)) {
+		return NULL;
+	}
+	return inflater->frame;
+}
+
+ssize_t relay_wire_inflate(const void *frame, size_t len,
+		const void **content)
+{
+	int ret;
+	uint64_t content_size, packet_size;
+	const struct consumer_compressed_packet_header *hdr = frame;
+	struct relay_wire_inflater *inflater = &URCU_TLS(worker_inflater);
+
+	if (len < sizeof(*hdr) ||
+			be32toh(hdr->magic) != CONSUMER_COMPRESSED_PACKET_MAGIC ||
+			be32toh(hdr->codec) != LTTNG_CHANNEL_COMPRESSION_ZLIB ||
+			be64toh(hdr->compressed_size) != len - sizeof(*hdr)) {
+		ERR("Invalid compressed packet frame of %zu bytes", len);
+		return -EINVAL;
+	}
+	content_size = be64toh(hdr->content_size);
+	packet_size = be64toh(hdr->packet_size);
+	/* The inflated content is accounted for as a data header size. */
+	if (content_size > packet_size || content_size > UINT32_MAX) {
+		ERR("Invalid compressed packet content size %" PRIu64,
+				content_size);
+		return -EINVAL;
+	}
+
+	if (!inflater->initialized) {
+		ret = inflateInit(&inflater->zstream);
+		if (ret != Z_OK) {
+			ERR("inflateInit: %s", inflater->zstream.msg ?
+					inflater->zstream.msg : "unknown error");
+			return -ENOMEM;
+		}
+		inflater->initialized = true;
+	} else {
+		ret = inflateReset(&inflater->zstream);
+		if (ret != Z_OK) {
+			return -EINVAL;
+		}
+	}
+
+	if (grow_buffer(&inflater->content, &inflater->content_alloc_len,
+			content_size)) {
+		return -ENOMEM;
+	}
+
+	inflater->zstream.next_in = (Bytef *) frame + sizeof(*hdr);
+	inflater->zstream.avail_in = len - sizeof(*hdr);
+	inflater->zstream.next_out = (Bytef *) inflater->content;
+	inflater->zstream.avail_out = content_size;
+
+	ret = inflate(&inflater->zstream, Z_FINISH);
+	if (ret != Z_STREAM_END ||
+			inflater->zstream.total_out != content_size) {
+		ERR("inflate of a %zu bytes packet frame: %s", len,
+				inflater->zstream.msg ?
+					inflater->zstream.msg : "invalid size");
+		return -EIO;
+	}
+
+	*content = inflater->content;
+	return content_size;
+}
+
+void relay_wire_compress_fini(void)
+{
+	struct relay_wire_inflater *inflater = &URCU_TLS(worker_inflater);
+
+	if (inflater->initialized) {
+		(void) inflateEnd(&inflater->zstream);
+		inflater->initialized = false;
+	}
+	free(inflater->frame);
+	inflater->frame = NULL;
+	inflater->frame_alloc_len = 0;
+	free(inflater->content);
+	inflater->content = NULL;
+	inflater->content_alloc_len = 0;
+}
+
+#endif /* HAVE_LIBZ */
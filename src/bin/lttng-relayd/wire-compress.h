@@ -0,0 +1,82 @@
+#ifndef _WIRE_COMPRESS_H
+#define _WIRE_COMPRESS_H
+
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <common/sessiond-comm/relayd.h>
+
+/*
+ * Inflation of the data packets compressed by the consumers for the wire,
+ * flagged RELAYD_DATA_COMPRESSED. Each worker thread keeps its own inflate
+ * state and buffers, so none of these functions needs a lock.
+ */
+
+#ifdef HAVE_LIBZ
+
+/* Features advertised in the RELAYD_VERSION reply. */
+#define RELAY_WIRE_FEATURES	RELAYD_FEATURE_WIRE_COMPRESSION
+
+/*
+ * Get the buffer of the calling worker receiving a compressed packet frame
+ * of "len" bytes. It remains valid until the next call.
+ *
+ * Return the buffer or NULL on error.
+ */
+void *relay_wire_frame_buffer(size_t len);
+
+/*
+ * Inflate the compressed packet frame of "len" bytes. On success, "content"
+ * points to the packet content, which remains valid until the next call.
+ *
+ * Return the packet content size or else a negative value.
+ */
+ssize_t relay_wire_inflate(const void *frame, size_t len,
+		const void **content);
+
+/*
+ * Release the inflate state and buffers of the calling worker.
+ */
+void relay_wire_compress_fini(void);
+
+#else /* HAVE_LIBZ */
+
+#define RELAY_WIRE_FEATURES	0
+
+static inline void *relay_wire_frame_buffer(size_t len)
+{
+	return NULL;
+}
+
+static inline ssize_t relay_wire_inflate(const void *frame, size_t len,
+		const void **content)
+{
+	return -ENOSYS;
+}
+
+static inline void relay_wire_compress_fini(void)
+{
+}
+
+#endif /* HAVE_LIBZ */
+
+#endif /* _WIRE_COMPRESS_H */
@@ -17,6 +17,7 @@
 
 #define _LGPL_SOURCE
 #include <assert.h>
+#include <poll.h>
 
 #include <common/common.h>
 #include <common/sessiond-comm/sessiond-comm.h>
@@ -28,6 +29,7 @@
 #include "fd-limit.h"
 #include "agent-thread.h"
 #include "agent.h"
+#include "app-update-pool.h"
 #include "lttng-sessiond.h"
 #include "session.h"
 #include "utils.h"
@@ -42,22 +44,18 @@ static const char *default_reg_uri =
 
 /*
  * Update agent application using the given socket. This is done just after
- * registration was successful.
+ * registration was successful, concurrently for the agents registering
+ * together.
  *
- * This is a quite heavy call in terms of locking since the session list lock
- * AND session lock are acquired.
+ * This is a quite heavy call in terms of locking since the lock of every
+ * session is acquired in turn. The session list itself is iterated lock-free.
  */
-static void update_agent_app(struct agent_app *app)
+static int update_agent_app(struct agent_app *app, void *data)
 {
-	struct ltt_session *session, *stmp;
-	struct ltt_session_list *list;
+	struct ltt_session *session;
+	struct ltt_session_list_iter iter = SESSION_LIST_ITER_INIT;
 
-	list = session_get_list();
-	assert(list);
-
-	session_lock_list();
-	cds_list_for_each_entry_safe(session, stmp, &list->head, list) {
-		session_lock(session);
+	while ((session = session_lock_next_alive(&iter))) {
 		if (session->ust_session) {
 			struct agent *agt;
 
@@ -70,7 +68,21 @@ static void update_agent_app(struct agent_app *app)
 		}
 		session_unlock(session);
 	}
-	session_unlock_list();
+	return 0;
+}
+
+/*
+ * Return 1 if another agent is waiting to be accepted on the registration
+ * socket or else 0.
+ */
+static int registration_pending(struct lttcomm_sock *reg_sock)
+{
+	struct pollfd pfd;
+
+	pfd.fd = reg_sock->fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	return poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN);
 }
 
 /*
@@ -169,6 +181,17 @@ static int handle_registration(struct lttcomm_sock *reg_sock,
 		goto error;
 	}
 
+	/*
+	 * Bound the time an unresponsive agent can stall the registration and
+	 * the updates of the other agents. app_socket_timeout is in seconds.
+	 */
+	if (app_socket_timeout >= 0) {
+		(void) lttcomm_setsockopt_rcv_timeout(new_sock->fd,
+				app_socket_timeout * 1000);
+		(void) lttcomm_setsockopt_snd_timeout(new_sock->fd,
+				app_socket_timeout * 1000);
+	}
+
 	size = new_sock->ops->recvmsg(new_sock, &msg, sizeof(msg), 0);
 	if (size < sizeof(msg)) {
 		ret = -EINVAL;
@@ -184,19 +207,20 @@ static int handle_registration(struct lttcomm_sock *reg_sock,
 		ret = -EINVAL;
 		goto error_socket;
 	}
-	if (minor_version != AGENT_MINOR_VERSION) {
+	if (minor_version < AGENT_MINOR_VERSION) {
 		ret = -EINVAL;
 		goto error_socket;
 	}
 
-	DBG2("[agent-thread] New registration for pid %d domain %d on socket %d",
-			pid, domain, new_sock->fd);
+	DBG2("[agent-thread] New registration for pid %d domain %d version %u.%u on socket %d",
+			pid, domain, major_version, minor_version, new_sock->fd);
 
 	app = agent_create_app(pid, domain, new_sock);
 	if (!app) {
 		ret = -ENOMEM;
 		goto error_socket;
 	}
+	app->minor_version = minor_version;
 
 	/*
 	 * Add before assigning the socket value to the UST app so it can be found
@@ -296,49 +320,70 @@ restart:
 			}
 
 			if (revents & LPOLLIN) {
-				int new_fd;
-				struct agent_app *app = NULL;
+				unsigned int j, nr_apps = 0;
+				struct agent_app *apps[DEFAULT_APP_UPDATE_BATCH];
 
 				assert(pollfd == reg_sock->fd);
-				new_fd = handle_registration(reg_sock, &app);
-				if (new_fd < 0) {
-					continue;
-				}
-				/* Should not have a NULL app on success. */
-				assert(app);
 
-				/*
-				 * Since this is a command socket (write then read),
-				 * only add poll error event to only detect shutdown.
-				 */
-				ret = lttng_poll_add(&events, new_fd,
-						LPOLLERR | LPOLLHUP | LPOLLRDHUP);
-				if (ret < 0) {
-					agent_destroy_app_by_sock(new_fd);
-					continue;
+				/* Accept the agents registering together. */
+				for (j = 0; j < ARRAY_SIZE(apps); j++) {
+					int new_fd;
+					struct agent_app *app = NULL;
+
+					if (j > 0 && !registration_pending(reg_sock)) {
+						break;
+					}
+					new_fd = handle_registration(reg_sock, &app);
+					if (new_fd < 0) {
+						continue;
+					}
+					/* Should not have a NULL app on success. */
+					assert(app);
+
+					/*
+					 * Since this is a command socket (write then read),
+					 * only add poll error event to only detect shutdown.
+					 */
+					ret = lttng_poll_add_data(&events, new_fd,
+							LPOLLERR | LPOLLHUP | LPOLLRDHUP,
+							app);
+					if (ret < 0) {
+						agent_unregister_app(app);
+						continue;
+					}
+					apps[nr_apps++] = app;
 				}
 
-				/* Update newly registered app. */
-				update_agent_app(app);
+				/* Update newly registered apps. */
+				(void) app_update_pool_run_agents(apps, nr_apps,
+						update_agent_app, NULL);
 
-				/* On failure, the poll will detect it and clean it up. */
-				ret = agent_send_registration_done(app);
-				if (ret < 0) {
-					/* Removing from the poll set */
-					ret = lttng_poll_del(&events, new_fd);
+				for (j = 0; j < nr_apps; j++) {
+					int app_fd = apps[j]->sock->fd;
+
+					/* On failure, the poll will detect it and clean it up. */
+					ret = agent_send_registration_done(apps[j]);
 					if (ret < 0) {
-						goto error;
+						/* Removing from the poll set */
+						ret = lttng_poll_del(&events, app_fd);
+						if (ret < 0) {
+							goto error;
+						}
+						agent_unregister_app(apps[j]);
+						continue;
 					}
-					agent_destroy_app_by_sock(new_fd);
-					continue;
 				}
 			} else if (revents & (LPOLLERR | LPOLLHUP | LPOLLRDHUP)) {
+				/* The socket's application, no lookup needed. */
+				struct agent_app *app = LTTNG_POLL_GETDATA(&events, i);
+
+				assert(app);
 				/* Removing from the poll set */
 				ret = lttng_poll_del(&events, pollfd);
 				if (ret < 0) {
 					goto error;
 				}
-				agent_destroy_app_by_sock(pollfd);
+				agent_unregister_app(app);
 			} else {
 				ERR("Unexpected poll events %u for sock %d", revents, pollfd);
 				goto error;
@@ -22,6 +22,7 @@
 #include <urcu/rculist.h>
 
 #include <common/common.h>
+#include <common/dynamic-buffer.h>
 #include <common/sessiond-comm/agent.h>
 
 #include <common/compat/endian.h>
@@ -385,67 +386,80 @@ error:
 }
 
 /*
- * Internal enable agent event on a agent application. This function
- * communicates with the agent to enable a given event.
+ * Append the enable command payload of an event to a buffer, which is the
+ * fixed-size struct followed by the variable-length filter expression (+1
+ * for the ending \0).
  *
  * Return LTTNG_OK on success or else a LTTNG_ERR* code.
  */
-static int enable_event(struct agent_app *app, struct agent_event *event)
+static int append_enable_event(struct lttng_dynamic_buffer *buf,
+		struct agent_event *event)
 {
 	int ret;
-	char *bytes_to_send;
-	uint64_t data_size;
 	size_t filter_expression_length;
-	uint32_t reply_ret_code;
 	struct lttcomm_agent_enable_event msg;
-	struct lttcomm_agent_generic_reply reply;
 
-	assert(app);
-	assert(app->sock);
-	assert(event);
-
-	DBG2("Agent enabling event %s for app pid: %d and socket %d", event->name,
-			app->pid, app->sock->fd);
-
-	/*
-	 * Calculate the payload's size, which is the fixed-size struct followed
-	 * by the variable-length filter expression (+1 for the ending \0).
-	 */
 	if (!event->filter_expression) {
 		filter_expression_length = 0;
 	} else {
 		filter_expression_length = strlen(event->filter_expression) + 1;
 	}
-	data_size = sizeof(msg) + filter_expression_length;
 
 	memset(&msg, 0, sizeof(msg));
 	msg.loglevel_value = htobe32(event->loglevel_value);
 	msg.loglevel_type = htobe32(event->loglevel_type);
 	if (lttng_strncpy(msg.name, event->name, sizeof(msg.name))) {
 		ret = LTTNG_ERR_INVALID;
-		goto error;
+		goto end;
 	}
 	msg.filter_expression_length = htobe32(filter_expression_length);
 
-	ret = send_header(app->sock, data_size, AGENT_CMD_ENABLE, 0);
-	if (ret < 0) {
-		goto error_io;
+	if (lttng_dynamic_buffer_append(buf, &msg, sizeof(msg)) ||
+			lttng_dynamic_buffer_append(buf, event->filter_expression,
+				filter_expression_length)) {
+		ret = LTTNG_ERR_NOMEM;
+		goto end;
 	}
+	ret = LTTNG_OK;
+end:
+	return ret;
+}
 
-	bytes_to_send = zmalloc(data_size);
-	if (!bytes_to_send) {
-		ret = LTTNG_ERR_NOMEM;
+/*
+ * Internal enable agent event on a agent application. This function
+ * communicates with the agent to enable a given event.
+ *
+ * Return LTTNG_OK on success or else a LTTNG_ERR* code.
+ */
+static int enable_event(struct agent_app *app, struct agent_event *event)
+{
+	int ret;
+	uint32_t reply_ret_code;
+	struct lttng_dynamic_buffer payload;
+	struct lttcomm_agent_generic_reply reply;
+
+	assert(app);
+	assert(app->sock);
+	assert(event);
+
+	DBG2("Agent enabling event %s for app pid: %d and socket %d", event->name,
+			app->pid, app->sock->fd);
+
+	lttng_dynamic_buffer_init(&payload);
+	ret = append_enable_event(&payload, event);
+	if (ret != LTTNG_OK) {
+		lttng_dynamic_buffer_reset(&payload);
 		goto error;
 	}
 
-	memcpy(bytes_to_send, &msg, sizeof(msg));
-	if (filter_expression_length > 0) {
-		memcpy(bytes_to_send + sizeof(msg), event->filter_expression,
-				filter_expression_length);
+	ret = send_header(app->sock, payload.size, AGENT_CMD_ENABLE, 0);
+	if (ret < 0) {
+		lttng_dynamic_buffer_reset(&payload);
+		goto error_io;
 	}
 
-	ret = send_payload(app->sock, bytes_to_send, data_size);
-	free(bytes_to_send);
+	ret = send_payload(app->sock, payload.data, payload.size);
+	lttng_dynamic_buffer_reset(&payload);
 	if (ret < 0) {
 		goto error_io;
 	}
@@ -1373,7 +1387,20 @@ void agent_destroy_app_by_sock(int sock)
 	rcu_read_lock();
 	app = agent_find_app_by_sock(sock);
 	assert(app);
+	agent_unregister_app(app);
+	rcu_read_unlock();
+}
 
+/*
+ * Delete a registered agent application from the hash table and destroy it.
+ * The agent thread owns the registered applications, which it keeps as the
+ * user data of their socket in its poll set.
+ */
+void agent_unregister_app(struct agent_app *app)
+{
+	assert(app);
+
+	rcu_read_lock();
 	/* RCU read side lock is assumed to be held by this function. */
 	agent_delete_app(app);
 
@@ -1405,6 +1432,148 @@ void agent_app_ht_clean(void)
 	lttng_ht_destroy(agent_apps_ht_by_sock);
 }
 
+/*
+ * Append an application context, as sent by app_context_op(), to a buffer.
+ *
+ * Return LTTNG_OK on success or else a LTTNG_ERR* code.
+ */
+static int append_app_ctx(struct lttng_dynamic_buffer *buf,
+		struct agent_app_ctx *ctx)
+{
+	int ret;
+	size_t provider_name_len, ctx_name_len;
+	uint32_t provider_name_len_be, ctx_name_len_be;
+
+	provider_name_len = strlen(ctx->provider_name) + 1;
+	ctx_name_len = strlen(ctx->ctx_name) + 1;
+	if (provider_name_len > UINT32_MAX || ctx_name_len > UINT32_MAX) {
+		ERR("Application context name > MAX_UINT32");
+		ret = LTTNG_ERR_INVALID;
+		goto end;
+	}
+	provider_name_len_be = htobe32((uint32_t) provider_name_len);
+	ctx_name_len_be = htobe32((uint32_t) ctx_name_len);
+
+	if (lttng_dynamic_buffer_append(buf, &provider_name_len_be,
+				sizeof(provider_name_len_be)) ||
+			lttng_dynamic_buffer_append(buf, ctx->provider_name,
+				provider_name_len) ||
+			lttng_dynamic_buffer_append(buf, &ctx_name_len_be,
+				sizeof(ctx_name_len_be)) ||
+			lttng_dynamic_buffer_append(buf, ctx->ctx_name,
+				ctx_name_len)) {
+		ret = LTTNG_ERR_NOMEM;
+		goto end;
+	}
+	ret = LTTNG_OK;
+end:
+	return ret;
+}
+
+/*
+ * Enable the enabled events and the application contexts of an agent on an
+ * agent application with a single command.
+ *
+ * Return LTTNG_OK if the command is completed, even if some events or
+ * contexts failed, or else a LTTNG_ERR* code.
+ */
+static int enable_batch(struct agent_app *app, struct agent *agt)
+{
+	int ret;
+	uint32_t i, nb_replies, nb_failed = 0;
+	struct agent_event *event;
+	struct lttng_ht_iter iter;
+	struct agent_app_ctx *ctx;
+	struct lttng_dynamic_buffer payload;
+	struct lttcomm_agent_enable_batch msg;
+	struct lttcomm_agent_generic_reply *replies = NULL;
+
+	memset(&msg, 0, sizeof(msg));
+	lttng_dynamic_buffer_init(&payload);
+	if (lttng_dynamic_buffer_append(&payload, &msg, sizeof(msg))) {
+		ret = LTTNG_ERR_NOMEM;
+		goto end;
+	}
+
+	cds_lfht_for_each_entry(agt->events->ht, &iter.iter, event, node.node) {
+		/* Skip event if disabled. */
+		if (!event->enabled) {
+			continue;
+		}
+
+		ret = append_enable_event(&payload, event);
+		if (ret != LTTNG_OK) {
+			goto end;
+		}
+		msg.nb_events++;
+	}
+
+	cds_list_for_each_entry_rcu(ctx, &agt->app_ctx_list, list_node) {
+		ret = append_app_ctx(&payload, ctx);
+		if (ret != LTTNG_OK) {
+			goto end;
+		}
+		msg.nb_contexts++;
+	}
+
+	nb_replies = msg.nb_events + msg.nb_contexts;
+	if (!nb_replies) {
+		ret = LTTNG_OK;
+		goto end;
+	}
+
+	DBG2("Agent enabling %u events and %u contexts for app pid: %d and socket %d",
+			msg.nb_events, msg.nb_contexts, app->pid, app->sock->fd);
+
+	msg.nb_events = htobe32(msg.nb_events);
+	msg.nb_contexts = htobe32(msg.nb_contexts);
+	memcpy(payload.data, &msg, sizeof(msg));
+
+	replies = zmalloc(nb_replies * sizeof(*replies));
+	if (!replies) {
+		ret = LTTNG_ERR_NOMEM;
+		goto end;
+	}
+
+	ret = send_header(app->sock, payload.size, AGENT_CMD_ENABLE_BATCH, 0);
+	if (ret < 0) {
+		goto error_io;
+	}
+
+	ret = send_payload(app->sock, payload.data, payload.size);
+	if (ret < 0) {
+		goto error_io;
+	}
+
+	ret = recv_reply(app->sock, replies, nb_replies * sizeof(*replies));
+	if (ret < 0) {
+		goto error_io;
+	}
+
+	for (i = 0; i < nb_replies; i++) {
+		uint32_t reply_ret_code = be32toh(replies[i].ret_code);
+
+		log_reply_code(reply_ret_code);
+		if (reply_ret_code != AGENT_RET_CODE_SUCCESS) {
+			nb_failed++;
+		}
+	}
+	if (nb_failed) {
+		DBG2("Agent update unable to enable %u of %u events and contexts on app pid: %d sock %d",
+				nb_failed, nb_replies, app->pid, app->sock->fd);
+	}
+
+	ret = LTTNG_OK;
+	goto end;
+
+error_io:
+	ret = LTTNG_ERR_UST_ENABLE_FAIL;
+end:
+	free(replies);
+	lttng_dynamic_buffer_reset(&payload);
+	return ret;
+}
+
 /*
  * Update a agent application (given socket) using the given agent.
  *
@@ -1431,6 +1600,16 @@ void agent_update(struct agent *agt, int sock)
 	 * there is a serious code flow error.
 	 */
 	assert(app);
+
+	if (app->minor_version >= AGENT_MINOR_VERSION_BATCH) {
+		ret = enable_batch(app, agt);
+		if (ret != LTTNG_OK) {
+			DBG2("Agent update unable to enable the events on app pid: %d sock %d",
+					app->pid, app->sock->fd);
+		}
+		goto end;
+	}
+
 	cds_lfht_for_each_entry(agt->events->ht, &iter.iter, event, node.node) {
 		/* Skip event if disabled. */
 		if (!event->enabled) {
@@ -1438,7 +1617,12 @@ void agent_update(struct agent *agt, int sock)
 		}
 
 		ret = enable_event(app, event);
-		if (ret != LTTNG_OK) {
+		if (ret == LTTNG_ERR_UST_ENABLE_FAIL) {
+			/* The socket failed or timed out, the app is unusable. */
+			DBG2("Agent update stopped on app pid: %d sock %d",
+					app->pid, app->sock->fd);
+			goto end;
+		} else if (ret != LTTNG_OK) {
 			DBG2("Agent update unable to enable event %s on app pid: %d sock %d",
 					event->name, app->pid, app->sock->fd);
 			/* Let's try the others here and don't assume the app is dead. */
@@ -1456,5 +1640,6 @@ void agent_update(struct agent *agt, int sock)
 		}
 	}
 
+end:
 	rcu_read_unlock();
 }
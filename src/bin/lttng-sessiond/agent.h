@@ -24,9 +24,14 @@
 #include <common/hashtable/hashtable.h>
 #include <lttng/lttng.h>
 
-/* Agent protocol version that is verified during the agent registration. */
+/*
+ * Agent protocol version that is verified during the agent registration. The
+ * agents of a newer minor version are accepted.
+ */
 #define AGENT_MAJOR_VERSION		2
 #define AGENT_MINOR_VERSION		0
+/* Minor version from which the agents support AGENT_CMD_ENABLE_BATCH. */
+#define AGENT_MINOR_VERSION_BATCH	1
 
 /*
  * Hash table that contains the agent app created upon registration indexed by
@@ -67,6 +72,9 @@ struct agent_app {
 	/* Domain of the application. */
 	enum lttng_domain_type domain;
 
+	/* Minor protocol version sent during registration. */
+	uint32_t minor_version;
+
 	/*
 	 * AGENT TCP socket that was created upon registration.
 	 */
@@ -165,6 +173,7 @@ void agent_delete_app(struct agent_app *app);
 struct agent_app *agent_find_app_by_sock(int sock);
 void agent_destroy_app(struct agent_app *app);
 void agent_destroy_app_by_sock(int sock);
+void agent_unregister_app(struct agent_app *app);
 int agent_send_registration_done(struct agent_app *app);
 
 /* Agent action API */
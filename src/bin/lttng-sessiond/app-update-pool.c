@@ -0,0 +1,260 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include <pthread.h>
+#include <stdlib.h>
+#include <urcu.h>
+#include <urcu/list.h>
+
+#include <common/common.h>
+#include <common/defaults.h>
+
+#include "app-update-pool.h"
+#include "health-sessiond.h"
+#include "utils.h"
+
+/*
+ * Batch of applications being updated. Protected by pool_lock.
+ */
+struct app_update_job {
+	/* Set if the applications are agent applications. */
+	int agent;
+	union {
+		struct ust_app **ust;
+		struct agent_app **agent;
+	} apps;
+	unsigned int nr_apps;
+	/* Index of the next application to update. */
+	unsigned int next;
+	/* Number of updates done. */
+	unsigned int done;
+	/* Number of updates which failed. */
+	unsigned int nr_errors;
+	union {
+		int (*ust)(struct ust_app *app, void *data);
+		int (*agent)(struct agent_app *app, void *data);
+	} update;
+	void *data;
+	/* Node of pool_jobs. */
+	struct cds_list_head node;
+};
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Jobs being run, posted by the dispatch thread and the client workers. */
+static CDS_LIST_HEAD(pool_jobs);
+/* Signaled when a job is posted or the pool quits. */
+static pthread_cond_t pool_work_cond = PTHREAD_COND_INITIALIZER;
+/* Signaled when the last update of a job is done. */
+static pthread_cond_t pool_done_cond = PTHREAD_COND_INITIALIZER;
+static int pool_quit;
+
+static pthread_t *pool_threads;
+static unsigned int pool_nr_threads;
+
+/*
+ * Update the applications of a job until none is left.
+ *
+ * Called with pool_lock held, which is released during the updates.
+ */
+static void run_job(struct app_update_job *job)
+{
+	while (job->next < job->nr_apps) {
+		int ret;
+		unsigned int i = job->next++;
+
+		pthread_mutex_unlock(&pool_lock);
+		health_code_update();
+		if (job->agent) {
+			ret = job->update.agent(job->apps.agent[i], job->data);
+		} else {
+			ret = job->update.ust(job->apps.ust[i], job->data);
+		}
+		pthread_mutex_lock(&pool_lock);
+
+		if (ret < 0) {
+			job->nr_errors++;
+		}
+		if (++job->done == job->nr_apps) {
+			pthread_cond_broadcast(&pool_done_cond);
+		}
+	}
+}
+
+/*
+ * Return a job with applications left to update or NULL if none.
+ *
+ * Called with pool_lock held.
+ */
+static struct app_update_job *next_job(void)
+{
+	struct app_update_job *job;
+
+	cds_list_for_each_entry(job, &pool_jobs, node) {
+		if (job->next < job->nr_apps) {
+			return job;
+		}
+	}
+	return NULL;
+}
+
+static void *thread_app_update(void *data)
+{
+	rcu_register_thread();
+
+	health_register(health_sessiond, HEALTH_SESSIOND_TYPE_APP_UPDATE);
+
+	health_code_update();
+
+	DBG("[thread] Application update thread started");
+
+	pthread_mutex_lock(&pool_lock);
+	for (;;) {
+		struct app_update_job *job;
+
+		if (pool_quit) {
+			break;
+		}
+		job = next_job();
+		if (job) {
+			run_job(job);
+			continue;
+		}
+		health_poll_entry();
+		pthread_cond_wait(&pool_work_cond, &pool_lock);
+		health_poll_exit();
+	}
+	pthread_mutex_unlock(&pool_lock);
+
+	health_unregister(health_sessiond);
+	DBG("Application update thread exiting");
+	rcu_unregister_thread();
+	return NULL;
+}
+
+int init_app_update_pool(unsigned int nr_threads)
+{
+	int ret = 0;
+	unsigned int i;
+
+	if (!nr_threads) {
+		goto end;
+	}
+
+	pool_threads = zmalloc(nr_threads * sizeof(*pool_threads));
+	if (!pool_threads) {
+		PERROR("zmalloc application update threads");
+		ret = -1;
+		goto end;
+	}
+
+	for (i = 0; i < nr_threads; i++) {
+		ret = pthread_create(&pool_threads[i], default_pthread_attr(),
+				thread_app_update, NULL);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_create application update");
+			ret = -1;
+			fini_app_update_pool();
+			goto end;
+		}
+		pool_nr_threads++;
+	}
+	DBG("Application update pool of %u threads started", nr_threads);
+end:
+	return ret;
+}
+
+void fini_app_update_pool(void)
+{
+	int ret;
+	unsigned int i;
+
+	pthread_mutex_lock(&pool_lock);
+	pool_quit = 1;
+	pthread_cond_broadcast(&pool_work_cond);
+	pthread_mutex_unlock(&pool_lock);
+
+	for (i = 0; i < pool_nr_threads; i++) {
+		ret = pthread_join(pool_threads[i], NULL);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_join application update");
+		}
+	}
+	free(pool_threads);
+	pool_threads = NULL;
+	pool_nr_threads = 0;
+}
+
+/*
+ * Run a job on the pool and wait for its completion.
+ *
+ * Return the number of updates which failed.
+ */
+static unsigned int run(struct app_update_job *job)
+{
+	if (!job->nr_apps) {
+		return 0;
+	}
+
+	pthread_mutex_lock(&pool_lock);
+	cds_list_add_tail(&job->node, &pool_jobs);
+	if (job->nr_apps > 1) {
+		pthread_cond_broadcast(&pool_work_cond);
+	}
+	/*
+	 * The caller runs its own job, so it completes even when all the
+	 * update threads are blocked in the updates of other jobs.
+	 */
+	run_job(job);
+	while (job->done < job->nr_apps) {
+		pthread_cond_wait(&pool_done_cond, &pool_lock);
+	}
+	cds_list_del(&job->node);
+	pthread_mutex_unlock(&pool_lock);
+
+	return job->nr_errors;
+}
+
+unsigned int app_update_pool_run(struct ust_app **apps, unsigned int nr_apps,
+		int (*update)(struct ust_app *app, void *data), void *data)
+{
+	struct app_update_job job = {
+		.apps.ust = apps,
+		.nr_apps = nr_apps,
+		.update.ust = update,
+		.data = data,
+	};
+
+	return run(&job);
+}
+
+unsigned int app_update_pool_run_agents(struct agent_app **apps,
+		unsigned int nr_apps,
+		int (*update)(struct agent_app *app, void *data), void *data)
+{
+	struct app_update_job job = {
+		.agent = 1,
+		.apps.agent = apps,
+		.nr_apps = nr_apps,
+		.update.agent = update,
+		.data = data,
+	};
+
+	return run(&job);
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _LTTNG_APP_UPDATE_POOL_H
+#define _LTTNG_APP_UPDATE_POOL_H
+
+struct ust_app;
+struct agent_app;
+
+/*
+ * The application update pool runs a per-application operation on a batch
+ * of applications concurrently: the setup of the tracing sessions of newly
+ * registered applications, or the start, stop and flush of a session on all
+ * the applications, or the update of newly registered agent applications. The
+ * caller takes part in the work, so a pool without threads runs the
+ * operations one at a time.
+ */
+
+/*
+ * Launch "nr_threads" update threads, which can be 0.
+ *
+ * Return 0 on success or else a negative value.
+ */
+int init_app_update_pool(unsigned int nr_threads);
+
+/*
+ * Stop and join the update threads. MUST be called once no thread can run
+ * an update anymore.
+ */
+void fini_app_update_pool(void);
+
+/*
+ * Call "update" with "data" on each of the "nr_apps" applications,
+ * concurrently on the update threads, and wait for all the calls to return.
+ * Several batches can be run at once.
+ *
+ * Return the number of calls which returned a negative value.
+ */
+unsigned int app_update_pool_run(struct ust_app **apps, unsigned int nr_apps,
+		int (*update)(struct ust_app *app, void *data), void *data);
+
+/*
+ * Same as app_update_pool_run() for agent applications.
+ */
+unsigned int app_update_pool_run_agents(struct agent_app **apps,
+		unsigned int nr_apps,
+		int (*update)(struct agent_app *app, void *data), void *data);
+
+#endif /* _LTTNG_APP_UPDATE_POOL_H */
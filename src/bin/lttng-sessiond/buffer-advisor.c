@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include <common/time.h>
+
+#include "buffer-advisor.h"
+
+void buffer_advisor_init(struct buffer_advisor *advisor)
+{
+	memset(advisor, 0, sizeof(*advisor));
+}
+
+void buffer_advisor_sample(struct buffer_advisor *advisor,
+		uint64_t highest_usage, uint64_t discarded_events,
+		uint64_t timestamp)
+{
+	if (!advisor->nr_samples ||
+			discarded_events < advisor->last_discarded_events ||
+			timestamp < advisor->last_timestamp) {
+		advisor->first_discarded_events = discarded_events;
+		advisor->first_timestamp = timestamp;
+	}
+	if (highest_usage > advisor->peak_usage) {
+		advisor->peak_usage = highest_usage;
+	}
+	advisor->last_discarded_events = discarded_events;
+	advisor->last_timestamp = timestamp;
+	advisor->nr_samples++;
+}
+
+static uint64_t next_pow2(uint64_t v)
+{
+	uint64_t pow2 = 1;
+
+	while (pow2 < v) {
+		pow2 <<= 1;
+	}
+	return pow2;
+}
+
+bool buffer_advisor_recommend(const struct buffer_advisor *advisor,
+		const struct buffer_geometry *current, uint64_t target_rate,
+		bool final, struct buffer_geometry *recommended)
+{
+	uint64_t elapsed, discarded, capacity;
+
+	*recommended = *current;
+	elapsed = advisor->last_timestamp - advisor->first_timestamp;
+	discarded = advisor->last_discarded_events -
+			advisor->first_discarded_events;
+	capacity = current->subbuf_size * current->num_subbuf;
+
+	if (!advisor->nr_samples || !capacity) {
+		goto end;
+	}
+
+	/* Compare discarded / elapsed to the target without dividing. */
+	if (elapsed && (double) discarded * NSEC_PER_SEC >
+			(double) target_rate * elapsed) {
+		/*
+		 * More sub-buffers absorb the bursts the consumer can not keep
+		 * up with, at the same packet size.
+		 */
+		recommended->num_subbuf = current->num_subbuf * 2;
+		goto end;
+	}
+
+	if (discarded || advisor->peak_usage * 4 > capacity ||
+			(!final && advisor->nr_samples < BUFFER_ADVISOR_MIN_SAMPLES)) {
+		goto end;
+	}
+
+	/* At least two sub-buffers, so that one is written while one is read. */
+	capacity = next_pow2(advisor->peak_usage * 2);
+	if (capacity < 2 * BUFFER_ADVISOR_MIN_SUBBUF_SIZE) {
+		capacity = 2 * BUFFER_ADVISOR_MIN_SUBBUF_SIZE;
+	}
+	if (capacity >= current->subbuf_size * current->num_subbuf) {
+		goto end;
+	}
+	if (capacity >= 2 * current->subbuf_size) {
+		recommended->num_subbuf = capacity / current->subbuf_size;
+	} else {
+		recommended->num_subbuf = 2;
+		recommended->subbuf_size = capacity / 2;
+	}
+
+end:
+	return recommended->subbuf_size != current->subbuf_size ||
+			recommended->num_subbuf != current->num_subbuf;
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _LTTNG_BUFFER_ADVISOR_H
+#define _LTTNG_BUFFER_ADVISOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Smallest sub-buffer size recommended, a page on most architectures. */
+#define BUFFER_ADVISOR_MIN_SUBBUF_SIZE	4096
+/* Samples of a channel needed before recommending smaller buffers. */
+#define BUFFER_ADVISOR_MIN_SAMPLES	60
+
+struct buffer_geometry {
+	uint64_t subbuf_size;
+	uint64_t num_subbuf;
+};
+
+/*
+ * Peak usage and discard history of a channel, built from its monitor
+ * samples, to recommend the smallest buffer geometry meeting a target rate of
+ * discarded events.
+ */
+struct buffer_advisor {
+	/* Highest usage of a stream of the channel, in bytes. */
+	uint64_t peak_usage;
+	/* Discarded events counter and time (nsec) of the observation start. */
+	uint64_t first_discarded_events;
+	uint64_t first_timestamp;
+	uint64_t last_discarded_events;
+	uint64_t last_timestamp;
+	uint64_t nr_samples;
+	/* Last recommendation reported, zeroed if none. */
+	struct buffer_geometry reported;
+};
+
+void buffer_advisor_init(struct buffer_advisor *advisor);
+
+/*
+ * Account a monitor sample of the channel. A discarded events counter going
+ * backward restarts the observation.
+ */
+void buffer_advisor_sample(struct buffer_advisor *advisor,
+		uint64_t highest_usage, uint64_t discarded_events,
+		uint64_t timestamp);
+
+/*
+ * Recommend a buffer geometry for a channel of geometry "current" from its
+ * history: twice the sub-buffers when more than "target_rate" events per
+ * second were discarded, or the smallest power of two capacity holding twice
+ * the peak usage when it stayed under a quarter of the capacity and no
+ * events were discarded. Smaller buffers are only recommended after
+ * BUFFER_ADVISOR_MIN_SAMPLES samples, or at the end of the observation if
+ * "final" is set.
+ *
+ * Return true and set "recommended" if it differs from "current".
+ */
+bool buffer_advisor_recommend(const struct buffer_advisor *advisor,
+		const struct buffer_geometry *current, uint64_t target_rate,
+		bool final, struct buffer_geometry *recommended);
+
+#endif /* _LTTNG_BUFFER_ADVISOR_H */
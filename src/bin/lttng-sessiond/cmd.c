@@ -19,6 +19,9 @@
 #define _LGPL_SOURCE
 #include <assert.h>
 #include <inttypes.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <urcu.h>
 #include <urcu/list.h>
 #include <urcu/uatomic.h>
 
@@ -31,6 +34,7 @@
 #include <common/kernel-ctl/kernel-ctl.h>
 #include <common/dynamic-buffer.h>
 #include <common/buffer-view.h>
+#include <common/config/session-config.h>
 #include <lttng/trigger/trigger-internal.h>
 #include <lttng/condition/condition.h>
 #include <lttng/action/action.h>
@@ -45,6 +49,7 @@
 #include "kernel.h"
 #include "kernel-consumer.h"
 #include "lttng-sessiond.h"
+#include "modprobe.h"
 #include "utils.h"
 #include "syscall.h"
 #include "agent.h"
@@ -152,45 +157,41 @@ error:
 
 /*
  * Get run-time attributes if the session has been started (discarded events,
- * lost packets).
+ * lost packets) from the "stats" of consumer_get_channel_stats().
  */
 static int get_kernel_runtime_stats(struct ltt_session *session,
-		struct ltt_kernel_channel *kchan, uint64_t *discarded_events,
+		struct ltt_kernel_channel *kchan,
+		const struct lttcomm_consumer_channel_stats *stats,
+		size_t nr_stats, uint64_t *discarded_events,
 		uint64_t *lost_packets)
 {
-	int ret;
+	const struct lttcomm_consumer_channel_stats *chan_stats;
 
-	if (!session->has_been_started) {
-		ret = 0;
-		*discarded_events = 0;
-		*lost_packets = 0;
-		goto end;
-	}
+	*discarded_events = 0;
+	*lost_packets = 0;
 
-	ret = consumer_get_discarded_events(session->id, kchan->fd,
-			session->kernel_session->consumer,
-			discarded_events);
-	if (ret < 0) {
+	if (!session->has_been_started) {
 		goto end;
 	}
 
-	ret = consumer_get_lost_packets(session->id, kchan->fd,
-			session->kernel_session->consumer,
-			lost_packets);
-	if (ret < 0) {
-		goto end;
+	chan_stats = consumer_find_channel_stats(stats, nr_stats, kchan->fd);
+	if (chan_stats) {
+		*discarded_events = chan_stats->discarded_events;
+		*lost_packets = chan_stats->lost_packets;
 	}
 
 end:
-	return ret;
+	return 0;
 }
 
 /*
  * Get run-time attributes if the session has been started (discarded events,
- * lost packets).
+ * lost packets) from the "stats" of consumer_get_channel_stats().
  */
 static int get_ust_runtime_stats(struct ltt_session *session,
-		struct ltt_ust_channel *uchan, uint64_t *discarded_events,
+		struct ltt_ust_channel *uchan,
+		const struct lttcomm_consumer_channel_stats *stats,
+		size_t nr_stats, uint64_t *discarded_events,
 		uint64_t *lost_packets)
 {
 	int ret;
@@ -215,13 +216,13 @@ static int get_ust_runtime_stats(struct ltt_session *session,
 	if (usess->buffer_type == LTTNG_BUFFER_PER_UID) {
 		ret = ust_app_uid_get_channel_runtime_stats(usess->id,
 				&usess->buffer_reg_uid_list,
-				usess->consumer, uchan->id,
+				stats, nr_stats, uchan->id,
 				uchan->attr.overwrite,
 				discarded_events,
 				lost_packets);
 	} else if (usess->buffer_type == LTTNG_BUFFER_PER_PID) {
 		ret = ust_app_pid_get_channel_runtime_stats(usess,
-				uchan, usess->consumer,
+				uchan, stats, nr_stats,
 				uchan->attr.overwrite,
 				discarded_events,
 				lost_packets);
@@ -250,6 +251,8 @@ static ssize_t list_lttng_channels(enum lttng_domain_type domain,
 {
 	int i = 0, ret = 0;
 	struct ltt_kernel_channel *kchan;
+	struct lttcomm_consumer_channel_stats *stats = NULL;
+	size_t nr_stats = 0;
 
 	DBG("Listing channels for session %s", session->name);
 
@@ -257,6 +260,15 @@ static ssize_t list_lttng_channels(enum lttng_domain_type domain,
 	case LTTNG_DOMAIN_KERNEL:
 		/* Kernel channels */
 		if (session->kernel_session != NULL) {
+			/* One consumer round trip for the stats of all channels. */
+			if (session->has_been_started) {
+				ret = consumer_get_channel_stats(session->id,
+						session->kernel_session->consumer,
+						&stats, &nr_stats);
+				if (ret < 0) {
+					goto end;
+				}
+			}
 			cds_list_for_each_entry(kchan,
 					&session->kernel_session->channel_list.head, list) {
 				uint64_t discarded_events, lost_packets;
@@ -266,6 +278,7 @@ static ssize_t list_lttng_channels(enum lttng_domain_type domain,
 						kchan->channel->attr.extended.ptr;
 
 				ret = get_kernel_runtime_stats(session, kchan,
+						stats, nr_stats,
 						&discarded_events, &lost_packets);
 				if (ret < 0) {
 					goto end;
@@ -279,6 +292,8 @@ static ssize_t list_lttng_channels(enum lttng_domain_type domain,
 				chan_exts[i].monitor_timer_interval =
 						extended->monitor_timer_interval;
 				chan_exts[i].blocking_timeout = 0;
+				chan_exts[i].compression = extended->compression;
+				chan_exts[i].huge_pages = 0;
 				i++;
 			}
 		}
@@ -288,6 +303,16 @@ static ssize_t list_lttng_channels(enum lttng_domain_type domain,
 		struct lttng_ht_iter iter;
 		struct ltt_ust_channel *uchan;
 
+		/* One consumer round trip for the stats of all channels. */
+		if (session->ust_session && session->has_been_started) {
+			ret = consumer_get_channel_stats(session->ust_session->id,
+					session->ust_session->consumer,
+					&stats, &nr_stats);
+			if (ret < 0) {
+				goto end;
+			}
+		}
+
 		rcu_read_lock();
 		cds_lfht_for_each_entry(session->ust_session->domain_global.channels->ht,
 				&iter.iter, uchan, node.node) {
@@ -328,8 +353,11 @@ static ssize_t list_lttng_channels(enum lttng_domain_type domain,
 					uchan->monitor_timer_interval;
 			chan_exts[i].blocking_timeout =
 				uchan->attr.u.s.blocking_timeout;
+			chan_exts[i].compression = uchan->compression;
+			chan_exts[i].huge_pages = uchan->huge_pages;
 
 			ret = get_ust_runtime_stats(session, uchan,
+					stats, nr_stats,
 					&discarded_events, &lost_packets);
 			if (ret < 0) {
 				break;
@@ -346,6 +374,7 @@ static ssize_t list_lttng_channels(enum lttng_domain_type domain,
 	}
 
 end:
+	free(stats);
 	if (ret < 0) {
 		return -LTTNG_ERR_FATAL;
 	} else {
@@ -736,6 +765,7 @@ static int add_uri_to_consumer(struct consumer_output *consumer,
 	switch (uri->dtype) {
 	case LTTNG_DST_IPV4:
 	case LTTNG_DST_IPV6:
+	case LTTNG_DST_UNIX:
 		DBG2("Setting network URI to consumer");
 
 		if (consumer->type == CONSUMER_DST_NET) {
@@ -1124,6 +1154,12 @@ static int start_kernel_session(struct ltt_kernel_session *ksess, int wpipe)
 			/* Update the stream global counter */
 			ksess->stream_count_global += ret;
 		}
+		/* One command per channel for the system calls enabled so far. */
+		ret = kernel_apply_syscall_mask(kchan);
+		if (ret < 0) {
+			ret = LTTNG_ERR_KERN_ENABLE_FAIL;
+			goto error;
+		}
 	}
 
 	/* Setup kernel consumer socket and send fds to it */
@@ -1309,6 +1345,135 @@ error:
 	return ret;
 }
 
+/*
+ * Return 1 if every range is a valid range of PIDs, else 0.
+ */
+static int pid_ranges_are_valid(const struct lttng_pid_range *ranges,
+		unsigned int nb_ranges)
+{
+	unsigned int i;
+
+	for (i = 0; i < nb_ranges; i++) {
+		if (ranges[i].start < 0 || ranges[i].start > ranges[i].end) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+ * Command LTTNG_TRACK_PID_RANGES processed by the client thread.
+ *
+ * The kernel tracer is waited for once all the ranges are tracked.
+ *
+ * Called with session lock held.
+ */
+int cmd_track_pid_ranges(struct ltt_session *session,
+		enum lttng_domain_type domain,
+		const struct lttng_pid_range *ranges, unsigned int nb_ranges)
+{
+	int ret;
+
+	if (!pid_ranges_are_valid(ranges, nb_ranges)) {
+		return LTTNG_ERR_INVALID;
+	}
+
+	rcu_read_lock();
+
+	switch (domain) {
+	case LTTNG_DOMAIN_KERNEL:
+		ret = kernel_track_pid_ranges(session->kernel_session, ranges,
+				nb_ranges);
+		kernel_wait_quiescent(kernel_tracer_fd);
+		break;
+	case LTTNG_DOMAIN_UST:
+		ret = trace_ust_track_pid_ranges(session->ust_session, ranges,
+				nb_ranges);
+		break;
+	default:
+		ret = LTTNG_ERR_UNKNOWN_DOMAIN;
+		break;
+	}
+
+	rcu_read_unlock();
+	return ret;
+}
+
+/*
+ * Command LTTNG_UNTRACK_PID_RANGES processed by the client thread.
+ *
+ * Called with session lock held.
+ */
+int cmd_untrack_pid_ranges(struct ltt_session *session,
+		enum lttng_domain_type domain,
+		const struct lttng_pid_range *ranges, unsigned int nb_ranges)
+{
+	int ret;
+
+	if (!pid_ranges_are_valid(ranges, nb_ranges)) {
+		return LTTNG_ERR_INVALID;
+	}
+
+	rcu_read_lock();
+
+	switch (domain) {
+	case LTTNG_DOMAIN_KERNEL:
+		ret = kernel_untrack_pid_ranges(session->kernel_session,
+				ranges, nb_ranges);
+		kernel_wait_quiescent(kernel_tracer_fd);
+		break;
+	case LTTNG_DOMAIN_UST:
+		ret = trace_ust_untrack_pid_ranges(session->ust_session,
+				ranges, nb_ranges);
+		break;
+	default:
+		ret = LTTNG_ERR_UNKNOWN_DOMAIN;
+		break;
+	}
+
+	rcu_read_unlock();
+	return ret;
+}
+
+/*
+ * Check that the packet compression of a channel, if any, can be done. The
+ * packets are compressed by the consumer from the mmap'd sub-buffers and live
+ * viewers expect uncompressed packets.
+ *
+ * Return LTTNG_OK on success or else an LTTng error code.
+ */
+static int validate_channel_compression(struct ltt_session *session,
+		struct lttng_channel *attr)
+{
+	int ret = LTTNG_OK;
+	struct lttng_channel_extended *extended =
+			(struct lttng_channel_extended *) attr->attr.extended.ptr;
+
+	if (!extended ||
+			extended->compression == LTTNG_CHANNEL_COMPRESSION_NONE) {
+		goto end;
+	}
+
+	if (extended->compression != LTTNG_CHANNEL_COMPRESSION_ZLIB) {
+		ret = LTTNG_ERR_INVALID;
+		goto end;
+	}
+
+#ifndef HAVE_LIBZ
+	ret = LTTNG_ERR_COMPRESSION_UNSUPPORTED;
+	goto end;
+#endif
+
+	if (session->live_timer > 0 ||
+			attr->attr.output == LTTNG_EVENT_SPLICE) {
+		ret = LTTNG_ERR_COMPRESSION_UNSUPPORTED;
+		goto end;
+	}
+
+end:
+	return ret;
+}
+
 /*
  * Command LTTNG_ENABLE_CHANNEL processed by the client thread.
  *
@@ -1358,10 +1523,23 @@ int cmd_enable_channel(struct ltt_session *session,
 		attr->attr.switch_timer_interval = 0;
 	}
 
+	ret = validate_channel_compression(session, attr);
+	if (ret != LTTNG_OK) {
+		goto error;
+	}
+
 	/* Check for feature support */
 	switch (domain->type) {
 	case LTTNG_DOMAIN_KERNEL:
 	{
+		struct lttng_channel_extended *extended =
+				(struct lttng_channel_extended *) attr->attr.extended.ptr;
+
+		/* The kernel tracer allocates its own buffers. */
+		if (extended && extended->huge_pages) {
+			ret = LTTNG_ERR_INVALID;
+			goto error;
+		}
 		if (kernel_supports_ring_buffer_snapshot_sample_positions(kernel_tracer_fd) != 1) {
 			/* Sampling position of buffer is not supported */
 			WARN("Kernel tracer does not support buffer monitoring. "
@@ -1857,6 +2035,11 @@ static int _cmd_enable_event(struct ltt_session *session,
 			goto error;
 		}
 
+		if (modprobe_lttng_data_deferred()) {
+			ret = LTTNG_ERR_KERN_ENABLE_FAIL;
+			goto error;
+		}
+
 		kchan = trace_kernel_get_channel_by_name(channel_name,
 				session->kernel_session);
 		if (kchan == NULL) {
@@ -1894,6 +2077,27 @@ static int _cmd_enable_event(struct ltt_session *session,
 			char *filter_expression_a = NULL;
 			struct lttng_filter_bytecode *filter_a = NULL;
 
+			if (!filter_expression && !filter) {
+				struct lttng_event syscall_event = *event;
+				struct lttng_event *events[] = {
+					event, &syscall_event,
+				};
+
+				/* Create both events in a single batch. */
+				event->type = LTTNG_EVENT_TRACEPOINT;	/* Hack */
+				syscall_event.type = LTTNG_EVENT_SYSCALL;
+				ret = event_kernel_enable_events(kchan, events,
+						ARRAY_SIZE(events));
+				if (ret != LTTNG_OK) {
+					if (channel_created && !kchan->event_count) {
+						/* Let's not leak a useless channel. */
+						kernel_destroy_channel(kchan);
+					}
+					goto error;
+				}
+				break;
+			}
+
 			/*
 			 * We need to duplicate filter_expression and filter,
 			 * because ownership is passed to first enable
@@ -2229,13 +2433,24 @@ static int cmd_enable_event_internal(struct ltt_session *session,
  * Command LTTNG_LIST_TRACEPOINTS processed by the client thread.
  */
 ssize_t cmd_list_tracepoints(enum lttng_domain_type domain,
+		pid_t pid_cursor, unsigned int page_len,
 		struct lttng_event **events)
 {
 	int ret;
 	ssize_t nb_events = 0;
 
+	/* Only the UST tracepoints are listed by pages. */
+	if (page_len && domain != LTTNG_DOMAIN_UST) {
+		ret = LTTNG_ERR_INVALID;
+		goto error;
+	}
+
 	switch (domain) {
 	case LTTNG_DOMAIN_KERNEL:
+		if (modprobe_lttng_data_deferred()) {
+			ret = LTTNG_ERR_KERN_LIST_FAIL;
+			goto error;
+		}
 		nb_events = kernel_list_events(kernel_tracer_fd, events);
 		if (nb_events < 0) {
 			ret = LTTNG_ERR_KERN_LIST_FAIL;
@@ -2243,7 +2458,7 @@ ssize_t cmd_list_tracepoints(enum lttng_domain_type domain,
 		}
 		break;
 	case LTTNG_DOMAIN_UST:
-		nb_events = ust_app_list_events(events);
+		nb_events = ust_app_list_events(events, pid_cursor, page_len);
 		if (nb_events < 0) {
 			ret = LTTNG_ERR_UST_LIST_FAIL;
 			goto error;
@@ -2274,6 +2489,7 @@ error:
  * Command LTTNG_LIST_TRACEPOINT_FIELDS processed by the client thread.
  */
 ssize_t cmd_list_tracepoint_fields(enum lttng_domain_type domain,
+		pid_t pid_cursor, unsigned int page_len,
 		struct lttng_event_field **fields)
 {
 	int ret;
@@ -2281,7 +2497,8 @@ ssize_t cmd_list_tracepoint_fields(enum lttng_domain_type domain,
 
 	switch (domain) {
 	case LTTNG_DOMAIN_UST:
-		nb_fields = ust_app_list_event_fields(fields);
+		nb_fields = ust_app_list_event_fields(fields, pid_cursor,
+				page_len);
 		if (nb_fields < 0) {
 			ret = LTTNG_ERR_UST_LIST_FAIL;
 			goto error;
@@ -2579,10 +2796,13 @@ error:
 }
 
 /*
- * Command LTTNG_CREATE_SESSION processed by the client thread.
+ * Create a session and set up its consumer output. The session is not
+ * published to the lock-free lookups so that the caller can complete its
+ * set up.
  */
-int cmd_create_session_uri(char *name, struct lttng_uri *uris,
-		size_t nb_uri, lttng_sock_cred *creds, unsigned int live_timer)
+static int create_session_uri(char *name, struct lttng_uri *uris,
+		size_t nb_uri, lttng_sock_cred *creds, unsigned int live_timer,
+		struct ltt_session **session_out)
 {
 	int ret;
 	struct ltt_session *session;
@@ -2591,19 +2811,9 @@ int cmd_create_session_uri(char *name, struct lttng_uri *uris,
 	assert(creds);
 
 	/*
-	 * Verify if the session already exist
-	 *
-	 * XXX: There is no need for the session lock list here since the caller
-	 * (process_client_msg) is holding it. We might want to change that so a
-	 * single command does not lock the entire session list.
+	 * Create tracing session in the registry. This fails if the session
+	 * already exists.
 	 */
-	session = session_find_by_name(name);
-	if (session != NULL) {
-		ret = LTTNG_ERR_EXIST_SESS;
-		goto find_error;
-	}
-
-	/* Create tracing session in the registry */
 	ret = session_create(name, LTTNG_SOCK_GET_UID_CRED(creds),
 			LTTNG_SOCK_GET_GID_CRED(creds));
 	if (ret != LTTNG_OK) {
@@ -2611,13 +2821,12 @@ int cmd_create_session_uri(char *name, struct lttng_uri *uris,
 	}
 
 	/*
-	 * Get the newly created session pointer back
-	 *
-	 * XXX: There is no need for the session lock list here since the caller
-	 * (process_client_msg) is holding it. We might want to change that so a
-	 * single command does not lock the entire session list.
+	 * Get the newly created session pointer back. It can't be destroyed by
+	 * another command before it is published.
 	 */
+	rcu_read_lock();
 	session = session_find_by_name(name);
+	rcu_read_unlock();
 	assert(session);
 
 	session->live_timer = live_timer;
@@ -2640,13 +2849,34 @@ int cmd_create_session_uri(char *name, struct lttng_uri *uris,
 	}
 
 	session->consumer->enabled = 1;
+	*session_out = session;
 
 	return LTTNG_OK;
 
 consumer_error:
+	session_lock_list();
 	session_destroy(session);
+	session_unlock_list();
 session_error:
-find_error:
+	return ret;
+}
+
+/*
+ * Command LTTNG_CREATE_SESSION processed by the client thread.
+ */
+int cmd_create_session_uri(char *name, struct lttng_uri *uris,
+		size_t nb_uri, lttng_sock_cred *creds, unsigned int live_timer)
+{
+	int ret;
+	struct ltt_session *session;
+
+	ret = create_session_uri(name, uris, nb_uri, creds, live_timer,
+			&session);
+	if (ret != LTTNG_OK) {
+		goto error;
+	}
+	session_publish(session);
+error:
 	return ret;
 }
 
@@ -2667,15 +2897,11 @@ int cmd_create_session_snapshot(char *name, struct lttng_uri *uris,
 	 * Create session in no output mode with URIs set to NULL. The uris we've
 	 * received are for a default snapshot output if one.
 	 */
-	ret = cmd_create_session_uri(name, NULL, 0, creds, 0);
+	ret = create_session_uri(name, NULL, 0, creds, 0, &session);
 	if (ret != LTTNG_OK) {
 		goto error;
 	}
 
-	/* Get the newly created session pointer back. This should NEVER fail. */
-	session = session_find_by_name(name);
-	assert(session);
-
 	/* Flag session for snapshot mode. */
 	session->snapshot_mode = 1;
 
@@ -2706,12 +2932,15 @@ int cmd_create_session_snapshot(char *name, struct lttng_uri *uris,
 	rcu_read_unlock();
 
 end:
+	session_publish(session);
 	return LTTNG_OK;
 
 error_snapshot:
 	snapshot_output_destroy(new_output);
 error_snapshot_alloc:
+	session_lock_list();
 	session_destroy(session);
+	session_unlock_list();
 error:
 	return ret;
 }
@@ -2719,7 +2948,8 @@ error:
 /*
  * Command LTTNG_DESTROY_SESSION processed by the client thread.
  *
- * Called with session lock held.
+ * Called with the session list lock and session lock held. The session lock is
+ * released.
  */
 int cmd_destroy_session(struct ltt_session *session, int wpipe)
 {
@@ -2760,6 +2990,12 @@ int cmd_destroy_session(struct ltt_session *session, int wpipe)
 		PERROR("write kernel poll pipe");
 	}
 
+	/*
+	 * The lock-free readers waiting on the session lock see that the session
+	 * is gone and release it.
+	 */
+	session->alive = 0;
+	session_unlock(session);
 	ret = session_destroy(session);
 
 	return ret;
@@ -2984,6 +3220,122 @@ end:
 	return ret;
 }
 
+/*
+ * Command LTTNG_LIST_STREAM_STATS processed by the client thread.
+ *
+ * Return the size of the "stats" array in bytes, which the caller must free,
+ * or else a negative lttng_error_code.
+ */
+ssize_t cmd_list_stream_stats(enum lttng_domain_type domain,
+		struct ltt_session *session, const char *channel_name,
+		struct lttng_stream_stats **stats)
+{
+	ssize_t ret;
+	size_t nr_stats = 0;
+
+	*stats = NULL;
+
+	switch (domain) {
+	case LTTNG_DOMAIN_KERNEL:
+	{
+		struct ltt_kernel_channel *kchan;
+		struct ltt_kernel_session *ksess = session->kernel_session;
+
+		kchan = ksess ? trace_kernel_get_channel_by_name(
+				(char *) channel_name, ksess) : NULL;
+		if (!kchan) {
+			ret = -LTTNG_ERR_KERN_CHAN_NOT_FOUND;
+			goto end;
+		}
+		if (!session->has_been_started) {
+			break;
+		}
+		ret = consumer_get_stream_stats(kchan->fd, ksess->consumer,
+				stats, &nr_stats);
+		if (ret < 0) {
+			ret = -LTTNG_ERR_FATAL;
+			goto error;
+		}
+		break;
+	}
+	case LTTNG_DOMAIN_UST:
+	{
+		struct ltt_ust_channel *uchan;
+		struct ltt_ust_session *usess = session->ust_session;
+
+		rcu_read_lock();
+		uchan = usess ? trace_ust_find_channel_by_name(
+				usess->domain_global.channels,
+				(char *) channel_name) :
+				NULL;
+		if (!uchan) {
+			rcu_read_unlock();
+			ret = -LTTNG_ERR_UST_CHAN_NOT_FOUND;
+			goto end;
+		}
+		if (!session->has_been_started) {
+			rcu_read_unlock();
+			break;
+		}
+		if (usess->buffer_type == LTTNG_BUFFER_PER_UID) {
+			ret = ust_app_uid_get_stream_stats(usess, uchan, stats,
+					&nr_stats);
+		} else {
+			ret = ust_app_pid_get_stream_stats(usess, uchan, stats,
+					&nr_stats);
+		}
+		rcu_read_unlock();
+		if (ret < 0) {
+			ret = -LTTNG_ERR_FATAL;
+			goto error;
+		}
+		break;
+	}
+	default:
+		ret = -LTTNG_ERR_UND;
+		goto end;
+	}
+
+	ret = nr_stats * sizeof(**stats);
+end:
+	return ret;
+error:
+	free(*stats);
+	*stats = NULL;
+	return ret;
+}
+
+/*
+ * Command LTTNG_LIST_MEMORY_USAGE processed by the client thread.
+ *
+ * Return the size of the "usage" array in bytes, which the caller must free,
+ * or else a negative lttng_error_code.
+ */
+ssize_t cmd_list_memory_usage(enum lttng_domain_type domain,
+		struct ltt_session *session, struct lttng_memory_usage **usage)
+{
+	int ret;
+	size_t nr_usage = 0;
+
+	*usage = NULL;
+
+	if (domain != LTTNG_DOMAIN_UST) {
+		return -LTTNG_ERR_UND;
+	}
+	if (!session->ust_session) {
+		return 0;
+	}
+
+	ret = ust_app_get_memory_usage(session->ust_session, usage, &nr_usage);
+	if (ret < 0) {
+		free(*usage);
+		*usage = NULL;
+		return -LTTNG_ERR_NOMEM;
+	}
+
+	return nr_usage * sizeof(**usage);
+}
+
 /*
  * Command LTTNG_LIST_EVENTS processed by the client thread.
  */
@@ -3047,16 +3399,16 @@ error:
  * Using the session list, filled a lttng_session array to send back to the
  * client for session listing.
  *
- * The session list lock MUST be acquired before calling this function. Use
- * session_lock_list() and session_unlock_list().
+ * The session list lock is not held: the list is iterated lock-free. At most
+ * "nr_sessions" are listed. Return the number of sessions listed.
  */
-void cmd_list_lttng_sessions(struct lttng_session *sessions, uid_t uid,
-		gid_t gid)
+unsigned int cmd_list_lttng_sessions(struct lttng_session *sessions,
+		unsigned int nr_sessions, uid_t uid, gid_t gid)
 {
 	int ret;
 	unsigned int i = 0;
 	struct ltt_session *session;
-	struct ltt_session_list *list = session_get_list();
+	struct ltt_session_list_iter iter = SESSION_LIST_ITER_INIT;
 
 	DBG("Getting all available session for UID %d GID %d",
 			uid, gid);
@@ -3064,16 +3416,20 @@ void cmd_list_lttng_sessions(struct lttng_session *sessions, uid_t uid,
 	 * Iterate over session list and append data after the control struct in
 	 * the buffer.
 	 */
-	cds_list_for_each_entry(session, &list->head, list) {
+	while (i < nr_sessions && (session = session_lock_next_alive(&iter))) {
+		struct ltt_kernel_session *ksess;
+		struct ltt_ust_session *usess;
+
 		/*
 		 * Only list the sessions the user can control.
 		 */
 		if (!session_access_ok(session, uid, gid)) {
+			session_unlock(session);
 			continue;
 		}
 
-		struct ltt_kernel_session *ksess = session->kernel_session;
-		struct ltt_ust_session *usess = session->ust_session;
+		ksess = session->kernel_session;
+		usess = session->ust_session;
 
 		if (session->consumer->type == CONSUMER_DST_NET ||
 				(ksess && ksess->consumer->type == CONSUMER_DST_NET) ||
@@ -3086,6 +3442,7 @@ void cmd_list_lttng_sessions(struct lttng_session *sessions, uid_t uid,
 		}
 		if (ret < 0) {
 			PERROR("snprintf session path");
+			session_unlock(session);
 			continue;
 		}
 
@@ -3094,8 +3451,11 @@ void cmd_list_lttng_sessions(struct lttng_session *sessions, uid_t uid,
 		sessions[i].enabled = session->active;
 		sessions[i].snapshot_mode = session->snapshot_mode;
 		sessions[i].live_timer_interval = session->live_timer;
+		session_unlock(session);
 		i++;
 	}
+	session_list_iter_fini(&iter);
+	return i;
 }
 
 /*
@@ -3427,6 +3787,9 @@ int ust_regenerate_metadata(struct ltt_ust_session *usess)
 	struct buffer_reg_uid *uid_reg = NULL;
 	struct buffer_reg_session *session_reg = NULL;
 
+	/* Regenerate the clock description with a precise offset. */
+	ust_metadata_measure_clock_offset();
+
 	rcu_read_lock();
 	cds_list_for_each_entry(uid_reg, &usess->buffer_reg_uid_list, lnode) {
 		struct ust_registry_session *registry;
@@ -3438,6 +3801,7 @@ int ust_regenerate_metadata(struct ltt_ust_session *usess)
 
 		pthread_mutex_lock(&registry->lock);
 		registry->metadata_len_sent = 0;
+		registry->metadata_len_written = 0;
 		memset(registry->metadata, 0, registry->metadata_alloc_len);
 		registry->metadata_len = 0;
 		registry->metadata_version++;
@@ -3588,6 +3952,111 @@ end:
 	return ret;
 }
 
+/*
+ * Command LTTNG_ROTATE_SESSION from the lttng-ctl library.
+ *
+ * Switch every stream of the session to a new trace chunk directory at its
+ * next packet boundary, without stopping the tracing. The previous trace
+ * chunk is not written anymore once this returns and can be moved away. When
+ * "path" is empty, the Nth trace chunk is written next to the first one, in
+ * its path suffixed with "-N".
+ *
+ * Only the user space sessions written locally are supported.
+ *
+ * On success, the path of the new trace chunk is copied in "chunk_path".
+ *
+ * Return LTTNG_OK on success or else a LTTNG_ERR code.
+ */
+int cmd_rotate_session(struct ltt_session *session, const char *path,
+		char *chunk_path, size_t chunk_path_len)
+{
+	int ret;
+	struct ltt_ust_session *usess;
+	char new_path[PATH_MAX], new_ust_root[PATH_MAX];
+
+	assert(session);
+	assert(path);
+	assert(chunk_path);
+
+	usess = session->ust_session;
+	if (session->kernel_session || !usess || session->snapshot_mode ||
+			!session->output_traces || !session->consumer ||
+			session->consumer->type != CONSUMER_DST_LOCAL ||
+			usess->consumer->type != CONSUMER_DST_LOCAL) {
+		ret = LTTNG_ERR_ROTATION_UNSUPPORTED;
+		goto end;
+	}
+	if (!session->has_been_started) {
+		ret = LTTNG_ERR_SESSION_NOT_STARTED;
+		goto end;
+	}
+
+	if (path[0] != '\0') {
+		if (path[0] != '/' || lttng_strncpy(new_path, path,
+				sizeof(new_path))) {
+			ret = LTTNG_ERR_INVALID;
+			goto end;
+		}
+	} else {
+		if (!session->rotation_count &&
+				lttng_strncpy(session->rotation_base_path,
+					session->consumer->dst.trace_path,
+					sizeof(session->rotation_base_path))) {
+			ret = LTTNG_ERR_INVALID;
+			goto end;
+		}
+		ret = snprintf(new_path, sizeof(new_path), "%s-%" PRIu64,
+				session->rotation_base_path,
+				session->rotation_count + 1);
+		if (ret < 0 || ret >= sizeof(new_path)) {
+			ret = LTTNG_ERR_INVALID;
+			goto end;
+		}
+	}
+	if (!strcmp(new_path, session->consumer->dst.trace_path)) {
+		ret = LTTNG_ERR_INVALID;
+		goto end;
+	}
+	ret = snprintf(new_ust_root, sizeof(new_ust_root), "%s%s", new_path,
+			DEFAULT_UST_TRACE_DIR);
+	if (ret < 0 || ret >= sizeof(new_ust_root) ||
+			strlen(new_path) >= sizeof(session->consumer->dst.trace_path)) {
+		ret = LTTNG_ERR_INVALID;
+		goto end;
+	}
+
+	ret = run_as_mkdir_recursive(new_ust_root, S_IRWXU | S_IRWXG,
+			session->uid, session->gid);
+	if (ret < 0 && errno != EEXIST) {
+		ERR("Trace chunk directory creation error");
+		ret = LTTNG_ERR_CREATE_DIR_FAIL;
+		goto end;
+	}
+
+	ret = consumer_rotate_session(usess->consumer, usess->id,
+			usess->consumer->dst.trace_path, new_ust_root);
+	if (ret < 0) {
+		ERR("Failed to rotate the session %s", session->name);
+		ret = LTTNG_ERR_UNK;
+		goto end;
+	}
+
+	/* The channels created from now on are written in the new chunk. */
+	strcpy(usess->consumer->dst.trace_path, new_ust_root);
+	strcpy(session->consumer->dst.trace_path, new_path);
+	session->rotation_count++;
+	DBG("Cmd rotate session %s to %s", session->name, new_path);
+
+	if (lttng_strncpy(chunk_path, new_path, chunk_path_len)) {
+		ret = LTTNG_ERR_INVALID;
+		goto end;
+	}
+	ret = LTTNG_OK;
+
+end:
+	return ret;
+}
+
 int cmd_register_trigger(struct command_ctx *cmd_ctx, int sock,
 		struct notification_thread_handle *notification_thread)
 {
@@ -3614,6 +4083,7 @@ int cmd_register_trigger(struct command_ctx *cmd_ctx, int sock,
 		ret = LTTNG_ERR_INVALID_TRIGGER;
 		goto end;
 	}
+	cmd_ctx->payload_left -= trigger_len;
 
 	view = lttng_buffer_view_from_dynamic_buffer(&trigger_buffer, 0, -1);
 	if (lttng_trigger_create_from_buffer(&view, &trigger) !=
@@ -3633,6 +4103,132 @@ end:
 	return ret;
 }
 
+/* Session configuration document loaded on behalf of a client. */
+struct load_definition {
+	/* Client socket, the reply is sent on it once loaded. */
+	int sock;
+	int overwrite;
+	struct lttng_dynamic_buffer buffer;
+};
+
+/*
+ * Load a session configuration document and send the reply of the command to
+ * the client.
+ *
+ * The sessions are created through liblttng-ctl like the sessions loaded at
+ * launch, that is with commands to this session daemon. This thread holds no
+ * client worker so that these commands can run.
+ */
+static void *thread_load_definition(void *data)
+{
+	int ret;
+	struct load_definition *def = data;
+	struct lttcomm_lttng_msg llm;
+
+	DBG("[thread] Load session definition started");
+
+	ret = config_load_session_from_buffer(def->buffer.data,
+			def->buffer.size, def->overwrite);
+
+	memset(&llm, 0, sizeof(llm));
+	llm.cmd_type = LTTNG_LOAD_SESSION_DEFINITION;
+	llm.ret_code = ret ? -ret : LTTNG_OK;
+	ret = lttcomm_send_unix_sock(def->sock, &llm, sizeof(llm));
+	if (ret < 0) {
+		ERR("Failed to send data back to client");
+	}
+
+	ret = close(def->sock);
+	if (ret) {
+		PERROR("close");
+	}
+	lttng_dynamic_buffer_reset(&def->buffer);
+	free(def);
+	return NULL;
+}
+
+/*
+ * Command LTTNG_LOAD_SESSION_DEFINITION processed by the client thread.
+ *
+ * The document is loaded by a dedicated thread which sends the reply: on
+ * success, the reply of the command context is not sent.
+ */
+int cmd_load_session_definition(struct command_ctx *cmd_ctx, int sock)
+{
+	int ret;
+	size_t size;
+	ssize_t sock_recv_len;
+	pthread_t thread;
+	struct load_definition *def = NULL;
+
+	/*
+	 * The sessions are created with the credentials of the session
+	 * daemon.
+	 */
+	if (LTTNG_SOCK_GET_UID_CRED(&cmd_ctx->creds) != geteuid()) {
+		ret = LTTNG_ERR_EPERM;
+		goto error;
+	}
+
+	size = (size_t) cmd_ctx->lsm->u.load_definition.size;
+	if (!size || size > DEFAULT_SESSION_DEFINITION_MAX_SIZE) {
+		ret = LTTNG_ERR_INVALID;
+		goto error;
+	}
+
+	def = zmalloc(sizeof(*def));
+	if (!def) {
+		ret = LTTNG_ERR_NOMEM;
+		goto error;
+	}
+	def->sock = -1;
+	def->overwrite = !!cmd_ctx->lsm->u.load_definition.overwrite;
+	lttng_dynamic_buffer_init(&def->buffer);
+	ret = lttng_dynamic_buffer_set_size(&def->buffer, size);
+	if (ret) {
+		ret = LTTNG_ERR_NOMEM;
+		goto error;
+	}
+
+	sock_recv_len = lttcomm_recv_unix_sock(sock, def->buffer.data, size);
+	if (sock_recv_len < 0 || sock_recv_len != size) {
+		ERR("Failed to receive \"load session definition\" command payload");
+		ret = LTTNG_ERR_INVALID;
+		goto error;
+	}
+	cmd_ctx->payload_left -= size;
+
+	/* The client socket is closed by the caller. */
+	def->sock = dup(sock);
+	if (def->sock < 0) {
+		PERROR("dup client socket");
+		ret = LTTNG_ERR_FATAL;
+		goto error;
+	}
+
+	ret = pthread_create(&thread, default_pthread_attr(),
+			thread_load_definition, def);
+	if (ret) {
+		errno = ret;
+		PERROR("pthread_create load session definition");
+		ret = LTTNG_ERR_FATAL;
+		goto error;
+	}
+	(void) pthread_detach(thread);
+	cmd_ctx->reply_deferred = 1;
+	return LTTNG_OK;
+
+error:
+	if (def) {
+		if (def->sock >= 0 && close(def->sock)) {
+			PERROR("close");
+		}
+		lttng_dynamic_buffer_reset(&def->buffer);
+		free(def);
+	}
+	return ret;
+}
+
 int cmd_unregister_trigger(struct command_ctx *cmd_ctx, int sock,
 		struct notification_thread_handle *notification_thread)
 {
@@ -3659,9 +4255,14 @@ int cmd_unregister_trigger(struct command_ctx *cmd_ctx, int sock,
 		ret = LTTNG_ERR_INVALID_TRIGGER;
 		goto end;
 	}
+	cmd_ctx->payload_left -= trigger_len;
 
+	/*
+	 * The trigger is only used to look up the registered one and is
+	 * destroyed before the buffer, from which it can borrow its strings.
+	 */
 	view = lttng_buffer_view_from_dynamic_buffer(&trigger_buffer, 0, -1);
-	if (lttng_trigger_create_from_buffer(&view, &trigger) !=
+	if (lttng_trigger_create_from_buffer_borrowed(&view, &trigger) !=
 			trigger_len) {
 		ERR("Invalid trigger payload received in \"unregister trigger\" command");
 		ret = LTTNG_ERR_INVALID_TRIGGER;
@@ -3723,101 +4324,160 @@ error:
 }
 
 /*
- * Record a kernel snapshot.
- *
- * Return LTTNG_OK on success or a LTTNG_ERR code.
+ * Snapshot record of the buffers held by one consumer: the kernel consumer
+ * or the UST consumer of a bitness.
  */
-static int record_kernel_snapshot(struct ltt_kernel_session *ksess,
-		struct snapshot_output *output, struct ltt_session *session,
-		int wait, uint64_t nb_packets_per_stream)
-{
+struct snapshot_record_job {
+	/* Exactly one of ksess and usess is set. */
+	struct ltt_kernel_session *ksess;
+	struct ltt_ust_session *usess;
+	uint32_t bits_per_long;
+	struct snapshot_output *output;
+	int wait;
+	uint64_t nb_packets_per_stream;
+	/* Set if the job runs on "thread". */
+	int threaded;
+	pthread_t thread;
+	/* LTTNG_OK or a LTTNG_ERR code. */
 	int ret;
+};
 
-	assert(ksess);
-	assert(output);
-	assert(session);
-
-
-	/*
-	 * Copy kernel session sockets so we can communicate with the right
-	 * consumer for the snapshot record command.
-	 */
-	ret = consumer_copy_sockets(output->consumer, ksess->consumer);
-	if (ret < 0) {
-		ret = LTTNG_ERR_NOMEM;
-		goto error;
-	}
+static void run_snapshot_record_job(struct snapshot_record_job *job)
+{
+	int ret;
 
-	ret = set_relayd_for_snapshot(ksess->consumer, output, session);
-	if (ret != LTTNG_OK) {
-		goto error_snapshot;
+	if (job->ksess) {
+		job->ret = kernel_snapshot_record(job->ksess, job->output,
+				job->wait, job->nb_packets_per_stream);
+		return;
 	}
 
-	ret = kernel_snapshot_record(ksess, output, wait, nb_packets_per_stream);
-	if (ret != LTTNG_OK) {
-		goto error_snapshot;
+	ret = ust_app_snapshot_record(job->usess, job->output, job->wait,
+			job->nb_packets_per_stream, job->bits_per_long);
+	if (ret < 0) {
+		switch (-ret) {
+		case EINVAL:
+			ret = LTTNG_ERR_INVALID;
+			break;
+		default:
+			ret = LTTNG_ERR_SNAPSHOT_FAIL;
+			break;
+		}
+	} else {
+		ret = LTTNG_OK;
 	}
+	job->ret = ret;
+}
 
-	ret = LTTNG_OK;
-	goto end;
-
-error_snapshot:
-	/* Clean up copied sockets so this output can use some other later on. */
-	consumer_destroy_output_sockets(output->consumer);
-error:
-end:
-	return ret;
+static void *thread_snapshot_record(void *data)
+{
+	rcu_register_thread();
+	run_snapshot_record_job(data);
+	rcu_unregister_thread();
+	return NULL;
 }
 
 /*
- * Record a UST snapshot.
+ * Record a snapshot of the kernel and UST sessions of a session to an
+ * output. The buffers of each consumer are recorded concurrently, on their
+ * own thread, which lowers the latency of the snapshot and the skew between
+ * the capture times of the domains.
  *
- * Return 0 on success or a LTTNG_ERR error code.
+ * Return LTTNG_OK on success or a LTTNG_ERR code.
  */
-static int record_ust_snapshot(struct ltt_ust_session *usess,
-		struct snapshot_output *output, struct ltt_session *session,
-		int wait, uint64_t nb_packets_per_stream)
+static int record_snapshot(struct ltt_session *session,
+		struct snapshot_output *output, int wait,
+		uint64_t nb_packets_per_stream)
 {
 	int ret;
-
-	assert(usess);
-	assert(output);
-	assert(session);
+	unsigned int i, nr_jobs = 0;
+	/* The kernel consumer and the 32 and 64-bit UST consumers. */
+	struct snapshot_record_job jobs[3];
+	struct snapshot_record_job job = {
+		.output = output,
+		.wait = wait,
+		.nb_packets_per_stream = nb_packets_per_stream,
+		.ret = LTTNG_OK,
+	};
 
 	/*
-	 * Copy UST session sockets so we can communicate with the right
-	 * consumer for the snapshot record command.
+	 * Copy the session sockets so we can communicate with the right
+	 * consumers for the snapshot record command.
 	 */
-	ret = consumer_copy_sockets(output->consumer, usess->consumer);
-	if (ret < 0) {
-		ret = LTTNG_ERR_NOMEM;
-		goto error;
+	if (session->kernel_session) {
+		ret = consumer_copy_sockets(output->consumer,
+				session->kernel_session->consumer);
+		if (ret < 0) {
+			ret = LTTNG_ERR_NOMEM;
+			goto error_snapshot;
+		}
+		jobs[nr_jobs] = job;
+		jobs[nr_jobs++].ksess = session->kernel_session;
 	}
 
-	ret = set_relayd_for_snapshot(usess->consumer, output, session);
+	if (session->ust_session) {
+		struct ltt_ust_session *usess = session->ust_session;
+
+		ret = consumer_copy_sockets(output->consumer, usess->consumer);
+		if (ret < 0) {
+			ret = LTTNG_ERR_NOMEM;
+			goto error_snapshot;
+		}
+		rcu_read_lock();
+		if (consumer_find_socket_by_bitness(32, usess->consumer)) {
+			jobs[nr_jobs] = job;
+			jobs[nr_jobs].usess = usess;
+			jobs[nr_jobs++].bits_per_long = 32;
+		}
+		if (consumer_find_socket_by_bitness(64, usess->consumer)) {
+			jobs[nr_jobs] = job;
+			jobs[nr_jobs].usess = usess;
+			jobs[nr_jobs++].bits_per_long = 64;
+		}
+		rcu_read_unlock();
+	}
+
+	ret = set_relayd_for_snapshot(output->consumer, output, session);
 	if (ret != LTTNG_OK) {
 		goto error_snapshot;
 	}
 
-	ret = ust_app_snapshot_record(usess, output, wait, nb_packets_per_stream);
-	if (ret < 0) {
-		switch (-ret) {
-		case EINVAL:
-			ret = LTTNG_ERR_INVALID;
-			break;
-		default:
-			ret = LTTNG_ERR_SNAPSHOT_FAIL;
+	for (i = 1; i < nr_jobs; i++) {
+		ret = pthread_create(&jobs[i].thread, NULL,
+				thread_snapshot_record, &jobs[i]);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_create snapshot record");
+			/* Record the remaining consumers on this thread. */
 			break;
 		}
-		goto error_snapshot;
+		jobs[i].threaded = 1;
+	}
+	if (nr_jobs) {
+		run_snapshot_record_job(&jobs[0]);
+	}
+	for (; i < nr_jobs; i++) {
+		run_snapshot_record_job(&jobs[i]);
 	}
 
 	ret = LTTNG_OK;
+	for (i = 0; i < nr_jobs; i++) {
+		if (jobs[i].threaded) {
+			int err = pthread_join(jobs[i].thread, NULL);
+
+			if (err) {
+				errno = err;
+				PERROR("pthread_join snapshot record");
+			}
+		}
+		if (ret == LTTNG_OK) {
+			ret = jobs[i].ret;
+		}
+	}
 
 error_snapshot:
 	/* Clean up copied sockets so this output can use some other later on. */
 	consumer_destroy_output_sockets(output->consumer);
-error:
 	return ret;
 }
 
@@ -3868,7 +4528,9 @@ uint64_t get_session_size_one_more_packet_per_stream(struct ltt_session *session
  * the file.
  *
  * This algorithm is currently bounded by the number of packets per
- * stream.
+ * stream. The consumers then split the resulting budget of each channel
+ * between its streams according to the packets they actually hold, see
+ * consumer_snapshot_plan_streams().
  *
  * Since we call this algorithm before actually grabbing the data, it's
  * an approximation: for instance, applications could appear/disappear
@@ -3911,12 +4573,13 @@ int64_t get_session_nb_packets_per_stream(struct ltt_session *session, uint64_t
  * Command LTTNG_SNAPSHOT_RECORD from lib lttng ctl.
  *
  * The wait parameter is ignored so this call always wait for the snapshot to
- * complete before returning.
+ * complete before returning. An incremental snapshot only writes the packets
+ * produced since the last snapshot to the same output.
  *
  * Return LTTNG_OK on success or else a LTTNG_ERR code.
  */
 int cmd_snapshot_record(struct ltt_session *session,
-		struct lttng_snapshot_output *output, int wait)
+		struct lttng_snapshot_output *output, int wait, int incremental)
 {
 	int ret = LTTNG_OK;
 	unsigned int use_tmp_output = 0;
@@ -3970,6 +4633,7 @@ int cmd_snapshot_record(struct ltt_session *session,
 
 		/* Use the global datetime */
 		memcpy(tmp_output.datetime, datetime, sizeof(datetime));
+		tmp_output.incremental = !!incremental;
 		use_tmp_output = 1;
 	}
 
@@ -3983,22 +4647,10 @@ int cmd_snapshot_record(struct ltt_session *session,
 			goto error;
 		}
 
-		if (session->kernel_session) {
-			ret = record_kernel_snapshot(session->kernel_session,
-					&tmp_output, session,
-					wait, nb_packets_per_stream);
-			if (ret != LTTNG_OK) {
-				goto error;
-			}
-		}
-
-		if (session->ust_session) {
-			ret = record_ust_snapshot(session->ust_session,
-					&tmp_output, session,
-					wait, nb_packets_per_stream);
-			if (ret != LTTNG_OK) {
-				goto error;
-			}
+		ret = record_snapshot(session, &tmp_output, wait,
+				nb_packets_per_stream);
+		if (ret != LTTNG_OK) {
+			goto error;
 		}
 
 		snapshot_success = 1;
@@ -4042,25 +4694,13 @@ int cmd_snapshot_record(struct ltt_session *session,
 
 			tmp_output.nb_snapshot = session->snapshot.nb_snapshot;
 			memcpy(tmp_output.datetime, datetime, sizeof(datetime));
+			tmp_output.incremental = !!incremental;
 
-			if (session->kernel_session) {
-				ret = record_kernel_snapshot(session->kernel_session,
-						&tmp_output, session,
-						wait, nb_packets_per_stream);
-				if (ret != LTTNG_OK) {
-					rcu_read_unlock();
-					goto error;
-				}
-			}
-
-			if (session->ust_session) {
-				ret = record_ust_snapshot(session->ust_session,
-						&tmp_output, session,
-						wait, nb_packets_per_stream);
-				if (ret != LTTNG_OK) {
-					rcu_read_unlock();
-					goto error;
-				}
+			ret = record_snapshot(session, &tmp_output, wait,
+					nb_packets_per_stream);
+			if (ret != LTTNG_OK) {
+				rcu_read_unlock();
+				goto error;
 			}
 			snapshot_success = 1;
 		}
@@ -46,6 +46,12 @@ int cmd_track_pid(struct ltt_session *session, enum lttng_domain_type domain,
 		int pid);
 int cmd_untrack_pid(struct ltt_session *session, enum lttng_domain_type domain,
 		int pid);
+int cmd_track_pid_ranges(struct ltt_session *session,
+		enum lttng_domain_type domain,
+		const struct lttng_pid_range *ranges, unsigned int nb_ranges);
+int cmd_untrack_pid_ranges(struct ltt_session *session,
+		enum lttng_domain_type domain,
+		const struct lttng_pid_range *ranges, unsigned int nb_ranges);
 
 /* Event commands */
 int cmd_disable_event(struct ltt_session *session,
@@ -84,13 +90,20 @@ ssize_t cmd_list_events(enum lttng_domain_type domain,
 		struct lttng_event **events, size_t *total_size);
 ssize_t cmd_list_channels(enum lttng_domain_type domain,
 		struct ltt_session *session, struct lttng_channel **channels);
+ssize_t cmd_list_stream_stats(enum lttng_domain_type domain,
+		struct ltt_session *session, const char *channel_name,
+		struct lttng_stream_stats **stats);
+ssize_t cmd_list_memory_usage(enum lttng_domain_type domain,
+		struct ltt_session *session, struct lttng_memory_usage **usage);
 ssize_t cmd_list_domains(struct ltt_session *session,
 		struct lttng_domain **domains);
-void cmd_list_lttng_sessions(struct lttng_session *sessions, uid_t uid,
-		gid_t gid);
+unsigned int cmd_list_lttng_sessions(struct lttng_session *sessions,
+		unsigned int nr_sessions, uid_t uid, gid_t gid);
 ssize_t cmd_list_tracepoint_fields(enum lttng_domain_type domain,
+		pid_t pid_cursor, unsigned int page_len,
 		struct lttng_event_field **fields);
 ssize_t cmd_list_tracepoints(enum lttng_domain_type domain,
+		pid_t pid_cursor, unsigned int page_len,
 		struct lttng_event **events);
 ssize_t cmd_snapshot_list_outputs(struct ltt_session *session,
 		struct lttng_snapshot_output **outputs);
@@ -106,16 +119,19 @@ int cmd_snapshot_add_output(struct ltt_session *session,
 int cmd_snapshot_del_output(struct ltt_session *session,
 		struct lttng_snapshot_output *output);
 int cmd_snapshot_record(struct ltt_session *session,
-		struct lttng_snapshot_output *output, int wait);
+		struct lttng_snapshot_output *output, int wait, int incremental);
 
 int cmd_set_session_shm_path(struct ltt_session *session,
 		const char *shm_path);
 int cmd_regenerate_metadata(struct ltt_session *session);
 int cmd_regenerate_statedump(struct ltt_session *session);
+int cmd_rotate_session(struct ltt_session *session, const char *path,
+		char *chunk_path, size_t chunk_path_len);
 
 int cmd_register_trigger(struct command_ctx *cmd_ctx, int sock,
 		struct notification_thread_handle *notification_thread_handle);
 int cmd_unregister_trigger(struct command_ctx *cmd_ctx, int sock,
 		struct notification_thread_handle *notification_thread_handle);
+int cmd_load_session_definition(struct command_ctx *cmd_ctx, int sock);
 
 #endif /* CMD_H */
@@ -823,6 +823,8 @@ void consumer_init_ask_channel_comm_msg(struct lttcomm_consumer_msg *msg,
 		unsigned int monitor,
 		uint32_t ust_app_uid,
 		int64_t blocking_timeout,
+		enum lttng_channel_compression compression,
+		int huge_pages,
 		const char *root_shm_path,
 		const char *shm_path)
 {
@@ -853,6 +855,8 @@ void consumer_init_ask_channel_comm_msg(struct lttcomm_consumer_msg *msg,
 	msg->u.ask_channel.monitor = monitor;
 	msg->u.ask_channel.ust_app_uid = ust_app_uid;
 	msg->u.ask_channel.blocking_timeout = blocking_timeout;
+	msg->u.ask_channel.compression = compression;
+	msg->u.ask_channel.huge_pages = !!huge_pages;
 
 	memcpy(msg->u.ask_channel.uuid, uuid, sizeof(msg->u.ask_channel.uuid));
 
@@ -896,7 +900,8 @@ void consumer_init_channel_comm_msg(struct lttcomm_consumer_msg *msg,
 		uint64_t tracefile_count,
 		unsigned int monitor,
 		unsigned int live_timer_interval,
-		unsigned int monitor_timer_interval)
+		unsigned int monitor_timer_interval,
+		enum lttng_channel_compression compression)
 {
 	assert(msg);
 
@@ -918,6 +923,7 @@ void consumer_init_channel_comm_msg(struct lttcomm_consumer_msg *msg,
 	msg->u.channel.monitor = monitor;
 	msg->u.channel.live_timer_interval = live_timer_interval;
 	msg->u.channel.monitor_timer_interval = monitor_timer_interval;
+	msg->u.channel.compression = compression;
 
 	strncpy(msg->u.channel.pathname, pathname,
 			sizeof(msg->u.channel.pathname));
@@ -987,6 +993,52 @@ error:
 	return ret;
 }
 
+/*
+ * Send all the streams of a kernel channel to the consumer at once with
+ * LTTNG_CONSUMER_ADD_STREAMS: the message, the CPU of each stream and then
+ * their fds, in as few messages as possible.
+ */
+int consumer_send_streams(struct consumer_socket *sock,
+		uint64_t channel_key, int32_t *cpus, int *fds, size_t nb_streams)
+{
+	int ret;
+	ssize_t size;
+	struct lttcomm_consumer_msg msg;
+
+	assert(sock);
+	assert(cpus);
+	assert(fds);
+	assert(nb_streams > 0);
+
+	memset(&msg, 0, sizeof(msg));
+	msg.cmd_type = LTTNG_CONSUMER_ADD_STREAMS;
+	msg.u.streams.channel_key = channel_key;
+	msg.u.streams.nb_streams = nb_streams;
+
+	ret = consumer_send_msg(sock, &msg);
+	if (ret < 0) {
+		goto error;
+	}
+
+	ret = consumer_socket_send(sock, cpus, nb_streams * sizeof(*cpus));
+	if (ret < 0) {
+		goto error;
+	}
+
+	size = lttcomm_send_fds_batch_unix_sock(*sock->fd_ptr, fds, nb_streams);
+	if (size < 0) {
+		/* The above call will print a PERROR on error. */
+		DBG("Error when sending consumer stream fds on sock %d",
+				*sock->fd_ptr);
+		ret = size;
+		goto error;
+	}
+
+	ret = consumer_recv_status_reply(sock);
+error:
+	return ret;
+}
+
 /*
  * Send relayd socket to consumer associated with a session name.
  *
@@ -1225,6 +1277,56 @@ end:
 	return ret;
 }
 
+/*
+ * Ask every consumer of the output to switch the local streams of the session
+ * to a new trace chunk, from under "old_root" to under "new_root". The
+ * consumers reply once the streams are flagged, each stream then switches on
+ * its next packet.
+ *
+ * Return 0 on success else a negative value.
+ */
+int consumer_rotate_session(struct consumer_output *consumer,
+		uint64_t session_id, const char *old_root, const char *new_root)
+{
+	int ret = 0;
+	struct consumer_socket *socket;
+	struct lttng_ht_iter iter;
+	struct lttcomm_consumer_msg msg;
+
+	assert(consumer);
+	assert(old_root);
+	assert(new_root);
+
+	DBG2("Consumer rotate session %" PRIu64 " to %s", session_id, new_root);
+
+	memset(&msg, 0, sizeof(msg));
+	msg.cmd_type = LTTNG_CONSUMER_ROTATE_SESSION;
+	msg.u.rotate_session.session_id = session_id;
+	if (lttng_strncpy(msg.u.rotate_session.old_root, old_root,
+			sizeof(msg.u.rotate_session.old_root)) ||
+			lttng_strncpy(msg.u.rotate_session.new_root, new_root,
+			sizeof(msg.u.rotate_session.new_root))) {
+		ret = -1;
+		goto end;
+	}
+
+	rcu_read_lock();
+	cds_lfht_for_each_entry(consumer->socks->ht, &iter.iter, socket,
+			node.node) {
+		pthread_mutex_lock(socket->lock);
+		health_code_update();
+		ret = consumer_send_msg(socket, &msg);
+		health_code_update();
+		pthread_mutex_unlock(socket->lock);
+		if (ret < 0) {
+			break;
+		}
+	}
+	rcu_read_unlock();
+end:
+	return ret;
+}
+
 /*
  * Send a clear quiescent command to consumer using the given channel key.
  *
@@ -1257,6 +1359,96 @@ end:
 	return ret;
 }
 
+/*
+ * Send the usage thresholds filtering the monitoring samples of a channel to
+ * the consumer daemon of "data". The consumer not running or not knowing the
+ * channel, which belongs to another consumer, is not an error.
+ *
+ * Return 0 on success else a negative value.
+ */
+int consumer_send_channel_monitor_filter(struct consumer_data *data,
+		uint64_t key, bool forward_all, const uint64_t *thresholds,
+		uint32_t nr_thresholds)
+{
+	int ret = 0;
+	struct lttcomm_consumer_msg msg;
+	struct consumer_socket socket;
+
+	assert(data);
+	assert(nr_thresholds <= LTTCOMM_CONSUMER_MONITOR_THRESHOLDS_MAX);
+
+	DBG2("Consumer channel monitor filter key %" PRIu64 ", %" PRIu32 " thresholds%s",
+			key, nr_thresholds, forward_all ? ", forward all" : "");
+
+	memset(&msg, 0, sizeof(msg));
+	msg.cmd_type = LTTNG_CONSUMER_SET_CHANNEL_MONITOR_FILTER;
+	msg.u.channel_monitor_filter.key = key;
+	msg.u.channel_monitor_filter.forward_all = forward_all;
+	msg.u.channel_monitor_filter.nr_thresholds = nr_thresholds;
+	memcpy(msg.u.channel_monitor_filter.thresholds, thresholds,
+			nr_thresholds * sizeof(*thresholds));
+
+	/* The command socket of the consumer, without a consumer output. */
+	memset(&socket, 0, sizeof(socket));
+	socket.fd_ptr = &data->cmd_sock;
+	socket.lock = &data->lock;
+
+	pthread_mutex_lock(socket.lock);
+	if (data->cmd_sock < 0) {
+		goto end;
+	}
+	health_code_update();
+
+	ret = consumer_send_msg(&socket, &msg);
+	if (ret == -LTTCOMM_CONSUMERD_CHAN_NOT_FOUND) {
+		ret = 0;
+	}
+
+	health_code_update();
+end:
+	pthread_mutex_unlock(socket.lock);
+	return ret;
+}
+
+/*
+ * Ask the consumer daemon of "data" to stop or resume the consumption of its
+ * channels of priority 0. The consumer not running is not an error.
+ *
+ * Return 0 on success else a negative value.
+ */
+int consumer_send_overload_shedding(struct consumer_data *data, bool enable)
+{
+	int ret = 0;
+	struct lttcomm_consumer_msg msg;
+	struct consumer_socket socket;
+
+	assert(data);
+
+	DBG2("Consumer overload shedding %s", enable ? "enabled" : "disabled");
+
+	memset(&msg, 0, sizeof(msg));
+	msg.cmd_type = LTTNG_CONSUMER_SET_OVERLOAD_SHEDDING;
+	msg.u.overload_shedding.enable = enable;
+
+	/* The command socket of the consumer, without a consumer output. */
+	memset(&socket, 0, sizeof(socket));
+	socket.fd_ptr = &data->cmd_sock;
+	socket.lock = &data->lock;
+
+	pthread_mutex_lock(socket.lock);
+	if (data->cmd_sock < 0) {
+		goto end;
+	}
+	health_code_update();
+
+	ret = consumer_send_msg(&socket, &msg);
+
+	health_code_update();
+end:
+	pthread_mutex_unlock(socket.lock);
+	return ret;
+}
+
 /*
  * Send a close metadata command to consumer using the given channel key.
  * Called with registry lock held.
@@ -1399,6 +1591,8 @@ int consumer_snapshot_channel(struct consumer_socket *socket, uint64_t key,
 	msg.u.snapshot_channel.key = key;
 	msg.u.snapshot_channel.nb_packets_per_stream = nb_packets_per_stream;
 	msg.u.snapshot_channel.metadata = metadata;
+	msg.u.snapshot_channel.incremental = output->incremental;
+	msg.u.snapshot_channel.output_id = output->id;
 
 	if (output->consumer->type == CONSUMER_DST_NET) {
 		msg.u.snapshot_channel.relayd_id = output->consumer->net_seq_index;
@@ -1559,3 +1753,243 @@ end:
 	rcu_read_unlock();
 	return ret;
 }
+
+/*
+ * Receive "nr_recv" stream statistics from a consumer socket and append them
+ * to the "stats" array of "*nr_stats" entries.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static int recv_stream_stats(struct consumer_socket *socket,
+		uint64_t nr_recv, struct lttng_stream_stats **stats,
+		size_t *nr_stats)
+{
+	int ret;
+	uint64_t i;
+	struct lttng_stream_stats *new_stats;
+	struct lttcomm_consumer_stream_stats *recv_stats = NULL;
+
+	if (!nr_recv) {
+		ret = 0;
+		goto end;
+	}
+
+	recv_stats = zmalloc(nr_recv * sizeof(*recv_stats));
+	new_stats = realloc(*stats, (*nr_stats + nr_recv) * sizeof(**stats));
+	if (!recv_stats || !new_stats) {
+		PERROR("zmalloc stream stats");
+		if (new_stats) {
+			*stats = new_stats;
+		}
+		ret = -ENOMEM;
+		goto end;
+	}
+	*stats = new_stats;
+
+	ret = consumer_socket_recv(socket, recv_stats,
+			nr_recv * sizeof(*recv_stats));
+	if (ret < 0) {
+		goto end;
+	}
+
+	for (i = 0; i < nr_recv; i++) {
+		unsigned int j;
+		struct lttng_stream_stats *s = &(*stats)[*nr_stats + i];
+
+		memset(s, 0, sizeof(*s));
+		s->cpu = recv_stats[i].cpu;
+		s->bytes_consumed = recv_stats[i].bytes_consumed;
+		s->subbufs_consumed = recv_stats[i].subbufs_consumed;
+		for (j = 0; j < LTTNG_STREAM_STATS_LATENCY_BUCKETS; j++) {
+			s->write_latency_hist[j] =
+					recv_stats[i].write_latency_hist[j];
+		}
+		s->wakeup_delay_total = recv_stats[i].wakeup_delay_total;
+		s->wakeup_delay_max = recv_stats[i].wakeup_delay_max;
+		s->lag_bytes = recv_stats[i].lag_bytes;
+	}
+	*nr_stats += nr_recv;
+	ret = 0;
+
+end:
+	free(recv_stats);
+	return ret;
+}
+
+/*
+ * Ask the consumer the consumption statistics of the streams of a channel and
+ * append them to the "stats" array of "*nr_stats" entries, which the caller
+ * must free.
+ */
+int consumer_get_stream_stats(uint64_t channel_key,
+		struct consumer_output *consumer, struct lttng_stream_stats **stats,
+		size_t *nr_stats)
+{
+	int ret = 0;
+	struct consumer_socket *socket;
+	struct lttng_ht_iter iter;
+	struct lttcomm_consumer_msg msg;
+
+	assert(consumer);
+	assert(stats);
+	assert(nr_stats);
+
+	DBG3("Consumer stream stats of channel key %" PRIu64, channel_key);
+
+	memset(&msg, 0, sizeof(msg));
+	msg.cmd_type = LTTNG_CONSUMER_STREAM_STATS;
+	msg.u.stream_stats.channel_key = channel_key;
+
+	/* Send command for each consumer */
+	rcu_read_lock();
+	cds_lfht_for_each_entry(consumer->socks->ht, &iter.iter, socket,
+			node.node) {
+		uint64_t nr_recv = 0;
+
+		pthread_mutex_lock(socket->lock);
+		ret = consumer_socket_send(socket, &msg, sizeof(msg));
+		if (ret < 0) {
+			pthread_mutex_unlock(socket->lock);
+			goto end;
+		}
+
+		/*
+		 * No need for a recv reply status because the answer to the
+		 * command is the reply status message.
+		 */
+		ret = consumer_socket_recv(socket, &nr_recv, sizeof(nr_recv));
+		if (ret < 0) {
+			ERR("get stream stats");
+			pthread_mutex_unlock(socket->lock);
+			goto end;
+		}
+		ret = recv_stream_stats(socket, nr_recv, stats, nr_stats);
+		pthread_mutex_unlock(socket->lock);
+		if (ret < 0) {
+			ERR("get stream stats");
+			goto end;
+		}
+	}
+	ret = 0;
+
+end:
+	rcu_read_unlock();
+	return ret;
+}
+
+static int channel_stats_cmp(const void *a, const void *b)
+{
+	const struct lttcomm_consumer_channel_stats *sa = a, *sb = b;
+
+	return (sa->key > sb->key) - (sa->key < sb->key);
+}
+
+/*
+ * Ask the consumers the runtime statistics of all the data channels of a
+ * session in one round trip per consumer socket. On success, "*stats" is set
+ * to an array of "*nr_stats" entries sorted by channel key, which the caller
+ * must free, for consumer_find_channel_stats().
+ */
+int consumer_get_channel_stats(uint64_t session_id,
+		struct consumer_output *consumer,
+		struct lttcomm_consumer_channel_stats **stats, size_t *nr_stats)
+{
+	int ret = 0;
+	struct consumer_socket *socket;
+	struct lttng_ht_iter iter;
+	struct lttcomm_consumer_msg msg;
+
+	assert(consumer);
+	assert(stats);
+	assert(nr_stats);
+
+	DBG3("Consumer channel stats of session id %" PRIu64, session_id);
+
+	*stats = NULL;
+	*nr_stats = 0;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.cmd_type = LTTNG_CONSUMER_CHANNEL_STATS;
+	msg.u.channel_stats.session_id = session_id;
+
+	/* Send command for each consumer */
+	rcu_read_lock();
+	cds_lfht_for_each_entry(consumer->socks->ht, &iter.iter, socket,
+			node.node) {
+		uint64_t nr_recv = 0;
+		struct lttcomm_consumer_channel_stats *new_stats;
+
+		pthread_mutex_lock(socket->lock);
+		ret = consumer_socket_send(socket, &msg, sizeof(msg));
+		if (ret < 0) {
+			pthread_mutex_unlock(socket->lock);
+			goto end;
+		}
+
+		/*
+		 * No need for a recv reply status because the answer to the
+		 * command is the reply status message.
+		 */
+		ret = consumer_socket_recv(socket, &nr_recv, sizeof(nr_recv));
+		if (ret < 0 || !nr_recv) {
+			pthread_mutex_unlock(socket->lock);
+			if (ret < 0) {
+				ERR("get channel stats");
+				goto end;
+			}
+			continue;
+		}
+
+		new_stats = realloc(*stats,
+				(*nr_stats + nr_recv) * sizeof(**stats));
+		if (!new_stats) {
+			PERROR("realloc channel stats");
+			pthread_mutex_unlock(socket->lock);
+			ret = -ENOMEM;
+			goto end;
+		}
+		*stats = new_stats;
+
+		ret = consumer_socket_recv(socket, *stats + *nr_stats,
+				nr_recv * sizeof(**stats));
+		pthread_mutex_unlock(socket->lock);
+		if (ret < 0) {
+			ERR("get channel stats");
+			goto end;
+		}
+		*nr_stats += nr_recv;
+	}
+	ret = 0;
+
+	if (*nr_stats) {
+		qsort(*stats, *nr_stats, sizeof(**stats), channel_stats_cmp);
+	}
+
+end:
+	rcu_read_unlock();
+	if (ret < 0) {
+		free(*stats);
+		*stats = NULL;
+		*nr_stats = 0;
+	}
+	return ret;
+}
+
+/*
+ * Find the statistics of a channel key in an array returned by
+ * consumer_get_channel_stats().
+ *
+ * Return the statistics, or NULL if the consumers do not know the channel.
+ */
+const struct lttcomm_consumer_channel_stats *consumer_find_channel_stats(
+		const struct lttcomm_consumer_channel_stats *stats,
+		size_t nr_stats, uint64_t key)
+{
+	struct lttcomm_consumer_channel_stats needle = { .key = key };
+
+	if (!nr_stats) {
+		return NULL;
+	}
+	return bsearch(&needle, stats, nr_stats, sizeof(*stats),
+			channel_stats_cmp);
+}
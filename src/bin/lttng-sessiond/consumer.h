@@ -213,6 +213,8 @@ int consumer_send_msg(struct consumer_socket *sock,
 int consumer_send_stream(struct consumer_socket *sock,
 		struct consumer_output *dst, struct lttcomm_consumer_msg *msg,
 		int *fds, size_t nb_fd);
+int consumer_send_streams(struct consumer_socket *sock,
+		uint64_t channel_key, int32_t *cpus, int *fds, size_t nb_streams);
 int consumer_send_channel(struct consumer_socket *sock,
 		struct lttcomm_consumer_msg *msg);
 int consumer_send_relayd_socket(struct consumer_socket *consumer_sock,
@@ -257,6 +259,8 @@ void consumer_init_ask_channel_comm_msg(struct lttcomm_consumer_msg *msg,
 		unsigned int monitor,
 		uint32_t ust_app_uid,
 		int64_t blocking_timeout,
+		enum lttng_channel_compression compression,
+		int huge_pages,
 		const char *root_shm_path,
 		const char *shm_path);
 void consumer_init_stream_comm_msg(struct lttcomm_consumer_msg *msg,
@@ -283,7 +287,8 @@ void consumer_init_channel_comm_msg(struct lttcomm_consumer_msg *msg,
 		uint64_t tracefile_count,
 		unsigned int monitor,
 		unsigned int live_timer_interval,
-		unsigned int monitor_timer_interval);
+		unsigned int monitor_timer_interval,
+		enum lttng_channel_compression compression);
 int consumer_is_data_pending(uint64_t session_id,
 		struct consumer_output *consumer);
 int consumer_close_metadata(struct consumer_socket *socket,
@@ -295,10 +300,25 @@ int consumer_push_metadata(struct consumer_socket *socket,
 		size_t target_offset, uint64_t version);
 int consumer_flush_channel(struct consumer_socket *socket, uint64_t key);
 int consumer_clear_quiescent_channel(struct consumer_socket *socket, uint64_t key);
+int consumer_send_channel_monitor_filter(struct consumer_data *data,
+		uint64_t key, bool forward_all, const uint64_t *thresholds,
+		uint32_t nr_thresholds);
+int consumer_send_overload_shedding(struct consumer_data *data, bool enable);
+int consumer_rotate_session(struct consumer_output *consumer,
+		uint64_t session_id, const char *old_root, const char *new_root);
 int consumer_get_discarded_events(uint64_t session_id, uint64_t channel_key,
 		struct consumer_output *consumer, uint64_t *discarded);
 int consumer_get_lost_packets(uint64_t session_id, uint64_t channel_key,
 		struct consumer_output *consumer, uint64_t *lost);
+int consumer_get_stream_stats(uint64_t channel_key,
+		struct consumer_output *consumer, struct lttng_stream_stats **stats,
+		size_t *nr_stats);
+int consumer_get_channel_stats(uint64_t session_id,
+		struct consumer_output *consumer,
+		struct lttcomm_consumer_channel_stats **stats, size_t *nr_stats);
+const struct lttcomm_consumer_channel_stats *consumer_find_channel_stats(
+		const struct lttcomm_consumer_channel_stats *stats,
+		size_t nr_stats, uint64_t key);
 
 /* Snapshot command. */
 int consumer_snapshot_channel(struct consumer_socket *socket, uint64_t key,
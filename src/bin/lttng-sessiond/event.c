@@ -62,6 +62,20 @@ static void add_unique_ust_event(struct lttng_ht *ht,
 	assert(node_ptr == &event->node.node);
 }
 
+/*
+ * Enable a disabled kernel event, through the syscall mask of its channel if
+ * it traces a system call of the mask.
+ */
+static int enable_kernel_event(struct ltt_kernel_channel *kchan,
+		struct ltt_kernel_event *kevent)
+{
+	if (kevent->in_syscall_mask) {
+		kevent->enabled = 1;
+		return kernel_syscall_mask_changed(kchan);
+	}
+	return kernel_enable_event(kevent);
+}
+
 /*
  * Disable kernel tracepoint events for a channel from the kernel session of
  * a specified event_name and event type.
@@ -72,6 +86,7 @@ int event_kernel_disable_event(struct ltt_kernel_channel *kchan,
 		char *event_name, enum lttng_event_type type)
 {
 	int ret, error = 0, found = 0;
+	bool mask_changed = false;
 	struct ltt_kernel_event *kevent;
 
 	assert(kchan);
@@ -84,12 +99,21 @@ int event_kernel_disable_event(struct ltt_kernel_channel *kchan,
 			continue;
 		}
 		found++;
+		if (kevent->in_syscall_mask) {
+			/* Applied once for all the system calls of the mask. */
+			kevent->enabled = 0;
+			mask_changed = true;
+			continue;
+		}
 		ret = kernel_disable_event(kevent);
 		if (ret < 0) {
 			error = 1;
 			continue;
 		}
 	}
+	if (mask_changed && kernel_syscall_mask_changed(kchan) < 0) {
+		error = 1;
+	}
 	DBG("Disable kernel event: found %d events with name: %s and type: %d",
 			found, event_name ? event_name : "NULL", type);
 
@@ -119,8 +143,13 @@ int event_kernel_enable_event(struct ltt_kernel_channel *kchan,
 	kevent = trace_kernel_find_event(event->name, kchan,
 			event->type, filter);
 	if (kevent == NULL) {
-		ret = kernel_create_event(event, kchan,
-			filter_expression, filter);
+		if (!filter_expression && !filter &&
+				kernel_syscall_mask_eligible(event)) {
+			ret = kernel_create_mask_syscall(event, kchan);
+		} else {
+			ret = kernel_create_event(event, kchan,
+				filter_expression, filter);
+		}
 		/* We have passed ownership */
 		filter_expression = NULL;
 		filter = NULL;
@@ -139,7 +168,7 @@ int event_kernel_enable_event(struct ltt_kernel_channel *kchan,
 			goto end;
 		}
 	} else if (kevent->enabled == 0) {
-		ret = kernel_enable_event(kevent);
+		ret = enable_kernel_event(kchan, kevent);
 		if (ret < 0) {
 			ret = LTTNG_ERR_KERN_ENABLE_FAIL;
 			goto end;
@@ -157,6 +186,88 @@ end:
 	return ret;
 }
 
+/*
+ * Enable a batch of kernel events without filter for a channel from the
+ * kernel session. The events which don't exist yet are created in a single
+ * batch.
+ *
+ * Every event is attempted. Return LTTNG_OK on success or else the error
+ * code of the first failure.
+ */
+int event_kernel_enable_events(struct ltt_kernel_channel *kchan,
+		struct lttng_event **events, unsigned int nr_events)
+{
+	int ret = LTTNG_OK, err;
+	unsigned int i, nr_create = 0;
+	struct lttng_event **create;
+	struct ltt_kernel_event *kevent;
+
+	assert(kchan);
+	assert(events);
+
+	create = zmalloc(nr_events * sizeof(*create));
+	if (!create) {
+		PERROR("zmalloc kernel events to create");
+		ret = LTTNG_ERR_FATAL;
+		goto end;
+	}
+
+	for (i = 0; i < nr_events; i++) {
+		kevent = trace_kernel_find_event(events[i]->name, kchan,
+				events[i]->type, NULL);
+		if (kevent == NULL) {
+			if (!kernel_syscall_mask_eligible(events[i])) {
+				create[nr_create++] = events[i];
+				continue;
+			}
+			err = kernel_create_mask_syscall(events[i], kchan);
+			if (err < 0) {
+				err = LTTNG_ERR_KERN_ENABLE_FAIL;
+			} else {
+				err = LTTNG_OK;
+			}
+		} else if (kevent->enabled == 0) {
+			err = enable_kernel_event(kchan, kevent);
+			if (err < 0) {
+				err = LTTNG_ERR_KERN_ENABLE_FAIL;
+			} else {
+				err = LTTNG_OK;
+			}
+		} else {
+			/* At this point, the event is considered enabled */
+			err = LTTNG_ERR_KERN_EVENT_EXIST;
+		}
+		if (ret == LTTNG_OK) {
+			ret = err;
+		}
+	}
+
+	if (!nr_create) {
+		goto end;
+	}
+
+	err = kernel_create_events(create, nr_create, kchan);
+	if (err < 0) {
+		switch (-err) {
+		case EEXIST:
+			err = LTTNG_ERR_KERN_EVENT_EXIST;
+			break;
+		case ENOSYS:
+			err = LTTNG_ERR_KERN_EVENT_ENOSYS;
+			break;
+		default:
+			err = LTTNG_ERR_KERN_ENABLE_FAIL;
+			break;
+		}
+		if (ret == LTTNG_OK) {
+			ret = err;
+		}
+	}
+end:
+	free(create);
+	return ret;
+}
+
 /*
  * ============================
  * UST : The Ultimate Frontier!
@@ -359,7 +470,7 @@ int event_ust_disable_all_tracepoints(struct ltt_ust_session *usess,
 	}
 
 	/* Get all UST available events */
-	size = ust_app_list_events(&events);
+	size = ust_app_list_events(&events, 0, 0);
 	if (size < 0) {
 		ret = LTTNG_ERR_UST_LIST_FAIL;
 		goto error;
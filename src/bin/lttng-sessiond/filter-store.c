@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include <assert.h>
+#include <pthread.h>
+#include <string.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include <common/common.h>
+#include <common/hashtable/hashtable.h>
+#include <common/hashtable/utils.h>
+
+#include "filter-store.h"
+#include "utils.h"
+
+struct filter_store_entry {
+	/* Number of users of the bytecode. Protected by the store lock. */
+	unsigned long refcount;
+	unsigned long hash;
+	struct cds_lfht_node node;
+	/* For delayed reclaim. */
+	struct rcu_head rcu_head;
+	/* Followed by the bytecode data. MUST be last. */
+	struct lttng_filter_bytecode bytecode;
+};
+
+/*
+ * The table is allocated with its first bytecode and freed with its last
+ * one. Protected by store_lock.
+ */
+static struct lttng_ht *store_ht;
+static pthread_mutex_t store_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static size_t bytecode_size(const struct lttng_filter_bytecode *bytecode)
+{
+	return sizeof(*bytecode) + bytecode->len;
+}
+
+static int ht_match_bytecode(struct cds_lfht_node *node, const void *key)
+{
+	const struct lttng_filter_bytecode *bytecode = key;
+	struct filter_store_entry *entry;
+
+	entry = caa_container_of(node, struct filter_store_entry, node);
+	return entry->bytecode.len == bytecode->len &&
+			!memcmp(&entry->bytecode, bytecode,
+				bytecode_size(bytecode));
+}
+
+struct lttng_filter_bytecode *filter_store_add(
+		struct lttng_filter_bytecode *bytecode)
+{
+	unsigned long hash;
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+	struct filter_store_entry *entry = NULL;
+
+	if (!bytecode) {
+		goto end;
+	}
+	hash = hash_key_buf(bytecode, bytecode_size(bytecode), lttng_ht_seed);
+
+	pthread_mutex_lock(&store_lock);
+	if (!store_ht) {
+		store_ht = lttng_ht_new(0, LTTNG_HT_TYPE_STRING);
+		if (!store_ht) {
+			goto end_unlock;
+		}
+	}
+
+	rcu_read_lock();
+	cds_lfht_lookup(store_ht->ht, hash, ht_match_bytecode, bytecode, &iter);
+	node = cds_lfht_iter_get_node(&iter);
+	if (node) {
+		entry = caa_container_of(node, struct filter_store_entry, node);
+		entry->refcount++;
+		goto end_rcu_unlock;
+	}
+
+	entry = zmalloc(sizeof(*entry) + bytecode->len);
+	if (!entry) {
+		PERROR("zmalloc filter store entry");
+		goto end_rcu_unlock;
+	}
+	memcpy(&entry->bytecode, bytecode, bytecode_size(bytecode));
+	entry->refcount = 1;
+	entry->hash = hash;
+	cds_lfht_node_init(&entry->node);
+	cds_lfht_add(store_ht->ht, hash, &entry->node);
+	DBG3("Filter bytecode of %u bytes stored", bytecode->len);
+end_rcu_unlock:
+	rcu_read_unlock();
+end_unlock:
+	pthread_mutex_unlock(&store_lock);
+	free(bytecode);
+end:
+	return entry ? &entry->bytecode : NULL;
+}
+
+struct lttng_filter_bytecode *filter_store_get(
+		struct lttng_filter_bytecode *bytecode)
+{
+	struct filter_store_entry *entry;
+
+	if (!bytecode) {
+		return NULL;
+	}
+
+	entry = caa_container_of(bytecode, struct filter_store_entry, bytecode);
+	pthread_mutex_lock(&store_lock);
+	assert(entry->refcount);
+	entry->refcount++;
+	pthread_mutex_unlock(&store_lock);
+	return bytecode;
+}
+
+static void destroy_entry_rcu(struct rcu_head *head)
+{
+	struct filter_store_entry *entry =
+		caa_container_of(head, struct filter_store_entry, rcu_head);
+
+	free(entry);
+}
+
+void filter_store_put(struct lttng_filter_bytecode *bytecode)
+{
+	int ret;
+	struct lttng_ht_iter iter;
+	struct filter_store_entry *entry;
+
+	if (!bytecode) {
+		return;
+	}
+
+	entry = caa_container_of(bytecode, struct filter_store_entry, bytecode);
+	pthread_mutex_lock(&store_lock);
+	if (--entry->refcount) {
+		goto end;
+	}
+
+	rcu_read_lock();
+	iter.iter.node = &entry->node;
+	ret = lttng_ht_del(store_ht, &iter);
+	assert(!ret);
+	call_rcu(&entry->rcu_head, destroy_entry_rcu);
+	if (!lttng_ht_get_count(store_ht)) {
+		ht_cleanup_push(store_ht);
+		store_ht = NULL;
+	}
+	rcu_read_unlock();
+end:
+	pthread_mutex_unlock(&store_lock);
+}
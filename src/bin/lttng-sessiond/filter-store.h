@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef LTTNG_SESSIOND_FILTER_STORE_H
+#define LTTNG_SESSIOND_FILTER_STORE_H
+
+#include <common/sessiond-comm/sessiond-comm.h>
+
+/*
+ * Content-addressed store of the filter bytecodes. The events with the same
+ * filter, and their per application copies, share a single reference counted
+ * bytecode, which MUST NOT be modified.
+ */
+
+/*
+ * Get a reference on the stored bytecode equal to "bytecode", storing it if
+ * it is not already. The ownership of "bytecode" is taken, even on error.
+ *
+ * Return the stored bytecode or NULL on error.
+ */
+struct lttng_filter_bytecode *filter_store_add(
+		struct lttng_filter_bytecode *bytecode);
+
+/*
+ * Get another reference on a stored bytecode. It's safe to pass NULL.
+ */
+struct lttng_filter_bytecode *filter_store_get(
+		struct lttng_filter_bytecode *bytecode);
+
+/*
+ * Release a reference on a stored bytecode. It's safe to pass NULL.
+ */
+void filter_store_put(struct lttng_filter_bytecode *bytecode);
+
+#endif /* LTTNG_SESSIOND_FILTER_STORE_H */
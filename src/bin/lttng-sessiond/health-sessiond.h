@@ -30,6 +30,9 @@ enum health_type_sessiond {
 	HEALTH_SESSIOND_TYPE_APP_MANAGE_NOTIFY	= 6,
 	HEALTH_SESSIOND_TYPE_APP_REG_DISPATCH	= 7,
 	HEALTH_SESSIOND_TYPE_NOTIFICATION	= 8,
+	HEALTH_SESSIOND_TYPE_APP_UPDATE		= 9,
+	HEALTH_SESSIOND_TYPE_CMD_WORKER		= 10,
+	HEALTH_SESSIOND_TYPE_NOTIFICATION_EVALUATOR	= 11,
 
 	NR_HEALTH_SESSIOND_TYPES,
 };
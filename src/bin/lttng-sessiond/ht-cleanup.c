@@ -91,10 +91,39 @@ error:
 	return ret;
 }
 
+/*
+ * Read up to "max" hash tables from the cleanup pipe, which is readable.
+ *
+ * Return the number of hash tables read or a negative value on error.
+ */
+static ssize_t read_hts(struct lttng_ht **hts, size_t max)
+{
+	ssize_t size_ret, rem_ret;
+	size_t rem;
+
+	do {
+		size_ret = read(ht_cleanup_pipe[0], hts, max * sizeof(*hts));
+	} while (size_ret < 0 && errno == EINTR);
+	if (size_ret <= 0) {
+		return -1;
+	}
+
+	/* The pushes are atomic, but complete a partial read anyway. */
+	rem = size_ret % sizeof(*hts);
+	if (rem) {
+		rem_ret = lttng_read(ht_cleanup_pipe[0],
+				(char *) hts + size_ret, sizeof(*hts) - rem);
+		if (rem_ret != sizeof(*hts) - rem) {
+			return -1;
+		}
+		size_ret += rem_ret;
+	}
+	return size_ret / sizeof(*hts);
+}
+
 static void *thread_ht_cleanup(void *data)
 {
 	int ret, i, pollfd, err = -1;
-	ssize_t size_ret;
 	uint32_t revents, nb_fd;
 	struct lttng_poll_event events;
 
@@ -139,7 +168,8 @@ static void *thread_ht_cleanup(void *data)
 
 		nb_fd = ret;
 		for (i = 0; i < nb_fd; i++) {
-			struct lttng_ht *ht;
+			ssize_t nr_hts, j;
+			struct lttng_ht *hts[DEFAULT_HT_CLEANUP_BATCH];
 
 			health_code_update();
 
@@ -157,21 +187,27 @@ static void *thread_ht_cleanup(void *data)
 			}
 
 			if (revents & LPOLLIN) {
-				/* Get socket from dispatch thread. */
-				size_ret = lttng_read(ht_cleanup_pipe[0], &ht,
-						sizeof(ht));
-				if (size_ret < sizeof(ht)) {
+				/*
+				 * Get the pushed hash tables, in batches when
+				 * many are pushed at once as on a mass
+				 * application exit.
+				 */
+				nr_hts = read_hts(hts, DEFAULT_HT_CLEANUP_BATCH);
+				if (nr_hts < 0) {
 					PERROR("ht cleanup notify pipe");
 					goto error;
 				}
-				health_code_update();
-				/*
-				 * The whole point of this thread is to call
-				 * lttng_ht_destroy from a context that is NOT:
-				 * 1) a read-side RCU lock,
-				 * 2) a call_rcu thread.
-				 */
-				lttng_ht_destroy(ht);
+				for (j = 0; j < nr_hts; j++) {
+					health_code_update();
+					/*
+					 * The whole point of this thread is to
+					 * call lttng_ht_destroy from a context
+					 * that is NOT:
+					 * 1) a read-side RCU lock,
+					 * 2) a call_rcu thread.
+					 */
+					lttng_ht_destroy(hts[j]);
+				}
 
 				health_code_update();
 			} else if (revents & (LPOLLERR | LPOLLHUP | LPOLLRDHUP)) {
@@ -143,7 +143,8 @@ int kernel_consumer_add_channel(struct consumer_socket *sock,
 			channel->channel->attr.tracefile_count,
 			monitor,
 			channel->channel->attr.live_timer_interval,
-			channel_attr_extended->monitor_timer_interval);
+			channel_attr_extended->monitor_timer_interval,
+			channel_attr_extended->compression);
 
 	health_code_update();
 
@@ -162,7 +163,8 @@ int kernel_consumer_add_channel(struct consumer_socket *sock,
 			ksession->uid, ksession->gid,
 			channel->channel->name, channel->fd,
 			LTTNG_DOMAIN_KERNEL,
-			channel->channel->attr.subbuf_size * channel->channel->attr.num_subbuf);
+			channel->channel->attr.subbuf_size * channel->channel->attr.num_subbuf,
+			channel->channel->attr.subbuf_size);
 	rcu_read_unlock();
 	if (status != LTTNG_OK) {
 		ret = -1;
@@ -222,7 +224,7 @@ int kernel_consumer_add_metadata(struct consumer_socket *sock,
 			DEFAULT_KERNEL_CHANNEL_OUTPUT,
 			CONSUMER_CHANNEL_TYPE_METADATA,
 			0, 0,
-			monitor, 0, 0);
+			monitor, 0, 0, LTTNG_CHANNEL_COMPRESSION_NONE);
 
 	health_code_update();
 
@@ -300,6 +302,65 @@ error:
 	return ret;
 }
 
+/*
+ * Sending the nb_streams streams of the channel not yet sent to the consumer
+ * at once with command ADD_STREAMS, rather than with one ADD_STREAM round trip
+ * per stream.
+ */
+static int kernel_consumer_add_streams(struct consumer_socket *sock,
+		struct ltt_kernel_channel *channel, size_t nb_streams)
+{
+	int ret;
+	size_t i = 0;
+	int32_t *cpus;
+	int *fds;
+	struct ltt_kernel_stream *stream;
+
+	cpus = zmalloc(nb_streams * sizeof(*cpus));
+	fds = zmalloc(nb_streams * sizeof(*fds));
+	if (!cpus || !fds) {
+		PERROR("zmalloc stream array");
+		ret = -ENOMEM;
+		goto error;
+	}
+
+	cds_list_for_each_entry(stream, &channel->stream_list.head, list) {
+		if (stream->sent_to_consumer) {
+			break;
+		}
+		if (!stream->fd) {
+			continue;
+		}
+		cpus[i] = stream->cpu;
+		fds[i] = stream->fd;
+		i++;
+	}
+	assert(i == nb_streams);
+
+	DBG("Sending %zu streams of channel %s to kernel consumer",
+			nb_streams, channel->channel->name);
+
+	health_code_update();
+
+	ret = consumer_send_streams(sock, channel->fd, cpus, fds, nb_streams);
+	if (ret < 0) {
+		goto error;
+	}
+
+	health_code_update();
+
+	cds_list_for_each_entry(stream, &channel->stream_list.head, list) {
+		if (stream->fd) {
+			stream->sent_to_consumer = true;
+		}
+	}
+
+error:
+	free(cpus);
+	free(fds);
+	return ret;
+}
+
 /*
  * Sending the notification that all streams were sent with STREAMS_SENT.
  */
@@ -343,6 +404,7 @@ int kernel_consumer_send_channel_stream(struct consumer_socket *sock,
 {
 	int ret = LTTNG_OK;
 	struct ltt_kernel_stream *stream;
+	size_t nb_streams = 0;
 
 	/* Safety net */
 	assert(channel);
@@ -367,9 +429,30 @@ int kernel_consumer_send_channel_stream(struct consumer_socket *sock,
 		channel->sent_to_consumer = true;
 	}
 
-	/* Send streams */
+	/*
+	 * The streams are added at the head of the list and sent in bulk, or
+	 * one at a time, so the streams not sent yet, such as the stream of a
+	 * hotplugged CPU, are at the head of the list.
+	 */
+	cds_list_for_each_entry(stream, &channel->stream_list.head, list) {
+		if (stream->sent_to_consumer) {
+			break;
+		}
+		if (stream->fd) {
+			nb_streams++;
+		}
+	}
+	if (nb_streams > 1) {
+		ret = kernel_consumer_add_streams(sock, channel, nb_streams);
+		goto error;
+	}
+
+	/* Send the stream added by a CPU hotplug on its own. */
 	cds_list_for_each_entry(stream, &channel->stream_list.head, list) {
-		if (!stream->fd || stream->sent_to_consumer) {
+		if (stream->sent_to_consumer) {
+			break;
+		}
+		if (!stream->fd) {
 			continue;
 		}
 
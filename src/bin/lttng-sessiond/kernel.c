@@ -17,13 +17,16 @@
 
 #define _LGPL_SOURCE
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 #include <inttypes.h>
 
+#include <common/align.h>
 #include <common/common.h>
+#include <common/time.h>
 #include <common/kernel-ctl/kernel-ctl.h>
 #include <common/kernel-ctl/kernel-ioctl.h>
 #include <common/sessiond-comm/sessiond-comm.h>
@@ -32,8 +35,12 @@
 #include "kernel.h"
 #include "kernel-consumer.h"
 #include "kern-modules.h"
+#include "syscall.h"
 #include "utils.h"
 
+/* The kernel tracer lacks the syscall enable mask command. */
+static bool syscall_mask_unsupported;
+
 /*
  * Add context on a kernel channel.
  */
@@ -160,9 +167,7 @@ int kernel_create_channel(struct ltt_kernel_session *session,
 	}
 
 	/* Add channel to session */
-	cds_list_add(&lkc->list, &session->channel_list.head);
-	session->channel_count++;
-	lkc->session = session;
+	trace_kernel_add_channel(session, lkc);
 
 	DBG("Kernel channel %s created (fd: %d)", lkc->channel->name, lkc->fd);
 
@@ -170,8 +175,9 @@ int kernel_create_channel(struct ltt_kernel_session *session,
 
 error:
 	if (lkc) {
-		free(lkc->channel);
-		free(lkc);
+		/* Not added to the session yet, no need to unlink it. */
+		CDS_INIT_LIST_HEAD(&lkc->list);
+		trace_kernel_destroy_channel(lkc);
 	}
 	return -1;
 }
@@ -246,8 +252,7 @@ int kernel_create_event(struct lttng_event *ev,
 	}
 
 	/* Add event to event list */
-	cds_list_add(&event->list, &channel->events_list.head);
-	channel->event_count++;
+	trace_kernel_add_event(channel, event);
 
 	DBG("Event %s created (fd: %d)", ev->name, event->fd);
 
@@ -269,6 +274,295 @@ error:
 	return ret;
 }
 
+/*
+ * Create a batch of kernel events without filter, enable them to the kernel
+ * tracer and add them to the channel event list of the kernel session. The
+ * creation commands of the whole batch are issued before the events are
+ * enabled.
+ *
+ * Every event is attempted. Return 0 on success or else the negative value
+ * of the first failure, as returned by kernel_create_event().
+ */
+int kernel_create_events(struct lttng_event **evs, unsigned int nr_evs,
+		struct ltt_kernel_channel *channel)
+{
+	int ret = 0;
+	unsigned int i;
+	int *fds = NULL;
+	struct ltt_kernel_event **events = NULL;
+	struct lttng_kernel_event **attrs = NULL;
+
+	assert(evs);
+	assert(channel);
+
+	events = zmalloc(nr_evs * sizeof(*events));
+	attrs = zmalloc(nr_evs * sizeof(*attrs));
+	fds = zmalloc(nr_evs * sizeof(*fds));
+	if (!events || !attrs || !fds) {
+		PERROR("zmalloc kernel events batch");
+		ret = -ENOMEM;
+		goto end;
+	}
+
+	for (i = 0; i < nr_evs; i++) {
+		events[i] = trace_kernel_create_event(evs[i], NULL, NULL);
+		if (!events[i]) {
+			ret = -1;
+			goto end;
+		}
+		CDS_INIT_LIST_HEAD(&events[i]->list);
+		events[i]->type = evs[i]->type;
+		attrs[i] = events[i]->event;
+	}
+
+	kernctl_create_events(channel->fd, attrs, nr_evs, fds);
+
+	for (i = 0; i < nr_evs; i++) {
+		int err = fds[i];
+		struct ltt_kernel_event *event = events[i];
+
+		if (err < 0) {
+			switch (-err) {
+			case EEXIST:
+				break;
+			case ENOSYS:
+				WARN("Event type not implemented");
+				break;
+			case ENOENT:
+				WARN("Event %s not found!", evs[i]->name);
+				break;
+			default:
+				errno = -err;
+				PERROR("create event ioctl");
+			}
+			goto error_event;
+		}
+
+		event->fd = err;
+		/* Prevent fd duplication after execlp() */
+		err = fcntl(event->fd, F_SETFD, FD_CLOEXEC);
+		if (err < 0) {
+			PERROR("fcntl session fd");
+		}
+
+		err = kernctl_enable(event->fd);
+		if (err < 0) {
+			switch (-err) {
+			case EEXIST:
+				err = LTTNG_ERR_KERN_EVENT_EXIST;
+				break;
+			default:
+				PERROR("enable kernel event");
+				break;
+			}
+			goto error_event;
+		}
+
+		/* Add event to event list */
+		trace_kernel_add_event(channel, event);
+		events[i] = NULL;
+
+		DBG("Event %s created (fd: %d)", evs[i]->name, event->fd);
+		continue;
+
+	error_event:
+		if (!ret) {
+			ret = err;
+		}
+	}
+
+end:
+	if (events) {
+		for (i = 0; i < nr_evs; i++) {
+			if (events[i]) {
+				trace_kernel_destroy_event(events[i]);
+			}
+		}
+	}
+	free(events);
+	free(attrs);
+	free(fds);
+	return ret;
+}
+
+/*
+ * Whether a system call event without filter can be traced through the
+ * syscall mask of its channel. It must name system calls of the syscall
+ * table, the wildcards being left to the kernel tracer.
+ */
+bool kernel_syscall_mask_eligible(const struct lttng_event *ev)
+{
+	assert(ev);
+
+	return !syscall_mask_unsupported && ev->type == LTTNG_EVENT_SYSCALL &&
+			!strchr(ev->name, '*') &&
+			syscall_table_mask_set(ev->name, NULL);
+}
+
+/*
+ * Create a system call event traced through the syscall mask of a kernel
+ * channel and add it to the channel event list. The mask is applied right
+ * away when the session is active, or else when it starts, so that the
+ * system calls enabled before starting cost a single command per channel.
+ *
+ * Return 0 on success else a negative value. On an error to apply the mask,
+ * the event is kept and the mask is applied again on its next change.
+ */
+int kernel_create_mask_syscall(struct lttng_event *ev,
+		struct ltt_kernel_channel *channel)
+{
+	struct ltt_kernel_event *event;
+
+	assert(ev);
+	assert(channel);
+
+	event = trace_kernel_create_event(ev, NULL, NULL);
+	if (!event) {
+		return -1;
+	}
+	event->type = ev->type;
+	event->in_syscall_mask = true;
+
+	trace_kernel_add_event(channel, event);
+
+	DBG("Event %s added to the syscall mask of channel %s", ev->name,
+			channel->channel->name);
+
+	return kernel_syscall_mask_changed(channel);
+}
+
+/*
+ * Fall back to an event of the kernel tracer for each system call of the
+ * syscall mask of a channel. The events which cannot be created are removed.
+ *
+ * Return 0 on success or else the negative value of the first failure.
+ */
+static int create_syscall_mask_events(struct ltt_kernel_channel *chan)
+{
+	int ret = 0;
+	struct ltt_kernel_event *event, *tmp;
+
+	cds_list_for_each_entry_safe(event, tmp, &chan->events_list.head,
+			list) {
+		int err;
+
+		if (!event->in_syscall_mask) {
+			continue;
+		}
+
+		err = kernctl_create_event(chan->fd, event->event);
+		if (err < 0) {
+			goto error_event;
+		}
+		event->fd = err;
+		event->in_syscall_mask = false;
+		/* Prevent fd duplication after execlp() */
+		if (fcntl(event->fd, F_SETFD, FD_CLOEXEC) < 0) {
+			PERROR("fcntl session fd");
+		}
+
+		err = event->enabled ? kernctl_enable(event->fd) :
+				kernctl_disable(event->fd);
+		if (err < 0 && err != -EEXIST) {
+			goto error_event;
+		}
+
+		DBG("Event %s created (fd: %d)", event->event->name, event->fd);
+		continue;
+
+	error_event:
+		errno = -err;
+		PERROR("create syscall event %s", event->event->name);
+		trace_kernel_destroy_event(event);
+		chan->event_count--;
+		if (!ret) {
+			ret = err;
+		}
+	}
+
+	return ret;
+}
+
+/*
+ * Apply the syscall mask of a kernel channel when it changed: a single
+ * command enables the enabled system calls of its mask. With a kernel tracer
+ * lacking the command, the system calls of the mask become events of the
+ * kernel tracer, one by one.
+ *
+ * Return 0 on success else a negative value.
+ */
+int kernel_apply_syscall_mask(struct ltt_kernel_channel *chan)
+{
+	int ret = 0;
+	char *mask = NULL;
+	uint32_t nr_bits = syscall_table_mask_len();
+	struct ltt_kernel_event *event;
+
+	assert(chan);
+
+	if (!chan->syscall_mask_dirty) {
+		goto end;
+	}
+
+	if (syscall_mask_unsupported || !nr_bits) {
+		ret = create_syscall_mask_events(chan);
+		goto applied;
+	}
+
+	mask = zmalloc(ALIGN(nr_bits, 8) >> 3);
+	if (!mask) {
+		PERROR("zmalloc syscall mask");
+		ret = -ENOMEM;
+		goto end;
+	}
+
+	cds_list_for_each_entry(event, &chan->events_list.head, list) {
+		if (event->in_syscall_mask && event->enabled) {
+			(void) syscall_table_mask_set(event->event->name, mask);
+		}
+	}
+
+	ret = kernctl_syscall_enable_mask(chan->fd, mask, nr_bits);
+	switch (-ret) {
+	case 0:
+		break;
+	case ENOTTY:
+	case EINVAL:
+		DBG("Kernel tracer without syscall enable mask, creating the syscall events of channel %s",
+				chan->channel->name);
+		syscall_mask_unsupported = true;
+		ret = create_syscall_mask_events(chan);
+		break;
+	default:
+		errno = -ret;
+		PERROR("syscall enable mask ioctl");
+		goto end;
+	}
+
+	DBG("Syscall mask of channel %s applied", chan->channel->name);
+applied:
+	/* The events which could not be created are gone. */
+	chan->syscall_mask_dirty = false;
+end:
+	free(mask);
+	return ret;
+}
+
+/*
+ * Record a change of the syscall mask of a kernel channel, applied right away
+ * if the session is active.
+ */
+int kernel_syscall_mask_changed(struct ltt_kernel_channel *chan)
+{
+	assert(chan);
+
+	chan->syscall_mask_dirty = true;
+	if (!chan->session->active) {
+		return 0;
+	}
+	return kernel_apply_syscall_mask(chan);
+}
+
 /*
  * Disable a kernel channel.
  */
@@ -424,6 +718,51 @@ int kernel_untrack_pid(struct ltt_kernel_session *session, int pid)
 	}
 }
 
+/*
+ * The kernel tracer takes the PIDs one at a time: track each PID of the
+ * ranges, ignoring the PIDs already tracked.
+ */
+int kernel_track_pid_ranges(struct ltt_kernel_session *session,
+		const struct lttng_pid_range *ranges, unsigned int nb_ranges)
+{
+	unsigned int i;
+
+	for (i = 0; i < nb_ranges; i++) {
+		int64_t pid;
+
+		for (pid = ranges[i].start; pid <= ranges[i].end; pid++) {
+			int ret = kernel_track_pid(session, (int) pid);
+
+			if (ret != LTTNG_OK && ret != LTTNG_ERR_PID_TRACKED) {
+				return ret;
+			}
+		}
+	}
+	return LTTNG_OK;
+}
+
+/*
+ * Untrack each PID of the ranges, ignoring the PIDs which are not tracked.
+ */
+int kernel_untrack_pid_ranges(struct ltt_kernel_session *session,
+		const struct lttng_pid_range *ranges, unsigned int nb_ranges)
+{
+	unsigned int i;
+
+	for (i = 0; i < nb_ranges; i++) {
+		int64_t pid;
+
+		for (pid = ranges[i].start; pid <= ranges[i].end; pid++) {
+			int ret = kernel_untrack_pid(session, (int) pid);
+
+			if (ret != LTTNG_OK && ret != LTTNG_ERR_PID_NOT_TRACKED) {
+				return ret;
+			}
+		}
+	}
+	return LTTNG_OK;
+}
+
 ssize_t kernel_list_tracker_pids(struct ltt_kernel_session *session,
 		int **_pids)
 {
@@ -652,7 +991,7 @@ error:
  */
 int kernel_open_channel_stream(struct ltt_kernel_channel *channel)
 {
-	int ret;
+	int ret, nb_created = 0;
 	struct ltt_kernel_stream *lks;
 
 	assert(channel);
@@ -681,12 +1020,13 @@ int kernel_open_channel_stream(struct ltt_kernel_channel *channel)
 		/* Add stream to channel stream list */
 		cds_list_add(&lks->list, &channel->stream_list.head);
 		channel->stream_count++;
+		nb_created++;
 
 		DBG("Kernel stream %s created (fd: %d, state: %d)", lks->name, lks->fd,
 				lks->state);
 	}
 
-	return channel->stream_count;
+	return nb_created;
 
 error:
 	return -1;
@@ -722,9 +1062,10 @@ error:
 }
 
 /*
- * Get the event list from the kernel tracer and return the number of elements.
+ * Read the event list from the kernel tracer and return the number of
+ * elements.
  */
-ssize_t kernel_list_events(int tracer_fd, struct lttng_event **events)
+static ssize_t read_kernel_events(int tracer_fd, struct lttng_event **events)
 {
 	int fd, ret;
 	char *event;
@@ -805,6 +1146,106 @@ error:
 	return -1;
 }
 
+/*
+ * Cache of the event list of the kernel tracer. The list only changes when
+ * a probe module is loaded or unloaded.
+ */
+static struct kernel_event_list_cache {
+	pthread_mutex_t lock;
+	struct lttng_event *events;
+	size_t nr_events;
+	/* Monotonic time at which the list was read, in nanoseconds. */
+	uint64_t read_ns;
+} event_list_cache = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/*
+ * Copy the cached event list if it is still valid.
+ *
+ * Called with the cache lock held. Return the number of events, or else -1
+ * if the list must be read from the kernel tracer.
+ */
+static ssize_t get_cached_events(struct lttng_event **events)
+{
+	struct lttng_event *elist;
+	uint64_t now_ns = lttng_monotonic_time_ns();
+
+	if (!event_list_cache.events || !now_ns ||
+			now_ns - event_list_cache.read_ns >
+				DEFAULT_KERNEL_EVENT_LIST_CACHE_VALIDITY) {
+		return -1;
+	}
+
+	elist = zmalloc(sizeof(*elist) * max_t(size_t,
+			event_list_cache.nr_events, 1));
+	if (!elist) {
+		PERROR("zmalloc cached events list");
+		return -1;
+	}
+	memcpy(elist, event_list_cache.events,
+			sizeof(*elist) * event_list_cache.nr_events);
+	*events = elist;
+	return event_list_cache.nr_events;
+}
+
+/*
+ * Replace the cached event list by a copy of "events".
+ *
+ * Called with the cache lock held.
+ */
+static void set_cached_events(struct lttng_event *events, size_t nr_events)
+{
+	struct lttng_event *elist;
+
+	elist = zmalloc(sizeof(*elist) * max_t(size_t, nr_events, 1));
+	if (!elist) {
+		/* The list is read again next time. */
+		PERROR("zmalloc cached events list");
+		return;
+	}
+	memcpy(elist, events, sizeof(*elist) * nr_events);
+	free(event_list_cache.events);
+	event_list_cache.events = elist;
+	event_list_cache.nr_events = nr_events;
+	event_list_cache.read_ns = lttng_monotonic_time_ns();
+}
+
+void kernel_list_events_invalidate(void)
+{
+	pthread_mutex_lock(&event_list_cache.lock);
+	free(event_list_cache.events);
+	event_list_cache.events = NULL;
+	event_list_cache.nr_events = 0;
+	pthread_mutex_unlock(&event_list_cache.lock);
+}
+
+/*
+ * Get the event list from the kernel tracer and return the number of elements.
+ * The list is cached for DEFAULT_KERNEL_EVENT_LIST_CACHE_VALIDITY ns, which
+ * bounds the time during which a probe module loaded outside of the session
+ * daemon is not listed.
+ */
+ssize_t kernel_list_events(int tracer_fd, struct lttng_event **events)
+{
+	ssize_t ret;
+
+	pthread_mutex_lock(&event_list_cache.lock);
+	ret = get_cached_events(events);
+	if (ret >= 0) {
+		DBG("Kernel list events from cache (%zd events)", ret);
+		goto end;
+	}
+
+	ret = read_kernel_events(tracer_fd, events);
+	if (ret >= 0) {
+		set_cached_events(*events, ret);
+	}
+end:
+	pthread_mutex_unlock(&event_list_cache.lock);
+	return ret;
+}
+
 /*
  * Get kernel version and validate it.
  */
@@ -39,12 +39,23 @@ int kernel_create_channel(struct ltt_kernel_session *session,
 		struct lttng_channel *chan);
 int kernel_create_event(struct lttng_event *ev, struct ltt_kernel_channel *channel,
 		char *filter_expression, struct lttng_filter_bytecode *filter);
+int kernel_create_events(struct lttng_event **evs, unsigned int nr_evs,
+		struct ltt_kernel_channel *channel);
+bool kernel_syscall_mask_eligible(const struct lttng_event *ev);
+int kernel_create_mask_syscall(struct lttng_event *ev,
+		struct ltt_kernel_channel *channel);
+int kernel_apply_syscall_mask(struct ltt_kernel_channel *chan);
+int kernel_syscall_mask_changed(struct ltt_kernel_channel *chan);
 int kernel_disable_channel(struct ltt_kernel_channel *chan);
 int kernel_disable_event(struct ltt_kernel_event *event);
 int kernel_enable_event(struct ltt_kernel_event *event);
 int kernel_enable_channel(struct ltt_kernel_channel *chan);
 int kernel_track_pid(struct ltt_kernel_session *session, int pid);
 int kernel_untrack_pid(struct ltt_kernel_session *session, int pid);
+int kernel_track_pid_ranges(struct ltt_kernel_session *session,
+		const struct lttng_pid_range *ranges, unsigned int nb_ranges);
+int kernel_untrack_pid_ranges(struct ltt_kernel_session *session,
+		const struct lttng_pid_range *ranges, unsigned int nb_ranges);
 int kernel_open_metadata(struct ltt_kernel_session *session);
 int kernel_open_metadata_stream(struct ltt_kernel_session *session);
 int kernel_open_channel_stream(struct ltt_kernel_channel *channel);
@@ -53,6 +64,7 @@ int kernel_metadata_flush_buffer(int fd);
 int kernel_start_session(struct ltt_kernel_session *session);
 int kernel_stop_session(struct ltt_kernel_session *session);
 ssize_t kernel_list_events(int tracer_fd, struct lttng_event **event_list);
+void kernel_list_events_invalidate(void);
 void kernel_wait_quiescent(int fd);
 int kernel_validate_version(int tracer_fd);
 void kernel_destroy_session(struct ltt_kernel_session *ksess);
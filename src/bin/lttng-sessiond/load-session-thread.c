@@ -86,6 +86,7 @@ error:
 void *thread_load_session(void *data)
 {
 	int ret;
+	bool notified = false;
 	struct load_session_thread_data *info = data;
 
 	DBG("[load-session-thread] Load session");
@@ -96,13 +97,22 @@ void *thread_load_session(void *data)
 		goto end;
 	}
 
+	if (info->notify_before_load) {
+		sessiond_notify_ready();
+		notified = true;
+	}
+
 	/* Override existing session and autoload also. */
-	ret = config_load_session(info->path, NULL, 1, 1, NULL);
+	ret = config_load_session(info->path, NULL, 1, 1, NULL,
+			info->nr_threads, !info->trusted);
 	if (ret) {
 		ERR("Session load failed: %s", error_get_str(ret));
 	}
+	DBG("[load-session-thread] Session loading subsystem ready");
 
 end:
-	sessiond_notify_ready();
+	if (!notified) {
+		sessiond_notify_ready();
+	}
 	return NULL;
 }
@@ -33,6 +33,15 @@ struct load_session_thread_data {
 
 	/* Path where the sessions are located. */
 	const char *path;
+	/* Number of threads loading the files of a directory. */
+	unsigned int nr_threads;
+	/* Skip the XSD validation of the files. */
+	unsigned int trusted:1;
+	/*
+	 * Notify the readiness of the session daemon before loading the
+	 * sessions rather than once they are loaded.
+	 */
+	unsigned int notify_before_load:1;
 };
 
 void *thread_load_session(void *data);
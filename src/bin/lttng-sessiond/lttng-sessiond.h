@@ -20,6 +20,7 @@
 #define _LTT_SESSIOND_H
 
 #include <urcu.h>
+#include <urcu/list.h>
 #include <urcu/wfcqueue.h>
 
 #include <common/sessiond-comm/sessiond-comm.h>
@@ -52,14 +53,36 @@ struct command_ctx {
 	struct lttcomm_lttng_msg *llm;
 	struct lttcomm_session_msg *lsm;
 	lttng_sock_cred creds;
+	/* Client socket and node in the client command queues. */
+	int sock;
+	struct cds_list_head list;
+	/* The reply is sent by the command itself. */
+	int reply_deferred;
+	/* The client socket is kept open for the next commands. */
+	int persistent;
+	/* Size of the command payload not received from the client yet. */
+	size_t payload_left;
 };
 
 struct ust_command {
 	int sock;
 	struct ust_register_msg reg_msg;
+	/* Monotonic time of the enqueue, in nsec. */
+	uint64_t enqueue_ns;
 	struct cds_wfcq_node node;
 };
 
+/* Statistics of the UST registration queue, updated by the dispatch thread. */
+struct ust_cmd_queue_stats {
+	uint64_t dequeued;
+	unsigned long max_depth;
+	/* Time spent in the queue by the dequeued commands. */
+	uint64_t total_wait_ns;
+	uint64_t max_wait_ns;
+	/* Applications registered again while still known. */
+	uint64_t reregistered;
+};
+
 /*
  * Queue used to enqueue UST registration request (ust_command) and synchronized
  * by a futex with a scheme N wakers / 1 waiters. See futex.c/.h
@@ -68,6 +91,9 @@ struct ust_cmd_queue {
 	int32_t futex;
 	struct cds_wfcq_head head;
 	struct cds_wfcq_tail tail;
+	/* Number of queued commands. Updated atomically. */
+	unsigned long depth;
+	struct ust_cmd_queue_stats stats;
 };
 
 /*
@@ -89,10 +115,11 @@ struct ust_reg_wait_node {
 };
 
 /*
- * This pipe is used to inform the thread managing application notify
- * communication that a command is queued and ready to be processed.
+ * These pipes are used to inform the threads managing application notify
+ * communication that a command is queued and ready to be processed. They are
+ * indexed by the number of the notify thread.
  */
-extern int apps_cmd_notify_pipe[2];
+extern int apps_cmd_notify_pipe[DEFAULT_APP_NOTIFY_THREADS_MAX][2];
 
 /*
  * Used to notify that a hash table needs to be destroyed by dedicated
@@ -113,6 +140,24 @@ extern long page_size;
  */
 extern unsigned int agent_tcp_port;
 
+/* Socket timeout of the applications and agents, in seconds. */
+extern int app_socket_timeout;
+
+/*
+ * Close the fds of the channel objects once sent to the applications, set
+ * once in main().
+ */
+extern int app_fd_frugal;
+
+/* Number of threads saving the sessions concurrently. */
+extern unsigned int save_threads;
+
+/*
+ * Bytes of the session daemon a UST session can use before refusing new
+ * applications, 0 if unlimited. Set once in main().
+ */
+extern uint64_t ust_session_memory_cap;
+
 /* Application health monitoring */
 extern struct health_app *health_sessiond;
 
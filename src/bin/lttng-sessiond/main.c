@@ -42,13 +42,16 @@
 #include <common/common.h>
 #include <common/compat/socket.h>
 #include <common/compat/getenv.h>
+#include <common/compat/time.h>
 #include <common/defaults.h>
 #include <common/kernel-consumer/kernel-consumer.h>
 #include <common/futex.h>
 #include <common/relayd/relayd.h>
 #include <common/utils.h>
+#include <common/time.h>
 #include <common/daemonize.h>
 #include <common/config/session-config.h>
+#include <common/self-tracing/self-tracing.h>
 
 #include "lttng-sessiond.h"
 #include "buffer-registry.h"
@@ -76,6 +79,7 @@
 #include "syscall.h"
 #include "agent.h"
 #include "ht-cleanup.h"
+#include "app-update-pool.h"
 
 #define CONSUMERD_FILE	"lttng-consumerd"
 
@@ -95,7 +99,23 @@ static int opt_sig_parent;
 static int opt_verbose_consumer;
 static int opt_daemon, opt_background;
 static int opt_no_kernel;
+static int opt_lazy_kmod_probes;
+static int opt_consumerd_prefork;
+static int opt_lazy_consumerd;
+static int opt_async_init;
 static char *opt_load_session_path;
+static unsigned int opt_load_threads = DEFAULT_LOAD_THREADS;
+static int opt_load_trusted;
+static unsigned int opt_app_update_threads = DEFAULT_APP_UPDATE_THREADS;
+static unsigned int opt_notification_threads = DEFAULT_NOTIFICATION_THREADS;
+/* Target discarded events per second of the buffer advisor, -1 if disabled. */
+static int64_t opt_buffer_advisor_rate = -1;
+static int opt_overload_high = -1;
+static int opt_overload_low = -1;
+unsigned int save_threads = DEFAULT_SAVE_THREADS;
+uint64_t ust_session_memory_cap;
+static unsigned int opt_client_threads = DEFAULT_CLIENT_THREADS;
+static unsigned int opt_app_notify_threads = DEFAULT_APP_NOTIFY_THREADS;
 static pid_t ppid;          /* Parent PID for --sig-parent option */
 static pid_t child_ppid;    /* Internal parent PID use with daemonize. */
 static char *rundir;
@@ -169,12 +189,29 @@ static const struct option long_options[] = {
 	{ "verbose", no_argument, 0, 'v' },
 	{ "verbose-consumer", no_argument, 0, '\0' },
 	{ "no-kernel", no_argument, 0, '\0' },
+	{ "lazy-kmod-probes", no_argument, 0, '\0' },
+	{ "consumerd-prefork", no_argument, 0, '\0' },
+	{ "lazy-consumerd", no_argument, 0, '\0' },
+	{ "async-init", no_argument, 0, '\0' },
 	{ "pidfile", required_argument, 0, 'p' },
 	{ "agent-tcp-port", required_argument, 0, '\0' },
 	{ "config", required_argument, 0, 'f' },
 	{ "load", required_argument, 0, 'l' },
 	{ "kmod-probes", required_argument, 0, '\0' },
 	{ "extra-kmod-probes", required_argument, 0, '\0' },
+	{ "app-update-threads", required_argument, 0, '\0' },
+	{ "client-threads", required_argument, 0, '\0' },
+	{ "save-threads", required_argument, 0, '\0' },
+	{ "load-threads", required_argument, 0, '\0' },
+	{ "load-trusted", no_argument, 0, '\0' },
+	{ "app-notify-threads", required_argument, 0, '\0' },
+	{ "ust-prewarm-uids", required_argument, 0, '\0' },
+	{ "ust-specialize-filters", no_argument, 0, '\0' },
+	{ "ust-cache-tracepoint-lists", no_argument, 0, '\0' },
+	{ "ust-session-memory-cap", required_argument, 0, '\0' },
+	{ "notification-threads", required_argument, 0, '\0' },
+	{ "buffer-advisor", required_argument, 0, '\0' },
+	{ "overload-shedding", required_argument, 0, '\0' },
 	{ NULL, 0, 0, 0 }
 };
 
@@ -211,11 +248,12 @@ static int thread_quit_pipe[2] = { -1, -1 };
  */
 static int apps_cmd_pipe[2] = { -1, -1 };
 
-int apps_cmd_notify_pipe[2] = { -1, -1 };
+int apps_cmd_notify_pipe[DEFAULT_APP_NOTIFY_THREADS_MAX][2];
 
 /* Pthread, Mutexes and Semaphores */
 static pthread_t apps_thread;
-static pthread_t apps_notify_thread;
+static pthread_t apps_notify_threads[DEFAULT_APP_NOTIFY_THREADS_MAX];
+static unsigned int nr_apps_notify_threads;
 static pthread_t reg_apps_thread;
 static pthread_t client_thread;
 static pthread_t kernel_thread;
@@ -224,6 +262,8 @@ static pthread_t health_thread;
 static pthread_t ht_cleanup_thread;
 static pthread_t agent_reg_thread;
 static pthread_t load_session_thread;
+static pthread_t kernel_init_thread;
+static bool kernel_init_thread_running;
 static pthread_t notification_thread;
 
 /*
@@ -241,8 +281,10 @@ static struct ust_cmd_queue ust_cmd_queue;
  * Pointer initialized before thread creation.
  *
  * This points to the tracing session list containing the session count and a
- * mutex lock. The lock MUST be taken if you iterate over the list. The lock
- * MUST NOT be taken if you call a public function in session.c.
+ * mutex lock. The lock MUST be taken if you iterate over the list, unless it
+ * is iterated within a RCU read-side critical section as described in
+ * session.h. The lock MUST NOT be taken if you call a public function in
+ * session.c.
  *
  * The lock is nested inside the structure: session_list_ptr->lock. Please use
  * session_lock_list and session_unlock_list for lock acquisition.
@@ -297,10 +339,25 @@ enum consumerd_state {
 static enum consumerd_state ust_consumerd_state;
 static enum consumerd_state kernel_consumerd_state;
 
+/*
+ * Serializes the starts of the consumer daemons between the client threads,
+ * the pre-fork at startup and the registration of the applications.
+ */
+static pthread_mutex_t consumerd_start_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * With --async-init, the kernel tracer is initialized in the background and
+ * the kernel commands wait for kernel_init_done to be set.
+ */
+static int kernel_init_done = 1;
+static pthread_mutex_t kernel_init_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t kernel_init_cond = PTHREAD_COND_INITIALIZER;
+
 /*
  * Socket timeout for receiving and sending in seconds.
  */
-static int app_socket_timeout;
+int app_socket_timeout;
+int app_fd_frugal = DEFAULT_APP_FD_FRUGAL;
 
 /* Set in main() with the current page size. */
 long page_size;
@@ -697,6 +754,7 @@ static void sessiond_cleanup(void)
 		/* Cleanup ALL session */
 		cds_list_for_each_entry_safe(sess, stmp,
 				&session_list_ptr->head, list) {
+			session_lock(sess);
 			cmd_destroy_session(sess, kernel_poll_pipe[1]);
 		}
 	}
@@ -711,6 +769,7 @@ static void sessiond_cleanup(void)
 	DBG("Closing all UST sockets");
 	ust_app_clean_list();
 	buffer_reg_destroy_registries();
+	ust_metadata_cache_destroy();
 
 	if (is_root && !opt_no_kernel) {
 		DBG2("Closing kernel fd");
@@ -911,11 +970,59 @@ static int setup_lttng_msg_no_cmd_header(struct command_ctx *cmd_ctx,
 {
 	return setup_lttng_msg(cmd_ctx, payload_buf, payload_len, NULL, 0);
 }
+/*
+ * Channel fd of the kernel poll set and the id of its session, so that a CPU
+ * hotplug only looks at the channels of the session of the fd.
+ */
+struct kernel_poll_channel {
+	int fd;
+	uint64_t session_id;
+};
+
+/* Kernel poll set channels, sorted by fd. Only used by the kernel thread. */
+struct kernel_poll_channels {
+	struct kernel_poll_channel *entries;
+	size_t count;
+	size_t alloc;
+};
+
+static int kernel_poll_channel_cmp(const void *a, const void *b)
+{
+	const struct kernel_poll_channel *ca = a, *cb = b;
+
+	return (ca->fd > cb->fd) - (ca->fd < cb->fd);
+}
+
+static int kernel_poll_channels_add(struct kernel_poll_channels *channels,
+		int fd, uint64_t session_id)
+{
+	if (channels->count == channels->alloc) {
+		size_t new_alloc = max_t(size_t, 2 * channels->alloc, 16);
+		struct kernel_poll_channel *new_entries;
+
+		new_entries = realloc(channels->entries,
+				new_alloc * sizeof(*new_entries));
+		if (!new_entries) {
+			PERROR("realloc kernel poll channels");
+			return -1;
+		}
+		channels->entries = new_entries;
+		channels->alloc = new_alloc;
+	}
+	channels->entries[channels->count].fd = fd;
+	channels->entries[channels->count].session_id = session_id;
+	channels->count++;
+	return 0;
+}
+
 /*
  * Update the kernel poll set of all channel fd available over all tracing
  * session. Add the wakeup pipe at the end of the set.
+ *
+ * The channels are also recorded, sorted by fd, in 'channels'.
  */
-static int update_kernel_poll(struct lttng_poll_event *events)
+static int update_kernel_poll(struct lttng_poll_event *events,
+		struct kernel_poll_channels *channels)
 {
 	int ret;
 	struct ltt_session *session;
@@ -923,6 +1030,7 @@ static int update_kernel_poll(struct lttng_poll_event *events)
 
 	DBG("Updating kernel poll set");
 
+	channels->count = 0;
 	session_lock_list();
 	cds_list_for_each_entry(session, &session_list_ptr->head, list) {
 		session_lock(session);
@@ -939,12 +1047,20 @@ static int update_kernel_poll(struct lttng_poll_event *events)
 				session_unlock(session);
 				goto error;
 			}
+			ret = kernel_poll_channels_add(channels, channel->fd,
+					session->id);
+			if (ret < 0) {
+				session_unlock(session);
+				goto error;
+			}
 			DBG("Channel fd %d added to kernel set", channel->fd);
 		}
 		session_unlock(session);
 	}
 	session_unlock_list();
 
+	qsort(channels->entries, channels->count, sizeof(*channels->entries),
+			kernel_poll_channel_cmp);
 	return 0;
 
 error:
@@ -953,89 +1069,102 @@ error:
 }
 
 /*
- * Find the channel fd from 'fd' over all tracing session. When found, check
- * for new channel stream and send those stream fds to the kernel consumer.
+ * Find the channel fd from 'fd' in the tracing session it was added to the
+ * poll set for. When found, check for new channel stream and send those
+ * stream fds to the kernel consumer.
+ *
+ * Only the session of the channel is locked, the session list lock is not
+ * taken.
  *
  * Useful for CPU hotplug feature.
  */
-static int update_kernel_stream(struct consumer_data *consumer_data, int fd)
+static int update_kernel_stream(struct consumer_data *consumer_data, int fd,
+		const struct kernel_poll_channels *channels)
 {
 	int ret = 0;
 	struct ltt_session *session;
 	struct ltt_kernel_session *ksess;
 	struct ltt_kernel_channel *channel;
+	struct kernel_poll_channel key, *entry;
 
 	DBG("Updating kernel streams for channel fd %d", fd);
 
-	session_lock_list();
-	cds_list_for_each_entry(session, &session_list_ptr->head, list) {
-		session_lock(session);
-		if (session->kernel_session == NULL) {
-			session_unlock(session);
+	key.fd = fd;
+	entry = bsearch(&key, channels->entries, channels->count,
+			sizeof(*channels->entries), kernel_poll_channel_cmp);
+	if (!entry) {
+		DBG("Channel fd %d not in the kernel poll set", fd);
+		goto end;
+	}
+
+	session = session_lock_by_id(entry->session_id);
+	if (!session) {
+		DBG("Session %" PRIu64 " of channel fd %d is gone",
+				entry->session_id, fd);
+		goto end;
+	}
+	ksess = session->kernel_session;
+	if (ksess == NULL) {
+		goto end_unlock;
+	}
+
+	cds_list_for_each_entry(channel, &ksess->channel_list.head, list) {
+		struct lttng_ht_iter iter;
+		struct consumer_socket *socket;
+
+		if (channel->fd != fd) {
 			continue;
 		}
-		ksess = session->kernel_session;
+		DBG("Channel found, updating kernel streams");
+		ret = kernel_open_channel_stream(channel);
+		if (ret < 0) {
+			goto end_unlock;
+		}
+		/* Update the stream global counter */
+		ksess->stream_count_global += ret;
 
-		cds_list_for_each_entry(channel,
-				&ksess->channel_list.head, list) {
-			struct lttng_ht_iter iter;
-			struct consumer_socket *socket;
+		/*
+		 * Have we already sent fds to the consumer? If yes, it
+		 * means that tracing is started so it is safe to send
+		 * our updated stream fds.
+		 */
+		if (ksess->consumer_fds_sent != 1
+				|| ksess->consumer == NULL) {
+			ret = -1;
+			goto end_unlock;
+		}
 
-			if (channel->fd != fd) {
-				continue;
-			}
-			DBG("Channel found, updating kernel streams");
-			ret = kernel_open_channel_stream(channel);
+		rcu_read_lock();
+		cds_lfht_for_each_entry(ksess->consumer->socks->ht,
+				&iter.iter, socket, node.node) {
+			pthread_mutex_lock(socket->lock);
+			ret = kernel_consumer_send_channel_stream(socket,
+					channel, ksess,
+					session->output_traces ? 1 : 0);
+			pthread_mutex_unlock(socket->lock);
 			if (ret < 0) {
-				goto error;
-			}
-			/* Update the stream global counter */
-			ksess->stream_count_global += ret;
-
-			/*
-			 * Have we already sent fds to the consumer? If yes, it
-			 * means that tracing is started so it is safe to send
-			 * our updated stream fds.
-			 */
-			if (ksess->consumer_fds_sent != 1
-					|| ksess->consumer == NULL) {
-				ret = -1;
-				goto error;
-			}
-
-			rcu_read_lock();
-			cds_lfht_for_each_entry(ksess->consumer->socks->ht,
-					&iter.iter, socket, node.node) {
-				pthread_mutex_lock(socket->lock);
-				ret = kernel_consumer_send_channel_stream(socket,
-						channel, ksess,
-						session->output_traces ? 1 : 0);
-				pthread_mutex_unlock(socket->lock);
-				if (ret < 0) {
-					rcu_read_unlock();
-					goto error;
-				}
+				break;
 			}
-			rcu_read_unlock();
 		}
-		session_unlock(session);
+		rcu_read_unlock();
+		break;
 	}
-	session_unlock_list();
-	return ret;
 
-error:
+end_unlock:
 	session_unlock(session);
-	session_unlock_list();
+end:
 	return ret;
 }
 
 /*
- * For each tracing session, update newly registered apps. The session list
- * lock MUST be acquired before calling this.
+ * For each tracing session, update newly registered apps. The session list is
+ * iterated without its lock, each session being updated with its own lock
+ * held.
  */
 static void update_ust_app(int app_sock)
 {
-	struct ltt_session *sess, *stmp;
+	struct ltt_session *sess;
+	struct ltt_session_list_iter iter = SESSION_LIST_ITER_INIT;
 
 	/* Consumer is in an ERROR state. Stop any application update. */
 	if (uatomic_read(&ust_consumerd_state) == CONSUMER_ERROR) {
@@ -1044,15 +1173,15 @@ static void update_ust_app(int app_sock)
 	}
 
 	/* For all tracing session(s) */
-	cds_list_for_each_entry_safe(sess, stmp, &session_list_ptr->head, list) {
+	while ((sess = session_lock_next_alive(&iter))) {
 		struct ust_app *app;
 
-		session_lock(sess);
+		/* The application is looked up with its session locked. */
+		rcu_read_lock();
 		if (!sess->ust_session) {
 			goto unlock_session;
 		}
 
-		rcu_read_lock();
 		assert(app_sock >= 0);
 		app = ust_app_find_by_sock(app_sock);
 		if (app == NULL) {
@@ -1063,12 +1192,11 @@ static void update_ust_app(int app_sock)
 			 */
 			DBG3("UST app update failed to find app sock %d",
 				app_sock);
-			goto unlock_rcu;
+			goto unlock_session;
 		}
 		ust_app_global_update(sess->ust_session, app);
-	unlock_rcu:
-		rcu_read_unlock();
 	unlock_session:
+		rcu_read_unlock();
 		session_unlock(sess);
 	}
 }
@@ -1085,9 +1213,12 @@ static void *thread_manage_kernel(void *data)
 	uint32_t revents, nb_fd;
 	char tmp;
 	struct lttng_poll_event events;
+	struct kernel_poll_channels channels = { 0 };
 
 	DBG("[thread] Thread manage kernel started");
 
+	rcu_register_thread();
+
 	health_register(health_sessiond, HEALTH_SESSIOND_TYPE_KERNEL);
 
 	/*
@@ -1124,7 +1255,7 @@ static void *thread_manage_kernel(void *data)
 			}
 
 			/* This will add the available kernel channel if any. */
-			ret = update_kernel_poll(&events);
+			ret = update_kernel_poll(&events, &channels);
 			if (ret < 0) {
 				goto error;
 			}
@@ -1192,7 +1323,8 @@ static void *thread_manage_kernel(void *data)
 					 * New CPU detected by the kernel. Adding kernel stream to
 					 * kernel session and updating the kernel consumer
 					 */
-					ret = update_kernel_stream(&kconsumer_data, pollfd);
+					ret = update_kernel_stream(&kconsumer_data,
+							pollfd, &channels);
 					if (ret < 0) {
 						continue;
 					}
@@ -1221,7 +1353,9 @@ error_testpoint:
 		WARN("Kernel thread died unexpectedly. "
 				"Kernel tracing can continue but CPU hotplug is disabled.");
 	}
+	free(channels.entries);
 	health_unregister(health_sessiond);
+	rcu_unregister_thread();
 	DBG("Kernel thread dying");
 	return NULL;
 }
@@ -1617,6 +1751,9 @@ static void *thread_manage_apps(void *data)
 	ssize_t size_ret;
 	uint32_t revents, nb_fd;
 	struct lttng_poll_event events;
+	/* Sockets of the exited apps, unregistered together. */
+	int unregister_socks[DEFAULT_APP_UNREGISTER_BATCH];
+	unsigned int nr_unregister = 0;
 
 	DBG("[thread] Manage application started");
 
@@ -1733,7 +1870,12 @@ static void *thread_manage_apps(void *data)
 					}
 
 					/* Socket closed on remote end. */
-					ust_app_unregister(pollfd);
+					unregister_socks[nr_unregister++] = pollfd;
+					if (nr_unregister == DEFAULT_APP_UNREGISTER_BATCH) {
+						ust_app_unregister_batch(unregister_socks,
+								nr_unregister);
+						nr_unregister = 0;
+					}
 				} else {
 					ERR("Unexpected poll events %u for sock %d", revents, pollfd);
 					goto error;
@@ -1742,10 +1884,14 @@ static void *thread_manage_apps(void *data)
 
 			health_code_update();
 		}
+
+		ust_app_unregister_batch(unregister_socks, nr_unregister);
+		nr_unregister = 0;
 	}
 
 exit:
 error:
+	ust_app_unregister_batch(unregister_socks, nr_unregister);
 	lttng_poll_clean(&events);
 error_poll_create:
 error_testpoint:
@@ -1906,6 +2052,159 @@ error_create:
 	return;
 }
 
+/*
+ * Account a command dequeued from the UST registration queue.
+ */
+static void ust_cmd_queue_account(struct ust_command *ust_cmd)
+{
+	uint64_t wait_ns, now_ns = lttng_monotonic_time_ns();
+	unsigned long depth;
+	struct ust_cmd_queue_stats *stats = &ust_cmd_queue.stats;
+
+	/* Depth of the queue before the dequeue. */
+	depth = uatomic_sub_return(&ust_cmd_queue.depth, 1) + 1;
+	if (depth > stats->max_depth) {
+		stats->max_depth = depth;
+	}
+	stats->dequeued++;
+	if (!now_ns || !ust_cmd->enqueue_ns || now_ns < ust_cmd->enqueue_ns) {
+		return;
+	}
+	wait_ns = now_ns - ust_cmd->enqueue_ns;
+	stats->total_wait_ns += wait_ns;
+	if (wait_ns > stats->max_wait_ns) {
+		stats->max_wait_ns = wait_ns;
+	}
+}
+
+static void ust_cmd_queue_log_stats(void)
+{
+	struct ust_cmd_queue_stats *stats = &ust_cmd_queue.stats;
+
+	DBG("UST registration queue: depth %lu (max %lu), %" PRIu64
+			" dequeued, %" PRIu64 " re-registered, time in queue avg %"
+			PRIu64 " us max %" PRIu64 " us",
+			uatomic_read(&ust_cmd_queue.depth), stats->max_depth,
+			stats->dequeued, stats->reregistered,
+			(uint64_t) (stats->dequeued ? stats->total_wait_ns /
+				stats->dequeued / NSEC_PER_USEC : 0),
+			(uint64_t) (stats->max_wait_ns / NSEC_PER_USEC));
+}
+
+/*
+ * Return 1 if an application is registered again while its previous
+ * registration is still known, for instance after its registration timed
+ * out on the application side.
+ */
+static int ust_app_is_reregistration(struct ust_app *app)
+{
+	int ret;
+
+	rcu_read_lock();
+	ret = ust_app_find_by_pid(app->pid) != NULL;
+	rcu_read_unlock();
+	return ret;
+}
+
+/*
+ * Update a newly registered application with the tracing registry info
+ * already enabled information. Called from the application update pool.
+ */
+static int update_registered_app(struct ust_app *app, void *data)
+{
+	self_tracepoint(sessiond_app_update_begin, app->pid);
+	update_ust_app(app->sock);
+
+	/*
+	 * Don't care about return value. Let the manage apps threads
+	 * handle app unregistration upon socket close.
+	 */
+	(void) ust_app_register_done(app);
+	return 0;
+}
+
+static int ust_consumerd_is_lazy(int bits);
+static void start_lazy_ust_consumerd(int bits);
+
+/*
+ * Register a batch of applications whose notify socket is set, updating them
+ * concurrently on the application update pool.
+ *
+ * Return 0 on success or else a negative value if the notify or apps thread
+ * is gone.
+ */
+static int register_ust_apps(struct ust_app **apps, unsigned int nr_apps)
+{
+	int ret = 0;
+	unsigned int i;
+
+	if (!nr_apps) {
+		goto end;
+	}
+
+	/*
+	 * The consumer daemon of the bitness of the applications must be
+	 * there before they are updated with the started sessions.
+	 */
+	for (i = 0; i < nr_apps; i++) {
+		if (ust_consumerd_is_lazy(apps[i]->bits_per_long)) {
+			start_lazy_ust_consumerd(apps[i]->bits_per_long);
+		}
+	}
+
+	/*
+	 * The session list lock is not held: a command can see the
+	 * applications before their registration is done, but each session
+	 * is updated with its lock held, which the commands changing the
+	 * session hold as well. A session destroyed meanwhile is skipped.
+	 */
+	rcu_read_lock();
+
+	for (i = 0; i < nr_apps; i++) {
+		struct ust_app *app = apps[i];
+
+		/*
+		 * Add application to the global hash table. This needs to be
+		 * done before the update to the UST registry can locate the
+		 * application.
+		 */
+		ust_app_add(app);
+
+		/* Set app version. This call will print an error if needed. */
+		(void) ust_app_version(app);
+
+		/*
+		 * Send notify socket through the notify pipe of the thread
+		 * handling the notifications of the application.
+		 */
+		ret = send_socket_to_thread(apps_cmd_notify_pipe[
+				(unsigned int) app->pid % opt_app_notify_threads][1],
+				app->notify_sock);
+		if (ret < 0) {
+			goto unlock;
+		}
+	}
+
+	(void) app_update_pool_run(apps, nr_apps, update_registered_app, NULL);
+
+	for (i = 0; i < nr_apps; i++) {
+		/*
+		 * Even if the application socket has been closed, send the app
+		 * to the thread and unregistration will take place at that
+		 * place.
+		 */
+		ret = send_socket_to_thread(apps_cmd_pipe[1], apps[i]->sock);
+		if (ret < 0) {
+			goto unlock;
+		}
+	}
+
+unlock:
+	rcu_read_unlock();
+end:
+	return ret;
+}
+
 /*
  * Dispatch request from the registration threads to the application
  * communication thread.
@@ -1919,6 +2218,9 @@ static void *thread_dispatch_ust_registration(void *data)
 	struct ust_reg_wait_queue wait_queue = {
 		.count = 0,
 	};
+	/* Applications ready to be registered. */
+	struct ust_app *batch[DEFAULT_APP_UPDATE_BATCH];
+	unsigned int nr_batch = 0, nr_dequeued;
 
 	rcu_register_thread();
 
@@ -1944,6 +2246,7 @@ static void *thread_dispatch_ust_registration(void *data)
 			break;
 		}
 
+		nr_dequeued = 0;
 		do {
 			struct ust_app *app = NULL;
 			ust_cmd = NULL;
@@ -1951,9 +2254,13 @@ static void *thread_dispatch_ust_registration(void *data)
 			/*
 			 * Make sure we don't have node(s) that have hung up before receiving
 			 * the notify socket. This is to clean the list in order to avoid
-			 * memory leaks from notify socket that are never seen.
+			 * memory leaks from notify socket that are never seen. Polling the
+			 * whole wait queue is linear in its size, so it is only done once
+			 * per batch of commands during a registration storm.
 			 */
-			sanitize_wait_queue(&wait_queue);
+			if (!(nr_dequeued % DEFAULT_APP_UPDATE_BATCH)) {
+				sanitize_wait_queue(&wait_queue);
+			}
 
 			health_code_update();
 			/* Dequeue command for registration */
@@ -1963,8 +2270,10 @@ static void *thread_dispatch_ust_registration(void *data)
 				/* Continue thread execution */
 				break;
 			}
+			nr_dequeued++;
 
 			ust_cmd = caa_container_of(node, struct ust_command, node);
+			ust_cmd_queue_account(ust_cmd);
 
 			DBG("Dispatching UST registration pid:%d ppid:%d uid:%d"
 					" gid:%d sock:%d name:%s (version %d.%d)",
@@ -2049,76 +2358,52 @@ static void *thread_dispatch_ust_registration(void *data)
 			}
 
 			if (app) {
-				/*
-				 * @session_lock_list
-				 *
-				 * Lock the global session list so from the register up to the
-				 * registration done message, no thread can see the application
-				 * and change its state.
-				 */
-				session_lock_list();
-				rcu_read_lock();
-
-				/*
-				 * Add application to the global hash table. This needs to be
-				 * done before the update to the UST registry can locate the
-				 * application.
-				 */
-				ust_app_add(app);
+				int rereg = ust_app_is_reregistration(app);
 
-				/* Set app version. This call will print an error if needed. */
-				(void) ust_app_version(app);
-
-				/* Send notify socket through the notify pipe. */
-				ret = send_socket_to_thread(apps_cmd_notify_pipe[1],
-						app->notify_sock);
-				if (ret < 0) {
-					rcu_read_unlock();
-					session_unlock_list();
+				if (rereg) {
 					/*
-					 * No notify thread, stop the UST tracing. However, this is
-					 * not an internal error of the this thread thus setting
-					 * the health error code to a normal exit.
+					 * The application already waited for a previous
+					 * registration: register it first, right away.
 					 */
-					err = 0;
-					goto error;
+					ust_cmd_queue.stats.reregistered++;
+					if (nr_batch) {
+						batch[nr_batch] = batch[0];
+					}
+					batch[0] = app;
+					nr_batch++;
+				} else {
+					batch[nr_batch++] = app;
 				}
-
-				/*
-				 * Update newly registered application with the tracing
-				 * registry info already enabled information.
-				 */
-				update_ust_app(app->sock);
-
-				/*
-				 * Don't care about return value. Let the manage apps threads
-				 * handle app unregistration upon socket close.
-				 */
-				(void) ust_app_register_done(app);
-
-				/*
-				 * Even if the application socket has been closed, send the app
-				 * to the thread and unregistration will take place at that
-				 * place.
-				 */
-				ret = send_socket_to_thread(apps_cmd_pipe[1], app->sock);
+				if (!rereg && nr_batch < DEFAULT_APP_UPDATE_BATCH) {
+					continue;
+				}
+				ret = register_ust_apps(batch, nr_batch);
+				nr_batch = 0;
 				if (ret < 0) {
-					rcu_read_unlock();
-					session_unlock_list();
 					/*
-					 * No apps. thread, stop the UST tracing. However, this is
-					 * not an internal error of the this thread thus setting
-					 * the health error code to a normal exit.
+					 * No notify or apps. thread, stop the UST tracing.
+					 * However, this is not an internal error of the this
+					 * thread thus setting the health error code to a
+					 * normal exit.
 					 */
 					err = 0;
 					goto error;
 				}
-
-				rcu_read_unlock();
-				session_unlock_list();
 			}
 		} while (node != NULL);
 
+		/* Register the applications dequeued so far. */
+		ret = register_ust_apps(batch, nr_batch);
+		nr_batch = 0;
+		if (ret < 0) {
+			/* See above. */
+			err = 0;
+			goto error;
+		}
+		if (nr_dequeued) {
+			ust_cmd_queue_log_stats();
+		}
+
 		health_poll_entry();
 		/* Futex wait on queue. Blocking call on futex() */
 		futex_nto1_wait(&ust_cmd_queue.futex);
@@ -2323,6 +2608,8 @@ static void *thread_registration_apps(void *data)
 					health_code_update();
 
 					ust_cmd->sock = sock;
+					ust_cmd->enqueue_ns =
+						lttng_monotonic_time_ns();
 					sock = -1;
 
 					DBG("UST registration received with pid:%d ppid:%d uid:%d"
@@ -2336,6 +2623,7 @@ static void *thread_registration_apps(void *data)
 					 * Lock free enqueue the registration request. The red pill
 					 * has been taken! This apps will be part of the *system*.
 					 */
+					uatomic_inc(&ust_cmd_queue.depth);
 					cds_wfcq_enqueue(&ust_cmd_queue.head, &ust_cmd_queue.tail, &ust_cmd->node);
 
 					/*
@@ -2766,65 +3054,229 @@ error:
 }
 
 /*
- * Setup necessary data for kernel tracer action.
+ * Start the kernel consumer daemon if it is not running yet.
+ *
+ * Return 0 on success or else a negative value.
  */
-static int init_kernel_tracer(void)
+static int start_kernel_consumerd(void)
 {
-	int ret;
+	int ret = 0;
 
-	/* Modprobe lttng kernel modules */
-	ret = modprobe_lttng_control();
-	if (ret < 0) {
-		goto error;
+	pthread_mutex_lock(&consumerd_start_lock);
+	pthread_mutex_lock(&kconsumer_data.pid_mutex);
+	if (kconsumer_data.pid != 0) {
+		pthread_mutex_unlock(&kconsumer_data.pid_mutex);
+		goto end;
 	}
+	pthread_mutex_unlock(&kconsumer_data.pid_mutex);
 
-	/* Open debugfs lttng */
-	kernel_tracer_fd = open(module_proc_lttng, O_RDWR);
-	if (kernel_tracer_fd < 0) {
-		DBG("Failed to open %s", module_proc_lttng);
-		ret = -1;
-		goto error_open;
+	ret = start_consumerd(&kconsumer_data);
+	if (ret < 0) {
+		goto end;
 	}
+	uatomic_set(&kernel_consumerd_state, CONSUMER_STARTED);
+end:
+	pthread_mutex_unlock(&consumerd_start_lock);
+	return ret;
+}
 
-	/* Validate kernel version */
-	ret = kernel_validate_version(kernel_tracer_fd);
-	if (ret < 0) {
-		goto error_version;
+/*
+ * Start the UST consumer daemon of bitness "bits" if it is available and not
+ * running yet.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static int start_ust_consumerd(int bits)
+{
+	int ret = 0;
+	struct consumer_data *consumer_data;
+	const char *bin;
+	int *consumerd_fd;
+
+	if (bits == 32) {
+		consumer_data = &ustconsumer32_data;
+		bin = consumerd32_bin;
+		consumerd_fd = &ust_consumerd32_fd;
+	} else {
+		consumer_data = &ustconsumer64_data;
+		bin = consumerd64_bin;
+		consumerd_fd = &ust_consumerd64_fd;
 	}
 
-	ret = modprobe_lttng_data();
-	if (ret < 0) {
-		goto error_modules;
+	pthread_mutex_lock(&consumerd_start_lock);
+	pthread_mutex_lock(&consumer_data->pid_mutex);
+	if (bin[0] == '\0' || consumer_data->pid != 0) {
+		pthread_mutex_unlock(&consumer_data->pid_mutex);
+		goto end;
 	}
+	pthread_mutex_unlock(&consumer_data->pid_mutex);
 
-	ret = kernel_supports_ring_buffer_snapshot_sample_positions(
-			kernel_tracer_fd);
+	ret = start_consumerd(consumer_data);
 	if (ret < 0) {
-		goto error_modules;
+		uatomic_set(consumerd_fd, -EINVAL);
+		goto end;
 	}
+	uatomic_set(consumerd_fd, consumer_data->cmd_sock);
+	uatomic_set(&ust_consumerd_state, CONSUMER_STARTED);
+end:
+	pthread_mutex_unlock(&consumerd_start_lock);
+	return ret;
+}
 
-	if (ret < 1) {
-		WARN("Kernel tracer does not support buffer monitoring. "
-			"The monitoring timer of channels in the kernel domain "
-			"will be set to 0 (disabled).");
-	}
+/*
+ * Return 1 if the UST consumer daemon of bitness "bits" is only started
+ * when the first application of that bitness registers: with
+ * --lazy-consumerd, for the bitness differing from the session daemon's, as
+ * long as the consumer daemon of the session daemon's bitness is available
+ * to start the user space sessions.
+ */
+static int ust_consumerd_is_lazy(int bits)
+{
+	const char *native_bin = CAA_BITS_PER_LONG == 32 ?
+			consumerd32_bin : consumerd64_bin;
 
-	DBG("Kernel tracer fd %d", kernel_tracer_fd);
-	return 0;
+	return opt_lazy_consumerd && bits != CAA_BITS_PER_LONG &&
+			native_bin[0] != '\0';
+}
 
-error_version:
-	modprobe_remove_lttng_control();
-	ret = close(kernel_tracer_fd);
+/*
+ * Start the lazily started UST consumer daemon of the bitness of registering
+ * applications and add it to the consumer output of every user space
+ * session, as the client commands do for the consumer daemons they start.
+ */
+static void start_lazy_ust_consumerd(int bits)
+{
+	int ret;
+	struct ltt_session *sess;
+	struct ltt_session_list_iter iter = SESSION_LIST_ITER_INIT;
+	struct consumer_data *consumer_data = bits == 32 ?
+			&ustconsumer32_data : &ustconsumer64_data;
+
+	pthread_mutex_lock(&consumer_data->pid_mutex);
+	ret = consumer_data->pid != 0;
+	pthread_mutex_unlock(&consumer_data->pid_mutex);
 	if (ret) {
-		PERROR("close");
+		return;
 	}
-	kernel_tracer_fd = -1;
-	return LTTNG_ERR_KERN_VERSION;
 
-error_modules:
-	ret = close(kernel_tracer_fd);
-	if (ret) {
-		PERROR("close");
+	DBG("Starting the %d-bit UST consumer daemon for its first application",
+			bits);
+	ret = start_ust_consumerd(bits);
+	if (ret < 0) {
+		ERR("Failed to start the %d-bit UST consumer daemon", bits);
+		return;
+	}
+
+	while ((sess = session_lock_next_alive(&iter))) {
+		if (sess->ust_session) {
+			ret = consumer_create_socket(consumer_data,
+					sess->ust_session->consumer);
+			if (ret < 0) {
+				ERR("Failed to add the %d-bit UST consumer daemon to session %s",
+						bits, sess->name);
+			}
+		}
+		session_unlock(sess);
+	}
+}
+
+/*
+ * With --consumerd-prefork, start the consumer daemons of every available
+ * domain when the session daemon starts, so that the first start of a
+ * tracing session does not wait for them.
+ */
+static void prefork_consumerds(void)
+{
+	int ret;
+
+	/* With --async-init, the kernel initialization thread starts it. */
+	if (is_root && !opt_async_init && kernel_tracer_fd >= 0) {
+		ret = start_kernel_consumerd();
+		if (ret < 0) {
+			ERR("Failed to pre-fork the kernel consumer daemon");
+		}
+	}
+	if (!ust_app_supported()) {
+		return;
+	}
+	if (!ust_consumerd_is_lazy(64)) {
+		ret = start_ust_consumerd(64);
+		if (ret < 0) {
+			ERR("Failed to pre-fork the 64-bit UST consumer daemon");
+		}
+	}
+	if (!ust_consumerd_is_lazy(32)) {
+		ret = start_ust_consumerd(32);
+		if (ret < 0) {
+			ERR("Failed to pre-fork the 32-bit UST consumer daemon");
+		}
+	}
+}
+
+/*
+ * Setup necessary data for kernel tracer action.
+ */
+static int init_kernel_tracer(void)
+{
+	int ret;
+
+	/* Modprobe lttng kernel modules */
+	ret = modprobe_lttng_control();
+	if (ret < 0) {
+		goto error;
+	}
+
+	/* Open debugfs lttng */
+	kernel_tracer_fd = open(module_proc_lttng, O_RDWR);
+	if (kernel_tracer_fd < 0) {
+		DBG("Failed to open %s", module_proc_lttng);
+		ret = -1;
+		goto error_open;
+	}
+
+	/* Validate kernel version */
+	ret = kernel_validate_version(kernel_tracer_fd);
+	if (ret < 0) {
+		goto error_version;
+	}
+
+	if (opt_lazy_kmod_probes) {
+		modprobe_lttng_data_defer();
+	} else {
+		ret = modprobe_lttng_data();
+		if (ret < 0) {
+			goto error_modules;
+		}
+	}
+
+	ret = kernel_supports_ring_buffer_snapshot_sample_positions(
+			kernel_tracer_fd);
+	if (ret < 0) {
+		goto error_modules;
+	}
+
+	if (ret < 1) {
+		WARN("Kernel tracer does not support buffer monitoring. "
+			"The monitoring timer of channels in the kernel domain "
+			"will be set to 0 (disabled).");
+	}
+
+	DBG("Kernel tracer fd %d", kernel_tracer_fd);
+	return 0;
+
+error_version:
+	modprobe_remove_lttng_control();
+	ret = close(kernel_tracer_fd);
+	if (ret) {
+		PERROR("close");
+	}
+	kernel_tracer_fd = -1;
+	return LTTNG_ERR_KERN_VERSION;
+
+error_modules:
+	ret = close(kernel_tracer_fd);
+	if (ret) {
+		PERROR("close");
 	}
 
 error_open:
@@ -2840,6 +3292,60 @@ error:
 	}
 }
 
+/*
+ * Load the kernel tracer modules and populate the system call table.
+ */
+static void init_kernel_subsystem(void)
+{
+	int ret;
+
+	init_kernel_tracer();
+	if (kernel_tracer_fd >= 0) {
+		ret = syscall_init_table();
+		if (ret < 0) {
+			ERR("Unable to populate syscall table. "
+				"Syscall tracing won't work "
+				"for this session daemon.");
+		}
+	}
+}
+
+/*
+ * With --async-init, this thread initializes the kernel tracer while the
+ * client thread already accepts commands, and then wakes up the kernel
+ * commands waiting for it.
+ */
+static void *thread_init_kernel(void *data)
+{
+	DBG("[kernel-init-thread] Initializing the kernel tracer");
+
+	init_kernel_subsystem();
+	if (opt_consumerd_prefork && kernel_tracer_fd >= 0) {
+		if (start_kernel_consumerd() < 0) {
+			ERR("Failed to pre-fork the kernel consumer daemon");
+		}
+	}
+
+	pthread_mutex_lock(&kernel_init_lock);
+	kernel_init_done = 1;
+	pthread_cond_broadcast(&kernel_init_cond);
+	pthread_mutex_unlock(&kernel_init_lock);
+
+	DBG("[kernel-init-thread] Kernel tracer subsystem ready");
+	return NULL;
+}
+
+/*
+ * Wait for the background initialization of the kernel tracer, if any.
+ */
+static void wait_kernel_init(void)
+{
+	pthread_mutex_lock(&kernel_init_lock);
+	while (!kernel_init_done) {
+		pthread_cond_wait(&kernel_init_cond, &kernel_init_lock);
+	}
+	pthread_mutex_unlock(&kernel_init_lock);
+}
 
 /*
  * Copy consumer output from the tracing session to the domain session. The
@@ -3023,6 +3529,8 @@ error:
 
 /*
  * Count number of session permitted by uid/gid.
+ *
+ * The session list lock is not held: the list is iterated lock-free.
  */
 static unsigned int lttng_sessions_count(uid_t uid, gid_t gid)
 {
@@ -3031,7 +3539,8 @@ static unsigned int lttng_sessions_count(uid_t uid, gid_t gid)
 
 	DBG("Counting number of available session for UID %d GID %d",
 			uid, gid);
-	cds_list_for_each_entry(session, &session_list_ptr->head, list) {
+	rcu_read_lock();
+	cds_list_for_each_entry_rcu(session, &session_list_ptr->head, list) {
 		/*
 		 * Only list the sessions the user can control.
 		 */
@@ -3040,9 +3549,139 @@ static unsigned int lttng_sessions_count(uid_t uid, gid_t gid)
 		}
 		i++;
 	}
+	rcu_read_unlock();
 	return i;
 }
 
+/*
+ * Return 1 if a client command only reads the state of the session daemon.
+ */
+static int client_cmd_is_read_only(enum lttcomm_sessiond_command cmd)
+{
+	switch (cmd) {
+	case LTTNG_LIST_SESSIONS:
+	case LTTNG_LIST_DOMAINS:
+	case LTTNG_LIST_CHANNELS:
+	case LTTNG_LIST_STREAM_STATS:
+	case LTTNG_LIST_MEMORY_USAGE:
+	case LTTNG_LIST_EVENTS:
+	case LTTNG_LIST_TRACEPOINTS:
+	case LTTNG_LIST_TRACEPOINT_FIELDS:
+	case LTTNG_LIST_SYSCALLS:
+	case LTTNG_LIST_TRACKER_PIDS:
+	case LTTNG_SNAPSHOT_LIST_OUTPUT:
+	case LTTNG_PERSISTENT_CONNECTION:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Return 1 if a client command can run for long. Such a command releases the
+ * session list lock once it holds the lock of its session, so that the
+ * commands on the other sessions are not serialized behind it. It MUST NOT
+ * acquire the session list lock nor access another session.
+ */
+static int client_cmd_is_long(enum lttcomm_sessiond_command cmd)
+{
+	switch (cmd) {
+	case LTTNG_START_TRACE:
+	case LTTNG_STOP_TRACE:
+	case LTTNG_DATA_PENDING:
+	case LTTNG_SNAPSHOT_RECORD:
+	case LTTNG_REGENERATE_STATEDUMP:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Return the size of the variable-length payload sent by the client after the
+ * message of a command.
+ */
+static size_t client_cmd_payload_size(const struct lttcomm_session_msg *lsm)
+{
+	switch (lsm->cmd_type) {
+	case LTTNG_ADD_CONTEXT:
+		if (lsm->u.context.ctx.ctx != LTTNG_EVENT_CONTEXT_APP_CONTEXT) {
+			return 0;
+		}
+		return (size_t) lsm->u.context.provider_name_len +
+				lsm->u.context.context_name_len;
+	case LTTNG_DISABLE_EVENT:
+		return (size_t) lsm->u.disable.expression_len +
+				lsm->u.disable.bytecode_len;
+	case LTTNG_ENABLE_EVENT:
+		return (size_t) lsm->u.enable.exclusion_count *
+				LTTNG_SYMBOL_NAME_LEN +
+				lsm->u.enable.expression_len +
+				lsm->u.enable.bytecode_len;
+	case LTTNG_TRACK_PID_RANGES:
+	case LTTNG_UNTRACK_PID_RANGES:
+		return (size_t) lsm->u.pid_ranges.nb_ranges *
+				sizeof(struct lttng_pid_range);
+	case LTTNG_SET_CONSUMER_URI:
+	case LTTNG_CREATE_SESSION:
+	case LTTNG_CREATE_SESSION_SNAPSHOT:
+	case LTTNG_CREATE_SESSION_LIVE:
+		return (size_t) lsm->u.uri.size * sizeof(struct lttng_uri);
+	case LTTNG_REGISTER_TRIGGER:
+	case LTTNG_UNREGISTER_TRIGGER:
+		return lsm->u.trigger.length;
+	case LTTNG_LOAD_SESSION_DEFINITION:
+		return lsm->u.load_definition.size;
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Receive "len" bytes of the payload of a client command.
+ *
+ * Return the size received, 0 on an orderly shutdown or else a negative value.
+ */
+static ssize_t recv_client_payload(struct command_ctx *cmd_ctx, int sock,
+		void *buf, size_t len)
+{
+	ssize_t ret;
+
+	ret = lttcomm_recv_unix_sock(sock, buf, len);
+	if (ret > 0) {
+		assert((size_t) ret <= cmd_ctx->payload_left);
+		cmd_ctx->payload_left -= ret;
+	}
+	return ret;
+}
+
+/*
+ * Receive and discard the payload of a client command which was not read, so
+ * that the next command of a persistent connection is read from the start of
+ * its message.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static int drain_client_payload(struct command_ctx *cmd_ctx, int sock)
+{
+	char data[LTTNG_FILTER_MAX_LEN];
+
+	if (cmd_ctx->payload_left) {
+		DBG("Discarding client command payload of size %zu",
+				cmd_ctx->payload_left);
+	}
+	while (cmd_ctx->payload_left) {
+		ssize_t ret;
+
+		ret = recv_client_payload(cmd_ctx, sock, data,
+				min(sizeof(data), cmd_ctx->payload_left));
+		if (ret <= 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
 /*
  * Process the command requested by the lttng client within the command
  * context structure. This function make sure that the return structure (llm)
@@ -3060,6 +3699,7 @@ static int process_client_msg(struct command_ctx *cmd_ctx, int sock,
 	int ret = LTTNG_OK;
 	int need_tracing_session = 1;
 	int need_domain;
+	int list_locked = 0;
 
 	DBG("Processing client command %d", cmd_ctx->lsm->cmd_type);
 
@@ -3085,8 +3725,11 @@ static int process_client_msg(struct command_ctx *cmd_ctx, int sock,
 	case LTTNG_SET_SESSION_SHM_PATH:
 	case LTTNG_REGENERATE_METADATA:
 	case LTTNG_REGENERATE_STATEDUMP:
+	case LTTNG_ROTATE_SESSION:
 	case LTTNG_REGISTER_TRIGGER:
 	case LTTNG_UNREGISTER_TRIGGER:
+	case LTTNG_LOAD_SESSION_DEFINITION:
+	case LTTNG_PERSISTENT_CONNECTION:
 		need_domain = 0;
 		break;
 	default:
@@ -3125,10 +3768,13 @@ static int process_client_msg(struct command_ctx *cmd_ctx, int sock,
 	case LTTNG_LIST_TRACEPOINT_FIELDS:
 	case LTTNG_LIST_DOMAINS:
 	case LTTNG_LIST_CHANNELS:
+	case LTTNG_LIST_STREAM_STATS:
+	case LTTNG_LIST_MEMORY_USAGE:
 	case LTTNG_LIST_EVENTS:
 	case LTTNG_LIST_SYSCALLS:
 	case LTTNG_LIST_TRACKER_PIDS:
 	case LTTNG_DATA_PENDING:
+	case LTTNG_ROTATE_SESSION:
 		break;
 	default:
 		/* Setup lttng message with no payload */
@@ -3151,23 +3797,43 @@ static int process_client_msg(struct command_ctx *cmd_ctx, int sock,
 	case LTTNG_SAVE_SESSION:
 	case LTTNG_REGISTER_TRIGGER:
 	case LTTNG_UNREGISTER_TRIGGER:
+	case LTTNG_LOAD_SESSION_DEFINITION:
+	case LTTNG_PERSISTENT_CONNECTION:
 		need_tracing_session = 0;
 		break;
 	default:
 		DBG("Getting session %s by name", cmd_ctx->lsm->session.name);
+		if (client_cmd_is_read_only(cmd_ctx->lsm->cmd_type)) {
+			/* The lookup and lock of the session are lock-free. */
+			cmd_ctx->session = session_lock_by_name(
+					cmd_ctx->lsm->session.name);
+			if (cmd_ctx->session == NULL) {
+				ret = LTTNG_ERR_SESS_NOT_FOUND;
+				goto error;
+			}
+			break;
+		}
 		/*
-		 * We keep the session list lock across _all_ commands
-		 * for now, because the per-session lock does not
-		 * handle teardown properly.
+		 * We keep the session list lock across the commands
+		 * changing a session for now, to serialize them.
 		 */
 		session_lock_list();
+		list_locked = 1;
 		cmd_ctx->session = session_find_by_name(cmd_ctx->lsm->session.name);
-		if (cmd_ctx->session == NULL) {
+		if (cmd_ctx->session == NULL ||
+				!session_lock_alive(cmd_ctx->session)) {
+			/* Not found or not created yet. */
+			cmd_ctx->session = NULL;
 			ret = LTTNG_ERR_SESS_NOT_FOUND;
 			goto error;
-		} else {
-			/* Acquire lock for the session */
-			session_lock(cmd_ctx->session);
+		}
+		/*
+		 * The session can't be destroyed while its lock is held: the
+		 * destroy command acquires it with the session list lock.
+		 */
+		if (client_cmd_is_long(cmd_ctx->lsm->cmd_type)) {
+			session_unlock_list();
+			list_locked = 0;
 		}
 		break;
 	}
@@ -3219,6 +3885,8 @@ static int process_client_msg(struct command_ctx *cmd_ctx, int sock,
 			goto error;
 		}
 
+		wait_kernel_init();
+
 		/* Kernel tracer check */
 		if (kernel_tracer_fd == -1) {
 			/* Basically, load kernel tracer modules */
@@ -3245,18 +3913,12 @@ static int process_client_msg(struct command_ctx *cmd_ctx, int sock,
 			}
 
 			/* Start the kernel consumer daemon */
-			pthread_mutex_lock(&kconsumer_data.pid_mutex);
-			if (kconsumer_data.pid == 0 &&
-					cmd_ctx->lsm->cmd_type != LTTNG_REGISTER_CONSUMER) {
-				pthread_mutex_unlock(&kconsumer_data.pid_mutex);
-				ret = start_consumerd(&kconsumer_data);
+			if (cmd_ctx->lsm->cmd_type != LTTNG_REGISTER_CONSUMER) {
+				ret = start_kernel_consumerd();
 				if (ret < 0) {
 					ret = LTTNG_ERR_KERN_CONSUMER_FAIL;
 					goto error;
 				}
-				uatomic_set(&kernel_consumerd_state, CONSUMER_STARTED);
-			} else {
-				pthread_mutex_unlock(&kconsumer_data.pid_mutex);
 			}
 
 			/*
@@ -3296,24 +3958,19 @@ static int process_client_msg(struct command_ctx *cmd_ctx, int sock,
 				}
 			}
 
-			/* Start the UST consumer daemons */
+			/*
+			 * Start the UST consumer daemons. With --lazy-consumerd,
+			 * the one of the foreign bitness is started by the
+			 * registration of its first application instead.
+			 */
 			/* 64-bit */
-			pthread_mutex_lock(&ustconsumer64_data.pid_mutex);
-			if (consumerd64_bin[0] != '\0' &&
-					ustconsumer64_data.pid == 0 &&
-					cmd_ctx->lsm->cmd_type != LTTNG_REGISTER_CONSUMER) {
-				pthread_mutex_unlock(&ustconsumer64_data.pid_mutex);
-				ret = start_consumerd(&ustconsumer64_data);
+			if (cmd_ctx->lsm->cmd_type != LTTNG_REGISTER_CONSUMER &&
+					!ust_consumerd_is_lazy(64)) {
+				ret = start_ust_consumerd(64);
 				if (ret < 0) {
 					ret = LTTNG_ERR_UST_CONSUMER64_FAIL;
-					uatomic_set(&ust_consumerd64_fd, -EINVAL);
 					goto error;
 				}
-
-				uatomic_set(&ust_consumerd64_fd, ustconsumer64_data.cmd_sock);
-				uatomic_set(&ust_consumerd_state, CONSUMER_STARTED);
-			} else {
-				pthread_mutex_unlock(&ustconsumer64_data.pid_mutex);
 			}
 
 			/*
@@ -3327,22 +3984,13 @@ static int process_client_msg(struct command_ctx *cmd_ctx, int sock,
 			}
 
 			/* 32-bit */
-			pthread_mutex_lock(&ustconsumer32_data.pid_mutex);
-			if (consumerd32_bin[0] != '\0' &&
-					ustconsumer32_data.pid == 0 &&
-					cmd_ctx->lsm->cmd_type != LTTNG_REGISTER_CONSUMER) {
-				pthread_mutex_unlock(&ustconsumer32_data.pid_mutex);
-				ret = start_consumerd(&ustconsumer32_data);
+			if (cmd_ctx->lsm->cmd_type != LTTNG_REGISTER_CONSUMER &&
+					!ust_consumerd_is_lazy(32)) {
+				ret = start_ust_consumerd(32);
 				if (ret < 0) {
 					ret = LTTNG_ERR_UST_CONSUMER32_FAIL;
-					uatomic_set(&ust_consumerd32_fd, -EINVAL);
 					goto error;
 				}
-
-				uatomic_set(&ust_consumerd32_fd, ustconsumer32_data.cmd_sock);
-				uatomic_set(&ust_consumerd_state, CONSUMER_STARTED);
-			} else {
-				pthread_mutex_unlock(&ustconsumer32_data.pid_mutex);
 			}
 
 			/*
@@ -3458,13 +4106,13 @@ skip_domain:
 			cmd_ctx->lsm->u.context.ctx.u.app_ctx.ctx_name =
 					context_name;
 
-			ret = lttcomm_recv_unix_sock(sock, provider_name,
+			ret = recv_client_payload(cmd_ctx, sock, provider_name,
 					provider_name_len);
 			if (ret < 0) {
 				goto error_add_context;
 			}
 
-			ret = lttcomm_recv_unix_sock(sock, context_name,
+			ret = recv_client_payload(cmd_ctx, sock, context_name,
 					context_name_len);
 			if (ret < 0) {
 				goto error_add_context;
@@ -3509,22 +4157,9 @@ error_add_context:
 		 * the filter payload and encounter an error because the session
 		 * daemon closes the socket without ever handling this data.
 		 */
-		size_t count = cmd_ctx->lsm->u.disable.expression_len +
-			cmd_ctx->lsm->u.disable.bytecode_len;
-
-		if (count) {
-			char data[LTTNG_FILTER_MAX_LEN];
-
-			DBG("Discarding disable event command payload of size %zu", count);
-			while (count) {
-				ret = lttcomm_recv_unix_sock(sock, data,
-				        count > sizeof(data) ? sizeof(data) : count);
-				if (ret < 0) {
-					goto error;
-				}
-
-				count -= (size_t) ret;
-			}
+		ret = drain_client_payload(cmd_ctx, sock);
+		if (ret < 0) {
+			goto error;
 		}
 		/* FIXME: passing packed structure to non-packed pointer */
 		ret = cmd_disable_event(cmd_ctx->session, cmd_ctx->lsm->domain.type,
@@ -3555,6 +4190,45 @@ error_add_context:
 				cmd_ctx->lsm->u.pid_tracker.pid);
 		break;
 	}
+	case LTTNG_TRACK_PID_RANGES:
+	case LTTNG_UNTRACK_PID_RANGES:
+	{
+		struct lttng_pid_range *ranges;
+		size_t nb_ranges = cmd_ctx->lsm->u.pid_ranges.nb_ranges;
+
+		if (!nb_ranges || nb_ranges > LTTNG_PID_RANGES_MAX) {
+			ret = LTTNG_ERR_INVALID;
+			goto error;
+		}
+		ranges = zmalloc(nb_ranges * sizeof(*ranges));
+		if (!ranges) {
+			ret = LTTNG_ERR_NOMEM;
+			goto error;
+		}
+
+		DBG("Receiving %zu PID ranges from client ...", nb_ranges);
+		ret = recv_client_payload(cmd_ctx, sock, ranges,
+				nb_ranges * sizeof(*ranges));
+		if (ret <= 0) {
+			DBG("Nothing recv() from client var len data... continuing");
+			*sock_error = 1;
+			free(ranges);
+			ret = LTTNG_ERR_INVALID;
+			goto error;
+		}
+
+		if (cmd_ctx->lsm->cmd_type == LTTNG_TRACK_PID_RANGES) {
+			ret = cmd_track_pid_ranges(cmd_ctx->session,
+					cmd_ctx->lsm->domain.type, ranges,
+					nb_ranges);
+		} else {
+			ret = cmd_untrack_pid_ranges(cmd_ctx->session,
+					cmd_ctx->lsm->domain.type, ranges,
+					nb_ranges);
+		}
+		free(ranges);
+		break;
+	}
 	case LTTNG_ENABLE_EVENT:
 	{
 		struct lttng_event_exclusion *exclusion = NULL;
@@ -3574,7 +4248,8 @@ error_add_context:
 
 			DBG("Receiving var len exclusion event list from client ...");
 			exclusion->count = count;
-			ret = lttcomm_recv_unix_sock(sock, exclusion->names,
+			ret = recv_client_payload(cmd_ctx, sock,
+					exclusion->names,
 					count * LTTNG_SYMBOL_NAME_LEN);
 			if (ret <= 0) {
 				DBG("Nothing recv() from client var len data... continuing");
@@ -3605,8 +4280,8 @@ error_add_context:
 
 			/* Receive var. len. data */
 			DBG("Receiving var len filter's expression from client ...");
-			ret = lttcomm_recv_unix_sock(sock, filter_expression,
-				expression_len);
+			ret = recv_client_payload(cmd_ctx, sock,
+				filter_expression, expression_len);
 			if (ret <= 0) {
 				DBG("Nothing recv() from client car len data... continuing");
 				*sock_error = 1;
@@ -3638,7 +4313,8 @@ error_add_context:
 
 			/* Receive var. len. data */
 			DBG("Receiving var len filter's bytecode from client ...");
-			ret = lttcomm_recv_unix_sock(sock, bytecode, bytecode_len);
+			ret = recv_client_payload(cmd_ctx, sock, bytecode,
+					bytecode_len);
 			if (ret <= 0) {
 				DBG("Nothing recv() from client car len data... continuing");
 				*sock_error = 1;
@@ -3671,7 +4347,9 @@ error_add_context:
 		ssize_t nb_events;
 
 		session_lock_list();
-		nb_events = cmd_list_tracepoints(cmd_ctx->lsm->domain.type, &events);
+		nb_events = cmd_list_tracepoints(cmd_ctx->lsm->domain.type,
+				cmd_ctx->lsm->u.list.pid_cursor,
+				cmd_ctx->lsm->u.list.page_len, &events);
 		session_unlock_list();
 		if (nb_events < 0) {
 			/* Return value is a negative lttng_error_code. */
@@ -3701,7 +4379,8 @@ error_add_context:
 
 		session_lock_list();
 		nb_fields = cmd_list_tracepoint_fields(cmd_ctx->lsm->domain.type,
-				&fields);
+				cmd_ctx->lsm->u.list.pid_cursor,
+				cmd_ctx->lsm->u.list.page_len, &fields);
 		session_unlock_list();
 		if (nb_fields < 0) {
 			/* Return value is a negative lttng_error_code. */
@@ -3800,7 +4479,7 @@ error_add_context:
 
 		/* Receive variable len data */
 		DBG("Receiving %zu URI(s) from client ...", nb_uri);
-		ret = lttcomm_recv_unix_sock(sock, uris, len);
+		ret = recv_client_payload(cmd_ctx, sock, uris, len);
 		if (ret <= 0) {
 			DBG("No URIs received from client... continuing");
 			*sock_error = 1;
@@ -3845,7 +4524,7 @@ error_add_context:
 
 			/* Receive variable len data */
 			DBG("Waiting for %zu URIs from client ...", nb_uri);
-			ret = lttcomm_recv_unix_sock(sock, uris, len);
+			ret = recv_client_payload(cmd_ctx, sock, uris, len);
 			if (ret <= 0) {
 				DBG("No URIs received from client... continuing");
 				*sock_error = 1;
@@ -3873,7 +4552,7 @@ error_add_context:
 	{
 		ret = cmd_destroy_session(cmd_ctx->session, kernel_poll_pipe[1]);
 
-		/* Set session to NULL so we do not unlock it after free. */
+		/* Set session to NULL so we do not unlock it after destroy. */
 		cmd_ctx->session = NULL;
 		break;
 	}
@@ -3924,6 +4603,55 @@ error_add_context:
 		ret = LTTNG_OK;
 		break;
 	}
+	case LTTNG_LIST_STREAM_STATS:
+	{
+		ssize_t payload_size;
+		struct lttng_stream_stats *stats = NULL;
+
+		payload_size = cmd_list_stream_stats(cmd_ctx->lsm->domain.type,
+				cmd_ctx->session,
+				cmd_ctx->lsm->u.list.channel_name, &stats);
+		if (payload_size < 0) {
+			/* Return value is a negative lttng_error_code. */
+			ret = -payload_size;
+			goto error;
+		}
+
+		ret = setup_lttng_msg_no_cmd_header(cmd_ctx, stats,
+			payload_size);
+		free(stats);
+
+		if (ret < 0) {
+			goto setup_error;
+		}
+
+		ret = LTTNG_OK;
+		break;
+	}
+	case LTTNG_LIST_MEMORY_USAGE:
+	{
+		ssize_t payload_size;
+		struct lttng_memory_usage *usage = NULL;
+
+		payload_size = cmd_list_memory_usage(cmd_ctx->lsm->domain.type,
+				cmd_ctx->session, &usage);
+		if (payload_size < 0) {
+			/* Return value is a negative lttng_error_code. */
+			ret = -payload_size;
+			goto error;
+		}
+
+		ret = setup_lttng_msg_no_cmd_header(cmd_ctx, usage,
+			payload_size);
+		free(usage);
+
+		if (ret < 0) {
+			goto setup_error;
+		}
+
+		ret = LTTNG_OK;
+		break;
+	}
 	case LTTNG_LIST_EVENTS:
 	{
 		ssize_t nb_event;
@@ -3961,7 +4689,10 @@ error_add_context:
 		void *sessions_payload;
 		size_t payload_len;
 
-		session_lock_list();
+		/*
+		 * The session list is iterated without its lock: sessions
+		 * created between the count and the listing are ignored.
+		 */
 		nr_sessions = lttng_sessions_count(
 				LTTNG_SOCK_GET_UID_CRED(&cmd_ctx->creds),
 				LTTNG_SOCK_GET_GID_CRED(&cmd_ctx->creds));
@@ -3969,15 +4700,15 @@ error_add_context:
 		sessions_payload = zmalloc(payload_len);
 
 		if (!sessions_payload) {
-			session_unlock_list();
 			ret = -ENOMEM;
 			goto setup_error;
 		}
 
-		cmd_list_lttng_sessions(sessions_payload,
+		nr_sessions = cmd_list_lttng_sessions(sessions_payload,
+			nr_sessions,
 			LTTNG_SOCK_GET_UID_CRED(&cmd_ctx->creds),
 			LTTNG_SOCK_GET_GID_CRED(&cmd_ctx->creds));
-		session_unlock_list();
+		payload_len = sizeof(struct lttng_session) * nr_sessions;
 
 		ret = setup_lttng_msg_no_cmd_header(cmd_ctx, sessions_payload,
 			payload_len);
@@ -4102,7 +4833,8 @@ error_add_context:
 	{
 		ret = cmd_snapshot_record(cmd_ctx->session,
 				&cmd_ctx->lsm->u.snapshot_record.output,
-				cmd_ctx->lsm->u.snapshot_record.wait);
+				cmd_ctx->lsm->u.snapshot_record.wait,
+				cmd_ctx->lsm->u.snapshot_record.incremental);
 		break;
 	}
 	case LTTNG_CREATE_SESSION_SNAPSHOT:
@@ -4122,7 +4854,7 @@ error_add_context:
 
 			/* Receive variable len data */
 			DBG("Waiting for %zu URIs from client ...", nb_uri);
-			ret = lttcomm_recv_unix_sock(sock, uris, len);
+			ret = recv_client_payload(cmd_ctx, sock, uris, len);
 			if (ret <= 0) {
 				DBG("No URIs received from client... continuing");
 				*sock_error = 1;
@@ -4161,7 +4893,7 @@ error_add_context:
 
 			/* Receive variable len data */
 			DBG("Waiting for %zu URIs from client ...", nb_uri);
-			ret = lttcomm_recv_unix_sock(sock, uris, len);
+			ret = recv_client_payload(cmd_ctx, sock, uris, len);
 			if (ret <= 0) {
 				DBG("No URIs received from client... continuing");
 				*sock_error = 1;
@@ -4205,6 +4937,28 @@ error_add_context:
 		ret = cmd_regenerate_statedump(cmd_ctx->session);
 		break;
 	}
+	case LTTNG_ROTATE_SESSION:
+	{
+		char chunk_path[PATH_MAX];
+
+		cmd_ctx->lsm->u.rotate_session.path[
+				sizeof(cmd_ctx->lsm->u.rotate_session.path) - 1] = '\0';
+		ret = cmd_rotate_session(cmd_ctx->session,
+				cmd_ctx->lsm->u.rotate_session.path,
+				chunk_path, sizeof(chunk_path));
+		if (ret != LTTNG_OK) {
+			goto error;
+		}
+
+		ret = setup_lttng_msg_no_cmd_header(cmd_ctx, chunk_path,
+				strlen(chunk_path) + 1);
+		if (ret < 0) {
+			goto setup_error;
+		}
+
+		ret = LTTNG_OK;
+		break;
+	}
 	case LTTNG_REGISTER_TRIGGER:
 	{
 		ret = cmd_register_trigger(cmd_ctx, sock,
@@ -4217,6 +4971,17 @@ error_add_context:
 				notification_thread_handle);
 		break;
 	}
+	case LTTNG_LOAD_SESSION_DEFINITION:
+	{
+		ret = cmd_load_session_definition(cmd_ctx, sock);
+		break;
+	}
+	case LTTNG_PERSISTENT_CONNECTION:
+	{
+		cmd_ctx->persistent = 1;
+		ret = LTTNG_OK;
+		break;
+	}
 	default:
 		ret = LTTNG_ERR_UND;
 		break;
@@ -4235,7 +5000,7 @@ setup_error:
 	if (cmd_ctx->session) {
 		session_unlock(cmd_ctx->session);
 	}
-	if (need_tracing_session) {
+	if (list_locked) {
 		session_unlock_list();
 	}
 init_setup_error:
@@ -4389,61 +5154,410 @@ restart:
 		rcu_thread_online();
 
 		memset(&reply, 0, sizeof(reply));
-		for (i = 0; i < NR_HEALTH_SESSIOND_TYPES; i++) {
-			/*
-			 * health_check_state returns 0 if health is
-			 * bad.
-			 */
-			if (!health_check_state(health_sessiond, i)) {
-				reply.ret_code |= 1ULL << i;
-			}
-		}
+		/* Bit i is set if the threads of type i are in bad health. */
+		reply.ret_code = health_check_all(health_sessiond);
 
 		DBG2("Health check return value %" PRIx64, reply.ret_code);
 
 		ret = send_unix_sock(new_sock, (void *) &reply, sizeof(reply));
 		if (ret < 0) {
 			ERR("Failed to send health data back to client");
+		} else {
+			struct health_comm_stats *stats;
+			ssize_t stats_len;
+
+			stats_len = health_create_stats(health_sessiond, &stats);
+			if (stats_len > 0) {
+				/* Older clients close without reading them. */
+				(void) send_unix_sock(new_sock, stats, stats_len);
+				free(stats);
+			}
+		}
+
+		/* End of transmission */
+		ret = close(new_sock);
+		if (ret) {
+			PERROR("close");
+		}
+	}
+
+exit:
+error:
+	if (err) {
+		ERR("Health error occurred in %s", __func__);
+	}
+	DBG("Health check thread dying");
+	unlink(health_unix_sock_path);
+	if (sock >= 0) {
+		ret = close(sock);
+		if (ret) {
+			PERROR("close");
+		}
+	}
+
+	lttng_poll_clean(&events);
+	stop_threads();
+	rcu_unregister_thread();
+	return NULL;
+}
+
+/*
+ * Client command queues. The read-only commands have their own queue, also
+ * served by a dedicated worker, so that they never wait behind long-running
+ * commands.
+ */
+static struct cds_list_head client_read_queue =
+	CDS_LIST_HEAD_INIT(client_read_queue);
+static struct cds_list_head client_write_queue =
+	CDS_LIST_HEAD_INIT(client_write_queue);
+static pthread_mutex_t client_queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t client_queue_cond = PTHREAD_COND_INITIALIZER;
+static int client_workers_quit;
+
+/*
+ * Persistent client sockets handed back to the client thread by the workers
+ * once the reply of a command is sent.
+ */
+static struct lttng_pipe *client_return_pipe;
+
+static void client_queue_cmd(struct command_ctx *cmd_ctx)
+{
+	struct cds_list_head *queue;
+
+	queue = client_cmd_is_read_only(cmd_ctx->lsm->cmd_type) ?
+			&client_read_queue : &client_write_queue;
+
+	pthread_mutex_lock(&client_queue_lock);
+	cds_list_add_tail(&cmd_ctx->list, queue);
+	pthread_cond_broadcast(&client_queue_cond);
+	pthread_mutex_unlock(&client_queue_lock);
+}
+
+/*
+ * Dequeue a client command, the read-only commands first. A read-only worker
+ * only dequeues read-only commands.
+ *
+ * Called with client_queue_lock held.
+ */
+static struct command_ctx *client_dequeue_cmd(int read_only)
+{
+	struct command_ctx *cmd_ctx;
+
+	if (!cds_list_empty(&client_read_queue)) {
+		cmd_ctx = cds_list_first_entry(&client_read_queue,
+				struct command_ctx, list);
+	} else if (!read_only && !cds_list_empty(&client_write_queue)) {
+		cmd_ctx = cds_list_first_entry(&client_write_queue,
+				struct command_ctx, list);
+	} else {
+		return NULL;
+	}
+	cds_list_del(&cmd_ctx->list);
+	return cmd_ctx;
+}
+
+/*
+ * Process a client command, send its reply and close the client socket, or
+ * hand it back to the client thread if the connection is persistent.
+ */
+static void handle_client_cmd(struct command_ctx *cmd_ctx)
+{
+	int ret, sock_error;
+
+	// TODO: Validate cmd_ctx including sanity check for
+	// security purpose.
+
+	rcu_thread_online();
+	/*
+	 * This function dispatch the work to the kernel or userspace tracer
+	 * libs and fill the lttcomm_lttng_msg data structure of all the needed
+	 * informations for the client. The command context struct contains
+	 * everything this function may needs.
+	 */
+	self_tracepoint(sessiond_cmd_begin, cmd_ctx->lsm->cmd_type);
+	ret = process_client_msg(cmd_ctx, cmd_ctx->sock, &sock_error);
+	self_tracepoint(sessiond_cmd_end, cmd_ctx->lsm->cmd_type, ret);
+	rcu_thread_offline();
+	if (ret < 0) {
+		/*
+		 * TODO: Inform client somehow of the fatal error. At
+		 * this point, ret < 0 means that a zmalloc failed
+		 * (ENOMEM). Error detected but still accept
+		 * command, unless a socket error has been
+		 * detected.
+		 */
+		goto end;
+	}
+
+	/*
+	 * A command failing before it received its payload leaves it on the
+	 * socket, where it would be read as the next command.
+	 */
+	if (cmd_ctx->persistent && !sock_error &&
+			drain_client_payload(cmd_ctx, cmd_ctx->sock) < 0) {
+		sock_error = 1;
+	}
+
+	health_code_update();
+
+	if (cmd_ctx->reply_deferred) {
+		goto reply_sent;
+	}
+
+	DBG("Sending response (size: %d, retcode: %s (%d))",
+			cmd_ctx->lttng_msg_size,
+			lttng_strerror(-cmd_ctx->llm->ret_code),
+			cmd_ctx->llm->ret_code);
+	ret = send_unix_sock(cmd_ctx->sock, cmd_ctx->llm,
+			cmd_ctx->lttng_msg_size);
+	if (ret < 0) {
+		ERR("Failed to send data back to client");
+		goto end;
+	}
+
+reply_sent:
+	if (cmd_ctx->persistent && !sock_error) {
+		ret = lttng_pipe_write(client_return_pipe, &cmd_ctx->sock,
+				sizeof(cmd_ctx->sock));
+		if (ret == sizeof(cmd_ctx->sock)) {
+			cmd_ctx->sock = -1;
+			goto clean;
+		}
+		ERR("Failed to hand back persistent client socket");
+	}
+
+end:
+	/* End of transmission */
+	ret = close(cmd_ctx->sock);
+	if (ret) {
+		PERROR("close");
+	}
+clean:
+	clean_command_ctx(&cmd_ctx);
+}
+
+/*
+ * This thread runs the client commands queued by the client thread.
+ */
+static void *thread_client_worker(void *data)
+{
+	int read_only = !!data;
+
+	rcu_register_thread();
+
+	health_register(health_sessiond, HEALTH_SESSIOND_TYPE_CMD_WORKER);
+
+	rcu_thread_offline();
+
+	DBG("[thread] Client %sworker started", read_only ? "read-only " : "");
+
+	for (;;) {
+		struct command_ctx *cmd_ctx;
+
+		health_code_update();
+
+		cmd_ctx = NULL;
+		pthread_mutex_lock(&client_queue_lock);
+		while (!client_workers_quit) {
+			cmd_ctx = client_dequeue_cmd(read_only);
+			if (cmd_ctx) {
+				break;
+			}
+			health_poll_entry();
+			pthread_cond_wait(&client_queue_cond,
+					&client_queue_lock);
+			health_poll_exit();
+		}
+		pthread_mutex_unlock(&client_queue_lock);
+		if (!cmd_ctx) {
+			/* Quit. */
+			break;
+		}
+
+		handle_client_cmd(cmd_ctx);
+	}
+
+	health_unregister(health_sessiond);
+	DBG("Client worker thread dying");
+	rcu_thread_online();
+	rcu_unregister_thread();
+	return NULL;
+}
+
+/*
+ * Stop and join the client workers, then drop the commands left in the
+ * queues.
+ */
+static void stop_client_workers(pthread_t *workers, unsigned int nr_workers)
+{
+	int ret;
+	unsigned int i;
+	struct command_ctx *cmd_ctx;
+
+	pthread_mutex_lock(&client_queue_lock);
+	client_workers_quit = 1;
+	pthread_cond_broadcast(&client_queue_cond);
+	pthread_mutex_unlock(&client_queue_lock);
+
+	for (i = 0; i < nr_workers; i++) {
+		ret = pthread_join(workers[i], NULL);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_join client worker");
+		}
+	}
+
+	while ((cmd_ctx = client_dequeue_cmd(0))) {
+		ret = close(cmd_ctx->sock);
+		if (ret) {
+			PERROR("close");
+		}
+		clean_command_ctx(&cmd_ctx);
+	}
+}
+
+/*
+ * Receive a command on a client socket and queue it for the client workers,
+ * which own the socket from then on. The socket is closed if nothing is
+ * received.
+ *
+ * Return 0 on success or else -1 on a fatal error.
+ */
+static int client_recv_cmd(int sock, int persistent)
+{
+	int ret;
+	struct command_ctx *cmd_ctx;
+
+	/* Allocate context command to process the client request */
+	cmd_ctx = zmalloc(sizeof(struct command_ctx));
+	if (cmd_ctx == NULL) {
+		PERROR("zmalloc cmd_ctx");
+		goto error;
+	}
+
+	/* Allocate data buffer for reception */
+	cmd_ctx->lsm = zmalloc(sizeof(struct lttcomm_session_msg));
+	if (cmd_ctx->lsm == NULL) {
+		PERROR("zmalloc cmd_ctx->lsm");
+		goto error;
+	}
+
+	cmd_ctx->llm = NULL;
+	cmd_ctx->session = NULL;
+	cmd_ctx->persistent = persistent;
+
+	health_code_update();
+
+	/*
+	 * Data is received from the lttng client. The struct
+	 * lttcomm_session_msg (lsm) contains the command and data request of
+	 * the client.
+	 */
+	DBG("Receiving data from client ...");
+	ret = lttcomm_recv_creds_unix_sock(sock, cmd_ctx->lsm,
+			sizeof(struct lttcomm_session_msg), &cmd_ctx->creds);
+	if (ret <= 0) {
+		DBG("Nothing recv() from client... continuing");
+		ret = close(sock);
+		if (ret) {
+			PERROR("close");
 		}
+		clean_command_ctx(&cmd_ctx);
+		return 0;
+	}
+	cmd_ctx->payload_left = client_cmd_payload_size(cmd_ctx->lsm);
+
+	health_code_update();
+
+	cmd_ctx->sock = sock;
+	client_queue_cmd(cmd_ctx);
+	return 0;
+
+error:
+	ret = close(sock);
+	if (ret) {
+		PERROR("close");
+	}
+	clean_command_ctx(&cmd_ctx);
+	return -1;
+}
+
+/*
+ * Accept a client connection and receive its first command.
+ *
+ * Return 0 on success or else -1 on a fatal error.
+ */
+static int client_accept(void)
+{
+	int sock, ret;
+
+	DBG("Wait for client response");
+
+	health_code_update();
+
+	sock = lttcomm_accept_unix_sock(client_sock);
+	if (sock < 0) {
+		return -1;
+	}
+
+	/*
+	 * Set the CLOEXEC flag. Return code is useless because either way, the
+	 * show must go on.
+	 */
+	(void) utils_set_fd_cloexec(sock);
 
-		/* End of transmission */
-		ret = close(new_sock);
+	/* Set socket option for credentials retrieval */
+	ret = lttcomm_setsockopt_creds_unix_sock(sock);
+	if (ret < 0) {
+		ret = close(sock);
 		if (ret) {
 			PERROR("close");
 		}
+		return -1;
 	}
 
-exit:
-error:
-	if (err) {
-		ERR("Health error occurred in %s", __func__);
+	return client_recv_cmd(sock, 0);
+}
+
+/*
+ * Add a persistent client socket handed back by a worker to the poll set of
+ * the client thread.
+ *
+ * Return 0 on success or else -1 on a fatal error.
+ */
+static int client_add_returned_sock(struct lttng_poll_event *events)
+{
+	int ret, sock;
+
+	ret = lttng_pipe_read(client_return_pipe, &sock, sizeof(sock));
+	if (ret != sizeof(sock)) {
+		ERR("Failed to read returned client socket");
+		return -1;
 	}
-	DBG("Health check thread dying");
-	unlink(health_unix_sock_path);
-	if (sock >= 0) {
+
+	ret = lttng_poll_add(events, sock, LPOLLIN | LPOLLRDHUP);
+	if (ret < 0) {
+		ERR("Failed to poll persistent client socket %d", sock);
 		ret = close(sock);
 		if (ret) {
 			PERROR("close");
 		}
 	}
-
-	lttng_poll_clean(&events);
-	stop_threads();
-	rcu_unregister_thread();
-	return NULL;
+	return 0;
 }
 
 /*
  * This thread manage all clients request using the unix client socket for
- * communication.
+ * communication. The commands are run by the client workers.
  */
 static void *thread_manage_clients(void *data)
 {
-	int sock = -1, ret, i, pollfd, err = -1;
-	int sock_error;
+	int ret, i, pollfd, err = -1;
 	uint32_t revents, nb_fd;
-	struct command_ctx *cmd_ctx = NULL;
 	struct lttng_poll_event events;
+	/* One read-only worker followed by the general workers. */
+	pthread_t *workers = NULL;
+	unsigned int nr_workers = 0;
 
 	DBG("[thread] Manage client started");
 
@@ -4453,16 +5567,38 @@ static void *thread_manage_clients(void *data)
 
 	health_code_update();
 
+	client_return_pipe = lttng_pipe_open(FD_CLOEXEC);
+	if (!client_return_pipe) {
+		goto error_workers;
+	}
+
+	workers = zmalloc((opt_client_threads + 1) * sizeof(*workers));
+	if (!workers) {
+		PERROR("zmalloc client workers");
+		goto error_workers;
+	}
+	for (; nr_workers < opt_client_threads + 1; nr_workers++) {
+		ret = pthread_create(&workers[nr_workers],
+				default_pthread_attr(), thread_client_worker,
+				nr_workers ? NULL : (void *) 1);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_create client worker");
+			goto error_workers;
+		}
+	}
+
 	ret = lttcomm_listen_unix_sock(client_sock);
 	if (ret < 0) {
 		goto error_listen;
 	}
 
 	/*
-	 * Pass 2 as size here for the thread quit pipe and client_sock. Nothing
-	 * more will be added to this poll set.
+	 * Pass 3 as size here for the thread quit pipe, client_sock and the
+	 * return pipe. The persistent client sockets are added to this poll
+	 * set while they are idle.
 	 */
-	ret = sessiond_set_thread_pollset(&events, 2);
+	ret = sessiond_set_thread_pollset(&events, 3);
 	if (ret < 0) {
 		goto error_create_poll;
 	}
@@ -4473,6 +5609,13 @@ static void *thread_manage_clients(void *data)
 		goto error;
 	}
 
+	ret = lttng_poll_add(&events,
+			lttng_pipe_get_readfd(client_return_pipe),
+			LPOLLIN | LPOLLERR);
+	if (ret < 0) {
+		goto error;
+	}
+
 	sessiond_notify_ready();
 	ret = sem_post(&load_info->message_thread_ready);
 	if (ret) {
@@ -4533,6 +5676,10 @@ static void *thread_manage_clients(void *data)
 			/* Event on the registration socket */
 			if (pollfd == client_sock) {
 				if (revents & LPOLLIN) {
+					ret = client_accept();
+					if (ret < 0) {
+						goto error;
+					}
 					continue;
 				} else if (revents & (LPOLLERR | LPOLLHUP | LPOLLRDHUP)) {
 					ERR("Client socket poll error");
@@ -4542,135 +5689,54 @@ static void *thread_manage_clients(void *data)
 					goto error;
 				}
 			}
-		}
-
-		DBG("Wait for client response");
-
-		health_code_update();
-
-		sock = lttcomm_accept_unix_sock(client_sock);
-		if (sock < 0) {
-			goto error;
-		}
-
-		/*
-		 * Set the CLOEXEC flag. Return code is useless because either way, the
-		 * show must go on.
-		 */
-		(void) utils_set_fd_cloexec(sock);
-
-		/* Set socket option for credentials retrieval */
-		ret = lttcomm_setsockopt_creds_unix_sock(sock);
-		if (ret < 0) {
-			goto error;
-		}
-
-		/* Allocate context command to process the client request */
-		cmd_ctx = zmalloc(sizeof(struct command_ctx));
-		if (cmd_ctx == NULL) {
-			PERROR("zmalloc cmd_ctx");
-			goto error;
-		}
-
-		/* Allocate data buffer for reception */
-		cmd_ctx->lsm = zmalloc(sizeof(struct lttcomm_session_msg));
-		if (cmd_ctx->lsm == NULL) {
-			PERROR("zmalloc cmd_ctx->lsm");
-			goto error;
-		}
 
-		cmd_ctx->llm = NULL;
-		cmd_ctx->session = NULL;
-
-		health_code_update();
-
-		/*
-		 * Data is received from the lttng client. The struct
-		 * lttcomm_session_msg (lsm) contains the command and data request of
-		 * the client.
-		 */
-		DBG("Receiving data from client ...");
-		ret = lttcomm_recv_creds_unix_sock(sock, cmd_ctx->lsm,
-				sizeof(struct lttcomm_session_msg), &cmd_ctx->creds);
-		if (ret <= 0) {
-			DBG("Nothing recv() from client... continuing");
-			ret = close(sock);
-			if (ret) {
-				PERROR("close");
+			if (pollfd == lttng_pipe_get_readfd(client_return_pipe)) {
+				if (revents & LPOLLIN) {
+					ret = client_add_returned_sock(&events);
+					if (ret < 0) {
+						goto error;
+					}
+					continue;
+				}
+				ERR("Client return pipe poll error");
+				goto error;
 			}
-			sock = -1;
-			clean_command_ctx(&cmd_ctx);
-			continue;
-		}
-
-		health_code_update();
-
-		// TODO: Validate cmd_ctx including sanity check for
-		// security purpose.
 
-		rcu_thread_online();
-		/*
-		 * This function dispatch the work to the kernel or userspace tracer
-		 * libs and fill the lttcomm_lttng_msg data structure of all the needed
-		 * informations for the client. The command context struct contains
-		 * everything this function may needs.
-		 */
-		ret = process_client_msg(cmd_ctx, sock, &sock_error);
-		rcu_thread_offline();
-		if (ret < 0) {
-			ret = close(sock);
-			if (ret) {
-				PERROR("close");
-			}
-			sock = -1;
 			/*
-			 * TODO: Inform client somehow of the fatal error. At
-			 * this point, ret < 0 means that a zmalloc failed
-			 * (ENOMEM). Error detected but still accept
-			 * command, unless a socket error has been
-			 * detected.
+			 * Persistent client socket. It is polled again once
+			 * the reply of its command is sent.
 			 */
-			clean_command_ctx(&cmd_ctx);
-			continue;
-		}
-
-		health_code_update();
-
-		DBG("Sending response (size: %d, retcode: %s (%d))",
-				cmd_ctx->lttng_msg_size,
-				lttng_strerror(-cmd_ctx->llm->ret_code),
-				cmd_ctx->llm->ret_code);
-		ret = send_unix_sock(sock, cmd_ctx->llm, cmd_ctx->lttng_msg_size);
-		if (ret < 0) {
-			ERR("Failed to send data back to client");
-		}
-
-		/* End of transmission */
-		ret = close(sock);
-		if (ret) {
-			PERROR("close");
+			ret = lttng_poll_del(&events, pollfd);
+			if (ret < 0) {
+				goto error;
+			}
+			if (revents & LPOLLIN) {
+				ret = client_recv_cmd(pollfd, 1);
+				if (ret < 0) {
+					goto error;
+				}
+			} else {
+				DBG("Persistent client socket %d hung up", pollfd);
+				ret = close(pollfd);
+				if (ret) {
+					PERROR("close");
+				}
+			}
 		}
-		sock = -1;
-
-		clean_command_ctx(&cmd_ctx);
-
-		health_code_update();
 	}
 
 exit:
 error:
-	if (sock >= 0) {
-		ret = close(sock);
-		if (ret) {
-			PERROR("close");
-		}
-	}
-
 	lttng_poll_clean(&events);
-	clean_command_ctx(&cmd_ctx);
 
 error_listen:
 error_create_poll:
+error_workers:
+	stop_client_workers(workers, nr_workers);
+	free(workers);
+	lttng_pipe_destroy(client_return_pipe);
+	client_return_pipe = NULL;
+
 	unlink(client_unix_sock_path);
 	if (client_sock >= 0) {
 		ret = close(client_sock);
@@ -4859,6 +5925,203 @@ static int set_option(int opt, const char *arg, const char *optname)
 		}
 	} else if (string_match(optname, "no-kernel")) {
 		opt_no_kernel = 1;
+	} else if (string_match(optname, "lazy-kmod-probes")) {
+		opt_lazy_kmod_probes = 1;
+	} else if (string_match(optname, "consumerd-prefork")) {
+		opt_consumerd_prefork = 1;
+	} else if (string_match(optname, "lazy-consumerd")) {
+		opt_lazy_consumerd = 1;
+	} else if (string_match(optname, "async-init")) {
+		opt_async_init = 1;
+	} else if (string_match(optname, "app-update-threads")) {
+		unsigned long v;
+
+		if (!arg || *arg == '\0') {
+			ret = -EINVAL;
+			goto end;
+		}
+		errno = 0;
+		v = strtoul(arg, NULL, 0);
+		if (errno != 0 || !isdigit(arg[0]) ||
+				v > DEFAULT_APP_UPDATE_THREADS_MAX) {
+			ERR("Wrong value in --app-update-threads parameter: %s", arg);
+			return -1;
+		}
+		opt_app_update_threads = (unsigned int) v;
+		DBG3("Application update threads set to %u",
+				opt_app_update_threads);
+	} else if (string_match(optname, "notification-threads")) {
+		unsigned long v;
+
+		if (!arg || *arg == '\0') {
+			ret = -EINVAL;
+			goto end;
+		}
+		errno = 0;
+		v = strtoul(arg, NULL, 0);
+		if (errno != 0 || !isdigit(arg[0]) ||
+				v > DEFAULT_NOTIFICATION_THREADS_MAX) {
+			ERR("Wrong value in --notification-threads parameter: %s", arg);
+			return -1;
+		}
+		opt_notification_threads = (unsigned int) v;
+		DBG3("Notification evaluator threads set to %u",
+				opt_notification_threads);
+	} else if (string_match(optname, "buffer-advisor")) {
+		unsigned long long v;
+
+		if (!arg || *arg == '\0') {
+			ret = -EINVAL;
+			goto end;
+		}
+		errno = 0;
+		v = strtoull(arg, NULL, 0);
+		if (errno != 0 || !isdigit(arg[0]) || v > INT64_MAX) {
+			ERR("Wrong value in --buffer-advisor parameter: %s", arg);
+			return -1;
+		}
+		opt_buffer_advisor_rate = (int64_t) v;
+		DBG3("Buffer advisor target set to %" PRId64 " discarded events/s",
+				opt_buffer_advisor_rate);
+	} else if (string_match(optname, "overload-shedding")) {
+		unsigned long high, low;
+		char *end;
+
+		if (!arg || *arg == '\0') {
+			ret = -EINVAL;
+			goto end;
+		}
+		errno = 0;
+		high = strtoul(arg, &end, 10);
+		low = high / 2;
+		if (!errno && *end == ':') {
+			const char *low_arg = end + 1;
+
+			low = strtoul(low_arg, &end, 10);
+			if (!isdigit(low_arg[0])) {
+				errno = EINVAL;
+			}
+		}
+		if (errno != 0 || !isdigit(arg[0]) || *end != '\0' ||
+				high == 0 || high > 100 || low >= high) {
+			ERR("Wrong value in --overload-shedding parameter: %s", arg);
+			return -1;
+		}
+		opt_overload_high = (int) high;
+		opt_overload_low = (int) low;
+		DBG3("Overload shedding from %d%% to %d%% of usage",
+				opt_overload_high, opt_overload_low);
+	} else if (string_match(optname, "save-threads")) {
+		unsigned long v;
+
+		if (!arg || *arg == '\0') {
+			ret = -EINVAL;
+			goto end;
+		}
+		errno = 0;
+		v = strtoul(arg, NULL, 0);
+		if (errno != 0 || !isdigit(arg[0]) || v == 0 ||
+				v > DEFAULT_SAVE_THREADS_MAX) {
+			ERR("Wrong value in --save-threads parameter: %s", arg);
+			return -1;
+		}
+		save_threads = (unsigned int) v;
+		DBG3("Session save threads set to %u", save_threads);
+	} else if (string_match(optname, "load-threads")) {
+		unsigned long v;
+
+		if (!arg || *arg == '\0') {
+			ret = -EINVAL;
+			goto end;
+		}
+		errno = 0;
+		v = strtoul(arg, NULL, 0);
+		if (errno != 0 || !isdigit(arg[0]) || v == 0 ||
+				v > DEFAULT_LOAD_THREADS_MAX) {
+			ERR("Wrong value in --load-threads parameter: %s", arg);
+			return -1;
+		}
+		opt_load_threads = (unsigned int) v;
+		DBG3("Session load threads set to %u", opt_load_threads);
+	} else if (string_match(optname, "load-trusted")) {
+		opt_load_trusted = 1;
+	} else if (string_match(optname, "client-threads")) {
+		unsigned long v;
+
+		if (!arg || *arg == '\0') {
+			ret = -EINVAL;
+			goto end;
+		}
+		errno = 0;
+		v = strtoul(arg, NULL, 0);
+		if (errno != 0 || !isdigit(arg[0]) || v == 0 ||
+				v > DEFAULT_CLIENT_THREADS_MAX) {
+			ERR("Wrong value in --client-threads parameter: %s", arg);
+			return -1;
+		}
+		opt_client_threads = (unsigned int) v;
+		DBG3("Client threads set to %u", opt_client_threads);
+	} else if (string_match(optname, "app-notify-threads")) {
+		unsigned long v;
+
+		if (!arg || *arg == '\0') {
+			ret = -EINVAL;
+			goto end;
+		}
+		errno = 0;
+		v = strtoul(arg, NULL, 0);
+		if (errno != 0 || !isdigit(arg[0]) || v == 0 ||
+				v > DEFAULT_APP_NOTIFY_THREADS_MAX) {
+			ERR("Wrong value in --app-notify-threads parameter: %s", arg);
+			return -1;
+		}
+		opt_app_notify_threads = (unsigned int) v;
+		DBG3("Application notify threads set to %u",
+				opt_app_notify_threads);
+	} else if (string_match(optname, "ust-prewarm-uids")) {
+		const char *p = arg;
+
+		if (!arg || *arg == '\0') {
+			ret = -EINVAL;
+			goto end;
+		}
+		for (;;) {
+			unsigned long v;
+			char *endptr;
+
+			errno = 0;
+			v = strtoul(p, &endptr, 0);
+			if (errno != 0 || !isdigit(p[0]) ||
+					(*endptr != ',' && *endptr != '\0') ||
+					v > (uid_t) -1 ||
+					ust_app_add_prewarm_uid((uid_t) v)) {
+				ERR("Wrong value in --ust-prewarm-uids parameter: %s",
+						arg);
+				return -1;
+			}
+			DBG3("Per UID buffers of uid %lu created at session start",
+					v);
+			if (*endptr == '\0') {
+				break;
+			}
+			p = endptr + 1;
+		}
+	} else if (string_match(optname, "ust-specialize-filters")) {
+		ust_app_enable_filter_specialization();
+	} else if (string_match(optname, "ust-cache-tracepoint-lists")) {
+		ust_app_enable_list_cache();
+	} else if (string_match(optname, "ust-session-memory-cap")) {
+		if (!arg || *arg == '\0') {
+			ret = -EINVAL;
+			goto end;
+		}
+		if (utils_parse_size_suffix(arg, &ust_session_memory_cap) < 0) {
+			ERR("Wrong value in --ust-session-memory-cap parameter: %s",
+					arg);
+			return -1;
+		}
+		DBG3("UST session memory cap set to %" PRIu64 " bytes",
+				ust_session_memory_cap);
 	} else if (string_match(optname, "quiet") || opt == 'q') {
 		lttng_opt_quiet = 1;
 	} else if (string_match(optname, "verbose") || opt == 'v') {
@@ -5629,8 +6892,9 @@ error:
 int main(int argc, char **argv)
 {
 	int ret = 0, retval = 0;
+	unsigned int i;
 	void *status;
-	const char *home_path, *env_app_timeout;
+	const char *home_path, *env_app_timeout, *env_fd_frugal;
 	struct lttng_pipe *ust32_channel_monitor_pipe = NULL,
 			*ust64_channel_monitor_pipe = NULL,
 			*kernel_channel_monitor_pipe = NULL;
@@ -6001,17 +7265,9 @@ int main(int argc, char **argv)
 			goto exit_init_data;
 		}
 
-		/* Setup kernel tracer */
-		if (!opt_no_kernel) {
-			init_kernel_tracer();
-			if (kernel_tracer_fd >= 0) {
-				ret = syscall_init_table();
-				if (ret < 0) {
-					ERR("Unable to populate syscall table. "
-						"Syscall tracing won't work "
-						"for this session daemon.");
-				}
-			}
+		/* Setup kernel tracer, in the background with --async-init. */
+		if (!opt_no_kernel && !opt_async_init) {
+			init_kernel_subsystem();
 		}
 
 		/* Set ulimit for open files */
@@ -6061,10 +7317,15 @@ int main(int argc, char **argv)
 		goto exit_init_data;
 	}
 
-	/* Setup the thread apps notify communication pipe. */
-	if (utils_create_pipe_cloexec(apps_cmd_notify_pipe)) {
-		retval = -1;
-		goto exit_init_data;
+	/* Setup the threads apps notify communication pipes. */
+	for (i = 0; i < DEFAULT_APP_NOTIFY_THREADS_MAX; i++) {
+		apps_cmd_notify_pipe[i][0] = apps_cmd_notify_pipe[i][1] = -1;
+	}
+	for (i = 0; i < opt_app_notify_threads; i++) {
+		if (utils_create_pipe_cloexec(apps_cmd_notify_pipe[i])) {
+			retval = -1;
+			goto exit_init_data;
+		}
 	}
 
 	/* Initialize global buffer per UID and PID registry. */
@@ -6090,6 +7351,11 @@ int main(int argc, char **argv)
 		app_socket_timeout = DEFAULT_APP_SOCKET_RW_TIMEOUT;
 	}
 
+	env_fd_frugal = getenv(DEFAULT_APP_FD_FRUGAL_ENV);
+	if (env_fd_frugal) {
+		app_fd_frugal = !!atoi(env_fd_frugal);
+	}
+
 	ret = write_pidfile();
 	if (ret) {
 		ERR("Error in write_pidfile");
@@ -6113,6 +7379,9 @@ int main(int argc, char **argv)
 		goto exit_init_data;
 	}
 	load_info->path = opt_load_session_path;
+	load_info->nr_threads = opt_load_threads;
+	load_info->trusted = !!opt_load_trusted;
+	load_info->notify_before_load = !!opt_async_init;
 
 	/* Create health-check thread. */
 	ret = pthread_create(&health_thread, default_pthread_attr(),
@@ -6128,13 +7397,19 @@ int main(int argc, char **argv)
 	notification_thread_handle = notification_thread_handle_create(
 			ust32_channel_monitor_pipe,
 			ust64_channel_monitor_pipe,
-			kernel_channel_monitor_pipe);
+			kernel_channel_monitor_pipe,
+			opt_notification_threads, opt_buffer_advisor_rate);
 	if (!notification_thread_handle) {
 		retval = -1;
 		ERR("Failed to create notification thread shared data");
 		stop_threads();
 		goto exit_notification;
 	}
+	notification_thread_handle->consumers.kernel = &kconsumer_data;
+	notification_thread_handle->overload_shedding.high = opt_overload_high;
+	notification_thread_handle->overload_shedding.low = opt_overload_low;
+	notification_thread_handle->consumers.ust32 = &ustconsumer32_data;
+	notification_thread_handle->consumers.ust64 = &ustconsumer64_data;
 
 	/* Create notification thread. */
 	ret = pthread_create(&notification_thread, default_pthread_attr(),
@@ -6148,6 +7423,24 @@ int main(int argc, char **argv)
 	}
 	notification_thread_running = true;
 
+	if (is_root && !opt_no_kernel && opt_async_init) {
+		kernel_init_done = 0;
+		ret = pthread_create(&kernel_init_thread, default_pthread_attr(),
+				thread_init_kernel, (void *) NULL);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_create kernel init");
+			retval = -1;
+			stop_threads();
+			goto exit_kernel_init;
+		}
+		kernel_init_thread_running = true;
+	}
+
+	if (opt_consumerd_prefork) {
+		prefork_consumerds();
+	}
+
 	/* Create thread to manage the client socket */
 	ret = pthread_create(&client_thread, default_pthread_attr(),
 			thread_manage_clients, (void *) NULL);
@@ -6159,6 +7452,13 @@ int main(int argc, char **argv)
 		goto exit_client;
 	}
 
+	ret = init_app_update_pool(opt_app_update_threads);
+	if (ret) {
+		retval = -1;
+		stop_threads();
+		goto exit_dispatch;
+	}
+
 	/* Create thread to dispatch registration */
 	ret = pthread_create(&dispatch_thread, default_pthread_attr(),
 			thread_dispatch_ust_registration, (void *) NULL);
@@ -6192,15 +7492,19 @@ int main(int argc, char **argv)
 		goto exit_apps;
 	}
 
-	/* Create thread to manage application notify socket */
-	ret = pthread_create(&apps_notify_thread, default_pthread_attr(),
-			ust_thread_manage_notify, (void *) NULL);
-	if (ret) {
-		errno = ret;
-		PERROR("pthread_create notify");
-		retval = -1;
-		stop_threads();
-		goto exit_apps_notify;
+	/* Create threads to manage application notify sockets */
+	for (; nr_apps_notify_threads < opt_app_notify_threads;
+			nr_apps_notify_threads++) {
+		ret = pthread_create(&apps_notify_threads[nr_apps_notify_threads],
+				default_pthread_attr(), ust_thread_manage_notify,
+				(void *) (unsigned long) nr_apps_notify_threads);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_create notify");
+			retval = -1;
+			stop_threads();
+			goto exit_apps_notify;
+		}
 	}
 
 	/* Create agent registration thread. */
@@ -6270,13 +7574,15 @@ exit_kernel:
 	}
 exit_agent_reg:
 
-	ret = pthread_join(apps_notify_thread, &status);
-	if (ret) {
-		errno = ret;
-		PERROR("pthread_join apps notify");
-		retval = -1;
-	}
 exit_apps_notify:
+	for (i = 0; i < nr_apps_notify_threads; i++) {
+		ret = pthread_join(apps_notify_threads[i], &status);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_join apps notify");
+			retval = -1;
+		}
+	}
 
 	ret = pthread_join(apps_thread, &status);
 	if (ret) {
@@ -6305,6 +7611,7 @@ exit_reg_apps:
 		retval = -1;
 	}
 exit_dispatch:
+	fini_app_update_pool();
 
 	ret = pthread_join(client_thread, &status);
 	if (ret) {
@@ -6314,6 +7621,16 @@ exit_dispatch:
 	}
 
 exit_client:
+	if (kernel_init_thread_running) {
+		ret = pthread_join(kernel_init_thread, &status);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_join kernel init thread");
+			retval = -1;
+		}
+	}
+
+exit_kernel_init:
 exit_notification:
 	ret = pthread_join(health_thread, &status);
 	if (ret) {
@@ -25,15 +25,18 @@
 
 #define _LGPL_SOURCE
 #include <assert.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/wait.h>
+#include <urcu/uatomic.h>
 
 #include <common/common.h>
 #include <common/utils.h>
 
 #include "modprobe.h"
 #include "kern-modules.h"
+#include "kernel.h"
 
 #define LTTNG_MOD_REQUIRED	1
 #define LTTNG_MOD_OPTIONAL	0
@@ -93,11 +96,22 @@ struct kern_modules_param kern_modules_probes_default[] = {
 	{ "lttng-probe-x86-exceptions" },
 };
 
+/* Probe modules lists set by the options, if any. */
+char *kmod_probes_list;
+char *kmod_extra_probes_list;
+
 /* dynamic probe modules list */
 static struct kern_modules_param *probes;
 static int nr_probes;
 static int probes_capacity;
 
+/*
+ * The data modules are loaded on the first use of the kernel tracer rather
+ * than at launch. Protected by probes_lock.
+ */
+static int probes_deferred;
+static pthread_mutex_t probes_lock = PTHREAD_MUTEX_INITIALIZER;
+
 #if HAVE_KMOD
 #include <libkmod.h>
 
@@ -131,7 +145,7 @@ static int setup_kmod_ctx(struct kmod_ctx **ctx)
 	int ret = 0;
 
 	*ctx = kmod_new(NULL, NULL);
-	if (!ctx) {
+	if (!*ctx) {
 		PERROR("Unable to create kmod library context");
 		ret = -ENOMEM;
 		goto error;
@@ -148,6 +162,121 @@ error:
 	return ret;
 }
 
+/**
+ * @brief Loads the kernel module \p module
+ *
+ * @param ctx		The libkmod context
+ * @param module	The module to load
+ * @param required	Is the module required or optionnal
+ *
+ * @returns		\c 0 on success
+ * 			\c < 0 on error
+ */
+static int insert_module(struct kmod_ctx *ctx,
+		struct kern_modules_param *module, int required)
+{
+	int ret;
+	struct kmod_module *mod = NULL;
+
+	ret = kmod_module_new_from_name(ctx, module->name, &mod);
+	if (ret < 0) {
+		PERROR("Failed to create kmod module for %s", module->name);
+		goto error;
+	}
+
+	ret = kmod_module_probe_insert_module(mod, 0,
+			NULL, NULL, NULL, NULL);
+	if (ret == -EEXIST) {
+		DBG("Module %s is already loaded", module->name);
+		ret = 0;
+	} else if (ret < 0) {
+		if (required) {
+			ERR("Unable to load required module %s",
+					module->name);
+		} else {
+			DBG("Unable to load optional module %s; continuing",
+					module->name);
+			ret = 0;
+		}
+	} else {
+		DBG("Modprobe successfully %s", module->name);
+		module->loaded = true;
+	}
+
+	kmod_module_unref(mod);
+error:
+	return ret;
+}
+
+/* Optional modules shared by the threads loading them. */
+struct modprobe_work {
+	struct kern_modules_param *modules;
+	int entries;
+	/* Index of the next module to load. Updated atomically. */
+	int next;
+};
+
+/*
+ * Load the optional modules of a work until none is left. Each thread uses
+ * its own libkmod context since a context can't be shared across threads.
+ */
+static void *modprobe_work_thread(void *data)
+{
+	int i;
+	struct kmod_ctx *ctx;
+	struct modprobe_work *work = data;
+
+	if (setup_kmod_ctx(&ctx) < 0) {
+		goto end;
+	}
+
+	while ((i = uatomic_add_return(&work->next, 1) - 1) < work->entries) {
+		(void) insert_module(ctx, &work->modules[i], LTTNG_MOD_OPTIONAL);
+	}
+end:
+	if (ctx) {
+		kmod_unref(ctx);
+	}
+	return NULL;
+}
+
+/*
+ * Load optional modules, which only depend on the required ones, on up to
+ * DEFAULT_KMOD_PROBES_LOAD_THREADS threads including the calling thread.
+ */
+static void modprobe_lttng_parallel(struct kern_modules_param *modules,
+		int entries)
+{
+	int ret, i, nr_threads = 0;
+	pthread_t threads[DEFAULT_KMOD_PROBES_LOAD_THREADS - 1];
+	struct modprobe_work work = {
+		.modules = modules,
+		.entries = entries,
+	};
+
+	for (i = 0; i < min_t(int, ARRAY_SIZE(threads), entries - 1); i++) {
+		ret = pthread_create(&threads[nr_threads], NULL,
+				modprobe_work_thread, &work);
+		if (ret) {
+			errno = ret;
+			/* The remaining threads load the modules. */
+			PERROR("pthread_create modprobe");
+			break;
+		}
+		nr_threads++;
+	}
+
+	(void) modprobe_work_thread(&work);
+
+	for (i = 0; i < nr_threads; i++) {
+		ret = pthread_join(threads[i], NULL);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_join modprobe");
+		}
+	}
+}
+
 /**
  * @brief Loads the kernel modules in \p modules
  *
@@ -156,7 +285,8 @@ error:
  * @param required	Are the modules required or optionnal
  *
  * If the modules are required, we will return with error after the
- * first failed module load, otherwise we continue loading.
+ * first failed module load, otherwise we continue loading. The optional
+ * modules are loaded in parallel.
  *
  * @returns		\c 0 on success
  * 			\c < 0 on error
@@ -167,41 +297,21 @@ static int modprobe_lttng(struct kern_modules_param *modules,
 	int ret = 0, i;
 	struct kmod_ctx *ctx;
 
+	if (!required && entries > 1) {
+		modprobe_lttng_parallel(modules, entries);
+		return 0;
+	}
+
 	ret = setup_kmod_ctx(&ctx);
 	if (ret < 0) {
 		goto error;
 	}
 
 	for (i = 0; i < entries; i++) {
-		struct kmod_module *mod = NULL;
-
-		ret = kmod_module_new_from_name(ctx, modules[i].name, &mod);
+		ret = insert_module(ctx, &modules[i], required);
 		if (ret < 0) {
-			PERROR("Failed to create kmod module for %s", modules[i].name);
 			goto error;
 		}
-
-		ret = kmod_module_probe_insert_module(mod, 0,
-				NULL, NULL, NULL, NULL);
-		if (ret == -EEXIST) {
-			DBG("Module %s is already loaded", modules[i].name);
-			ret = 0;
-		} else if (ret < 0) {
-			if (required) {
-				ERR("Unable to load required module %s",
-						modules[i].name);
-				goto error;
-			} else {
-				DBG("Unable to load optional module %s; continuing",
-						modules[i].name);
-				ret = 0;
-			}
-		} else {
-			DBG("Modprobe successfully %s", modules[i].name);
-			modules[i].loaded = true;
-		}
-
-		kmod_module_unref(mod);
 	}
 
 error:
@@ -420,6 +530,7 @@ void modprobe_remove_lttng_data(void)
 	}
 	modprobe_remove_lttng(probes, nr_probes, LTTNG_MOD_OPTIONAL);
 	free_probes();
+	kernel_list_events_invalidate();
 }
 
 /*
@@ -625,6 +736,7 @@ int modprobe_lttng_data(void)
 	 * Load probes modules now.
 	 */
 	ret = modprobe_lttng(probes, nr_probes, LTTNG_MOD_OPTIONAL);
+	kernel_list_events_invalidate();
 	if (ret) {
 		goto error;
 	}
@@ -634,3 +746,34 @@ error:
 	free_probes();
 	return ret;
 }
+
+/*
+ * Defer the loading of the data kernel modules to the first call to
+ * modprobe_lttng_data_deferred().
+ */
+void modprobe_lttng_data_defer(void)
+{
+	pthread_mutex_lock(&probes_lock);
+	probes_deferred = 1;
+	pthread_mutex_unlock(&probes_lock);
+}
+
+/*
+ * Load the data kernel modules if their loading was deferred and did not
+ * happen yet.
+ */
+int modprobe_lttng_data_deferred(void)
+{
+	int ret = 0;
+
+	pthread_mutex_lock(&probes_lock);
+	if (!probes_deferred) {
+		goto end;
+	}
+	probes_deferred = 0;
+	DBG("Loading the deferred kernel probe modules");
+	ret = modprobe_lttng_data();
+end:
+	pthread_mutex_unlock(&probes_lock);
+	return ret;
+}
@@ -23,8 +23,10 @@ void modprobe_remove_lttng_control(void);
 void modprobe_remove_lttng_data(void);
 int modprobe_lttng_control(void);
 int modprobe_lttng_data(void);
+void modprobe_lttng_data_defer(void);
+int modprobe_lttng_data_deferred(void);
 
-char *kmod_probes_list;
-char *kmod_extra_probes_list;
+extern char *kmod_probes_list;
+extern char *kmod_extra_probes_list;
 
 #endif /* _MODPROBE_H */
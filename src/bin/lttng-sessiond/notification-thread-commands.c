@@ -20,6 +20,10 @@
 #include "notification-thread.h"
 #include "notification-thread-commands.h"
 #include <common/error.h>
+#include <common/macros.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <stdint.h>
 #include <inttypes.h>
@@ -33,35 +37,87 @@ void init_notification_thread_command(struct notification_thread_command *cmd)
 }
 
 static
-int run_command_wait(struct notification_thread_handle *handle,
+int enqueue_command(struct notification_thread_handle *handle,
 		struct notification_thread_command *cmd)
 {
-	int ret;
+	int ret = 0;
+	bool was_empty;
 	uint64_t notification_counter = 1;
 
 	pthread_mutex_lock(&handle->cmd_queue.lock);
+	was_empty = cds_list_empty(&handle->cmd_queue.list);
 	/* Add to queue. */
 	cds_list_add_tail(&cmd->cmd_list_node,
 			&handle->cmd_queue.list);
-	/* Wake-up thread. */
-	ret = write(handle->cmd_queue.event_fd,
-			&notification_counter, sizeof(notification_counter));
-	if (ret < 0) {
-		PERROR("write to notification thread's queue event fd");
-		/*
-		 * Remove the command from the list so the notification
-		 * thread does not process it.
-		 */
-		cds_list_del(&cmd->cmd_list_node);
-		goto error_unlock_queue;
+	/*
+	 * Wake-up thread for the first command of a batch only, each wake-up
+	 * handling all the queued commands.
+	 */
+	if (was_empty) {
+		ret = write(handle->cmd_queue.event_fd,
+				&notification_counter,
+				sizeof(notification_counter));
+		if (ret < 0) {
+			PERROR("write to notification thread's queue event fd");
+			/*
+			 * Remove the command from the list so the notification
+			 * thread does not process it.
+			 */
+			cds_list_del(&cmd->cmd_list_node);
+			ret = -1;
+		} else {
+			ret = 0;
+		}
 	}
 	pthread_mutex_unlock(&handle->cmd_queue.lock);
+	return ret;
+}
+
+static
+int run_command_wait(struct notification_thread_handle *handle,
+		struct notification_thread_command *cmd)
+{
+	int ret;
 
+	ret = enqueue_command(handle, cmd);
+	if (ret) {
+		goto end;
+	}
 	lttng_waiter_wait(&cmd->reply_waiter);
-	return 0;
-error_unlock_queue:
-	pthread_mutex_unlock(&handle->cmd_queue.lock);
-	return -1;
+end:
+	return ret;
+}
+
+/*
+ * Queue a command allocated on the heap without waiting for its reply. The
+ * notification thread destroys it once handled, only logging its errors.
+ */
+static
+int run_command_no_wait(struct notification_thread_handle *handle,
+		struct notification_thread_command *cmd)
+{
+	int ret;
+
+	cmd->is_async = true;
+	ret = enqueue_command(handle, cmd);
+	if (ret) {
+		notification_thread_command_destroy(cmd);
+	}
+	return ret;
+}
+
+void notification_thread_command_destroy(
+		struct notification_thread_command *cmd)
+{
+	if (!cmd) {
+		return;
+	}
+
+	if (cmd->type == NOTIFICATION_COMMAND_TYPE_ADD_CHANNEL) {
+		free(cmd->parameters.add_channel.session_name);
+		free(cmd->parameters.add_channel.channel_name);
+	}
+	free(cmd);
 }
 
 enum lttng_error_code notification_thread_command_register_trigger(
@@ -110,33 +166,50 @@ end:
 	return ret_code;
 }
 
+/*
+ * The channel commands are queued without waiting for the notification
+ * thread: only the failure to queue them is returned.
+ */
 enum lttng_error_code notification_thread_command_add_channel(
 		struct notification_thread_handle *handle,
 		char *session_name, uid_t uid, gid_t gid,
 		char *channel_name, uint64_t key,
-		enum lttng_domain_type domain, uint64_t capacity)
+		enum lttng_domain_type domain, uint64_t capacity,
+		uint64_t subbuf_size)
 {
 	int ret;
 	enum lttng_error_code ret_code;
-	struct notification_thread_command cmd;
+	struct notification_thread_command *cmd;
 
-	init_notification_thread_command(&cmd);
+	cmd = zmalloc(sizeof(*cmd));
+	if (!cmd) {
+		ret_code = LTTNG_ERR_NOMEM;
+		goto end;
+	}
+	init_notification_thread_command(cmd);
 
-	cmd.type = NOTIFICATION_COMMAND_TYPE_ADD_CHANNEL;
-	cmd.parameters.add_channel.session_name = session_name;
-	cmd.parameters.add_channel.uid = uid;
-	cmd.parameters.add_channel.gid = gid;
-	cmd.parameters.add_channel.channel_name = channel_name;
-	cmd.parameters.add_channel.key.key = key;
-	cmd.parameters.add_channel.key.domain = domain;
-	cmd.parameters.add_channel.capacity = capacity;
+	cmd->type = NOTIFICATION_COMMAND_TYPE_ADD_CHANNEL;
+	cmd->parameters.add_channel.session_name = strdup(session_name);
+	cmd->parameters.add_channel.uid = uid;
+	cmd->parameters.add_channel.gid = gid;
+	cmd->parameters.add_channel.channel_name = strdup(channel_name);
+	cmd->parameters.add_channel.key.key = key;
+	cmd->parameters.add_channel.key.domain = domain;
+	cmd->parameters.add_channel.capacity = capacity;
+	cmd->parameters.add_channel.subbuf_size = subbuf_size;
+	if (!cmd->parameters.add_channel.session_name ||
+			!cmd->parameters.add_channel.channel_name) {
+		notification_thread_command_destroy(cmd);
+		ret_code = LTTNG_ERR_NOMEM;
+		goto end;
+	}
 
-	ret = run_command_wait(handle, &cmd);
+	ret = run_command_no_wait(handle, cmd);
 	if (ret) {
 		ret_code = LTTNG_ERR_UNK;
 		goto end;
 	}
-	ret_code = cmd.reply_code;
+	ret_code = LTTNG_OK;
 end:
 	return ret_code;
 }
@@ -147,20 +220,25 @@ enum lttng_error_code notification_thread_command_remove_channel(
 {
 	int ret;
 	enum lttng_error_code ret_code;
-	struct notification_thread_command cmd;
+	struct notification_thread_command *cmd;
 
-	init_notification_thread_command(&cmd);
+	cmd = zmalloc(sizeof(*cmd));
+	if (!cmd) {
+		ret_code = LTTNG_ERR_NOMEM;
+		goto end;
+	}
+	init_notification_thread_command(cmd);
 
-	cmd.type = NOTIFICATION_COMMAND_TYPE_REMOVE_CHANNEL;
-	cmd.parameters.remove_channel.key = key;
-	cmd.parameters.remove_channel.domain = domain;
+	cmd->type = NOTIFICATION_COMMAND_TYPE_REMOVE_CHANNEL;
+	cmd->parameters.remove_channel.key = key;
+	cmd->parameters.remove_channel.domain = domain;
 
-	ret = run_command_wait(handle, &cmd);
+	ret = run_command_no_wait(handle, cmd);
 	if (ret) {
 		ret_code = LTTNG_ERR_UNK;
 		goto end;
 	}
-	ret_code = cmd.reply_code;
+	ret_code = LTTNG_OK;
 end:
 	return ret_code;
 }
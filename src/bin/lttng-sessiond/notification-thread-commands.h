@@ -21,6 +21,7 @@
 #include <lttng/domain.h>
 #include <lttng/lttng-error.h>
 #include <urcu/rculfhash.h>
+#include <stdbool.h>
 #include "notification-thread.h"
 #include <common/waiter.h>
 
@@ -47,7 +48,9 @@ struct channel_info {
 	gid_t gid;
 	char *channel_name;
 	uint64_t capacity;
+	uint64_t subbuf_size;
 	struct cds_lfht_node channels_ht_node;
+	struct cds_lfht_node channels_by_name_ht_node;
 };
 
 struct notification_thread_command {
@@ -69,6 +72,11 @@ struct notification_thread_command {
 	/* lttng_waiter on which to wait for command reply (optional). */
 	struct lttng_waiter reply_waiter;
 	enum lttng_error_code reply_code;
+	/*
+	 * Set for a command nobody waits for, which the notification thread
+	 * destroys once handled.
+	 */
+	bool is_async;
 };
 
 enum lttng_error_code notification_thread_command_register_trigger(
@@ -83,7 +91,8 @@ enum lttng_error_code notification_thread_command_add_channel(
 		struct notification_thread_handle *handle,
 		char *session_name, uid_t uid, gid_t gid,
 		char *channel_name, uint64_t key,
-		enum lttng_domain_type domain, uint64_t capacity);
+		enum lttng_domain_type domain, uint64_t capacity,
+		uint64_t subbuf_size);
 
 enum lttng_error_code notification_thread_command_remove_channel(
 		struct notification_thread_handle *handle,
@@ -92,4 +101,7 @@ enum lttng_error_code notification_thread_command_remove_channel(
 void notification_thread_command_quit(
 		struct notification_thread_handle *handle);
 
+void notification_thread_command_destroy(
+		struct notification_thread_command *cmd);
+
 #endif /* NOTIFICATION_THREAD_COMMANDS_H */
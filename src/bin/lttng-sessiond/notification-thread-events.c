@@ -18,6 +18,7 @@
 #define _LGPL_SOURCE
 #include <urcu.h>
 #include <urcu/rculfhash.h>
+#include <urcu/wfcqueue.h>
 
 #include <common/defaults.h>
 #include <common/error.h>
@@ -27,11 +28,14 @@
 #include <common/hashtable/utils.h>
 #include <common/sessiond-comm/sessiond-comm.h>
 #include <common/macros.h>
+#include <common/time.h>
+#include <common/string-utils/string-utils.h>
 #include <lttng/condition/condition.h>
 #include <lttng/action/action.h>
 #include <lttng/notification/notification-internal.h>
 #include <lttng/condition/condition-internal.h>
 #include <lttng/condition/buffer-usage-internal.h>
+#include <lttng/condition/channel-rate-internal.h>
 #include <lttng/notification/channel-internal.h>
 
 #include <time.h>
@@ -39,30 +43,80 @@
 #include <assert.h>
 #include <inttypes.h>
 #include <fcntl.h>
+#include <fnmatch.h>
 
 #include "notification-thread.h"
 #include "notification-thread-events.h"
 #include "notification-thread-commands.h"
 #include "lttng-sessiond.h"
 #include "kernel.h"
+#include "buffer-advisor.h"
+#include "consumer.h"
 
 #define CLIENT_POLL_MASK_IN (LPOLLIN | LPOLLERR | LPOLLHUP | LPOLLRDHUP)
 #define CLIENT_POLL_MASK_IN_OUT (CLIENT_POLL_MASK_IN | LPOLLOUT)
 
+/*
+ * Aggregated state of a trigger whose channel name is a globbing pattern,
+ * shared by the channels of the session it matches.
+ */
+struct session_condition_state {
+	/* Matching channels for which the condition is met, atomic. */
+	unsigned long channels_met;
+};
+
 struct lttng_trigger_list_element {
 	struct lttng_trigger *trigger;
 	struct cds_list_head node;
+	/*
+	 * Evaluation state of the trigger for the channel, used by the
+	 * conditions with a hysteresis band or a minimum notification
+	 * interval.
+	 */
+	bool disarmed;
+	bool notified;
+	uint64_t last_notification_ns;
+	/* Set if the trigger applies to a channel name pattern. */
+	struct session_condition_state *session_state;
+	/* The condition is met for the channel, counted in session_state. */
+	bool met;
 };
 
 struct lttng_channel_trigger_list {
 	struct channel_key channel_key;
+	/* Owned by the channels_ht, released after the list. */
+	struct channel_info *channel_info;
 	struct cds_list_head list;
 	struct cds_lfht_node channel_triggers_ht_node;
 };
 
+/* Evaluation of an evaluator thread to send to the clients. */
+struct notification_dispatch {
+	/* The trigger outlives its queued evaluations. */
+	struct lttng_trigger *trigger;
+	struct lttng_evaluation *evaluation;
+	uid_t channel_uid;
+	gid_t channel_gid;
+	struct cds_wfcq_node node;
+};
+
 struct lttng_trigger_ht_element {
 	struct lttng_trigger *trigger;
 	struct cds_lfht_node node;
+	/*
+	 * Node in the triggers_by_channel_ht, if the trigger has a channel, or
+	 * in the triggers_by_session_ht if its channel name is a pattern.
+	 */
+	struct cds_lfht_node channel_ht_node;
+	bool has_channel;
+	struct session_condition_state *session_state;
+};
+
+/* Channel designated by name, the key of the by-name indexes. */
+struct channel_name_key {
+	const char *session_name;
+	const char *channel_name;
+	enum lttng_domain_type domain;
 };
 
 struct lttng_condition_list_element {
@@ -147,11 +201,30 @@ struct notification_client {
 	} communication;
 };
 
+/* Number of enum lttng_condition_channel_rate_metric values. */
+#define CHANNEL_RATE_METRIC_COUNT	3
+
 struct channel_state_sample {
 	struct channel_key key;
 	struct cds_lfht_node channel_state_ht_node;
 	uint64_t highest_usage;
 	uint64_t lowest_usage;
+	uint64_t consumed_bytes;
+	uint64_t discarded_events;
+	uint64_t lost_packets;
+	/* CLOCK_MONOTONIC, nsec. */
+	uint64_t timestamp;
+	/*
+	 * Rates per second since the previous sample of the channel, indexed
+	 * by enum lttng_condition_channel_rate_metric. Only valid if the
+	 * previous sample is available and no counter went backward.
+	 */
+	bool rates_valid;
+	double rates[CHANNEL_RATE_METRIC_COUNT];
+	/* History of the channel, only fed if the buffer advisor is enabled. */
+	struct buffer_advisor advisor;
+	/* Counted in the overloaded channels of its domain. */
+	bool overloaded;
 };
 
 static
@@ -206,6 +279,22 @@ int match_channel_info(struct cds_lfht_node *node, const void *key)
 			(channel_key->domain == channel_info->key.domain));
 }
 
+static
+int match_channel_info_name(struct cds_lfht_node *node, const void *key)
+{
+	const struct channel_name_key *name_key = key;
+	struct channel_info *channel_info;
+
+	channel_info = caa_container_of(node, struct channel_info,
+			channels_by_name_ht_node);
+
+	return !!((name_key->domain == channel_info->key.domain) &&
+			!strcmp(name_key->session_name,
+				channel_info->session_name) &&
+			!strcmp(name_key->channel_name,
+				channel_info->channel_name));
+}
+
 static
 int match_condition(struct cds_lfht_node *node, const void *key)
 {
@@ -290,6 +379,37 @@ unsigned long lttng_condition_buffer_usage_hash(
 	return hash;
 }
 
+static
+unsigned long lttng_condition_channel_rate_hash(
+	struct lttng_condition *_condition)
+{
+	unsigned long hash = 0;
+	struct lttng_condition_channel_rate *condition;
+
+	condition = container_of(_condition,
+			struct lttng_condition_channel_rate, parent);
+
+	if (condition->session_name) {
+		hash ^= hash_key_str(condition->session_name, lttng_ht_seed);
+	}
+	if (condition->channel_name) {
+		hash ^= hash_key_str(condition->channel_name, lttng_ht_seed);
+	}
+	if (condition->domain.set) {
+		hash ^= hash_key_ulong(
+				(void *) condition->domain.type,
+				lttng_ht_seed);
+	}
+	hash ^= hash_key_ulong((void *) (unsigned long) condition->metric,
+			lttng_ht_seed);
+	if (condition->threshold.set) {
+		uint64_t val = condition->threshold.value;
+
+		hash ^= hash_key_u64(&val, lttng_ht_seed);
+	}
+	return hash;
+}
+
 /*
  * The lttng_condition hashing code is kept in this file (rather than
  * condition.c) since it makes use of GPLv2 code (hashtable utils), which we
@@ -302,6 +422,9 @@ unsigned long lttng_condition_hash(struct lttng_condition *condition)
 	case LTTNG_CONDITION_TYPE_BUFFER_USAGE_LOW:
 	case LTTNG_CONDITION_TYPE_BUFFER_USAGE_HIGH:
 		return lttng_condition_buffer_usage_hash(condition);
+	case LTTNG_CONDITION_TYPE_CHANNEL_RATE_LOW:
+	case LTTNG_CONDITION_TYPE_CHANNEL_RATE_HIGH:
+		return lttng_condition_channel_rate_hash(condition);
 	default:
 		ERR("[notification-thread] Unexpected condition type caught");
 		abort();
@@ -573,15 +696,16 @@ end:
 	return client;
 }
 
+/*
+ * Get the channel to which the condition of a trigger applies. Return false
+ * if the condition does not apply to a channel.
+ */
 static
-bool trigger_applies_to_channel(struct lttng_trigger *trigger,
-		struct channel_info *info)
+bool trigger_get_channel_name_key(struct lttng_trigger *trigger,
+		struct channel_name_key *key)
 {
 	enum lttng_condition_status status;
 	struct lttng_condition *condition;
-	const char *trigger_session_name = NULL;
-	const char *trigger_channel_name = NULL;
-	enum lttng_domain_type trigger_domain;
 
 	condition = lttng_trigger_get_condition(trigger);
 	if (!condition) {
@@ -591,36 +715,125 @@ bool trigger_applies_to_channel(struct lttng_trigger *trigger,
 	switch (lttng_condition_get_type(condition)) {
 	case LTTNG_CONDITION_TYPE_BUFFER_USAGE_LOW:
 	case LTTNG_CONDITION_TYPE_BUFFER_USAGE_HIGH:
+		status = lttng_condition_buffer_usage_get_domain_type(condition,
+				&key->domain);
+		assert(status == LTTNG_CONDITION_STATUS_OK);
+
+		status = lttng_condition_buffer_usage_get_session_name(
+				condition, &key->session_name);
+		assert((status == LTTNG_CONDITION_STATUS_OK) &&
+				key->session_name);
+
+		status = lttng_condition_buffer_usage_get_channel_name(
+				condition, &key->channel_name);
+		assert((status == LTTNG_CONDITION_STATUS_OK) &&
+				key->channel_name);
+		break;
+	case LTTNG_CONDITION_TYPE_CHANNEL_RATE_LOW:
+	case LTTNG_CONDITION_TYPE_CHANNEL_RATE_HIGH:
+		status = lttng_condition_channel_rate_get_domain_type(condition,
+				&key->domain);
+		assert(status == LTTNG_CONDITION_STATUS_OK);
+
+		status = lttng_condition_channel_rate_get_session_name(
+				condition, &key->session_name);
+		assert((status == LTTNG_CONDITION_STATUS_OK) &&
+				key->session_name);
+
+		status = lttng_condition_channel_rate_get_channel_name(
+				condition, &key->channel_name);
+		assert((status == LTTNG_CONDITION_STATUS_OK) &&
+				key->channel_name);
 		break;
 	default:
 		goto fail;
 	}
 
-	status = lttng_condition_buffer_usage_get_domain_type(condition,
-			&trigger_domain);
-	assert(status == LTTNG_CONDITION_STATUS_OK);
-	if (info->key.domain != trigger_domain) {
-		goto fail;
-	}
+	return true;
+fail:
+	return false;
+}
 
-	status = lttng_condition_buffer_usage_get_session_name(
-			condition, &trigger_session_name);
-	assert((status == LTTNG_CONDITION_STATUS_OK) && trigger_session_name);
+static
+unsigned long hash_channel_name_key(const struct channel_name_key *key)
+{
+	return hash_key_str((void *) key->session_name, lttng_ht_seed) ^
+			hash_key_str((void *) key->channel_name, lttng_ht_seed) ^
+			hash_key_ulong((void *) (unsigned long) key->domain,
+				lttng_ht_seed);
+}
 
-	status = lttng_condition_buffer_usage_get_channel_name(
-			condition, &trigger_channel_name);
-	assert((status == LTTNG_CONDITION_STATUS_OK) && trigger_channel_name);
+static
+int match_trigger_channel(struct cds_lfht_node *node, const void *key)
+{
+	const struct channel_name_key *name_key = key;
+	struct lttng_trigger_ht_element *trigger_ht_element;
+	struct channel_name_key trigger_key;
 
-	if (strcmp(info->session_name, trigger_session_name)) {
-		goto fail;
+	trigger_ht_element = caa_container_of(node,
+			struct lttng_trigger_ht_element, channel_ht_node);
+	if (!trigger_get_channel_name_key(trigger_ht_element->trigger,
+			&trigger_key)) {
+		return 0;
 	}
-	if (strcmp(info->channel_name, trigger_channel_name)) {
-		goto fail;
+
+	return !!((name_key->domain == trigger_key.domain) &&
+			!strcmp(name_key->session_name,
+				trigger_key.session_name) &&
+			!strcmp(name_key->channel_name,
+				trigger_key.channel_name));
+}
+
+static
+bool channel_name_key_is_pattern(const struct channel_name_key *key)
+{
+	return strutils_is_star_glob_pattern(key->channel_name);
+}
+
+static
+unsigned long hash_session_name_key(const struct channel_name_key *key)
+{
+	return hash_key_str((void *) key->session_name, lttng_ht_seed) ^
+			hash_key_ulong((void *) (unsigned long) key->domain,
+				lttng_ht_seed);
+}
+
+static
+int match_trigger_session(struct cds_lfht_node *node, const void *key)
+{
+	const struct channel_name_key *name_key = key;
+	struct lttng_trigger_ht_element *trigger_ht_element;
+	struct channel_name_key trigger_key;
+
+	trigger_ht_element = caa_container_of(node,
+			struct lttng_trigger_ht_element, channel_ht_node);
+	if (!trigger_get_channel_name_key(trigger_ht_element->trigger,
+			&trigger_key)) {
+		return 0;
 	}
 
-	return true;
-fail:
-	return false;
+	return !!((name_key->domain == trigger_key.domain) &&
+			!strcmp(name_key->session_name,
+				trigger_key.session_name));
+}
+
+static
+bool trigger_applies_to_channel(struct lttng_trigger *trigger,
+		struct channel_info *channel)
+{
+	struct channel_name_key key;
+
+	if (!trigger_get_channel_name_key(trigger, &key)) {
+		return false;
+	}
+	if (key.domain != channel->key.domain ||
+			strcmp(key.session_name, channel->session_name)) {
+		return false;
+	}
+	if (channel_name_key_is_pattern(&key)) {
+		return !fnmatch(key.channel_name, channel->channel_name, 0);
+	}
+	return !strcmp(key.channel_name, channel->channel_name);
 }
 
 static
@@ -649,6 +862,159 @@ unsigned long hash_channel_key(struct channel_key *key)
 		(void *) (unsigned long) key->domain, lttng_ht_seed);
 }
 
+static
+struct notification_thread_shard *get_channel_shard(
+		struct notification_thread_state *state,
+		struct channel_key *key)
+{
+	return &state->shards[hash_channel_key(key) % state->nr_shards];
+}
+
+static
+uint64_t buffer_usage_condition_threshold(
+		struct lttng_condition_buffer_usage *use_condition,
+		uint64_t buffer_capacity);
+
+static
+uint64_t overload_threshold(uint64_t capacity, int percent)
+{
+	return capacity * (uint64_t) percent / 100;
+}
+
+static
+unsigned int overload_domain_index(enum lttng_domain_type domain)
+{
+	return domain == LTTNG_DOMAIN_KERNEL ? 0 : 1;
+}
+
+/* Usage thresholds of the triggers of a channel, sent to its consumer. */
+struct channel_monitor_filter {
+	struct channel_key key;
+	bool forward_all;
+	uint32_t nr_thresholds;
+	uint64_t thresholds[LTTCOMM_CONSUMER_MONITOR_THRESHOLDS_MAX];
+};
+
+static
+void channel_monitor_filter_add(struct channel_monitor_filter *filter,
+		uint64_t threshold)
+{
+	uint32_t i;
+
+	for (i = 0; i < filter->nr_thresholds; i++) {
+		if (filter->thresholds[i] == threshold) {
+			return;
+		}
+	}
+	if (filter->nr_thresholds == LTTCOMM_CONSUMER_MONITOR_THRESHOLDS_MAX) {
+		filter->forward_all = true;
+		return;
+	}
+	filter->thresholds[filter->nr_thresholds++] = threshold;
+}
+
+/*
+ * Compute the usage thresholds of the triggers of a channel: the buffer usage
+ * conditions only change of state when the usage crosses their threshold or
+ * the bounds of their hysteresis band. The buffer advisor, the channel rate
+ * conditions and the minimum notification intervals need every sample.
+ *
+ * Called with the lock of the shard of the channel held.
+ */
+static
+void channel_monitor_filter_compute(struct notification_thread_state *state,
+		const struct lttng_channel_trigger_list *trigger_list,
+		struct channel_monitor_filter *filter)
+{
+	struct lttng_trigger_list_element *trigger_element;
+	uint64_t capacity = trigger_list->channel_info->capacity;
+
+	memset(filter, 0, sizeof(*filter));
+	filter->key = trigger_list->channel_key;
+	if (state->buffer_advisor_rate >= 0) {
+		filter->forward_all = true;
+		return;
+	}
+	if (state->overload_shedding.high >= 0) {
+		channel_monitor_filter_add(filter, overload_threshold(capacity,
+				state->overload_shedding.high));
+		channel_monitor_filter_add(filter, overload_threshold(capacity,
+				state->overload_shedding.low));
+	}
+
+	cds_list_for_each_entry(trigger_element, &trigger_list->list, node) {
+		struct lttng_condition *condition = lttng_trigger_get_condition(
+				trigger_element->trigger);
+		struct lttng_condition_buffer_usage *use_condition;
+		enum lttng_condition_type type;
+		uint64_t threshold, band = 0;
+
+		type = lttng_condition_get_type(condition);
+		if (type != LTTNG_CONDITION_TYPE_BUFFER_USAGE_LOW &&
+				type != LTTNG_CONDITION_TYPE_BUFFER_USAGE_HIGH) {
+			filter->forward_all = true;
+			return;
+		}
+		use_condition = container_of(condition,
+				struct lttng_condition_buffer_usage, parent);
+		if (use_condition->min_notification_interval_us) {
+			filter->forward_all = true;
+			return;
+		}
+
+		threshold = buffer_usage_condition_threshold(use_condition,
+				capacity);
+		channel_monitor_filter_add(filter, threshold);
+		if (use_condition->hysteresis_ratio.set) {
+			band = (uint64_t) (use_condition->hysteresis_ratio.value *
+					(double) capacity);
+		}
+		if (!band) {
+			continue;
+		}
+		if (type == LTTNG_CONDITION_TYPE_BUFFER_USAGE_LOW) {
+			channel_monitor_filter_add(filter, threshold + band);
+		} else if (threshold > band) {
+			channel_monitor_filter_add(filter, threshold - band);
+		}
+	}
+}
+
+/*
+ * Send the usage thresholds of a channel to its consumer daemon, which then
+ * only samples the channel when they are crossed. The consumer keeps sending
+ * every sample of the channel if this fails.
+ */
+static
+void channel_monitor_filter_send(struct notification_thread_state *state,
+		const struct channel_monitor_filter *filter)
+{
+	int ret = 0;
+	struct consumer_data *consumers[2] = { NULL, NULL };
+	unsigned int i;
+
+	if (filter->key.domain == LTTNG_DOMAIN_KERNEL) {
+		consumers[0] = state->consumers.kernel;
+	} else {
+		/* The channel belongs to one of them. */
+		consumers[0] = state->consumers.ust32;
+		consumers[1] = state->consumers.ust64;
+	}
+
+	for (i = 0; i < 2; i++) {
+		if (!consumers[i]) {
+			continue;
+		}
+		ret = consumer_send_channel_monitor_filter(consumers[i],
+				filter->key.key, filter->forward_all,
+				filter->thresholds, filter->nr_thresholds);
+		if (ret) {
+			WARN("[notification-thread] Failed to send the monitor filter of channel key %" PRIu64 " to the consumer",
+					filter->key.key);
+		}
+	}
+}
+
 static
 int handle_notification_thread_command_add_channel(
 	struct notification_thread_state *state,
@@ -662,6 +1028,9 @@ int handle_notification_thread_command_add_channel(
 	struct lttng_trigger_ht_element *trigger_ht_element = NULL;
 	int trigger_count = 0;
 	struct cds_lfht_iter iter;
+	struct channel_name_key name_key;
+	struct notification_thread_shard *shard;
+	struct channel_monitor_filter filter;
 
 	DBG("[notification-thread] Adding channel %s from session %s, channel key = %" PRIu64 " in %s domain",
 			channel_info->channel_name, channel_info->session_name,
@@ -675,14 +1044,35 @@ int handle_notification_thread_command_add_channel(
 	}
 
 	channel_key = &new_channel_info->key;
+	name_key.session_name = new_channel_info->session_name;
+	name_key.channel_name = new_channel_info->channel_name;
+	name_key.domain = channel_key->domain;
 
 	/* Build a list of all triggers applying to the new channel. */
-	cds_lfht_for_each_entry(state->triggers_ht, &iter, trigger_ht_element,
-			node) {
+	cds_lfht_for_each_entry_duplicate(state->triggers_by_channel_ht,
+			hash_channel_name_key(&name_key),
+			match_trigger_channel, &name_key, &iter,
+			trigger_ht_element, channel_ht_node) {
+		struct lttng_trigger_list_element *new_element;
+
+		new_element = zmalloc(sizeof(*new_element));
+		if (!new_element) {
+			goto error;
+		}
+		CDS_INIT_LIST_HEAD(&new_element->node);
+		new_element->trigger = trigger_ht_element->trigger;
+		cds_list_add(&new_element->node, &trigger_list);
+		trigger_count++;
+	}
+	/* Add the triggers of which a pattern matches the channel's name. */
+	cds_lfht_for_each_entry_duplicate(state->triggers_by_session_ht,
+			hash_session_name_key(&name_key),
+			match_trigger_session, &name_key, &iter,
+			trigger_ht_element, channel_ht_node) {
 		struct lttng_trigger_list_element *new_element;
 
 		if (!trigger_applies_to_channel(trigger_ht_element->trigger,
-				channel_info)) {
+				new_channel_info)) {
 			continue;
 		}
 
@@ -692,6 +1082,7 @@ int handle_notification_thread_command_add_channel(
 		}
 		CDS_INIT_LIST_HEAD(&new_element->node);
 		new_element->trigger = trigger_ht_element->trigger;
+		new_element->session_state = trigger_ht_element->session_state;
 		cds_list_add(&new_element->node, &trigger_list);
 		trigger_count++;
 	}
@@ -703,6 +1094,7 @@ int handle_notification_thread_command_add_channel(
 		goto error;
 	}
 	channel_trigger_list->channel_key = *channel_key;
+	channel_trigger_list->channel_info = new_channel_info;
 	CDS_INIT_LIST_HEAD(&channel_trigger_list->list);
 	cds_lfht_node_init(&channel_trigger_list->channel_triggers_ht_node);
 	cds_list_splice(&trigger_list, &channel_trigger_list->list);
@@ -712,14 +1104,22 @@ int handle_notification_thread_command_add_channel(
 	cds_lfht_add(state->channels_ht,
 			hash_channel_key(channel_key),
 			&new_channel_info->channels_ht_node);
+	cds_lfht_add(state->channels_by_name_ht,
+			hash_channel_name_key(&name_key),
+			&new_channel_info->channels_by_name_ht_node);
 	/*
 	 * Add the list of triggers associated with this channel to the
-	 * channel_triggers_ht.
+	 * channel_triggers_ht of its shard.
 	 */
-	cds_lfht_add(state->channel_triggers_ht,
+	shard = get_channel_shard(state, channel_key);
+	pthread_mutex_lock(&shard->lock);
+	cds_lfht_add(shard->channel_triggers_ht,
 			hash_channel_key(channel_key),
 			&channel_trigger_list->channel_triggers_ht_node);
+	channel_monitor_filter_compute(state, channel_trigger_list, &filter);
+	pthread_mutex_unlock(&shard->lock);
 	rcu_read_unlock();
+	channel_monitor_filter_send(state, &filter);
 	*cmd_result = LTTNG_OK;
 	return 0;
 error:
@@ -728,6 +1128,172 @@ error:
 	return 1;
 }
 
+/*
+ * Log the buffer geometry recommended for a channel by the buffer advisor,
+ * once per change of the recommendation. "final" is set when the channel goes
+ * away, the advice then applying to the next session using the channel.
+ */
+static
+void report_buffer_advice(struct notification_thread_state *state,
+		const struct channel_info *channel_info,
+		struct channel_state_sample *sample, bool final)
+{
+	struct buffer_advisor *advisor = &sample->advisor;
+	struct buffer_geometry current, recommended;
+
+	if (state->buffer_advisor_rate < 0 || !channel_info->subbuf_size) {
+		return;
+	}
+
+	current.subbuf_size = channel_info->subbuf_size;
+	current.num_subbuf = channel_info->capacity /
+			channel_info->subbuf_size;
+	if (!buffer_advisor_recommend(advisor, &current,
+			(uint64_t) state->buffer_advisor_rate, final,
+			&recommended)) {
+		return;
+	}
+	if (!memcmp(&recommended, &advisor->reported, sizeof(recommended))) {
+		return;
+	}
+	advisor->reported = recommended;
+
+	WARN("Buffer advisor: channel %s of session %s (%s domain) discarded %" PRIu64 " events in %.1f s with a peak usage of %" PRIu64 " of %" PRIu64 " bytes, recommended geometry: --subbuf-size=%" PRIu64 " --num-subbuf=%" PRIu64,
+			channel_info->channel_name,
+			channel_info->session_name,
+			channel_info->key.domain == LTTNG_DOMAIN_KERNEL ?
+				"kernel" : "user space",
+			advisor->last_discarded_events -
+				advisor->first_discarded_events,
+			(double) (advisor->last_timestamp -
+				advisor->first_timestamp) / NSEC_PER_SEC,
+			advisor->peak_usage, channel_info->capacity,
+			recommended.subbuf_size, recommended.num_subbuf);
+}
+
+/*
+ * Update the overload state of a channel from its latest sample: a channel of
+ * priority above 0 is overloaded from the sample reaching the high threshold
+ * to the one at or below the low threshold.
+ *
+ * Called with the lock of the shard of the channel held.
+ */
+static
+void overload_shedding_sample(struct notification_thread_state *state,
+		struct channel_state_sample *sample, uint32_t priority,
+		uint64_t capacity)
+{
+	unsigned int domain = overload_domain_index(sample->key.domain);
+	bool overloaded;
+
+	if (state->overload_shedding.high < 0 || !capacity) {
+		return;
+	}
+
+	if (!priority) {
+		overloaded = false;
+	} else if (sample->overloaded) {
+		overloaded = sample->highest_usage > overload_threshold(capacity,
+				state->overload_shedding.low);
+	} else {
+		overloaded = sample->highest_usage >= overload_threshold(
+				capacity, state->overload_shedding.high);
+	}
+	if (overloaded == sample->overloaded) {
+		return;
+	}
+
+	DBG("[notification-thread] Channel key = %" PRIu64 " %s overloaded (usage = %" PRIu64 " of %" PRIu64 ")",
+			sample->key.key, overloaded ? "is" : "is no longer",
+			sample->highest_usage, capacity);
+	sample->overloaded = overloaded;
+	pthread_mutex_lock(&state->overload.lock);
+	if (overloaded) {
+		state->overload.nr_overloaded[domain]++;
+	} else {
+		assert(state->overload.nr_overloaded[domain]);
+		state->overload.nr_overloaded[domain]--;
+	}
+	pthread_mutex_unlock(&state->overload.lock);
+}
+
+/*
+ * Forget the overload state of a channel going away.
+ *
+ * Called with the lock of the shard of the channel held.
+ */
+static
+void overload_shedding_remove(struct notification_thread_state *state,
+		struct channel_state_sample *sample)
+{
+	if (!sample->overloaded) {
+		return;
+	}
+	pthread_mutex_lock(&state->overload.lock);
+	state->overload.nr_overloaded[
+			overload_domain_index(sample->key.domain)]--;
+	pthread_mutex_unlock(&state->overload.lock);
+	sample->overloaded = false;
+}
+
+/*
+ * Start the overload shedding of the consumers of a domain once one of its
+ * channels is overloaded and stop it once none is.
+ *
+ * Waits for the consumers: MUST be called without the lock of a shard held.
+ */
+static
+void overload_shedding_update(struct notification_thread_state *state)
+{
+	unsigned int domain;
+
+	if (state->overload_shedding.high < 0) {
+		return;
+	}
+
+	pthread_mutex_lock(&state->overload.lock);
+	for (domain = 0; domain < NOTIFICATION_OVERLOAD_DOMAIN_COUNT; domain++) {
+		bool shedding = state->overload.nr_overloaded[domain] > 0;
+		struct consumer_data *consumers[2] = { NULL, NULL };
+		const char *domain_name = domain == 0 ? "kernel" : "user space";
+		unsigned int i;
+
+		if (shedding == state->overload.shedding[domain]) {
+			continue;
+		}
+		state->overload.shedding[domain] = shedding;
+
+		if (shedding) {
+			WARN("Overload shedding: %u channels of priority above 0 of the %s domain are overloaded, the consumption of the channels of priority 0 is stopped",
+					state->overload.nr_overloaded[domain],
+					domain_name);
+		} else {
+			DBG("[notification-thread] End of the overload shedding of the %s domain",
+					domain_name);
+		}
+
+		if (domain == 0) {
+			consumers[0] = state->consumers.kernel;
+		} else {
+			consumers[0] = state->consumers.ust32;
+			consumers[1] = state->consumers.ust64;
+		}
+		for (i = 0; i < 2; i++) {
+			int ret;
+
+			if (!consumers[i]) {
+				continue;
+			}
+			ret = consumer_send_overload_shedding(consumers[i],
+					shedding);
+			if (ret) {
+				WARN("[notification-thread] Failed to send the overload shedding state to the consumer");
+			}
+		}
+	}
+	pthread_mutex_unlock(&state->overload.lock);
+}
+
 static
 int handle_notification_thread_command_remove_channel(
 	struct notification_thread_state *state,
@@ -740,13 +1306,16 @@ int handle_notification_thread_command_remove_channel(
 	struct lttng_trigger_list_element *trigger_list_element, *tmp;
 	struct channel_key key = { .key = channel_key, .domain = domain };
 	struct channel_info *channel_info;
+	struct notification_thread_shard *shard = get_channel_shard(state,
+			&key);
 
 	DBG("[notification-thread] Removing channel key = %" PRIu64 " in %s domain",
 			channel_key, domain == LTTNG_DOMAIN_KERNEL ? "kernel" : "user space");
 
 	rcu_read_lock();
+	pthread_mutex_lock(&shard->lock);
 
-	cds_lfht_lookup(state->channel_triggers_ht,
+	cds_lfht_lookup(shard->channel_triggers_ht,
 			hash_channel_key(&key),
 			match_channel_trigger_list,
 			&key,
@@ -764,16 +1333,20 @@ int handle_notification_thread_command_remove_channel(
 	/* Free the list of triggers associated with this channel. */
 	trigger_list = caa_container_of(node, struct lttng_channel_trigger_list,
 			channel_triggers_ht_node);
+	channel_info = trigger_list->channel_info;
 	cds_list_for_each_entry_safe(trigger_list_element, tmp,
 			&trigger_list->list, node) {
+		if (trigger_list_element->met) {
+			uatomic_dec(&trigger_list_element->session_state->channels_met);
+		}
 		cds_list_del(&trigger_list_element->node);
 		free(trigger_list_element);
 	}
-	cds_lfht_del(state->channel_triggers_ht, node);
+	cds_lfht_del(shard->channel_triggers_ht, node);
 	free(trigger_list);
 
 	/* Free sampled channel state. */
-	cds_lfht_lookup(state->channel_state_ht,
+	cds_lfht_lookup(shard->channel_state_ht,
 			hash_channel_key(&key),
 			match_channel_state_sample,
 			&key,
@@ -788,7 +1361,9 @@ int handle_notification_thread_command_remove_channel(
 				struct channel_state_sample,
 				channel_state_ht_node);
 
-		cds_lfht_del(state->channel_state_ht, node);
+		report_buffer_advice(state, channel_info, sample, true);
+		overload_shedding_remove(state, sample);
+		cds_lfht_del(shard->channel_state_ht, node);
 		free(sample);
 	}
 
@@ -803,9 +1378,13 @@ int handle_notification_thread_command_remove_channel(
 	channel_info = caa_container_of(node, struct channel_info,
 			channels_ht_node);
 	cds_lfht_del(state->channels_ht, node);
+	cds_lfht_del(state->channels_by_name_ht,
+			&channel_info->channels_by_name_ht_node);
 	channel_info_destroy(channel_info);
 end:
+	pthread_mutex_unlock(&shard->lock);
 	rcu_read_unlock();
+	overload_shedding_update(state);
 	*cmd_result = LTTNG_OK;
 	return 0;
 }
@@ -818,11 +1397,21 @@ int condition_is_supported(struct lttng_condition *condition)
 	switch (lttng_condition_get_type(condition)) {
 	case LTTNG_CONDITION_TYPE_BUFFER_USAGE_LOW:
 	case LTTNG_CONDITION_TYPE_BUFFER_USAGE_HIGH:
+	case LTTNG_CONDITION_TYPE_CHANNEL_RATE_LOW:
+	case LTTNG_CONDITION_TYPE_CHANNEL_RATE_HIGH:
 	{
 		enum lttng_domain_type domain;
 
-		ret = lttng_condition_buffer_usage_get_domain_type(condition,
-				&domain);
+		if (lttng_condition_get_type(condition) ==
+				LTTNG_CONDITION_TYPE_CHANNEL_RATE_LOW ||
+				lttng_condition_get_type(condition) ==
+				LTTNG_CONDITION_TYPE_CHANNEL_RATE_HIGH) {
+			ret = lttng_condition_channel_rate_get_domain_type(
+					condition, &domain);
+		} else {
+			ret = lttng_condition_buffer_usage_get_domain_type(
+					condition, &domain);
+		}
 		if (ret) {
 			ret = -1;
 			goto end;
@@ -850,20 +1439,112 @@ end:
 }
 
 /*
- * FIXME A client's credentials are not checked when registering a trigger, nor
- *       are they stored alongside with the trigger.
- *
- * The effects of this are benign since:
- *     - The client will succeed in registering the trigger, as it is valid,
- *     - The trigger will, internally, be bound to the channel,
- *     - The notifications will not be sent since the client's credentials
- *       are checked against the channel at that moment.
- *
- * If this function returns a non-zero value, it means something is
- * fundamentally and the whole subsystem/thread will be torn down.
+ * Add a trigger to the list of triggers bound to a channel.
  *
- * If a non-fatal error occurs, just set the cmd_result to the appropriate
- * error code.
+ * The RCU read side lock MUST be acquired.
+ */
+static
+int channel_add_trigger(struct notification_thread_state *state,
+		struct channel_info *channel,
+		struct lttng_trigger_ht_element *trigger_ht_element)
+{
+	struct lttng_trigger_list_element *trigger_list_element;
+	struct lttng_channel_trigger_list *trigger_list;
+	struct cds_lfht_node *node;
+	struct cds_lfht_iter iter;
+	struct channel_monitor_filter filter;
+	struct notification_thread_shard *shard = get_channel_shard(state,
+			&channel->key);
+
+	trigger_list_element = zmalloc(sizeof(*trigger_list_element));
+	if (!trigger_list_element) {
+		return -1;
+	}
+	CDS_INIT_LIST_HEAD(&trigger_list_element->node);
+	trigger_list_element->trigger = trigger_ht_element->trigger;
+	trigger_list_element->session_state = trigger_ht_element->session_state;
+
+	pthread_mutex_lock(&shard->lock);
+	cds_lfht_lookup(shard->channel_triggers_ht,
+			hash_channel_key(&channel->key),
+			match_channel_trigger_list,
+			&channel->key,
+			&iter);
+	node = cds_lfht_iter_get_node(&iter);
+	assert(node);
+	trigger_list = caa_container_of(node,
+			struct lttng_channel_trigger_list,
+			channel_triggers_ht_node);
+	cds_list_add(&trigger_list_element->node, &trigger_list->list);
+	channel_monitor_filter_compute(state, trigger_list, &filter);
+	pthread_mutex_unlock(&shard->lock);
+	channel_monitor_filter_send(state, &filter);
+	return 0;
+}
+
+/*
+ * Remove a trigger from the list of triggers bound to a channel.
+ *
+ * The RCU read side lock MUST be acquired.
+ */
+static
+void channel_remove_trigger(struct notification_thread_state *state,
+		struct channel_info *channel,
+		struct lttng_trigger *trigger)
+{
+	struct lttng_trigger_list_element *trigger_element, *tmp;
+	struct lttng_channel_trigger_list *trigger_list;
+	struct cds_lfht_node *node;
+	struct cds_lfht_iter iter;
+	struct channel_monitor_filter filter;
+	struct notification_thread_shard *shard = get_channel_shard(state,
+			&channel->key);
+
+	pthread_mutex_lock(&shard->lock);
+	cds_lfht_lookup(shard->channel_triggers_ht,
+			hash_channel_key(&channel->key),
+			match_channel_trigger_list,
+			&channel->key,
+			&iter);
+	node = cds_lfht_iter_get_node(&iter);
+	assert(node);
+	trigger_list = caa_container_of(node,
+			struct lttng_channel_trigger_list,
+			channel_triggers_ht_node);
+
+	cds_list_for_each_entry_safe(trigger_element, tmp,
+			&trigger_list->list, node) {
+		if (trigger_element->trigger != trigger) {
+			continue;
+		}
+
+		DBG("[notification-thread] Removed trigger from channel_triggers_ht");
+		if (trigger_element->met) {
+			uatomic_dec(&trigger_element->session_state->channels_met);
+		}
+		cds_list_del(&trigger_element->node);
+		free(trigger_element);
+	}
+	channel_monitor_filter_compute(state, trigger_list, &filter);
+	pthread_mutex_unlock(&shard->lock);
+	channel_monitor_filter_send(state, &filter);
+}
+
+/*
+ * FIXME A client's credentials are not checked when registering a trigger, nor
+ *       are they stored alongside with the trigger.
+ *
+ * The effects of this are benign since:
+ *     - The client will succeed in registering the trigger, as it is valid,
+ *     - The trigger will, internally, be bound to the channel,
+ *     - The notifications will not be sent since the client's credentials
+ *       are checked against the channel at that moment.
+ *
+ * If this function returns a non-zero value, it means something is
+ * fundamentally and the whole subsystem/thread will be torn down.
+ *
+ * If a non-fatal error occurs, just set the cmd_result to the appropriate
+ * error code.
  */
 static
 int handle_notification_thread_command_register_trigger(
@@ -876,10 +1557,12 @@ int handle_notification_thread_command_register_trigger(
 	struct notification_client *client;
 	struct notification_client_list *client_list = NULL;
 	struct lttng_trigger_ht_element *trigger_ht_element = NULL;
+	struct lttng_trigger_ht_element *registered_ht_element;
 	struct notification_client_list_element *client_list_element, *tmp;
 	struct cds_lfht_node *node;
 	struct cds_lfht_iter iter;
 	struct channel_info *channel;
+	struct channel_name_key name_key;
 	bool free_trigger = true;
 
 	rcu_read_lock();
@@ -919,10 +1602,37 @@ int handle_notification_thread_command_register_trigger(
 		goto error_free_ht_element;
 	}
 
+	/*
+	 * Index the trigger by the channel to which it applies, or by session
+	 * if its channel name is a pattern matching several channels.
+	 */
+	cds_lfht_node_init(&trigger_ht_element->channel_ht_node);
+	trigger_ht_element->has_channel = trigger_get_channel_name_key(trigger,
+			&name_key);
+	if (trigger_ht_element->has_channel &&
+			channel_name_key_is_pattern(&name_key)) {
+		trigger_ht_element->session_state = zmalloc(
+				sizeof(*trigger_ht_element->session_state));
+		if (!trigger_ht_element->session_state) {
+			cds_lfht_del(state->triggers_ht,
+					&trigger_ht_element->node);
+			ret = -1;
+			goto error_free_ht_element;
+		}
+		cds_lfht_add(state->triggers_by_session_ht,
+				hash_session_name_key(&name_key),
+				&trigger_ht_element->channel_ht_node);
+	} else if (trigger_ht_element->has_channel) {
+		cds_lfht_add(state->triggers_by_channel_ht,
+				hash_channel_name_key(&name_key),
+				&trigger_ht_element->channel_ht_node);
+	}
+
 	/*
 	 * Ownership of the trigger and of its wrapper was transfered to
 	 * the triggers_ht.
 	 */
+	registered_ht_element = trigger_ht_element;
 	trigger_ht_element = NULL;
 	free_trigger = false;
 
@@ -968,40 +1678,37 @@ int handle_notification_thread_command_register_trigger(
 
 	/*
 	 * Add the trigger to list of triggers bound to the channels currently
-	 * known.
+	 * known. The channels of the per-PID buffers share the same name.
 	 */
-	cds_lfht_for_each_entry(state->channels_ht, &iter, channel,
-			channels_ht_node) {
-		struct lttng_trigger_list_element *trigger_list_element;
-		struct lttng_channel_trigger_list *trigger_list;
-
-		if (!trigger_applies_to_channel(trigger, channel)) {
-			continue;
+	if (!registered_ht_element->has_channel) {
+		goto end_channels;
+	}
+	if (registered_ht_element->session_state) {
+		/* Channel patterns are only matched on registration. */
+		cds_lfht_for_each_entry(state->channels_ht, &iter, channel,
+				channels_ht_node) {
+			if (!trigger_applies_to_channel(trigger, channel)) {
+				continue;
+			}
+			ret = channel_add_trigger(state, channel,
+					registered_ht_element);
+			if (ret) {
+				goto error_free_client_list;
+			}
 		}
-
-		cds_lfht_lookup(state->channel_triggers_ht,
-				hash_channel_key(&channel->key),
-				match_channel_trigger_list,
-				&channel->key,
-				&iter);
-		node = cds_lfht_iter_get_node(&iter);
-		assert(node);
-		/* Free the list of triggers associated with this channel. */
-		trigger_list = caa_container_of(node,
-				struct lttng_channel_trigger_list,
-				channel_triggers_ht_node);
-
-		trigger_list_element = zmalloc(sizeof(*trigger_list_element));
-		if (!trigger_list_element) {
-			ret = -1;
+		goto end_channels;
+	}
+	cds_lfht_for_each_entry_duplicate(state->channels_by_name_ht,
+			hash_channel_name_key(&name_key),
+			match_channel_info_name, &name_key, &iter,
+			channel, channels_by_name_ht_node) {
+		ret = channel_add_trigger(state, channel,
+				registered_ht_element);
+		if (ret) {
 			goto error_free_client_list;
 		}
-		CDS_INIT_LIST_HEAD(&trigger_list_element->node);
-		trigger_list_element->trigger = trigger;
-		cds_list_add(&trigger_list_element->node, &trigger_list->list);
-		/* A trigger can only apply to one channel. */
-		break;
 	}
+end_channels:
 
 	*cmd_result = LTTNG_OK;
 error_free_client_list:
@@ -1034,7 +1741,6 @@ int handle_notification_thread_command_unregister_trigger(
 {
 	struct cds_lfht_iter iter;
 	struct cds_lfht_node *node, *triggers_ht_node;
-	struct lttng_channel_trigger_list *trigger_list;
 	struct notification_client_list *client_list;
 	struct notification_client_list_element *client_list_element, *tmp;
 	struct lttng_trigger_ht_element *trigger_ht_element = NULL;
@@ -1042,6 +1748,8 @@ int handle_notification_thread_command_unregister_trigger(
 			trigger);
 	struct lttng_action *action;
 	enum lttng_error_code cmd_reply;
+	struct channel_name_key name_key;
+	struct channel_info *channel;
 
 	rcu_read_lock();
 
@@ -1058,28 +1766,50 @@ int handle_notification_thread_command_unregister_trigger(
 		cmd_reply = LTTNG_OK;
 	}
 
-	/* Remove trigger from channel_triggers_ht. */
-	cds_lfht_for_each_entry(state->channel_triggers_ht, &iter, trigger_list,
-			channel_triggers_ht_node) {
-		struct lttng_trigger_list_element *trigger_element, *tmp;
-
-		cds_list_for_each_entry_safe(trigger_element, tmp,
-				&trigger_list->list, node) {
-			struct lttng_condition *current_condition =
-					lttng_trigger_get_condition(
-						trigger_element->trigger);
+	trigger_ht_element = caa_container_of(triggers_ht_node,
+			struct lttng_trigger_ht_element, node);
 
-			assert(current_condition);
-			if (!lttng_condition_is_equal(condition,
-					current_condition)) {
+	/*
+	 * Remove trigger from the channel_triggers_ht entries of the channels
+	 * to which it applies.
+	 */
+	if (!trigger_ht_element->has_channel) {
+		goto end_channels;
+	}
+	(void) trigger_get_channel_name_key(trigger_ht_element->trigger,
+			&name_key);
+	if (trigger_ht_element->session_state) {
+		cds_lfht_for_each_entry(state->channels_ht, &iter, channel,
+				channels_ht_node) {
+			if (!trigger_applies_to_channel(
+					trigger_ht_element->trigger,
+					channel)) {
 				continue;
 			}
-
-			DBG("[notification-thread] Removed trigger from channel_triggers_ht");
-			cds_list_del(&trigger_element->node);
+			channel_remove_trigger(state, channel,
+					trigger_ht_element->trigger);
 		}
+		cds_lfht_del(state->triggers_by_session_ht,
+				&trigger_ht_element->channel_ht_node);
+	} else {
+		cds_lfht_for_each_entry_duplicate(state->channels_by_name_ht,
+				hash_channel_name_key(&name_key),
+				match_channel_info_name, &name_key, &iter,
+				channel, channels_by_name_ht_node) {
+			channel_remove_trigger(state, channel,
+					trigger_ht_element->trigger);
+		}
+		cds_lfht_del(state->triggers_by_channel_ht,
+				&trigger_ht_element->channel_ht_node);
 	}
 
+	/*
+	 * The evaluator threads can't queue evaluations of the trigger
+	 * anymore: send those already queued while it is registered.
+	 */
+	(void) handle_notification_thread_dispatch(state);
+end_channels:
+
 	/*
 	 * Remove and release the client list from
 	 * notification_trigger_clients_ht.
@@ -1101,8 +1831,6 @@ int handle_notification_thread_command_unregister_trigger(
 	free(client_list);
 
 	/* Remove trigger from triggers_ht. */
-	trigger_ht_element = caa_container_of(triggers_ht_node,
-			struct lttng_trigger_ht_element, node);
 	cds_lfht_del(state->triggers_ht, triggers_ht_node);
 
 	condition = lttng_trigger_get_condition(trigger_ht_element->trigger);
@@ -1110,6 +1838,7 @@ int handle_notification_thread_command_unregister_trigger(
 	action = lttng_trigger_get_action(trigger_ht_element->trigger);
 	lttng_action_destroy(action);
 	lttng_trigger_destroy(trigger_ht_element->trigger);
+	free(trigger_ht_element->session_state);
 	free(trigger_ht_element);
 end:
 	rcu_read_unlock();
@@ -1120,23 +1849,13 @@ end:
 }
 
 /* Returns 0 on success, 1 on exit requested, negative value on error. */
-int handle_notification_thread_command(
-		struct notification_thread_handle *handle,
-		struct notification_thread_state *state)
+static
+int handle_one_notification_thread_command(
+		struct notification_thread_state *state,
+		struct notification_thread_command *cmd)
 {
 	int ret;
-	uint64_t counter;
-	struct notification_thread_command *cmd;
-
-	/* Read event_fd to put it back into a quiescent state. */
-	ret = read(handle->cmd_queue.event_fd, &counter, sizeof(counter));
-	if (ret == -1) {
-		goto error;
-	}
 
-	pthread_mutex_lock(&handle->cmd_queue.lock);
-	cmd = cds_list_first_entry(&handle->cmd_queue.list,
-			struct notification_thread_command, cmd_list_node);
 	switch (cmd->type) {
 	case NOTIFICATION_COMMAND_TYPE_REGISTER_TRIGGER:
 		DBG("[notification-thread] Received register trigger command");
@@ -1170,22 +1889,80 @@ int handle_notification_thread_command(
 		goto end;
 	default:
 		ERR("[notification-thread] Unknown internal command received");
-		goto error_unlock;
+		ret = -1;
+		goto error;
 	}
 
 	if (ret) {
-		goto error_unlock;
+		ret = -1;
+		goto error;
 	}
 end:
-	cds_list_del(&cmd->cmd_list_node);
-	lttng_waiter_wake_up(&cmd->reply_waiter);
-	pthread_mutex_unlock(&handle->cmd_queue.lock);
 	return ret;
-error_unlock:
-	/* Wake-up and return a fatal error to the calling thread. */
-	lttng_waiter_wake_up(&cmd->reply_waiter);
-	pthread_mutex_unlock(&handle->cmd_queue.lock);
+error:
 	cmd->reply_code = LTTNG_ERR_FATAL;
+	return ret;
+}
+
+/*
+ * Wake-up the thread waiting for the reply of a command, or destroy it if
+ * nobody waits for it. The command can't be used afterwards.
+ */
+static
+void complete_notification_thread_command(
+		struct notification_thread_command *cmd)
+{
+	if (!cmd->is_async) {
+		lttng_waiter_wake_up(&cmd->reply_waiter);
+		return;
+	}
+
+	if (cmd->reply_code != LTTNG_OK) {
+		ERR("[notification-thread] Asynchronous command failed: %s",
+				error_get_str(cmd->reply_code));
+	}
+	notification_thread_command_destroy(cmd);
+}
+
+/*
+ * Handle all the queued commands. The queue is emptied first so that the
+ * threads submitting commands meanwhile don't wait for the batch to be
+ * handled.
+ *
+ * Returns 0 on success, 1 on exit requested, negative value on error.
+ */
+int handle_notification_thread_command(
+		struct notification_thread_handle *handle,
+		struct notification_thread_state *state)
+{
+	int ret = 0;
+	uint64_t counter;
+	struct notification_thread_command *cmd, *tmp;
+	struct cds_list_head batch;
+
+	/* Read event_fd to put it back into a quiescent state. */
+	if (read(handle->cmd_queue.event_fd, &counter, sizeof(counter)) == -1) {
+		goto error;
+	}
+
+	CDS_INIT_LIST_HEAD(&batch);
+	pthread_mutex_lock(&handle->cmd_queue.lock);
+	cds_list_splice(&handle->cmd_queue.list, &batch);
+	CDS_INIT_LIST_HEAD(&handle->cmd_queue.list);
+	pthread_mutex_unlock(&handle->cmd_queue.lock);
+
+	cds_list_for_each_entry_safe(cmd, tmp, &batch, cmd_list_node) {
+		cds_list_del(&cmd->cmd_list_node);
+		if (ret == 0) {
+			ret = handle_one_notification_thread_command(state,
+					cmd);
+		} else {
+			/* The thread is exiting, fail the rest of the batch. */
+			cmd->reply_code = LTTNG_ERR_FATAL;
+		}
+		complete_notification_thread_command(cmd);
+	}
+	return ret;
 error:
 	/* Indicate a fatal error to the caller. */
 	return -1;
@@ -1404,7 +2181,7 @@ int client_flush_outgoing_queue(struct notification_client *client,
 				client->socket);
 		to_send_count -= max(ret, 0);
 
-		memcpy(client->communication.outbound.buffer.data,
+		memmove(client->communication.outbound.buffer.data,
 				client->communication.outbound.buffer.data +
 				client->communication.outbound.buffer.size - to_send_count,
 				to_send_count);
@@ -1455,6 +2232,68 @@ error:
 	return -1;
 }
 
+/*
+ * Send a message to a client. When its outgoing queue is empty, the message
+ * is sent from the caller's buffer and only the part that could not be sent
+ * is copied to the queue.
+ */
+static
+int client_send_message(struct notification_client *client,
+		struct notification_thread_state *state,
+		const char *buf, size_t len)
+{
+	ssize_t ret;
+	size_t sent;
+
+	if (client->communication.outbound.buffer.size != 0) {
+		ret = lttng_dynamic_buffer_append(
+				&client->communication.outbound.buffer,
+				buf, len);
+		if (ret) {
+			goto error;
+		}
+		return client_flush_outgoing_queue(client, state);
+	}
+
+	ret = lttcomm_send_unix_sock_non_block(client->socket, buf, len);
+	if (ret == len) {
+		return 0;
+	} else if (ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+		/* Generic error, disconnect the client. */
+		ERR("[notification-thread] Failed to send message, disconnecting client (socket fd = %i)",
+				client->socket);
+		ret = handle_notification_thread_client_disconnect(
+				client->socket, state);
+		if (ret) {
+			goto error;
+		}
+		return 0;
+	}
+
+	DBG("[notification-thread] Client (socket fd = %i) message could not be completely sent",
+			client->socket);
+	sent = max(ret, 0);
+	ret = lttng_dynamic_buffer_append(
+			&client->communication.outbound.buffer,
+			buf + sent, len - sent);
+	if (ret) {
+		goto error;
+	}
+
+	/*
+	 * We want to be notified whenever there is buffer space available to
+	 * send the rest of the payload.
+	 */
+	ret = lttng_poll_mod(&state->events, client->socket,
+			CLIENT_POLL_MASK_IN_OUT);
+	if (ret) {
+		goto error;
+	}
+	return 0;
+error:
+	return -1;
+}
+
 static
 int client_send_command_reply(struct notification_client *client,
 		struct notification_thread_state *state,
@@ -1642,8 +2481,19 @@ int client_dispatch_message(struct notification_client *client,
 		size_t expected_condition_size =
 				client->communication.inbound.buffer.size;
 
-		ret = lttng_condition_create_from_buffer(&condition_view,
-				&condition);
+		/*
+		 * A subscribed condition is kept in the client's condition
+		 * list while an unsubscribed one is destroyed before the
+		 * inbound buffer is reset; the latter borrows its strings.
+		 */
+		if (client->communication.inbound.msg_type ==
+				LTTNG_NOTIFICATION_CHANNEL_MESSAGE_TYPE_SUBSCRIBE) {
+			ret = lttng_condition_create_from_buffer(
+					&condition_view, &condition);
+		} else {
+			ret = lttng_condition_create_from_buffer_borrowed(
+					&condition_view, &condition);
+		}
 		if (ret != expected_condition_size) {
 			ERR("[notification-thread] Malformed condition received from client");
 			goto end;
@@ -1765,19 +2615,11 @@ end:
 }
 
 static
-bool evaluate_buffer_usage_condition(struct lttng_condition *condition,
-		struct channel_state_sample *sample, uint64_t buffer_capacity)
+uint64_t buffer_usage_condition_threshold(
+		struct lttng_condition_buffer_usage *use_condition,
+		uint64_t buffer_capacity)
 {
-	bool result = false;
 	uint64_t threshold;
-	enum lttng_condition_type condition_type;
-	struct lttng_condition_buffer_usage *use_condition = container_of(
-			condition, struct lttng_condition_buffer_usage,
-			parent);
-
-	if (!sample) {
-		goto end;
-	}
 
 	if (use_condition->threshold_bytes.set) {
 		threshold = use_condition->threshold_bytes.value;
@@ -1797,6 +2639,26 @@ bool evaluate_buffer_usage_condition(struct lttng_condition *condition,
 		threshold = (uint64_t) (use_condition->threshold_ratio.value *
 				(double) buffer_capacity);
 	}
+	return threshold;
+}
+
+static
+bool evaluate_buffer_usage_condition(struct lttng_condition *condition,
+		struct channel_state_sample *sample, uint64_t buffer_capacity)
+{
+	bool result = false;
+	uint64_t threshold;
+	enum lttng_condition_type condition_type;
+	struct lttng_condition_buffer_usage *use_condition = container_of(
+			condition, struct lttng_condition_buffer_usage,
+			parent);
+
+	if (!sample) {
+		goto end;
+	}
+
+	threshold = buffer_usage_condition_threshold(use_condition,
+			buffer_capacity);
 
 	condition_type = lttng_condition_get_type(condition);
 	if (condition_type == LTTNG_CONDITION_TYPE_BUFFER_USAGE_LOW) {
@@ -1826,43 +2688,314 @@ end:
 	return result;
 }
 
+/*
+ * Return true if the usage of a channel left the hysteresis band of a buffer
+ * usage condition, beyond which the condition can be notified again.
+ */
 static
-int evaluate_condition(struct lttng_condition *condition,
-		struct lttng_evaluation **evaluation,
-		struct notification_thread_state *state,
-		struct channel_state_sample *previous_sample,
-		struct channel_state_sample *latest_sample,
-		uint64_t buffer_capacity)
+bool buffer_usage_condition_left_band(struct lttng_condition *condition,
+		struct channel_state_sample *sample, uint64_t buffer_capacity)
 {
-	int ret = 0;
-	enum lttng_condition_type condition_type;
-	bool previous_sample_result;
-	bool latest_sample_result;
-
-	condition_type = lttng_condition_get_type(condition);
-	/* No other condition type supported for the moment. */
-	assert(condition_type == LTTNG_CONDITION_TYPE_BUFFER_USAGE_LOW ||
-			condition_type == LTTNG_CONDITION_TYPE_BUFFER_USAGE_HIGH);
-
-	previous_sample_result = evaluate_buffer_usage_condition(condition,
-			previous_sample, buffer_capacity);
-	latest_sample_result = evaluate_buffer_usage_condition(condition,
-			latest_sample, buffer_capacity);
+	uint64_t threshold, band = 0;
+	struct lttng_condition_buffer_usage *use_condition = container_of(
+			condition, struct lttng_condition_buffer_usage,
+			parent);
 
-	if (!latest_sample_result ||
-			(previous_sample_result == latest_sample_result)) {
-		/*
-		 * Only trigger on a condition evaluation transition.
-		 *
-		 * NOTE: This edge-triggered logic may not be appropriate for
-		 * future condition types.
-		 */
-		goto end;
+	threshold = buffer_usage_condition_threshold(use_condition,
+			buffer_capacity);
+	if (use_condition->hysteresis_ratio.set) {
+		band = (uint64_t) (use_condition->hysteresis_ratio.value *
+				(double) buffer_capacity);
+	}
+	if (lttng_condition_get_type(condition) ==
+			LTTNG_CONDITION_TYPE_BUFFER_USAGE_LOW) {
+		return sample->highest_usage > threshold + band;
+	} else {
+		return sample->highest_usage + band < threshold;
 	}
+}
 
-	if (evaluation && latest_sample_result) {
-		*evaluation = lttng_evaluation_buffer_usage_create(
-				condition_type,
+/*
+ * Evaluate a buffer usage condition with a hysteresis band or a minimum
+ * notification interval against the latest sample of a channel. Once
+ * notified, the condition is disarmed until the usage leaves the hysteresis
+ * band.
+ *
+ * Return true if the condition must be notified.
+ */
+static
+bool evaluate_buffer_usage_condition_state(struct lttng_condition *condition,
+		struct channel_state_sample *sample, uint64_t buffer_capacity,
+		struct lttng_trigger_list_element *trigger_element)
+{
+	struct lttng_condition_buffer_usage *use_condition = container_of(
+			condition, struct lttng_condition_buffer_usage,
+			parent);
+
+	if (trigger_element->disarmed) {
+		if (!buffer_usage_condition_left_band(condition, sample,
+				buffer_capacity)) {
+			return false;
+		}
+		trigger_element->disarmed = false;
+	}
+
+	if (!evaluate_buffer_usage_condition(condition, sample,
+			buffer_capacity)) {
+		return false;
+	}
+
+	if (use_condition->min_notification_interval_us) {
+		uint64_t now = lttng_monotonic_time_ns();
+
+		if (trigger_element->notified && now -
+				trigger_element->last_notification_ns <
+				use_condition->min_notification_interval_us *
+					NSEC_PER_USEC) {
+			/* Stay armed, the next sample may be notified. */
+			DBG("[notification-thread] Buffer usage notification suppressed by the minimum interval");
+			return false;
+		}
+		trigger_element->last_notification_ns = now;
+		trigger_element->notified = true;
+	}
+
+	trigger_element->disarmed = true;
+	return true;
+}
+
+/*
+ * Compute the rates of a channel over the interval separating its latest
+ * sample from the previous one. The consumed bytes only account for the
+ * current streams of the channel: a counter going backward means a stream
+ * went away and the rates are restarted from the latest sample.
+ */
+static
+void channel_state_sample_compute_rates(struct channel_state_sample *latest,
+		const struct channel_state_sample *previous)
+{
+	double elapsed_s;
+
+	latest->rates_valid = false;
+	if (latest->timestamp <= previous->timestamp ||
+			latest->consumed_bytes < previous->consumed_bytes ||
+			latest->discarded_events < previous->discarded_events ||
+			latest->lost_packets < previous->lost_packets) {
+		return;
+	}
+
+	elapsed_s = (double) (latest->timestamp - previous->timestamp) /
+			(double) NSEC_PER_SEC;
+	latest->rates[LTTNG_CONDITION_CHANNEL_RATE_METRIC_CONSUMED_BYTES] =
+			(double) (latest->consumed_bytes -
+				previous->consumed_bytes) / elapsed_s;
+	latest->rates[LTTNG_CONDITION_CHANNEL_RATE_METRIC_DISCARDED_EVENTS] =
+			(double) (latest->discarded_events -
+				previous->discarded_events) / elapsed_s;
+	latest->rates[LTTNG_CONDITION_CHANNEL_RATE_METRIC_LOST_PACKETS] =
+			(double) (latest->lost_packets -
+				previous->lost_packets) / elapsed_s;
+	latest->rates_valid = true;
+}
+
+static
+bool evaluate_channel_rate_condition_sample(
+		struct lttng_condition_channel_rate *rate_condition,
+		struct channel_state_sample *sample, double *rate)
+{
+	bool result = false;
+	double threshold;
+
+	if (!sample || !sample->rates_valid) {
+		goto end;
+	}
+
+	*rate = sample->rates[rate_condition->metric];
+	threshold = (double) rate_condition->threshold.value;
+	if (lttng_condition_get_type(&rate_condition->parent) ==
+			LTTNG_CONDITION_TYPE_CHANNEL_RATE_LOW) {
+		result = *rate < threshold;
+	} else {
+		result = *rate > threshold;
+	}
+	DBG("[notification-thread] Channel rate condition being evaluated: metric = %i, threshold = %" PRIu64 ", rate = %f",
+			(int) rate_condition->metric,
+			rate_condition->threshold.value, *rate);
+end:
+	return result;
+}
+
+/*
+ * Channel rate conditions are edge-triggered like the buffer usage ones: the
+ * condition is notified when the rate crosses the threshold.
+ */
+static
+int evaluate_channel_rate_condition(struct lttng_condition *condition,
+		struct lttng_evaluation **evaluation,
+		struct channel_state_sample *previous_sample,
+		struct channel_state_sample *latest_sample)
+{
+	int ret = 0;
+	double previous_rate, latest_rate;
+	struct lttng_condition_channel_rate *rate_condition = container_of(
+			condition, struct lttng_condition_channel_rate,
+			parent);
+
+	if (!evaluate_channel_rate_condition_sample(rate_condition,
+			latest_sample, &latest_rate) ||
+			evaluate_channel_rate_condition_sample(rate_condition,
+				previous_sample, &previous_rate)) {
+		goto end;
+	}
+
+	if (evaluation) {
+		*evaluation = lttng_evaluation_channel_rate_create(
+				lttng_condition_get_type(condition),
+				rate_condition->metric, latest_rate);
+		if (!*evaluation) {
+			ret = -1;
+			goto end;
+		}
+	}
+end:
+	return ret;
+}
+
+/*
+ * Evaluate a condition applying to the channels of a session matched by a
+ * pattern. The condition is only notified when it becomes met for a first
+ * channel of the session, and again once it is no longer met for any of
+ * them. A met buffer usage condition stays met within its hysteresis band.
+ */
+static
+int evaluate_session_condition(struct lttng_condition *condition,
+		struct lttng_evaluation **evaluation,
+		struct channel_state_sample *latest_sample,
+		uint64_t buffer_capacity,
+		struct lttng_trigger_list_element *trigger_element)
+{
+	int ret = 0;
+	bool met;
+	double rate = 0;
+	enum lttng_condition_type condition_type;
+
+	condition_type = lttng_condition_get_type(condition);
+	if (condition_type == LTTNG_CONDITION_TYPE_CHANNEL_RATE_LOW ||
+			condition_type == LTTNG_CONDITION_TYPE_CHANNEL_RATE_HIGH) {
+		met = evaluate_channel_rate_condition_sample(container_of(
+					condition,
+					struct lttng_condition_channel_rate,
+					parent),
+				latest_sample, &rate);
+	} else if (trigger_element->met) {
+		met = !buffer_usage_condition_left_band(condition,
+				latest_sample, buffer_capacity);
+	} else {
+		met = evaluate_buffer_usage_condition(condition,
+				latest_sample, buffer_capacity);
+	}
+
+	if (met == trigger_element->met) {
+		goto end;
+	}
+	trigger_element->met = met;
+	if (!met) {
+		uatomic_dec(&trigger_element->session_state->channels_met);
+		goto end;
+	}
+	if (uatomic_add_return(&trigger_element->session_state->channels_met,
+			1) != 1) {
+		/* Already met for another channel of the session. */
+		goto end;
+	}
+
+	if (!evaluation) {
+		goto end;
+	}
+	if (condition_type == LTTNG_CONDITION_TYPE_CHANNEL_RATE_LOW ||
+			condition_type == LTTNG_CONDITION_TYPE_CHANNEL_RATE_HIGH) {
+		*evaluation = lttng_evaluation_channel_rate_create(
+				condition_type, container_of(condition,
+					struct lttng_condition_channel_rate,
+					parent)->metric, rate);
+	} else {
+		*evaluation = lttng_evaluation_buffer_usage_create(
+				condition_type, latest_sample->highest_usage,
+				buffer_capacity);
+	}
+	if (!*evaluation) {
+		ret = -1;
+	}
+end:
+	return ret;
+}
+
+static
+int evaluate_condition(struct lttng_condition *condition,
+		struct lttng_evaluation **evaluation,
+		struct notification_thread_state *state,
+		struct channel_state_sample *previous_sample,
+		struct channel_state_sample *latest_sample,
+		uint64_t buffer_capacity,
+		struct lttng_trigger_list_element *trigger_element)
+{
+	int ret = 0;
+	enum lttng_condition_type condition_type;
+	bool previous_sample_result;
+	bool latest_sample_result;
+	struct lttng_condition_buffer_usage *use_condition;
+
+	if (trigger_element->session_state) {
+		ret = evaluate_session_condition(condition, evaluation,
+				latest_sample, buffer_capacity,
+				trigger_element);
+		goto end;
+	}
+
+	condition_type = lttng_condition_get_type(condition);
+	if (condition_type == LTTNG_CONDITION_TYPE_CHANNEL_RATE_LOW ||
+			condition_type == LTTNG_CONDITION_TYPE_CHANNEL_RATE_HIGH) {
+		ret = evaluate_channel_rate_condition(condition, evaluation,
+				previous_sample, latest_sample);
+		goto end;
+	}
+
+	assert(condition_type == LTTNG_CONDITION_TYPE_BUFFER_USAGE_LOW ||
+			condition_type == LTTNG_CONDITION_TYPE_BUFFER_USAGE_HIGH);
+
+	use_condition = container_of(condition,
+			struct lttng_condition_buffer_usage, parent);
+	if (use_condition->hysteresis_ratio.set ||
+			use_condition->min_notification_interval_us) {
+		latest_sample_result = evaluate_buffer_usage_condition_state(
+				condition, latest_sample, buffer_capacity,
+				trigger_element);
+		if (!latest_sample_result) {
+			goto end;
+		}
+		goto create_evaluation;
+	}
+
+	previous_sample_result = evaluate_buffer_usage_condition(condition,
+			previous_sample, buffer_capacity);
+	latest_sample_result = evaluate_buffer_usage_condition(condition,
+			latest_sample, buffer_capacity);
+
+	if (!latest_sample_result ||
+			(previous_sample_result == latest_sample_result)) {
+		/*
+		 * Only trigger on a condition evaluation transition.
+		 *
+		 * NOTE: This edge-triggered logic may not be appropriate for
+		 * future condition types.
+		 */
+		goto end;
+	}
+
+create_evaluation:
+	if (evaluation && latest_sample_result) {
+		*evaluation = lttng_evaluation_buffer_usage_create(
+				condition_type,
 				latest_sample->highest_usage,
 				buffer_capacity);
 		if (!*evaluation) {
@@ -1899,13 +3032,16 @@ int send_evaluation_to_clients(struct lttng_trigger *trigger,
 {
 	int ret = 0;
 	struct lttng_dynamic_buffer msg_buffer;
+	/* Most notifications fit, sparing the heap allocation. */
+	char msg_storage[512];
 	struct notification_client_list_element *client_list_element, *tmp;
 	struct lttng_notification *notification;
 	struct lttng_condition *condition;
 	ssize_t expected_notification_size, notification_size;
 	struct lttng_notification_channel_message msg;
 
-	lttng_dynamic_buffer_init(&msg_buffer);
+	lttng_dynamic_buffer_init_with_storage(&msg_buffer, msg_storage,
+			sizeof(msg_storage));
 
 	condition = lttng_trigger_get_condition(trigger);
 	assert(condition);
@@ -1931,7 +3067,8 @@ int send_evaluation_to_clients(struct lttng_trigger *trigger,
 		goto end;
 	}
 
-	ret = lttng_dynamic_buffer_set_size(&msg_buffer,
+	/* The notification is serialized in place. */
+	ret = lttng_dynamic_buffer_set_size_no_zero(&msg_buffer,
 			msg_buffer.size + expected_notification_size);
 	if (ret) {
 		goto end;
@@ -1980,31 +3117,77 @@ int send_evaluation_to_clients(struct lttng_trigger *trigger,
 			continue;
 		}
 
-		ret = lttng_dynamic_buffer_append_buffer(
-				&client->communication.outbound.buffer,
-				&msg_buffer);
+		/* The serialized notification is shared by the clients. */
+		ret = client_send_message(client, state, msg_buffer.data,
+				msg_buffer.size);
 		if (ret) {
 			goto end;
 		}
+	}
+	ret = 0;
+end:
+	lttng_notification_destroy(notification);
+	lttng_dynamic_buffer_reset(&msg_buffer);
+	return ret;
+}
 
-		ret = client_flush_outgoing_queue(client, state);
-		if (ret) {
+/*
+ * Queue an evaluation to be sent to the clients by the notification thread.
+ * Ownership of the evaluation is transferred to the dispatch queue.
+ */
+static
+int queue_evaluation(struct notification_thread_state *state,
+		struct lttng_trigger *trigger,
+		struct lttng_evaluation *evaluation,
+		uid_t channel_uid, gid_t channel_gid)
+{
+	int ret = 0;
+	uint64_t counter = 1;
+	struct notification_dispatch *dispatch;
+
+	dispatch = zmalloc(sizeof(*dispatch));
+	if (!dispatch) {
+		lttng_evaluation_destroy(evaluation);
+		ret = -1;
+		goto end;
+	}
+	dispatch->trigger = trigger;
+	dispatch->evaluation = evaluation;
+	dispatch->channel_uid = channel_uid;
+	dispatch->channel_gid = channel_gid;
+	cds_wfcq_node_init(&dispatch->node);
+	cds_wfcq_enqueue(&state->dispatch_queue.head,
+			&state->dispatch_queue.tail, &dispatch->node);
+
+	ret = lttng_write(state->dispatch_queue.event_fd, &counter,
+			sizeof(counter));
+	if (ret != sizeof(counter)) {
+		/* The eventfd counter is already set. */
+		if (errno != EAGAIN) {
+			PERROR("write to notification dispatch eventfd");
+			ret = -1;
 			goto end;
 		}
 	}
 	ret = 0;
 end:
-	lttng_notification_destroy(notification);
-	lttng_dynamic_buffer_reset(&msg_buffer);
 	return ret;
 }
 
-int handle_notification_thread_channel_sample(
-		struct notification_thread_state *state, int pipe,
+/*
+ * Update the state of a channel with a sample and evaluate the conditions of
+ * its triggers. With evaluator threads, the evaluations are queued to the
+ * notification thread which sends them to the clients.
+ *
+ * The RCU read side lock and the lock of the channel's shard MUST be acquired.
+ */
+static
+int handle_channel_sample(struct notification_thread_state *state,
+		struct notification_thread_shard *shard,
+		const struct lttcomm_consumer_channel_monitor_msg *sample_msg,
 		enum lttng_domain_type domain)
 {
 	int ret = 0;
-	struct lttcomm_consumer_channel_monitor_msg sample_msg;
 	struct channel_state_sample previous_sample, latest_sample;
 	struct channel_info *channel_info;
 	struct cds_lfht_node *node;
@@ -2013,30 +3196,25 @@ int handle_notification_thread_channel_sample(
 	struct lttng_trigger_list_element *trigger_list_element;
 	bool previous_sample_available = false;
 
-	/*
-	 * The monitoring pipe only holds messages smaller than PIPE_BUF,
-	 * ensuring that read/write of sampling messages are atomic.
-	 */
-	ret = lttng_read(pipe, &sample_msg, sizeof(sample_msg));
-	if (ret != sizeof(sample_msg)) {
-		ERR("[notification-thread] Failed to read from monitoring pipe (fd = %i)",
-				pipe);
-		ret = -1;
-		goto end;
-	}
-
-	ret = 0;
-	latest_sample.key.key = sample_msg.key;
+	latest_sample.key.key = sample_msg->key;
 	latest_sample.key.domain = domain;
-	latest_sample.highest_usage = sample_msg.highest;
-	latest_sample.lowest_usage = sample_msg.lowest;
+	latest_sample.highest_usage = sample_msg->highest;
+	latest_sample.lowest_usage = sample_msg->lowest;
+	latest_sample.consumed_bytes = sample_msg->consumed_bytes;
+	latest_sample.discarded_events = sample_msg->discarded_events;
+	latest_sample.lost_packets = sample_msg->lost_packets;
+	latest_sample.timestamp = sample_msg->timestamp;
+	latest_sample.rates_valid = false;
+	latest_sample.overloaded = false;
 
-	rcu_read_lock();
-
-	/* Retrieve the channel's informations */
-	cds_lfht_lookup(state->channels_ht,
+	/*
+	 * Retrieve the channel's triggers and informations. The shard's list
+	 * is used since the channel_info may only be released under the
+	 * shard's lock.
+	 */
+	cds_lfht_lookup(shard->channel_triggers_ht,
 			hash_channel_key(&latest_sample.key),
-			match_channel_info,
+			match_channel_trigger_list,
 			&latest_sample.key,
 			&iter);
 	node = cds_lfht_iter_get_node(&iter);
@@ -2051,10 +3229,11 @@ int handle_notification_thread_channel_sample(
 				latest_sample.key.key,
 				domain == LTTNG_DOMAIN_KERNEL ? "kernel" :
 					"user space");
-		goto end_unlock;
+		goto end;
 	}
-	channel_info = caa_container_of(node, struct channel_info,
-			channels_ht_node);
+	trigger_list = caa_container_of(node, struct lttng_channel_trigger_list,
+			channel_triggers_ht_node);
+	channel_info = trigger_list->channel_info;
 	DBG("[notification-thread] Handling channel sample for channel %s (key = %" PRIu64 ") in session %s (highest usage = %" PRIu64 ", lowest usage = %" PRIu64")",
 			channel_info->channel_name,
 			latest_sample.key.key,
@@ -2063,7 +3242,7 @@ int handle_notification_thread_channel_sample(
 			latest_sample.lowest_usage);
 
 	/* Retrieve the channel's last sample, if it exists, and update it. */
-	cds_lfht_lookup(state->channel_state_ht,
+	cds_lfht_lookup(shard->channel_state_ht,
 			hash_channel_key(&latest_sample.key),
 			match_channel_state_sample,
 			&latest_sample.key,
@@ -2078,9 +3257,29 @@ int handle_notification_thread_channel_sample(
 				channel_state_ht_node);
 		memcpy(&previous_sample, stored_sample,
 				sizeof(previous_sample));
+		channel_state_sample_compute_rates(&latest_sample,
+				&previous_sample);
 		stored_sample->highest_usage = latest_sample.highest_usage;
 		stored_sample->lowest_usage = latest_sample.lowest_usage;
+		stored_sample->consumed_bytes = latest_sample.consumed_bytes;
+		stored_sample->discarded_events =
+				latest_sample.discarded_events;
+		stored_sample->lost_packets = latest_sample.lost_packets;
+		stored_sample->timestamp = latest_sample.timestamp;
+		stored_sample->rates_valid = latest_sample.rates_valid;
+		memcpy(stored_sample->rates, latest_sample.rates,
+				sizeof(stored_sample->rates));
 		previous_sample_available = true;
+		if (state->buffer_advisor_rate >= 0) {
+			buffer_advisor_sample(&stored_sample->advisor,
+					latest_sample.highest_usage,
+					latest_sample.discarded_events,
+					latest_sample.timestamp);
+			report_buffer_advice(state, channel_info,
+					stored_sample, false);
+		}
+		overload_shedding_sample(state, stored_sample,
+				sample_msg->priority, channel_info->capacity);
 	} else {
 		/*
 		 * This is the channel's first sample, allocate space for and
@@ -2091,35 +3290,31 @@ int handle_notification_thread_channel_sample(
 		stored_sample = zmalloc(sizeof(*stored_sample));
 		if (!stored_sample) {
 			ret = -1;
-			goto end_unlock;
+			goto end;
 		}
 
 		memcpy(stored_sample, &latest_sample, sizeof(*stored_sample));
+		buffer_advisor_init(&stored_sample->advisor);
+		if (state->buffer_advisor_rate >= 0) {
+			buffer_advisor_sample(&stored_sample->advisor,
+					latest_sample.highest_usage,
+					latest_sample.discarded_events,
+					latest_sample.timestamp);
+		}
+		overload_shedding_sample(state, stored_sample,
+				sample_msg->priority, channel_info->capacity);
 		cds_lfht_node_init(&stored_sample->channel_state_ht_node);
-		cds_lfht_add(state->channel_state_ht,
+		cds_lfht_add(shard->channel_state_ht,
 				hash_channel_key(&stored_sample->key),
 				&stored_sample->channel_state_ht_node);
 	}
 
-	/* Find triggers associated with this channel. */
-	cds_lfht_lookup(state->channel_triggers_ht,
-			hash_channel_key(&latest_sample.key),
-			match_channel_trigger_list,
-			&latest_sample.key,
-			&iter);
-	node = cds_lfht_iter_get_node(&iter);
-	if (!node) {
-		goto end_unlock;
-	}
-
-	trigger_list = caa_container_of(node, struct lttng_channel_trigger_list,
-			channel_triggers_ht_node);
 	cds_list_for_each_entry(trigger_list_element, &trigger_list->list,
 		        node) {
 		struct lttng_condition *condition;
 		struct lttng_action *action;
 		struct lttng_trigger *trigger;
-		struct notification_client_list *client_list;
+		struct notification_client_list *client_list = NULL;
 		struct lttng_evaluation *evaluation = NULL;
 
 		trigger = trigger_list_element->trigger;
@@ -2133,48 +3328,258 @@ int handle_notification_thread_channel_sample(
 
 		/*
 		 * Check if any client is subscribed to the result of this
-		 * evaluation.
+		 * evaluation. The client lists belong to the notification
+		 * thread: the evaluator threads leave that check to the
+		 * dispatch of the evaluation.
 		 */
-		cds_lfht_lookup(state->notification_trigger_clients_ht,
-				lttng_condition_hash(condition),
-				match_client_list,
-				trigger,
-				&iter);
-		node = cds_lfht_iter_get_node(&iter);
-		assert(node);
-
-		client_list = caa_container_of(node,
-				struct notification_client_list,
-				notification_trigger_ht_node);
-		if (cds_list_empty(&client_list->list)) {
-			/*
-			 * No clients interested in the evaluation's result,
-			 * skip it.
-			 */
-			continue;
+		if (!state->nr_evaluators) {
+			cds_lfht_lookup(state->notification_trigger_clients_ht,
+					lttng_condition_hash(condition),
+					match_client_list,
+					trigger,
+					&iter);
+			node = cds_lfht_iter_get_node(&iter);
+			assert(node);
+
+			client_list = caa_container_of(node,
+					struct notification_client_list,
+					notification_trigger_ht_node);
+			if (cds_list_empty(&client_list->list)) {
+				/*
+				 * No clients interested in the evaluation's
+				 * result, skip it.
+				 */
+				continue;
+			}
 		}
 
 		ret = evaluate_condition(condition, &evaluation, state,
 				previous_sample_available ? &previous_sample : NULL,
-				&latest_sample, channel_info->capacity);
+				&latest_sample, channel_info->capacity,
+				trigger_list_element);
 		if (ret) {
-			goto end_unlock;
+			goto end;
 		}
 
 		if (!evaluation) {
 			continue;
 		}
 
+		if (!client_list) {
+			ret = queue_evaluation(state, trigger, evaluation,
+					channel_info->uid, channel_info->gid);
+			if (ret) {
+				goto end;
+			}
+			continue;
+		}
+
 		/* Dispatch evaluation result to all clients. */
 		ret = send_evaluation_to_clients(trigger_list_element->trigger,
 				evaluation, client_list, state,
 				channel_info->uid, channel_info->gid);
+		lttng_evaluation_destroy(evaluation);
 		if (ret) {
-			goto end_unlock;
+			goto end;
 		}
 	}
-end_unlock:
+end:
+	return ret;
+}
+
+int handle_notification_thread_sample_batch(
+		struct notification_thread_state *state,
+		struct notification_thread_shard *shard,
+		const struct notification_sample_batch *batch)
+{
+	int ret = 0;
+	uint32_t i;
+
+	rcu_read_lock();
+	pthread_mutex_lock(&shard->lock);
+	for (i = 0; i < batch->nb_samples; i++) {
+		ret = handle_channel_sample(state, shard, &batch->samples[i],
+				batch->domain);
+		if (ret) {
+			break;
+		}
+	}
+	pthread_mutex_unlock(&shard->lock);
+	rcu_read_unlock();
+	overload_shedding_update(state);
+	return ret;
+}
+
+/*
+ * Spread the samples of a batch over the queues of the evaluator threads.
+ */
+static
+int distribute_channel_samples(struct notification_thread_state *state,
+		const struct lttcomm_consumer_channel_monitor_batch_msg *batch_msg,
+		enum lttng_domain_type domain)
+{
+	int ret = 0;
+	uint32_t i;
+	struct notification_sample_batch *batches[DEFAULT_NOTIFICATION_THREADS_MAX] = {};
+
+	for (i = 0; i < batch_msg->nb_samples; i++) {
+		struct channel_key key = {
+			.key = batch_msg->samples[i].key,
+			.domain = domain,
+		};
+		unsigned int shard_index =
+				hash_channel_key(&key) % state->nr_shards;
+		struct notification_sample_batch *batch = batches[shard_index];
+
+		if (!batch) {
+			batch = zmalloc(sizeof(*batch));
+			if (!batch) {
+				ret = -1;
+				break;
+			}
+			batch->domain = domain;
+			cds_wfcq_node_init(&batch->node);
+			batches[shard_index] = batch;
+		}
+		batch->samples[batch->nb_samples++] = batch_msg->samples[i];
+	}
+
+	/* The samples already grouped are evaluated even on error. */
+	for (i = 0; i < state->nr_shards; i++) {
+		struct notification_thread_shard *shard = &state->shards[i];
+
+		if (!batches[i]) {
+			continue;
+		}
+		cds_wfcq_enqueue(&shard->queue.head, &shard->queue.tail,
+				&batches[i]->node);
+		futex_nto1_wake(&shard->queue.futex);
+	}
+	return ret;
+}
+
+int handle_notification_thread_channel_sample(
+		struct notification_thread_state *state, int pipe,
+		enum lttng_domain_type domain)
+{
+	int ret;
+	uint32_t i;
+	struct lttcomm_consumer_channel_monitor_batch_msg batch_msg;
+	size_t samples_len;
+
+	/*
+	 * The monitoring pipe only holds messages smaller than PIPE_BUF,
+	 * ensuring that read/write of sampling messages are atomic.
+	 */
+	ret = lttng_read(pipe, &batch_msg.nb_samples,
+			sizeof(batch_msg.nb_samples));
+	if (ret != sizeof(batch_msg.nb_samples)) {
+		goto error_read;
+	}
+	if (batch_msg.nb_samples > LTTCOMM_CONSUMER_CHANNEL_MONITOR_BATCH_MAX) {
+		ERR("[notification-thread] Invalid number of channel samples received from consumerd: %" PRIu32,
+				batch_msg.nb_samples);
+		ret = -1;
+		goto end;
+	}
+	samples_len = batch_msg.nb_samples * sizeof(batch_msg.samples[0]);
+	ret = lttng_read(pipe, batch_msg.samples, samples_len);
+	if (ret != samples_len) {
+		goto error_read;
+	}
+
+	if (state->nr_evaluators) {
+		ret = distribute_channel_samples(state, &batch_msg, domain);
+		goto end;
+	}
+
+	ret = 0;
+	rcu_read_lock();
+	pthread_mutex_lock(&state->shards[0].lock);
+	for (i = 0; i < batch_msg.nb_samples; i++) {
+		ret = handle_channel_sample(state, &state->shards[0],
+				&batch_msg.samples[i], domain);
+		if (ret) {
+			break;
+		}
+	}
+	pthread_mutex_unlock(&state->shards[0].lock);
+	rcu_read_unlock();
+	overload_shedding_update(state);
+	goto end;
+
+error_read:
+	ERR("[notification-thread] Failed to read from monitoring pipe (fd = %i)",
+			pipe);
+	ret = -1;
+end:
+	return ret;
+}
+
+int handle_notification_thread_dispatch(
+		struct notification_thread_state *state)
+{
+	int ret = 0;
+	uint64_t counter;
+	struct cds_wfcq_node *node;
+
+	if (!state->nr_evaluators) {
+		goto end;
+	}
+
+	/* Reset the eventfd before draining to not miss a wake-up. */
+	(void) lttng_read(state->dispatch_queue.event_fd, &counter,
+			sizeof(counter));
+
+	rcu_read_lock();
+	while ((node = __cds_wfcq_dequeue_blocking(&state->dispatch_queue.head,
+			&state->dispatch_queue.tail))) {
+		struct notification_dispatch *dispatch = caa_container_of(node,
+				struct notification_dispatch, node);
+		struct lttng_condition *condition;
+		struct notification_client_list *client_list;
+		struct cds_lfht_iter iter;
+		struct cds_lfht_node *client_list_node;
+
+		condition = lttng_trigger_get_condition(dispatch->trigger);
+		cds_lfht_lookup(state->notification_trigger_clients_ht,
+				lttng_condition_hash(condition),
+				match_client_list,
+				dispatch->trigger,
+				&iter);
+		client_list_node = cds_lfht_iter_get_node(&iter);
+		if (client_list_node && !ret) {
+			client_list = caa_container_of(client_list_node,
+					struct notification_client_list,
+					notification_trigger_ht_node);
+			if (!cds_list_empty(&client_list->list)) {
+				ret = send_evaluation_to_clients(
+						dispatch->trigger,
+						dispatch->evaluation,
+						client_list, state,
+						dispatch->channel_uid,
+						dispatch->channel_gid);
+			}
+		}
+		lttng_evaluation_destroy(dispatch->evaluation);
+		free(dispatch);
+	}
 	rcu_read_unlock();
 end:
 	return ret;
 }
+
+void notification_thread_discard_dispatch(
+		struct notification_thread_state *state)
+{
+	struct cds_wfcq_node *node;
+
+	while ((node = __cds_wfcq_dequeue_blocking(&state->dispatch_queue.head,
+			&state->dispatch_queue.tail))) {
+		struct notification_dispatch *dispatch = caa_container_of(node,
+				struct notification_dispatch, node);
+
+		lttng_evaluation_destroy(dispatch->evaluation);
+		free(dispatch);
+	}
+}
@@ -54,4 +54,18 @@ int handle_notification_thread_channel_sample(
 		struct notification_thread_state *state, int pipe,
 		enum lttng_domain_type domain);
 
+/* Evaluate a batch of samples queued to an evaluator thread. */
+int handle_notification_thread_sample_batch(
+		struct notification_thread_state *state,
+		struct notification_thread_shard *shard,
+		const struct notification_sample_batch *batch);
+
+/* Send the evaluations queued by the evaluator threads to the clients. */
+int handle_notification_thread_dispatch(
+		struct notification_thread_state *state);
+
+/* Release the queued evaluations on teardown. */
+void notification_thread_discard_dispatch(
+		struct notification_thread_state *state);
+
 #endif /* NOTIFICATION_THREAD_EVENTS_H */
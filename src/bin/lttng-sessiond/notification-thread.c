@@ -38,9 +38,11 @@
 #include "lttng-sessiond.h"
 #include "health-sessiond.h"
 
+#include <common/futex.h>
 #include <urcu.h>
 #include <urcu/list.h>
 #include <urcu/rculfhash.h>
+#include <urcu/wfcqueue.h>
 
 /**
  * This thread maintains an internal state associating clients and triggers.
@@ -52,13 +54,13 @@
  *             This hash table owns the "struct client" which must thus be
  *             disposed-of on removal from the hash table.
  *
- *   - channel_triggers_ht:
+ *   - channel_triggers_ht (per shard):
  *             associates a channel key to a list of
  *             struct lttng_trigger_list_nodes. The triggers in this list are
  *             those that have conditions that apply to this channel.
  *             This hash table owns the list, but not the triggers themselves.
  *
- *   - channel_state_ht:
+ *   - channel_state_ht (per shard):
  *             associates a pair (channel key, channel domain) to its last
  *             sampled state received from the consumer daemon
  *             (struct channel_state).
@@ -83,6 +85,32 @@
  *             The hash table holds the ownership of the
  *             lttng_trigger_ht_elements along with the triggers themselves.
  *
+ *   - channels_by_name_ht:
+ *             indexes the struct channel_info by (session name, channel
+ *             name, domain). The channels of the per-PID buffers share the
+ *             same name. This hash table holds no ownership.
+ *
+ *   - triggers_by_channel_ht:
+ *             indexes the struct lttng_trigger_ht_element of the triggers
+ *             applying to a channel by its (session name, channel name,
+ *             domain), so that the triggers and the channels are matched
+ *             with a lookup. This hash table holds no ownership.
+ *
+ *   - triggers_by_session_ht:
+ *             indexes the struct lttng_trigger_ht_element of the triggers
+ *             of which the channel name is a globbing pattern by (session
+ *             name, domain). The channels matching such a trigger share an
+ *             aggregated state, so that the trigger is notified once for
+ *             the session. This hash table holds no ownership.
+ *
+ * The channels are spread over shards by channel key. Each shard holds the
+ * channel_triggers_ht and channel_state_ht of its channels under its lock.
+ * With evaluator threads (--notification-threads), the channel samples are
+ * queued to the thread of their shard, which evaluates the conditions and
+ * queues the resulting evaluations back to this thread: the clients are only
+ * ever handled by this thread. Otherwise, this thread evaluates the samples
+ * of its single shard itself.
+ *
  * The thread reacts to the following internal events:
  *   1) creation of a tracing channel,
  *   2) destruction of a tracing channel,
@@ -101,13 +129,13 @@
  *    - notification_trigger_clients_ht is traversed to identify
  *      triggers which apply to this new channel,
  *    - triggers identified are added to the channel_triggers_ht.
- *    - add channel to channels_ht
+ *    - add channel to channels_ht and channels_by_name_ht
  *
  * 2) Destruction of a tracing channel
  *    - remove entry from channel_triggers_ht, releasing the list wrapper and
  *      elements,
  *    - remove entry from the channel_state_ht.
- *    - remove channel from channels_ht
+ *    - remove channel from channels_ht and channels_by_name_ht
  *
  * 3) Registration of a trigger
  *    - if the trigger's action is of type "notify",
@@ -116,15 +144,18 @@
  *        - add list of clients (even if it is empty) to the
  *          notification_trigger_clients_ht,
  *    - add trigger to channel_triggers_ht (if applicable),
- *    - add trigger to triggers_ht
+ *    - add trigger to triggers_ht and triggers_by_channel_ht (or
+ *      triggers_by_session_ht)
  *
  * 4) Unregistration of a trigger
  *    - if the trigger's action is of type "notify",
  *      - remove the trigger from the notification_trigger_clients_ht,
  *    - remove trigger from channel_triggers_ht (if applicable),
- *    - remove trigger from triggers_ht
+ *    - remove trigger from triggers_ht and triggers_by_channel_ht (or
+ *      triggers_by_session_ht)
  *
  * 5) Reception of a channel monitor sample from the consumer daemon
+ *    - queue the sample to the evaluator thread of its shard (if any),
  *    - evaluate the conditions associated with the triggers found in
  *      the channel_triggers_ht,
  *      - if a condition evaluates to "true" and the condition is of type
@@ -157,6 +188,7 @@ void notification_thread_handle_destroy(
 		struct notification_thread_handle *handle)
 {
 	int ret;
+	struct notification_thread_command *cmd, *tmp;
 
 	if (!handle) {
 		goto end;
@@ -170,7 +202,16 @@ void notification_thread_handle_destroy(
 		PERROR("close notification command queue event_fd");
 	}
 
-	assert(cds_list_empty(&handle->cmd_queue.list));
+	/*
+	 * Only the commands nobody waits for can be left behind by the
+	 * thread, like the removal of the channels destroyed after its exit.
+	 */
+	cds_list_for_each_entry_safe(cmd, tmp, &handle->cmd_queue.list,
+			cmd_list_node) {
+		assert(cmd->is_async);
+		cds_list_del(&cmd->cmd_list_node);
+		notification_thread_command_destroy(cmd);
+	}
 	pthread_mutex_destroy(&handle->cmd_queue.lock);
 
 	if (handle->channel_monitoring_pipes.ust32_consumer >= 0) {
@@ -198,7 +239,8 @@ end:
 struct notification_thread_handle *notification_thread_handle_create(
 		struct lttng_pipe *ust32_channel_monitor_pipe,
 		struct lttng_pipe *ust64_channel_monitor_pipe,
-		struct lttng_pipe *kernel_channel_monitor_pipe)
+		struct lttng_pipe *kernel_channel_monitor_pipe,
+		unsigned int nr_evaluators, int64_t buffer_advisor_rate)
 {
 	int ret;
 	struct notification_thread_handle *handle;
@@ -207,9 +249,12 @@ struct notification_thread_handle *notification_thread_handle_create(
 	if (!handle) {
 		goto end;
 	}
+	handle->nr_evaluators = nr_evaluators;
+	handle->buffer_advisor_rate = buffer_advisor_rate;
+	handle->overload_shedding.high = -1;
 
 	/* FIXME Replace eventfd by a pipe to support older kernels. */
-	handle->cmd_queue.event_fd = eventfd(0, EFD_CLOEXEC | EFD_SEMAPHORE);
+	handle->cmd_queue.event_fd = eventfd(0, EFD_CLOEXEC);
 	if (handle->cmd_queue.event_fd < 0) {
 		PERROR("eventfd notification command queue");
 		goto error;
@@ -367,19 +412,20 @@ error:
 static
 int init_poll_set(struct lttng_poll_event *poll_set,
 		struct notification_thread_handle *handle,
-		int notification_channel_socket)
+		int notification_channel_socket, int dispatch_event_fd)
 {
 	int ret;
 
 	/*
-	 * Create pollset with size 5:
+	 * Create pollset with size 6:
 	 *	- notification channel socket (listen for new connections),
 	 *	- command queue event fd (internal sessiond commands),
+	 *	- dispatch queue event fd (evaluations of the evaluator threads),
 	 *	- consumerd (32-bit user space) channel monitor pipe,
 	 *	- consumerd (64-bit user space) channel monitor pipe,
 	 *	- consumerd (kernel) channel monitor pipe.
 	 */
-	ret = lttng_poll_create(poll_set, 5, LTTNG_CLOEXEC);
+	ret = lttng_poll_create(poll_set, 6, LTTNG_CLOEXEC);
 	if (ret < 0) {
 		goto end;
 	}
@@ -396,6 +442,14 @@ int init_poll_set(struct lttng_poll_event *poll_set,
 		ERR("[notification-thread] Failed to add notification command queue event fd to pollset");
 		goto error;
 	}
+	if (dispatch_event_fd >= 0) {
+		ret = lttng_poll_add(poll_set, dispatch_event_fd,
+				LPOLLIN | LPOLLERR);
+		if (ret < 0) {
+			ERR("[notification-thread] Failed to add notification dispatch event fd to pollset");
+			goto error;
+		}
+	}
 	ret = lttng_poll_add(poll_set,
 			handle->channel_monitoring_pipes.ust32_consumer,
 			LPOLLIN | LPOLLERR);
@@ -427,11 +481,192 @@ error:
 	return ret;
 }
 
+/*
+ * Evaluate the channel samples queued to a shard until the evaluator threads
+ * are stopped.
+ */
+static
+void *thread_notification_evaluator(void *data)
+{
+	struct notification_thread_shard *shard = data;
+
+	rcu_register_thread();
+
+	health_register(health_sessiond,
+			HEALTH_SESSIOND_TYPE_NOTIFICATION_EVALUATOR);
+	health_code_update();
+
+	DBG("[notification-thread] Evaluator thread of shard %u started",
+			(unsigned int) (shard - shard->state->shards));
+
+	for (;;) {
+		int quit;
+		struct cds_wfcq_node *node;
+
+		health_code_update();
+
+		futex_nto1_prepare(&shard->queue.futex);
+		quit = CMM_LOAD_SHARED(shard->state->evaluators_quit);
+
+		while ((node = __cds_wfcq_dequeue_blocking(&shard->queue.head,
+				&shard->queue.tail))) {
+			struct notification_sample_batch *batch =
+					caa_container_of(node,
+						struct notification_sample_batch,
+						node);
+
+			health_code_update();
+			if (handle_notification_thread_sample_batch(
+					shard->state, shard, batch)) {
+				ERR("[notification-thread] Channel sample evaluation error occurred");
+			}
+			free(batch);
+		}
+
+		if (quit) {
+			break;
+		}
+
+		health_poll_entry();
+		futex_nto1_wait(&shard->queue.futex);
+		health_poll_exit();
+	}
+
+	health_unregister(health_sessiond);
+	DBG("[notification-thread] Evaluator thread exiting");
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static
+void stop_evaluator_threads(struct notification_thread_state *state)
+{
+	int ret;
+	unsigned int i;
+
+	CMM_STORE_SHARED(state->evaluators_quit, 1);
+	for (i = 0; i < state->nr_shards; i++) {
+		struct notification_thread_shard *shard = &state->shards[i];
+
+		if (!shard->thread_running) {
+			continue;
+		}
+		futex_nto1_prepare(&shard->queue.futex);
+		futex_nto1_wake(&shard->queue.futex);
+		ret = pthread_join(shard->thread, NULL);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_join notification evaluator thread");
+		}
+		shard->thread_running = false;
+	}
+}
+
+static
+void fini_shards(struct notification_thread_state *state)
+{
+	int ret;
+	unsigned int i;
+	struct cds_wfcq_node *node;
+
+	if (!state->shards) {
+		return;
+	}
+
+	for (i = 0; i < state->nr_shards; i++) {
+		struct notification_thread_shard *shard = &state->shards[i];
+
+		/* Samples left behind by the evaluator thread on exit. */
+		while ((node = __cds_wfcq_dequeue_blocking(&shard->queue.head,
+				&shard->queue.tail))) {
+			free(caa_container_of(node,
+					struct notification_sample_batch, node));
+		}
+		if (shard->channel_triggers_ht) {
+			ret = cds_lfht_destroy(shard->channel_triggers_ht, NULL);
+			assert(!ret);
+		}
+		if (shard->channel_state_ht) {
+			ret = cds_lfht_destroy(shard->channel_state_ht, NULL);
+			assert(!ret);
+		}
+		pthread_mutex_destroy(&shard->lock);
+	}
+	free(state->shards);
+	state->shards = NULL;
+}
+
+static
+int init_shards(struct notification_thread_state *state)
+{
+	int ret = 0;
+	unsigned int i;
+
+	state->shards = zmalloc(state->nr_shards * sizeof(*state->shards));
+	if (!state->shards) {
+		ret = -1;
+		goto end;
+	}
+
+	for (i = 0; i < state->nr_shards; i++) {
+		struct notification_thread_shard *shard = &state->shards[i];
+
+		pthread_mutex_init(&shard->lock, NULL);
+		cds_wfcq_init(&shard->queue.head, &shard->queue.tail);
+		shard->state = state;
+
+		shard->channel_triggers_ht = cds_lfht_new(DEFAULT_HT_SIZE, 1, 0,
+				CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING, NULL);
+		if (!shard->channel_triggers_ht) {
+			ret = -1;
+			goto end;
+		}
+
+		shard->channel_state_ht = cds_lfht_new(DEFAULT_HT_SIZE, 1, 0,
+				CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING, NULL);
+		if (!shard->channel_state_ht) {
+			ret = -1;
+			goto end;
+		}
+	}
+end:
+	return ret;
+}
+
+static
+int start_evaluator_threads(struct notification_thread_state *state)
+{
+	int ret = 0;
+	unsigned int i;
+
+	for (i = 0; i < state->nr_evaluators; i++) {
+		struct notification_thread_shard *shard = &state->shards[i];
+
+		ret = pthread_create(&shard->thread, NULL,
+				thread_notification_evaluator, shard);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_create notification evaluator thread");
+			ret = -1;
+			goto end;
+		}
+		shard->thread_running = true;
+	}
+	DBG("[notification-thread] Started %u evaluator threads",
+			state->nr_evaluators);
+end:
+	return ret;
+}
+
 static
 void fini_thread_state(struct notification_thread_state *state)
 {
 	int ret;
 
+	if (state->shards) {
+		stop_evaluator_threads(state);
+	}
+
 	if (state->client_socket_ht) {
 		ret = handle_notification_thread_client_disconnect_all(state);
 		assert(!ret);
@@ -444,14 +679,15 @@ void fini_thread_state(struct notification_thread_state *state)
 		ret = cds_lfht_destroy(state->triggers_ht, NULL);
 		assert(!ret);
 	}
-	if (state->channel_triggers_ht) {
-		ret = cds_lfht_destroy(state->channel_triggers_ht, NULL);
+	if (state->triggers_by_channel_ht) {
+		ret = cds_lfht_destroy(state->triggers_by_channel_ht, NULL);
 		assert(!ret);
 	}
-	if (state->channel_state_ht) {
-		ret = cds_lfht_destroy(state->channel_state_ht, NULL);
+	if (state->triggers_by_session_ht) {
+		ret = cds_lfht_destroy(state->triggers_by_session_ht, NULL);
 		assert(!ret);
 	}
+	fini_shards(state);
 	if (state->notification_trigger_clients_ht) {
 		ret = cds_lfht_destroy(state->notification_trigger_clients_ht,
 				NULL);
@@ -462,12 +698,25 @@ void fini_thread_state(struct notification_thread_state *state)
 				NULL);
 		assert(!ret);
 	}
+	if (state->channels_by_name_ht) {
+		ret = cds_lfht_destroy(state->channels_by_name_ht, NULL);
+		assert(!ret);
+	}
+
+	notification_thread_discard_dispatch(state);
+	if (state->dispatch_queue.event_fd >= 0) {
+		ret = close(state->dispatch_queue.event_fd);
+		if (ret < 0) {
+			PERROR("close notification dispatch queue event_fd");
+		}
+	}
 
 	if (state->notification_channel_socket >= 0) {
 		notification_channel_socket_destroy(
 				state->notification_channel_socket);
 	}
 	lttng_poll_clean(&state->events);
+	pthread_mutex_destroy(&state->overload.lock);
 }
 
 static
@@ -478,7 +727,15 @@ int init_thread_state(struct notification_thread_handle *handle,
 
 	memset(state, 0, sizeof(*state));
 	state->notification_channel_socket = -1;
+	state->dispatch_queue.event_fd = -1;
+	cds_wfcq_init(&state->dispatch_queue.head, &state->dispatch_queue.tail);
 	lttng_poll_init(&state->events);
+	state->nr_evaluators = handle->nr_evaluators;
+	state->nr_shards = state->nr_evaluators ? state->nr_evaluators : 1;
+	state->buffer_advisor_rate = handle->buffer_advisor_rate;
+	state->consumers = handle->consumers;
+	state->overload_shedding = handle->overload_shedding;
+	pthread_mutex_init(&state->overload.lock, NULL);
 
 	ret = notification_channel_socket_create();
 	if (ret < 0) {
@@ -486,8 +743,18 @@ int init_thread_state(struct notification_thread_handle *handle,
 	}
 	state->notification_channel_socket = ret;
 
+	if (state->nr_evaluators) {
+		state->dispatch_queue.event_fd = eventfd(0,
+				EFD_CLOEXEC | EFD_NONBLOCK);
+		if (state->dispatch_queue.event_fd < 0) {
+			PERROR("eventfd notification dispatch queue");
+			goto error;
+		}
+	}
+
 	ret = init_poll_set(&state->events, handle,
-			state->notification_channel_socket);
+			state->notification_channel_socket,
+			state->dispatch_queue.event_fd);
 	if (ret) {
 		goto end;
 	}
@@ -505,15 +772,8 @@ int init_thread_state(struct notification_thread_handle *handle,
 		goto error;
 	}
 
-	state->channel_triggers_ht = cds_lfht_new(DEFAULT_HT_SIZE, 1, 0,
-			CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING, NULL);
-	if (!state->channel_triggers_ht) {
-		goto error;
-	}
-
-	state->channel_state_ht = cds_lfht_new(DEFAULT_HT_SIZE, 1, 0,
-			CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING, NULL);
-	if (!state->channel_state_ht) {
+	ret = init_shards(state);
+	if (ret) {
 		goto error;
 	}
 
@@ -534,6 +794,29 @@ int init_thread_state(struct notification_thread_handle *handle,
 	if (!state->triggers_ht) {
 		goto error;
 	}
+
+	state->channels_by_name_ht = cds_lfht_new(DEFAULT_HT_SIZE,
+			1, 0, CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING, NULL);
+	if (!state->channels_by_name_ht) {
+		goto error;
+	}
+
+	state->triggers_by_channel_ht = cds_lfht_new(DEFAULT_HT_SIZE,
+			1, 0, CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING, NULL);
+	if (!state->triggers_by_channel_ht) {
+		goto error;
+	}
+
+	state->triggers_by_session_ht = cds_lfht_new(DEFAULT_HT_SIZE,
+			1, 0, CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING, NULL);
+	if (!state->triggers_by_session_ht) {
+		goto error;
+	}
+
+	ret = start_evaluator_threads(state);
+	if (ret) {
+		goto error;
+	}
 end:
 	return 0;
 error:
@@ -652,6 +935,12 @@ void *thread_notification(void *data)
 					ERR("[notification-thread] Unexpected poll events %u for notification socket %i", revents, fd);
 					goto error;
 				}
+			} else if (fd == state.dispatch_queue.event_fd) {
+				ret = handle_notification_thread_dispatch(
+						&state);
+				if (ret) {
+					goto error;
+				}
 			} else if (fd == handle->cmd_queue.event_fd) {
 				ret = handle_notification_thread_command(handle,
 						&state);
@@ -21,11 +21,41 @@
 #include <urcu/list.h>
 #include <urcu.h>
 #include <urcu/rculfhash.h>
+#include <urcu/wfcqueue.h>
 #include <lttng/trigger/trigger.h>
+#include <lttng/domain.h>
 #include <common/pipe.h>
 #include <common/compat/poll.h>
 #include <common/hashtable/hashtable.h>
+#include <common/sessiond-comm/sessiond-comm.h>
 #include <pthread.h>
+#include <stdbool.h>
+
+struct consumer_data;
+
+/*
+ * Consumer daemons spawned by the session daemon, to which the usage
+ * thresholds of the channels are sent. NULL if not set.
+ */
+struct notification_thread_consumers {
+	struct consumer_data *kernel;
+	struct consumer_data *ust32;
+	struct consumer_data *ust64;
+};
+
+/*
+ * Overload shedding: while a channel of priority above 0 of a consumer daemon
+ * is used above "high" percent of its capacity, the consumer stops consuming
+ * its channels of priority 0, until each of them is back under "low" percent.
+ */
+struct notification_overload_shedding {
+	/* Negative if the shedding is disabled. */
+	int high;
+	int low;
+};
+
+/* Index of the kernel and user space domains in the overload state. */
+#define NOTIFICATION_OVERLOAD_DOMAIN_COUNT	2
 
 struct notification_thread_handle {
 	/*
@@ -47,24 +77,107 @@ struct notification_thread_handle {
 		int ust64_consumer;
 		int kernel_consumer;
 	} channel_monitoring_pipes;
+	/* Number of threads evaluating the channel samples. */
+	unsigned int nr_evaluators;
+	/*
+	 * Target rate of discarded events per second of the buffer advisor,
+	 * negative if it is disabled.
+	 */
+	int64_t buffer_advisor_rate;
+	/* Set before the notification thread is launched. */
+	struct notification_thread_consumers consumers;
+	/* Set before the notification thread is launched. */
+	struct notification_overload_shedding overload_shedding;
+};
+
+/*
+ * Channel monitor samples of a shard, queued by the notification thread to
+ * the evaluator thread of the shard.
+ */
+struct notification_sample_batch {
+	enum lttng_domain_type domain;
+	uint32_t nb_samples;
+	struct lttcomm_consumer_channel_monitor_msg samples[
+			LTTCOMM_CONSUMER_CHANNEL_MONITOR_BATCH_MAX];
+	struct cds_wfcq_node node;
+};
+
+/*
+ * The channels are spread over the shards by channel key. Each shard holds
+ * the sampled state and the trigger lists of its channels.
+ */
+struct notification_thread_shard {
+	/*
+	 * Protects the hash tables of the shard, the trigger lists and the
+	 * channel_infos they reference between the notification thread and
+	 * the evaluator thread of the shard.
+	 */
+	pthread_mutex_t lock;
+	struct cds_lfht *channel_triggers_ht;
+	struct cds_lfht *channel_state_ht;
+	/*
+	 * Queue of struct notification_sample_batch. Protected by a futex
+	 * with a scheme N wakers / 1 waiter. See futex.c/.h
+	 */
+	struct {
+		int32_t futex;
+		struct cds_wfcq_head head;
+		struct cds_wfcq_tail tail;
+	} queue;
+	pthread_t thread;
+	bool thread_running;
+	struct notification_thread_state *state;
 };
 
 struct notification_thread_state {
 	int notification_channel_socket;
 	struct lttng_poll_event events;
 	struct cds_lfht *client_socket_ht;
-	struct cds_lfht *channel_triggers_ht;
-	struct cds_lfht *channel_state_ht;
+	/*
+	 * With no evaluator thread, a single shard is evaluated by the
+	 * notification thread itself.
+	 */
+	unsigned int nr_evaluators;
+	unsigned int nr_shards;
+	struct notification_thread_shard *shards;
+	/* See struct notification_thread_handle. */
+	int64_t buffer_advisor_rate;
+	struct notification_thread_consumers consumers;
+	struct notification_overload_shedding overload_shedding;
+	/*
+	 * Overloaded channels of priority above 0 and shedding state last sent
+	 * to the consumers, per domain. The lock serializes the updates of the
+	 * evaluator threads.
+	 */
+	struct {
+		pthread_mutex_t lock;
+		unsigned int nr_overloaded[NOTIFICATION_OVERLOAD_DOMAIN_COUNT];
+		bool shedding[NOTIFICATION_OVERLOAD_DOMAIN_COUNT];
+	} overload;
+	int evaluators_quit;
+	/*
+	 * Evaluations of the evaluator threads, sent to the clients by the
+	 * notification thread. event_fd is written once one is enqueued.
+	 */
+	struct {
+		int event_fd;
+		struct cds_wfcq_head head;
+		struct cds_wfcq_tail tail;
+	} dispatch_queue;
 	struct cds_lfht *notification_trigger_clients_ht;
 	struct cds_lfht *channels_ht;
 	struct cds_lfht *triggers_ht;
+	struct cds_lfht *channels_by_name_ht;
+	struct cds_lfht *triggers_by_channel_ht;
+	struct cds_lfht *triggers_by_session_ht;
 };
 
 /* notification_thread_data takes ownership of the channel monitor pipes. */
 struct notification_thread_handle *notification_thread_handle_create(
 		struct lttng_pipe *ust32_channel_monitor_pipe,
 		struct lttng_pipe *ust64_channel_monitor_pipe,
-		struct lttng_pipe *kernel_channel_monitor_pipe);
+		struct lttng_pipe *kernel_channel_monitor_pipe,
+		unsigned int nr_evaluators, int64_t buffer_advisor_rate);
 void notification_thread_handle_destroy(
 		struct notification_thread_handle *handle);
 
@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <string.h>
+
+#include <common/common.h>
+
+#include "pid-ranges.h"
+
+void pid_ranges_init(struct pid_ranges *set)
+{
+	memset(set, 0, sizeof(*set));
+}
+
+void pid_ranges_fini(struct pid_ranges *set)
+{
+	free(set->ranges);
+	pid_ranges_init(set);
+}
+
+/*
+ * Return the index of the first range ending at or after "pid", or
+ * nb_ranges if none does.
+ */
+static unsigned int first_range_ending_after(const struct pid_ranges *set,
+		int64_t pid)
+{
+	unsigned int low = 0, high = set->nb_ranges;
+
+	while (low < high) {
+		unsigned int mid = low + (high - low) / 2;
+
+		if (set->ranges[mid].end < pid) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	return low;
+}
+
+/*
+ * Replace the "nb_old" ranges from index "i" by the "nb_new" ranges of
+ * "new_ranges".
+ *
+ * Return LTTNG_OK on success or else LTTNG_ERR_NOMEM.
+ */
+static int replace_ranges(struct pid_ranges *set, unsigned int i,
+		unsigned int nb_old, const struct lttng_pid_range *new_ranges,
+		unsigned int nb_new)
+{
+	unsigned int nb_ranges = set->nb_ranges - nb_old + nb_new;
+
+	if (nb_ranges > set->alloc_ranges) {
+		unsigned int alloc_ranges = max_t(unsigned int, 8,
+				set->alloc_ranges << 1);
+		struct lttng_pid_range *ranges;
+
+		ranges = realloc(set->ranges, alloc_ranges * sizeof(*ranges));
+		if (!ranges) {
+			return LTTNG_ERR_NOMEM;
+		}
+		set->ranges = ranges;
+		set->alloc_ranges = alloc_ranges;
+	}
+	memmove(&set->ranges[i + nb_new], &set->ranges[i + nb_old],
+			(set->nb_ranges - i - nb_old) * sizeof(*set->ranges));
+	memcpy(&set->ranges[i], new_ranges, nb_new * sizeof(*set->ranges));
+	set->nb_ranges = nb_ranges;
+	return LTTNG_OK;
+}
+
+bool pid_ranges_lookup(const struct pid_ranges *set, int32_t pid)
+{
+	unsigned int i = first_range_ending_after(set, pid);
+
+	return i < set->nb_ranges && set->ranges[i].start <= pid;
+}
+
+int pid_ranges_add(struct pid_ranges *set, int32_t start, int32_t end,
+		bool *added)
+{
+	unsigned int i, j;
+	struct lttng_pid_range merged = { .start = start, .end = end };
+
+	if (start < 0 || start > end) {
+		return LTTNG_ERR_INVALID;
+	}
+
+	/* Merge with the ranges overlapping or adjacent to the new one. */
+	i = first_range_ending_after(set, (int64_t) start - 1);
+	j = i;
+	while (j < set->nb_ranges &&
+			set->ranges[j].start <= (int64_t) end + 1) {
+		j++;
+	}
+	if (j == i + 1 && set->ranges[i].start <= start &&
+			set->ranges[i].end >= end) {
+		*added = false;
+		return LTTNG_OK;
+	}
+	if (j > i) {
+		merged.start = min(merged.start, set->ranges[i].start);
+		merged.end = max(merged.end, set->ranges[j - 1].end);
+	}
+	*added = true;
+	return replace_ranges(set, i, j - i, &merged, 1);
+}
+
+int pid_ranges_del(struct pid_ranges *set, int32_t start, int32_t end,
+		bool *removed)
+{
+	unsigned int i, j, nb_pieces = 0;
+	struct lttng_pid_range pieces[2];
+
+	if (start < 0 || start > end) {
+		return LTTNG_ERR_INVALID;
+	}
+
+	/* Trim or remove the ranges overlapping the removed one. */
+	i = first_range_ending_after(set, start);
+	j = i;
+	while (j < set->nb_ranges && set->ranges[j].start <= end) {
+		j++;
+	}
+	if (j == i) {
+		*removed = false;
+		return LTTNG_OK;
+	}
+	if (set->ranges[i].start < start) {
+		pieces[nb_pieces].start = set->ranges[i].start;
+		pieces[nb_pieces++].end = start - 1;
+	}
+	if (set->ranges[j - 1].end > end) {
+		pieces[nb_pieces].start = end + 1;
+		pieces[nb_pieces++].end = set->ranges[j - 1].end;
+	}
+	*removed = true;
+	return replace_ranges(set, i, j - i, pieces, nb_pieces);
+}
+
+uint64_t pid_ranges_count(const struct pid_ranges *set)
+{
+	unsigned int i;
+	uint64_t count = 0;
+
+	for (i = 0; i < set->nb_ranges; i++) {
+		count += (uint64_t) set->ranges[i].end - set->ranges[i].start + 1;
+	}
+	return count;
+}
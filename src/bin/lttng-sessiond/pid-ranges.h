@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _LTTNG_PID_RANGES_H
+#define _LTTNG_PID_RANGES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <lttng/lttng.h>
+
+/*
+ * Set of PIDs stored as sorted, disjoint and non-adjacent ranges, so that a
+ * range of thousands of PIDs takes a single entry and a lookup is a binary
+ * search.
+ */
+struct pid_ranges {
+	struct lttng_pid_range *ranges;
+	unsigned int nb_ranges;
+	unsigned int alloc_ranges;
+};
+
+void pid_ranges_init(struct pid_ranges *set);
+void pid_ranges_fini(struct pid_ranges *set);
+
+/*
+ * Return true if "pid" is in the set.
+ */
+bool pid_ranges_lookup(const struct pid_ranges *set, int32_t pid);
+
+/*
+ * Add the PIDs from "start" to "end" included to the set. "added" is set to
+ * whether at least one of them was not already in the set.
+ *
+ * Return LTTNG_OK on success or else LTTNG_ERR_INVALID or LTTNG_ERR_NOMEM,
+ * the set being left unchanged.
+ */
+int pid_ranges_add(struct pid_ranges *set, int32_t start, int32_t end,
+		bool *added);
+
+/*
+ * Remove the PIDs from "start" to "end" included from the set. "removed" is
+ * set to whether at least one of them was in the set.
+ *
+ * Return LTTNG_OK on success or else LTTNG_ERR_INVALID or LTTNG_ERR_NOMEM,
+ * the set being left unchanged.
+ */
+int pid_ranges_del(struct pid_ranges *set, int32_t start, int32_t end,
+		bool *removed);
+
+/*
+ * Return the number of PIDs in the set.
+ */
+uint64_t pid_ranges_count(const struct pid_ranges *set);
+
+#endif /* _LTTNG_PID_RANGES_H */
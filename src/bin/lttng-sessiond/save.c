@@ -18,7 +18,9 @@
 #define _LGPL_SOURCE
 #include <assert.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <string.h>
+#include <urcu.h>
 #include <urcu/uatomic.h>
 #include <unistd.h>
 
@@ -30,12 +32,31 @@
 #include <lttng/save-internal.h>
 
 #include "kernel.h"
+#include "lttng-sessiond.h"
 #include "save.h"
 #include "session.h"
 #include "syscall.h"
 #include "trace-ust.h"
 #include "agent.h"
 
+static
+const char *get_compression_string(
+	enum lttng_channel_compression compression)
+{
+	const char *compression_string;
+
+	switch (compression) {
+	case LTTNG_CHANNEL_COMPRESSION_ZLIB:
+		compression_string = config_compression_zlib;
+		break;
+	case LTTNG_CHANNEL_COMPRESSION_NONE:
+	default:
+		compression_string = config_compression_none;
+	}
+
+	return compression_string;
+}
+
 static
 int save_kernel_channel_attributes(struct config_writer *writer,
 	struct lttng_channel_attr *attr)
@@ -122,6 +143,13 @@ int save_kernel_channel_attributes(struct config_writer *writer,
 		if (ret) {
 			goto end;
 		}
+
+		ret = config_writer_write_element_string(writer,
+				config_element_compression,
+				get_compression_string(ext->compression));
+		if (ret) {
+			goto end;
+		}
 	}
 
 end:
@@ -197,6 +225,19 @@ int save_ust_channel_attributes(struct config_writer *writer,
 		goto end;
 	}
 
+	ret = config_writer_write_element_string(writer,
+		config_element_compression,
+		get_compression_string(channel->compression));
+	if (ret) {
+		goto end;
+	}
+
+	ret = config_writer_write_element_bool(writer,
+		config_element_huge_pages, channel->huge_pages);
+	if (ret) {
+		goto end;
+	}
+
 end:
 	return ret ? LTTNG_ERR_SAVE_IO_FAIL : 0;
 }
@@ -1892,7 +1933,9 @@ int save_session(struct ltt_session *session,
 {
 	int ret, fd;
 	unsigned int file_opened = 0;	/* Indicate if the file has been opened */
+	unsigned int tmp_file_created = 0;
 	char config_file_path[PATH_MAX];
+	char tmp_file_path[PATH_MAX];
 	size_t len;
 	struct config_writer *writer = NULL;
 	size_t session_name_len;
@@ -1976,17 +2019,20 @@ int save_session(struct ltt_session *session,
 		goto end;
 	}
 
-	fd = run_as_open(config_file_path, O_CREAT | O_WRONLY | O_TRUNC,
-		S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP,
-		LTTNG_SOCK_GET_UID_CRED(creds), LTTNG_SOCK_GET_GID_CRED(creds));
-	if (fd < 0) {
-		PERROR("Could not create configuration file");
-		ret = LTTNG_ERR_SAVE_IO_FAIL;
+	/*
+	 * The XML document is built in memory and written at once to a
+	 * temporary file renamed over the configuration file, which is thus
+	 * never seen partially written.
+	 */
+	ret = snprintf(tmp_file_path, sizeof(tmp_file_path), "%s.tmp",
+			config_file_path);
+	if (ret < 0 || ret >= sizeof(tmp_file_path)) {
+		ret = LTTNG_ERR_SET_URL;
 		goto end;
 	}
-	file_opened = 1;
 
-	writer = config_writer_create(fd, 1);
+	writer = attr->binary ? config_writer_create_binary() :
+			config_writer_create_buffer(1);
 	if (!writer) {
 		ret = LTTNG_ERR_NOMEM;
 		goto end;
@@ -2082,6 +2128,39 @@ int save_session(struct ltt_session *session,
 		ret = LTTNG_ERR_SAVE_IO_FAIL;
 		goto end;
 	}
+
+	fd = run_as_open(tmp_file_path, O_CREAT | O_WRONLY | O_TRUNC,
+		S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP,
+		LTTNG_SOCK_GET_UID_CRED(creds), LTTNG_SOCK_GET_GID_CRED(creds));
+	if (fd < 0) {
+		PERROR("Could not create configuration file");
+		ret = LTTNG_ERR_SAVE_IO_FAIL;
+		goto end;
+	}
+	file_opened = 1;
+	tmp_file_created = 1;
+
+	ret = config_writer_write_buffer(writer, fd);
+	if (ret) {
+		ret = LTTNG_ERR_SAVE_IO_FAIL;
+		goto end;
+	}
+
+	file_opened = 0;
+	ret = close(fd);
+	if (ret) {
+		PERROR("Closing XML session configuration");
+		ret = LTTNG_ERR_SAVE_IO_FAIL;
+		goto end;
+	}
+
+	ret = run_as_rename(tmp_file_path, config_file_path,
+		LTTNG_SOCK_GET_UID_CRED(creds), LTTNG_SOCK_GET_GID_CRED(creds));
+	if (ret) {
+		PERROR("Renaming XML session configuration");
+		ret = LTTNG_ERR_SAVE_IO_FAIL;
+		goto end;
+	}
 end:
 	if (writer && config_writer_destroy(writer)) {
 		/* Preserve the original error code */
@@ -2089,14 +2168,13 @@ end:
 	}
 	if (ret) {
 		/* Delete file in case of error */
-		if (file_opened && unlink(config_file_path)) {
+		if (tmp_file_created && unlink(tmp_file_path)) {
 			PERROR("Unlinking XML session configuration.");
 		}
 	}
 
 	if (file_opened) {
-		ret = close(fd);
-		if (ret) {
+		if (close(fd)) {
 			PERROR("Closing XML session configuration");
 		}
 	}
@@ -2104,6 +2182,136 @@ end:
 	return ret;
 }
 
+/* Sessions of a save command shared by the save workers. */
+struct save_work {
+	struct ltt_session **sessions;
+	unsigned long nr_sessions;
+	/* Index of the next session to save. */
+	unsigned long next;
+	struct lttng_save_session_attr *attr;
+	lttng_sock_cred *creds;
+	/* First error, the sessions saved after it are skipped. */
+	int ret;
+};
+
+/*
+ * Save the sessions of a save command until none is left or one fails.
+ *
+ * The session list lock is held by the caller of save_sessions(): it keeps the
+ * sessions from being destroyed, so that they are locked outside of any RCU
+ * read-side critical section, see session_lock_alive().
+ */
+static
+void save_work_run(struct save_work *work)
+{
+	for (;;) {
+		int ret;
+		unsigned long i;
+		struct ltt_session *session;
+
+		i = uatomic_add_return(&work->next, 1) - 1;
+		if (i >= work->nr_sessions || uatomic_read(&work->ret)) {
+			break;
+		}
+		session = work->sessions[i];
+
+		/* Skip the sessions being created. */
+		if (!session_lock_alive(session)) {
+			continue;
+		}
+		ret = save_session(session, work->attr, work->creds);
+		session_unlock(session);
+
+		/* Don't abort if we don't have the required permissions. */
+		if (ret && ret != LTTNG_ERR_EPERM) {
+			(void) uatomic_cmpxchg(&work->ret, 0, ret);
+			break;
+		}
+	}
+}
+
+static
+void *thread_save_sessions(void *data)
+{
+	rcu_register_thread();
+	save_work_run(data);
+	rcu_unregister_thread();
+	return NULL;
+}
+
+/*
+ * Save every session of the session list on up to save_threads threads, the
+ * calling thread included.
+ *
+ * The session list lock MUST be acquired.
+ *
+ * Return 0 on success else a LTTNG_ERR* code.
+ */
+static
+int save_sessions(struct lttng_save_session_attr *attr, lttng_sock_cred *creds)
+{
+	int ret;
+	unsigned int i, nr_threads, nr_started = 0;
+	pthread_t *threads = NULL;
+	struct ltt_session *session;
+	struct ltt_session_list *list = session_get_list();
+	struct save_work work = {
+		.attr = attr,
+		.creds = creds,
+	};
+
+	cds_list_for_each_entry(session, &list->head, list) {
+		work.nr_sessions++;
+	}
+	if (!work.nr_sessions) {
+		goto end;
+	}
+
+	work.sessions = zmalloc(work.nr_sessions * sizeof(*work.sessions));
+	if (!work.sessions) {
+		PERROR("zmalloc save sessions");
+		work.ret = LTTNG_ERR_NOMEM;
+		goto end;
+	}
+	i = 0;
+	cds_list_for_each_entry(session, &list->head, list) {
+		work.sessions[i++] = session;
+	}
+
+	nr_threads = min_t(unsigned long, save_threads, work.nr_sessions);
+	if (nr_threads > 1) {
+		threads = zmalloc((nr_threads - 1) * sizeof(*threads));
+		if (!threads) {
+			PERROR("zmalloc save threads");
+		}
+	}
+	for (i = 0; threads && i < nr_threads - 1; i++) {
+		ret = pthread_create(&threads[i], NULL, thread_save_sessions,
+				&work);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_create save thread");
+			/* Save with the threads started so far. */
+			break;
+		}
+		nr_started++;
+	}
+
+	save_work_run(&work);
+
+	for (i = 0; i < nr_started; i++) {
+		ret = pthread_join(threads[i], NULL);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_join save thread");
+		}
+	}
+	free(threads);
+	free(work.sessions);
+end:
+	return work.ret;
+}
+
 int cmd_save_sessions(struct lttng_save_session_attr *attr,
 	lttng_sock_cred *creds)
 {
@@ -2116,29 +2324,20 @@ int cmd_save_sessions(struct lttng_save_session_attr *attr,
 	session_name = lttng_save_session_attr_get_session_name(attr);
 	if (session_name) {
 		session = session_find_by_name(session_name);
-		if (!session) {
+		if (!session || !session_lock_alive(session)) {
 			ret = LTTNG_ERR_SESS_NOT_FOUND;
 			goto end;
 		}
 
-		session_lock(session);
 		ret = save_session(session, attr, creds);
 		session_unlock(session);
 		if (ret) {
 			goto end;
 		}
 	} else {
-		struct ltt_session_list *list = session_get_list();
-
-		cds_list_for_each_entry(session, &list->head, list) {
-			session_lock(session);
-			ret = save_session(session, attr, creds);
-			session_unlock(session);
-
-			/* Don't abort if we don't have the required permissions. */
-			if (ret && ret != LTTNG_ERR_EPERM) {
-				goto end;
-			}
+		ret = save_sessions(attr, creds);
+		if (ret) {
+			goto end;
 		}
 	}
 	ret = LTTNG_OK;
@@ -21,6 +21,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <sys/stat.h>
 #include <urcu.h>
 #include <dirent.h>
@@ -55,8 +56,13 @@ static struct ltt_session_list ltt_session_list = {
 /* These characters are forbidden in a session name. Used by validate_name. */
 static const char *forbidden_name_chars = "/";
 
-/* Global hash table to keep the sessions, indexed by id. */
+/*
+ * Global hash tables of the sessions indexed by id and by name. They are
+ * looked up without the session list lock, so they are kept for the lifetime
+ * of the daemon once allocated.
+ */
 static struct lttng_ht *ltt_sessions_ht_by_id = NULL;
+static struct lttng_ht *ltt_sessions_ht_by_name = NULL;
 
 /*
  * Validate the session name for forbidden characters.
@@ -101,7 +107,7 @@ static uint64_t add_session_list(struct ltt_session *ls)
 {
 	assert(ls);
 
-	cds_list_add(&ls->list, &ltt_session_list.head);
+	cds_list_add_rcu(&ls->list, &ltt_session_list.head);
 	return ltt_session_list.next_uuid++;
 }
 
@@ -114,7 +120,9 @@ static void del_session_list(struct ltt_session *ls)
 {
 	assert(ls);
 
-	cds_list_del(&ls->list);
+	/* Seen by the iterations resuming from this session, see removed. */
+	CMM_STORE_SHARED(ls->removed, true);
+	cds_list_del_rcu(&ls->list);
 }
 
 /*
@@ -149,32 +157,20 @@ void session_unlock_list(void)
 int ltt_sessions_ht_alloc(void)
 {
 	int ret = 0;
+	struct lttng_ht *ht;
 
 	DBG("Allocating ltt_sessions_ht_by_id");
-	ltt_sessions_ht_by_id = lttng_ht_new(0, LTTNG_HT_TYPE_U64);
-	if (!ltt_sessions_ht_by_id) {
+	ht = lttng_ht_new(0, LTTNG_HT_TYPE_U64);
+	if (!ht) {
 		ret = -1;
 		ERR("Failed to allocate ltt_sessions_ht_by_id");
 		goto end;
 	}
+	rcu_assign_pointer(ltt_sessions_ht_by_id, ht);
 end:
 	return ret;
 }
 
-/*
- * Destroy the ltt_sessions_ht_by_id HT.
- *
- * The session list lock must be held.
- */
-static void ltt_sessions_ht_destroy(void)
-{
-	if (!ltt_sessions_ht_by_id) {
-		return;
-	}
-	ht_cleanup_push(ltt_sessions_ht_by_id);
-	ltt_sessions_ht_by_id = NULL;
-}
-
 /*
  * Add a ltt_session to the ltt_sessions_ht_by_id.
  * If unallocated, the ltt_sessions_ht_by_id HT is allocated.
@@ -194,52 +190,100 @@ static void add_session_ht(struct ltt_session *ls)
 		}
 	}
 	lttng_ht_node_init_u64(&ls->node, ls->id);
+	rcu_read_lock();
 	lttng_ht_add_unique_u64(ltt_sessions_ht_by_id, &ls->node);
+	rcu_read_unlock();
 
 end:
 	return;
 }
 
 /*
- * Test if ltt_sessions_ht_by_id is empty.
- * Return 1 if empty, 0 if not empty.
+ * Remove a ltt_session from the ltt_sessions_ht_by_id.
  * The session list lock must be held.
  */
-static int ltt_sessions_ht_empty(void)
+static void del_session_ht(struct ltt_session *ls)
 {
+	struct lttng_ht_iter iter;
 	int ret;
 
-	if (!ltt_sessions_ht_by_id) {
-		ret = 1;
-		goto end;
-	}
+	assert(ls);
+	assert(ltt_sessions_ht_by_id);
 
-	ret = lttng_ht_get_count(ltt_sessions_ht_by_id) ? 0 : 1;
-end:
-	return ret;
+	rcu_read_lock();
+	iter.iter.node = &ls->node.node;
+	ret = lttng_ht_del(ltt_sessions_ht_by_id, &iter);
+	assert(!ret);
+	rcu_read_unlock();
 }
 
 /*
- * Remove a ltt_session from the ltt_sessions_ht_by_id.
- * If empty, the ltt_sessions_ht_by_id HT is freed.
+ * Add a ltt_session to the ltt_sessions_ht_by_name, allocating it on first
+ * use.
+ *
+ * The session list lock must be held. Return 0 on success or else -1.
+ */
+static int add_session_ht_by_name(struct ltt_session *ls)
+{
+	assert(ls);
+
+	if (!ltt_sessions_ht_by_name) {
+		struct lttng_ht *ht;
+
+		DBG("Allocating ltt_sessions_ht_by_name");
+		ht = lttng_ht_new(0, LTTNG_HT_TYPE_STRING);
+		if (!ht) {
+			ERR("Failed to allocate ltt_sessions_ht_by_name");
+			return -1;
+		}
+		rcu_assign_pointer(ltt_sessions_ht_by_name, ht);
+	}
+	lttng_ht_node_init_str(&ls->node_by_name, ls->name);
+	rcu_read_lock();
+	lttng_ht_add_unique_str(ltt_sessions_ht_by_name, &ls->node_by_name);
+	rcu_read_unlock();
+	return 0;
+}
+
+/*
+ * Remove a ltt_session from the ltt_sessions_ht_by_name.
+ *
  * The session list lock must be held.
  */
-static void del_session_ht(struct ltt_session *ls)
+static void del_session_ht_by_name(struct ltt_session *ls)
 {
 	struct lttng_ht_iter iter;
 	int ret;
 
 	assert(ls);
-	assert(ltt_sessions_ht_by_id);
+	assert(ltt_sessions_ht_by_name);
 
-	iter.iter.node = &ls->node.node;
-	ret = lttng_ht_del(ltt_sessions_ht_by_id, &iter);
+	rcu_read_lock();
+	iter.iter.node = &ls->node_by_name.node;
+	ret = lttng_ht_del(ltt_sessions_ht_by_name, &iter);
 	assert(!ret);
+	rcu_read_unlock();
+}
+
+/*
+ * Look up a session by name in the ltt_sessions_ht_by_name. The RCU read-side
+ * lock must be held.
+ */
+static struct ltt_session *lookup_session_by_name(const char *name)
+{
+	struct lttng_ht *ht = rcu_dereference(ltt_sessions_ht_by_name);
+	struct lttng_ht_node_str *node;
+	struct lttng_ht_iter iter;
 
-	if (ltt_sessions_ht_empty()) {
-		DBG("Empty ltt_sessions_ht_by_id, destroying it");
-		ltt_sessions_ht_destroy();
+	if (!ht) {
+		return NULL;
+	}
+	lttng_ht_lookup(ht, (void *) name, &iter);
+	node = lttng_ht_iter_get_node_str(&iter);
+	if (!node) {
+		return NULL;
 	}
+	return caa_container_of(node, struct ltt_session, node_by_name);
 }
 
 /*
@@ -252,6 +296,184 @@ void session_lock(struct ltt_session *session)
 	pthread_mutex_lock(&session->lock);
 }
 
+/*
+ * Acquire the lock of a session kept from being reclaimed by the session list
+ * lock held by the caller, or by a reference of the lock-free lookups.
+ *
+ * Return 1 if the session is locked or else 0 if it is not created yet or
+ * being destroyed, in which case it MUST NOT be used.
+ *
+ * This MUST NOT be called within a RCU read-side critical section: the lock
+ * of a session can be held for the whole duration of a long command, which
+ * would delay the grace periods of the whole daemon. The sessions found
+ * without the session list lock are locked with session_lock_next_alive(),
+ * session_lock_by_name() or session_lock_by_id() instead, which never wait
+ * for a session lock within the read-side critical section.
+ */
+int session_lock_alive(struct ltt_session *session)
+{
+	assert(session);
+
+	pthread_mutex_lock(&session->lock);
+	if (!session->alive) {
+		pthread_mutex_unlock(&session->lock);
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * Get a reference on a session found within a RCU read-side critical section,
+ * keeping its memory from being reclaimed once the critical section is left.
+ *
+ * Return true on success or else false if the session is being reclaimed.
+ */
+static bool session_get(struct ltt_session *session)
+{
+	return urcu_ref_get_unless_zero(&session->ref);
+}
+
+static void free_session_rcu(struct rcu_head *head)
+{
+	struct ltt_session *session =
+		caa_container_of(head, struct ltt_session, rcu_node);
+
+	pthread_mutex_destroy(&session->lock);
+	free(session);
+}
+
+static void session_release(struct urcu_ref *ref)
+{
+	struct ltt_session *session =
+		caa_container_of(ref, struct ltt_session, ref);
+
+	call_rcu(&session->rcu_node, free_session_rcu);
+}
+
+static void session_put(struct ltt_session *session)
+{
+	urcu_ref_put(&session->ref, session_release);
+}
+
+/*
+ * Lock a session referenced by the caller, outside of any RCU read-side
+ * critical section, and release the reference.
+ *
+ * Return the locked session or else NULL if it is not created yet or being
+ * destroyed.
+ */
+static struct ltt_session *session_lock_ref(struct ltt_session *session)
+{
+	if (!session_lock_alive(session)) {
+		session_put(session);
+		return NULL;
+	}
+	/* The session list keeps a reference on a locked alive session. */
+	session_put(session);
+	return session;
+}
+
+/*
+ * Return the session following the last one of the iteration in the session
+ * list with a reference, or else NULL at the end of the list. The sessions
+ * being reclaimed are skipped.
+ *
+ * The RCU read-side lock MUST be held.
+ */
+static struct ltt_session *session_list_iter_next(
+		struct ltt_session_list_iter *iter)
+{
+	struct cds_list_head *pos;
+	struct ltt_session *session;
+
+	if (!iter->session) {
+		pos = rcu_dereference(ltt_session_list.head.next);
+	} else if (!CMM_LOAD_SHARED(iter->session->removed)) {
+		/*
+		 * The successors of a session in the list can't be reclaimed
+		 * before the end of this critical section.
+		 */
+		pos = rcu_dereference(iter->session->list.next);
+	} else {
+		/*
+		 * Removed from the list since: its successors may have been
+		 * reclaimed, so resume from the first older session. The ids
+		 * decrease along the list.
+		 */
+		cds_list_for_each_entry_rcu(session, &ltt_session_list.head,
+				list) {
+			if (session->id < iter->id) {
+				break;
+			}
+		}
+		pos = &session->list;
+	}
+
+	for (; pos != &ltt_session_list.head; pos = rcu_dereference(pos->next)) {
+		session = cds_list_entry(pos, struct ltt_session, list);
+		if (session_get(session)) {
+			return session;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Lock the next alive session of the session list, iterated without the
+ * session list lock, and return it or else NULL once the whole list was
+ * iterated. The returned session MUST be unlocked before the next call. The
+ * sessions created during the iteration are not returned.
+ *
+ * The iteration keeps a reference on the last session returned to resume
+ * from it: session_list_iter_fini() MUST be called if the iteration is
+ * stopped before NULL is returned.
+ *
+ * MUST NOT be called within a RCU read-side critical section.
+ */
+struct ltt_session *session_lock_next_alive(
+		struct ltt_session_list_iter *iter)
+{
+	struct ltt_session *session, *prev;
+
+	assert(iter);
+
+	do {
+		rcu_read_lock();
+		session = session_list_iter_next(iter);
+		rcu_read_unlock();
+
+		prev = iter->session;
+		iter->session = session;
+		if (prev) {
+			session_put(prev);
+		}
+		if (!session) {
+			break;
+		}
+		iter->id = session->id;
+		/*
+		 * Wait for the lock of the referenced session outside of the
+		 * critical section.
+		 */
+	} while (!session_lock_alive(session));
+
+	return session;
+}
+
+/*
+ * Release the reference of an iteration of the session list stopped before
+ * session_lock_next_alive() returned NULL.
+ */
+void session_list_iter_fini(struct ltt_session_list_iter *iter)
+{
+	assert(iter);
+
+	if (iter->session) {
+		session_put(iter->session);
+		iter->session = NULL;
+	}
+}
+
 /*
  * Release session lock
  */
@@ -265,44 +487,99 @@ void session_unlock(struct ltt_session *session)
 /*
  * Return a ltt_session structure ptr that matches name. If no session found,
  * NULL is returned. This must be called with the session list lock held using
- * session_lock_list and session_unlock_list.
+ * session_lock_list and session_unlock_list, or within a RCU read-side
+ * critical section, in which case see session_lock_alive().
  */
 struct ltt_session *session_find_by_name(const char *name)
 {
-	struct ltt_session *iter;
+	struct ltt_session *session;
 
 	assert(name);
 
 	DBG2("Trying to find session by name %s", name);
 
-	cds_list_for_each_entry(iter, &ltt_session_list.head, list) {
-		if (strncmp(iter->name, name, NAME_MAX) == 0) {
-			goto found;
-		}
+	rcu_read_lock();
+	session = lookup_session_by_name(name);
+	rcu_read_unlock();
+
+	return session;
+}
+
+/*
+ * Return the locked ltt_session structure ptr that matches name. If no session
+ * is found, NULL is returned. The session list lock MUST NOT be held: the
+ * lookup is lock-free.
+ */
+struct ltt_session *session_lock_by_name(const char *name)
+{
+	struct ltt_session *session;
+
+	assert(name);
+
+	DBG2("Trying to find and lock session by name %s", name);
+
+	rcu_read_lock();
+	session = lookup_session_by_name(name);
+	if (session && !session_get(session)) {
+		session = NULL;
+	}
+	rcu_read_unlock();
+
+	return session ? session_lock_ref(session) : NULL;
+}
+
+/*
+ * Return the locked ltt_session structure ptr that matches id. If no session
+ * is found, NULL is returned. The session list lock MUST NOT be held: the
+ * lookup is lock-free.
+ */
+struct ltt_session *session_lock_by_id(uint64_t id)
+{
+	struct ltt_session *session;
+
+	DBG2("Trying to find and lock session by id %" PRIu64, id);
+
+	rcu_read_lock();
+	session = session_find_by_id(id);
+	if (session && !session_get(session)) {
+		session = NULL;
 	}
+	rcu_read_unlock();
 
-	iter = NULL;
+	return session ? session_lock_ref(session) : NULL;
+}
 
-found:
-	return iter;
+/*
+ * Make a newly created session visible to the lock-free lookups once it is
+ * completely set up.
+ */
+void session_publish(struct ltt_session *session)
+{
+	assert(session);
+
+	session_lock(session);
+	session->alive = 1;
+	session_unlock(session);
 }
 
 /*
  * Return an ltt_session that matches the id. If no session is found,
  * NULL is returned. This must be called with rcu_read_lock and
- * session list lock held (to guarantee the lifetime of the session).
+ * session list lock held (to guarantee the lifetime of the session), or see
+ * session_lock_by_id().
  */
 struct ltt_session *session_find_by_id(uint64_t id)
 {
+	struct lttng_ht *ht = rcu_dereference(ltt_sessions_ht_by_id);
 	struct lttng_ht_node_u64 *node;
 	struct lttng_ht_iter iter;
 	struct ltt_session *ls;
 
-	if (!ltt_sessions_ht_by_id) {
+	if (!ht) {
 		goto end;
 	}
 
-	lttng_ht_lookup(ltt_sessions_ht_by_id, &id, &iter);
+	lttng_ht_lookup(ht, &id, &iter);
 	node = lttng_ht_iter_get_node_u64(&iter);
 	if (node == NULL) {
 		goto end;
@@ -318,8 +595,10 @@ end:
 }
 
 /*
- * Delete session from the session list and free the memory.
+ * Delete session from the session list and free the memory once the lock-free
+ * readers are done with it.
  *
+ * The session MUST not be alive anymore and its lock MUST NOT be held.
  * Return -1 if no session is found.  On success, return 1;
  * Should *NOT* be called with RCU read-side lock held.
  */
@@ -327,15 +606,17 @@ int session_destroy(struct ltt_session *session)
 {
 	/* Safety check */
 	assert(session);
+	assert(!session->alive);
 
 	DBG("Destroying session %s", session->name);
 	del_session_list(session);
-	pthread_mutex_destroy(&session->lock);
 	del_session_ht(session);
+	del_session_ht_by_name(session);
 
 	consumer_output_put(session->consumer);
 	snapshot_destroy(&session->snapshot);
-	free(session);
+	/* Release the reference of the session list. */
+	session_put(session);
 
 	return LTTNG_OK;
 }
@@ -390,6 +671,8 @@ int session_create(char *name, uid_t uid, gid_t gid)
 
 	/* Init lock */
 	pthread_mutex_init(&new_session->lock, NULL);
+	/* Reference of the session list. */
+	urcu_ref_init(&new_session->ref);
 
 	new_session->uid = uid;
 	new_session->gid = gid;
@@ -402,6 +685,18 @@ int session_create(char *name, uid_t uid, gid_t gid)
 
 	/* Add new session to the session list */
 	session_lock_list();
+	if (session_find_by_name(name)) {
+		session_unlock_list();
+		snapshot_destroy(&new_session->snapshot);
+		ret = LTTNG_ERR_EXIST_SESS;
+		goto error;
+	}
+	if (add_session_ht_by_name(new_session)) {
+		session_unlock_list();
+		snapshot_destroy(&new_session->snapshot);
+		ret = LTTNG_ERR_NOMEM;
+		goto error;
+	}
 	new_session->id = add_session_list(new_session);
 	/*
 	 * Add the new session to the ltt_sessions_ht_by_id.
@@ -19,7 +19,10 @@
 #define _LTT_SESSION_H
 
 #include <limits.h>
+#include <stdbool.h>
 #include <urcu/list.h>
+#include <urcu/ref.h>
+#include <urcu/rculist.h>
 
 #include <common/hashtable/hashtable.h>
 
@@ -36,11 +39,15 @@ struct ltt_ust_session;
  */
 struct ltt_session_list {
 	/*
-	 * This lock protects any read/write access to the list and
-	 * next_uuid. All public functions in session.c acquire this
-	 * lock and release it before returning. If none of those
-	 * functions are used, the lock MUST be acquired in order to
-	 * iterate or/and do any actions on that list.
+	 * This lock protects any write access to the list and next_uuid,
+	 * and serializes the commands changing the sessions. All public
+	 * functions in session.c acquire this lock and release it before
+	 * returning, unless stated otherwise.
+	 *
+	 * The list is RCU-protected: it can also be iterated without this
+	 * lock with session_lock_next_alive(), or with
+	 * cds_list_for_each_entry_rcu() within a RCU read-side critical
+	 * section to read only the name, id, uid and gid of the sessions.
 	 */
 	pthread_mutex_t lock;
 
@@ -69,6 +76,7 @@ struct ltt_session {
 	 * session_lock() and session_unlock() for that.
 	 */
 	pthread_mutex_t lock;
+	/* Node in the session list. See struct ltt_session_list. */
 	struct cds_list_head list;
 	uint64_t id;		/* session unique identifier */
 	/* UID/GID of the user owning the session */
@@ -113,22 +121,66 @@ struct ltt_session {
 	 * Path where to keep the shared memory files.
 	 */
 	char shm_path[PATH_MAX];
+	/*
+	 * Number of rotations of the session and output path of its first trace
+	 * chunk, from which the default paths of the next trace chunks derive.
+	 */
+	uint64_t rotation_count;
+	char rotation_base_path[PATH_MAX];
 	/*
 	 * Node in ltt_sessions_ht_by_id.
 	 */
 	struct lttng_ht_node_u64 node;
+	/*
+	 * Node in ltt_sessions_ht_by_name.
+	 */
+	struct lttng_ht_node_str node_by_name;
+	/*
+	 * Set once the creation of the session is complete and cleared when it
+	 * is destroyed, with the session lock held.
+	 */
+	unsigned int alive:1;
+	/* Set, without the session lock, once removed from the session list. */
+	bool removed;
+	/*
+	 * Held by the session list and by the lock-free lookups waiting for
+	 * the session lock. The session memory is reclaimed after a grace
+	 * period once the last reference is released.
+	 */
+	struct urcu_ref ref;
+	struct rcu_head rcu_node;
+};
+
+/*
+ * Cursor of session_lock_next_alive(), initialized with
+ * SESSION_LIST_ITER_INIT.
+ */
+struct ltt_session_list_iter {
+	/* Last session returned, referenced until the next call. */
+	struct ltt_session *session;
+	/* Id of the last session returned. */
+	uint64_t id;
 };
+#define SESSION_LIST_ITER_INIT	{ .session = NULL, .id = UINT64_MAX }
 
 /* Prototypes */
 int session_create(char *name, uid_t uid, gid_t gid);
 int session_destroy(struct ltt_session *session);
 
 void session_lock(struct ltt_session *session);
+int session_lock_alive(struct ltt_session *session);
 void session_lock_list(void);
 void session_unlock(struct ltt_session *session);
 void session_unlock_list(void);
 
+struct ltt_session *session_lock_next_alive(
+		struct ltt_session_list_iter *iter);
+void session_list_iter_fini(struct ltt_session_list_iter *iter);
+
 struct ltt_session *session_find_by_name(const char *name);
+struct ltt_session *session_lock_by_name(const char *name);
+struct ltt_session *session_lock_by_id(uint64_t id);
+void session_publish(struct ltt_session *session);
 struct ltt_session *session_find_by_id(uint64_t id);
 struct ltt_session_list *session_get_list(void);
 
@@ -44,6 +44,11 @@ struct snapshot_output {
 	 * for the directory output.
 	 */
 	char datetime[16];
+	/*
+	 * Only write the packets produced since the last snapshot to this
+	 * output. Set for the duration of a snapshot record.
+	 */
+	int incremental;
 
 	/* Indexed by ID. */
 	struct lttng_ht_node_ulong node;
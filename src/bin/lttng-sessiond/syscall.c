@@ -151,6 +151,41 @@ error_ioctl:
 	return ret;
 }
 
+/*
+ * Number of bits of a syscall mask, one per entry of the syscall table.
+ */
+uint32_t syscall_table_mask_len(void)
+{
+	return syscall_table_nb_entry;
+}
+
+/*
+ * Set the bits of the syscalls named name, of every bitness, in a syscall
+ * mask of syscall_table_mask_len() bits laid out like the masks of the kernel
+ * tracer. The mask may be NULL to only look the syscalls up.
+ *
+ * Return the number of syscalls found.
+ */
+unsigned int syscall_table_mask_set(const char *name, char *mask)
+{
+	size_t i;
+	unsigned int found = 0;
+
+	assert(name);
+
+	for (i = 0; i < syscall_table_nb_entry; i++) {
+		if (strcmp(syscall_table[i].name, name)) {
+			continue;
+		}
+		if (mask) {
+			bitfield_write_be(mask, char, i, 1, 1);
+		}
+		found++;
+	}
+
+	return found;
+}
+
 /*
  * Helper function for the list syscalls command that empty the temporary
  * syscall hashtable used to track duplicate between 32 and 64 bit arch.
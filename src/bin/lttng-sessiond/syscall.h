@@ -54,4 +54,8 @@ extern struct syscall *syscall_table;
 int syscall_init_table(void);
 ssize_t syscall_table_list(struct lttng_event **events);
 
+/* Use to build the syscall masks of kernel channels. */
+uint32_t syscall_table_mask_len(void);
+unsigned int syscall_table_mask_set(const char *name, char *mask);
+
 #endif /* SYSCALL_H */
@@ -28,6 +28,7 @@
 #include "trace-kernel.h"
 #include "lttng-sessiond.h"
 #include "notification-thread-commands.h"
+#include "utils.h"
 
 /*
  * Find the channel name for the given kernel session.
@@ -35,7 +36,9 @@
 struct ltt_kernel_channel *trace_kernel_get_channel_by_name(
 		char *name, struct ltt_kernel_session *session)
 {
-	struct ltt_kernel_channel *chan;
+	struct lttng_ht_node_str *node;
+	struct lttng_ht_iter iter;
+	struct ltt_kernel_channel *chan = NULL;
 
 	assert(session);
 	assert(name);
@@ -49,14 +52,92 @@ struct ltt_kernel_channel *trace_kernel_get_channel_by_name(
 
 	DBG("Trying to find channel %s", name);
 
-	cds_list_for_each_entry(chan, &session->channel_list.head, list) {
-		if (strcmp(name, chan->channel->name) == 0) {
-			DBG("Found channel by name %s", name);
-			return chan;
+	rcu_read_lock();
+	lttng_ht_lookup(session->channels_by_name, (void *) name, &iter);
+	node = lttng_ht_iter_get_node_str(&iter);
+	if (node) {
+		chan = caa_container_of(node, struct ltt_kernel_channel, node);
+		DBG("Found channel by name %s", name);
+	}
+	rcu_read_unlock();
+
+	return chan;
+}
+
+/*
+ * Match function of the events_by_name HT lookups by the name only.
+ */
+static int ht_match_event_by_name(struct cds_lfht_node *node, const void *key)
+{
+	struct lttng_ht_node_str *event_node =
+			caa_container_of(node, struct lttng_ht_node_str, node);
+
+	return strcmp(event_node->key, key) == 0;
+}
+
+/*
+ * Return whether an event matches the type and the filter. The type
+ * LTTNG_EVENT_ALL matches any event type, and a NULL filter pointer with
+ * match_filter set matches the events without filter only.
+ */
+static bool event_matches(struct ltt_kernel_event *ev,
+		enum lttng_event_type type, bool match_filter,
+		struct lttng_filter_bytecode *filter)
+{
+	if (type != LTTNG_EVENT_ALL && ev->type != type) {
+		return false;
+	}
+	if (!match_filter) {
+		return true;
+	}
+	if ((ev->filter && !filter) || (!ev->filter && filter)) {
+		return false;
+	}
+	if (ev->filter && filter) {
+		if (ev->filter->len != filter->len ||
+				memcmp(ev->filter->data, filter->data,
+					filter->len) != 0) {
+			return false;
 		}
 	}
+	return true;
+}
 
-	return NULL;
+/*
+ * Find, among the events of the channel with the given name, the first one
+ * matching the type and, if match_filter is set, the filter.
+ */
+static struct ltt_kernel_event *lookup_event(char *name,
+		struct ltt_kernel_channel *channel, enum lttng_event_type type,
+		bool match_filter, struct lttng_filter_bytecode *filter)
+{
+	struct lttng_ht *ht = channel->events_by_name;
+	struct lttng_ht_node_str *node;
+	struct lttng_ht_iter iter;
+	struct ltt_kernel_event *ev = NULL;
+
+	rcu_read_lock();
+	cds_lfht_lookup(ht->ht, ht->hash_fct((void *) name, lttng_ht_seed),
+			ht_match_event_by_name, name, &iter.iter);
+	for (node = lttng_ht_iter_get_node_str(&iter); node;
+			cds_lfht_next_duplicate(ht->ht, ht_match_event_by_name,
+				name, &iter.iter),
+			node = lttng_ht_iter_get_node_str(&iter)) {
+		struct ltt_kernel_event *candidate = caa_container_of(node,
+				struct ltt_kernel_event, node);
+
+		if (event_matches(candidate, type, match_filter, filter)) {
+			ev = candidate;
+			break;
+		}
+	}
+	rcu_read_unlock();
+
+	if (ev) {
+		DBG("Found event %s for channel %s", name,
+			channel->channel->name);
+	}
+	return ev;
 }
 
 /*
@@ -67,39 +148,10 @@ struct ltt_kernel_event *trace_kernel_find_event(
 		enum lttng_event_type type,
 		struct lttng_filter_bytecode *filter)
 {
-	struct ltt_kernel_event *ev;
-	int found = 0;
-
 	assert(name);
 	assert(channel);
 
-	cds_list_for_each_entry(ev, &channel->events_list.head, list) {
-		if (type != LTTNG_EVENT_ALL && ev->type != type) {
-			continue;
-		}
-		if (strcmp(name, ev->event->name)) {
-			continue;
-		}
-		if ((ev->filter && !filter) || (!ev->filter && filter)) {
-			continue;
-		}
-		if (ev->filter && filter) {
-			if (ev->filter->len != filter->len ||
-					memcmp(ev->filter->data, filter->data,
-						filter->len) != 0) {
-				continue;
-			}
-		}
-		found = 1;
-		break;
-	}
-	if (found) {
-		DBG("Found event %s for channel %s", name,
-			channel->channel->name);
-		return ev;
-	} else {
-		return NULL;
-	}
+	return lookup_event(name, channel, type, true, filter);
 }
 
 /*
@@ -109,29 +161,44 @@ struct ltt_kernel_event *trace_kernel_get_event_by_name(
 		char *name, struct ltt_kernel_channel *channel,
 		enum lttng_event_type type)
 {
-	struct ltt_kernel_event *ev;
-	int found = 0;
-
 	assert(name);
 	assert(channel);
 
-	cds_list_for_each_entry(ev, &channel->events_list.head, list) {
-		if (type != LTTNG_EVENT_ALL && ev->type != type) {
-			continue;
-		}
-		if (strcmp(name, ev->event->name)) {
-			continue;
-		}
-		found = 1;
-		break;
-	}
-	if (found) {
-		DBG("Found event %s for channel %s", name,
-			channel->channel->name);
-		return ev;
-	} else {
-		return NULL;
-	}
+	return lookup_event(name, channel, type, false, NULL);
+}
+
+/*
+ * Add a channel to the channel list and name HT of a kernel session.
+ */
+void trace_kernel_add_channel(struct ltt_kernel_session *session,
+		struct ltt_kernel_channel *channel)
+{
+	assert(session);
+	assert(channel);
+
+	cds_list_add(&channel->list, &session->channel_list.head);
+	rcu_read_lock();
+	lttng_ht_add_unique_str(session->channels_by_name, &channel->node);
+	rcu_read_unlock();
+	session->channel_count++;
+	channel->session = session;
+}
+
+/*
+ * Add an event to the event list and name HT of a kernel channel.
+ */
+void trace_kernel_add_event(struct ltt_kernel_channel *channel,
+		struct ltt_kernel_event *event)
+{
+	assert(channel);
+	assert(event);
+
+	cds_list_add(&event->list, &channel->events_list.head);
+	rcu_read_lock();
+	lttng_ht_add_str(channel->events_by_name, &event->node);
+	rcu_read_unlock();
+	channel->event_count++;
+	event->channel = channel;
 }
 
 /*
@@ -157,6 +224,10 @@ struct ltt_kernel_session *trace_kernel_create_session(void)
 	lks->stream_count_global = 0;
 	lks->metadata = NULL;
 	CDS_INIT_LIST_HEAD(&lks->channel_list.head);
+	lks->channels_by_name = lttng_ht_new(0, LTTNG_HT_TYPE_STRING);
+	if (!lks->channels_by_name) {
+		goto error;
+	}
 
 	lks->consumer = consumer_create_output(CONSUMER_DST_LOCAL);
 	if (lks->consumer == NULL) {
@@ -166,6 +237,7 @@ struct ltt_kernel_session *trace_kernel_create_session(void)
 	return lks;
 
 error:
+	ht_cleanup_push(lks->channels_by_name);
 	free(lks);
 
 alloc_error:
@@ -226,11 +298,19 @@ struct ltt_kernel_channel *trace_kernel_create_channel(
 	CDS_INIT_LIST_HEAD(&lkc->events_list.head);
 	CDS_INIT_LIST_HEAD(&lkc->stream_list.head);
 	CDS_INIT_LIST_HEAD(&lkc->ctx_list);
+	lkc->events_by_name = lttng_ht_new(0, LTTNG_HT_TYPE_STRING);
+	if (!lkc->events_by_name) {
+		goto error;
+	}
+	lttng_ht_node_init_str(&lkc->node, lkc->channel->name);
 
 	return lkc;
 
 error:
 	if (lkc) {
+		if (lkc->channel) {
+			free(lkc->channel->attr.extended.ptr);
+		}
 		free(lkc->channel);
 	}
 	free(extended);
@@ -332,6 +412,7 @@ struct ltt_kernel_event *trace_kernel_create_event(struct lttng_event *ev,
 	lke->enabled = 1;
 	lke->filter_expression = filter_expression;
 	lke->filter = filter;
+	lttng_ht_node_init_str(&lke->node, attr->name);
 
 	return lke;
 
@@ -442,6 +523,23 @@ void trace_kernel_destroy_stream(struct ltt_kernel_stream *stream)
 	free(stream);
 }
 
+static void free_event(struct ltt_kernel_event *event)
+{
+	free(event->filter_expression);
+	free(event->filter);
+
+	free(event->event);
+	free(event);
+}
+
+static void free_event_rcu(struct rcu_head *head)
+{
+	struct lttng_ht_node_str *node =
+			caa_container_of(head, struct lttng_ht_node_str, head);
+
+	free_event(caa_container_of(node, struct ltt_kernel_event, node));
+}
+
 /*
  * Cleanup kernel event structure.
  */
@@ -465,11 +563,20 @@ void trace_kernel_destroy_event(struct ltt_kernel_event *event)
 	/* Remove from event list */
 	cds_list_del(&event->list);
 
-	free(event->filter_expression);
-	free(event->filter);
+	if (event->channel) {
+		struct lttng_ht_iter iter;
+		int ret;
 
-	free(event->event);
-	free(event);
+		/* The HT may still reference the node for a grace period. */
+		rcu_read_lock();
+		iter.iter.node = &event->node.node;
+		ret = lttng_ht_del(event->channel->events_by_name, &iter);
+		assert(!ret);
+		rcu_read_unlock();
+		call_rcu(&event->node.head, free_event_rcu);
+	} else {
+		free_event(event);
+	}
 }
 
 /*
@@ -483,6 +590,21 @@ void trace_kernel_destroy_context(struct ltt_kernel_context *ctx)
 	free(ctx);
 }
 
+static void free_channel(struct ltt_kernel_channel *channel)
+{
+	free(channel->channel->attr.extended.ptr);
+	free(channel->channel);
+	free(channel);
+}
+
+static void free_channel_rcu(struct rcu_head *head)
+{
+	struct lttng_ht_node_str *node =
+			caa_container_of(head, struct lttng_ht_node_str, head);
+
+	free_channel(caa_container_of(node, struct ltt_kernel_channel, node));
+}
+
 /*
  * Cleanup kernel channel structure.
  */
@@ -522,6 +644,7 @@ void trace_kernel_destroy_channel(struct ltt_kernel_channel *channel)
 
 	/* Remove from channel list */
 	cds_list_del(&channel->list);
+	ht_cleanup_push(channel->events_by_name);
 
 	if (notification_thread_handle
 			&& channel->published_to_notification_thread) {
@@ -530,9 +653,18 @@ void trace_kernel_destroy_channel(struct ltt_kernel_channel *channel)
 				channel->fd, LTTNG_DOMAIN_KERNEL);
 		assert(status == LTTNG_OK);
 	}
-	free(channel->channel->attr.extended.ptr);
-	free(channel->channel);
-	free(channel);
+	if (channel->session) {
+		struct lttng_ht_iter iter;
+
+		rcu_read_lock();
+		iter.iter.node = &channel->node.node;
+		ret = lttng_ht_del(channel->session->channels_by_name, &iter);
+		assert(!ret);
+		rcu_read_unlock();
+		call_rcu(&channel->node.head, free_channel_rcu);
+	} else {
+		free_channel(channel);
+	}
 }
 
 /*
@@ -597,5 +729,6 @@ void trace_kernel_destroy_session(struct ltt_kernel_session *session)
 	/* Wipe consumer output object */
 	consumer_output_put(session->consumer);
 
+	ht_cleanup_push(session->channels_by_name);
 	free(session);
 }
@@ -24,6 +24,7 @@
 #include <common/lttng-kernel.h>
 #include <common/lttng-kernel-old.h>
 #include <common/defaults.h>
+#include <common/hashtable/hashtable.h>
 
 #include "consumer.h"
 
@@ -54,8 +55,17 @@ struct ltt_kernel_event {
 	enum lttng_event_type type;
 	struct lttng_kernel_event *event;
 	struct cds_list_head list;
+	/* Node in the events_by_name HT of its channel, keyed by name. */
+	struct lttng_ht_node_str node;
+	/* Channel indexing the event, NULL until it is added to it. */
+	struct ltt_kernel_channel *channel;
 	char *filter_expression;
 	struct lttng_filter_bytecode *filter;
+	/*
+	 * System call traced through the syscall mask of its channel rather
+	 * than an event of the kernel tracer, in which case fd is -1.
+	 */
+	bool in_syscall_mask;
 };
 
 /* Kernel channel */
@@ -68,11 +78,17 @@ struct ltt_kernel_channel {
 	struct cds_list_head ctx_list;
 	struct lttng_channel *channel;
 	struct ltt_kernel_event_list events_list;
+	/* Events of events_list indexed by name, with duplicates. */
+	struct lttng_ht *events_by_name;
 	struct ltt_kernel_stream_list stream_list;
 	struct cds_list_head list;
+	/* Node in the channels_by_name HT of its session. */
+	struct lttng_ht_node_str node;
 	/* Session pointer which has a reference to this object. */
 	struct ltt_kernel_session *session;
 	bool sent_to_consumer;
+	/* The syscall mask changed since it was last applied. */
+	bool syscall_mask_dirty;
 };
 
 /* Metadata */
@@ -103,6 +119,8 @@ struct ltt_kernel_session {
 	unsigned int stream_count_global;
 	struct ltt_kernel_metadata *metadata;
 	struct ltt_kernel_channel_list channel_list;
+	/* Channels of channel_list indexed by name. */
+	struct lttng_ht *channels_by_name;
 	/* UID/GID of the user owning the session */
 	uid_t uid;
 	gid_t gid;
@@ -130,6 +148,14 @@ struct ltt_kernel_event *trace_kernel_find_event(
 struct ltt_kernel_channel *trace_kernel_get_channel_by_name(
 		char *name, struct ltt_kernel_session *session);
 
+/*
+ * Add functions insert the object in the list and hash table of its parent.
+ */
+void trace_kernel_add_channel(struct ltt_kernel_session *session,
+		struct ltt_kernel_channel *channel);
+void trace_kernel_add_event(struct ltt_kernel_channel *channel,
+		struct ltt_kernel_event *event);
+
 /*
  * Create functions malloc() the data structure.
  */
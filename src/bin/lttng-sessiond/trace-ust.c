@@ -27,6 +27,8 @@
 #include <common/defaults.h>
 
 #include "buffer-registry.h"
+#include "filter-store.h"
+#include "pid-ranges.h"
 #include "trace-ust.h"
 #include "utils.h"
 #include "ust-app.h"
@@ -360,6 +362,10 @@ struct ltt_ust_channel *trace_ust_create_channel(struct lttng_channel *chan,
 			chan->attr.extended.ptr)->monitor_timer_interval;
 	luc->attr.u.s.blocking_timeout = ((struct lttng_channel_extended *)
 			chan->attr.extended.ptr)->blocking_timeout;
+	luc->compression = ((struct lttng_channel_extended *)
+			chan->attr.extended.ptr)->compression;
+	luc->huge_pages = ((struct lttng_channel_extended *)
+			chan->attr.extended.ptr)->huge_pages;
 
 	/* Translate to UST output enum */
 	switch (luc->attr.output) {
@@ -431,6 +437,212 @@ end:
 	return ret;
 }
 
+/*
+ * Return the length of the literal prefix of a globbing pattern, up to its
+ * first star or escape character.
+ */
+static size_t pattern_literal_len(const char *pattern)
+{
+	return strcspn(pattern, "*\\");
+}
+
+/*
+ * Return 1 if a name can match both globbing patterns "a" and "b", based on
+ * their literal prefixes, or else 0.
+ */
+static int patterns_may_intersect(const char *a, const char *b)
+{
+	size_t len = min(pattern_literal_len(a), pattern_literal_len(b));
+
+	return !strncmp(a, b, len);
+}
+
+/*
+ * Return 1 if every name matching the exclusion "b" also matches the
+ * exclusion "a", that is "a" is a prefix followed by a star, or else 0.
+ */
+static int exclusion_implies(const char *a, const char *b)
+{
+	size_t len = pattern_literal_len(a);
+
+	if (a[len] != '*' || a[len + 1] != '\0') {
+		return 0;
+	}
+	return pattern_literal_len(b) >= len && !strncmp(a, b, len);
+}
+
+static int compare_exclusion_names(const void *a, const void *b)
+{
+	return strncmp(a, b, LTTNG_SYMBOL_NAME_LEN);
+}
+
+/*
+ * Compile the exclusion list sent to the applications for the event name
+ * "event_name". The tracers test the exclusions of an event against every
+ * tracepoint it matches, which is quadratic with the wildcard events having
+ * hundreds of exclusions.
+ *
+ * Return 0 on success, setting "uexclusion->compiled", or else a negative
+ * value.
+ */
+static int compile_exclusion(struct ltt_ust_exclusion *uexclusion,
+		const char *event_name)
+{
+	size_t i, j, count = 0;
+	struct lttng_event_exclusion *exclusion = uexclusion->exclusion;
+	struct lttng_event_exclusion *compiled;
+
+	compiled = zmalloc(sizeof(*compiled) +
+			exclusion->count * LTTNG_SYMBOL_NAME_LEN);
+	if (!compiled) {
+		PERROR("zmalloc exclusion");
+		return -1;
+	}
+
+	for (i = 0; i < exclusion->count; i++) {
+		const char *name = LTTNG_EVENT_EXCLUSION_NAME_AT(exclusion, i);
+
+		if (!patterns_may_intersect(event_name, name)) {
+			continue;
+		}
+		/* The names are unique: two names can't imply each other. */
+		for (j = 0; j < exclusion->count; j++) {
+			if (j != i && exclusion_implies(
+					LTTNG_EVENT_EXCLUSION_NAME_AT(exclusion, j),
+					name)) {
+				break;
+			}
+		}
+		if (j < exclusion->count) {
+			continue;
+		}
+		memcpy(LTTNG_EVENT_EXCLUSION_NAME_AT(compiled, count), name,
+				LTTNG_SYMBOL_NAME_LEN);
+		count++;
+	}
+
+	if (!count) {
+		free(compiled);
+		uexclusion->compiled = NULL;
+		goto end;
+	}
+	compiled->count = count;
+	qsort(compiled->names, count, LTTNG_SYMBOL_NAME_LEN,
+			compare_exclusion_names);
+	uexclusion->compiled = compiled;
+	DBG2("Compiled %zu of %" PRIu32 " exclusions of UST event %s", count,
+			exclusion->count, event_name);
+end:
+	return 0;
+}
+
+/*
+ * Create the shared exclusion list of the event name "event_name". We own
+ * exclusion.
+ *
+ * Return pointer to structure or NULL.
+ */
+static struct ltt_ust_exclusion *create_exclusion(const char *event_name,
+		struct lttng_event_exclusion *exclusion)
+{
+	struct ltt_ust_exclusion *uexclusion;
+
+	uexclusion = zmalloc(sizeof(*uexclusion));
+	if (!uexclusion) {
+		PERROR("zmalloc ust exclusion");
+		goto error;
+	}
+	urcu_ref_init(&uexclusion->ref);
+	uexclusion->exclusion = exclusion;
+	if (compile_exclusion(uexclusion, event_name)) {
+		goto error;
+	}
+	return uexclusion;
+
+error:
+	free(uexclusion);
+	free(exclusion);
+	return NULL;
+}
+
+static void release_exclusion(struct urcu_ref *ref)
+{
+	struct ltt_ust_exclusion *uexclusion =
+			caa_container_of(ref, struct ltt_ust_exclusion, ref);
+
+	free(uexclusion->compiled);
+	free(uexclusion->exclusion);
+	free(uexclusion);
+}
+
+struct ltt_ust_exclusion *trace_ust_exclusion_get(
+		struct ltt_ust_exclusion *uexclusion)
+{
+	if (uexclusion) {
+		urcu_ref_get(&uexclusion->ref);
+	}
+	return uexclusion;
+}
+
+void trace_ust_exclusion_put(struct ltt_ust_exclusion *uexclusion)
+{
+	if (uexclusion) {
+		urcu_ref_put(&uexclusion->ref, release_exclusion);
+	}
+}
+
+/*
+ * Create the configuration of an event shared with the applications, with
+ * references on its filter and exclusions.
+ *
+ * Return pointer to structure or NULL.
+ */
+static struct ltt_ust_event_conf *create_event_conf(
+		struct ltt_ust_event *event)
+{
+	struct ltt_ust_event_conf *conf;
+
+	conf = zmalloc(sizeof(*conf));
+	if (!conf) {
+		PERROR("zmalloc ust event conf");
+		return NULL;
+	}
+	urcu_ref_init(&conf->ref);
+	memcpy(&conf->attr, &event->attr, sizeof(conf->attr));
+	if (event->filter) {
+		conf->filter = filter_store_get(event->filter);
+	}
+	conf->uexclusion = trace_ust_exclusion_get(event->uexclusion);
+	conf->exclusion = event->exclusion;
+	return conf;
+}
+
+static void release_event_conf(struct urcu_ref *ref)
+{
+	struct ltt_ust_event_conf *conf =
+			caa_container_of(ref, struct ltt_ust_event_conf, ref);
+
+	filter_store_put(conf->filter);
+	trace_ust_exclusion_put(conf->uexclusion);
+	free(conf);
+}
+
+struct ltt_ust_event_conf *trace_ust_event_conf_get(
+		struct ltt_ust_event_conf *conf)
+{
+	if (conf) {
+		urcu_ref_get(&conf->ref);
+	}
+	return conf;
+}
+
+void trace_ust_event_conf_put(struct ltt_ust_event_conf *conf)
+{
+	if (conf) {
+		urcu_ref_put(&conf->ref, release_event_conf);
+	}
+}
+
 /*
  * Allocate and initialize a ust event. Set name and event type.
  * We own filter_expression, filter, and exclusion.
@@ -499,10 +711,30 @@ struct ltt_ust_event *trace_ust_create_event(struct lttng_event *ev,
 		goto error_free_event;
 	}
 
+	if (filter) {
+		lue->filter = filter_store_add(filter);
+		filter = NULL;
+		if (!lue->filter) {
+			goto error_free_event;
+		}
+	}
+
+	if (exclusion) {
+		lue->uexclusion = create_exclusion(lue->attr.name, exclusion);
+		exclusion = NULL;
+		if (!lue->uexclusion) {
+			goto error_free_event;
+		}
+		lue->exclusion = lue->uexclusion->exclusion;
+	}
+
+	lue->conf = create_event_conf(lue);
+	if (!lue->conf) {
+		goto error_free_event;
+	}
+
 	/* Same layout. */
 	lue->filter_expression = filter_expression;
-	lue->filter = filter;
-	lue->exclusion = exclusion;
 
 	/* Init node */
 	lttng_ht_node_init_str(&lue->node, lue->attr.name);
@@ -514,6 +746,8 @@ struct ltt_ust_event *trace_ust_create_event(struct lttng_event *ev,
 	return lue;
 
 error_free_event:
+	filter_store_put(lue->filter);
+	trace_ust_exclusion_put(lue->uexclusion);
 	free(lue);
 error:
 	free(filter_expression);
@@ -671,34 +905,14 @@ error:
 	return NULL;
 }
 
+/*
+ * Enable the PID tracker of the session, initially tracking no PID.
+ */
 static
-void destroy_pid_tracker_node_rcu(struct rcu_head *head)
-{
-	struct ust_pid_tracker_node *tracker_node =
-		caa_container_of(head, struct ust_pid_tracker_node, node.head);
-	free(tracker_node);
-}
-
-static
-void destroy_pid_tracker_node(struct ust_pid_tracker_node *tracker_node)
-{
-
-	call_rcu(&tracker_node->node.head, destroy_pid_tracker_node_rcu);
-}
-
-static
-int init_pid_tracker(struct ust_pid_tracker *pid_tracker)
+void init_pid_tracker(struct ust_pid_tracker *pid_tracker)
 {
-	int ret = 0;
-
-	pid_tracker->ht = lttng_ht_new(0, LTTNG_HT_TYPE_ULONG);
-	if (!pid_tracker->ht) {
-		ret = -1;
-		goto end;
-	}
-
-end:
-	return ret;
+	pid_ranges_init(&pid_tracker->pids);
+	pid_tracker->enabled = 1;
 }
 
 /*
@@ -707,94 +921,8 @@ end:
 static
 void fini_pid_tracker(struct ust_pid_tracker *pid_tracker)
 {
-	struct ust_pid_tracker_node *tracker_node;
-	struct lttng_ht_iter iter;
-
-	if (!pid_tracker->ht) {
-		return;
-	}
-	rcu_read_lock();
-	cds_lfht_for_each_entry(pid_tracker->ht->ht,
-			&iter.iter, tracker_node, node.node) {
-		int ret = lttng_ht_del(pid_tracker->ht, &iter);
-
-		assert(!ret);
-		destroy_pid_tracker_node(tracker_node);
-	}
-	rcu_read_unlock();
-	ht_cleanup_push(pid_tracker->ht);
-	pid_tracker->ht = NULL;
-}
-
-static
-struct ust_pid_tracker_node *pid_tracker_lookup(
-		struct ust_pid_tracker *pid_tracker, int pid,
-		struct lttng_ht_iter *iter)
-{
-	unsigned long _pid = (unsigned long) pid;
-	struct lttng_ht_node_ulong *node;
-
-	lttng_ht_lookup(pid_tracker->ht, (void *) _pid, iter);
-	node = lttng_ht_iter_get_node_ulong(iter);
-	if (node) {
-		return caa_container_of(node, struct ust_pid_tracker_node,
-			node);
-	} else {
-		return NULL;
-	}
-}
-
-static
-int pid_tracker_add_pid(struct ust_pid_tracker *pid_tracker, int pid)
-{
-	int retval = LTTNG_OK;
-	struct ust_pid_tracker_node *tracker_node;
-	struct lttng_ht_iter iter;
-
-	if (pid < 0) {
-		retval = LTTNG_ERR_INVALID;
-		goto end;
-	}
-	tracker_node = pid_tracker_lookup(pid_tracker, pid, &iter);
-	if (tracker_node) {
-		/* Already exists. */
-		retval = LTTNG_ERR_PID_TRACKED;
-		goto end;
-	}
-	tracker_node = zmalloc(sizeof(*tracker_node));
-	if (!tracker_node) {
-		retval = LTTNG_ERR_NOMEM;
-		goto end;
-	}
-	lttng_ht_node_init_ulong(&tracker_node->node, (unsigned long) pid);
-	lttng_ht_add_unique_ulong(pid_tracker->ht, &tracker_node->node);
-end:
-	return retval;
-}
-
-static
-int pid_tracker_del_pid(struct ust_pid_tracker *pid_tracker, int pid)
-{
-	int retval = LTTNG_OK, ret;
-	struct ust_pid_tracker_node *tracker_node;
-	struct lttng_ht_iter iter;
-
-	if (pid < 0) {
-		retval = LTTNG_ERR_INVALID;
-		goto end;
-	}
-	tracker_node = pid_tracker_lookup(pid_tracker, pid, &iter);
-	if (!tracker_node) {
-		/* Not found */
-		retval = LTTNG_ERR_PID_NOT_TRACKED;
-		goto end;
-	}
-	ret = lttng_ht_del(pid_tracker->ht, &iter);
-	assert(!ret);
-
-	destroy_pid_tracker_node(tracker_node);
-end:
-	return retval;
+	pid_ranges_fini(&pid_tracker->pids);
+	pid_tracker->enabled = 0;
 }
 
 /*
@@ -802,15 +930,10 @@ end:
  */
 int trace_ust_pid_tracker_lookup(struct ltt_ust_session *session, int pid)
 {
-	struct lttng_ht_iter iter;
-
-	if (!session->pid_tracker.ht) {
+	if (!session->pid_tracker.enabled) {
 		return 1;
 	}
-	if (pid_tracker_lookup(&session->pid_tracker, pid, &iter)) {
-		return 1;
-	}
-	return 0;
+	return pid_ranges_lookup(&session->pid_tracker.pids, pid);
 }
 
 /*
@@ -822,22 +945,20 @@ int trace_ust_track_pid(struct ltt_ust_session *session, int pid)
 
 	if (pid == -1) {
 		/* Track all pids: destroy tracker if exists. */
-		if (session->pid_tracker.ht) {
+		if (session->pid_tracker.enabled) {
 			fini_pid_tracker(&session->pid_tracker);
 			/* Ensure all apps have session. */
 			ust_app_global_update_all(session);
 		}
 	} else {
 		int ret;
+		bool added;
 
-		if (!session->pid_tracker.ht) {
+		if (!session->pid_tracker.enabled) {
 			/* Create tracker. */
-			if (init_pid_tracker(&session->pid_tracker)) {
-				ERR("Error initializing PID tracker");
-				retval = LTTNG_ERR_NOMEM;
-				goto end;
-			}
-			ret = pid_tracker_add_pid(&session->pid_tracker, pid);
+			init_pid_tracker(&session->pid_tracker);
+			ret = pid_ranges_add(&session->pid_tracker.pids, pid,
+					pid, &added);
 			if (ret != LTTNG_OK) {
 				retval = ret;
 				fini_pid_tracker(&session->pid_tracker);
@@ -848,11 +969,17 @@ int trace_ust_track_pid(struct ltt_ust_session *session, int pid)
 		} else {
 			struct ust_app *app;
 
-			ret = pid_tracker_add_pid(&session->pid_tracker, pid);
+			ret = pid_ranges_add(&session->pid_tracker.pids, pid,
+					pid, &added);
 			if (ret != LTTNG_OK) {
 				retval = ret;
 				goto end;
 			}
+			if (!added) {
+				/* Already exists. */
+				retval = LTTNG_ERR_PID_TRACKED;
+				goto end;
+			}
 			/* Add session to application */
 			app = ust_app_find_by_pid(pid);
 			if (app) {
@@ -872,36 +999,34 @@ int trace_ust_untrack_pid(struct ltt_ust_session *session, int pid)
 	int retval = LTTNG_OK;
 
 	if (pid == -1) {
-		/* Create empty tracker, replace old tracker. */
-		struct ust_pid_tracker tmp_tracker;
-
-		tmp_tracker = session->pid_tracker;
-		if (init_pid_tracker(&session->pid_tracker)) {
-			ERR("Error initializing PID tracker");
-			retval = LTTNG_ERR_NOMEM;
-			/* Rollback operation. */
-			session->pid_tracker = tmp_tracker;
-			goto end;
-		}
-		fini_pid_tracker(&tmp_tracker);
+		/* Replace the old tracker by an empty one. */
+		fini_pid_tracker(&session->pid_tracker);
+		init_pid_tracker(&session->pid_tracker);
 
 		/* Remove session from all applications */
 		ust_app_global_update_all(session);
 	} else {
 		int ret;
+		bool removed;
 		struct ust_app *app;
 
-		if (!session->pid_tracker.ht) {
+		if (!session->pid_tracker.enabled) {
 			/* No PID being tracked. */
 			retval = LTTNG_ERR_PID_NOT_TRACKED;
 			goto end;
 		}
 		/* Remove PID from tracker */
-		ret = pid_tracker_del_pid(&session->pid_tracker, pid);
+		ret = pid_ranges_del(&session->pid_tracker.pids, pid, pid,
+				&removed);
 		if (ret != LTTNG_OK) {
 			retval = ret;
 			goto end;
 		}
+		if (!removed) {
+			/* Not found */
+			retval = LTTNG_ERR_PID_NOT_TRACKED;
+			goto end;
+		}
 		/* Remove session from application. */
 		app = ust_app_find_by_pid(pid);
 		if (app) {
@@ -912,48 +1037,122 @@ end:
 	return retval;
 }
 
+/*
+ * Track the PIDs of many ranges with a single update of the applications.
+ * The PIDs already tracked are ignored.
+ *
+ * Called with the session lock held.
+ */
+int trace_ust_track_pid_ranges(struct ltt_ust_session *session,
+		const struct lttng_pid_range *ranges, unsigned int nb_ranges)
+{
+	int retval = LTTNG_OK;
+	unsigned int i;
+	bool updated = false, was_enabled = session->pid_tracker.enabled;
+
+	if (!was_enabled) {
+		/* The applications not in the ranges leave the session. */
+		init_pid_tracker(&session->pid_tracker);
+		updated = true;
+	}
+	for (i = 0; i < nb_ranges; i++) {
+		bool added;
+
+		retval = pid_ranges_add(&session->pid_tracker.pids,
+				ranges[i].start, ranges[i].end, &added);
+		if (retval != LTTNG_OK) {
+			break;
+		}
+		updated |= added;
+	}
+	if (retval != LTTNG_OK && !was_enabled) {
+		/* Rollback to tracking all PIDs. */
+		fini_pid_tracker(&session->pid_tracker);
+		goto end;
+	}
+	if (updated) {
+		ust_app_global_update_all(session);
+	}
+end:
+	return retval;
+}
+
+/*
+ * Untrack the PIDs of many ranges with a single update of the applications.
+ * The PIDs which are not tracked are ignored.
+ *
+ * Called with the session lock held.
+ */
+int trace_ust_untrack_pid_ranges(struct ltt_ust_session *session,
+		const struct lttng_pid_range *ranges, unsigned int nb_ranges)
+{
+	int retval = LTTNG_OK;
+	unsigned int i;
+	bool updated = false;
+
+	if (!session->pid_tracker.enabled) {
+		/* No PID being tracked. */
+		retval = LTTNG_ERR_PID_NOT_TRACKED;
+		goto end;
+	}
+	for (i = 0; i < nb_ranges; i++) {
+		bool removed;
+
+		retval = pid_ranges_del(&session->pid_tracker.pids,
+				ranges[i].start, ranges[i].end, &removed);
+		if (retval != LTTNG_OK) {
+			break;
+		}
+		updated |= removed;
+	}
+	if (updated) {
+		ust_app_global_update_all(session);
+	}
+end:
+	return retval;
+}
+
 /*
  * Called with session lock held.
  */
 ssize_t trace_ust_list_tracker_pids(struct ltt_ust_session *session,
 		int32_t **_pids)
 {
-	struct ust_pid_tracker_node *tracker_node;
-	struct lttng_ht_iter iter;
-	unsigned long count, i = 0;
-	long approx[2];
+	const struct pid_ranges *set = &session->pid_tracker.pids;
+	uint64_t count;
+	unsigned int i;
+	size_t nr_pids = 0;
 	int32_t *pids;
-	int ret = 0;
 
-	if (!session->pid_tracker.ht) {
+	if (!session->pid_tracker.enabled) {
 		/* Tracker disabled. Set first entry to -1. */
 		pids = zmalloc(sizeof(*pids));
 		if (!pids) {
-			ret = -1;
-			goto end;
+			return -1;
 		}
 		pids[0] = -1;
 		*_pids = pids;
 		return 1;
 	}
 
-	rcu_read_lock();
-	cds_lfht_count_nodes(session->pid_tracker.ht->ht,
-		&approx[0], &count, &approx[1]);
+	count = pid_ranges_count(set);
+	if (count > SSIZE_MAX / sizeof(*pids)) {
+		return -1;
+	}
 	pids = zmalloc(sizeof(*pids) * count);
-	if (!pids) {
-		ret = -1;
-		goto end;
+	if (!pids && count) {
+		return -1;
 	}
-	cds_lfht_for_each_entry(session->pid_tracker.ht->ht,
-			&iter.iter, tracker_node, node.node) {
-		pids[i++] = tracker_node->node.key;
+	for (i = 0; i < set->nb_ranges; i++) {
+		int64_t pid;
+
+		for (pid = set->ranges[i].start; pid <= set->ranges[i].end;
+				pid++) {
+			pids[nr_pids++] = (int32_t) pid;
+		}
 	}
 	*_pids = pids;
-	ret = count;
-end:
-	rcu_read_unlock();
-	return ret;
+	return nr_pids;
 }
 
 /*
@@ -1006,8 +1205,9 @@ void trace_ust_destroy_event(struct ltt_ust_event *event)
 
 	DBG2("Trace destroy UST event %s", event->attr.name);
 	free(event->filter_expression);
-	free(event->filter);
-	free(event->exclusion);
+	filter_store_put(event->filter);
+	trace_ust_exclusion_put(event->uexclusion);
+	trace_ust_event_conf_put(event->conf);
 	free(event);
 }
 
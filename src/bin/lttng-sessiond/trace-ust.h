@@ -21,12 +21,14 @@
 
 #include <limits.h>
 #include <urcu/list.h>
+#include <urcu/ref.h>
 
 #include <lttng/lttng.h>
 #include <common/hashtable/hashtable.h>
 #include <common/defaults.h>
 
 #include "consumer.h"
+#include "pid-ranges.h"
 #include "ust-ctl.h"
 
 struct agent;
@@ -46,6 +48,36 @@ struct ltt_ust_context {
 	struct cds_list_head list;
 };
 
+/*
+ * Exclusion list of an UST event, shared by reference with the per
+ * application copies of the event.
+ */
+struct ltt_ust_exclusion {
+	struct urcu_ref ref;
+	/* As given by the user. */
+	struct lttng_event_exclusion *exclusion;
+	/*
+	 * Sent to the applications: the exclusion names which can match the
+	 * event name, without those implied by another exclusion, sorted.
+	 * NULL if no exclusion can apply.
+	 */
+	struct lttng_event_exclusion *compiled;
+};
+
+/*
+ * Immutable configuration of a UST event, referenced by the events of the
+ * applications rather than copied in each of them.
+ */
+struct ltt_ust_event_conf {
+	struct urcu_ref ref;
+	struct lttng_ust_event attr;
+	/* Reference on the filter store. NULL if the event has no filter. */
+	struct lttng_filter_bytecode *filter;
+	struct lttng_event_exclusion *exclusion;
+	/* Owns exclusion. NULL if the event has no exclusion. */
+	struct ltt_ust_exclusion *uexclusion;
+};
+
 /* UST event */
 struct ltt_ust_event {
 	unsigned int enabled;
@@ -54,6 +86,10 @@ struct ltt_ust_event {
 	char *filter_expression;
 	struct lttng_filter_bytecode *filter;
 	struct lttng_event_exclusion *exclusion;
+	/* Owns exclusion. NULL if the event has no exclusion. */
+	struct ltt_ust_exclusion *uexclusion;
+	/* Configuration shared with the events of the applications. */
+	struct ltt_ust_event_conf *conf;
 	/*
 	 * An internal event is an event which was created by the session daemon
 	 * through which, for example, events emitted in Agent domains are
@@ -83,6 +119,8 @@ struct ltt_ust_channel {
 	uint64_t per_pid_closed_app_discarded;
 	uint64_t per_pid_closed_app_lost;
 	uint64_t monitor_timer_interval;
+	enum lttng_channel_compression compression;
+	int huge_pages;
 };
 
 /* UST domain global (LTTNG_DOMAIN_UST) */
@@ -91,12 +129,10 @@ struct ltt_ust_domain_global {
 	struct cds_list_head registry_buffer_uid_list;
 };
 
-struct ust_pid_tracker_node {
-	struct lttng_ht_node_ulong node;
-};
-
 struct ust_pid_tracker {
-	struct lttng_ht *ht;
+	/* All the PIDs are tracked while the tracker is disabled. */
+	int enabled;
+	struct pid_ranges pids;
 };
 
 /* UST session */
@@ -128,6 +164,11 @@ struct ltt_ust_session {
 	unsigned int snapshot_mode;
 	unsigned int has_non_default_channel;
 	unsigned int live_timer_interval;	/* usec */
+	/*
+	 * Version of the configuration, incremented by each change applied to
+	 * the registered applications. Protected by the session lock.
+	 */
+	uint64_t config_version;
 
 	/* Metadata channel attributes. */
 	struct lttng_ust_channel_attr metadata_attr;
@@ -215,8 +256,22 @@ void trace_ust_destroy_channel(struct ltt_ust_channel *channel);
 void trace_ust_destroy_event(struct ltt_ust_event *event);
 void trace_ust_destroy_context(struct ltt_ust_context *ctx);
 
+/*
+ * Get and put a reference on an event exclusion list. It's safe to pass NULL.
+ */
+struct ltt_ust_exclusion *trace_ust_exclusion_get(
+		struct ltt_ust_exclusion *uexclusion);
+void trace_ust_exclusion_put(struct ltt_ust_exclusion *uexclusion);
+struct ltt_ust_event_conf *trace_ust_event_conf_get(
+		struct ltt_ust_event_conf *conf);
+void trace_ust_event_conf_put(struct ltt_ust_event_conf *conf);
+
 int trace_ust_track_pid(struct ltt_ust_session *session, int pid);
 int trace_ust_untrack_pid(struct ltt_ust_session *session, int pid);
+int trace_ust_track_pid_ranges(struct ltt_ust_session *session,
+		const struct lttng_pid_range *ranges, unsigned int nb_ranges);
+int trace_ust_untrack_pid_ranges(struct ltt_ust_session *session,
+		const struct lttng_pid_range *ranges, unsigned int nb_ranges);
 
 int trace_ust_pid_tracker_lookup(struct ltt_ust_session *session, int pid);
 
@@ -319,6 +374,18 @@ int trace_ust_untrack_pid(struct ltt_ust_session *session, int pid)
 	return 0;
 }
 static inline
+int trace_ust_track_pid_ranges(struct ltt_ust_session *session,
+		const struct lttng_pid_range *ranges, unsigned int nb_ranges)
+{
+	return 0;
+}
+static inline
+int trace_ust_untrack_pid_ranges(struct ltt_ust_session *session,
+		const struct lttng_pid_range *ranges, unsigned int nb_ranges)
+{
+	return 0;
+}
+static inline
 int trace_ust_pid_tracker_lookup(struct ltt_ust_session *session, int pid)
 {
 	return 0;
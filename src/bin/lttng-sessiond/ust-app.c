@@ -19,6 +19,7 @@
 #define _LGPL_SOURCE
 #include <errno.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -30,15 +31,23 @@
 #include <lttng/ust-error.h>
 #include <signal.h>
 
+#include <common/align.h>
 #include <common/common.h>
+#include <common/compat/endian.h>
+#include <common/compat/time.h>
+#include <common/time.h>
 #include <common/sessiond-comm/sessiond-comm.h>
+#include <common/self-tracing/self-tracing.h>
 
+#include "app-update-pool.h"
 #include "buffer-registry.h"
 #include "fd-limit.h"
+#include "filter-store.h"
 #include "health-sessiond.h"
 #include "ust-app.h"
 #include "ust-consumer.h"
 #include "ust-ctl.h"
+#include "ust-filter.h"
 #include "utils.h"
 #include "session.h"
 #include "lttng-sessiond.h"
@@ -55,6 +64,19 @@ static pthread_mutex_t next_channel_key_lock = PTHREAD_MUTEX_INITIALIZER;
 static uint64_t _next_session_id;
 static pthread_mutex_t next_session_id_lock = PTHREAD_MUTEX_INITIALIZER;
 
+/*
+ * UIDs of which the per UID buffers are created at session start. Set before
+ * any command is processed.
+ */
+static uid_t prewarm_uids[DEFAULT_UST_PREWARM_UIDS_MAX];
+static unsigned int nr_prewarm_uids;
+
+/* Specialize the filters for the registered events. Set before any command. */
+static int specialize_filters;
+
+/* Cache the tracepoint lists of the apps. Set before any command. */
+static int cache_app_lists;
+
 /*
  * Return the incremented value of next_channel_key.
  */
@@ -104,6 +126,7 @@ static void copy_channel_attr_to_ustctl(
 static int ht_match_ust_app_event(struct cds_lfht_node *node, const void *_key)
 {
 	struct ust_app_event *event;
+	const struct ltt_ust_event_conf *conf;
 	const struct ust_app_ht_key *key;
 	int ev_loglevel_value;
 
@@ -111,19 +134,20 @@ static int ht_match_ust_app_event(struct cds_lfht_node *node, const void *_key)
 	assert(_key);
 
 	event = caa_container_of(node, struct ust_app_event, node.node);
+	conf = event->conf;
 	key = _key;
-	ev_loglevel_value = event->attr.loglevel;
+	ev_loglevel_value = conf->attr.loglevel;
 
 	/* Match the 4 elements of the key: name, filter, loglevel, exclusions */
 
 	/* Event name */
-	if (strncmp(event->attr.name, key->name, sizeof(event->attr.name)) != 0) {
+	if (strncmp(conf->attr.name, key->name, sizeof(conf->attr.name)) != 0) {
 		goto no_match;
 	}
 
 	/* Event loglevel. */
 	if (ev_loglevel_value != key->loglevel_type) {
-		if (event->attr.loglevel_type == LTTNG_UST_LOGLEVEL_ALL
+		if (conf->attr.loglevel_type == LTTNG_UST_LOGLEVEL_ALL
 				&& key->loglevel_type == 0 &&
 				ev_loglevel_value == -1) {
 			/*
@@ -138,29 +162,30 @@ static int ht_match_ust_app_event(struct cds_lfht_node *node, const void *_key)
 	}
 
 	/* One of the filters is NULL, fail. */
-	if ((key->filter && !event->filter) || (!key->filter && event->filter)) {
+	if ((key->filter && !conf->filter) || (!key->filter && conf->filter)) {
 		goto no_match;
 	}
 
-	if (key->filter && event->filter) {
+	if (key->filter && conf->filter && key->filter != conf->filter) {
 		/* Both filters exists, check length followed by the bytecode. */
-		if (event->filter->len != key->filter->len ||
-				memcmp(event->filter->data, key->filter->data,
-					event->filter->len) != 0) {
+		if (conf->filter->len != key->filter->len ||
+				memcmp(conf->filter->data, key->filter->data,
+					conf->filter->len) != 0) {
 			goto no_match;
 		}
 	}
 
 	/* One of the exclusions is NULL, fail. */
-	if ((key->exclusion && !event->exclusion) || (!key->exclusion && event->exclusion)) {
+	if ((key->exclusion && !conf->exclusion) || (!key->exclusion && conf->exclusion)) {
 		goto no_match;
 	}
 
-	if (key->exclusion && event->exclusion) {
+	if (key->exclusion && conf->exclusion &&
+			key->exclusion != conf->exclusion) {
 		/* Both exclusions exists, check count followed by the names. */
-		if (event->exclusion->count != key->exclusion->count ||
-				memcmp(event->exclusion->names, key->exclusion->names,
-					event->exclusion->count * LTTNG_UST_SYM_NAME_LEN) != 0) {
+		if (conf->exclusion->count != key->exclusion->count ||
+				memcmp(conf->exclusion->names, key->exclusion->names,
+					conf->exclusion->count * LTTNG_UST_SYM_NAME_LEN) != 0) {
 			goto no_match;
 		}
 	}
@@ -189,10 +214,10 @@ static void add_unique_ust_app_event(struct ust_app_channel *ua_chan,
 	assert(event);
 
 	ht = ua_chan->events;
-	key.name = event->attr.name;
-	key.filter = event->filter;
-	key.loglevel_type = event->attr.loglevel;
-	key.exclusion = event->exclusion;
+	key.name = event->conf->attr.name;
+	key.filter = event->conf->filter;
+	key.loglevel_type = event->conf->attr.loglevel;
+	key.exclusion = event->conf->exclusion;
 
 	node_ptr = cds_lfht_add_unique(ht->ht,
 			ht->hash_fct(event->node.key, lttng_ht_seed),
@@ -264,6 +289,90 @@ error:
 	return registry;
 }
 
+#define UST_APP_ARENA_CHUNK_LEN	(64 * 1024)
+#define UST_APP_ARENA_ALIGN	sizeof(uint64_t)
+
+struct ust_app_arena_chunk {
+	struct ust_app_arena_chunk *prev;
+	size_t len;
+	size_t used;
+	char data[] __attribute__((aligned(UST_APP_ARENA_ALIGN)));
+};
+
+/*
+ * Allocate zeroed memory from the arena of an application session.
+ *
+ * Return the allocated memory or NULL on error.
+ */
+static void *ust_app_arena_zalloc(struct ust_app_arena *arena, size_t len)
+{
+	void *ptr = NULL;
+	struct ust_app_arena_chunk *chunk;
+
+	len = ALIGN(len, UST_APP_ARENA_ALIGN);
+
+	pthread_mutex_lock(&arena->lock);
+	chunk = arena->chunk;
+	if (!chunk || chunk->len - chunk->used < len) {
+		size_t chunk_len = max_t(size_t, UST_APP_ARENA_CHUNK_LEN, len);
+
+		chunk = zmalloc(sizeof(*chunk) + chunk_len);
+		if (!chunk) {
+			PERROR("zmalloc ust app arena chunk");
+			goto end;
+		}
+		chunk->len = chunk_len;
+		chunk->prev = arena->chunk;
+		arena->chunk = chunk;
+		arena->allocated += sizeof(*chunk) + chunk_len;
+	}
+	ptr = chunk->data + chunk->used;
+	chunk->used += len;
+end:
+	pthread_mutex_unlock(&arena->lock);
+	return ptr;
+}
+
+/*
+ * Give back memory of the arena. Only the last allocation can be reused,
+ * which covers the objects freed right after their allocation on error
+ * paths. The rest is released with the arena.
+ */
+static void ust_app_arena_free(struct ust_app_arena *arena, void *ptr,
+		size_t len)
+{
+	struct ust_app_arena_chunk *chunk;
+
+	len = ALIGN(len, UST_APP_ARENA_ALIGN);
+
+	pthread_mutex_lock(&arena->lock);
+	chunk = arena->chunk;
+	if (chunk && ptr == chunk->data + chunk->used - len) {
+		memset(ptr, 0, len);
+		chunk->used -= len;
+	}
+	pthread_mutex_unlock(&arena->lock);
+}
+
+/*
+ * Release all the memory of an arena. Called once no object of the arena
+ * can be accessed anymore, after the grace period of the session.
+ */
+static void ust_app_arena_release(struct ust_app_arena *arena)
+{
+	struct ust_app_arena_chunk *chunk = arena->chunk;
+
+	while (chunk) {
+		struct ust_app_arena_chunk *prev = chunk->prev;
+
+		free(chunk);
+		chunk = prev;
+	}
+	arena->chunk = NULL;
+	arena->allocated = 0;
+	(void) pthread_mutex_destroy(&arena->lock);
+}
+
 /*
  * Delete ust context safely. RCU read lock must be held before calling
  * this function.
@@ -286,7 +395,7 @@ void delete_ust_app_ctx(int sock, struct ust_app_ctx *ua_ctx,
 		}
 		free(ua_ctx->obj);
 	}
-	free(ua_ctx);
+	/* The context memory is released with the session arena. */
 }
 
 /*
@@ -301,9 +410,7 @@ void delete_ust_app_event(int sock, struct ust_app_event *ua_event,
 
 	assert(ua_event);
 
-	free(ua_event->filter);
-	if (ua_event->exclusion != NULL)
-		free(ua_event->exclusion);
+	trace_ust_event_conf_put(ua_event->conf);
 	if (ua_event->obj != NULL) {
 		pthread_mutex_lock(&app->sock_lock);
 		ret = ustctl_release_object(sock, ua_event->obj);
@@ -314,7 +421,7 @@ void delete_ust_app_event(int sock, struct ust_app_event *ua_event,
 		}
 		free(ua_event->obj);
 	}
-	free(ua_event);
+	/* The event memory is released with the session arena. */
 }
 
 /*
@@ -355,7 +462,7 @@ void delete_ust_app_stream(int sock, struct ust_app_stream *stream,
 	assert(stream);
 
 	(void) release_ust_app_stream(sock, stream, app);
-	free(stream);
+	/* The stream memory is released with the session arena. */
 }
 
 /*
@@ -372,7 +479,10 @@ void delete_ust_app_channel_rcu(struct rcu_head *head)
 
 	ht_cleanup_push(ua_chan->ctx);
 	ht_cleanup_push(ua_chan->events);
-	free(ua_chan);
+	/*
+	 * The channel memory is released with the session arena, whose grace
+	 * period is always queued after this one.
+	 */
 }
 
 /*
@@ -442,11 +552,14 @@ end:
  * Delete ust app channel safely. RCU read lock must be held before calling
  * this function.
  *
+ * The channel is freed with the objects of "free_batch" or, if NULL, after a
+ * grace period of its own.
+ *
  * The session list lock must be held by the caller.
  */
 static
 void delete_ust_app_channel(int sock, struct ust_app_channel *ua_chan,
-		struct ust_app *app)
+		struct ust_app *app, struct lttng_ht_free_batch *free_batch)
 {
 	int ret;
 	struct lttng_ht_iter iter;
@@ -503,10 +616,13 @@ void delete_ust_app_channel(int sock, struct ust_app_channel *ua_chan,
 			ERR("UST app sock %d release channel obj failed with ret %d",
 					sock, ret);
 		}
-		lttng_fd_put(LTTNG_FD_APPS, 1);
+		if (!ua_chan->obj_fds_released) {
+			lttng_fd_put(LTTNG_FD_APPS, 1);
+		}
 		free(ua_chan->obj);
 	}
-	call_rcu(&ua_chan->rcu_head, delete_ust_app_channel_rcu);
+	lttng_ht_free_batch_add(free_batch, &ua_chan->rcu_head,
+			delete_ust_app_channel_rcu);
 }
 
 int ust_app_register_done(struct ust_app *app)
@@ -516,6 +632,7 @@ int ust_app_register_done(struct ust_app *app)
 	pthread_mutex_lock(&app->sock_lock);
 	ret = ustctl_register_done(app->sock);
 	pthread_mutex_unlock(&app->sock_lock);
+	self_tracepoint(sessiond_app_register_done, app->pid, ret);
 	return ret;
 }
 
@@ -697,6 +814,17 @@ static int push_metadata(struct ust_registry_session *registry,
 	assert(consumer);
 
 	pthread_mutex_lock(&registry->lock);
+	/*
+	 * Wait for the push of the registry in progress, if any, and then
+	 * push all the metadata appended meanwhile at once. The concurrent
+	 * pushes, as on the teardown of many applications sharing a per UID
+	 * registry, are thus coalesced instead of sending the same metadata
+	 * range each. The metadata requests of the consumer don't wait, since
+	 * a push in progress can depend on them.
+	 */
+	while (registry->metadata_pushing) {
+		pthread_cond_wait(&registry->metadata_push_cond, &registry->lock);
+	}
 	if (registry->metadata_closed) {
 		ret_val = -EPIPE;
 		goto error;
@@ -710,7 +838,10 @@ static int push_metadata(struct ust_registry_session *registry,
 		goto error;
 	}
 
+	registry->metadata_pushing = 1;
 	ret = ust_app_push_metadata(registry, socket, 0);
+	registry->metadata_pushing = 0;
+	pthread_cond_broadcast(&registry->metadata_push_cond);
 	if (ret < 0) {
 		ret_val = ret;
 		goto error;
@@ -788,6 +919,7 @@ void delete_ust_app_session_rcu(struct rcu_head *head)
 		caa_container_of(head, struct ust_app_session, rcu_head);
 
 	ht_cleanup_push(ua_sess->channels);
+	ust_app_arena_release(&ua_sess->arena);
 	free(ua_sess);
 }
 
@@ -805,6 +937,8 @@ void delete_ust_app_session(int sock, struct ust_app_session *ua_sess,
 	struct lttng_ht_iter iter;
 	struct ust_app_channel *ua_chan;
 	struct ust_registry_session *registry;
+	/* The channels and the session share one grace period. */
+	struct lttng_ht_free_batch free_batch = { 0 };
 
 	assert(ua_sess);
 
@@ -835,7 +969,7 @@ void delete_ust_app_session(int sock, struct ust_app_session *ua_sess,
 			node.node) {
 		ret = lttng_ht_del(ua_sess->channels, &iter);
 		assert(!ret);
-		delete_ust_app_channel(sock, ua_chan, app);
+		delete_ust_app_channel(sock, ua_chan, app, &free_batch);
 	}
 
 	/* In case of per PID, the registry is kept in the session. */
@@ -869,26 +1003,25 @@ void delete_ust_app_session(int sock, struct ust_app_session *ua_sess,
 
 	consumer_output_put(ua_sess->consumer);
 
-	call_rcu(&ua_sess->rcu_head, delete_ust_app_session_rcu);
+	lttng_ht_free_batch_add(&free_batch, &ua_sess->rcu_head,
+			delete_ust_app_session_rcu);
+	lttng_ht_free_batch_commit(&free_batch);
 }
 
 /*
  * Delete a traceable application structure from the global list. Never call
  * this function outside of a call_rcu call.
  *
- * RCU read side lock should _NOT_ be held when calling this function.
+ * The session list lock must be held during this function to guarantee the
+ * existence of ua_sess. RCU read side lock should _NOT_ be held when calling
+ * this function.
  */
 static
-void delete_ust_app(struct ust_app *app)
+void __delete_ust_app(struct ust_app *app)
 {
 	int ret, sock;
 	struct ust_app_session *ua_sess, *tmp_ua_sess;
 
-	/*
-	 * The session list lock must be held during this function to guarantee
-	 * the existence of ua_sess.
-	 */
-	session_lock_list();
 	/* Delete ust app sessions info */
 	sock = app->sock;
 	app->sock = -1;
@@ -925,8 +1058,18 @@ void delete_ust_app(struct ust_app *app)
 	}
 	lttng_fd_put(LTTNG_FD_APPS, 1);
 
+	free(app->events_cache.events);
+	free(app->fields_cache.fields);
+
 	DBG2("UST app pid %d deleted", app->pid);
 	free(app);
+}
+
+static
+void delete_ust_app(struct ust_app *app)
+{
+	session_lock_list();
+	__delete_ust_app(app);
 	session_unlock_list();
 }
 
@@ -945,6 +1088,35 @@ void delete_ust_app_rcu(struct rcu_head *head)
 	delete_ust_app(app);
 }
 
+/*
+ * Applications unregistered together, deleted after a single grace period
+ * and under a single acquisition of the session list lock.
+ */
+struct ust_app_teardown_batch {
+	struct rcu_head head;
+	unsigned int nr_apps;
+	struct ust_app *apps[];
+};
+
+/*
+ * URCU intermediate call to delete a batch of UST apps.
+ */
+static
+void delete_ust_app_batch_rcu(struct rcu_head *head)
+{
+	unsigned int i;
+	struct ust_app_teardown_batch *batch =
+		caa_container_of(head, struct ust_app_teardown_batch, head);
+
+	DBG3("Call RCU deleting %u apps", batch->nr_apps);
+	session_lock_list();
+	for (i = 0; i < batch->nr_apps; i++) {
+		__delete_ust_app(batch->apps[i]);
+	}
+	session_unlock_list();
+	free(batch);
+}
+
 /*
  * Delete the session from the application ht and delete the data structure by
  * freeing every object inside and releasing them.
@@ -993,6 +1165,7 @@ struct ust_app_session *alloc_ust_app_session(struct ust_app *app)
 	ua_sess->channels = lttng_ht_new(0, LTTNG_HT_TYPE_STRING);
 	ua_sess->metadata_attr.type = LTTNG_UST_CHAN_METADATA;
 	pthread_mutex_init(&ua_sess->lock, NULL);
+	pthread_mutex_init(&ua_sess->arena.lock, NULL);
 
 	return ua_sess;
 
@@ -1011,7 +1184,8 @@ struct ust_app_channel *alloc_ust_app_channel(char *name,
 	struct ust_app_channel *ua_chan;
 
 	/* Init most of the default value by allocating and zeroing */
-	ua_chan = zmalloc(sizeof(struct ust_app_channel));
+	ua_chan = ust_app_arena_zalloc(&ua_sess->arena,
+			sizeof(struct ust_app_channel));
 	if (ua_chan == NULL) {
 		PERROR("malloc");
 		goto error;
@@ -1055,17 +1229,17 @@ error:
 }
 
 /*
- * Allocate and initialize a UST app stream.
+ * Allocate and initialize a UST app stream of a channel.
  *
  * Return newly allocated stream pointer or NULL on error.
  */
-struct ust_app_stream *ust_app_alloc_stream(void)
+struct ust_app_stream *ust_app_alloc_stream(struct ust_app_channel *ua_chan)
 {
 	struct ust_app_stream *stream = NULL;
 
-	stream = zmalloc(sizeof(*stream));
+	stream = ust_app_arena_zalloc(&ua_chan->session->arena,
+			sizeof(*stream));
 	if (stream == NULL) {
-		PERROR("zmalloc ust app stream");
 		goto error;
 	}
 
@@ -1077,32 +1251,35 @@ error:
 }
 
 /*
- * Alloc new UST app event.
+ * Free a UST app stream which was never added to its channel.
+ */
+void ust_app_free_stream(struct ust_app_channel *ua_chan,
+		struct ust_app_stream *stream)
+{
+	ust_app_arena_free(&ua_chan->session->arena, stream, sizeof(*stream));
+}
+
+/*
+ * Alloc new UST app event referencing the configuration of a session event.
  */
 static
-struct ust_app_event *alloc_ust_app_event(char *name,
-		struct lttng_ust_event *attr)
+struct ust_app_event *alloc_ust_app_event(struct ust_app_arena *arena,
+		struct ltt_ust_event_conf *conf)
 {
 	struct ust_app_event *ua_event;
 
 	/* Init most of the default value by allocating and zeroing */
-	ua_event = zmalloc(sizeof(struct ust_app_event));
+	ua_event = ust_app_arena_zalloc(arena, sizeof(struct ust_app_event));
 	if (ua_event == NULL) {
 		PERROR("malloc");
 		goto error;
 	}
 
 	ua_event->enabled = 1;
-	strncpy(ua_event->name, name, sizeof(ua_event->name));
-	ua_event->name[sizeof(ua_event->name) - 1] = '\0';
-	lttng_ht_node_init_str(&ua_event->node, ua_event->name);
-
-	/* Copy attributes */
-	if (attr) {
-		memcpy(&ua_event->attr, attr, sizeof(ua_event->attr));
-	}
+	ua_event->conf = trace_ust_event_conf_get(conf);
+	lttng_ht_node_init_str(&ua_event->node, conf->attr.name);
 
-	DBG3("UST app event %s allocated", ua_event->name);
+	DBG3("UST app event %s allocated", conf->attr.name);
 
 	return ua_event;
 
@@ -1114,13 +1291,14 @@ error:
  * Alloc new UST app context.
  */
 static
-struct ust_app_ctx *alloc_ust_app_ctx(struct lttng_ust_context_attr *uctx)
+struct ust_app_ctx *alloc_ust_app_ctx(struct ust_app_arena *arena,
+		struct lttng_ust_context_attr *uctx)
 {
 	struct ust_app_ctx *ua_ctx;
 
-	ua_ctx = zmalloc(sizeof(struct ust_app_ctx));
+	ua_ctx = ust_app_arena_zalloc(arena, sizeof(struct ust_app_ctx));
 	if (ua_ctx == NULL) {
-		goto error;
+		goto error_alloc;
 	}
 
 	CDS_INIT_LIST_HEAD(&ua_ctx->list);
@@ -1146,33 +1324,11 @@ struct ust_app_ctx *alloc_ust_app_ctx(struct lttng_ust_context_attr *uctx)
 	DBG3("UST app context %d allocated", ua_ctx->ctx.ctx);
 	return ua_ctx;
 error:
-	free(ua_ctx);
+	ust_app_arena_free(arena, ua_ctx, sizeof(struct ust_app_ctx));
+error_alloc:
 	return NULL;
 }
 
-/*
- * Allocate a filter and copy the given original filter.
- *
- * Return allocated filter or NULL on error.
- */
-static struct lttng_filter_bytecode *copy_filter_bytecode(
-		struct lttng_filter_bytecode *orig_f)
-{
-	struct lttng_filter_bytecode *filter = NULL;
-
-	/* Copy filter bytecode */
-	filter = zmalloc(sizeof(*filter) + orig_f->len);
-	if (!filter) {
-		PERROR("zmalloc alloc filter bytecode");
-		goto error;
-	}
-
-	memcpy(filter, orig_f, sizeof(*filter) + orig_f->len);
-
-error:
-	return filter;
-}
-
 /*
  * Create a liblttng-ust filter bytecode from given bytecode.
  *
@@ -1325,27 +1481,77 @@ error:
 	return ret;
 }
 
+/*
+ * Specialize the filter bytecode of an event for the field types of the
+ * events already registered in the channel registry, by the other
+ * applications of the user for per UID buffers.
+ */
+static void specialize_event_filter(struct ust_app_session *ua_sess,
+		struct ust_app_channel *ua_chan, struct ust_app_event *ua_event,
+		struct lttng_ust_filter_bytecode *bytecode)
+{
+	int count = 0;
+	uint64_t chan_reg_key;
+	struct ust_registry_session *registry;
+	struct ust_registry_channel *chan_reg;
+
+	rcu_read_lock();
+	registry = get_session_registry(ua_sess);
+	if (!registry) {
+		goto end;
+	}
+
+	if (ua_sess->buffer_type == LTTNG_BUFFER_PER_UID) {
+		chan_reg_key = ua_chan->tracing_channel_id;
+	} else {
+		chan_reg_key = ua_chan->key;
+	}
+
+	pthread_mutex_lock(&registry->lock);
+	chan_reg = ust_registry_channel_find(registry, chan_reg_key);
+	if (chan_reg) {
+		count = ust_filter_specialize(bytecode, chan_reg,
+				ua_event->conf->attr.name);
+	}
+	pthread_mutex_unlock(&registry->lock);
+end:
+	rcu_read_unlock();
+	DBG3("UST filter of event %s: %d instructions specialized",
+			ua_event->conf->attr.name, count);
+}
+
 /*
  * Set the filter on the tracer.
  */
 static
-int set_ust_event_filter(struct ust_app_event *ua_event,
+int set_ust_event_filter(struct ust_app_session *ua_sess,
+		struct ust_app_channel *ua_chan, struct ust_app_event *ua_event,
 		struct ust_app *app)
 {
 	int ret;
-	struct lttng_ust_filter_bytecode *ust_bytecode = NULL;
+	struct lttng_ust_filter_bytecode *ust_bytecode = NULL, *copy = NULL;
 
 	health_code_update();
 
-	if (!ua_event->filter) {
+	if (!ua_event->conf->filter) {
 		ret = 0;
 		goto error;
 	}
 
-	ust_bytecode = create_ust_bytecode_from_bytecode(ua_event->filter);
-	if (!ust_bytecode) {
-		ret = -LTTNG_ERR_NOMEM;
-		goto error;
+	if (specialize_filters) {
+		copy = create_ust_bytecode_from_bytecode(ua_event->conf->filter);
+		if (!copy) {
+			ret = -LTTNG_ERR_NOMEM;
+			goto error;
+		}
+		specialize_event_filter(ua_sess, ua_chan, ua_event, copy);
+		ust_bytecode = copy;
+	} else {
+		/* Same layout, the stored bytecode is sent as is. */
+		assert(sizeof(struct lttng_filter_bytecode) ==
+				sizeof(struct lttng_ust_filter_bytecode));
+		ust_bytecode = (struct lttng_ust_filter_bytecode *)
+				ua_event->conf->filter;
 	}
 	pthread_mutex_lock(&app->sock_lock);
 	ret = ustctl_set_filter(app->sock, ust_bytecode,
@@ -1354,7 +1560,7 @@ int set_ust_event_filter(struct ust_app_event *ua_event,
 	if (ret < 0) {
 		if (ret != -EPIPE && ret != -LTTNG_UST_ERR_EXITING) {
 			ERR("UST app event %s filter failed for app (pid: %d) "
-					"with ret %d", ua_event->attr.name, app->pid, ret);
+					"with ret %d", ua_event->conf->attr.name, app->pid, ret);
 		} else {
 			/*
 			 * This is normal behavior, an application can die during the
@@ -1367,35 +1573,14 @@ int set_ust_event_filter(struct ust_app_event *ua_event,
 		goto error;
 	}
 
-	DBG2("UST filter set successfully for event %s", ua_event->name);
+	DBG2("UST filter set successfully for event %s", ua_event->conf->attr.name);
 
 error:
 	health_code_update();
-	free(ust_bytecode);
+	free(copy);
 	return ret;
 }
 
-static
-struct lttng_ust_event_exclusion *create_ust_exclusion_from_exclusion(
-		struct lttng_event_exclusion *exclusion)
-{
-	struct lttng_ust_event_exclusion *ust_exclusion = NULL;
-	size_t exclusion_alloc_size = sizeof(struct lttng_ust_event_exclusion) +
-		LTTNG_UST_SYM_NAME_LEN * exclusion->count;
-
-	ust_exclusion = zmalloc(exclusion_alloc_size);
-	if (!ust_exclusion) {
-		PERROR("malloc");
-		goto end;
-	}
-
-	assert(sizeof(struct lttng_event_exclusion) ==
-			sizeof(struct lttng_ust_event_exclusion));
-	memcpy(ust_exclusion, exclusion, exclusion_alloc_size);
-end:
-	return ust_exclusion;
-}
-
 /*
  * Set event exclusions on the tracer.
  */
@@ -1404,28 +1589,28 @@ int set_ust_event_exclusion(struct ust_app_event *ua_event,
 		struct ust_app *app)
 {
 	int ret;
-	struct lttng_ust_event_exclusion *ust_exclusion = NULL;
+	struct lttng_ust_event_exclusion *ust_exclusion;
 
 	health_code_update();
 
-	if (!ua_event->exclusion || !ua_event->exclusion->count) {
+	/* None of the exclusions can apply to the event. */
+	if (!ua_event->conf->uexclusion || !ua_event->conf->uexclusion->compiled) {
 		ret = 0;
 		goto error;
 	}
 
-	ust_exclusion = create_ust_exclusion_from_exclusion(
-			ua_event->exclusion);
-	if (!ust_exclusion) {
-		ret = -LTTNG_ERR_NOMEM;
-		goto error;
-	}
+	/* Same layout, sent as is. */
+	assert(sizeof(struct lttng_event_exclusion) ==
+			sizeof(struct lttng_ust_event_exclusion));
+	ust_exclusion = (struct lttng_ust_event_exclusion *)
+			ua_event->conf->uexclusion->compiled;
 	pthread_mutex_lock(&app->sock_lock);
 	ret = ustctl_set_exclusion(app->sock, ust_exclusion, ua_event->obj);
 	pthread_mutex_unlock(&app->sock_lock);
 	if (ret < 0) {
 		if (ret != -EPIPE && ret != -LTTNG_UST_ERR_EXITING) {
 			ERR("UST app event %s exclusions failed for app (pid: %d) "
-					"with ret %d", ua_event->attr.name, app->pid, ret);
+					"with ret %d", ua_event->conf->attr.name, app->pid, ret);
 		} else {
 			/*
 			 * This is normal behavior, an application can die during the
@@ -1438,11 +1623,10 @@ int set_ust_event_exclusion(struct ust_app_event *ua_event,
 		goto error;
 	}
 
-	DBG2("UST exclusion set successfully for event %s", ua_event->name);
+	DBG2("UST exclusion set successfully for event %s", ua_event->conf->attr.name);
 
 error:
 	health_code_update();
-	free(ust_exclusion);
 	return ret;
 }
 
@@ -1463,7 +1647,7 @@ static int disable_ust_event(struct ust_app *app,
 		if (ret != -EPIPE && ret != -LTTNG_UST_ERR_EXITING) {
 			ERR("UST app event %s disable failed for app (pid: %d) "
 					"and session handle %d with ret %d",
-					ua_event->attr.name, app->pid, ua_sess->handle, ret);
+					ua_event->conf->attr.name, app->pid, ua_sess->handle, ret);
 		} else {
 			/*
 			 * This is normal behavior, an application can die during the
@@ -1477,7 +1661,7 @@ static int disable_ust_event(struct ust_app *app,
 	}
 
 	DBG2("UST app event %s disabled successfully for app (pid: %d)",
-			ua_event->attr.name, app->pid);
+			ua_event->conf->attr.name, app->pid);
 
 error:
 	health_code_update();
@@ -1579,7 +1763,7 @@ static int enable_ust_event(struct ust_app *app,
 		if (ret != -EPIPE && ret != -LTTNG_UST_ERR_EXITING) {
 			ERR("UST app event %s enable failed for app (pid: %d) "
 					"and session handle %d with ret %d",
-					ua_event->attr.name, app->pid, ua_sess->handle, ret);
+					ua_event->conf->attr.name, app->pid, ua_sess->handle, ret);
 		} else {
 			/*
 			 * This is normal behavior, an application can die during the
@@ -1593,13 +1777,39 @@ static int enable_ust_event(struct ust_app *app,
 	}
 
 	DBG2("UST app event %s enabled successfully for app (pid: %d)",
-			ua_event->attr.name, app->pid);
+			ua_event->conf->attr.name, app->pid);
 
 error:
 	health_code_update();
 	return ret;
 }
 
+/*
+ * In fd frugal mode, close the fds of the channel object of an application
+ * once the channel is sent. The application has its own copies and only the
+ * handle of the object is used afterwards, which is kept until the object is
+ * released on the application side by delete_ust_app_channel().
+ */
+static void release_channel_obj_fds(struct ust_app *app,
+		struct ust_app_channel *ua_chan)
+{
+	int ret;
+
+	if (!app_fd_frugal || !ua_chan->obj || ua_chan->obj_fds_released) {
+		return;
+	}
+
+	/* A negative socket only closes the fds locally. */
+	ret = ustctl_release_object(-1, ua_chan->obj);
+	if (ret < 0) {
+		ERR("UST app pid %d closing channel obj fds failed with ret %d",
+				app->pid, ret);
+		return;
+	}
+	ua_chan->obj_fds_released = 1;
+	lttng_fd_put(LTTNG_FD_APPS, 1);
+}
+
 /*
  * Send channel and stream buffer to application.
  *
@@ -1646,6 +1856,7 @@ static int send_channel_pid_to_ust(struct ust_app *app,
 	}
 	/* Flag the channel that it is sent to the application. */
 	ua_chan->is_sent = 1;
+	release_channel_obj_fds(app, ua_chan);
 
 error:
 	health_code_update();
@@ -1667,13 +1878,13 @@ int create_ust_event(struct ust_app *app, struct ust_app_session *ua_sess,
 
 	/* Create UST event on tracer */
 	pthread_mutex_lock(&app->sock_lock);
-	ret = ustctl_create_event(app->sock, &ua_event->attr, ua_chan->obj,
+	ret = ustctl_create_event(app->sock, &ua_event->conf->attr, ua_chan->obj,
 			&ua_event->obj);
 	pthread_mutex_unlock(&app->sock_lock);
 	if (ret < 0) {
 		if (ret != -EPIPE && ret != -LTTNG_UST_ERR_EXITING) {
 			ERR("Error ustctl create event %s for app pid: %d with ret %d",
-					ua_event->attr.name, app->pid, ret);
+					ua_event->conf->attr.name, app->pid, ret);
 		} else {
 			/*
 			 * This is normal behavior, an application can die during the
@@ -1689,20 +1900,20 @@ int create_ust_event(struct ust_app *app, struct ust_app_session *ua_sess,
 	ua_event->handle = ua_event->obj->handle;
 
 	DBG2("UST app event %s created successfully for pid:%d",
-			ua_event->attr.name, app->pid);
+			ua_event->conf->attr.name, app->pid);
 
 	health_code_update();
 
 	/* Set filter if one is present. */
-	if (ua_event->filter) {
-		ret = set_ust_event_filter(ua_event, app);
+	if (ua_event->conf->filter) {
+		ret = set_ust_event_filter(ua_sess, ua_chan, ua_event, app);
 		if (ret < 0) {
 			goto error;
 		}
 	}
 
 	/* Set exclusions for the event */
-	if (ua_event->exclusion) {
+	if (ua_event->conf->exclusion) {
 		ret = set_ust_event_exclusion(ua_event, app);
 		if (ret < 0) {
 			goto error;
@@ -1743,39 +1954,13 @@ error:
 }
 
 /*
- * Copy data between an UST app event and a LTT event.
+ * Copy data between an UST app event and a LTT event. The configuration is
+ * shared on allocation, only the state of the application is copied.
  */
 static void shadow_copy_event(struct ust_app_event *ua_event,
 		struct ltt_ust_event *uevent)
 {
-	size_t exclusion_alloc_size;
-
-	strncpy(ua_event->name, uevent->attr.name, sizeof(ua_event->name));
-	ua_event->name[sizeof(ua_event->name) - 1] = '\0';
-
 	ua_event->enabled = uevent->enabled;
-
-	/* Copy event attributes */
-	memcpy(&ua_event->attr, &uevent->attr, sizeof(ua_event->attr));
-
-	/* Copy filter bytecode */
-	if (uevent->filter) {
-		ua_event->filter = copy_filter_bytecode(uevent->filter);
-		/* Filter might be NULL here in case of ENONEM. */
-	}
-
-	/* Copy exclusion data */
-	if (uevent->exclusion) {
-		exclusion_alloc_size = sizeof(struct lttng_event_exclusion) +
-				LTTNG_UST_SYM_NAME_LEN * uevent->exclusion->count;
-		ua_event->exclusion = zmalloc(exclusion_alloc_size);
-		if (ua_event->exclusion == NULL) {
-			PERROR("malloc");
-		} else {
-			memcpy(ua_event->exclusion, uevent->exclusion,
-					exclusion_alloc_size);
-		}
-	}
 }
 
 /*
@@ -1806,6 +1991,8 @@ static void shadow_copy_channel(struct ust_app_channel *ua_chan,
 	ua_chan->monitor_timer_interval = uchan->monitor_timer_interval;
 	ua_chan->attr.output = uchan->attr.output;
 	ua_chan->attr.blocking_timeout = uchan->attr.u.s.blocking_timeout;
+	ua_chan->compression = uchan->compression;
+	ua_chan->huge_pages = uchan->huge_pages;
 
 	/*
 	 * Note that the attribute channel type is not set since the channel on the
@@ -1816,7 +2003,8 @@ static void shadow_copy_channel(struct ust_app_channel *ua_chan,
 	ua_chan->tracing_channel_id = uchan->id;
 
 	cds_list_for_each_entry(uctx, &uchan->ctx_list, list) {
-		struct ust_app_ctx *ua_ctx = alloc_ust_app_ctx(&uctx->ctx);
+		struct ust_app_ctx *ua_ctx = alloc_ust_app_ctx(
+				&ua_chan->session->arena, &uctx->ctx);
 
 		if (ua_ctx == NULL) {
 			continue;
@@ -1834,7 +2022,8 @@ static void shadow_copy_channel(struct ust_app_channel *ua_chan,
 		if (ua_event == NULL) {
 			DBG2("UST event %s not found on shadow copy channel",
 					uevent->attr.name);
-			ua_event = alloc_ust_app_event(uevent->attr.name, &uevent->attr);
+			ua_event = alloc_ust_app_event(&ua_chan->session->arena,
+					uevent->conf);
 			if (ua_event == NULL) {
 				continue;
 			}
@@ -1877,6 +2066,7 @@ static void shadow_copy_session(struct ust_app_session *ua_sess,
 	ua_sess->egid = usess->gid;
 	ua_sess->buffer_type = usess->buffer_type;
 	ua_sess->bits_per_long = app->bits_per_long;
+	ua_sess->config_version = usess->config_version;
 
 	/* There is only one consumer object per session possible. */
 	consumer_output_get(usess->consumer);
@@ -2008,6 +2198,22 @@ error:
 	return NULL;
 }
 
+/*
+ * Record that an application session applied the last change of the session
+ * configuration. The version only advances if the application session was in
+ * sync with the previous version, so that a missed change is not hidden by
+ * the next one.
+ *
+ * Called with the session lock held.
+ */
+static void app_session_applied_change(struct ltt_ust_session *usess,
+		struct ust_app_session *ua_sess)
+{
+	if (ua_sess->config_version == usess->config_version - 1) {
+		ua_sess->config_version = usess->config_version;
+	}
+}
+
 /*
  * Setup buffer registry per PID for the given session and application. If none
  * is found, a new one is created, added to the global registry and
@@ -2362,7 +2568,7 @@ int create_ust_app_channel_context(struct ust_app_session *ua_sess,
 		goto error;
 	}
 
-	ua_ctx = alloc_ust_app_ctx(uctx);
+	ua_ctx = alloc_ust_app_ctx(&ua_chan->session->arena, uctx);
 	if (ua_ctx == NULL) {
 		/* malloc failed */
 		ret = -1;
@@ -2570,42 +2776,6 @@ error:
 	return ret;
 }
 
-/*
- * Duplicate the ust data object of the ust app stream and save it in the
- * buffer registry stream.
- *
- * Return 0 on success or else a negative value.
- */
-static int duplicate_stream_object(struct buffer_reg_stream *reg_stream,
-		struct ust_app_stream *stream)
-{
-	int ret;
-
-	assert(reg_stream);
-	assert(stream);
-
-	/* Reserve the amount of file descriptor we need. */
-	ret = lttng_fd_get(LTTNG_FD_APPS, 2);
-	if (ret < 0) {
-		ERR("Exhausted number of available FD upon duplicate stream");
-		goto error;
-	}
-
-	/* Duplicate object for stream once the original is in the registry. */
-	ret = ustctl_duplicate_ust_object_data(&stream->obj,
-			reg_stream->obj.ust);
-	if (ret < 0) {
-		ERR("Duplicate stream obj from %p to %p failed with ret %d",
-				reg_stream->obj.ust, stream->obj, ret);
-		lttng_fd_put(LTTNG_FD_APPS, 2);
-		goto error;
-	}
-	stream->handle = stream->obj->handle;
-
-error:
-	return ret;
-}
-
 /*
  * Duplicate the ust data object of the ust app. channel and save it in the
  * buffer registry channel.
@@ -2809,32 +2979,30 @@ static int send_channel_uid_to_ust(struct buffer_reg_channel *reg_chan,
 
 	health_code_update();
 
-	/* Send all streams to application. */
+	/*
+	 * Send all streams to application. Unlike the channel, whose handle is
+	 * set by the send, a stream object is only read to pass its file
+	 * descriptors to the application, which gets its own copies. The
+	 * registry objects are thus sent as is, without duplicating the shm
+	 * and wakeup fds of every stream for every application.
+	 */
 	pthread_mutex_lock(&reg_chan->stream_list_lock);
 	cds_list_for_each_entry(reg_stream, &reg_chan->streams, lnode) {
 		struct ust_app_stream stream;
 
-		ret = duplicate_stream_object(reg_stream, &stream);
-		if (ret < 0) {
-			goto error_stream_unlock;
-		}
+		stream.obj = reg_stream->obj.ust;
+		stream.handle = stream.obj->handle;
 
 		ret = ust_consumer_send_stream_to_ust(app, ua_chan, &stream);
 		if (ret < 0) {
-			(void) release_ust_app_stream(-1, &stream, app);
 			if (ret == -EPIPE || ret == -LTTNG_UST_ERR_EXITING) {
 				ret = -ENOTCONN; /* Caused by app exiting. */
 			}
 			goto error_stream_unlock;
 		}
-
-		/*
-		 * The return value is not important here. This function will output an
-		 * error if needed.
-		 */
-		(void) release_ust_app_stream(-1, &stream, app);
 	}
 	ua_chan->is_sent = 1;
+	release_channel_obj_fds(app, ua_chan);
 
 error_stream_unlock:
 	pthread_mutex_unlock(&reg_chan->stream_list_lock);
@@ -2843,78 +3011,133 @@ error:
 }
 
 /*
- * Create and send to the application the created buffers with per UID buffers.
+ * Create the buffers of a channel with per UID buffers on the consumer and
+ * add them to the buffer registry of the UID. If regp pointer is valid, it's
+ * set with the created object.
  *
  * Return 0 on success else a negative value.
  */
-static int create_channel_per_uid(struct ust_app *app,
+static int create_channel_uid(struct ust_app *app,
 		struct ltt_ust_session *usess, struct ust_app_session *ua_sess,
-		struct ust_app_channel *ua_chan)
+		struct ust_app_channel *ua_chan, struct buffer_reg_uid *reg_uid,
+		struct buffer_reg_channel **regp)
 {
 	int ret;
-	struct buffer_reg_uid *reg_uid;
+	enum lttng_error_code cmd_ret;
+	struct ltt_session *session;
 	struct buffer_reg_channel *reg_chan;
-	bool created = false;
-
-	assert(app);
-	assert(usess);
-	assert(ua_sess);
-	assert(ua_chan);
+	struct ust_registry_channel *chan_reg;
 
-	DBG("UST app creating channel %s with per UID buffers", ua_chan->name);
+	/* Create the buffer registry channel object. */
+	ret = create_buffer_reg_channel(reg_uid->registry, ua_chan, &reg_chan);
+	if (ret < 0) {
+		ERR("Error creating the UST channel \"%s\" registry instance",
+			ua_chan->name);
+		goto error;
+	}
+	assert(reg_chan);
 
-	reg_uid = buffer_reg_uid_find(usess->id, app->bits_per_long, app->uid);
 	/*
-	 * The session creation handles the creation of this global registry
-	 * object. If none can be find, there is a code flow problem or a
-	 * teardown race.
+	 * Create the buffers on the consumer side. This call populates the
+	 * ust app channel object with all streams and data object.
 	 */
-	assert(reg_uid);
-
-	reg_chan = buffer_reg_channel_find(ua_chan->tracing_channel_id,
-			reg_uid);
-	if (!reg_chan) {
-		/* Create the buffer registry channel object. */
-		ret = create_buffer_reg_channel(reg_uid->registry, ua_chan, &reg_chan);
-		if (ret < 0) {
-			ERR("Error creating the UST channel \"%s\" registry instance",
-				ua_chan->name);
-			goto error;
-		}
-		assert(reg_chan);
+	ret = do_consumer_create_channel(usess, ua_sess, ua_chan,
+			app->bits_per_long, reg_uid->registry->reg.ust);
+	if (ret < 0) {
+		ERR("Error creating UST channel \"%s\" on the consumer daemon",
+			ua_chan->name);
 
 		/*
-		 * Create the buffers on the consumer side. This call populates the
-		 * ust app channel object with all streams and data object.
+		 * Let's remove the previously created buffer registry channel so
+		 * it's not visible anymore in the session registry.
 		 */
-		ret = do_consumer_create_channel(usess, ua_sess, ua_chan,
-				app->bits_per_long, reg_uid->registry->reg.ust);
-		if (ret < 0) {
-			ERR("Error creating UST channel \"%s\" on the consumer daemon",
-				ua_chan->name);
+		ust_registry_channel_del_free(reg_uid->registry->reg.ust,
+				ua_chan->tracing_channel_id, false);
+		buffer_reg_channel_remove(reg_uid->registry, reg_chan);
+		buffer_reg_channel_destroy(reg_chan, LTTNG_DOMAIN_UST);
+		goto error;
+	}
 
-			/*
-			 * Let's remove the previously created buffer registry channel so
-			 * it's not visible anymore in the session registry.
-			 */
-			ust_registry_channel_del_free(reg_uid->registry->reg.ust,
-					ua_chan->tracing_channel_id, false);
-			buffer_reg_channel_remove(reg_uid->registry, reg_chan);
-			buffer_reg_channel_destroy(reg_chan, LTTNG_DOMAIN_UST);
-			goto error;
-		}
+	/*
+	 * Setup the streams and add it to the session registry.
+	 */
+	ret = setup_buffer_reg_channel(reg_uid->registry,
+			ua_chan, reg_chan, app);
+	if (ret < 0) {
+		ERR("Error setting up UST channel \"%s\"",
+			ua_chan->name);
+		goto error;
+	}
 
-		/*
-		 * Setup the streams and add it to the session registry.
-		 */
-		ret = setup_buffer_reg_channel(reg_uid->registry,
-				ua_chan, reg_chan, app);
+	rcu_read_lock();
+	pthread_mutex_lock(&reg_uid->registry->reg.ust->lock);
+	chan_reg = ust_registry_channel_find(reg_uid->registry->reg.ust,
+			ua_chan->tracing_channel_id);
+	assert(chan_reg);
+	chan_reg->consumer_key = ua_chan->key;
+	pthread_mutex_unlock(&reg_uid->registry->reg.ust->lock);
+
+	session = session_find_by_id(ua_sess->tracing_id);
+	assert(session);
+
+	cmd_ret = notification_thread_command_add_channel(
+			notification_thread_handle, session->name,
+			ua_sess->euid, ua_sess->egid,
+			ua_chan->name,
+			ua_chan->key,
+			LTTNG_DOMAIN_UST,
+			ua_chan->attr.subbuf_size * ua_chan->attr.num_subbuf,
+			ua_chan->attr.subbuf_size);
+	rcu_read_unlock();
+	if (cmd_ret != LTTNG_OK) {
+		ret = - (int) cmd_ret;
+		ERR("Failed to add channel to notification thread");
+		goto error;
+	}
+
+	if (regp) {
+		*regp = reg_chan;
+	}
+error:
+	return ret;
+}
+
+/*
+ * Create and send to the application the created buffers with per UID buffers.
+ *
+ * Return 0 on success else a negative value.
+ */
+static int create_channel_per_uid(struct ust_app *app,
+		struct ltt_ust_session *usess, struct ust_app_session *ua_sess,
+		struct ust_app_channel *ua_chan)
+{
+	int ret;
+	struct buffer_reg_uid *reg_uid;
+	struct buffer_reg_channel *reg_chan;
+
+	assert(app);
+	assert(usess);
+	assert(ua_sess);
+	assert(ua_chan);
+
+	DBG("UST app creating channel %s with per UID buffers", ua_chan->name);
+
+	reg_uid = buffer_reg_uid_find(usess->id, app->bits_per_long, app->uid);
+	/*
+	 * The session creation handles the creation of this global registry
+	 * object. If none can be find, there is a code flow problem or a
+	 * teardown race.
+	 */
+	assert(reg_uid);
+
+	reg_chan = buffer_reg_channel_find(ua_chan->tracing_channel_id,
+			reg_uid);
+	if (!reg_chan) {
+		ret = create_channel_uid(app, usess, ua_sess, ua_chan, reg_uid,
+				&reg_chan);
 		if (ret < 0) {
-			ERR("Error setting up UST channel \"%s\"",
-				ua_chan->name);
 			goto error;
 		}
-		created = true;
 	}
 
 	/* Send buffers to the application. */
@@ -2926,41 +3149,6 @@ static int create_channel_per_uid(struct ust_app *app,
 		goto error;
 	}
 
-	if (created) {
-		enum lttng_error_code cmd_ret;
-		struct ltt_session *session;
-		uint64_t chan_reg_key;
-		struct ust_registry_channel *chan_reg;
-
-		rcu_read_lock();
-		chan_reg_key = ua_chan->tracing_channel_id;
-
-		pthread_mutex_lock(&reg_uid->registry->reg.ust->lock);
-		chan_reg = ust_registry_channel_find(reg_uid->registry->reg.ust,
-				chan_reg_key);
-		assert(chan_reg);
-		chan_reg->consumer_key = ua_chan->key;
-		chan_reg = NULL;
-		pthread_mutex_unlock(&reg_uid->registry->reg.ust->lock);
-
-		session = session_find_by_id(ua_sess->tracing_id);
-		assert(session);
-
-		cmd_ret = notification_thread_command_add_channel(
-				notification_thread_handle, session->name,
-				ua_sess->euid, ua_sess->egid,
-				ua_chan->name,
-				ua_chan->key,
-				LTTNG_DOMAIN_UST,
-				ua_chan->attr.subbuf_size * ua_chan->attr.num_subbuf);
-		rcu_read_unlock();
-		if (cmd_ret != LTTNG_OK) {
-			ret = - (int) cmd_ret;
-			ERR("Failed to add channel to notification thread");
-			goto error;
-		}
-	}
-
 error:
 	return ret;
 }
@@ -3037,7 +3225,8 @@ static int create_channel_per_pid(struct ust_app *app,
 			ua_chan->name,
 			ua_chan->key,
 			LTTNG_DOMAIN_UST,
-			ua_chan->attr.subbuf_size * ua_chan->attr.num_subbuf);
+			ua_chan->attr.subbuf_size * ua_chan->attr.num_subbuf,
+			ua_chan->attr.subbuf_size);
 	if (cmd_ret != LTTNG_OK) {
 		ret = - (int) cmd_ret;
 		ERR("Failed to add channel to notification thread");
@@ -3167,7 +3356,8 @@ end:
 	return 0;
 
 error:
-	delete_ust_app_channel(ua_chan->is_sent ? app->sock : -1, ua_chan, app);
+	delete_ust_app_channel(ua_chan->is_sent ? app->sock : -1, ua_chan, app,
+			NULL);
 error_alloc:
 	return ret;
 }
@@ -3194,7 +3384,7 @@ int create_ust_app_event(struct ust_app_session *ua_sess,
 	}
 
 	/* Does not exist so create one */
-	ua_event = alloc_ust_app_event(uevent->attr.name, &uevent->attr);
+	ua_event = alloc_ust_app_event(&ua_sess->arena, uevent->conf);
 	if (ua_event == NULL) {
 		/* Only malloc can failed so something is really wrong */
 		ret = -ENOMEM;
@@ -3212,8 +3402,8 @@ int create_ust_app_event(struct ust_app_session *ua_sess,
 
 	add_unique_ust_app_event(ua_chan, ua_event);
 
-	DBG2("UST app create event %s for PID %d completed", ua_event->name,
-			app->pid);
+	DBG2("UST app create event %s for PID %d completed",
+			ua_event->conf->attr.name, app->pid);
 
 end:
 	return ret;
@@ -3317,7 +3507,7 @@ static int create_ust_app_metadata(struct ust_app_session *ua_sess,
 
 error_consumer:
 	lttng_fd_put(LTTNG_FD_APPS, 1);
-	delete_ust_app_channel(-1, metadata, app);
+	delete_ust_app_channel(-1, metadata, app, NULL);
 error:
 	pthread_mutex_unlock(&registry->lock);
 	return ret;
@@ -3364,6 +3554,17 @@ struct ust_app *ust_app_create(struct ust_register_msg *msg, int sock)
 
 	DBG3("UST app creating application for socket %d", sock);
 
+	/*
+	 * A session daemon tracing itself or its consumer daemons would loop
+	 * on its own events. Self-tracing must go to another session daemon.
+	 */
+	if (msg->pid == getpid() || msg->ppid == getpid()) {
+		DBG("Registration refused: application \"%s\" (pid: %d) is "
+				"this session daemon or one of its children",
+				msg->name, msg->pid);
+		goto error;
+	}
+
 	if ((msg->bits_per_long == 64 &&
 				(uatomic_read(&ust_consumerd64_fd) == -EINVAL))
 			|| (msg->bits_per_long == 32 &&
@@ -3414,6 +3615,7 @@ struct ust_app *ust_app_create(struct ust_register_msg *msg, int sock)
 	lttng_ht_node_init_ulong(&lta->pid_n, (unsigned long) lta->pid);
 	lta->sock = sock;
 	pthread_mutex_init(&lta->sock_lock, NULL);
+	pthread_mutex_init(&lta->list_cache_lock, NULL);
 	lttng_ht_node_init_ulong(&lta->sock_n, (unsigned long) lta->sock);
 
 	CDS_INIT_LIST_HEAD(&lta->teardown_head);
@@ -3483,12 +3685,12 @@ int ust_app_version(struct ust_app *app)
 }
 
 /*
- * Unregister app by removing it from the global traceable app list and freeing
- * the data struct.
+ * Remove the app of a socket from the global traceable app lists. The app
+ * must be freed with delete_ust_app_rcu after a grace period.
  *
- * The socket is already closed at this point so no close to sock.
+ * Called with the RCU read side lock held.
  */
-void ust_app_unregister(int sock)
+static struct ust_app *unregister_app(int sock)
 {
 	struct ust_app *lta;
 	struct lttng_ht_node_ulong *node;
@@ -3497,8 +3699,6 @@ void ust_app_unregister(int sock)
 	struct ust_app_session *ua_sess;
 	int ret;
 
-	rcu_read_lock();
-
 	/* Get the node reference for a call_rcu */
 	lttng_ht_lookup(ust_app_ht_by_sock, (void *)((unsigned long) sock), &ust_app_sock_iter);
 	node = lttng_ht_iter_get_node_ulong(&ust_app_sock_iter);
@@ -3595,6 +3795,22 @@ void ust_app_unregister(int sock)
 				lta->pid);
 	}
 
+	return lta;
+}
+
+/*
+ * Unregister app by removing it from the global traceable app list and freeing
+ * the data struct.
+ *
+ * The socket is already closed at this point so no close to sock.
+ */
+void ust_app_unregister(int sock)
+{
+	struct ust_app *lta;
+
+	rcu_read_lock();
+	lta = unregister_app(sock);
+
 	/* Free memory */
 	call_rcu(&lta->pid_n.head, delete_ust_app_rcu);
 
@@ -3603,11 +3819,410 @@ void ust_app_unregister(int sock)
 }
 
 /*
- * Fill events array with all events name of all registered apps.
+ * Unregister the apps of "nr_socks" sockets at once. The apps are deleted
+ * after a single grace period, which keeps a mass application exit from
+ * queuing one call_rcu and one session list lock acquisition per app.
+ */
+void ust_app_unregister_batch(int *socks, unsigned int nr_socks)
+{
+	unsigned int i;
+	struct ust_app_teardown_batch *batch;
+
+	if (!nr_socks) {
+		return;
+	}
+
+	batch = zmalloc(sizeof(*batch) + nr_socks * sizeof(*batch->apps));
+	if (!batch) {
+		PERROR("zmalloc ust app teardown batch");
+	}
+
+	rcu_read_lock();
+	for (i = 0; i < nr_socks; i++) {
+		struct ust_app *lta = unregister_app(socks[i]);
+
+		if (batch) {
+			batch->apps[batch->nr_apps++] = lta;
+		} else {
+			call_rcu(&lta->pid_n.head, delete_ust_app_rcu);
+		}
+	}
+	if (batch) {
+		call_rcu(&batch->head, delete_ust_app_batch_rcu);
+	}
+	rcu_read_unlock();
+}
+
+/*
+ * Grow "*array", of "*nbmem" entries of "entry_size" bytes of which "count"
+ * are used, so it holds at least "count + n" entries. The new entries are
+ * zeroed.
+ *
+ * Return 0 on success or else -ENOMEM, in which case "*array" is untouched.
+ */
+static int reserve_list_entries(void **array, size_t *nbmem, size_t count,
+		size_t n, size_t entry_size)
+{
+	void *new_array;
+	size_t new_nbmem = max_t(size_t, *nbmem, UST_APP_EVENT_LIST_SIZE);
+
+	if (count + n <= *nbmem) {
+		return 0;
+	}
+	while (new_nbmem < count + n) {
+		new_nbmem <<= 1;
+	}
+	DBG2("Reallocating list from %zu to %zu entries", *nbmem, new_nbmem);
+	new_array = realloc(*array, new_nbmem * entry_size);
+	if (new_array == NULL) {
+		PERROR("realloc ust app list");
+		return -ENOMEM;
+	}
+	/* Zero the new memory */
+	memset((char *) new_array + *nbmem * entry_size, 0,
+			(new_nbmem - *nbmem) * entry_size);
+	*array = new_array;
+	*nbmem = new_nbmem;
+	return 0;
+}
+
+/*
+ * Append the "n" entries of "entry_size" bytes at "src" to the "*array" list
+ * of "*nbmem" entries, of which "*count" are used.
+ *
+ * Return 0 on success or else -ENOMEM.
  */
-int ust_app_list_events(struct lttng_event **events)
+static int append_list_entries(void **array, size_t *nbmem, size_t *count,
+		const void *src, size_t n, size_t entry_size)
+{
+	int ret;
+
+	ret = reserve_list_entries(array, nbmem, *count, n, entry_size);
+	if (ret < 0) {
+		return ret;
+	}
+	if (n) {
+		memcpy((char *) *array + *count * entry_size, src, n * entry_size);
+	}
+	*count += n;
+	return 0;
+}
+
+/*
+ * Release a listing handle of an app. Called with the app socket lock held.
+ */
+static void release_list_handle(struct ust_app *app, int handle)
+{
+	int ret;
+
+	ret = ustctl_release_handle(app->sock, handle);
+	if (ret < 0 && ret != -LTTNG_UST_ERR_EXITING && ret != -EPIPE) {
+		ERR("Error releasing app handle for app %d with ret %d",
+				app->sock, ret);
+	}
+}
+
+/*
+ * Get the tracepoints of an app from its tracer, in a new array of "*count"
+ * entries. Called with the app socket lock held.
+ *
+ * Return 0 on success, 1 if the app could not be listed completely, which is
+ * not an error since the app may be dying, or else a negative value.
+ */
+static int fetch_app_events(struct ust_app *app, struct lttng_event **events,
+		size_t *count)
 {
 	int ret, handle;
+	size_t nbmem = 0;
+	struct lttng_ust_tracepoint_iter uiter;
+
+	*events = NULL;
+	*count = 0;
+
+	handle = ustctl_tracepoint_list(app->sock);
+	if (handle < 0) {
+		if (handle != -EPIPE && handle != -LTTNG_UST_ERR_EXITING) {
+			ERR("UST app list events getting handle failed for app pid %d",
+					app->pid);
+		}
+		return 1;
+	}
+
+	while ((ret = ustctl_tracepoint_list_get(app->sock, handle,
+				&uiter)) != -LTTNG_UST_ERR_NOENT) {
+		/* Handle ustctl error. */
+		if (ret < 0) {
+			if (ret != -LTTNG_UST_ERR_EXITING && ret != -EPIPE) {
+				ERR("UST app tp list get failed for app %d with ret %d",
+						app->sock, ret);
+				goto release;
+			}
+			DBG3("UST app tp list get failed. Application is dead");
+			/*
+			 * This is normal behavior, an application can die during the
+			 * creation process. Don't report an error so the execution can
+			 * continue normally.
+			 */
+			ret = 1;
+			goto release;
+		}
+
+		health_code_update();
+		ret = reserve_list_entries((void **) events, &nbmem, *count, 1,
+				sizeof(**events));
+		if (ret < 0) {
+			goto release;
+		}
+		memcpy((*events)[*count].name, uiter.name, LTTNG_UST_SYM_NAME_LEN);
+		(*events)[*count].loglevel = uiter.loglevel;
+		(*events)[*count].type = (enum lttng_event_type) LTTNG_UST_TRACEPOINT;
+		(*events)[*count].pid = app->pid;
+		(*events)[*count].enabled = -1;
+		(*count)++;
+	}
+	ret = 0;
+
+release:
+	release_list_handle(app, handle);
+	if (ret < 0) {
+		free(*events);
+		*events = NULL;
+		*count = 0;
+	}
+	return ret;
+}
+
+/*
+ * Get the tracepoint fields of an app from its tracer, in a new array of
+ * "*count" entries. Called with the app socket lock held.
+ *
+ * Return 0 on success, 1 if the app could not be listed completely, which is
+ * not an error since the app may be dying, or else a negative value.
+ */
+static int fetch_app_event_fields(struct ust_app *app,
+		struct lttng_event_field **fields, size_t *count)
+{
+	int ret, handle;
+	size_t nbmem = 0;
+	struct lttng_ust_field_iter uiter;
+
+	*fields = NULL;
+	*count = 0;
+
+	handle = ustctl_tracepoint_field_list(app->sock);
+	if (handle < 0) {
+		if (handle != -EPIPE && handle != -LTTNG_UST_ERR_EXITING) {
+			ERR("UST app list field getting handle failed for app pid %d",
+					app->pid);
+		}
+		return 1;
+	}
+
+	while ((ret = ustctl_tracepoint_field_list_get(app->sock, handle,
+				&uiter)) != -LTTNG_UST_ERR_NOENT) {
+		/* Handle ustctl error. */
+		if (ret < 0) {
+			if (ret != -LTTNG_UST_ERR_EXITING && ret != -EPIPE) {
+				ERR("UST app tp list field failed for app %d with ret %d",
+						app->sock, ret);
+				goto release;
+			}
+			DBG3("UST app tp list field failed. Application is dead");
+			/*
+			 * This is normal behavior, an application can die during the
+			 * creation process. Don't report an error so the execution can
+			 * continue normally.
+			 */
+			ret = 1;
+			goto release;
+		}
+
+		health_code_update();
+		ret = reserve_list_entries((void **) fields, &nbmem, *count, 1,
+				sizeof(**fields));
+		if (ret < 0) {
+			goto release;
+		}
+		memcpy((*fields)[*count].field_name, uiter.field_name,
+				LTTNG_UST_SYM_NAME_LEN);
+		/* Mapping between these enums matches 1 to 1. */
+		(*fields)[*count].type = (enum lttng_event_field_type) uiter.type;
+		(*fields)[*count].nowrite = uiter.nowrite;
+
+		memcpy((*fields)[*count].event.name, uiter.event_name,
+				LTTNG_UST_SYM_NAME_LEN);
+		(*fields)[*count].event.loglevel = uiter.loglevel;
+		(*fields)[*count].event.type = LTTNG_EVENT_TRACEPOINT;
+		(*fields)[*count].event.pid = app->pid;
+		(*fields)[*count].event.enabled = -1;
+		(*count)++;
+	}
+	ret = 0;
+
+release:
+	release_list_handle(app, handle);
+	if (ret < 0) {
+		free(*fields);
+		*fields = NULL;
+		*count = 0;
+	}
+	return ret;
+}
+
+/*
+ * Append the events of an app to the "events" array of "*nbmem" entries, of
+ * which "*count" are used. RCU read side lock must be held.
+ *
+ * The events are served from the cache of the app when it is still valid,
+ * that is when the app registered no event since it was filled.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static int list_app_events(struct ust_app *app, struct lttng_event **events,
+		size_t *nbmem, size_t *count)
+{
+	int ret;
+	unsigned long gen;
+	size_t nr_app_events;
+	struct lttng_event *app_events;
+
+	health_code_update();
+
+	if (!app->compatible) {
+		/*
+		 * TODO: In time, we should notice the caller of this error by
+		 * telling him that this is a version error.
+		 */
+		return 0;
+	}
+
+	pthread_mutex_lock(&app->list_cache_lock);
+	gen = uatomic_read(&app->registered_events_gen);
+	if (app->events_cache.valid && app->events_cache.gen == gen) {
+		ret = append_list_entries((void **) events, nbmem, count,
+				app->events_cache.events, app->events_cache.count,
+				sizeof(**events));
+		goto end;
+	}
+
+	pthread_mutex_lock(&app->sock_lock);
+	ret = fetch_app_events(app, &app_events, &nr_app_events);
+	pthread_mutex_unlock(&app->sock_lock);
+	if (ret < 0) {
+		goto end;
+	}
+	if (append_list_entries((void **) events, nbmem, count, app_events,
+			nr_app_events, sizeof(**events))) {
+		free(app_events);
+		ret = -ENOMEM;
+		goto end;
+	}
+	if (cache_app_lists && ret == 0) {
+		free(app->events_cache.events);
+		app->events_cache.events = app_events;
+		app->events_cache.count = nr_app_events;
+		app->events_cache.gen = gen;
+		app->events_cache.valid = 1;
+	} else {
+		free(app_events);
+	}
+	ret = 0;
+end:
+	pthread_mutex_unlock(&app->list_cache_lock);
+	return ret;
+}
+
+/*
+ * Append the event fields of an app to the "fields" array of "*nbmem"
+ * entries, of which "*count" are used. RCU read side lock must be held.
+ *
+ * Cached like the events, see list_app_events().
+ *
+ * Return 0 on success or else a negative value.
+ */
+static int list_app_event_fields(struct ust_app *app,
+		struct lttng_event_field **fields, size_t *nbmem, size_t *count)
+{
+	int ret;
+	unsigned long gen;
+	size_t nr_app_fields;
+	struct lttng_event_field *app_fields;
+
+	health_code_update();
+
+	if (!app->compatible) {
+		/*
+		 * TODO: In time, we should notice the caller of this error by
+		 * telling him that this is a version error.
+		 */
+		return 0;
+	}
+
+	pthread_mutex_lock(&app->list_cache_lock);
+	gen = uatomic_read(&app->registered_events_gen);
+	if (app->fields_cache.valid && app->fields_cache.gen == gen) {
+		ret = append_list_entries((void **) fields, nbmem, count,
+				app->fields_cache.fields, app->fields_cache.count,
+				sizeof(**fields));
+		goto end;
+	}
+
+	pthread_mutex_lock(&app->sock_lock);
+	ret = fetch_app_event_fields(app, &app_fields, &nr_app_fields);
+	pthread_mutex_unlock(&app->sock_lock);
+	if (ret < 0) {
+		goto end;
+	}
+	if (append_list_entries((void **) fields, nbmem, count, app_fields,
+			nr_app_fields, sizeof(**fields))) {
+		free(app_fields);
+		ret = -ENOMEM;
+		goto end;
+	}
+	if (cache_app_lists && ret == 0) {
+		free(app->fields_cache.fields);
+		app->fields_cache.fields = app_fields;
+		app->fields_cache.count = nr_app_fields;
+		app->fields_cache.gen = gen;
+		app->fields_cache.valid = 1;
+	} else {
+		free(app_fields);
+	}
+	ret = 0;
+end:
+	pthread_mutex_unlock(&app->list_cache_lock);
+	return ret;
+}
+
+/*
+ * Find the compatible app with the smallest pid greater than "pid". RCU read
+ * side lock must be held.
+ */
+static struct ust_app *find_next_app_by_pid(pid_t pid)
+{
+	struct lttng_ht_iter iter;
+	struct ust_app *app, *next = NULL;
+
+	cds_lfht_for_each_entry(ust_app_ht->ht, &iter.iter, app, pid_n.node) {
+		if (app->compatible && app->pid > pid &&
+				(!next || app->pid < next->pid)) {
+			next = app;
+		}
+	}
+	return next;
+}
+
+/*
+ * Fill events array with all events name of all registered apps.
+ *
+ * If "page_len" is not 0, only list the events of the apps following the pid
+ * "pid_cursor", in increasing order of pid, until "page_len" events are
+ * listed. The events of an app are never split across pages.
+ */
+int ust_app_list_events(struct lttng_event **events, pid_t pid_cursor,
+		unsigned int page_len)
+{
+	int ret;
 	size_t nbmem, count = 0;
 	struct lttng_ht_iter iter;
 	struct ust_app *app;
@@ -3623,101 +4238,24 @@ int ust_app_list_events(struct lttng_event **events)
 
 	rcu_read_lock();
 
-	cds_lfht_for_each_entry(ust_app_ht->ht, &iter.iter, app, pid_n.node) {
-		struct lttng_ust_tracepoint_iter uiter;
-
-		health_code_update();
-
-		if (!app->compatible) {
-			/*
-			 * TODO: In time, we should notice the caller of this error by
-			 * telling him that this is a version error.
-			 */
-			continue;
-		}
-		pthread_mutex_lock(&app->sock_lock);
-		handle = ustctl_tracepoint_list(app->sock);
-		if (handle < 0) {
-			if (handle != -EPIPE && handle != -LTTNG_UST_ERR_EXITING) {
-				ERR("UST app list events getting handle failed for app pid %d",
-						app->pid);
+	if (!page_len) {
+		cds_lfht_for_each_entry(ust_app_ht->ht, &iter.iter, app,
+				pid_n.node) {
+			ret = list_app_events(app, &tmp_event, &nbmem, &count);
+			if (ret < 0) {
+				free(tmp_event);
+				goto rcu_error;
 			}
-			pthread_mutex_unlock(&app->sock_lock);
-			continue;
 		}
-
-		while ((ret = ustctl_tracepoint_list_get(app->sock, handle,
-					&uiter)) != -LTTNG_UST_ERR_NOENT) {
-			/* Handle ustctl error. */
+	} else {
+		while (count < page_len &&
+				(app = find_next_app_by_pid(pid_cursor))) {
+			ret = list_app_events(app, &tmp_event, &nbmem, &count);
 			if (ret < 0) {
-				int release_ret;
-
-				if (ret != -LTTNG_UST_ERR_EXITING && ret != -EPIPE) {
-					ERR("UST app tp list get failed for app %d with ret %d",
-							app->sock, ret);
-				} else {
-					DBG3("UST app tp list get failed. Application is dead");
-					/*
-					 * This is normal behavior, an application can die during the
-					 * creation process. Don't report an error so the execution can
-					 * continue normally. Continue normal execution.
-					 */
-					break;
-				}
 				free(tmp_event);
-				release_ret = ustctl_release_handle(app->sock, handle);
-				if (release_ret < 0 &&
-						release_ret != -LTTNG_UST_ERR_EXITING &&
-						release_ret != -EPIPE) {
-					ERR("Error releasing app handle for app %d with ret %d", app->sock, release_ret);
-				}
-				pthread_mutex_unlock(&app->sock_lock);
 				goto rcu_error;
 			}
-
-			health_code_update();
-			if (count >= nbmem) {
-				/* In case the realloc fails, we free the memory */
-				struct lttng_event *new_tmp_event;
-				size_t new_nbmem;
-
-				new_nbmem = nbmem << 1;
-				DBG2("Reallocating event list from %zu to %zu entries",
-						nbmem, new_nbmem);
-				new_tmp_event = realloc(tmp_event,
-					new_nbmem * sizeof(struct lttng_event));
-				if (new_tmp_event == NULL) {
-					int release_ret;
-
-					PERROR("realloc ust app events");
-					free(tmp_event);
-					ret = -ENOMEM;
-					release_ret = ustctl_release_handle(app->sock, handle);
-					if (release_ret < 0 &&
-							release_ret != -LTTNG_UST_ERR_EXITING &&
-							release_ret != -EPIPE) {
-						ERR("Error releasing app handle for app %d with ret %d", app->sock, release_ret);
-					}
-					pthread_mutex_unlock(&app->sock_lock);
-					goto rcu_error;
-				}
-				/* Zero the new memory */
-				memset(new_tmp_event + nbmem, 0,
-					(new_nbmem - nbmem) * sizeof(struct lttng_event));
-				nbmem = new_nbmem;
-				tmp_event = new_tmp_event;
-			}
-			memcpy(tmp_event[count].name, uiter.name, LTTNG_UST_SYM_NAME_LEN);
-			tmp_event[count].loglevel = uiter.loglevel;
-			tmp_event[count].type = (enum lttng_event_type) LTTNG_UST_TRACEPOINT;
-			tmp_event[count].pid = app->pid;
-			tmp_event[count].enabled = -1;
-			count++;
-		}
-		ret = ustctl_release_handle(app->sock, handle);
-		pthread_mutex_unlock(&app->sock_lock);
-		if (ret < 0 && ret != -LTTNG_UST_ERR_EXITING && ret != -EPIPE) {
-			ERR("Error releasing app handle for app %d with ret %d", app->sock, ret);
+			pid_cursor = app->pid;
 		}
 	}
 
@@ -3734,11 +4272,14 @@ error:
 }
 
 /*
- * Fill events array with all events name of all registered apps.
+ * Fill fields array with all events fields of all registered apps.
+ *
+ * Paged like the events, see ust_app_list_events().
  */
-int ust_app_list_event_fields(struct lttng_event_field **fields)
+int ust_app_list_event_fields(struct lttng_event_field **fields,
+		pid_t pid_cursor, unsigned int page_len)
 {
-	int ret, handle;
+	int ret;
 	size_t nbmem, count = 0;
 	struct lttng_ht_iter iter;
 	struct ust_app *app;
@@ -3754,109 +4295,26 @@ int ust_app_list_event_fields(struct lttng_event_field **fields)
 
 	rcu_read_lock();
 
-	cds_lfht_for_each_entry(ust_app_ht->ht, &iter.iter, app, pid_n.node) {
-		struct lttng_ust_field_iter uiter;
-
-		health_code_update();
-
-		if (!app->compatible) {
-			/*
-			 * TODO: In time, we should notice the caller of this error by
-			 * telling him that this is a version error.
-			 */
-			continue;
-		}
-		pthread_mutex_lock(&app->sock_lock);
-		handle = ustctl_tracepoint_field_list(app->sock);
-		if (handle < 0) {
-			if (handle != -EPIPE && handle != -LTTNG_UST_ERR_EXITING) {
-				ERR("UST app list field getting handle failed for app pid %d",
-						app->pid);
+	if (!page_len) {
+		cds_lfht_for_each_entry(ust_app_ht->ht, &iter.iter, app,
+				pid_n.node) {
+			ret = list_app_event_fields(app, &tmp_event, &nbmem,
+					&count);
+			if (ret < 0) {
+				free(tmp_event);
+				goto rcu_error;
 			}
-			pthread_mutex_unlock(&app->sock_lock);
-			continue;
 		}
-
-		while ((ret = ustctl_tracepoint_field_list_get(app->sock, handle,
-					&uiter)) != -LTTNG_UST_ERR_NOENT) {
-			/* Handle ustctl error. */
+	} else {
+		while (count < page_len &&
+				(app = find_next_app_by_pid(pid_cursor))) {
+			ret = list_app_event_fields(app, &tmp_event, &nbmem,
+					&count);
 			if (ret < 0) {
-				int release_ret;
-
-				if (ret != -LTTNG_UST_ERR_EXITING && ret != -EPIPE) {
-					ERR("UST app tp list field failed for app %d with ret %d",
-							app->sock, ret);
-				} else {
-					DBG3("UST app tp list field failed. Application is dead");
-					/*
-					 * This is normal behavior, an application can die during the
-					 * creation process. Don't report an error so the execution can
-					 * continue normally. Reset list and count for next app.
-					 */
-					break;
-				}
 				free(tmp_event);
-				release_ret = ustctl_release_handle(app->sock, handle);
-				pthread_mutex_unlock(&app->sock_lock);
-				if (release_ret < 0 &&
-						release_ret != -LTTNG_UST_ERR_EXITING &&
-						release_ret != -EPIPE) {
-					ERR("Error releasing app handle for app %d with ret %d", app->sock, release_ret);
-				}
 				goto rcu_error;
 			}
-
-			health_code_update();
-			if (count >= nbmem) {
-				/* In case the realloc fails, we free the memory */
-				struct lttng_event_field *new_tmp_event;
-				size_t new_nbmem;
-
-				new_nbmem = nbmem << 1;
-				DBG2("Reallocating event field list from %zu to %zu entries",
-						nbmem, new_nbmem);
-				new_tmp_event = realloc(tmp_event,
-					new_nbmem * sizeof(struct lttng_event_field));
-				if (new_tmp_event == NULL) {
-					int release_ret;
-
-					PERROR("realloc ust app event fields");
-					free(tmp_event);
-					ret = -ENOMEM;
-					release_ret = ustctl_release_handle(app->sock, handle);
-					pthread_mutex_unlock(&app->sock_lock);
-					if (release_ret &&
-							release_ret != -LTTNG_UST_ERR_EXITING &&
-							release_ret != -EPIPE) {
-						ERR("Error releasing app handle for app %d with ret %d", app->sock, release_ret);
-					}
-					goto rcu_error;
-				}
-				/* Zero the new memory */
-				memset(new_tmp_event + nbmem, 0,
-					(new_nbmem - nbmem) * sizeof(struct lttng_event_field));
-				nbmem = new_nbmem;
-				tmp_event = new_tmp_event;
-			}
-
-			memcpy(tmp_event[count].field_name, uiter.field_name, LTTNG_UST_SYM_NAME_LEN);
-			/* Mapping between these enums matches 1 to 1. */
-			tmp_event[count].type = (enum lttng_event_field_type) uiter.type;
-			tmp_event[count].nowrite = uiter.nowrite;
-
-			memcpy(tmp_event[count].event.name, uiter.event_name, LTTNG_UST_SYM_NAME_LEN);
-			tmp_event[count].event.loglevel = uiter.loglevel;
-			tmp_event[count].event.type = LTTNG_EVENT_TRACEPOINT;
-			tmp_event[count].event.pid = app->pid;
-			tmp_event[count].event.enabled = -1;
-			count++;
-		}
-		ret = ustctl_release_handle(app->sock, handle);
-		pthread_mutex_unlock(&app->sock_lock);
-		if (ret < 0 &&
-				ret != -LTTNG_UST_ERR_EXITING &&
-				ret != -EPIPE) {
-			ERR("Error releasing app handle for app %d with ret %d", app->sock, ret);
+			pid_cursor = app->pid;
 		}
 	}
 
@@ -3968,6 +4426,7 @@ int ust_app_disable_channel_glb(struct ltt_ust_session *usess,
 	DBG2("UST app disabling channel %s from global domain for session id %" PRIu64,
 			uchan->name, usess->id);
 
+	usess->config_version++;
 	rcu_read_lock();
 
 	/* For every registered applications */
@@ -4001,6 +4460,7 @@ int ust_app_disable_channel_glb(struct ltt_ust_session *usess,
 			/* XXX: We might want to report this error at some point... */
 			continue;
 		}
+		app_session_applied_change(usess, ua_sess);
 	}
 
 	rcu_read_unlock();
@@ -4029,6 +4489,7 @@ int ust_app_enable_channel_glb(struct ltt_ust_session *usess,
 	DBG2("UST app enabling channel %s to global domain for session id %" PRIu64,
 			uchan->name, usess->id);
 
+	usess->config_version++;
 	rcu_read_lock();
 
 	/* For every registered applications */
@@ -4051,6 +4512,7 @@ int ust_app_enable_channel_glb(struct ltt_ust_session *usess,
 			/* XXX: We might want to report this error at some point... */
 			continue;
 		}
+		app_session_applied_change(usess, ua_sess);
 	}
 
 	rcu_read_unlock();
@@ -4077,6 +4539,7 @@ int ust_app_disable_event_glb(struct ltt_ust_session *usess,
 			"%s for session id %" PRIu64,
 			uevent->attr.name, uchan->name, usess->id);
 
+	usess->config_version++;
 	rcu_read_lock();
 
 	/* For all registered applications */
@@ -4118,6 +4581,7 @@ int ust_app_disable_event_glb(struct ltt_ust_session *usess,
 			/* XXX: Report error someday... */
 			continue;
 		}
+		app_session_applied_change(usess, ua_sess);
 	}
 
 	rcu_read_unlock();
@@ -4143,6 +4607,7 @@ int ust_app_create_channel_glb(struct ltt_ust_session *usess,
 	DBG2("UST app adding channel %s to UST domain for session id %" PRIu64,
 			uchan->name, usess->id);
 
+	usess->config_version++;
 	rcu_read_lock();
 
 	/* For every registered applications */
@@ -4218,6 +4683,7 @@ int ust_app_create_channel_glb(struct ltt_ust_session *usess,
 				goto error_rcu_unlock;
 			}
 		}
+		app_session_applied_change(usess, ua_sess);
 	}
 
 error_rcu_unlock:
@@ -4248,6 +4714,7 @@ int ust_app_enable_event_glb(struct ltt_ust_session *usess,
 	 * tracer also.
 	 */
 
+	usess->config_version++;
 	rcu_read_lock();
 
 	/* For all registered applications */
@@ -4301,6 +4768,7 @@ int ust_app_enable_event_glb(struct ltt_ust_session *usess,
 			pthread_mutex_unlock(&ua_sess->lock);
 			goto error;
 		}
+		app_session_applied_change(usess, ua_sess);
 	next_app:
 		pthread_mutex_unlock(&ua_sess->lock);
 	}
@@ -4327,6 +4795,7 @@ int ust_app_create_event_glb(struct ltt_ust_session *usess,
 	DBG("UST app creating event %s for all apps for session id %" PRIu64,
 			uevent->attr.name, usess->id);
 
+	usess->config_version++;
 	rcu_read_lock();
 
 	/* For all registered applications */
@@ -4368,8 +4837,8 @@ int ust_app_create_event_glb(struct ltt_ust_session *usess,
 			}
 			DBG2("UST app event %s already exist on app PID %d",
 					uevent->attr.name, app->pid);
-			continue;
 		}
+		app_session_applied_change(usess, ua_sess);
 	}
 
 	rcu_read_unlock();
@@ -4378,13 +4847,16 @@ int ust_app_create_event_glb(struct ltt_ust_session *usess,
 }
 
 /*
- * Start tracing for a specific UST session and app.
+ * Start tracing for a specific UST session and app. If "start_ns" is not
+ * NULL, it is set to the time at which the application started tracing or
+ * 0 if it did not.
  *
  * Called with UST app session lock held.
  *
  */
 static
-int ust_app_start_trace(struct ltt_ust_session *usess, struct ust_app *app)
+int ust_app_start_trace(struct ltt_ust_session *usess, struct ust_app *app,
+		uint64_t *start_ns)
 {
 	int ret = 0;
 	struct ust_app_session *ua_sess;
@@ -4461,6 +4933,10 @@ skip_setup:
 		goto error_unlock;
 	}
 
+	if (start_ns) {
+		*start_ns = lttng_monotonic_time_ns();
+	}
+
 	/* Indicate that the session has been started once */
 	ua_sess->started = 1;
 
@@ -4646,6 +5122,75 @@ end_not_compatible:
 	return retval;
 }
 
+/*
+ * Call "fn" with "data" on every registered application, concurrently on the
+ * application update pool. The number of applications is returned in
+ * "nr_apps" if not NULL.
+ *
+ * Called with the RCU read side lock held, which keeps the applications
+ * alive for the duration of the calls.
+ *
+ * Return the number of calls which failed.
+ */
+static unsigned int run_on_all_apps(int (*fn)(struct ust_app *app, void *data),
+		void *data, unsigned int *nr_apps)
+{
+	unsigned int count = 0, nbmem = 0, nr_errors = 0;
+	struct ust_app **apps = NULL;
+	struct lttng_ht_iter iter;
+	struct ust_app *app;
+
+	cds_lfht_for_each_entry(ust_app_ht->ht, &iter.iter, app, pid_n.node) {
+		if (count == nbmem) {
+			struct ust_app **new_apps;
+			unsigned int new_nbmem = max_t(unsigned int, nbmem << 1,
+					DEFAULT_APP_UPDATE_BATCH);
+
+			new_apps = realloc(apps, new_nbmem * sizeof(*apps));
+			if (!new_apps) {
+				PERROR("realloc ust app array");
+				goto serial;
+			}
+			apps = new_apps;
+			nbmem = new_nbmem;
+		}
+		apps[count++] = app;
+	}
+
+	nr_errors = app_update_pool_run(apps, count, fn, data);
+	goto end;
+
+serial:
+	/* Fall back to calling fn on each application in turn. */
+	count = 0;
+	cds_lfht_for_each_entry(ust_app_ht->ht, &iter.iter, app, pid_n.node) {
+		if (fn(app, data) < 0) {
+			nr_errors++;
+		}
+		count++;
+	}
+end:
+	free(apps);
+	if (nr_apps) {
+		*nr_apps = count;
+	}
+	return nr_errors;
+}
+
+/*
+ * Flush the buffers of a per PID session for an application.
+ */
+static int flush_app_session(struct ust_app *app, void *data)
+{
+	struct ust_app_session *ua_sess;
+
+	ua_sess = lookup_session_by_app(data, app);
+	if (ua_sess == NULL) {
+		return 0;
+	}
+	return ust_app_flush_app_session(app, ua_sess);
+}
+
 /*
  * Flush buffers for all applications for a specific UST session.
  * Called with UST session lock held.
@@ -4699,16 +5244,12 @@ int ust_app_flush_session(struct ltt_ust_session *usess)
 	}
 	case LTTNG_BUFFER_PER_PID:
 	{
-		struct ust_app_session *ua_sess;
-		struct lttng_ht_iter iter;
-		struct ust_app *app;
+		unsigned int nr_apps, nr_errors;
 
-		cds_lfht_for_each_entry(ust_app_ht->ht, &iter.iter, app, pid_n.node) {
-			ua_sess = lookup_session_by_app(usess, app);
-			if (ua_sess == NULL) {
-				continue;
-			}
-			(void) ust_app_flush_app_session(app, ua_sess);
+		nr_errors = run_on_all_apps(flush_app_session, usess, &nr_apps);
+		if (nr_errors) {
+			ERR("Failed to flush the buffers of %u of %u applications",
+					nr_errors, nr_apps);
 		}
 		break;
 	}
@@ -4917,14 +5458,189 @@ end:
 	return 0;
 }
 
+/*
+ * State of a start of a session on all the applications.
+ */
+struct start_trace_all_data {
+	struct ltt_ust_session *usess;
+	/* Protects the start time bounds. */
+	pthread_mutex_t lock;
+	uint64_t first_start_ns;
+	uint64_t last_start_ns;
+};
+
+void ust_app_enable_filter_specialization(void)
+{
+	specialize_filters = 1;
+}
+
+void ust_app_enable_list_cache(void)
+{
+	cache_app_lists = 1;
+}
+
+int ust_app_add_prewarm_uid(uid_t uid)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr_prewarm_uids; i++) {
+		if (prewarm_uids[i] == uid) {
+			return 0;
+		}
+	}
+	if (nr_prewarm_uids == DEFAULT_UST_PREWARM_UIDS_MAX) {
+		return -1;
+	}
+	prewarm_uids[nr_prewarm_uids++] = uid;
+	return 0;
+}
+
+/*
+ * Initialize the placeholder of the applications of a UID which are not
+ * registered yet, with the ABI and tracer version of this session daemon.
+ */
+static void init_prewarm_app(struct ust_app *app, uid_t uid)
+{
+	memset(app, 0, sizeof(*app));
+	app->sock = -1;
+	pthread_mutex_init(&app->sock_lock, NULL);
+	app->notify_sock = -1;
+	app->pid = -1;
+	app->ppid = -1;
+	app->uid = uid;
+	app->gid = (gid_t) -1;
+	app->bits_per_long = CAA_BITS_PER_LONG;
+	app->uint8_t_alignment = __alignof__(uint8_t) * CHAR_BIT;
+	app->uint16_t_alignment = __alignof__(uint16_t) * CHAR_BIT;
+	app->uint32_t_alignment = __alignof__(uint32_t) * CHAR_BIT;
+	app->uint64_t_alignment = __alignof__(uint64_t) * CHAR_BIT;
+	app->long_alignment = __alignof__(long) * CHAR_BIT;
+	app->byte_order = BYTE_ORDER;
+	app->compatible = 1;
+	/* The lttng-ust and lttng-tools versions move together. */
+	app->version.major = VERSION_MAJOR;
+	app->version.minor = VERSION_MINOR;
+	app->buffer_type = LTTNG_BUFFER_PER_UID;
+	app->agent_app_sock = -1;
+}
+
+/*
+ * Create the per UID buffer registry of a session for the applications of a
+ * UID and the consumer channels of all its channels, metadata included, so
+ * that the first application of the UID only has to get the buffers.
+ *
+ * Called with UST session lock held.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static int prewarm_uid_buffers(struct ltt_ust_session *usess, uid_t uid)
+{
+	int ret;
+	struct ust_app app;
+	struct ust_app_session *ua_sess;
+	struct ust_app_channel *ua_chan;
+	struct buffer_reg_uid *reg_uid;
+	struct lttng_ht_iter iter;
+
+	init_prewarm_app(&app, uid);
+
+	ua_sess = alloc_ust_app_session(&app);
+	if (!ua_sess) {
+		ret = -ENOMEM;
+		goto end;
+	}
+	shadow_copy_session(ua_sess, usess, &app);
+
+	rcu_read_lock();
+	ret = setup_buffer_reg_uid(usess, ua_sess, &app, &reg_uid);
+	if (ret < 0) {
+		goto error;
+	}
+
+	pthread_mutex_lock(&ua_sess->lock);
+	cds_lfht_for_each_entry(ua_sess->channels->ht, &iter.iter, ua_chan,
+			node.node) {
+		if (buffer_reg_channel_find(ua_chan->tracing_channel_id,
+				reg_uid)) {
+			continue;
+		}
+		ret = create_channel_uid(&app, usess, ua_sess, ua_chan, reg_uid,
+				NULL);
+		if (ret < 0) {
+			goto error_unlock;
+		}
+	}
+	ret = create_ust_app_metadata(ua_sess, &app, usess->consumer);
+	if (ret < 0) {
+		goto error_unlock;
+	}
+	DBG("UST per UID buffers of session %" PRIu64 " created for uid %d",
+			usess->id, (int) uid);
+
+error_unlock:
+	/* Objects left by an error are not in the placeholder hash tables. */
+	cds_lfht_for_each_entry(ua_sess->channels->ht, &iter.iter, ua_chan,
+			node.node) {
+		if (ua_chan->obj) {
+			(void) ustctl_release_object(-1, ua_chan->obj);
+			lttng_fd_put(LTTNG_FD_APPS, 1);
+			free(ua_chan->obj);
+			ua_chan->obj = NULL;
+		}
+	}
+	pthread_mutex_unlock(&ua_sess->lock);
+error:
+	/*
+	 * The placeholder session is not visible to any other thread, so the
+	 * session list lock is not needed to delete it.
+	 */
+	delete_ust_app_session(-1, ua_sess, &app);
+	rcu_read_unlock();
+end:
+	pthread_mutex_destroy(&app.sock_lock);
+	return ret;
+}
+
+static int start_trace_app(struct ust_app *app, void *data)
+{
+	int ret;
+	uint64_t start_ns = 0;
+	struct start_trace_all_data *start = data;
+
+	ret = ust_app_start_trace(start->usess, app, &start_ns);
+	if (start_ns) {
+		pthread_mutex_lock(&start->lock);
+		if (!start->first_start_ns || start_ns < start->first_start_ns) {
+			start->first_start_ns = start_ns;
+		}
+		if (start_ns > start->last_start_ns) {
+			start->last_start_ns = start_ns;
+		}
+		pthread_mutex_unlock(&start->lock);
+	}
+	return ret;
+}
+
+static int stop_trace_app(struct ust_app *app, void *data)
+{
+	return ust_app_stop_trace(data, app);
+}
+
+static int destroy_trace_app(struct ust_app *app, void *data)
+{
+	return destroy_trace(data, app);
+}
+
 /*
  * Start tracing for the UST session.
  */
 int ust_app_start_trace_all(struct ltt_ust_session *usess)
 {
-	int ret = 0;
-	struct lttng_ht_iter iter;
-	struct ust_app *app;
+	unsigned int nr_apps, nr_errors;
+	struct start_trace_all_data start = {
+		.usess = usess,
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+	};
 
 	DBG("Starting all UST traces");
 
@@ -4938,16 +5654,29 @@ int ust_app_start_trace_all(struct ltt_ust_session *usess)
 	 */
 	(void) ust_app_clear_quiescent_session(usess);
 
-	cds_lfht_for_each_entry(ust_app_ht->ht, &iter.iter, app, pid_n.node) {
-		ret = ust_app_start_trace(usess, app);
-		if (ret < 0) {
-			/* Continue to next apps even on error */
-			continue;
+	if (usess->buffer_type == LTTNG_BUFFER_PER_UID) {
+		unsigned int i;
+
+		for (i = 0; i < nr_prewarm_uids; i++) {
+			/* The applications create the buffers on error. */
+			(void) prewarm_uid_buffers(usess, prewarm_uids[i]);
 		}
 	}
 
+	/* Continue to next apps even on error */
+	nr_errors = run_on_all_apps(start_trace_app, &start, &nr_apps);
+
 	rcu_read_unlock();
 
+	if (nr_errors) {
+		ERR("Failed to start tracing on %u of %u applications",
+				nr_errors, nr_apps);
+	}
+	DBG("UST traces started on %u applications with a start skew of %" PRIu64 " us",
+			nr_apps, (uint64_t) ((start.last_start_ns -
+				start.first_start_ns) / NSEC_PER_USEC));
+	pthread_mutex_destroy(&start.lock);
+
 	return 0;
 }
 
@@ -4957,20 +5686,17 @@ int ust_app_start_trace_all(struct ltt_ust_session *usess)
  */
 int ust_app_stop_trace_all(struct ltt_ust_session *usess)
 {
-	int ret = 0;
-	struct lttng_ht_iter iter;
-	struct ust_app *app;
+	unsigned int nr_apps, nr_errors;
 
 	DBG("Stopping all UST traces");
 
 	rcu_read_lock();
 
-	cds_lfht_for_each_entry(ust_app_ht->ht, &iter.iter, app, pid_n.node) {
-		ret = ust_app_stop_trace(usess, app);
-		if (ret < 0) {
-			/* Continue to next apps even on error */
-			continue;
-		}
+	/* Continue to next apps even on error */
+	nr_errors = run_on_all_apps(stop_trace_app, usess, &nr_apps);
+	if (nr_errors) {
+		ERR("Failed to stop tracing on %u of %u applications",
+				nr_errors, nr_apps);
 	}
 
 	(void) ust_app_flush_session(usess);
@@ -4984,26 +5710,278 @@ int ust_app_stop_trace_all(struct ltt_ust_session *usess)
  * Destroy app UST session.
  */
 int ust_app_destroy_trace_all(struct ltt_ust_session *usess)
+{
+	unsigned int nr_apps, nr_errors;
+
+	DBG("Destroy all UST traces");
+
+	rcu_read_lock();
+
+	/*
+	 * The sessions of the applications are torn down concurrently, each
+	 * waiting on its own application and consumer round trips. Continue
+	 * to next apps even on error.
+	 */
+	nr_errors = run_on_all_apps(destroy_trace_app, usess, &nr_apps);
+	if (nr_errors) {
+		ERR("Failed to destroy the trace of %u of %u applications",
+				nr_errors, nr_apps);
+	}
+
+	rcu_read_unlock();
+
+	return 0;
+}
+
+/*
+ * Add the memory used by a UST registry to a memory usage entry.
+ */
+static void registry_memory_usage(struct ust_registry_session *registry,
+		struct lttng_memory_usage *usage)
+{
+	pthread_mutex_lock(&registry->lock);
+	usage->registry_bytes += uatomic_read(&registry->registry_bytes);
+	usage->metadata_bytes += registry->metadata_alloc_len;
+	pthread_mutex_unlock(&registry->lock);
+}
+
+/*
+ * Set the memory usage entry of an application session: its objects, the
+ * filters of its events and, with per PID buffers, its registry.
+ *
+ * Called with the RCU read side lock held.
+ */
+static void app_session_memory_usage(struct ust_app *app,
+		struct ust_app_session *ua_sess, struct lttng_memory_usage *usage)
+{
+	struct lttng_ht_iter iter, uiter;
+	struct ust_app_channel *ua_chan;
+	struct ust_app_event *ua_event;
+	struct ust_registry_session *registry;
+
+	memset(usage, 0, sizeof(*usage));
+	usage->pid = app->pid;
+	usage->uid = app->uid;
+
+	pthread_mutex_lock(&ua_sess->lock);
+	if (ua_sess->deleted) {
+		goto end;
+	}
+
+	pthread_mutex_lock(&ua_sess->arena.lock);
+	usage->object_bytes = ua_sess->arena.allocated;
+	pthread_mutex_unlock(&ua_sess->arena.lock);
+
+	cds_lfht_for_each_entry(ua_sess->channels->ht, &iter.iter, ua_chan,
+			node.node) {
+		cds_lfht_for_each_entry(ua_chan->events->ht, &uiter.iter,
+				ua_event, node.node) {
+			if (ua_event->conf->filter) {
+				usage->filter_bytes += sizeof(*ua_event->conf->filter) +
+						ua_event->conf->filter->len;
+			}
+			if (ua_event->conf->exclusion) {
+				usage->filter_bytes +=
+						sizeof(*ua_event->conf->exclusion) +
+						ua_event->conf->exclusion->count *
+						LTTNG_SYMBOL_NAME_LEN;
+			}
+		}
+	}
+
+	if (ua_sess->buffer_type == LTTNG_BUFFER_PER_PID) {
+		registry = get_session_registry(ua_sess);
+		if (registry) {
+			registry_memory_usage(registry, usage);
+		}
+	}
+end:
+	pthread_mutex_unlock(&ua_sess->lock);
+}
+
+static uint64_t memory_usage_total(const struct lttng_memory_usage *usage)
+{
+	return usage->registry_bytes + usage->metadata_bytes +
+			usage->object_bytes + usage->filter_bytes;
+}
+
+/*
+ * Whether a session reached its memory cap, in which case the application
+ * is refused, unless it already has its application session. The memory of
+ * the session is summed over all its applications and registries.
+ *
+ * Called with the session lock held.
+ */
+static bool session_memory_cap_reached(struct ltt_ust_session *usess,
+		struct ust_app *app)
+{
+	bool reached = false;
+	uint64_t total = 0;
+	struct lttng_ht_iter iter;
+	struct lttng_memory_usage usage;
+	struct buffer_reg_uid *reg;
+	struct ust_app *other;
+
+	if (!ust_session_memory_cap) {
+		goto end;
+	}
+
+	rcu_read_lock();
+	if (lookup_session_by_app(usess, app)) {
+		goto end_unlock;
+	}
+
+	cds_lfht_for_each_entry(ust_app_ht->ht, &iter.iter, other,
+			pid_n.node) {
+		struct ust_app_session *ua_sess;
+
+		ua_sess = lookup_session_by_app(usess, other);
+		if (!ua_sess) {
+			continue;
+		}
+		app_session_memory_usage(other, ua_sess, &usage);
+		total += memory_usage_total(&usage);
+	}
+	cds_list_for_each_entry(reg, &usess->buffer_reg_uid_list, lnode) {
+		memset(&usage, 0, sizeof(usage));
+		registry_memory_usage(reg->registry->reg.ust, &usage);
+		total += memory_usage_total(&usage);
+	}
+
+	if (total >= ust_session_memory_cap) {
+		WARN("UST session %" PRIu64 " uses %" PRIu64 " bytes of the session daemon, reaching its cap of %" PRIu64 " bytes: application pid %d not traced",
+				usess->id, total, ust_session_memory_cap,
+				app->pid);
+		reached = true;
+	}
+end_unlock:
+	rcu_read_unlock();
+end:
+	return reached;
+}
+
+/*
+ * List the memory used for a session, one entry per application session and
+ * one per UID registry. The applications registering during the listing may
+ * be missed.
+ *
+ * Called with the session lock held. Return 0 on success else a negative
+ * value. The usage array must be freed by the caller in both cases.
+ */
+int ust_app_get_memory_usage(struct ltt_ust_session *usess,
+		struct lttng_memory_usage **usage, size_t *nr_usage)
 {
 	int ret = 0;
+	size_t nr_alloc;
 	struct lttng_ht_iter iter;
+	struct buffer_reg_uid *reg;
 	struct ust_app *app;
 
-	DBG("Destroy all UST traces");
-
 	rcu_read_lock();
+	nr_alloc = lttng_ht_get_count(ust_app_ht);
+	cds_list_for_each_entry(reg, &usess->buffer_reg_uid_list, lnode) {
+		nr_alloc++;
+	}
+	if (!nr_alloc) {
+		goto end;
+	}
 
+	*usage = zmalloc(nr_alloc * sizeof(**usage));
+	if (!*usage) {
+		PERROR("zmalloc memory usage");
+		ret = -ENOMEM;
+		goto end;
+	}
+
+	cds_list_for_each_entry(reg, &usess->buffer_reg_uid_list, lnode) {
+		struct lttng_memory_usage *entry = &(*usage)[(*nr_usage)++];
+
+		entry->pid = -1;
+		entry->uid = reg->uid;
+		registry_memory_usage(reg->registry->reg.ust, entry);
+	}
 	cds_lfht_for_each_entry(ust_app_ht->ht, &iter.iter, app, pid_n.node) {
-		ret = destroy_trace(usess, app);
-		if (ret < 0) {
-			/* Continue to next apps even on error */
+		struct ust_app_session *ua_sess;
+
+		if (*nr_usage == nr_alloc) {
+			break;
+		}
+		ua_sess = lookup_session_by_app(usess, app);
+		if (!ua_sess) {
 			continue;
 		}
+		app_session_memory_usage(app, ua_sess, &(*usage)[(*nr_usage)++]);
 	}
-
+end:
 	rcu_read_unlock();
+	return ret;
+}
 
-	return 0;
+/*
+ * Apply to an existing application session the events of the session
+ * configuration it missed, created or enabled state differing, when a change
+ * failed to be applied to the application. The session gets in sync with the
+ * current version of the configuration.
+ *
+ * Called with session lock held and RCU read-side lock held.
+ */
+static int sync_app_session(struct ltt_ust_session *usess,
+		struct ust_app_session *ua_sess, struct ust_app *app)
+{
+	int ret = 0;
+	struct lttng_ht_iter iter, uiter;
+	struct ltt_ust_channel *uchan;
+
+	DBG2("UST app session of app pid %d at version %" PRIu64
+			" is out of sync with version %" PRIu64,
+			app->pid, ua_sess->config_version,
+			usess->config_version);
+
+	pthread_mutex_lock(&ua_sess->lock);
+	if (ua_sess->deleted) {
+		goto end;
+	}
+
+	cds_lfht_for_each_entry(usess->domain_global.channels->ht, &iter.iter,
+			uchan, node.node) {
+		struct lttng_ht_node_str *ua_chan_node;
+		struct ust_app_channel *ua_chan;
+		struct ltt_ust_event *uevent;
+
+		lttng_ht_lookup(ua_sess->channels, (void *) uchan->name, &uiter);
+		ua_chan_node = lttng_ht_iter_get_node_str(&uiter);
+		if (!ua_chan_node) {
+			continue;
+		}
+		ua_chan = caa_container_of(ua_chan_node, struct ust_app_channel,
+				node);
+
+		cds_lfht_for_each_entry(uchan->events->ht, &uiter.iter, uevent,
+				node.node) {
+			struct ust_app_event *ua_event;
+
+			ua_event = find_ust_app_event(ua_chan->events,
+					uevent->attr.name, uevent->filter,
+					uevent->attr.loglevel, uevent->exclusion);
+			if (!ua_event) {
+				ret = create_ust_app_event(ua_sess, ua_chan,
+						uevent, app);
+			} else if (ua_event->enabled && !uevent->enabled) {
+				ret = disable_ust_app_event(ua_sess, ua_event,
+						app);
+			} else if (!ua_event->enabled && uevent->enabled) {
+				ret = enable_ust_app_event(ua_sess, ua_event,
+						app);
+			}
+			if (ret < 0) {
+				goto end;
+			}
+		}
+	}
+	ua_sess->config_version = usess->config_version;
+end:
+	pthread_mutex_unlock(&ua_sess->lock);
+	return ret;
 }
 
 static
@@ -5023,7 +6001,8 @@ void ust_app_global_create(struct ltt_ust_session *usess, struct ust_app *app)
 		goto error;
 	}
 	if (!is_created) {
-		/* App session already created. */
+		/* App session already created, apply the changes it missed. */
+		(void) sync_app_session(usess, ua_sess, app);
 		goto end;
 	}
 	assert(ua_sess);
@@ -5080,7 +6059,7 @@ void ust_app_global_create(struct ltt_ust_session *usess, struct ust_app *app)
 	pthread_mutex_unlock(&ua_sess->lock);
 
 	if (usess->active) {
-		ret = ust_app_start_trace(usess, app);
+		ret = ust_app_start_trace(usess, app, NULL);
 		if (ret < 0) {
 			goto error;
 		}
@@ -5130,6 +6109,16 @@ void ust_app_global_update(struct ltt_ust_session *usess, struct ust_app *app)
 	}
 
 	if (trace_ust_pid_tracker_lookup(usess, app->pid)) {
+		struct ust_app_session *ua_sess;
+
+		ua_sess = lookup_session_by_app(usess, app);
+		if (ua_sess && ua_sess->config_version == usess->config_version) {
+			/* No change of the configuration since the last sync. */
+			return;
+		}
+		if (session_memory_cap_reached(usess, app)) {
+			return;
+		}
 		ust_app_global_create(usess, app);
 	} else {
 		ust_app_global_destroy(usess, app);
@@ -5164,6 +6153,7 @@ int ust_app_add_ctx_channel_glb(struct ltt_ust_session *usess,
 	struct ust_app_session *ua_sess;
 	struct ust_app *app;
 
+	usess->config_version++;
 	rcu_read_lock();
 
 	cds_lfht_for_each_entry(ust_app_ht->ht, &iter.iter, app, pid_n.node) {
@@ -5198,6 +6188,7 @@ int ust_app_add_ctx_channel_glb(struct ltt_ust_session *usess,
 		if (ret < 0) {
 			goto next_app;
 		}
+		app_session_applied_change(usess, ua_sess);
 	next_app:
 		pthread_mutex_unlock(&ua_sess->lock);
 	}
@@ -5531,6 +6522,9 @@ static int add_event_ust_registry(int sock, int sobjd, int cobjd, char *name,
 		goto error_rcu_unlock;
 	}
 
+	/* A newly loaded provider may have added tracepoints. */
+	uatomic_inc(&app->registered_events_gen);
+
 	/* Lookup channel by UST object descriptor. */
 	ua_chan = find_channel_by_objd(app, cobjd);
 	if (!ua_chan) {
@@ -5905,13 +6899,14 @@ void ust_app_destroy(struct ust_app *app)
 
 /*
  * Take a snapshot for a given UST session. The snapshot is sent to the given
- * output.
+ * output. If "bits_per_long" is not 0, only the buffers of that bitness, held
+ * by a single consumer, are recorded.
  *
  * Return 0 on success or else a negative value.
  */
 int ust_app_snapshot_record(struct ltt_ust_session *usess,
 		struct snapshot_output *output, int wait,
-		uint64_t nb_packets_per_stream)
+		uint64_t nb_packets_per_stream, uint32_t bits_per_long)
 {
 	int ret = 0;
 	struct lttng_ht_iter iter;
@@ -5932,6 +6927,10 @@ int ust_app_snapshot_record(struct ltt_ust_session *usess,
 			struct buffer_reg_channel *reg_chan;
 			struct consumer_socket *socket;
 
+			if (bits_per_long && reg->bits_per_long != bits_per_long) {
+				continue;
+			}
+
 			/* Get consumer socket to use to push the metadata.*/
 			socket = consumer_find_socket_by_bitness(reg->bits_per_long,
 					usess->consumer);
@@ -5977,6 +6976,10 @@ int ust_app_snapshot_record(struct ltt_ust_session *usess,
 			struct ust_app_session *ua_sess;
 			struct ust_registry_session *registry;
 
+			if (bits_per_long && app->bits_per_long != bits_per_long) {
+				continue;
+			}
+
 			ua_sess = lookup_session_by_app(usess, app);
 			if (!ua_sess) {
 				/* Session not associated with this app. */
@@ -6107,13 +7110,19 @@ uint64_t ust_app_get_size_one_more_packet_per_stream(struct ltt_ust_session *use
 	return tot_size;
 }
 
+/*
+ * Get the runtime statistics of a channel of a per-UID session from the
+ * "stats" of consumer_get_channel_stats().
+ */
 int ust_app_uid_get_channel_runtime_stats(uint64_t ust_session_id,
 		struct cds_list_head *buffer_reg_uid_list,
-		struct consumer_output *consumer, uint64_t uchan_id,
+		const struct lttcomm_consumer_channel_stats *stats,
+		size_t nr_stats, uint64_t uchan_id,
 		int overwrite, uint64_t *discarded, uint64_t *lost)
 {
 	int ret;
 	uint64_t consumer_chan_key;
+	const struct lttcomm_consumer_channel_stats *chan_stats;
 
 	*discarded = 0;
 	*lost = 0;
@@ -6127,21 +7136,30 @@ int ust_app_uid_get_channel_runtime_stats(uint64_t ust_session_id,
 		goto end;
 	}
 
-	if (overwrite) {
-		ret = consumer_get_lost_packets(ust_session_id,
-				consumer_chan_key, consumer, lost);
-	} else {
-		ret = consumer_get_discarded_events(ust_session_id,
-				consumer_chan_key, consumer, discarded);
+	/* No events are dropped if the channel is not yet in use. */
+	chan_stats = consumer_find_channel_stats(stats, nr_stats,
+			consumer_chan_key);
+	if (chan_stats) {
+		if (overwrite) {
+			*lost = chan_stats->lost_packets;
+		} else {
+			*discarded = chan_stats->discarded_events;
+		}
 	}
+	ret = 0;
 
 end:
 	return ret;
 }
 
+/*
+ * Get the runtime statistics of a channel of a per-PID session, summed over
+ * its applications, from the "stats" of consumer_get_channel_stats().
+ */
 int ust_app_pid_get_channel_runtime_stats(struct ltt_ust_session *usess,
 		struct ltt_ust_channel *uchan,
-		struct consumer_output *consumer, int overwrite,
+		const struct lttcomm_consumer_channel_stats *stats,
+		size_t nr_stats, int overwrite,
 		uint64_t *discarded, uint64_t *lost)
 {
 	int ret = 0;
@@ -6150,6 +7168,7 @@ int ust_app_pid_get_channel_runtime_stats(struct ltt_ust_session *usess,
 	struct ust_app *app;
 	struct ust_app_session *ua_sess;
 	struct ust_app_channel *ua_chan;
+	const struct lttcomm_consumer_channel_stats *chan_stats;
 
 	*discarded = 0;
 	*lost = 0;
@@ -6175,27 +7194,90 @@ int ust_app_pid_get_channel_runtime_stats(struct ltt_ust_session *usess,
 
 		ua_chan = caa_container_of(ua_chan_node, struct ust_app_channel, node);
 
+		chan_stats = consumer_find_channel_stats(stats, nr_stats,
+				ua_chan->key);
+		if (!chan_stats) {
+			continue;
+		}
 		if (overwrite) {
-			uint64_t _lost;
-
-			ret = consumer_get_lost_packets(usess->id, ua_chan->key,
-					consumer, &_lost);
-			if (ret < 0) {
-				break;
-			}
-			(*lost) += _lost;
+			(*lost) += chan_stats->lost_packets;
 		} else {
-			uint64_t _discarded;
+			(*discarded) += chan_stats->discarded_events;
+		}
+	}
 
-			ret = consumer_get_discarded_events(usess->id,
-					ua_chan->key, consumer, &_discarded);
-			if (ret < 0) {
-				break;
-			}
-			(*discarded) += _discarded;
+	rcu_read_unlock();
+	return ret;
+}
+
+/*
+ * Get the consumption statistics of the streams of a channel of a per-UID
+ * session, over every UID and bitness registry.
+ */
+int ust_app_uid_get_stream_stats(struct ltt_ust_session *usess,
+		struct ltt_ust_channel *uchan,
+		struct lttng_stream_stats **stats, size_t *nr_stats)
+{
+	int ret = 0;
+	struct buffer_reg_uid *reg;
+
+	rcu_read_lock();
+	cds_list_for_each_entry(reg, &usess->buffer_reg_uid_list, lnode) {
+		struct buffer_reg_channel *reg_chan;
+
+		reg_chan = buffer_reg_channel_find(uchan->id, reg);
+		if (!reg_chan) {
+			continue;
+		}
+
+		ret = consumer_get_stream_stats(reg_chan->consumer_key,
+				usess->consumer, stats, nr_stats);
+		if (ret < 0) {
+			break;
 		}
 	}
+	rcu_read_unlock();
+	return ret;
+}
 
+/*
+ * Get the consumption statistics of the streams of a channel of a per-PID
+ * session, over every registered application.
+ */
+int ust_app_pid_get_stream_stats(struct ltt_ust_session *usess,
+		struct ltt_ust_channel *uchan,
+		struct lttng_stream_stats **stats, size_t *nr_stats)
+{
+	int ret = 0;
+	struct lttng_ht_iter iter;
+	struct lttng_ht_node_str *ua_chan_node;
+	struct ust_app *app;
+	struct ust_app_session *ua_sess;
+	struct ust_app_channel *ua_chan;
+
+	rcu_read_lock();
+	cds_lfht_for_each_entry(ust_app_ht->ht, &iter.iter, app, pid_n.node) {
+		struct lttng_ht_iter uiter;
+
+		ua_sess = lookup_session_by_app(usess, app);
+		if (ua_sess == NULL) {
+			continue;
+		}
+
+		/* Get channel */
+		lttng_ht_lookup(ua_sess->channels, (void *) uchan->name, &uiter);
+		ua_chan_node = lttng_ht_iter_get_node_str(&uiter);
+		/* If the session is found for the app, the channel must be there */
+		assert(ua_chan_node);
+
+		ua_chan = caa_container_of(ua_chan_node, struct ust_app_channel, node);
+
+		ret = consumer_get_stream_stats(ua_chan->key, usess->consumer,
+				stats, nr_stats);
+		if (ret < 0) {
+			break;
+		}
+	}
 	rcu_read_unlock();
 	return ret;
 }
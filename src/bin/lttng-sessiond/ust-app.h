@@ -112,11 +112,13 @@ struct ust_app_event {
 	int enabled;
 	int handle;
 	struct lttng_ust_object_data *obj;
-	struct lttng_ust_event attr;
-	char name[LTTNG_UST_SYM_NAME_LEN];
+	/* Keyed by the name of the configuration. */
 	struct lttng_ht_node_str node;
-	struct lttng_filter_bytecode *filter;
-	struct lttng_event_exclusion *exclusion;
+	/*
+	 * Attributes, filter and exclusions shared with the session's event and
+	 * the other applications. Only the above state is per application.
+	 */
+	struct ltt_ust_event_conf *conf;
 };
 
 struct ust_app_stream {
@@ -134,6 +136,8 @@ struct ust_app_channel {
 	int handle;
 	/* Channel and streams were sent to the UST tracer. */
 	int is_sent;
+	/* The fds of the object were closed once the channel was sent. */
+	int obj_fds_released;
 	/* Unique key used to identify the channel on the consumer side. */
 	uint64_t key;
 	/* Id of the tracing channel set on creation. */
@@ -158,6 +162,8 @@ struct ust_app_channel {
 	uint64_t tracefile_size;
 	uint64_t tracefile_count;
 	uint64_t monitor_timer_interval;
+	enum lttng_channel_compression compression;
+	int huge_pages;
 	/*
 	 * Node indexed by channel name in the channels' hash table of a session.
 	 */
@@ -171,6 +177,21 @@ struct ust_app_channel {
 	struct rcu_head rcu_head;
 };
 
+struct ust_app_arena_chunk;
+
+/*
+ * Memory of the channels, events, contexts and streams of an application
+ * session. The objects are carved out of large chunks and all released at
+ * once with the session, after its grace period, rather than one by one.
+ */
+struct ust_app_arena {
+	pthread_mutex_t lock;
+	/* Chunk being carved, chained to the previous ones. */
+	struct ust_app_arena_chunk *chunk;
+	/* Bytes of the chunks of the arena. */
+	size_t allocated;
+};
+
 struct ust_app_session {
 	/*
 	 * Lock protecting this session's ust app interaction. Held
@@ -199,6 +220,11 @@ struct ust_app_session {
 	 * ust_sessions_objd hash table in the ust_app object.
 	 */
 	struct lttng_ht_node_ulong ust_objd_node;
+	/*
+	 * Version of the session configuration this session is in sync with.
+	 * Protected by the session lock.
+	 */
+	uint64_t config_version;
 	char path[PATH_MAX];
 	/* UID/GID of the application owning the session */
 	uid_t uid;
@@ -226,6 +252,9 @@ struct ust_app_session {
 
 	char root_shm_path[PATH_MAX];
 	char shm_path[PATH_MAX];
+
+	/* Memory of the objects of the session. */
+	struct ust_app_arena arena;
 };
 
 /*
@@ -291,6 +320,30 @@ struct ust_app {
 	 * to a negative value indicating that the agent application is gone.
 	 */
 	int agent_app_sock;
+
+	/*
+	 * Tracepoints and tracepoint fields listed from the application, kept
+	 * when the listing cache is enabled. Protected by list_cache_lock,
+	 * which is acquired before sock_lock.
+	 *
+	 * A cache is valid until the application registers an event on its
+	 * notify socket, as it does when a provider it loads has an enabled
+	 * event. registered_events_gen counts these registrations.
+	 */
+	pthread_mutex_t list_cache_lock;
+	unsigned long registered_events_gen;
+	struct {
+		int valid;
+		unsigned long gen;
+		size_t count;
+		struct lttng_event *events;
+	} events_cache;
+	struct {
+		int valid;
+		unsigned long gen;
+		size_t count;
+		struct lttng_event_field *fields;
+	} fields_cache;
 };
 
 #ifdef HAVE_LIBLTTNG_UST_CTL
@@ -299,11 +352,17 @@ int ust_app_register(struct ust_register_msg *msg, int sock);
 int ust_app_register_done(struct ust_app *app);
 int ust_app_version(struct ust_app *app);
 void ust_app_unregister(int sock);
+void ust_app_unregister_batch(int *socks, unsigned int nr_socks);
+int ust_app_add_prewarm_uid(uid_t uid);
+void ust_app_enable_filter_specialization(void);
+void ust_app_enable_list_cache(void);
 int ust_app_start_trace_all(struct ltt_ust_session *usess);
 int ust_app_stop_trace_all(struct ltt_ust_session *usess);
 int ust_app_destroy_trace_all(struct ltt_ust_session *usess);
-int ust_app_list_events(struct lttng_event **events);
-int ust_app_list_event_fields(struct lttng_event_field **fields);
+int ust_app_list_events(struct lttng_event **events, pid_t pid_cursor,
+		unsigned int page_len);
+int ust_app_list_event_fields(struct lttng_event_field **fields,
+		pid_t pid_cursor, unsigned int page_len);
 int ust_app_create_channel_glb(struct ltt_ust_session *usess,
 		struct ltt_ust_channel *uchan);
 int ust_app_create_event_glb(struct ltt_ust_session *usess,
@@ -329,7 +388,9 @@ void ust_app_global_update_all(struct ltt_ust_session *usess);
 void ust_app_clean_list(void);
 int ust_app_ht_alloc(void);
 struct ust_app *ust_app_find_by_pid(pid_t pid);
-struct ust_app_stream *ust_app_alloc_stream(void);
+struct ust_app_stream *ust_app_alloc_stream(struct ust_app_channel *ua_chan);
+void ust_app_free_stream(struct ust_app_channel *ua_chan,
+		struct ust_app_stream *stream);
 int ust_app_recv_registration(int sock, struct ust_register_msg *msg);
 int ust_app_recv_notify(int sock);
 void ust_app_add(struct ust_app *app);
@@ -340,19 +401,29 @@ ssize_t ust_app_push_metadata(struct ust_registry_session *registry,
 void ust_app_destroy(struct ust_app *app);
 int ust_app_snapshot_record(struct ltt_ust_session *usess,
 		struct snapshot_output *output, int wait,
-		uint64_t nb_packets_per_stream);
+		uint64_t nb_packets_per_stream, uint32_t bits_per_long);
 uint64_t ust_app_get_size_one_more_packet_per_stream(
 		struct ltt_ust_session *usess, uint64_t cur_nr_packets);
 struct ust_app *ust_app_find_by_sock(int sock);
 int ust_app_uid_get_channel_runtime_stats(uint64_t ust_session_id,
 		struct cds_list_head *buffer_reg_uid_list,
-		struct consumer_output *consumer, uint64_t uchan_id,
+		const struct lttcomm_consumer_channel_stats *stats,
+		size_t nr_stats, uint64_t uchan_id,
 		int overwrite, uint64_t *discarded, uint64_t *lost);
 int ust_app_pid_get_channel_runtime_stats(struct ltt_ust_session *usess,
 		struct ltt_ust_channel *uchan,
-		struct consumer_output *consumer,
+		const struct lttcomm_consumer_channel_stats *stats,
+		size_t nr_stats,
 		int overwrite, uint64_t *discarded, uint64_t *lost);
+int ust_app_uid_get_stream_stats(struct ltt_ust_session *usess,
+		struct ltt_ust_channel *uchan,
+		struct lttng_stream_stats **stats, size_t *nr_stats);
+int ust_app_pid_get_stream_stats(struct ltt_ust_session *usess,
+		struct ltt_ust_channel *uchan,
+		struct lttng_stream_stats **stats, size_t *nr_stats);
 int ust_app_regenerate_statedump_all(struct ltt_ust_session *usess);
+int ust_app_get_memory_usage(struct ltt_ust_session *usess,
+		struct lttng_memory_usage **usage, size_t *nr_usage);
 
 static inline
 int ust_app_supported(void)
@@ -383,12 +454,14 @@ int ust_app_stop_trace_all(struct ltt_ust_session *usess)
 	return 0;
 }
 static inline
-int ust_app_list_events(struct lttng_event **events)
+int ust_app_list_events(struct lttng_event **events, pid_t pid_cursor,
+		unsigned int page_len)
 {
 	return -ENOSYS;
 }
 static inline
-int ust_app_list_event_fields(struct lttng_event_field **fields)
+int ust_app_list_event_fields(struct lttng_event_field **fields,
+		pid_t pid_cursor, unsigned int page_len)
 {
 	return -ENOSYS;
 }
@@ -412,6 +485,23 @@ void ust_app_unregister(int sock)
 {
 }
 static inline
+void ust_app_unregister_batch(int *socks, unsigned int nr_socks)
+{
+}
+static inline
+int ust_app_add_prewarm_uid(uid_t uid)
+{
+	return 0;
+}
+static inline
+void ust_app_enable_filter_specialization(void)
+{
+}
+static inline
+void ust_app_enable_list_cache(void)
+{
+}
+static inline
 void ust_app_lock_list(void)
 {
 }
@@ -532,7 +622,8 @@ void ust_app_destroy(struct ust_app *app)
 }
 static inline
 int ust_app_snapshot_record(struct ltt_ust_session *usess,
-		struct snapshot_output *output, int wait, uint64_t max_stream_size)
+		struct snapshot_output *output, int wait, uint64_t max_stream_size,
+		uint32_t bits_per_long)
 {
 	return 0;
 }
@@ -565,8 +656,9 @@ uint64_t ust_app_get_size_one_more_packet_per_stream(
 static inline
 int ust_app_uid_get_channel_runtime_stats(uint64_t ust_session_id,
 		struct cds_list_head *buffer_reg_uid_list,
-		struct consumer_output *consumer, int overwrite,
-		uint64_t uchan_id, uint64_t *discarded, uint64_t *lost)
+		const struct lttcomm_consumer_channel_stats *stats,
+		size_t nr_stats, uint64_t uchan_id,
+		int overwrite, uint64_t *discarded, uint64_t *lost)
 {
 	return 0;
 }
@@ -574,12 +666,36 @@ int ust_app_uid_get_channel_runtime_stats(uint64_t ust_session_id,
 static inline
 int ust_app_pid_get_channel_runtime_stats(struct ltt_ust_session *usess,
 		struct ltt_ust_channel *uchan,
-		struct consumer_output *consumer,
+		const struct lttcomm_consumer_channel_stats *stats,
+		size_t nr_stats,
 		int overwrite, uint64_t *discarded, uint64_t *lost)
 {
 	return 0;
 }
 
+static inline
+int ust_app_uid_get_stream_stats(struct ltt_ust_session *usess,
+		struct ltt_ust_channel *uchan,
+		struct lttng_stream_stats **stats, size_t *nr_stats)
+{
+	return 0;
+}
+
+static inline
+int ust_app_pid_get_stream_stats(struct ltt_ust_session *usess,
+		struct ltt_ust_channel *uchan,
+		struct lttng_stream_stats **stats, size_t *nr_stats)
+{
+	return 0;
+}
+
+static inline
+int ust_app_get_memory_usage(struct ltt_ust_session *usess,
+		struct lttng_memory_usage **usage, size_t *nr_usage)
+{
+	return 0;
+}
+
 static inline
 int ust_app_regenerate_statedump_all(struct ltt_ust_session *usess)
 {
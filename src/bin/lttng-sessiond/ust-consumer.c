@@ -193,6 +193,8 @@ static int ask_channel_creation(struct ust_app_session *ua_sess,
 			ua_sess->output_traces,
 			ua_sess->uid,
 			ua_chan->attr.blocking_timeout,
+			ua_chan->compression,
+			ua_chan->huge_pages,
 			root_shm_path, shm_path);
 
 	health_code_update();
@@ -309,7 +311,7 @@ int ust_consumer_get_channel(struct consumer_socket *socket,
 		struct ust_app_stream *stream;
 
 		/* Create UST stream */
-		stream = ust_app_alloc_stream();
+		stream = ust_app_alloc_stream(ua_chan);
 		if (stream == NULL) {
 			ret = -ENOMEM;
 			goto error;
@@ -318,7 +320,7 @@ int ust_consumer_get_channel(struct consumer_socket *socket,
 		/* Stream object is populated by this call if successful. */
 		ret = ustctl_recv_stream_from_consumer(*socket->fd_ptr, &stream->obj);
 		if (ret < 0) {
-			free(stream);
+			ust_app_free_stream(ua_chan, stream);
 			if (ret == -LTTNG_UST_ERR_NOENT) {
 				DBG3("UST app consumer has no more stream available");
 				ret = 0;
@@ -521,6 +523,11 @@ int ust_consumer_metadata_request(struct consumer_socket *socket)
 	assert(ust_reg);
 
 	pthread_mutex_lock(&ust_reg->lock);
+	if (request.reload) {
+		/* The consumer released the metadata it had consumed. */
+		DBG("Reloading the metadata of key %" PRIu64, request.key);
+		ust_reg->metadata_len_sent = 0;
+	}
 	ret_push = ust_app_push_metadata(ust_reg, socket, 1);
 	pthread_mutex_unlock(&ust_reg->lock);
 	if (ret_push == -EPIPE) {
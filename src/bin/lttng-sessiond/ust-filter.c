@@ -0,0 +1,437 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include <stdint.h>
+#include <string.h>
+#include <urcu/rculfhash.h>
+
+#include <common/common.h>
+#include <lib/lttng-ctl/filter/filter-bytecode.h>
+
+#include "ust-filter.h"
+
+/* Deep enough for the bytecode generated by liblttng-ctl. */
+#define FILTER_STACK_LEN	16
+
+/* Types of the stack registers, as tracked by the tracer. */
+enum filter_reg_type {
+	REG_UNKNOWN = 0,
+	REG_S64,
+	REG_DOUBLE,
+	REG_STRING,
+	REG_STAR_GLOB_STRING,
+};
+
+struct filter_stack {
+	enum filter_reg_type reg[FILTER_STACK_LEN];
+	unsigned int top;
+};
+
+static int stack_push(struct filter_stack *stack, enum filter_reg_type type)
+{
+	if (stack->top == FILTER_STACK_LEN) {
+		return -1;
+	}
+	stack->reg[stack->top++] = type;
+	return 0;
+}
+
+static int stack_pop(struct filter_stack *stack, unsigned int count)
+{
+	if (stack->top < count) {
+		return -1;
+	}
+	stack->top -= count;
+	return 0;
+}
+
+static enum filter_reg_type field_reg_type(const struct ustctl_field *field)
+{
+	const struct ustctl_basic_type *elem_type;
+
+	switch (field->type.atype) {
+	case ustctl_atype_integer:
+	case ustctl_atype_enum:
+		return REG_S64;
+	case ustctl_atype_float:
+		return REG_DOUBLE;
+	case ustctl_atype_string:
+		return REG_STRING;
+	case ustctl_atype_array:
+		elem_type = &field->type.u.array.elem_type;
+		break;
+	case ustctl_atype_sequence:
+		elem_type = &field->type.u.sequence.elem_type;
+		break;
+	default:
+		return REG_UNKNOWN;
+	}
+
+	/* Only the arrays and sequences of characters are loaded as strings. */
+	if (elem_type->atype != ustctl_atype_integer ||
+			elem_type->u.basic.integer.encoding == ustctl_encode_none) {
+		return REG_UNKNOWN;
+	}
+	return REG_STRING;
+}
+
+/*
+ * Type of a field in all the registered events named "event_name", or
+ * REG_UNKNOWN if the events don't agree or none is registered.
+ */
+static enum filter_reg_type lookup_field_type(struct ust_registry_channel *chan,
+		const char *event_name, const char *field_name)
+{
+	enum filter_reg_type type = REG_UNKNOWN;
+	struct lttng_ht_iter iter;
+	struct ust_registry_event *event;
+
+	cds_lfht_for_each_entry(chan->ht->ht, &iter.iter, event, node.node) {
+		size_t i;
+		enum filter_reg_type event_type = REG_UNKNOWN;
+
+		if (strncmp(event->name, event_name, sizeof(event->name))) {
+			continue;
+		}
+		for (i = 0; i < event->nr_fields; i++) {
+			if (!strncmp(event->fields[i].name, field_name,
+					sizeof(event->fields[i].name))) {
+				event_type = field_reg_type(&event->fields[i]);
+				break;
+			}
+		}
+		if (event_type == REG_UNKNOWN ||
+				(type != REG_UNKNOWN && type != event_type)) {
+			return REG_UNKNOWN;
+		}
+		type = event_type;
+	}
+	return type;
+}
+
+/*
+ * Name of the field relocated at offset "pc" of the bytecode, or NULL.
+ */
+static const char *find_reloc(struct lttng_ust_filter_bytecode *bytecode,
+		uint32_t pc)
+{
+	uint32_t offset = bytecode->reloc_offset;
+
+	while (offset + sizeof(uint16_t) < bytecode->len) {
+		uint16_t reloc_pc;
+		const char *name = &bytecode->data[offset + sizeof(uint16_t)];
+		size_t name_len = strnlen(name,
+				bytecode->len - offset - sizeof(uint16_t));
+
+		if (offset + sizeof(uint16_t) + name_len == bytecode->len) {
+			break;
+		}
+		memcpy(&reloc_pc, &bytecode->data[offset], sizeof(reloc_pc));
+		if (reloc_pc == pc) {
+			return name;
+		}
+		offset += sizeof(uint16_t) + name_len + 1;
+	}
+	return NULL;
+}
+
+/*
+ * Specialized comparator of "op" for operands of types "left" and "right",
+ * or "op" itself if the types are unknown or not comparable.
+ */
+static filter_opcode_t specialize_comparator(filter_opcode_t op,
+		enum filter_reg_type left, enum filter_reg_type right)
+{
+	unsigned int index = op - FILTER_OP_EQ;
+
+	if (left == REG_STAR_GLOB_STRING || right == REG_STAR_GLOB_STRING) {
+		if (left == right || (left != REG_STRING && right != REG_STRING)) {
+			return op;
+		}
+		if (op == FILTER_OP_EQ) {
+			return FILTER_OP_EQ_STAR_GLOB_STRING;
+		} else if (op == FILTER_OP_NE) {
+			return FILTER_OP_NE_STAR_GLOB_STRING;
+		}
+		return op;
+	}
+
+	if (left == REG_STRING && right == REG_STRING) {
+		return FILTER_OP_EQ_STRING + index;
+	} else if (left == REG_S64 && right == REG_S64) {
+		return FILTER_OP_EQ_S64 + index;
+	} else if (left == REG_DOUBLE && right == REG_DOUBLE) {
+		return FILTER_OP_EQ_DOUBLE + index;
+	} else if (left == REG_DOUBLE && right == REG_S64) {
+		return FILTER_OP_EQ_DOUBLE_S64 + index;
+	} else if (left == REG_S64 && right == REG_DOUBLE) {
+		return FILTER_OP_EQ_S64_DOUBLE + index;
+	}
+	return op;
+}
+
+/*
+ * Specialize the instructions of "code", a copy of the bytecode instructions.
+ *
+ * Return the number of specialized instructions or else a negative value.
+ */
+static int specialize_code(struct lttng_ust_filter_bytecode *bytecode,
+		char *code, struct ust_registry_channel *chan,
+		const char *event_name)
+{
+	int count = 0;
+	uint32_t pc = 0, len = bytecode->reloc_offset;
+	struct filter_stack stack = { .top = 0 };
+
+	while (pc < len) {
+		filter_opcode_t *op = (filter_opcode_t *) &code[pc];
+		enum filter_reg_type left, right, type;
+		filter_opcode_t new_op;
+		uint32_t insn_len = 0;
+		const char *name;
+
+		switch (*op) {
+		case FILTER_OP_RETURN:
+			return count;
+
+		case FILTER_OP_EQ:
+		case FILTER_OP_NE:
+		case FILTER_OP_GT:
+		case FILTER_OP_LT:
+		case FILTER_OP_GE:
+		case FILTER_OP_LE:
+			if (stack.top < 2) {
+				return -1;
+			}
+			left = stack.reg[stack.top - 2];
+			right = stack.reg[stack.top - 1];
+			new_op = specialize_comparator(*op, left, right);
+			if (new_op != *op) {
+				*op = new_op;
+				count++;
+			}
+			/* Fall-through */
+		case FILTER_OP_EQ_STRING:
+		case FILTER_OP_NE_STRING:
+		case FILTER_OP_GT_STRING:
+		case FILTER_OP_LT_STRING:
+		case FILTER_OP_GE_STRING:
+		case FILTER_OP_LE_STRING:
+		case FILTER_OP_EQ_S64:
+		case FILTER_OP_NE_S64:
+		case FILTER_OP_GT_S64:
+		case FILTER_OP_LT_S64:
+		case FILTER_OP_GE_S64:
+		case FILTER_OP_LE_S64:
+		case FILTER_OP_EQ_DOUBLE:
+		case FILTER_OP_NE_DOUBLE:
+		case FILTER_OP_GT_DOUBLE:
+		case FILTER_OP_LT_DOUBLE:
+		case FILTER_OP_GE_DOUBLE:
+		case FILTER_OP_LE_DOUBLE:
+		case FILTER_OP_EQ_DOUBLE_S64:
+		case FILTER_OP_NE_DOUBLE_S64:
+		case FILTER_OP_GT_DOUBLE_S64:
+		case FILTER_OP_LT_DOUBLE_S64:
+		case FILTER_OP_GE_DOUBLE_S64:
+		case FILTER_OP_LE_DOUBLE_S64:
+		case FILTER_OP_EQ_S64_DOUBLE:
+		case FILTER_OP_NE_S64_DOUBLE:
+		case FILTER_OP_GT_S64_DOUBLE:
+		case FILTER_OP_LT_S64_DOUBLE:
+		case FILTER_OP_GE_S64_DOUBLE:
+		case FILTER_OP_LE_S64_DOUBLE:
+		case FILTER_OP_EQ_STAR_GLOB_STRING:
+		case FILTER_OP_NE_STAR_GLOB_STRING:
+			if (stack_pop(&stack, 2) || stack_push(&stack, REG_S64)) {
+				return -1;
+			}
+			insn_len = sizeof(struct binary_op);
+			break;
+
+		case FILTER_OP_UNARY_PLUS:
+		case FILTER_OP_UNARY_MINUS:
+		case FILTER_OP_UNARY_NOT:
+			if (!stack.top) {
+				return -1;
+			}
+			type = stack.reg[stack.top - 1];
+			if (type == REG_S64) {
+				*op += FILTER_OP_UNARY_PLUS_S64 - FILTER_OP_UNARY_PLUS;
+				count++;
+			} else if (type == REG_DOUBLE) {
+				*op += FILTER_OP_UNARY_PLUS_DOUBLE -
+					FILTER_OP_UNARY_PLUS;
+				count++;
+			}
+			if (*op == FILTER_OP_UNARY_NOT_DOUBLE) {
+				/* The tracer keeps a double register type. */
+				stack.reg[stack.top - 1] = REG_UNKNOWN;
+			}
+			insn_len = sizeof(struct unary_op);
+			break;
+		case FILTER_OP_UNARY_PLUS_S64:
+		case FILTER_OP_UNARY_MINUS_S64:
+		case FILTER_OP_UNARY_NOT_S64:
+		case FILTER_OP_UNARY_PLUS_DOUBLE:
+		case FILTER_OP_UNARY_MINUS_DOUBLE:
+		case FILTER_OP_UNARY_NOT_DOUBLE:
+			if (!stack.top) {
+				return -1;
+			}
+			insn_len = sizeof(struct unary_op);
+			break;
+
+		case FILTER_OP_AND:
+		case FILTER_OP_OR:
+			/* The right operand replaces the left one if evaluated. */
+			if (stack_pop(&stack, 1)) {
+				return -1;
+			}
+			insn_len = sizeof(struct logical_op);
+			break;
+
+		case FILTER_OP_LOAD_FIELD_REF:
+			name = find_reloc(bytecode, pc);
+			if (!name) {
+				return -1;
+			}
+			type = lookup_field_type(chan, event_name, name);
+			goto load_ref;
+		case FILTER_OP_LOAD_FIELD_REF_STRING:
+		case FILTER_OP_LOAD_FIELD_REF_SEQUENCE:
+		case FILTER_OP_LOAD_FIELD_REF_USER_STRING:
+		case FILTER_OP_LOAD_FIELD_REF_USER_SEQUENCE:
+		case FILTER_OP_GET_CONTEXT_REF_STRING:
+			type = REG_STRING;
+			goto load_ref;
+		case FILTER_OP_LOAD_FIELD_REF_S64:
+		case FILTER_OP_GET_CONTEXT_REF_S64:
+			type = REG_S64;
+			goto load_ref;
+		case FILTER_OP_LOAD_FIELD_REF_DOUBLE:
+		case FILTER_OP_GET_CONTEXT_REF_DOUBLE:
+			type = REG_DOUBLE;
+			goto load_ref;
+		case FILTER_OP_GET_CONTEXT_REF:
+			type = REG_UNKNOWN;
+		load_ref:
+			if (stack_push(&stack, type)) {
+				return -1;
+			}
+			insn_len = sizeof(struct load_op) + sizeof(struct field_ref);
+			break;
+
+		case FILTER_OP_LOAD_STRING:
+		case FILTER_OP_LOAD_STAR_GLOB_STRING:
+		{
+			const char *str = &code[pc + sizeof(struct load_op)];
+
+			if (pc + sizeof(struct load_op) >= len) {
+				return -1;
+			}
+			if (stack_push(&stack, *op == FILTER_OP_LOAD_STRING ?
+					REG_STRING : REG_STAR_GLOB_STRING)) {
+				return -1;
+			}
+			insn_len = sizeof(struct load_op) +
+				strnlen(str, len - pc - sizeof(struct load_op)) + 1;
+			break;
+		}
+		case FILTER_OP_LOAD_S64:
+			if (stack_push(&stack, REG_S64)) {
+				return -1;
+			}
+			insn_len = sizeof(struct load_op) +
+				sizeof(struct literal_numeric);
+			break;
+		case FILTER_OP_LOAD_DOUBLE:
+			if (stack_push(&stack, REG_DOUBLE)) {
+				return -1;
+			}
+			insn_len = sizeof(struct load_op) +
+				sizeof(struct literal_double);
+			break;
+
+		case FILTER_OP_CAST_TO_S64:
+			if (!stack.top) {
+				return -1;
+			}
+			type = stack.reg[stack.top - 1];
+			if (type == REG_S64) {
+				*op = FILTER_OP_CAST_NOP;
+				count++;
+			} else if (type == REG_DOUBLE) {
+				*op = FILTER_OP_CAST_DOUBLE_TO_S64;
+				count++;
+			}
+			/* Fall-through */
+		case FILTER_OP_CAST_DOUBLE_TO_S64:
+		case FILTER_OP_CAST_NOP:
+			if (!stack.top) {
+				return -1;
+			}
+			stack.reg[stack.top - 1] = REG_S64;
+			insn_len = sizeof(struct cast_op);
+			break;
+
+		default:
+			/* Arithmetic operators are not generated by liblttng-ctl. */
+			return -1;
+		}
+
+		if (pc + insn_len > len) {
+			return -1;
+		}
+		pc += insn_len;
+	}
+	/* No return instruction. */
+	return -1;
+}
+
+int ust_filter_specialize(struct lttng_ust_filter_bytecode *bytecode,
+		struct ust_registry_channel *chan, const char *event_name)
+{
+	int ret;
+	char *code;
+
+	if (bytecode->reloc_offset > bytecode->len) {
+		ret = 0;
+		goto end;
+	}
+
+	code = zmalloc(bytecode->reloc_offset);
+	if (!code) {
+		PERROR("zmalloc filter code");
+		ret = 0;
+		goto end;
+	}
+	memcpy(code, bytecode->data, bytecode->reloc_offset);
+
+	ret = specialize_code(bytecode, code, chan, event_name);
+	if (ret < 0) {
+		DBG("Unexpected filter bytecode of event %s, not specialized",
+				event_name);
+		ret = 0;
+	} else {
+		memcpy(bytecode->data, code, bytecode->reloc_offset);
+	}
+	free(code);
+end:
+	return ret;
+}
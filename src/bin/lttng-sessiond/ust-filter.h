@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef LTTNG_UST_FILTER_H
+#define LTTNG_UST_FILTER_H
+
+#include <lttng/ust-abi.h>
+
+#include "ust-registry.h"
+
+/*
+ * Specialize the generic operators of the filter bytecode of the event
+ * "event_name" for the types of the event fields known by the registry
+ * channel, as the tracer does when linking the bytecode.
+ *
+ * The field loads are left generic since the tracer resolves them while
+ * relocating the bytecode. An operator is only specialized when the types of
+ * its operands are known, and the types of a field must agree between the
+ * registered events of that name. The bytecode is left unchanged if it holds
+ * an unexpected instruction.
+ *
+ * RCU read side lock and the registry session lock MUST be acquired.
+ *
+ * Return the number of specialized instructions.
+ */
+int ust_filter_specialize(struct lttng_ust_filter_bytecode *bytecode,
+		struct ust_registry_channel *chan, const char *event_name);
+
+#endif /* LTTNG_UST_FILTER_H */
@@ -27,6 +27,7 @@
 #include <limits.h>
 #include <unistd.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <common/common.h>
 #include <common/time.h>
 
@@ -39,12 +40,47 @@
 #endif
 
 #define NR_CLOCK_OFFSET_SAMPLES		10
+#define NR_PRECISE_CLOCK_OFFSET_SAMPLES	100
+/* Time during which a measured clock offset is reused, in nsec. */
+#define CLOCK_OFFSET_VALIDITY		(100 * NSEC_PER_MSEC)
 
 struct offset_sample {
 	int64_t offset;			/* correlation offset */
 	uint64_t measure_delta;		/* lower is better */
 };
 
+/*
+ * Last clock offset measured, shared by the sessions created at about the
+ * same time, as on a burst of per PID application registrations.
+ */
+static struct clock_offset_cache {
+	pthread_mutex_t lock;
+	int valid;
+	int64_t offset;
+	/* Trace clock value at the time of the measurement. */
+	uint64_t timestamp;
+} clock_offset_cache = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/*
+ * Fields description of an event signature, for each byte order of the
+ * registry sessions. It does not depend on anything else in a session, so it
+ * is shared by the registries of all the applications.
+ */
+struct ust_metadata_fields {
+	char *signature;
+	/* Indexed by ust_metadata_fields_bo(), NULL if not dumped yet. */
+	char *text[2];
+	size_t len[2];
+	/* Node in the fields cache, keyed by signature. */
+	struct lttng_ht_node_str node;
+};
+
+/* Created on first use. Protected by fields_cache_lock. */
+static struct lttng_ht *fields_cache;
+static pthread_mutex_t fields_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
 static
 int _lttng_field_statedump(struct ust_registry_session *session,
 		const struct ustctl_field *fields, size_t nr_fields,
@@ -91,53 +127,79 @@ int get_count_order(unsigned int count)
 }
 
 /*
- * Returns offset where to write in metadata array, or negative error value on error.
+ * Grow the metadata array so that it can hold "len" more bytes.
+ *
+ * Returns 0 on success, or negative error value on error.
  */
 static
-ssize_t metadata_reserve(struct ust_registry_session *session, size_t len)
+int metadata_grow(struct ust_registry_session *session, size_t len)
 {
-	size_t new_len = session->metadata_len + len;
-	size_t new_alloc_len = new_len;
+	size_t new_alloc_len = session->metadata_len + len;
 	size_t old_alloc_len = session->metadata_alloc_len;
-	ssize_t ret;
+	char *newptr;
 
+	if (new_alloc_len <= old_alloc_len)
+		return 0;
 	if (new_alloc_len > (UINT32_MAX >> 1))
 		return -EINVAL;
 	if ((old_alloc_len << 1) > (UINT32_MAX >> 1))
 		return -EINVAL;
 
-	if (new_alloc_len > old_alloc_len) {
-		char *newptr;
+	new_alloc_len =
+		max_t(size_t, 1U << get_count_order(new_alloc_len), old_alloc_len << 1);
+	/*
+	 * The bytes past metadata_len are never read, there is no need to
+	 * zero them.
+	 */
+	newptr = realloc(session->metadata, new_alloc_len);
+	if (!newptr)
+		return -ENOMEM;
+	session->metadata = newptr;
+	session->metadata_alloc_len = new_alloc_len;
+	return 0;
+}
+
+/*
+ * Returns offset where to write in metadata array, or negative error value on error.
+ */
+static
+ssize_t metadata_reserve(struct ust_registry_session *session, size_t len)
+{
+	ssize_t ret;
 
-		new_alloc_len =
-			max_t(size_t, 1U << get_count_order(new_alloc_len), old_alloc_len << 1);
-		newptr = realloc(session->metadata, new_alloc_len);
-		if (!newptr)
-			return -ENOMEM;
-		session->metadata = newptr;
-		/* We zero directly the memory from start of allocation. */
-		memset(&session->metadata[old_alloc_len], 0, new_alloc_len - old_alloc_len);
-		session->metadata_alloc_len = new_alloc_len;
-	}
+	ret = metadata_grow(session, len);
+	if (ret)
+		return ret;
 	ret = session->metadata_len;
 	session->metadata_len += len;
 	return ret;
 }
 
+/*
+ * Write the metadata appended since the last flush to the metadata file, in
+ * a single write.
+ */
 static
-int metadata_file_append(struct ust_registry_session *session,
-		const char *str, size_t len)
+int metadata_file_flush(struct ust_registry_session *session)
 {
 	ssize_t written;
+	size_t len;
 
 	if (session->metadata_fd < 0) {
 		return 0;
 	}
+	len = session->metadata_len - session->metadata_len_written;
+	if (!len) {
+		return 0;
+	}
 	/* Write to metadata file */
-	written = lttng_write(session->metadata_fd, str, len);
+	written = lttng_write(session->metadata_fd,
+			&session->metadata[session->metadata_len_written], len);
 	if (written != len) {
+		PERROR("Error appending to metadata file");
 		return -1;
 	}
+	session->metadata_len_written = session->metadata_len;
 	return 0;
 }
 
@@ -146,41 +208,40 @@ int metadata_file_append(struct ust_registry_session *session,
  * ust_lock), so we can do racy operations such as looking for
  * remaining space left in packet and write, since mutual exclusion
  * protects us from concurrent writes.
+ *
+ * The line is formatted straight into the metadata array, which is grown and
+ * the line formatted again when it does not fit. The metadata file is only
+ * written by metadata_file_flush().
  */
 static
 int lttng_metadata_printf(struct ust_registry_session *session,
 		const char *fmt, ...)
 {
-	char *str = NULL;
-	size_t len;
 	va_list ap;
-	ssize_t offset;
+	size_t space;
+	char *str;
 	int ret;
 
-	va_start(ap, fmt);
-	ret = vasprintf(&str, fmt, ap);
-	va_end(ap);
-	if (ret < 0)
-		return -ENOMEM;
+	for (;;) {
+		space = session->metadata_alloc_len - session->metadata_len;
+		str = space ? &session->metadata[session->metadata_len] : NULL;
 
-	len = strlen(str);
-	offset = metadata_reserve(session, len);
-	if (offset < 0) {
-		ret = offset;
-		goto end;
-	}
-	memcpy(&session->metadata[offset], str, len);
-	ret = metadata_file_append(session, str, len);
-	if (ret) {
-		PERROR("Error appending to metadata file");
-		goto end;
+		va_start(ap, fmt);
+		ret = vsnprintf(str, space, fmt, ap);
+		va_end(ap);
+		if (ret < 0)
+			return -ENOMEM;
+		/* vsnprintf() needs room for the null terminator. */
+		if (ret < space)
+			break;
+		ret = metadata_grow(session, (size_t) ret + 1);
+		if (ret)
+			return ret;
 	}
-	DBG3("Append to metadata: \"%s\"", str);
-	ret = 0;
 
-end:
-	free(str);
-	return ret;
+	session->metadata_len += ret;
+	DBG3("Append to metadata: \"%.*s\"", ret, str);
+	return 0;
 }
 
 static
@@ -633,6 +694,149 @@ int _lttng_fields_metadata_statedump(struct ust_registry_session *session,
 	return ret;
 }
 
+/*
+ * The description of the enumeration fields refers to enumerations of the
+ * session which are not part of the event signature.
+ */
+static
+int fields_cacheable(struct ust_registry_event *event)
+{
+	size_t i;
+
+	if (!event->signature) {
+		return 0;
+	}
+	for (i = 0; i < event->nr_fields; i++) {
+		if (event->fields[i].type.atype == ustctl_atype_enum) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static
+int ust_metadata_fields_bo(struct ust_registry_session *session)
+{
+	return session->byte_order == BIG_ENDIAN;
+}
+
+/*
+ * Look up the fields description of a signature in the cache.
+ *
+ * Called with fields_cache_lock held.
+ */
+static
+struct ust_metadata_fields *lookup_fields(const char *signature)
+{
+	struct lttng_ht_iter iter;
+	struct lttng_ht_node_str *node;
+
+	if (!fields_cache) {
+		return NULL;
+	}
+	lttng_ht_lookup(fields_cache, (void *) signature, &iter);
+	node = lttng_ht_iter_get_node_str(&iter);
+	if (!node) {
+		return NULL;
+	}
+	return caa_container_of(node, struct ust_metadata_fields, node);
+}
+
+/*
+ * Add the fields description of a signature to the cache. The cache is best
+ * effort, errors are ignored.
+ *
+ * Called with fields_cache_lock held.
+ */
+static
+void add_fields(const char *signature, int bo, const char *text, size_t len)
+{
+	struct ust_metadata_fields *fields;
+
+	if (!fields_cache) {
+		fields_cache = lttng_ht_new(0, LTTNG_HT_TYPE_STRING);
+		if (!fields_cache) {
+			return;
+		}
+	}
+
+	fields = lookup_fields(signature);
+	if (fields && fields->text[bo]) {
+		/* Added concurrently. */
+		return;
+	}
+	if (!fields) {
+		fields = zmalloc(sizeof(*fields));
+		if (!fields) {
+			return;
+		}
+		fields->signature = strdup(signature);
+		if (!fields->signature) {
+			free(fields);
+			return;
+		}
+		lttng_ht_node_init_str(&fields->node, fields->signature);
+		lttng_ht_add_unique_str(fields_cache, &fields->node);
+	}
+	fields->text[bo] = zmalloc(len);
+	if (!fields->text[bo]) {
+		return;
+	}
+	memcpy(fields->text[bo], text, len);
+	fields->len[bo] = len;
+}
+
+/*
+ * Dump the fields description of an event, copying it from the cache if an
+ * event of the same signature was already dumped by any registry session of
+ * the same byte order.
+ */
+static
+int _lttng_fields_metadata_statedump_cached(
+		struct ust_registry_session *session,
+		struct ust_registry_event *event)
+{
+	int ret;
+	int bo = ust_metadata_fields_bo(session);
+	ssize_t offset;
+	size_t start;
+	struct ust_metadata_fields *fields;
+
+	if (!fields_cacheable(event)) {
+		return _lttng_fields_metadata_statedump(session, event);
+	}
+
+	rcu_read_lock();
+	pthread_mutex_lock(&fields_cache_lock);
+	fields = lookup_fields(event->signature);
+	if (fields && fields->text[bo]) {
+		offset = metadata_reserve(session, fields->len[bo]);
+		if (offset >= 0) {
+			memcpy(&session->metadata[offset], fields->text[bo],
+					fields->len[bo]);
+		}
+		pthread_mutex_unlock(&fields_cache_lock);
+		ret = offset < 0 ? offset : 0;
+		goto end;
+	}
+	pthread_mutex_unlock(&fields_cache_lock);
+
+	/* Format outside of the cache lock, other sessions may use it. */
+	start = session->metadata_len;
+	ret = _lttng_fields_metadata_statedump(session, event);
+	if (ret) {
+		goto end;
+	}
+
+	pthread_mutex_lock(&fields_cache_lock);
+	add_fields(event->signature, bo, &session->metadata[start],
+			session->metadata_len - start);
+	pthread_mutex_unlock(&fields_cache_lock);
+end:
+	rcu_read_unlock();
+	return ret;
+}
+
 /*
  * Should be called with session registry mutex held.
  */
@@ -677,7 +881,7 @@ int ust_metadata_event_statedump(struct ust_registry_session *session,
 	if (ret)
 		goto end;
 
-	ret = _lttng_fields_metadata_statedump(session, event);
+	ret = _lttng_fields_metadata_statedump_cached(session, event);
 	if (ret)
 		goto end;
 
@@ -689,6 +893,8 @@ int ust_metadata_event_statedump(struct ust_registry_session *session,
 	event->metadata_dumped = 1;
 
 end:
+	if (metadata_file_flush(session) && !ret)
+		ret = -1;
 	return ret;
 }
 
@@ -743,6 +949,8 @@ int ust_metadata_channel_statedump(struct ust_registry_session *session,
 	chan->metadata_dumped = 1;
 
 end:
+	if (metadata_file_flush(session) && !ret)
+		ret = -1;
 	return ret;
 }
 
@@ -850,15 +1058,15 @@ int measure_single_clock_offset(struct offset_sample *sample)
  * May return a negative offset.
  */
 static
-int64_t measure_clock_offset(void)
+int64_t measure_clock_offset(unsigned int nr_samples)
 {
-	int i;
+	unsigned int i;
 	struct offset_sample offset_best_sample = {
 		.offset = 0,
 		.measure_delta = UINT64_MAX,
 	};
 
-	for (i = 0; i < NR_CLOCK_OFFSET_SAMPLES; i++) {
+	for (i = 0; i < nr_samples; i++) {
 		if (measure_single_clock_offset(&offset_best_sample)) {
 			return 0;
 		}
@@ -866,6 +1074,51 @@ int64_t measure_clock_offset(void)
 	return offset_best_sample.offset;
 }
 
+static
+void cache_clock_offset(int64_t offset)
+{
+	pthread_mutex_lock(&clock_offset_cache.lock);
+	clock_offset_cache.offset = offset;
+	clock_offset_cache.timestamp = trace_clock_read64();
+	clock_offset_cache.valid = 1;
+	pthread_mutex_unlock(&clock_offset_cache.lock);
+}
+
+/*
+ * Get the clock offset measured in the last CLOCK_OFFSET_VALIDITY nsec or
+ * else measure it. The clocks drift apart by far less than the precision of
+ * the measurement over such a window.
+ */
+static
+int64_t get_clock_offset(void)
+{
+	int64_t offset;
+	uint64_t tcf = trace_clock_freq(), validity, now;
+
+	validity = tcf == NSEC_PER_SEC ? CLOCK_OFFSET_VALIDITY :
+			CLOCK_OFFSET_VALIDITY * tcf / NSEC_PER_SEC;
+	now = trace_clock_read64();
+
+	pthread_mutex_lock(&clock_offset_cache.lock);
+	if (clock_offset_cache.valid &&
+			now - clock_offset_cache.timestamp < validity) {
+		offset = clock_offset_cache.offset;
+		pthread_mutex_unlock(&clock_offset_cache.lock);
+		return offset;
+	}
+	pthread_mutex_unlock(&clock_offset_cache.lock);
+
+	offset = measure_clock_offset(NR_CLOCK_OFFSET_SAMPLES);
+	cache_clock_offset(offset);
+	return offset;
+}
+
+void ust_metadata_measure_clock_offset(void)
+{
+	cache_clock_offset(measure_clock_offset(
+			NR_PRECISE_CLOCK_OFFSET_SAMPLES));
+}
+
 /*
  * Should be called with session registry mutex held.
  */
@@ -1003,7 +1256,7 @@ int ust_metadata_session_statedump(struct ust_registry_session *session,
 		"};\n\n",
 		trace_clock_description(),
 		trace_clock_freq(),
-		measure_clock_offset()
+		get_clock_offset()
 		);
 	if (ret)
 		goto end;
@@ -1041,5 +1294,38 @@ int ust_metadata_session_statedump(struct ust_registry_session *session,
 		goto end;
 
 end:
+	if (metadata_file_flush(session) && !ret)
+		ret = -1;
 	return ret;
 }
+
+/*
+ * Destroy the fields cache shared by the registry sessions. MUST be called
+ * once all the registry sessions are destroyed.
+ */
+void ust_metadata_cache_destroy(void)
+{
+	int ret;
+	struct lttng_ht_iter iter;
+	struct ust_metadata_fields *fields;
+
+	pthread_mutex_lock(&fields_cache_lock);
+	if (!fields_cache) {
+		goto end;
+	}
+	rcu_read_lock();
+	cds_lfht_for_each_entry(fields_cache->ht, &iter.iter, fields,
+			node.node) {
+		ret = lttng_ht_del(fields_cache, &iter);
+		assert(!ret);
+		free(fields->text[0]);
+		free(fields->text[1]);
+		free(fields->signature);
+		free(fields);
+	}
+	rcu_read_unlock();
+	lttng_ht_destroy(fields_cache);
+	fields_cache = NULL;
+end:
+	pthread_mutex_unlock(&fields_cache_lock);
+}
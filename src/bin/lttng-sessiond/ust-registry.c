@@ -29,6 +29,150 @@
 #include "lttng-sessiond.h"
 #include "notification-thread-commands.h"
 
+/*
+ * Content-addressed store of the event signatures, event field arrays and
+ * enumeration entries of all the registries, indexed by content. The
+ * registries of the instances of a same application share a single copy of
+ * each. The table is allocated with its first content and freed with its
+ * last one. Protected by contents_lock.
+ */
+static struct lttng_ht *contents_ht;
+static pthread_mutex_t contents_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Key of the content store. */
+struct content_key {
+	const void *data;
+	size_t len;
+};
+
+/*
+ * Hash table match function for the content store.
+ */
+static int ht_match_content(struct cds_lfht_node *node, const void *_key)
+{
+	struct ust_registry_content *content;
+	const struct content_key *key = _key;
+
+	content = caa_container_of(node, struct ust_registry_content, node);
+	return content->len == key->len &&
+			!memcmp(content->data, key->data, key->len);
+}
+
+/*
+ * Lookup a content using its hash.
+ *
+ * The content lock MUST be held.
+ */
+static struct ust_registry_content *lookup_content(const void *data,
+		size_t len, unsigned long hash)
+{
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+	struct content_key key = {
+		.data = data,
+		.len = len,
+	};
+
+	if (!contents_ht) {
+		return NULL;
+	}
+
+	rcu_read_lock();
+	cds_lfht_lookup(contents_ht->ht, hash, ht_match_content, &key, &iter);
+	node = cds_lfht_iter_get_node(&iter);
+	rcu_read_unlock();
+	if (!node) {
+		return NULL;
+	}
+	return caa_container_of(node, struct ust_registry_content, node);
+}
+
+/*
+ * Get a reference on the stored content equal to the "len" bytes of "data",
+ * storing it if it is not already. On success, the ownership of "data" is
+ * taken.
+ *
+ * Return the stored content or NULL on error.
+ */
+static struct ust_registry_content *get_content(void *data, size_t len)
+{
+	unsigned long hash = hash_key_buf(data, len, lttng_ht_seed);
+	struct ust_registry_content *content;
+
+	pthread_mutex_lock(&contents_lock);
+	content = lookup_content(data, len, hash);
+	if (content) {
+		content->refcount++;
+		free(data);
+		goto end;
+	}
+
+	content = zmalloc(sizeof(*content));
+	if (!content) {
+		PERROR("zmalloc ust registry content");
+		goto end;
+	}
+	if (!contents_ht) {
+		contents_ht = lttng_ht_new(0, LTTNG_HT_TYPE_STRING);
+		if (!contents_ht) {
+			free(content);
+			content = NULL;
+			goto end;
+		}
+	}
+	content->data = data;
+	content->len = len;
+	content->hash = hash;
+	content->refcount = 1;
+	cds_lfht_node_init(&content->node);
+	rcu_read_lock();
+	cds_lfht_add(contents_ht->ht, hash, &content->node);
+	rcu_read_unlock();
+end:
+	pthread_mutex_unlock(&contents_lock);
+	return content;
+}
+
+static void destroy_content_rcu(struct rcu_head *head)
+{
+	struct ust_registry_content *content =
+		caa_container_of(head, struct ust_registry_content, rcu_head);
+
+	free(content->data);
+	free(content);
+}
+
+/*
+ * Release a reference on a stored content. It's safe to pass a NULL pointer.
+ */
+static void put_content(struct ust_registry_content *content)
+{
+	int ret;
+	struct lttng_ht_iter iter;
+
+	if (!content) {
+		return;
+	}
+
+	pthread_mutex_lock(&contents_lock);
+	if (--content->refcount) {
+		goto end;
+	}
+
+	rcu_read_lock();
+	iter.iter.node = &content->node;
+	ret = lttng_ht_del(contents_ht, &iter);
+	assert(!ret);
+	call_rcu(&content->rcu_head, destroy_content_rcu);
+	if (!lttng_ht_get_count(contents_ht)) {
+		ht_cleanup_push(contents_ht);
+		contents_ht = NULL;
+	}
+	rcu_read_unlock();
+end:
+	pthread_mutex_unlock(&contents_lock);
+}
+
 /*
  * Hash table match function for event in the registry.
  */
@@ -44,14 +188,13 @@ static int ht_match_event(struct cds_lfht_node *node, const void *_key)
 	assert(event);
 	key = _key;
 
-	/* It has to be a perfect match. */
-	if (strncmp(event->name, key->name, sizeof(event->name))) {
+	/* The signatures are interned. */
+	if (event->interned_sig != key->interned_sig) {
 		goto no_match;
 	}
 
 	/* It has to be a perfect match. */
-	if (strncmp(event->signature, key->signature,
-			strlen(event->signature))) {
+	if (strncmp(event->name, key->name, sizeof(event->name))) {
 		goto no_match;
 	}
 
@@ -68,9 +211,11 @@ static unsigned long ht_hash_event(void *_key, unsigned long seed)
 	struct ust_registry_event *key = _key;
 
 	assert(key);
+	assert(key->interned_sig);
 
+	/* The hash of the signature is computed once when it is stored. */
 	xored_key = (uint64_t) (hash_key_str(key->name, seed) ^
-			hash_key_str(key->signature, seed));
+			key->interned_sig->hash);
 
 	return hash_key_u64(&xored_key, seed);
 }
@@ -86,6 +231,10 @@ static int compare_enums(const struct ust_registry_enum *reg_enum_a,
 		ret = -1;
 		goto end;
 	}
+	if (reg_enum_a->entries == reg_enum_b->entries) {
+		/* Same stored entries. */
+		goto end;
+	}
 	for (i = 0; i < reg_enum_a->nr_entries; i++) {
 		const struct ustctl_enum_entry *entries_a, *entries_b;
 
@@ -254,6 +403,19 @@ int validate_event_fields(size_t nr_fields, struct ustctl_field *fields,
 	return 0;
 }
 
+/*
+ * Account bytes of a channel of a registry, or of the registry itself if the
+ * channel is NULL.
+ */
+static void account_registry_bytes(struct ust_registry_session *session,
+		struct ust_registry_channel *chan, size_t len)
+{
+	if (chan) {
+		uatomic_add(&chan->registry_bytes, len);
+	}
+	uatomic_add(&session->registry_bytes, len);
+}
+
 /*
  * Allocate event and initialize it. This does NOT set a valid event id from a
  * registry.
@@ -278,10 +440,25 @@ static struct ust_registry_event *alloc_event(int session_objd,
 		goto error;
 	}
 
+	/* Allocated by ustctl, owned by the content store on success. */
+	event->interned_sig = get_content(sig, strlen(sig) + 1);
+	if (!event->interned_sig) {
+		free(event);
+		event = NULL;
+		goto error;
+	}
+	event->signature = event->interned_sig->data;
+	/* Keep a private copy of the fields if they can't be stored. */
+	if (nr_fields) {
+		event->interned_fields = get_content(fields,
+				nr_fields * sizeof(*fields));
+		if (event->interned_fields) {
+			fields = event->interned_fields->data;
+		}
+	}
+
 	event->session_objd = session_objd;
 	event->channel_objd = channel_objd;
-	/* Allocated by ustctl. */
-	event->signature = sig;
 	event->nr_fields = nr_fields;
 	event->fields = fields;
 	event->loglevel_value = loglevel_value;
@@ -308,9 +485,13 @@ static void destroy_event(struct ust_registry_event *event)
 		return;
 	}
 
-	free(event->fields);
+	if (event->interned_fields) {
+		put_content(event->interned_fields);
+	} else {
+		free(event->fields);
+	}
 	free(event->model_emf_uri);
-	free(event->signature);
+	put_content(event->interned_sig);
 	free(event);
 }
 
@@ -346,10 +527,20 @@ struct ust_registry_event *ust_registry_find_event(
 	assert(name);
 	assert(sig);
 
-	/* Setup key for the match function. */
+	/*
+	 * Setup key for the match function. The interned signature can't be
+	 * reclaimed within the RCU read side lock section.
+	 */
 	strncpy(key.name, name, sizeof(key.name));
 	key.name[sizeof(key.name) - 1] = '\0';
-	key.signature = sig;
+	pthread_mutex_lock(&contents_lock);
+	key.interned_sig = lookup_content(sig, strlen(sig) + 1,
+			hash_key_buf(sig, strlen(sig) + 1, lttng_ht_seed));
+	pthread_mutex_unlock(&contents_lock);
+	if (!key.interned_sig) {
+		/* No event has this signature. */
+		goto end;
+	}
 
 	cds_lfht_lookup(chan->ht->ht, chan->ht->hash_fct(&key, lttng_ht_seed),
 			chan->ht->match_fct, &key, &iter.iter);
@@ -454,6 +645,11 @@ int ust_registry_create_event(struct ust_registry_session *session,
 	} else {
 		/* Request next event id if the node was successfully added. */
 		event_id = event->id = ust_registry_get_next_event_id(chan);
+		account_registry_bytes(session, chan, sizeof(*event) +
+				nr_fields * sizeof(*event->fields) +
+				strlen(event->signature) + 1 +
+				(event->model_emf_uri ?
+					strlen(event->model_emf_uri) + 1 : 0));
 	}
 
 	*event_id_p = event_id;
@@ -509,7 +705,11 @@ static void destroy_enum(struct ust_registry_enum *reg_enum)
 	if (!reg_enum) {
 		return;
 	}
-	free(reg_enum->entries);
+	if (reg_enum->interned_entries) {
+		put_content(reg_enum->interned_entries);
+	} else {
+		free(reg_enum->entries);
+	}
 	free(reg_enum);
 }
 
@@ -616,7 +816,17 @@ int ust_registry_create_or_find_enum(struct ust_registry_session *session,
 	}
 	strncpy(reg_enum->name, enum_name, LTTNG_UST_SYM_NAME_LEN);
 	reg_enum->name[LTTNG_UST_SYM_NAME_LEN - 1] = '\0';
-	/* entries will be owned by reg_enum. */
+	/*
+	 * entries will be owned by reg_enum, which keeps a private copy if they
+	 * can't be stored.
+	 */
+	if (nr_entries) {
+		reg_enum->interned_entries = get_content(entries,
+				nr_entries * sizeof(*entries));
+		if (reg_enum->interned_entries) {
+			entries = reg_enum->interned_entries->data;
+		}
+	}
 	reg_enum->entries = entries;
 	reg_enum->nr_entries = nr_entries;
 	entries = NULL;
@@ -642,6 +852,8 @@ int ust_registry_create_or_find_enum(struct ust_registry_session *session,
 				ht_match_enum_id, reg_enum,
 				&reg_enum->node.node);
 		assert(nodep == &reg_enum->node.node);
+		account_registry_bytes(session, NULL, sizeof(*reg_enum) +
+				nr_entries * sizeof(*reg_enum->entries));
 	}
 	DBG("UST registry reply with enum %s with id %" PRIu64 " in sess_objd: %u",
 			enum_name, reg_enum->id, session_objd);
@@ -652,27 +864,6 @@ end:
 	return ret;
 }
 
-/*
- * For a given enumeration in a registry, delete the entry and destroy
- * the enumeration.
- * This MUST be called within a RCU read side lock section.
- */
-void ust_registry_destroy_enum(struct ust_registry_session *reg_session,
-		struct ust_registry_enum *reg_enum)
-{
-	int ret;
-	struct lttng_ht_iter iter;
-
-	assert(reg_session);
-	assert(reg_enum);
-
-	/* Delete the node first. */
-	iter.iter.node = &reg_enum->node.node;
-	ret = lttng_ht_del(reg_session->enums, &iter);
-	assert(!ret);
-	call_rcu(&reg_enum->rcu_head, destroy_enum_rcu);
-}
-
 /*
  * We need to execute ht_destroy outside of RCU read-side critical
  * section and outside of call_rcu thread, so we postpone its execution
@@ -696,12 +887,18 @@ void destroy_channel_rcu(struct rcu_head *head)
  * Destroy every element of the registry and free the memory. This does NOT
  * free the registry pointer since it might not have been allocated before so
  * it's the caller responsability.
+ *
+ * The channel and its events are freed with the objects of "free_batch" or,
+ * if NULL, after a grace period of their own.
  */
-static void destroy_channel(struct ust_registry_channel *chan, bool notif)
+static void destroy_channel(struct ust_registry_channel *chan, bool notif,
+		struct lttng_ht_free_batch *free_batch)
 {
+	int ret;
 	struct lttng_ht_iter iter;
 	struct ust_registry_event *event;
 	enum lttng_error_code cmd_ret;
+	struct lttng_ht_free_batch local_batch = { 0 };
 
 	assert(chan);
 
@@ -714,14 +911,25 @@ static void destroy_channel(struct ust_registry_channel *chan, bool notif)
 		}
 	}
 
+	if (!free_batch) {
+		free_batch = &local_batch;
+	}
+
 	rcu_read_lock();
 	/* Destroy all event associated with this registry. */
 	cds_lfht_for_each_entry(chan->ht->ht, &iter.iter, event, node.node) {
 		/* Delete the node from the ht and free it. */
-		ust_registry_destroy_event(chan, event);
+		ret = lttng_ht_del(chan->ht, &iter);
+		assert(!ret);
+		lttng_ht_free_batch_add(free_batch, &event->node.head,
+				destroy_event_rcu);
 	}
 	rcu_read_unlock();
-	call_rcu(&chan->rcu_head, destroy_channel_rcu);
+	lttng_ht_free_batch_add(free_batch, &chan->rcu_head,
+			destroy_channel_rcu);
+	if (free_batch == &local_batch) {
+		lttng_ht_free_batch_commit(&local_batch);
+	}
 }
 
 /*
@@ -767,11 +975,12 @@ int ust_registry_channel_add(struct ust_registry_session *session,
 	lttng_ht_node_init_u64(&chan->node, key);
 	lttng_ht_add_unique_u64(session->channels, &chan->node);
 	rcu_read_unlock();
+	account_registry_bytes(session, chan, sizeof(*chan));
 
 	return 0;
 
 error:
-	destroy_channel(chan, false);
+	destroy_channel(chan, false, NULL);
 error_alloc:
 	return ret;
 }
@@ -829,7 +1038,9 @@ void ust_registry_channel_del_free(struct ust_registry_session *session,
 	ret = lttng_ht_del(session->channels, &iter);
 	assert(!ret);
 	rcu_read_unlock();
-	destroy_channel(chan, notif);
+	uatomic_sub(&session->registry_bytes,
+			uatomic_read(&chan->registry_bytes));
+	destroy_channel(chan, notif, NULL);
 
 end:
 	return;
@@ -870,6 +1081,7 @@ int ust_registry_session_init(struct ust_registry_session **sessionp,
 	}
 
 	pthread_mutex_init(&session->lock, NULL);
+	pthread_cond_init(&session->metadata_push_cond, NULL);
 	session->bits_per_long = bits_per_long;
 	session->uint8_t_alignment = uint8_t_alignment;
 	session->uint16_t_alignment = uint16_t_alignment;
@@ -967,6 +1179,8 @@ void ust_registry_session_destroy(struct ust_registry_session *reg)
 	struct lttng_ht_iter iter;
 	struct ust_registry_channel *chan;
 	struct ust_registry_enum *reg_enum;
+	/* The channels, events and enums share one grace period. */
+	struct lttng_ht_free_batch free_batch = { 0 };
 
 	if (!reg) {
 		return;
@@ -975,6 +1189,8 @@ void ust_registry_session_destroy(struct ust_registry_session *reg)
 	/* On error, EBUSY can be returned if lock. Code flow error. */
 	ret = pthread_mutex_destroy(&reg->lock);
 	assert(!ret);
+	ret = pthread_cond_destroy(&reg->metadata_push_cond);
+	assert(!ret);
 
 	if (reg->channels) {
 		rcu_read_lock();
@@ -984,7 +1200,7 @@ void ust_registry_session_destroy(struct ust_registry_session *reg)
 			/* Delete the node from the ht and free it. */
 			ret = lttng_ht_del(reg->channels, &iter);
 			assert(!ret);
-			destroy_channel(chan, true);
+			destroy_channel(chan, true, &free_batch);
 		}
 		rcu_read_unlock();
 		ht_cleanup_push(reg->channels);
@@ -1015,9 +1231,13 @@ void ust_registry_session_destroy(struct ust_registry_session *reg)
 		/* Destroy all enum entries associated with this registry. */
 		cds_lfht_for_each_entry(reg->enums->ht, &iter.iter, reg_enum,
 				node.node) {
-			ust_registry_destroy_enum(reg, reg_enum);
+			ret = lttng_ht_del(reg->enums, &iter);
+			assert(!ret);
+			lttng_ht_free_batch_add(&free_batch, &reg_enum->rcu_head,
+					destroy_enum_rcu);
 		}
 		rcu_read_unlock();
 		ht_cleanup_push(reg->enums);
 	}
+	lttng_ht_free_batch_commit(&free_batch);
 }
@@ -68,6 +68,14 @@ struct ust_registry_session {
 	size_t metadata_len, metadata_alloc_len;
 	/* Length of bytes sent to the consumer. */
 	size_t metadata_len_sent;
+	/*
+	 * Set while push_metadata() pushes the metadata, with the registry
+	 * lock released. metadata_push_cond is signaled once it is done.
+	 */
+	int metadata_pushing;
+	pthread_cond_t metadata_push_cond;
+	/* Length of bytes written to the metadata file. */
+	size_t metadata_len_written;
 	/* Current version of the metadata. */
 	uint64_t metadata_version;
 
@@ -105,6 +113,13 @@ struct ust_registry_session {
 	 */
 	uint32_t major;
 	uint32_t minor;
+
+	/*
+	 * Bytes of the channel, event and enumeration descriptions of the
+	 * registry, the stored contents they share included. Updated
+	 * atomically.
+	 */
+	size_t registry_bytes;
 };
 
 struct ust_registry_channel {
@@ -140,6 +155,24 @@ struct ust_registry_channel {
 	struct lttng_ht_node_u64 node;
 	/* For delayed reclaim */
 	struct rcu_head rcu_head;
+	/* Part of the registry bytes of the session due to the channel. */
+	size_t registry_bytes;
+};
+
+/*
+ * Content shared by the registries, stored once and reference counted. An
+ * event signature is hashed once when it is stored and the events are matched
+ * by comparing the addresses of their stored signatures.
+ */
+struct ust_registry_content {
+	void *data;
+	size_t len;
+	unsigned long hash;
+	/* Number of users of the content. Protected by the store lock. */
+	unsigned long refcount;
+	struct cds_lfht_node node;
+	/* For delayed reclaim. */
+	struct rcu_head rcu_head;
 };
 
 /*
@@ -153,10 +186,14 @@ struct ust_registry_event {
 	int channel_objd;
 	/* Name of the event returned by the tracer. */
 	char name[LTTNG_UST_SYM_NAME_LEN];
+	/* String of the stored signature. */
 	char *signature;
+	struct ust_registry_content *interned_sig;
 	int loglevel_value;
 	size_t nr_fields;
+	/* Stored fields, or a private copy if interned_fields is NULL. */
 	struct ustctl_field *fields;
+	struct ust_registry_content *interned_fields;
 	char *model_emf_uri;
 	/*
 	 * Flag for this channel if the metadata was dumped once during
@@ -172,7 +209,9 @@ struct ust_registry_event {
 
 struct ust_registry_enum {
 	char name[LTTNG_UST_SYM_NAME_LEN];
+	/* Stored entries, or a private copy if interned_entries is NULL. */
 	struct ustctl_enum_entry *entries;
+	struct ust_registry_content *interned_entries;
 	size_t nr_entries;
 	uint64_t id;	/* enum id in session */
 	/* Enumeration node in session hash table. */
@@ -286,6 +325,12 @@ int ust_metadata_channel_statedump(struct ust_registry_session *session,
 int ust_metadata_event_statedump(struct ust_registry_session *session,
 		struct ust_registry_channel *chan,
 		struct ust_registry_event *event);
+void ust_metadata_cache_destroy(void);
+/*
+ * Measure the clock offset of the session metadata with more samples than on
+ * a session creation, for the next session statedumps.
+ */
+void ust_metadata_measure_clock_offset(void);
 int ust_registry_create_or_find_enum(struct ust_registry_session *session,
 		int session_objd, char *name,
 		struct ustctl_enum_entry *entries, size_t nr_entries,
@@ -352,6 +397,10 @@ void ust_registry_destroy_event(struct ust_registry_channel *chan,
 		struct ust_registry_event *event)
 {}
 
+static inline
+void ust_metadata_measure_clock_offset(void)
+{
+}
 /* The app object can be NULL for registry shared across applications. */
 static inline
 int ust_metadata_session_statedump(struct ust_registry_session *session,
@@ -373,6 +422,9 @@ int ust_metadata_event_statedump(struct ust_registry_session *session,
 	return 0;
 }
 static inline
+void ust_metadata_cache_destroy(void)
+{}
+static inline
 int ust_registry_create_or_find_enum(struct ust_registry_session *session,
 		int session_objd, char *name,
 		struct ustctl_enum_entry *entries, size_t nr_entries,
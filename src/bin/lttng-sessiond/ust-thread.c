@@ -36,8 +36,10 @@ void *ust_thread_manage_notify(void *data)
 	ssize_t size_ret;
 	uint32_t revents, nb_fd;
 	struct lttng_poll_event events;
+	int *notify_pipe = apps_cmd_notify_pipe[(unsigned long) data];
 
-	DBG("[ust-thread] Manage application notify command");
+	DBG("[ust-thread] Manage application notify command on thread %lu",
+			(unsigned long) data);
 
 	rcu_register_thread();
 	rcu_thread_online();
@@ -57,7 +59,7 @@ void *ust_thread_manage_notify(void *data)
 	}
 
 	/* Add notify pipe to the pollset. */
-	ret = lttng_poll_add(&events, apps_cmd_notify_pipe[0],
+	ret = lttng_poll_add(&events, notify_pipe[0],
 			LPOLLIN | LPOLLERR | LPOLLHUP | LPOLLRDHUP);
 	if (ret < 0) {
 		goto error;
@@ -107,12 +109,12 @@ restart:
 			}
 
 			/* Inspect the apps cmd pipe */
-			if (pollfd == apps_cmd_notify_pipe[0]) {
+			if (pollfd == notify_pipe[0]) {
 				int sock;
 
 				if (revents & LPOLLIN) {
 					/* Get socket from dispatch thread. */
-					size_ret = lttng_read(apps_cmd_notify_pipe[0],
+					size_ret = lttng_read(notify_pipe[0],
 							&sock, sizeof(sock));
 					if (size_ret < sizeof(sock)) {
 						PERROR("read apps notify pipe");
@@ -182,8 +184,8 @@ error:
 	lttng_poll_clean(&events);
 error_poll_create:
 error_testpoint:
-	utils_close_pipe(apps_cmd_notify_pipe);
-	apps_cmd_notify_pipe[0] = apps_cmd_notify_pipe[1] = -1;
+	utils_close_pipe(notify_pipe);
+	notify_pipe[0] = notify_pipe[1] = -1;
 	DBG("Application notify communication apps thread cleanup complete");
 	if (err) {
 		health_error();
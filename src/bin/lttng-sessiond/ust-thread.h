@@ -20,6 +20,10 @@
 
 #ifdef HAVE_LIBLTTNG_UST_CTL
 
+/*
+ * Application notify thread. "data" is the number of the thread, which
+ * selects its notify pipe in apps_cmd_notify_pipe.
+ */
 void *ust_thread_manage_notify(void *data);
 
 #else /* HAVE_LIBLTTNG_UST_CTL */
@@ -83,6 +83,7 @@ DECL_COMMAND(track);
 DECL_COMMAND(untrack);
 DECL_COMMAND(metadata);
 DECL_COMMAND(regenerate);
+DECL_COMMAND(rotate);
 
 extern int cmd_help(int argc, const char **argv,
 		const struct cmd_struct commands[]);
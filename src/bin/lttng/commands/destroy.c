@@ -77,6 +77,7 @@ static int destroy_session(struct lttng_session *session)
 	session_was_stopped = ret == -LTTNG_ERR_TRACE_ALREADY_STOPPED;
 	if (!opt_no_wait) {
 		bool printed_wait_msg = false;
+		useconds_t wait_time = DEFAULT_DATA_AVAILABILITY_MIN_WAIT_TIME;
 
 		do {
 			ret = lttng_data_pending(session->name);
@@ -96,7 +97,9 @@ static int destroy_session(struct lttng_session *session)
 				}
 
 				printed_wait_msg = true;
-				usleep(DEFAULT_DATA_AVAILABILITY_WAIT_TIME);
+				usleep(wait_time);
+				wait_time = min_t(useconds_t, wait_time * 2,
+						DEFAULT_DATA_AVAILABILITY_WAIT_TIME);
 				_MSG(".");
 				fflush(stdout);
 			}
@@ -52,6 +52,11 @@ static struct {
 	bool set;
 	int64_t value;
 } opt_blocking_timeout;
+static struct {
+	bool set;
+	enum lttng_channel_compression value;
+} opt_compression;
+static int opt_huge_pages;
 
 static struct mi_writer *writer;
 
@@ -75,6 +80,8 @@ enum {
 	OPT_TRACEFILE_SIZE,
 	OPT_TRACEFILE_COUNT,
 	OPT_BLOCKING_TIMEOUT,
+	OPT_COMPRESSION,
+	OPT_HUGE_PAGES,
 };
 
 static struct lttng_handle *handle;
@@ -103,6 +110,8 @@ static struct poptOption long_options[] = {
 	{"tracefile-size", 'C',   POPT_ARG_INT, 0, OPT_TRACEFILE_SIZE, 0, 0},
 	{"tracefile-count", 'W',   POPT_ARG_INT, 0, OPT_TRACEFILE_COUNT, 0, 0},
 	{"blocking-timeout",     0,   POPT_ARG_INT, 0, OPT_BLOCKING_TIMEOUT, 0, 0},
+	{"compression",    0,   POPT_ARG_STRING, 0, OPT_COMPRESSION, 0, 0},
+	{"huge-pages",     0,   POPT_ARG_NONE, 0, OPT_HUGE_PAGES, 0, 0},
 	{0, 0, 0, 0, 0, 0, 0}
 };
 
@@ -175,6 +184,11 @@ static int enable_channel(char *session_name)
 			ret = CMD_ERROR;
 			goto error;
 		}
+		if (opt_huge_pages) {
+			ERR("Huge pages not supported for domain -k");
+			ret = CMD_ERROR;
+			goto error;
+		}
 	} else if (opt_userspace) {
 		dom.type = LTTNG_DOMAIN_UST;
 		if (opt_buffer_pid) {
@@ -220,6 +234,10 @@ static int enable_channel(char *session_name)
 			ret = CMD_ERROR;
 			goto error;
 		}
+	} else if (opt_compression.set &&
+			opt_compression.value != LTTNG_CHANNEL_COMPRESSION_NONE) {
+		/* The packets are compressed from the mmap'd sub-buffers. */
+		chan_opts.attr.output = LTTNG_EVENT_MMAP;
 	}
 
 	handle = lttng_create_handle(session_name, &dom);
@@ -286,6 +304,23 @@ static int enable_channel(char *session_name)
 				goto error;
 			}
 		}
+		if (opt_compression.set) {
+			ret = lttng_channel_set_compression(channel,
+					opt_compression.value);
+			if (ret) {
+				ERR("Failed to set the channel's compression");
+				error = 1;
+				goto error;
+			}
+		}
+		if (opt_huge_pages) {
+			ret = lttng_channel_set_huge_pages(channel, 1);
+			if (ret) {
+				ERR("Failed to request huge pages for the channel");
+				error = 1;
+				goto error;
+			}
+		}
 
 		DBG("Enabling channel %s", channel_name);
 
@@ -594,6 +629,25 @@ int cmd_enable_channels(int argc, const char **argv)
 					opt_blocking_timeout.value);
 			break;
 		}
+		case OPT_COMPRESSION:
+			opt_arg = poptGetOptArg(pc);
+			if (!strcmp(opt_arg, "none")) {
+				opt_compression.value = LTTNG_CHANNEL_COMPRESSION_NONE;
+			} else if (!strcmp(opt_arg, "zlib")) {
+				opt_compression.value = LTTNG_CHANNEL_COMPRESSION_ZLIB;
+			} else {
+				ERR("Unknown compression %s. Possible values are: none, zlib",
+						opt_arg);
+				ret = CMD_ERROR;
+				goto end;
+			}
+			opt_compression.set = true;
+			DBG("Channel compression set to %s", opt_arg);
+			break;
+		case OPT_HUGE_PAGES:
+			opt_huge_pages = 1;
+			DBG("Channel huge pages requested");
+			break;
 		case OPT_USERSPACE:
 			opt_userspace = 1;
 			break;
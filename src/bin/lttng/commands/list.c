@@ -38,6 +38,12 @@ static int opt_domain;
 static int opt_fields;
 static int opt_syscall;
 
+/*
+ * The UST tracepoints are fetched and printed by pages of about this many
+ * tracepoints, so that the memory used is bounded with many applications.
+ */
+#define UST_EVENTS_PAGE_LEN	4096
+
 const char *indent4 = "    ";
 const char *indent6 = "      ";
 const char *indent8 = "        ";
@@ -380,15 +386,11 @@ static void print_event_field(struct lttng_event_field *field)
 
 /*
  * Machine interface
- * Jul and ust event listing
+ * Open the elements of the Jul and ust event listing
  */
-static int mi_list_agent_ust_events(struct lttng_event *events, int count,
-		struct lttng_domain *domain)
+static int mi_list_agent_ust_events_open(struct lttng_domain *domain)
 {
-	int ret, i;
-	pid_t cur_pid = 0;
-	char *cmdline = NULL;
-	int pid_element_open = 0;
+	int ret;
 
 	/* Open domains element */
 	ret = mi_lttng_domains_open(writer);
@@ -404,31 +406,42 @@ static int mi_list_agent_ust_events(struct lttng_event *events, int count,
 
 	/* Open pids element element */
 	ret = mi_lttng_pids_open(writer);
-	if (ret) {
-		goto end;
-	}
+end:
+	return ret;
+}
+
+/*
+ * Machine interface
+ * Write Jul and ust events, grouped by pid. "cur_pid" and "pid_element_open"
+ * carry the open pid element from a call to the next one.
+ */
+static int mi_list_agent_ust_pid_events(struct lttng_event *events, int count,
+		pid_t *cur_pid, int *pid_element_open)
+{
+	int ret = 0, i;
+	char *cmdline = NULL;
 
 	for (i = 0; i < count; i++) {
-		if (cur_pid != events[i].pid) {
-			if (pid_element_open) {
+		if (*cur_pid != events[i].pid) {
+			if (*pid_element_open) {
 				/* Close the previous events and pid element */
 				ret = mi_lttng_close_multi_element(writer, 2);
 				if (ret) {
 					goto end;
 				}
-				pid_element_open = 0;
+				*pid_element_open = 0;
 			}
 
-			cur_pid = events[i].pid;
-			cmdline = get_cmdline_by_pid(cur_pid);
+			*cur_pid = events[i].pid;
+			cmdline = get_cmdline_by_pid(*cur_pid);
 			if (!cmdline) {
 				ret = CMD_ERROR;
 				goto end;
 			}
 
-			if (!pid_element_open) {
+			if (!*pid_element_open) {
 				/* Open and write a pid element */
-				ret = mi_lttng_pid(writer, cur_pid, cmdline, 1);
+				ret = mi_lttng_pid(writer, *cur_pid, cmdline, 1);
 				if (ret) {
 					goto error;
 				}
@@ -439,7 +452,7 @@ static int mi_list_agent_ust_events(struct lttng_event *events, int count,
 					goto error;
 				}
 
-				pid_element_open = 1;
+				*pid_element_open = 1;
 			}
 			free(cmdline);
 		}
@@ -450,6 +463,20 @@ static int mi_list_agent_ust_events(struct lttng_event *events, int count,
 			goto end;
 		}
 	}
+end:
+	return ret;
+error:
+	free(cmdline);
+	return ret;
+}
+
+/*
+ * Machine interface
+ * Close the elements of the Jul and ust event listing
+ */
+static int mi_list_agent_ust_events_close(void)
+{
+	int ret;
 
 	/* Close pids */
 	ret = mi_lttng_writer_close_element(writer);
@@ -461,8 +488,32 @@ static int mi_list_agent_ust_events(struct lttng_event *events, int count,
 	ret = mi_lttng_close_multi_element(writer, 2);
 end:
 	return ret;
-error:
-	free(cmdline);
+}
+
+/*
+ * Machine interface
+ * Jul and ust event listing
+ */
+static int mi_list_agent_ust_events(struct lttng_event *events, int count,
+		struct lttng_domain *domain)
+{
+	int ret;
+	pid_t cur_pid = 0;
+	int pid_element_open = 0;
+
+	ret = mi_list_agent_ust_events_open(domain);
+	if (ret) {
+		goto end;
+	}
+
+	ret = mi_list_agent_ust_pid_events(events, count, &cur_pid,
+			&pid_element_open);
+	if (ret) {
+		goto end;
+	}
+
+	ret = mi_list_agent_ust_events_close();
+end:
 	return ret;
 }
 
@@ -552,11 +603,12 @@ end:
  */
 static int list_ust_events(void)
 {
-	int i, size, ret = CMD_SUCCESS;
+	int i, size, nb_events = 0, ret = CMD_SUCCESS;
 	struct lttng_domain domain;
 	struct lttng_handle *handle;
 	struct lttng_event *event_list = NULL;
-	pid_t cur_pid = 0;
+	pid_t cur_pid = 0, pid_cursor = 0;
+	int pid_element_open = 0;
 	char *cmdline = NULL;
 
 	memset(&domain, 0, sizeof(domain));
@@ -571,36 +623,63 @@ static int list_ust_events(void)
 		goto end;
 	}
 
-	size = lttng_list_tracepoints(handle, &event_list);
-	if (size < 0) {
-		ERR("Unable to list UST events: %s", lttng_strerror(size));
-		ret = CMD_ERROR;
-		goto error;
-	}
-
 	if (lttng_opt_mi) {
 		/* Mi print */
-		ret = mi_list_agent_ust_events(event_list, size, &domain);
+		ret = mi_list_agent_ust_events_open(&domain);
+		if (ret) {
+			goto error;
+		}
 	} else {
 		/* Pretty print */
 		MSG("UST events:\n-------------");
+	}
 
+	/* Print each page as soon as it is received. */
+	for (;;) {
+		size = lttng_list_tracepoints_page(handle, &pid_cursor,
+				UST_EVENTS_PAGE_LEN, &event_list);
+		if (size < 0) {
+			ERR("Unable to list UST events: %s",
+					lttng_strerror(size));
+			ret = CMD_ERROR;
+			goto error;
+		}
 		if (size == 0) {
-			MSG("None");
+			break;
 		}
+		nb_events += size;
 
-		for (i = 0; i < size; i++) {
-			if (cur_pid != event_list[i].pid) {
-				cur_pid = event_list[i].pid;
-				cmdline = get_cmdline_by_pid(cur_pid);
-				if (cmdline == NULL) {
-					ret = CMD_ERROR;
-					goto error;
+		if (lttng_opt_mi) {
+			ret = mi_list_agent_ust_pid_events(event_list, size,
+					&cur_pid, &pid_element_open);
+			if (ret) {
+				goto error;
+			}
+		} else {
+			for (i = 0; i < size; i++) {
+				if (cur_pid != event_list[i].pid) {
+					cur_pid = event_list[i].pid;
+					cmdline = get_cmdline_by_pid(cur_pid);
+					if (cmdline == NULL) {
+						ret = CMD_ERROR;
+						goto error;
+					}
+					MSG("\nPID: %d - Name: %s", cur_pid,
+							cmdline);
+					free(cmdline);
 				}
-				MSG("\nPID: %d - Name: %s", cur_pid, cmdline);
-				free(cmdline);
+				print_events(&event_list[i]);
 			}
-			print_events(&event_list[i]);
+		}
+		free(event_list);
+		event_list = NULL;
+	}
+
+	if (lttng_opt_mi) {
+		ret = mi_list_agent_ust_events_close();
+	} else {
+		if (nb_events == 0) {
+			MSG("None");
 		}
 
 		MSG("");
@@ -613,64 +692,51 @@ end:
 	return ret;
 }
 
+/*
+ * State of the machine interface of the UST event fields listing, kept across
+ * the pages of fields.
+ */
+struct mi_event_fields_state {
+	pid_t cur_pid;
+	int pid_element_open;
+	int event_element_open;
+	struct lttng_event cur_event;
+};
+
 /*
  * Machine interface
- * List all ust event with their fields
+ * Print a page of ust event fields in the open pids element
  */
-static int mi_list_ust_event_fields(struct lttng_event_field *fields, int count,
-		struct lttng_domain *domain)
+static int mi_list_ust_pid_event_fields(struct lttng_event_field *fields,
+		int count, struct mi_event_fields_state *state)
 {
-	int ret, i;
-	pid_t cur_pid = 0;
+	int ret = 0, i;
 	char *cmdline = NULL;
-	int pid_element_open = 0;
-	int event_element_open = 0;
-	struct lttng_event cur_event;
-
-	memset(&cur_event, 0, sizeof(cur_event));
-
-	/* Open domains element */
-	ret = mi_lttng_domains_open(writer);
-	if (ret) {
-		goto end;
-	}
-
-	/* Write domain */
-	ret = mi_lttng_domain(writer, domain, 1);
-	if (ret) {
-		goto end;
-	}
-
-	/* Open pids element */
-	ret = mi_lttng_pids_open(writer);
-	if (ret) {
-		goto end;
-	}
 
 	for (i = 0; i < count; i++) {
-		if (cur_pid != fields[i].event.pid) {
-			if (pid_element_open) {
-				if (event_element_open) {
+		if (state->cur_pid != fields[i].event.pid) {
+			if (state->pid_element_open) {
+				if (state->event_element_open) {
 					/* Close the previous field element and event. */
 					ret = mi_lttng_close_multi_element(writer, 2);
 					if (ret) {
 						goto end;
 					}
-					event_element_open = 0;
+					state->event_element_open = 0;
 				}
 				/* Close the previous events, pid element */
 				ret = mi_lttng_close_multi_element(writer, 2);
 				if (ret) {
 					goto end;
 				}
-				pid_element_open = 0;
+				state->pid_element_open = 0;
 			}
 
-			cur_pid = fields[i].event.pid;
-			cmdline = get_cmdline_by_pid(cur_pid);
-			if (!pid_element_open) {
+			state->cur_pid = fields[i].event.pid;
+			cmdline = get_cmdline_by_pid(state->cur_pid);
+			if (!state->pid_element_open) {
 				/* Open and write a pid element */
-				ret = mi_lttng_pid(writer, cur_pid, cmdline, 1);
+				ret = mi_lttng_pid(writer, state->cur_pid, cmdline, 1);
 				if (ret) {
 					goto error;
 				}
@@ -680,29 +746,29 @@ static int mi_list_ust_event_fields(struct lttng_event_field *fields, int count,
 				if (ret) {
 					goto error;
 				}
-				pid_element_open = 1;
+				state->pid_element_open = 1;
 			}
 			free(cmdline);
 			/* Wipe current event since we are about to print a new PID. */
-			memset(&cur_event, 0, sizeof(cur_event));
+			memset(&state->cur_event, 0, sizeof(state->cur_event));
 		}
 
-		if (strcmp(cur_event.name, fields[i].event.name) != 0) {
-			if (event_element_open) {
+		if (strcmp(state->cur_event.name, fields[i].event.name) != 0) {
+			if (state->event_element_open) {
 				/* Close the previous fields element and the previous event */
 				ret = mi_lttng_close_multi_element(writer, 2);
 				if (ret) {
 					goto end;
 				}
-				event_element_open = 0;
+				state->event_element_open = 0;
 			}
 
-			memcpy(&cur_event, &fields[i].event,
-					sizeof(cur_event));
+			memcpy(&state->cur_event, &fields[i].event,
+					sizeof(state->cur_event));
 
-			if (!event_element_open) {
+			if (!state->event_element_open) {
 				/* Open and write the event */
-				ret = mi_lttng_event(writer, &cur_event, 1,
+				ret = mi_lttng_event(writer, &state->cur_event, 1,
 						handle->domain.type);
 				if (ret) {
 					goto end;
@@ -713,7 +779,7 @@ static int mi_list_ust_event_fields(struct lttng_event_field *fields, int count,
 				if (ret) {
 					goto end;
 				}
-				event_element_open = 1;
+				state->event_element_open = 1;
 			}
 		}
 
@@ -723,9 +789,6 @@ static int mi_list_ust_event_fields(struct lttng_event_field *fields, int count,
 			goto end;
 		}
 	}
-
-	/* Close pid, domain, domains */
-	ret = mi_lttng_close_multi_element(writer, 3);
 end:
 	return ret;
 error:
@@ -733,22 +796,52 @@ error:
 	return ret;
 }
 
+/*
+ * Machine interface
+ * Close the elements of the ust event fields listing
+ */
+static int mi_list_ust_event_fields_close(struct mi_event_fields_state *state)
+{
+	int ret = 0;
+
+	if (state->event_element_open) {
+		/* Close fields, event */
+		ret = mi_lttng_close_multi_element(writer, 2);
+		if (ret) {
+			goto end;
+		}
+	}
+	if (state->pid_element_open) {
+		/* Close events, pid */
+		ret = mi_lttng_close_multi_element(writer, 2);
+		if (ret) {
+			goto end;
+		}
+	}
+
+	/* Close pids, domain, domains */
+	ret = mi_lttng_close_multi_element(writer, 3);
+end:
+	return ret;
+}
+
 /*
  * Ask session daemon for all user space tracepoint fields available.
  */
 static int list_ust_event_fields(void)
 {
-	int i, size, ret = CMD_SUCCESS;
+	int i, size, nb_fields = 0, ret = CMD_SUCCESS;
 	struct lttng_domain domain;
 	struct lttng_handle *handle;
-	struct lttng_event_field *event_field_list;
-	pid_t cur_pid = 0;
+	struct lttng_event_field *event_field_list = NULL;
+	pid_t cur_pid = 0, pid_cursor = 0;
 	char *cmdline = NULL;
-
+	struct mi_event_fields_state mi_state;
 	struct lttng_event cur_event;
 
 	memset(&domain, 0, sizeof(domain));
 	memset(&cur_event, 0, sizeof(cur_event));
+	memset(&mi_state, 0, sizeof(mi_state));
 
 	DBG("Getting UST tracing event fields");
 
@@ -760,16 +853,9 @@ static int list_ust_event_fields(void)
 		goto end;
 	}
 
-	size = lttng_list_tracepoint_fields(handle, &event_field_list);
-	if (size < 0) {
-		ERR("Unable to list UST event fields: %s", lttng_strerror(size));
-		ret = CMD_ERROR;
-		goto end;
-	}
-
 	if (lttng_opt_mi) {
 		/* Mi print */
-		ret = mi_list_ust_event_fields(event_field_list, size, &domain);
+		ret = mi_list_agent_ust_events_open(&domain);
 		if (ret) {
 			ret = CMD_ERROR;
 			goto error;
@@ -777,30 +863,68 @@ static int list_ust_event_fields(void)
 	} else {
 		/* Pretty print */
 		MSG("UST events:\n-------------");
+	}
 
+	/* Print each page as soon as it is received. */
+	for (;;) {
+		size = lttng_list_tracepoint_fields_page(handle, &pid_cursor,
+				UST_EVENTS_PAGE_LEN, &event_field_list);
+		if (size < 0) {
+			ERR("Unable to list UST event fields: %s",
+					lttng_strerror(size));
+			ret = CMD_ERROR;
+			goto error;
+		}
 		if (size == 0) {
-			MSG("None");
+			break;
 		}
+		nb_fields += size;
 
-		for (i = 0; i < size; i++) {
-			if (cur_pid != event_field_list[i].event.pid) {
-				cur_pid = event_field_list[i].event.pid;
-				cmdline = get_cmdline_by_pid(cur_pid);
-				if (cmdline == NULL) {
-					ret = CMD_ERROR;
-					goto error;
-				}
-				MSG("\nPID: %d - Name: %s", cur_pid, cmdline);
-				free(cmdline);
-				/* Wipe current event since we are about to print a new PID. */
-				memset(&cur_event, 0, sizeof(cur_event));
+		if (lttng_opt_mi) {
+			ret = mi_list_ust_pid_event_fields(event_field_list,
+					size, &mi_state);
+			if (ret) {
+				ret = CMD_ERROR;
+				goto error;
 			}
-			if (strcmp(cur_event.name, event_field_list[i].event.name) != 0) {
-				print_events(&event_field_list[i].event);
-				memcpy(&cur_event, &event_field_list[i].event,
-						sizeof(cur_event));
+		} else {
+			for (i = 0; i < size; i++) {
+				if (cur_pid != event_field_list[i].event.pid) {
+					cur_pid = event_field_list[i].event.pid;
+					cmdline = get_cmdline_by_pid(cur_pid);
+					if (cmdline == NULL) {
+						ret = CMD_ERROR;
+						goto error;
+					}
+					MSG("\nPID: %d - Name: %s", cur_pid,
+							cmdline);
+					free(cmdline);
+					/* Wipe current event since we are about to print a new PID. */
+					memset(&cur_event, 0, sizeof(cur_event));
+				}
+				if (strcmp(cur_event.name,
+						event_field_list[i].event.name) != 0) {
+					print_events(&event_field_list[i].event);
+					memcpy(&cur_event,
+							&event_field_list[i].event,
+							sizeof(cur_event));
+				}
+				print_event_field(&event_field_list[i]);
 			}
-			print_event_field(&event_field_list[i]);
+		}
+		free(event_field_list);
+		event_field_list = NULL;
+	}
+
+	if (lttng_opt_mi) {
+		ret = mi_list_ust_event_fields_close(&mi_state);
+		if (ret) {
+			ret = CMD_ERROR;
+			goto error;
+		}
+	} else {
+		if (nb_fields == 0) {
+			MSG("None");
 		}
 
 		MSG("");
@@ -1166,6 +1290,70 @@ error:
 	return ret;
 }
 
+/*
+ * Pretty print the consumption statistics of the streams of a channel. Nothing
+ * is printed if the channel has no stream yet or if the statistics are not
+ * available.
+ */
+static void print_stream_stats(const char *channel_name)
+{
+	int count, i;
+	struct lttng_stream_stats *stats = NULL;
+
+	count = lttng_list_stream_stats(handle, channel_name, &stats);
+	if (count <= 0) {
+		goto end;
+	}
+
+	MSG("\n%sStreams:", indent4);
+	for (i = 0; i < count; i++) {
+		struct lttng_stream_stats *s = &stats[i];
+		uint64_t wakeup_avg = s->subbufs_consumed ?
+				s->wakeup_delay_total / s->subbufs_consumed : 0;
+		char hist[LTTNG_STREAM_STATS_LATENCY_BUCKETS * 32] = "";
+		size_t hist_len = 0;
+		unsigned int b;
+
+		MSG("%scpu %d: consumed: %" PRIu64 " bytes in %" PRIu64
+				" sub-buffers, lag: %" PRIu64 " bytes",
+				indent6, s->cpu, s->bytes_consumed,
+				s->subbufs_consumed, s->lag_bytes);
+		MSG("%swakeup delay (µs): average %" PRIu64 ", maximum %" PRIu64,
+				indent8, wakeup_avg / 1000,
+				s->wakeup_delay_max / 1000);
+
+		/* Only the non-empty buckets are shown, as "< bound: count". */
+		for (b = 0; b < LTTNG_STREAM_STATS_LATENCY_BUCKETS; b++) {
+			int ret;
+
+			if (!s->write_latency_hist[b]) {
+				continue;
+			}
+			if (b == LTTNG_STREAM_STATS_LATENCY_BUCKETS - 1) {
+				ret = snprintf(hist + hist_len,
+						sizeof(hist) - hist_len,
+						"%s>= %u: %" PRIu64,
+						hist_len ? ", " : "", 1U << (b - 1),
+						s->write_latency_hist[b]);
+			} else {
+				ret = snprintf(hist + hist_len,
+						sizeof(hist) - hist_len,
+						"%s< %u: %" PRIu64,
+						hist_len ? ", " : "", 1U << b,
+						s->write_latency_hist[b]);
+			}
+			if (ret < 0 || ret >= sizeof(hist) - hist_len) {
+				break;
+			}
+			hist_len += ret;
+		}
+		MSG("%swrite latency (µs): %s", indent8,
+				hist_len ? hist : "none");
+	}
+end:
+	free(stats);
+}
+
 /*
  * Pretty print channel
  */
@@ -1174,6 +1362,8 @@ static void print_channel(struct lttng_channel *channel)
 	int ret;
 	uint64_t discarded_events, lost_packets, monitor_timer_interval;
 	int64_t blocking_timeout;
+	enum lttng_channel_compression compression;
+	int huge_pages;
 
 	ret = lttng_channel_get_discarded_event_count(channel,
 			&discarded_events);
@@ -1203,6 +1393,18 @@ static void print_channel(struct lttng_channel *channel)
 		return;
 	}
 
+	ret = lttng_channel_get_compression(channel, &compression);
+	if (ret) {
+		ERR("Failed to retrieve compression of channel");
+		return;
+	}
+
+	ret = lttng_channel_get_huge_pages(channel, &huge_pages);
+	if (ret) {
+		ERR("Failed to retrieve huge pages request of channel");
+		return;
+	}
+
 	MSG("- %s:%s\n", channel->name, enabled_string(channel->enabled));
 
 	MSG("%sAttributes:", indent4);
@@ -1225,6 +1427,18 @@ static void print_channel(struct lttng_channel *channel)
 			MSG("%soutput: mmap()", indent6);
 			break;
 	}
+	switch (compression) {
+		case LTTNG_CHANNEL_COMPRESSION_NONE:
+			break;
+		case LTTNG_CHANNEL_COMPRESSION_ZLIB:
+			MSG("%scompression: zlib", indent6);
+			break;
+	}
+	if (huge_pages) {
+		MSG("%shuge pages: requested", indent6);
+	}
+
+	print_stream_stats(channel->name);
 }
 
 /*
@@ -1369,6 +1583,44 @@ error_channels:
 	return ret;
 }
 
+/*
+ * Pretty print the memory used by the session daemon for the applications of
+ * the session. Nothing is printed if no application is traced or if the
+ * memory usage is not available.
+ */
+static void print_memory_usage(void)
+{
+	int count, i;
+	uint64_t total = 0;
+	struct lttng_memory_usage *usage = NULL;
+
+	count = lttng_list_memory_usage(handle, &usage);
+	if (count <= 0) {
+		goto end;
+	}
+
+	MSG("Session daemon memory:");
+	for (i = 0; i < count; i++) {
+		struct lttng_memory_usage *u = &usage[i];
+
+		if (u->pid < 0) {
+			MSG("%sUID %u registry:", indent4, u->uid);
+		} else {
+			MSG("%sPID %d (UID %u):", indent4, u->pid, u->uid);
+		}
+		MSG("%sregistry: %" PRIu64 " bytes, metadata: %" PRIu64
+				" bytes, objects: %" PRIu64 " bytes, filters: %"
+				PRIu64 " bytes", indent6, u->registry_bytes,
+				u->metadata_bytes, u->object_bytes,
+				u->filter_bytes);
+		total += u->registry_bytes + u->metadata_bytes +
+				u->object_bytes + u->filter_bytes;
+	}
+	MSG("%sTotal: %" PRIu64 " bytes\n", indent4, total);
+end:
+	free(usage);
+}
+
 /*
  * List tracker PID(s) of session and domain.
  */
@@ -1995,6 +2247,11 @@ int cmd_list(int argc, const char **argv)
 					goto end;
 				}
 
+				if (domains[i].type == LTTNG_DOMAIN_UST &&
+						!lttng_opt_mi) {
+					print_memory_usage();
+				}
+
 next_domain:
 				if (lttng_opt_mi) {
 					/* Close domain element */
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 only,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include <popt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../command.h"
+
+static char *opt_session_name;
+static char *opt_output_path;
+
+#ifdef LTTNG_EMBED_HELP
+static const char help_msg[] =
+#include <lttng-rotate.1.h>
+;
+#endif
+
+enum {
+	OPT_HELP = 1,
+	OPT_LIST_OPTIONS,
+};
+
+static struct poptOption long_options[] = {
+	/* longName, shortName, argInfo, argPtr, value, descrip, argDesc */
+	{"help",         'h', POPT_ARG_NONE, 0, OPT_HELP, 0, 0},
+	{"session",      's', POPT_ARG_STRING, &opt_session_name, 0, 0, 0},
+	{"output",       'o', POPT_ARG_STRING, &opt_output_path, 0, 0, 0},
+	{"list-options", 0, POPT_ARG_NONE, NULL, OPT_LIST_OPTIONS, NULL, NULL},
+	{0, 0, 0, 0, 0, 0, 0}
+};
+
+static int rotate_session(void)
+{
+	int ret;
+	char *session_name;
+	char *chunk_path = NULL;
+
+	if (opt_session_name == NULL) {
+		session_name = get_session_name();
+		if (session_name == NULL) {
+			ret = CMD_ERROR;
+			goto error;
+		}
+	} else {
+		session_name = opt_session_name;
+	}
+
+	DBG("Rotating session %s", session_name);
+
+	ret = lttng_rotate_session(session_name, opt_output_path, &chunk_path);
+	if (ret < 0) {
+		ERR("%s", lttng_strerror(ret));
+		ret = CMD_ERROR;
+		goto free_name;
+	}
+
+	MSG("Session %s rotated, new trace chunk written in %s", session_name,
+			chunk_path);
+	ret = CMD_SUCCESS;
+
+free_name:
+	free(chunk_path);
+	if (opt_session_name == NULL) {
+		free(session_name);
+	}
+error:
+	return ret;
+}
+
+/*
+ *  cmd_rotate
+ *
+ *  The 'rotate <options>' first level command
+ */
+int cmd_rotate(int argc, const char **argv)
+{
+	int opt, ret = CMD_SUCCESS;
+	static poptContext pc;
+
+	pc = poptGetContext(NULL, argc, argv, long_options, 0);
+	poptReadDefaultConfig(pc, 0);
+
+	if (lttng_opt_mi) {
+		WARN("mi does not apply to rotate command");
+	}
+
+	while ((opt = poptGetNextOpt(pc)) != -1) {
+		switch (opt) {
+		case OPT_HELP:
+			SHOW_HELP();
+			goto end;
+		case OPT_LIST_OPTIONS:
+			list_cmd_options(stdout, long_options);
+			goto end;
+		default:
+			ret = CMD_UNDEFINED;
+			goto end;
+		}
+	}
+
+	ret = rotate_session();
+
+end:
+	poptFreeContext(pc);
+	return ret;
+}
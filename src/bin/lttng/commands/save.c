@@ -30,6 +30,7 @@
 
 static char *opt_output_path;
 static bool opt_force;
+static int opt_binary;
 static bool opt_save_all;
 static struct mi_writer *writer;
 
@@ -52,6 +53,7 @@ static struct poptOption save_opts[] = {
 	{"all",         'a', POPT_ARG_NONE, NULL, OPT_ALL, NULL, NULL},
 	{"output-path", 'o', POPT_ARG_STRING, &opt_output_path, 0, NULL, NULL},
 	{"force",       'f', POPT_ARG_NONE, NULL, OPT_FORCE, NULL, NULL},
+	{"binary",        0, POPT_ARG_NONE, &opt_binary, 0, NULL, NULL},
 	{"list-options",  0, POPT_ARG_NONE, NULL, OPT_LIST_OPTIONS, NULL, NULL},
 	{0, 0, 0, 0, 0, 0, 0}
 };
@@ -180,6 +182,11 @@ int cmd_save(int argc, const char **argv)
 		goto end_destroy;
 	}
 
+	if (lttng_save_session_attr_set_binary(attr, opt_binary)) {
+		ret = CMD_ERROR;
+		goto end_destroy;
+	}
+
 	if (lttng_save_session_attr_set_output_url(attr, opt_output_path)) {
 		ret = CMD_ERROR;
 		goto end_destroy;
@@ -39,6 +39,7 @@ static const char *opt_data_url;
 static const char *opt_ctrl_url;
 static const char *current_session_name;
 static uint64_t opt_max_size;
+static int opt_incremental;
 
 /* Stub for the cmd struct actions. */
 static int cmd_add_output(int argc, const char **argv);
@@ -71,6 +72,7 @@ static struct poptOption snapshot_opts[] = {
 	{"data-url",     'D', POPT_ARG_STRING, &opt_data_url, 0, 0, 0},
 	{"name",         'n', POPT_ARG_STRING, &opt_output_name, 0, 0, 0},
 	{"max-size",     'm', POPT_ARG_STRING, 0, OPT_MAX_SIZE, 0, 0},
+	{"incremental",    0, POPT_ARG_NONE, &opt_incremental, 0, 0, 0},
 	{"list-options",   0, POPT_ARG_NONE, NULL, OPT_LIST_OPTIONS, NULL, NULL},
 	{"list-commands",  0, POPT_ARG_NONE, NULL, OPT_LIST_COMMANDS},
 	{0, 0, 0, 0, 0, 0, 0}
@@ -393,7 +395,12 @@ static int record(const char *url)
 		goto error;
 	}
 
-	ret = lttng_snapshot_record(current_session_name, output, 0);
+	if (opt_incremental) {
+		ret = lttng_snapshot_record_incremental(current_session_name,
+				output, 0);
+	} else {
+		ret = lttng_snapshot_record(current_session_name, output, 0);
+	}
 	if (ret < 0) {
 		if (ret == -LTTNG_ERR_MAX_SIZE_INVALID) {
 			ERR("Invalid snapshot size. Cannot fit at least one packet per stream.");
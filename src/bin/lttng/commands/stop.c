@@ -121,6 +121,8 @@ static int stop_tracing(void)
 	}
 
 	if (!opt_no_wait) {
+		useconds_t wait_time = DEFAULT_DATA_AVAILABILITY_MIN_WAIT_TIME;
+
 		_MSG("Waiting for data availability");
 		fflush(stdout);
 		do {
@@ -135,7 +137,9 @@ static int stop_tracing(void)
 			 * returned value indicates availability.
 			 */
 			if (ret) {
-				usleep(DEFAULT_DATA_AVAILABILITY_WAIT_TIME);
+				usleep(wait_time);
+				wait_time = min_t(useconds_t, wait_time * 2,
+						DEFAULT_DATA_AVAILABILITY_WAIT_TIME);
 				_MSG(".");
 				fflush(stdout);
 			}
@@ -64,17 +64,53 @@ static struct poptOption long_options[] = {
 	{ 0, 0, 0, 0, 0, 0, 0, },
 };
 
+/*
+ * Parse a PID or a range of PIDs, "PID" or "START-END".
+ *
+ * Return 0 on success or else -1.
+ */
+static
+int parse_pid_range(const char *str, struct lttng_pid_range *range)
+{
+	unsigned long start, end;
+	char *endptr;
+
+	errno = 0;
+	start = strtoul(str, &endptr, 10);
+	if (errno || endptr == str || start > INT_MAX) {
+		goto error;
+	}
+	end = start;
+	if (*endptr == '-') {
+		const char *end_str = endptr + 1;
+
+		end = strtoul(end_str, &endptr, 10);
+		if (errno || endptr == end_str || end > INT_MAX) {
+			goto error;
+		}
+	}
+	if (*endptr != '\0' || start > end) {
+		goto error;
+	}
+	range->start = (int32_t) start;
+	range->end = (int32_t) end;
+	return 0;
+
+error:
+	ERR("Error parsing PID %s", str);
+	return -1;
+}
+
 static
 int parse_pid_string(const char *_pid_string,
-		int all, int **_pid_list, int *nr_pids)
+		int all, struct lttng_pid_range **_ranges, int *nr_ranges)
 {
 	const char *one_pid_str;
 	char *iter;
 	int retval = CMD_SUCCESS;
 	int count = 0;
-	int *pid_list = NULL;
+	struct lttng_pid_range *ranges = NULL;
 	char *pid_string = NULL;
-	char *endptr;
 
 	if (all && _pid_string) {
 		ERR("An empty PID string is expected with --all");
@@ -87,42 +123,34 @@ int parse_pid_string(const char *_pid_string,
 		goto error;
 	}
 	if (all) {
-		pid_list = zmalloc(sizeof(*pid_list));
-		if (!pid_list) {
+		ranges = zmalloc(sizeof(*ranges));
+		if (!ranges) {
 			ERR("Out of memory");
 			retval = CMD_ERROR;
 			goto error;
 		}
 		/* Empty PID string means all PIDs */
 		count = 1;
-		pid_list[0] = -1;
+		ranges[0].start = ranges[0].end = -1;
 		goto assign;
 	}
 
+	/* At most one range per delimiter plus one. */
+	for (one_pid_str = _pid_string; *one_pid_str; one_pid_str++) {
+		count += *one_pid_str == ',';
+	}
+	ranges = zmalloc((count + 1) * sizeof(*ranges));
 	pid_string = strdup(_pid_string);
-	if (!pid_string) {
+	if (!ranges || !pid_string) {
 		ERR("Out of memory");
 		retval = CMD_ERROR;
 		goto error;
 	}
 
-	/* Count */
+	count = 0;
 	one_pid_str = strtok_r(pid_string, ",", &iter);
 	while (one_pid_str != NULL) {
-		unsigned long v;
-
-		errno = 0;
-		v = strtoul(one_pid_str, &endptr, 10);
-		if ((v == 0 && errno == EINVAL)
-				|| (v == ULONG_MAX && errno == ERANGE)
-				|| (*one_pid_str != '\0' && *endptr != '\0')){
-			ERR("Error parsing PID %s", one_pid_str);
-			retval = CMD_ERROR;
-			goto error;
-		}
-
-		if ((long) v > INT_MAX || (int) v < 0) {
-			ERR("Invalid PID value %ld", (long) v);
+		if (parse_pid_range(one_pid_str, &ranges[count])) {
 			retval = CMD_ERROR;
 			goto error;
 		}
@@ -132,47 +160,88 @@ int parse_pid_string(const char *_pid_string,
 		one_pid_str = strtok_r(NULL, ",", &iter);
 	}
 
+assign:
+	*nr_ranges = count;
+	*_ranges = ranges;
+	goto end;	/* SUCCESS */
+
+	/* ERROR */
+error:
+	free(ranges);
+end:
 	free(pid_string);
-	/* Identity of delimiter has been lost in first pass. */
-	pid_string = strdup(_pid_string);
-	if (!pid_string) {
-		ERR("Out of memory");
-		retval = CMD_ERROR;
-		goto error;
+	return retval;
+}
+
+static
+int write_mi_pid_target(struct mi_writer *writer, int pid, int success)
+{
+	int ret;
+
+	ret = mi_lttng_pid_target(writer, pid, 1);
+	if (ret) {
+		goto end;
 	}
 
-	/* Allocate */
-	pid_list = zmalloc(count * sizeof(*pid_list));
-	if (!pid_list) {
-		ERR("Out of memory");
-		retval = CMD_ERROR;
-		goto error;
+	ret = mi_lttng_writer_write_element_bool(writer,
+			mi_lttng_element_success, success);
+	if (ret) {
+		goto end;
 	}
 
-	/* Reparse string and populate the pid list. */
-	count = 0;
-	one_pid_str = strtok_r(pid_string, ",", &iter);
-	while (one_pid_str != NULL) {
-		unsigned long v;
+	ret = mi_lttng_writer_close_element(writer);
+end:
+	return ret;
+}
 
-		v = strtoul(one_pid_str, NULL, 10);
-		pid_list[count++] = (int) v;
+/*
+ * Track or untrack all the ranges with a single command.
+ *
+ * Return 0 on success, -LTTNG_ERR_UND if the session daemon does not support
+ * the command or else a negative value.
+ */
+static
+int track_untrack_pid_ranges(enum cmd_type cmd_type, const char *cmd_str,
+		struct lttng_handle *handle, const char *session_name,
+		const char *pid_string, const struct lttng_pid_range *ranges,
+		int nr_ranges, struct mi_writer *writer)
+{
+	int ret, i, success = 1;
 
-		/* For next loop */
-		one_pid_str = strtok_r(NULL, ",", &iter);
+	DBG("%s PIDs %s", cmd_str, pid_string);
+	if (cmd_type == CMD_TRACK) {
+		ret = lttng_track_pid_ranges(handle, ranges, nr_ranges);
+	} else {
+		ret = lttng_untrack_pid_ranges(handle, ranges, nr_ranges);
+	}
+	switch (-ret) {
+	case 0:
+		MSG("PIDs %s %sed in session %s", pid_string, cmd_str,
+				session_name);
+		break;
+	case LTTNG_ERR_UND:
+		return ret;
+	case LTTNG_ERR_PID_NOT_TRACKED:
+		WARN("PIDs %s not tracked in session %s", pid_string,
+				session_name);
+		ret = 0;
+		break;
+	default:
+		ERR("%s", lttng_strerror(ret));
+		success = 0;
+		break;
 	}
 
-assign:
-	*nr_pids = count;
-	*_pid_list = pid_list;
-	goto end;	/* SUCCESS */
+	for (i = 0; writer && i < nr_ranges; i++) {
+		int64_t pid;
 
-	/* ERROR */
-error:
-	free(pid_list);
-end:
-	free(pid_string);
-	return retval;
+		for (pid = ranges[i].start; pid <= ranges[i].end; pid++) {
+			if (write_mi_pid_target(writer, (int) pid, success)) {
+				return -LTTNG_ERR_MI_IO_FAIL;
+			}
+		}
+	}
+	return ret;
 }
 
 static
@@ -182,8 +251,8 @@ enum cmd_error_code track_untrack_pid(enum cmd_type cmd_type, const char *cmd_st
 {
 	int ret, success = 1 , i;
 	enum cmd_error_code retval = CMD_SUCCESS;
-	int *pid_list = NULL;
-	int nr_pids;
+	struct lttng_pid_range *ranges = NULL;
+	int nr_ranges;
 	struct lttng_domain dom;
 	struct lttng_handle *handle = NULL;
 	int (*cmd_func)(struct lttng_handle *handle, int pid);
@@ -211,7 +280,7 @@ enum cmd_error_code track_untrack_pid(enum cmd_type cmd_type, const char *cmd_st
 		assert(0);
 	}
 
-	ret = parse_pid_string(pid_string, all, &pid_list, &nr_pids);
+	ret = parse_pid_string(pid_string, all, &ranges, &nr_ranges);
 	if (ret != CMD_SUCCESS) {
 		ERR("Error parsing PID string");
 		retval = CMD_ERROR;
@@ -233,58 +302,67 @@ enum cmd_error_code track_untrack_pid(enum cmd_type cmd_type, const char *cmd_st
 		}
 	}
 
-	for (i = 0; i < nr_pids; i++) {
-		DBG("%s PID %d", cmd_str, pid_list[i]);
-		ret = cmd_func(handle, pid_list[i]);
-		if (ret) {
-			switch (-ret) {
-			case LTTNG_ERR_PID_TRACKED:
-				WARN("PID %i already tracked in session %s",
-						pid_list[i], session_name);
-				success = 1;
-				retval = CMD_SUCCESS;
-				break;
-			case LTTNG_ERR_PID_NOT_TRACKED:
-				WARN("PID %i not tracked in session %s",
-						pid_list[i], session_name);
-				success = 1;
-				retval = CMD_SUCCESS;
-				break;
-			default:
-				ERR("%s", lttng_strerror(ret));
-				success = 0;
+	/*
+	 * Many PIDs are (un)tracked with a single command, falling back to a
+	 * command per PID with a session daemon which does not support it.
+	 */
+	if (!all && (nr_ranges > 1 || ranges[0].start != ranges[0].end)) {
+		ret = track_untrack_pid_ranges(cmd_type, cmd_str, handle,
+				session_name, pid_string, ranges, nr_ranges,
+				writer);
+		if (ret != -LTTNG_ERR_UND) {
+			if (ret) {
 				retval = CMD_ERROR;
-				break;
 			}
-		} else {
-			MSG("PID %i %sed in session %s",
-					pid_list[i], cmd_str, session_name);
-			success = 1;
+			goto close_targets;
 		}
+	}
 
-		/* Mi */
-		if (writer) {
-			ret = mi_lttng_pid_target(writer, pid_list[i], 1);
-			if (ret) {
-				retval = CMD_ERROR;
-				goto end;
-			}
+	for (i = 0; i < nr_ranges; i++) {
+		int64_t pid;
 
-			ret = mi_lttng_writer_write_element_bool(writer,
-					mi_lttng_element_success, success);
+		for (pid = ranges[i].start; pid <= ranges[i].end; pid++) {
+			DBG("%s PID %d", cmd_str, (int) pid);
+			ret = cmd_func(handle, (int) pid);
 			if (ret) {
-				retval = CMD_ERROR;
-				goto end;
+				switch (-ret) {
+				case LTTNG_ERR_PID_TRACKED:
+					WARN("PID %i already tracked in session %s",
+							(int) pid, session_name);
+					success = 1;
+					retval = CMD_SUCCESS;
+					break;
+				case LTTNG_ERR_PID_NOT_TRACKED:
+					WARN("PID %i not tracked in session %s",
+							(int) pid, session_name);
+					success = 1;
+					retval = CMD_SUCCESS;
+					break;
+				default:
+					ERR("%s", lttng_strerror(ret));
+					success = 0;
+					retval = CMD_ERROR;
+					break;
+				}
+			} else {
+				MSG("PID %i %sed in session %s",
+						(int) pid, cmd_str, session_name);
+				success = 1;
 			}
 
-			ret = mi_lttng_writer_close_element(writer);
-			if (ret) {
-				retval = CMD_ERROR;
-				goto end;
+			/* Mi */
+			if (writer) {
+				ret = write_mi_pid_target(writer, (int) pid,
+						success);
+				if (ret) {
+					retval = CMD_ERROR;
+					goto end;
+				}
 			}
 		}
 	}
 
+close_targets:
 	if (writer) {
 		/* Close targets element */
 		ret = mi_lttng_writer_close_element(writer);
@@ -298,7 +376,7 @@ end:
 	if (handle) {
 		lttng_destroy_handle(handle);
 	}
-	free(pid_list);
+	free(ranges);
 	return retval;
 }
 
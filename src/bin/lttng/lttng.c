@@ -85,6 +85,7 @@ static struct cmd_struct commands[] =  {
 	{ "load", cmd_load},
 	{ "metadata", cmd_metadata},
 	{ "regenerate", cmd_regenerate},
+	{ "rotate", cmd_rotate},
 	{ "save", cmd_save},
 	{ "set-session", cmd_set_session},
 	{ "snapshot", cmd_snapshot},
@@ -115,6 +116,8 @@ static int mi_output_type(const char *output_type)
 
 	if (!strncasecmp("xml", output_type, 3)) {
 		ret = LTTNG_MI_XML;
+	} else if (!strncasecmp("json", output_type, 4)) {
+		ret = LTTNG_MI_JSON;
 	} else {
 		/* Invalid output format */
 		ERR("MI output format not supported");
@@ -278,6 +281,7 @@ static void show_basic_help(void)
 	puts("  status            " CONFIG_CMD_DESCR_STATUS);
 	puts("");
 	puts("Control:");
+	puts("  rotate            " CONFIG_CMD_DESCR_ROTATE);
 	puts("  snapshot          " CONFIG_CMD_DESCR_SNAPSHOT);
 	puts("  start             " CONFIG_CMD_DESCR_START);
 	puts("  stop              " CONFIG_CMD_DESCR_STOP);
@@ -58,11 +58,35 @@ void lttng_condition_buffer_usage_destroy(struct lttng_condition *condition)
 	usage = container_of(condition, struct lttng_condition_buffer_usage,
 			parent);
 
-	free(usage->session_name);
-	free(usage->channel_name);
+	if (!usage->names_borrowed) {
+		free(usage->session_name);
+		free(usage->channel_name);
+	}
 	free(usage);
 }
 
+/*
+ * Copy the names borrowed from the buffer the condition was created from so
+ * that they can be replaced.
+ */
+static
+int own_names(struct lttng_condition_buffer_usage *usage)
+{
+	char *session_name, *channel_name;
+
+	session_name = strdup(usage->session_name);
+	channel_name = strdup(usage->channel_name);
+	if (!session_name || !channel_name) {
+		free(session_name);
+		free(channel_name);
+		return -1;
+	}
+	usage->session_name = session_name;
+	usage->channel_name = channel_name;
+	usage->names_borrowed = false;
+	return 0;
+}
+
 static
 bool lttng_condition_buffer_usage_validate(
 		const struct lttng_condition *condition)
@@ -125,6 +149,8 @@ ssize_t lttng_condition_buffer_usage_serialize(
 			.session_name_len = session_name_len,
 			.channel_name_len = channel_name_len,
 			.domain_type = (int8_t) usage->domain.type,
+			.min_notification_interval =
+				usage->min_notification_interval_us,
 		};
 
 		if (usage->threshold_bytes.set) {
@@ -141,6 +167,18 @@ ssize_t lttng_condition_buffer_usage_serialize(
 			usage_comm.threshold = val;
 		}
 
+		if (usage->hysteresis_ratio.set) {
+			uint64_t val = double_to_fixed(
+					usage->hysteresis_ratio.value);
+
+			if (val > UINT32_MAX) {
+				/* overflow. */
+				ret = -1;
+				goto end;
+			}
+			usage_comm.hysteresis = val;
+		}
+
 		memcpy(buf, &usage_comm, sizeof(usage_comm));
 		buf += sizeof(usage_comm);
 		memcpy(buf, usage->session_name, session_name_len);
@@ -218,6 +256,21 @@ bool lttng_condition_buffer_usage_is_equal(const struct lttng_condition *_a,
 			goto end;
 		}
 	}
+
+	if (a->hysteresis_ratio.set != b->hysteresis_ratio.set) {
+		goto end;
+	}
+
+	if (a->hysteresis_ratio.set &&
+			fabs(a->hysteresis_ratio.value -
+				b->hysteresis_ratio.value) > DBL_EPSILON) {
+		goto end;
+	}
+
+	if (a->min_notification_interval_us !=
+			b->min_notification_interval_us) {
+		goto end;
+	}
 	is_equal = true;
 end:
 	return is_equal;
@@ -256,7 +309,7 @@ struct lttng_condition *lttng_condition_buffer_usage_high_create(void)
 
 static
 ssize_t init_condition_from_buffer(struct lttng_condition *condition,
-		const struct lttng_buffer_view *src_view)
+		const struct lttng_buffer_view *src_view, bool borrow)
 {
 	ssize_t ret, condition_size;
 	enum lttng_condition_status status;
@@ -313,6 +366,25 @@ ssize_t init_condition_from_buffer(struct lttng_condition *condition,
 		goto end;
 	}
 
+	if (condition_comm->hysteresis) {
+		status = lttng_condition_buffer_usage_set_hysteresis_ratio(
+				condition,
+				fixed_to_double(condition_comm->hysteresis));
+		if (status != LTTNG_CONDITION_STATUS_OK) {
+			ERR("Failed to initialize buffer usage condition hysteresis");
+			ret = -1;
+			goto end;
+		}
+	}
+
+	status = lttng_condition_buffer_usage_set_min_notification_interval(
+			condition, condition_comm->min_notification_interval);
+	if (status != LTTNG_CONDITION_STATUS_OK) {
+		ERR("Failed to initialize buffer usage condition notification interval");
+		ret = -1;
+		goto end;
+	}
+
 	domain_type = (enum lttng_domain_type) condition_comm->domain_type;
 	status = lttng_condition_buffer_usage_set_domain_type(condition,
 			domain_type);
@@ -336,20 +408,35 @@ ssize_t init_condition_from_buffer(struct lttng_condition *condition,
 		goto end;
 	}
 
-	status = lttng_condition_buffer_usage_set_session_name(condition,
-			session_name);
-	if (status != LTTNG_CONDITION_STATUS_OK) {
-		ERR("Failed to set buffer usage session name");
-		ret = -1;
-		goto end;
-	}
+	if (borrow) {
+		struct lttng_condition_buffer_usage *usage = container_of(condition,
+				struct lttng_condition_buffer_usage, parent);
 
-	status = lttng_condition_buffer_usage_set_channel_name(condition,
-			channel_name);
-	if (status != LTTNG_CONDITION_STATUS_OK) {
-		ERR("Failed to set buffer usage channel name");
-		ret = -1;
-		goto end;
+		/* The names are used in place, as the setters would check. */
+		if (!*session_name || !*channel_name) {
+			ERR("Empty name encountered in condition buffer");
+			ret = -1;
+			goto end;
+		}
+		usage->session_name = (char *) session_name;
+		usage->channel_name = (char *) channel_name;
+		usage->names_borrowed = true;
+	} else {
+		status = lttng_condition_buffer_usage_set_session_name(condition,
+				session_name);
+		if (status != LTTNG_CONDITION_STATUS_OK) {
+			ERR("Failed to set buffer usage session name");
+			ret = -1;
+			goto end;
+		}
+
+		status = lttng_condition_buffer_usage_set_channel_name(condition,
+				channel_name);
+		if (status != LTTNG_CONDITION_STATUS_OK) {
+			ERR("Failed to set buffer usage channel name");
+			ret = -1;
+			goto end;
+		}
 	}
 
 	if (!lttng_condition_validate(condition)) {
@@ -368,7 +455,7 @@ end:
 LTTNG_HIDDEN
 ssize_t lttng_condition_buffer_usage_low_create_from_buffer(
 		const struct lttng_buffer_view *view,
-		struct lttng_condition **_condition)
+		struct lttng_condition **_condition, bool borrow)
 {
 	ssize_t ret;
 	struct lttng_condition *condition =
@@ -379,7 +466,7 @@ ssize_t lttng_condition_buffer_usage_low_create_from_buffer(
 		goto error;
 	}
 
-	ret = init_condition_from_buffer(condition, view);
+	ret = init_condition_from_buffer(condition, view, borrow);
 	if (ret < 0) {
 		goto error;
 	}
@@ -394,7 +481,7 @@ error:
 LTTNG_HIDDEN
 ssize_t lttng_condition_buffer_usage_high_create_from_buffer(
 		const struct lttng_buffer_view *view,
-		struct lttng_condition **_condition)
+		struct lttng_condition **_condition, bool borrow)
 {
 	ssize_t ret;
 	struct lttng_condition *condition =
@@ -405,7 +492,7 @@ ssize_t lttng_condition_buffer_usage_high_create_from_buffer(
 		goto error;
 	}
 
-	ret = init_condition_from_buffer(condition, view);
+	ret = init_condition_from_buffer(condition, view, borrow);
 	if (ret < 0) {
 		goto error;
 	}
@@ -632,6 +719,12 @@ lttng_condition_buffer_usage_set_session_name(
 		goto end;
 	}
 
+	if (usage->names_borrowed && own_names(usage)) {
+		free(session_name_copy);
+		status = LTTNG_CONDITION_STATUS_ERROR;
+		goto end;
+	}
+
 	if (usage->session_name) {
 		free(usage->session_name);
 	}
@@ -686,6 +779,12 @@ lttng_condition_buffer_usage_set_channel_name(
 		goto end;
 	}
 
+	if (usage->names_borrowed && own_names(usage)) {
+		free(channel_name_copy);
+		status = LTTNG_CONDITION_STATUS_ERROR;
+		goto end;
+	}
+
 	if (usage->channel_name) {
 		free(usage->channel_name);
 	}
@@ -739,6 +838,93 @@ end:
 	return status;
 }
 
+enum lttng_condition_status
+lttng_condition_buffer_usage_get_hysteresis_ratio(
+		const struct lttng_condition *condition,
+		double *hysteresis_ratio)
+{
+	struct lttng_condition_buffer_usage *usage;
+	enum lttng_condition_status status = LTTNG_CONDITION_STATUS_OK;
+
+	if (!condition || !IS_USAGE_CONDITION(condition) ||
+			!hysteresis_ratio) {
+		status = LTTNG_CONDITION_STATUS_INVALID;
+		goto end;
+	}
+
+	usage = container_of(condition, struct lttng_condition_buffer_usage,
+			parent);
+	if (!usage->hysteresis_ratio.set) {
+		status = LTTNG_CONDITION_STATUS_UNSET;
+		goto end;
+	}
+	*hysteresis_ratio = usage->hysteresis_ratio.value;
+end:
+	return status;
+}
+
+/* hysteresis_ratio expressed as [0.0, 1.0]. */
+enum lttng_condition_status
+lttng_condition_buffer_usage_set_hysteresis_ratio(
+		struct lttng_condition *condition, double hysteresis_ratio)
+{
+	struct lttng_condition_buffer_usage *usage;
+	enum lttng_condition_status status = LTTNG_CONDITION_STATUS_OK;
+
+	if (!condition || !IS_USAGE_CONDITION(condition) ||
+			hysteresis_ratio < 0.0 ||
+			hysteresis_ratio > 1.0) {
+		status = LTTNG_CONDITION_STATUS_INVALID;
+		goto end;
+	}
+
+	usage = container_of(condition, struct lttng_condition_buffer_usage,
+			parent);
+	usage->hysteresis_ratio.set = true;
+	usage->hysteresis_ratio.value = hysteresis_ratio;
+end:
+	return status;
+}
+
+enum lttng_condition_status
+lttng_condition_buffer_usage_get_min_notification_interval(
+		const struct lttng_condition *condition,
+		uint64_t *interval_us)
+{
+	struct lttng_condition_buffer_usage *usage;
+	enum lttng_condition_status status = LTTNG_CONDITION_STATUS_OK;
+
+	if (!condition || !IS_USAGE_CONDITION(condition) || !interval_us) {
+		status = LTTNG_CONDITION_STATUS_INVALID;
+		goto end;
+	}
+
+	usage = container_of(condition, struct lttng_condition_buffer_usage,
+			parent);
+	*interval_us = usage->min_notification_interval_us;
+end:
+	return status;
+}
+
+enum lttng_condition_status
+lttng_condition_buffer_usage_set_min_notification_interval(
+		struct lttng_condition *condition, uint64_t interval_us)
+{
+	struct lttng_condition_buffer_usage *usage;
+	enum lttng_condition_status status = LTTNG_CONDITION_STATUS_OK;
+
+	if (!condition || !IS_USAGE_CONDITION(condition)) {
+		status = LTTNG_CONDITION_STATUS_INVALID;
+		goto end;
+	}
+
+	usage = container_of(condition, struct lttng_condition_buffer_usage,
+			parent);
+	usage->min_notification_interval_us = interval_us;
+end:
+	return status;
+}
+
 static
 ssize_t lttng_evaluation_buffer_usage_serialize(
 		struct lttng_evaluation *evaluation, char *buf)
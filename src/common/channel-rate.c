@@ -0,0 +1,823 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License, version 2.1 only,
+ * as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <lttng/condition/condition-internal.h>
+#include <lttng/condition/channel-rate-internal.h>
+#include <common/macros.h>
+#include <common/error.h>
+#include <assert.h>
+#include <time.h>
+
+#define IS_RATE_CONDITION(condition) ( \
+	lttng_condition_get_type(condition) == LTTNG_CONDITION_TYPE_CHANNEL_RATE_LOW || \
+	lttng_condition_get_type(condition) == LTTNG_CONDITION_TYPE_CHANNEL_RATE_HIGH   \
+	)
+
+/* The evaluated rates are transmitted in thousandths of units. */
+#define RATE_FIXED_SCALE	1000.0
+
+static
+bool is_rate_evaluation(const struct lttng_evaluation *evaluation)
+{
+	enum lttng_condition_type type = lttng_evaluation_get_type(evaluation);
+
+	return type == LTTNG_CONDITION_TYPE_CHANNEL_RATE_LOW ||
+			type == LTTNG_CONDITION_TYPE_CHANNEL_RATE_HIGH;
+}
+
+static
+bool is_valid_metric(enum lttng_condition_channel_rate_metric metric)
+{
+	switch (metric) {
+	case LTTNG_CONDITION_CHANNEL_RATE_METRIC_CONSUMED_BYTES:
+	case LTTNG_CONDITION_CHANNEL_RATE_METRIC_DISCARDED_EVENTS:
+	case LTTNG_CONDITION_CHANNEL_RATE_METRIC_LOST_PACKETS:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static
+void lttng_condition_channel_rate_destroy(struct lttng_condition *condition)
+{
+	struct lttng_condition_channel_rate *rate;
+
+	rate = container_of(condition, struct lttng_condition_channel_rate,
+			parent);
+
+	if (!rate->names_borrowed) {
+		free(rate->session_name);
+		free(rate->channel_name);
+	}
+	free(rate);
+}
+
+/*
+ * Copy the names borrowed from the buffer the condition was created from so
+ * that they can be replaced.
+ */
+static
+int own_names(struct lttng_condition_channel_rate *rate)
+{
+	char *session_name, *channel_name;
+
+	session_name = strdup(rate->session_name);
+	channel_name = strdup(rate->channel_name);
+	if (!session_name || !channel_name) {
+		free(session_name);
+		free(channel_name);
+		return -1;
+	}
+	rate->session_name = session_name;
+	rate->channel_name = channel_name;
+	rate->names_borrowed = false;
+	return 0;
+}
+
+static
+bool lttng_condition_channel_rate_validate(
+		const struct lttng_condition *condition)
+{
+	bool valid = false;
+	struct lttng_condition_channel_rate *rate;
+
+	if (!condition) {
+		goto end;
+	}
+
+	rate = container_of(condition, struct lttng_condition_channel_rate,
+			parent);
+	if (!rate->session_name) {
+		ERR("Invalid channel rate condition: a target session name must be set.");
+		goto end;
+	}
+	if (!rate->channel_name) {
+		ERR("Invalid channel rate condition: a target channel name must be set.");
+		goto end;
+	}
+	if (!rate->domain.set) {
+		ERR("Invalid channel rate condition: a target domain must be set.");
+		goto end;
+	}
+	if (!is_valid_metric(rate->metric)) {
+		ERR("Invalid channel rate condition: a metric must be set.");
+		goto end;
+	}
+	if (!rate->threshold.set) {
+		ERR("Invalid channel rate condition: a threshold must be set.");
+		goto end;
+	}
+
+	valid = true;
+end:
+	return valid;
+}
+
+static
+ssize_t lttng_condition_channel_rate_serialize(
+		const struct lttng_condition *condition, char *buf)
+{
+	struct lttng_condition_channel_rate *rate;
+	ssize_t ret, size;
+	size_t session_name_len, channel_name_len;
+
+	if (!condition || !IS_RATE_CONDITION(condition)) {
+		ret = -1;
+		goto end;
+	}
+
+	DBG("Serializing channel rate condition");
+	rate = container_of(condition, struct lttng_condition_channel_rate,
+			parent);
+	size = sizeof(struct lttng_condition_channel_rate_comm);
+	session_name_len = strlen(rate->session_name) + 1;
+	channel_name_len = strlen(rate->channel_name) + 1;
+	if (session_name_len > LTTNG_NAME_MAX ||
+			channel_name_len > LTTNG_NAME_MAX) {
+		ret = -1;
+		goto end;
+	}
+	size += session_name_len + channel_name_len;
+	if (buf) {
+		struct lttng_condition_channel_rate_comm rate_comm = {
+			.metric = (int8_t) rate->metric,
+			.threshold = rate->threshold.value,
+			.session_name_len = session_name_len,
+			.channel_name_len = channel_name_len,
+			.domain_type = (int8_t) rate->domain.type,
+		};
+
+		memcpy(buf, &rate_comm, sizeof(rate_comm));
+		buf += sizeof(rate_comm);
+		memcpy(buf, rate->session_name, session_name_len);
+		buf += session_name_len;
+		memcpy(buf, rate->channel_name, channel_name_len);
+		buf += channel_name_len;
+	}
+	ret = size;
+end:
+	return ret;
+}
+
+static
+bool lttng_condition_channel_rate_is_equal(const struct lttng_condition *_a,
+		const struct lttng_condition *_b)
+{
+	bool is_equal = false;
+	struct lttng_condition_channel_rate *a, *b;
+
+	a = container_of(_a, struct lttng_condition_channel_rate, parent);
+	b = container_of(_b, struct lttng_condition_channel_rate, parent);
+
+	if (a->metric != b->metric) {
+		goto end;
+	}
+
+	if (a->threshold.set != b->threshold.set ||
+			(a->threshold.set &&
+				a->threshold.value != b->threshold.value)) {
+		goto end;
+	}
+
+	if ((a->session_name && !b->session_name) ||
+			(!a->session_name && b->session_name)) {
+		goto end;
+	}
+
+	if (a->session_name && b->session_name) {
+		if (strcmp(a->session_name, b->session_name)) {
+			goto end;
+		}
+	}
+
+	if ((a->channel_name && !b->channel_name) ||
+			(!a->channel_name && b->channel_name)) {
+		goto end;
+	}
+
+	if (a->channel_name && b->channel_name) {
+		if (strcmp(a->channel_name, b->channel_name)) {
+			goto end;
+		}
+	}
+
+	if (a->domain.set != b->domain.set ||
+			(a->domain.set && a->domain.type != b->domain.type)) {
+		goto end;
+	}
+	is_equal = true;
+end:
+	return is_equal;
+}
+
+static
+struct lttng_condition *lttng_condition_channel_rate_create(
+		enum lttng_condition_type type)
+{
+	struct lttng_condition_channel_rate *condition;
+
+	condition = zmalloc(sizeof(struct lttng_condition_channel_rate));
+	if (!condition) {
+		return NULL;
+	}
+
+	lttng_condition_init(&condition->parent, type);
+	condition->parent.validate = lttng_condition_channel_rate_validate;
+	condition->parent.serialize = lttng_condition_channel_rate_serialize;
+	condition->parent.equal = lttng_condition_channel_rate_is_equal;
+	condition->parent.destroy = lttng_condition_channel_rate_destroy;
+	condition->metric = LTTNG_CONDITION_CHANNEL_RATE_METRIC_UNKNOWN;
+	return &condition->parent;
+}
+
+struct lttng_condition *lttng_condition_channel_rate_low_create(void)
+{
+	return lttng_condition_channel_rate_create(
+			LTTNG_CONDITION_TYPE_CHANNEL_RATE_LOW);
+}
+
+struct lttng_condition *lttng_condition_channel_rate_high_create(void)
+{
+	return lttng_condition_channel_rate_create(
+			LTTNG_CONDITION_TYPE_CHANNEL_RATE_HIGH);
+}
+
+static
+ssize_t init_condition_from_buffer(struct lttng_condition *condition,
+		const struct lttng_buffer_view *src_view, bool borrow)
+{
+	ssize_t ret;
+	enum lttng_condition_status status;
+	const struct lttng_condition_channel_rate_comm *condition_comm;
+	const char *session_name, *channel_name;
+	struct lttng_buffer_view names_view;
+
+	if (src_view->size < sizeof(*condition_comm)) {
+		ERR("Failed to initialize from malformed condition buffer: buffer too short to contain header");
+		ret = -1;
+		goto end;
+	}
+
+	condition_comm = (const struct lttng_condition_channel_rate_comm *) src_view->data;
+	names_view = lttng_buffer_view_from_view(src_view,
+			sizeof(*condition_comm), -1);
+
+	if (condition_comm->session_name_len > LTTNG_NAME_MAX ||
+			condition_comm->channel_name_len > LTTNG_NAME_MAX ||
+			!condition_comm->session_name_len ||
+			!condition_comm->channel_name_len) {
+		ERR("Failed to initialize from malformed condition buffer: invalid element name length");
+		ret = -1;
+		goto end;
+	}
+
+	if (names_view.size <
+			(condition_comm->session_name_len +
+			condition_comm->channel_name_len)) {
+		ERR("Failed to initialize from malformed condition buffer: buffer too short to contain element names");
+		ret = -1;
+		goto end;
+	}
+
+	status = lttng_condition_channel_rate_set_metric(condition,
+			(enum lttng_condition_channel_rate_metric) condition_comm->metric);
+	if (status != LTTNG_CONDITION_STATUS_OK) {
+		ERR("Invalid channel rate metric (%i) found in condition buffer",
+				(int) condition_comm->metric);
+		ret = -1;
+		goto end;
+	}
+
+	status = lttng_condition_channel_rate_set_threshold(condition,
+			condition_comm->threshold);
+	if (status != LTTNG_CONDITION_STATUS_OK) {
+		ERR("Failed to initialize channel rate condition threshold");
+		ret = -1;
+		goto end;
+	}
+
+	if (condition_comm->domain_type <= LTTNG_DOMAIN_NONE ||
+			condition_comm->domain_type > LTTNG_DOMAIN_PYTHON) {
+		/* Invalid domain value. */
+		ERR("Invalid domain type value (%i) found in condition buffer",
+				(int) condition_comm->domain_type);
+		ret = -1;
+		goto end;
+	}
+
+	status = lttng_condition_channel_rate_set_domain_type(condition,
+			(enum lttng_domain_type) condition_comm->domain_type);
+	if (status != LTTNG_CONDITION_STATUS_OK) {
+		ERR("Failed to set channel rate condition domain");
+		ret = -1;
+		goto end;
+	}
+
+	session_name = names_view.data;
+	if (*(session_name + condition_comm->session_name_len - 1) != '\0') {
+		ERR("Malformed session name encountered in condition buffer");
+		ret = -1;
+		goto end;
+	}
+
+	channel_name = session_name + condition_comm->session_name_len;
+	if (*(channel_name + condition_comm->channel_name_len - 1) != '\0') {
+		ERR("Malformed channel name encountered in condition buffer");
+		ret = -1;
+		goto end;
+	}
+
+	if (borrow) {
+		struct lttng_condition_channel_rate *rate = container_of(condition,
+				struct lttng_condition_channel_rate, parent);
+
+		/* The names are used in place, as the setters would check. */
+		if (!*session_name || !*channel_name) {
+			ERR("Empty name encountered in condition buffer");
+			ret = -1;
+			goto end;
+		}
+		rate->session_name = (char *) session_name;
+		rate->channel_name = (char *) channel_name;
+		rate->names_borrowed = true;
+	} else {
+		status = lttng_condition_channel_rate_set_session_name(condition,
+				session_name);
+		if (status != LTTNG_CONDITION_STATUS_OK) {
+			ERR("Failed to set channel rate session name");
+			ret = -1;
+			goto end;
+		}
+
+		status = lttng_condition_channel_rate_set_channel_name(condition,
+				channel_name);
+		if (status != LTTNG_CONDITION_STATUS_OK) {
+			ERR("Failed to set channel rate channel name");
+			ret = -1;
+			goto end;
+		}
+	}
+
+	if (!lttng_condition_validate(condition)) {
+		ret = -1;
+		goto end;
+	}
+
+	ret = sizeof(*condition_comm) +
+			(ssize_t) condition_comm->session_name_len +
+			(ssize_t) condition_comm->channel_name_len;
+end:
+	return ret;
+}
+
+static
+ssize_t condition_create_from_buffer(enum lttng_condition_type type,
+		const struct lttng_buffer_view *view,
+		struct lttng_condition **_condition, bool borrow)
+{
+	ssize_t ret;
+	struct lttng_condition *condition =
+			lttng_condition_channel_rate_create(type);
+
+	if (!_condition || !condition) {
+		ret = -1;
+		goto error;
+	}
+
+	ret = init_condition_from_buffer(condition, view, borrow);
+	if (ret < 0) {
+		goto error;
+	}
+
+	*_condition = condition;
+	return ret;
+error:
+	lttng_condition_destroy(condition);
+	return ret;
+}
+
+LTTNG_HIDDEN
+ssize_t lttng_condition_channel_rate_low_create_from_buffer(
+		const struct lttng_buffer_view *view,
+		struct lttng_condition **condition, bool borrow)
+{
+	return condition_create_from_buffer(
+			LTTNG_CONDITION_TYPE_CHANNEL_RATE_LOW, view, condition,
+			borrow);
+}
+
+LTTNG_HIDDEN
+ssize_t lttng_condition_channel_rate_high_create_from_buffer(
+		const struct lttng_buffer_view *view,
+		struct lttng_condition **condition, bool borrow)
+{
+	return condition_create_from_buffer(
+			LTTNG_CONDITION_TYPE_CHANNEL_RATE_HIGH, view, condition,
+			borrow);
+}
+
+static
+ssize_t evaluation_create_from_buffer(enum lttng_condition_type type,
+		const struct lttng_buffer_view *view,
+		struct lttng_evaluation **_evaluation)
+{
+	ssize_t ret;
+	struct lttng_evaluation *evaluation = NULL;
+	const struct lttng_evaluation_channel_rate_comm *comm =
+			(const struct lttng_evaluation_channel_rate_comm *) view->data;
+
+	if (!_evaluation || view->size < sizeof(*comm) ||
+			!is_valid_metric((enum lttng_condition_channel_rate_metric)
+				comm->metric)) {
+		ret = -1;
+		goto error;
+	}
+
+	evaluation = lttng_evaluation_channel_rate_create(type,
+			(enum lttng_condition_channel_rate_metric) comm->metric,
+			(double) comm->rate / RATE_FIXED_SCALE);
+	if (!evaluation) {
+		ret = -1;
+		goto error;
+	}
+
+	*_evaluation = evaluation;
+	ret = sizeof(*comm);
+	return ret;
+error:
+	lttng_evaluation_destroy(evaluation);
+	return ret;
+}
+
+LTTNG_HIDDEN
+ssize_t lttng_evaluation_channel_rate_low_create_from_buffer(
+		const struct lttng_buffer_view *view,
+		struct lttng_evaluation **evaluation)
+{
+	return evaluation_create_from_buffer(
+			LTTNG_CONDITION_TYPE_CHANNEL_RATE_LOW, view, evaluation);
+}
+
+LTTNG_HIDDEN
+ssize_t lttng_evaluation_channel_rate_high_create_from_buffer(
+		const struct lttng_buffer_view *view,
+		struct lttng_evaluation **evaluation)
+{
+	return evaluation_create_from_buffer(
+			LTTNG_CONDITION_TYPE_CHANNEL_RATE_HIGH, view, evaluation);
+}
+
+enum lttng_condition_status
+lttng_condition_channel_rate_get_metric(
+		const struct lttng_condition *condition,
+		enum lttng_condition_channel_rate_metric *metric)
+{
+	struct lttng_condition_channel_rate *rate;
+	enum lttng_condition_status status = LTTNG_CONDITION_STATUS_OK;
+
+	if (!condition || !IS_RATE_CONDITION(condition) || !metric) {
+		status = LTTNG_CONDITION_STATUS_INVALID;
+		goto end;
+	}
+
+	rate = container_of(condition, struct lttng_condition_channel_rate,
+			parent);
+	if (!is_valid_metric(rate->metric)) {
+		status = LTTNG_CONDITION_STATUS_UNSET;
+		goto end;
+	}
+	*metric = rate->metric;
+end:
+	return status;
+}
+
+enum lttng_condition_status
+lttng_condition_channel_rate_set_metric(
+		struct lttng_condition *condition,
+		enum lttng_condition_channel_rate_metric metric)
+{
+	struct lttng_condition_channel_rate *rate;
+	enum lttng_condition_status status = LTTNG_CONDITION_STATUS_OK;
+
+	if (!condition || !IS_RATE_CONDITION(condition) ||
+			!is_valid_metric(metric)) {
+		status = LTTNG_CONDITION_STATUS_INVALID;
+		goto end;
+	}
+
+	rate = container_of(condition, struct lttng_condition_channel_rate,
+			parent);
+	rate->metric = metric;
+end:
+	return status;
+}
+
+enum lttng_condition_status
+lttng_condition_channel_rate_get_threshold(
+		const struct lttng_condition *condition,
+		uint64_t *threshold)
+{
+	struct lttng_condition_channel_rate *rate;
+	enum lttng_condition_status status = LTTNG_CONDITION_STATUS_OK;
+
+	if (!condition || !IS_RATE_CONDITION(condition) || !threshold) {
+		status = LTTNG_CONDITION_STATUS_INVALID;
+		goto end;
+	}
+
+	rate = container_of(condition, struct lttng_condition_channel_rate,
+			parent);
+	if (!rate->threshold.set) {
+		status = LTTNG_CONDITION_STATUS_UNSET;
+		goto end;
+	}
+	*threshold = rate->threshold.value;
+end:
+	return status;
+}
+
+enum lttng_condition_status
+lttng_condition_channel_rate_set_threshold(
+		struct lttng_condition *condition, uint64_t threshold)
+{
+	struct lttng_condition_channel_rate *rate;
+	enum lttng_condition_status status = LTTNG_CONDITION_STATUS_OK;
+
+	if (!condition || !IS_RATE_CONDITION(condition)) {
+		status = LTTNG_CONDITION_STATUS_INVALID;
+		goto end;
+	}
+
+	rate = container_of(condition, struct lttng_condition_channel_rate,
+			parent);
+	rate->threshold.set = true;
+	rate->threshold.value = threshold;
+end:
+	return status;
+}
+
+enum lttng_condition_status
+lttng_condition_channel_rate_get_session_name(
+		const struct lttng_condition *condition,
+		const char **session_name)
+{
+	struct lttng_condition_channel_rate *rate;
+	enum lttng_condition_status status = LTTNG_CONDITION_STATUS_OK;
+
+	if (!condition || !IS_RATE_CONDITION(condition) || !session_name) {
+		status = LTTNG_CONDITION_STATUS_INVALID;
+		goto end;
+	}
+
+	rate = container_of(condition, struct lttng_condition_channel_rate,
+			parent);
+	if (!rate->session_name) {
+		status = LTTNG_CONDITION_STATUS_UNSET;
+		goto end;
+	}
+	*session_name = rate->session_name;
+end:
+	return status;
+}
+
+enum lttng_condition_status
+lttng_condition_channel_rate_set_session_name(
+		struct lttng_condition *condition, const char *session_name)
+{
+	char *session_name_copy;
+	struct lttng_condition_channel_rate *rate;
+	enum lttng_condition_status status = LTTNG_CONDITION_STATUS_OK;
+
+	if (!condition || !IS_RATE_CONDITION(condition) || !session_name ||
+			strlen(session_name) == 0) {
+		status = LTTNG_CONDITION_STATUS_INVALID;
+		goto end;
+	}
+
+	rate = container_of(condition, struct lttng_condition_channel_rate,
+			parent);
+	session_name_copy = strdup(session_name);
+	if (!session_name_copy) {
+		status = LTTNG_CONDITION_STATUS_ERROR;
+		goto end;
+	}
+
+	if (rate->names_borrowed && own_names(rate)) {
+		free(session_name_copy);
+		status = LTTNG_CONDITION_STATUS_ERROR;
+		goto end;
+	}
+
+	free(rate->session_name);
+	rate->session_name = session_name_copy;
+end:
+	return status;
+}
+
+enum lttng_condition_status
+lttng_condition_channel_rate_get_channel_name(
+		const struct lttng_condition *condition,
+		const char **channel_name)
+{
+	struct lttng_condition_channel_rate *rate;
+	enum lttng_condition_status status = LTTNG_CONDITION_STATUS_OK;
+
+	if (!condition || !IS_RATE_CONDITION(condition) || !channel_name) {
+		status = LTTNG_CONDITION_STATUS_INVALID;
+		goto end;
+	}
+
+	rate = container_of(condition, struct lttng_condition_channel_rate,
+			parent);
+	if (!rate->channel_name) {
+		status = LTTNG_CONDITION_STATUS_UNSET;
+		goto end;
+	}
+	*channel_name = rate->channel_name;
+end:
+	return status;
+}
+
+enum lttng_condition_status
+lttng_condition_channel_rate_set_channel_name(
+		struct lttng_condition *condition, const char *channel_name)
+{
+	char *channel_name_copy;
+	struct lttng_condition_channel_rate *rate;
+	enum lttng_condition_status status = LTTNG_CONDITION_STATUS_OK;
+
+	if (!condition || !IS_RATE_CONDITION(condition) || !channel_name ||
+			strlen(channel_name) == 0) {
+		status = LTTNG_CONDITION_STATUS_INVALID;
+		goto end;
+	}
+
+	rate = container_of(condition, struct lttng_condition_channel_rate,
+			parent);
+	channel_name_copy = strdup(channel_name);
+	if (!channel_name_copy) {
+		status = LTTNG_CONDITION_STATUS_ERROR;
+		goto end;
+	}
+
+	if (rate->names_borrowed && own_names(rate)) {
+		free(channel_name_copy);
+		status = LTTNG_CONDITION_STATUS_ERROR;
+		goto end;
+	}
+
+	free(rate->channel_name);
+	rate->channel_name = channel_name_copy;
+end:
+	return status;
+}
+
+enum lttng_condition_status
+lttng_condition_channel_rate_get_domain_type(
+		const struct lttng_condition *condition,
+		enum lttng_domain_type *type)
+{
+	struct lttng_condition_channel_rate *rate;
+	enum lttng_condition_status status = LTTNG_CONDITION_STATUS_OK;
+
+	if (!condition || !IS_RATE_CONDITION(condition) || !type) {
+		status = LTTNG_CONDITION_STATUS_INVALID;
+		goto end;
+	}
+
+	rate = container_of(condition, struct lttng_condition_channel_rate,
+			parent);
+	if (!rate->domain.set) {
+		status = LTTNG_CONDITION_STATUS_UNSET;
+		goto end;
+	}
+	*type = rate->domain.type;
+end:
+	return status;
+}
+
+enum lttng_condition_status
+lttng_condition_channel_rate_set_domain_type(
+		struct lttng_condition *condition, enum lttng_domain_type type)
+{
+	struct lttng_condition_channel_rate *rate;
+	enum lttng_condition_status status = LTTNG_CONDITION_STATUS_OK;
+
+	if (!condition || !IS_RATE_CONDITION(condition) ||
+			type == LTTNG_DOMAIN_NONE) {
+		status = LTTNG_CONDITION_STATUS_INVALID;
+		goto end;
+	}
+
+	rate = container_of(condition, struct lttng_condition_channel_rate,
+			parent);
+	rate->domain.set = true;
+	rate->domain.type = type;
+end:
+	return status;
+}
+
+static
+ssize_t lttng_evaluation_channel_rate_serialize(
+		struct lttng_evaluation *evaluation, char *buf)
+{
+	struct lttng_evaluation_channel_rate *rate;
+
+	rate = container_of(evaluation, struct lttng_evaluation_channel_rate,
+			parent);
+	if (buf) {
+		struct lttng_evaluation_channel_rate_comm comm = {
+			.metric = (int8_t) rate->metric,
+			.rate = (uint64_t) (rate->rate * RATE_FIXED_SCALE),
+		};
+
+		memcpy(buf, &comm, sizeof(comm));
+	}
+
+	return sizeof(struct lttng_evaluation_channel_rate_comm);
+}
+
+static
+void lttng_evaluation_channel_rate_destroy(
+		struct lttng_evaluation *evaluation)
+{
+	struct lttng_evaluation_channel_rate *rate;
+
+	rate = container_of(evaluation, struct lttng_evaluation_channel_rate,
+			parent);
+	free(rate);
+}
+
+LTTNG_HIDDEN
+struct lttng_evaluation *lttng_evaluation_channel_rate_create(
+		enum lttng_condition_type type,
+		enum lttng_condition_channel_rate_metric metric, double rate)
+{
+	struct lttng_evaluation_channel_rate *evaluation;
+
+	evaluation = zmalloc(sizeof(struct lttng_evaluation_channel_rate));
+	if (!evaluation) {
+		return NULL;
+	}
+
+	evaluation->parent.type = type;
+	evaluation->metric = metric;
+	evaluation->rate = rate;
+	evaluation->parent.serialize = lttng_evaluation_channel_rate_serialize;
+	evaluation->parent.destroy = lttng_evaluation_channel_rate_destroy;
+	return &evaluation->parent;
+}
+
+enum lttng_evaluation_status
+lttng_evaluation_channel_rate_get_rate(
+		const struct lttng_evaluation *evaluation, double *rate)
+{
+	struct lttng_evaluation_channel_rate *rate_evaluation;
+	enum lttng_evaluation_status status = LTTNG_EVALUATION_STATUS_OK;
+
+	if (!evaluation || !is_rate_evaluation(evaluation) || !rate) {
+		status = LTTNG_EVALUATION_STATUS_INVALID;
+		goto end;
+	}
+
+	rate_evaluation = container_of(evaluation,
+			struct lttng_evaluation_channel_rate, parent);
+	*rate = rate_evaluation->rate;
+end:
+	return status;
+}
+
+enum lttng_evaluation_status
+lttng_evaluation_channel_rate_get_metric(
+		const struct lttng_evaluation *evaluation,
+		enum lttng_condition_channel_rate_metric *metric)
+{
+	struct lttng_evaluation_channel_rate *rate_evaluation;
+	enum lttng_evaluation_status status = LTTNG_EVALUATION_STATUS_OK;
+
+	if (!evaluation || !is_rate_evaluation(evaluation) || !metric) {
+		status = LTTNG_EVALUATION_STATUS_INVALID;
+		goto end;
+	}
+
+	rate_evaluation = container_of(evaluation,
+			struct lttng_evaluation_channel_rate, parent);
+	*metric = rate_evaluation->metric;
+end:
+	return status;
+}
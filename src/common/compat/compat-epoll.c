@@ -120,6 +120,15 @@ error:
  * Add a fd to the epoll set with requesting events.
  */
 int compat_epoll_add(struct lttng_poll_event *events, int fd, uint32_t req_events)
+{
+	return compat_epoll_add_data(events, fd, req_events, NULL);
+}
+
+/*
+ * Add a fd to the epoll set with requesting events and a user data pointer.
+ */
+int compat_epoll_add_data(struct lttng_poll_event *events, int fd,
+		uint32_t req_events, void *data)
 {
 	int ret;
 	struct epoll_event ev;
@@ -137,6 +146,12 @@ int compat_epoll_add(struct lttng_poll_event *events, int fd, uint32_t req_event
 	ev.events = req_events;
 	ev.data.fd = fd;
 
+	ret = __lttng_poll_fd_data_set(&events->fd_data, fd, data);
+	if (ret < 0) {
+		PERROR("realloc epoll fd data");
+		goto error;
+	}
+
 	ret = epoll_ctl(events->epfd, EPOLL_CTL_ADD, fd, &ev);
 	if (ret < 0) {
 		switch (errno) {
@@ -174,6 +189,8 @@ int compat_epoll_del(struct lttng_poll_event *events, int fd)
 		goto error;
 	}
 
+	(void) __lttng_poll_fd_data_set(&events->fd_data, fd, NULL);
+
 	ret = epoll_ctl(events->epfd, EPOLL_CTL_DEL, fd, NULL);
 	if (ret < 0) {
 		switch (errno) {
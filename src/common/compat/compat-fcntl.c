@@ -31,4 +31,16 @@ int compat_sync_file_range(int fd, off64_t offset, off64_t nbytes,
 #endif
 }
 
+int compat_fallocate_keep_size(int fd, off64_t offset, off64_t len)
+{
+#if defined(HAVE_FALLOCATE) && defined(FALLOC_FL_KEEP_SIZE)
+	int ret;
+
+	ret = fallocate(fd, FALLOC_FL_KEEP_SIZE, offset, len);
+	return ret ? -errno : 0;
+#else
+	return -ENOSYS;
+#endif
+}
+
 #endif /* __linux__ */
@@ -0,0 +1,484 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include "io-uring.h"
+
+#ifdef LTTNG_HAVE_IO_URING
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+#include <urcu/arch.h>
+#include <urcu/system.h>
+
+#include <common/error.h>
+#include <common/macros.h>
+#include <common/compat/fcntl.h>
+#include <common/defaults.h>
+
+/* Staging buffer holding the data of one queued write. */
+struct lttng_io_uring_slot {
+	void *buf;
+	size_t buf_len;
+	/* Output fd and range of the complete write. */
+	int fd;
+	off_t start;
+	size_t len;
+	/* Part of the write not yet completed, resubmitted on short writes. */
+	struct iovec iov;
+	off_t offset;
+	unsigned int in_flight:1;
+};
+
+struct lttng_io_uring {
+	int ring_fd;
+	unsigned int depth;
+	unsigned int nr_in_flight;
+	/* First write error since the last report. */
+	int error;
+
+	void *sq_ring;
+	size_t sq_ring_len;
+	unsigned int *sq_tail;
+	unsigned int *sq_mask;
+	unsigned int *sq_array;
+	struct io_uring_sqe *sqes;
+	size_t sqes_len;
+
+	void *cq_ring;
+	size_t cq_ring_len;
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	unsigned int *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	struct lttng_io_uring_slot *slots;
+};
+
+static int sys_io_uring_setup(unsigned int entries,
+		struct io_uring_params *params)
+{
+	return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_io_uring_enter(int fd, unsigned int to_submit,
+		unsigned int min_complete, unsigned int flags)
+{
+	int ret;
+
+	do {
+		ret = (int) syscall(__NR_io_uring_enter, fd, to_submit,
+				min_complete, flags, NULL, 0);
+	} while (ret < 0 && errno == EINTR);
+
+	return ret;
+}
+
+/*
+ * Submit the remaining part of a slot's write.
+ *
+ * Return 0 on success or else a negative errno.
+ */
+static int submit_slot(struct lttng_io_uring *ring, unsigned int idx)
+{
+	int ret;
+	unsigned int tail, index;
+	struct io_uring_sqe *sqe;
+	struct lttng_io_uring_slot *slot = &ring->slots[idx];
+
+	tail = *ring->sq_tail;
+	index = tail & *ring->sq_mask;
+	sqe = &ring->sqes[index];
+
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_WRITEV;
+	sqe->fd = slot->fd;
+	sqe->addr = (uint64_t) (uintptr_t) &slot->iov;
+	sqe->len = 1;
+	sqe->off = (uint64_t) slot->offset;
+	sqe->user_data = idx;
+	ring->sq_array[index] = index;
+
+	/* The entry must be visible to the kernel before the tail update. */
+	cmm_smp_wmb();
+	CMM_STORE_SHARED(*ring->sq_tail, tail + 1);
+
+	ret = sys_io_uring_enter(ring->ring_fd, 1, 0, 0);
+	if (ret != 1) {
+		ret = ret < 0 ? -errno : -EAGAIN;
+		PERROR("io_uring_enter submit");
+		/* The entry was not consumed, take it back. */
+		CMM_STORE_SHARED(*ring->sq_tail, tail);
+		goto end;
+	}
+	ret = 0;
+
+end:
+	return ret;
+}
+
+/*
+ * Handle the completion of a slot's write. Short writes are resubmitted.
+ */
+static void complete_slot(struct lttng_io_uring *ring, unsigned int idx,
+		int res)
+{
+	int ret;
+	struct lttng_io_uring_slot *slot = &ring->slots[idx];
+
+	assert(idx < ring->depth);
+	assert(slot->in_flight);
+
+	if (res > 0 && (size_t) res < slot->iov.iov_len) {
+		slot->iov.iov_base = (char *) slot->iov.iov_base + res;
+		slot->iov.iov_len -= res;
+		slot->offset += res;
+		ret = submit_slot(ring, idx);
+		if (!ret) {
+			return;
+		}
+		res = ret;
+	} else if (res == 0) {
+		res = -EIO;
+	}
+
+	if (res < 0) {
+		errno = -res;
+		PERROR("io_uring write of %zu bytes at offset %jd on fd %d",
+				slot->len, (intmax_t) slot->start, slot->fd);
+		if (!ring->error) {
+			ring->error = res;
+		}
+	} else {
+		/* This won't block, but will start writeout asynchronously */
+		lttng_sync_file_range(slot->fd, slot->start, slot->len,
+				SYNC_FILE_RANGE_WRITE);
+	}
+
+	slot->in_flight = 0;
+	ring->nr_in_flight--;
+}
+
+/*
+ * Reap the available completions, first waiting for at least "min_complete"
+ * of them.
+ *
+ * Return 0 on success or else a negative errno.
+ */
+static int reap(struct lttng_io_uring *ring, unsigned int min_complete)
+{
+	int ret = 0;
+	unsigned int head, tail;
+
+	if (min_complete) {
+		ret = sys_io_uring_enter(ring->ring_fd, 0, min_complete,
+				IORING_ENTER_GETEVENTS);
+		if (ret < 0) {
+			ret = -errno;
+			PERROR("io_uring_enter wait");
+			goto end;
+		}
+		ret = 0;
+	}
+
+	head = *ring->cq_head;
+	for (;;) {
+		struct io_uring_cqe *cqe;
+
+		tail = CMM_LOAD_SHARED(*ring->cq_tail);
+		/* Read the entries after the tail. */
+		cmm_smp_rmb();
+		if (head == tail) {
+			break;
+		}
+		cqe = &ring->cqes[head & *ring->cq_mask];
+		complete_slot(ring, (unsigned int) cqe->user_data, cqe->res);
+		head++;
+	}
+	/* The entries must be consumed before the kernel can reuse them. */
+	cmm_smp_mb();
+	CMM_STORE_SHARED(*ring->cq_head, head);
+
+end:
+	return ret;
+}
+
+/*
+ * Wait until at least one slot is free or every write is completed.
+ *
+ * Return 0 on success or else a negative errno.
+ */
+static int wait_one(struct lttng_io_uring *ring)
+{
+	unsigned int nr_in_flight = ring->nr_in_flight;
+	int ret = 0;
+
+	while (ring->nr_in_flight && ring->nr_in_flight >= nr_in_flight) {
+		ret = reap(ring, 1);
+		if (ret < 0) {
+			break;
+		}
+	}
+
+	return ret;
+}
+
+int lttng_io_uring_probe(void)
+{
+	int fd, ret;
+	struct io_uring_params params;
+
+	memset(&params, 0, sizeof(params));
+	fd = sys_io_uring_setup(1, &params);
+	if (fd < 0) {
+		ret = -errno;
+		goto end;
+	}
+	ret = close(fd);
+	if (ret) {
+		PERROR("close io_uring");
+	}
+	ret = 0;
+end:
+	return ret;
+}
+
+struct lttng_io_uring *lttng_io_uring_create(unsigned int depth)
+{
+	int fd;
+	struct io_uring_params params;
+	struct lttng_io_uring *ring;
+
+	assert(depth > 0);
+
+	ring = zmalloc(sizeof(*ring));
+	if (!ring) {
+		PERROR("zmalloc io_uring");
+		goto error;
+	}
+	ring->ring_fd = -1;
+	ring->sq_ring = MAP_FAILED;
+	ring->cq_ring = MAP_FAILED;
+	ring->sqes = MAP_FAILED;
+
+	ring->slots = zmalloc(depth * sizeof(*ring->slots));
+	if (!ring->slots) {
+		PERROR("zmalloc io_uring slots");
+		goto error;
+	}
+
+	memset(&params, 0, sizeof(params));
+	fd = sys_io_uring_setup(depth, &params);
+	if (fd < 0) {
+		PERROR("io_uring_setup");
+		goto error;
+	}
+	ring->ring_fd = fd;
+	ring->depth = depth;
+
+	ring->sq_ring_len = params.sq_off.array +
+			params.sq_entries * sizeof(unsigned int);
+	ring->sq_ring = mmap(NULL, ring->sq_ring_len, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (ring->sq_ring == MAP_FAILED) {
+		PERROR("mmap io_uring submission ring");
+		goto error;
+	}
+	ring->sq_tail = (unsigned int *) ((char *) ring->sq_ring +
+			params.sq_off.tail);
+	ring->sq_mask = (unsigned int *) ((char *) ring->sq_ring +
+			params.sq_off.ring_mask);
+	ring->sq_array = (unsigned int *) ((char *) ring->sq_ring +
+			params.sq_off.array);
+
+	ring->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED) {
+		PERROR("mmap io_uring submission entries");
+		goto error;
+	}
+
+	ring->cq_ring_len = params.cq_off.cqes +
+			params.cq_entries * sizeof(struct io_uring_cqe);
+	ring->cq_ring = mmap(NULL, ring->cq_ring_len, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+	if (ring->cq_ring == MAP_FAILED) {
+		PERROR("mmap io_uring completion ring");
+		goto error;
+	}
+	ring->cq_head = (unsigned int *) ((char *) ring->cq_ring +
+			params.cq_off.head);
+	ring->cq_tail = (unsigned int *) ((char *) ring->cq_ring +
+			params.cq_off.tail);
+	ring->cq_mask = (unsigned int *) ((char *) ring->cq_ring +
+			params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *) ((char *) ring->cq_ring +
+			params.cq_off.cqes);
+
+	return ring;
+
+error:
+	lttng_io_uring_destroy(ring);
+	return NULL;
+}
+
+void lttng_io_uring_destroy(struct lttng_io_uring *ring)
+{
+	int ret;
+	unsigned int i;
+
+	if (!ring) {
+		return;
+	}
+
+	if (ring->ring_fd >= 0 && ring->cq_ring != MAP_FAILED) {
+		(void) lttng_io_uring_drain(ring);
+	}
+
+	if (ring->cq_ring != MAP_FAILED) {
+		ret = munmap(ring->cq_ring, ring->cq_ring_len);
+		if (ret) {
+			PERROR("munmap io_uring completion ring");
+		}
+	}
+	if (ring->sqes != MAP_FAILED) {
+		ret = munmap(ring->sqes, ring->sqes_len);
+		if (ret) {
+			PERROR("munmap io_uring submission entries");
+		}
+	}
+	if (ring->sq_ring != MAP_FAILED) {
+		ret = munmap(ring->sq_ring, ring->sq_ring_len);
+		if (ret) {
+			PERROR("munmap io_uring submission ring");
+		}
+	}
+	if (ring->ring_fd >= 0) {
+		ret = close(ring->ring_fd);
+		if (ret) {
+			PERROR("close io_uring");
+		}
+	}
+	if (ring->slots) {
+		for (i = 0; i < ring->depth; i++) {
+			free(ring->slots[i].buf);
+		}
+		free(ring->slots);
+	}
+	free(ring);
+}
+
+int lttng_io_uring_drain(struct lttng_io_uring *ring)
+{
+	int ret = 0;
+
+	assert(ring);
+
+	while (ring->nr_in_flight) {
+		ret = reap(ring, 1);
+		if (ret < 0) {
+			goto end;
+		}
+	}
+
+	ret = ring->error;
+	ring->error = 0;
+end:
+	return ret;
+}
+
+ssize_t lttng_io_uring_write(struct lttng_io_uring *ring, int fd,
+		const void *buf, size_t len, off_t offset)
+{
+	ssize_t ret;
+	unsigned int i;
+	struct lttng_io_uring_slot *slot = NULL;
+
+	assert(ring);
+	assert(buf);
+
+	ret = reap(ring, 0);
+	if (ret < 0) {
+		goto end;
+	}
+	if (ring->nr_in_flight == ring->depth) {
+		ret = wait_one(ring);
+		if (ret < 0) {
+			goto end;
+		}
+	}
+	if (ring->error) {
+		ret = ring->error;
+		ring->error = 0;
+		goto end;
+	}
+
+	for (i = 0; i < ring->depth; i++) {
+		if (!ring->slots[i].in_flight) {
+			slot = &ring->slots[i];
+			break;
+		}
+	}
+	assert(slot);
+
+	if (slot->buf_len < len) {
+		void *new_buf;
+
+		/* Aligned so the output file can be opened with O_DIRECT. */
+		ret = posix_memalign(&new_buf, DEFAULT_CONSUMERD_DIRECT_IO_ALIGN,
+				len);
+		if (ret) {
+			errno = ret;
+			PERROR("posix_memalign io_uring staging buffer");
+			ret = -ENOMEM;
+			goto end;
+		}
+		free(slot->buf);
+		slot->buf = new_buf;
+		slot->buf_len = len;
+	}
+	memcpy(slot->buf, buf, len);
+
+	slot->fd = fd;
+	slot->start = offset;
+	slot->len = len;
+	slot->iov.iov_base = slot->buf;
+	slot->iov.iov_len = len;
+	slot->offset = offset;
+	slot->in_flight = 1;
+	ring->nr_in_flight++;
+
+	ret = submit_slot(ring, i);
+	if (ret < 0) {
+		slot->in_flight = 0;
+		ring->nr_in_flight--;
+		goto end;
+	}
+	ret = len;
+
+end:
+	return ret;
+}
+
+#endif /* LTTNG_HAVE_IO_URING */
@@ -156,6 +156,16 @@ error:
  */
 int compat_poll_add(struct lttng_poll_event *events, int fd,
 		uint32_t req_events)
+{
+	return compat_poll_add_data(events, fd, req_events, NULL);
+}
+
+/*
+ * Add fd to pollfd data structure with requested events and a user data
+ * pointer.
+ */
+int compat_poll_add_data(struct lttng_poll_event *events, int fd,
+		uint32_t req_events, void *data)
 {
 	int new_size, ret, i;
 	struct compat_poll_event_array *current;
@@ -184,6 +194,12 @@ int compat_poll_add(struct lttng_poll_event *events, int fd,
 		}
 	}
 
+	ret = __lttng_poll_fd_data_set(&events->fd_data, fd, data);
+	if (ret < 0) {
+		PERROR("realloc poll fd data");
+		goto error;
+	}
+
 	current->events[current->nb_fd].fd = fd;
 	current->events[current->nb_fd].events = req_events;
 	current->nb_fd++;
@@ -248,6 +264,7 @@ int compat_poll_del(struct lttng_poll_event *events, int fd)
 
 	/* Ease our life a bit. */
 	current = &events->current;
+	(void) __lttng_poll_fd_data_set(&events->fd_data, fd, NULL);
 
 	for (i = 0; i < current->nb_fd; i++) {
 		/* Don't put back the fd we want to delete */
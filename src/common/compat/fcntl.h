@@ -21,6 +21,7 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
 #if (defined(__FreeBSD__) || defined(__CYGWIN__))
 typedef long long off64_t;
@@ -36,6 +37,14 @@ extern int compat_sync_file_range(int fd, off64_t offset, off64_t nbytes,
 #define lttng_sync_file_range(fd, offset, nbytes, flags) \
 	compat_sync_file_range(fd, offset, nbytes, flags)
 
+/*
+ * Allocate disk space for the given range of a file without changing its
+ * size. Return 0 on success or else a negative errno.
+ */
+extern int compat_fallocate_keep_size(int fd, off64_t offset, off64_t len);
+#define lttng_fallocate_keep_size(fd, offset, len) \
+	compat_fallocate_keep_size(fd, offset, len)
+
 #endif /* __linux__ */
 
 #if (defined(__FreeBSD__) || defined(__CYGWIN__) || defined(__sun__))
@@ -51,6 +60,12 @@ static inline int lttng_sync_file_range(int fd, off64_t offset,
 {
 	return -ENOSYS;
 }
+
+static inline int lttng_fallocate_keep_size(int fd, off64_t offset,
+		off64_t len)
+{
+	return -ENOSYS;
+}
 #endif
 
 #if (defined(__FreeBSD__) || defined(__CYGWIN__) || defined(__sun__))
@@ -67,6 +82,12 @@ static inline ssize_t splice(int fd_in, loff_t *off_in, int fd_out, loff_t *off_
 {
 	return -ENOSYS;
 }
+
+static inline ssize_t vmsplice(int fd, const struct iovec *iov,
+		unsigned long nr_segs, unsigned int flags)
+{
+	return -ENOSYS;
+}
 #endif
 
 #ifdef __FreeBSD__
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef LTTNG_COMPAT_IO_URING_H
+#define LTTNG_COMPAT_IO_URING_H
+
+#include <errno.h>
+#include <stddef.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+
+#if defined(HAVE_LINUX_IO_URING_H) && defined(__NR_io_uring_setup) && \
+	defined(__NR_io_uring_enter)
+#define LTTNG_HAVE_IO_URING 1
+#endif
+
+/*
+ * Asynchronous writer of a trace stream output file.
+ *
+ * Every queued write is first copied in one of the writer's staging buffers
+ * so the caller can reuse its buffer (e.g. release the sub-buffer back to the
+ * ring buffer) as soon as the write is queued. Writes are positioned (explicit file offset) and
+ * complete in any order.
+ *
+ * A writer is not thread safe: it is owned by a stream and MUST be used with
+ * the stream lock held.
+ */
+struct lttng_io_uring;
+
+#ifdef LTTNG_HAVE_IO_URING
+
+/*
+ * Check that the running kernel supports io_uring.
+ *
+ * Return 0 if supported or else a negative errno.
+ */
+int lttng_io_uring_probe(void);
+
+/*
+ * Create a writer that can have up to "depth" writes in flight.
+ *
+ * Return the new writer or NULL on error.
+ */
+struct lttng_io_uring *lttng_io_uring_create(unsigned int depth);
+
+/*
+ * Wait for every in-flight write of the writer to complete and destroy it.
+ * NULL is accepted.
+ */
+void lttng_io_uring_destroy(struct lttng_io_uring *ring);
+
+/*
+ * Wait for every in-flight write of the writer to complete. This MUST be
+ * called before the output file descriptor is closed or replaced.
+ *
+ * Return 0 on success or else the negative errno of the first failed write
+ * since the last call.
+ */
+int lttng_io_uring_drain(struct lttng_io_uring *ring);
+
+/*
+ * Queue a write of "len" bytes of "buf" at "offset" in "fd". The data is
+ * copied and "buf" can be reused as soon as this returns. This blocks only
+ * if all the writes of the writer are already in flight.
+ *
+ * Return len on success or else a negative errno. A failure of a previously
+ * queued write is reported by the next call.
+ */
+ssize_t lttng_io_uring_write(struct lttng_io_uring *ring, int fd,
+		const void *buf, size_t len, off_t offset);
+
+#else /* LTTNG_HAVE_IO_URING */
+
+static inline int lttng_io_uring_probe(void)
+{
+	return -ENOSYS;
+}
+
+static inline struct lttng_io_uring *lttng_io_uring_create(
+		unsigned int depth)
+{
+	return NULL;
+}
+
+static inline void lttng_io_uring_destroy(struct lttng_io_uring *ring)
+{
+}
+
+static inline int lttng_io_uring_drain(struct lttng_io_uring *ring)
+{
+	return 0;
+}
+
+static inline ssize_t lttng_io_uring_write(struct lttng_io_uring *ring,
+		int fd, const void *buf, size_t len, off_t offset)
+{
+	return -ENOSYS;
+}
+
+#endif /* LTTNG_HAVE_IO_URING */
+
+#endif /* LTTNG_COMPAT_IO_URING_H */
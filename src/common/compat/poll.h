@@ -19,6 +19,8 @@
 #define _LTT_POLL_H
 
 #include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -46,6 +48,54 @@ static inline void __lttng_poll_free(void *events)
 	free(events);
 }
 
+/*
+ * User data pointers of the fds of a poll set, indexed by fd, so that the
+ * event loops get the object of a ready fd without looking it up.
+ */
+struct lttng_poll_fd_data {
+	void **ptrs;
+	uint32_t size;
+};
+
+/*
+ * Set the user data pointer of fd, growing the table if needed.
+ *
+ * Return 0 on success or else -1 on ENOMEM.
+ */
+static inline int __lttng_poll_fd_data_set(struct lttng_poll_fd_data *data,
+		int fd, void *ptr)
+{
+	if (fd >= data->size) {
+		void **new_ptrs;
+		uint32_t new_size;
+
+		if (!ptr) {
+			/* Unset entries are NULL already. */
+			return 0;
+		}
+		new_size = data->size ? data->size : 64;
+		while (new_size <= fd) {
+			new_size <<= 1;
+		}
+		new_ptrs = realloc(data->ptrs, new_size * sizeof(*new_ptrs));
+		if (!new_ptrs) {
+			return -1;
+		}
+		memset(new_ptrs + data->size, 0,
+				(new_size - data->size) * sizeof(*new_ptrs));
+		data->ptrs = new_ptrs;
+		data->size = new_size;
+	}
+	data->ptrs[fd] = ptr;
+	return 0;
+}
+
+static inline void *__lttng_poll_fd_data_get(struct lttng_poll_fd_data *data,
+		int fd)
+{
+	return fd >= 0 && fd < data->size ? data->ptrs[fd] : NULL;
+}
+
 /*
  * epoll(7) implementation.
  */
@@ -72,6 +122,8 @@ enum {
 	LPOLLHUP = EPOLLHUP,
 	LPOLLNVAL = EPOLLHUP,
 	LPOLLRDHUP = EPOLLRDHUP,
+	/* Edge-triggered registration, see lttng_poll_add(). */
+	LPOLLET = EPOLLET,
 	/* Close on exec feature of epoll */
 #if defined(HAVE_EPOLL_CREATE1) && defined(EPOLL_CLOEXEC)
 	LTTNG_CLOEXEC = EPOLL_CLOEXEC,
@@ -92,6 +144,7 @@ struct compat_epoll_event {
 	uint32_t alloc_size; /* Size of events array */
 	uint32_t init_size;	/* Initial size of events array */
 	struct epoll_event *events;
+	struct lttng_poll_fd_data fd_data;
 };
 #define lttng_poll_event compat_epoll_event
 
@@ -118,6 +171,8 @@ static inline int __lttng_epoll_get_prev_fd(struct lttng_poll_event *events,
 #define LTTNG_POLL_GETSZ(e) LTTNG_REF(e)->events_size
 #define LTTNG_POLL_GET_PREV_FD(e, i, nb_fd) \
 	__lttng_epoll_get_prev_fd(LTTNG_REF(e), i, nb_fd)
+#define LTTNG_POLL_GETDATA(e, i) \
+	__lttng_poll_fd_data_get(&LTTNG_REF(e)->fd_data, LTTNG_POLL_GETFD(e, i))
 
 /*
  * Create the epoll set. No memory allocation is done here.
@@ -158,12 +213,25 @@ extern int compat_epoll_wait(struct lttng_poll_event *events, int timeout);
 
 /*
  * Add a fd to the epoll set and resize the epoll_event structure if needed.
+ *
+ * With LPOLLET in req_events, an event is reported once when the fd becomes
+ * ready: the caller must then consume it until EAGAIN. The poll(2) fallback
+ * ignores LPOLLET, which only reports the fd again if it is still ready.
  */
 extern int compat_epoll_add(struct lttng_poll_event *events,
 		int fd, uint32_t req_events);
 #define lttng_poll_add(events, fd, req_events) \
 	compat_epoll_add(events, fd, req_events)
 
+/*
+ * Add a fd to the epoll set with a user data pointer, returned by
+ * LTTNG_POLL_GETDATA() for its events until it is removed from the set.
+ */
+extern int compat_epoll_add_data(struct lttng_poll_event *events,
+		int fd, uint32_t req_events, void *data);
+#define lttng_poll_add_data(events, fd, req_events, data) \
+	compat_epoll_add_data(events, fd, req_events, data)
+
 /*
  * Remove a fd from the epoll set.
  */
@@ -177,7 +245,7 @@ extern int compat_epoll_del(struct lttng_poll_event *events, int fd);
 extern int compat_epoll_mod(struct lttng_poll_event *events,
 		int fd, uint32_t req_events);
 #define lttng_poll_mod(events, fd, req_events) \
-	compat_epoll_add(events, fd, req_events)
+	compat_epoll_mod(events, fd, req_events)
 
 /*
  * Set up the poll set limits variable poll_max_size
@@ -230,6 +298,7 @@ static inline void lttng_poll_clean(struct lttng_poll_event *events)
 	}
 
 	__lttng_poll_free((void *) events->events);
+	__lttng_poll_free((void *) events->fd_data.ptrs);
 }
 
 #else	/* HAVE_EPOLL */
@@ -270,6 +339,8 @@ enum {
 #endif /* __linux__ */
 	LPOLLERR = POLLERR,
 	LPOLLHUP = POLLHUP | POLLNVAL,
+	/* poll(2) is level-triggered only. */
+	LPOLLET = 0,
 	/* Close on exec feature does not exist for poll(2) */
 	LTTNG_CLOEXEC = 0xdead,
 };
@@ -296,6 +367,8 @@ struct compat_poll_event {
 
 	/* Indicate if wait.events need to be updated from current. */
 	int need_update:1;
+
+	struct lttng_poll_fd_data fd_data;
 };
 #define lttng_poll_event compat_poll_event
 
@@ -322,6 +395,8 @@ static inline int __lttng_poll_get_prev_fd(struct lttng_poll_event *events,
 #define LTTNG_POLL_GETSZ(e) LTTNG_REF(e)->wait.events_size
 #define LTTNG_POLL_GET_PREV_FD(e, i, nb_fd) \
 	__lttng_poll_get_prev_fd(LTTNG_REF(e), i, nb_fd)
+#define LTTNG_POLL_GETDATA(e, i) \
+	__lttng_poll_fd_data_get(&LTTNG_REF(e)->fd_data, LTTNG_POLL_GETFD(e, i))
 
 /*
  * Create a pollfd structure of size 'size'.
@@ -346,6 +421,15 @@ extern int compat_poll_add(struct lttng_poll_event *events,
 #define lttng_poll_add(events, fd, req_events) \
 	compat_poll_add(events, fd, req_events)
 
+/*
+ * Add the fd to the pollfd structure with a user data pointer, returned by
+ * LTTNG_POLL_GETDATA() for its events until it is removed.
+ */
+extern int compat_poll_add_data(struct lttng_poll_event *events,
+		int fd, uint32_t req_events, void *data);
+#define lttng_poll_add_data(events, fd, req_events, data) \
+	compat_poll_add_data(events, fd, req_events, data)
+
 /*
  * Remove the fd from the pollfd. Memory allocation is done to recreate a new
  * pollfd, data is copied from the old pollfd to the new and, finally, the old
@@ -361,7 +445,7 @@ extern int compat_poll_del(struct lttng_poll_event *events, int fd);
 extern int compat_poll_mod(struct lttng_poll_event *events,
 		int fd, uint32_t req_events);
 #define lttng_poll_mod(events, fd, req_events) \
-	compat_poll_add(events, fd, req_events)
+	compat_poll_mod(events, fd, req_events)
 
 /*
  * Set up the poll set limits variable poll_max_size
@@ -393,6 +477,7 @@ static inline void lttng_poll_clean(struct lttng_poll_event *events)
 	if (events) {
 		__lttng_poll_free((void *) events->wait.events);
 		__lttng_poll_free((void *) events->current.events);
+		__lttng_poll_free((void *) events->fd_data.ptrs);
 	}
 }
 
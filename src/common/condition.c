@@ -17,6 +17,7 @@
 
 #include <lttng/condition/condition-internal.h>
 #include <lttng/condition/buffer-usage-internal.h>
+#include <lttng/condition/channel-rate-internal.h>
 #include <common/macros.h>
 #include <common/error.h>
 #include <common/dynamic-buffer.h>
@@ -111,10 +112,9 @@ end:
 	return is_equal;
 }
 
-LTTNG_HIDDEN
-ssize_t lttng_condition_create_from_buffer(
-		const struct lttng_buffer_view *buffer,
-		struct lttng_condition **condition)
+static
+ssize_t condition_create_from_buffer(const struct lttng_buffer_view *buffer,
+		struct lttng_condition **condition, bool borrow)
 {
 	ssize_t ret, condition_size = 0;
 	const struct lttng_condition_comm *condition_comm;
@@ -136,6 +136,12 @@ ssize_t lttng_condition_create_from_buffer(
 	case LTTNG_CONDITION_TYPE_BUFFER_USAGE_HIGH:
 		create_from_buffer = lttng_condition_buffer_usage_high_create_from_buffer;
 		break;
+	case LTTNG_CONDITION_TYPE_CHANNEL_RATE_LOW:
+		create_from_buffer = lttng_condition_channel_rate_low_create_from_buffer;
+		break;
+	case LTTNG_CONDITION_TYPE_CHANNEL_RATE_HIGH:
+		create_from_buffer = lttng_condition_channel_rate_high_create_from_buffer;
+		break;
 	default:
 		ERR("Attempted to create condition of unknown type (%i)",
 				(int) condition_comm->condition_type);
@@ -148,7 +154,7 @@ ssize_t lttng_condition_create_from_buffer(
 				lttng_buffer_view_from_view(buffer,
 					sizeof(*condition_comm), -1);
 
-		ret = create_from_buffer(&view, condition);
+		ret = create_from_buffer(&view, condition, borrow);
 		if (ret < 0) {
 			goto end;
 		}
@@ -163,6 +169,22 @@ end:
 	return ret;
 }
 
+LTTNG_HIDDEN
+ssize_t lttng_condition_create_from_buffer(
+		const struct lttng_buffer_view *buffer,
+		struct lttng_condition **condition)
+{
+	return condition_create_from_buffer(buffer, condition, false);
+}
+
+LTTNG_HIDDEN
+ssize_t lttng_condition_create_from_buffer_borrowed(
+		const struct lttng_buffer_view *buffer,
+		struct lttng_condition **condition)
+{
+	return condition_create_from_buffer(buffer, condition, true);
+}
+
 LTTNG_HIDDEN
 void lttng_condition_init(struct lttng_condition *condition,
 		enum lttng_condition_type type)
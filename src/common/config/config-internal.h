@@ -15,9 +15,70 @@
  * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <libxml/tree.h>
 #include <libxml/xmlwriter.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
+#include <common/macros.h>
+
+/* Length of the magic starting a binary session configuration document. */
+#define CONFIG_BINARY_MAGIC_LEN	8
+
+extern const char * const config_xml_true;
+extern const char * const config_xml_false;
+
+struct config_binary_writer;
+
 struct config_writer {
 	xmlTextWriterPtr writer;
+	/* Content of a buffered writer, NULL if it writes to a file. */
+	xmlBufferPtr buffer;
+	/* Writer of a binary document, in which case writer is NULL. */
+	struct config_binary_writer *binary;
+	unsigned int document_ended:1;
 };
+
+/* See session-config-binary.c for the binary format. */
+LTTNG_HIDDEN
+struct config_binary_writer *config_binary_writer_create(void);
+LTTNG_HIDDEN
+void config_binary_writer_destroy(struct config_binary_writer *writer);
+LTTNG_HIDDEN
+int config_binary_writer_open_element(struct config_binary_writer *writer,
+		const char *name);
+LTTNG_HIDDEN
+int config_binary_writer_close_element(struct config_binary_writer *writer);
+LTTNG_HIDDEN
+int config_binary_writer_write_attribute(struct config_binary_writer *writer,
+		const char *name, const char *value);
+LTTNG_HIDDEN
+int config_binary_writer_write_element_string(
+		struct config_binary_writer *writer, const char *name,
+		const char *value);
+LTTNG_HIDDEN
+int config_binary_writer_write_element_unsigned_int(
+		struct config_binary_writer *writer, const char *name,
+		uint64_t value);
+LTTNG_HIDDEN
+int config_binary_writer_write_element_signed_int(
+		struct config_binary_writer *writer, const char *name,
+		int64_t value);
+LTTNG_HIDDEN
+int config_binary_writer_write_element_bool(struct config_binary_writer *writer,
+		const char *name, int value);
+/* Write the whole document to a file. Returns 0 or a negative errno. */
+LTTNG_HIDDEN
+int config_binary_writer_write(struct config_binary_writer *writer,
+		int fd_output);
+
+/* Whether a buffer starts with the magic of a binary document. */
+LTTNG_HIDDEN
+bool config_binary_is_document(const char *buf, size_t len);
+/*
+ * Build the element tree of a binary document, to be freed with
+ * xmlFreeDoc(). Returns NULL if the document is invalid.
+ */
+LTTNG_HIDDEN
+xmlDocPtr config_binary_read_document(const char *buf, size_t len);
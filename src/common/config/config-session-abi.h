@@ -43,6 +43,8 @@ extern const char * const config_element_switch_timer_interval;
 extern const char * const config_element_read_timer_interval;
 extern const char * const config_element_monitor_timer_interval;
 extern const char * const config_element_blocking_timeout;
+extern const char * const config_element_compression;
+extern const char * const config_element_huge_pages;
 extern const char * const config_element_output;
 extern const char * const config_element_output_type;
 extern const char * const config_element_tracefile_size;
@@ -97,6 +99,9 @@ extern const char * const config_overwrite_mode_overwrite;
 extern const char * const config_output_type_splice;
 extern const char * const config_output_type_mmap;
 
+extern const char * const config_compression_none;
+extern const char * const config_compression_zlib;
+
 extern const char * const config_loglevel_type_all;
 extern const char * const config_loglevel_type_range;
 extern const char * const config_loglevel_type_single;
@@ -0,0 +1,576 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Compact binary session configuration format.
+ *
+ * The binary format holds the same element tree as the XML format, so that
+ * the session daemon saves it through the same configuration writer calls
+ * and the loader processes the same tree, but it is read without parsing
+ * text and without validating against the XSD.
+ *
+ * A document is a header followed by records until the end of the file:
+ *
+ *   header:	magic (8 bytes), version (uint32_t, little endian)
+ *   record:	OPEN name | CLOSE | ATTRIBUTE name string | STRING name string
+ *		| UINT name uvarint | SINT name svarint | BOOL name byte
+ *
+ * Each record starts with its type byte. A name is the uvarint index of a
+ * name already defined in the document, or the number of names defined so
+ * far followed by a string to define a new one. A string is its uvarint
+ * length followed by its bytes. The integers are LEB128-encoded, the signed
+ * ones after a zigzag encoding.
+ */
+
+#define _LGPL_SOURCE
+#include <assert.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <common/common.h>
+#include <common/compat/endian.h>
+#include <common/dynamic-buffer.h>
+#include <common/readwrite.h>
+
+#include "config-internal.h"
+
+#define CONFIG_BINARY_VERSION	1
+/* Maximal depth of the element tree of a document. */
+#define CONFIG_BINARY_MAX_DEPTH	64
+
+enum config_binary_record {
+	CONFIG_BINARY_OPEN	= 1,
+	CONFIG_BINARY_CLOSE	= 2,
+	CONFIG_BINARY_ATTRIBUTE	= 3,
+	CONFIG_BINARY_STRING	= 4,
+	CONFIG_BINARY_UINT	= 5,
+	CONFIG_BINARY_SINT	= 6,
+	CONFIG_BINARY_BOOL	= 7,
+};
+
+static const char config_binary_magic[CONFIG_BINARY_MAGIC_LEN] = "\177LTTNGSB";
+
+struct config_binary_writer {
+	struct lttng_dynamic_buffer buf;
+	/* Element names defined so far, in the order of their index. */
+	char **names;
+	uint64_t nr_names;
+	uint64_t alloc_names;
+	unsigned int depth;
+};
+
+static int append_byte(struct config_binary_writer *writer, uint8_t byte)
+{
+	return lttng_dynamic_buffer_append(&writer->buf, &byte, 1);
+}
+
+static int append_uvarint(struct config_binary_writer *writer, uint64_t value)
+{
+	uint8_t bytes[10];
+	size_t len = 0;
+
+	do {
+		bytes[len] = value & 0x7f;
+		value >>= 7;
+		if (value) {
+			bytes[len] |= 0x80;
+		}
+		len++;
+	} while (value);
+	return lttng_dynamic_buffer_append(&writer->buf, bytes, len);
+}
+
+static int append_string(struct config_binary_writer *writer,
+		const char *str)
+{
+	size_t len = strlen(str);
+	int ret;
+
+	ret = append_uvarint(writer, len);
+	if (ret) {
+		goto end;
+	}
+	ret = lttng_dynamic_buffer_append(&writer->buf, str, len);
+end:
+	return ret;
+}
+
+/*
+ * Append a record header: its type and the reference to its name, defining
+ * the name if it is new to the document.
+ */
+static int append_record(struct config_binary_writer *writer,
+		enum config_binary_record type, const char *name)
+{
+	int ret;
+	uint64_t i;
+
+	ret = append_byte(writer, type);
+	if (ret || !name) {
+		goto end;
+	}
+
+	for (i = 0; i < writer->nr_names; i++) {
+		if (!strcmp(writer->names[i], name)) {
+			ret = append_uvarint(writer, i);
+			goto end;
+		}
+	}
+
+	if (writer->nr_names == writer->alloc_names) {
+		char **new_names;
+		uint64_t new_alloc = max_t(uint64_t, writer->alloc_names << 1,
+				64);
+
+		new_names = realloc(writer->names,
+				new_alloc * sizeof(*new_names));
+		if (!new_names) {
+			PERROR("realloc binary configuration names");
+			ret = -1;
+			goto end;
+		}
+		writer->names = new_names;
+		writer->alloc_names = new_alloc;
+	}
+	writer->names[writer->nr_names] = strdup(name);
+	if (!writer->names[writer->nr_names]) {
+		PERROR("strdup binary configuration name");
+		ret = -1;
+		goto end;
+	}
+	ret = append_uvarint(writer, writer->nr_names++);
+	if (ret) {
+		goto end;
+	}
+	ret = append_string(writer, name);
+end:
+	return ret;
+}
+
+LTTNG_HIDDEN
+struct config_binary_writer *config_binary_writer_create(void)
+{
+	uint32_t version = htole32(CONFIG_BINARY_VERSION);
+	struct config_binary_writer *writer;
+
+	writer = zmalloc(sizeof(*writer));
+	if (!writer) {
+		PERROR("zmalloc config_binary_writer");
+		goto end;
+	}
+	lttng_dynamic_buffer_init(&writer->buf);
+	if (lttng_dynamic_buffer_append(&writer->buf, config_binary_magic,
+				sizeof(config_binary_magic)) ||
+			lttng_dynamic_buffer_append(&writer->buf, &version,
+				sizeof(version))) {
+		config_binary_writer_destroy(writer);
+		writer = NULL;
+	}
+end:
+	return writer;
+}
+
+LTTNG_HIDDEN
+void config_binary_writer_destroy(struct config_binary_writer *writer)
+{
+	uint64_t i;
+
+	if (!writer) {
+		return;
+	}
+	for (i = 0; i < writer->nr_names; i++) {
+		free(writer->names[i]);
+	}
+	free(writer->names);
+	lttng_dynamic_buffer_reset(&writer->buf);
+	free(writer);
+}
+
+LTTNG_HIDDEN
+int config_binary_writer_open_element(struct config_binary_writer *writer,
+		const char *name)
+{
+	int ret;
+
+	ret = append_record(writer, CONFIG_BINARY_OPEN, name);
+	if (!ret) {
+		writer->depth++;
+	}
+	return ret;
+}
+
+LTTNG_HIDDEN
+int config_binary_writer_close_element(struct config_binary_writer *writer)
+{
+	int ret;
+
+	if (!writer->depth) {
+		ret = -1;
+		goto end;
+	}
+	ret = append_record(writer, CONFIG_BINARY_CLOSE, NULL);
+	if (!ret) {
+		writer->depth--;
+	}
+end:
+	return ret;
+}
+
+LTTNG_HIDDEN
+int config_binary_writer_write_attribute(struct config_binary_writer *writer,
+		const char *name, const char *value)
+{
+	int ret;
+
+	ret = append_record(writer, CONFIG_BINARY_ATTRIBUTE, name);
+	if (ret) {
+		goto end;
+	}
+	ret = append_string(writer, value);
+end:
+	return ret;
+}
+
+LTTNG_HIDDEN
+int config_binary_writer_write_element_string(
+		struct config_binary_writer *writer, const char *name,
+		const char *value)
+{
+	int ret;
+
+	ret = append_record(writer, CONFIG_BINARY_STRING, name);
+	if (ret) {
+		goto end;
+	}
+	ret = append_string(writer, value);
+end:
+	return ret;
+}
+
+LTTNG_HIDDEN
+int config_binary_writer_write_element_unsigned_int(
+		struct config_binary_writer *writer, const char *name,
+		uint64_t value)
+{
+	int ret;
+
+	ret = append_record(writer, CONFIG_BINARY_UINT, name);
+	if (ret) {
+		goto end;
+	}
+	ret = append_uvarint(writer, value);
+end:
+	return ret;
+}
+
+LTTNG_HIDDEN
+int config_binary_writer_write_element_signed_int(
+		struct config_binary_writer *writer, const char *name,
+		int64_t value)
+{
+	int ret;
+
+	ret = append_record(writer, CONFIG_BINARY_SINT, name);
+	if (ret) {
+		goto end;
+	}
+	/* Zigzag encoding: small magnitudes take few bytes. */
+	ret = append_uvarint(writer,
+			((uint64_t) value << 1) ^ (uint64_t) (value >> 63));
+end:
+	return ret;
+}
+
+LTTNG_HIDDEN
+int config_binary_writer_write_element_bool(struct config_binary_writer *writer,
+		const char *name, int value)
+{
+	int ret;
+
+	ret = append_record(writer, CONFIG_BINARY_BOOL, name);
+	if (ret) {
+		goto end;
+	}
+	ret = append_byte(writer, !!value);
+end:
+	return ret;
+}
+
+LTTNG_HIDDEN
+int config_binary_writer_write(struct config_binary_writer *writer,
+		int fd_output)
+{
+	int ret = 0;
+	ssize_t len;
+
+	if (writer->depth) {
+		ERR("Binary configuration document has unclosed elements");
+		ret = -EINVAL;
+		goto end;
+	}
+	len = lttng_write(fd_output, writer->buf.data, writer->buf.size);
+	if (len != writer->buf.size) {
+		PERROR("Writing binary configuration document");
+		ret = -EIO;
+	}
+end:
+	return ret;
+}
+
+LTTNG_HIDDEN
+bool config_binary_is_document(const char *buf, size_t len)
+{
+	return len >= CONFIG_BINARY_MAGIC_LEN &&
+			!memcmp(buf, config_binary_magic, CONFIG_BINARY_MAGIC_LEN);
+}
+
+struct config_binary_reader {
+	const uint8_t *pos;
+	const uint8_t *end;
+	/* Element names defined so far, pointing in the document. */
+	const uint8_t **names;
+	uint64_t *name_lens;
+	uint64_t nr_names;
+	uint64_t alloc_names;
+};
+
+static int read_uvarint(struct config_binary_reader *reader, uint64_t *value)
+{
+	unsigned int shift = 0;
+
+	*value = 0;
+	while (reader->pos < reader->end && shift < 64) {
+		uint8_t byte = *reader->pos++;
+
+		*value |= (uint64_t) (byte & 0x7f) << shift;
+		if (!(byte & 0x80)) {
+			return 0;
+		}
+		shift += 7;
+	}
+	return -1;
+}
+
+static int read_string(struct config_binary_reader *reader,
+		const uint8_t **str, uint64_t *len)
+{
+	if (read_uvarint(reader, len) ||
+			*len > (uint64_t) (reader->end - reader->pos)) {
+		return -1;
+	}
+	*str = reader->pos;
+	reader->pos += *len;
+	return 0;
+}
+
+/* Return the name of a record as a string to be freed with xmlFree(). */
+static xmlChar *read_name(struct config_binary_reader *reader)
+{
+	uint64_t index;
+	const uint8_t *name;
+	uint64_t len;
+
+	if (read_uvarint(reader, &index) || index > reader->nr_names) {
+		return NULL;
+	}
+	if (index < reader->nr_names) {
+		return xmlStrndup(reader->names[index],
+				reader->name_lens[index]);
+	}
+
+	if (read_string(reader, &name, &len) || !len || len > INT_MAX) {
+		return NULL;
+	}
+	if (reader->nr_names == reader->alloc_names) {
+		const uint8_t **new_names;
+		uint64_t *new_lens;
+		uint64_t new_alloc = max_t(uint64_t, reader->alloc_names << 1,
+				64);
+
+		new_names = realloc(reader->names,
+				new_alloc * sizeof(*new_names));
+		if (!new_names) {
+			return NULL;
+		}
+		reader->names = new_names;
+		new_lens = realloc(reader->name_lens,
+				new_alloc * sizeof(*new_lens));
+		if (!new_lens) {
+			return NULL;
+		}
+		reader->name_lens = new_lens;
+		reader->alloc_names = new_alloc;
+	}
+	reader->names[reader->nr_names] = name;
+	reader->name_lens[reader->nr_names++] = len;
+	return xmlStrndup(name, len);
+}
+
+/* Read the value of a record as a string to be freed with xmlFree(). */
+static xmlChar *read_value(struct config_binary_reader *reader,
+		enum config_binary_record type)
+{
+	char str[24];
+	uint64_t value, len;
+	const uint8_t *value_str;
+
+	switch (type) {
+	case CONFIG_BINARY_ATTRIBUTE:
+	case CONFIG_BINARY_STRING:
+		if (read_string(reader, &value_str, &len) || len > INT_MAX) {
+			return NULL;
+		}
+		return xmlStrndup(value_str, len);
+	case CONFIG_BINARY_UINT:
+		if (read_uvarint(reader, &value)) {
+			return NULL;
+		}
+		snprintf(str, sizeof(str), "%" PRIu64, value);
+		break;
+	case CONFIG_BINARY_SINT:
+		if (read_uvarint(reader, &value)) {
+			return NULL;
+		}
+		snprintf(str, sizeof(str), "%" PRIi64,
+				(int64_t) ((value >> 1) ^ -(value & 1)));
+		break;
+	case CONFIG_BINARY_BOOL:
+		if (reader->pos >= reader->end) {
+			return NULL;
+		}
+		strcpy(str, *reader->pos++ ? config_xml_true : config_xml_false);
+		break;
+	default:
+		return NULL;
+	}
+	return xmlStrdup(BAD_CAST str);
+}
+
+LTTNG_HIDDEN
+xmlDocPtr config_binary_read_document(const char *buf, size_t len)
+{
+	uint32_t version;
+	unsigned int depth = 0;
+	xmlDocPtr doc = NULL;
+	xmlNodePtr node = NULL;
+	struct config_binary_reader reader = { 0 };
+
+	if (!config_binary_is_document(buf, len) ||
+			len < CONFIG_BINARY_MAGIC_LEN + sizeof(version)) {
+		ERR("Invalid binary session configuration header");
+		goto error;
+	}
+	memcpy(&version, buf + CONFIG_BINARY_MAGIC_LEN, sizeof(version));
+	version = le32toh(version);
+	if (version != CONFIG_BINARY_VERSION) {
+		ERR("Unsupported binary session configuration version %" PRIu32,
+				version);
+		goto error;
+	}
+	reader.pos = (const uint8_t *) buf + CONFIG_BINARY_MAGIC_LEN +
+			sizeof(version);
+	reader.end = (const uint8_t *) buf + len;
+
+	doc = xmlNewDoc(BAD_CAST "1.0");
+	if (!doc) {
+		goto error;
+	}
+
+	while (reader.pos < reader.end) {
+		enum config_binary_record type = *reader.pos++;
+		xmlChar *name, *value;
+		xmlNodePtr child;
+
+		if (type == CONFIG_BINARY_CLOSE) {
+			if (!depth) {
+				goto invalid;
+			}
+			node = node->parent;
+			if (!--depth) {
+				/* The root element is closed. */
+				break;
+			}
+			continue;
+		}
+
+		if (!depth && (type != CONFIG_BINARY_OPEN ||
+				xmlDocGetRootElement(doc))) {
+			goto invalid;
+		}
+		name = read_name(&reader);
+		if (!name) {
+			goto invalid;
+		}
+
+		if (type == CONFIG_BINARY_OPEN) {
+			if (depth == CONFIG_BINARY_MAX_DEPTH) {
+				xmlFree(name);
+				goto invalid;
+			}
+			if (depth) {
+				child = xmlNewChild(node, NULL, name, NULL);
+			} else {
+				child = xmlNewDocNode(doc, NULL, name, NULL);
+				if (child) {
+					xmlDocSetRootElement(doc, child);
+				}
+			}
+			xmlFree(name);
+			if (!child) {
+				goto error;
+			}
+			node = child;
+			depth++;
+			continue;
+		}
+
+		value = read_value(&reader, type);
+		if (!value) {
+			xmlFree(name);
+			goto invalid;
+		}
+		if (type == CONFIG_BINARY_ATTRIBUTE) {
+			child = (xmlNodePtr) xmlNewProp(node, name, value);
+		} else {
+			child = xmlNewTextChild(node, NULL, name, value);
+		}
+		xmlFree(name);
+		xmlFree(value);
+		if (!child) {
+			goto error;
+		}
+	}
+	if (depth || reader.pos != reader.end || !xmlDocGetRootElement(doc)) {
+		goto invalid;
+	}
+
+	free(reader.names);
+	free(reader.name_lens);
+	return doc;
+
+invalid:
+	ERR("Invalid binary session configuration document");
+error:
+	free(reader.names);
+	free(reader.name_lens);
+	if (doc) {
+		xmlFreeDoc(doc);
+	}
+	return NULL;
+}
@@ -23,21 +23,27 @@
 #include <string.h>
 #include <inttypes.h>
 #include <dirent.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <stdbool.h>
+#include <pthread.h>
+#include <urcu/uatomic.h>
 
 #include <common/defaults.h>
 #include <common/error.h>
 #include <common/macros.h>
 #include <common/utils.h>
+#include <common/readwrite.h>
+#include <common/dynamic-buffer.h>
 #include <common/compat/getenv.h>
 #include <lttng/lttng-error.h>
 #include <libxml/parser.h>
 #include <libxml/valid.h>
 #include <libxml/xmlschemas.h>
 #include <libxml/tree.h>
+#include <libxml/xmlreader.h>
 #include <lttng/lttng.h>
 #include <lttng/snapshot.h>
 
@@ -93,6 +99,8 @@ const char * const config_element_switch_timer_interval = "switch_timer_interval
 const char * const config_element_read_timer_interval = "read_timer_interval";
 LTTNG_HIDDEN const char * const config_element_monitor_timer_interval = "monitor_timer_interval";
 LTTNG_HIDDEN const char * const config_element_blocking_timeout = "blocking_timeout";
+LTTNG_HIDDEN const char * const config_element_compression = "compression";
+LTTNG_HIDDEN const char * const config_element_huge_pages = "huge_pages";
 const char * const config_element_output = "output";
 const char * const config_element_output_type = "output_type";
 const char * const config_element_tracefile_size = "tracefile_size";
@@ -147,6 +155,9 @@ const char * const config_overwrite_mode_overwrite = "OVERWRITE";
 const char * const config_output_type_splice = "SPLICE";
 const char * const config_output_type_mmap = "MMAP";
 
+LTTNG_HIDDEN const char * const config_compression_none = "NONE";
+LTTNG_HIDDEN const char * const config_compression_zlib = "ZLIB";
+
 const char * const config_loglevel_type_all = "ALL";
 const char * const config_loglevel_type_range = "RANGE";
 const char * const config_loglevel_type_single = "SINGLE";
@@ -383,6 +394,32 @@ end:
 	return out_str;
 }
 
+static int start_document(struct config_writer *writer, int indent)
+{
+	int ret;
+
+	if (!writer->writer) {
+		ret = -1;
+		goto end;
+	}
+
+	ret = xmlTextWriterStartDocument(writer->writer, NULL,
+		config_xml_encoding, NULL);
+	if (ret < 0) {
+		goto end;
+	}
+
+	ret = xmlTextWriterSetIndentString(writer->writer,
+		BAD_CAST config_xml_indent_string);
+	if (ret) {
+		goto end;
+	}
+
+	ret = xmlTextWriterSetIndent(writer->writer, indent);
+end:
+	return ret;
+}
+
 LTTNG_HIDDEN
 struct config_writer *config_writer_create(int fd_output, int indent)
 {
@@ -402,19 +439,37 @@ struct config_writer *config_writer_create(int fd_output, int indent)
 	}
 
 	writer->writer = xmlNewTextWriter(buffer);
-	ret = xmlTextWriterStartDocument(writer->writer, NULL,
-		config_xml_encoding, NULL);
-	if (ret < 0) {
+	ret = start_document(writer, indent);
+	if (ret) {
 		goto error_destroy;
 	}
 
-	ret = xmlTextWriterSetIndentString(writer->writer,
-		BAD_CAST config_xml_indent_string);
-	if (ret) {
+end:
+	return writer;
+error_destroy:
+	config_writer_destroy(writer);
+	return NULL;
+}
+
+LTTNG_HIDDEN
+struct config_writer *config_writer_create_buffer(int indent)
+{
+	int ret;
+	struct config_writer *writer;
+
+	writer = zmalloc(sizeof(struct config_writer));
+	if (!writer) {
+		PERROR("zmalloc config_writer_create_buffer");
+		goto end;
+	}
+
+	writer->buffer = xmlBufferCreate();
+	if (!writer->buffer) {
 		goto error_destroy;
 	}
 
-	ret = xmlTextWriterSetIndent(writer->writer, indent);
+	writer->writer = xmlNewTextWriterMemory(writer->buffer, 0);
+	ret = start_document(writer, indent);
 	if (ret) {
 		goto error_destroy;
 	}
@@ -426,6 +481,62 @@ error_destroy:
 	return NULL;
 }
 
+LTTNG_HIDDEN
+struct config_writer *config_writer_create_binary(void)
+{
+	struct config_writer *writer;
+
+	writer = zmalloc(sizeof(struct config_writer));
+	if (!writer) {
+		PERROR("zmalloc config_writer_create_binary");
+		goto end;
+	}
+
+	writer->binary = config_binary_writer_create();
+	if (!writer->binary) {
+		free(writer);
+		writer = NULL;
+	}
+end:
+	return writer;
+}
+
+LTTNG_HIDDEN
+int config_writer_write_buffer(struct config_writer *writer, int fd_output)
+{
+	int ret = 0;
+	ssize_t len;
+
+	if (writer && writer->binary && !writer->document_ended) {
+		writer->document_ended = 1;
+		ret = config_binary_writer_write(writer->binary, fd_output);
+		goto end;
+	}
+
+	if (!writer || !writer->writer || !writer->buffer ||
+			writer->document_ended) {
+		ret = -EINVAL;
+		goto end;
+	}
+
+	writer->document_ended = 1;
+	if (xmlTextWriterEndDocument(writer->writer) < 0 ||
+			xmlTextWriterFlush(writer->writer) < 0) {
+		WARN("Could not close XML document");
+		ret = -EIO;
+		goto end;
+	}
+
+	len = lttng_write(fd_output, xmlBufferContent(writer->buffer),
+			xmlBufferLength(writer->buffer));
+	if (len != xmlBufferLength(writer->buffer)) {
+		PERROR("Writing XML document");
+		ret = -EIO;
+	}
+end:
+	return ret;
+}
+
 LTTNG_HIDDEN
 int config_writer_destroy(struct config_writer *writer)
 {
@@ -436,7 +547,10 @@ int config_writer_destroy(struct config_writer *writer)
 		goto end;
 	}
 
-	if (xmlTextWriterEndDocument(writer->writer) < 0) {
+	if (writer->binary) {
+		config_binary_writer_destroy(writer->binary);
+	} else if (!writer->document_ended &&
+			xmlTextWriterEndDocument(writer->writer) < 0) {
 		WARN("Could not close XML document");
 		ret = -EIO;
 	}
@@ -444,6 +558,9 @@ int config_writer_destroy(struct config_writer *writer)
 	if (writer->writer) {
 		xmlFreeTextWriter(writer->writer);
 	}
+	if (writer->buffer) {
+		xmlBufferFree(writer->buffer);
+	}
 
 	free(writer);
 end:
@@ -457,6 +574,12 @@ int config_writer_open_element(struct config_writer *writer,
 	int ret;
 	xmlChar *encoded_element_name;
 
+	if (writer && writer->binary && element_name && element_name[0]) {
+		ret = config_binary_writer_open_element(writer->binary,
+				element_name);
+		goto end;
+	}
+
 	if (!writer || !writer->writer || !element_name || !element_name[0]) {
 		ret = -1;
 		goto end;
@@ -482,6 +605,12 @@ int config_writer_write_attribute(struct config_writer *writer,
 	xmlChar *encoded_name = NULL;
 	xmlChar *encoded_value = NULL;
 
+	if (writer && writer->binary && name && name[0] && value) {
+		ret = config_binary_writer_write_attribute(writer->binary,
+				name, value);
+		goto end;
+	}
+
 	if (!writer || !writer->writer || !name || !name[0]) {
 		ret = -1;
 		goto end;
@@ -512,6 +641,11 @@ int config_writer_close_element(struct config_writer *writer)
 {
 	int ret;
 
+	if (writer && writer->binary) {
+		ret = config_binary_writer_close_element(writer->binary);
+		goto end;
+	}
+
 	if (!writer || !writer->writer) {
 		ret = -1;
 		goto end;
@@ -529,6 +663,12 @@ int config_writer_write_element_unsigned_int(struct config_writer *writer,
 	int ret;
 	xmlChar *encoded_element_name;
 
+	if (writer && writer->binary && element_name && element_name[0]) {
+		ret = config_binary_writer_write_element_unsigned_int(
+				writer->binary, element_name, value);
+		goto end;
+	}
+
 	if (!writer || !writer->writer || !element_name || !element_name[0]) {
 		ret = -1;
 		goto end;
@@ -554,6 +694,12 @@ int config_writer_write_element_signed_int(struct config_writer *writer,
 	int ret;
 	xmlChar *encoded_element_name;
 
+	if (writer && writer->binary && element_name && element_name[0]) {
+		ret = config_binary_writer_write_element_signed_int(
+				writer->binary, element_name, value);
+		goto end;
+	}
+
 	if (!writer || !writer->writer || !element_name || !element_name[0]) {
 		ret = -1;
 		goto end;
@@ -576,6 +722,10 @@ LTTNG_HIDDEN
 int config_writer_write_element_bool(struct config_writer *writer,
 		const char *element_name, int value)
 {
+	if (writer && writer->binary && element_name && element_name[0]) {
+		return config_binary_writer_write_element_bool(writer->binary,
+				element_name, value) >= 0 ? 0 : -1;
+	}
 	return config_writer_write_element_string(writer, element_name,
 		value ? config_xml_true : config_xml_false);
 }
@@ -588,6 +738,13 @@ int config_writer_write_element_string(struct config_writer *writer,
 	xmlChar *encoded_element_name = NULL;
 	xmlChar *encoded_value = NULL;
 
+	if (writer && writer->binary && element_name && element_name[0] &&
+			value) {
+		ret = config_binary_writer_write_element_string(writer->binary,
+				element_name, value);
+		goto end;
+	}
+
 	if (!writer || !writer->writer || !element_name || !element_name[0] ||
 		!value) {
 		ret = -1;
@@ -895,6 +1052,28 @@ error:
 	return -1;
 }
 
+static
+int get_compression(xmlChar *compression)
+{
+	int ret;
+
+	if (!compression) {
+		goto error;
+	}
+
+	if (!strcmp((char *) compression, config_compression_none)) {
+		ret = LTTNG_CHANNEL_COMPRESSION_NONE;
+	} else if (!strcmp((char *) compression, config_compression_zlib)) {
+		ret = LTTNG_CHANNEL_COMPRESSION_ZLIB;
+	} else {
+		goto error;
+	}
+
+	return ret;
+error:
+	return -1;
+}
+
 static
 int get_event_type(xmlChar *event_type)
 {
@@ -2130,6 +2309,54 @@ int process_channel_attr_node(xmlNodePtr attr_node,
 			ret = -LTTNG_ERR_LOAD_INVALID_CONFIG;
 			goto end;
 		}
+	} else if (!strcmp((const char *) attr_node->name,
+			config_element_compression)) {
+		xmlChar *content;
+		int compression;
+
+		/* compression */
+		content = xmlNodeGetContent(attr_node);
+		if (!content) {
+			ret = -LTTNG_ERR_NOMEM;
+			goto end;
+		}
+
+		compression = get_compression(content);
+		free(content);
+		if (compression < 0) {
+			ret = -LTTNG_ERR_LOAD_INVALID_CONFIG;
+			goto end;
+		}
+
+		ret = lttng_channel_set_compression(channel, compression);
+		if (ret) {
+			ret = -LTTNG_ERR_LOAD_INVALID_CONFIG;
+			goto end;
+		}
+	} else if (!strcmp((const char *) attr_node->name,
+			config_element_huge_pages)) {
+		xmlChar *content;
+		int huge_pages;
+
+		/* huge_pages */
+		content = xmlNodeGetContent(attr_node);
+		if (!content) {
+			ret = -LTTNG_ERR_NOMEM;
+			goto end;
+		}
+
+		ret = parse_bool(content, &huge_pages);
+		free(content);
+		if (ret) {
+			ret = -LTTNG_ERR_LOAD_INVALID_CONFIG;
+			goto end;
+		}
+
+		ret = lttng_channel_set_huge_pages(channel, huge_pages);
+		if (ret) {
+			ret = -LTTNG_ERR_LOAD_INVALID_CONFIG;
+			goto end;
+		}
 	} else if (!strcmp((const char *) attr_node->name,
 			config_element_events)) {
 		/* events */
@@ -2794,15 +3021,230 @@ valid:
 	return 1;
 }
 
+/*
+ * Validate a session configuration document against the XSD while reading it
+ * as a stream, without building its tree. The reader is freed.
+ *
+ * Return 0 on success or else a negative LTTNG_ERR code.
+ */
+static
+int validate_reader(xmlTextReaderPtr reader,
+	struct session_config_validation_ctx *validation_ctx)
+{
+	int ret;
+
+	if (!reader) {
+		ret = -LTTNG_ERR_LOAD_IO_FAIL;
+		goto end;
+	}
+
+	ret = xmlTextReaderSchemaValidateCtxt(reader,
+		validation_ctx->schema_validation_ctx, 0);
+	if (ret) {
+		ERR("XSD validation context creation failed");
+		ret = -LTTNG_ERR_LOAD_INVALID_CONFIG;
+		goto end;
+	}
+
+	do {
+		ret = xmlTextReaderRead(reader);
+	} while (ret == 1);
+	if (ret < 0) {
+		ret = -LTTNG_ERR_LOAD_IO_FAIL;
+		goto end;
+	}
+
+	if (xmlTextReaderIsValid(reader) != 1) {
+		ERR("Session configuration file validation failed");
+		ret = -LTTNG_ERR_LOAD_INVALID_CONFIG;
+		goto end;
+	}
+	ret = 0;
+end:
+	xmlFreeTextReader(reader);
+	return ret;
+}
+
+/*
+ * Load the sessions of a session configuration document read as a stream:
+ * only the session being processed is kept in memory. The reader is freed.
+ */
+static
+int load_session_from_reader(xmlTextReaderPtr reader, const char *session_name,
+	int overwrite, const struct config_load_session_override_attr *overrides)
+{
+	int ret, load_ret = 0, session_found = !session_name;
+
+	if (!reader) {
+		ret = -LTTNG_ERR_LOAD_IO_FAIL;
+		goto end;
+	}
+
+	/* The session nodes are the children of the root sessions node. */
+	ret = xmlTextReaderRead(reader);
+	while (ret == 1) {
+		xmlNodePtr session_node;
+
+		if (xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT ||
+				xmlTextReaderDepth(reader) != 1) {
+			ret = xmlTextReaderRead(reader);
+			continue;
+		}
+
+		session_node = xmlTextReaderExpand(reader);
+		if (!session_node) {
+			ret = -1;
+			break;
+		}
+		load_ret = process_session_node(session_node,
+			session_name, overwrite, overrides);
+		if (session_name && load_ret == 0) {
+			/* Target session found and loaded */
+			session_found = 1;
+			break;
+		}
+
+		/* Skip to the next session, releasing this one. */
+		ret = xmlTextReaderNext(reader);
+	}
+	if (ret < 0) {
+		ret = -LTTNG_ERR_LOAD_IO_FAIL;
+		goto end;
+	}
+	ret = load_ret;
+end:
+	xmlFreeTextReader(reader);
+	if (!ret) {
+		ret = session_found ? 0 : -LTTNG_ERR_LOAD_SESSION_NOENT;
+	}
+	return ret;
+}
+
+/*
+ * Read a configuration file if it is a binary document.
+ *
+ * Return 1 and the content of the file in "*buf", to be freed by the caller,
+ * if it is a binary document, 0 if it is not, or else a negative LTTNG_ERR
+ * code.
+ */
+static
+int read_binary_file(const char *path, char **buf, size_t *len)
+{
+	int fd, ret;
+	struct stat st;
+	char magic[CONFIG_BINARY_MAGIC_LEN];
+	ssize_t read_len;
+
+	*buf = NULL;
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		PERROR("open %s", path);
+		ret = -LTTNG_ERR_LOAD_IO_FAIL;
+		goto end;
+	}
+
+	read_len = lttng_read(fd, magic, sizeof(magic));
+	if (read_len != sizeof(magic) ||
+			!config_binary_is_document(magic, sizeof(magic))) {
+		ret = 0;
+		goto end;
+	}
+
+	if (fstat(fd, &st) < 0) {
+		PERROR("fstat %s", path);
+		ret = -LTTNG_ERR_LOAD_IO_FAIL;
+		goto end;
+	}
+	*len = st.st_size;
+	*buf = zmalloc(*len);
+	if (!*buf) {
+		ret = -LTTNG_ERR_NOMEM;
+		goto end;
+	}
+	memcpy(*buf, magic, sizeof(magic));
+	read_len = lttng_read(fd, *buf + sizeof(magic), *len - sizeof(magic));
+	if (read_len != *len - sizeof(magic)) {
+		PERROR("read %s", path);
+		free(*buf);
+		*buf = NULL;
+		ret = -LTTNG_ERR_LOAD_IO_FAIL;
+		goto end;
+	}
+	ret = 1;
+end:
+	if (fd >= 0 && close(fd)) {
+		PERROR("close");
+	}
+	return ret;
+}
+
+/*
+ * Load the sessions of a binary configuration document, its element tree
+ * being validated first unless the validation context holds no schema.
+ */
+static
+int load_session_from_binary(const char *buf, size_t len,
+	const char *session_name,
+	struct session_config_validation_ctx *validation_ctx, int overwrite,
+	const struct config_load_session_override_attr *overrides)
+{
+	int ret = 0, session_found = !session_name;
+	xmlDocPtr doc;
+	xmlNodePtr root, session_node;
+
+	doc = config_binary_read_document(buf, len);
+	if (!doc) {
+		ret = -LTTNG_ERR_LOAD_INVALID_CONFIG;
+		goto end;
+	}
+
+	root = xmlDocGetRootElement(doc);
+	if (xmlStrcmp(root->name, (const xmlChar *) config_element_sessions)) {
+		ERR("Binary session configuration has no sessions element");
+		ret = -LTTNG_ERR_LOAD_INVALID_CONFIG;
+		goto end;
+	}
+
+	if (validation_ctx->schema_validation_ctx &&
+			xmlSchemaValidateDoc(
+				validation_ctx->schema_validation_ctx, doc)) {
+		ERR("Session configuration file validation failed");
+		ret = -LTTNG_ERR_LOAD_INVALID_CONFIG;
+		goto end;
+	}
+
+	for (session_node = xmlFirstElementChild(root); session_node;
+			session_node = xmlNextElementSibling(session_node)) {
+		ret = process_session_node(session_node, session_name,
+			overwrite, overrides);
+		if (session_name && ret == 0) {
+			/* Target session found and loaded */
+			session_found = 1;
+			break;
+		}
+	}
+	if (!ret) {
+		ret = session_found ? 0 : -LTTNG_ERR_LOAD_SESSION_NOENT;
+	}
+end:
+	if (doc) {
+		xmlFreeDoc(doc);
+	}
+	return ret;
+}
+
+/*
+ * Load the sessions of a configuration file, validated first unless the
+ * validation context holds no schema.
+ */
 static
 int load_session_from_file(const char *path, const char *session_name,
 	struct session_config_validation_ctx *validation_ctx, int overwrite,
 	const struct config_load_session_override_attr *overrides)
 {
-	int ret, session_found = !session_name;
-	xmlDocPtr doc = NULL;
-	xmlNodePtr sessions_node;
-	xmlNodePtr session_node;
+	int ret;
+	char *binary_buf;
+	size_t binary_len;
 
 	assert(path);
 	assert(validation_ctx);
@@ -2817,40 +3259,156 @@ int load_session_from_file(const char *path, const char *session_name,
 		goto end;
 	}
 
-	doc = xmlParseFile(path);
-	if (!doc) {
-		ret = -LTTNG_ERR_LOAD_IO_FAIL;
+	ret = read_binary_file(path, &binary_buf, &binary_len);
+	if (ret < 0) {
+		goto end;
+	} else if (ret == 1) {
+		ret = load_session_from_binary(binary_buf, binary_len,
+			session_name, validation_ctx, overwrite, overrides);
+		free(binary_buf);
 		goto end;
 	}
 
-	ret = xmlSchemaValidateDoc(validation_ctx->schema_validation_ctx, doc);
-	if (ret) {
-		ERR("Session configuration file validation failed");
-		ret = -LTTNG_ERR_LOAD_INVALID_CONFIG;
-		goto end;
+	if (validation_ctx->schema_validation_ctx) {
+		ret = validate_reader(xmlReaderForFile(path, NULL, 0),
+			validation_ctx);
+		if (ret) {
+			goto end;
+		}
+	}
+
+	ret = load_session_from_reader(
+		xmlReaderForFile(path, NULL, XML_PARSE_NOBLANKS),
+		session_name, overwrite, overrides);
+end:
+	return ret;
+}
+
+/* Configuration files of a directory shared by the load workers. */
+struct load_work {
+	char **paths;
+	unsigned long nr_paths;
+	/* Index of the next file to load. */
+	unsigned long next;
+	/* Result of the load of each file. */
+	int *rets;
+	/* Shared schema, NULL if the files are not validated. */
+	xmlSchemaPtr schema;
+	int overwrite;
+	const struct config_load_session_override_attr *overrides;
+};
+
+/*
+ * Load the files of a directory until none is left.
+ */
+static
+void load_work_run(struct load_work *work)
+{
+	struct session_config_validation_ctx validation_ctx = { 0 };
+
+	if (work->schema) {
+		/* A schema validation context can't be shared between threads. */
+		validation_ctx.schema_validation_ctx =
+			xmlSchemaNewValidCtxt(work->schema);
+		if (validation_ctx.schema_validation_ctx) {
+			xmlSchemaSetValidErrors(validation_ctx.schema_validation_ctx,
+				xml_error_handler, xml_error_handler, NULL);
+		} else {
+			ERR("XSD validation context creation failed");
+		}
+	}
+
+	for (;;) {
+		unsigned long i;
+
+		i = uatomic_add_return(&work->next, 1) - 1;
+		if (i >= work->nr_paths) {
+			break;
+		}
+		if (work->schema && !validation_ctx.schema_validation_ctx) {
+			work->rets[i] = -LTTNG_ERR_LOAD_INVALID_CONFIG;
+			continue;
+		}
+		work->rets[i] = load_session_from_file(work->paths[i], NULL,
+			&validation_ctx, work->overwrite, work->overrides);
+	}
+
+	if (validation_ctx.schema_validation_ctx) {
+		xmlSchemaFreeValidCtxt(validation_ctx.schema_validation_ctx);
 	}
+}
+
+static
+void *thread_load_files(void *data)
+{
+	load_work_run(data);
+	return NULL;
+}
 
-	sessions_node = xmlDocGetRootElement(doc);
-	if (!sessions_node) {
+/*
+ * Load every session of the configuration files "paths" on up to
+ * "nr_threads" threads, the calling thread included.
+ *
+ * Return the result of the load of the last file, as the sequential load of
+ * a directory does.
+ */
+static
+int load_files(char **paths, unsigned long nr_paths,
+	struct session_config_validation_ctx *validation_ctx, int overwrite,
+	const struct config_load_session_override_attr *overrides,
+	unsigned int nr_threads)
+{
+	int ret;
+	unsigned int i, nr_started = 0;
+	pthread_t *threads = NULL;
+	struct load_work work = {
+		.paths = paths,
+		.nr_paths = nr_paths,
+		.schema = validation_ctx->schema,
+		.overwrite = overwrite,
+		.overrides = overrides,
+	};
+
+	work.rets = zmalloc(nr_paths * sizeof(*work.rets));
+	if (!work.rets) {
+		ret = -LTTNG_ERR_NOMEM;
 		goto end;
 	}
 
-	for (session_node = xmlFirstElementChild(sessions_node);
-		session_node; session_node =
-			xmlNextElementSibling(session_node)) {
-		ret = process_session_node(session_node,
-			session_name, overwrite, overrides);
-		if (session_name && ret == 0) {
-			/* Target session found and loaded */
-			session_found = 1;
+	nr_threads = min_t(unsigned long, nr_threads, nr_paths);
+	if (nr_threads > 1) {
+		threads = zmalloc((nr_threads - 1) * sizeof(*threads));
+		if (!threads) {
+			PERROR("zmalloc load threads");
+		}
+	}
+	for (i = 0; threads && i < nr_threads - 1; i++) {
+		ret = pthread_create(&threads[i], NULL, thread_load_files, &work);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_create load thread");
+			/* Load with the threads started so far. */
 			break;
 		}
+		nr_started++;
 	}
-end:
-	xmlFreeDoc(doc);
-	if (!ret) {
-		ret = session_found ? 0 : -LTTNG_ERR_LOAD_SESSION_NOENT;
+	DBG("Loading %lu session configuration files with %u thread(s)",
+		nr_paths, nr_started + 1);
+
+	load_work_run(&work);
+
+	for (i = 0; i < nr_started; i++) {
+		ret = pthread_join(threads[i], NULL);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_join load thread");
+		}
 	}
+	free(threads);
+
+	ret = work.rets[nr_paths - 1];
+	free(work.rets);
+end:
 	return ret;
 }
 
@@ -2874,10 +3432,14 @@ struct dirent *alloc_dirent(const char *path)
 static
 int load_session_from_path(const char *path, const char *session_name,
 	struct session_config_validation_ctx *validation_ctx, int overwrite,
-	const struct config_load_session_override_attr *overrides)
+	const struct config_load_session_override_attr *overrides,
+	unsigned int nr_threads)
 {
 	int ret, session_found = !session_name;
 	DIR *directory = NULL;
+	struct lttng_dynamic_buffer paths;
+
+	lttng_dynamic_buffer_init(&paths);
 
 	assert(path);
 	assert(validation_ctx);
@@ -2948,6 +3510,21 @@ int load_session_from_path(const char *path, const char *session_name,
 			strncpy(file_path + path_len, result->d_name, file_name_len);
 			file_path[path_len + file_name_len] = '\0';
 
+			if (!session_name && nr_threads > 1) {
+				char *file_path_copy = strdup(file_path);
+
+				/* Loaded concurrently once all the files are found. */
+				if (!file_path_copy ||
+						lttng_dynamic_buffer_append(&paths,
+							&file_path_copy,
+							sizeof(file_path_copy))) {
+					free(file_path_copy);
+					ret = -LTTNG_ERR_NOMEM;
+					break;
+				}
+				continue;
+			}
+
 			ret = load_session_from_file(file_path, session_name,
 				validation_ctx, overwrite, overrides);
 			if (session_name && !ret) {
@@ -2956,6 +3533,12 @@ int load_session_from_path(const char *path, const char *session_name,
 			}
 		}
 
+		if (!ret && paths.size) {
+			ret = load_files((char **) paths.data,
+				paths.size / sizeof(char *), validation_ctx,
+				overwrite, overrides, nr_threads);
+		}
+
 		free(entry);
 		free(file_path);
 	} else {
@@ -2974,6 +3557,11 @@ end:
 			PERROR("closedir");
 		}
 	}
+	while (paths.size) {
+		paths.size -= sizeof(char *);
+		free(*(char **) (paths.data + paths.size));
+	}
+	lttng_dynamic_buffer_reset(&paths);
 
 	if (session_found && !ret) {
 		ret = 0;
@@ -3019,16 +3607,22 @@ invalid:
 LTTNG_HIDDEN
 int config_load_session(const char *path, const char *session_name,
 		int overwrite, unsigned int autoload,
-		const struct config_load_session_override_attr *overrides)
+		const struct config_load_session_override_attr *overrides,
+		unsigned int nr_threads, int validate)
 {
 	int ret;
 	bool session_loaded = false;
 	const char *path_ptr = NULL;
 	struct session_config_validation_ctx validation_ctx = { 0 };
 
-	ret = init_session_config_validation_ctx(&validation_ctx);
-	if (ret) {
-		goto end;
+	/* MUST be called before libxml2 is used by several threads. */
+	xmlInitParser();
+
+	if (validate) {
+		ret = init_session_config_validation_ctx(&validation_ctx);
+		if (ret) {
+			goto end;
+		}
 	}
 
 	if (!path) {
@@ -3073,7 +3667,8 @@ int config_load_session(const char *path, const char *session_name,
 			}
 			if (path_ptr) {
 				ret = load_session_from_path(path_ptr, session_name,
-						&validation_ctx, overwrite, overrides);
+						&validation_ctx, overwrite, overrides,
+					nr_threads);
 				if (ret && ret != -LTTNG_ERR_LOAD_SESSION_NOENT) {
 					goto end;
 				}
@@ -3103,7 +3698,8 @@ int config_load_session(const char *path, const char *session_name,
 
 		if (path_ptr) {
 			ret = load_session_from_path(path_ptr, session_name,
-					&validation_ctx, overwrite, overrides);
+					&validation_ctx, overwrite, overrides,
+					nr_threads);
 			if (!ret) {
 				session_loaded = true;
 			}
@@ -3128,7 +3724,7 @@ int config_load_session(const char *path, const char *session_name,
 		}
 
 		ret = load_session_from_path(path, session_name,
-			&validation_ctx, overwrite, overrides);
+			&validation_ctx, overwrite, overrides, nr_threads);
 	}
 end:
 	fini_session_config_validation_ctx(&validation_ctx);
@@ -3152,3 +3748,37 @@ void __attribute__((destructor)) session_config_exit(void)
 {
 	xmlCleanupParser();
 }
+
+LTTNG_HIDDEN
+int config_load_session_from_buffer(const char *buf, size_t len,
+		int overwrite)
+{
+	int ret;
+	struct session_config_validation_ctx validation_ctx = { 0 };
+
+	if (len > INT_MAX) {
+		ret = -LTTNG_ERR_INVALID;
+		goto end;
+	}
+
+	xmlInitParser();
+
+	ret = init_session_config_validation_ctx(&validation_ctx);
+	if (ret) {
+		goto end;
+	}
+
+	ret = validate_reader(xmlReaderForMemory(buf, (int) len, NULL, NULL, 0),
+		&validation_ctx);
+	if (ret) {
+		goto end;
+	}
+
+	ret = load_session_from_reader(
+		xmlReaderForMemory(buf, (int) len, NULL, NULL,
+			XML_PARSE_NOBLANKS),
+		NULL, overwrite, NULL);
+end:
+	fini_session_config_validation_ctx(&validation_ctx);
+	return ret;
+}
@@ -21,6 +21,7 @@
 #include <common/config/ini.h>
 #include <common/config/config-session-abi.h>
 #include <common/macros.h>
+#include <stddef.h>
 #include <stdint.h>
 
 struct config_entry {
@@ -97,6 +98,47 @@ int config_parse_value(const char *value);
 LTTNG_HIDDEN
 struct config_writer *config_writer_create(int fd_output, int indent);
 
+/*
+ * Create an instance of a configuration writer keeping the XML content in
+ * memory until config_writer_write_buffer() is called.
+ *
+ * indent If other than 0 the XML will be pretty printed
+ * with indentation and newline.
+ *
+ * Returns an instance of a configuration writer on success, NULL on
+ * error.
+ */
+LTTNG_HIDDEN
+struct config_writer *config_writer_create_buffer(int indent);
+
+/*
+ * Create an instance of a configuration writer keeping a compact binary
+ * document in memory until config_writer_write_buffer() is called. The
+ * binary document holds the same elements as the XML one and is loaded
+ * without parsing text nor validating it against the XSD.
+ *
+ * Returns an instance of a configuration writer on success, NULL on
+ * error.
+ */
+LTTNG_HIDDEN
+struct config_writer *config_writer_create_binary(void);
+
+/*
+ * Close the XML document of a buffered configuration writer, or the binary
+ * document of a binary one, and write its whole content to a file. The
+ * writer must still be destroyed.
+ *
+ * writer An instance of a buffered configuration writer.
+ *
+ * fd_output File to which the XML content must be written. fd_output is
+ * owned by the caller.
+ *
+ * Returns zero if the XML document could be written. Negative values
+ * indicate an error.
+ */
+LTTNG_HIDDEN
+int config_writer_write_buffer(struct config_writer *writer, int fd_output);
+
 /*
  * Destroy an instance of a configuration writer.
  *
@@ -225,6 +267,9 @@ int config_writer_write_element_string(struct config_writer *writer,
  * overwrite Overwrite current session configuration if it exists.
  * autoload Tell to load the auto session(s).
  * overrides The override attribute structure specifying override parameters.
+ * nr_threads Number of threads loading the files of a directory when all
+ * of its sessions are loaded.
+ * validate Validate the files against the XSD, skipped for trusted files.
  *
  * Returns zero if the session could be loaded successfully. Returns
  * a negative LTTNG_ERR code on error.
@@ -232,6 +277,21 @@ int config_writer_write_element_string(struct config_writer *writer,
 LTTNG_HIDDEN
 int config_load_session(const char *path, const char *session_name,
 		int overwrite, unsigned int autoload,
-		const struct config_load_session_override_attr *overrides);
+		const struct config_load_session_override_attr *overrides,
+		unsigned int nr_threads, int validate);
+
+/*
+ * Load the sessions of a session configuration document held in memory,
+ * validated against the XSD first.
+ *
+ * buf Session configuration document of "len" bytes.
+ * overwrite Overwrite current session configuration if it exists.
+ *
+ * Returns zero if the sessions could be loaded successfully. Returns
+ * a negative LTTNG_ERR code on error.
+ */
+LTTNG_HIDDEN
+int config_load_session_from_buffer(const char *buf, size_t len,
+		int overwrite);
 
 #endif /* _CONFIG_H */
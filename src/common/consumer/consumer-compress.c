@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include "consumer-compress.h"
+
+#ifdef HAVE_LIBZ
+
+#include <limits.h>
+#include <stdlib.h>
+#include <zlib.h>
+
+#include <common/common.h>
+#include <common/compat/endian.h>
+#include <common/defaults.h>
+
+struct consumer_compress {
+	enum lttng_channel_compression codec;
+	z_stream zstream;
+	/* Frame of the last compressed packet. */
+	char *buf;
+	size_t alloc_len;
+};
+
+struct consumer_compress *consumer_compress_create(
+		enum lttng_channel_compression codec)
+{
+	int ret;
+	struct consumer_compress *compress = NULL;
+
+	if (codec != LTTNG_CHANNEL_COMPRESSION_ZLIB) {
+		ERR("Unsupported channel compression %d", codec);
+		goto end;
+	}
+
+	compress = zmalloc(sizeof(*compress));
+	if (!compress) {
+		PERROR("zmalloc compressor");
+		goto end;
+	}
+	compress->codec = codec;
+
+	/* Allocated once, reset for each packet. */
+	ret = deflateInit(&compress->zstream, DEFAULT_CONSUMERD_ZLIB_LEVEL);
+	if (ret != Z_OK) {
+		ERR("deflateInit: %s", compress->zstream.msg ?
+				compress->zstream.msg : "unknown error");
+		free(compress);
+		compress = NULL;
+		goto end;
+	}
+
+end:
+	return compress;
+}
+
+void consumer_compress_destroy(struct consumer_compress *compress)
+{
+	if (!compress) {
+		return;
+	}
+
+	(void) deflateEnd(&compress->zstream);
+	free(compress->buf);
+	free(compress);
+}
+
+ssize_t consumer_compress_packet(struct consumer_compress *compress,
+		const void *packet, size_t content_size, size_t packet_size,
+		const void **frame)
+{
+	int ret;
+	size_t bound, frame_len;
+	struct consumer_compressed_packet_header *hdr;
+
+	if (content_size > UINT_MAX) {
+		return -EINVAL;
+	}
+
+	ret = deflateReset(&compress->zstream);
+	if (ret != Z_OK) {
+		return -EINVAL;
+	}
+
+	bound = sizeof(*hdr) + deflateBound(&compress->zstream, content_size);
+	if (bound > compress->alloc_len) {
+		char *new_buf;
+
+		new_buf = realloc(compress->buf, bound);
+		if (!new_buf) {
+			PERROR("realloc compression buffer");
+			return -ENOMEM;
+		}
+		compress->buf = new_buf;
+		compress->alloc_len = bound;
+	}
+
+	compress->zstream.next_in = (Bytef *) packet;
+	compress->zstream.avail_in = content_size;
+	compress->zstream.next_out = (Bytef *) compress->buf + sizeof(*hdr);
+	compress->zstream.avail_out = bound - sizeof(*hdr);
+
+	/* The output buffer is large enough to complete in one call. */
+	ret = deflate(&compress->zstream, Z_FINISH);
+	if (ret != Z_STREAM_END) {
+		ERR("deflate of a %zu bytes packet: %s", content_size,
+				compress->zstream.msg ?
+					compress->zstream.msg : "unknown error");
+		return -EIO;
+	}
+	frame_len = sizeof(*hdr) + compress->zstream.total_out;
+
+	hdr = (struct consumer_compressed_packet_header *) compress->buf;
+	hdr->magic = htobe32(CONSUMER_COMPRESSED_PACKET_MAGIC);
+	hdr->codec = htobe32(compress->codec);
+	hdr->packet_size = htobe64(packet_size);
+	hdr->content_size = htobe64(content_size);
+	hdr->compressed_size = htobe64(compress->zstream.total_out);
+
+	*frame = compress->buf;
+	return frame_len;
+}
+
+#endif /* HAVE_LIBZ */
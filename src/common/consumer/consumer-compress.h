@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef LTTNG_CONSUMER_COMPRESS_H
+#define LTTNG_CONSUMER_COMPRESS_H
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <lttng/channel.h>
+#include <common/macros.h>
+
+/*
+ * Packet compression of the data streams of a compressed channel.
+ *
+ * Every packet is compressed independently and written to the output as a
+ * frame made of a header followed by the compressed packet content. Frames
+ * are written back to back, so the offset of a packet index points to the
+ * frame of its packet and a reader can seek to any packet without inflating
+ * the ones before it. The packet and content sizes of the indexes remain the
+ * uncompressed ones.
+ *
+ * Only the packet content is compressed: the padding up to the packet size is
+ * restored as zeroes on decompression.
+ */
+#define CONSUMER_COMPRESSED_PACKET_MAGIC	0xC1FC2C01
+
+/* Header of a compressed packet frame. All fields are big endian. */
+struct consumer_compressed_packet_header {
+	uint32_t magic;			/* CONSUMER_COMPRESSED_PACKET_MAGIC */
+	uint32_t codec;			/* enum lttng_channel_compression */
+	uint64_t packet_size;		/* bytes, uncompressed packet with padding */
+	uint64_t content_size;		/* bytes, uncompressed packet content */
+	uint64_t compressed_size;	/* bytes following the header */
+} LTTNG_PACKED;
+
+/*
+ * Compressor of a data stream. It keeps the codec state and the frame buffer
+ * across packets.
+ *
+ * A compressor is not thread safe: it is owned by a stream and MUST be used
+ * with the stream lock held.
+ */
+struct consumer_compress;
+
+#ifdef HAVE_LIBZ
+
+/*
+ * Create a compressor using "codec".
+ *
+ * Return the new compressor or NULL on error.
+ */
+struct consumer_compress *consumer_compress_create(
+		enum lttng_channel_compression codec);
+
+/*
+ * Destroy a compressor. NULL is accepted.
+ */
+void consumer_compress_destroy(struct consumer_compress *compress);
+
+/*
+ * Compress the "content_size" bytes of content of a packet of "packet_size"
+ * bytes in a frame. On success, "frame" points to the frame, which remains
+ * valid until the next call.
+ *
+ * Return the frame length or else a negative errno.
+ */
+ssize_t consumer_compress_packet(struct consumer_compress *compress,
+		const void *packet, size_t content_size, size_t packet_size,
+		const void **frame);
+
+#else /* HAVE_LIBZ */
+
+static inline struct consumer_compress *consumer_compress_create(
+		enum lttng_channel_compression codec)
+{
+	return NULL;
+}
+
+static inline void consumer_compress_destroy(struct consumer_compress *compress)
+{
+}
+
+static inline ssize_t consumer_compress_packet(
+		struct consumer_compress *compress, const void *packet,
+		size_t content_size, size_t packet_size, const void **frame)
+{
+	return -ENOSYS;
+}
+
+#endif /* HAVE_LIBZ */
+
+#endif /* LTTNG_CONSUMER_COMPRESS_H */
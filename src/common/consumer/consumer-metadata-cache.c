@@ -36,35 +36,224 @@
 extern struct lttng_consumer_global_data consumer_data;
 
 /*
- * Extend the allocated size of the metadata cache. Called only from
- * lttng_ustconsumer_write_metadata_cache.
+ * Size of the chunks holding the cached metadata. This is also the
+ * granularity at which identical metadata is shared between caches.
+ */
+#define METADATA_CACHE_CHUNK_SIZE	4096
+
+struct consumer_metadata_chunk {
+	/*
+	 * A shared chunk is in the shared chunk table and is never written to,
+	 * it is copied first. A private chunk belongs to a single cache.
+	 */
+	int shared;
+	/* Number of caches using a shared chunk. */
+	unsigned long refcount;
+	/* Hash of the content of a shared chunk. */
+	struct lttng_ht_node_u64 node;
+	struct rcu_head rcu_node;
+	char data[METADATA_CACHE_CHUNK_SIZE];
+};
+
+/*
+ * Complete metadata chunks, indexed by the hash of their content, shared by
+ * all the metadata caches of the consumer. The per-application metadata of
+ * a per-PID session is mostly identical from one process to the other, so
+ * each unique chunk is stored once. The table is created when the first
+ * chunk is shared and destroyed when the last one is released.
+ */
+static struct {
+	pthread_mutex_t lock;
+	struct lttng_ht *ht;
+	unsigned long count;
+} shared_chunks = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/*
+ * FNV-1a hash of the content of a chunk.
+ */
+static
+uint64_t hash_chunk(const char *data)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	size_t i;
+
+	for (i = 0; i < METADATA_CACHE_CHUNK_SIZE; i++) {
+		hash ^= (unsigned char) data[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static
+void free_chunk_rcu(struct rcu_head *head)
+{
+	struct consumer_metadata_chunk *chunk =
+		caa_container_of(head, struct consumer_metadata_chunk, rcu_node);
+
+	free(chunk);
+}
+
+/*
+ * Release a chunk used by a cache.
+ */
+static
+void put_chunk(struct consumer_metadata_chunk *chunk)
+{
+	struct lttng_ht_iter iter;
+
+	if (!chunk) {
+		return;
+	}
+	if (!chunk->shared) {
+		free(chunk);
+		return;
+	}
+
+	pthread_mutex_lock(&shared_chunks.lock);
+	if (--chunk->refcount) {
+		goto end;
+	}
+	rcu_read_lock();
+	iter.iter.node = &chunk->node.node;
+	(void) lttng_ht_del(shared_chunks.ht, &iter);
+	rcu_read_unlock();
+	call_rcu(&chunk->rcu_node, free_chunk_rcu);
+	if (!--shared_chunks.count) {
+		lttng_ht_destroy(shared_chunks.ht);
+		shared_chunks.ht = NULL;
+	}
+end:
+	pthread_mutex_unlock(&shared_chunks.lock);
+}
+
+/*
+ * Share a complete private chunk of a cache. If an identical chunk is
+ * already shared, use it and free the private copy.
+ *
+ * A failure to share simply leaves the chunk private.
+ */
+static
+void share_chunk(struct consumer_metadata_cache *cache, uint64_t index)
+{
+	uint64_t hash;
+	struct lttng_ht_iter iter;
+	struct consumer_metadata_chunk *chunk = cache->chunks[index], *shared;
+
+	assert(chunk && !chunk->shared);
+
+	hash = hash_chunk(chunk->data);
+
+	pthread_mutex_lock(&shared_chunks.lock);
+	if (!shared_chunks.ht) {
+		shared_chunks.ht = lttng_ht_new(0, LTTNG_HT_TYPE_U64);
+		if (!shared_chunks.ht) {
+			goto end;
+		}
+	}
+
+	rcu_read_lock();
+	cds_lfht_for_each_entry_duplicate(shared_chunks.ht->ht,
+			shared_chunks.ht->hash_fct(&hash, lttng_ht_seed),
+			shared_chunks.ht->match_fct, &hash,
+			&iter.iter, shared, node.node) {
+		if (!memcmp(shared->data, chunk->data,
+				METADATA_CACHE_CHUNK_SIZE)) {
+			shared->refcount++;
+			cache->chunks[index] = shared;
+			free(chunk);
+			rcu_read_unlock();
+			goto end;
+		}
+	}
+
+	chunk->shared = 1;
+	chunk->refcount = 1;
+	lttng_ht_node_init_u64(&chunk->node, hash);
+	lttng_ht_add_u64(shared_chunks.ht, &chunk->node);
+	shared_chunks.count++;
+	rcu_read_unlock();
+end:
+	pthread_mutex_unlock(&shared_chunks.lock);
+}
+
+/*
+ * Copy "len" bytes of "data" at "offset" in a chunk of the cache, allocating
+ * it or copying it if it is shared.
+ *
+ * Return 0 on success, a negative value on error.
+ */
+static
+int write_chunk(struct consumer_metadata_cache *cache, uint64_t index,
+		unsigned int offset, const char *data, unsigned int len)
+{
+	int ret = 0;
+	struct consumer_metadata_chunk *chunk = cache->chunks[index];
+
+	if (!chunk) {
+		chunk = zmalloc(sizeof(*chunk));
+		if (!chunk) {
+			PERROR("zmalloc metadata cache chunk");
+			ret = -1;
+			goto end;
+		}
+		cache->chunks[index] = chunk;
+	} else if (chunk->shared) {
+		struct consumer_metadata_chunk *copy;
+
+		/* Overlapping updates usually rewrite the same content. */
+		if (!memcmp(chunk->data + offset, data, len)) {
+			goto end;
+		}
+		copy = zmalloc(sizeof(*copy));
+		if (!copy) {
+			PERROR("zmalloc metadata cache chunk");
+			ret = -1;
+			goto end;
+		}
+		memcpy(copy->data, chunk->data, METADATA_CACHE_CHUNK_SIZE);
+		put_chunk(chunk);
+		chunk = copy;
+		cache->chunks[index] = chunk;
+	}
+	memcpy(chunk->data + offset, data, len);
+
+end:
+	return ret;
+}
+
+/*
+ * Extend the number of chunk slots of the metadata cache. Called only from
+ * consumer_metadata_cache_write.
  *
  * Return 0 on success, a negative value on error.
  */
 static int extend_metadata_cache(struct lttng_consumer_channel *channel,
-		unsigned int size)
+		uint64_t nr_chunks)
 {
 	int ret = 0;
-	char *tmp_data_ptr;
-	unsigned int new_size, old_size;
+	struct consumer_metadata_chunk **tmp_chunks;
+	uint64_t new_nr, old_nr;
 
 	assert(channel);
 	assert(channel->metadata_cache);
 
-	old_size = channel->metadata_cache->cache_alloc_size;
-	new_size = max_t(unsigned int, old_size + size, old_size << 1);
-	DBG("Extending metadata cache to %u", new_size);
-	tmp_data_ptr = realloc(channel->metadata_cache->data, new_size);
-	if (!tmp_data_ptr) {
+	old_nr = channel->metadata_cache->nr_chunks;
+	new_nr = max_t(uint64_t, nr_chunks, old_nr << 1);
+	DBG("Extending metadata cache to %" PRIu64 " chunks", new_nr);
+	tmp_chunks = realloc(channel->metadata_cache->chunks,
+			new_nr * sizeof(*tmp_chunks));
+	if (!tmp_chunks) {
 		ERR("Reallocating metadata cache");
-		free(channel->metadata_cache->data);
 		ret = -1;
 		goto end;
 	}
-	/* Zero newly allocated memory */
-	memset(tmp_data_ptr + old_size, 0, new_size - old_size);
-	channel->metadata_cache->data = tmp_data_ptr;
-	channel->metadata_cache->cache_alloc_size = new_size;
+	/* Zero newly allocated slots */
+	memset(tmp_chunks + old_nr, 0,
+			(new_nr - old_nr) * sizeof(*tmp_chunks));
+	channel->metadata_cache->chunks = tmp_chunks;
+	channel->metadata_cache->nr_chunks = new_nr;
 
 end:
 	return ret;
@@ -76,8 +265,15 @@ end:
 static
 void metadata_cache_reset(struct consumer_metadata_cache *cache)
 {
-	memset(cache->data, 0, cache->cache_alloc_size);
+	uint64_t i;
+
+	for (i = 0; i < cache->nr_chunks; i++) {
+		put_chunk(cache->chunks[i]);
+		cache->chunks[i] = NULL;
+	}
 	cache->max_offset = 0;
+	cache->trimmed_offset = 0;
+	cache->reload_pending = 0;
 }
 
 /*
@@ -119,6 +315,8 @@ int consumer_metadata_cache_write(struct lttng_consumer_channel *channel,
 {
 	int ret = 0;
 	int size_ret;
+	uint64_t index, last, end = (uint64_t) offset + len;
+	unsigned int written = 0;
 	struct consumer_metadata_cache *cache;
 
 	assert(channel);
@@ -131,22 +329,63 @@ int consumer_metadata_cache_write(struct lttng_consumer_channel *channel,
 		goto end;
 	}
 
+	if (offset < cache->trimmed_offset) {
+		if (offset == 0 && end >= cache->trimmed_offset) {
+			DBG("Restoring %" PRIu64 " trimmed bytes of metadata cache",
+					cache->trimmed_offset);
+			cache->trimmed_offset = 0;
+			cache->reload_pending = 0;
+		} else if (end <= cache->trimmed_offset) {
+			DBG("Ignoring %u bytes of trimmed metadata", len);
+			goto end;
+		} else {
+			unsigned int skip = cache->trimmed_offset - offset;
+
+			/* Only write what is above the trimmed chunks. */
+			offset += skip;
+			data += skip;
+			len -= skip;
+		}
+	}
+
 	DBG("Writing %u bytes from offset %u in metadata cache", len, offset);
 
-	if (offset + len > cache->cache_alloc_size) {
-		ret = extend_metadata_cache(channel,
-				len - cache->cache_alloc_size + offset);
+	last = (end + METADATA_CACHE_CHUNK_SIZE - 1) / METADATA_CACHE_CHUNK_SIZE;
+	if (last > cache->nr_chunks) {
+		ret = extend_metadata_cache(channel, last);
 		if (ret < 0) {
 			ERR("Extending metadata cache");
 			goto end;
 		}
 	}
 
-	memcpy(cache->data + offset, data, len);
-	if (offset + len > cache->max_offset) {
+	for (index = offset / METADATA_CACHE_CHUNK_SIZE; written < len;
+			index++) {
+		unsigned int chunk_offset, chunk_len;
+
+		chunk_offset = (offset + written) % METADATA_CACHE_CHUNK_SIZE;
+		chunk_len = min_t(unsigned int, len - written,
+				METADATA_CACHE_CHUNK_SIZE - chunk_offset);
+		ret = write_chunk(cache, index, chunk_offset, data + written,
+				chunk_len);
+		if (ret < 0) {
+			goto end;
+		}
+		written += chunk_len;
+	}
+
+	/* Share the chunks completed by this write. */
+	for (index = offset / METADATA_CACHE_CHUNK_SIZE;
+			index < end / METADATA_CACHE_CHUNK_SIZE; index++) {
+		if (!cache->chunks[index]->shared) {
+			share_chunk(cache, index);
+		}
+	}
+
+	if (end > cache->max_offset) {
 		char dummy = 'c';
 
-		cache->max_offset = offset + len;
+		cache->max_offset = end;
 		if (channel->monitor && channel->metadata_stream) {
 			size_ret = lttng_write(channel->metadata_stream->ust_metadata_poll_pipe[1],
 					&dummy, 1);
@@ -162,6 +401,60 @@ end:
 	return ret;
 }
 
+/*
+ * Return a pointer to the contiguous metadata of the cache starting at
+ * "offset" and set "len" to its length, at most "max_len" bytes. Metadata
+ * spanning more than one chunk is copied in the read buffer of the cache.
+ * The metadata cache lock MUST be acquired and the pointer is valid until it
+ * is released.
+ *
+ * Return NULL on error.
+ */
+const char *consumer_metadata_cache_read(struct consumer_metadata_cache *cache,
+		uint64_t offset, size_t max_len, size_t *len)
+{
+	const char *ret = NULL;
+	uint64_t index = offset / METADATA_CACHE_CHUNK_SIZE;
+	size_t chunk_offset = offset % METADATA_CACHE_CHUNK_SIZE;
+	size_t read_len, copied = 0;
+
+	assert(offset < cache->max_offset);
+	assert(offset >= cache->trimmed_offset);
+
+	read_len = min_t(uint64_t, cache->max_offset - offset, max_len);
+	if (chunk_offset + read_len <= METADATA_CACHE_CHUNK_SIZE) {
+		ret = cache->chunks[index]->data + chunk_offset;
+		goto end;
+	}
+
+	if (read_len > cache->read_buf_size) {
+		char *tmp_buf;
+
+		tmp_buf = realloc(cache->read_buf, read_len);
+		if (!tmp_buf) {
+			PERROR("realloc metadata cache read buffer");
+			goto end;
+		}
+		cache->read_buf = tmp_buf;
+		cache->read_buf_size = read_len;
+	}
+	while (copied < read_len) {
+		size_t chunk_len = min_t(size_t, read_len - copied,
+				METADATA_CACHE_CHUNK_SIZE - chunk_offset);
+
+		memcpy(cache->read_buf + copied,
+				cache->chunks[index]->data + chunk_offset, chunk_len);
+		copied += chunk_len;
+		chunk_offset = 0;
+		index++;
+	}
+	ret = cache->read_buf;
+
+end:
+	*len = read_len;
+	return ret;
+}
+
 /*
  * Create the metadata cache, original allocated size: max_sb_size
  *
@@ -186,16 +479,18 @@ int consumer_metadata_cache_allocate(struct lttng_consumer_channel *channel)
 		goto end_free_cache;
 	}
 
-	channel->metadata_cache->cache_alloc_size = DEFAULT_METADATA_CACHE_SIZE;
-	channel->metadata_cache->data = zmalloc(
-			channel->metadata_cache->cache_alloc_size * sizeof(char));
-	if (!channel->metadata_cache->data) {
-		PERROR("zmalloc metadata cache data");
+	channel->metadata_cache->nr_chunks = (DEFAULT_METADATA_CACHE_SIZE +
+			METADATA_CACHE_CHUNK_SIZE - 1) / METADATA_CACHE_CHUNK_SIZE;
+	channel->metadata_cache->chunks = zmalloc(
+			channel->metadata_cache->nr_chunks *
+			sizeof(*channel->metadata_cache->chunks));
+	if (!channel->metadata_cache->chunks) {
+		PERROR("zmalloc metadata cache chunks");
 		ret = -1;
 		goto end_free_mutex;
 	}
-	DBG("Allocated metadata cache of %" PRIu64 " bytes",
-			channel->metadata_cache->cache_alloc_size);
+	DBG("Allocated metadata cache of %" PRIu64 " chunks",
+			channel->metadata_cache->nr_chunks);
 
 	ret = 0;
 	goto end;
@@ -219,11 +514,48 @@ void consumer_metadata_cache_destroy(struct lttng_consumer_channel *channel)
 
 	DBG("Destroying metadata cache");
 
+	metadata_cache_reset(channel->metadata_cache);
 	pthread_mutex_destroy(&channel->metadata_cache->lock);
-	free(channel->metadata_cache->data);
+	free(channel->metadata_cache->chunks);
+	free(channel->metadata_cache->read_buf);
 	free(channel->metadata_cache);
 }
 
+/*
+ * Release the chunks of the cache entirely below "offset", the metadata
+ * committed to the metadata channel, if the metadata cache trimming is
+ * enabled. The metadata of the channels which are not monitored is kept
+ * since each snapshot commits it again from the start. The metadata cache
+ * lock MUST be acquired.
+ */
+void consumer_metadata_cache_trim(struct lttng_consumer_channel *channel,
+		uint64_t offset)
+{
+	uint64_t index, last;
+	struct consumer_metadata_cache *cache;
+
+	assert(channel);
+	assert(channel->metadata_cache);
+
+	cache = channel->metadata_cache;
+	if (!consumer_data.metadata_cache_trim || !channel->monitor ||
+			cache->reload_pending) {
+		return;
+	}
+
+	last = offset / METADATA_CACHE_CHUNK_SIZE;
+	for (index = cache->trimmed_offset / METADATA_CACHE_CHUNK_SIZE;
+			index < last; index++) {
+		put_chunk(cache->chunks[index]);
+		cache->chunks[index] = NULL;
+	}
+	if (last * METADATA_CACHE_CHUNK_SIZE > cache->trimmed_offset) {
+		cache->trimmed_offset = last * METADATA_CACHE_CHUNK_SIZE;
+		DBG3("Metadata cache of channel %" PRIu64 " trimmed up to offset %" PRIu64,
+				channel->key, cache->trimmed_offset);
+	}
+}
+
 /*
  * Check if the cache is flushed up to the offset passed in parameter.
  *
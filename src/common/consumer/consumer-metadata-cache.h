@@ -21,9 +21,19 @@
 
 #include <common/consumer/consumer.h>
 
+struct consumer_metadata_chunk;
+
 struct consumer_metadata_cache {
-	char *data;
-	uint64_t cache_alloc_size;
+	/*
+	 * Fixed-size chunks holding the cached metadata. The chunks entirely
+	 * below max_offset are shared with the other caches holding identical
+	 * metadata and copied on write.
+	 */
+	struct consumer_metadata_chunk **chunks;
+	uint64_t nr_chunks;
+	/* Copy of the metadata read across chunks. */
+	char *read_buf;
+	size_t read_buf_size;
 	/*
 	 * Current version of the metadata cache.
 	 */
@@ -36,6 +46,14 @@ struct consumer_metadata_cache {
 	 * All cached data is contiguous.
 	 */
 	uint64_t max_offset;
+	/*
+	 * With the metadata cache trimming, the chunks below this offset were
+	 * released once committed to the metadata channel. A write of the
+	 * metadata from offset 0 restores them.
+	 */
+	uint64_t trimmed_offset;
+	/* Ask the session daemon to send the whole metadata again. */
+	unsigned int reload_pending:1;
 	/*
 	 * Lock to update the metadata cache and push into the ring_buffer
 	 * (ustctl_write_metadata_to_channel).
@@ -48,8 +66,12 @@ struct consumer_metadata_cache {
 int consumer_metadata_cache_write(struct lttng_consumer_channel *channel,
 		unsigned int offset, unsigned int len, uint64_t version,
 		char *data);
+const char *consumer_metadata_cache_read(struct consumer_metadata_cache *cache,
+		uint64_t offset, size_t max_len, size_t *len);
 int consumer_metadata_cache_allocate(struct lttng_consumer_channel *channel);
 void consumer_metadata_cache_destroy(struct lttng_consumer_channel *channel);
+void consumer_metadata_cache_trim(struct lttng_consumer_channel *channel,
+		uint64_t offset);
 int consumer_metadata_cache_flushed(struct lttng_consumer_channel *channel,
 		uint64_t offset, int timer);
 
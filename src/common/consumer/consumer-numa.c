@@ -0,0 +1,266 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "consumer-numa.h"
+
+#ifdef __linux__
+
+#include <assert.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <common/common.h>
+
+#define NUMA_SYSFS_NODE_PATH	"/sys/devices/system/node"
+/* Large enough for the list of CPUs or nodes of any sane host. */
+#define NUMA_LIST_MAX_LEN	4096
+
+struct numa_node {
+	/* Kernel node number. */
+	int id;
+	cpu_set_t cpus;
+};
+
+static struct numa_node *numa_nodes;
+static unsigned int numa_nr_nodes;
+/* Node index of every CPU below CPU_SETSIZE, -1 if unknown. */
+static int numa_cpu_node[CPU_SETSIZE];
+
+/*
+ * Read the first line of a sysfs file in "buf".
+ *
+ * Return 0 on success or else -1.
+ */
+static int read_sysfs_line(const char *path, char *buf, size_t len)
+{
+	int ret = 0;
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	if (!fp) {
+		ret = -1;
+		goto end;
+	}
+	if (!fgets(buf, len, fp)) {
+		ret = -1;
+	}
+	fclose(fp);
+end:
+	return ret;
+}
+
+/*
+ * Parse a sysfs list of the form "0-3,8,10-11". The callback is called on each
+ * listed value.
+ *
+ * Return 0 on success or else -1.
+ */
+static int parse_sysfs_list(const char *list,
+		int (*cb)(unsigned long value, void *data), void *data)
+{
+	const char *p = list;
+
+	while (*p && *p != '\n') {
+		char *end;
+		unsigned long first, last, v;
+
+		errno = 0;
+		first = strtoul(p, &end, 10);
+		if (errno || end == p) {
+			return -1;
+		}
+		last = first;
+		p = end;
+		if (*p == '-') {
+			p++;
+			last = strtoul(p, &end, 10);
+			if (errno || end == p || last < first) {
+				return -1;
+			}
+			p = end;
+		}
+		for (v = first; v <= last; v++) {
+			if (cb(v, data)) {
+				return -1;
+			}
+		}
+		if (*p == ',') {
+			p++;
+		}
+	}
+	return 0;
+}
+
+/* Append a node number to the node array. */
+static int add_node_cb(unsigned long id, void *data)
+{
+	unsigned int *nr_nodes = data;
+
+	if (id > INT_MAX) {
+		return -1;
+	}
+	numa_nodes[(*nr_nodes)++].id = (int) id;
+	return 0;
+}
+
+/* Count the listed values. */
+static int count_cb(unsigned long value, void *data)
+{
+	unsigned int *count = data;
+
+	(*count)++;
+	return 0;
+}
+
+/* Add a CPU to the node of index "data". */
+static int add_cpu_cb(unsigned long cpu, void *data)
+{
+	unsigned int node = *(unsigned int *) data;
+
+	/* The CPUs beyond the affinity mask limit are simply not bound. */
+	if (cpu < CPU_SETSIZE) {
+		CPU_SET(cpu, &numa_nodes[node].cpus);
+		numa_cpu_node[cpu] = (int) node;
+	}
+	return 0;
+}
+
+int consumer_numa_init(void)
+{
+	int ret;
+	unsigned int i, nr_nodes = 0, nr_nodes_found = 0;
+	char *list;
+
+	for (i = 0; i < CPU_SETSIZE; i++) {
+		numa_cpu_node[i] = -1;
+	}
+
+	list = zmalloc(NUMA_LIST_MAX_LEN);
+	if (!list) {
+		PERROR("zmalloc NUMA list");
+		ret = -ENOMEM;
+		goto end;
+	}
+
+	ret = read_sysfs_line(NUMA_SYSFS_NODE_PATH "/online", list,
+			NUMA_LIST_MAX_LEN);
+	if (ret) {
+		DBG("No NUMA topology available");
+		ret = -ENOENT;
+		goto end;
+	}
+	ret = parse_sysfs_list(list, count_cb, &nr_nodes);
+	if (ret || !nr_nodes) {
+		ERR("Invalid list of online NUMA nodes: %s", list);
+		ret = -EINVAL;
+		goto end;
+	}
+
+	numa_nodes = zmalloc(nr_nodes * sizeof(*numa_nodes));
+	if (!numa_nodes) {
+		PERROR("zmalloc NUMA nodes");
+		ret = -ENOMEM;
+		goto end;
+	}
+	(void) parse_sysfs_list(list, add_node_cb, &nr_nodes_found);
+
+	/* Only the nodes having CPUs are kept, memory-only nodes are skipped. */
+	for (i = 0; i < nr_nodes_found; i++) {
+		char path[PATH_MAX];
+		unsigned int node = numa_nr_nodes;
+
+		ret = snprintf(path, sizeof(path),
+				NUMA_SYSFS_NODE_PATH "/node%d/cpulist",
+				numa_nodes[i].id);
+		if (ret < 0 || ret >= sizeof(path)) {
+			ret = -EINVAL;
+			goto error;
+		}
+		ret = read_sysfs_line(path, list, NUMA_LIST_MAX_LEN);
+		if (ret) {
+			PERROR("Reading %s", path);
+			ret = -EINVAL;
+			goto error;
+		}
+		numa_nodes[node].id = numa_nodes[i].id;
+		CPU_ZERO(&numa_nodes[node].cpus);
+		ret = parse_sysfs_list(list, add_cpu_cb, &node);
+		if (ret) {
+			ERR("Invalid CPU list of NUMA node %d: %s",
+					numa_nodes[node].id, list);
+			ret = -EINVAL;
+			goto error;
+		}
+		if (!CPU_COUNT(&numa_nodes[node].cpus)) {
+			continue;
+		}
+		DBG("NUMA node %d has %d CPU(s)", numa_nodes[node].id,
+				CPU_COUNT(&numa_nodes[node].cpus));
+		numa_nr_nodes++;
+	}
+	if (!numa_nr_nodes) {
+		ERR("No NUMA node has a CPU");
+		ret = -EINVAL;
+		goto error;
+	}
+	ret = (int) numa_nr_nodes;
+	goto end;
+
+error:
+	free(numa_nodes);
+	numa_nodes = NULL;
+	numa_nr_nodes = 0;
+	for (i = 0; i < CPU_SETSIZE; i++) {
+		numa_cpu_node[i] = -1;
+	}
+end:
+	free(list);
+	return ret;
+}
+
+unsigned int consumer_numa_nr_nodes(void)
+{
+	return numa_nr_nodes;
+}
+
+int consumer_numa_cpu_to_node(int cpu)
+{
+	if (cpu < 0 || cpu >= CPU_SETSIZE) {
+		return -1;
+	}
+	return numa_cpu_node[cpu];
+}
+
+int consumer_numa_bind_thread(unsigned int node)
+{
+	int ret;
+
+	assert(node < numa_nr_nodes);
+
+	ret = sched_setaffinity(0, sizeof(numa_nodes[node].cpus),
+			&numa_nodes[node].cpus);
+	if (ret) {
+		ret = -errno;
+		PERROR("sched_setaffinity to NUMA node %d", numa_nodes[node].id);
+	}
+	return ret;
+}
+
+#endif /* __linux__ */
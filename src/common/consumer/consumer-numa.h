@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef LTTNG_CONSUMER_NUMA_H
+#define LTTNG_CONSUMER_NUMA_H
+
+#include <errno.h>
+
+/*
+ * NUMA topology of the host, as exposed by sysfs, used to bind the data
+ * threads to the CPUs of a node and to consume each per-CPU stream from a
+ * thread of the CPU's node.
+ *
+ * Nodes are designated by their index in the list of online nodes, which is
+ * not necessarily their kernel node number.
+ */
+
+#ifdef __linux__
+
+/*
+ * Discover the online NUMA nodes and their CPUs. MUST be called before any
+ * other function of this interface, before any consumer thread is launched.
+ *
+ * Return the number of nodes found (at least 1) or else a negative value, in
+ * which case the host is handled as a single node.
+ */
+int consumer_numa_init(void);
+
+/*
+ * Return the number of nodes found by consumer_numa_init() or 0.
+ */
+unsigned int consumer_numa_nr_nodes(void);
+
+/*
+ * Return the node index of "cpu" or -1 if unknown.
+ */
+int consumer_numa_cpu_to_node(int cpu);
+
+/*
+ * Bind the calling thread to the CPUs of node index "node". Memory first
+ * touched by the thread is then allocated on that node by the kernel's
+ * default policy.
+ *
+ * Return 0 on success or else a negative errno.
+ */
+int consumer_numa_bind_thread(unsigned int node);
+
+#else /* __linux__ */
+
+static inline int consumer_numa_init(void)
+{
+	return -ENOSYS;
+}
+
+static inline unsigned int consumer_numa_nr_nodes(void)
+{
+	return 0;
+}
+
+static inline int consumer_numa_cpu_to_node(int cpu)
+{
+	return -1;
+}
+
+static inline int consumer_numa_bind_thread(unsigned int node)
+{
+	return -ENOSYS;
+}
+
+#endif /* __linux__ */
+
+#endif /* LTTNG_CONSUMER_NUMA_H */
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <fnmatch.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <common/common.h>
+#include <common/defaults.h>
+
+#include "consumer-priority.h"
+
+struct consumer_priority_entry {
+	char *pattern;
+	unsigned int priority;
+};
+
+static struct consumer_priority_entry *priority_entries;
+static size_t nr_priority_entries;
+
+static void free_entries(struct consumer_priority_entry *entries,
+		size_t nr_entries)
+{
+	size_t i;
+
+	for (i = 0; i < nr_entries; i++) {
+		free(entries[i].pattern);
+	}
+	free(entries);
+}
+
+/*
+ * Parse an entry PATTERN=PRIORITY of "len" characters.
+ *
+ * Return 0 on success or else -1.
+ */
+static int parse_entry(const char *entry, size_t len,
+		struct consumer_priority_entry *parsed)
+{
+	const char *p;
+	char *end;
+	unsigned long priority;
+
+	p = memchr(entry, '=', len);
+	if (!p || p == entry) {
+		goto error;
+	}
+	errno = 0;
+	priority = strtoul(p + 1, &end, 10);
+	if (errno || end == p + 1 || end != entry + len ||
+			priority > DEFAULT_CONSUMERD_CHANNEL_PRIORITY_MAX) {
+		goto error;
+	}
+	parsed->pattern = strndup(entry, p - entry);
+	if (!parsed->pattern) {
+		PERROR("strndup channel priority pattern");
+		return -1;
+	}
+	parsed->priority = (unsigned int) priority;
+	return 0;
+
+error:
+	ERR("Invalid channel priority entry \"%.*s\" (the priority is at most %d)",
+			(int) len, entry, DEFAULT_CONSUMERD_CHANNEL_PRIORITY_MAX);
+	return -1;
+}
+
+int consumer_priority_parse(const char *spec)
+{
+	struct consumer_priority_entry *entries = NULL;
+	size_t nr_entries = 0, i;
+	const char *p = spec;
+
+	while (*p) {
+		size_t len = strcspn(p, ";");
+
+		if (len) {
+			struct consumer_priority_entry *new_entries;
+
+			new_entries = realloc(entries,
+					(nr_entries + 1) * sizeof(*entries));
+			if (!new_entries) {
+				PERROR("realloc channel priorities");
+				goto error;
+			}
+			entries = new_entries;
+			if (parse_entry(p, len, &entries[nr_entries])) {
+				goto error;
+			}
+			nr_entries++;
+		}
+		p += len;
+		if (*p == ';') {
+			p++;
+		}
+	}
+
+	free_entries(priority_entries, nr_priority_entries);
+	priority_entries = entries;
+	nr_priority_entries = nr_entries;
+
+	for (i = 0; i < nr_priority_entries; i++) {
+		DBG("Priority of the channels matching \"%s\": %u",
+				priority_entries[i].pattern,
+				priority_entries[i].priority);
+	}
+	return 0;
+
+error:
+	free_entries(entries, nr_entries);
+	return -1;
+}
+
+unsigned int consumer_priority_lookup(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < nr_priority_entries; i++) {
+		if (!fnmatch(priority_entries[i].pattern, name, 0)) {
+			return priority_entries[i].priority;
+		}
+	}
+	return 0;
+}
+
+int consumer_priority_enabled(void)
+{
+	return nr_priority_entries != 0;
+}
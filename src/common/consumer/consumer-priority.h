@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef LTTNG_CONSUMER_PRIORITY_H
+#define LTTNG_CONSUMER_PRIORITY_H
+
+/*
+ * Consumption priority of the channels, looked up by channel name.
+ *
+ * A specification is a list of entries separated by ';', each of the form
+ * PATTERN=PRIORITY, where PATTERN is a fnmatch(3) pattern of channel names
+ * and PRIORITY is between 0, the default, and
+ * DEFAULT_CONSUMERD_CHANNEL_PRIORITY_MAX. The first matching entry sets the
+ * priority of a channel. For instance:
+ *
+ *   audit=8;metrics*=2
+ *
+ * On each pass of a data thread over its ready streams, the streams of the
+ * channels of higher priority are consumed first, and a stream of priority P
+ * is consumed up to P + 1 sub-buffers when those of priority 0 are consumed
+ * one, so that the discards of an overloaded consumer fall on the channels
+ * of lower priority.
+ */
+
+/*
+ * Parse a specification, replacing the current one. MUST be called before
+ * any channel is created.
+ *
+ * Return 0 on success or else -1, in which case the current specification is
+ * kept.
+ */
+int consumer_priority_parse(const char *spec);
+
+/*
+ * Return the priority of the channel named "name".
+ */
+unsigned int consumer_priority_lookup(const char *name);
+
+/*
+ * Return 1 if any channel priority is configured or else 0.
+ */
+int consumer_priority_enabled(void);
+
+#endif /* LTTNG_CONSUMER_PRIORITY_H */
@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "consumer-sched.h"
+
+#ifdef __linux__
+
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <common/common.h>
+
+struct consumer_sched_attr {
+	unsigned int set:1;
+	unsigned int has_cpus:1;
+	int policy;
+	int priority;
+	cpu_set_t cpus;
+};
+
+static struct consumer_sched_attr sched_attrs[NR_HEALTH_CONSUMERD_TYPES];
+
+static const char *sched_type_names[NR_HEALTH_CONSUMERD_TYPES] = {
+	[HEALTH_CONSUMERD_TYPE_CHANNEL] = "channel",
+	[HEALTH_CONSUMERD_TYPE_METADATA] = "metadata",
+	[HEALTH_CONSUMERD_TYPE_DATA] = "data",
+	[HEALTH_CONSUMERD_TYPE_SESSIOND] = "sessiond",
+	[HEALTH_CONSUMERD_TYPE_METADATA_TIMER] = "timer",
+	[HEALTH_CONSUMERD_TYPE_WRITEBACK] = "writeback",
+	[HEALTH_CONSUMERD_TYPE_SPOOL] = "spool",
+};
+
+/*
+ * Parse a CPU list of the form "0-3,8" of "len" characters in "cpus".
+ *
+ * Return 0 on success or else -1.
+ */
+static int parse_cpu_list(const char *list, size_t len, cpu_set_t *cpus)
+{
+	const char *p = list, *list_end = list + len;
+
+	CPU_ZERO(cpus);
+	while (p < list_end) {
+		char *end;
+		unsigned long first, last, cpu;
+
+		errno = 0;
+		first = strtoul(p, &end, 10);
+		if (errno || end == p || end > list_end) {
+			return -1;
+		}
+		last = first;
+		p = end;
+		if (p < list_end && *p == '-') {
+			p++;
+			last = strtoul(p, &end, 10);
+			if (errno || end == p || end > list_end || last < first) {
+				return -1;
+			}
+			p = end;
+		}
+		if (last >= CPU_SETSIZE) {
+			return -1;
+		}
+		for (cpu = first; cpu <= last; cpu++) {
+			CPU_SET(cpu, cpus);
+		}
+		if (p < list_end) {
+			if (*p != ',') {
+				return -1;
+			}
+			p++;
+		}
+	}
+	return CPU_COUNT(cpus) ? 0 : -1;
+}
+
+/*
+ * Parse an entry TYPE=POLICY[:PRIORITY][@CPUS] of "len" characters.
+ *
+ * Return the thread type on success or else -1.
+ */
+static int parse_entry(const char *entry, size_t len,
+		struct consumer_sched_attr *attr)
+{
+	const char *entry_end = entry + len, *p, *cpus;
+	size_t name_len;
+	int i, type = -1;
+
+	memset(attr, 0, sizeof(*attr));
+
+	p = memchr(entry, '=', len);
+	if (!p) {
+		goto error;
+	}
+	for (i = 0; i < NR_HEALTH_CONSUMERD_TYPES; i++) {
+		if (strlen(sched_type_names[i]) == (size_t) (p - entry) &&
+				!strncmp(entry, sched_type_names[i], p - entry)) {
+			type = i;
+			break;
+		}
+	}
+	if (type < 0) {
+		goto error;
+	}
+	p++;
+
+	cpus = memchr(p, '@', entry_end - p);
+	name_len = strcspn(p, ":@;");
+	if (name_len == 4 && !strncmp(p, "fifo", 4)) {
+		attr->policy = SCHED_FIFO;
+	} else if (name_len == 2 && !strncmp(p, "rr", 2)) {
+		attr->policy = SCHED_RR;
+	} else if (name_len == 5 && !strncmp(p, "other", 5)) {
+		attr->policy = SCHED_OTHER;
+	} else {
+		goto error;
+	}
+	p += name_len;
+
+	if (p < entry_end && *p == ':') {
+		char *end;
+		long priority;
+
+		p++;
+		errno = 0;
+		priority = strtol(p, &end, 10);
+		if (errno || end == p || end > entry_end ||
+				(end < entry_end && *end != '@') ||
+				priority < sched_get_priority_min(attr->policy) ||
+				priority > sched_get_priority_max(attr->policy)) {
+			goto error;
+		}
+		attr->priority = (int) priority;
+		p = end;
+	} else if (attr->policy != SCHED_OTHER) {
+		/* A real-time policy needs a priority. */
+		goto error;
+	}
+
+	if (cpus) {
+		if (p != cpus || parse_cpu_list(cpus + 1, entry_end - cpus - 1,
+				&attr->cpus)) {
+			goto error;
+		}
+		attr->has_cpus = 1;
+	} else if (p != entry_end) {
+		goto error;
+	}
+
+	attr->set = 1;
+	return type;
+
+error:
+	ERR("Invalid thread scheduling entry \"%.*s\"", (int) len, entry);
+	return -1;
+}
+
+int consumer_sched_parse(const char *spec)
+{
+	struct consumer_sched_attr attrs[NR_HEALTH_CONSUMERD_TYPES];
+	const char *p = spec;
+	int i;
+
+	memcpy(attrs, sched_attrs, sizeof(attrs));
+	while (*p) {
+		struct consumer_sched_attr attr;
+		size_t len = strcspn(p, ";");
+		int type;
+
+		if (len) {
+			type = parse_entry(p, len, &attr);
+			if (type < 0) {
+				return -1;
+			}
+			attrs[type] = attr;
+		}
+		p += len;
+		if (*p == ';') {
+			p++;
+		}
+	}
+	memcpy(sched_attrs, attrs, sizeof(attrs));
+
+	for (i = 0; i < NR_HEALTH_CONSUMERD_TYPES; i++) {
+		if (sched_attrs[i].set) {
+			DBG("Scheduling of the %s threads: policy %d priority %d%s",
+					sched_type_names[i], sched_attrs[i].policy,
+					sched_attrs[i].priority,
+					sched_attrs[i].has_cpus ? ", bound" : "");
+		}
+	}
+	return 0;
+}
+
+void consumer_sched_apply(enum health_type_consumerd type)
+{
+	struct consumer_sched_attr *attr;
+	int ret;
+
+	assert(type < NR_HEALTH_CONSUMERD_TYPES);
+
+	attr = &sched_attrs[type];
+	if (!attr->set) {
+		return;
+	}
+
+	if (attr->has_cpus) {
+		ret = sched_setaffinity(0, sizeof(attr->cpus), &attr->cpus);
+		if (ret) {
+			PERROR("sched_setaffinity of a %s thread",
+					sched_type_names[type]);
+		}
+	}
+	if (attr->policy != SCHED_OTHER) {
+		struct sched_param param = {
+			.sched_priority = attr->priority,
+		};
+
+		ret = pthread_setschedparam(pthread_self(), attr->policy,
+				&param);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_setschedparam of a %s thread",
+					sched_type_names[type]);
+		}
+	}
+}
+
+#endif /* __linux__ */
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef LTTNG_CONSUMER_SCHED_H
+#define LTTNG_CONSUMER_SCHED_H
+
+#include <errno.h>
+
+#include <bin/lttng-consumerd/health-consumerd.h>
+
+/*
+ * Scheduling policy and CPU affinity of each type of consumer thread, as
+ * identified by its health type.
+ *
+ * A specification is a list of entries separated by ';', each of the form
+ * TYPE=POLICY[:PRIORITY][@CPUS], where TYPE is one of channel, metadata,
+ * data, sessiond, timer, writeback or spool, POLICY is fifo, rr or other and
+ * CPUS is a list of the form "0-3,8". For instance:
+ *
+ *   data=fifo:50@2-3;metadata=rr:10;timer=other@0
+ *
+ * The "other" policy keeps the default scheduling of the thread, only
+ * setting its affinity.
+ */
+
+#ifdef __linux__
+
+/*
+ * Parse a specification, overriding the settings of the thread types it
+ * lists. MUST be called before any consumer thread is launched.
+ *
+ * Return 0 on success or else -1, in which case no setting is changed.
+ */
+int consumer_sched_parse(const char *spec);
+
+/*
+ * Apply the settings of thread type "type", if any, to the calling thread.
+ * The failures, for instance for lack of the CAP_SYS_NICE capability, are
+ * reported but not fatal.
+ */
+void consumer_sched_apply(enum health_type_consumerd type);
+
+#else /* __linux__ */
+
+static inline int consumer_sched_parse(const char *spec)
+{
+	return -1;
+}
+
+static inline void consumer_sched_apply(enum health_type_consumerd type)
+{
+}
+
+#endif /* __linux__ */
+
+#endif /* LTTNG_CONSUMER_SCHED_H */
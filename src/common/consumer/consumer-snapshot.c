@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <urcu.h>
+#include <urcu/list.h>
+
+#include <common/common.h>
+
+#include "consumer-snapshot.h"
+
+/* Snapshot callback and lost packets of the streams of a channel. */
+struct snapshot_work {
+	pthread_mutex_t lock;
+	consumer_snapshot_stream_cb cb;
+	void *data;
+	uint64_t lost_packets;
+};
+
+static int snapshot_work_stream(struct lttng_consumer_stream *stream,
+		void *data)
+{
+	int ret;
+	uint64_t lost_packets = 0;
+	struct snapshot_work *work = data;
+
+	ret = work->cb(stream, work->data, &lost_packets);
+	pthread_mutex_lock(&work->lock);
+	work->lost_packets += lost_packets;
+	pthread_mutex_unlock(&work->lock);
+	return ret;
+}
+
+int consumer_snapshot_streams(struct lttng_consumer_channel *channel,
+		consumer_snapshot_stream_cb cb, void *data)
+{
+	int ret;
+	struct snapshot_work work = {
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+		.cb = cb,
+		.data = data,
+	};
+
+	ret = consumer_channel_streams_run(channel,
+			consumer_data.snapshot_threads, snapshot_work_stream,
+			&work);
+	channel->lost_packets += work.lost_packets;
+	return ret;
+}
+
+int consumer_snapshot_send_relayd_streams(struct lttng_consumer_channel *channel,
+		char *path, uint64_t relayd_id)
+{
+	int ret;
+	struct lttng_consumer_stream *stream;
+
+	cds_list_for_each_entry(stream, &channel->streams.head, send_node) {
+		pthread_mutex_lock(&stream->lock);
+		stream->net_seq_idx = relayd_id;
+		pthread_mutex_unlock(&stream->lock);
+	}
+
+	ret = consumer_send_relayd_channel_streams(channel, path);
+	if (ret < 0) {
+		ERR("sending the streams of channel %" PRIu64 " to relayd",
+				channel->key);
+		goto error;
+	}
+	ret = consumer_send_relayd_streams_sent(relayd_id);
+	if (ret < 0) {
+		ERR("sending streams sent to relayd");
+		goto error;
+	}
+	return 0;
+
+error:
+	consumer_close_relayd_channel_streams(channel, relayd_id);
+	return ret;
+}
+
+/* Packets held by a stream for the snapshot planning. */
+struct snapshot_plan_entry {
+	struct lttng_consumer_stream *stream;
+	uint64_t nb_packets;
+};
+
+static int compare_plan_entry(const void *a, const void *b)
+{
+	const struct snapshot_plan_entry *ea = a, *eb = b;
+
+	if (ea->nb_packets != eb->nb_packets) {
+		return ea->nb_packets < eb->nb_packets ? -1 : 1;
+	}
+	return 0;
+}
+
+/*
+ * Return the number of packets of a stream a snapshot can capture, counting
+ * the packet being written, which the snapshot flushes.
+ *
+ * Return 0 on error.
+ */
+static uint64_t sample_stream(struct lttng_consumer_stream *stream,
+		bool incremental, uint64_t output_id,
+		consumer_snapshot_sample_cb cb)
+{
+	int ret;
+	uint64_t nb_packets = 0;
+	unsigned long produced_pos, consumed_pos;
+
+	pthread_mutex_lock(&stream->lock);
+	ret = cb(stream, &produced_pos, &consumed_pos);
+	if (ret < 0 || !stream->max_sb_size) {
+		goto end;
+	}
+	if (incremental) {
+		consumed_pos = consumer_get_incremental_start_pos(stream,
+				consumed_pos, output_id);
+	}
+	if ((long) (produced_pos - consumed_pos) > 0) {
+		nb_packets = (produced_pos - consumed_pos) / stream->max_sb_size;
+	}
+	nb_packets++;
+end:
+	pthread_mutex_unlock(&stream->lock);
+	return nb_packets;
+}
+
+void consumer_snapshot_plan_streams(struct lttng_consumer_channel *channel,
+		uint64_t nb_packets_per_stream, bool incremental,
+		uint64_t output_id, consumer_snapshot_sample_cb cb)
+{
+	unsigned int i, nr_streams = 0;
+	uint64_t budget;
+	struct lttng_consumer_stream *stream;
+	struct snapshot_plan_entry *entries = NULL;
+
+	cds_list_for_each_entry(stream, &channel->streams.head, send_node) {
+		stream->snapshot_nb_packets = nb_packets_per_stream;
+		nr_streams++;
+	}
+	if (!nb_packets_per_stream || nr_streams < 2) {
+		/* Grabbing everything or a single stream. */
+		goto end;
+	}
+
+	entries = zmalloc(nr_streams * sizeof(*entries));
+	if (!entries) {
+		PERROR("zmalloc snapshot plan");
+		goto end;
+	}
+	i = 0;
+	cds_list_for_each_entry(stream, &channel->streams.head, send_node) {
+		entries[i].stream = stream;
+		entries[i].nb_packets = sample_stream(stream, incremental,
+				output_id, cb);
+		if (!entries[i].nb_packets) {
+			/* Keep the uniform count. */
+			goto end;
+		}
+		i++;
+	}
+
+	/*
+	 * Give each stream, from the quietest, its share of the budget left or
+	 * all of its packets if it holds less.
+	 */
+	qsort(entries, nr_streams, sizeof(*entries), compare_plan_entry);
+	budget = nb_packets_per_stream * nr_streams;
+	for (i = 0; i < nr_streams; i++) {
+		uint64_t share = budget / (nr_streams - i);
+
+		share = max_t(uint64_t, min(share, entries[i].nb_packets), 1);
+		budget -= min(share, budget);
+		entries[i].stream->snapshot_nb_packets = share;
+		DBG("Snapshot of stream %" PRIu64 " planned to %" PRIu64 " packets",
+				entries[i].stream->key, share);
+	}
+end:
+	free(entries);
+}
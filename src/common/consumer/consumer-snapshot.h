@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef LTTNG_CONSUMER_SNAPSHOT_H
+#define LTTNG_CONSUMER_SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "consumer.h"
+
+/*
+ * Capture the snapshot of one stream. The lost packets accounted while
+ * capturing the stream are added to "lost_packets".
+ *
+ * Return 0 on success or else a negative value.
+ */
+typedef int (*consumer_snapshot_stream_cb)(struct lttng_consumer_stream *stream,
+		void *data, uint64_t *lost_packets);
+
+/*
+ * Capture the snapshot of every stream of a channel by calling "cb" on each
+ * of them. The streams are spread over up to consumer_data.snapshot_threads
+ * threads, the calling thread included, so "cb" MUST only modify the state of
+ * the stream it is given.
+ *
+ * The lost packets of all the streams are added to the channel once every
+ * stream is captured. The capture stops at the first error.
+ *
+ * The RCU read side lock MUST be acquired.
+ *
+ * Return 0 on success or else the first error returned by "cb".
+ */
+int consumer_snapshot_streams(struct lttng_consumer_channel *channel,
+		consumer_snapshot_stream_cb cb, void *data);
+
+/*
+ * Add all the streams of a snapshot channel on the relayd of id "relayd_id"
+ * in bulk, before their capture, and send a single streams sent command.
+ * The streams are closed on the relayd in bulk, once captured, by
+ * consumer_close_relayd_channel_streams().
+ *
+ * The RCU read side lock MUST be acquired.
+ *
+ * Return 0 on success or else a negative value, the streams added to the
+ * relayd being closed on it.
+ */
+int consumer_snapshot_send_relayd_streams(struct lttng_consumer_channel *channel,
+		char *path, uint64_t relayd_id);
+
+/*
+ * Sample the produced and consumed positions of a stream, as seen by a
+ * snapshot taken right away. The stream lock is held by the caller.
+ *
+ * Return 0 on success or else a negative value.
+ */
+typedef int (*consumer_snapshot_sample_cb)(struct lttng_consumer_stream *stream,
+		unsigned long *produced_pos, unsigned long *consumed_pos);
+
+/*
+ * Plan the number of packets captured from each stream of a channel by a
+ * snapshot limited to "nb_packets_per_stream" packets per stream, set in
+ * the snapshot_nb_packets field of the streams.
+ *
+ * The budget of the channel, nb_packets_per_stream times its number of
+ * streams, is split between the streams weighted by the packets they
+ * actually hold, as sampled by "cb": the packets a quiet stream does not
+ * use go to the busier streams. An incremental snapshot only weights the
+ * packets following the last snapshot of each stream to "output_id".
+ * Every stream gets the uniform count if the sampling fails.
+ *
+ * The RCU read side lock MUST be acquired.
+ */
+void consumer_snapshot_plan_streams(struct lttng_consumer_channel *channel,
+		uint64_t nb_packets_per_stream, bool incremental,
+		uint64_t output_id, consumer_snapshot_sample_cb cb);
+
+#endif /* LTTNG_CONSUMER_SNAPSHOT_H */
@@ -0,0 +1,385 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include <assert.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <urcu.h>
+
+#include <bin/lttng-consumerd/health-consumerd.h>
+#include <common/common.h>
+#include <common/futex.h>
+#include <common/utils.h>
+#include <common/compat/endian.h>
+#include <common/relayd/relayd.h>
+
+#include "consumer-sched.h"
+#include "consumer-spool.h"
+
+static int spool_enabled;
+static int spool_quit;
+static char spool_dir[PATH_MAX];
+static uint64_t spool_max_bytes;
+
+/*
+ * Wakes the spool thread when a spool becomes non-empty. Scheme N wakers / 1
+ * waiter. See futex.c/.h
+ */
+static int32_t spool_futex;
+
+int consumer_spool_enable(const char *dir, uint64_t max_bytes)
+{
+	int ret;
+
+	ret = utils_mkdir_recursive(dir, S_IRWXU, -1, -1);
+	if (ret < 0) {
+		ERR("Creating spool directory %s", dir);
+		goto end;
+	}
+
+	strncpy(spool_dir, dir, sizeof(spool_dir));
+	spool_dir[sizeof(spool_dir) - 1] = '\0';
+	spool_max_bytes = max_bytes;
+	spool_enabled = 1;
+end:
+	return ret;
+}
+
+int consumer_spool_enabled(void)
+{
+	return spool_enabled;
+}
+
+void consumer_spool_stop(void)
+{
+	CMM_STORE_SHARED(spool_quit, 1);
+	futex_nto1_prepare(&spool_futex);
+	futex_nto1_wake(&spool_futex);
+}
+
+static int spool_empty(struct consumer_spool *spool)
+{
+	return spool->read_offset == spool->write_offset;
+}
+
+/*
+ * Return 1 if a send on the data socket would not block. A socket in error
+ * is reported as writable so that the send reports the error.
+ */
+static int sock_writable(struct consumer_relayd_data_sock *data_sock)
+{
+	struct pollfd pfd;
+
+	pfd.fd = data_sock->sock.sock.fd;
+	pfd.events = POLLOUT;
+	pfd.revents = 0;
+	return poll(&pfd, 1, 0) != 0;
+}
+
+/*
+ * Create the spool file of a data socket. The file is unlinked right away:
+ * the spooled packets are only replayed by this process.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static int spool_open(struct consumer_relayd_sock_pair *relayd,
+		struct consumer_relayd_data_sock *data_sock)
+{
+	int ret;
+	char path[PATH_MAX];
+
+	ret = snprintf(path, sizeof(path), "%s/consumerd-%d-%" PRIu64 "-%u",
+			spool_dir, (int) getpid(), relayd->net_seq_idx,
+			(unsigned int) (data_sock - relayd->data_socks));
+	if (ret < 0 || ret >= sizeof(path)) {
+		ERR("Spool file path too long in %s", spool_dir);
+		ret = -1;
+		goto end;
+	}
+
+	ret = open(path, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+	if (ret < 0) {
+		PERROR("open spool file %s", path);
+		goto end;
+	}
+	data_sock->spool.fd = ret;
+	(void) utils_set_fd_cloexec(data_sock->spool.fd);
+
+	ret = unlink(path);
+	if (ret < 0) {
+		PERROR("unlink spool file %s", path);
+	}
+	ret = 0;
+end:
+	return ret;
+}
+
+static int spool_pwrite(int fd, const void *buf, size_t len, off_t offset)
+{
+	ssize_t ret;
+	const char *p = buf;
+
+	while (len) {
+		ret = pwrite(fd, p, len, offset);
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			PERROR("pwrite spool");
+			return -1;
+		}
+		p += ret;
+		len -= ret;
+		offset += ret;
+	}
+	return 0;
+}
+
+/*
+ * Empty the spool of a data socket, reclaiming the space of its file.
+ */
+static void spool_reset(struct consumer_relayd_sock_pair *relayd,
+		struct consumer_spool *spool)
+{
+	int ret;
+
+	uatomic_sub(&relayd->spool_bytes,
+			spool->write_offset - spool->read_offset);
+	spool->read_offset = 0;
+	spool->write_offset = 0;
+	ret = ftruncate(spool->fd, 0);
+	if (ret < 0) {
+		PERROR("ftruncate spool");
+	}
+}
+
+/*
+ * Send the oldest spooled packet of a data socket to the relayd.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static int replay_packet(struct consumer_relayd_sock_pair *relayd,
+		struct consumer_relayd_data_sock *data_sock)
+{
+	int ret;
+	ssize_t sent;
+	size_t len;
+	off_t offset;
+	struct lttcomm_relayd_data_hdr hdr;
+	struct consumer_spool *spool = &data_sock->spool;
+
+	offset = spool->read_offset;
+	sent = pread(spool->fd, &hdr, sizeof(hdr), offset);
+	if (sent != sizeof(hdr)) {
+		PERROR("pread spool");
+		ret = -1;
+		goto end;
+	}
+	offset += sizeof(hdr);
+	len = be32toh(hdr.data_size);
+
+	ret = relayd_send_data_hdr(&data_sock->sock, &hdr, sizeof(hdr));
+	if (ret < 0) {
+		goto end;
+	}
+
+	while (len) {
+		sent = sendfile(data_sock->sock.sock.fd, spool->fd, &offset, len);
+		if (sent < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			PERROR("sendfile spool");
+			ret = -1;
+			goto end;
+		}
+		if (sent == 0) {
+			ERR("Spool file truncated");
+			ret = -1;
+			goto end;
+		}
+		len -= sent;
+	}
+
+	uatomic_sub(&relayd->spool_bytes, offset - spool->read_offset);
+	spool->read_offset = offset;
+	if (spool_empty(spool)) {
+		spool_reset(relayd, spool);
+	}
+	ret = 0;
+end:
+	return ret;
+}
+
+int consumer_spool_drain(struct consumer_relayd_sock_pair *relayd,
+		struct consumer_relayd_data_sock *data_sock)
+{
+	int ret = 0;
+	struct consumer_spool *spool = &data_sock->spool;
+
+	while (!spool_empty(spool)) {
+		ret = replay_packet(relayd, data_sock);
+		if (ret < 0) {
+			ERR("Dropping %" PRIu64 " spooled bytes of relayd %" PRIu64,
+					(uint64_t) (spool->write_offset -
+						spool->read_offset),
+					relayd->net_seq_idx);
+			spool_reset(relayd, spool);
+			break;
+		}
+	}
+	return ret;
+}
+
+int consumer_spool_packet(struct consumer_relayd_sock_pair *relayd,
+		struct consumer_relayd_data_sock *data_sock,
+		const struct lttcomm_relayd_data_hdr *hdr,
+		const void *buf, size_t len)
+{
+	int ret, was_empty;
+	size_t spool_len = sizeof(*hdr) + len;
+	struct consumer_spool *spool = &data_sock->spool;
+
+	was_empty = spool_empty(spool);
+	if (was_empty && sock_writable(data_sock)) {
+		ret = 0;
+		goto end;
+	}
+
+	if (uatomic_read(&relayd->spool_bytes) + spool_len > spool_max_bytes) {
+		goto drain;
+	}
+	if (spool->fd < 0 && spool_open(relayd, data_sock)) {
+		goto drain;
+	}
+	if (spool_pwrite(spool->fd, hdr, sizeof(*hdr), spool->write_offset) ||
+			spool_pwrite(spool->fd, buf, len,
+				spool->write_offset + sizeof(*hdr))) {
+		goto drain;
+	}
+	spool->write_offset += spool_len;
+	uatomic_add(&relayd->spool_bytes, spool_len);
+
+	if (was_empty) {
+		DBG("Spooling the packets of relayd %" PRIu64 " data socket %d",
+				relayd->net_seq_idx, data_sock->sock.sock.fd);
+		futex_nto1_wake(&spool_futex);
+	}
+	ret = 1;
+	goto end;
+
+drain:
+	/* The packet is sent after the spooled ones. */
+	ret = consumer_spool_drain(relayd, data_sock);
+end:
+	return ret;
+}
+
+/*
+ * Replay the spooled packets of every relayd while their data socket is
+ * writable.
+ *
+ * Return 1 if packets are left in a spool or else 0.
+ */
+static int replay_spools(void)
+{
+	int pending = 0;
+	unsigned int i;
+	struct lttng_ht_iter iter;
+	struct consumer_relayd_sock_pair *relayd;
+
+	rcu_read_lock();
+	cds_lfht_for_each_entry(consumer_data.relayd_ht->ht, &iter.iter, relayd,
+			node.node) {
+		if (!uatomic_read(&relayd->spool_bytes)) {
+			continue;
+		}
+
+		for (i = 0; i < CMM_LOAD_SHARED(relayd->nr_data_socks); i++) {
+			struct consumer_relayd_data_sock *data_sock =
+					&relayd->data_socks[i];
+
+			health_code_update();
+
+			pthread_mutex_lock(&data_sock->lock);
+			while (!spool_empty(&data_sock->spool) &&
+					sock_writable(data_sock)) {
+				if (replay_packet(relayd, data_sock)) {
+					/* The data threads see the relayd hang up. */
+					spool_reset(relayd, &data_sock->spool);
+					break;
+				}
+			}
+			if (!spool_empty(&data_sock->spool)) {
+				pending = 1;
+			}
+			pthread_mutex_unlock(&data_sock->lock);
+		}
+	}
+	rcu_read_unlock();
+
+	return pending;
+}
+
+void *consumer_thread_spool(void *data)
+{
+	rcu_register_thread();
+
+	health_register(health_consumerd, HEALTH_CONSUMERD_TYPE_SPOOL);
+	consumer_sched_apply(HEALTH_CONSUMERD_TYPE_SPOOL);
+
+	health_code_update();
+
+	DBG("[thread] Spool thread started");
+
+	for (;;) {
+		int quit, pending;
+
+		health_code_update();
+
+		futex_nto1_prepare(&spool_futex);
+		quit = CMM_LOAD_SHARED(spool_quit);
+
+		pending = replay_spools();
+
+		if (quit) {
+			break;
+		}
+
+		health_poll_entry();
+		if (pending) {
+			/* Wait for the stalled sockets to drain. */
+			(void) usleep(DEFAULT_CONSUMERD_SPOOL_REPLAY_PERIOD);
+		} else {
+			futex_nto1_wait(&spool_futex);
+		}
+		health_poll_exit();
+	}
+
+	health_unregister(health_consumerd);
+	DBG("Spool thread exiting");
+	rcu_unregister_thread();
+	return NULL;
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef LTTNG_CONSUMER_SPOOL_H
+#define LTTNG_CONSUMER_SPOOL_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <common/sessiond-comm/relayd.h>
+
+#include "consumer.h"
+
+/*
+ * Local spool of the relayd data connections.
+ *
+ * When the data socket of a relayd is stalled, the packets sent on it are
+ * appended to a spool file instead of blocking the data threads, up to a
+ * bound per relayd, that is per session. The spool thread replays them in
+ * order once the socket is writable again. A packet is never sent directly
+ * while the spool of its socket holds packets, which keeps the net_seq_num
+ * order of each stream. The indexes are still sent on the control socket as
+ * the packets are consumed: the relayd keeps an index until its data arrives.
+ */
+
+/*
+ * Enable the spool in the directory "dir", created if needed, with up to
+ * "max_bytes" spooled per relayd.
+ *
+ * MUST be called before any consumer thread is launched.
+ * Return 0 on success or else a negative value.
+ */
+int consumer_spool_enable(const char *dir, uint64_t max_bytes);
+
+int consumer_spool_enabled(void);
+
+/*
+ * Spool a packet of "len" bytes and its header, already in big endian, if
+ * the spool of the data socket holds packets or the socket is stalled. When
+ * the packet can't be spooled, the spool is replayed synchronously so that
+ * the caller can send it.
+ *
+ * The data socket lock MUST be acquired.
+ *
+ * Return 1 if the packet is spooled, 0 if the caller must send it or else a
+ * negative value if the relayd is unreachable.
+ */
+int consumer_spool_packet(struct consumer_relayd_sock_pair *relayd,
+		struct consumer_relayd_data_sock *data_sock,
+		const struct lttcomm_relayd_data_hdr *hdr,
+		const void *buf, size_t len);
+
+/*
+ * Replay the whole spool of a data socket synchronously. The spooled packets
+ * are dropped if the relayd is unreachable.
+ *
+ * The data socket lock MUST be acquired.
+ *
+ * Return 0 on success or else a negative value.
+ */
+int consumer_spool_drain(struct consumer_relayd_sock_pair *relayd,
+		struct consumer_relayd_data_sock *data_sock);
+
+/*
+ * Spool thread. It exits once consumer_spool_stop() is called.
+ */
+void *consumer_thread_spool(void *data);
+
+/*
+ * Ask the spool thread to exit. MUST be called before the relayds are
+ * destroyed on teardown, which drains their spools.
+ */
+void consumer_spool_stop(void);
+
+#endif /* LTTNG_CONSUMER_SPOOL_H */
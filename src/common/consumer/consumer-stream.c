@@ -19,11 +19,14 @@
 
 #define _LGPL_SOURCE
 #include <assert.h>
+#include <fcntl.h>
 #include <inttypes.h>
 #include <sys/mman.h>
 #include <unistd.h>
 
 #include <common/common.h>
+#include <common/compat/fcntl.h>
+#include <common/compat/io-uring.h>
 #include <common/index/index.h>
 #include <common/kernel-consumer/kernel-consumer.h>
 #include <common/relayd/relayd.h>
@@ -31,6 +34,8 @@
 #include <common/utils.h>
 
 #include "consumer-stream.h"
+#include "consumer-compress.h"
+#include "consumer-writeback.h"
 
 /*
  * RCU call to free stream. MUST only be used with call_rcu().
@@ -43,6 +48,11 @@ static void free_stream_rcu(struct rcu_head *head)
 		caa_container_of(node, struct lttng_consumer_stream, node);
 
 	pthread_mutex_destroy(&stream->lock);
+	free(stream->batch.buf);
+	free(stream->batch.indexes);
+	free(stream->direct_buf);
+	free(stream->rotate_path);
+	free(stream->chunk_path);
 	free(stream);
 }
 
@@ -67,7 +77,7 @@ void consumer_stream_relayd_close(struct lttng_consumer_stream *stream,
 	}
 
 	/* Closing streams requires to lock the control socket. */
-	pthread_mutex_lock(&relayd->ctrl_sock_mutex);
+	consumer_relayd_lock_control(relayd);
 	ret = relayd_send_close_stream(&relayd->control_sock,
 			stream->relayd_stream_id,
 			stream->next_net_seq_num - 1);
@@ -94,7 +104,6 @@ void consumer_stream_relayd_close(struct lttng_consumer_stream *stream,
  * Close stream's file descriptors and, if needed, close stream also on the
  * relayd side.
  *
- * The consumer data lock MUST be acquired.
  * The stream lock MUST be acquired.
  */
 void consumer_stream_close(struct lttng_consumer_stream *stream)
@@ -154,6 +163,13 @@ void consumer_stream_close(struct lttng_consumer_stream *stream)
 		assert(0);
 	}
 
+	/* The pending writes must complete before the output fd is closed. */
+	lttng_io_uring_destroy(stream->io_uring);
+	stream->io_uring = NULL;
+	consumer_writeback_wait(stream);
+	consumer_compress_destroy(stream->compress);
+	stream->compress = NULL;
+
 	/* Close output fd. Could be a socket or local file at this point. */
 	if (stream->out_fd >= 0) {
 		ret = close(stream->out_fd);
@@ -162,12 +178,22 @@ void consumer_stream_close(struct lttng_consumer_stream *stream)
 		}
 		stream->out_fd = -1;
 	}
+	if (stream->out_dir_fd >= 0) {
+		ret = close(stream->out_dir_fd);
+		if (ret) {
+			PERROR("close");
+		}
+		stream->out_dir_fd = -1;
+	}
 
 	if (stream->index_file) {
 		lttng_index_file_put(stream->index_file);
 		stream->index_file = NULL;
 	}
 
+	utils_close_pipe(stream->snapshot_pipe);
+	stream->snapshot_pipe[0] = stream->snapshot_pipe[1] = -1;
+
 	/* Check and cleanup relayd if needed. */
 	rcu_read_lock();
 	relayd = consumer_find_relayd(stream->net_seq_idx);
@@ -180,7 +206,6 @@ void consumer_stream_close(struct lttng_consumer_stream *stream)
 /*
  * Delete the stream from all possible hash tables.
  *
- * The consumer data lock MUST be acquired.
  * The stream lock MUST be acquired.
  */
 void consumer_stream_delete(struct lttng_consumer_stream *stream,
@@ -220,8 +245,8 @@ void consumer_stream_delete(struct lttng_consumer_stream *stream,
 
 	if (!stream->metadata_flag) {
 		/* Decrement the stream count of the global consumer data. */
-		assert(consumer_data.stream_count > 0);
-		consumer_data.stream_count--;
+		assert(uatomic_read(&consumer_data.stream_count) > 0);
+		uatomic_dec(&consumer_data.stream_count);
 	}
 }
 
@@ -232,7 +257,7 @@ void consumer_stream_free(struct lttng_consumer_stream *stream)
 {
 	assert(stream);
 
-	call_rcu(&stream->node.head, free_stream_rcu);
+	lttng_ht_defer_free(&stream->node.head, free_stream_rcu);
 }
 
 /*
@@ -301,6 +326,16 @@ static struct lttng_consumer_channel *unref_channel(
  */
 void consumer_stream_destroy(struct lttng_consumer_stream *stream,
 		struct lttng_ht *ht)
+{
+	consumer_stream_destroy_batch(stream, ht, NULL);
+}
+
+/*
+ * Destroy a stream like consumer_stream_destroy() but free it with the objects
+ * of "free_batch", or after a grace period of its own if NULL.
+ */
+void consumer_stream_destroy_batch(struct lttng_consumer_stream *stream,
+		struct lttng_ht *ht, struct lttng_ht_free_batch *free_batch)
 {
 	assert(stream);
 
@@ -314,7 +349,6 @@ void consumer_stream_destroy(struct lttng_consumer_stream *stream,
 		 * stream thus being globally visible.
 		 */
 		if (stream->globally_visible) {
-			pthread_mutex_lock(&consumer_data.lock);
 			pthread_mutex_lock(&stream->chan->lock);
 			pthread_mutex_lock(&stream->lock);
 			/* Remove every reference of the stream in the consumer. */
@@ -325,16 +359,12 @@ void consumer_stream_destroy(struct lttng_consumer_stream *stream,
 			/* Update channel's refcount of the stream. */
 			free_chan = unref_channel(stream);
 
-			/* Indicates that the consumer data state MUST be updated after this. */
-			consumer_data.need_update = 1;
-
 			pthread_mutex_unlock(&stream->lock);
 			pthread_mutex_unlock(&stream->chan->lock);
-			pthread_mutex_unlock(&consumer_data.lock);
 		} else {
 			/*
 			 * If the stream is not visible globally, this needs to be done
-			 * outside of the consumer data lock section.
+			 * outside of the channel lock section.
 			 */
 			free_chan = unref_channel(stream);
 		}
@@ -347,7 +377,39 @@ void consumer_stream_destroy(struct lttng_consumer_stream *stream,
 	}
 
 	/* Free stream within a RCU call. */
-	consumer_stream_free(stream);
+	lttng_ht_free_batch_add(free_batch, &stream->node.head,
+			free_stream_rcu);
+}
+
+/*
+ * Queue a packet index in the batch of a stream.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static int batch_add_index(struct consumer_stream_batch *batch,
+		struct ctf_packet_index *element)
+{
+	int ret = 0;
+
+	if (batch->nr_indexes == batch->alloc_indexes) {
+		struct ctf_packet_index *new_indexes;
+		unsigned int new_alloc = max_t(unsigned int,
+				batch->alloc_indexes << 1, 16);
+
+		new_indexes = realloc(batch->indexes,
+				new_alloc * sizeof(*new_indexes));
+		if (!new_indexes) {
+			PERROR("realloc batch indexes");
+			ret = -1;
+			goto end;
+		}
+		batch->indexes = new_indexes;
+		batch->alloc_indexes = new_alloc;
+	}
+	batch->indexes[batch->nr_indexes++] = *element;
+
+end:
+	return ret;
 }
 
 /*
@@ -363,15 +425,19 @@ int consumer_stream_write_index(struct lttng_consumer_stream *stream,
 	assert(stream);
 	assert(element);
 
+	if (stream->batch.active) {
+		/* Written once the batched data is written. */
+		ret = batch_add_index(&stream->batch, element);
+		goto end;
+	}
+
 	rcu_read_lock();
 	if (stream->net_seq_idx != (uint64_t) -1ULL) {
 		struct consumer_relayd_sock_pair *relayd;
 		relayd = consumer_find_relayd(stream->net_seq_idx);
 		if (relayd) {
-			pthread_mutex_lock(&relayd->ctrl_sock_mutex);
-			ret = relayd_send_index(&relayd->control_sock, element,
-				stream->relayd_stream_id, stream->next_net_seq_num - 1);
-			pthread_mutex_unlock(&relayd->ctrl_sock_mutex);
+			ret = consumer_relayd_send_index(relayd, stream,
+					element);
 		} else {
 			ERR("Stream %" PRIu64 " relayd ID %" PRIu64 " unknown. Can't write index.",
 					stream->key, stream->net_seq_idx);
@@ -390,6 +456,40 @@ int consumer_stream_write_index(struct lttng_consumer_stream *stream,
 
 error:
 	rcu_read_unlock();
+end:
+	return ret;
+}
+
+int consumer_stream_open_snapshot_index(struct lttng_consumer_stream *stream,
+		char *path)
+{
+	int ret;
+
+	assert(stream);
+	assert(!stream->index_file);
+
+	if (stream->net_seq_idx != (uint64_t) -1ULL) {
+		struct consumer_relayd_sock_pair *relayd;
+
+		rcu_read_lock();
+		relayd = consumer_find_relayd(stream->net_seq_idx);
+		ret = relayd &&
+				relayd_supports_snapshot_index(&relayd->control_sock);
+		rcu_read_unlock();
+		goto end;
+	}
+
+	stream->index_file = lttng_index_file_create(path,
+			stream->name, stream->uid, stream->gid,
+			stream->chan->tracefile_size,
+			stream->tracefile_count_current,
+			CTF_INDEX_MAJOR, CTF_INDEX_MINOR);
+	if (!stream->index_file) {
+		ret = -1;
+		goto end;
+	}
+	ret = 1;
+end:
 	return ret;
 }
 
@@ -551,3 +651,220 @@ end:
 	rcu_read_unlock();
 	return ret;
 }
+
+/*
+ * Prepare the newly created local output file of a data stream: preallocate
+ * it up to the tracefile size of the channel and switch it to direct I/O if
+ * enabled.
+ *
+ * Errors are not fatal, the file is then written as usual.
+ *
+ * The stream lock MUST be acquired.
+ */
+void consumer_stream_setup_output_file(struct lttng_consumer_stream *stream)
+{
+	int ret;
+
+	assert(stream);
+
+	stream->out_fd_direct = 0;
+
+	if (stream->metadata_flag || stream->out_fd < 0 ||
+			stream->net_seq_idx != (uint64_t) -1ULL) {
+		goto end;
+	}
+
+	if (consumer_data.preallocate && stream->chan->tracefile_size > 0) {
+		/*
+		 * Keep the size so that readers of a live file and the
+		 * tracefile rotation still see the data actually written.
+		 */
+		ret = lttng_fallocate_keep_size(stream->out_fd, 0,
+				stream->chan->tracefile_size);
+		if (ret < 0) {
+			DBG("Preallocation of stream %" PRIu64 " output file failed: %s",
+					stream->key, strerror(-ret));
+		}
+	}
+
+#ifdef O_DIRECT
+	if (consumer_data.direct_io &&
+			stream->chan->output != CONSUMER_CHANNEL_SPLICE) {
+		int flags;
+
+		flags = fcntl(stream->out_fd, F_GETFL);
+		if (flags < 0) {
+			PERROR("fcntl F_GETFL on stream %" PRIu64 " output file",
+					stream->key);
+			goto end;
+		}
+		ret = fcntl(stream->out_fd, F_SETFL, flags | O_DIRECT);
+		if (ret < 0) {
+			/* The filesystem may not support direct I/O. */
+			DBG("Direct I/O unavailable for stream %" PRIu64 " output file",
+					stream->key);
+			goto end;
+		}
+		stream->out_fd_direct = 1;
+	}
+#endif /* O_DIRECT */
+
+end:
+	return;
+}
+
+/*
+ * Open the output directory of a local stream rotating through tracefiles so
+ * that the unlinking and creation of its tracefiles do not resolve the
+ * directory path each time.
+ */
+void consumer_stream_open_output_dir(struct lttng_consumer_stream *stream)
+{
+	assert(stream);
+	assert(stream->out_dir_fd < 0);
+
+	if (stream->net_seq_idx != (uint64_t) -1ULL ||
+			stream->chan->tracefile_size == 0) {
+		return;
+	}
+
+	stream->out_dir_fd = utils_open_stream_dir(
+			consumer_stream_output_path(stream),
+			stream->uid, stream->gid);
+	if (stream->out_dir_fd < 0) {
+		DBG("Stream %" PRIu64 " tracefiles are rotated by path",
+				stream->key);
+	}
+}
+
+/*
+ * Switch the output file of a stream back to buffered I/O. This is needed as
+ * soon as a write is not aligned on DEFAULT_CONSUMERD_DIRECT_IO_ALIGN.
+ *
+ * The stream lock MUST be acquired.
+ */
+void consumer_stream_clear_direct_io(struct lttng_consumer_stream *stream)
+{
+#ifdef O_DIRECT
+	int flags;
+
+	assert(stream);
+
+	if (!stream->out_fd_direct) {
+		goto end;
+	}
+
+	/* Pending asynchronous writes are aligned, complete them first. */
+	(void) lttng_io_uring_drain(stream->io_uring);
+
+	flags = fcntl(stream->out_fd, F_GETFL);
+	if (flags >= 0) {
+		flags = fcntl(stream->out_fd, F_SETFL, flags & ~O_DIRECT);
+	}
+	if (flags < 0) {
+		PERROR("fcntl clearing O_DIRECT on stream %" PRIu64 " output file",
+				stream->key);
+	}
+	DBG("Stream %" PRIu64 " output file switched to buffered I/O",
+			stream->key);
+	stream->out_fd_direct = 0;
+end:
+#endif /* O_DIRECT */
+	return;
+}
+
+/*
+ * Return the directory of the local output files of a stream: the one of its
+ * current trace chunk once rotated, the channel's path otherwise.
+ *
+ * The stream lock MUST be acquired.
+ */
+char *consumer_stream_output_path(struct lttng_consumer_stream *stream)
+{
+	assert(stream);
+
+	return stream->chunk_path ? stream->chunk_path : stream->chan->pathname;
+}
+
+/*
+ * Switch the local output files of a stream to the trace chunk of its pending
+ * rotation. The output files of the current chunk are closed once their
+ * pending writes complete, and the stream starts over from the first
+ * tracefile of the new chunk.
+ *
+ * The stream lock MUST be acquired and no batched data may be pending.
+ *
+ * Return 0 on success or else a negative value.
+ */
+int consumer_stream_rotate_chunk(struct lttng_consumer_stream *stream)
+{
+	int ret;
+
+	assert(stream);
+	assert(stream->rotate_path);
+	assert(stream->net_seq_idx == (uint64_t) -1ULL);
+
+	/* The writes in flight target the files of the current chunk. */
+	if (stream->io_uring) {
+		ret = lttng_io_uring_drain(stream->io_uring);
+		if (ret < 0) {
+			goto end;
+		}
+	}
+	consumer_writeback_wait(stream);
+
+	if (stream->out_fd >= 0) {
+		ret = close(stream->out_fd);
+		if (ret) {
+			PERROR("close");
+		}
+		stream->out_fd = -1;
+	}
+	if (stream->out_dir_fd >= 0) {
+		ret = close(stream->out_dir_fd);
+		if (ret) {
+			PERROR("close");
+		}
+		stream->out_dir_fd = -1;
+	}
+	if (stream->index_file) {
+		lttng_index_file_put(stream->index_file);
+		stream->index_file = NULL;
+	}
+
+	free(stream->chunk_path);
+	stream->chunk_path = stream->rotate_path;
+	stream->rotate_path = NULL;
+
+	stream->tracefile_count_current = 0;
+	ret = utils_create_stream_file(stream->chunk_path, stream->name,
+			stream->chan->tracefile_size,
+			stream->tracefile_count_current, stream->uid, stream->gid,
+			NULL);
+	if (ret < 0) {
+		goto end;
+	}
+	stream->out_fd = ret;
+	stream->out_fd_offset = 0;
+	stream->tracefile_size_current = 0;
+	consumer_stream_setup_output_file(stream);
+	consumer_stream_open_output_dir(stream);
+
+	if (!stream->metadata_flag) {
+		stream->index_file = lttng_index_file_create(stream->chunk_path,
+				stream->name, stream->uid, stream->gid,
+				stream->chan->tracefile_size,
+				stream->tracefile_count_current,
+				CTF_INDEX_MAJOR, CTF_INDEX_MINOR);
+		if (!stream->index_file) {
+			ret = -1;
+			goto end;
+		}
+	}
+
+	DBG("Stream %" PRIu64 " rotated to the trace chunk %s", stream->key,
+			stream->chunk_path);
+	ret = 0;
+end:
+	return ret;
+}
@@ -25,7 +25,6 @@
  * relayd side.
  *
  * The stream lock MUST be acquired.
- * The consumer data lock MUST be acquired.
  */
 void consumer_stream_close(struct lttng_consumer_stream *stream);
 
@@ -42,7 +41,7 @@ void consumer_stream_relayd_close(struct lttng_consumer_stream *stream,
 /*
  * Delete the stream from all possible hash tables.
  *
- * The consumer data lock MUST be acquired.
+ * The stream lock MUST be acquired.
  */
 void consumer_stream_delete(struct lttng_consumer_stream *stream,
 		struct lttng_ht *ht);
@@ -62,6 +61,14 @@ void consumer_stream_free(struct lttng_consumer_stream *stream);
 void consumer_stream_destroy(struct lttng_consumer_stream *stream,
 		struct lttng_ht *ht);
 
+/*
+ * Destroy a stream like consumer_stream_destroy() but free it after the grace
+ * period of a batch, shared by the streams of a table being torn down. A NULL
+ * batch frees the stream after a grace period of its own.
+ */
+void consumer_stream_destroy_batch(struct lttng_consumer_stream *stream,
+		struct lttng_ht *ht, struct lttng_ht_free_batch *free_batch);
+
 /*
  * Destroy the stream's buffers on the tracer side. This is also called in a
  * stream destroy.
@@ -74,7 +81,45 @@ void consumer_stream_destroy_buffers(struct lttng_consumer_stream *stream);
 int consumer_stream_write_index(struct lttng_consumer_stream *stream,
 		struct ctf_packet_index *index);
 
+/*
+ * Open the index of the snapshot of a stream written locally in path, or sent
+ * to its relayd. The stream lock MUST be held.
+ *
+ * Return 1 if the packets of the snapshot are indexed, 0 if the relayd of the
+ * stream does not index the snapshots, or a negative value on error.
+ */
+int consumer_stream_open_snapshot_index(struct lttng_consumer_stream *stream,
+		char *path);
+
 int consumer_stream_sync_metadata(struct lttng_consumer_local_data *ctx,
 		uint64_t session_id);
 
+/*
+ * Preallocate and/or switch to direct I/O the new local output file of a data
+ * stream according to the consumer settings.
+ */
+void consumer_stream_setup_output_file(struct lttng_consumer_stream *stream);
+
+/*
+ * Open the output directory of a local stream rotating through tracefiles.
+ * On failure, the tracefiles are rotated using their full path.
+ */
+void consumer_stream_open_output_dir(struct lttng_consumer_stream *stream);
+
+/*
+ * Switch the output file of a stream back to buffered I/O.
+ */
+void consumer_stream_clear_direct_io(struct lttng_consumer_stream *stream);
+
+/*
+ * Return the directory of the local output files of a stream.
+ */
+char *consumer_stream_output_path(struct lttng_consumer_stream *stream);
+
+/*
+ * Switch the local output files of a stream to the trace chunk of its pending
+ * rotation.
+ */
+int consumer_stream_rotate_chunk(struct lttng_consumer_stream *stream);
+
 #endif /* LTTNG_CONSUMER_STREAM_H */
@@ -19,17 +19,22 @@
 #define _LGPL_SOURCE
 #include <assert.h>
 #include <inttypes.h>
-#include <signal.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
 
 #include <bin/lttng-sessiond/ust-ctl.h>
 #include <bin/lttng-consumerd/health-consumerd.h>
 #include <common/common.h>
 #include <common/compat/endian.h>
+#include <common/compat/time.h>
+#include <common/time.h>
 #include <common/kernel-ctl/kernel-ctl.h>
 #include <common/kernel-consumer/kernel-consumer.h>
 #include <common/consumer/consumer-stream.h>
 #include <common/consumer/consumer-timer.h>
 #include <common/consumer/consumer-testpoint.h>
+#include <common/consumer/consumer-sched.h>
+#include <common/relayd/relayd.h>
 #include <common/ust-consumer/ust-consumer.h>
 
 typedef int (*sample_positions_cb)(struct lttng_consumer_stream *stream);
@@ -38,47 +43,71 @@ typedef int (*get_consumed_cb)(struct lttng_consumer_stream *stream,
 typedef int (*get_produced_cb)(struct lttng_consumer_stream *stream,
 		unsigned long *produced);
 
-static struct timer_signal_data timer_signal = {
-	.tid = 0,
-	.setup_done = 0,
-	.qs_done = 0,
+/*
+ * Resolution of the timer wheel. The deadlines are rounded up to a tick so
+ * that the timers expiring within the same tick are handled on a single
+ * wakeup.
+ */
+#define TIMER_WHEEL_TICK_NS	NSEC_PER_MSEC
+/*
+ * Number of slots of the timer wheel, a power of two. A timer expires in the
+ * slot of its deadline tick modulo the number of slots: the wheel spans about
+ * 16 seconds, a longer interval costs one extra slot visit per revolution.
+ */
+#define TIMER_WHEEL_SLOTS	16384
+#define TIMER_WHEEL_WORD_BITS	64
+
+/*
+ * Timer wheel of the channel timers, driven by a single timerfd read by the
+ * timer thread.
+ *
+ * The timer thread runs the expired timers one at a time without the wheel
+ * lock held. Stopping a timer waits for the completion of its running
+ * handler, after which the handler is guaranteed not to be called again for
+ * that timer, so the channel can be freed.
+ */
+static struct timer_wheel {
+	pthread_mutex_t lock;
+	/* Signaled each time the running timer handler completes. */
+	pthread_cond_t cond;
+	int timerfd;
+	/* Every tick below current_tick has been processed. */
+	uint64_t current_tick;
+	/* Absolute deadline (nsec) of the armed timerfd, 0 if disarmed. */
+	uint64_t armed_ns;
+	/* Timer whose handler is running, if any. */
+	struct consumer_timer *running;
+	pthread_t tid;
+	int quit;
+	struct cds_list_head slots[TIMER_WHEEL_SLOTS];
+	/* One bit per non-empty slot. */
+	uint64_t slot_map[TIMER_WHEEL_SLOTS / TIMER_WHEEL_WORD_BITS];
+} timer_wheel = {
 	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+	.timerfd = -1,
 };
 
+static int channel_monitor_pipe = -1;
+/* Samples of the monitor timers run on the current timer wakeup. */
+static struct lttcomm_consumer_channel_monitor_batch_msg monitor_batch;
+
 /*
- * Set custom signal mask to current thread.
+ * Live beacons of the idle network streams found by the live timers run on
+ * the current timer wakeup, one batch per relayd. Only used by the timer
+ * thread.
  */
-static void setmask(sigset_t *mask)
-{
-	int ret;
-
-	ret = sigemptyset(mask);
-	if (ret) {
-		PERROR("sigemptyset");
-	}
-	ret = sigaddset(mask, LTTNG_CONSUMER_SIG_SWITCH);
-	if (ret) {
-		PERROR("sigaddset switch");
-	}
-	ret = sigaddset(mask, LTTNG_CONSUMER_SIG_TEARDOWN);
-	if (ret) {
-		PERROR("sigaddset teardown");
-	}
-	ret = sigaddset(mask, LTTNG_CONSUMER_SIG_LIVE);
-	if (ret) {
-		PERROR("sigaddset live");
-	}
-	ret = sigaddset(mask, LTTNG_CONSUMER_SIG_MONITOR);
-	if (ret) {
-		PERROR("sigaddset monitor");
-	}
-	ret = sigaddset(mask, LTTNG_CONSUMER_SIG_EXIT);
-	if (ret) {
-		PERROR("sigaddset exit");
-	}
-}
+struct beacon_batch {
+	/* Key of the relayd of the batch, -1ULL if unused. */
+	uint64_t net_seq_idx;
+	unsigned int nb_beacons;
+	struct lttcomm_relayd_beacon beacons[RELAYD_BEACONS_MAX];
+};
 
-static int channel_monitor_pipe = -1;
+static struct {
+	unsigned int nb_batches;
+	struct beacon_batch **batches;
+} beacon_batches;
 
 /*
  * Execute action on a timer switch.
@@ -88,12 +117,10 @@ static int channel_monitor_pipe = -1;
  * deadlocks.
  */
 static void metadata_switch_timer(struct lttng_consumer_local_data *ctx,
-		int sig, siginfo_t *si)
+		struct lttng_consumer_channel *channel)
 {
 	int ret;
-	struct lttng_consumer_channel *channel;
 
-	channel = si->si_value.sival_ptr;
 	assert(channel);
 
 	if (channel->switch_timer_error) {
@@ -130,12 +157,285 @@ static void metadata_switch_timer(struct lttng_consumer_local_data *ctx,
 	}
 }
 
+/*
+ * Switch the sub-buffer of a stream of a user space data channel unless it
+ * produced too few data since its last switch and was not skipped for too
+ * many periods already. The flush wakes up the data thread through the
+ * stream's wakeup fd, like the tracer's switch timer.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static int switch_ust_stream(struct lttng_consumer_stream *stream)
+{
+	int ret;
+	unsigned long produced;
+
+	assert(stream);
+	assert(stream->ustream);
+
+	/*
+	 * Same as check_ust_stream(): never wait on a stream waiting on the
+	 * metadata pushed by this thread. Its switch is simply skipped for this
+	 * period since it is being consumed.
+	 */
+	for (;;) {
+		ret = pthread_mutex_trylock(&stream->lock);
+		switch (ret) {
+		case 0:
+			break;	/* We have the lock. */
+		case EBUSY:
+			pthread_mutex_lock(&stream->metadata_timer_lock);
+			if (stream->waiting_on_metadata) {
+				pthread_mutex_unlock(&stream->metadata_timer_lock);
+				ret = 0;
+				goto end;	/* Bail out. */
+			}
+			pthread_mutex_unlock(&stream->metadata_timer_lock);
+			/* Try again. */
+			caa_cpu_relax();
+			continue;
+		default:
+			ERR("Unexpected pthread_mutex_trylock error %d", ret);
+			ret = -1;
+			goto end;
+		}
+		break;
+	}
+
+	if (cds_lfht_is_node_deleted(&stream->node.node)) {
+		ret = 0;
+		goto end_unlock;
+	}
+
+	ret = lttng_ustconsumer_sample_snapshot_positions(stream);
+	if (ret < 0) {
+		ERR("Failed to sample the positions of stream %" PRIu64,
+				stream->key);
+		goto end_unlock;
+	}
+	ret = lttng_ustconsumer_get_produced_snapshot(stream, &produced);
+	if (ret < 0) {
+		ERR("Failed to get the produced position of stream %" PRIu64,
+				stream->key);
+		goto end_unlock;
+	}
+
+	if (produced == stream->switch_produced_pos) {
+		/* Nothing to switch. */
+		stream->switch_skipped = 0;
+		goto end_unlock;
+	}
+	if (produced - stream->switch_produced_pos <
+			stream->max_sb_size / DEFAULT_CONSUMERD_SWITCH_QUIET_DIV &&
+			stream->switch_skipped < consumer_data.switch_skip_max) {
+		stream->switch_skipped++;
+		goto end_unlock;
+	}
+
+	lttng_ustconsumer_flush_buffer(stream, 1);
+	stream->switch_skipped = 0;
+
+	/* Start counting from the beginning of the new sub-buffer. */
+	ret = lttng_ustconsumer_sample_snapshot_positions(stream);
+	if (!ret) {
+		ret = lttng_ustconsumer_get_produced_snapshot(stream, &produced);
+	}
+	if (ret < 0) {
+		ERR("Failed to get the produced position of stream %" PRIu64,
+				stream->key);
+		goto end_unlock;
+	}
+	stream->switch_produced_pos = produced;
+
+end_unlock:
+	pthread_mutex_unlock(&stream->lock);
+end:
+	return ret;
+}
+
+/*
+ * Execute action on the switch timer of a user space data channel.
+ */
+static void data_switch_timer(struct lttng_consumer_local_data *ctx,
+		struct lttng_consumer_channel *channel)
+{
+	int ret;
+	struct lttng_consumer_stream *stream;
+	struct lttng_ht *ht;
+	struct lttng_ht_iter iter;
+
+	assert(channel);
+
+	if (channel->switch_timer_error) {
+		return;
+	}
+	ht = consumer_data.stream_per_chan_id_ht;
+
+	DBG("Switch timer for channel %" PRIu64, channel->key);
+
+	switch (ctx->type) {
+	case LTTNG_CONSUMER32_UST:
+	case LTTNG_CONSUMER64_UST:
+		rcu_read_lock();
+		cds_lfht_for_each_entry_duplicate(ht->ht,
+				ht->hash_fct(&channel->key, lttng_ht_seed),
+				ht->match_fct, &channel->key, &iter.iter,
+				stream, node_channel_id.node) {
+			ret = switch_ust_stream(stream);
+			if (ret < 0) {
+				channel->switch_timer_error = 1;
+				break;
+			}
+		}
+		rcu_read_unlock();
+		break;
+	case LTTNG_CONSUMER_KERNEL:
+	case LTTNG_CONSUMER_UNKNOWN:
+		assert(0);
+		break;
+	}
+}
+
+/*
+ * Send the pending live beacons of a relayd and reset its batch.
+ *
+ * RCU read side lock MUST be acquired.
+ */
+static void beacon_batch_flush(struct beacon_batch *batch)
+{
+	int ret;
+	struct consumer_relayd_sock_pair *relayd;
+
+	if (!batch->nb_beacons) {
+		return;
+	}
+
+	relayd = consumer_find_relayd(batch->net_seq_idx);
+	if (relayd) {
+		/* The queued indexes precede the beacons of their streams. */
+		consumer_relayd_lock_control(relayd);
+		ret = relayd_send_beacons(&relayd->control_sock,
+				batch->beacons, batch->nb_beacons);
+		pthread_mutex_unlock(&relayd->ctrl_sock_mutex);
+		if (ret < 0) {
+			ERR("Failed to send %u live beacons to relayd %" PRIu64,
+					batch->nb_beacons, batch->net_seq_idx);
+		}
+	} else {
+		DBG("Relayd %" PRIu64 " unknown, dropping %u live beacons",
+				batch->net_seq_idx, batch->nb_beacons);
+	}
+	batch->nb_beacons = 0;
+}
+
+/*
+ * Send the live beacons queued by the live timers of this timer wakeup.
+ */
+static void beacon_batches_flush(void)
+{
+	unsigned int i;
+
+	rcu_read_lock();
+	for (i = 0; i < beacon_batches.nb_batches; i++) {
+		beacon_batch_flush(beacon_batches.batches[i]);
+	}
+	rcu_read_unlock();
+}
+
+/*
+ * Return the beacon batch of a relayd, creating it if needed, or NULL on
+ * allocation error.
+ */
+static struct beacon_batch *get_beacon_batch(uint64_t net_seq_idx)
+{
+	unsigned int i;
+	struct beacon_batch *batch, **batches;
+
+	for (i = 0; i < beacon_batches.nb_batches; i++) {
+		batch = beacon_batches.batches[i];
+		if (batch->net_seq_idx == net_seq_idx) {
+			return batch;
+		}
+	}
+	/* Reuse the batch of a relayd that went away. */
+	for (i = 0; i < beacon_batches.nb_batches; i++) {
+		batch = beacon_batches.batches[i];
+		if (!batch->nb_beacons &&
+				!consumer_find_relayd(batch->net_seq_idx)) {
+			batch->net_seq_idx = net_seq_idx;
+			return batch;
+		}
+	}
+
+	batches = realloc(beacon_batches.batches,
+			(beacon_batches.nb_batches + 1) * sizeof(*batches));
+	if (!batches) {
+		PERROR("realloc beacon batches");
+		return NULL;
+	}
+	beacon_batches.batches = batches;
+	batch = zmalloc(sizeof(*batch));
+	if (!batch) {
+		PERROR("zmalloc beacon batch");
+		return NULL;
+	}
+	batch->net_seq_idx = net_seq_idx;
+	batches[beacon_batches.nb_batches++] = batch;
+	return batch;
+}
+
+/*
+ * Queue the live beacon of a network stream in the batch of its relayd when
+ * called from the timer thread and the relayd supports batched beacons.
+ *
+ * Return 0 if queued, else a negative value, in which case the beacon must be
+ * sent as an empty index.
+ */
+static int queue_beacon(struct lttng_consumer_stream *stream, uint64_t ts)
+{
+	int ret = -1;
+	struct beacon_batch *batch;
+	struct lttcomm_relayd_beacon *beacon;
+	struct consumer_relayd_sock_pair *relayd;
+
+	if (stream->net_seq_idx == (uint64_t) -1ULL ||
+			!pthread_equal(timer_wheel.tid, pthread_self())) {
+		goto end;
+	}
+
+	rcu_read_lock();
+	relayd = consumer_find_relayd(stream->net_seq_idx);
+	if (!relayd || !relayd_supports_beacons(&relayd->control_sock)) {
+		goto end_unlock;
+	}
+	batch = get_beacon_batch(stream->net_seq_idx);
+	if (!batch) {
+		goto end_unlock;
+	}
+	if (batch->nb_beacons == RELAYD_BEACONS_MAX) {
+		beacon_batch_flush(batch);
+	}
+	beacon = &batch->beacons[batch->nb_beacons++];
+	beacon->relay_stream_id = htobe64(stream->relayd_stream_id);
+	beacon->timestamp_end = htobe64(ts);
+	ret = 0;
+end_unlock:
+	rcu_read_unlock();
+end:
+	return ret;
+}
+
 static int send_empty_index(struct lttng_consumer_stream *stream, uint64_t ts,
 		uint64_t stream_id)
 {
 	int ret;
 	struct ctf_packet_index index;
 
+	ret = queue_beacon(stream, ts);
+	if (!ret) {
+		goto error;
+	}
+
 	memset(&index, 0, sizeof(index));
 	index.stream_id = htobe64(stream_id);
 	index.timestamp_end = htobe64(ts);
@@ -321,15 +621,13 @@ end:
  * Execute action on a live timer
  */
 static void live_timer(struct lttng_consumer_local_data *ctx,
-		int sig, siginfo_t *si)
+		struct lttng_consumer_channel *channel)
 {
 	int ret;
-	struct lttng_consumer_channel *channel;
 	struct lttng_consumer_stream *stream;
 	struct lttng_ht *ht;
 	struct lttng_ht_iter iter;
 
-	channel = si->si_value.sival_ptr;
 	assert(channel);
 
 	if (channel->switch_timer_error) {
@@ -376,72 +674,170 @@ error:
 	return;
 }
 
-static
-void consumer_timer_signal_thread_qs(unsigned int signr)
+/*
+ * Arm the timerfd for the absolute deadline "deadline_ns", or disarm it if 0.
+ *
+ * The wheel lock MUST be acquired.
+ */
+static void timer_wheel_arm(uint64_t deadline_ns)
 {
-	sigset_t pending_set;
 	int ret;
+	struct itimerspec its;
 
-	/*
-	 * We need to be the only thread interacting with the thread
-	 * that manages signals for teardown synchronization.
-	 */
-	pthread_mutex_lock(&timer_signal.lock);
+	memset(&its, 0, sizeof(its));
+	its.it_value.tv_sec = deadline_ns / NSEC_PER_SEC;
+	its.it_value.tv_nsec = deadline_ns % NSEC_PER_SEC;
+	ret = timerfd_settime(timer_wheel.timerfd, TFD_TIMER_ABSTIME, &its,
+			NULL);
+	if (ret) {
+		PERROR("timerfd_settime");
+	}
+	timer_wheel.armed_ns = deadline_ns;
+}
 
-	/* Ensure we don't have any signal queued for this channel. */
-	for (;;) {
-		ret = sigemptyset(&pending_set);
-		if (ret == -1) {
-			PERROR("sigemptyset");
-		}
-		ret = sigpending(&pending_set);
-		if (ret == -1) {
-			PERROR("sigpending");
-		}
-		if (!sigismember(&pending_set, signr)) {
-			break;
-		}
-		caa_cpu_relax();
+static void timer_wheel_set_slot(unsigned int slot, bool used)
+{
+	uint64_t mask = 1ULL << (slot % TIMER_WHEEL_WORD_BITS);
+
+	if (used) {
+		timer_wheel.slot_map[slot / TIMER_WHEEL_WORD_BITS] |= mask;
+	} else {
+		timer_wheel.slot_map[slot / TIMER_WHEEL_WORD_BITS] &= ~mask;
 	}
+}
 
-	/*
-	 * From this point, no new signal handler will be fired that would try to
-	 * access "chan". However, we still need to wait for any currently
-	 * executing handler to complete.
-	 */
-	cmm_smp_mb();
-	CMM_STORE_SHARED(timer_signal.qs_done, 0);
-	cmm_smp_mb();
+static bool timer_wheel_slot_used(unsigned int slot)
+{
+	return timer_wheel.slot_map[slot / TIMER_WHEEL_WORD_BITS] &
+			(1ULL << (slot % TIMER_WHEEL_WORD_BITS));
+}
 
-	/*
-	 * Kill with LTTNG_CONSUMER_SIG_TEARDOWN, so signal management thread wakes
-	 * up.
-	 */
-	kill(getpid(), LTTNG_CONSUMER_SIG_TEARDOWN);
+/*
+ * Queue a timer in the slot of its deadline rounded up to a tick, and re-arm
+ * the timerfd if it is the earliest deadline.
+ *
+ * The wheel lock MUST be acquired.
+ */
+static void timer_wheel_add(struct consumer_timer *timer)
+{
+	uint64_t tick;
+	unsigned int slot;
+
+	tick = (timer->deadline_ns + TIMER_WHEEL_TICK_NS - 1) /
+			TIMER_WHEEL_TICK_NS;
+	if (tick < timer_wheel.current_tick) {
+		/* Already expired, run it on the next wakeup. */
+		tick = timer_wheel.current_tick;
+		timer->deadline_ns = tick * TIMER_WHEEL_TICK_NS;
+	}
+
+	slot = tick % TIMER_WHEEL_SLOTS;
+	cds_list_add_tail(&timer->node, &timer_wheel.slots[slot]);
+	timer_wheel_set_slot(slot, true);
+	timer->queued = 1;
+
+	if (!timer_wheel.armed_ns || timer->deadline_ns < timer_wheel.armed_ns) {
+		timer_wheel_arm(timer->deadline_ns);
+	}
+}
+
+/*
+ * Remove a queued timer from the wheel.
+ *
+ * The wheel lock MUST be acquired.
+ */
+static void timer_wheel_del(struct consumer_timer *timer)
+{
+	unsigned int slot;
+
+	assert(timer->queued);
+
+	slot = ((timer->deadline_ns + TIMER_WHEEL_TICK_NS - 1) /
+			TIMER_WHEEL_TICK_NS) % TIMER_WHEEL_SLOTS;
+	cds_list_del(&timer->node);
+	if (cds_list_empty(&timer_wheel.slots[slot])) {
+		timer_wheel_set_slot(slot, false);
+	}
+	timer->queued = 0;
+}
 
-	while (!CMM_LOAD_SHARED(timer_signal.qs_done)) {
-		caa_cpu_relax();
+/*
+ * Dequeue an expired timer, if any. The slots are visited from the last
+ * processed tick up to the current one; a slot without expired timer is never
+ * visited again before the wheel revolves.
+ *
+ * The wheel lock MUST be acquired.
+ */
+static struct consumer_timer *timer_wheel_pop_expired(uint64_t now_ns)
+{
+	uint64_t now_tick = now_ns / TIMER_WHEEL_TICK_NS;
+
+	/* Visiting each slot once is enough after a long sleep. */
+	if (now_tick >= timer_wheel.current_tick + TIMER_WHEEL_SLOTS) {
+		timer_wheel.current_tick = now_tick - TIMER_WHEEL_SLOTS + 1;
 	}
-	cmm_smp_mb();
 
-	pthread_mutex_unlock(&timer_signal.lock);
+	for (; timer_wheel.current_tick <= now_tick;
+			timer_wheel.current_tick++) {
+		unsigned int slot = timer_wheel.current_tick % TIMER_WHEEL_SLOTS;
+		struct consumer_timer *timer;
+
+		if (!timer_wheel_slot_used(slot)) {
+			continue;
+		}
+		cds_list_for_each_entry(timer, &timer_wheel.slots[slot], node) {
+			if (timer->deadline_ns <= now_ns) {
+				timer_wheel_del(timer);
+				return timer;
+			}
+		}
+	}
+	return NULL;
 }
 
 /*
- * Start a timer channel timer which will fire at a given interval
- * (timer_interval_us)and fire a given signal (signal).
+ * Arm the timerfd for the next non-empty slot, or disarm it if the wheel is
+ * empty. The slot may only hold timers of a later revolution, in which case
+ * the wakeup simply advances the wheel.
  *
- * Returns a negative value on error, 0 if a timer was created, and
- * a positive value if no timer was created (not an error).
+ * The wheel lock MUST be acquired.
+ */
+static void timer_wheel_arm_next(void)
+{
+	unsigned int i;
+	uint64_t tick = timer_wheel.current_tick;
+
+	for (i = 0; i < TIMER_WHEEL_SLOTS; i++, tick++) {
+		unsigned int slot = tick % TIMER_WHEEL_SLOTS;
+
+		if (!(slot % TIMER_WHEEL_WORD_BITS) &&
+				!timer_wheel.slot_map[slot / TIMER_WHEEL_WORD_BITS] &&
+				i + TIMER_WHEEL_WORD_BITS <= TIMER_WHEEL_SLOTS) {
+			/* Skip a whole empty word of the slot map. */
+			i += TIMER_WHEEL_WORD_BITS - 1;
+			tick += TIMER_WHEEL_WORD_BITS - 1;
+			continue;
+		}
+		if (timer_wheel_slot_used(slot)) {
+			timer_wheel_arm(tick * TIMER_WHEEL_TICK_NS);
+			return;
+		}
+	}
+	timer_wheel_arm(0);
+}
+
+/*
+ * Start a channel timer which will fire periodically every timer_interval_us.
+ *
+ * Returns 0 if the timer was started and a positive value if no timer was
+ * started (not an error).
  */
 static
-int consumer_channel_timer_start(timer_t *timer_id,
+int consumer_channel_timer_start(struct consumer_timer *timer,
 		struct lttng_consumer_channel *channel,
-		unsigned int timer_interval_us, int signal)
+		unsigned int timer_interval_us, enum consumer_timer_type type)
 {
-	int ret = 0, delete_ret;
-	struct sigevent sev;
-	struct itimerspec its;
+	int ret = 0;
 
 	assert(channel);
 	assert(channel->key);
@@ -452,50 +848,57 @@ int consumer_channel_timer_start(timer_t *timer_id,
 		goto end;
 	}
 
-	sev.sigev_notify = SIGEV_SIGNAL;
-	sev.sigev_signo = signal;
-	sev.sigev_value.sival_ptr = channel;
-	ret = timer_create(CLOCKID, &sev, timer_id);
-	if (ret == -1) {
-		PERROR("timer_create");
-		goto end;
-	}
-
-	its.it_value.tv_sec = timer_interval_us / 1000000;
-	its.it_value.tv_nsec = (timer_interval_us % 1000000) * 1000;
-	its.it_interval.tv_sec = its.it_value.tv_sec;
-	its.it_interval.tv_nsec = its.it_value.tv_nsec;
+	timer->channel = channel;
+	timer->type = type;
+	timer->interval_ns = (uint64_t) timer_interval_us * NSEC_PER_USEC;
 
-	ret = timer_settime(*timer_id, 0, &its, NULL);
-	if (ret == -1) {
-		PERROR("timer_settime");
-		goto error_destroy_timer;
+	pthread_mutex_lock(&timer_wheel.lock);
+	assert(!timer->queued);
+	timer->enabled = 1;
+	timer->deadline_ns = lttng_monotonic_time_ns() + timer->interval_ns;
+	if (type == CONSUMER_TIMER_SWITCH &&
+			channel->type == CONSUMER_CHANNEL_TYPE_DATA) {
+		/*
+		 * Spread the switch timers of the data channels over their
+		 * period, using the channel key as a cheap and stable source of
+		 * jitter, so that the channels created together don't switch
+		 * all their streams on the same wakeup.
+		 */
+		timer->deadline_ns -= (channel->key * 0x9E3779B97F4A7C15ULL) %
+				timer->interval_ns;
+	} else if (type == CONSUMER_TIMER_LIVE) {
+		/*
+		 * Align the live timers on their period so that the timers of
+		 * the channels sharing a period expire on the same wakeup and
+		 * their beacons are batched.
+		 */
+		timer->deadline_ns -= timer->deadline_ns % timer->interval_ns;
 	}
+	timer_wheel_add(timer);
+	pthread_mutex_unlock(&timer_wheel.lock);
 end:
 	return ret;
-error_destroy_timer:
-	delete_ret = timer_delete(*timer_id);
-	if (delete_ret == -1) {
-		PERROR("timer_delete");
-	}
-	goto end;
 }
 
+/*
+ * Stop a channel timer. On return, the timer handler is not running and will
+ * not be called anymore for this timer.
+ */
 static
-int consumer_channel_timer_stop(timer_t *timer_id, int signal)
+int consumer_channel_timer_stop(struct consumer_timer *timer)
 {
-	int ret = 0;
-
-	ret = timer_delete(*timer_id);
-	if (ret == -1) {
-		PERROR("timer_delete");
-		goto end;
+	pthread_mutex_lock(&timer_wheel.lock);
+	timer->enabled = 0;
+	if (timer->queued) {
+		timer_wheel_del(timer);
 	}
-
-	consumer_timer_signal_thread_qs(signal);
-	*timer_id = 0;
-end:
-	return ret;
+	/* A handler stopping its own timer must not wait for itself. */
+	while (timer_wheel.running == timer &&
+			!pthread_equal(timer_wheel.tid, pthread_self())) {
+		pthread_cond_wait(&timer_wheel.cond, &timer_wheel.lock);
+	}
+	pthread_mutex_unlock(&timer_wheel.lock);
+	return 0;
 }
 
 /*
@@ -510,7 +913,7 @@ void consumer_timer_switch_start(struct lttng_consumer_channel *channel,
 	assert(channel->key);
 
 	ret = consumer_channel_timer_start(&channel->switch_timer, channel,
-			switch_timer_interval_us, LTTNG_CONSUMER_SIG_SWITCH);
+			switch_timer_interval_us, CONSUMER_TIMER_SWITCH);
 
 	channel->switch_timer_enabled = !!(ret == 0);
 }
@@ -524,8 +927,7 @@ void consumer_timer_switch_stop(struct lttng_consumer_channel *channel)
 
 	assert(channel);
 
-	ret = consumer_channel_timer_stop(&channel->switch_timer,
-			LTTNG_CONSUMER_SIG_SWITCH);
+	ret = consumer_channel_timer_stop(&channel->switch_timer);
 	if (ret == -1) {
 		ERR("Failed to stop switch timer");
 	}
@@ -545,7 +947,7 @@ void consumer_timer_live_start(struct lttng_consumer_channel *channel,
 	assert(channel->key);
 
 	ret = consumer_channel_timer_start(&channel->live_timer, channel,
-			live_timer_interval_us, LTTNG_CONSUMER_SIG_LIVE);
+			live_timer_interval_us, CONSUMER_TIMER_LIVE);
 
 	channel->live_timer_enabled = !!(ret == 0);
 }
@@ -559,8 +961,7 @@ void consumer_timer_live_stop(struct lttng_consumer_channel *channel)
 
 	assert(channel);
 
-	ret = consumer_channel_timer_stop(&channel->live_timer,
-			LTTNG_CONSUMER_SIG_LIVE);
+	ret = consumer_channel_timer_stop(&channel->live_timer);
 	if (ret == -1) {
 		ERR("Failed to stop live timer");
 	}
@@ -584,7 +985,7 @@ int consumer_timer_monitor_start(struct lttng_consumer_channel *channel,
 	assert(!channel->monitor_timer_enabled);
 
 	ret = consumer_channel_timer_start(&channel->monitor_timer, channel,
-			monitor_timer_interval_us, LTTNG_CONSUMER_SIG_MONITOR);
+			monitor_timer_interval_us, CONSUMER_TIMER_MONITOR);
 	channel->monitor_timer_enabled = !!(ret == 0);
 	return ret;
 }
@@ -599,8 +1000,7 @@ int consumer_timer_monitor_stop(struct lttng_consumer_channel *channel)
 	assert(channel);
 	assert(channel->monitor_timer_enabled);
 
-	ret = consumer_channel_timer_stop(&channel->monitor_timer,
-			LTTNG_CONSUMER_SIG_MONITOR);
+	ret = consumer_channel_timer_stop(&channel->monitor_timer);
 	if (ret == -1) {
 		ERR("Failed to stop live timer");
 		goto end;
@@ -612,36 +1012,52 @@ end:
 }
 
 /*
- * Block the RT signals for the entire process. It must be called from the
- * consumer main before creating the threads
+ * Initialize the timer wheel and its timerfd. It must be called from the
+ * consumer main before creating the threads.
  */
-int consumer_signal_init(void)
+int consumer_timer_init(void)
 {
-	int ret;
-	sigset_t mask;
+	int ret = 0;
+	unsigned int i;
 
-	/* Block signal for entire process, so only our thread processes it. */
-	setmask(&mask);
-	ret = pthread_sigmask(SIG_BLOCK, &mask, NULL);
-	if (ret) {
-		errno = ret;
-		PERROR("pthread_sigmask");
-		return -1;
+	for (i = 0; i < TIMER_WHEEL_SLOTS; i++) {
+		CDS_INIT_LIST_HEAD(&timer_wheel.slots[i]);
 	}
-	return 0;
+	timer_wheel.current_tick =
+			lttng_monotonic_time_ns() / TIMER_WHEEL_TICK_NS;
+
+	timer_wheel.timerfd = timerfd_create(CLOCKID, TFD_CLOEXEC);
+	if (timer_wheel.timerfd < 0) {
+		PERROR("timerfd_create");
+		ret = -1;
+	}
+	return ret;
+}
+
+/*
+ * Ask the timer thread to exit.
+ */
+void consumer_timer_thread_quit(void)
+{
+	pthread_mutex_lock(&timer_wheel.lock);
+	timer_wheel.quit = 1;
+	/* Any deadline in the past wakes the timer thread up. */
+	timer_wheel_arm(1);
+	pthread_mutex_unlock(&timer_wheel.lock);
 }
 
 static
 int sample_channel_positions(struct lttng_consumer_channel *channel,
 		uint64_t *_highest_use, uint64_t *_lowest_use,
+		uint64_t *_consumed_bytes,
 		sample_positions_cb sample, get_consumed_cb get_consumed,
 		get_produced_cb get_produced)
 {
-	int ret;
+	int ret = 0;
 	struct lttng_ht_iter iter;
 	struct lttng_consumer_stream *stream;
 	bool empty_channel = true;
-	uint64_t high = 0, low = UINT64_MAX;
+	uint64_t high = 0, low = UINT64_MAX, consumed_bytes = 0;
 	struct lttng_ht *ht = consumer_data.stream_per_chan_id_ht;
 
 	rcu_read_lock();
@@ -654,9 +1070,24 @@ int sample_channel_positions(struct lttng_consumer_channel *channel,
 
 		empty_channel = false;
 
-		pthread_mutex_lock(&stream->lock);
 		if (cds_lfht_is_node_deleted(&stream->node.node)) {
-			goto next;
+			continue;
+		}
+		/*
+		 * The positions are sampled through the stream's buffer handle,
+		 * which the data thread uses while it consumes the stream. Rather
+		 * than making the data thread wait on the timer (or the timer on
+		 * a whole sub-buffer write), a stream being consumed reports the
+		 * usage of its previous sample: it is only off by what the data
+		 * thread is consuming right now.
+		 */
+		if (pthread_mutex_trylock(&stream->lock)) {
+			usage = stream->monitor_last_usage;
+			goto account;
+		}
+		if (cds_lfht_is_node_deleted(&stream->node.node)) {
+			pthread_mutex_unlock(&stream->lock);
+			continue;
 		}
 
 		ret = sample(stream);
@@ -678,15 +1109,18 @@ int sample_channel_positions(struct lttng_consumer_channel *channel,
 			goto end;
 		}
 
+		pthread_mutex_unlock(&stream->lock);
 		usage = produced - consumed;
+		stream->monitor_last_usage = usage;
+	account:
 		high = (usage > high) ? usage : high;
 		low = (usage < low) ? usage : low;
-	next:
-		pthread_mutex_unlock(&stream->lock);
+		consumed_bytes += CMM_LOAD_SHARED(stream->output_written);
 	}
 
 	*_highest_use = high;
 	*_lowest_use = low;
+	*_consumed_bytes = consumed_bytes;
 end:
 	rcu_read_unlock();
 	if (empty_channel) {
@@ -696,7 +1130,99 @@ end:
 }
 
 /*
- * Execute action on a monitor timer.
+ * Send the pending channel monitoring samples to the session daemon in a
+ * single message.
+ *
+ * Only called by the timer thread.
+ */
+static
+void monitor_batch_flush(void)
+{
+	ssize_t ret;
+	size_t len;
+	int channel_monitor_pipe =
+			consumer_timer_thread_get_channel_monitor_pipe();
+
+	if (!monitor_batch.nb_samples) {
+		return;
+	}
+
+	/*
+	 * Writes performed here are assumed to be atomic which is only
+	 * guaranteed for sizes < than PIPE_BUF.
+	 */
+	assert(sizeof(monitor_batch) <= PIPE_BUF);
+
+	len = sizeof(monitor_batch.nb_samples) +
+			monitor_batch.nb_samples * sizeof(monitor_batch.samples[0]);
+	do {
+		ret = write(channel_monitor_pipe, &monitor_batch, len);
+	} while (ret == -1 && errno == EINTR);
+	if (ret == -1) {
+		if (errno == EAGAIN) {
+			/* Not an error, the samples are merely dropped. */
+			DBG("Channel monitor pipe is full; dropping %" PRIu32 " samples",
+					monitor_batch.nb_samples);
+		} else {
+			PERROR("write to the channel monitor pipe");
+		}
+	} else {
+		DBG("Sent %" PRIu32 " channel monitoring samples",
+				monitor_batch.nb_samples);
+	}
+	monitor_batch.nb_samples = 0;
+}
+
+/*
+ * Return true if the sample of a channel whose highest usage is "highest"
+ * must be sent to the session daemon given the monitor filter of the channel:
+ * the conditions of the triggers compare the usage to their thresholds, so a
+ * sample only matters if the usage moved from below, at or above one of them.
+ *
+ * Only called by the timer thread.
+ */
+static
+bool monitor_filter_sample(struct lttng_consumer_channel *channel,
+		uint64_t highest, uint64_t now)
+{
+	bool send = true;
+	uint32_t i, bucket = 0;
+
+	pthread_mutex_lock(&channel->monitor_filter.lock);
+	if (!channel->monitor_filter.enabled ||
+			channel->monitor_filter.forward_all) {
+		goto end;
+	}
+
+	/*
+	 * Monotonic in the usage: any threshold crossed or reached since the
+	 * last sample sent changes the bucket.
+	 */
+	for (i = 0; i < channel->monitor_filter.nr_thresholds; i++) {
+		uint64_t threshold = channel->monitor_filter.thresholds[i];
+
+		bucket += (highest >= threshold) + (highest > threshold);
+	}
+
+	if (!channel->monitor_filter.reset &&
+			bucket == channel->monitor_filter.last_bucket &&
+			now - channel->monitor_filter.last_sent_ns <
+				DEFAULT_CONSUMERD_MONITOR_HEARTBEAT_PERIOD *
+					NSEC_PER_USEC) {
+		send = false;
+		goto end;
+	}
+	channel->monitor_filter.reset = false;
+	channel->monitor_filter.last_bucket = bucket;
+	channel->monitor_filter.last_sent_ns = now;
+end:
+	pthread_mutex_unlock(&channel->monitor_filter.lock);
+	return send;
+}
+
+/*
+ * Execute action on a monitor timer: the channel sample is added to the
+ * pending batch, sent once all the timers expired on this wakeup have run.
  */
 static
 void monitor_timer(struct lttng_consumer_local_data *ctx,
@@ -705,12 +1231,11 @@ void monitor_timer(struct lttng_consumer_local_data *ctx,
 	int ret;
 	int channel_monitor_pipe =
 			consumer_timer_thread_get_channel_monitor_pipe();
-	struct lttcomm_consumer_channel_monitor_msg msg = {
-		.key = channel->key,
-	};
+	struct lttcomm_consumer_channel_monitor_msg *msg;
 	sample_positions_cb sample;
 	get_consumed_cb get_consumed;
 	get_produced_cb get_produced;
+	uint64_t lowest, highest, consumed_bytes, now;
 
 	assert(channel);
 
@@ -734,34 +1259,37 @@ void monitor_timer(struct lttng_consumer_local_data *ctx,
 		abort();
 	}
 
-	ret = sample_channel_positions(channel, &msg.highest, &msg.lowest,
-			sample, get_consumed, get_produced);
+	ret = sample_channel_positions(channel, &highest, &lowest,
+			&consumed_bytes, sample, get_consumed, get_produced);
 	if (ret) {
 		return;
 	}
 
-	/*
-	 * Writes performed here are assumed to be atomic which is only
-	 * guaranteed for sizes < than PIPE_BUF.
-	 */
-	assert(sizeof(msg) <= PIPE_BUF);
+	now = lttng_monotonic_time_ns();
+	if (!monitor_filter_sample(channel, highest, now)) {
+		DBG("Filtered channel monitoring sample for channel key %" PRIu64
+				", (highest = %" PRIu64 ")",
+				channel->key, highest);
+		return;
+	}
 
-	do {
-		ret = write(channel_monitor_pipe, &msg, sizeof(msg));
-	} while (ret == -1 && errno == EINTR);
-	if (ret == -1) {
-		if (errno == EAGAIN) {
-			/* Not an error, the sample is merely dropped. */
-			DBG("Channel monitor pipe is full; dropping sample for channel key = %"PRIu64,
-					channel->key);
-		} else {
-			PERROR("write to the channel monitor pipe");
-		}
-	} else {
-		DBG("Sent channel monitoring sample for channel key %" PRIu64
-				", (highest = %" PRIu64 ", lowest = %"PRIu64")",
-				channel->key, msg.highest, msg.lowest);
+	if (monitor_batch.nb_samples ==
+			LTTCOMM_CONSUMER_CHANNEL_MONITOR_BATCH_MAX) {
+		monitor_batch_flush();
 	}
+	msg = &monitor_batch.samples[monitor_batch.nb_samples++];
+	msg->key = channel->key;
+	msg->highest = highest;
+	msg->lowest = lowest;
+	msg->consumed_bytes = consumed_bytes;
+	/* Updated by the data threads, a torn read only skews one rate. */
+	msg->discarded_events = CMM_LOAD_SHARED(channel->discarded_events);
+	msg->lost_packets = CMM_LOAD_SHARED(channel->lost_packets);
+	msg->timestamp = now;
+	msg->priority = channel->priority;
+	DBG("Queued channel monitoring sample for channel key %" PRIu64
+			", (highest = %" PRIu64 ", lowest = %"PRIu64")",
+			channel->key, highest, lowest);
 }
 
 int consumer_timer_thread_get_channel_monitor_pipe(void)
@@ -784,20 +1312,43 @@ end:
 }
 
 /*
- * This thread is the sighandler for signals LTTNG_CONSUMER_SIG_SWITCH,
- * LTTNG_CONSUMER_SIG_TEARDOWN, LTTNG_CONSUMER_SIG_LIVE, and
- * LTTNG_CONSUMER_SIG_MONITOR, LTTNG_CONSUMER_SIG_EXIT.
+ * Run the handler of an expired timer.
+ */
+static void run_timer(struct lttng_consumer_local_data *ctx,
+		struct consumer_timer *timer)
+{
+	switch (timer->type) {
+	case CONSUMER_TIMER_SWITCH:
+		if (timer->channel->type == CONSUMER_CHANNEL_TYPE_METADATA) {
+			metadata_switch_timer(ctx, timer->channel);
+		} else {
+			data_switch_timer(ctx, timer->channel);
+		}
+		break;
+	case CONSUMER_TIMER_LIVE:
+		live_timer(ctx, timer->channel);
+		break;
+	case CONSUMER_TIMER_MONITOR:
+		monitor_timer(ctx, timer->channel);
+		break;
+	default:
+		ERR("Unexpected timer type %d", timer->type);
+		break;
+	}
+}
+
+/*
+ * This thread runs the switch, live and monitor timers of the channels. It
+ * sleeps on the timerfd armed for the next deadline of the timer wheel.
  */
 void *consumer_timer_thread(void *data)
 {
-	int signr;
-	sigset_t mask;
-	siginfo_t info;
 	struct lttng_consumer_local_data *ctx = data;
 
 	rcu_register_thread();
 
 	health_register(health_consumerd, HEALTH_CONSUMERD_TYPE_METADATA_TIMER);
+	consumer_sched_apply(HEALTH_CONSUMERD_TYPE_METADATA_TIMER);
 
 	if (testpoint(consumerd_thread_metadata_timer)) {
 		goto error_testpoint;
@@ -805,48 +1356,65 @@ void *consumer_timer_thread(void *data)
 
 	health_code_update();
 
-	/* Only self thread will receive signal mask. */
-	setmask(&mask);
-	CMM_STORE_SHARED(timer_signal.tid, pthread_self());
+	pthread_mutex_lock(&timer_wheel.lock);
+	timer_wheel.tid = pthread_self();
+	while (!timer_wheel.quit) {
+		ssize_t len;
+		uint64_t expirations, now_ns;
+		struct consumer_timer *timer;
 
-	while (1) {
 		health_code_update();
 
-		health_poll_entry();
-		signr = sigwaitinfo(&mask, &info);
-		health_poll_exit();
-
-		/*
-		 * NOTE: cascading conditions are used instead of a switch case
-		 * since the use of SIGRTMIN in the definition of the signals'
-		 * values prevents the reduction to an integer constant.
-		 */
-		if (signr == -1) {
-			if (errno != EINTR) {
-				PERROR("sigwaitinfo");
+		now_ns = lttng_monotonic_time_ns();
+		timer = timer_wheel_pop_expired(now_ns);
+		if (timer) {
+			timer_wheel.running = timer;
+			pthread_mutex_unlock(&timer_wheel.lock);
+
+			run_timer(ctx, timer);
+
+			pthread_mutex_lock(&timer_wheel.lock);
+			timer_wheel.running = NULL;
+			if (timer->enabled) {
+				/*
+				 * Skip the periods missed by a late wakeup,
+				 * keeping the timer phase.
+				 */
+				timer->deadline_ns += timer->interval_ns;
+				if (timer->deadline_ns <= now_ns) {
+					timer->deadline_ns += ((now_ns -
+							timer->deadline_ns) /
+							timer->interval_ns + 1) *
+							timer->interval_ns;
+				}
+				timer_wheel_add(timer);
 			}
+			pthread_cond_broadcast(&timer_wheel.cond);
 			continue;
-		} else if (signr == LTTNG_CONSUMER_SIG_SWITCH) {
-			metadata_switch_timer(ctx, info.si_signo, &info);
-		} else if (signr == LTTNG_CONSUMER_SIG_TEARDOWN) {
-			cmm_smp_mb();
-			CMM_STORE_SHARED(timer_signal.qs_done, 1);
-			cmm_smp_mb();
-			DBG("Signal timer metadata thread teardown");
-		} else if (signr == LTTNG_CONSUMER_SIG_LIVE) {
-			live_timer(ctx, info.si_signo, &info);
-		} else if (signr == LTTNG_CONSUMER_SIG_MONITOR) {
-			struct lttng_consumer_channel *channel;
-
-			channel = info.si_value.sival_ptr;
-			monitor_timer(ctx, channel);
-		} else if (signr == LTTNG_CONSUMER_SIG_EXIT) {
-			assert(CMM_LOAD_SHARED(consumer_quit));
-			goto end;
-		} else {
-			ERR("Unexpected signal %d\n", info.si_signo);
 		}
+
+		/* Every timer due on this wakeup has run. */
+		pthread_mutex_unlock(&timer_wheel.lock);
+		monitor_batch_flush();
+		beacon_batches_flush();
+		pthread_mutex_lock(&timer_wheel.lock);
+
+		timer_wheel_arm_next();
+		pthread_mutex_unlock(&timer_wheel.lock);
+
+		health_poll_entry();
+		len = read(timer_wheel.timerfd, &expirations,
+				sizeof(expirations));
+		health_poll_exit();
+		if (len < 0 && errno != EINTR && errno != EAGAIN) {
+			PERROR("read timerfd");
+		}
+
+		pthread_mutex_lock(&timer_wheel.lock);
 	}
+	pthread_mutex_unlock(&timer_wheel.lock);
+	assert(CMM_LOAD_SHARED(consumer_quit));
+	goto end;
 
 error_testpoint:
 	/* Only reached in testpoint error */
@@ -0,0 +1,315 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include <assert.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <urcu.h>
+#include <urcu/wfcqueue.h>
+
+#include <bin/lttng-consumerd/health-consumerd.h>
+#include <common/common.h>
+#include <common/futex.h>
+#include <common/compat/fcntl.h>
+
+#include "consumer-writeback.h"
+#include "consumer-sched.h"
+
+/* Written range of the output file of a stream. */
+struct writeback_range {
+	struct lttng_consumer_stream *stream;
+	int fd;
+	/* Generation of the stream output file at the time of the write. */
+	unsigned int generation;
+	off_t offset;
+	size_t len;
+	struct cds_wfcq_node node;
+};
+
+/*
+ * Queue of written ranges. Protected by a futex with a scheme N wakers / 1
+ * waiter. See futex.c/.h
+ */
+static struct writeback_queue {
+	int32_t futex;
+	struct cds_wfcq_head head;
+	struct cds_wfcq_tail tail;
+} writeback_queue;
+
+static int writeback_enabled;
+static int writeback_quit;
+static unsigned long writeback_coalesce_bytes;
+static unsigned int writeback_evict_lag;
+
+/* Used to wait for the pending ranges of a stream to be processed. */
+static pthread_mutex_t writeback_wait_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t writeback_wait_cond = PTHREAD_COND_INITIALIZER;
+
+void consumer_writeback_enable(unsigned long coalesce_bytes,
+		unsigned int evict_lag)
+{
+	cds_wfcq_init(&writeback_queue.head, &writeback_queue.tail);
+	writeback_coalesce_bytes = coalesce_bytes;
+	writeback_evict_lag = evict_lag;
+	writeback_enabled = 1;
+}
+
+int consumer_writeback_queue(struct lttng_consumer_stream *stream,
+		off_t offset, size_t len)
+{
+	int ret = 0;
+	struct writeback_range *range;
+
+	if (!writeback_enabled) {
+		ret = -1;
+		goto end;
+	}
+
+	range = zmalloc(sizeof(*range));
+	if (!range) {
+		PERROR("zmalloc writeback range");
+		ret = -1;
+		goto end;
+	}
+	range->stream = stream;
+	range->fd = stream->out_fd;
+	range->generation = stream->writeback.generation;
+	range->offset = offset;
+	range->len = len;
+	cds_wfcq_node_init(&range->node);
+
+	uatomic_inc(&stream->writeback.pending);
+	cds_wfcq_enqueue(&writeback_queue.head, &writeback_queue.tail,
+			&range->node);
+	/*
+	 * Wake the writeback thread. The enqueue provides the memory barrier
+	 * with the futex update.
+	 */
+	futex_nto1_wake(&writeback_queue.futex);
+
+end:
+	return ret;
+}
+
+void consumer_writeback_wait(struct lttng_consumer_stream *stream)
+{
+	if (!writeback_enabled) {
+		goto end;
+	}
+
+	pthread_mutex_lock(&writeback_wait_lock);
+	while (uatomic_read(&stream->writeback.pending)) {
+		pthread_cond_wait(&writeback_wait_cond, &writeback_wait_lock);
+	}
+	pthread_mutex_unlock(&writeback_wait_lock);
+
+	/* The output file is about to change. */
+	stream->writeback.generation++;
+end:
+	return;
+}
+
+void consumer_writeback_stop(void)
+{
+	CMM_STORE_SHARED(writeback_quit, 1);
+	futex_nto1_prepare(&writeback_queue.futex);
+	futex_nto1_wake(&writeback_queue.futex);
+}
+
+/*
+ * Order the ranges by stream, file generation and offset so that the
+ * contiguous ranges of a stream are adjacent.
+ */
+static int compare_range(const void *a, const void *b)
+{
+	const struct writeback_range *ra = *(const struct writeback_range **) a;
+	const struct writeback_range *rb = *(const struct writeback_range **) b;
+
+	if (ra->stream != rb->stream) {
+		return ra->stream < rb->stream ? -1 : 1;
+	}
+	if (ra->generation != rb->generation) {
+		return ra->generation < rb->generation ? -1 : 1;
+	}
+	if (ra->offset != rb->offset) {
+		return ra->offset < rb->offset ? -1 : 1;
+	}
+	return 0;
+}
+
+/*
+ * Start the writeback of the range [start, end) of the output file of a
+ * stream and evict the data lagging the write position by more than the
+ * eviction lag from the page cache.
+ *
+ * Don't care about error values, as these are just hints and ways to limit
+ * the amount of page cache used.
+ */
+static void process_range(struct lttng_consumer_stream *stream, int fd,
+		unsigned int generation, off_t start, off_t end)
+{
+	int ret;
+	off_t lag, evict_end;
+	struct consumer_stream_writeback *wb = &stream->writeback;
+
+	/* This won't block, but will start writeout asynchronously */
+	lttng_sync_file_range(fd, start, end - start, SYNC_FILE_RANGE_WRITE);
+
+	if (wb->evict_generation != generation) {
+		wb->evict_generation = generation;
+		wb->evict_offset = 0;
+	}
+
+	lag = (off_t) writeback_evict_lag * stream->max_sb_size;
+	if (end <= lag) {
+		return;
+	}
+	evict_end = end - lag;
+	if (evict_end <= wb->evict_offset) {
+		return;
+	}
+
+	lttng_sync_file_range(fd, wb->evict_offset,
+			evict_end - wb->evict_offset,
+			SYNC_FILE_RANGE_WAIT_BEFORE
+			| SYNC_FILE_RANGE_WRITE
+			| SYNC_FILE_RANGE_WAIT_AFTER);
+	/* See lttng_consumer_sync_trace_file_range(). */
+	ret = posix_fadvise(fd, wb->evict_offset, evict_end - wb->evict_offset,
+			POSIX_FADV_DONTNEED);
+	if (ret && ret != -ENOSYS) {
+		errno = ret;
+		PERROR("posix_fadvise on fd %i", fd);
+	}
+	wb->evict_offset = evict_end;
+}
+
+/*
+ * Process a batch of dequeued ranges, merging the contiguous ranges of each
+ * stream, and release them.
+ */
+static void process_ranges(struct writeback_range **ranges,
+		unsigned int nr_ranges)
+{
+	unsigned int i, first;
+
+	qsort(ranges, nr_ranges, sizeof(*ranges), compare_range);
+
+	for (first = 0; first < nr_ranges; first = i) {
+		struct writeback_range *cur = ranges[first];
+		off_t start = cur->offset, end = cur->offset + cur->len;
+
+		for (i = first + 1; i < nr_ranges; i++) {
+			struct writeback_range *next = ranges[i];
+
+			if (next->stream != cur->stream ||
+					next->generation != cur->generation ||
+					next->offset != end ||
+					(unsigned long) (end + next->len - start) >
+						writeback_coalesce_bytes) {
+				break;
+			}
+			end += next->len;
+		}
+
+		process_range(cur->stream, cur->fd, cur->generation, start, end);
+	}
+
+	for (i = 0; i < nr_ranges; i++) {
+		struct lttng_consumer_stream *stream = ranges[i]->stream;
+
+		free(ranges[i]);
+		if (!uatomic_sub_return(&stream->writeback.pending, 1)) {
+			pthread_mutex_lock(&writeback_wait_lock);
+			pthread_cond_broadcast(&writeback_wait_cond);
+			pthread_mutex_unlock(&writeback_wait_lock);
+		}
+	}
+}
+
+void *consumer_thread_writeback(void *data)
+{
+	unsigned int nr_ranges, alloc_ranges = 0;
+	struct writeback_range **ranges = NULL;
+
+	rcu_register_thread();
+
+	health_register(health_consumerd, HEALTH_CONSUMERD_TYPE_WRITEBACK);
+	consumer_sched_apply(HEALTH_CONSUMERD_TYPE_WRITEBACK);
+
+	health_code_update();
+
+	DBG("[thread] Writeback thread started");
+
+	for (;;) {
+		int quit;
+		struct cds_wfcq_node *node;
+
+		health_code_update();
+
+		futex_nto1_prepare(&writeback_queue.futex);
+		quit = CMM_LOAD_SHARED(writeback_quit);
+
+		nr_ranges = 0;
+		while ((node = cds_wfcq_dequeue_blocking(&writeback_queue.head,
+				&writeback_queue.tail))) {
+			if (nr_ranges == alloc_ranges) {
+				struct writeback_range **new_ranges;
+				unsigned int new_alloc = max_t(unsigned int,
+						alloc_ranges << 1, 64);
+
+				new_ranges = realloc(ranges,
+						new_alloc * sizeof(*ranges));
+				if (!new_ranges) {
+					PERROR("realloc writeback ranges");
+					/* Process what we have, the rest is still queued. */
+					cds_wfcq_enqueue(&writeback_queue.head,
+							&writeback_queue.tail, node);
+					break;
+				}
+				ranges = new_ranges;
+				alloc_ranges = new_alloc;
+			}
+			ranges[nr_ranges++] = caa_container_of(node,
+					struct writeback_range, node);
+		}
+
+		if (nr_ranges) {
+			process_ranges(ranges, nr_ranges);
+			/* More ranges may have been queued meanwhile. */
+			continue;
+		}
+
+		if (quit) {
+			break;
+		}
+
+		health_poll_entry();
+		futex_nto1_wait(&writeback_queue.futex);
+		health_poll_exit();
+	}
+
+	free(ranges);
+
+	health_unregister(health_consumerd);
+	DBG("Writeback thread exiting");
+	rcu_unregister_thread();
+	return NULL;
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef LTTNG_CONSUMER_WRITEBACK_H
+#define LTTNG_CONSUMER_WRITEBACK_H
+
+#include <sys/types.h>
+
+#include "consumer.h"
+
+/*
+ * Asynchronous writeback of the trace output files.
+ *
+ * Instead of starting the writeback of the data it just wrote and waiting for
+ * the writeback of the previous sub-buffer before evicting it from the page
+ * cache, a consuming thread queues the written range on a wait-free queue.
+ * The writeback thread coalesces the contiguous ranges of a stream, starts
+ * their writeback and evicts the data that lags the write position by more
+ * than the eviction lag.
+ */
+
+/*
+ * Enable the asynchronous writeback. Contiguous ranges of a stream are merged
+ * up to "coalesce_bytes" (0 disables merging) and "evict_lag" sub-buffers are
+ * kept in the page cache behind the write position of each stream.
+ *
+ * MUST be called before any consumer thread is launched.
+ */
+void consumer_writeback_enable(unsigned long coalesce_bytes,
+		unsigned int evict_lag);
+
+/*
+ * Queue for writeback the "len" bytes written at "offset" in the output file
+ * of a stream.
+ *
+ * The stream lock MUST be acquired.
+ *
+ * Return 0 if the range is queued or else a negative value, in which case the
+ * caller handles the writeback of the range.
+ */
+int consumer_writeback_queue(struct lttng_consumer_stream *stream,
+		off_t offset, size_t len);
+
+/*
+ * Wait for the queued ranges of a stream to be processed. This MUST be called
+ * before the output file of the stream is closed, replaced or truncated.
+ *
+ * The stream lock MUST be acquired.
+ */
+void consumer_writeback_wait(struct lttng_consumer_stream *stream);
+
+/*
+ * Writeback thread. It exits once consumer_writeback_stop() is called and
+ * every queued range is processed.
+ */
+void *consumer_thread_writeback(void *data);
+
+/*
+ * Ask the writeback thread to exit. MUST be called once no other consumer
+ * thread can queue ranges.
+ */
+void consumer_writeback_stop(void);
+
+#endif /* LTTNG_CONSUMER_WRITEBACK_H */
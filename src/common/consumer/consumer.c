@@ -25,6 +25,7 @@
 #include <string.h>
 #include <sys/mman.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <inttypes.h>
@@ -35,6 +36,8 @@
 #include <common/utils.h>
 #include <common/compat/poll.h>
 #include <common/compat/endian.h>
+#include <common/compat/time.h>
+#include <common/time.h>
 #include <common/index/index.h>
 #include <common/kernel-ctl/kernel-ctl.h>
 #include <common/sessiond-comm/relayd.h>
@@ -46,12 +49,19 @@
 #include <common/consumer/consumer.h>
 #include <common/consumer/consumer-stream.h>
 #include <common/consumer/consumer-testpoint.h>
+#include <common/compat/io-uring.h>
+#include <common/consumer/consumer-compress.h>
+#include <common/consumer/consumer-writeback.h>
+#include <common/consumer/consumer-spool.h>
+#include <common/consumer/consumer-numa.h>
+#include <common/consumer/consumer-sched.h>
+#include <common/consumer/consumer-priority.h>
 #include <common/align.h>
 #include <common/consumer/consumer-metadata-cache.h>
+#include <common/self-tracing/self-tracing.h>
 
 struct lttng_consumer_global_data consumer_data = {
 	.stream_count = 0,
-	.need_update = 1,
 	.type = LTTNG_CONSUMER_UNKNOWN,
 };
 
@@ -86,6 +96,12 @@ int consumer_quit;
 static struct lttng_ht *metadata_ht;
 static struct lttng_ht *data_ht;
 
+/*
+ * Set on the data threads, whose relayd indexes are queued and sent in bulk,
+ * see consumer_relayd_send_index().
+ */
+static DEFINE_URCU_TLS(int, relayd_index_batching);
+
 /*
  * Notify a thread lttng pipe to poll back again. This usually means that some
  * global state has changed so we just send back the thread in a poll wait
@@ -100,6 +116,34 @@ static void notify_thread_lttng_pipe(struct lttng_pipe *pipe)
 	(void) lttng_pipe_write(pipe, &null_stream, sizeof(null_stream));
 }
 
+/*
+ * Notify the data thread of every data shard to poll back again.
+ */
+static void notify_data_shards(struct lttng_consumer_local_data *ctx)
+{
+	unsigned int i;
+
+	assert(ctx);
+
+	for (i = 0; i < ctx->nr_data_shards; i++) {
+		notify_thread_lttng_pipe(ctx->data_shards[i].data_pipe);
+	}
+}
+
+/*
+ * Notify the metadata thread of every metadata shard to poll back again.
+ */
+static void notify_metadata_shards(struct lttng_consumer_local_data *ctx)
+{
+	unsigned int i;
+
+	assert(ctx);
+
+	for (i = 0; i < ctx->nr_metadata_shards; i++) {
+		notify_thread_lttng_pipe(ctx->metadata_shards[i].metadata_pipe);
+	}
+}
+
 static void notify_health_quit_pipe(int *pipe)
 {
 	ssize_t ret;
@@ -181,8 +225,7 @@ static void clean_channel_stream_list(struct lttng_consumer_channel *channel)
 }
 
 /*
- * Find a stream. The consumer_data.lock must be locked during this
- * call.
+ * Find a stream.
  */
 static struct lttng_consumer_stream *find_stream(uint64_t key,
 		struct lttng_ht *ht)
@@ -229,6 +272,32 @@ static void steal_stream_key(uint64_t key, struct lttng_ht *ht)
 	rcu_read_unlock();
 }
 
+/*
+ * Add a stream to a hash table indexed by stream key, stealing the key of any
+ * stream already indexed with the same key so that only the new one matches
+ * the lookups.
+ *
+ * This needs no lock: concurrent additions of the same key are serialized by
+ * the unique add of the hash table and the last one added wins.
+ */
+static void add_stream_steal_key(struct lttng_consumer_stream *stream,
+		struct lttng_ht *ht)
+{
+	struct cds_lfht_node *node;
+
+	rcu_read_lock();
+	for (;;) {
+		node = cds_lfht_add_unique(ht->ht,
+				ht->hash_fct(&stream->node.key, lttng_ht_seed),
+				ht->match_fct, &stream->node.key, &stream->node.node);
+		if (node == &stream->node.node) {
+			break;
+		}
+		steal_stream_key(stream->node.key, ht);
+	}
+	rcu_read_unlock();
+}
+
 /*
  * Return a channel object for the given key.
  *
@@ -246,7 +315,7 @@ struct lttng_consumer_channel *consumer_find_channel(uint64_t key)
 		return NULL;
 	}
 
-	lttng_ht_lookup(consumer_data.channel_ht, &key, &iter);
+	lttng_ht_lookup_fast_u64(consumer_data.channel_ht, key, &iter);
 	node = lttng_ht_iter_get_node_u64(&iter);
 	if (node != NULL) {
 		channel = caa_container_of(node, struct lttng_consumer_channel, node);
@@ -307,6 +376,7 @@ static void free_channel_rcu(struct rcu_head *head)
  */
 static void free_relayd_rcu(struct rcu_head *head)
 {
+	unsigned int i;
 	struct lttng_ht_node_u64 *node =
 		caa_container_of(head, struct lttng_ht_node_u64, head);
 	struct consumer_relayd_sock_pair *relayd =
@@ -321,7 +391,14 @@ static void free_relayd_rcu(struct rcu_head *head)
 	 * there is no one referencing to this relayd object.
 	 */
 	(void) relayd_close(&relayd->control_sock);
-	(void) relayd_close(&relayd->data_sock);
+	free(relayd->pending_indexes);
+	for (i = 0; i < relayd->nr_data_socks; i++) {
+		(void) relayd_close(&relayd->data_socks[i].sock);
+		if (relayd->data_socks[i].spool.fd >= 0 &&
+				close(relayd->data_socks[i].spool.fd)) {
+			PERROR("close spool");
+		}
+	}
 
 	free(relayd);
 }
@@ -332,6 +409,7 @@ static void free_relayd_rcu(struct rcu_head *head)
 void consumer_destroy_relayd(struct consumer_relayd_sock_pair *relayd)
 {
 	int ret;
+	unsigned int i;
 	struct lttng_ht_iter iter;
 
 	if (relayd == NULL) {
@@ -347,6 +425,22 @@ void consumer_destroy_relayd(struct consumer_relayd_sock_pair *relayd)
 		return;
 	}
 
+	/*
+	 * Send the spooled packets before the sockets are closed. A relayd
+	 * hangs up with the lock of a data socket held.
+	 */
+	for (i = 0; !relayd->hung_up && i < relayd->nr_data_socks; i++) {
+		struct consumer_relayd_data_sock *data_sock = &relayd->data_socks[i];
+
+		pthread_mutex_lock(&data_sock->lock);
+		(void) consumer_spool_drain(relayd, data_sock);
+		pthread_mutex_unlock(&data_sock->lock);
+	}
+	if (!relayd->hung_up) {
+		consumer_relayd_lock_control(relayd);
+		pthread_mutex_unlock(&relayd->ctrl_sock_mutex);
+	}
+
 	/* RCU free() call */
 	call_rcu(&relayd->node.head, free_relayd_rcu);
 }
@@ -394,7 +488,7 @@ void consumer_del_channel(struct lttng_consumer_channel *channel)
 	assert(!ret);
 	rcu_read_unlock();
 
-	call_rcu(&channel->node.head, free_channel_rcu);
+	lttng_ht_defer_free(&channel->node.head, free_channel_rcu);
 end:
 	pthread_mutex_unlock(&channel->lock);
 	pthread_mutex_unlock(&consumer_data.lock);
@@ -475,6 +569,7 @@ static void cleanup_relayd(struct consumer_relayd_sock_pair *relayd,
 
 	/* Save the net sequence index before destroying the object */
 	netidx = relayd->net_seq_idx;
+	relayd->hung_up = 1;
 
 	/*
 	 * Delete the relayd from the relayd hash table, close the sockets and free
@@ -492,8 +587,8 @@ static void cleanup_relayd(struct consumer_relayd_sock_pair *relayd,
 	 * read of this status which happens AFTER receiving this notify.
 	 */
 	if (ctx) {
-		notify_thread_lttng_pipe(ctx->consumer_data_pipe);
-		notify_thread_lttng_pipe(ctx->consumer_metadata_pipe);
+		notify_data_shards(ctx);
+		notify_metadata_shards(ctx);
 	}
 }
 
@@ -516,6 +611,204 @@ void consumer_flag_relayd_for_destroy(struct consumer_relayd_sock_pair *relayd)
 	}
 }
 
+/*
+ * Record the backpressure advertised by a relayd in an index reply.
+ *
+ * The control socket mutex of the relayd MUST be acquired.
+ */
+void consumer_relayd_set_backpressure(struct consumer_relayd_sock_pair *relayd,
+		uint32_t backpressure, uint64_t write_lag_ns)
+{
+	if (backpressure != CMM_LOAD_SHARED(relayd->backpressure)) {
+		DBG("Relayd %" PRIu64 " backpressure level %u, write lag %" PRIu64 " ns",
+				relayd->net_seq_idx, backpressure, write_lag_ns);
+	}
+	CMM_STORE_SHARED(relayd->backpressure_lag_ns, write_lag_ns);
+	CMM_STORE_SHARED(relayd->backpressure_ts, lttng_monotonic_time_ns());
+	CMM_STORE_SHARED(relayd->backpressure, backpressure);
+}
+
+/*
+ * Send the indexes queued on a relayd in a single RELAYD_SEND_INDEXES
+ * message. The queued indexes are dropped on error.
+ *
+ * The control socket mutex of the relayd MUST be acquired.
+ * Return 0 on success or else a negative value.
+ */
+static int relayd_flush_indexes(struct consumer_relayd_sock_pair *relayd)
+{
+	int ret;
+	uint32_t backpressure;
+	uint64_t write_lag_ns;
+
+	if (!relayd->nr_pending_indexes) {
+		return 0;
+	}
+	ret = relayd_send_indexes(&relayd->control_sock,
+			relayd->pending_indexes, relayd->nr_pending_indexes,
+			&backpressure, &write_lag_ns);
+	if (ret < 0) {
+		ERR("Failed to send %u indexes to relayd %" PRIu64,
+				relayd->nr_pending_indexes, relayd->net_seq_idx);
+	} else {
+		consumer_relayd_set_backpressure(relayd, backpressure,
+				write_lag_ns);
+	}
+	uatomic_set(&relayd->nr_pending_indexes, 0);
+	return ret;
+}
+
+/*
+ * Acquire the control socket mutex of a relayd and send its queued indexes
+ * first, so that the next command is handled with every index received, like
+ * the data pending and close commands expect.
+ */
+void consumer_relayd_lock_control(struct consumer_relayd_sock_pair *relayd)
+{
+	pthread_mutex_lock(&relayd->ctrl_sock_mutex);
+	(void) relayd_flush_indexes(relayd);
+}
+
+/*
+ * Send the index of the last packet of a stream to its relayd. On a data
+ * thread, with a relayd accepting RELAYD_SEND_INDEXES, the index is queued
+ * and sent with the others once DEFAULT_CONSUMERD_RELAYD_INDEX_BATCH are
+ * queued, the oldest was queued DEFAULT_CONSUMERD_RELAYD_INDEX_BATCH_DELAY
+ * usec ago, or before the thread waits for more data.
+ *
+ * A failed send of queued indexes is only reported by the flush.
+ *
+ * RCU read side lock MUST be acquired.
+ * Return 0 on success or else a negative value.
+ */
+int consumer_relayd_send_index(struct consumer_relayd_sock_pair *relayd,
+		struct lttng_consumer_stream *stream,
+		struct ctf_packet_index *element)
+{
+	int ret = 0;
+	uint64_t now;
+
+	pthread_mutex_lock(&relayd->ctrl_sock_mutex);
+	if (!URCU_TLS(relayd_index_batching) ||
+			!relayd_supports_bulk_indexes(&relayd->control_sock)) {
+		uint32_t backpressure;
+		uint64_t write_lag_ns;
+
+		ret = relayd_flush_indexes(relayd);
+		if (ret < 0) {
+			goto end;
+		}
+		ret = relayd_send_index(&relayd->control_sock, element,
+				stream->relayd_stream_id,
+				stream->next_net_seq_num - 1,
+				&backpressure, &write_lag_ns);
+		if (!ret) {
+			consumer_relayd_set_backpressure(relayd,
+					backpressure, write_lag_ns);
+		}
+		goto end;
+	}
+
+	if (!relayd->pending_indexes) {
+		relayd->pending_indexes = zmalloc(
+				DEFAULT_CONSUMERD_RELAYD_INDEX_BATCH *
+				sizeof(*relayd->pending_indexes));
+		if (!relayd->pending_indexes) {
+			PERROR("zmalloc relayd pending indexes");
+			ret = -1;
+			goto end;
+		}
+	}
+	now = lttng_monotonic_time_ns();
+	if (!relayd->nr_pending_indexes) {
+		relayd->pending_indexes_ts = now;
+	}
+	relayd_fill_bulk_index(&relayd->control_sock,
+			&relayd->pending_indexes[relayd->nr_pending_indexes],
+			element, stream->relayd_stream_id,
+			stream->next_net_seq_num - 1);
+	uatomic_set(&relayd->nr_pending_indexes,
+			relayd->nr_pending_indexes + 1);
+
+	if (relayd->nr_pending_indexes >= DEFAULT_CONSUMERD_RELAYD_INDEX_BATCH ||
+			now - relayd->pending_indexes_ts >=
+				DEFAULT_CONSUMERD_RELAYD_INDEX_BATCH_DELAY *
+				NSEC_PER_USEC) {
+		ret = relayd_flush_indexes(relayd);
+	}
+end:
+	pthread_mutex_unlock(&relayd->ctrl_sock_mutex);
+	return ret;
+}
+
+/*
+ * Send the queued indexes of every relayd. Called by the data threads
+ * before they wait for more data.
+ */
+static void relayd_flush_all_indexes(void)
+{
+	struct lttng_ht_iter iter;
+	struct consumer_relayd_sock_pair *relayd;
+
+	rcu_read_lock();
+	cds_lfht_for_each_entry(consumer_data.relayd_ht->ht, &iter.iter,
+			relayd, node.node) {
+		if (!uatomic_read(&relayd->nr_pending_indexes)) {
+			continue;
+		}
+		consumer_relayd_lock_control(relayd);
+		pthread_mutex_unlock(&relayd->ctrl_sock_mutex);
+	}
+	rcu_read_unlock();
+}
+
+/*
+ * Apply the backpressure policy to a packet of a data stream sent to a relayd
+ * by delaying it by the write lag of the relayd, up to
+ * DEFAULT_CONSUMERD_BACKPRESSURE_MAX_DELAY. The metadata streams are never
+ * delayed nor discarded.
+ *
+ * Return 1 if the packet must be discarded or else 0.
+ */
+static int relayd_apply_backpressure(struct consumer_relayd_sock_pair *relayd,
+		struct lttng_consumer_stream *stream, int can_discard)
+{
+	uint32_t level;
+	uint64_t delay_us;
+
+	if (consumer_data.backpressure_policy == CONSUMER_BACKPRESSURE_NONE) {
+		return 0;
+	}
+	level = CMM_LOAD_SHARED(relayd->backpressure);
+	if (level == RELAYD_BACKPRESSURE_NONE) {
+		return 0;
+	}
+	if (lttng_monotonic_time_ns() -
+			CMM_LOAD_SHARED(relayd->backpressure_ts) >
+			DEFAULT_CONSUMERD_BACKPRESSURE_TTL * NSEC_PER_USEC) {
+		/* Send the packet to get a fresh advertisement. */
+		return 0;
+	}
+
+	if (level == RELAYD_BACKPRESSURE_SATURATED && can_discard &&
+			consumer_data.backpressure_policy ==
+				CONSUMER_BACKPRESSURE_DISCARD) {
+		DBG3("Discarding packet of stream %" PRIu64 ", relayd saturated",
+				stream->key);
+		return 1;
+	}
+
+	delay_us = min_t(uint64_t,
+			CMM_LOAD_SHARED(relayd->backpressure_lag_ns) / NSEC_PER_USEC,
+			DEFAULT_CONSUMERD_BACKPRESSURE_MAX_DELAY);
+	if (delay_us) {
+		DBG3("Delaying packet of stream %" PRIu64 " by %" PRIu64 " usec",
+				stream->key, delay_us);
+		(void) usleep(delay_us);
+	}
+	return 0;
+}
+
 /*
  * Completly destroy stream from every visiable data structure and the given
  * hash table if one.
@@ -568,6 +861,8 @@ struct lttng_consumer_stream *consumer_allocate_stream(uint64_t channel_key,
 
 	stream->key = stream_key;
 	stream->out_fd = -1;
+	stream->out_dir_fd = -1;
+	stream->snapshot_pipe[0] = stream->snapshot_pipe[1] = -1;
 	stream->out_fd_offset = 0;
 	stream->output_written = 0;
 	stream->state = state;
@@ -579,8 +874,10 @@ struct lttng_consumer_stream *consumer_allocate_stream(uint64_t channel_key,
 	stream->endpoint_status = CONSUMER_ENDPOINT_ACTIVE;
 	stream->index_file = NULL;
 	stream->last_sequence_number = -1ULL;
+	stream->cpu = type == CONSUMER_CHANNEL_TYPE_METADATA ? -1 : cpu;
 	pthread_mutex_init(&stream->lock, NULL);
 	pthread_mutex_init(&stream->metadata_timer_lock, NULL);
+	CDS_INIT_LIST_HEAD(&stream->has_data_node);
 
 	/* If channel is the metadata, flag this stream as metadata. */
 	if (type == CONSUMER_CHANNEL_TYPE_METADATA) {
@@ -627,29 +924,60 @@ end:
 	return NULL;
 }
 
+/*
+ * Select the data shard of a stream. With NUMA affinity, the streams of the
+ * CPUs of a node are spread by key among the shards bound to that node, which
+ * are the shards node, node + nr_nodes, node + 2 * nr_nodes and so on.
+ * Otherwise, or if the node of the stream's CPU is unknown, the streams are
+ * spread by key among all the shards.
+ */
+static struct lttng_consumer_data_shard *select_data_shard(
+		struct lttng_consumer_local_data *ctx,
+		struct lttng_consumer_stream *stream)
+{
+	int node;
+	unsigned int nr_nodes, nr_node_shards;
+
+	if (!consumer_data.numa_affine) {
+		goto any;
+	}
+	node = consumer_numa_cpu_to_node(stream->cpu);
+	nr_nodes = consumer_numa_nr_nodes();
+	if (node < 0 || (unsigned int) node >= ctx->nr_data_shards) {
+		goto any;
+	}
+	nr_node_shards = (ctx->nr_data_shards - node + nr_nodes - 1) / nr_nodes;
+	return &ctx->data_shards[node +
+			(stream->key % nr_node_shards) * nr_nodes];
+any:
+	return &ctx->data_shards[stream->key % ctx->nr_data_shards];
+}
+
 /*
  * Add a stream to the global list protected by a mutex.
+ *
+ * The stream is assigned to a data shard according to its key and, with NUMA
+ * affinity, its CPU. Once this returns, the stream must be handed over to the
+ * thread of that shard with consumer_handover_data_stream().
  */
-int consumer_add_data_stream(struct lttng_consumer_stream *stream)
+int consumer_add_data_stream(struct lttng_consumer_stream *stream,
+		struct lttng_consumer_local_data *ctx)
 {
 	struct lttng_ht *ht = data_ht;
 	int ret = 0;
 
 	assert(stream);
+	assert(ctx);
+	assert(ctx->nr_data_shards > 0);
 	assert(ht);
 
-	DBG3("Adding consumer stream %" PRIu64, stream->key);
-
-	pthread_mutex_lock(&consumer_data.lock);
 	pthread_mutex_lock(&stream->chan->lock);
 	pthread_mutex_lock(&stream->chan->timer_lock);
 	pthread_mutex_lock(&stream->lock);
 	rcu_read_lock();
 
 	/* Steal stream identifier to avoid having streams with the same key */
-	steal_stream_key(stream->key, ht);
-
-	lttng_ht_add_unique_u64(ht, &stream->node);
+	add_stream_steal_key(stream, ht);
 
 	lttng_ht_add_u64(consumer_data.stream_per_chan_id_ht,
 			&stream->node_channel_id);
@@ -675,14 +1003,15 @@ int consumer_add_data_stream(struct lttng_consumer_stream *stream)
 	}
 
 	/* Update consumer data once the node is inserted. */
-	consumer_data.stream_count++;
-	consumer_data.need_update = 1;
+	stream->data_shard = select_data_shard(ctx, stream);
+	uatomic_inc(&consumer_data.stream_count);
+	DBG3("Adding consumer stream %" PRIu64 " (cpu %d) to data shard %u",
+			stream->key, stream->cpu, stream->data_shard->id);
 
 	rcu_read_unlock();
 	pthread_mutex_unlock(&stream->lock);
 	pthread_mutex_unlock(&stream->chan->timer_lock);
 	pthread_mutex_unlock(&stream->chan->lock);
-	pthread_mutex_unlock(&consumer_data.lock);
 
 	return ret;
 }
@@ -692,6 +1021,60 @@ void consumer_del_data_stream(struct lttng_consumer_stream *stream)
 	consumer_del_stream(stream, data_ht);
 }
 
+/*
+ * Queue a data stream added by consumer_add_data_stream() to the thread of its
+ * shard. The thread only picks it up once woken up by
+ * consumer_wakeup_data_shards(), so that all the streams of a channel are
+ * handed over with a single wakeup.
+ */
+void consumer_handover_data_stream(struct lttng_consumer_stream *stream)
+{
+	struct lttng_consumer_data_shard *shard = stream->data_shard;
+
+	assert(shard);
+
+	cds_wfcq_node_init(&stream->handover_node);
+	if (!cds_wfcq_enqueue(&shard->new_streams.head,
+			&shard->new_streams.tail, &stream->handover_node)) {
+		/* The queue was empty, the thread was not woken up yet. */
+		uatomic_set(&shard->new_streams.wakeup_pending, 1);
+	}
+}
+
+/*
+ * Wake up the threads of the shards to which streams were handed over since
+ * their last wakeup.
+ *
+ * Return 0 on success else a negative value, the streams then stay queued
+ * until the next wakeup of their shard.
+ */
+int consumer_wakeup_data_shards(struct lttng_consumer_local_data *ctx)
+{
+	int ret = 0;
+	unsigned int i;
+	/* Never dereferenced, see the data_pipe of the shards. */
+	struct lttng_consumer_stream *wakeup =
+			(struct lttng_consumer_stream *) &ctx->data_shards;
+
+	for (i = 0; i < ctx->nr_data_shards; i++) {
+		struct lttng_consumer_data_shard *shard = &ctx->data_shards[i];
+		ssize_t size;
+
+		if (!uatomic_xchg(&shard->new_streams.wakeup_pending, 0)) {
+			continue;
+		}
+		size = lttng_pipe_write(shard->data_pipe, &wakeup,
+				sizeof(wakeup));
+		if (size < (ssize_t) sizeof(wakeup)) {
+			ERR("Consumer write to the data pipe %d of data shard %u",
+					lttng_pipe_get_writefd(shard->data_pipe),
+					shard->id);
+			ret = -1;
+		}
+	}
+	return ret;
+}
+
 /*
  * Add relayd socket to global consumer data hashtable. RCU read side lock MUST
  * be acquired before calling this.
@@ -722,6 +1105,7 @@ end:
 static struct consumer_relayd_sock_pair *consumer_allocate_relayd_sock_pair(
 		uint64_t net_seq_idx)
 {
+	unsigned int i;
 	struct consumer_relayd_sock_pair *obj = NULL;
 
 	/* net sequence index of -1 is a failure */
@@ -739,7 +1123,11 @@ static struct consumer_relayd_sock_pair *consumer_allocate_relayd_sock_pair(
 	obj->refcount = 0;
 	obj->destroy_flag = 0;
 	obj->control_sock.sock.fd = -1;
-	obj->data_sock.sock.fd = -1;
+	for (i = 0; i < DEFAULT_CONSUMERD_MAX_RELAYD_DATA_CONNECTIONS; i++) {
+		obj->data_socks[i].sock.sock.fd = -1;
+		obj->data_socks[i].spool.fd = -1;
+		pthread_mutex_init(&obj->data_socks[i].lock, NULL);
+	}
 	lttng_ht_node_init_u64(&obj->node, obj->net_seq_idx);
 	pthread_mutex_init(&obj->ctrl_sock_mutex, NULL);
 
@@ -822,6 +1210,205 @@ end:
 	return ret;
 }
 
+/* Streams of a channel shared by the stream workers. */
+struct stream_work {
+	pthread_mutex_t lock;
+	/* Next stream to work on. */
+	struct cds_list_head *next;
+	struct cds_list_head *head;
+	consumer_stream_work_cb cb;
+	void *data;
+	/* First error returned by the callback. */
+	int ret;
+};
+
+/* A stream worker thread. */
+struct stream_worker {
+	pthread_t tid;
+	struct stream_work *work;
+};
+
+/*
+ * Work on the streams until none is left or the callback fails.
+ *
+ * The RCU read side lock MUST be acquired.
+ */
+static void stream_work_run(struct stream_work *work)
+{
+	for (;;) {
+		int ret;
+		struct lttng_consumer_stream *stream;
+
+		pthread_mutex_lock(&work->lock);
+		if (work->ret || work->next == work->head) {
+			pthread_mutex_unlock(&work->lock);
+			break;
+		}
+		stream = cds_list_entry(work->next, struct lttng_consumer_stream,
+				send_node);
+		work->next = work->next->next;
+		pthread_mutex_unlock(&work->lock);
+
+		ret = work->cb(stream, work->data);
+		if (ret) {
+			pthread_mutex_lock(&work->lock);
+			if (!work->ret) {
+				work->ret = ret;
+			}
+			pthread_mutex_unlock(&work->lock);
+			break;
+		}
+	}
+}
+
+static void *stream_worker_thread(void *data)
+{
+	struct stream_worker *worker = data;
+
+	rcu_register_thread();
+	rcu_read_lock();
+	stream_work_run(worker->work);
+	rcu_read_unlock();
+	rcu_unregister_thread();
+	return NULL;
+}
+
+int consumer_channel_streams_run(struct lttng_consumer_channel *channel,
+		unsigned int nr_threads, consumer_stream_work_cb cb, void *data)
+{
+	int ret;
+	unsigned int i, nr_streams = 0, nr_workers, nr_started = 0;
+	struct cds_list_head *pos;
+	struct stream_worker *workers = NULL;
+	struct stream_work work = {
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+		.next = channel->streams.head.next,
+		.head = &channel->streams.head,
+		.cb = cb,
+		.data = data,
+	};
+
+	cds_list_for_each(pos, &channel->streams.head) {
+		nr_streams++;
+	}
+
+	/* The calling thread is one of the workers. */
+	nr_workers = min(nr_threads, nr_streams);
+	if (nr_workers > 1) {
+		workers = zmalloc((nr_workers - 1) * sizeof(*workers));
+		if (!workers) {
+			PERROR("zmalloc stream workers");
+		}
+	}
+	for (i = 0; workers && i < nr_workers - 1; i++) {
+		workers[i].work = &work;
+		ret = pthread_create(&workers[i].tid, NULL,
+				stream_worker_thread, &workers[i]);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_create stream worker");
+			/* Work with the workers started so far. */
+			break;
+		}
+		nr_started++;
+	}
+	DBG("Working on %u streams of channel %" PRIu64 " with %u thread(s)",
+			nr_streams, channel->key, nr_started + 1);
+
+	stream_work_run(&work);
+
+	for (i = 0; i < nr_started; i++) {
+		ret = pthread_join(workers[i].tid, NULL);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_join stream worker");
+		}
+	}
+	free(workers);
+
+	return work.ret;
+}
+
+/*
+ * Add all the streams of a channel, which share the same relayd, on the relayd
+ * with their add stream commands pipelined.
+ *
+ * Returns 0 on success, < 0 on error. On error, the streams the relayd added
+ * are still flagged as sent to it.
+ */
+int consumer_send_relayd_channel_streams(struct lttng_consumer_channel *channel,
+		char *path)
+{
+	int ret;
+	unsigned int i, nb_streams = 0;
+	const char **names = NULL;
+	uint64_t *ids = NULL;
+	uint64_t net_seq_idx = -1ULL;
+	struct consumer_relayd_sock_pair *relayd;
+	struct lttng_consumer_stream *stream;
+
+	assert(channel);
+	assert(path);
+
+	cds_list_for_each_entry(stream, &channel->streams.head, send_node) {
+		net_seq_idx = stream->net_seq_idx;
+		nb_streams++;
+	}
+	if (!nb_streams) {
+		return 0;
+	}
+	assert(net_seq_idx != -1ULL);
+
+	names = zmalloc(nb_streams * sizeof(*names));
+	ids = zmalloc(nb_streams * sizeof(*ids));
+	if (!names || !ids) {
+		PERROR("zmalloc relayd streams");
+		ret = -ENOMEM;
+		goto end_free;
+	}
+	i = 0;
+	cds_list_for_each_entry(stream, &channel->streams.head, send_node) {
+		names[i] = stream->name;
+		ids[i] = -1ULL;
+		i++;
+	}
+
+	rcu_read_lock();
+	relayd = consumer_find_relayd(net_seq_idx);
+	if (relayd == NULL) {
+		ERR("Channel %" PRIu64 " relayd ID %" PRIu64 " unknown. Can't send its streams.",
+				channel->key, net_seq_idx);
+		ret = -1;
+		goto end;
+	}
+
+	pthread_mutex_lock(&relayd->ctrl_sock_mutex);
+	ret = relayd_add_streams(&relayd->control_sock, names, path, ids,
+			nb_streams, channel->tracefile_size,
+			channel->tracefile_count);
+	pthread_mutex_unlock(&relayd->ctrl_sock_mutex);
+
+	i = 0;
+	cds_list_for_each_entry(stream, &channel->streams.head, send_node) {
+		if (ids[i] != -1ULL) {
+			stream->relayd_stream_id = ids[i];
+			uatomic_inc(&relayd->refcount);
+			stream->sent_to_relayd = 1;
+		}
+		i++;
+	}
+
+	DBG("%u streams of channel %" PRIu64 " sent to relayd id %" PRIu64,
+			nb_streams, channel->key, net_seq_idx);
+
+end:
+	rcu_read_unlock();
+end_free:
+	free(names);
+	free(ids);
+	return ret;
+}
+
 /*
  * Find a relayd and send the streams sent message
  *
@@ -877,25 +1464,254 @@ void close_relayd_stream(struct lttng_consumer_stream *stream)
 }
 
 /*
- * Handle stream for relayd transmission if the stream applies for network
- * streaming where the net sequence index is set.
+ * Close on the relayd of id "net_seq_idx", in bulk, all the streams of a
+ * channel still flagged as sent to it, and drop their relayd reference.
  *
- * Return destination file descriptor or negative value on error.
+ * The streams MUST not be used concurrently.
  */
-static int write_relayd_stream_header(struct lttng_consumer_stream *stream,
-		size_t data_size, unsigned long padding,
-		struct consumer_relayd_sock_pair *relayd)
+void consumer_close_relayd_channel_streams(
+		struct lttng_consumer_channel *channel, uint64_t net_seq_idx)
 {
-	int outfd = -1, ret;
-	struct lttcomm_relayd_data_hdr data_hdr;
-
-	/* Safety net */
+	int ret;
+	unsigned int i = 0, nb_streams = 0;
+	struct lttcomm_relayd_close_stream *streams = NULL;
+	struct consumer_relayd_sock_pair *relayd;
+	struct lttng_consumer_stream *stream;
+
+	assert(channel);
+
+	cds_list_for_each_entry(stream, &channel->streams.head, send_node) {
+		if (stream->sent_to_relayd) {
+			nb_streams++;
+		}
+	}
+	if (!nb_streams) {
+		return;
+	}
+
+	streams = zmalloc(nb_streams * sizeof(*streams));
+	if (!streams) {
+		PERROR("zmalloc relayd close streams");
+	}
+
+	rcu_read_lock();
+	relayd = consumer_find_relayd(net_seq_idx);
+	cds_list_for_each_entry(stream, &channel->streams.head, send_node) {
+		pthread_mutex_lock(&stream->lock);
+		if (!stream->sent_to_relayd) {
+			goto next;
+		}
+		if (relayd && !streams) {
+			/* Fall back to closing the streams one by one. */
+			consumer_stream_relayd_close(stream, relayd);
+			goto next;
+		}
+		if (streams) {
+			streams[i].stream_id = htobe64(stream->relayd_stream_id);
+			streams[i].last_net_seq_num =
+				htobe64(stream->next_net_seq_num - 1);
+			i++;
+		}
+		if (relayd) {
+			uatomic_dec(&relayd->refcount);
+		}
+		stream->net_seq_idx = (uint64_t) -1ULL;
+		stream->sent_to_relayd = 0;
+	next:
+		pthread_mutex_unlock(&stream->lock);
+	}
+	/* Without the bulk array, the streams were closed one by one. */
+	if (!relayd || !streams) {
+		goto end;
+	}
+
+	/* Closing streams requires to lock the control socket. */
+	consumer_relayd_lock_control(relayd);
+	ret = relayd_close_streams(&relayd->control_sock, streams, nb_streams);
+	pthread_mutex_unlock(&relayd->ctrl_sock_mutex);
+	if (ret < 0) {
+		/* Same as consumer_stream_relayd_close(), continue cleaning up. */
+		DBG("Unable to close the streams on the relayd. Continuing");
+	}
+
+	/* Both conditions are met, we destroy the relayd. */
+	if (uatomic_read(&relayd->refcount) == 0 &&
+			uatomic_read(&relayd->destroy_flag)) {
+		consumer_destroy_relayd(relayd);
+	}
+end:
+	rcu_read_unlock();
+	free(streams);
+}
+
+/*
+ * Prepare the rotation of the local streams of a channel to a new trace chunk.
+ * The part of the channel's path under "old_root" is moved under "new_root",
+ * the resulting directory is created and every stream of the channel switches
+ * to it on its next packet. The streams created afterwards start in the new
+ * trace chunk.
+ *
+ * Return 0 on success, 1 if the channel is not written locally under
+ * "old_root" or else a negative value.
+ */
+int consumer_rotate_channel(struct lttng_consumer_channel *channel,
+		const char *old_root, const char *new_root)
+{
+	int ret;
+	size_t old_root_len = strlen(old_root);
+	char path[PATH_MAX];
+	struct lttng_consumer_stream *stream;
+	struct lttng_ht *ht = consumer_data.stream_per_chan_id_ht;
+	struct lttng_ht_iter iter;
+
+	assert(channel);
+
+	pthread_mutex_lock(&channel->lock);
+	if (!channel->monitor || channel->relayd_id != (uint64_t) -1ULL ||
+			strncmp(channel->pathname, old_root, old_root_len) ||
+			(channel->pathname[old_root_len] != '\0' &&
+			channel->pathname[old_root_len] != '/')) {
+		ret = 1;
+		goto end;
+	}
+
+	ret = snprintf(path, sizeof(path), "%s%s", new_root,
+			channel->pathname + old_root_len);
+	if (ret < 0 || ret >= sizeof(path)) {
+		ERR("Trace chunk path of channel %" PRIu64 " too long",
+				channel->key);
+		ret = -1;
+		goto end;
+	}
+	ret = utils_mkdir_recursive(path, S_IRWXU | S_IRWXG, channel->uid,
+			channel->gid);
+	if (ret < 0) {
+		ERR("Creating the trace chunk directory %s", path);
+		goto end;
+	}
+
+	rcu_read_lock();
+	cds_lfht_for_each_entry_duplicate(ht->ht,
+			ht->hash_fct(&channel->key, lttng_ht_seed), ht->match_fct,
+			&channel->key, &iter.iter, stream, node_channel_id.node) {
+		char *rotate_path;
+
+		health_code_update();
+
+		if (stream->net_seq_idx != (uint64_t) -1ULL) {
+			continue;
+		}
+		rotate_path = strdup(path);
+		if (!rotate_path) {
+			PERROR("strdup trace chunk path");
+			ret = -1;
+			rcu_read_unlock();
+			goto end;
+		}
+		pthread_mutex_lock(&stream->lock);
+		free(stream->rotate_path);
+		stream->rotate_path = rotate_path;
+		pthread_mutex_unlock(&stream->lock);
+	}
+	rcu_read_unlock();
+
+	/*
+	 * Every stream rotates before writing a new tracefile, none of them
+	 * reads the channel's path concurrently anymore.
+	 */
+	strcpy(channel->pathname, path);
+	DBG("Channel %" PRIu64 " rotated to the trace chunk %s", channel->key,
+			channel->pathname);
+	ret = 0;
+end:
+	pthread_mutex_unlock(&channel->lock);
+	return ret;
+}
+
+/*
+ * Return the relayd data socket on which the packets of a data stream are
+ * sent.
+ */
+static struct consumer_relayd_data_sock *relayd_stream_data_sock(
+		struct consumer_relayd_sock_pair *relayd,
+		struct lttng_consumer_stream *stream)
+{
+	if (!relayd->nr_data_socks) {
+		/* Never received; sending on its invalid fd fails. */
+		return &relayd->data_socks[0];
+	}
+	return &relayd->data_socks[stream->relayd_stream_id %
+			relayd->nr_data_socks];
+}
+
+/*
+ * Set the header of the next packet of a data stream sent to the relayd.
+ */
+static void init_relayd_data_hdr(struct lttng_consumer_stream *stream,
+		size_t data_size, unsigned long padding, uint64_t flags,
+		struct lttcomm_relayd_data_hdr *data_hdr)
+{
+	memset(data_hdr, 0, sizeof(*data_hdr));
+
+	/* Set header with stream information */
+	data_hdr->flags = htobe64(flags);
+	data_hdr->stream_id = htobe64(stream->relayd_stream_id);
+	data_hdr->data_size = htobe32(data_size);
+	data_hdr->padding_size = htobe32(padding);
+	/*
+	 * Note that net_seq_num below is assigned with the *current* value of
+	 * next_net_seq_num and only after that the next_net_seq_num will be
+	 * increment. This is why when issuing a command on the relayd using
+	 * this next value, 1 should always be substracted in order to compare
+	 * the last seen sequence number on the relayd side to the last sent.
+	 */
+	data_hdr->net_seq_num = htobe64(stream->next_net_seq_num);
+	/* Other fields are zeroed previously */
+}
+
+/*
+ * Spool a packet of a data stream if its relayd data socket is stalled, see
+ * consumer_spool_packet().
+ *
+ * The caller MUST hold the lock of the stream's data socket.
+ */
+static int spool_relayd_packet(struct lttng_consumer_stream *stream,
+		struct consumer_relayd_sock_pair *relayd,
+		struct consumer_relayd_data_sock *data_sock,
+		const char *buf, size_t len, unsigned long padding,
+		uint64_t flags)
+{
+	int ret;
+	struct lttcomm_relayd_data_hdr data_hdr;
+
+	init_relayd_data_hdr(stream, len, padding, flags, &data_hdr);
+	ret = consumer_spool_packet(relayd, data_sock, &data_hdr, buf, len);
+	if (ret == 1) {
+		++stream->next_net_seq_num;
+	}
+	return ret;
+}
+
+/*
+ * Handle stream for relayd transmission if the stream applies for network
+ * streaming where the net sequence index is set.
+ *
+ * The caller MUST hold the lock of the relayd control socket for a metadata
+ * stream or else the lock of the stream's data socket.
+ *
+ * Return destination file descriptor or negative value on error.
+ */
+static int write_relayd_stream_header(struct lttng_consumer_stream *stream,
+		size_t data_size, unsigned long padding, uint64_t flags,
+		struct consumer_relayd_sock_pair *relayd)
+{
+	int outfd = -1, ret;
+	struct lttcomm_relayd_data_hdr data_hdr;
+
+	/* Safety net */
 	assert(stream);
 	assert(relayd);
 
-	/* Reset data header */
-	memset(&data_hdr, 0, sizeof(data_hdr));
-
 	if (stream->metadata_flag) {
 		/* Caller MUST acquire the relayd control socket lock */
 		ret = relayd_send_metadata(&relayd->control_sock, data_size);
@@ -906,21 +1722,12 @@ static int write_relayd_stream_header(struct lttng_consumer_stream *stream,
 		/* Metadata are always sent on the control socket. */
 		outfd = relayd->control_sock.sock.fd;
 	} else {
-		/* Set header with stream information */
-		data_hdr.stream_id = htobe64(stream->relayd_stream_id);
-		data_hdr.data_size = htobe32(data_size);
-		data_hdr.padding_size = htobe32(padding);
-		/*
-		 * Note that net_seq_num below is assigned with the *current* value of
-		 * next_net_seq_num and only after that the next_net_seq_num will be
-		 * increment. This is why when issuing a command on the relayd using
-		 * this next value, 1 should always be substracted in order to compare
-		 * the last seen sequence number on the relayd side to the last sent.
-		 */
-		data_hdr.net_seq_num = htobe64(stream->next_net_seq_num);
-		/* Other fields are zeroed previously */
+		struct consumer_relayd_data_sock *data_sock =
+				relayd_stream_data_sock(relayd, stream);
 
-		ret = relayd_send_data_hdr(&relayd->data_sock, &data_hdr,
+		init_relayd_data_hdr(stream, data_size, padding, flags,
+				&data_hdr);
+		ret = relayd_send_data_hdr(&data_sock->sock, &data_hdr,
 				sizeof(data_hdr));
 		if (ret < 0) {
 			goto error;
@@ -929,13 +1736,125 @@ static int write_relayd_stream_header(struct lttng_consumer_stream *stream,
 		++stream->next_net_seq_num;
 
 		/* Set to go on data socket */
-		outfd = relayd->data_sock.sock.fd;
+		outfd = data_sock->sock.sock.fd;
 	}
 
 error:
 	return outfd;
 }
 
+/*
+ * Send a packet of "len" bytes mmap'd from the ring buffer to the relayd with
+ * its headers in a single vectored send: on the control socket for a
+ * metadata stream, on the data socket "data_sock" otherwise.
+ *
+ * If "zerocopy_seq" is not NULL, the payload is sent with MSG_ZEROCOPY and
+ * "zerocopy_seq" is set to the number of zero-copy sends of the socket which
+ * must complete before the sub-buffer is released.
+ *
+ * The caller MUST hold the lock of the relayd control socket for a metadata
+ * stream or else the lock of "data_sock".
+ *
+ * Return the number of payload bytes sent or else -1 with errno set.
+ */
+static ssize_t write_relayd_packet(struct lttng_consumer_stream *stream,
+		struct consumer_relayd_sock_pair *relayd,
+		struct consumer_relayd_data_sock *data_sock, const char *buf,
+		size_t len, unsigned long padding, uint64_t flags,
+		uint32_t *zerocopy_seq)
+{
+	ssize_t ret;
+	struct lttcomm_relayd_data_hdr data_hdr;
+
+	if (stream->metadata_flag) {
+		return relayd_send_metadata_packet(&relayd->control_sock,
+				stream->relayd_stream_id, padding, buf, len);
+	}
+
+	init_relayd_data_hdr(stream, len, padding, flags, &data_hdr);
+	if (zerocopy_seq) {
+		ret = relayd_send_data_packet_zerocopy(&data_sock->sock,
+				&data_hdr, buf, len, &data_sock->zerocopy_sent);
+		*zerocopy_seq = data_sock->zerocopy_sent;
+	} else {
+		ret = relayd_send_data_packet(&data_sock->sock, &data_hdr,
+				buf, len);
+	}
+	if (ret >= 0) {
+		++stream->next_net_seq_num;
+	}
+	return ret;
+}
+
+/*
+ * Wait until the zero-copy sends of a data socket are completed up to the
+ * send "seq", so that the sub-buffer they were made from can be released. A
+ * socket error or hang up ends the wait, the data is not sent anymore.
+ *
+ * The lock of "data_sock" MUST NOT be held.
+ */
+static void wait_relayd_zerocopy(struct consumer_relayd_data_sock *data_sock,
+		uint32_t seq)
+{
+	for (;;) {
+		int ret, copied = 0, done, err = 0;
+		socklen_t err_len = sizeof(err);
+		struct pollfd pfd;
+
+		pthread_mutex_lock(&data_sock->lock);
+		ret = relayd_reap_zerocopy(&data_sock->sock,
+				&data_sock->zerocopy_completed, &copied);
+		done = (int32_t) (data_sock->zerocopy_completed - seq) >= 0;
+		if (copied && data_sock->zerocopy) {
+			/* Typically over the loopback, nothing to spare. */
+			DBG("Zero-copy sends copied by the kernel, disabling them (fd: %d)",
+					data_sock->sock.sock.fd);
+			data_sock->zerocopy = 0;
+		}
+		pfd.fd = data_sock->sock.sock.fd;
+		pthread_mutex_unlock(&data_sock->lock);
+		if (done || ret < 0 || pfd.fd < 0 || CMM_LOAD_SHARED(consumer_quit)) {
+			break;
+		}
+
+		/* The error queue is reported by POLLERR. */
+		pfd.events = 0;
+		ret = poll(&pfd, 1, DEFAULT_CONSUMERD_ZEROCOPY_POLL_MS);
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			PERROR("poll zero-copy completion");
+			break;
+		}
+		if (pfd.revents & (POLLHUP | POLLNVAL)) {
+			break;
+		}
+		if ((pfd.revents & POLLERR) &&
+				!getsockopt(pfd.fd, SOL_SOCKET, SO_ERROR, &err,
+					&err_len) && err) {
+			DBG("Zero-copy completion wait ended by socket error %d",
+					err);
+			break;
+		}
+	}
+}
+
+/*
+ * Return the consumer output of a channel using the mmap tracer output. Data
+ * of monitored channels written on the local filesystem goes through
+ * io_uring when it is enabled.
+ */
+enum consumer_channel_output consumer_channel_mmap_output(uint64_t relayd_id,
+		int monitor)
+{
+	if (consumer_data.io_uring_depth && monitor &&
+			relayd_id == (uint64_t) -1ULL) {
+		return CONSUMER_CHANNEL_MMAP_URING;
+	}
+	return CONSUMER_CHANNEL_MMAP;
+}
+
 /*
  * Allocate and return a new lttng_consumer_channel object using the given key
  * to initialize the hash table node.
@@ -979,13 +1898,14 @@ struct lttng_consumer_channel *consumer_allocate_channel(uint64_t key,
 	channel->live_timer_interval = live_timer_interval;
 	pthread_mutex_init(&channel->lock, NULL);
 	pthread_mutex_init(&channel->timer_lock, NULL);
+	pthread_mutex_init(&channel->monitor_filter.lock, NULL);
 
 	switch (output) {
 	case LTTNG_EVENT_SPLICE:
 		channel->output = CONSUMER_CHANNEL_SPLICE;
 		break;
 	case LTTNG_EVENT_MMAP:
-		channel->output = CONSUMER_CHANNEL_MMAP;
+		channel->output = consumer_channel_mmap_output(relayd_id, monitor);
 		break;
 	default:
 		assert(0);
@@ -1012,6 +1932,7 @@ struct lttng_consumer_channel *consumer_allocate_channel(uint64_t key,
 
 	strncpy(channel->name, name, sizeof(channel->name));
 	channel->name[sizeof(channel->name) - 1] = '\0';
+	channel->priority = consumer_priority_lookup(channel->name);
 
 	if (root_shm_path) {
 		strncpy(channel->root_shm_path, root_shm_path, sizeof(channel->root_shm_path));
@@ -1068,67 +1989,6 @@ int consumer_add_channel(struct lttng_consumer_channel *channel,
 	return 0;
 }
 
-/*
- * Allocate the pollfd structure and the local view of the out fds to avoid
- * doing a lookup in the linked list and concurrency issues when writing is
- * needed. Called with consumer_data.lock held.
- *
- * Returns the number of fds in the structures.
- */
-static int update_poll_array(struct lttng_consumer_local_data *ctx,
-		struct pollfd **pollfd, struct lttng_consumer_stream **local_stream,
-		struct lttng_ht *ht)
-{
-	int i = 0;
-	struct lttng_ht_iter iter;
-	struct lttng_consumer_stream *stream;
-
-	assert(ctx);
-	assert(ht);
-	assert(pollfd);
-	assert(local_stream);
-
-	DBG("Updating poll fd array");
-	rcu_read_lock();
-	cds_lfht_for_each_entry(ht->ht, &iter.iter, stream, node.node) {
-		/*
-		 * Only active streams with an active end point can be added to the
-		 * poll set and local stream storage of the thread.
-		 *
-		 * There is a potential race here for endpoint_status to be updated
-		 * just after the check. However, this is OK since the stream(s) will
-		 * be deleted once the thread is notified that the end point state has
-		 * changed where this function will be called back again.
-		 */
-		if (stream->state != LTTNG_CONSUMER_ACTIVE_STREAM ||
-				stream->endpoint_status == CONSUMER_ENDPOINT_INACTIVE) {
-			continue;
-		}
-		/*
-		 * This clobbers way too much the debug output. Uncomment that if you
-		 * need it for debugging purposes.
-		 *
-		 * DBG("Active FD %d", stream->wait_fd);
-		 */
-		(*pollfd)[i].fd = stream->wait_fd;
-		(*pollfd)[i].events = POLLIN | POLLPRI;
-		local_stream[i] = stream;
-		i++;
-	}
-	rcu_read_unlock();
-
-	/*
-	 * Insert the consumer_data_pipe at the end of the array and don't
-	 * increment i so nb_fd is the number of real FD.
-	 */
-	(*pollfd)[i].fd = lttng_pipe_get_readfd(ctx->consumer_data_pipe);
-	(*pollfd)[i].events = POLLIN | POLLPRI;
-
-	(*pollfd)[i + 1].fd = lttng_pipe_get_readfd(ctx->consumer_wakeup_pipe);
-	(*pollfd)[i + 1].events = POLLIN | POLLPRI;
-	return i;
-}
-
 /*
  * Poll on the should_quit pipe and the command socket return -1 on
  * error, 1 if should exit, 0 if data is available on the command socket
@@ -1238,26 +2098,26 @@ void lttng_consumer_should_exit(struct lttng_consumer_local_data *ctx)
 
 
 /*
- * Flush pending writes to trace output disk file.
+ * Flush pending writes to trace output disk file for the "len" bytes written
+ * prior to "offset".
  */
 static
-void lttng_consumer_sync_trace_file(struct lttng_consumer_stream *stream,
-		off_t orig_offset)
+void lttng_consumer_sync_trace_file_range(struct lttng_consumer_stream *stream,
+		off_t offset, size_t len)
 {
 	int ret;
 	int outfd = stream->out_fd;
 
 	/*
 	 * This does a blocking write-and-wait on any page that belongs to the
-	 * subbuffer prior to the one we just wrote.
+	 * range prior to the one we just wrote.
 	 * Don't care about error values, as these are just hints and ways to
 	 * limit the amount of page cache used.
 	 */
-	if (orig_offset < stream->max_sb_size) {
+	if (!len || offset < len) {
 		return;
 	}
-	lttng_sync_file_range(outfd, orig_offset - stream->max_sb_size,
-			stream->max_sb_size,
+	lttng_sync_file_range(outfd, offset - len, len,
 			SYNC_FILE_RANGE_WAIT_BEFORE
 			| SYNC_FILE_RANGE_WRITE
 			| SYNC_FILE_RANGE_WAIT_AFTER);
@@ -1275,8 +2135,7 @@ void lttng_consumer_sync_trace_file(struct lttng_consumer_stream *stream,
 	 * defined. So it can be expected to lead to lower throughput in
 	 * streaming.
 	 */
-	ret = posix_fadvise(outfd, orig_offset - stream->max_sb_size,
-			stream->max_sb_size, POSIX_FADV_DONTNEED);
+	ret = posix_fadvise(outfd, offset - len, len, POSIX_FADV_DONTNEED);
 	if (ret && ret != -ENOSYS) {
 		errno = ret;
 		PERROR("posix_fadvise on fd %i", outfd);
@@ -1284,60 +2143,197 @@ void lttng_consumer_sync_trace_file(struct lttng_consumer_stream *stream,
 }
 
 /*
- * Initialise the necessary environnement :
- * - create a new context
- * - create the poll_pipe
- * - create the should_quit pipe (for signal handler)
- * - create the thread pipe (for splice)
- *
- * Takes a function pointer as argument, this function is called when data is
- * available on a buffer. This function is responsible to do the
- * kernctl_get_next_subbuf, read the data with mmap or splice depending on the
- * buffer configuration and then kernctl_put_next_subbuf at the end.
- *
- * Returns a pointer to the new context or NULL on error.
+ * Flush pending writes to trace output disk file.
  */
-struct lttng_consumer_local_data *lttng_consumer_create(
-		enum lttng_consumer_type type,
-		ssize_t (*buffer_ready)(struct lttng_consumer_stream *stream,
-			struct lttng_consumer_local_data *ctx),
-		int (*recv_channel)(struct lttng_consumer_channel *channel),
-		int (*recv_stream)(struct lttng_consumer_stream *stream),
-		int (*update_stream)(uint64_t stream_key, uint32_t state))
+static
+void lttng_consumer_sync_trace_file(struct lttng_consumer_stream *stream,
+		off_t orig_offset)
 {
-	int ret;
-	struct lttng_consumer_local_data *ctx;
+	lttng_consumer_sync_trace_file_range(stream, orig_offset,
+			stream->max_sb_size);
+}
 
-	assert(consumer_data.type == LTTNG_CONSUMER_UNKNOWN ||
-		consumer_data.type == type);
-	consumer_data.type = type;
+/*
+ * Destroy the pipes of the first nr_shards data shards of the context and
+ * free the shard array.
+ */
+static void destroy_data_shards(struct lttng_consumer_local_data *ctx,
+		unsigned int nr_shards)
+{
+	unsigned int i;
 
-	ctx = zmalloc(sizeof(struct lttng_consumer_local_data));
-	if (ctx == NULL) {
-		PERROR("allocating context");
-		goto error;
+	for (i = 0; i < nr_shards; i++) {
+		lttng_pipe_destroy(ctx->data_shards[i].wakeup_pipe);
+		lttng_pipe_destroy(ctx->data_shards[i].data_pipe);
 	}
+	free(ctx->data_shards);
+	ctx->data_shards = NULL;
+	ctx->nr_data_shards = 0;
+}
 
-	ctx->consumer_error_socket = -1;
-	ctx->consumer_metadata_socket = -1;
-	pthread_mutex_init(&ctx->metadata_socket_lock, NULL);
-	/* assign the callbacks */
-	ctx->on_buffer_ready = buffer_ready;
-	ctx->on_recv_channel = recv_channel;
-	ctx->on_recv_stream = recv_stream;
-	ctx->on_update_stream = update_stream;
+/*
+ * Allocate the data shards of the context and their pipes.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static int create_data_shards(struct lttng_consumer_local_data *ctx,
+		unsigned int nr_shards)
+{
+	int ret = 0;
+	unsigned int i;
 
-	ctx->consumer_data_pipe = lttng_pipe_open(0);
-	if (!ctx->consumer_data_pipe) {
-		goto error_poll_pipe;
-	}
+	assert(nr_shards > 0);
 
-	ctx->consumer_wakeup_pipe = lttng_pipe_open(0);
-	if (!ctx->consumer_wakeup_pipe) {
-		goto error_wakeup_pipe;
+	ctx->data_shards = zmalloc(nr_shards * sizeof(*ctx->data_shards));
+	if (!ctx->data_shards) {
+		PERROR("zmalloc data shards");
+		ret = -ENOMEM;
+		goto end;
 	}
 
-	ret = pipe(ctx->consumer_should_quit);
+	for (i = 0; i < nr_shards; i++) {
+		struct lttng_consumer_data_shard *shard = &ctx->data_shards[i];
+
+		shard->id = i;
+		shard->ctx = ctx;
+		shard->numa_node = consumer_data.numa_affine ?
+				(int) (i % consumer_numa_nr_nodes()) : -1;
+		cds_wfcq_init(&shard->new_streams.head,
+				&shard->new_streams.tail);
+		shard->data_pipe = lttng_pipe_open(0);
+		if (!shard->data_pipe) {
+			ret = -1;
+			goto error;
+		}
+		shard->wakeup_pipe = lttng_pipe_open(0);
+		if (!shard->wakeup_pipe) {
+			lttng_pipe_destroy(shard->data_pipe);
+			ret = -1;
+			goto error;
+		}
+	}
+	ctx->nr_data_shards = nr_shards;
+	ctx->nr_data_threads_active = nr_shards;
+end:
+	return ret;
+error:
+	destroy_data_shards(ctx, i);
+	return ret;
+}
+
+/*
+ * Destroy the pipes of the first nr_shards metadata shards of the context and
+ * free the shard array.
+ */
+static void destroy_metadata_shards(struct lttng_consumer_local_data *ctx,
+		unsigned int nr_shards)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr_shards; i++) {
+		lttng_pipe_destroy(ctx->metadata_shards[i].metadata_pipe);
+	}
+	free(ctx->metadata_shards);
+	ctx->metadata_shards = NULL;
+	ctx->nr_metadata_shards = 0;
+}
+
+/*
+ * Allocate the metadata shards of the context and their pipes.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static int create_metadata_shards(struct lttng_consumer_local_data *ctx,
+		unsigned int nr_shards)
+{
+	int ret = 0;
+	unsigned int i;
+
+	assert(nr_shards > 0);
+
+	ctx->metadata_shards = zmalloc(nr_shards *
+			sizeof(*ctx->metadata_shards));
+	if (!ctx->metadata_shards) {
+		PERROR("zmalloc metadata shards");
+		ret = -ENOMEM;
+		goto end;
+	}
+
+	for (i = 0; i < nr_shards; i++) {
+		struct lttng_consumer_metadata_shard *shard =
+				&ctx->metadata_shards[i];
+
+		shard->id = i;
+		shard->ctx = ctx;
+		shard->metadata_pipe = lttng_pipe_open(0);
+		if (!shard->metadata_pipe) {
+			ret = -1;
+			goto error;
+		}
+	}
+	ctx->nr_metadata_shards = nr_shards;
+end:
+	return ret;
+error:
+	destroy_metadata_shards(ctx, i);
+	return ret;
+}
+
+/*
+ * Initialise the necessary environnement :
+ * - create a new context
+ * - create the data and metadata shards and their poll pipes
+ * - create the should_quit pipe (for signal handler)
+ * - create the thread pipe (for splice)
+ *
+ * Takes a function pointer as argument, this function is called when data is
+ * available on a buffer. This function is responsible to do the
+ * kernctl_get_next_subbuf, read the data with mmap or splice depending on the
+ * buffer configuration and then kernctl_put_next_subbuf at the end.
+ *
+ * One data poll thread must be launched for each of the nr_data_shards data
+ * shards and one metadata poll thread for each of the nr_metadata_shards
+ * metadata shards.
+ *
+ * Returns a pointer to the new context or NULL on error.
+ */
+struct lttng_consumer_local_data *lttng_consumer_create(
+		enum lttng_consumer_type type,
+		ssize_t (*buffer_ready)(struct lttng_consumer_stream *stream,
+			struct lttng_consumer_local_data *ctx),
+		int (*recv_channel)(struct lttng_consumer_channel *channel),
+		int (*recv_stream)(struct lttng_consumer_stream *stream),
+		int (*update_stream)(uint64_t stream_key, uint32_t state),
+		unsigned int nr_data_shards, unsigned int nr_metadata_shards)
+{
+	int ret;
+	struct lttng_consumer_local_data *ctx;
+
+	assert(consumer_data.type == LTTNG_CONSUMER_UNKNOWN ||
+		consumer_data.type == type);
+	consumer_data.type = type;
+
+	ctx = zmalloc(sizeof(struct lttng_consumer_local_data));
+	if (ctx == NULL) {
+		PERROR("allocating context");
+		goto error;
+	}
+
+	ctx->consumer_error_socket = -1;
+	ctx->consumer_metadata_socket = -1;
+	pthread_mutex_init(&ctx->metadata_socket_lock, NULL);
+	/* assign the callbacks */
+	ctx->on_buffer_ready = buffer_ready;
+	ctx->on_recv_channel = recv_channel;
+	ctx->on_recv_stream = recv_stream;
+	ctx->on_update_stream = update_stream;
+
+	ret = create_data_shards(ctx, nr_data_shards);
+	if (ret) {
+		goto error_data_shards;
+	}
+
+	ret = pipe(ctx->consumer_should_quit);
 	if (ret < 0) {
 		PERROR("Error creating recv pipe");
 		goto error_quit_pipe;
@@ -1349,36 +2345,36 @@ struct lttng_consumer_local_data *lttng_consumer_create(
 		goto error_channel_pipe;
 	}
 
-	ctx->consumer_metadata_pipe = lttng_pipe_open(0);
-	if (!ctx->consumer_metadata_pipe) {
-		goto error_metadata_pipe;
+	ret = create_metadata_shards(ctx, nr_metadata_shards);
+	if (ret) {
+		goto error_metadata_shards;
 	}
 
 	ctx->channel_monitor_pipe = -1;
 
 	return ctx;
 
-error_metadata_pipe:
+error_metadata_shards:
 	utils_close_pipe(ctx->consumer_channel_pipe);
 error_channel_pipe:
 	utils_close_pipe(ctx->consumer_should_quit);
 error_quit_pipe:
-	lttng_pipe_destroy(ctx->consumer_wakeup_pipe);
-error_wakeup_pipe:
-	lttng_pipe_destroy(ctx->consumer_data_pipe);
-error_poll_pipe:
+	destroy_data_shards(ctx, ctx->nr_data_shards);
+error_data_shards:
 	free(ctx);
 error:
 	return NULL;
 }
 
 /*
- * Iterate over all streams of the hashtable and free them properly.
+ * Iterate over all streams of the hashtable and free them properly, after a
+ * single grace period.
  */
 static void destroy_data_stream_ht(struct lttng_ht *ht)
 {
 	struct lttng_ht_iter iter;
 	struct lttng_consumer_stream *stream;
+	struct lttng_ht_free_batch free_batch = { 0 };
 
 	if (ht == NULL) {
 		return;
@@ -1386,13 +2382,10 @@ static void destroy_data_stream_ht(struct lttng_ht *ht)
 
 	rcu_read_lock();
 	cds_lfht_for_each_entry(ht->ht, &iter.iter, stream, node.node) {
-		/*
-		 * Ignore return value since we are currently cleaning up so any error
-		 * can't be handled.
-		 */
-		(void) consumer_del_stream(stream, ht);
+		consumer_stream_destroy_batch(stream, ht, &free_batch);
 	}
 	rcu_read_unlock();
+	lttng_ht_free_batch_commit(&free_batch);
 
 	lttng_ht_destroy(ht);
 }
@@ -1448,9 +2441,8 @@ void lttng_consumer_destroy(struct lttng_consumer_local_data *ctx)
 		PERROR("close");
 	}
 	utils_close_pipe(ctx->consumer_channel_pipe);
-	lttng_pipe_destroy(ctx->consumer_data_pipe);
-	lttng_pipe_destroy(ctx->consumer_metadata_pipe);
-	lttng_pipe_destroy(ctx->consumer_wakeup_pipe);
+	destroy_data_shards(ctx, ctx->nr_data_shards);
+	destroy_metadata_shards(ctx, ctx->nr_metadata_shards);
 	utils_close_pipe(ctx->consumer_should_quit);
 
 	unlink(ctx->consumer_command_sock_path);
@@ -1495,6 +2487,266 @@ end:
 	return (int) ret;
 }
 
+/*
+ * Copy a sub-buffer at the end of the batch of a stream.
+ *
+ * Return 0 on success or else a negative errno.
+ */
+static int batch_append(struct lttng_consumer_stream *stream,
+		const void *data, size_t len)
+{
+	int ret = 0;
+	struct consumer_stream_batch *batch = &stream->batch;
+
+	if (batch->len + len > batch->alloc_len) {
+		char *new_buf;
+		size_t new_len = max_t(size_t, batch->alloc_len << 1,
+				batch->len + len);
+
+		/* Aligned so the batch can be written with direct I/O. */
+		ret = posix_memalign((void **) &new_buf,
+				DEFAULT_CONSUMERD_DIRECT_IO_ALIGN, new_len);
+		if (ret) {
+			errno = ret;
+			PERROR("posix_memalign batch buffer");
+			ret = -ENOMEM;
+			goto end;
+		}
+		memcpy(new_buf, batch->buf, batch->len);
+		free(batch->buf);
+		batch->buf = new_buf;
+		batch->alloc_len = new_len;
+	}
+
+	if (!batch->len) {
+		batch->offset = stream->out_fd_offset;
+	}
+	memcpy(batch->buf + batch->len, data, len);
+	batch->len += len;
+
+end:
+	return ret;
+}
+
+/*
+ * Return 1 if a write of "len" bytes at "offset" in the output file of a stream
+ * can be done with direct I/O, or if the file is not opened with direct I/O.
+ */
+static int direct_io_aligned(struct lttng_consumer_stream *stream,
+		off_t offset, size_t len)
+{
+	if (!stream->out_fd_direct) {
+		return 1;
+	}
+	return !(((uint64_t) offset | len) &
+			(DEFAULT_CONSUMERD_DIRECT_IO_ALIGN - 1));
+}
+
+/*
+ * Write "len" bytes of "buf" to the output file of a stream opened with direct
+ * I/O through its aligned staging buffer.
+ *
+ * Return the number of bytes written or else -1 with errno set.
+ */
+static ssize_t write_direct(struct lttng_consumer_stream *stream,
+		const void *buf, size_t len)
+{
+	if (stream->direct_buf_len < len) {
+		int ret;
+		void *new_buf;
+
+		ret = posix_memalign(&new_buf, DEFAULT_CONSUMERD_DIRECT_IO_ALIGN,
+				len);
+		if (ret) {
+			errno = ret;
+			return -1;
+		}
+		free(stream->direct_buf);
+		stream->direct_buf = new_buf;
+		stream->direct_buf_len = len;
+	}
+	memcpy(stream->direct_buf, buf, len);
+	return lttng_write(stream->out_fd, stream->direct_buf, len);
+}
+
+/*
+ * Write the batch of a stream to its output file and then the packet indexes
+ * of the batched sub-buffers. The batch is empty on return.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static int batch_flush(struct lttng_consumer_stream *stream)
+{
+	ssize_t ret = 0;
+	unsigned int i;
+	struct consumer_stream_batch *batch = &stream->batch;
+
+	if (!batch->len) {
+		goto write_indexes;
+	}
+
+	if (!direct_io_aligned(stream, batch->offset, batch->len)) {
+		consumer_stream_clear_direct_io(stream);
+	}
+
+	if (stream->io_uring) {
+		ret = lttng_io_uring_write(stream->io_uring, stream->out_fd,
+				batch->buf, batch->len, batch->offset);
+		if (ret < 0) {
+			ERR("Error in io_uring batch write (ret %zd, len %zu)", ret,
+					batch->len);
+			goto end;
+		}
+	} else {
+		ret = lttng_write(stream->out_fd, batch->buf, batch->len);
+		if (ret < 0 || (size_t) ret != batch->len) {
+			PERROR("Error in batch write (ret %zd != len %zu)", ret,
+					batch->len);
+			ret = -1;
+			goto end;
+		}
+		/* Direct I/O bypasses the page cache, nothing to write back. */
+		if (!stream->out_fd_direct &&
+				consumer_writeback_queue(stream, batch->offset,
+					batch->len)) {
+			/* This won't block, but will start writeout asynchronously */
+			lttng_sync_file_range(stream->out_fd, batch->offset,
+					batch->len, SYNC_FILE_RANGE_WRITE);
+			lttng_consumer_sync_trace_file_range(stream, batch->offset,
+					batch->prev_len);
+		}
+	}
+	batch->prev_len = batch->len;
+
+write_indexes:
+	/* The indexes must never reference data that is not written. */
+	for (i = 0; i < batch->nr_indexes; i++) {
+		ret = lttng_index_file_write(stream->index_file,
+				&batch->indexes[i]);
+		if (ret) {
+			ret = -1;
+			goto end;
+		}
+	}
+	ret = 0;
+
+end:
+	batch->len = 0;
+	batch->nr_indexes = 0;
+	return ret;
+}
+
+/*
+ * Write "len" bytes of the mmap'd sub-buffer "buf" to the output file of a
+ * snapshot stream without copying them in user space: the pages are spliced
+ * from memory to the snapshot pipe of the stream and from there to the file.
+ *
+ * The pipe is drained before returning, so the sub-buffer can be released
+ * right after.
+ *
+ * Return the number of bytes written or else -1 with errno set.
+ */
+static ssize_t write_snapshot_splice(struct lttng_consumer_stream *stream,
+		int outfd, const char *buf, size_t len)
+{
+	ssize_t ret;
+	int saved_errno;
+	size_t written = 0;
+
+	if (stream->snapshot_pipe[0] < 0) {
+		ret = utils_create_pipe(stream->snapshot_pipe);
+		if (ret < 0) {
+			stream->snapshot_pipe[0] = stream->snapshot_pipe[1] = -1;
+			return lttng_write(outfd, buf, len);
+		}
+	}
+
+	while (written < len) {
+		size_t chunk;
+		struct iovec iov = {
+			.iov_base = (void *) (buf + written),
+			.iov_len = len - written,
+		};
+
+		/* The pipe is empty, at least one page always fits. */
+		ret = vmsplice(stream->snapshot_pipe[1], &iov, 1,
+				SPLICE_F_NONBLOCK);
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			goto error;
+		}
+
+		chunk = ret;
+		while (chunk > 0) {
+			ret = splice(stream->snapshot_pipe[0], NULL, outfd, NULL,
+					chunk, SPLICE_F_MOVE | SPLICE_F_MORE);
+			if (ret < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				goto error;
+			}
+			chunk -= ret;
+			written += ret;
+		}
+	}
+	return written;
+
+error:
+	PERROR("Snapshot splice of stream %" PRIu64, stream->key);
+	saved_errno = errno;
+	/* The pipe content is unknown, use a new one on the next write. */
+	utils_close_pipe(stream->snapshot_pipe);
+	stream->snapshot_pipe[0] = stream->snapshot_pipe[1] = -1;
+	errno = saved_errno;
+	return written ? (ssize_t) written : -1;
+}
+
+/*
+ * Write the packet of "len" bytes of "buf", ending with "padding" bytes of
+ * padding, to the output file of a local stream, leaving the padding as a
+ * hole which reads as zeros.
+ *
+ * Return the number of bytes written, counting the padding, or else -1 with
+ * errno set.
+ */
+static ssize_t write_sparse_padding(int fd, const char *buf, size_t len,
+		unsigned long padding)
+{
+	ssize_t ret;
+	size_t content_len = len - padding;
+	off_t end;
+
+	ret = lttng_write(fd, buf, content_len);
+	if (ret < (ssize_t) content_len) {
+		goto end;
+	}
+
+	end = lseek(fd, padding, SEEK_CUR);
+	if (end < 0) {
+		ret = -1;
+		goto end;
+	}
+	/* The hole of the last packet of the file must still be counted in. */
+	if (ftruncate(fd, end)) {
+		DBG("Extending the output file past the padding failed: %s",
+				strerror(errno));
+		if (lseek(fd, end - padding, SEEK_SET) < 0) {
+			ret = -1;
+			goto end;
+		}
+		ret = lttng_write(fd, buf + content_len, padding);
+		if (ret < (ssize_t) padding) {
+			goto end;
+		}
+	}
+	ret = len;
+end:
+	return ret;
+}
+
 /*
  * Mmap the ring buffer, read it and write the data to the tracefile. This is a
  * core function for writing trace buffers to either the local filesystem or
@@ -1504,6 +2756,11 @@ end:
  *
  * Careful review MUST be put if any changes occur!
  *
+ * The packets of the data streams of a compressed channel are written as
+ * compressed frames, as are the packets sent to a relayd inflating them when
+ * the relayd compression is enabled, but the returned length is always the
+ * one of the uncompressed data.
+ *
  * Returns the number of bytes written
  */
 ssize_t lttng_consumer_on_read_subbuffer_mmap(
@@ -1514,12 +2771,21 @@ ssize_t lttng_consumer_on_read_subbuffer_mmap(
 {
 	unsigned long mmap_offset;
 	void *mmap_base;
+	const char *buf;
+	size_t write_len;
 	ssize_t ret = 0;
 	off_t orig_offset = stream->out_fd_offset;
 	/* Default is on the disk */
 	int outfd = stream->out_fd;
 	struct consumer_relayd_sock_pair *relayd = NULL;
+	struct consumer_relayd_data_sock *data_sock = NULL;
 	unsigned int relayd_hang_up = 0;
+	unsigned int use_io_uring = 0;
+	unsigned int use_snapshot_splice = 0;
+	unsigned int use_zerocopy = 0;
+	uint32_t zerocopy_seq = 0;
+	unsigned int compressed = 0;
+	uint64_t data_flags = 0;
 
 	/* RCU lock for the relayd pointer */
 	rcu_read_lock();
@@ -1531,6 +2797,13 @@ ssize_t lttng_consumer_on_read_subbuffer_mmap(
 			ret = -EPIPE;
 			goto end;
 		}
+		/* A snapshot is never left incomplete. */
+		if (!stream->metadata_flag &&
+				relayd_apply_backpressure(relayd, stream,
+					stream->chan->monitor)) {
+			/* The caller releases the packet without its index. */
+			goto end;
+		}
 	}
 
 	/* get the offset inside the fd to mmap */
@@ -1563,10 +2836,55 @@ ssize_t lttng_consumer_on_read_subbuffer_mmap(
 		assert(0);
 	}
 
+	buf = mmap_base + mmap_offset;
+	write_len = len;
+
+	/* Only the packets of the data streams are compressed. */
+	if (stream->chan->compression != LTTNG_CHANNEL_COMPRESSION_NONE &&
+			!stream->metadata_flag) {
+		const void *frame;
+
+		if (!stream->compress) {
+			stream->compress = consumer_compress_create(
+					stream->chan->compression);
+			if (!stream->compress) {
+				ret = -ENOMEM;
+				goto end;
+			}
+		}
+		ret = consumer_compress_packet(stream->compress, buf, len,
+				len + padding, &frame);
+		if (ret < 0) {
+			ERR("Compressing packet of stream %" PRIu64, stream->key);
+			goto end;
+		}
+		buf = frame;
+		write_len = ret;
+		compressed = 1;
+	} else if (relayd && consumer_data.relayd_compression &&
+			!stream->metadata_flag &&
+			relayd_supports_wire_compression(&relayd->control_sock)) {
+		const void *frame;
+
+		/* The relayd inflates the packet before writing it. */
+		if (!stream->compress) {
+			stream->compress = consumer_compress_create(
+					LTTNG_CHANNEL_COMPRESSION_ZLIB);
+		}
+		if (stream->compress) {
+			ret = consumer_compress_packet(stream->compress, buf,
+					len, len + padding, &frame);
+			/* Incompressible packets are sent as is. */
+			if (ret > 0 && (size_t) ret < len) {
+				buf = frame;
+				write_len = ret;
+				data_flags = RELAYD_DATA_COMPRESSED;
+			}
+		}
+	}
+
 	/* Handle stream on the relayd if the output is on the network */
 	if (relayd) {
-		unsigned long netlen = len;
-
 		/*
 		 * Lock the control socket for the complete duration of the function
 		 * since from this point on we will use the socket.
@@ -1584,30 +2902,36 @@ ssize_t lttng_consumer_on_read_subbuffer_mmap(
 				}
 				stream->reset_metadata_flag = 0;
 			}
-			netlen += sizeof(struct lttcomm_relayd_metadata_payload);
-		}
-
-		ret = write_relayd_stream_header(stream, netlen, padding, relayd);
-		if (ret < 0) {
-			relayd_hang_up = 1;
-			goto write_error;
-		}
-		/* Use the returned socket. */
-		outfd = ret;
-
-		/* Write metadata stream id before payload */
-		if (stream->metadata_flag) {
-			ret = write_relayd_metadata_id(outfd, stream, relayd, padding);
-			if (ret < 0) {
-				relayd_hang_up = 1;
-				goto write_error;
+		} else {
+			/* Lock the data socket until the whole packet is sent. */
+			data_sock = relayd_stream_data_sock(relayd, stream);
+			pthread_mutex_lock(&data_sock->lock);
+
+			if (consumer_spool_enabled()) {
+				ret = spool_relayd_packet(stream, relayd, data_sock,
+						buf, write_len, compressed ? 0 : padding,
+						data_flags);
+				if (ret < 0) {
+					relayd_hang_up = 1;
+					goto write_error;
+				}
+				if (ret == 1) {
+					stream->output_written += write_len;
+					ret = len;
+					goto end;
+				}
 			}
 		}
+
 	} else {
 		/* No streaming, we have to set the len with the full padding */
 		len += padding;
+		if (!compressed) {
+			write_len = len;
+		}
 
 		if (stream->metadata_flag && stream->reset_metadata_flag) {
+			consumer_writeback_wait(stream);
 			ret = utils_truncate_stream_file(stream->out_fd, 0);
 			if (ret < 0) {
 				ERR("Reset metadata file");
@@ -1616,13 +2940,67 @@ ssize_t lttng_consumer_on_read_subbuffer_mmap(
 			stream->reset_metadata_flag = 0;
 		}
 
+		if (consumer_data.snapshot_splice && !stream->chan->monitor &&
+				!stream->metadata_flag && !compressed) {
+			use_snapshot_splice = 1;
+		} else if (stream->chan->output == CONSUMER_CHANNEL_MMAP_URING &&
+				!stream->metadata_flag) {
+			if (!stream->io_uring) {
+				stream->io_uring = lttng_io_uring_create(
+						consumer_data.io_uring_depth);
+			}
+			/* Fallback on a blocking write if the writer is unavailable. */
+			use_io_uring = stream->io_uring != NULL;
+		}
+
+		/*
+		 * Switch to the trace chunk of a pending session rotation at this
+		 * packet boundary. The metadata streams are switched by the
+		 * tracer-specific code once their buffers are drained, since the
+		 * new chunk needs the whole metadata.
+		 */
+		if (stream->rotate_path && !stream->metadata_flag) {
+			if (stream->batch.active) {
+				/* The batched data belongs to the current chunk. */
+				ret = batch_flush(stream);
+				if (ret < 0) {
+					goto end;
+				}
+			}
+			ret = consumer_stream_rotate_chunk(stream);
+			if (ret < 0) {
+				ERR("Rotating stream %" PRIu64 " to a new trace chunk",
+						stream->key);
+				goto end;
+			}
+			outfd = stream->out_fd;
+			stream->batch.prev_len = 0;
+			orig_offset = 0;
+		}
+
 		/*
 		 * Check if we need to change the tracefile before writing the packet.
 		 */
 		if (stream->chan->tracefile_size > 0 &&
-				(stream->tracefile_size_current + len) >
+				(stream->tracefile_size_current + write_len) >
 				stream->chan->tracefile_size) {
-			ret = utils_rotate_stream_file(stream->chan->pathname,
+			if (stream->batch.active) {
+				/* The batched data belongs to the current tracefile. */
+				ret = batch_flush(stream);
+				if (ret < 0) {
+					goto end;
+				}
+			}
+			if (stream->io_uring) {
+				/* The writes in flight target the current tracefile. */
+				ret = lttng_io_uring_drain(stream->io_uring);
+				if (ret < 0) {
+					goto end;
+				}
+			}
+			consumer_writeback_wait(stream);
+			ret = utils_rotate_stream_file_at(stream->out_dir_fd,
+					consumer_stream_output_path(stream),
 					stream->name, stream->chan->tracefile_size,
 					stream->chan->tracefile_count, stream->uid, stream->gid,
 					stream->out_fd, &(stream->tracefile_count_current),
@@ -1632,10 +3010,12 @@ ssize_t lttng_consumer_on_read_subbuffer_mmap(
 				goto end;
 			}
 			outfd = stream->out_fd;
+			consumer_stream_setup_output_file(stream);
 
 			if (stream->index_file) {
 				lttng_index_file_put(stream->index_file);
-				stream->index_file = lttng_index_file_create(stream->chan->pathname,
+				stream->index_file = lttng_index_file_create(
+						consumer_stream_output_path(stream),
 						stream->name, stream->uid, stream->gid,
 						stream->chan->tracefile_size,
 						stream->tracefile_count_current,
@@ -1648,21 +3028,90 @@ ssize_t lttng_consumer_on_read_subbuffer_mmap(
 			/* Reset current size because we just perform a rotation. */
 			stream->tracefile_size_current = 0;
 			stream->out_fd_offset = 0;
+			stream->batch.prev_len = 0;
 			orig_offset = 0;
 		}
-		stream->tracefile_size_current += len;
+		stream->tracefile_size_current += write_len;
+		/* The index of a compressed packet points to its frame. */
 		if (index) {
 			index->offset = htobe64(stream->out_fd_offset);
 		}
+
+		/* The batch is checked as a whole when flushed. */
+		if (!stream->batch.active &&
+				!direct_io_aligned(stream, stream->out_fd_offset,
+					write_len)) {
+			consumer_stream_clear_direct_io(stream);
+		}
+	}
+
+	if (stream->batch.active) {
+		/* Written by the batch flush at the end of the batched read. */
+		ret = batch_append(stream, buf, write_len);
+		if (ret < 0) {
+			goto end;
+		}
+		ret = len;
+		stream->output_written += write_len;
+		stream->out_fd_offset += write_len;
+		goto end;
+	}
+
+	if (use_io_uring) {
+		/*
+		 * The data is copied by the writer, the sub-buffer can be released
+		 * as soon as the write is queued.
+		 */
+		ret = lttng_io_uring_write(stream->io_uring, outfd, buf,
+				write_len, stream->out_fd_offset);
+		DBG("Consumer mmap io_uring write ret %zd (len %zu)", ret,
+				write_len);
+		if (ret < 0) {
+			ERR("Error in io_uring write mmap (ret %zd, len %zu)", ret,
+					write_len);
+			goto end;
+		}
+		stream->output_written += ret;
+		stream->out_fd_offset += write_len;
+		ret = len;
+		goto end;
 	}
 
 	/*
 	 * This call guarantee that len or less is returned. It's impossible to
 	 * receive a ret value that is bigger than len.
 	 */
-	ret = lttng_write(outfd, mmap_base + mmap_offset, len);
-	DBG("Consumer mmap write() ret %zd (len %lu)", ret, len);
-	if (ret < 0 || ((size_t) ret != len)) {
+	if (relayd) {
+		/*
+		 * Only the packets sent from the ring buffer pages, large enough
+		 * for the page pinning to cost less than the copy, are sent
+		 * without copy.
+		 */
+		if (data_sock && data_sock->zerocopy && !compressed &&
+				!data_flags &&
+				write_len >= DEFAULT_CONSUMERD_ZEROCOPY_MIN_BYTES) {
+			use_zerocopy = 1;
+		}
+		/* The padding of a compressed packet is restored on decompression. */
+		ret = write_relayd_packet(stream, relayd, data_sock, buf,
+				write_len, compressed ? 0 : padding, data_flags,
+				use_zerocopy ? &zerocopy_seq : NULL);
+		if (ret < 0) {
+			use_zerocopy = 0;
+		}
+	} else if (stream->out_fd_direct) {
+		ret = write_direct(stream, buf, write_len);
+	} else if (use_snapshot_splice) {
+		ret = write_snapshot_splice(stream, outfd, buf, write_len);
+	} else if (consumer_data.sparse_padding && !compressed &&
+			!stream->metadata_flag &&
+			padding >= DEFAULT_CONSUMERD_SPARSE_PADDING_MIN_BYTES) {
+		ret = write_sparse_padding(outfd, buf, write_len, padding);
+	} else {
+		ret = lttng_write(outfd, buf, write_len);
+	}
+	DBG("Consumer mmap write() ret %zd (len %zu)", ret, write_len);
+	if (ret < 0 || ((size_t) ret != write_len)) {
 		/*
 		 * Report error to caller if nothing was written else at least send the
 		 * amount written.
@@ -1683,19 +3132,26 @@ ssize_t lttng_consumer_on_read_subbuffer_mmap(
 			DBG("Consumer mmap write detected relayd hang up");
 		} else {
 			/* Unhandled error, print it and stop function right now. */
-			PERROR("Error in write mmap (ret %zd != len %lu)", ret, len);
+			PERROR("Error in write mmap (ret %zd != len %zu)", ret,
+					write_len);
 		}
 		goto write_error;
 	}
 	stream->output_written += ret;
+	ret = len;
 
 	/* This call is useless on a socket so better save a syscall. */
 	if (!relayd) {
-		/* This won't block, but will start writeout asynchronously */
-		lttng_sync_file_range(outfd, stream->out_fd_offset, len,
-				SYNC_FILE_RANGE_WRITE);
-		stream->out_fd_offset += len;
-		lttng_consumer_sync_trace_file(stream, orig_offset);
+		/* Direct I/O bypasses the page cache, nothing to write back. */
+		if (!stream->out_fd_direct &&
+				consumer_writeback_queue(stream,
+					stream->out_fd_offset, write_len)) {
+			/* This won't block, but will start writeout asynchronously */
+			lttng_sync_file_range(outfd, stream->out_fd_offset,
+					write_len, SYNC_FILE_RANGE_WRITE);
+			lttng_consumer_sync_trace_file(stream, orig_offset);
+		}
+		stream->out_fd_offset += write_len;
 	}
 
 write_error:
@@ -1712,6 +3168,13 @@ end:
 	if (relayd && stream->metadata_flag) {
 		pthread_mutex_unlock(&relayd->ctrl_sock_mutex);
 	}
+	if (data_sock) {
+		pthread_mutex_unlock(&data_sock->lock);
+	}
+	/* The caller releases the sub-buffer once the kernel is done with it. */
+	if (use_zerocopy && !relayd_hang_up) {
+		wait_relayd_zerocopy(data_sock, zerocopy_seq);
+	}
 
 	rcu_read_unlock();
 	return ret;
@@ -1737,8 +3200,12 @@ ssize_t lttng_consumer_on_read_subbuffer_splice(
 	/* Default is on the disk */
 	int outfd = stream->out_fd;
 	struct consumer_relayd_sock_pair *relayd = NULL;
+	struct consumer_relayd_data_sock *data_sock = NULL;
 	int *splice_pipe;
 	unsigned int relayd_hang_up = 0;
+	unsigned int writeback_queued = 0;
+	/* Bytes in the splice pipe of the metadata payload header. */
+	size_t header_len = 0;
 
 	switch (consumer_data.type) {
 	case LTTNG_CONSUMER_KERNEL:
@@ -1762,6 +3229,10 @@ ssize_t lttng_consumer_on_read_subbuffer_splice(
 			written = -ret;
 			goto end;
 		}
+		if (!stream->metadata_flag) {
+			/* A spliced packet is never discarded. */
+			(void) relayd_apply_backpressure(relayd, stream, 0);
+		}
 	}
 	splice_pipe = stream->splice_pipe;
 
@@ -1795,9 +3266,23 @@ ssize_t lttng_consumer_on_read_subbuffer_splice(
 			}
 
 			total_len += sizeof(struct lttcomm_relayd_metadata_payload);
+			header_len = sizeof(struct lttcomm_relayd_metadata_payload);
+		} else {
+			/* Lock the data socket until the whole packet is sent. */
+			data_sock = relayd_stream_data_sock(relayd, stream);
+			pthread_mutex_lock(&data_sock->lock);
+
+			/* A spliced packet is sent after the spooled ones. */
+			ret = consumer_spool_drain(relayd, data_sock);
+			if (ret < 0) {
+				written = ret;
+				relayd_hang_up = 1;
+				goto write_error;
+			}
 		}
 
-		ret = write_relayd_stream_header(stream, total_len, padding, relayd);
+		ret = write_relayd_stream_header(stream, total_len, padding, 0,
+				relayd);
 		if (ret < 0) {
 			written = ret;
 			relayd_hang_up = 1;
@@ -1810,6 +3295,7 @@ ssize_t lttng_consumer_on_read_subbuffer_splice(
 		len += padding;
 
 		if (stream->metadata_flag && stream->reset_metadata_flag) {
+			consumer_writeback_wait(stream);
 			ret = utils_truncate_stream_file(stream->out_fd, 0);
 			if (ret < 0) {
 				ERR("Reset metadata file");
@@ -1823,7 +3309,9 @@ ssize_t lttng_consumer_on_read_subbuffer_splice(
 		if (stream->chan->tracefile_size > 0 &&
 				(stream->tracefile_size_current + len) >
 				stream->chan->tracefile_size) {
-			ret = utils_rotate_stream_file(stream->chan->pathname,
+			consumer_writeback_wait(stream);
+			ret = utils_rotate_stream_file_at(stream->out_dir_fd,
+					consumer_stream_output_path(stream),
 					stream->name, stream->chan->tracefile_size,
 					stream->chan->tracefile_count, stream->uid, stream->gid,
 					stream->out_fd, &(stream->tracefile_count_current),
@@ -1834,10 +3322,12 @@ ssize_t lttng_consumer_on_read_subbuffer_splice(
 				goto end;
 			}
 			outfd = stream->out_fd;
+			consumer_stream_setup_output_file(stream);
 
 			if (stream->index_file) {
 				lttng_index_file_put(stream->index_file);
-				stream->index_file = lttng_index_file_create(stream->chan->pathname,
+				stream->index_file = lttng_index_file_create(
+						consumer_stream_output_path(stream),
 						stream->name, stream->uid, stream->gid,
 						stream->chan->tracefile_size,
 						stream->tracefile_count_current,
@@ -1856,11 +3346,22 @@ ssize_t lttng_consumer_on_read_subbuffer_splice(
 		index->offset = htobe64(stream->out_fd_offset);
 	}
 
+	if (header_len) {
+		/*
+		 * The metadata payload header is already in the pipe, and is not
+		 * accounted in the returned length.
+		 */
+		len += header_len;
+		written -= header_len;
+	}
+
 	while (len > 0) {
+		size_t pipe_len;
+
 		DBG("splice chan to pipe offset %lu of len %lu (fd : %d, pipe: %d)",
 				(unsigned long)offset, len, fd, splice_pipe[1]);
-		ret_splice = splice(fd, &offset, splice_pipe[1], NULL, len,
-				SPLICE_F_MOVE | SPLICE_F_MORE);
+		ret_splice = splice(fd, &offset, splice_pipe[1], NULL,
+				len - header_len, SPLICE_F_MOVE | SPLICE_F_MORE);
 		DBG("splice chan to pipe, ret %zd", ret_splice);
 		if (ret_splice < 0) {
 			ret = errno;
@@ -1868,58 +3369,61 @@ ssize_t lttng_consumer_on_read_subbuffer_splice(
 			PERROR("Error in relay splice");
 			goto splice_error;
 		}
+		pipe_len = ret_splice + header_len;
+		header_len = 0;
 
-		/* Handle stream on the relayd if the output is on the network */
-		if (relayd && stream->metadata_flag) {
-			size_t metadata_payload_size =
-				sizeof(struct lttcomm_relayd_metadata_payload);
-
-			/* Update counter to fit the spliced data */
-			ret_splice += metadata_payload_size;
-			len += metadata_payload_size;
-			/*
-			 * We do this so the return value can match the len passed as
-			 * argument to this function.
-			 */
-			written -= metadata_payload_size;
-		}
-
-		/* Splice data out */
-		ret_splice = splice(splice_pipe[0], NULL, outfd, NULL,
-				ret_splice, SPLICE_F_MOVE | SPLICE_F_MORE);
-		DBG("Consumer splice pipe to file (out_fd: %d), ret %zd",
-				outfd, ret_splice);
-		if (ret_splice < 0) {
-			ret = errno;
-			written = -ret;
-			relayd_hang_up = 1;
-			goto write_error;
-		} else if (ret_splice > len) {
-			/*
-			 * We don't expect this code path to be executed but you never know
-			 * so this is an extra protection agains a buggy splice().
-			 */
-			ret = errno;
-			written += ret_splice;
-			PERROR("Wrote more data than requested %zd (len: %lu)", ret_splice,
-					len);
-			goto splice_error;
-		} else {
+		/*
+		 * Drain the pipe before filling it again: a socket may take
+		 * less than the pipe holds. The pipe holds a whole sub-buffer,
+		 * so a packet normally goes through in one step.
+		 */
+		while (pipe_len > 0) {
+			ret_splice = splice(splice_pipe[0], NULL, outfd, NULL,
+					pipe_len, SPLICE_F_MOVE | SPLICE_F_MORE);
+			DBG("Consumer splice pipe to file (out_fd: %d), ret %zd",
+					outfd, ret_splice);
+			if (ret_splice < 0) {
+				ret = errno;
+				written = -ret;
+				relayd_hang_up = 1;
+				goto write_error;
+			} else if (ret_splice > pipe_len) {
+				/*
+				 * We don't expect this code path to be executed but you
+				 * never know so this is an extra protection agains a
+				 * buggy splice().
+				 */
+				ret = errno;
+				written += ret_splice;
+				PERROR("Wrote more data than requested %zd (len: %zu)",
+						ret_splice, pipe_len);
+				goto splice_error;
+			}
 			/* All good, update current len and continue. */
+			pipe_len -= ret_splice;
 			len -= ret_splice;
-		}
 
-		/* This call is useless on a socket so better save a syscall. */
-		if (!relayd) {
-			/* This won't block, but will start writeout asynchronously */
-			lttng_sync_file_range(outfd, stream->out_fd_offset, ret_splice,
-					SYNC_FILE_RANGE_WRITE);
-			stream->out_fd_offset += ret_splice;
+			/* This call is useless on a socket so better save a syscall. */
+			if (!relayd) {
+				if (consumer_writeback_queue(stream,
+						stream->out_fd_offset, ret_splice)) {
+					/*
+					 * This won't block, but will start writeout
+					 * asynchronously.
+					 */
+					lttng_sync_file_range(outfd,
+							stream->out_fd_offset, ret_splice,
+							SYNC_FILE_RANGE_WRITE);
+				} else {
+					writeback_queued = 1;
+				}
+				stream->out_fd_offset += ret_splice;
+			}
+			stream->output_written += ret_splice;
+			written += ret_splice;
 		}
-		stream->output_written += ret_splice;
-		written += ret_splice;
 	}
-	if (!relayd) {
+	if (!relayd && !writeback_queued) {
 		lttng_consumer_sync_trace_file(stream, orig_offset);
 	}
 	goto end;
@@ -1935,68 +3439,328 @@ write_error:
 		goto end;
 	}
 
-splice_error:
-	/* send the appropriate error description to sessiond */
-	switch (ret) {
-	case EINVAL:
-		lttng_consumer_send_error(ctx, LTTCOMM_CONSUMERD_SPLICE_EINVAL);
-		break;
-	case ENOMEM:
-		lttng_consumer_send_error(ctx, LTTCOMM_CONSUMERD_SPLICE_ENOMEM);
-		break;
-	case ESPIPE:
-		lttng_consumer_send_error(ctx, LTTCOMM_CONSUMERD_SPLICE_ESPIPE);
-		break;
+splice_error:
+	/* send the appropriate error description to sessiond */
+	switch (ret) {
+	case EINVAL:
+		lttng_consumer_send_error(ctx, LTTCOMM_CONSUMERD_SPLICE_EINVAL);
+		break;
+	case ENOMEM:
+		lttng_consumer_send_error(ctx, LTTCOMM_CONSUMERD_SPLICE_ENOMEM);
+		break;
+	case ESPIPE:
+		lttng_consumer_send_error(ctx, LTTCOMM_CONSUMERD_SPLICE_ESPIPE);
+		break;
+	}
+
+end:
+	if (relayd && stream->metadata_flag) {
+		pthread_mutex_unlock(&relayd->ctrl_sock_mutex);
+	}
+	if (data_sock) {
+		pthread_mutex_unlock(&data_sock->lock);
+	}
+
+	rcu_read_unlock();
+	return written;
+}
+
+/*
+ * Take a snapshot for a specific fd
+ *
+ * Returns 0 on success, < 0 on error
+ */
+int lttng_consumer_take_snapshot(struct lttng_consumer_stream *stream)
+{
+	switch (consumer_data.type) {
+	case LTTNG_CONSUMER_KERNEL:
+		return lttng_kconsumer_take_snapshot(stream);
+	case LTTNG_CONSUMER32_UST:
+	case LTTNG_CONSUMER64_UST:
+		return lttng_ustconsumer_take_snapshot(stream);
+	default:
+		ERR("Unknown consumer_data type");
+		assert(0);
+		return -ENOSYS;
+	}
+}
+
+/*
+ * Get the produced position
+ *
+ * Returns 0 on success, < 0 on error
+ */
+int lttng_consumer_get_produced_snapshot(struct lttng_consumer_stream *stream,
+		unsigned long *pos)
+{
+	switch (consumer_data.type) {
+	case LTTNG_CONSUMER_KERNEL:
+		return lttng_kconsumer_get_produced_snapshot(stream, pos);
+	case LTTNG_CONSUMER32_UST:
+	case LTTNG_CONSUMER64_UST:
+		return lttng_ustconsumer_get_produced_snapshot(stream, pos);
+	default:
+		ERR("Unknown consumer_data type");
+		assert(0);
+		return -ENOSYS;
+	}
+}
+
+/*
+ * Send the consumption statistics of the streams of a channel on the sessiond
+ * socket: the number of streams (uint64_t, 0 if the channel is unknown)
+ * followed by one struct lttcomm_consumer_stream_stats per stream.
+ *
+ * Returns 0 on success, < 0 on error
+ */
+int lttng_consumer_send_stream_stats(int sock, uint64_t channel_key)
+{
+	int ret;
+	ssize_t size;
+	uint64_t nr_stats = 0;
+	size_t alloc_stats = 0;
+	struct lttng_ht_iter iter;
+	struct lttng_consumer_stream *stream;
+	struct lttcomm_consumer_stream_stats *stats = NULL;
+	struct lttng_ht *ht = consumer_data.stream_per_chan_id_ht;
+	int (*sample)(struct lttng_consumer_stream *);
+	int (*get_consumed)(struct lttng_consumer_stream *, unsigned long *);
+	int (*get_produced)(struct lttng_consumer_stream *, unsigned long *);
+
+	switch (consumer_data.type) {
+	case LTTNG_CONSUMER_KERNEL:
+		sample = lttng_kconsumer_sample_snapshot_positions;
+		get_consumed = lttng_kconsumer_get_consumed_snapshot;
+		get_produced = lttng_kconsumer_get_produced_snapshot;
+		break;
+	case LTTNG_CONSUMER32_UST:
+	case LTTNG_CONSUMER64_UST:
+		sample = lttng_ustconsumer_sample_snapshot_positions;
+		get_consumed = lttng_ustconsumer_get_consumed_snapshot;
+		get_produced = lttng_ustconsumer_get_produced_snapshot;
+		break;
+	default:
+		ERR("Unknown consumer_data type");
+		abort();
+	}
+
+	rcu_read_lock();
+	cds_lfht_for_each_entry_duplicate(ht->ht,
+			ht->hash_fct(&channel_key, lttng_ht_seed),
+			ht->match_fct, &channel_key,
+			&iter.iter, stream, node_channel_id.node) {
+		struct lttcomm_consumer_stream_stats *stream_stats;
+		unsigned long produced, consumed;
+		unsigned int i;
+
+		if (nr_stats == alloc_stats) {
+			struct lttcomm_consumer_stream_stats *new_stats;
+			size_t new_alloc = max_t(size_t, alloc_stats << 1, 16);
+
+			new_stats = realloc(stats, new_alloc * sizeof(*stats));
+			if (!new_stats) {
+				PERROR("realloc stream stats");
+				rcu_read_unlock();
+				ret = -ENOMEM;
+				goto end;
+			}
+			stats = new_stats;
+			alloc_stats = new_alloc;
+		}
+
+		pthread_mutex_lock(&stream->lock);
+		if (cds_lfht_is_node_deleted(&stream->node.node)) {
+			pthread_mutex_unlock(&stream->lock);
+			continue;
+		}
+
+		stream_stats = &stats[nr_stats++];
+		memset(stream_stats, 0, sizeof(*stream_stats));
+		stream_stats->cpu = stream->cpu;
+		stream_stats->bytes_consumed = stream->stats.bytes_consumed;
+		stream_stats->subbufs_consumed = stream->stats.subbufs_consumed;
+		for (i = 0; i < LTTNG_STREAM_STATS_LATENCY_BUCKETS; i++) {
+			stream_stats->write_latency_hist[i] =
+					stream->stats.write_latency_hist[i];
+		}
+		stream_stats->wakeup_delay_total =
+				stream->stats.wakeup_delay_total;
+		stream_stats->wakeup_delay_max = stream->stats.wakeup_delay_max;
+		/* The lag is only reported if the positions can be sampled. */
+		if (!sample(stream) && !get_consumed(stream, &consumed) &&
+				!get_produced(stream, &produced)) {
+			stream_stats->lag_bytes = produced - consumed;
+		}
+		pthread_mutex_unlock(&stream->lock);
+	}
+	rcu_read_unlock();
+
+	DBG("Sending the statistics of %" PRIu64 " stream(s) of channel %" PRIu64,
+			nr_stats, channel_key);
+
+	size = lttcomm_send_unix_sock(sock, &nr_stats, sizeof(nr_stats));
+	if (size < 0) {
+		ret = -1;
+		goto end;
+	}
+	if (nr_stats) {
+		size = lttcomm_send_unix_sock(sock, stats,
+				nr_stats * sizeof(*stats));
+		if (size < 0) {
+			ret = -1;
+			goto end;
+		}
+	}
+	ret = 0;
+end:
+	free(stats);
+	return ret;
+}
+
+/*
+ * Send the runtime statistics of the data channels of a session on the sessiond
+ * socket, gathered in one pass over the channels: the number of channels
+ * (uint64_t) followed by one struct lttcomm_consumer_channel_stats per channel.
+ *
+ * Returns 0 on success, < 0 on error
+ */
+int lttng_consumer_send_channel_stats(int sock, uint64_t session_id)
+{
+	int ret;
+	ssize_t size;
+	uint64_t nr_stats = 0;
+	size_t alloc_stats = 0;
+	struct lttng_ht_iter iter;
+	struct lttng_consumer_channel *channel;
+	struct lttcomm_consumer_channel_stats *stats = NULL;
+
+	rcu_read_lock();
+	cds_lfht_for_each_entry(consumer_data.channel_ht->ht, &iter.iter,
+			channel, node.node) {
+		struct lttcomm_consumer_channel_stats *channel_stats;
+
+		if (channel->session_id != session_id ||
+				channel->type != CONSUMER_CHANNEL_TYPE_DATA) {
+			continue;
+		}
+
+		if (nr_stats == alloc_stats) {
+			struct lttcomm_consumer_channel_stats *new_stats;
+			size_t new_alloc = max_t(size_t, alloc_stats << 1, 16);
+
+			new_stats = realloc(stats, new_alloc * sizeof(*stats));
+			if (!new_stats) {
+				PERROR("realloc channel stats");
+				rcu_read_unlock();
+				ret = -ENOMEM;
+				goto end;
+			}
+			stats = new_stats;
+			alloc_stats = new_alloc;
+		}
+
+		channel_stats = &stats[nr_stats++];
+		channel_stats->key = channel->key;
+		channel_stats->discarded_events = channel->discarded_events;
+		channel_stats->lost_packets = channel->lost_packets;
 	}
+	rcu_read_unlock();
 
-end:
-	if (relayd && stream->metadata_flag) {
-		pthread_mutex_unlock(&relayd->ctrl_sock_mutex);
-	}
+	DBG("Sending the statistics of %" PRIu64 " channel(s) of session %" PRIu64,
+			nr_stats, session_id);
 
-	rcu_read_unlock();
-	return written;
+	size = lttcomm_send_unix_sock(sock, &nr_stats, sizeof(nr_stats));
+	if (size < 0) {
+		ret = -1;
+		goto end;
+	}
+	if (nr_stats) {
+		size = lttcomm_send_unix_sock(sock, stats,
+				nr_stats * sizeof(*stats));
+		if (size < 0) {
+			ret = -1;
+			goto end;
+		}
+	}
+	ret = 0;
+end:
+	free(stats);
+	return ret;
 }
 
 /*
- * Take a snapshot for a specific fd
- *
- * Returns 0 on success, < 0 on error
+ * Stop or resume the consumption of the streams of the channels of priority 0.
+ * The data threads shed the streams as they become ready; on resume, they are
+ * woken up to put them back in their poll sets.
  */
-int lttng_consumer_take_snapshot(struct lttng_consumer_stream *stream)
+void consumer_set_overload_shedding(struct lttng_consumer_local_data *ctx,
+		bool enable)
 {
-	switch (consumer_data.type) {
-	case LTTNG_CONSUMER_KERNEL:
-		return lttng_kconsumer_take_snapshot(stream);
-	case LTTNG_CONSUMER32_UST:
-	case LTTNG_CONSUMER64_UST:
-		return lttng_ustconsumer_take_snapshot(stream);
-	default:
-		ERR("Unknown consumer_data type");
-		assert(0);
-		return -ENOSYS;
+	unsigned int i;
+
+	if (CMM_LOAD_SHARED(consumer_data.overload_shedding) == enable) {
+		return;
+	}
+	DBG("Overload shedding of the channels of priority 0 %s",
+			enable ? "started" : "stopped");
+	CMM_STORE_SHARED(consumer_data.overload_shedding, enable);
+	if (enable) {
+		return;
+	}
+
+	for (i = 0; i < ctx->nr_data_shards; i++) {
+		ssize_t writelen;
+
+		writelen = lttng_pipe_write(ctx->data_shards[i].wakeup_pipe,
+				"!", 1);
+		if (writelen < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+			PERROR("Wake up data shard %u at the end of the overload shedding",
+					i);
+		}
 	}
 }
 
 /*
- * Get the produced position
+ * Set the usage thresholds filtering the monitoring samples of a channel. The
+ * next sample of the channel is sent regardless of them.
  *
- * Returns 0 on success, < 0 on error
+ * Returns 0 on success or an lttcomm_return_code on error.
  */
-int lttng_consumer_get_produced_snapshot(struct lttng_consumer_stream *stream,
-		unsigned long *pos)
+int consumer_set_channel_monitor_filter(uint64_t key, bool forward_all,
+		const uint64_t *thresholds, uint32_t nr_thresholds)
 {
-	switch (consumer_data.type) {
-	case LTTNG_CONSUMER_KERNEL:
-		return lttng_kconsumer_get_produced_snapshot(stream, pos);
-	case LTTNG_CONSUMER32_UST:
-	case LTTNG_CONSUMER64_UST:
-		return lttng_ustconsumer_get_produced_snapshot(stream, pos);
-	default:
-		ERR("Unknown consumer_data type");
-		assert(0);
-		return -ENOSYS;
+	int ret;
+	struct lttng_consumer_channel *channel;
+
+	if (nr_thresholds > LTTCOMM_CONSUMER_MONITOR_THRESHOLDS_MAX) {
+		ret = LTTCOMM_CONSUMERD_ERROR_RECV_CMD;
+		goto end;
 	}
+
+	rcu_read_lock();
+	channel = consumer_find_channel(key);
+	if (!channel) {
+		DBG("Channel %" PRIu64 " of the monitor filter not found", key);
+		ret = LTTCOMM_CONSUMERD_CHAN_NOT_FOUND;
+		goto end_unlock;
+	}
+
+	pthread_mutex_lock(&channel->monitor_filter.lock);
+	channel->monitor_filter.enabled = true;
+	channel->monitor_filter.forward_all = forward_all;
+	channel->monitor_filter.nr_thresholds = nr_thresholds;
+	memcpy(channel->monitor_filter.thresholds, thresholds,
+			nr_thresholds * sizeof(*thresholds));
+	channel->monitor_filter.reset = true;
+	pthread_mutex_unlock(&channel->monitor_filter.lock);
+
+	DBG("Channel %" PRIu64 " monitor filter set: %" PRIu32 " thresholds%s",
+			key, nr_thresholds, forward_all ? ", forward all" : "");
+	ret = 0;
+end_unlock:
+	rcu_read_unlock();
+end:
+	return ret;
 }
 
 int lttng_consumer_recv_cmd(struct lttng_consumer_local_data *ctx,
@@ -2058,7 +3822,6 @@ void consumer_del_metadata_stream(struct lttng_consumer_stream *stream,
 
 	DBG3("Consumer delete metadata stream %d", stream->wait_fd);
 
-	pthread_mutex_lock(&consumer_data.lock);
 	pthread_mutex_lock(&stream->chan->lock);
 	pthread_mutex_lock(&stream->lock);
 	if (stream->chan->metadata_cache) {
@@ -2093,7 +3856,6 @@ void consumer_del_metadata_stream(struct lttng_consumer_stream *stream,
 	}
 	pthread_mutex_unlock(&stream->lock);
 	pthread_mutex_unlock(&stream->chan->lock);
-	pthread_mutex_unlock(&consumer_data.lock);
 
 	if (free_chan) {
 		consumer_del_channel(free_chan);
@@ -2105,8 +3867,12 @@ void consumer_del_metadata_stream(struct lttng_consumer_stream *stream,
 /*
  * Action done with the metadata stream when adding it to the consumer internal
  * data structures to handle it.
+ *
+ * The stream is assigned to a metadata shard according to its key. Once this
+ * returns, the stream must be sent to the metadata pipe of that shard.
  */
-int consumer_add_metadata_stream(struct lttng_consumer_stream *stream)
+int consumer_add_metadata_stream(struct lttng_consumer_stream *stream,
+		struct lttng_consumer_local_data *ctx)
 {
 	struct lttng_ht *ht = metadata_ht;
 	int ret = 0;
@@ -2114,11 +3880,12 @@ int consumer_add_metadata_stream(struct lttng_consumer_stream *stream)
 	struct lttng_ht_node_u64 *node;
 
 	assert(stream);
+	assert(ctx);
+	assert(ctx->nr_metadata_shards > 0);
 	assert(ht);
 
 	DBG3("Adding metadata stream %" PRIu64 " to hash table", stream->key);
 
-	pthread_mutex_lock(&consumer_data.lock);
 	pthread_mutex_lock(&stream->chan->lock);
 	pthread_mutex_lock(&stream->chan->timer_lock);
 	pthread_mutex_lock(&stream->lock);
@@ -2163,52 +3930,148 @@ int consumer_add_metadata_stream(struct lttng_consumer_stream *stream)
 	 */
 	lttng_ht_add_u64(consumer_data.stream_list_ht, &stream->node_session_id);
 
+	stream->metadata_shard = &ctx->metadata_shards[stream->key %
+			ctx->nr_metadata_shards];
+	DBG3("Adding metadata stream %" PRIu64 " to metadata shard %u",
+			stream->key, stream->metadata_shard->id);
+
 	rcu_read_unlock();
 
 	pthread_mutex_unlock(&stream->lock);
 	pthread_mutex_unlock(&stream->chan->lock);
 	pthread_mutex_unlock(&stream->chan->timer_lock);
-	pthread_mutex_unlock(&consumer_data.lock);
 	return ret;
 }
 
 /*
- * Delete data stream that are flagged for deletion (endpoint_status).
+ * Remove a data stream from the poll set of its shard's thread and delete it.
+ * Must only be called by the thread owning the stream's data shard.
+ */
+static void data_poll_del_stream(struct lttng_poll_event *events,
+		struct lttng_consumer_stream *stream, unsigned int *nb_streams)
+{
+	assert(*nb_streams > 0);
+
+	/* A shed stream is already out of the poll set. */
+	if (!stream->shed) {
+		lttng_poll_del(events, stream->wait_fd);
+	}
+	cds_list_del_init(&stream->has_data_node);
+	(*nb_streams)--;
+	consumer_del_stream(stream, data_ht);
+}
+
+/*
+ * Queue a data stream that still has data to be read after a call to
+ * on_buffer_ready() so that it gets consumed on the next pass even if its
+ * wait fd is not reported by the poll set.
+ */
+static void data_poll_queue_has_data(struct cds_list_head *has_data_list,
+		struct lttng_consumer_stream *stream)
+{
+	cds_list_del_init(&stream->has_data_node);
+	if (stream->has_data) {
+		cds_list_add_tail(&stream->has_data_node, has_data_list);
+	}
+}
+
+/*
+ * Delete data stream of the given shard that are flagged for deletion
+ * (endpoint_status).
  */
-static void validate_endpoint_status_data_stream(void)
+static void validate_endpoint_status_data_stream(
+		struct lttng_consumer_data_shard *shard,
+		struct lttng_poll_event *events, unsigned int *nb_streams)
 {
 	struct lttng_ht_iter iter;
 	struct lttng_consumer_stream *stream;
 
-	DBG("Consumer delete flagged data stream");
+	DBG("Consumer delete flagged data stream of data shard %u", shard->id);
+
+	assert(events);
 
 	rcu_read_lock();
 	cds_lfht_for_each_entry(data_ht->ht, &iter.iter, stream, node.node) {
+		/* Only the shard's thread may delete its streams. */
+		if (stream->data_shard != shard) {
+			continue;
+		}
 		/* Validate delete flag of the stream */
 		if (stream->endpoint_status == CONSUMER_ENDPOINT_ACTIVE) {
 			continue;
 		}
-		/* Delete it right now */
-		consumer_del_stream(stream, data_ht);
+		/*
+		 * Remove from the poll set and delete it right now so the data
+		 * thread can continue without blocking on a deleted stream.
+		 */
+		data_poll_del_stream(events, stream, nb_streams);
 	}
 	rcu_read_unlock();
 }
 
 /*
- * Delete metadata stream that are flagged for deletion (endpoint_status).
+ * Add the data streams handed over to a shard to the poll set of its thread,
+ * all at once.
+ */
+static void data_poll_add_new_streams(struct lttng_consumer_data_shard *shard,
+		struct lttng_poll_event *events, unsigned int *nb_streams)
+{
+	int ret;
+	struct cds_wfcq_node *node;
+
+	/* The shard's thread is the only dequeuer. */
+	while ((node = __cds_wfcq_dequeue_blocking(&shard->new_streams.head,
+			&shard->new_streams.tail))) {
+		struct lttng_consumer_stream *stream = caa_container_of(node,
+				struct lttng_consumer_stream, handover_node);
+
+		/*
+		 * Only active streams with an active end point can be added to
+		 * the poll set. A stream with an inactive end point would be
+		 * deleted by the next end point validation so do it right away.
+		 */
+		if (uatomic_read(&stream->endpoint_status) ==
+				CONSUMER_ENDPOINT_INACTIVE) {
+			consumer_del_stream(stream, data_ht);
+			continue;
+		}
+
+		DBG("Adding data stream %d to poll set of data shard %u",
+				stream->wait_fd, shard->id);
+		ret = lttng_poll_add(events, stream->wait_fd,
+				LPOLLIN | LPOLLPRI);
+		if (ret < 0) {
+			ERR("Failed to add data stream %" PRIu64 " to poll set",
+					stream->key);
+			consumer_del_stream(stream, data_ht);
+			continue;
+		}
+		(*nb_streams)++;
+	}
+}
+
+/*
+ * Delete metadata stream of the given shard that are flagged for deletion
+ * (endpoint_status).
  */
 static void validate_endpoint_status_metadata_stream(
+		struct lttng_consumer_metadata_shard *shard,
 		struct lttng_poll_event *pollset)
 {
 	struct lttng_ht_iter iter;
 	struct lttng_consumer_stream *stream;
 
-	DBG("Consumer delete flagged metadata stream");
+	DBG("Consumer delete flagged metadata stream of metadata shard %u",
+			shard->id);
 
 	assert(pollset);
 
 	rcu_read_lock();
 	cds_lfht_for_each_entry(metadata_ht->ht, &iter.iter, stream, node.node) {
+		/* Only the shard's thread may delete its streams. */
+		if (stream->metadata_shard != shard) {
+			continue;
+		}
 		/* Validate delete flag of the stream */
 		if (stream->endpoint_status == CONSUMER_ENDPOINT_ACTIVE) {
 			continue;
@@ -2226,8 +4089,11 @@ static void validate_endpoint_status_metadata_stream(
 }
 
 /*
- * Thread polls on metadata file descriptor and write them on disk or on the
- * network.
+ * Thread polls on the metadata file descriptors of the streams of a metadata
+ * shard and write them on disk or on the network.
+ *
+ * The data argument is the metadata shard (struct
+ * lttng_consumer_metadata_shard) owned by the thread.
  */
 void *consumer_thread_metadata_poll(void *data)
 {
@@ -2237,12 +4103,16 @@ void *consumer_thread_metadata_poll(void *data)
 	struct lttng_ht_iter iter;
 	struct lttng_ht_node_u64 *node;
 	struct lttng_poll_event events;
-	struct lttng_consumer_local_data *ctx = data;
+	struct lttng_consumer_metadata_shard *shard = data;
+	struct lttng_consumer_local_data *ctx = shard->ctx;
+	struct lttng_pipe *metadata_pipe = shard->metadata_pipe;
 	ssize_t len;
 
 	rcu_register_thread();
+	lttng_ht_thread_batch_start();
 
 	health_register(health_consumerd, HEALTH_CONSUMERD_TYPE_METADATA);
+	consumer_sched_apply(HEALTH_CONSUMERD_TYPE_METADATA);
 
 	if (testpoint(consumerd_thread_metadata)) {
 		goto error_testpoint;
@@ -2250,7 +4120,7 @@ void *consumer_thread_metadata_poll(void *data)
 
 	health_code_update();
 
-	DBG("Thread metadata poll started");
+	DBG("Thread metadata poll of metadata shard %u started", shard->id);
 
 	/* Size is set to 1 for the consumer_metadata pipe */
 	ret = lttng_poll_create(&events, 2, LTTNG_CLOEXEC);
@@ -2260,7 +4130,7 @@ void *consumer_thread_metadata_poll(void *data)
 	}
 
 	ret = lttng_poll_add(&events,
-			lttng_pipe_get_readfd(ctx->consumer_metadata_pipe), LPOLLIN);
+			lttng_pipe_get_readfd(metadata_pipe), LPOLLIN);
 	if (ret < 0) {
 		goto end;
 	}
@@ -2271,6 +4141,8 @@ void *consumer_thread_metadata_poll(void *data)
 	while (1) {
 restart:
 		health_code_update();
+		/* Release the streams freed since the last wait at once. */
+		lttng_ht_thread_batch_flush();
 		health_poll_entry();
 		DBG("Metadata poll wait");
 		ret = lttng_poll_wait(&events, -1);
@@ -2303,11 +4175,11 @@ restart:
 				continue;
 			}
 
-			if (pollfd == lttng_pipe_get_readfd(ctx->consumer_metadata_pipe)) {
+			if (pollfd == lttng_pipe_get_readfd(metadata_pipe)) {
 				if (revents & LPOLLIN) {
 					ssize_t pipe_len;
 
-					pipe_len = lttng_pipe_read(ctx->consumer_metadata_pipe,
+					pipe_len = lttng_pipe_read(metadata_pipe,
 							&stream, sizeof(stream));
 					if (pipe_len < sizeof(stream)) {
 						if (pipe_len < 0) {
@@ -2318,15 +4190,16 @@ restart:
 						 * since their might be data to consume.
 						 */
 						lttng_poll_del(&events,
-								lttng_pipe_get_readfd(ctx->consumer_metadata_pipe));
-						lttng_pipe_read_close(ctx->consumer_metadata_pipe);
+								lttng_pipe_get_readfd(metadata_pipe));
+						lttng_pipe_read_close(metadata_pipe);
 						continue;
 					}
 
 					/* A NULL stream means that the state has changed. */
 					if (stream == NULL) {
 						/* Check for deleted streams. */
-						validate_endpoint_status_metadata_stream(&events);
+						validate_endpoint_status_metadata_stream(shard,
+								&events);
 						goto restart;
 					}
 
@@ -2343,8 +4216,8 @@ restart:
 					 * since their might be data to consume.
 					 */
 					lttng_poll_del(&events,
-							lttng_pipe_get_readfd(ctx->consumer_metadata_pipe));
-					lttng_pipe_read_close(ctx->consumer_metadata_pipe);
+							lttng_pipe_get_readfd(metadata_pipe));
+					lttng_pipe_read_close(metadata_pipe);
 					continue;
 				} else {
 					ERR("Unexpected poll events %u for sock %d", revents, pollfd);
@@ -2356,11 +4229,8 @@ restart:
 			}
 
 			rcu_read_lock();
-			{
-				uint64_t tmp_id = (uint64_t) pollfd;
-
-				lttng_ht_lookup(metadata_ht, &tmp_id, &iter);
-			}
+			lttng_ht_lookup_fast_u64(metadata_ht, (uint64_t) pollfd,
+					&iter);
 			node = lttng_ht_iter_get_node_u64(&iter);
 			assert(node);
 
@@ -2381,8 +4251,13 @@ restart:
 					 * a negative len, it means an error occurred thus we
 					 * simply remove it from the poll set and free the
 					 * stream.
+					 *
+					 * A kernel metadata stream is drained by a single
+					 * read, the poll set reports it again if the
+					 * tracer outputs more metadata meanwhile.
 					 */
-				} while (len > 0);
+				} while (len > 0 &&
+						consumer_data.type != LTTNG_CONSUMER_KERNEL);
 
 				/* It's ok to have an unavailable sub-buffer */
 				if (len < 0 && len != -EAGAIN && len != -ENODATA) {
@@ -2441,28 +4316,272 @@ error_testpoint:
 		ERR("Health error occurred in %s", __func__);
 	}
 	health_unregister(health_consumerd);
+	lttng_ht_thread_batch_stop();
 	rcu_unregister_thread();
 	return NULL;
 }
 
 /*
- * This thread polls the fds in the set to consume the data and write
- * it to tracefile if necessary.
+ * Adaptive wakeup batching of a data thread.
+ *
+ * Under load, a data thread is woken up by every sub-buffer switch of every
+ * stream it polls. When it is woken up more than once per batching period on
+ * average over a window, it switches to timed polling: it sleeps for a period
+ * before each non-blocking poll so that all the streams that became ready
+ * meanwhile are consumed on a single wakeup. It goes back to blocking on the
+ * wait fds as soon as a poll finds nothing ready. The latency added to the
+ * consumption is bounded by the period.
+ */
+struct data_poll_batching {
+	int active;
+	uint64_t window_start;
+	unsigned int window_wakeups;
+};
+
+/*
+ * Return the timeout of the next poll of a data thread, sleeping for the
+ * batching period first if batching is active.
+ */
+static int data_poll_batching_timeout(struct data_poll_batching *batching)
+{
+	if (!batching->active) {
+		return -1;
+	}
+	(void) usleep(consumer_data.wakeup_batch_period_us);
+	return 0;
+}
+
+/*
+ * Account a wakeup of a data thread and start batching the next ones if the
+ * wakeups of the last window are too frequent.
+ */
+static void data_poll_batching_wakeup(struct data_poll_batching *batching,
+		uint64_t now)
+{
+	uint64_t period_ns = (uint64_t) consumer_data.wakeup_batch_period_us *
+			NSEC_PER_USEC;
+	uint64_t window_ns = period_ns * DEFAULT_CONSUMERD_WAKEUP_BATCH_WINDOW;
+
+	if (!window_ns || batching->active) {
+		return;
+	}
+
+	if (!batching->window_start) {
+		batching->window_start = now;
+	}
+	batching->window_wakeups++;
+	if (now - batching->window_start < window_ns) {
+		return;
+	}
+
+	/* More than one wakeup per period on average. */
+	if (batching->window_wakeups * period_ns >
+			now - batching->window_start) {
+		DBG("Data thread woken up %u times in %" PRIu64 " usec, batching wakeups",
+				batching->window_wakeups,
+				(uint64_t) ((now - batching->window_start) /
+						NSEC_PER_USEC));
+		batching->active = 1;
+	}
+	batching->window_start = now;
+	batching->window_wakeups = 0;
+}
+
+/*
+ * Go back to blocking on the wait fds once a timed poll finds nothing ready.
+ */
+static void data_poll_batching_idle(struct data_poll_batching *batching)
+{
+	DBG("Data thread idle, back to wakeups on the wait fds");
+	batching->active = 0;
+	batching->window_start = 0;
+	batching->window_wakeups = 0;
+}
+
+/*
+ * Return 1 if the consumption of a data stream is shed: while the session
+ * daemon reports the overload of a channel of higher priority, the streams
+ * of the channels of priority 0 are left unconsumed.
+ */
+static int data_poll_stream_is_shed(struct lttng_consumer_stream *stream)
+{
+	return CMM_LOAD_SHARED(consumer_data.overload_shedding) &&
+			!CMM_LOAD_SHARED(consumer_quit) &&
+			consumer_priority_enabled() && !stream->chan->priority;
+}
+
+/*
+ * Remove a shed stream from the poll set, so that its wait fd does not keep
+ * waking the thread up, and park it on the shed list.
+ */
+static void data_poll_shed_stream(struct lttng_poll_event *events,
+		struct lttng_consumer_stream *stream,
+		struct cds_list_head *shed_list)
+{
+	DBG("Shedding the consumption of data stream %" PRIu64, stream->key);
+	lttng_poll_del(events, stream->wait_fd);
+	stream->shed = 1;
+	cds_list_del_init(&stream->has_data_node);
+	cds_list_add_tail(&stream->has_data_node, shed_list);
+}
+
+/*
+ * Once the overload shedding is over, put the shed streams back in the poll
+ * set. Their wait fds then report the data left in their buffers.
+ */
+static void data_poll_unshed_streams(struct lttng_poll_event *events,
+		struct cds_list_head *shed_list,
+		struct cds_list_head *has_data_list, unsigned int *nb_streams)
+{
+	int ret;
+	struct lttng_consumer_stream *stream, *tmp_stream;
+
+	if (cds_list_empty(shed_list) ||
+			(CMM_LOAD_SHARED(consumer_data.overload_shedding) &&
+				!CMM_LOAD_SHARED(consumer_quit))) {
+		return;
+	}
+
+	cds_list_for_each_entry_safe(stream, tmp_stream, shed_list,
+			has_data_node) {
+		DBG("Resuming the consumption of data stream %" PRIu64,
+				stream->key);
+		cds_list_del_init(&stream->has_data_node);
+		stream->shed = 0;
+		ret = lttng_poll_add(events, stream->wait_fd,
+				LPOLLIN | LPOLLPRI);
+		if (ret < 0) {
+			ERR("Failed to add data stream %" PRIu64 " back to poll set",
+					stream->key);
+			(*nb_streams)--;
+			consumer_del_stream(stream, data_ht);
+			continue;
+		}
+		data_poll_queue_has_data(has_data_list, stream);
+	}
+}
+
+/*
+ * Consume a ready stream, up to one more sub-buffer per level of priority of
+ * its channel.
+ */
+static ssize_t data_poll_consume(struct lttng_consumer_stream *stream,
+		struct lttng_consumer_local_data *ctx)
+{
+	unsigned int reads = stream->chan->priority + 1;
+	ssize_t len;
+
+	do {
+		len = ctx->on_buffer_ready(stream, ctx);
+		if (len > 0) {
+			stream->data_read = 1;
+		}
+	} while (len > 0 && --reads);
+	return len;
+}
+
+/*
+ * Fill "order" with the indexes of the "nb_fd" entries of "local_stream" by
+ * decreasing priority of their channel, keeping the poll order of the streams
+ * of a same priority.
+ */
+static void data_poll_order_streams(struct lttng_consumer_stream **local_stream,
+		uint32_t nb_fd, uint32_t *order)
+{
+	uint32_t offsets[DEFAULT_CONSUMERD_CHANNEL_PRIORITY_MAX + 2] = { 0 };
+	uint32_t i;
+
+	if (!consumer_priority_enabled()) {
+		for (i = 0; i < nb_fd; i++) {
+			order[i] = i;
+		}
+		return;
+	}
+
+	/* Counting sort on the priorities, highest first. */
+	for (i = 0; i < nb_fd; i++) {
+		unsigned int priority = local_stream[i] ?
+				local_stream[i]->chan->priority : 0;
+
+		offsets[DEFAULT_CONSUMERD_CHANNEL_PRIORITY_MAX - priority + 1]++;
+	}
+	for (i = 1; i < DEFAULT_CONSUMERD_CHANNEL_PRIORITY_MAX + 2; i++) {
+		offsets[i] += offsets[i - 1];
+	}
+	for (i = 0; i < nb_fd; i++) {
+		unsigned int priority = local_stream[i] ?
+				local_stream[i]->chan->priority : 0;
+
+		order[offsets[DEFAULT_CONSUMERD_CHANNEL_PRIORITY_MAX - priority]++] = i;
+	}
+}
+
+/*
+ * This thread polls the fds of the streams of a data shard to consume the
+ * data and write it to tracefile if necessary.
+ *
+ * The data argument is the data shard (struct lttng_consumer_data_shard)
+ * owned by the thread.
+ *
+ * The stream wait fds are kept in a poll set (epoll(7) when available) to
+ * which streams are added one at a time as they are received on the shard's
+ * data pipe and from which they are removed one at a time as they are
+ * deleted. The poll set is never rebuilt.
  */
 void *consumer_thread_data_poll(void *data)
 {
-	int num_rdy, num_hup, high_prio, ret, i, err = -1;
-	struct pollfd *pollfd = NULL;
-	/* local view of the streams */
+	int high_prio, ret, i, err = -1;
+	uint32_t revents, nb_fd, j;
+	unsigned int nb_streams = 0, local_stream_size = 0;
+	struct lttng_poll_event events;
+	/* Local view of the streams of the events returned by the poll set. */
 	struct lttng_consumer_stream **local_stream = NULL, *new_stream = NULL;
-	/* local view of consumer_data.fds_count */
-	int nb_fd = 0;
-	struct lttng_consumer_local_data *ctx = data;
+	struct lttng_consumer_stream *stream, *tmp_stream;
+	/* Consumption order of the entries of local_stream. */
+	uint32_t *local_order = NULL;
+	/*
+	 * Streams which still had data to be read after being consumed and the
+	 * ones which are flagged on the current low priority pass.
+	 */
+	struct cds_list_head has_data_streams, next_has_data_streams;
+	/* Streams removed from the poll set by the overload shedding. */
+	struct cds_list_head shed_streams;
+	struct lttng_consumer_data_shard *shard = data;
+	struct lttng_consumer_local_data *ctx = shard->ctx;
+	struct data_poll_batching batching = { 0 };
 	ssize_t len;
 
 	rcu_register_thread();
+	lttng_ht_thread_batch_start();
+	URCU_TLS(relayd_index_batching) = 1;
 
+	/*
+	 * Every shard thread registers as a data thread; the health of the data
+	 * component is good only if all shards are healthy.
+	 */
 	health_register(health_consumerd, HEALTH_CONSUMERD_TYPE_DATA);
+	DBG("Data poll thread of data shard %u started", shard->id);
+
+	if (shard->numa_node >= 0) {
+		/*
+		 * The staging buffers are allocated lazily by this thread, so
+		 * they are first touched, and thus allocated, on its node.
+		 */
+		ret = consumer_numa_bind_thread(shard->numa_node);
+		if (ret) {
+			WARN("Data shard %u not bound to NUMA node index %d",
+					shard->id, shard->numa_node);
+		} else {
+			DBG("Data shard %u bound to NUMA node index %d",
+					shard->id, shard->numa_node);
+		}
+	}
+	/* An explicit affinity of the data threads overrides the NUMA one. */
+	consumer_sched_apply(HEALTH_CONSUMERD_TYPE_DATA);
+
+	CDS_INIT_LIST_HEAD(&has_data_streams);
+	CDS_INIT_LIST_HEAD(&next_has_data_streams);
+	CDS_INIT_LIST_HEAD(&shed_streams);
 
 	if (testpoint(consumerd_thread_data)) {
 		goto error_testpoint;
@@ -2470,9 +4589,22 @@ void *consumer_thread_data_poll(void *data)
 
 	health_code_update();
 
-	local_stream = zmalloc(sizeof(struct lttng_consumer_stream *));
-	if (local_stream == NULL) {
-		PERROR("local_stream malloc");
+	/* Size is set to 2 for the shard's data and wakeup pipes. */
+	ret = lttng_poll_create(&events, 2, LTTNG_CLOEXEC);
+	if (ret < 0) {
+		ERR("Poll set creation failed");
+		goto end_poll;
+	}
+
+	ret = lttng_poll_add(&events, lttng_pipe_get_readfd(shard->data_pipe),
+			LPOLLIN | LPOLLPRI);
+	if (ret < 0) {
+		goto end;
+	}
+
+	ret = lttng_poll_add(&events, lttng_pipe_get_readfd(shard->wakeup_pipe),
+			LPOLLIN | LPOLLPRI);
+	if (ret < 0) {
 		goto end;
 	}
 
@@ -2480,67 +4612,31 @@ void *consumer_thread_data_poll(void *data)
 		health_code_update();
 
 		high_prio = 0;
-		num_hup = 0;
-
-		/*
-		 * the fds set has been updated, we need to update our
-		 * local array as well
-		 */
-		pthread_mutex_lock(&consumer_data.lock);
-		if (consumer_data.need_update) {
-			free(pollfd);
-			pollfd = NULL;
-
-			free(local_stream);
-			local_stream = NULL;
-
-			/*
-			 * Allocate for all fds +1 for the consumer_data_pipe and +1 for
-			 * wake up pipe.
-			 */
-			pollfd = zmalloc((consumer_data.stream_count + 2) * sizeof(struct pollfd));
-			if (pollfd == NULL) {
-				PERROR("pollfd malloc");
-				pthread_mutex_unlock(&consumer_data.lock);
-				goto end;
-			}
 
-			local_stream = zmalloc((consumer_data.stream_count + 2) *
-					sizeof(struct lttng_consumer_stream *));
-			if (local_stream == NULL) {
-				PERROR("local_stream malloc");
-				pthread_mutex_unlock(&consumer_data.lock);
-				goto end;
-			}
-			ret = update_poll_array(ctx, &pollfd, local_stream,
-					data_ht);
-			if (ret < 0) {
-				ERR("Error in allocating pollfd or local_outfds");
-				lttng_consumer_send_error(ctx, LTTCOMM_CONSUMERD_POLL_ERROR);
-				pthread_mutex_unlock(&consumer_data.lock);
-				goto end;
-			}
-			nb_fd = ret;
-			consumer_data.need_update = 0;
-		}
-		pthread_mutex_unlock(&consumer_data.lock);
+		data_poll_unshed_streams(&events, &shed_streams,
+				&has_data_streams, &nb_streams);
 
 		/* No FDs and consumer_quit, consumer_cleanup the thread */
-		if (nb_fd == 0 && CMM_LOAD_SHARED(consumer_quit) == 1) {
+		if (nb_streams == 0 && CMM_LOAD_SHARED(consumer_quit) == 1) {
 			err = 0;	/* All is OK */
 			goto end;
 		}
-		/* poll on the array of fds */
+		/* poll on the set of fds */
 	restart:
-		DBG("polling on %d fd", nb_fd + 2);
+		DBG("polling on %u stream(s) of data shard %u", nb_streams,
+				shard->id);
 		if (testpoint(consumerd_thread_data_poll)) {
 			goto end;
 		}
+		/* Release the streams freed since the last wait at once. */
+		lttng_ht_thread_batch_flush();
+		relayd_flush_all_indexes();
 		health_poll_entry();
-		num_rdy = poll(pollfd, nb_fd + 2, -1);
+		ret = lttng_poll_wait(&events,
+				data_poll_batching_timeout(&batching));
 		health_poll_exit();
-		DBG("poll num_rdy : %d", num_rdy);
-		if (num_rdy == -1) {
+		DBG("poll num_rdy : %d", ret);
+		if (ret < 0) {
 			/*
 			 * Restart interrupted system call.
 			 */
@@ -2550,10 +4646,17 @@ void *consumer_thread_data_poll(void *data)
 			PERROR("Poll error");
 			lttng_consumer_send_error(ctx, LTTCOMM_CONSUMERD_POLL_ERROR);
 			goto end;
-		} else if (num_rdy == 0) {
+		} else if (ret == 0) {
+			if (batching.active) {
+				data_poll_batching_idle(&batching);
+				continue;
+			}
 			DBG("Polling thread timed out");
 			goto end;
 		}
+		nb_fd = ret;
+		shard->wakeup_ts = lttng_monotonic_time_ns();
+		data_poll_batching_wakeup(&batching, shard->wakeup_ts);
 
 		if (caa_unlikely(data_consumption_paused)) {
 			DBG("Data consumption paused, sleeping...");
@@ -2561,50 +4664,107 @@ void *consumer_thread_data_poll(void *data)
 			goto restart;
 		}
 
+		if (nb_fd > local_stream_size) {
+			struct lttng_consumer_stream **new_local_stream;
+			uint32_t *new_local_order;
+
+			new_local_stream = realloc(local_stream,
+					nb_fd * sizeof(*local_stream));
+			if (!new_local_stream) {
+				PERROR("local_stream realloc");
+				goto end;
+			}
+			local_stream = new_local_stream;
+			new_local_order = realloc(local_order,
+					nb_fd * sizeof(*local_order));
+			if (!new_local_order) {
+				PERROR("local_order realloc");
+				goto end;
+			}
+			local_order = new_local_order;
+			local_stream_size = nb_fd;
+		}
+
 		/*
-		 * If the consumer_data_pipe triggered poll go directly to the
-		 * beginning of the loop to update the array. We want to prioritize
-		 * array update over low-priority reads.
+		 * Handle the shard's pipes and resolve the streams of the returned
+		 * events.
 		 */
-		if (pollfd[nb_fd].revents & (POLLIN | POLLPRI)) {
-			ssize_t pipe_readlen;
-
-			DBG("consumer_data_pipe wake up");
-			pipe_readlen = lttng_pipe_read(ctx->consumer_data_pipe,
-					&new_stream, sizeof(new_stream));
-			if (pipe_readlen < sizeof(new_stream)) {
-				PERROR("Consumer data pipe");
-				/* Continue so we can at least handle the current stream(s). */
+		rcu_read_lock();
+		for (i = 0; i < nb_fd; i++) {
+			int pollfd = LTTNG_POLL_GETFD(&events, i);
+			struct lttng_ht_iter iter;
+			struct lttng_ht_node_u64 *node;
+			uint64_t tmp_id = (uint64_t) pollfd;
+
+			local_stream[i] = NULL;
+			revents = LTTNG_POLL_GETEV(&events, i);
+			if (!revents) {
+				/* No activity for this FD (poll implementation). */
 				continue;
 			}
 
 			/*
-			 * If the stream is NULL, just ignore it. It's also possible that
-			 * the sessiond poll thread changed the consumer_quit state and is
-			 * waking us up to test it.
+			 * If the shard's data pipe triggered poll go directly to the
+			 * beginning of the loop to handle the new stream. We want to
+			 * prioritize poll set updates over low-priority reads.
 			 */
-			if (new_stream == NULL) {
-				validate_endpoint_status_data_stream();
-				continue;
+			if (pollfd == lttng_pipe_get_readfd(shard->data_pipe)) {
+				ssize_t pipe_readlen;
+
+				DBG("Data pipe of data shard %u wake up", shard->id);
+				pipe_readlen = lttng_pipe_read(shard->data_pipe,
+						&new_stream, sizeof(new_stream));
+				rcu_read_unlock();
+				if (pipe_readlen < sizeof(new_stream)) {
+					PERROR("Consumer data pipe");
+					/* Continue so we can at least handle the current stream(s). */
+					goto next_loop;
+				}
+
+				/*
+				 * Take the queued streams first so that the end point
+				 * validation below does not delete one of them.
+				 */
+				data_poll_add_new_streams(shard, &events, &nb_streams);
+
+				/*
+				 * If the stream is NULL, validate the end points. It's
+				 * also possible that the sessiond poll thread changed the
+				 * consumer_quit state and is waking us up to test it.
+				 */
+				if (new_stream == NULL) {
+					validate_endpoint_status_data_stream(shard, &events,
+							&nb_streams);
+				}
+				goto next_loop;
 			}
 
-			/* Continue to update the local streams and handle prio ones */
-			continue;
-		}
+			/* Handle wakeup pipe. */
+			if (pollfd == lttng_pipe_get_readfd(shard->wakeup_pipe)) {
+				char dummy;
+				ssize_t pipe_readlen;
 
-		/* Handle wakeup pipe. */
-		if (pollfd[nb_fd + 1].revents & (POLLIN | POLLPRI)) {
-			char dummy;
-			ssize_t pipe_readlen;
+				pipe_readlen = lttng_pipe_read(shard->wakeup_pipe, &dummy,
+						sizeof(dummy));
+				if (pipe_readlen < 0) {
+					PERROR("Consumer data wakeup pipe");
+				}
+				/* We've been awakened to handle stream(s). */
+				shard->has_wakeup = 0;
+				continue;
+			}
 
-			pipe_readlen = lttng_pipe_read(ctx->consumer_wakeup_pipe, &dummy,
-					sizeof(dummy));
-			if (pipe_readlen < 0) {
-				PERROR("Consumer data wakeup pipe");
+			/* The key of a data stream is its wait fd. */
+			lttng_ht_lookup_fast_u64(data_ht, tmp_id, &iter);
+			node = lttng_ht_iter_get_node_u64(&iter);
+			if (!node) {
+				continue;
 			}
-			/* We've been awakened to handle stream(s). */
-			ctx->has_wakeup = 0;
+			local_stream[i] = caa_container_of(node,
+					struct lttng_consumer_stream, node);
+			assert(local_stream[i]->data_shard == shard);
 		}
+		rcu_read_unlock();
 
 		/* Take care of high priority channels first. */
 		for (i = 0; i < nb_fd; i++) {
@@ -2613,18 +4773,22 @@ void *consumer_thread_data_poll(void *data)
 			if (local_stream[i] == NULL) {
 				continue;
 			}
-			if (pollfd[i].revents & POLLPRI) {
-				DBG("Urgent read on fd %d", pollfd[i].fd);
+			if (LTTNG_POLL_GETEV(&events, i) & LPOLLPRI) {
+				DBG("Urgent read on fd %d", LTTNG_POLL_GETFD(&events, i));
 				high_prio = 1;
 				len = ctx->on_buffer_ready(local_stream[i], ctx);
 				/* it's ok to have an unavailable sub-buffer */
 				if (len < 0 && len != -EAGAIN && len != -ENODATA) {
 					/* Clean the stream and free it. */
-					consumer_del_stream(local_stream[i], data_ht);
+					data_poll_del_stream(&events, local_stream[i],
+							&nb_streams);
 					local_stream[i] = NULL;
+					continue;
 				} else if (len > 0) {
 					local_stream[i]->data_read = 1;
 				}
+				data_poll_queue_has_data(&has_data_streams,
+						local_stream[i]);
 			}
 		}
 
@@ -2636,42 +4800,94 @@ void *consumer_thread_data_poll(void *data)
 			continue;
 		}
 
-		/* Take care of low priority channels. */
-		for (i = 0; i < nb_fd; i++) {
+		/*
+		 * Take care of low priority channels, by decreasing consumption
+		 * priority.
+		 */
+		data_poll_order_streams(local_stream, nb_fd, local_order);
+		for (j = 0; j < nb_fd; j++) {
+			i = local_order[j];
 			health_code_update();
 
 			if (local_stream[i] == NULL) {
 				continue;
 			}
-			if ((pollfd[i].revents & POLLIN) ||
+			if (data_poll_stream_is_shed(local_stream[i])) {
+				data_poll_shed_stream(&events, local_stream[i],
+						&shed_streams);
+				local_stream[i] = NULL;
+				continue;
+			}
+			if ((LTTNG_POLL_GETEV(&events, i) & LPOLLIN) ||
 					local_stream[i]->hangup_flush_done ||
 					local_stream[i]->has_data) {
-				DBG("Normal read on fd %d", pollfd[i].fd);
-				len = ctx->on_buffer_ready(local_stream[i], ctx);
+				DBG("Normal read on fd %d", LTTNG_POLL_GETFD(&events, i));
+				len = data_poll_consume(local_stream[i], ctx);
 				/* it's ok to have an unavailable sub-buffer */
 				if (len < 0 && len != -EAGAIN && len != -ENODATA) {
 					/* Clean the stream and free it. */
-					consumer_del_stream(local_stream[i], data_ht);
+					data_poll_del_stream(&events, local_stream[i],
+							&nb_streams);
 					local_stream[i] = NULL;
-				} else if (len > 0) {
-					local_stream[i]->data_read = 1;
+					continue;
+				}
+				data_poll_queue_has_data(&next_has_data_streams,
+						local_stream[i]);
+			}
+		}
+
+		/*
+		 * Streams that still had data left after their last read are not
+		 * necessarily reported by the poll set; consume them now.
+		 */
+		cds_list_for_each_entry_safe(stream, tmp_stream, &has_data_streams,
+				has_data_node) {
+			health_code_update();
+
+			if (data_poll_stream_is_shed(stream)) {
+				for (i = 0; i < nb_fd; i++) {
+					if (local_stream[i] == stream) {
+						local_stream[i] = NULL;
+					}
+				}
+				data_poll_shed_stream(&events, stream, &shed_streams);
+				continue;
+			}
+			DBG("Normal read on fd %d (data left)", stream->wait_fd);
+			len = data_poll_consume(stream, ctx);
+			/* it's ok to have an unavailable sub-buffer */
+			if (len < 0 && len != -EAGAIN && len != -ENODATA) {
+				/* Clean the stream and free it. */
+				for (i = 0; i < nb_fd; i++) {
+					if (local_stream[i] == stream) {
+						local_stream[i] = NULL;
+					}
 				}
+				data_poll_del_stream(&events, stream, &nb_streams);
+				continue;
 			}
+			data_poll_queue_has_data(&next_has_data_streams, stream);
 		}
+		assert(cds_list_empty(&has_data_streams));
+		cds_list_splice(&next_has_data_streams, &has_data_streams);
+		CDS_INIT_LIST_HEAD(&next_has_data_streams);
 
 		/* Handle hangup and errors */
 		for (i = 0; i < nb_fd; i++) {
+			int pollfd = LTTNG_POLL_GETFD(&events, i);
+
 			health_code_update();
 
 			if (local_stream[i] == NULL) {
 				continue;
 			}
+			revents = LTTNG_POLL_GETEV(&events, i);
 			if (!local_stream[i]->hangup_flush_done
-					&& (pollfd[i].revents & (POLLHUP | POLLERR | POLLNVAL))
+					&& (revents & (LPOLLHUP | LPOLLERR))
 					&& (consumer_data.type == LTTNG_CONSUMER32_UST
 						|| consumer_data.type == LTTNG_CONSUMER64_UST)) {
 				DBG("fd %d is hup|err|nval. Attempting flush and read.",
-						pollfd[i].fd);
+						pollfd);
 				lttng_ustconsumer_on_stream_hangup(local_stream[i]);
 				/* Attempt read again, for the data we just flushed. */
 				local_stream[i]->data_read = 1;
@@ -2681,49 +4897,53 @@ void *consumer_thread_data_poll(void *data)
 			 * read no data in this pass, we can remove the
 			 * stream from its hash table.
 			 */
-			if ((pollfd[i].revents & POLLHUP)) {
-				DBG("Polling fd %d tells it has hung up.", pollfd[i].fd);
-				if (!local_stream[i]->data_read) {
-					consumer_del_stream(local_stream[i], data_ht);
-					local_stream[i] = NULL;
-					num_hup++;
-				}
-			} else if (pollfd[i].revents & POLLERR) {
-				ERR("Error returned in polling fd %d.", pollfd[i].fd);
+			if (revents & LPOLLHUP) {
+				DBG("Polling fd %d tells it has hung up.", pollfd);
 				if (!local_stream[i]->data_read) {
-					consumer_del_stream(local_stream[i], data_ht);
+					data_poll_del_stream(&events, local_stream[i],
+							&nb_streams);
 					local_stream[i] = NULL;
-					num_hup++;
 				}
-			} else if (pollfd[i].revents & POLLNVAL) {
-				ERR("Polling fd %d tells fd is not open.", pollfd[i].fd);
+			} else if (revents & LPOLLERR) {
+				ERR("Error returned in polling fd %d.", pollfd);
 				if (!local_stream[i]->data_read) {
-					consumer_del_stream(local_stream[i], data_ht);
+					data_poll_del_stream(&events, local_stream[i],
+							&nb_streams);
 					local_stream[i] = NULL;
-					num_hup++;
 				}
 			}
 			if (local_stream[i] != NULL) {
 				local_stream[i]->data_read = 0;
 			}
 		}
+	next_loop:
+		;
 	}
 	/* All is OK */
 	err = 0;
 end:
-	DBG("polling thread exiting");
-	free(pollfd);
+	DBG("polling thread of data shard %u exiting", shard->id);
+	lttng_poll_clean(&events);
+end_poll:
 	free(local_stream);
+	free(local_order);
 
 	/*
-	 * Close the write side of the pipe so epoll_wait() in
-	 * consumer_thread_metadata_poll can catch it. The thread is monitoring the
-	 * read side of the pipe. If we close them both, epoll_wait strangely does
-	 * not return and could create a endless wait period if the pipe is the
-	 * only tracked fd in the poll set. The thread will take care of closing
-	 * the read side.
+	 * The last data thread to exit closes the write side of the metadata
+	 * pipes so epoll_wait() in consumer_thread_metadata_poll can catch it.
+	 * The metadata threads are monitoring the read side of the pipes. If we
+	 * close them both, epoll_wait strangely does not return and could create
+	 * a endless wait period if the pipe is the only tracked fd in the poll
+	 * set. The metadata threads will take care of closing the read side.
 	 */
-	(void) lttng_pipe_write_close(ctx->consumer_metadata_pipe);
+	if (!uatomic_sub_return(&ctx->nr_data_threads_active, 1)) {
+		unsigned int j;
+
+		for (j = 0; j < ctx->nr_metadata_shards; j++) {
+			(void) lttng_pipe_write_close(
+					ctx->metadata_shards[j].metadata_pipe);
+		}
+	}
 
 error_testpoint:
 	if (err) {
@@ -2732,6 +4952,9 @@ error_testpoint:
 	}
 	health_unregister(health_consumerd);
 
+	relayd_flush_all_indexes();
+	URCU_TLS(relayd_index_batching) = 0;
+	lttng_ht_thread_batch_stop();
 	rcu_unregister_thread();
 	return NULL;
 }
@@ -2830,6 +5053,7 @@ void *consumer_thread_channel_poll(void *data)
 	rcu_register_thread();
 
 	health_register(health_consumerd, HEALTH_CONSUMERD_TYPE_CHANNEL);
+	consumer_sched_apply(HEALTH_CONSUMERD_TYPE_CHANNEL);
 
 	if (testpoint(consumerd_thread_channel)) {
 		goto error_testpoint;
@@ -2837,7 +5061,7 @@ void *consumer_thread_channel_poll(void *data)
 
 	health_code_update();
 
-	channel_ht = lttng_ht_new(0, LTTNG_HT_TYPE_U64);
+	channel_ht = lttng_ht_new(0, LTTNG_HT_TYPE_FAST_U64);
 	if (!channel_ht) {
 		/* ENOMEM at this point. Better to bail out. */
 		goto end_ht;
@@ -3000,11 +5224,8 @@ restart:
 			}
 
 			rcu_read_lock();
-			{
-				uint64_t tmp_id = (uint64_t) pollfd;
-
-				lttng_ht_lookup(channel_ht, &tmp_id, &iter);
-			}
+			lttng_ht_lookup_fast_u64(channel_ht, (uint64_t) pollfd,
+					&iter);
 			node = lttng_ht_iter_get_node_u64(&iter);
 			assert(node);
 
@@ -3104,6 +5325,7 @@ void *consumer_thread_sessiond_poll(void *data)
 	rcu_register_thread();
 
 	health_register(health_consumerd, HEALTH_CONSUMERD_TYPE_SESSIOND);
+	consumer_sched_apply(HEALTH_CONSUMERD_TYPE_SESSIOND);
 
 	if (testpoint(consumerd_thread_sessiond)) {
 		goto error_testpoint;
@@ -3231,10 +5453,10 @@ end:
 	CMM_STORE_SHARED(consumer_quit, 1);
 
 	/*
-	 * Notify the data poll thread to poll back again and test the
+	 * Notify the data poll threads to poll back again and test the
 	 * consumer_quit state that we just set so to quit gracefully.
 	 */
-	notify_thread_lttng_pipe(ctx->consumer_data_pipe);
+	notify_data_shards(ctx);
 
 	notify_channel_pipe(ctx, NULL, -1, CONSUMER_CHANNEL_QUIT);
 
@@ -3265,15 +5487,47 @@ error_testpoint:
 	return NULL;
 }
 
-ssize_t lttng_consumer_read_subbuffer(struct lttng_consumer_stream *stream,
-		struct lttng_consumer_local_data *ctx)
+/*
+ * Read one sub-buffer of the stream with the tracer specific read operation.
+ */
+/*
+ * Account for a sub-buffer of "len" bytes whose consumption started at
+ * "start" in the statistics of a stream.
+ */
+static void stream_stats_add_subbuf(struct lttng_consumer_stream *stream,
+		uint64_t start, uint64_t len)
 {
-	ssize_t ret;
+	int bucket;
+	uint64_t now = lttng_monotonic_time_ns();
+	struct consumer_stream_stats *stats = &stream->stats;
 
-	pthread_mutex_lock(&stream->lock);
-	if (stream->metadata_flag) {
-		pthread_mutex_lock(&stream->metadata_rdv_lock);
+	stats->bytes_consumed += len;
+	stats->subbufs_consumed++;
+
+	if (!start || now < start) {
+		return;
 	}
+	bucket = utils_get_count_order_u64((now - start) / NSEC_PER_USEC + 1);
+	bucket = min(bucket, LTTNG_STREAM_STATS_LATENCY_BUCKETS - 1);
+	stats->write_latency_hist[bucket]++;
+
+	/* Only the data streams are consumed on a data thread wakeup. */
+	if (stream->data_shard && stream->data_shard->wakeup_ts &&
+			start >= stream->data_shard->wakeup_ts) {
+		uint64_t delay = start - stream->data_shard->wakeup_ts;
+
+		stats->wakeup_delay_total += delay;
+		stats->wakeup_delay_max = max_t(uint64_t, delay,
+				stats->wakeup_delay_max);
+	}
+}
+
+static ssize_t read_subbuffer(struct lttng_consumer_stream *stream,
+		struct lttng_consumer_local_data *ctx)
+{
+	ssize_t ret;
+	uint64_t start = lttng_monotonic_time_ns();
+	uint64_t output_written = stream->output_written;
 
 	switch (consumer_data.type) {
 	case LTTNG_CONSUMER_KERNEL:
@@ -3290,6 +5544,123 @@ ssize_t lttng_consumer_read_subbuffer(struct lttng_consumer_stream *stream,
 		break;
 	}
 
+	/* Nothing is written when no sub-buffer is ready. */
+	if (stream->output_written != output_written) {
+		stream_stats_add_subbuf(stream, start,
+				stream->output_written - output_written);
+	}
+
+	return ret;
+}
+
+/*
+ * Return 1 if the stream is read in batches. Only the data streams written
+ * on the local filesystem are batched since a relayd expects one data header
+ * per packet.
+ */
+static int stream_is_batched(struct lttng_consumer_stream *stream)
+{
+	return consumer_data.batch_bytes && !stream->metadata_flag &&
+			stream->monitor &&
+			stream->net_seq_idx == (uint64_t) -1ULL &&
+			stream->chan->output != CONSUMER_CHANNEL_SPLICE;
+}
+
+/*
+ * Consume every ready sub-buffer of the stream, up to the batch byte budget,
+ * and write them with a single write followed by their packet indexes.
+ *
+ * Return the number of bytes consumed or, if none, the result of the first
+ * read.
+ */
+static ssize_t read_subbuffer_batch(struct lttng_consumer_stream *stream,
+		struct lttng_consumer_local_data *ctx)
+{
+	int err;
+	unsigned int nr_read = 0;
+	ssize_t ret, total = 0;
+
+	stream->batch.active = 1;
+	do {
+		ret = read_subbuffer(stream, ctx);
+		if (ret < 0) {
+			break;
+		}
+		nr_read++;
+		total += ret;
+		if (consumer_data.type == LTTNG_CONSUMER_KERNEL) {
+			if (!ret) {
+				break;
+			}
+		} else if (!stream->has_data) {
+			/* UST flags the stream once no sub-buffer is left. */
+			break;
+		}
+	} while (stream->batch.len < consumer_data.batch_bytes);
+	stream->batch.active = 0;
+
+	err = batch_flush(stream);
+	if (err < 0) {
+		ret = err;
+		goto end;
+	}
+
+	/* Running out of ready sub-buffers only ends the batch. */
+	if (nr_read && (ret >= 0 || ret == -EAGAIN || ret == -ENODATA)) {
+		ret = total;
+	}
+end:
+	return ret;
+}
+
+/*
+ * Read all the ready sub-buffers of a kernel metadata stream, with a single
+ * rendez-vous with the threads syncing the metadata. The wait fd of the
+ * stream only reports new metadata, so the metadata thread does not poll for
+ * more once the stream is drained.
+ */
+static ssize_t read_kernel_metadata_batch(struct lttng_consumer_stream *stream,
+		struct lttng_consumer_local_data *ctx)
+{
+	ssize_t ret, total = 0;
+
+	do {
+		health_code_update();
+
+		ret = read_subbuffer(stream, ctx);
+		if (ret > 0) {
+			total += ret;
+		}
+	} while (ret > 0);
+
+	/* Running out of ready sub-buffers only ends the batch. */
+	if (total && (ret == 0 || ret == -EAGAIN || ret == -ENODATA)) {
+		ret = total;
+	}
+	return ret;
+}
+
+ssize_t lttng_consumer_read_subbuffer(struct lttng_consumer_stream *stream,
+		struct lttng_consumer_local_data *ctx)
+{
+	ssize_t ret;
+
+	pthread_mutex_lock(&stream->lock);
+	if (stream->metadata_flag) {
+		pthread_mutex_lock(&stream->metadata_rdv_lock);
+	}
+
+	self_tracepoint(consumerd_subbuffer_begin, stream->key);
+	if (stream_is_batched(stream)) {
+		ret = read_subbuffer_batch(stream, ctx);
+	} else if (stream->metadata_flag &&
+			consumer_data.type == LTTNG_CONSUMER_KERNEL) {
+		ret = read_kernel_metadata_batch(stream, ctx);
+	} else {
+		ret = read_subbuffer(stream, ctx);
+	}
+	self_tracepoint(consumerd_subbuffer_end, stream->key, ret);
+
 	if (stream->metadata_flag) {
 		pthread_cond_broadcast(&stream->metadata_rdv);
 		pthread_mutex_unlock(&stream->metadata_rdv_lock);
@@ -3318,7 +5689,7 @@ int lttng_consumer_on_recv_stream(struct lttng_consumer_stream *stream)
  */
 int lttng_consumer_init(void)
 {
-	consumer_data.channel_ht = lttng_ht_new(0, LTTNG_HT_TYPE_U64);
+	consumer_data.channel_ht = lttng_ht_new(0, LTTNG_HT_TYPE_FAST_U64);
 	if (!consumer_data.channel_ht) {
 		goto error;
 	}
@@ -3338,12 +5709,12 @@ int lttng_consumer_init(void)
 		goto error;
 	}
 
-	data_ht = lttng_ht_new(0, LTTNG_HT_TYPE_U64);
+	data_ht = lttng_ht_new(0, LTTNG_HT_TYPE_FAST_U64);
 	if (!data_ht) {
 		goto error;
 	}
 
-	metadata_ht = lttng_ht_new(0, LTTNG_HT_TYPE_U64);
+	metadata_ht = lttng_ht_new(0, LTTNG_HT_TYPE_FAST_U64);
 	if (!metadata_ht) {
 		goto error;
 	}
@@ -3354,6 +5725,70 @@ error:
 	return -1;
 }
 
+/*
+ * Open the additional data connections of a relayd socket pair to the address
+ * of the data socket received from the session daemon. The relayd
+ * demultiplexes the packets of its data connections by stream id.
+ *
+ * Return the number of connections opened. Failing to open one is not fatal:
+ * the streams are spread among the connections opened so far.
+ */
+static unsigned int open_relayd_data_socks(
+		struct consumer_relayd_sock_pair *relayd,
+		struct lttcomm_relayd_sock *relayd_sock)
+{
+	int ret;
+	unsigned int i;
+
+	for (i = 1; i < consumer_data.relayd_data_connections; i++) {
+		struct lttcomm_relayd_sock *data_sock =
+				&relayd->data_socks[i].sock;
+
+		lttcomm_copy_sock(&data_sock->sock, &relayd_sock->sock);
+		ret = lttcomm_create_sock(&data_sock->sock);
+		if (ret < 0) {
+			data_sock->sock.fd = -1;
+			break;
+		}
+		ret = relayd_connect(data_sock);
+		if (ret < 0) {
+			(void) relayd_close(data_sock);
+			data_sock->sock.fd = -1;
+			break;
+		}
+		data_sock->major = relayd_sock->major;
+		data_sock->minor = relayd_sock->minor;
+	}
+
+	if (i < consumer_data.relayd_data_connections) {
+		WARN("Only %u of %u data connections opened to relayd (idx: %" PRIu64 ")",
+				i, consumer_data.relayd_data_connections,
+				relayd->net_seq_idx);
+	}
+	return i - 1;
+}
+
+/*
+ * Enable the zero-copy sends on the data connections of a relayd socket
+ * pair. The connections not supporting them, like the local ones, send
+ * copies.
+ */
+static void setup_relayd_zerocopy(struct consumer_relayd_sock_pair *relayd)
+{
+	unsigned int i;
+
+	for (i = 0; i < relayd->nr_data_socks; i++) {
+		struct consumer_relayd_data_sock *data_sock =
+				&relayd->data_socks[i];
+
+		data_sock->zerocopy =
+				!relayd_enable_zerocopy(&data_sock->sock);
+		DBG("Zero-copy sends %s on relayd data connection %u (idx: %" PRIu64 ")",
+				data_sock->zerocopy ? "enabled" : "unsupported",
+				i, relayd->net_seq_idx);
+	}
+}
+
 /*
  * Process the ADD_RELAYD command receive by a consumer.
  *
@@ -3465,14 +5900,18 @@ int consumer_add_relayd_socket(uint64_t net_seq_idx, int sock_type,
 		/* Assign version values. */
 		relayd->control_sock.major = relayd_sock->major;
 		relayd->control_sock.minor = relayd_sock->minor;
+		relayd->control_sock.features = relayd_sock->features;
 
 		relayd->relayd_session_id = relayd_session_id;
 
 		break;
 	case LTTNG_STREAM_DATA:
+	{
+		struct lttcomm_relayd_sock *data_sock = &relayd->data_socks[0].sock;
+
 		/* Copy received lttcomm socket */
-		lttcomm_copy_sock(&relayd->data_sock.sock, &relayd_sock->sock);
-		ret = lttcomm_create_sock(&relayd->data_sock.sock);
+		lttcomm_copy_sock(&data_sock->sock, &relayd_sock->sock);
+		ret = lttcomm_create_sock(&data_sock->sock);
 		/* Handle create_sock error. */
 		if (ret < 0) {
 			ret_code = LTTCOMM_CONSUMERD_ENOMEM;
@@ -3483,17 +5922,24 @@ int consumer_add_relayd_socket(uint64_t net_seq_idx, int sock_type,
 		 * lttcomm_create_sock, so we can replace it by the one
 		 * received from sessiond.
 		 */
-		if (close(relayd->data_sock.sock.fd)) {
+		if (close(data_sock->sock.fd)) {
 			PERROR("close");
 		}
 
 		/* Assign new file descriptor */
-		relayd->data_sock.sock.fd = fd;
+		data_sock->sock.fd = fd;
 		fd = -1;	/* for eventual error paths */
 		/* Assign version values. */
-		relayd->data_sock.major = relayd_sock->major;
-		relayd->data_sock.minor = relayd_sock->minor;
+		data_sock->major = relayd_sock->major;
+		data_sock->minor = relayd_sock->minor;
+
+		relayd->nr_data_socks = 1 + open_relayd_data_socks(relayd,
+				relayd_sock);
+		if (consumer_data.relayd_zerocopy) {
+			setup_relayd_zerocopy(relayd);
+		}
 		break;
+	}
 	default:
 		ERR("Unknown relayd socket type (%d)", sock_type);
 		ret = -1;
@@ -3600,6 +6046,94 @@ found:
 	return relayd;
 }
 
+/*
+ * Send the data pending checks of streams batched by consumer_data_pending()
+ * to the relayd.
+ *
+ * Return 1 if data is pending on the relayd side, 0 if not or a negative
+ * value on error.
+ */
+static int relayd_flush_data_pending(struct consumer_relayd_sock_pair *relayd,
+		const struct lttcomm_relayd_stream_data_pending *streams,
+		unsigned int nb_streams)
+{
+	int ret;
+
+	if (!nb_streams) {
+		return 0;
+	}
+
+	pthread_mutex_lock(&relayd->ctrl_sock_mutex);
+	ret = relayd_streams_data_pending(&relayd->control_sock, streams,
+			nb_streams);
+	pthread_mutex_unlock(&relayd->ctrl_sock_mutex);
+	return ret;
+}
+
+/*
+ * Check the relayd side of the data pending of a stream, either right away or
+ * by batching it in "streams" when the relayd supports it. The stream lock
+ * MUST be acquired.
+ *
+ * Return 1 if data is known to be pending, else 0.
+ */
+static int relayd_stream_data_pending(struct consumer_relayd_sock_pair *relayd,
+		struct lttng_consumer_stream *stream,
+		struct lttcomm_relayd_stream_data_pending **streams,
+		unsigned int *nb_streams, unsigned int *alloc_streams)
+{
+	int ret;
+	struct lttcomm_relayd_stream_data_pending *entry;
+
+	if (!relayd_supports_streams_data_pending(&relayd->control_sock)) {
+		goto single;
+	}
+
+	if (*nb_streams == RELAYD_STREAMS_DATA_PENDING_MAX) {
+		ret = relayd_flush_data_pending(relayd, *streams, *nb_streams);
+		*nb_streams = 0;
+		if (ret == 1) {
+			goto end;
+		}
+	}
+	if (*nb_streams == *alloc_streams) {
+		struct lttcomm_relayd_stream_data_pending *new_streams;
+		unsigned int new_alloc = min_t(unsigned int,
+				max_t(unsigned int, *alloc_streams << 1, 64),
+				RELAYD_STREAMS_DATA_PENDING_MAX);
+
+		new_streams = realloc(*streams, new_alloc * sizeof(**streams));
+		if (!new_streams) {
+			PERROR("realloc relayd data pending streams");
+			goto single;
+		}
+		*streams = new_streams;
+		*alloc_streams = new_alloc;
+	}
+
+	entry = &(*streams)[(*nb_streams)++];
+	memset(entry, 0, sizeof(*entry));
+	entry->stream_id = htobe64(stream->relayd_stream_id);
+	entry->last_net_seq_num = htobe64(stream->next_net_seq_num - 1);
+	entry->metadata = !!stream->metadata_flag;
+	ret = 0;
+	goto end;
+
+single:
+	pthread_mutex_lock(&relayd->ctrl_sock_mutex);
+	if (stream->metadata_flag) {
+		ret = relayd_quiescent_control(&relayd->control_sock,
+				stream->relayd_stream_id);
+	} else {
+		ret = relayd_data_pending(&relayd->control_sock,
+				stream->relayd_stream_id,
+				stream->next_net_seq_num - 1);
+	}
+	pthread_mutex_unlock(&relayd->ctrl_sock_mutex);
+end:
+	return ret == 1;
+}
+
 /*
  * Check if for a given session id there is still data needed to be extract
  * from the buffers.
@@ -3608,17 +6142,23 @@ found:
  */
 int consumer_data_pending(uint64_t id)
 {
-	int ret;
+	int ret, pending = 0;
 	struct lttng_ht_iter iter;
 	struct lttng_ht *ht;
 	struct lttng_consumer_stream *stream;
 	struct consumer_relayd_sock_pair *relayd = NULL;
+	struct lttcomm_relayd_stream_data_pending *relayd_streams = NULL;
+	unsigned int nb_relayd_streams = 0, alloc_relayd_streams = 0;
 	int (*data_pending)(struct lttng_consumer_stream *);
 
 	DBG("Consumer data pending command on session id %" PRIu64, id);
 
+	/*
+	 * The streams are looked up locklessly: a stream deleted concurrently
+	 * stays valid until the end of the RCU read side critical section and its
+	 * deletion is detected once its lock is acquired.
+	 */
 	rcu_read_lock();
-	pthread_mutex_lock(&consumer_data.lock);
 
 	switch (consumer_data.type) {
 	case LTTNG_CONSUMER_KERNEL:
@@ -3639,13 +6179,13 @@ int consumer_data_pending(uint64_t id)
 	relayd = find_relayd_by_session_id(id);
 	if (relayd) {
 		/* Send init command for data pending. */
-		pthread_mutex_lock(&relayd->ctrl_sock_mutex);
+		consumer_relayd_lock_control(relayd);
 		ret = relayd_begin_data_pending(&relayd->control_sock,
 				relayd->relayd_session_id);
 		pthread_mutex_unlock(&relayd->ctrl_sock_mutex);
 		if (ret < 0) {
 			/* Communication error thus the relayd so no data pending. */
-			goto data_not_pending;
+			goto end;
 		}
 	}
 
@@ -3675,22 +6215,15 @@ int consumer_data_pending(uint64_t id)
 			}
 		}
 
-		/* Relayd check */
-		if (relayd) {
-			pthread_mutex_lock(&relayd->ctrl_sock_mutex);
-			if (stream->metadata_flag) {
-				ret = relayd_quiescent_control(&relayd->control_sock,
-						stream->relayd_stream_id);
-			} else {
-				ret = relayd_data_pending(&relayd->control_sock,
-						stream->relayd_stream_id,
-						stream->next_net_seq_num - 1);
-			}
-			pthread_mutex_unlock(&relayd->ctrl_sock_mutex);
-			if (ret == 1) {
-				pthread_mutex_unlock(&stream->lock);
-				goto data_pending;
-			}
+		/*
+		 * Relayd check. The checks are batched in as few messages as
+		 * possible instead of costing a round trip per stream.
+		 */
+		if (relayd && relayd_stream_data_pending(relayd, stream,
+				&relayd_streams, &nb_relayd_streams,
+				&alloc_relayd_streams)) {
+			pthread_mutex_unlock(&stream->lock);
+			goto data_pending;
 		}
 		pthread_mutex_unlock(&stream->lock);
 	}
@@ -3698,13 +6231,19 @@ int consumer_data_pending(uint64_t id)
 	if (relayd) {
 		unsigned int is_data_inflight = 0;
 
+		ret = relayd_flush_data_pending(relayd, relayd_streams,
+				nb_relayd_streams);
+		if (ret == 1) {
+			goto data_pending;
+		}
+
 		/* Send init command for data pending. */
 		pthread_mutex_lock(&relayd->ctrl_sock_mutex);
 		ret = relayd_end_data_pending(&relayd->control_sock,
 				relayd->relayd_session_id, &is_data_inflight);
 		pthread_mutex_unlock(&relayd->ctrl_sock_mutex);
 		if (ret < 0) {
-			goto data_not_pending;
+			goto end;
 		}
 		if (is_data_inflight) {
 			goto data_pending;
@@ -3716,18 +6255,16 @@ int consumer_data_pending(uint64_t id)
 	 * stream(s) have been removed thus data is guaranteed to be available for
 	 * analysis from the trace files.
 	 */
-
-data_not_pending:
-	/* Data is available to be read by a viewer. */
-	pthread_mutex_unlock(&consumer_data.lock);
-	rcu_read_unlock();
-	return 0;
+	goto end;
 
 data_pending:
 	/* Data is still being extracted from buffers. */
-	pthread_mutex_unlock(&consumer_data.lock);
+	pending = 1;
+end:
+	/* When not pending, data is available to be read by a viewer. */
 	rcu_read_unlock();
-	return 1;
+	free(relayd_streams);
+	return pending;
 }
 
 /*
@@ -3785,3 +6322,38 @@ unsigned long consumer_get_consume_start_pos(unsigned long consumed_pos,
 	}
 	return start_pos;
 }
+
+/*
+ * Return the position from which an incremental snapshot of a stream to the
+ * output "output_id" starts: the end of the last snapshot of the stream to
+ * that output, unless the tracer overwrote the packets following it.
+ *
+ * The stream lock MUST be acquired.
+ */
+unsigned long consumer_get_incremental_start_pos(
+		struct lttng_consumer_stream *stream, unsigned long start_pos,
+		uint64_t output_id)
+{
+	if (!stream->last_snapshot.valid ||
+			stream->last_snapshot.output_id != output_id) {
+		return start_pos;	/* First snapshot to this output */
+	}
+	if ((long) (stream->last_snapshot.produced_pos - start_pos) < 0) {
+		return start_pos;	/* Packets lost since the last snapshot */
+	}
+	return stream->last_snapshot.produced_pos;
+}
+
+/*
+ * Record the end of a successful snapshot of a stream to the output
+ * "output_id".
+ *
+ * The stream lock MUST be acquired.
+ */
+void consumer_set_last_snapshot_pos(struct lttng_consumer_stream *stream,
+		uint64_t output_id, unsigned long produced_pos)
+{
+	stream->last_snapshot.valid = true;
+	stream->last_snapshot.output_id = output_id;
+	stream->last_snapshot.produced_pos = produced_pos;
+}
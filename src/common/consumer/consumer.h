@@ -24,6 +24,7 @@
 #include <poll.h>
 #include <unistd.h>
 #include <urcu/list.h>
+#include <urcu/wfcqueue.h>
 
 #include <lttng/lttng.h>
 
@@ -62,6 +63,17 @@ enum lttng_consumer_command {
 	LTTNG_CONSUMER_LOST_PACKETS,
 	LTTNG_CONSUMER_CLEAR_QUIESCENT_CHANNEL,
 	LTTNG_CONSUMER_SET_CHANNEL_MONITOR_PIPE,
+	LTTNG_CONSUMER_STREAM_STATS,
+	/* Add all the streams of a channel at once. */
+	LTTNG_CONSUMER_ADD_STREAMS,
+	/* Switch the local streams of a session to a new trace chunk. */
+	LTTNG_CONSUMER_ROTATE_SESSION,
+	/* Runtime statistics of all the channels of a session at once. */
+	LTTNG_CONSUMER_CHANNEL_STATS,
+	/* Usage thresholds filtering the monitoring samples of a channel. */
+	LTTNG_CONSUMER_SET_CHANNEL_MONITOR_FILTER,
+	/* Stop or resume the consumption of the channels of priority 0. */
+	LTTNG_CONSUMER_SET_OVERLOAD_SHEDDING,
 };
 
 /* State of each fd in consumer */
@@ -86,6 +98,8 @@ enum consumer_endpoint_status {
 enum consumer_channel_output {
 	CONSUMER_CHANNEL_MMAP	= 0,
 	CONSUMER_CHANNEL_SPLICE	= 1,
+	/* mmap read, asynchronous io_uring write to a local tracefile. */
+	CONSUMER_CHANNEL_MMAP_URING	= 2,
 };
 
 enum consumer_channel_type {
@@ -93,6 +107,15 @@ enum consumer_channel_type {
 	CONSUMER_CHANNEL_TYPE_DATA	= 1,
 };
 
+/* Reaction of the data streams to the backpressure of their relayd. */
+enum consumer_backpressure_policy {
+	CONSUMER_BACKPRESSURE_NONE	= 0,
+	/* Delay the packets by the write lag of the relayd. */
+	CONSUMER_BACKPRESSURE_THROTTLE	= 1,
+	/* Also discard the packets while the relayd is saturated. */
+	CONSUMER_BACKPRESSURE_DISCARD	= 2,
+};
+
 extern struct lttng_consumer_global_data consumer_data;
 
 struct stream_list {
@@ -102,6 +125,94 @@ struct stream_list {
 
 /* Stub. */
 struct consumer_metadata_cache;
+struct lttng_consumer_local_data;
+struct lttng_io_uring;
+struct consumer_compress;
+
+/*
+ * Metadata stream consumption shard. Every metadata stream is assigned to
+ * exactly one shard when it is added to the consumer and is only ever polled
+ * and consumed by the metadata thread owning that shard, so that the metadata
+ * of many sessions is not serialized on a single thread.
+ */
+struct lttng_consumer_metadata_shard {
+	/* Index of the shard in the context's shard array. */
+	unsigned int id;
+	/* Context owning this shard. */
+	struct lttng_consumer_local_data *ctx;
+	/* Pipe used to transfer metadata streams to the shard's thread. */
+	struct lttng_pipe *metadata_pipe;
+};
+
+/*
+ * Data stream consumption shard. Every data stream is assigned to exactly one
+ * shard when it is added to the consumer and is only ever polled and consumed
+ * by the data thread owning that shard. This allows the data streams to be
+ * drained in parallel without the threads contending on each other's streams.
+ */
+struct lttng_consumer_data_shard {
+	/* Index of the shard in the context's shard array. */
+	unsigned int id;
+	/* Context owning this shard. */
+	struct lttng_consumer_local_data *ctx;
+	/*
+	 * Pipe used to wake up the shard's thread. A NULL stream asks it to
+	 * check the end point status of its streams, any other value that new
+	 * streams are queued in new_streams.
+	 */
+	struct lttng_pipe *data_pipe;
+	/*
+	 * Data streams handed over to the shard's thread, which drains the
+	 * queue at once on a wakeup. A single wakeup is written for all the
+	 * streams queued while the thread did not drain the queue.
+	 */
+	struct {
+		struct cds_wfcq_head head;
+		struct cds_wfcq_tail tail;
+		/* Set if a wakeup is due for the streams queued. */
+		int wakeup_pending;
+	} new_streams;
+	/*
+	 * The shard's thread uses that pipe to catch wakeup from read subbuffer
+	 * that detects that there is still data to be read for the stream
+	 * encountered. Before doing so, the stream is flagged to indicate that
+	 * there is still data to be read.
+	 *
+	 * Both pipes (read/write) are owned and used inside the shard's thread,
+	 * apart from the wakeup of the end of the overload shedding.
+	 */
+	struct lttng_pipe *wakeup_pipe;
+	/* Indicate if the shard's thread has been woken up. */
+	unsigned int has_wakeup:1;
+	/*
+	 * NUMA node index of the shard's thread, -1 if the thread is not bound.
+	 * A bound shard consumes the per-CPU streams of the CPUs of its node.
+	 */
+	int numa_node;
+	/* Monotonic time (nsec) of the last wakeup of the shard's thread. */
+	uint64_t wakeup_ts;
+};
+
+enum consumer_timer_type {
+	CONSUMER_TIMER_SWITCH,
+	CONSUMER_TIMER_LIVE,
+	CONSUMER_TIMER_MONITOR,
+};
+
+/*
+ * Periodic timer of a channel, queued on the timer wheel of the consumer
+ * timer thread. Protected by the timer wheel lock. See consumer-timer.c.
+ */
+struct consumer_timer {
+	struct cds_list_head node;
+	struct lttng_consumer_channel *channel;
+	enum consumer_timer_type type;
+	uint64_t interval_ns;
+	/* Absolute monotonic deadline of the next expiration. */
+	uint64_t deadline_ns;
+	unsigned int enabled:1;
+	unsigned int queued:1;
+};
 
 struct lttng_consumer_channel {
 	/* HT node used for consumer_data.channel_ht */
@@ -164,17 +275,20 @@ struct lttng_consumer_channel {
 
 	/* For UST metadata periodical flush */
 	int switch_timer_enabled;
-	timer_t switch_timer;
+	struct consumer_timer switch_timer;
 	int switch_timer_error;
 
 	/* For the live mode */
 	int live_timer_enabled;
-	timer_t live_timer;
+	struct consumer_timer live_timer;
 	int live_timer_error;
 
 	/* For channel monitoring timer. */
 	int monitor_timer_enabled;
-	timer_t monitor_timer;
+	struct consumer_timer monitor_timer;
+
+	/* Consumption priority of the streams, see consumer-priority.h. */
+	unsigned int priority;
 
 	/* On-disk circular buffer */
 	uint64_t tracefile_size;
@@ -226,6 +340,77 @@ struct lttng_consumer_channel {
 	uint64_t lost_packets;
 
 	bool streams_sent_to_relayd;
+	/* Compression of the packets of the data streams. */
+	enum lttng_channel_compression compression;
+	/* Back the ring buffers of the data streams with huge pages (UST). */
+	int huge_pages;
+	/* Number of sub-buffers of the ring buffers of the channel (UST). */
+	uint64_t num_subbuf;
+
+	/*
+	 * Usage thresholds of the triggers of the channel, set by the session
+	 * daemon. Once enabled, the monitor timer only sends a sample when the
+	 * position of the usage relative to the thresholds changes, or after
+	 * the heartbeat period. All the samples are sent until then, or if
+	 * "forward_all" is set.
+	 */
+	struct {
+		pthread_mutex_t lock;
+		bool enabled;
+		bool forward_all;
+		uint32_t nr_thresholds;
+		uint64_t thresholds[LTTCOMM_CONSUMER_MONITOR_THRESHOLDS_MAX];
+		/* Force the next sample, after a change of the thresholds. */
+		bool reset;
+		uint32_t last_bucket;
+		uint64_t last_sent_ns;
+	} monitor_filter;
+};
+
+/*
+ * Sub-buffers of a stream consumed by a batched read and not yet written to
+ * the output file, along with their packet indexes. The whole batch is written
+ * with a single write once the read completes.
+ */
+struct consumer_stream_batch {
+	/* Set while the stream is read in batch mode. */
+	unsigned int active:1;
+	char *buf;
+	size_t len;
+	size_t alloc_len;
+	/* Output file offset of the first byte of buf. */
+	off_t offset;
+	/* Length of the previous batch written, synced on the next flush. */
+	size_t prev_len;
+	struct ctf_packet_index *indexes;
+	unsigned int nr_indexes;
+	unsigned int alloc_indexes;
+};
+
+/* Asynchronous writeback state of a stream, see consumer-writeback.h. */
+struct consumer_stream_writeback {
+	/* Number of queued ranges not yet processed. Updated atomically. */
+	unsigned long pending;
+	/*
+	 * Incremented each time the output file is replaced or truncated.
+	 * Protected by the stream lock.
+	 */
+	unsigned int generation;
+	/* Eviction position, only used by the writeback thread. */
+	unsigned int evict_generation;
+	off_t evict_offset;
+};
+
+/*
+ * Consumption statistics of a stream, see struct lttng_stream_stats. Protected
+ * by the stream lock.
+ */
+struct consumer_stream_stats {
+	uint64_t bytes_consumed;
+	uint64_t subbufs_consumed;
+	uint64_t write_latency_hist[LTTNG_STREAM_STATS_LATENCY_BUCKETS];
+	uint64_t wakeup_delay_total;
+	uint64_t wakeup_delay_max;
 };
 
 /*
@@ -241,6 +426,16 @@ struct lttng_consumer_stream {
 	struct lttng_ht_node_u64 node_session_id;
 	/* Pointer to associated channel. */
 	struct lttng_consumer_channel *chan;
+	/*
+	 * Data shard consuming this stream. Set once the stream is added to the
+	 * data stream hash table; NULL for metadata streams.
+	 */
+	struct lttng_consumer_data_shard *data_shard;
+	/*
+	 * Metadata shard consuming this stream. Set once the stream is added to
+	 * the metadata stream hash table; NULL for data streams.
+	 */
+	struct lttng_consumer_metadata_shard *metadata_shard;
 
 	/* Key by which the stream is indexed for 'node'. */
 	uint64_t key;
@@ -249,10 +444,54 @@ struct lttng_consumer_stream {
 	 * socket fd for relayd streaming.
 	 */
 	int out_fd; /* output file to write the data */
+	/*
+	 * Directory of the local output files of a stream rotating through
+	 * tracefiles, relative to which they are rotated. -1 when unused.
+	 */
+	int out_dir_fd;
+	/*
+	 * Output directory of the trace chunk the local stream switches to on
+	 * its next packet, set by a session rotation. NULL when no rotation is
+	 * pending. Protected by the stream lock.
+	 */
+	char *rotate_path;
+	/*
+	 * Output directory of the current trace chunk of a rotated local
+	 * stream. NULL until the first rotation, the stream then writes in the
+	 * channel's path.
+	 */
+	char *chunk_path;
 	/* Write position in the output file descriptor */
 	off_t out_fd_offset;
 	/* Amount of bytes written to the output */
 	uint64_t output_written;
+	/*
+	 * Buffer usage of the last position sample of the monitor timer,
+	 * reused when the data thread holds the stream lock. Only accessed by
+	 * the timer thread.
+	 */
+	unsigned long monitor_last_usage;
+	/*
+	 * Asynchronous writer of the output file, created on the first write of
+	 * a CONSUMER_CHANNEL_MMAP_URING stream. Protected by the stream lock.
+	 */
+	struct lttng_io_uring *io_uring;
+	/*
+	 * Packet compressor, created on the first write of a data stream of a
+	 * compressed channel. Protected by the stream lock.
+	 */
+	struct consumer_compress *compress;
+	/* Batched read state. Protected by the stream lock. */
+	struct consumer_stream_batch batch;
+	struct consumer_stream_writeback writeback;
+	struct consumer_stream_stats stats;
+	/*
+	 * Set when the output file is opened with O_DIRECT. The data is then
+	 * written from aligned staging buffers. Protected by the stream lock.
+	 */
+	unsigned int out_fd_direct:1;
+	void *direct_buf;
+	size_t direct_buf_len;
 	enum lttng_consumer_stream_state state;
 	int shm_fd_is_copy;
 	int data_read;
@@ -277,6 +516,23 @@ struct lttng_consumer_stream {
 	 */
 	bool quiescent;
 
+	/*
+	 * Output and produced position of the last snapshot of the stream, from
+	 * which an incremental snapshot to the same output starts.
+	 *
+	 * NOTE: Update and read are protected by the stream lock.
+	 */
+	struct {
+		bool valid;
+		uint64_t output_id;
+		unsigned long produced_pos;
+	} last_snapshot;
+	/*
+	 * Number of packets captured by the snapshot in progress, 0 for all. See
+	 * consumer_snapshot_plan_streams().
+	 */
+	uint64_t snapshot_nb_packets;
+
 	/*
 	 * metadata_timer_lock protects flags waiting_on_metadata and
 	 * missed_metadata_flush.
@@ -291,6 +547,14 @@ struct lttng_consumer_stream {
 	/* Raised when a timer misses a metadata flush. */
 	bool missed_metadata_flush;
 
+	/*
+	 * Produced position sampled after the last switch of the load-aware
+	 * switch timer and number of consecutive periods skipped since.
+	 * Protected by the stream lock.
+	 */
+	unsigned long switch_produced_pos;
+	unsigned int switch_skipped;
+
 	enum lttng_event_output output;
 	/* Maximum subbuffer size. */
 	unsigned long max_sb_size;
@@ -325,6 +589,8 @@ struct lttng_consumer_stream {
 	 * of change.
 	 */
 	uint64_t metadata_version;
+	/* The tracer does not report the metadata version (kernel). */
+	unsigned int metadata_version_unsupported:1;
 	/* Used when the stream is set for network streaming */
 	uint64_t relayd_stream_id;
 	/*
@@ -360,11 +626,15 @@ struct lttng_consumer_stream {
 	 * consumer data appropriate pipe.
 	 */
 	enum consumer_endpoint_status endpoint_status;
+	/* CPU of the stream's buffer, -1 for a metadata stream. */
+	int cpu;
 	/* Stream name. Format is: <channel_name>_<cpu_number> */
 	char name[LTTNG_SYMBOL_NAME_LEN];
 	/* Internal state of libustctl. */
 	struct ustctl_consumer_stream *ustream;
 	struct cds_list_head send_node;
+	/* Node in the new_streams queue of the data shard. */
+	struct cds_wfcq_node handover_node;
 	/* On-disk circular buffer */
 	uint64_t tracefile_size_current;
 	uint64_t tracefile_count_current;
@@ -406,6 +676,11 @@ struct lttng_consumer_stream {
 	 * Local pipe to extract data when using splice.
 	 */
 	int splice_pipe[2];
+	/*
+	 * Local pipe used to splice the mmap'd sub-buffers of a snapshot to its
+	 * local output file. Created on first use.
+	 */
+	int snapshot_pipe[2];
 
 	/*
 	 * Rendez-vous point between data and metadata stream in live mode.
@@ -413,6 +688,15 @@ struct lttng_consumer_stream {
 	pthread_cond_t metadata_rdv;
 	pthread_mutex_t metadata_rdv_lock;
 
+	/*
+	 * Node in the data thread's list of streams that still have data to be
+	 * read, or of the streams removed from its poll set by the overload
+	 * shedding. Only used by the thread owning the stream's data shard.
+	 */
+	struct cds_list_head has_data_node;
+	/* Set while the stream is removed from the poll set by the shedding. */
+	unsigned int shed:1;
+
 	/* Indicate if the stream still has some data to be read. */
 	unsigned int has_data:1;
 	/*
@@ -425,6 +709,42 @@ struct lttng_consumer_stream {
 /*
  * Internal representation of a relayd socket pair.
  */
+/*
+ * Spooled packets of a relayd data connection, see consumer-spool.h. Each
+ * packet is stored as its data header followed by its payload. Protected by
+ * the lock of the data connection.
+ */
+struct consumer_spool {
+	/* Spool file, -1 until a packet is spooled. */
+	int fd;
+	/* Offset of the oldest spooled packet and of the end of the spool. */
+	off_t read_offset;
+	off_t write_offset;
+};
+
+/*
+ * Data connection of a relayd socket pair.
+ */
+struct consumer_relayd_data_sock {
+	/*
+	 * Mutex protecting the socket for the time of a packet header and its
+	 * payload, which can be sent by any data thread.
+	 *
+	 * This is nested INSIDE the stream lock.
+	 */
+	pthread_mutex_t lock;
+	struct lttcomm_relayd_sock sock;
+	struct consumer_spool spool;
+	/*
+	 * With the zero-copy sends, number of MSG_ZEROCOPY sends made and
+	 * completed on the socket, protected by the lock. The sub-buffer of a
+	 * packet is released once its sends are completed.
+	 */
+	unsigned int zerocopy:1;
+	uint32_t zerocopy_sent;
+	uint32_t zerocopy_completed;
+};
+
 struct consumer_relayd_sock_pair {
 	/* Network sequence number. */
 	uint64_t net_seq_idx;
@@ -453,16 +773,46 @@ struct consumer_relayd_sock_pair {
 	struct lttcomm_relayd_sock control_sock;
 
 	/*
-	 * We don't need a mutex at this point since we only splice or write single
-	 * large chunk of data with a header appended at the begining. Moreover,
-	 * this socket is for now only used in a single thread.
+	 * Data sockets. The first one is received from the session daemon and
+	 * the others are opened by the consumer to the same address. The
+	 * streams are spread among them by relayd stream id, so the packets of
+	 * a stream are always sent on the same connection.
 	 */
-	struct lttcomm_relayd_sock data_sock;
+	struct consumer_relayd_data_sock data_socks[DEFAULT_CONSUMERD_MAX_RELAYD_DATA_CONNECTIONS];
+	unsigned int nr_data_socks;
 	struct lttng_ht_node_u64 node;
 
 	/* Session id on both sides for the sockets. */
 	uint64_t relayd_session_id;
 	uint64_t sessiond_session_id;
+
+	/*
+	 * Last backpressure advertised by the relayd in an index reply: level
+	 * (enum lttcomm_relayd_backpressure), write lag of the session and
+	 * monotonic time of the reply (nsec). Updated with the control socket
+	 * mutex held, read without lock by the data threads.
+	 */
+	uint32_t backpressure;
+	uint64_t backpressure_lag_ns;
+	uint64_t backpressure_ts;
+
+	/*
+	 * Indexes queued by the data threads, encoded for RELAYD_SEND_INDEXES,
+	 * and monotonic time (nsec) at which the oldest was queued, see
+	 * consumer_relayd_send_index(). Protected by the control socket
+	 * mutex, the count is also read without it.
+	 */
+	struct lttcomm_relayd_index *pending_indexes;
+	unsigned int nr_pending_indexes;
+	uint64_t pending_indexes_ts;
+
+	/* Bytes spooled on all the data sockets. Updated atomically. */
+	uint64_t spool_bytes;
+	/*
+	 * Set when the relayd hung up, its spooled packets are then dropped
+	 * instead of being sent on destruction.
+	 */
+	unsigned int hung_up;
 };
 
 /*
@@ -528,25 +878,26 @@ struct lttng_consumer_local_data {
 	char *consumer_command_sock_path;
 	/* communication with splice */
 	int consumer_channel_pipe[2];
-	/* Data stream poll thread pipe. To transfer data stream to the thread */
-	struct lttng_pipe *consumer_data_pipe;
-
 	/*
-	 * Data thread use that pipe to catch wakeup from read subbuffer that
-	 * detects that there is still data to be read for the stream encountered.
-	 * Before doing so, the stream is flagged to indicate that there is still
-	 * data to be read.
-	 *
-	 * Both pipes (read/write) are owned and used inside the data thread.
+	 * Data stream consumption shards. One data poll thread is spawned per
+	 * shard.
 	 */
-	struct lttng_pipe *consumer_wakeup_pipe;
-	/* Indicate if the wakeup thread has been notified. */
-	unsigned int has_wakeup:1;
+	struct lttng_consumer_data_shard *data_shards;
+	unsigned int nr_data_shards;
+	/*
+	 * Number of data poll threads still running. The last one to exit closes
+	 * the write side of the metadata pipes.
+	 */
+	unsigned int nr_data_threads_active;
+	/*
+	 * Metadata stream consumption shards. One metadata poll thread is
+	 * spawned per shard.
+	 */
+	struct lttng_consumer_metadata_shard *metadata_shards;
+	unsigned int nr_metadata_shards;
 
 	/* to let the signal handler wake up the fd receiver thread */
 	int consumer_should_quit[2];
-	/* Metadata poll thread pipe. Transfer metadata stream to it */
-	struct lttng_pipe *consumer_metadata_pipe;
 	/*
 	 * Pipe used by the channel monitoring timers to provide state samples
 	 * to the session daemon (write-only).
@@ -559,9 +910,10 @@ struct lttng_consumer_local_data {
  */
 struct lttng_consumer_global_data {
 	/*
-	 * At this time, this lock is used to ensure coherence between the count
-	 * and number of element in the hash table. It's also a protection for
-	 * concurrent read/write between threads.
+	 * Serializes the structural changes of the channel hash table, that is
+	 * the addition and deletion of channels. Streams are added, deleted and
+	 * looked up without it: the stream hash tables are RCU protected and a
+	 * stream is serialized by its own lock.
 	 *
 	 * This is nested OUTSIDE the stream lock.
 	 * This is nested OUTSIDE the consumer_relayd_sock_pair lock.
@@ -570,17 +922,12 @@ struct lttng_consumer_global_data {
 
 	/*
 	 * Number of streams in the data stream hash table declared outside.
-	 * Protected by consumer_data.lock.
+	 * Updated atomically.
 	 */
 	int stream_count;
 
 	/* Channel hash table protected by consumer_data.lock. */
 	struct lttng_ht *channel_ht;
-	/*
-	 * Flag specifying if the local array of FDs needs update in the
-	 * poll function. Protected by consumer_data.lock.
-	 */
-	unsigned int need_update;
 	enum lttng_consumer_type type;
 
 	/*
@@ -602,6 +949,113 @@ struct lttng_consumer_global_data {
 	 * This HT uses the "node_channel_id" of the consumer stream.
 	 */
 	struct lttng_ht *stream_per_chan_id_ht;
+
+	/*
+	 * Maximum number of in-flight io_uring writes per data stream of the
+	 * mmap channels written locally. 0 disables the io_uring output. Set
+	 * once at startup.
+	 */
+	unsigned int io_uring_depth;
+
+	/*
+	 * Maximum number of bytes consumed from a local data stream by a single
+	 * batched read, written with one write. 0 disables batched reads. Set
+	 * once at startup.
+	 */
+	unsigned long batch_bytes;
+
+	/*
+	 * Preallocate the local tracefiles of data streams up to the tracefile
+	 * size of their channel and write them with direct I/O. Set once at
+	 * startup.
+	 */
+	unsigned int preallocate:1;
+	unsigned int direct_io:1;
+
+	/*
+	 * Bind the data threads to the NUMA nodes and consume each data stream
+	 * from a thread of the node of its CPU. Set once at startup, after
+	 * consumer_numa_init().
+	 */
+	unsigned int numa_affine:1;
+
+	/*
+	 * Maximum number of threads capturing the streams of a channel
+	 * snapshot, the thread handling the snapshot command included. Set once
+	 * at startup.
+	 */
+	unsigned int snapshot_threads;
+
+	/*
+	 * Maximum number of threads creating the output files of the streams
+	 * of a user space channel, the thread creating the channel included.
+	 * Set once at startup.
+	 */
+	unsigned int setup_threads;
+
+	/*
+	 * Splice the data sub-buffers of the snapshots written locally to their
+	 * output file instead of writing them. Set once at startup.
+	 */
+	unsigned int snapshot_splice:1;
+
+	/*
+	 * Period (usec) of the adaptive wakeup batching of the data threads, 0
+	 * if disabled. Set once at startup.
+	 */
+	unsigned int wakeup_batch_period_us;
+
+	/*
+	 * Maximal number of consecutive switch timer periods skipped for a quiet
+	 * stream of a user space data channel, 0 if the switch timer of the data
+	 * channels is left to the tracer. Set once at startup.
+	 */
+	unsigned int switch_skip_max;
+
+	/*
+	 * Number of data connections opened to each relayd. Set once at
+	 * startup.
+	 */
+	unsigned int relayd_data_connections;
+
+	/*
+	 * Reaction of the data streams to the backpressure of their relayd.
+	 * Set once at startup.
+	 */
+	enum consumer_backpressure_policy backpressure_policy;
+
+	/*
+	 * Compress the packets of the data streams of the uncompressed channels
+	 * sent to the relayds inflating them. Set once at startup.
+	 */
+	unsigned int relayd_compression:1;
+
+	/*
+	 * Release the UST metadata already committed to the metadata channels
+	 * from their cache, reloading it from the session daemon when a stream
+	 * needs it again. Set once at startup.
+	 */
+	unsigned int metadata_cache_trim:1;
+
+	/*
+	 * Send the packets of the data streams to the relayds with MSG_ZEROCOPY.
+	 * Set once at startup.
+	 */
+	unsigned int relayd_zerocopy:1;
+
+	/*
+	 * Leave the padding of the packets written to the local tracefiles as
+	 * holes. Set once at startup.
+	 */
+	unsigned int sparse_padding:1;
+
+	/*
+	 * Set by the session daemon while a channel of priority above 0 is
+	 * overloaded: the data threads stop consuming the streams of the
+	 * channels of priority 0, which keep their latest data in their ring
+	 * buffers like in snapshot mode. Accessed with CMM_LOAD/STORE_SHARED.
+	 */
+	int overload_shedding;
 };
 
 /*
@@ -672,6 +1126,8 @@ struct lttng_consumer_stream *consumer_allocate_stream(uint64_t channel_key,
 		int *alloc_ret,
 		enum consumer_channel_type type,
 		unsigned int monitor);
+enum consumer_channel_output consumer_channel_mmap_output(uint64_t relayd_id,
+		int monitor);
 struct lttng_consumer_channel *consumer_allocate_channel(uint64_t key,
 		uint64_t session_id,
 		const char *pathname,
@@ -698,8 +1154,35 @@ void consumer_del_channel(struct lttng_consumer_channel *channel);
 /* lttng-relayd consumer command */
 struct consumer_relayd_sock_pair *consumer_find_relayd(uint64_t key);
 int consumer_send_relayd_stream(struct lttng_consumer_stream *stream, char *path);
+int consumer_send_relayd_channel_streams(struct lttng_consumer_channel *channel,
+		char *path);
+
+/*
+ * Work on one stream of a channel.
+ *
+ * Return 0 on success or else a negative value.
+ */
+typedef int (*consumer_stream_work_cb)(struct lttng_consumer_stream *stream,
+		void *data);
+
+/*
+ * Call "cb" on every stream of the channel list of streams. The streams are
+ * spread over up to nr_threads threads, the calling thread included, so "cb"
+ * MUST only modify the state of the stream it is given. The work stops at the
+ * first error.
+ *
+ * The RCU read side lock MUST be acquired.
+ *
+ * Return 0 on success or else the first error returned by "cb".
+ */
+int consumer_channel_streams_run(struct lttng_consumer_channel *channel,
+		unsigned int nr_threads, consumer_stream_work_cb cb, void *data);
 int consumer_send_relayd_streams_sent(uint64_t net_seq_idx);
 void close_relayd_stream(struct lttng_consumer_stream *stream);
+void consumer_close_relayd_channel_streams(
+		struct lttng_consumer_channel *channel, uint64_t net_seq_idx);
+int consumer_rotate_channel(struct lttng_consumer_channel *channel,
+		const char *old_root, const char *new_root);
 struct lttng_consumer_channel *consumer_find_channel(uint64_t key);
 int consumer_handle_stream_before_relayd(struct lttng_consumer_stream *stream,
 		size_t data_size);
@@ -711,7 +1194,8 @@ struct lttng_consumer_local_data *lttng_consumer_create(
 			struct lttng_consumer_local_data *ctx),
 		int (*recv_channel)(struct lttng_consumer_channel *channel),
 		int (*recv_stream)(struct lttng_consumer_stream *stream),
-		int (*update_stream)(uint64_t sessiond_key, uint32_t state));
+		int (*update_stream)(uint64_t sessiond_key, uint32_t state),
+		unsigned int nr_data_shards, unsigned int nr_metadata_shards);
 void lttng_consumer_destroy(struct lttng_consumer_local_data *ctx);
 ssize_t lttng_consumer_on_read_subbuffer_mmap(
 		struct lttng_consumer_local_data *ctx,
@@ -726,6 +1210,12 @@ ssize_t lttng_consumer_on_read_subbuffer_splice(
 int lttng_consumer_take_snapshot(struct lttng_consumer_stream *stream);
 int lttng_consumer_get_produced_snapshot(struct lttng_consumer_stream *stream,
 		unsigned long *pos);
+int lttng_consumer_send_stream_stats(int sock, uint64_t channel_key);
+int lttng_consumer_send_channel_stats(int sock, uint64_t session_id);
+int consumer_set_channel_monitor_filter(uint64_t key, bool forward_all,
+		const uint64_t *thresholds, uint32_t nr_thresholds);
+void consumer_set_overload_shedding(struct lttng_consumer_local_data *ctx,
+		bool enable);
 int lttng_ustconsumer_get_wakeup_fd(struct lttng_consumer_stream *stream);
 int lttng_ustconsumer_close_wakeup_fd(struct lttng_consumer_stream *stream);
 void *consumer_thread_metadata_poll(void *data);
@@ -744,6 +1234,12 @@ int consumer_add_relayd_socket(uint64_t net_seq_idx, int sock_type,
 		uint64_t sessiond_id, uint64_t relayd_session_id);
 void consumer_flag_relayd_for_destroy(
 		struct consumer_relayd_sock_pair *relayd);
+void consumer_relayd_lock_control(struct consumer_relayd_sock_pair *relayd);
+int consumer_relayd_send_index(struct consumer_relayd_sock_pair *relayd,
+		struct lttng_consumer_stream *stream,
+		struct ctf_packet_index *element);
+void consumer_relayd_set_backpressure(struct consumer_relayd_sock_pair *relayd,
+		uint32_t backpressure, uint64_t write_lag_ns);
 int consumer_data_pending(uint64_t id);
 int consumer_send_status_msg(int sock, int ret_code);
 int consumer_send_status_channel(int sock,
@@ -754,9 +1250,18 @@ void consumer_destroy_relayd(struct consumer_relayd_sock_pair *relayd);
 unsigned long consumer_get_consume_start_pos(unsigned long consumed_pos,
 		unsigned long produced_pos, uint64_t nb_packets_per_stream,
 		uint64_t max_sb_size);
-int consumer_add_data_stream(struct lttng_consumer_stream *stream);
+unsigned long consumer_get_incremental_start_pos(
+		struct lttng_consumer_stream *stream, unsigned long start_pos,
+		uint64_t output_id);
+void consumer_set_last_snapshot_pos(struct lttng_consumer_stream *stream,
+		uint64_t output_id, unsigned long produced_pos);
+void consumer_handover_data_stream(struct lttng_consumer_stream *stream);
+int consumer_wakeup_data_shards(struct lttng_consumer_local_data *ctx);
+int consumer_add_data_stream(struct lttng_consumer_stream *stream,
+		struct lttng_consumer_local_data *ctx);
 void consumer_del_stream_for_data(struct lttng_consumer_stream *stream);
-int consumer_add_metadata_stream(struct lttng_consumer_stream *stream);
+int consumer_add_metadata_stream(struct lttng_consumer_stream *stream,
+		struct lttng_consumer_local_data *ctx);
 void consumer_del_stream_for_metadata(struct lttng_consumer_stream *stream);
 int consumer_create_index_file(struct lttng_consumer_stream *stream);
 
@@ -86,10 +86,241 @@
 #define DEFAULT_USTCONSUMERD32_CMD_SOCK_PATH    DEFAULT_USTCONSUMERD32_PATH "/command"
 #define DEFAULT_USTCONSUMERD32_ERR_SOCK_PATH    DEFAULT_USTCONSUMERD32_PATH "/error"
 
+/*
+ * Number of data consumption threads (data shards) of a consumer daemon. The
+ * environment variable is inherited by the consumer daemons spawned by the
+ * session daemon.
+ */
+#define DEFAULT_CONSUMERD_DATA_THREADS          1
+#define DEFAULT_CONSUMERD_MAX_DATA_THREADS      4096
+#define DEFAULT_CONSUMERD_DATA_THREADS_ENV      "LTTNG_CONSUMERD_DATA_THREADS"
+
+/*
+ * Number of in-flight io_uring writes per data stream of the mmap channels
+ * written locally. 0 keeps the blocking write() output. Each in-flight write
+ * holds a copy of one sub-buffer.
+ */
+#define DEFAULT_CONSUMERD_IO_URING_DEPTH        0
+#define DEFAULT_CONSUMERD_MAX_IO_URING_DEPTH    256
+#define DEFAULT_CONSUMERD_IO_URING_DEPTH_ENV    "LTTNG_CONSUMERD_IO_URING_DEPTH"
+
+/*
+ * Maximum number of bytes consumed from a local data stream per batched read.
+ * The batched sub-buffers are copied and written with a single write. 0 reads
+ * and writes one sub-buffer at a time.
+ */
+#define DEFAULT_CONSUMERD_BATCH_BYTES           0
+#define DEFAULT_CONSUMERD_MAX_BATCH_BYTES       (64 * 1024 * 1024)
+#define DEFAULT_CONSUMERD_BATCH_BYTES_ENV       "LTTNG_CONSUMERD_BATCH_BYTES"
+
+/*
+ * Asynchronous writeback of the trace files. The contiguous written ranges of
+ * a stream are merged up to the coalescing size and the given number of
+ * sub-buffers is kept in the page cache behind the write position.
+ */
+#define DEFAULT_CONSUMERD_ASYNC_WRITEBACK_ENV   "LTTNG_CONSUMERD_ASYNC_WRITEBACK"
+#define DEFAULT_CONSUMERD_WRITEBACK_COALESCE_BYTES (1024 * 1024)
+#define DEFAULT_CONSUMERD_WRITEBACK_COALESCE_ENV "LTTNG_CONSUMERD_WRITEBACK_COALESCE"
+#define DEFAULT_CONSUMERD_WRITEBACK_EVICT_LAG   1
+#define DEFAULT_CONSUMERD_WRITEBACK_EVICT_LAG_ENV "LTTNG_CONSUMERD_WRITEBACK_EVICT_LAG"
+
+/*
+ * Preallocation and direct I/O of the local tracefiles of data streams. Direct
+ * I/O writes are aligned on DEFAULT_CONSUMERD_DIRECT_IO_ALIGN; a file is
+ * switched back to buffered I/O on the first unaligned write.
+ */
+#define DEFAULT_CONSUMERD_PREALLOCATE_ENV       "LTTNG_CONSUMERD_PREALLOCATE"
+#define DEFAULT_CONSUMERD_DIRECT_IO_ENV         "LTTNG_CONSUMERD_DIRECT_IO"
+#define DEFAULT_CONSUMERD_DIRECT_IO_ALIGN       4096
+
+/* Bind the consumerd data threads to the NUMA nodes. */
+#define DEFAULT_CONSUMERD_NUMA_AFFINE_ENV       "LTTNG_CONSUMERD_NUMA_AFFINE"
+
+/*
+ * Number of threads capturing the streams of a channel snapshot in parallel.
+ */
+#define DEFAULT_CONSUMERD_SNAPSHOT_THREADS      1
+#define DEFAULT_CONSUMERD_MAX_SNAPSHOT_THREADS  256
+#define DEFAULT_CONSUMERD_SNAPSHOT_THREADS_ENV  "LTTNG_CONSUMERD_SNAPSHOT_THREADS"
+
+/*
+ * Number of threads creating the output files of the per-CPU streams of a
+ * user space channel in parallel.
+ */
+#define DEFAULT_CONSUMERD_SETUP_THREADS         1
+#define DEFAULT_CONSUMERD_MAX_SETUP_THREADS     256
+#define DEFAULT_CONSUMERD_SETUP_THREADS_ENV     "LTTNG_CONSUMERD_SETUP_THREADS"
+
+/*
+ * Number of metadata consumption threads (metadata shards) of a consumer
+ * daemon. The environment variable is inherited by the consumer daemons
+ * spawned by the session daemon.
+ */
+#define DEFAULT_CONSUMERD_METADATA_THREADS      1
+#define DEFAULT_CONSUMERD_MAX_METADATA_THREADS  256
+#define DEFAULT_CONSUMERD_METADATA_THREADS_ENV  "LTTNG_CONSUMERD_METADATA_THREADS"
+
+/*
+ * Release the UST metadata committed to the metadata channels from the
+ * consumerd metadata caches.
+ */
+#define DEFAULT_CONSUMERD_METADATA_CACHE_TRIM_ENV "LTTNG_CONSUMERD_METADATA_CACHE_TRIM"
+
+/* Splice the snapshots written locally from the ring buffer mmap. */
+#define DEFAULT_CONSUMERD_SNAPSHOT_SPLICE_ENV   "LTTNG_CONSUMERD_SNAPSHOT_SPLICE"
+
+/*
+ * Adaptive wakeup batching of the data threads. A data thread woken up more
+ * than once per batching period on average over a window of
+ * DEFAULT_CONSUMERD_WAKEUP_BATCH_WINDOW periods polls its streams once per
+ * period until it finds no ready stream. A period of 0 disables it.
+ */
+#define DEFAULT_CONSUMERD_WAKEUP_BATCH_PERIOD   0
+#define DEFAULT_CONSUMERD_MAX_WAKEUP_BATCH_PERIOD 1000000	/* usec */
+#define DEFAULT_CONSUMERD_WAKEUP_BATCH_PERIOD_ENV "LTTNG_CONSUMERD_WAKEUP_BATCH_PERIOD"
+#define DEFAULT_CONSUMERD_WAKEUP_BATCH_WINDOW   16
+
+/*
+ * Load-aware switch timer of the user space data channels. When not 0, the
+ * consumer runs the switch timer of the data channels instead of the tracer,
+ * spreads the channel timers over their period and skips the switch of a
+ * stream which produced less than 1/DEFAULT_CONSUMERD_SWITCH_QUIET_DIV of a
+ * sub-buffer since its last switch, up to this many consecutive periods.
+ */
+#define DEFAULT_CONSUMERD_SWITCH_SKIP_MAX       0
+#define DEFAULT_CONSUMERD_MAX_SWITCH_SKIP_MAX   64
+#define DEFAULT_CONSUMERD_SWITCH_SKIP_MAX_ENV   "LTTNG_CONSUMERD_SWITCH_SKIP_MAX"
+#define DEFAULT_CONSUMERD_SWITCH_QUIET_DIV      8
+
+/*
+ * Number of data connections opened by the consumer to each relayd. The
+ * streams of a session are spread among them.
+ */
+#define DEFAULT_CONSUMERD_RELAYD_DATA_CONNECTIONS 1
+#define DEFAULT_CONSUMERD_MAX_RELAYD_DATA_CONNECTIONS 16
+#define DEFAULT_CONSUMERD_RELAYD_DATA_CONNECTIONS_ENV "LTTNG_CONSUMERD_RELAYD_DATA_CONNECTIONS"
+
+/*
+ * Packet indexes queued by a data thread for a relayd before they are sent
+ * in a single message, and maximal delay (usec) of a queued index.
+ */
+#define DEFAULT_CONSUMERD_RELAYD_INDEX_BATCH    64
+#define DEFAULT_CONSUMERD_RELAYD_INDEX_BATCH_DELAY 10000
+
+/*
+ * Reaction of the data streams to the backpressure advertised by their relayd:
+ * "none", "throttle" (delay each packet by the write lag of the relayd, up to
+ * DEFAULT_CONSUMERD_BACKPRESSURE_MAX_DELAY usec) or "discard" (also discard
+ * the packets while the relayd is saturated). An advertisement is applied for
+ * DEFAULT_CONSUMERD_BACKPRESSURE_TTL usec, after which a packet is sent to
+ * get a fresh one.
+ */
+#define DEFAULT_CONSUMERD_BACKPRESSURE          "none"
+#define DEFAULT_CONSUMERD_BACKPRESSURE_ENV      "LTTNG_CONSUMERD_BACKPRESSURE"
+#define DEFAULT_CONSUMERD_BACKPRESSURE_MAX_DELAY 100000
+#define DEFAULT_CONSUMERD_BACKPRESSURE_TTL      200000
+
+/*
+ * Compress the data packets sent to the relayds advertising
+ * RELAYD_FEATURE_WIRE_COMPRESSION.
+ */
+#define DEFAULT_CONSUMERD_RELAYD_COMPRESSION_ENV "LTTNG_CONSUMERD_RELAYD_COMPRESSION"
+
+/*
+ * Send the data packets of at least DEFAULT_CONSUMERD_ZEROCOPY_MIN_BYTES to
+ * the relayds with MSG_ZEROCOPY, releasing their sub-buffer once the kernel
+ * notifies the completion of the send. The completion is awaited at most
+ * DEFAULT_CONSUMERD_ZEROCOPY_POLL_MS at a time between checks of the socket.
+ */
+#define DEFAULT_CONSUMERD_RELAYD_ZEROCOPY_ENV   "LTTNG_CONSUMERD_RELAYD_ZEROCOPY"
+#define DEFAULT_CONSUMERD_ZEROCOPY_MIN_BYTES    16384
+#define DEFAULT_CONSUMERD_ZEROCOPY_POLL_MS      100
+
+/*
+ * Leave the padding of at least DEFAULT_CONSUMERD_SPARSE_PADDING_MIN_BYTES of
+ * the packets written to the local tracefiles as holes instead of writing it
+ * out.
+ */
+#define DEFAULT_CONSUMERD_SPARSE_PADDING_ENV    "LTTNG_CONSUMERD_SPARSE_PADDING"
+#define DEFAULT_CONSUMERD_SPARSE_PADDING_MIN_BYTES 4096
+
+/* Scheduling policy and CPU affinity of each type of consumerd thread. */
+#define DEFAULT_CONSUMERD_THREAD_SCHED_ENV      "LTTNG_CONSUMERD_THREAD_SCHED"
+
+/* Consumption priority of the channels, by channel name pattern. */
+#define DEFAULT_CONSUMERD_CHANNEL_PRIORITY_ENV  "LTTNG_CONSUMERD_CHANNEL_PRIORITY"
+#define DEFAULT_CONSUMERD_CHANNEL_PRIORITY_MAX  16
+
+/*
+ * Local spool of the packets sent to a stalled relayd data connection. The
+ * spool is disabled unless a directory is set. The spooled packets of a relayd
+ * are bounded by the spool size and replayed every replay period (usec) while
+ * the connection stays stalled.
+ */
+#define DEFAULT_CONSUMERD_SPOOL_DIR_ENV         "LTTNG_CONSUMERD_SPOOL_DIR"
+#define DEFAULT_CONSUMERD_SPOOL_SIZE            (256 * 1024 * 1024)
+#define DEFAULT_CONSUMERD_SPOOL_SIZE_ENV        "LTTNG_CONSUMERD_SPOOL_SIZE"
+#define DEFAULT_CONSUMERD_SPOOL_REPLAY_PERIOD   10000
+
+/*
+ * Once the session daemon has set the usage thresholds of a channel, the
+ * monitoring samples of the channel are only sent when its usage crosses one
+ * of them, and at least once per heartbeat period (usec) otherwise.
+ */
+#define DEFAULT_CONSUMERD_MONITOR_HEARTBEAT_PERIOD 5000000
+
+/*
+ * Colon-separated roots of the striped output, under which the tracefiles
+ * written locally are spread. The output is not striped by default.
+ */
+#define DEFAULT_CONSUMERD_STRIPE_PATHS_ENV      "LTTNG_CONSUMERD_STRIPE_PATHS"
+
+/* Level of the zlib compression of the packets of compressed channels. */
+#define DEFAULT_CONSUMERD_ZLIB_LEVEL            1
+
+/* Size of the transparent huge pages backing huge pages channels. */
+#define DEFAULT_CONSUMERD_THP_SIZE_PATH         "/sys/kernel/mm/transparent_hugepage/hpage_pmd_size"
+
 /* Relayd path */
 #define DEFAULT_RELAYD_RUNDIR			"%s"
 #define DEFAULT_RELAYD_PATH			DEFAULT_RELAYD_RUNDIR "/relayd"
 
+/* Number of relayd worker threads handling the consumer connections. */
+#define DEFAULT_RELAYD_WORKERS			1
+#define DEFAULT_RELAYD_LISTENERS		1
+#define DEFAULT_RELAYD_MAX_WORKERS		256
+
+/* Number of relayd worker threads handling the live viewer connections. */
+#define DEFAULT_RELAYD_LIVE_WORKERS		1
+
+/* Number of indexes of a stream written to its index file at once. */
+#define DEFAULT_RELAYD_INDEX_BATCH		32
+#define DEFAULT_RELAYD_MAX_INDEX_BATCH		1024
+
+/*
+ * Number of the last indexes of each live stream kept in memory for the
+ * viewers. 0 disables the index ring.
+ */
+#define DEFAULT_RELAYD_INDEX_RING		64
+#define DEFAULT_RELAYD_MAX_INDEX_RING		65536
+
+/*
+ * Number of in-flight io_uring writes per relayd data stream. 0 disables the
+ * io_uring output.
+ */
+#define DEFAULT_RELAYD_IO_URING_DEPTH		0
+#define DEFAULT_RELAYD_MAX_IO_URING_DEPTH	256
+
+/*
+ * Write lag (msec) of a session above which the relayd advertises
+ * backpressure to its consumers. 0 disables the backpressure.
+ */
+#define DEFAULT_RELAYD_BACKPRESSURE_LAG		100
+#define DEFAULT_RELAYD_MAX_BACKPRESSURE_LAG	60000
+
+/* Store of the deduplicated metadata files, relative to the output path. */
+#define DEFAULT_RELAYD_METADATA_STORE_DIR	".metadata-store"
+
 /* Default lttng run directory */
 #define DEFAULT_LTTNG_HOME_ENV_VAR              "LTTNG_HOME"
 #define DEFAULT_LTTNG_FALLBACK_HOME_ENV_VAR	"HOME"
@@ -124,6 +355,8 @@
 /* Default relay health unix socket path */
 #define DEFAULT_GLOBAL_RELAY_HEALTH_UNIX_SOCK		DEFAULT_LTTNG_RUNDIR "/relayd/health-%d"
 #define DEFAULT_HOME_RELAY_HEALTH_UNIX_SOCK		DEFAULT_LTTNG_HOME_RUNDIR "/relayd/health-%d"
+#define DEFAULT_GLOBAL_RELAY_STATS_UNIX_SOCK		DEFAULT_LTTNG_RUNDIR "/relayd/stats-%d"
+#define DEFAULT_HOME_RELAY_STATS_UNIX_SOCK		DEFAULT_LTTNG_HOME_RUNDIR "/relayd/stats-%d"
 
 /* Default daemon configuration file path */
 #define DEFAULT_SYSTEM_CONFIGPATH               CONFIG_LTTNG_SYSTEM_CONFIGDIR \
@@ -266,6 +499,13 @@
 #define DEFAULT_NETWORK_DATA_PORT           CONFIG_DEFAULT_NETWORK_DATA_PORT
 #define DEFAULT_NETWORK_VIEWER_PORT         CONFIG_DEFAULT_NETWORK_VIEWER_PORT
 
+/* Socket options of the network URI tuning profiles. */
+#define DEFAULT_SOCK_THROUGHPUT_BUF_SIZE    (4 * 1024 * 1024)   /* bytes */
+#define DEFAULT_SOCK_LATENCY_BUSY_POLL      50                  /* usec */
+#define DEFAULT_SOCK_KEEPALIVE_IDLE         60                  /* sec */
+#define DEFAULT_SOCK_KEEPALIVE_INTVL        10                  /* sec */
+#define DEFAULT_SOCK_KEEPALIVE_CNT          6
+
 /* Agent registration TCP port. */
 #define DEFAULT_AGENT_TCP_PORT              CONFIG_DEFAULT_AGENT_TCP_PORT
 
@@ -276,11 +516,21 @@
 #define DEFAULT_HEALTH_CHECK_DELTA_S        20
 #define DEFAULT_HEALTH_CHECK_DELTA_NS       0
 
+/*
+ * Time during which the health of the threads is not checked again to reply
+ * to the health queries, see health_check_all().
+ */
+#define DEFAULT_HEALTH_CHECK_CACHE_NS       (500 * 1000000ULL)
+
 /*
  * Wait period before retrying the lttng_data_pending command in the lttng
- * stop command of liblttng-ctl.
+ * stop command of liblttng-ctl. The first retries wait
+ * DEFAULT_DATA_AVAILABILITY_MIN_WAIT_TIME, doubled on each retry up to
+ * DEFAULT_DATA_AVAILABILITY_WAIT_TIME, so that a quick completion is
+ * noticed right away.
  */
 #define DEFAULT_DATA_AVAILABILITY_WAIT_TIME 200000  /* usec */
+#define DEFAULT_DATA_AVAILABILITY_MIN_WAIT_TIME 5000  /* usec */
 
 /*
  * Wait period before retrying the lttng_consumer_flushed_cache when
@@ -301,6 +551,76 @@
 #define DEFAULT_APP_SOCKET_RW_TIMEOUT       CONFIG_DEFAULT_APP_SOCKET_RW_TIMEOUT
 #define DEFAULT_APP_SOCKET_TIMEOUT_ENV      "LTTNG_APP_SOCKET_TIMEOUT"
 
+/*
+ * When not 0, the session daemon closes its copy of the file descriptors of
+ * the channel objects once they are sent to the applications.
+ */
+#define DEFAULT_APP_FD_FRUGAL               0
+#define DEFAULT_APP_FD_FRUGAL_ENV           "LTTNG_APP_FD_FRUGAL"
+
+/*
+ * Number of threads updating the newly registered applications concurrently
+ * with the registration dispatch thread, and maximum number of applications
+ * registered at once.
+ */
+#define DEFAULT_APP_UPDATE_THREADS          0
+#define DEFAULT_APP_UPDATE_THREADS_MAX      256
+#define DEFAULT_APP_UPDATE_BATCH            64
+
+/*
+ * Number of threads saving the sessions concurrently when all the sessions
+ * are saved, the client thread included.
+ */
+#define DEFAULT_SAVE_THREADS                1
+#define DEFAULT_SAVE_THREADS_MAX            64
+
+/*
+ * Number of threads loading the session configuration files of a directory
+ * concurrently at launch, the load thread included.
+ */
+#define DEFAULT_LOAD_THREADS                1
+#define DEFAULT_LOAD_THREADS_MAX            64
+
+/* Maximum size of a session configuration document loaded by a client. */
+#define DEFAULT_SESSION_DEFINITION_MAX_SIZE (16 * 1024 * 1024)
+
+/*
+ * Maximum number of exited applications unregistered at once, and of hash
+ * tables destroyed at once by the session daemon hash table cleanup thread.
+ */
+#define DEFAULT_APP_UNREGISTER_BATCH        64
+#define DEFAULT_HT_CLEANUP_BATCH            64
+
+/* Maximum number of threads loading the kernel probe modules. */
+#define DEFAULT_KMOD_PROBES_LOAD_THREADS	4
+
+/*
+ * Time during which the session daemon reuses the kernel event list it read,
+ * in nanoseconds. The list is read again when a probe module is loaded or
+ * unloaded by the session daemon.
+ */
+#define DEFAULT_KERNEL_EVENT_LIST_CACHE_VALIDITY	1000000000ULL   /* 1 sec */
+
+/*
+ * Maximum number of UIDs of which the session daemon creates the per UID
+ * buffers at session start.
+ */
+#define DEFAULT_UST_PREWARM_UIDS_MAX        64
+
+/*
+ * Number of threads running the client commands. A thread dedicated to the
+ * read-only commands is launched in addition.
+ */
+#define DEFAULT_CLIENT_THREADS              1
+#define DEFAULT_CLIENT_THREADS_MAX          64
+
+/*
+ * Number of threads handling the notifications of the applications, over
+ * which the applications are spread.
+ */
+#define DEFAULT_APP_NOTIFY_THREADS          1
+#define DEFAULT_APP_NOTIFY_THREADS_MAX      64
+
 #define DEFAULT_UST_STREAM_FD_NUM			2 /* Number of fd per UST stream. */
 
 #define DEFAULT_SNAPSHOT_NAME				"snapshot"
@@ -309,6 +629,8 @@
 /* Suffix of an index file. */
 #define DEFAULT_INDEX_FILE_SUFFIX			".idx"
 #define DEFAULT_INDEX_DIR					"index"
+/* Time range summary of the index files of a trace, in its index directory. */
+#define DEFAULT_INDEX_SUMMARY_FILE			"summary"
 
 /* Default lttng command live timer value in usec. */
 #define DEFAULT_LTTNG_LIVE_TIMER			CONFIG_DEFAULT_LTTNG_LIVE_TIMER
@@ -316,6 +638,14 @@
 /* Default runas worker name */
 #define DEFAULT_RUN_AS_WORKER_NAME			"lttng-runas"
 
+/*
+ * Number of run_as worker processes of a daemon. The commands of concurrent
+ * threads are executed in parallel by different workers.
+ */
+#define DEFAULT_RUN_AS_WORKERS				1
+#define DEFAULT_RUN_AS_MAX_WORKERS			64
+#define DEFAULT_RUN_AS_WORKERS_ENV			"LTTNG_RUN_AS_WORKERS"
+
 /* Default LTTng MI XML namespace. */
 #define DEFAULT_LTTNG_MI_NAMESPACE		"http://lttng.org/xml/ns/lttng-mi"
 
@@ -328,6 +658,13 @@
 /* Default maximal size of message notification channel message payloads. */
 #define DEFAULT_CLIENT_MAX_QUEUED_NOTIFICATIONS_COUNT		100
 
+/*
+ * Number of threads evaluating the channel samples of the notification
+ * thread, which evaluates them itself when there are none.
+ */
+#define DEFAULT_NOTIFICATION_THREADS		0
+#define DEFAULT_NOTIFICATION_THREADS_MAX	64
+
 /*
  * Returns the default subbuf size.
  *
@@ -18,6 +18,7 @@
 #include <common/dynamic-buffer.h>
 #include <common/utils.h>
 #include <assert.h>
+#include <stdbool.h>
 
 /*
  * Round to (upper) power of two, val is returned if it already is a power of
@@ -44,6 +45,25 @@ void lttng_dynamic_buffer_init(struct lttng_dynamic_buffer *buffer)
 	memset(buffer, 0, sizeof(*buffer));
 }
 
+LTTNG_HIDDEN
+void lttng_dynamic_buffer_init_with_storage(
+		struct lttng_dynamic_buffer *buffer,
+		void *storage, size_t storage_len)
+{
+	lttng_dynamic_buffer_init(buffer);
+	buffer->data = storage;
+	buffer->_capacity = storage_len;
+	buffer->_storage = storage;
+	buffer->_storage_len = storage_len;
+}
+
+/* Whether the data of the buffer is its user-provided storage. */
+static
+bool in_storage(const struct lttng_dynamic_buffer *buffer)
+{
+	return buffer->_storage && buffer->data == buffer->_storage;
+}
+
 LTTNG_HIDDEN
 int lttng_dynamic_buffer_append(struct lttng_dynamic_buffer *buffer,
 		const void *buf, size_t len)
@@ -93,9 +113,8 @@ end:
 	return ret;
 }
 
-LTTNG_HIDDEN
-int lttng_dynamic_buffer_set_size(struct lttng_dynamic_buffer *buffer,
-		size_t new_size)
+static
+int set_size(struct lttng_dynamic_buffer *buffer, size_t new_size, bool zero)
 {
 	int ret = 0;
 
@@ -108,24 +127,18 @@ int lttng_dynamic_buffer_set_size(struct lttng_dynamic_buffer *buffer,
 	}
 
 	if (new_size > buffer->_capacity) {
-		size_t original_size = buffer->size;
-		size_t original_capacity = buffer->_capacity;
-
 		ret = lttng_dynamic_buffer_set_capacity(buffer, new_size);
 		if (ret) {
 			goto end;
 		}
+	}
 
-		/*
-		 * Zero-initialize the space that was left in the buffer at the
-		 * before we increased its capacity (original capacity - original size).
-		 * The newly acquired capacity (new capacity - original capacity)
-		 * is zeroed by lttng_dynamic_buffer_set_capacity().
-		 */
-		memset(buffer->data + original_size, 0,
-				original_capacity - original_size);
-	} else if (new_size > buffer->size) {
-		memset(buffer->data + buffer->size, 0, new_size - buffer->size);
+	if (new_size > buffer->size) {
+		/* Neither realloc() nor a storage zero the acquired area. */
+		if (zero) {
+			memset(buffer->data + buffer->size, 0,
+					new_size - buffer->size);
+		}
 	} else {
 		/*
 		 * Shrinking size. There is no need to zero-out the newly
@@ -142,6 +155,20 @@ end:
 	return ret;
 }
 
+LTTNG_HIDDEN
+int lttng_dynamic_buffer_set_size(struct lttng_dynamic_buffer *buffer,
+		size_t new_size)
+{
+	return set_size(buffer, new_size, true);
+}
+
+LTTNG_HIDDEN
+int lttng_dynamic_buffer_set_size_no_zero(struct lttng_dynamic_buffer *buffer,
+		size_t new_size)
+{
+	return set_size(buffer, new_size, false);
+}
+
 LTTNG_HIDDEN
 int lttng_dynamic_buffer_set_capacity(struct lttng_dynamic_buffer *buffer,
 		size_t demanded_capacity)
@@ -163,11 +190,25 @@ int lttng_dynamic_buffer_set_capacity(struct lttng_dynamic_buffer *buffer,
 		goto end;
 	}
 
-	/* Memory is initialized by the size increases. */
-	new_buf = realloc(buffer->data, new_capacity);
-	if (!new_buf) {
-		ret = -1;
-		goto end;
+	if (in_storage(buffer)) {
+		if (demanded_capacity <= buffer->_storage_len) {
+			/* The storage is never shrunk. */
+			goto end;
+		}
+		/* Outgrowing the storage, move the content to the heap. */
+		new_buf = malloc(new_capacity);
+		if (!new_buf) {
+			ret = -1;
+			goto end;
+		}
+		memcpy(new_buf, buffer->data, buffer->size);
+	} else {
+		/* Memory is initialized by the size increases. */
+		new_buf = realloc(buffer->data, new_capacity);
+		if (!new_buf) {
+			ret = -1;
+			goto end;
+		}
 	}
 	buffer->data = new_buf;
 	buffer->_capacity = new_capacity;
@@ -182,7 +223,73 @@ void lttng_dynamic_buffer_reset(struct lttng_dynamic_buffer *buffer)
 	if (!buffer) {
 		return;
 	}
+	if (!in_storage(buffer)) {
+		free(buffer->data);
+	}
+	buffer->data = buffer->_storage;
+	buffer->size = 0;
+	buffer->_capacity = buffer->_storage_len;
+}
+
+LTTNG_HIDDEN
+int lttng_dynamic_buffer_move(struct lttng_dynamic_buffer *dst_buffer,
+		struct lttng_dynamic_buffer *src_buffer)
+{
+	int ret = 0;
+
+	if (!dst_buffer || !src_buffer || dst_buffer == src_buffer) {
+		ret = -1;
+		goto end;
+	}
+
+	lttng_dynamic_buffer_reset(dst_buffer);
+	if (in_storage(src_buffer) || !src_buffer->data) {
+		ret = lttng_dynamic_buffer_append_buffer(dst_buffer,
+				src_buffer);
+		if (ret) {
+			goto end;
+		}
+		src_buffer->size = 0;
+		goto end;
+	}
+
+	/* Hand the heap memory over, leaving the storage of dst unused. */
+	dst_buffer->data = src_buffer->data;
+	dst_buffer->size = src_buffer->size;
+	dst_buffer->_capacity = src_buffer->_capacity;
+	src_buffer->data = src_buffer->_storage;
+	src_buffer->size = 0;
+	src_buffer->_capacity = src_buffer->_storage_len;
+end:
+	return ret;
+}
+
+LTTNG_HIDDEN
+void *lttng_dynamic_buffer_steal(struct lttng_dynamic_buffer *buffer,
+		size_t *size)
+{
+	void *content = NULL;
+
+	if (!buffer || !size) {
+		goto end;
+	}
+
+	if (in_storage(buffer) || !buffer->data) {
+		/* Never return NULL for an empty content. */
+		content = malloc(buffer->size ? buffer->size : 1);
+		if (!content) {
+			goto end;
+		}
+		if (buffer->size) {
+			memcpy(content, buffer->data, buffer->size);
+		}
+	} else {
+		content = buffer->data;
+	}
+	*size = buffer->size;
+	buffer->data = buffer->_storage;
 	buffer->size = 0;
-	buffer->_capacity = 0;
-	free(buffer->data);
+	buffer->_capacity = buffer->_storage_len;
+end:
+	return content;
 }
@@ -31,6 +31,13 @@ struct lttng_dynamic_buffer {
 	 * internal use only.
 	 */
 	size_t _capacity;
+	/*
+	 * Storage provided by the user, used until the buffer outgrows it. The
+	 * buffer only owns its data when it is not this storage. These fields
+	 * are meant for internal use only.
+	 */
+	char *_storage;
+	size_t _storage_len;
 };
 
 /*
@@ -40,6 +47,19 @@ struct lttng_dynamic_buffer {
 LTTNG_HIDDEN
 void lttng_dynamic_buffer_init(struct lttng_dynamic_buffer *buffer);
 
+/*
+ * Initialize a dynamic buffer which uses "storage", typically an array on the
+ * stack, until its content exceeds "storage_len" bytes. The small messages
+ * built in such a buffer need no allocation.
+ *
+ * "storage" must outlive the buffer and must not be accessed directly while
+ * the buffer is in use.
+ */
+LTTNG_HIDDEN
+void lttng_dynamic_buffer_init_with_storage(
+		struct lttng_dynamic_buffer *buffer,
+		void *storage, size_t storage_len);
+
 /*
  * Append the content of a raw memory buffer to the end of a dynamic buffer
  * (after its current "size"). The dynamic buffer's size is increased by
@@ -78,6 +98,15 @@ LTTNG_HIDDEN
 int lttng_dynamic_buffer_set_size(struct lttng_dynamic_buffer *buffer,
 		size_t new_size);
 
+/*
+ * Same as lttng_dynamic_buffer_set_size(), but the areas acquired by a size
+ * increase are left uninitialized. The caller must fill them, for instance
+ * by serializing an object in place.
+ */
+LTTNG_HIDDEN
+int lttng_dynamic_buffer_set_size_no_zero(struct lttng_dynamic_buffer *buffer,
+		size_t new_size);
+
 /*
  * Set the buffer's capacity to accomodate the new_capacity, allocating memory
  * as necessary. The buffer's content is preserved. Setting a buffer's capacity
@@ -90,8 +119,35 @@ LTTNG_HIDDEN
 int lttng_dynamic_buffer_set_capacity(struct lttng_dynamic_buffer *buffer,
 		size_t new_capacity);
 
-/* Release any memory used by the dynamic buffer. */
+/*
+ * Release any memory used by the dynamic buffer. The buffer is then empty and
+ * can be used again, with its storage if it was initialized with one.
+ */
 LTTNG_HIDDEN
 void lttng_dynamic_buffer_reset(struct lttng_dynamic_buffer *buffer);
 
+/*
+ * Move the content of "src_buffer" to "dst_buffer", which is reset first.
+ * Heap memory is handed over without copy, the content of a storage is
+ * copied. "src_buffer" is left empty.
+ *
+ * Return 0 on success or else a negative value, in which case "src_buffer"
+ * is left untouched.
+ */
+LTTNG_HIDDEN
+int lttng_dynamic_buffer_move(struct lttng_dynamic_buffer *dst_buffer,
+		struct lttng_dynamic_buffer *src_buffer);
+
+/*
+ * Take ownership of the content of the buffer, which is left empty. The
+ * returned memory must be released with free(3); it is copied out of the
+ * storage of the buffer if needed. "size" is set to the size of the content.
+ *
+ * Return the content or NULL on error, in which case the buffer is left
+ * untouched.
+ */
+LTTNG_HIDDEN
+void *lttng_dynamic_buffer_steal(struct lttng_dynamic_buffer *buffer,
+		size_t *size);
+
 #endif /* LTTNG_DYNAMIC_BUFFER_H */
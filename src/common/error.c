@@ -190,6 +190,8 @@ static const char *error_string_array[] = {
 	[ ERROR_INDEX(LTTNG_ERR_TRIGGER_EXISTS) ] = "Trigger already registered",
 	[ ERROR_INDEX(LTTNG_ERR_TRIGGER_NOT_FOUND) ] = "Trigger not found",
 	[ ERROR_INDEX(LTTNG_ERR_COMMAND_CANCELLED) ] = "Command cancelled",
+	[ ERROR_INDEX(LTTNG_ERR_COMPRESSION_UNSUPPORTED) ] = "Channel compression is not supported by this configuration",
+	[ ERROR_INDEX(LTTNG_ERR_ROTATION_UNSUPPORTED) ] = "Rotation is only supported by the user space sessions written locally",
 
 	/* Last element */
 	[ ERROR_INDEX(LTTNG_ERR_NR) ] = "Unknown error code"
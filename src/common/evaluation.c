@@ -17,6 +17,7 @@
 
 #include <lttng/condition/evaluation-internal.h>
 #include <lttng/condition/buffer-usage-internal.h>
+#include <lttng/condition/channel-rate-internal.h>
 #include <common/macros.h>
 #include <common/error.h>
 #include <stdbool.h>
@@ -86,6 +87,22 @@ ssize_t lttng_evaluation_create_from_buffer(
 		}
 		evaluation_size += ret;
 		break;
+	case LTTNG_CONDITION_TYPE_CHANNEL_RATE_LOW:
+		ret = lttng_evaluation_channel_rate_low_create_from_buffer(
+				&evaluation_view, evaluation);
+		if (ret < 0) {
+			goto end;
+		}
+		evaluation_size += ret;
+		break;
+	case LTTNG_CONDITION_TYPE_CHANNEL_RATE_HIGH:
+		ret = lttng_evaluation_channel_rate_high_create_from_buffer(
+				&evaluation_view, evaluation);
+		if (ret < 0) {
+			goto end;
+		}
+		evaluation_size += ret;
+		break;
 	default:
 		ERR("Attempted to create evaluation of unknown type (%i)",
 				(int) evaluation_comm->type);
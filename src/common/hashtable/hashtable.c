@@ -20,6 +20,7 @@
 #include <string.h>
 #include <urcu.h>
 #include <urcu/compiler.h>
+#include <urcu/tls-compat.h>
 
 #include <common/common.h>
 #include <common/defaults.h>
@@ -35,6 +36,16 @@ unsigned long lttng_ht_seed;
 static unsigned long min_hash_alloc_size = 1;
 static unsigned long max_hash_buckets_size = 0;
 
+/* Objects queued in a thread batch before it is flushed regardless. */
+#define THREAD_BATCH_MAX_COUNT	4096
+
+struct thread_batch {
+	bool started;
+	struct lttng_ht_free_batch batch;
+};
+
+static DEFINE_URCU_TLS(struct thread_batch, thread_batch);
+
 /*
  * Getter/lookup functions need to be called with RCU read-side lock
  * held. However, modification functions (add, add_unique, replace, del)
@@ -86,6 +97,15 @@ static int match_two_u64(struct cds_lfht_node *node, const void *key)
 	return hash_match_key_two_u64((void *) &match_node->key, (void *) key);
 }
 
+/*
+ * Hash function for the LTTNG_HT_TYPE_FAST_U64 nodes, for the generic
+ * functions.
+ */
+static unsigned long hash_fast_u64(void *key, unsigned long seed)
+{
+	return lttng_ht_mix_u64(*(uint64_t *) key, seed);
+}
+
 /*
  * Return an allocated lttng hashtable.
  */
@@ -136,6 +156,10 @@ struct lttng_ht *lttng_ht_new(unsigned long size, int type)
 		ht->match_fct = match_two_u64;
 		ht->hash_fct = hash_key_two_u64;
 		break;
+	case LTTNG_HT_TYPE_FAST_U64:
+		ht->match_fct = lttng_ht_match_fast_u64;
+		ht->hash_fct = hash_fast_u64;
+		break;
 	default:
 		ERR("Unknown lttng hashtable type %d", type);
 		lttng_ht_destroy(ht);
@@ -572,6 +596,141 @@ struct lttng_ht_node_u64 *lttng_ht_iter_get_node_u64(
 	return caa_container_of(node, struct lttng_ht_node_u64, node);
 }
 
+struct free_batch_rcu {
+	struct rcu_head head;
+	unsigned long count;
+	struct lttng_ht_free_entry *entries;
+};
+
+static void free_batch_rcu(struct rcu_head *head)
+{
+	struct free_batch_rcu *batch =
+		caa_container_of(head, struct free_batch_rcu, head);
+	unsigned long i;
+
+	for (i = 0; i < batch->count; i++) {
+		batch->entries[i].func(batch->entries[i].head);
+	}
+	free(batch->entries);
+	free(batch);
+}
+
+/*
+ * Queue an object in a free batch.
+ */
+LTTNG_HIDDEN
+void lttng_ht_free_batch_add(struct lttng_ht_free_batch *batch,
+		struct rcu_head *head, void (*func)(struct rcu_head *head))
+{
+	assert(head);
+	assert(func);
+
+	if (!batch) {
+		call_rcu(head, func);
+		return;
+	}
+	if (batch->count == batch->alloc) {
+		struct lttng_ht_free_entry *new_entries;
+		unsigned long new_alloc = max_t(unsigned long,
+				batch->alloc << 1, 64);
+
+		new_entries = realloc(batch->entries,
+				new_alloc * sizeof(*new_entries));
+		if (!new_entries) {
+			/* Give this object a grace period of its own. */
+			call_rcu(head, func);
+			return;
+		}
+		batch->entries = new_entries;
+		batch->alloc = new_alloc;
+	}
+	batch->entries[batch->count].head = head;
+	batch->entries[batch->count].func = func;
+	batch->count++;
+}
+
+/*
+ * Free the objects of a batch after a single grace period.
+ */
+LTTNG_HIDDEN
+void lttng_ht_free_batch_commit(struct lttng_ht_free_batch *batch)
+{
+	struct free_batch_rcu *rcu_batch;
+	unsigned long i;
+
+	assert(batch);
+
+	if (!batch->count) {
+		goto end;
+	}
+	rcu_batch = zmalloc(sizeof(*rcu_batch));
+	if (!rcu_batch) {
+		/* Fall back on one grace period per object. */
+		for (i = 0; i < batch->count; i++) {
+			call_rcu(batch->entries[i].head, batch->entries[i].func);
+		}
+		free(batch->entries);
+		goto end;
+	}
+	rcu_batch->count = batch->count;
+	rcu_batch->entries = batch->entries;
+	call_rcu(&rcu_batch->head, free_batch_rcu);
+end:
+	batch->count = 0;
+	batch->alloc = 0;
+	batch->entries = NULL;
+}
+
+/*
+ * Start the free batch of the calling thread.
+ */
+LTTNG_HIDDEN
+void lttng_ht_thread_batch_start(void)
+{
+	URCU_TLS(thread_batch).started = true;
+}
+
+/*
+ * Start the grace period of the objects queued by the calling thread.
+ */
+LTTNG_HIDDEN
+void lttng_ht_thread_batch_flush(void)
+{
+	if (URCU_TLS(thread_batch).batch.count) {
+		lttng_ht_free_batch_commit(&URCU_TLS(thread_batch).batch);
+	}
+}
+
+/*
+ * Flush and stop the free batch of the calling thread.
+ */
+LTTNG_HIDDEN
+void lttng_ht_thread_batch_stop(void)
+{
+	lttng_ht_thread_batch_flush();
+	URCU_TLS(thread_batch).started = false;
+}
+
+/*
+ * Call func(head) after a grace period, like call_rcu(), sharing the grace
+ * period of the free batch of the calling thread if it is started.
+ */
+LTTNG_HIDDEN
+void lttng_ht_defer_free(struct rcu_head *head,
+		void (*func)(struct rcu_head *head))
+{
+	struct thread_batch *tbatch = &URCU_TLS(thread_batch);
+
+	if (!tbatch->started) {
+		call_rcu(head, func);
+		return;
+	}
+	lttng_ht_free_batch_add(&tbatch->batch, head, func);
+	if (tbatch->batch.count >= THREAD_BATCH_MAX_COUNT) {
+		lttng_ht_free_batch_commit(&tbatch->batch);
+	}
+}
+
 /*
  * Return lttng ht stream and index id node from iterator.
  */
@@ -34,6 +34,12 @@ enum lttng_ht_type {
 	LTTNG_HT_TYPE_ULONG,
 	LTTNG_HT_TYPE_U64,
 	LTTNG_HT_TYPE_TWO_U64,
+	/*
+	 * lttng_ht_node_u64 nodes hashed by lttng_ht_mix_u64() instead of the
+	 * Jenkins hash, for the tables looked up on hot paths. Their lookups
+	 * can be inlined with lttng_ht_lookup_fast_u64().
+	 */
+	LTTNG_HT_TYPE_FAST_U64,
 };
 
 struct lttng_ht {
@@ -75,6 +81,23 @@ struct lttng_ht_node_two_u64 {
 	struct rcu_head head;
 };
 
+struct lttng_ht_free_entry {
+	struct rcu_head *head;
+	void (*func)(struct rcu_head *head);
+};
+
+/*
+ * Objects removed from hash tables and freed after a single grace period,
+ * with one call_rcu() for the whole batch instead of one per object. This is
+ * meant for the teardown of tables holding many nodes. A batch must be
+ * zero-initialized.
+ */
+struct lttng_ht_free_batch {
+	unsigned long count;
+	unsigned long alloc;
+	struct lttng_ht_free_entry *entries;
+};
+
 /* Hashtable new and destroy */
 LTTNG_HIDDEN
 struct lttng_ht *lttng_ht_new(unsigned long size, int type);
@@ -147,6 +170,37 @@ void lttng_ht_get_next(struct lttng_ht *ht, struct lttng_ht_iter *iter);
 LTTNG_HIDDEN
 unsigned long lttng_ht_get_count(struct lttng_ht *ht);
 
+/*
+ * Queue func(head) to be called after the grace period of the batch, like
+ * call_rcu(). A NULL batch calls call_rcu() directly.
+ */
+LTTNG_HIDDEN
+void lttng_ht_free_batch_add(struct lttng_ht_free_batch *batch,
+		struct rcu_head *head, void (*func)(struct rcu_head *head));
+/*
+ * Start the grace period of the queued objects and reset the batch.
+ */
+LTTNG_HIDDEN
+void lttng_ht_free_batch_commit(struct lttng_ht_free_batch *batch);
+
+/*
+ * Free batch of the calling thread. A thread with natural quiescent points,
+ * such as the top of its poll loop, starts its batch and flushes it at these
+ * points: lttng_ht_defer_free() then queues the objects freed by the thread
+ * in its batch, which is also flushed once it grows large. Without a started
+ * batch, lttng_ht_defer_free() calls call_rcu() directly. Stopping the batch
+ * flushes it.
+ */
+LTTNG_HIDDEN
+void lttng_ht_thread_batch_start(void);
+LTTNG_HIDDEN
+void lttng_ht_thread_batch_flush(void);
+LTTNG_HIDDEN
+void lttng_ht_thread_batch_stop(void);
+LTTNG_HIDDEN
+void lttng_ht_defer_free(struct rcu_head *head,
+		void (*func)(struct rcu_head *head));
+
 LTTNG_HIDDEN
 struct lttng_ht_node_str *lttng_ht_iter_get_node_str(
 		struct lttng_ht_iter *iter);
@@ -160,4 +214,48 @@ LTTNG_HIDDEN
 struct lttng_ht_node_two_u64 *lttng_ht_iter_get_node_two_u64(
 		struct lttng_ht_iter *iter);
 
+/*
+ * Hash of a key of a LTTNG_HT_TYPE_FAST_U64 table: the 64-bit finalizer of
+ * MurmurHash3 applied to the seeded key, which mixes every key bit into
+ * every hash bit in a few instructions.
+ */
+static inline
+unsigned long lttng_ht_mix_u64(uint64_t key, unsigned long seed)
+{
+	uint64_t h = key ^ (uint64_t) seed;
+
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+#if (CAA_BITS_PER_LONG == 64)
+	return (unsigned long) h;
+#else
+	return (unsigned long) (h ^ (h >> 32));
+#endif
+}
+
+static inline
+int lttng_ht_match_fast_u64(struct cds_lfht_node *node, const void *key)
+{
+	const struct lttng_ht_node_u64 *match_node =
+		caa_container_of(node, struct lttng_ht_node_u64, node);
+
+	return match_node->key == *(const uint64_t *) key;
+}
+
+/*
+ * Lookup of a key in a LTTNG_HT_TYPE_FAST_U64 table, equivalent to
+ * lttng_ht_lookup() without its indirect hash call. Must be called with the
+ * RCU read side lock held.
+ */
+static inline
+void lttng_ht_lookup_fast_u64(struct lttng_ht *ht, uint64_t key,
+		struct lttng_ht_iter *iter)
+{
+	cds_lfht_lookup(ht->ht, lttng_ht_mix_u64(key, lttng_ht_seed),
+			lttng_ht_match_fast_u64, &key, &iter->iter);
+}
+
 #endif /* _LTT_HT_H */
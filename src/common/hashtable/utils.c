@@ -498,6 +498,15 @@ unsigned long hash_key_str(void *key, unsigned long seed)
 	return hashlittle(key, strlen((char *) key), seed);
 }
 
+/*
+ * Hash function for a buffer of "len" bytes.
+ */
+LTTNG_HIDDEN
+unsigned long hash_key_buf(const void *key, size_t len, unsigned long seed)
+{
+	return hashlittle(key, len, seed);
+}
+
 /*
  * Hash function for two uint64_t.
  */
@@ -18,11 +18,13 @@
 #ifndef _LTT_HT_UTILS_H
 #define _LTT_HT_UTILS_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 unsigned long hash_key_ulong(void *_key, unsigned long seed);
 unsigned long hash_key_u64(void *_key, unsigned long seed);
 unsigned long hash_key_str(void *key, unsigned long seed);
+unsigned long hash_key_buf(const void *key, size_t len, unsigned long seed);
 unsigned long hash_key_two_u64(void *key, unsigned long seed);
 int hash_match_key_ulong(void *key1, void *key2);
 int hash_match_key_u64(void *key1, void *key2);
@@ -21,6 +21,7 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #include <common/defaults.h>
@@ -51,6 +52,13 @@ struct health_app {
 	struct timespec time_delta;
 	/* Health flags containing thread type error state */
 	enum health_flags *flags;
+	/*
+	 * Result of the last health_check_all() and its monotonic time
+	 * (nsec), served to the queries of the next
+	 * DEFAULT_HEALTH_CHECK_CACHE_NS. Protected by lock.
+	 */
+	uint64_t cached_bad_types;
+	uint64_t cached_ns;
 };
 
 /* Define TLS health state. */
@@ -160,25 +168,18 @@ static int time_diff_gt(const struct timespec *time_a,
  *
  * Return 0 if health is bad or else 1.
  */
-static int validate_state(struct health_app *ha, struct health_state *state)
+static int validate_state(struct health_app *ha, struct health_state *state,
+		const struct timespec *now)
 {
-	int retval = 1, ret;
+	int retval = 1;
 	unsigned long current, last;
-	struct timespec current_time;
+	struct timespec current_time = *now;
 
 	assert(state);
 
 	last = state->last;
 	current = uatomic_read(&state->current);
 
-	ret = lttng_clock_gettime(CLOCK_MONOTONIC, &current_time);
-	if (ret < 0) {
-		PERROR("Error reading time\n");
-		/* error */
-		retval = 0;
-		goto end;
-	}
-
 	/*
 	 * Thread is in bad health if flag HEALTH_ERROR is set. It is also in bad
 	 * health if, after the delta delay has passed, its the progress counter
@@ -218,7 +219,7 @@ static int validate_state(struct health_app *ha, struct health_state *state)
 
 end:
 	DBG("Health state current %lu, last %lu, ret %d",
-			current, last, ret);
+			current, last, retval);
 	return retval;
 }
 
@@ -233,9 +234,15 @@ int health_check_state(struct health_app *ha, int type)
 {
 	int retval = 1;
 	struct health_state *state;
+	struct timespec now;
 
 	assert(type < ha->nr_types);
 
+	if (lttng_clock_gettime(CLOCK_MONOTONIC, &now) < 0) {
+		PERROR("Error reading time\n");
+		return 0;
+	}
+
 	state_lock(ha);
 
 	cds_list_for_each_entry(state, &ha->list, node) {
@@ -245,7 +252,7 @@ int health_check_state(struct health_app *ha, int type)
 			continue;
 		}
 
-		ret = validate_state(ha, state);
+		ret = validate_state(ha, state, &now);
 		if (!ret) {
 			retval = 0;
 			goto end;
@@ -265,6 +272,63 @@ end:
 	return retval;
 }
 
+/*
+ * Check the health of every type at once, with a single pass on the thread
+ * states. The result is reused for DEFAULT_HEALTH_CHECK_CACHE_NS, which is
+ * well below the health check time delta, so that frequent queries do not
+ * each walk the thread states.
+ *
+ * Return the mask of the types in bad health, bit "type" being set if
+ * health_check_state() would return 0 for it.
+ */
+uint64_t health_check_all(struct health_app *ha)
+{
+	uint64_t bad_types = 0, now_ns;
+	struct health_state *state;
+	struct timespec now;
+	int i;
+
+	assert(ha->nr_types <= 64);
+
+	now_ns = lttng_monotonic_time_ns();
+	if (!now_ns) {
+		ERR("Error reading time");
+		return (1ULL << ha->nr_types) - 1;
+	}
+	now.tv_sec = now_ns / NSEC_PER_SEC;
+	now.tv_nsec = now_ns % NSEC_PER_SEC;
+
+	state_lock(ha);
+	if (ha->cached_ns &&
+			now_ns - ha->cached_ns < DEFAULT_HEALTH_CHECK_CACHE_NS) {
+		bad_types = ha->cached_bad_types;
+		goto end;
+	}
+
+	cds_list_for_each_entry(state, &ha->list, node) {
+		/*
+		 * Validate every state, even of a type already in bad health,
+		 * to keep their samples up to date.
+		 */
+		if (!validate_state(ha, state, &now)) {
+			bad_types |= 1ULL << state->type;
+		}
+	}
+	/* Check the global state since some state might not be visible anymore. */
+	for (i = 0; i < ha->nr_types; i++) {
+		if (ha->flags[i] & HEALTH_ERROR) {
+			bad_types |= 1ULL << i;
+		}
+	}
+	ha->cached_bad_types = bad_types;
+	ha->cached_ns = now_ns;
+end:
+	state_unlock(ha);
+
+	DBG("Health check of every type returns %" PRIx64, bad_types);
+	return bad_types;
+}
+
 /*
  * Init health state.
  */
@@ -279,6 +343,12 @@ void health_register(struct health_app *ha, int type)
 	uatomic_set(&URCU_TLS(health_state).current, 0);
 	uatomic_set(&URCU_TLS(health_state).flags, 0);
 	uatomic_set(&URCU_TLS(health_state).type, type);
+	/* The thread is busy until its first poll() entry. */
+	URCU_TLS(health_state).last_poll_ns = lttng_monotonic_time_ns();
+	URCU_TLS(health_state).busy_ns = 0;
+	URCU_TLS(health_state).idle_ns = 0;
+	memset(URCU_TLS(health_state).latency, 0,
+			sizeof(URCU_TLS(health_state).latency));
 
 	/* Add it to the global TLS state list. */
 	state_lock(ha);
@@ -303,3 +373,48 @@ void health_unregister(struct health_app *ha)
 	cds_list_del(&URCU_TLS(health_state).node);
 	state_unlock(ha);
 }
+
+ssize_t health_create_stats(struct health_app *ha,
+		struct health_comm_stats **stats)
+{
+	struct health_comm_stats *all_stats;
+	struct health_state *state;
+	size_t len;
+	uint64_t now;
+
+	len = sizeof(*all_stats) + ha->nr_types * sizeof(all_stats->types[0]);
+	all_stats = zmalloc(len);
+	if (!all_stats) {
+		PERROR("zmalloc health stats");
+		return -1;
+	}
+	all_stats->nr_types = ha->nr_types;
+	all_stats->nr_buckets = LTTNG_HEALTH_LATENCY_NR_BUCKETS;
+
+	now = lttng_monotonic_time_ns();
+	state_lock(ha);
+	cds_list_for_each_entry(state, &ha->list, node) {
+		struct health_comm_type_stats *type_stats =
+				&all_stats->types[state->type];
+		uint64_t last = CMM_LOAD_SHARED(state->last_poll_ns);
+		uint64_t current_ns = now > last ? now - last : 0;
+		unsigned int i;
+
+		type_stats->busy_ns += CMM_LOAD_SHARED(state->busy_ns);
+		type_stats->idle_ns += CMM_LOAD_SHARED(state->idle_ns);
+		/* Account for the ongoing iteration or wait. */
+		if (HEALTH_IS_IN_POLL(uatomic_read(&state->current))) {
+			type_stats->idle_ns += current_ns;
+		} else {
+			type_stats->busy_ns += current_ns;
+		}
+		for (i = 0; i < LTTNG_HEALTH_LATENCY_NR_BUCKETS; i++) {
+			type_stats->latency[i] +=
+					CMM_LOAD_SHARED(state->latency[i]);
+		}
+	}
+	state_unlock(ha);
+
+	*stats = all_stats;
+	return len;
+}
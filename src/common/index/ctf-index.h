@@ -29,7 +29,7 @@
 
 #define CTF_INDEX_MAGIC 0xC1F1DCC1
 #define CTF_INDEX_MAJOR 1
-#define CTF_INDEX_MINOR 1
+#define CTF_INDEX_MINOR 2
 
 /*
  * Header at the beginning of each index file.
@@ -58,6 +58,29 @@ struct ctf_packet_index {
 	/* CTF_INDEX 1.0 limit */
 	uint64_t stream_instance_id;	/* ID of the channel instance */
 	uint64_t packet_seq_num;	/* packet sequence number */
+	/* CTF_INDEX 1.1 limit */
+	uint64_t events_count;		/* events in the packet, -1ULL if unknown */
+} __attribute__((__packed__));
+
+#define CTF_INDEX_SUMMARY_MAGIC 0xC1F15CC1
+#define CTF_INDEX_SUMMARY_NAME_LEN 256
+
+/*
+ * Entry of the summary file of a trace, appended when the index file of one
+ * of its tracefiles is closed. A reader can skip the tracefiles whose time
+ * range is out of its interest without opening them. In tracefile count
+ * mode, the last entry of a stream name and tracefile id is the current
+ * one. All integer fields are stored in big endian.
+ */
+struct ctf_index_summary_entry {
+	uint32_t magic;
+	/* struct ctf_index_summary_entry len, in bytes */
+	uint32_t entry_len;
+	char stream_name[CTF_INDEX_SUMMARY_NAME_LEN];
+	uint64_t tracefile_id;
+	uint64_t packet_count;
+	uint64_t timestamp_begin;	/* earliest packet timestamp_begin */
+	uint64_t timestamp_end;		/* latest packet timestamp_end */
 } __attribute__((__packed__));
 
 static inline size_t ctf_packet_index_len(uint32_t major, uint32_t minor)
@@ -72,6 +95,10 @@ static inline size_t ctf_packet_index_len(uint32_t major, uint32_t minor)
 			return offsetof(struct ctf_packet_index, packet_seq_num)
 				+ member_sizeof(struct ctf_packet_index,
 						packet_seq_num);
+		case 2:
+			return offsetof(struct ctf_packet_index, events_count)
+				+ member_sizeof(struct ctf_packet_index,
+						events_count);
 		default:
 			abort();
 		}
@@ -19,6 +19,7 @@
 
 #define _LGPL_SOURCE
 #include <assert.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <fcntl.h>
@@ -26,10 +27,111 @@
 #include <common/common.h>
 #include <common/defaults.h>
 #include <common/compat/endian.h>
+#include <common/runas.h>
 #include <common/utils.h>
 
 #include "index.h"
 
+/*
+ * Prepare the summary of a created index file. The summary is best effort: it
+ * is not kept on error.
+ */
+static void init_summary(struct lttng_index_file *index_file,
+		const char *index_dir, const char *stream_name, int uid, int gid,
+		uint64_t size, uint64_t count)
+{
+	int ret;
+	struct lttng_index_summary *summary = &index_file->summary;
+
+	ret = asprintf(&summary->path, "%s/" DEFAULT_INDEX_SUMMARY_FILE,
+			index_dir);
+	if (ret < 0) {
+		PERROR("asprintf index summary path");
+		summary->path = NULL;
+		return;
+	}
+	summary->stream_name = strdup(stream_name);
+	if (!summary->stream_name) {
+		PERROR("strdup index summary stream name");
+		free(summary->path);
+		summary->path = NULL;
+		return;
+	}
+	/* See utils_stream_file_name(). */
+	summary->tracefile_id = size > 0 ? count : 0;
+	summary->uid = uid;
+	summary->gid = gid;
+	summary->timestamp_begin = -1ULL;
+}
+
+/*
+ * Append the summary of a created index file to the summary file of its
+ * trace. The entry is written at once so that the index files of the other
+ * streams can be summarized concurrently.
+ */
+static void write_summary(const struct lttng_index_summary *summary)
+{
+	int fd, flags, mode;
+	ssize_t ret;
+	struct ctf_index_summary_entry entry;
+
+	if (!summary->path || !summary->packet_count) {
+		return;
+	}
+
+	memset(&entry, 0, sizeof(entry));
+	entry.magic = htobe32(CTF_INDEX_SUMMARY_MAGIC);
+	entry.entry_len = htobe32(sizeof(entry));
+	strncpy(entry.stream_name, summary->stream_name,
+			sizeof(entry.stream_name) - 1);
+	entry.tracefile_id = htobe64(summary->tracefile_id);
+	entry.packet_count = htobe64(summary->packet_count);
+	entry.timestamp_begin = htobe64(summary->timestamp_begin);
+	entry.timestamp_end = htobe64(summary->timestamp_end);
+
+	flags = O_WRONLY | O_CREAT | O_APPEND;
+	/* Open with 660 mode */
+	mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP;
+	if (summary->uid < 0 || summary->gid < 0) {
+		fd = open(summary->path, flags, mode);
+	} else {
+		fd = run_as_open(summary->path, flags, mode, summary->uid,
+				summary->gid);
+	}
+	if (fd < 0) {
+		PERROR("open index summary %s", summary->path);
+		return;
+	}
+	ret = lttng_write(fd, &entry, sizeof(entry));
+	if (ret < sizeof(entry)) {
+		PERROR("write index summary");
+	}
+	if (close(fd)) {
+		PERROR("close index summary");
+	}
+}
+
+void lttng_index_file_account(struct lttng_index_file *index_file,
+		const struct ctf_packet_index *element)
+{
+	uint64_t timestamp_begin, timestamp_end;
+	struct lttng_index_summary *summary = &index_file->summary;
+
+	if (!summary->path) {
+		return;
+	}
+
+	timestamp_begin = be64toh(element->timestamp_begin);
+	timestamp_end = be64toh(element->timestamp_end);
+	if (timestamp_begin < summary->timestamp_begin) {
+		summary->timestamp_begin = timestamp_begin;
+	}
+	if (timestamp_end > summary->timestamp_end) {
+		summary->timestamp_end = timestamp_end;
+	}
+	summary->packet_count++;
+}
+
 /*
  * Create the index file associated with a trace file.
  *
@@ -103,6 +205,7 @@ struct lttng_index_file *lttng_index_file_create(char *path_name,
 	index_file->major = major;
 	index_file->minor = minor;
 	index_file->element_len = element_len;
+	init_summary(index_file, fullpath, stream_name, uid, gid, size, count);
 	urcu_ref_init(&index_file->ref);
 
 	return index_file;
@@ -125,7 +228,7 @@ error:
  *
  * Return 0 on success, -1 on error.
  */
-int lttng_index_file_write(const struct lttng_index_file *index_file,
+int lttng_index_file_write(struct lttng_index_file *index_file,
 		const struct ctf_packet_index *element)
 {
 	int fd;
@@ -147,6 +250,7 @@ int lttng_index_file_write(const struct lttng_index_file *index_file,
 		PERROR("writing index file");
 		goto error;
 	}
+	lttng_index_file_account(index_file, element);
 	return 0;
 
 error:
@@ -182,6 +286,126 @@ error:
 	return -1;
 }
 
+/*
+ * Map the index entries of the given index file.
+ *
+ * Return 0 on success, -1 on error.
+ */
+int lttng_index_map(const struct lttng_index_file *index_file,
+		struct lttng_index_map *map)
+{
+	int ret;
+	struct stat st;
+
+	assert(index_file);
+	assert(map);
+
+	memset(map, 0, sizeof(*map));
+	map->element_len = index_file->element_len;
+
+	ret = fstat(index_file->fd, &st);
+	if (ret < 0) {
+		PERROR("fstat index file");
+		goto error;
+	}
+	if (st.st_size <= (off_t) sizeof(struct ctf_packet_index_file_hdr)) {
+		/* No entry yet. */
+		return 0;
+	}
+
+	map->len = st.st_size;
+	map->addr = mmap(NULL, map->len, PROT_READ, MAP_SHARED,
+			index_file->fd, 0);
+	if (map->addr == MAP_FAILED) {
+		PERROR("mmap index file");
+		map->addr = NULL;
+		goto error;
+	}
+	map->entries = (const char *) map->addr +
+			sizeof(struct ctf_packet_index_file_hdr);
+	/* A partially written last entry is ignored. */
+	map->count = (map->len - sizeof(struct ctf_packet_index_file_hdr)) /
+			map->element_len;
+	return 0;
+
+error:
+	memset(map, 0, sizeof(*map));
+	return -1;
+}
+
+void lttng_index_unmap(struct lttng_index_map *map)
+{
+	if (map->addr && munmap(map->addr, map->len)) {
+		PERROR("munmap index file");
+	}
+	memset(map, 0, sizeof(*map));
+}
+
+/*
+ * Read the entry "pos" of the given index map.
+ *
+ * Return 0 on success, -1 if there is no such entry.
+ */
+int lttng_index_map_read(const struct lttng_index_map *map, uint64_t pos,
+		struct ctf_packet_index *element)
+{
+	assert(map);
+	assert(element);
+
+	if (pos >= map->count) {
+		return -1;
+	}
+	memset(element, 0, sizeof(*element));
+	memcpy(element, map->entries + pos * map->element_len,
+			map->element_len);
+	return 0;
+}
+
+static uint64_t map_timestamp_begin(const struct lttng_index_map *map,
+		uint64_t pos)
+{
+	uint64_t timestamp_begin;
+
+	/* Part of every index version, possibly unaligned. */
+	memcpy(&timestamp_begin, map->entries + pos * map->element_len +
+			offsetof(struct ctf_packet_index, timestamp_begin),
+			sizeof(timestamp_begin));
+	return be64toh(timestamp_begin);
+}
+
+/*
+ * Binary search of the packet of the given index map containing
+ * "timestamp".
+ *
+ * Return 0 on success, -1 if the map is empty.
+ */
+int lttng_index_map_find(const struct lttng_index_map *map,
+		uint64_t timestamp, uint64_t *pos)
+{
+	uint64_t low = 0, high;
+
+	assert(map);
+	assert(pos);
+
+	if (!map->count) {
+		return -1;
+	}
+
+	/* The answer is in [low, high). */
+	high = map->count;
+	while (high - low > 1) {
+		uint64_t mid = low + (high - low) / 2;
+
+		if (map_timestamp_begin(map, mid) <= timestamp) {
+			low = mid;
+		} else {
+			high = mid;
+		}
+	}
+	*pos = low;
+	return 0;
+}
+
 /*
  * Open index file using a given path, channel name and tracefile count.
  *
@@ -291,6 +515,9 @@ static void lttng_index_file_release(struct urcu_ref *ref)
 	if (close(index_file->fd)) {
 		PERROR("close index fd");
 	}
+	write_summary(&index_file->summary);
+	free(index_file->summary.path);
+	free(index_file->summary.stream_name);
 	free(index_file);
 }
 
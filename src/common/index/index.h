@@ -25,14 +25,41 @@
 
 #include "ctf-index.h"
 
+/* Time range of the packets of a created index file. */
+struct lttng_index_summary {
+	/* Summary file of the trace, NULL if the summary is not kept. */
+	char *path;
+	char *stream_name;
+	uint64_t tracefile_id;
+	int uid;
+	int gid;
+	uint64_t packet_count;
+	uint64_t timestamp_begin;
+	uint64_t timestamp_end;
+};
+
 struct lttng_index_file {
 	int fd;
 	uint32_t major;
 	uint32_t minor;
 	uint32_t element_len;
+	struct lttng_index_summary summary;
 	struct urcu_ref ref;
 };
 
+/*
+ * Read-only mapping of the entries of an index file, as they are at the
+ * time of the mapping. The entries are element_len bytes long, in big
+ * endian.
+ */
+struct lttng_index_map {
+	void *addr;
+	size_t len;
+	const char *entries;
+	uint32_t element_len;
+	uint64_t count;
+};
+
 /*
  * create and open have refcount of 1. Use put to decrement the
  * refcount. Destroys when reaching 0. Use "get" to increment refcount.
@@ -43,11 +70,37 @@ struct lttng_index_file *lttng_index_file_create(char *path_name,
 struct lttng_index_file *lttng_index_file_open(const char *path_name,
 		const char *channel_name, uint64_t tracefile_count,
 		uint64_t tracefile_count_current);
-int lttng_index_file_write(const struct lttng_index_file *index_file,
+int lttng_index_file_write(struct lttng_index_file *index_file,
+		const struct ctf_packet_index *element);
+/*
+ * Account an element written to a created index file in its summary.
+ * lttng_index_file_write() does it, for the callers writing the elements
+ * themselves.
+ */
+void lttng_index_file_account(struct lttng_index_file *index_file,
 		const struct ctf_packet_index *element);
 int lttng_index_file_read(const struct lttng_index_file *index_file,
 		struct ctf_packet_index *element);
 
+/*
+ * Map the entries of an index file. An empty file gives an empty map. Use
+ * lttng_index_unmap() to release the mapping, and map again to see the
+ * entries appended since.
+ */
+int lttng_index_map(const struct lttng_index_file *index_file,
+		struct lttng_index_map *map);
+void lttng_index_unmap(struct lttng_index_map *map);
+/* Copy the entry "pos" of a map, zeroing the fields the file lacks. */
+int lttng_index_map_read(const struct lttng_index_map *map, uint64_t pos,
+		struct ctf_packet_index *element);
+/*
+ * Find the last entry of a map whose packet begins at or before
+ * "timestamp", or the first entry if every packet begins after it. The
+ * packets of a stream are in timestamp_begin order.
+ */
+int lttng_index_map_find(const struct lttng_index_map *map,
+		uint64_t timestamp, uint64_t *pos);
+
 void lttng_index_file_get(struct lttng_index_file *index_file);
 void lttng_index_file_put(struct lttng_index_file *index_file);
 
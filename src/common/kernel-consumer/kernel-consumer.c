@@ -40,9 +40,11 @@
 #include <common/pipe.h>
 #include <common/relayd/relayd.h>
 #include <common/utils.h>
+#include <common/consumer/consumer-snapshot.h>
 #include <common/consumer/consumer-stream.h>
 #include <common/index/index.h>
 #include <common/consumer/consumer-timer.h>
+#include <common/consumer/consumer-writeback.h>
 
 #include "kernel-consumer.h"
 
@@ -118,231 +120,272 @@ int lttng_kconsumer_get_consumed_snapshot(struct lttng_consumer_stream *stream,
 	return ret;
 }
 
+/* Parameters of the snapshot of a channel, shared by its streams. */
+struct snapshot_channel_data {
+	char *path;
+	uint64_t relayd_id;
+	unsigned int incremental:1;
+	uint64_t output_id;
+	struct lttng_consumer_local_data *ctx;
+};
+
+static int get_index_values(struct ctf_packet_index *index, int infd);
+
 /*
- * Take a snapshot of all the stream of a channel
+ * Sample the positions of a stream for the planning of a snapshot.
  *
  * Returns 0 on success, < 0 on error
  */
-int lttng_kconsumer_snapshot_channel(uint64_t key, char *path,
-		uint64_t relayd_id, uint64_t nb_packets_per_stream,
-		struct lttng_consumer_local_data *ctx)
+static int sample_stream(struct lttng_consumer_stream *stream,
+		unsigned long *produced_pos, unsigned long *consumed_pos)
 {
 	int ret;
-	struct lttng_consumer_channel *channel;
-	struct lttng_consumer_stream *stream;
 
-	DBG("Kernel consumer snapshot channel %" PRIu64, key);
-
-	rcu_read_lock();
-
-	channel = consumer_find_channel(key);
-	if (!channel) {
-		ERR("No channel found for key %" PRIu64, key);
-		ret = -1;
+	if (stream->max_sb_size == 0) {
+		ret = kernctl_get_max_subbuf_size(stream->wait_fd,
+				&stream->max_sb_size);
+		if (ret < 0) {
+			goto end;
+		}
+	}
+	ret = lttng_kconsumer_take_snapshot(stream);
+	if (ret < 0) {
 		goto end;
 	}
-
-	/* Splice is not supported yet for channel snapshot. */
-	if (channel->output != CONSUMER_CHANNEL_MMAP) {
-		ERR("Unsupported output %d", channel->output);
-		ret = -1;
+	ret = lttng_kconsumer_get_produced_snapshot(stream, produced_pos);
+	if (ret < 0) {
 		goto end;
 	}
+	ret = lttng_kconsumer_get_consumed_snapshot(stream, consumed_pos);
+end:
+	return ret;
+}
 
-	cds_list_for_each_entry(stream, &channel->streams.head, send_node) {
-		/* Are we at a position _before_ the first available packet ? */
-		bool before_first_packet = true;
-		unsigned long consumed_pos, produced_pos;
-
-		health_code_update();
-
-		/*
-		 * Lock stream because we are about to change its state.
-		 */
-		pthread_mutex_lock(&stream->lock);
-
-		/*
-		 * Assign the received relayd ID so we can use it for streaming. The streams
-		 * are not visible to anyone so this is OK to change it.
-		 */
-		stream->net_seq_idx = relayd_id;
-		channel->relayd_id = relayd_id;
-		if (relayd_id != (uint64_t) -1ULL) {
-			ret = consumer_send_relayd_stream(stream, path);
-			if (ret < 0) {
-				ERR("sending stream to relayd");
-				goto end_unlock;
-			}
-		} else {
-			ret = utils_create_stream_file(path, stream->name,
-					stream->chan->tracefile_size,
-					stream->tracefile_count_current,
-					stream->uid, stream->gid, NULL);
-			if (ret < 0) {
-				ERR("utils_create_stream_file");
-				goto end_unlock;
-			}
+/*
+ * Take a snapshot of a stream of a channel.
+ *
+ * Returns 0 on success, < 0 on error
+ */
+static int snapshot_stream(struct lttng_consumer_stream *stream, void *data,
+		uint64_t *lost_packets)
+{
+	int ret, write_index;
+	/* Are we at a position _before_ the first available packet ? */
+	bool before_first_packet = true;
+	unsigned long consumed_pos, produced_pos;
+	struct snapshot_channel_data *snapshot = data;
+	struct ctf_packet_index index;
 
-			stream->out_fd = ret;
-			stream->tracefile_size_current = 0;
+	health_code_update();
 
-			DBG("Kernel consumer snapshot stream %s/%s (%" PRIu64 ")",
-					path, stream->name, stream->key);
-		}
-		if (relayd_id != -1ULL) {
-			ret = consumer_send_relayd_streams_sent(relayd_id);
-			if (ret < 0) {
-				ERR("sending streams sent to relayd");
-				goto end_unlock;
-			}
-			channel->streams_sent_to_relayd = true;
-		}
+	/*
+	 * Lock stream because we are about to change its state.
+	 */
+	pthread_mutex_lock(&stream->lock);
 
-		ret = kernctl_buffer_flush_empty(stream->wait_fd);
+	/*
+	 * The streams were added on the relayd by
+	 * consumer_snapshot_send_relayd_streams().
+	 */
+	stream->net_seq_idx = snapshot->relayd_id;
+	if (snapshot->relayd_id == (uint64_t) -1ULL) {
+		ret = utils_create_stream_file(snapshot->path, stream->name,
+				stream->chan->tracefile_size,
+				stream->tracefile_count_current,
+				stream->uid, stream->gid, NULL);
 		if (ret < 0) {
-			/*
-			 * Doing a buffer flush which does not take into
-			 * account empty packets. This is not perfect
-			 * for stream intersection, but required as a
-			 * fall-back when "flush_empty" is not
-			 * implemented by lttng-modules.
-			 */
-			ret = kernctl_buffer_flush(stream->wait_fd);
-			if (ret < 0) {
-				ERR("Failed to flush kernel stream");
-				goto end_unlock;
-			}
+			ERR("utils_create_stream_file");
 			goto end_unlock;
 		}
 
-		ret = lttng_kconsumer_take_snapshot(stream);
-		if (ret < 0) {
-			ERR("Taking kernel snapshot");
-			goto end_unlock;
-		}
+		stream->out_fd = ret;
+		stream->tracefile_size_current = 0;
+		consumer_stream_setup_output_file(stream);
 
-		ret = lttng_kconsumer_get_produced_snapshot(stream, &produced_pos);
+		DBG("Kernel consumer snapshot stream %s/%s (%" PRIu64 ")",
+				snapshot->path, stream->name, stream->key);
+	}
+
+	/* Indexed so that the viewers seek in the snapshot without a scan. */
+	ret = consumer_stream_open_snapshot_index(stream, snapshot->path);
+	if (ret < 0) {
+		goto end_unlock;
+	}
+	write_index = ret;
+
+	ret = kernctl_buffer_flush_empty(stream->wait_fd);
+	if (ret < 0) {
+		/*
+		 * Doing a buffer flush which does not take into
+		 * account empty packets. This is not perfect
+		 * for stream intersection, but required as a
+		 * fall-back when "flush_empty" is not
+		 * implemented by lttng-modules.
+		 */
+		ret = kernctl_buffer_flush(stream->wait_fd);
 		if (ret < 0) {
-			ERR("Produced kernel snapshot position");
+			ERR("Failed to flush kernel stream");
 			goto end_unlock;
 		}
+		goto end_unlock;
+	}
+
+	ret = lttng_kconsumer_take_snapshot(stream);
+	if (ret < 0) {
+		ERR("Taking kernel snapshot");
+		goto end_unlock;
+	}
+
+	ret = lttng_kconsumer_get_produced_snapshot(stream, &produced_pos);
+	if (ret < 0) {
+		ERR("Produced kernel snapshot position");
+		goto end_unlock;
+	}
+
+	ret = lttng_kconsumer_get_consumed_snapshot(stream, &consumed_pos);
+	if (ret < 0) {
+		ERR("Consumerd kernel snapshot position");
+		goto end_unlock;
+	}
 
-		ret = lttng_kconsumer_get_consumed_snapshot(stream, &consumed_pos);
+	if (stream->max_sb_size == 0) {
+		ret = kernctl_get_max_subbuf_size(stream->wait_fd,
+				&stream->max_sb_size);
 		if (ret < 0) {
-			ERR("Consumerd kernel snapshot position");
+			ERR("Getting kernel max_sb_size");
 			goto end_unlock;
 		}
+	}
 
-		if (stream->max_sb_size == 0) {
-			ret = kernctl_get_max_subbuf_size(stream->wait_fd,
-					&stream->max_sb_size);
-			if (ret < 0) {
-				ERR("Getting kernel max_sb_size");
-				goto end_unlock;
-			}
-		}
-
-		consumed_pos = consumer_get_consume_start_pos(consumed_pos,
-				produced_pos, nb_packets_per_stream,
-				stream->max_sb_size);
+	consumed_pos = consumer_get_consume_start_pos(consumed_pos,
+			produced_pos, stream->snapshot_nb_packets,
+			stream->max_sb_size);
+	if (snapshot->incremental) {
+		consumed_pos = consumer_get_incremental_start_pos(stream,
+				consumed_pos, snapshot->output_id);
+	}
 
-		while (consumed_pos < produced_pos) {
-			ssize_t read_len;
-			unsigned long len, padded_len;
-			int lost_packet = 0;
+	while (consumed_pos < produced_pos) {
+		ssize_t read_len;
+		unsigned long len, padded_len;
+		int lost_packet = 0;
 
-			health_code_update();
+		health_code_update();
 
-			DBG("Kernel consumer taking snapshot at pos %lu", consumed_pos);
+		DBG("Kernel consumer taking snapshot at pos %lu", consumed_pos);
 
-			ret = kernctl_get_subbuf(stream->wait_fd, &consumed_pos);
-			if (ret < 0) {
-				if (ret != -EAGAIN) {
-					PERROR("kernctl_get_subbuf snapshot");
-					goto end_unlock;
-				}
-				DBG("Kernel consumer get subbuf failed. Skipping it.");
-				consumed_pos += stream->max_sb_size;
-
-				/*
-				 * Start accounting lost packets only when we
-				 * already have extracted packets (to match the
-				 * content of the final snapshot).
-				 */
-				if (!before_first_packet) {
-					lost_packet = 1;
-				}
-				continue;
+		ret = kernctl_get_subbuf(stream->wait_fd, &consumed_pos);
+		if (ret < 0) {
+			if (ret != -EAGAIN) {
+				PERROR("kernctl_get_subbuf snapshot");
+				goto end_unlock;
 			}
+			DBG("Kernel consumer get subbuf failed. Skipping it.");
+			consumed_pos += stream->max_sb_size;
 
-			ret = kernctl_get_subbuf_size(stream->wait_fd, &len);
-			if (ret < 0) {
-				ERR("Snapshot kernctl_get_subbuf_size");
-				goto error_put_subbuf;
+			/*
+			 * Start accounting lost packets only when we
+			 * already have extracted packets (to match the
+			 * content of the final snapshot).
+			 */
+			if (!before_first_packet) {
+				lost_packet = 1;
 			}
+			continue;
+		}
+
+		ret = kernctl_get_subbuf_size(stream->wait_fd, &len);
+		if (ret < 0) {
+			ERR("Snapshot kernctl_get_subbuf_size");
+			goto error_put_subbuf;
+		}
+
+		ret = kernctl_get_padded_subbuf_size(stream->wait_fd, &padded_len);
+		if (ret < 0) {
+			ERR("Snapshot kernctl_get_padded_subbuf_size");
+			goto error_put_subbuf;
+		}
 
-			ret = kernctl_get_padded_subbuf_size(stream->wait_fd, &padded_len);
+		if (write_index) {
+			index.offset = htobe64(stream->out_fd_offset);
+			ret = get_index_values(&index, stream->wait_fd);
 			if (ret < 0) {
-				ERR("Snapshot kernctl_get_padded_subbuf_size");
 				goto error_put_subbuf;
 			}
+		}
 
-			read_len = lttng_consumer_on_read_subbuffer_mmap(ctx, stream, len,
-					padded_len - len, NULL);
-			/*
-			 * We write the padded len in local tracefiles but the data len
-			 * when using a relay. Display the error but continue processing
-			 * to try to release the subbuffer.
-			 */
-			if (relayd_id != (uint64_t) -1ULL) {
-				if (read_len != len) {
-					ERR("Error sending to the relay (ret: %zd != len: %lu)",
-							read_len, len);
-				}
-			} else {
-				if (read_len != padded_len) {
-					ERR("Error writing to tracefile (ret: %zd != len: %lu)",
-							read_len, padded_len);
-				}
+		read_len = lttng_consumer_on_read_subbuffer_mmap(snapshot->ctx,
+				stream, len, padded_len - len,
+				write_index ? &index : NULL);
+		/*
+		 * We write the padded len in local tracefiles but the data len
+		 * when using a relay. Display the error but continue processing
+		 * to try to release the subbuffer.
+		 */
+		if (snapshot->relayd_id != (uint64_t) -1ULL) {
+			if (read_len != len) {
+				ERR("Error sending to the relay (ret: %zd != len: %lu)",
+						read_len, len);
+				write_index = 0;
 			}
+		} else {
+			if (read_len != padded_len) {
+				ERR("Error writing to tracefile (ret: %zd != len: %lu)",
+						read_len, padded_len);
+				write_index = 0;
+			}
+		}
+
+		ret = kernctl_put_subbuf(stream->wait_fd);
+		if (ret < 0) {
+			ERR("Snapshot kernctl_put_subbuf");
+			goto end_unlock;
+		}
+		consumed_pos += stream->max_sb_size;
 
-			ret = kernctl_put_subbuf(stream->wait_fd);
+		if (write_index) {
+			ret = consumer_stream_write_index(stream, &index);
 			if (ret < 0) {
-				ERR("Snapshot kernctl_put_subbuf");
+				ERR("Error writing the snapshot index of stream %" PRIu64,
+						stream->key);
 				goto end_unlock;
 			}
-			consumed_pos += stream->max_sb_size;
-
-			/*
-			 * Only account lost packets located between
-			 * succesfully extracted packets (do not account before
-			 * and after since they are not visible in the
-			 * resulting snapshot).
-			 */
-			stream->chan->lost_packets += lost_packet;
-			lost_packet = 0;
-			before_first_packet = false;
 		}
 
-		if (relayd_id == (uint64_t) -1ULL) {
-			if (stream->out_fd >= 0) {
-				ret = close(stream->out_fd);
-				if (ret < 0) {
-					PERROR("Kernel consumer snapshot close out_fd");
-					goto end_unlock;
-				}
-				stream->out_fd = -1;
+		/*
+		 * Only account lost packets located between
+		 * succesfully extracted packets (do not account before
+		 * and after since they are not visible in the
+		 * resulting snapshot).
+		 */
+		*lost_packets += lost_packet;
+		lost_packet = 0;
+		before_first_packet = false;
+	}
+
+	consumer_set_last_snapshot_pos(stream, snapshot->output_id,
+			produced_pos);
+
+	if (stream->index_file) {
+		lttng_index_file_put(stream->index_file);
+		stream->index_file = NULL;
+	}
+	if (snapshot->relayd_id == (uint64_t) -1ULL) {
+		if (stream->out_fd >= 0) {
+			consumer_writeback_wait(stream);
+			ret = close(stream->out_fd);
+			if (ret < 0) {
+				PERROR("Kernel consumer snapshot close out_fd");
+				goto end_unlock;
 			}
-		} else {
-			close_relayd_stream(stream);
-			stream->net_seq_idx = (uint64_t) -1ULL;
+			stream->out_fd = -1;
 		}
-		pthread_mutex_unlock(&stream->lock);
+	} else {
+		/* Closed on the relayd with the other streams of the channel. */
+		stream->net_seq_idx = (uint64_t) -1ULL;
 	}
-
-	/* All good! */
-	ret = 0;
-	goto end;
+	pthread_mutex_unlock(&stream->lock);
+	return 0;
 
 error_put_subbuf:
 	ret = kernctl_put_subbuf(stream->wait_fd);
@@ -350,7 +393,76 @@ error_put_subbuf:
 		ERR("Snapshot kernctl_put_subbuf error path");
 	}
 end_unlock:
+	if (stream->index_file) {
+		lttng_index_file_put(stream->index_file);
+		stream->index_file = NULL;
+	}
 	pthread_mutex_unlock(&stream->lock);
+	return ret;
+}
+
+/*
+ * Take a snapshot of all the stream of a channel
+ *
+ * Returns 0 on success, < 0 on error
+ */
+int lttng_kconsumer_snapshot_channel(uint64_t key, char *path,
+		uint64_t relayd_id, uint64_t nb_packets_per_stream,
+		int incremental, uint64_t output_id,
+		struct lttng_consumer_local_data *ctx)
+{
+	int ret;
+	struct lttng_consumer_channel *channel;
+	struct snapshot_channel_data snapshot = {
+		.path = path,
+		.relayd_id = relayd_id,
+		.incremental = !!incremental,
+		.output_id = output_id,
+		.ctx = ctx,
+	};
+
+	DBG("Kernel consumer snapshot channel %" PRIu64, key);
+
+	rcu_read_lock();
+
+	channel = consumer_find_channel(key);
+	if (!channel) {
+		ERR("No channel found for key %" PRIu64, key);
+		ret = -1;
+		goto end;
+	}
+
+	/* Splice is not supported yet for channel snapshot. */
+	if (channel->output != CONSUMER_CHANNEL_MMAP) {
+		ERR("Unsupported output %d", channel->output);
+		ret = -1;
+		goto end;
+	}
+
+	/*
+	 * Assign the received relayd ID so we can use it for streaming. The
+	 * streams are not visible to anyone so this is OK to change it.
+	 */
+	channel->relayd_id = relayd_id;
+	if (relayd_id != (uint64_t) -1ULL &&
+			!cds_list_empty(&channel->streams.head)) {
+		channel->streams_sent_to_relayd = true;
+	}
+
+	consumer_snapshot_plan_streams(channel, nb_packets_per_stream,
+			snapshot.incremental, output_id, sample_stream);
+	if (relayd_id != (uint64_t) -1ULL) {
+		ret = consumer_snapshot_send_relayd_streams(channel, path,
+				relayd_id);
+		if (ret < 0) {
+			goto end;
+		}
+	}
+	ret = consumer_snapshot_streams(channel, snapshot_stream, &snapshot);
+	if (relayd_id != (uint64_t) -1ULL) {
+		consumer_close_relayd_channel_streams(channel, relayd_id);
+	}
+
 end:
 	rcu_read_unlock();
 	return ret;
@@ -427,6 +539,7 @@ int lttng_kconsumer_snapshot_metadata(uint64_t key, char *path,
 		metadata_stream->net_seq_idx = (uint64_t) -1ULL;
 	} else {
 		if (metadata_stream->out_fd >= 0) {
+			consumer_writeback_wait(metadata_stream);
 			ret = close(metadata_stream->out_fd);
 			if (ret < 0) {
 				PERROR("Kernel consumer snapshot metadata close out_fd");
@@ -449,6 +562,209 @@ error:
 	return ret;
 }
 
+/*
+ * Size the splice pipe of a stream to hold a whole sub-buffer and the relayd
+ * metadata payload header, so that each packet is spliced to its output in
+ * one step rather than in chunks of the default pipe capacity.
+ *
+ * Failing to resize the pipe, for instance above /proc/sys/fs/pipe-max-size
+ * for an unprivileged consumer, is not an error: the default size is kept.
+ */
+static void size_splice_pipe(struct lttng_consumer_stream *stream)
+{
+#ifdef F_SETPIPE_SZ
+	int ret;
+
+	ret = kernctl_get_max_subbuf_size(stream->wait_fd, &stream->max_sb_size);
+	if (ret < 0) {
+		DBG("Failed to get the max sub-buffer size of stream %" PRIu64,
+				stream->key);
+		return;
+	}
+
+	ret = fcntl(stream->splice_pipe[1], F_SETPIPE_SZ,
+			(int) (stream->max_sb_size +
+				sizeof(struct lttcomm_relayd_metadata_payload)));
+	if (ret < 0) {
+		DBG("Splice pipe of stream %" PRIu64 " kept to its default size: %s",
+				stream->key, strerror(errno));
+	}
+#endif /* F_SETPIPE_SZ */
+}
+
+/*
+ * Create a stream of the channel from its received fd, and hand it to the
+ * data or metadata thread when the channel is monitored.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static int add_stream(struct lttng_consumer_local_data *ctx,
+		struct lttng_consumer_channel *channel, int fd, int cpu)
+{
+	int ret;
+	int alloc_ret = 0;
+	struct lttng_pipe *stream_pipe;
+	struct lttng_consumer_stream *new_stream;
+
+	new_stream = consumer_allocate_stream(channel->key,
+			fd,
+			LTTNG_CONSUMER_ACTIVE_STREAM,
+			channel->name,
+			channel->uid,
+			channel->gid,
+			channel->relayd_id,
+			channel->session_id,
+			cpu,
+			&alloc_ret,
+			channel->type,
+			channel->monitor);
+	if (new_stream == NULL) {
+		switch (alloc_ret) {
+		case -ENOMEM:
+		case -EINVAL:
+		default:
+			lttng_consumer_send_error(ctx, LTTCOMM_CONSUMERD_OUTFD_ERROR);
+			break;
+		}
+		return -1;
+	}
+
+	new_stream->chan = channel;
+	new_stream->wait_fd = fd;
+	switch (channel->output) {
+	case CONSUMER_CHANNEL_SPLICE:
+		new_stream->output = LTTNG_EVENT_SPLICE;
+		ret = utils_create_pipe(new_stream->splice_pipe);
+		if (ret < 0) {
+			return -1;
+		}
+		size_splice_pipe(new_stream);
+		break;
+	case CONSUMER_CHANNEL_MMAP:
+	case CONSUMER_CHANNEL_MMAP_URING:
+		new_stream->output = LTTNG_EVENT_MMAP;
+		break;
+	default:
+		ERR("Stream output unknown %d", channel->output);
+		return -1;
+	}
+
+	/*
+	 * We've just assigned the channel to the stream so increment the
+	 * refcount right now. We don't need to increment the refcount for
+	 * streams in no monitor because we handle manually the cleanup of
+	 * those. It is very important to make sure there is NO prior
+	 * consumer_del_stream() calls or else the refcount will be unbalanced.
+	 */
+	if (channel->monitor) {
+		uatomic_inc(&new_stream->chan->refcount);
+	}
+
+	/*
+	 * The buffer flush is done on the session daemon side for the kernel
+	 * so no need for the stream "hangup_flush_done" variable to be
+	 * tracked. This is important for a kernel stream since we don't rely
+	 * on the flush state of the stream to read data. It's not the case for
+	 * user space tracing.
+	 */
+	new_stream->hangup_flush_done = 0;
+
+	health_code_update();
+
+	if (ctx->on_recv_stream) {
+		ret = ctx->on_recv_stream(new_stream);
+		if (ret < 0) {
+			consumer_stream_free(new_stream);
+			return -1;
+		}
+	}
+
+	health_code_update();
+
+	if (new_stream->metadata_flag) {
+		channel->metadata_stream = new_stream;
+	}
+
+	/* Do not monitor this stream. */
+	if (!channel->monitor) {
+		DBG("Kernel consumer add stream %s in no monitor mode with "
+				"relayd id %" PRIu64, new_stream->name,
+				new_stream->net_seq_idx);
+		cds_list_add(&new_stream->send_node, &channel->streams.head);
+		return 0;
+	}
+
+	/* Send stream to relayd if the stream has an ID. */
+	if (new_stream->net_seq_idx != (uint64_t) -1ULL) {
+		ret = consumer_send_relayd_stream(new_stream,
+				new_stream->chan->pathname);
+		if (ret < 0) {
+			consumer_stream_free(new_stream);
+			return -1;
+		}
+
+		/*
+		 * If adding an extra stream to an already
+		 * existing channel (e.g. cpu hotplug), we need
+		 * to send the "streams_sent" command to relayd.
+		 */
+		if (channel->streams_sent_to_relayd) {
+			ret = consumer_send_relayd_streams_sent(
+					new_stream->net_seq_idx);
+			if (ret < 0) {
+				return -1;
+			}
+		}
+	}
+
+	/*
+	 * A data stream is queued to the thread of its shard, woken up by
+	 * consumer_wakeup_data_shards() once all the streams are added.
+	 */
+	if (!new_stream->metadata_flag) {
+		ret = consumer_add_data_stream(new_stream, ctx);
+		if (ret) {
+			ERR("Consumer add stream %" PRIu64 " failed. Continuing",
+					new_stream->key);
+			consumer_stream_free(new_stream);
+			return -1;
+		}
+
+		/* Visible to other threads */
+		new_stream->globally_visible = 1;
+		consumer_handover_data_stream(new_stream);
+		goto end;
+	}
+
+	/* Get the right pipe where the stream will be sent. */
+	ret = consumer_add_metadata_stream(new_stream, ctx);
+	if (ret) {
+		ERR("Consumer add metadata stream %" PRIu64 " failed. Continuing",
+				new_stream->key);
+		consumer_stream_free(new_stream);
+		return -1;
+	}
+	stream_pipe = new_stream->metadata_shard->metadata_pipe;
+
+	/* Vitible to other threads */
+	new_stream->globally_visible = 1;
+
+	health_code_update();
+
+	ret = lttng_pipe_write(stream_pipe, &new_stream, sizeof(new_stream));
+	if (ret < 0) {
+		ERR("Consumer write metadata stream to pipe %d",
+				lttng_pipe_get_writefd(stream_pipe));
+		consumer_del_stream_for_metadata(new_stream);
+		return -1;
+	}
+end:
+
+	DBG("Kernel consumer ADD_STREAM %s (fd: %d) with relayd id %" PRIu64,
+			new_stream->name, fd, new_stream->relayd_stream_id);
+	return 0;
+}
+
 /*
  * Receive command from session daemon and process it.
  *
@@ -523,12 +839,15 @@ int lttng_kconsumer_recv_cmd(struct lttng_consumer_local_data *ctx,
 			goto end_nosignal;
 		}
 		new_channel->nb_init_stream_left = msg.u.channel.nb_init_streams;
+		new_channel->compression = msg.u.channel.compression;
 		switch (msg.u.channel.output) {
 		case LTTNG_EVENT_SPLICE:
 			new_channel->output = CONSUMER_CHANNEL_SPLICE;
 			break;
 		case LTTNG_EVENT_MMAP:
-			new_channel->output = CONSUMER_CHANNEL_MMAP;
+			new_channel->output = consumer_channel_mmap_output(
+					msg.u.channel.relayd_id,
+					msg.u.channel.monitor);
 			break;
 		default:
 			ERR("Channel output unknown %d", msg.u.channel.output);
@@ -590,10 +909,7 @@ int lttng_kconsumer_recv_cmd(struct lttng_consumer_local_data *ctx,
 	case LTTNG_CONSUMER_ADD_STREAM:
 	{
 		int fd;
-		struct lttng_pipe *stream_pipe;
-		struct lttng_consumer_stream *new_stream;
 		struct lttng_consumer_channel *channel;
-		int alloc_ret = 0;
 
 		/*
 		 * Get stream's channel reference. Needed when adding the stream to the
@@ -658,157 +974,118 @@ int lttng_kconsumer_recv_cmd(struct lttng_consumer_local_data *ctx,
 
 		health_code_update();
 
-		new_stream = consumer_allocate_stream(channel->key,
-				fd,
-				LTTNG_CONSUMER_ACTIVE_STREAM,
-				channel->name,
-				channel->uid,
-				channel->gid,
-				channel->relayd_id,
-				channel->session_id,
-				msg.u.stream.cpu,
-				&alloc_ret,
-				channel->type,
-				channel->monitor);
-		if (new_stream == NULL) {
-			switch (alloc_ret) {
-			case -ENOMEM:
-			case -EINVAL:
-			default:
-				lttng_consumer_send_error(ctx, LTTCOMM_CONSUMERD_OUTFD_ERROR);
-				break;
-			}
+		ret = add_stream(ctx, channel, fd, msg.u.stream.cpu);
+		(void) consumer_wakeup_data_shards(ctx);
+		if (ret < 0) {
 			goto end_nosignal;
 		}
+		break;
+	}
+	case LTTNG_CONSUMER_ADD_STREAMS:
+	{
+		uint32_t i, nb_streams = msg.u.streams.nb_streams;
+		int32_t *cpus = NULL;
+		int *fds = NULL;
+		struct lttng_consumer_channel *channel;
 
-		new_stream->chan = channel;
-		new_stream->wait_fd = fd;
-		switch (channel->output) {
-		case CONSUMER_CHANNEL_SPLICE:
-			new_stream->output = LTTNG_EVENT_SPLICE;
-			ret = utils_create_pipe(new_stream->splice_pipe);
-			if (ret < 0) {
-				goto end_nosignal;
+		channel = consumer_find_channel(msg.u.streams.channel_key);
+		if (!channel) {
+			ERR("Unable to find channel key %" PRIu64,
+					msg.u.streams.channel_key);
+			ret_code = LTTCOMM_CONSUMERD_CHAN_NOT_FOUND;
+		} else if (!nb_streams ||
+				nb_streams > LTTCOMM_CONSUMER_MAX_STREAMS) {
+			ERR("Invalid number of streams %" PRIu32, nb_streams);
+			ret_code = LTTCOMM_CONSUMERD_CHANNEL_FAIL;
+		} else {
+			cpus = zmalloc(nb_streams * sizeof(*cpus));
+			fds = zmalloc(nb_streams * sizeof(*fds));
+			if (!cpus || !fds) {
+				ret_code = LTTCOMM_CONSUMERD_ENOMEM;
 			}
-			break;
-		case CONSUMER_CHANNEL_MMAP:
-			new_stream->output = LTTNG_EVENT_MMAP;
-			break;
-		default:
-			ERR("Stream output unknown %d", channel->output);
-			goto end_nosignal;
 		}
 
-		/*
-		 * We've just assigned the channel to the stream so increment the
-		 * refcount right now. We don't need to increment the refcount for
-		 * streams in no monitor because we handle manually the cleanup of
-		 * those. It is very important to make sure there is NO prior
-		 * consumer_del_stream() calls or else the refcount will be unbalanced.
-		 */
-		if (channel->monitor) {
-			uatomic_inc(&new_stream->chan->refcount);
-		}
-
-		/*
-		 * The buffer flush is done on the session daemon side for the kernel
-		 * so no need for the stream "hangup_flush_done" variable to be
-		 * tracked. This is important for a kernel stream since we don't rely
-		 * on the flush state of the stream to read data. It's not the case for
-		 * user space tracing.
-		 */
-		new_stream->hangup_flush_done = 0;
-
 		health_code_update();
 
-		if (ctx->on_recv_stream) {
-			ret = ctx->on_recv_stream(new_stream);
-			if (ret < 0) {
-				consumer_stream_free(new_stream);
-				goto end_nosignal;
-			}
+		/* First send a status message before receiving the streams. */
+		ret = consumer_send_status_msg(sock, ret_code);
+		if (ret < 0) {
+			free(cpus);
+			free(fds);
+			goto error_fatal;
+		}
+
+		if (ret_code != LTTCOMM_CONSUMERD_SUCCESS) {
+			free(cpus);
+			free(fds);
+			goto end_nosignal;
 		}
 
 		health_code_update();
 
-		if (new_stream->metadata_flag) {
-			channel->metadata_stream = new_stream;
+		/* Blocking call */
+		health_poll_entry();
+		ret = lttng_consumer_poll_socket(consumer_sockpoll);
+		health_poll_exit();
+		if (ret) {
+			free(cpus);
+			free(fds);
+			goto error_fatal;
 		}
 
-		/* Do not monitor this stream. */
-		if (!channel->monitor) {
-			DBG("Kernel consumer add stream %s in no monitor mode with "
-					"relayd id %" PRIu64, new_stream->name,
-					new_stream->net_seq_idx);
-			cds_list_add(&new_stream->send_node, &channel->streams.head);
-			break;
+		ret = lttcomm_recv_unix_sock(sock, cpus,
+				nb_streams * sizeof(*cpus));
+		if (ret != (ssize_t) (nb_streams * sizeof(*cpus))) {
+			free(cpus);
+			free(fds);
+			lttng_consumer_send_error(ctx, LTTCOMM_CONSUMERD_ERROR_RECV_FD);
+			rcu_read_unlock();
+			return ret;
 		}
 
-		/* Send stream to relayd if the stream has an ID. */
-		if (new_stream->net_seq_idx != (uint64_t) -1ULL) {
-			ret = consumer_send_relayd_stream(new_stream,
-					new_stream->chan->pathname);
-			if (ret < 0) {
-				consumer_stream_free(new_stream);
-				goto end_nosignal;
-			}
-
-			/*
-			 * If adding an extra stream to an already
-			 * existing channel (e.g. cpu hotplug), we need
-			 * to send the "streams_sent" command to relayd.
-			 */
-			if (channel->streams_sent_to_relayd) {
-				ret = consumer_send_relayd_streams_sent(
-						new_stream->net_seq_idx);
-				if (ret < 0) {
-					goto end_nosignal;
-				}
-			}
-		}
+		health_code_update();
 
-		/* Get the right pipe where the stream will be sent. */
-		if (new_stream->metadata_flag) {
-			ret = consumer_add_metadata_stream(new_stream);
-			if (ret) {
-				ERR("Consumer add metadata stream %" PRIu64 " failed. Continuing",
-						new_stream->key);
-				consumer_stream_free(new_stream);
-				goto end_nosignal;
-			}
-			stream_pipe = ctx->consumer_metadata_pipe;
-		} else {
-			ret = consumer_add_data_stream(new_stream);
-			if (ret) {
-				ERR("Consumer add stream %" PRIu64 " failed. Continuing",
-						new_stream->key);
-				consumer_stream_free(new_stream);
-				goto end_nosignal;
-			}
-			stream_pipe = ctx->consumer_data_pipe;
+		/* Get all the stream file descriptors from the socket. */
+		ret = lttcomm_recv_fds_batch_unix_sock(sock, fds, nb_streams);
+		if (ret != (ssize_t) nb_streams) {
+			free(cpus);
+			free(fds);
+			lttng_consumer_send_error(ctx, LTTCOMM_CONSUMERD_ERROR_RECV_FD);
+			rcu_read_unlock();
+			return ret;
 		}
 
-		/* Vitible to other threads */
-		new_stream->globally_visible = 1;
-
 		health_code_update();
 
-		ret = lttng_pipe_write(stream_pipe, &new_stream, sizeof(new_stream));
-		if (ret < 0) {
-			ERR("Consumer write %s stream to pipe %d",
-					new_stream->metadata_flag ? "metadata" : "data",
-					lttng_pipe_get_writefd(stream_pipe));
-			if (new_stream->metadata_flag) {
-				consumer_del_stream_for_metadata(new_stream);
-			} else {
-				consumer_del_stream_for_data(new_stream);
+		/*
+		 * Send status code to session daemon only if the recv works, as
+		 * for a single stream.
+		 */
+		ret = consumer_send_status_msg(sock, ret_code);
+		for (i = 0; ret >= 0 && i < nb_streams; i++) {
+			health_code_update();
+
+			/*
+			 * The fd is owned by the stream from now on, even if it
+			 * fails to be added.
+			 */
+			ret = add_stream(ctx, channel, fds[i], cpus[i]);
+			fds[i] = -1;
+		}
+		/* A single wakeup for all the data streams of the channel. */
+		(void) consumer_wakeup_data_shards(ctx);
+		DBG("Kernel consumer ADD_STREAMS of %" PRIu32 " streams of channel %"
+				PRIu64, nb_streams, channel->key);
+
+		/* Close the fds of the streams left after an error. */
+		for (i = 0; i < nb_streams; i++) {
+			if (fds[i] >= 0 && close(fds[i])) {
+				PERROR("close stream fd");
 			}
-			goto end_nosignal;
 		}
-
-		DBG("Kernel consumer ADD_STREAM %s (fd: %d) with relayd id %" PRIu64,
-				new_stream->name, fd, new_stream->relayd_stream_id);
-		break;
+		free(cpus);
+		free(fds);
+		goto end_nosignal;
 	}
 	case LTTNG_CONSUMER_STREAMS_SENT:
 	{
@@ -944,6 +1221,8 @@ int lttng_kconsumer_recv_cmd(struct lttng_consumer_local_data *ctx,
 					msg.u.snapshot_channel.pathname,
 					msg.u.snapshot_channel.relayd_id,
 					msg.u.snapshot_channel.nb_packets_per_stream,
+					msg.u.snapshot_channel.incremental,
+					msg.u.snapshot_channel.output_id,
 					ctx);
 			if (ret < 0) {
 				ERR("Snapshot channel failed");
@@ -1062,6 +1341,74 @@ int lttng_kconsumer_recv_cmd(struct lttng_consumer_local_data *ctx,
 
 		break;
 	}
+	case LTTNG_CONSUMER_STREAM_STATS:
+	{
+		uint64_t key = msg.u.stream_stats.channel_key;
+
+		DBG("Kernel consumer stream stats command for channel key %" PRIu64,
+				key);
+
+		health_code_update();
+
+		/* Send back the statistics to the session daemon */
+		ret = lttng_consumer_send_stream_stats(sock, key);
+		if (ret < 0) {
+			PERROR("send stream stats");
+			goto error_fatal;
+		}
+
+		break;
+	}
+	case LTTNG_CONSUMER_CHANNEL_STATS:
+	{
+		uint64_t id = msg.u.channel_stats.session_id;
+
+		DBG("Kernel consumer channel stats command for session id %" PRIu64,
+				id);
+
+		health_code_update();
+
+		/* Send back the statistics to the session daemon */
+		ret = lttng_consumer_send_channel_stats(sock, id);
+		if (ret < 0) {
+			PERROR("send channel stats");
+			goto error_fatal;
+		}
+
+		break;
+	}
+	case LTTNG_CONSUMER_SET_CHANNEL_MONITOR_FILTER:
+	{
+		ret = consumer_set_channel_monitor_filter(
+				msg.u.channel_monitor_filter.key,
+				msg.u.channel_monitor_filter.forward_all,
+				msg.u.channel_monitor_filter.thresholds,
+				msg.u.channel_monitor_filter.nr_thresholds);
+		if (ret != 0) {
+			ret_code = ret;
+		}
+
+		health_code_update();
+
+		ret = consumer_send_status_msg(sock, ret_code);
+		if (ret < 0) {
+			goto error_fatal;
+		}
+		break;
+	}
+	case LTTNG_CONSUMER_SET_OVERLOAD_SHEDDING:
+	{
+		consumer_set_overload_shedding(ctx,
+				!!msg.u.overload_shedding.enable);
+
+		health_code_update();
+
+		ret = consumer_send_status_msg(sock, ret_code);
+		if (ret < 0) {
+			goto error_fatal;
+		}
+		break;
+	}
 	case LTTNG_CONSUMER_SET_CHANNEL_MONITOR_PIPE:
 	{
 		int channel_monitor_pipe;
@@ -1208,6 +1555,19 @@ static int get_index_values(struct ctf_packet_index *index, int infd)
 	}
 	index->packet_seq_num = htobe64(index->packet_seq_num);
 
+	ret = kernctl_get_events_count(infd, &index->events_count);
+	if (ret < 0) {
+		if (ret == -ENOTTY) {
+			/* Command not implemented by lttng-modules. */
+			index->events_count = -1ULL;
+			ret = 0;
+		} else {
+			PERROR("kernctl_get_events_count");
+			goto error;
+		}
+	}
+	index->events_count = htobe64(index->events_count);
+
 error:
 	return ret;
 }
@@ -1223,9 +1583,29 @@ error:
 int lttng_kconsumer_sync_metadata(struct lttng_consumer_stream *metadata)
 {
 	int ret;
+	struct pollfd pollfd = {
+		.fd = metadata->wait_fd,
+		.events = POLLIN | POLLPRI,
+	};
 
 	assert(metadata);
 
+	/*
+	 * The kernel metadata stream is readable as long as metadata remains
+	 * to be output from the metadata cache of the session or consumed from
+	 * its buffer. When it is not, there is nothing to flush: skip the
+	 * flush and snapshot, which the live data streams otherwise request
+	 * for each of their packets.
+	 */
+	ret = poll(&pollfd, 1, 0);
+	if (ret == 0) {
+		DBG("Sync metadata, no new kernel metadata");
+		ret = ENODATA;
+		goto end;
+	} else if (ret < 0 && errno != EINTR) {
+		PERROR("poll kernel metadata stream");
+	}
+
 	ret = kernctl_buffer_flush(metadata->wait_fd);
 	if (ret < 0) {
 		ERR("Failed to flush kernel stream");
@@ -1320,13 +1700,19 @@ int metadata_stream_check_version(int infd, struct lttng_consumer_stream *stream
 	int ret;
 	uint64_t cur_version;
 
+	if (stream->metadata_version_unsupported) {
+		ret = 0;
+		goto end;
+	}
+
 	ret = kernctl_get_metadata_version(infd, &cur_version);
 	if (ret < 0) {
 		if (ret == -ENOTTY) {
 			/*
 			 * LTTng-modules does not implement this
-			 * command.
+			 * command, do not ask again for each sub-buffer.
 			 */
+			stream->metadata_version_unsupported = 1;
 			ret = 0;
 			goto end;
 		}
@@ -1474,6 +1860,7 @@ ssize_t lttng_kconsumer_read_subbuffer(struct lttng_consumer_stream *stream,
 		}
 		break;
 	case CONSUMER_CHANNEL_MMAP:
+	case CONSUMER_CHANNEL_MMAP_URING:
 		/* Get subbuffer size without padding */
 		err = kernctl_get_subbuf_size(infd, &subbuf_size);
 		if (err != 0) {
@@ -1594,6 +1981,8 @@ int lttng_kconsumer_on_recv_stream(struct lttng_consumer_stream *stream)
 		}
 		stream->out_fd = ret;
 		stream->tracefile_size_current = 0;
+		consumer_stream_setup_output_file(stream);
+		consumer_stream_open_output_dir(stream);
 
 		if (!stream->metadata_flag) {
 			struct lttng_index_file *index_file;
@@ -1648,8 +2037,7 @@ error:
 
 /*
  * Check if data is still being extracted from the buffers for a specific
- * stream. Consumer data lock MUST be acquired before calling this function
- * and the stream lock.
+ * stream. The stream lock MUST be acquired before calling this function.
  *
  * Return 1 if the traced data are still getting read else 0 meaning that the
  * data is available for trace viewer reading.
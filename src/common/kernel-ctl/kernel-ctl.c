@@ -213,6 +213,27 @@ end:
 	return ret;
 }
 
+int kernctl_syscall_enable_mask(int fd, const char *syscall_mask,
+		uint32_t nr_bits)
+{
+	struct lttng_kernel_syscall_mask *kmask;
+	size_t array_len = ALIGN(nr_bits, 8) >> 3;
+	int ret;
+
+	kmask = zmalloc(sizeof(*kmask) + array_len);
+	if (!kmask) {
+		ret = -ENOMEM;
+		goto end;
+	}
+
+	kmask->len = nr_bits;
+	memcpy(kmask->mask, syscall_mask, array_len);
+	ret = LTTNG_IOCTL_CHECK(fd, LTTNG_KERNEL_SYSCALL_ENABLE_MASK, kmask);
+end:
+	free(kmask);
+	return ret;
+}
+
 int kernctl_track_pid(int fd, int pid)
 {
 	return LTTNG_IOCTL_CHECK(fd, LTTNG_KERNEL_SESSION_TRACK_PID, pid);
@@ -282,6 +303,21 @@ int kernctl_create_event(int fd, struct lttng_kernel_event *ev)
 	return LTTNG_IOCTL_NO_CHECK(fd, LTTNG_KERNEL_EVENT, ev);
 }
 
+/*
+ * The kernel tracer has no command creating several events at once: the
+ * events are created one by one. The file descriptor of each event, or a
+ * negative errno value if its creation failed, is returned in "fds".
+ */
+void kernctl_create_events(int fd, struct lttng_kernel_event **evs,
+		unsigned int nr_evs, int *fds)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr_evs; i++) {
+		fds[i] = kernctl_create_event(fd, evs[i]);
+	}
+}
+
 int kernctl_add_context(int fd, struct lttng_kernel_context *ctx)
 {
 	if (lttng_kernel_use_old_abi) {
@@ -574,3 +610,9 @@ int kernctl_get_instance_id(int fd, uint64_t *id)
 {
 	return LTTNG_IOCTL_CHECK(fd, LTTNG_RING_BUFFER_INSTANCE_ID, id);
 }
+
+/* Returns the number of events in the current sub-buffer. */
+int kernctl_get_events_count(int fd, uint64_t *count)
+{
+	return LTTNG_IOCTL_CHECK(fd, LTTNG_RING_BUFFER_GET_EVENTS_COUNT, count);
+}
@@ -29,6 +29,8 @@ int kernctl_open_metadata(int fd, struct lttng_channel_attr *chops);
 int kernctl_create_channel(int fd, struct lttng_channel_attr *chops);
 int kernctl_create_stream(int fd);
 int kernctl_create_event(int fd, struct lttng_kernel_event *ev);
+void kernctl_create_events(int fd, struct lttng_kernel_event **evs,
+		unsigned int nr_evs, int *fds);
 int kernctl_add_context(int fd, struct lttng_kernel_context *ctx);
 
 int kernctl_enable(int fd);
@@ -59,6 +61,16 @@ int kernctl_wait_quiescent(int fd);
 int kernctl_syscall_mask(int fd, char **syscall_mask,
 		uint32_t *nr_bits);
 
+/*
+ * kernctl_syscall_enable_mask - Set the syscalls enabled on a channel FD
+ * through a mask of @nr_bits bits, in the layout of kernctl_syscall_mask().
+ *
+ * It returns 0 if OK, a negative errno value on error. Kernel tracers
+ * lacking the command fail with -ENOTTY.
+ */
+int kernctl_syscall_enable_mask(int fd, const char *syscall_mask,
+		uint32_t nr_bits);
+
 /* Process ID tracking can be applied to session FD */
 int kernctl_track_pid(int fd, int pid);
 int kernctl_untrack_pid(int fd, int pid);
@@ -106,5 +118,6 @@ int kernctl_get_stream_id(int fd, uint64_t *stream_id);
 int kernctl_get_current_timestamp(int fd, uint64_t *ts);
 int kernctl_get_sequence_number(int fd, uint64_t *seq);
 int kernctl_get_instance_id(int fd, uint64_t *seq);
+int kernctl_get_events_count(int fd, uint64_t *count);
 
 #endif /* _LTTNG_KERNEL_CTL_H */
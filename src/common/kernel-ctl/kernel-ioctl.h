@@ -78,6 +78,8 @@
 #define LTTNG_RING_BUFFER_GET_SEQ_NUM             _IOR(0xF6, 0x27, uint64_t)
 /* returns the stream instance id */
 #define LTTNG_RING_BUFFER_INSTANCE_ID             _IOR(0xF6, 0x28, uint64_t)
+/* returns the number of events in the current sub-buffer */
+#define LTTNG_RING_BUFFER_GET_EVENTS_COUNT        _IOR(0xF6, 0x29, uint64_t)
 
 /* Old ABI (without support for 32/64 bits compat) */
 /* LTTng file descriptor ioctl */
@@ -147,6 +149,12 @@
 	_IOW(0xF6, 0x63, struct lttng_kernel_event)
 #define LTTNG_KERNEL_SYSCALL_MASK		\
 	_IOWR(0xF6, 0x64, struct lttng_kernel_syscall_mask)
+/*
+ * Set the system calls traced by a channel besides its system call events,
+ * with the bit layout of LTTNG_KERNEL_SYSCALL_MASK.
+ */
+#define LTTNG_KERNEL_SYSCALL_ENABLE_MASK	\
+	_IOW(0xF6, 0x65, struct lttng_kernel_syscall_mask)
 
 /* Event and Channel FD ioctl */
 #define LTTNG_KERNEL_CONTEXT			\
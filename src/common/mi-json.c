@@ -0,0 +1,267 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <common/common.h>
+#include <common/readwrite.h>
+
+#include "mi-json.h"
+
+#define MI_JSON_BUF_LEN		4096
+/* The MI elements are nested a few levels deep. */
+#define MI_JSON_MAX_DEPTH	64
+
+struct mi_json_writer {
+	int fd;
+	/* Number of open elements. */
+	unsigned int depth;
+	/* Whether the array of an open element, or the root, has a child. */
+	char has_child[MI_JSON_MAX_DEPTH + 1];
+	size_t len;
+	char buf[MI_JSON_BUF_LEN];
+};
+
+static int flush_buf(struct mi_json_writer *writer)
+{
+	ssize_t ret;
+
+	if (!writer->len) {
+		return 0;
+	}
+	ret = lttng_write(writer->fd, writer->buf, writer->len);
+	if (ret != writer->len) {
+		PERROR("write MI");
+		return -1;
+	}
+	writer->len = 0;
+	return 0;
+}
+
+static int put_mem(struct mi_json_writer *writer, const char *s, size_t len)
+{
+	while (len) {
+		size_t chunk;
+
+		if (writer->len == sizeof(writer->buf) && flush_buf(writer)) {
+			return -1;
+		}
+		chunk = min(len, sizeof(writer->buf) - writer->len);
+		memcpy(writer->buf + writer->len, s, chunk);
+		writer->len += chunk;
+		s += chunk;
+		len -= chunk;
+	}
+	return 0;
+}
+
+static int put_str(struct mi_json_writer *writer, const char *s)
+{
+	return put_mem(writer, s, strlen(s));
+}
+
+/*
+ * Write "s" as a JSON string, escaping what must be.
+ */
+static int put_json_string(struct mi_json_writer *writer, const char *s)
+{
+	const char *run = s;
+
+	if (put_mem(writer, "\"", 1)) {
+		return -1;
+	}
+	for (; *s; s++) {
+		unsigned char c = *s;
+		char esc[8];
+
+		if (c != '"' && c != '\\' && c >= 0x20) {
+			continue;
+		}
+		/* Write the run of plain characters at once. */
+		if (put_mem(writer, run, s - run)) {
+			return -1;
+		}
+		run = s + 1;
+		switch (c) {
+		case '"':
+			strcpy(esc, "\\\"");
+			break;
+		case '\\':
+			strcpy(esc, "\\\\");
+			break;
+		case '\n':
+			strcpy(esc, "\\n");
+			break;
+		case '\t':
+			strcpy(esc, "\\t");
+			break;
+		default:
+			snprintf(esc, sizeof(esc), "\\u%04x", c);
+			break;
+		}
+		if (put_str(writer, esc)) {
+			return -1;
+		}
+	}
+	if (put_mem(writer, run, s - run)) {
+		return -1;
+	}
+	return put_mem(writer, "\"", 1);
+}
+
+/*
+ * Start a child of the innermost open element: {"name":
+ */
+static int open_member(struct mi_json_writer *writer, const char *prefix,
+		const char *name)
+{
+	if (writer->has_child[writer->depth] && put_mem(writer, ",", 1)) {
+		return -1;
+	}
+	writer->has_child[writer->depth] = 1;
+	/* Both the prefix and the name are plain identifiers. */
+	if (put_str(writer, "{\"") || put_str(writer, prefix) ||
+			put_str(writer, name) || put_str(writer, "\":")) {
+		return -1;
+	}
+	return 0;
+}
+
+static int write_leaf(struct mi_json_writer *writer, const char *prefix,
+		const char *name, const char *raw_value, const char *string_value)
+{
+	if (open_member(writer, prefix, name)) {
+		return -1;
+	}
+	if (string_value ? put_json_string(writer, string_value) :
+			put_str(writer, raw_value)) {
+		return -1;
+	}
+	return put_mem(writer, "}", 1);
+}
+
+LTTNG_HIDDEN
+struct mi_json_writer *mi_json_writer_create(int fd_output)
+{
+	struct mi_json_writer *writer;
+
+	writer = zmalloc(sizeof(*writer));
+	if (!writer) {
+		PERROR("zmalloc mi_json_writer");
+		goto end;
+	}
+	writer->fd = fd_output;
+end:
+	return writer;
+}
+
+LTTNG_HIDDEN
+int mi_json_writer_destroy(struct mi_json_writer *writer)
+{
+	int ret = 0;
+
+	if (!writer) {
+		ret = -1;
+		goto end;
+	}
+
+	while (writer->depth && !ret) {
+		ret = mi_json_writer_close_element(writer);
+	}
+	if (!ret) {
+		ret = put_mem(writer, "\n", 1);
+	}
+	if (!ret) {
+		ret = flush_buf(writer);
+	}
+	free(writer);
+end:
+	return ret;
+}
+
+LTTNG_HIDDEN
+int mi_json_writer_open_element(struct mi_json_writer *writer,
+		const char *element_name)
+{
+	if (writer->depth == MI_JSON_MAX_DEPTH) {
+		ERR("MI JSON elements nested too deeply");
+		return -1;
+	}
+	if (open_member(writer, "", element_name) ||
+			put_mem(writer, "[", 1)) {
+		return -1;
+	}
+	writer->has_child[++writer->depth] = 0;
+	return 0;
+}
+
+LTTNG_HIDDEN
+int mi_json_writer_close_element(struct mi_json_writer *writer)
+{
+	if (!writer->depth) {
+		return -1;
+	}
+	writer->depth--;
+	return put_mem(writer, "]}", 2);
+}
+
+LTTNG_HIDDEN
+int mi_json_writer_write_attribute(struct mi_json_writer *writer,
+		const char *name, const char *value)
+{
+	return write_leaf(writer, "@", name, NULL, value ? value : "");
+}
+
+LTTNG_HIDDEN
+int mi_json_writer_write_element_unsigned_int(struct mi_json_writer *writer,
+		const char *element_name, uint64_t value)
+{
+	char buf[24];
+
+	snprintf(buf, sizeof(buf), "%" PRIu64, value);
+	return write_leaf(writer, "", element_name, buf, NULL);
+}
+
+LTTNG_HIDDEN
+int mi_json_writer_write_element_signed_int(struct mi_json_writer *writer,
+		const char *element_name, int64_t value)
+{
+	char buf[24];
+
+	snprintf(buf, sizeof(buf), "%" PRId64, value);
+	return write_leaf(writer, "", element_name, buf, NULL);
+}
+
+LTTNG_HIDDEN
+int mi_json_writer_write_element_bool(struct mi_json_writer *writer,
+		const char *element_name, int value)
+{
+	return write_leaf(writer, "", element_name, value ? "true" : "false",
+			NULL);
+}
+
+LTTNG_HIDDEN
+int mi_json_writer_write_element_string(struct mi_json_writer *writer,
+		const char *element_name, const char *value)
+{
+	return write_leaf(writer, "", element_name, NULL, value ? value : "");
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _MI_JSON_H
+#define _MI_JSON_H
+
+#include <stdint.h>
+
+#include <common/macros.h>
+
+/*
+ * Streaming JSON writer of the machine interface.
+ *
+ * The output follows the structure of the XML one without any lookahead:
+ * an element is an object with a single member named after it, whose value
+ * is the array of its children, and a leaf element is an object with a
+ * single member holding its value. Attributes are leaf elements named with
+ * an '@' prefix. For instance:
+ *
+ *   {"command":[{"@xmlns":"..."},{"name":"version"},{"success":true}]}
+ *
+ * The output is buffered and written to the file descriptor as the buffer
+ * fills up, and when the writer is destroyed.
+ */
+struct mi_json_writer;
+
+/*
+ * Create a JSON writer on the file descriptor "fd_output", which is not closed
+ * on destruction.
+ *
+ * Return the writer or NULL on error.
+ */
+LTTNG_HIDDEN
+struct mi_json_writer *mi_json_writer_create(int fd_output);
+
+/*
+ * Close the elements still open, flush and destroy the writer.
+ *
+ * Return 0 on success or else a negative value.
+ */
+LTTNG_HIDDEN
+int mi_json_writer_destroy(struct mi_json_writer *writer);
+
+/*
+ * The following functions return 0 on success or else a negative value.
+ */
+LTTNG_HIDDEN
+int mi_json_writer_open_element(struct mi_json_writer *writer,
+		const char *element_name);
+
+LTTNG_HIDDEN
+int mi_json_writer_close_element(struct mi_json_writer *writer);
+
+LTTNG_HIDDEN
+int mi_json_writer_write_attribute(struct mi_json_writer *writer,
+		const char *name, const char *value);
+
+LTTNG_HIDDEN
+int mi_json_writer_write_element_unsigned_int(struct mi_json_writer *writer,
+		const char *element_name, uint64_t value);
+
+LTTNG_HIDDEN
+int mi_json_writer_write_element_signed_int(struct mi_json_writer *writer,
+		const char *element_name, int64_t value);
+
+LTTNG_HIDDEN
+int mi_json_writer_write_element_bool(struct mi_json_writer *writer,
+		const char *element_name, int value);
+
+LTTNG_HIDDEN
+int mi_json_writer_write_element_string(struct mi_json_writer *writer,
+		const char *element_name, const char *value);
+
+#endif /* _MI_JSON_H */
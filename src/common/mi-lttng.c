@@ -23,6 +23,7 @@
 #include <lttng/snapshot-internal.h>
 #include <lttng/channel.h>
 #include "mi-lttng.h"
+#include "mi-json.h"
 
 #include <assert.h>
 
@@ -452,6 +453,12 @@ struct mi_writer *mi_lttng_writer_create(int fd_output, int mi_output_type)
 			goto err_destroy;
 		}
 		mi_writer->type = LTTNG_MI_XML;
+	} else if (mi_output_type == LTTNG_MI_JSON) {
+		mi_writer->json_writer = mi_json_writer_create(fd_output);
+		if (!mi_writer->json_writer) {
+			goto err_destroy;
+		}
+		mi_writer->type = LTTNG_MI_JSON;
 	} else {
 		goto err_destroy;
 	}
@@ -474,7 +481,11 @@ int mi_lttng_writer_destroy(struct mi_writer *writer)
 		goto end;
 	}
 
-	ret = config_writer_destroy(writer->writer);
+	if (writer->type == LTTNG_MI_JSON) {
+		ret = mi_json_writer_destroy(writer->json_writer);
+	} else {
+		ret = config_writer_destroy(writer->writer);
+	}
 	if (ret < 0) {
 		goto end;
 	}
@@ -493,32 +504,31 @@ int mi_lttng_writer_command_open(struct mi_writer *writer, const char *command)
 	 * A command is always the MI's root node, it must declare the current
 	 * namespace and schema URIs and the schema's version.
 	 */
-	ret = config_writer_open_element(writer->writer,
-			mi_lttng_element_command);
+	ret = mi_lttng_writer_open_element(writer, mi_lttng_element_command);
 	if (ret) {
 		goto end;
 	}
 
-	ret = config_writer_write_attribute(writer->writer,
+	ret = mi_lttng_writer_write_attribute(writer,
 			mi_lttng_xmlns, DEFAULT_LTTNG_MI_NAMESPACE);
 	if (ret) {
 		goto end;
 	}
 
-	ret = config_writer_write_attribute(writer->writer,
+	ret = mi_lttng_writer_write_attribute(writer,
 			mi_lttng_xmlns_xsi, mi_lttng_w3_schema_uri);
 	if (ret) {
 		goto end;
 	}
 
-	ret = config_writer_write_attribute(writer->writer,
+	ret = mi_lttng_writer_write_attribute(writer,
 			mi_lttng_schema_location,
 			mi_lttng_schema_location_uri);
 	if (ret) {
 		goto end;
 	}
 
-	ret = config_writer_write_attribute(writer->writer,
+	ret = mi_lttng_writer_write_attribute(writer,
 			mi_lttng_schema_version,
 			mi_lttng_schema_version_value);
 	if (ret) {
@@ -541,15 +551,33 @@ LTTNG_HIDDEN
 int mi_lttng_writer_open_element(struct mi_writer *writer,
 		const char *element_name)
 {
+	if (writer->type == LTTNG_MI_JSON) {
+		return mi_json_writer_open_element(writer->json_writer,
+				element_name);
+	}
 	return config_writer_open_element(writer->writer, element_name);
 }
 
 LTTNG_HIDDEN
 int mi_lttng_writer_close_element(struct mi_writer *writer)
 {
+	if (writer->type == LTTNG_MI_JSON) {
+		return mi_json_writer_close_element(writer->json_writer);
+	}
 	return config_writer_close_element(writer->writer);
 }
 
+LTTNG_HIDDEN
+int mi_lttng_writer_write_attribute(struct mi_writer *writer,
+		const char *name, const char *value)
+{
+	if (writer->type == LTTNG_MI_JSON) {
+		return mi_json_writer_write_attribute(writer->json_writer,
+				name, value);
+	}
+	return config_writer_write_attribute(writer->writer, name, value);
+}
+
 LTTNG_HIDDEN
 int mi_lttng_close_multi_element(struct mi_writer *writer,
 		unsigned int nb_element)
@@ -574,6 +602,10 @@ LTTNG_HIDDEN
 int mi_lttng_writer_write_element_unsigned_int(struct mi_writer *writer,
 		const char *element_name, uint64_t value)
 {
+	if (writer->type == LTTNG_MI_JSON) {
+		return mi_json_writer_write_element_unsigned_int(writer->json_writer,
+				element_name, value);
+	}
 	return config_writer_write_element_unsigned_int(writer->writer,
 			element_name, value);
 }
@@ -582,6 +614,10 @@ LTTNG_HIDDEN
 int mi_lttng_writer_write_element_signed_int(struct mi_writer *writer,
 		const char *element_name, int64_t value)
 {
+	if (writer->type == LTTNG_MI_JSON) {
+		return mi_json_writer_write_element_signed_int(writer->json_writer,
+				element_name, value);
+	}
 	return config_writer_write_element_signed_int(writer->writer,
 			element_name, value);
 }
@@ -590,6 +626,10 @@ LTTNG_HIDDEN
 int mi_lttng_writer_write_element_bool(struct mi_writer *writer,
 		const char *element_name, int value)
 {
+	if (writer->type == LTTNG_MI_JSON) {
+		return mi_json_writer_write_element_bool(writer->json_writer,
+				element_name, value);
+	}
 	return config_writer_write_element_bool(writer->writer,
 			element_name, value);
 }
@@ -598,6 +638,10 @@ LTTNG_HIDDEN
 int mi_lttng_writer_write_element_string(struct mi_writer *writer,
 		const char *element_name, const char *value)
 {
+	if (writer->type == LTTNG_MI_JSON) {
+		return mi_json_writer_write_element_string(writer->json_writer,
+				element_name, value);
+	}
 	return config_writer_write_element_string(writer->writer,
 			element_name, value);
 }
@@ -864,6 +908,8 @@ int mi_lttng_channel_attr(struct mi_writer *writer,
 			struct lttng_channel, attr);
 	uint64_t discarded_events, lost_packets, monitor_timer_interval;
 	int64_t blocking_timeout;
+	enum lttng_channel_compression compression;
+	int huge_pages;
 
 	assert(attr);
 
@@ -889,6 +935,16 @@ int mi_lttng_channel_attr(struct mi_writer *writer,
 		goto end;
 	}
 
+	ret = lttng_channel_get_compression(chan, &compression);
+	if (ret) {
+		goto end;
+	}
+
+	ret = lttng_channel_get_huge_pages(chan, &huge_pages);
+	if (ret) {
+		goto end;
+	}
+
 	/* Opening Attributes */
 	ret = mi_lttng_writer_open_element(writer, config_element_attributes);
 	if (ret) {
@@ -960,6 +1016,22 @@ int mi_lttng_channel_attr(struct mi_writer *writer,
 		goto end;
 	}
 
+	/* Packet compression */
+	ret = mi_lttng_writer_write_element_string(writer,
+		config_element_compression,
+		compression == LTTNG_CHANNEL_COMPRESSION_ZLIB ?
+		config_compression_zlib : config_compression_none);
+	if (ret) {
+		goto end;
+	}
+
+	/* Huge pages request */
+	ret = mi_lttng_writer_write_element_bool(writer,
+		config_element_huge_pages, huge_pages);
+	if (ret) {
+		goto end;
+	}
+
 	/* Tracefile size in bytes */
 	ret = mi_lttng_writer_write_element_unsigned_int(writer,
 		config_element_tracefile_size, attr->tracefile_size);
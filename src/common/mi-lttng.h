@@ -30,9 +30,13 @@
 /* Don't want to reference snapshot-internal.h here */
 struct lttng_snapshot_output;
 
+struct mi_json_writer;
+
 /* Instance of a machine interface writer. */
 struct mi_writer {
+	/* Set according to the type. */
 	struct config_writer *writer;
+	struct mi_json_writer *json_writer;
 	enum lttng_mi_output_type type;
 };
 
@@ -256,6 +260,19 @@ int mi_lttng_writer_open_element(struct mi_writer *writer,
  */
 int mi_lttng_writer_close_element(struct mi_writer *writer);
 
+/*
+ * Write an attribute of the current element tag.
+ *
+ * writer An instance of a machine interface writer.
+ * name Attribute name.
+ * value Attribute value.
+ *
+ * Returns zero if the attribute could be written.
+ * Negative values indicate an error.
+ */
+int mi_lttng_writer_write_attribute(struct mi_writer *writer,
+		const char *name, const char *value);
+
 /*
  * Close multiple element.
  *
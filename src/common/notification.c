@@ -92,12 +92,15 @@ ssize_t lttng_notification_create_from_buffer(
 {
 	ssize_t ret, notification_size = 0, condition_size, evaluation_size;
 	const struct lttng_notification_comm *notification_comm;
-	struct lttng_condition *condition;
-	struct lttng_evaluation *evaluation;
+	struct lttng_condition *condition = NULL;
+	struct lttng_evaluation *evaluation = NULL;
+	struct lttng_buffer_view payload_view;
 	struct lttng_buffer_view condition_view;
 	struct lttng_buffer_view evaluation_view;
+	char *payload = NULL;
 
-	if (!src_view || !notification) {
+	if (!src_view || !notification ||
+			src_view->size < sizeof(*notification_comm)) {
 		ret = -1;
 		goto end;
 	}
@@ -105,15 +108,35 @@ ssize_t lttng_notification_create_from_buffer(
 	notification_comm =
 			(const struct lttng_notification_comm *) src_view->data;
 	notification_size += sizeof(*notification_comm);
+	if (src_view->size - sizeof(*notification_comm) <
+			notification_comm->length) {
+		ret = -1;
+		goto end;
+	}
+
+	/*
+	 * The source buffer is reused for the next message; copy the
+	 * notification once and let the condition borrow its strings from
+	 * the copy rather than allocating each of them.
+	 */
+	payload_view.size = sizeof(*notification_comm) +
+			notification_comm->length;
+	payload = zmalloc(payload_view.size);
+	if (!payload) {
+		ret = -1;
+		goto end;
+	}
+	memcpy(payload, src_view->data, payload_view.size);
+	payload_view.data = payload;
 
 	/* struct lttng_condition */
-	condition_view = lttng_buffer_view_from_view(src_view,
+	condition_view = lttng_buffer_view_from_view(&payload_view,
 			sizeof(*notification_comm), -1);
-	condition_size = lttng_condition_create_from_buffer(&condition_view,
-			&condition);
+	condition_size = lttng_condition_create_from_buffer_borrowed(
+			&condition_view, &condition);
 	if (condition_size < 0) {
 		ret = condition_size;
-		goto end;
+		goto error;
 	}
 	notification_size += condition_size;
 
@@ -124,7 +147,7 @@ ssize_t lttng_notification_create_from_buffer(
 			&evaluation);
 	if (evaluation_size < 0) {
 		ret = evaluation_size;
-		goto end;
+		goto error;
 	}
 	notification_size += evaluation_size;
 
@@ -142,11 +165,13 @@ ssize_t lttng_notification_create_from_buffer(
 	}
 	ret = notification_size;
 	(*notification)->owns_elements = true;
+	(*notification)->payload = payload;
 end:
 	return ret;
 error:
 	lttng_condition_destroy(condition);
 	lttng_evaluation_destroy(evaluation);
+	free(payload);
 	return ret;
 }
 
@@ -160,6 +185,7 @@ void lttng_notification_destroy(struct lttng_notification *notification)
 		lttng_condition_destroy(notification->condition);
 		lttng_evaluation_destroy(notification->evaluation);
 	}
+	free(notification->payload);
 	free(notification);
 }
 
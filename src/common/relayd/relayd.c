@@ -17,11 +17,15 @@
 
 #define _LGPL_SOURCE
 #include <assert.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <inttypes.h>
+#ifdef __linux__
+#include <linux/errqueue.h>
+#endif
 
 #include <common/common.h>
 #include <common/defaults.h>
@@ -31,12 +35,18 @@
 
 #include "relayd.h"
 
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) && \
+	defined(SO_EE_ORIGIN_ZEROCOPY)
+#define RELAYD_HAVE_ZEROCOPY
+#endif
+
 /*
- * Send command. Fill up the header and append the data.
+ * Send command with the given circuit ID. Fill up the header and append the
+ * data.
  */
-static int send_command(struct lttcomm_relayd_sock *rsock,
-		enum lttcomm_relayd_command cmd, void *data, size_t size,
-		int flags)
+static int send_command_circuit(struct lttcomm_relayd_sock *rsock,
+		enum lttcomm_relayd_command cmd, uint64_t circuit_id,
+		void *data, size_t size, int flags)
 {
 	int ret;
 	struct lttcomm_relayd_hdr header;
@@ -64,7 +74,7 @@ static int send_command(struct lttcomm_relayd_sock *rsock,
 
 	/* Zeroed for now since not used. */
 	header.cmd_version = 0;
-	header.circuit_id = 0;
+	header.circuit_id = htobe64(circuit_id);
 
 	/* Prepare buffer to send. */
 	memcpy(buf, &header, sizeof(header));
@@ -86,6 +96,16 @@ alloc_error:
 	return ret;
 }
 
+/*
+ * Send command. Fill up the header and append the data.
+ */
+static int send_command(struct lttcomm_relayd_sock *rsock,
+		enum lttcomm_relayd_command cmd, void *data, size_t size,
+		int flags)
+{
+	return send_command_circuit(rsock, cmd, 0, data, size, flags);
+}
+
 /*
  * Receive reply data on socket. This MUST be call after send_command or else
  * could result in unexpected behavior(s).
@@ -231,23 +251,18 @@ error:
 }
 
 /*
- * Add stream on the relayd and assign stream handle to the stream_id argument.
+ * Send the command adding a stream on the relayd, without waiting for its
+ * reply.
  *
  * On success return 0 else return ret_code negative value.
  */
-int relayd_add_stream(struct lttcomm_relayd_sock *rsock, const char *channel_name,
-		const char *pathname, uint64_t *stream_id,
+static int send_add_stream(struct lttcomm_relayd_sock *rsock,
+		const char *channel_name, const char *pathname,
 		uint64_t tracefile_size, uint64_t tracefile_count)
 {
 	int ret;
 	struct lttcomm_relayd_add_stream msg;
 	struct lttcomm_relayd_add_stream_2_2 msg_2_2;
-	struct lttcomm_relayd_status_stream reply;
-
-	/* Code flow error. Safety net. */
-	assert(rsock);
-	assert(channel_name);
-	assert(pathname);
 
 	DBG("Relayd adding stream for channel name %s", channel_name);
 
@@ -293,6 +308,22 @@ int relayd_add_stream(struct lttcomm_relayd_sock *rsock, const char *channel_nam
 		}
 	}
 
+error:
+	return ret;
+}
+
+/*
+ * Wait for the reply to an add stream command and assign the stream handle
+ * to the stream_id argument. The reply ret code is set in "replied_ok".
+ *
+ * Return 0 if the reply is received else a negative value.
+ */
+static int recv_add_stream_reply(struct lttcomm_relayd_sock *rsock,
+		uint64_t *stream_id, bool *replied_ok)
+{
+	int ret;
+	struct lttcomm_relayd_status_stream reply;
+
 	/* Waiting for reply */
 	ret = recv_reply(rsock, (void *) &reply, sizeof(reply));
 	if (ret < 0) {
@@ -303,23 +334,250 @@ int relayd_add_stream(struct lttcomm_relayd_sock *rsock, const char *channel_nam
 	reply.handle = be64toh(reply.handle);
 	reply.ret_code = be32toh(reply.ret_code);
 
-	/* Return session id or negative ret code. */
+	ret = 0;
 	if (reply.ret_code != LTTNG_OK) {
-		ret = -1;
+		*replied_ok = false;
 		ERR("Relayd add stream replied error %d", reply.ret_code);
 	} else {
-		/* Success */
-		ret = 0;
+		*replied_ok = true;
 		*stream_id = reply.handle;
+		DBG("Relayd stream added successfully with handle %" PRIu64,
+			reply.handle);
 	}
 
-	DBG("Relayd stream added successfully with handle %" PRIu64,
-		reply.handle);
+error:
+	return ret;
+}
+
+/*
+ * Add stream on the relayd and assign stream handle to the stream_id argument.
+ *
+ * On success return 0 else return ret_code negative value.
+ */
+int relayd_add_stream(struct lttcomm_relayd_sock *rsock, const char *channel_name,
+		const char *pathname, uint64_t *stream_id,
+		uint64_t tracefile_size, uint64_t tracefile_count)
+{
+	int ret;
+
+	/* Code flow error. Safety net. */
+	assert(rsock);
+	assert(channel_name);
+	assert(pathname);
+
+	bool replied_ok;
+
+	ret = send_add_stream(rsock, channel_name, pathname, tracefile_size,
+			tracefile_count);
+	if (ret < 0) {
+		goto error;
+	}
+
+	ret = recv_add_stream_reply(rsock, stream_id, &replied_ok);
+	if (!ret && !replied_ok) {
+		ret = -1;
+	}
+error:
+	return ret;
+}
+
+/*
+ * Add the streams with pipelined RELAYD_ADD_STREAM commands: up to
+ * RELAYD_ADD_STREAMS_WINDOW of them are sent before their replies are
+ * received, instead of one round trip per stream. The relayd processes the
+ * commands of a control connection in order, so this works with any version
+ * of it.
+ */
+static int add_streams_pipelined(struct lttcomm_relayd_sock *rsock,
+		const char **channel_names, const char *pathname,
+		uint64_t *stream_ids, unsigned int nb_streams,
+		uint64_t tracefile_size, uint64_t tracefile_count)
+{
+	int ret = 0;
+	unsigned int sent = 0, received = 0;
+
+	while (received < nb_streams) {
+		int io_ret;
+
+		while (sent < nb_streams &&
+				sent - received < RELAYD_ADD_STREAMS_WINDOW) {
+			io_ret = send_add_stream(rsock, channel_names[sent],
+					pathname, tracefile_size, tracefile_count);
+			if (io_ret < 0) {
+				/* The connection is unusable. */
+				ret = io_ret;
+				goto error;
+			}
+			sent++;
+		}
+
+		/*
+		 * An error reply leaves the connection usable, receive the
+		 * other replies to stay in sync with the relayd.
+		 */
+		do {
+			bool replied_ok;
+
+			io_ret = recv_add_stream_reply(rsock,
+					&stream_ids[received], &replied_ok);
+			if (io_ret < 0) {
+				ret = io_ret;
+				goto error;
+			}
+			if (!replied_ok) {
+				ret = -1;
+			}
+			received++;
+		} while (received < sent);
+	}
 
 error:
 	return ret;
 }
 
+/*
+ * Add at most RELAYD_BULK_STREAMS_MAX streams with a single
+ * RELAYD_ADD_STREAMS command.
+ */
+static int add_streams_bulk(struct lttcomm_relayd_sock *rsock,
+		const char **channel_names, const char *pathname,
+		uint64_t *stream_ids, unsigned int nb_streams,
+		uint64_t tracefile_size, uint64_t tracefile_count)
+{
+	int ret;
+	unsigned int i;
+	char *buf = NULL;
+	size_t len;
+	struct lttcomm_relayd_add_streams msg;
+	struct lttcomm_relayd_add_streams_entry *entries;
+	struct lttcomm_relayd_status_stream *replies = NULL;
+
+	assert(nb_streams <= RELAYD_BULK_STREAMS_MAX);
+
+	len = sizeof(msg) + nb_streams * sizeof(*entries);
+	buf = zmalloc(len);
+	replies = zmalloc(nb_streams * sizeof(*replies));
+	if (!buf || !replies) {
+		PERROR("zmalloc relayd add streams");
+		ret = -1;
+		goto end;
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	if (lttng_strncpy(msg.pathname, pathname, sizeof(msg.pathname))) {
+		ret = -1;
+		goto end;
+	}
+	msg.tracefile_size = htobe64(tracefile_size);
+	msg.tracefile_count = htobe64(tracefile_count);
+	msg.nb_streams = htobe32(nb_streams);
+	memcpy(buf, &msg, sizeof(msg));
+	entries = (struct lttcomm_relayd_add_streams_entry *) (buf + sizeof(msg));
+	for (i = 0; i < nb_streams; i++) {
+		if (lttng_strncpy(entries[i].channel_name, channel_names[i],
+				sizeof(entries[i].channel_name))) {
+			ret = -1;
+			goto end;
+		}
+	}
+
+	/* Send command */
+	ret = send_command(rsock, RELAYD_ADD_STREAMS, buf, len, 0);
+	if (ret < 0) {
+		goto end;
+	}
+
+	/* Waiting for reply */
+	ret = recv_reply(rsock, (void *) replies, nb_streams * sizeof(*replies));
+	if (ret < 0) {
+		goto end;
+	}
+
+	ret = 0;
+	for (i = 0; i < nb_streams; i++) {
+		uint32_t ret_code = be32toh(replies[i].ret_code);
+
+		if (ret_code != LTTNG_OK) {
+			ERR("Relayd add stream replied error %d", ret_code);
+			ret = -1;
+			continue;
+		}
+		stream_ids[i] = be64toh(replies[i].handle);
+	}
+
+	DBG("Relayd added %u streams", nb_streams);
+
+end:
+	free(buf);
+	free(replies);
+	return ret;
+}
+
+/*
+ * Return 1 if the relayd accepts RELAYD_ADD_STREAMS and RELAYD_CLOSE_STREAMS
+ * on this socket, as negotiated by relayd_version_check().
+ */
+int relayd_supports_bulk_streams(struct lttcomm_relayd_sock *rsock)
+{
+	return !!(rsock->features & RELAYD_FEATURE_BULK_STREAMS);
+}
+
+/*
+ * Return 1 if the relayd writes the indexes of the streams of the snapshot
+ * sessions on this socket, as negotiated by relayd_version_check().
+ */
+int relayd_supports_snapshot_index(struct lttcomm_relayd_sock *rsock)
+{
+	return !!(rsock->features & RELAYD_FEATURE_SNAPSHOT_INDEX);
+}
+
+/*
+ * Add the nb_streams streams named channel_names, sharing the same path and
+ * tracefile settings, on the relayd and assign their handles to the
+ * stream_ids array.
+ *
+ * The streams are added with RELAYD_ADD_STREAMS commands of up to
+ * RELAYD_BULK_STREAMS_MAX streams if the relayd supports them, else with
+ * pipelined RELAYD_ADD_STREAM commands. The handle of a stream the relayd
+ * failed to add is left untouched.
+ *
+ * On success return 0 else return ret_code negative value.
+ */
+int relayd_add_streams(struct lttcomm_relayd_sock *rsock,
+		const char **channel_names, const char *pathname,
+		uint64_t *stream_ids, unsigned int nb_streams,
+		uint64_t tracefile_size, uint64_t tracefile_count)
+{
+	int ret = 0;
+	unsigned int i;
+
+	/* Code flow error. Safety net. */
+	assert(rsock);
+	assert(channel_names);
+	assert(pathname);
+	assert(stream_ids);
+
+	if (!relayd_supports_bulk_streams(rsock)) {
+		return add_streams_pipelined(rsock, channel_names, pathname,
+				stream_ids, nb_streams, tracefile_size,
+				tracefile_count);
+	}
+
+	for (i = 0; i < nb_streams; i += RELAYD_BULK_STREAMS_MAX) {
+		int bulk_ret;
+		unsigned int nb = min_t(unsigned int, nb_streams - i,
+				RELAYD_BULK_STREAMS_MAX);
+
+		bulk_ret = add_streams_bulk(rsock, &channel_names[i], pathname,
+				&stream_ids[i], nb, tracefile_size,
+				tracefile_count);
+		if (bulk_ret < 0) {
+			ret = bulk_ret;
+		}
+	}
+	return ret;
+}
+
 /*
  * Inform the relay that all the streams for the current channel has been sent.
  *
@@ -383,6 +641,7 @@ end:
 int relayd_version_check(struct lttcomm_relayd_sock *rsock)
 {
 	int ret;
+	bool has_features;
 	struct lttcomm_relayd_version msg;
 
 	/* Code flow error. Safety net. */
@@ -396,8 +655,10 @@ int relayd_version_check(struct lttcomm_relayd_sock *rsock)
 	msg.major = htobe32(rsock->major);
 	msg.minor = htobe32(rsock->minor);
 
-	/* Send command */
-	ret = send_command(rsock, RELAYD_VERSION, (void *) &msg, sizeof(msg), 0);
+	/* Send command, asking for the features of the relayd. */
+	ret = send_command_circuit(rsock, RELAYD_VERSION,
+			RELAYD_VERSION_FEATURES_MAGIC, (void *) &msg,
+			sizeof(msg), 0);
 	if (ret < 0) {
 		goto error;
 	}
@@ -411,6 +672,8 @@ int relayd_version_check(struct lttcomm_relayd_sock *rsock)
 	/* Set back to host bytes order */
 	msg.major = be32toh(msg.major);
 	msg.minor = be32toh(msg.minor);
+	has_features = msg.minor & RELAYD_VERSION_FEATURES_FLAG;
+	msg.minor &= ~RELAYD_VERSION_FEATURES_FLAG;
 
 	/*
 	 * Only validate the major version. If the other side is higher,
@@ -435,9 +698,36 @@ int relayd_version_check(struct lttcomm_relayd_sock *rsock)
 		rsock->minor = msg.minor;
 	}
 
+	rsock->features = 0;
+	if (has_features) {
+		struct lttcomm_relayd_version_features features;
+
+		ret = recv_reply(rsock, (void *) &features, sizeof(features));
+		if (ret < 0) {
+			goto error;
+		}
+		rsock->features = be64toh(features.features) &
+				RELAYD_FEATURES_KNOWN;
+
+		/* Tell the relayd the features used on this connection. */
+		features.features = htobe64(rsock->features);
+		ret = rsock->sock.ops->sendmsg(&rsock->sock, &features,
+				sizeof(features), 0);
+		if (ret < 0) {
+			goto error;
+		}
+	}
+
 	/* Version number compatible */
-	DBG2("Relayd version is compatible, using protocol version %u.%u",
-			rsock->major, rsock->minor);
+	DBG2("Relayd version is compatible, using protocol version %u.%u "
+			"with features 0x%" PRIx64, rsock->major, rsock->minor,
+			rsock->features);
+	if (relayd_supports_beacons(rsock)) {
+		DBG2("Relayd supports batched live beacons");
+	}
+	if (relayd_supports_wire_compression(rsock)) {
+		DBG2("Relayd supports compressed data packets");
+	}
 	ret = 0;
 
 error:
@@ -539,13 +829,241 @@ end:
 	return ret;
 }
 
+/*
+ * Send the "cnt" iovecs of a packet, its headers followed by "len" bytes of
+ * payload, with a single vectored send.
+ *
+ * Return the number of payload bytes sent, which is less than "len" if the
+ * socket failed after the headers, or else -1 with errno set.
+ */
+static ssize_t send_packet_iov(struct lttcomm_relayd_sock *rsock,
+		struct iovec *iov, int cnt, size_t headers_len)
+{
+	ssize_t ret;
+
+	if (rsock->sock.fd < 0) {
+		errno = ECONNRESET;
+		return -1;
+	}
+
+	ret = rsock->sock.ops->sendmsg_iov(&rsock->sock, iov, cnt, 0);
+	if (ret < 0) {
+		return ret;
+	}
+	return (size_t) ret > headers_len ? ret - headers_len : 0;
+}
+
+/*
+ * Send the data header and the "len" bytes of payload of a data packet
+ * together. The padding is not sent, it is described by the header.
+ *
+ * Return the number of payload bytes sent or else -1 with errno set.
+ */
+ssize_t relayd_send_data_packet(struct lttcomm_relayd_sock *rsock,
+		struct lttcomm_relayd_data_hdr *hdr, const void *data, size_t len)
+{
+	struct iovec iov[2];
+
+	/* Code flow error. Safety net. */
+	assert(rsock);
+	assert(hdr);
+
+	DBG3("Relayd sending data packet of size %zu", len);
+
+	iov[0].iov_base = hdr;
+	iov[0].iov_len = sizeof(*hdr);
+	iov[1].iov_base = (void *) data;
+	iov[1].iov_len = len;
+	return send_packet_iov(rsock, iov, 2, sizeof(*hdr));
+}
+
+/*
+ * Send the RELAYD_SEND_METADATA command, the metadata payload header of the
+ * stream and the "len" bytes of a metadata packet together.
+ *
+ * Return the number of payload bytes sent or else -1 with errno set.
+ */
+ssize_t relayd_send_metadata_packet(struct lttcomm_relayd_sock *rsock,
+		uint64_t stream_id, uint32_t padding, const void *data,
+		size_t len)
+{
+	struct lttcomm_relayd_hdr header;
+	struct lttcomm_relayd_metadata_payload payload_hdr;
+	struct iovec iov[3];
+
+	/* Code flow error. Safety net. */
+	assert(rsock);
+
+	DBG("Relayd sending metadata of size %zu", len);
+
+	memset(&header, 0, sizeof(header));
+	header.cmd = htobe32(RELAYD_SEND_METADATA);
+	header.data_size = htobe64(sizeof(payload_hdr) + len);
+	payload_hdr.stream_id = htobe64(stream_id);
+	payload_hdr.padding_size = htobe32(padding);
+
+	iov[0].iov_base = &header;
+	iov[0].iov_len = sizeof(header);
+	iov[1].iov_base = &payload_hdr;
+	iov[1].iov_len = sizeof(payload_hdr);
+	iov[2].iov_base = (void *) data;
+	iov[2].iov_len = len;
+	return send_packet_iov(rsock, iov, 3,
+			sizeof(header) + sizeof(payload_hdr));
+}
+
+/*
+ * Enable the zero-copy sends (MSG_ZEROCOPY) on a data socket.
+ *
+ * Return 0 on success or else -1, the socket or the kernel not supporting
+ * them.
+ */
+int relayd_enable_zerocopy(struct lttcomm_relayd_sock *rsock)
+{
+#ifdef RELAYD_HAVE_ZEROCOPY
+	int one = 1;
+
+	assert(rsock);
+
+	if (rsock->sock.fd < 0 || rsock->sock.proto != LTTCOMM_SOCK_TCP) {
+		return -1;
+	}
+	if (setsockopt(rsock->sock.fd, SOL_SOCKET, SO_ZEROCOPY, &one,
+			sizeof(one))) {
+		DBG("Zero-copy sends not supported (fd: %d)", rsock->sock.fd);
+		return -1;
+	}
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+/*
+ * Same as relayd_send_data_packet(), sending the payload with MSG_ZEROCOPY:
+ * "data" MUST stay unchanged until the completion of the sends is reaped by
+ * relayd_reap_zerocopy(). "nr_sends" is incremented by the number of
+ * zero-copy sends, each notified on completion.
+ *
+ * Return the number of payload bytes sent or else -1 with errno set.
+ */
+ssize_t relayd_send_data_packet_zerocopy(struct lttcomm_relayd_sock *rsock,
+		struct lttcomm_relayd_data_hdr *hdr, const void *data, size_t len,
+		uint32_t *nr_sends)
+{
+#ifdef RELAYD_HAVE_ZEROCOPY
+	struct iovec iov[2];
+	struct msghdr msg;
+	unsigned int nr_zerocopy = 0;
+	ssize_t ret;
+
+	/* Code flow error. Safety net. */
+	assert(rsock);
+	assert(hdr);
+	assert(nr_sends);
+
+	if (rsock->sock.fd < 0) {
+		errno = ECONNRESET;
+		return -1;
+	}
+
+	DBG3("Relayd sending zero-copy data packet of size %zu", len);
+
+	iov[0].iov_base = hdr;
+	iov[0].iov_len = sizeof(*hdr);
+	iov[1].iov_base = (void *) data;
+	iov[1].iov_len = len;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 2;
+
+	ret = lttcomm_sendmsg_all_count(rsock->sock.fd, &msg, MSG_ZEROCOPY,
+			&nr_zerocopy);
+	*nr_sends += nr_zerocopy;
+	if (ret < 0) {
+		if (errno != EPIPE || !lttng_opt_quiet) {
+			PERROR("sendmsg zero-copy");
+		}
+		return ret;
+	}
+	return (size_t) ret > sizeof(*hdr) ? ret - sizeof(*hdr) : 0;
+#else
+	return relayd_send_data_packet(rsock, hdr, data, len);
+#endif
+}
+
+/*
+ * Reap the zero-copy completion notifications queued on a data socket,
+ * without blocking. "completed" is set past the last zero-copy send completed
+ * and "copied" to 1 if the kernel had to copy the data anyway, in which case
+ * the zero-copy sends only add overhead.
+ *
+ * Return 0 on success or else -1 with errno set on a socket error.
+ */
+int relayd_reap_zerocopy(struct lttcomm_relayd_sock *rsock,
+		uint32_t *completed, int *copied)
+{
+#ifdef RELAYD_HAVE_ZEROCOPY
+	assert(rsock);
+	assert(completed);
+	assert(copied);
+
+	for (;;) {
+		struct msghdr msg;
+		struct cmsghdr *cmsg;
+		char control[CMSG_SPACE(sizeof(struct sock_extended_err)) + 64];
+		ssize_t ret;
+
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		ret = recvmsg(rsock->sock.fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT);
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				return 0;
+			}
+			return -1;
+		}
+
+		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+				cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			struct sock_extended_err *serr;
+
+			if (!((cmsg->cmsg_level == SOL_IP &&
+					cmsg->cmsg_type == IP_RECVERR) ||
+					(cmsg->cmsg_level == SOL_IPV6 &&
+					cmsg->cmsg_type == IPV6_RECVERR))) {
+				continue;
+			}
+			serr = (struct sock_extended_err *) CMSG_DATA(cmsg);
+			if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+				continue;
+			}
+			/* The sends from ee_info to ee_data are completed. */
+			if ((int32_t) (serr->ee_data + 1 - *completed) > 0) {
+				*completed = serr->ee_data + 1;
+			}
+			if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+				*copied = 1;
+			}
+		}
+	}
+#else
+	return 0;
+#endif
+}
+
 /*
  * Send data header structure to the relayd.
  */
 int relayd_send_data_hdr(struct lttcomm_relayd_sock *rsock,
 		struct lttcomm_relayd_data_hdr *hdr, size_t size)
 {
-	int ret;
+	int ret, flags = 0;
 
 	/* Code flow error. Safety net. */
 	assert(rsock);
@@ -557,13 +1075,21 @@ int relayd_send_data_hdr(struct lttcomm_relayd_sock *rsock,
 
 	DBG3("Relayd sending data header of size %zu", size);
 
+	/*
+	 * With a tuning profile, hold the header until the payload is sent so
+	 * that they share a segment even with TCP_NODELAY.
+	 */
+	if (rsock->sock.profile != LTTNG_SOCK_PROFILE_DEFAULT) {
+		flags |= MSG_MORE;
+	}
+
 	/* Again, safety net */
 	if (size == 0) {
 		size = sizeof(struct lttcomm_relayd_data_hdr);
 	}
 
 	/* Only send data header. */
-	ret = rsock->sock.ops->sendmsg(&rsock->sock, hdr, size, 0);
+	ret = rsock->sock.ops->sendmsg(&rsock->sock, hdr, size, flags);
 	if (ret < 0) {
 		ret = -errno;
 		goto error;
@@ -626,6 +1152,109 @@ error:
 	return ret;
 }
 
+/*
+ * Close at most RELAYD_BULK_STREAMS_MAX streams with a single
+ * RELAYD_CLOSE_STREAMS command.
+ */
+static int close_streams_bulk(struct lttcomm_relayd_sock *rsock,
+		const struct lttcomm_relayd_close_stream *streams,
+		unsigned int nb_streams)
+{
+	int ret;
+	char *buf;
+	size_t len;
+	struct lttcomm_relayd_close_streams msg;
+	struct lttcomm_relayd_generic_reply reply;
+
+	assert(nb_streams <= RELAYD_BULK_STREAMS_MAX);
+
+	len = sizeof(msg) + nb_streams * sizeof(*streams);
+	buf = zmalloc(len);
+	if (!buf) {
+		PERROR("zmalloc relayd close streams");
+		ret = -1;
+		goto end;
+	}
+	msg.nb_streams = htobe32(nb_streams);
+	memcpy(buf, &msg, sizeof(msg));
+	memcpy(buf + sizeof(msg), streams, nb_streams * sizeof(*streams));
+
+	/* Send command */
+	ret = send_command(rsock, RELAYD_CLOSE_STREAMS, buf, len, 0);
+	free(buf);
+	if (ret < 0) {
+		goto end;
+	}
+
+	/* Receive response */
+	ret = recv_reply(rsock, (void *) &reply, sizeof(reply));
+	if (ret < 0) {
+		goto end;
+	}
+
+	reply.ret_code = be32toh(reply.ret_code);
+	if (reply.ret_code != LTTNG_OK) {
+		ret = -1;
+		ERR("Relayd close streams replied error %d", reply.ret_code);
+		goto end;
+	}
+
+	ret = 0;
+	DBG("Relayd closed %u streams", nb_streams);
+
+end:
+	return ret;
+}
+
+/*
+ * Close many streams on the relayd. The streams are expected in big endian.
+ *
+ * The streams are closed with RELAYD_CLOSE_STREAMS commands of up to
+ * RELAYD_BULK_STREAMS_MAX streams if the relayd supports them, else with a
+ * RELAYD_CLOSE_STREAM command per stream.
+ *
+ * On success return 0 else return ret_code negative value.
+ */
+int relayd_close_streams(struct lttcomm_relayd_sock *rsock,
+		const struct lttcomm_relayd_close_stream *streams,
+		unsigned int nb_streams)
+{
+	int ret = 0;
+	unsigned int i;
+
+	/* Code flow error. Safety net. */
+	assert(rsock);
+	assert(streams || !nb_streams);
+
+	if (relayd_supports_bulk_streams(rsock)) {
+		for (i = 0; i < nb_streams; i += RELAYD_BULK_STREAMS_MAX) {
+			int bulk_ret;
+
+			bulk_ret = close_streams_bulk(rsock, &streams[i],
+					min_t(unsigned int, nb_streams - i,
+						RELAYD_BULK_STREAMS_MAX));
+			if (bulk_ret < 0) {
+				ret = bulk_ret;
+			}
+		}
+		goto end;
+	}
+
+	for (i = 0; i < nb_streams; i++) {
+		int close_ret;
+
+		close_ret = relayd_send_close_stream(rsock,
+				be64toh(streams[i].stream_id),
+				be64toh(streams[i].last_net_seq_num));
+		if (close_ret < 0) {
+			ret = close_ret;
+		}
+	}
+
+end:
+	return ret;
+}
+
 /*
  * Check for data availability for a given stream id.
  *
@@ -816,19 +1445,99 @@ error:
 	return ret;
 }
 
+/*
+ * Fill the index message of a packet for the protocol version of the socket.
+ * The packet index is already in big endian.
+ */
+static void fill_index_msg(struct lttcomm_relayd_sock *rsock,
+		struct lttcomm_relayd_index *msg,
+		const struct ctf_packet_index *index, uint64_t relay_stream_id,
+		uint64_t net_seq_num)
+{
+	memset(msg, 0, sizeof(*msg));
+	msg->relay_stream_id = htobe64(relay_stream_id);
+	msg->net_seq_num = htobe64(net_seq_num);
+
+	/* The index is already in big endian. */
+	msg->packet_size = index->packet_size;
+	msg->content_size = index->content_size;
+	msg->timestamp_begin = index->timestamp_begin;
+	msg->timestamp_end = index->timestamp_end;
+	msg->events_discarded = index->events_discarded;
+	msg->stream_id = index->stream_id;
+
+	if (rsock->minor >= 8) {
+		msg->stream_instance_id = index->stream_instance_id;
+		msg->packet_seq_num = index->packet_seq_num;
+	}
+	if (rsock->features & RELAYD_FEATURE_INDEX_EVENTS) {
+		msg->events_count = index->events_count;
+	}
+}
+
+/*
+ * Receive the reply to RELAYD_SEND_INDEX or RELAYD_SEND_INDEXES.
+ *
+ * Return 0 on success else a negative value.
+ */
+static int recv_index_reply(struct lttcomm_relayd_sock *rsock,
+		uint32_t *backpressure, uint64_t *write_lag_ns)
+{
+	int ret;
+	struct lttcomm_relayd_index_reply reply;
+	size_t reply_len;
+
+	if (rsock->features & RELAYD_FEATURE_BACKPRESSURE) {
+		reply_len = sizeof(reply);
+	} else {
+		reply_len = sizeof(struct lttcomm_relayd_generic_reply);
+	}
+	ret = recv_reply(rsock, (void *) &reply, reply_len);
+	if (ret < 0) {
+		goto error;
+	}
+
+	reply.ret_code = be32toh(reply.ret_code);
+
+	/* Return session id or negative ret code. */
+	if (reply.ret_code != LTTNG_OK) {
+		ret = -1;
+		ERR("Relayd send index replied error %d", reply.ret_code);
+	} else {
+		/* Success */
+		ret = 0;
+		if (rsock->features & RELAYD_FEATURE_BACKPRESSURE) {
+			*backpressure = be32toh(reply.backpressure);
+			*write_lag_ns = be64toh(reply.write_lag_ns);
+		}
+	}
+
+error:
+	return ret;
+}
+
 /*
  * Send index to the relayd.
+ *
+ * The backpressure level and write lag of the session advertised by the
+ * relayd are returned in "backpressure" and "write_lag_ns", or
+ * RELAYD_BACKPRESSURE_NONE and 0 without RELAYD_FEATURE_BACKPRESSURE.
  */
 int relayd_send_index(struct lttcomm_relayd_sock *rsock,
 		struct ctf_packet_index *index, uint64_t relay_stream_id,
-		uint64_t net_seq_num)
+		uint64_t net_seq_num, uint32_t *backpressure,
+		uint64_t *write_lag_ns)
 {
 	int ret;
 	struct lttcomm_relayd_index msg;
-	struct lttcomm_relayd_generic_reply reply;
 
 	/* Code flow error. Safety net. */
 	assert(rsock);
+	assert(backpressure);
+	assert(write_lag_ns);
+
+	*backpressure = RELAYD_BACKPRESSURE_NONE;
+	*write_lag_ns = 0;
 
 	if (rsock->minor < 4) {
 		DBG("Not sending indexes before protocol 2.4");
@@ -838,51 +1547,265 @@ int relayd_send_index(struct lttcomm_relayd_sock *rsock,
 
 	DBG("Relayd sending index for stream ID %" PRIu64, relay_stream_id);
 
-	memset(&msg, 0, sizeof(msg));
-	msg.relay_stream_id = htobe64(relay_stream_id);
-	msg.net_seq_num = htobe64(net_seq_num);
-
-	/* The index is already in big endian. */
-	msg.packet_size = index->packet_size;
-	msg.content_size = index->content_size;
-	msg.timestamp_begin = index->timestamp_begin;
-	msg.timestamp_end = index->timestamp_end;
-	msg.events_discarded = index->events_discarded;
-	msg.stream_id = index->stream_id;
-
-	if (rsock->minor >= 8) {
-		msg.stream_instance_id = index->stream_instance_id;
-		msg.packet_seq_num = index->packet_seq_num;
-	}
+	fill_index_msg(rsock, &msg, index, relay_stream_id, net_seq_num);
 
 	/* Send command */
 	ret = send_command(rsock, RELAYD_SEND_INDEX, &msg,
 		lttcomm_relayd_index_len(lttng_to_index_major(rsock->major,
 								rsock->minor),
-				lttng_to_index_minor(rsock->major, rsock->minor)),
+				lttcomm_relayd_index_minor(rsock->major,
+					rsock->minor, rsock->features)),
 				0);
 	if (ret < 0) {
 		goto error;
 	}
 
+	/* Receive response */
+	ret = recv_index_reply(rsock, backpressure, write_lag_ns);
+
+error:
+	return ret;
+}
+
+/*
+ * Return 1 if the relayd accepts RELAYD_SEND_INDEXES on this socket, as
+ * negotiated by relayd_version_check().
+ */
+int relayd_supports_bulk_indexes(struct lttcomm_relayd_sock *rsock)
+{
+	return !!(rsock->features & RELAYD_FEATURE_BULK_INDEXES);
+}
+
+/*
+ * Encode the index of a packet in "msg", an entry of a RELAYD_SEND_INDEXES
+ * message. The packet index is already in big endian.
+ */
+void relayd_fill_bulk_index(struct lttcomm_relayd_sock *rsock,
+		struct lttcomm_relayd_index *msg,
+		const struct ctf_packet_index *index, uint64_t relay_stream_id,
+		uint64_t net_seq_num)
+{
+	assert(relayd_supports_bulk_indexes(rsock));
+
+	fill_index_msg(rsock, msg, index, relay_stream_id, net_seq_num);
+}
+
+/*
+ * Send the indexes of many packets in a single message, encoded with
+ * relayd_fill_bulk_index(). The backpressure is returned like
+ * relayd_send_index().
+ *
+ * On success return 0 else a negative value.
+ */
+int relayd_send_indexes(struct lttcomm_relayd_sock *rsock,
+		const struct lttcomm_relayd_index *indexes,
+		unsigned int nb_indexes, uint32_t *backpressure,
+		uint64_t *write_lag_ns)
+{
+	int ret;
+	char *buf;
+	size_t len;
+	struct lttcomm_relayd_indexes msg;
+
+	/* Code flow error. Safety net. */
+	assert(rsock);
+	assert(nb_indexes <= RELAYD_INDEXES_MAX);
+	assert(backpressure);
+	assert(write_lag_ns);
+
+	*backpressure = RELAYD_BACKPRESSURE_NONE;
+	*write_lag_ns = 0;
+
+	if (!relayd_supports_bulk_indexes(rsock)) {
+		DBG("Relayd does not support index batches");
+		ret = -1;
+		goto end;
+	}
+
+	DBG("Relayd sending %u indexes", nb_indexes);
+
+	len = sizeof(msg) + nb_indexes * sizeof(*indexes);
+	buf = zmalloc(len);
+	if (!buf) {
+		PERROR("zmalloc relayd indexes");
+		ret = -1;
+		goto end;
+	}
+	msg.nb_indexes = htobe32(nb_indexes);
+	memcpy(buf, &msg, sizeof(msg));
+	memcpy(buf + sizeof(msg), indexes, nb_indexes * sizeof(*indexes));
+
+	/* Send command */
+	ret = send_command(rsock, RELAYD_SEND_INDEXES, buf, len, 0);
+	free(buf);
+	if (ret < 0) {
+		goto end;
+	}
+
+	/* Receive response */
+	ret = recv_index_reply(rsock, backpressure, write_lag_ns);
+
+end:
+	return ret;
+}
+
+/*
+ * Return 1 if the relayd accepts RELAYD_SEND_BEACONS on this socket, as
+ * negotiated by relayd_version_check().
+ */
+int relayd_supports_beacons(struct lttcomm_relayd_sock *rsock)
+{
+	return !!(rsock->features & RELAYD_FEATURE_BEACONS);
+}
+
+/*
+ * Return 1 if the relayd inflates the data packets flagged
+ * RELAYD_DATA_COMPRESSED, as negotiated by relayd_version_check().
+ */
+int relayd_supports_wire_compression(struct lttcomm_relayd_sock *rsock)
+{
+	return !!(rsock->features & RELAYD_FEATURE_WIRE_COMPRESSION);
+}
+
+/*
+ * Send the live beacons of many streams in a single message. The beacons are
+ * expected in big endian.
+ *
+ * On success return 0 else a negative value.
+ */
+int relayd_send_beacons(struct lttcomm_relayd_sock *rsock,
+		const struct lttcomm_relayd_beacon *beacons,
+		unsigned int nb_beacons)
+{
+	int ret;
+	char *buf;
+	size_t len;
+	struct lttcomm_relayd_beacons msg;
+	struct lttcomm_relayd_generic_reply reply;
+
+	/* Code flow error. Safety net. */
+	assert(rsock);
+	assert(nb_beacons <= RELAYD_BEACONS_MAX);
+
+	if (!relayd_supports_beacons(rsock)) {
+		DBG("Relayd does not support beacon batches");
+		ret = -1;
+		goto end;
+	}
+
+	DBG("Relayd sending %u live beacons", nb_beacons);
+
+	len = sizeof(msg) + nb_beacons * sizeof(*beacons);
+	buf = zmalloc(len);
+	if (!buf) {
+		PERROR("zmalloc relayd beacons");
+		ret = -1;
+		goto end;
+	}
+	msg.nb_beacons = htobe32(nb_beacons);
+	memcpy(buf, &msg, sizeof(msg));
+	memcpy(buf + sizeof(msg), beacons, nb_beacons * sizeof(*beacons));
+
+	/* Send command */
+	ret = send_command(rsock, RELAYD_SEND_BEACONS, buf, len, 0);
+	free(buf);
+	if (ret < 0) {
+		goto end;
+	}
+
 	/* Receive response */
 	ret = recv_reply(rsock, (void *) &reply, sizeof(reply));
 	if (ret < 0) {
-		goto error;
+		goto end;
 	}
 
 	reply.ret_code = be32toh(reply.ret_code);
 
-	/* Return session id or negative ret code. */
 	if (reply.ret_code != LTTNG_OK) {
 		ret = -1;
-		ERR("Relayd send index replied error %d", reply.ret_code);
+		ERR("Relayd send beacons replied error %d", reply.ret_code);
 	} else {
 		/* Success */
 		ret = 0;
 	}
 
-error:
+end:
+	return ret;
+}
+
+/*
+ * Return 1 if the relayd accepts RELAYD_STREAMS_DATA_PENDING on this socket,
+ * as negotiated by relayd_version_check().
+ */
+int relayd_supports_streams_data_pending(struct lttcomm_relayd_sock *rsock)
+{
+	return !!(rsock->features & RELAYD_FEATURE_STREAMS_DATA_PENDING);
+}
+
+/*
+ * Check for data pending on many streams in a single message, in the scope
+ * of a begin/end data pending command. The streams are expected in big
+ * endian.
+ *
+ * Return 1 if data is pending on at least one stream, 0 if not or else a
+ * negative value.
+ */
+int relayd_streams_data_pending(struct lttcomm_relayd_sock *rsock,
+		const struct lttcomm_relayd_stream_data_pending *streams,
+		unsigned int nb_streams)
+{
+	int ret;
+	char *buf;
+	size_t len;
+	struct lttcomm_relayd_streams_data_pending msg;
+	struct lttcomm_relayd_generic_reply reply;
+
+	/* Code flow error. Safety net. */
+	assert(rsock);
+	assert(nb_streams <= RELAYD_STREAMS_DATA_PENDING_MAX);
+
+	if (!relayd_supports_streams_data_pending(rsock)) {
+		DBG("Relayd does not support batched data pending checks");
+		ret = -1;
+		goto end;
+	}
+
+	DBG("Relayd data pending for %u streams", nb_streams);
+
+	len = sizeof(msg) + nb_streams * sizeof(*streams);
+	buf = zmalloc(len);
+	if (!buf) {
+		PERROR("zmalloc relayd streams data pending");
+		ret = -1;
+		goto end;
+	}
+	msg.nb_streams = htobe32(nb_streams);
+	memcpy(buf, &msg, sizeof(msg));
+	memcpy(buf + sizeof(msg), streams, nb_streams * sizeof(*streams));
+
+	/* Send command */
+	ret = send_command(rsock, RELAYD_STREAMS_DATA_PENDING, buf, len, 0);
+	free(buf);
+	if (ret < 0) {
+		goto end;
+	}
+
+	/* Receive response */
+	ret = recv_reply(rsock, (void *) &reply, sizeof(reply));
+	if (ret < 0) {
+		goto end;
+	}
+
+	ret = (int32_t) be32toh(reply.ret_code);
+	if (ret < 0) {
+		ERR("Relayd streams data pending replied error %d", ret);
+		goto end;
+	}
+
+	DBG("Relayd data is %s pending for %u streams",
+			ret == 1 ? "" : "NOT", nb_streams);
+
+end:
 	return ret;
 }
 
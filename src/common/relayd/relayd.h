@@ -20,6 +20,9 @@
 
 #include <unistd.h>
 
+/* Add stream commands sent to a relayd before waiting for their replies. */
+#define RELAYD_ADD_STREAMS_WINDOW	64
+
 #include <common/sessiond-comm/relayd.h>
 #include <common/sessiond-comm/sessiond-comm.h>
 
@@ -31,14 +34,32 @@ int relayd_create_session(struct lttcomm_relayd_sock *sock, uint64_t *session_id
 int relayd_add_stream(struct lttcomm_relayd_sock *sock, const char *channel_name,
 		const char *pathname, uint64_t *stream_id,
 		uint64_t tracefile_size, uint64_t tracefile_count);
+int relayd_add_streams(struct lttcomm_relayd_sock *rsock,
+		const char **channel_names, const char *pathname,
+		uint64_t *stream_ids, unsigned int nb_streams,
+		uint64_t tracefile_size, uint64_t tracefile_count);
 int relayd_streams_sent(struct lttcomm_relayd_sock *rsock);
 int relayd_send_close_stream(struct lttcomm_relayd_sock *sock, uint64_t stream_id,
 		uint64_t last_net_seq_num);
+int relayd_close_streams(struct lttcomm_relayd_sock *rsock,
+		const struct lttcomm_relayd_close_stream *streams,
+		unsigned int nb_streams);
 int relayd_version_check(struct lttcomm_relayd_sock *sock);
 int relayd_start_data(struct lttcomm_relayd_sock *sock);
 int relayd_send_metadata(struct lttcomm_relayd_sock *sock, size_t len);
 int relayd_send_data_hdr(struct lttcomm_relayd_sock *sock,
 		struct lttcomm_relayd_data_hdr *hdr, size_t size);
+ssize_t relayd_send_data_packet(struct lttcomm_relayd_sock *sock,
+		struct lttcomm_relayd_data_hdr *hdr, const void *data, size_t len);
+int relayd_enable_zerocopy(struct lttcomm_relayd_sock *sock);
+ssize_t relayd_send_data_packet_zerocopy(struct lttcomm_relayd_sock *sock,
+		struct lttcomm_relayd_data_hdr *hdr, const void *data, size_t len,
+		uint32_t *nr_sends);
+int relayd_reap_zerocopy(struct lttcomm_relayd_sock *sock,
+		uint32_t *completed, int *copied);
+ssize_t relayd_send_metadata_packet(struct lttcomm_relayd_sock *sock,
+		uint64_t stream_id, uint32_t padding, const void *data,
+		size_t len);
 int relayd_data_pending(struct lttcomm_relayd_sock *sock, uint64_t stream_id,
 		uint64_t last_net_seq_num);
 int relayd_quiescent_control(struct lttcomm_relayd_sock *sock,
@@ -48,8 +69,29 @@ int relayd_end_data_pending(struct lttcomm_relayd_sock *sock, uint64_t id,
 		unsigned int *is_data_inflight);
 int relayd_send_index(struct lttcomm_relayd_sock *rsock,
 		struct ctf_packet_index *index, uint64_t relay_stream_id,
+		uint64_t net_seq_num, uint32_t *backpressure,
+		uint64_t *write_lag_ns);
+int relayd_supports_bulk_indexes(struct lttcomm_relayd_sock *rsock);
+void relayd_fill_bulk_index(struct lttcomm_relayd_sock *rsock,
+		struct lttcomm_relayd_index *msg,
+		const struct ctf_packet_index *index, uint64_t relay_stream_id,
 		uint64_t net_seq_num);
+int relayd_send_indexes(struct lttcomm_relayd_sock *rsock,
+		const struct lttcomm_relayd_index *indexes,
+		unsigned int nb_indexes, uint32_t *backpressure,
+		uint64_t *write_lag_ns);
 int relayd_reset_metadata(struct lttcomm_relayd_sock *rsock,
 		uint64_t stream_id, uint64_t version);
+int relayd_supports_beacons(struct lttcomm_relayd_sock *rsock);
+int relayd_supports_wire_compression(struct lttcomm_relayd_sock *rsock);
+int relayd_send_beacons(struct lttcomm_relayd_sock *rsock,
+		const struct lttcomm_relayd_beacon *beacons,
+		unsigned int nb_beacons);
+int relayd_supports_streams_data_pending(struct lttcomm_relayd_sock *rsock);
+int relayd_supports_bulk_streams(struct lttcomm_relayd_sock *rsock);
+int relayd_supports_snapshot_index(struct lttcomm_relayd_sock *rsock);
+int relayd_streams_data_pending(struct lttcomm_relayd_sock *rsock,
+		const struct lttcomm_relayd_stream_data_pending *streams,
+		unsigned int nb_streams);
 
 #endif /* _RELAYD_H */
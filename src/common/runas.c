@@ -31,6 +31,7 @@
 #include <signal.h>
 #include <assert.h>
 #include <signal.h>
+#include <urcu/uatomic.h>
 
 #include <common/common.h>
 #include <common/utils.h>
@@ -53,22 +54,40 @@ struct run_as_open_data {
 	char path[PATH_MAX];
 	int flags;
 	mode_t mode;
+	/* Directory of the relative path of RUN_AS_OPENAT. */
+	int dirfd;
 };
 
 struct run_as_unlink_data {
 	char path[PATH_MAX];
+	/* Directory of the relative path of RUN_AS_UNLINKAT. */
+	int dirfd;
 };
 
 struct run_as_rmdir_recursive_data {
 	char path[PATH_MAX];
 };
 
+struct run_as_rename_data {
+	char old_path[PATH_MAX];
+	char new_path[PATH_MAX];
+};
+
+struct run_as_symlink_data {
+	char target[PATH_MAX];
+	char path[PATH_MAX];
+};
+
 enum run_as_cmd {
 	RUN_AS_MKDIR,
 	RUN_AS_OPEN,
 	RUN_AS_UNLINK,
 	RUN_AS_RMDIR_RECURSIVE,
 	RUN_AS_MKDIR_RECURSIVE,
+	RUN_AS_RENAME,
+	RUN_AS_OPENAT,
+	RUN_AS_UNLINKAT,
+	RUN_AS_SYMLINK,
 };
 
 struct run_as_data {
@@ -78,6 +97,8 @@ struct run_as_data {
 		struct run_as_open_data open;
 		struct run_as_unlink_data unlink;
 		struct run_as_rmdir_recursive_data rmdir_recursive;
+		struct run_as_rename_data rename;
+		struct run_as_symlink_data symlink;
 	} u;
 	uid_t uid;
 	gid_t gid;
@@ -92,11 +113,19 @@ struct run_as_worker {
 	pid_t pid;	/* Worker PID. */
 	int sockpair[2];
 	char *procname;
+	/* Serializes the commands sent to the worker. */
+	pthread_mutex_t lock;
 };
 
-/* Single global worker per process (for now). */
-static struct run_as_worker *global_worker;
-/* Lock protecting the worker. */
+/* Maximum number of commands of a batch sent ahead of their replies. */
+#define RUN_AS_BATCH_WINDOW	16
+
+/* Pool of workers of the process. */
+static struct run_as_worker **workers;
+static unsigned int nr_workers;
+/* Worker waited for when they are all busy. */
+static unsigned long next_worker;
+/* Lock protecting the creation and destruction of the workers. */
 static pthread_mutex_t worker_lock = PTHREAD_MUTEX_INITIALIZER;
 
 #ifdef VALGRIND
@@ -156,6 +185,31 @@ int _rmdir_recursive(struct run_as_data *data)
 	return utils_recursive_rmdir(data->u.rmdir_recursive.path);
 }
 
+static
+int _rename(struct run_as_data *data)
+{
+	return rename(data->u.rename.old_path, data->u.rename.new_path);
+}
+
+static
+int _openat(struct run_as_data *data)
+{
+	return openat(data->u.open.dirfd, data->u.open.path,
+			data->u.open.flags, data->u.open.mode);
+}
+
+static
+int _unlinkat(struct run_as_data *data)
+{
+	return unlinkat(data->u.unlink.dirfd, data->u.unlink.path, 0);
+}
+
+static
+int _symlink(struct run_as_data *data)
+{
+	return symlink(data->u.symlink.target, data->u.symlink.path);
+}
+
 static
 run_as_fct run_as_enum_to_fct(enum run_as_cmd cmd)
 {
@@ -170,6 +224,14 @@ run_as_fct run_as_enum_to_fct(enum run_as_cmd cmd)
 		return _rmdir_recursive;
 	case RUN_AS_MKDIR_RECURSIVE:
 		return _mkdir_recursive;
+	case RUN_AS_RENAME:
+		return _rename;
+	case RUN_AS_OPENAT:
+		return _openat;
+	case RUN_AS_UNLINKAT:
+		return _unlinkat;
+	case RUN_AS_SYMLINK:
+		return _symlink;
 	default:
 		ERR("Unknown command %d", (int) cmd);
 		return NULL;
@@ -184,6 +246,7 @@ int do_send_fd(struct run_as_worker *worker,
 
 	switch (cmd) {
 	case RUN_AS_OPEN:
+	case RUN_AS_OPENAT:
 		break;
 	default:
 		return 0;
@@ -211,6 +274,7 @@ int do_recv_fd(struct run_as_worker *worker,
 
 	switch (cmd) {
 	case RUN_AS_OPEN:
+	case RUN_AS_OPENAT:
 		break;
 	default:
 		return 0;
@@ -228,6 +292,23 @@ int do_recv_fd(struct run_as_worker *worker,
 	return 0;
 }
 
+/*
+ * Directory of the relative path of a command, which is sent along with the
+ * command.
+ */
+static
+int *cmd_dirfd(struct run_as_data *data)
+{
+	switch (data->cmd) {
+	case RUN_AS_OPENAT:
+		return &data->u.open.dirfd;
+	case RUN_AS_UNLINKAT:
+		return &data->u.unlink.dirfd;
+	default:
+		return NULL;
+	}
+}
+
 /*
  * Return < 0 on error, 0 if OK, 1 on hangup.
  */
@@ -240,6 +321,7 @@ int handle_one_cmd(struct run_as_worker *worker)
 	struct run_as_ret sendret;
 	run_as_fct cmd;
 	uid_t prev_euid;
+	int *dirfd;
 
 	/* Read data */
 	readlen = lttcomm_recv_unix_sock(worker->sockpair[1], &data,
@@ -261,6 +343,17 @@ int handle_one_cmd(struct run_as_worker *worker)
 		goto end;
 	}
 
+	dirfd = cmd_dirfd(&data);
+	if (dirfd) {
+		readlen = lttcomm_recv_fds_unix_sock(worker->sockpair[1],
+				dirfd, 1);
+		if (readlen <= 0) {
+			PERROR("lttcomm_recv_fds_unix_sock error");
+			ret = -1;
+			goto end;
+		}
+	}
+
 	prev_euid = getuid();
 	if (data.gid != getegid()) {
 		ret = setegid(data.gid);
@@ -285,6 +378,9 @@ int handle_one_cmd(struct run_as_worker *worker)
 write_return:
 	sendret.ret = ret;
 	sendret._errno = errno;
+	if (dirfd && close(*dirfd)) {
+		PERROR("close");
+	}
 	/* send back return value */
 	writelen = lttcomm_send_unix_sock(worker->sockpair[1], &sendret,
 			sizeof(sendret));
@@ -358,25 +454,29 @@ end:
 	return ret;
 }
 
+/*
+ * Send a command to the worker without waiting for its result.
+ *
+ * Return 0 on success or else -1 with errno set.
+ */
 static
-int run_as_cmd(struct run_as_worker *worker,
+int run_as_send_cmd(struct run_as_worker *worker,
 		enum run_as_cmd cmd,
 		struct run_as_data *data,
 		uid_t uid, gid_t gid)
 {
-	ssize_t readlen, writelen;
-	struct run_as_ret recvret;
+	ssize_t writelen;
+	int *dirfd;
 
 	/*
 	 * If we are non-root, we can only deal with our own uid.
 	 */
 	if (geteuid() != 0) {
 		if (uid != geteuid()) {
-			recvret.ret = -1;
-			recvret._errno = EPERM;
 			ERR("Client (%d)/Server (%d) UID mismatch (and sessiond is not root)",
 				(int) uid, (int) geteuid());
-			goto end;
+			errno = EPERM;
+			return -1;
 		}
 	}
 
@@ -388,10 +488,29 @@ int run_as_cmd(struct run_as_worker *worker,
 			sizeof(*data));
 	if (writelen < sizeof(*data)) {
 		PERROR("Error writing message to run_as");
-		recvret.ret = -1;
-		recvret._errno = errno;
-		goto end;
+		return -1;
+	}
+	dirfd = cmd_dirfd(data);
+	if (dirfd) {
+		writelen = lttcomm_send_fds_unix_sock(worker->sockpair[0],
+				dirfd, 1);
+		if (writelen < 0) {
+			PERROR("Error sending directory to run_as");
+			return -1;
+		}
 	}
+	return 0;
+}
+
+/*
+ * Receive the result of the oldest command sent to the worker, and its file
+ * descriptor for an open. errno is set to the errno of the command.
+ */
+static
+int run_as_recv_ret(struct run_as_worker *worker, enum run_as_cmd cmd)
+{
+	ssize_t readlen;
+	struct run_as_ret recvret;
 
 	/* receive return value */
 	readlen = lttcomm_recv_unix_sock(worker->sockpair[0], &recvret,
@@ -416,6 +535,39 @@ end:
 	return recvret.ret;
 }
 
+static
+int run_as_cmd(struct run_as_worker *worker,
+		enum run_as_cmd cmd,
+		struct run_as_data *data,
+		uid_t uid, gid_t gid)
+{
+	if (run_as_send_cmd(worker, cmd, data, uid, gid)) {
+		return -1;
+	}
+	return run_as_recv_ret(worker, cmd);
+}
+
+/*
+ * Get an idle worker or, when they are all busy, wait for the next one in
+ * turn. The worker is returned locked.
+ */
+static
+struct run_as_worker *get_worker(void)
+{
+	unsigned int i;
+	struct run_as_worker *worker;
+
+	assert(nr_workers);
+	for (i = 0; i < nr_workers; i++) {
+		if (!pthread_mutex_trylock(&workers[i]->lock)) {
+			return workers[i];
+		}
+	}
+	worker = workers[uatomic_add_return(&next_worker, 1) % nr_workers];
+	pthread_mutex_lock(&worker->lock);
+	return worker;
+}
+
 /*
  * This is for debugging ONLY and should not be considered secure.
  */
@@ -448,11 +600,12 @@ int run_as(enum run_as_cmd cmd, struct run_as_data *data, uid_t uid, gid_t gid)
 	int ret;
 
 	if (use_clone()) {
+		struct run_as_worker *worker;
+
 		DBG("Using run_as worker");
-		pthread_mutex_lock(&worker_lock);
-		assert(global_worker);
-		ret = run_as_cmd(global_worker, cmd, data, uid, gid);
-		pthread_mutex_unlock(&worker_lock);
+		worker = get_worker();
+		ret = run_as_cmd(worker, cmd, data, uid, gid);
+		pthread_mutex_unlock(&worker->lock);
 
 	} else {
 		DBG("Using run_as without worker");
@@ -529,6 +682,164 @@ int run_as_rmdir_recursive(const char *path, uid_t uid, gid_t gid)
 	return run_as(RUN_AS_RMDIR_RECURSIVE, &data, uid, gid);
 }
 
+LTTNG_HIDDEN
+int run_as_rename(const char *old_path, const char *new_path, uid_t uid,
+		gid_t gid)
+{
+	struct run_as_data data;
+
+	memset(&data, 0, sizeof(data));
+	DBG3("rename() %s to %s with for uid %d and gid %d",
+			old_path, new_path, (int) uid, (int) gid);
+	strncpy(data.u.rename.old_path, old_path, PATH_MAX - 1);
+	data.u.rename.old_path[PATH_MAX - 1] = '\0';
+	strncpy(data.u.rename.new_path, new_path, PATH_MAX - 1);
+	data.u.rename.new_path[PATH_MAX - 1] = '\0';
+	return run_as(RUN_AS_RENAME, &data, uid, gid);
+}
+
+LTTNG_HIDDEN
+int run_as_openat(int dirfd, const char *path, int flags, mode_t mode,
+		uid_t uid, gid_t gid)
+{
+	struct run_as_data data;
+
+	memset(&data, 0, sizeof(data));
+	DBG3("openat() %s with flags %X mode %d for uid %d and gid %d",
+			path, flags, (int) mode, (int) uid, (int) gid);
+	strncpy(data.u.open.path, path, PATH_MAX - 1);
+	data.u.open.path[PATH_MAX - 1] = '\0';
+	data.u.open.flags = flags;
+	data.u.open.mode = mode;
+	data.u.open.dirfd = dirfd;
+	return run_as(RUN_AS_OPENAT, &data, uid, gid);
+}
+
+LTTNG_HIDDEN
+int run_as_unlinkat(int dirfd, const char *path, uid_t uid, gid_t gid)
+{
+	struct run_as_data data;
+
+	memset(&data, 0, sizeof(data));
+	DBG3("unlinkat() %s with for uid %d and gid %d",
+			path, (int) uid, (int) gid);
+	strncpy(data.u.unlink.path, path, PATH_MAX - 1);
+	data.u.unlink.path[PATH_MAX - 1] = '\0';
+	data.u.unlink.dirfd = dirfd;
+	return run_as(RUN_AS_UNLINKAT, &data, uid, gid);
+}
+
+LTTNG_HIDDEN
+int run_as_symlink(const char *target, const char *path, uid_t uid,
+		gid_t gid)
+{
+	struct run_as_data data;
+
+	memset(&data, 0, sizeof(data));
+	DBG3("symlink() %s to %s with for uid %d and gid %d",
+			path, target, (int) uid, (int) gid);
+	strncpy(data.u.symlink.target, target, PATH_MAX - 1);
+	data.u.symlink.target[PATH_MAX - 1] = '\0';
+	strncpy(data.u.symlink.path, path, PATH_MAX - 1);
+	data.u.symlink.path[PATH_MAX - 1] = '\0';
+	return run_as(RUN_AS_SYMLINK, &data, uid, gid);
+}
+
+static
+enum run_as_cmd batch_op_cmd(const struct run_as_batch_op *op)
+{
+	switch (op->type) {
+	case RUN_AS_BATCH_MKDIR_RECURSIVE:
+		return RUN_AS_MKDIR_RECURSIVE;
+	case RUN_AS_BATCH_OPEN:
+		return RUN_AS_OPEN;
+	case RUN_AS_BATCH_UNLINK:
+		return RUN_AS_UNLINK;
+	default:
+		abort();
+	}
+}
+
+static
+void batch_op_to_data(const struct run_as_batch_op *op,
+		struct run_as_data *data)
+{
+	memset(data, 0, sizeof(*data));
+	switch (op->type) {
+	case RUN_AS_BATCH_MKDIR_RECURSIVE:
+		strncpy(data->u.mkdir.path, op->path, PATH_MAX - 1);
+		data->u.mkdir.mode = op->mode;
+		break;
+	case RUN_AS_BATCH_OPEN:
+		strncpy(data->u.open.path, op->path, PATH_MAX - 1);
+		data->u.open.flags = op->flags;
+		data->u.open.mode = op->mode;
+		break;
+	case RUN_AS_BATCH_UNLINK:
+		strncpy(data->u.unlink.path, op->path, PATH_MAX - 1);
+		break;
+	default:
+		abort();
+	}
+}
+
+/*
+ * The commands of a batch are sent to a single worker ahead of their replies,
+ * up to RUN_AS_BATCH_WINDOW at a time. The worker, which executes them one by
+ * one, is not changed.
+ */
+LTTNG_HIDDEN
+int run_as_batch(struct run_as_batch_op *ops, unsigned int nr_ops,
+		uid_t uid, gid_t gid)
+{
+	int ret = 0, send_errno = 0;
+	unsigned int sent = 0, done = 0;
+	struct run_as_worker *worker;
+	struct run_as_data data;
+
+	DBG3("Batch of %u operations for uid %d and gid %d", nr_ops, (int) uid,
+			(int) gid);
+	if (!use_clone()) {
+		for (done = 0; done < nr_ops; done++) {
+			batch_op_to_data(&ops[done], &data);
+			ops[done].ret = run_as_noworker(batch_op_cmd(&ops[done]),
+					&data, uid, gid);
+			ops[done]._errno = errno;
+		}
+		goto end;
+	}
+
+	worker = get_worker();
+	while (done < nr_ops) {
+		while (!ret && sent < nr_ops &&
+				sent - done < RUN_AS_BATCH_WINDOW) {
+			batch_op_to_data(&ops[sent], &data);
+			if (run_as_send_cmd(worker, batch_op_cmd(&ops[sent]),
+					&data, uid, gid)) {
+				send_errno = errno;
+				ret = -1;
+				break;
+			}
+			sent++;
+		}
+		if (done == sent) {
+			/* The remaining operations could not be sent. */
+			for (; done < nr_ops; done++) {
+				ops[done].ret = -1;
+				ops[done]._errno = send_errno;
+			}
+			break;
+		}
+		ops[done].ret = run_as_recv_ret(worker,
+				batch_op_cmd(&ops[done]));
+		ops[done]._errno = errno;
+		done++;
+	}
+	pthread_mutex_unlock(&worker->lock);
+end:
+	return ret;
+}
+
 static
 int reset_sighandler(void)
 {
@@ -600,31 +911,53 @@ end:
 	return ret;
 }
 
-LTTNG_HIDDEN
-int run_as_create_worker(char *procname)
+/*
+ * Get the number of workers from the environment.
+ */
+static
+unsigned int get_nr_workers(void)
+{
+	const char *env;
+	char *end;
+	unsigned long val;
+
+	env = lttng_secure_getenv(DEFAULT_RUN_AS_WORKERS_ENV);
+	if (!env) {
+		return DEFAULT_RUN_AS_WORKERS;
+	}
+
+	errno = 0;
+	val = strtoul(env, &end, 10);
+	if (errno || end == env || *end != '\0' || val == 0 ||
+			val > DEFAULT_RUN_AS_MAX_WORKERS) {
+		WARN("Invalid value for %s: %s. Using %d run_as worker(s).",
+				DEFAULT_RUN_AS_WORKERS_ENV, env,
+				DEFAULT_RUN_AS_WORKERS);
+		return DEFAULT_RUN_AS_WORKERS;
+	}
+	return (unsigned int) val;
+}
+
+/*
+ * Fork a worker. Called with the worker lock held.
+ */
+static
+int create_worker(char *procname, struct run_as_worker **_worker)
 {
 	pid_t pid;
 	int i, ret = 0;
+	unsigned int j;
 	ssize_t readlen;
 	struct run_as_ret recvret;
 	struct run_as_worker *worker;
 
-	pthread_mutex_lock(&worker_lock);
-	assert(!global_worker);
-	if (!use_clone()) {
-		/*
-		 * Don't initialize a worker, all run_as tasks will be performed
-		 * in the current process.
-		 */
-		ret = 0;
-		goto end;
-	}
 	worker = zmalloc(sizeof(*worker));
 	if (!worker) {
 		ret = -ENOMEM;
 		goto end;
 	}
 	worker->procname = procname;
+	pthread_mutex_init(&worker->lock, NULL);
 	/* Create unix socket. */
 	if (lttcomm_create_anon_unix_socketpair(worker->sockpair) < 0) {
 		ret = -1;
@@ -645,6 +978,16 @@ int run_as_create_worker(char *procname)
 
 		/* The child has no use for this lock. */
 		pthread_mutex_unlock(&worker_lock);
+		/*
+		 * Close the sockets of the other workers, which must see their
+		 * hang up when the parent closes them.
+		 */
+		for (j = 0; j < nr_workers; j++) {
+			if (close(workers[j]->sockpair[0])) {
+				PERROR("close");
+				exit(EXIT_FAILURE);
+			}
+		}
 		/* Just close, no shutdown. */
 		if (close(worker->sockpair[0])) {
 			PERROR("close");
@@ -679,10 +1022,9 @@ int run_as_create_worker(char *procname)
 			ret = -1;
 			goto error_fork;
 		}
-		global_worker = worker;
+		*_worker = worker;
 	}
 end:
-	pthread_mutex_unlock(&worker_lock);
 	return ret;
 
 	/* Error handling. */
@@ -697,21 +1039,14 @@ error_fork:
 		worker->sockpair[i] = -1;
 	}
 error_sock:
+	pthread_mutex_destroy(&worker->lock);
 	free(worker);
-	pthread_mutex_unlock(&worker_lock);
 	return ret;
 }
 
-LTTNG_HIDDEN
-void run_as_destroy_worker(void)
+static
+void destroy_worker(struct run_as_worker *worker)
 {
-	struct run_as_worker *worker = global_worker;
-
-	DBG("Destroying run_as worker");
-	pthread_mutex_lock(&worker_lock);
-	if (!worker) {
-		goto end;
-	}
 	/* Close unix socket */
 	DBG("Closing run_as worker socket");
 	if (lttcomm_close_unix_sock(worker->sockpair[0])) {
@@ -743,8 +1078,69 @@ void run_as_destroy_worker(void)
 			break;
 		}
 	}
+	pthread_mutex_destroy(&worker->lock);
 	free(worker);
-	global_worker = NULL;
+}
+
+/*
+ * Fork the pool of workers, of LTTNG_RUN_AS_WORKERS processes.
+ */
+LTTNG_HIDDEN
+int run_as_create_worker(char *procname)
+{
+	int ret = 0;
+	unsigned int i, count;
+
+	pthread_mutex_lock(&worker_lock);
+	assert(!workers);
+	if (!use_clone()) {
+		/*
+		 * Don't initialize a worker, all run_as tasks will be performed
+		 * in the current process.
+		 */
+		ret = 0;
+		goto end;
+	}
+	count = get_nr_workers();
+	workers = zmalloc(count * sizeof(*workers));
+	if (!workers) {
+		ret = -ENOMEM;
+		goto end;
+	}
+	for (i = 0; i < count; i++) {
+		ret = create_worker(procname, &workers[i]);
+		if (ret) {
+			goto error;
+		}
+		nr_workers++;
+	}
+	DBG("Created %u run_as worker(s)", nr_workers);
+end:
+	pthread_mutex_unlock(&worker_lock);
+	return ret;
+
+error:
+	pthread_mutex_unlock(&worker_lock);
+	run_as_destroy_worker();
+	return ret;
+}
+
+LTTNG_HIDDEN
+void run_as_destroy_worker(void)
+{
+	unsigned int i;
+
+	DBG("Destroying run_as worker(s)");
+	pthread_mutex_lock(&worker_lock);
+	if (!workers) {
+		goto end;
+	}
+	for (i = 0; i < nr_workers; i++) {
+		destroy_worker(workers[i]);
+	}
+	free(workers);
+	workers = NULL;
+	nr_workers = 0;
 end:
 	pthread_mutex_unlock(&worker_lock);
 }
@@ -33,6 +33,52 @@ LTTNG_HIDDEN
 int run_as_unlink(const char *path, uid_t uid, gid_t gid);
 LTTNG_HIDDEN
 int run_as_rmdir_recursive(const char *path, uid_t uid, gid_t gid);
+LTTNG_HIDDEN
+int run_as_rename(const char *old_path, const char *new_path, uid_t uid,
+		gid_t gid);
+LTTNG_HIDDEN
+int run_as_symlink(const char *target, const char *path, uid_t uid,
+		gid_t gid);
+/*
+ * The directory file descriptor of the *at() operations is passed to the
+ * worker along with the relative path.
+ */
+LTTNG_HIDDEN
+int run_as_openat(int dirfd, const char *path, int flags, mode_t mode,
+		uid_t uid, gid_t gid);
+LTTNG_HIDDEN
+int run_as_unlinkat(int dirfd, const char *path, uid_t uid, gid_t gid);
+
+enum run_as_batch_op_type {
+	RUN_AS_BATCH_MKDIR_RECURSIVE,
+	RUN_AS_BATCH_OPEN,
+	RUN_AS_BATCH_UNLINK,
+};
+
+/*
+ * Operation of a run_as batch. The mode is used by the mkdir and open
+ * operations, the flags by the open ones.
+ */
+struct run_as_batch_op {
+	enum run_as_batch_op_type type;
+	const char *path;
+	int flags;
+	mode_t mode;
+	/* Result of the operation (fd of an open) and its errno. */
+	int ret;
+	int _errno;
+};
+
+/*
+ * Execute a batch of operations in order, pipelined through a single worker,
+ * and store their results in the operations.
+ *
+ * Return 0 on success or else -1 when the remaining operations could not be
+ * sent to the worker; they then fail as well.
+ */
+LTTNG_HIDDEN
+int run_as_batch(struct run_as_batch_op *ops, unsigned int nr_ops,
+		uid_t uid, gid_t gid);
 
 LTTNG_HIDDEN
 int run_as_create_worker(char *procname);
@@ -0,0 +1,93 @@
+#undef TRACEPOINT_PROVIDER
+#define TRACEPOINT_PROVIDER lttng_tools
+
+#if !defined(_LTTNG_TOOLS_TP_H) || defined(TRACEPOINT_HEADER_MULTI_READ)
+#define _LTTNG_TOOLS_TP_H
+
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdint.h>
+#include <lttng/tracepoint.h>
+
+/* Session daemon: client commands. */
+TRACEPOINT_EVENT(lttng_tools, sessiond_cmd_begin,
+	TP_ARGS(int, cmd_type),
+	TP_FIELDS(
+		ctf_integer(int, cmd_type, cmd_type)
+	)
+)
+
+TRACEPOINT_EVENT(lttng_tools, sessiond_cmd_end,
+	TP_ARGS(int, cmd_type, int, ret),
+	TP_FIELDS(
+		ctf_integer(int, cmd_type, cmd_type)
+		ctf_integer(int, ret, ret)
+	)
+)
+
+/* Session daemon: update of a registered application. */
+TRACEPOINT_EVENT(lttng_tools, sessiond_app_update_begin,
+	TP_ARGS(int, pid),
+	TP_FIELDS(
+		ctf_integer(int, pid, pid)
+	)
+)
+
+TRACEPOINT_EVENT(lttng_tools, sessiond_app_register_done,
+	TP_ARGS(int, pid, int, ret),
+	TP_FIELDS(
+		ctf_integer(int, pid, pid)
+		ctf_integer(int, ret, ret)
+	)
+)
+
+/* Consumer daemon: sub-buffer reads. */
+TRACEPOINT_EVENT(lttng_tools, consumerd_subbuffer_begin,
+	TP_ARGS(uint64_t, stream_key),
+	TP_FIELDS(
+		ctf_integer(uint64_t, stream_key, stream_key)
+	)
+)
+
+TRACEPOINT_EVENT(lttng_tools, consumerd_subbuffer_end,
+	TP_ARGS(uint64_t, stream_key, int64_t, ret),
+	TP_FIELDS(
+		ctf_integer(uint64_t, stream_key, stream_key)
+		ctf_integer(int64_t, ret, ret)
+	)
+)
+
+/* Relay daemon: data packets, with the time spent writing them. */
+TRACEPOINT_EVENT(lttng_tools, relayd_data_packet,
+	TP_ARGS(uint64_t, stream_id, uint64_t, net_seq_num,
+		uint32_t, data_size, uint64_t, write_ns),
+	TP_FIELDS(
+		ctf_integer(uint64_t, stream_id, stream_id)
+		ctf_integer(uint64_t, net_seq_num, net_seq_num)
+		ctf_integer(uint32_t, data_size, data_size)
+		ctf_integer(uint64_t, write_ns, write_ns)
+	)
+)
+
+#endif /* _LTTNG_TOOLS_TP_H */
+
+#undef TRACEPOINT_INCLUDE_FILE
+#define TRACEPOINT_INCLUDE_FILE common/self-tracing/lttng-tools-tp.h
+
+/* This part must be outside ifdef protection */
+#include <lttng/tracepoint-event.h>
@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _SELF_TRACING_H
+#define _SELF_TRACING_H
+
+/*
+ * Tracepoints of the daemons hot paths, built with --enable-self-tracing.
+ * When the probe provider is not loaded, a tracepoint is a single unlikely
+ * branch.
+ */
+#ifdef LTTNG_SELF_TRACING
+
+#define TRACEPOINT_PROBE_DYNAMIC_LINKAGE
+#include <common/self-tracing/lttng-tools-tp.h>
+
+#define self_tracepoint(...)	tracepoint(lttng_tools, __VA_ARGS__)
+
+#else /* LTTNG_SELF_TRACING */
+
+#define self_tracepoint(...)	do { } while (0)
+
+#endif /* LTTNG_SELF_TRACING */
+
+#endif /* _SELF_TRACING_H */
@@ -33,6 +33,8 @@ enum lttcomm_agent_command {
 	AGENT_CMD_REG_DONE		= 4,	/* End registration process. */
 	AGENT_CMD_APP_CTX_ENABLE	= 5,
 	AGENT_CMD_APP_CTX_DISABLE	= 6,
+	/* Enable many events and contexts, since minor version 1. */
+	AGENT_CMD_ENABLE_BATCH		= 7,
 };
 
 /*
@@ -75,6 +77,18 @@ struct lttcomm_agent_disable_event {
 	char name[LTTNG_SYMBOL_NAME_LEN];
 } LTTNG_PACKED;
 
+/*
+ * Batched enable command payload. Will be immediately followed by
+ * "nb_events" enable event payloads, each followed by its filter expression,
+ * and then by "nb_contexts" application contexts, each made of the provider
+ * name and the context name sent as Pascal-style strings. The agent replies
+ * with one generic reply per event and then per context, in order.
+ */
+struct lttcomm_agent_enable_batch {
+	uint32_t nb_events;
+	uint32_t nb_contexts;
+} LTTNG_PACKED;
+
 /*
  * Generic reply coming from the agent.
  */
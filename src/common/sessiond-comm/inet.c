@@ -47,6 +47,7 @@ static const struct lttcomm_proto_ops inet_ops = {
 	.listen = lttcomm_listen_inet_sock,
 	.recvmsg = lttcomm_recvmsg_inet_sock,
 	.sendmsg = lttcomm_sendmsg_inet_sock,
+	.sendmsg_iov = lttcomm_sendmsg_iov_inet_sock,
 };
 
 unsigned long lttcomm_inet_tcp_timeout;
@@ -312,8 +313,11 @@ struct lttcomm_sock *lttcomm_accept_inet_sock(struct lttcomm_sock *sock)
 		}
 	}
 
+	lttcomm_sock_apply_profile(new_fd, sock->profile);
+
 	new_sock->fd = new_fd;
 	new_sock->ops = &inet_ops;
+	new_sock->profile = sock->profile;
 
 end:
 	return new_sock;
@@ -445,6 +449,46 @@ ssize_t lttcomm_sendmsg_inet_sock(struct lttcomm_sock *sock, const void *buf,
 	return ret;
 }
 
+/*
+ * Send the "iovcnt" iovecs of "iov" with a single sendmsg call, unless it is
+ * partial. The iovecs are consumed.
+ *
+ * Return the size of sent data.
+ */
+LTTNG_HIDDEN
+ssize_t lttcomm_sendmsg_iov_inet_sock(struct lttcomm_sock *sock,
+		struct iovec *iov, int iovcnt, int flags)
+{
+	struct msghdr msg;
+	ssize_t ret;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = iovcnt;
+
+	switch (sock->proto) {
+	case LTTCOMM_SOCK_UDP:
+		msg.msg_name = (struct sockaddr *) &sock->sockaddr.addr.sin;
+		msg.msg_namelen = sizeof(sock->sockaddr.addr.sin);
+		break;
+	default:
+		break;
+	}
+
+	ret = lttcomm_sendmsg_all(sock->fd, &msg, flags);
+	if (ret < 0) {
+		/*
+		 * Only warn about EPIPE when quiet mode is deactivated.
+		 * We consider EPIPE as expected.
+		 */
+		if (errno != EPIPE || !lttng_opt_quiet) {
+			PERROR("sendmsg inet");
+		}
+	}
+
+	return ret;
+}
+
 /*
  * Shutdown cleanly and close.
  */
@@ -40,5 +40,7 @@ extern ssize_t lttcomm_recvmsg_inet6_sock(struct lttcomm_sock *sock, void *buf,
 		size_t len, int flags);
 extern ssize_t lttcomm_sendmsg_inet6_sock(struct lttcomm_sock *sock,
 		const void *buf, size_t len, int flags);
+extern ssize_t lttcomm_sendmsg_iov_inet6_sock(struct lttcomm_sock *sock,
+		struct iovec *iov, int iovcnt, int flags);
 
 #endif	/* _LTTCOMM_INET6_H */
@@ -0,0 +1,336 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <common/common.h>
+
+#include "local.h"
+
+/*
+ * Local protocol operations.
+ */
+static const struct lttcomm_proto_ops local_ops = {
+	.bind = lttcomm_bind_local_sock,
+	.close = lttcomm_close_local_sock,
+	.connect = lttcomm_connect_local_sock,
+	.accept = lttcomm_accept_local_sock,
+	.listen = lttcomm_listen_local_sock,
+	.recvmsg = lttcomm_recvmsg_local_sock,
+	.sendmsg = lttcomm_sendmsg_local_sock,
+	.sendmsg_iov = lttcomm_sendmsg_iov_local_sock,
+};
+
+static int set_timeouts(int fd)
+{
+	int ret = 0;
+	unsigned long timeout;
+
+	timeout = lttcomm_get_network_timeout();
+	if (timeout) {
+		ret = lttcomm_setsockopt_rcv_timeout(fd, timeout);
+		if (ret) {
+			goto end;
+		}
+		ret = lttcomm_setsockopt_snd_timeout(fd, timeout);
+	}
+end:
+	return ret;
+}
+
+/*
+ * Creates a PF_UNIX socket. Only stream sockets are supported and the
+ * protocol is ignored.
+ */
+LTTNG_HIDDEN
+int lttcomm_create_local_sock(struct lttcomm_sock *sock, int type, int proto)
+{
+	if (type != SOCK_STREAM) {
+		ERR("Unsupported local socket type %d", type);
+		goto error;
+	}
+
+	/* Create server socket */
+	if ((sock->fd = socket(PF_UNIX, type, 0)) < 0) {
+		PERROR("socket local");
+		goto error;
+	}
+
+	sock->ops = &local_ops;
+
+	if (set_timeouts(sock->fd)) {
+		goto error;
+	}
+
+	return 0;
+
+error:
+	return -1;
+}
+
+/*
+ * Bind socket and return. A stale socket file left by a previous instance is
+ * removed first.
+ */
+LTTNG_HIDDEN
+int lttcomm_bind_local_sock(struct lttcomm_sock *sock)
+{
+	int ret;
+
+	ret = unlink(sock->sockaddr.addr.un.sun_path);
+	if (ret < 0 && errno != ENOENT) {
+		PERROR("unlink local socket %s",
+				sock->sockaddr.addr.un.sun_path);
+	}
+
+	ret = bind(sock->fd, (const struct sockaddr *) &sock->sockaddr.addr.un,
+			sizeof(sock->sockaddr.addr.un));
+	if (ret < 0) {
+		PERROR("bind local");
+	}
+
+	return ret;
+}
+
+/*
+ * Connect PF_UNIX socket. A local connection fails right away when no relayd
+ * listens, so the network timeout does not apply.
+ */
+LTTNG_HIDDEN
+int lttcomm_connect_local_sock(struct lttcomm_sock *sock)
+{
+	int ret, closeret;
+
+	ret = connect(sock->fd, (struct sockaddr *) &sock->sockaddr.addr.un,
+			sizeof(sock->sockaddr.addr.un));
+	if (ret < 0) {
+		PERROR("connect local %s", sock->sockaddr.addr.un.sun_path);
+		goto error_connect;
+	}
+
+	return ret;
+
+error_connect:
+	closeret = close(sock->fd);
+	if (closeret) {
+		PERROR("close local");
+	}
+
+	return ret;
+}
+
+/*
+ * Do an accept(2) on the sock and return the new lttcomm socket. The socket
+ * MUST be bind(2) before.
+ */
+LTTNG_HIDDEN
+struct lttcomm_sock *lttcomm_accept_local_sock(struct lttcomm_sock *sock)
+{
+	int new_fd;
+	struct lttcomm_sock *new_sock;
+
+	new_sock = lttcomm_alloc_sock(sock->proto);
+	if (new_sock == NULL) {
+		goto error;
+	}
+
+	/* Blocking call */
+	new_fd = accept(sock->fd, NULL, NULL);
+	if (new_fd < 0) {
+		PERROR("accept local");
+		goto error;
+	}
+	if (set_timeouts(new_fd)) {
+		goto error_close;
+	}
+
+	new_sock->fd = new_fd;
+	new_sock->ops = &local_ops;
+	memcpy(&new_sock->sockaddr, &sock->sockaddr, sizeof(new_sock->sockaddr));
+
+	return new_sock;
+
+error_close:
+	if (close(new_fd) < 0) {
+		PERROR("accept local close fd");
+	}
+
+error:
+	free(new_sock);
+	return NULL;
+}
+
+/*
+ * Make the socket listen using LTTNG_SESSIOND_COMM_MAX_LISTEN.
+ */
+LTTNG_HIDDEN
+int lttcomm_listen_local_sock(struct lttcomm_sock *sock, int backlog)
+{
+	int ret;
+
+	/* Default listen backlog */
+	if (backlog <= 0) {
+		backlog = LTTNG_SESSIOND_COMM_MAX_LISTEN;
+	}
+
+	ret = listen(sock->fd, backlog);
+	if (ret < 0) {
+		PERROR("listen local");
+	}
+
+	return ret;
+}
+
+/*
+ * Receive data of size len in put that data into the buf param. Using recvmsg
+ * API.
+ *
+ * Return the size of received data.
+ */
+LTTNG_HIDDEN
+ssize_t lttcomm_recvmsg_local_sock(struct lttcomm_sock *sock, void *buf,
+		size_t len, int flags)
+{
+	struct msghdr msg;
+	struct iovec iov[1];
+	ssize_t ret = -1;
+	size_t len_last;
+
+	memset(&msg, 0, sizeof(msg));
+
+	iov[0].iov_base = buf;
+	iov[0].iov_len = len;
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 1;
+
+	do {
+		len_last = iov[0].iov_len;
+		ret = recvmsg(sock->fd, &msg, flags);
+		if (ret > 0) {
+			iov[0].iov_base += ret;
+			iov[0].iov_len -= ret;
+			assert(ret <= len_last);
+		}
+	} while ((ret > 0 && ret < len_last) || (ret < 0 && errno == EINTR));
+	if (ret < 0) {
+		PERROR("recvmsg local");
+	} else if (ret > 0) {
+		ret = len;
+	}
+	/* Else ret = 0 meaning an orderly shutdown. */
+
+	return ret;
+}
+
+/*
+ * Send buf data of size len. Using sendmsg API.
+ *
+ * Return the size of sent data.
+ */
+LTTNG_HIDDEN
+ssize_t lttcomm_sendmsg_local_sock(struct lttcomm_sock *sock, const void *buf,
+		size_t len, int flags)
+{
+	struct msghdr msg;
+	struct iovec iov[1];
+	ssize_t ret = -1;
+
+	memset(&msg, 0, sizeof(msg));
+
+	iov[0].iov_base = (void *) buf;
+	iov[0].iov_len = len;
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 1;
+
+	do {
+		ret = sendmsg(sock->fd, &msg, flags);
+	} while (ret < 0 && errno == EINTR);
+	if (ret < 0) {
+		/*
+		 * Only warn about EPIPE when quiet mode is deactivated.
+		 * We consider EPIPE as expected.
+		 */
+		if (errno != EPIPE || !lttng_opt_quiet) {
+			PERROR("sendmsg local");
+		}
+	}
+
+	return ret;
+}
+
+/*
+ * Send the "iovcnt" iovecs of "iov" with a single sendmsg call, unless it is
+ * partial. The iovecs are consumed.
+ *
+ * Return the size of sent data.
+ */
+LTTNG_HIDDEN
+ssize_t lttcomm_sendmsg_iov_local_sock(struct lttcomm_sock *sock,
+		struct iovec *iov, int iovcnt, int flags)
+{
+	struct msghdr msg;
+	ssize_t ret;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = iovcnt;
+
+	ret = lttcomm_sendmsg_all(sock->fd, &msg, flags);
+	if (ret < 0) {
+		/*
+		 * Only warn about EPIPE when quiet mode is deactivated.
+		 * We consider EPIPE as expected.
+		 */
+		if (errno != EPIPE || !lttng_opt_quiet) {
+			PERROR("sendmsg local");
+		}
+	}
+
+	return ret;
+}
+
+/*
+ * Shutdown cleanly and close.
+ */
+LTTNG_HIDDEN
+int lttcomm_close_local_sock(struct lttcomm_sock *sock)
+{
+	int ret;
+
+	/* Don't try to close an invalid marked socket */
+	if (sock->fd == -1) {
+		return 0;
+	}
+
+	ret = close(sock->fd);
+	if (ret) {
+		PERROR("close local");
+	}
+
+	/* Mark socket */
+	sock->fd = -1;
+
+	return ret;
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _LTTCOMM_LOCAL_H
+#define _LTTCOMM_LOCAL_H
+
+#include "sessiond-comm.h"
+
+/*
+ * Unix stream sockets carrying the relayd protocol between daemons of the
+ * same host, addressed by a unix:// URI. They avoid the TCP loopback stack
+ * and accept the same operations as the inet sockets.
+ */
+
+/* Stub */
+struct lttcomm_sock;
+
+/* Net family callback */
+extern int lttcomm_create_local_sock(struct lttcomm_sock *sock, int type,
+		int proto);
+
+extern struct lttcomm_sock *lttcomm_accept_local_sock(struct lttcomm_sock *sock);
+extern int lttcomm_bind_local_sock(struct lttcomm_sock *sock);
+extern int lttcomm_close_local_sock(struct lttcomm_sock *sock);
+extern int lttcomm_connect_local_sock(struct lttcomm_sock *sock);
+extern int lttcomm_listen_local_sock(struct lttcomm_sock *sock, int backlog);
+
+extern ssize_t lttcomm_recvmsg_local_sock(struct lttcomm_sock *sock, void *buf,
+		size_t len, int flags);
+extern ssize_t lttcomm_sendmsg_local_sock(struct lttcomm_sock *sock,
+		const void *buf, size_t len, int flags);
+extern ssize_t lttcomm_sendmsg_iov_local_sock(struct lttcomm_sock *sock,
+		struct iovec *iov, int iovcnt, int flags);
+
+#endif	/* _LTTCOMM_LOCAL_H */
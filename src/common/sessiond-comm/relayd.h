@@ -29,6 +29,80 @@
 #define RELAYD_VERSION_COMM_MAJOR             VERSION_MAJOR
 #define RELAYD_VERSION_COMM_MINOR             VERSION_MINOR
 
+/*
+ * The extensions of the protocol are negotiated as features, see enum
+ * lttcomm_relayd_feature, apart from the minor version numbers which belong
+ * to the upstream releases.
+ *
+ * A peer asking for the features sets the circuit ID of its RELAYD_VERSION
+ * header to RELAYD_VERSION_FEATURES_MAGIC, ignored by the relayds unaware of
+ * the features. A relayd aware of them flags the minor version of its reply
+ * with RELAYD_VERSION_FEATURES_FLAG and follows it with a struct
+ * lttcomm_relayd_version_features of its features. The peer answers with a
+ * struct lttcomm_relayd_version_features of the features used on the
+ * connection, among those of the relayd.
+ */
+#define RELAYD_VERSION_FEATURES_MAGIC         0x4c54544e47464541ULL
+#define RELAYD_VERSION_FEATURES_FLAG          (1U << 31)
+
+/* Maximal number of beacons of a RELAYD_SEND_BEACONS message. */
+#define RELAYD_BEACONS_MAX                    4096
+
+/* Maximal number of streams of a RELAYD_STREAMS_DATA_PENDING message. */
+#define RELAYD_STREAMS_DATA_PENDING_MAX       4096
+
+/* Maximal number of streams of a RELAYD_ADD_STREAMS or CLOSE_STREAMS message. */
+#define RELAYD_BULK_STREAMS_MAX               4096
+
+/* Maximal number of indexes of a RELAYD_SEND_INDEXES message. */
+#define RELAYD_INDEXES_MAX                    4096
+
+/* Optional features of a relayd, see struct lttcomm_relayd_version_features. */
+enum lttcomm_relayd_feature {
+	/* The relayd inflates the data packets flagged RELAYD_DATA_COMPRESSED. */
+	RELAYD_FEATURE_WIRE_COMPRESSION = (1ULL << 0),
+	/* The relayd accepts RELAYD_SEND_BEACONS. */
+	RELAYD_FEATURE_BEACONS = (1ULL << 1),
+	/* The relayd accepts RELAYD_STREAMS_DATA_PENDING. */
+	RELAYD_FEATURE_STREAMS_DATA_PENDING = (1ULL << 2),
+	/*
+	 * The relayd replies to RELAYD_SEND_INDEX with a struct
+	 * lttcomm_relayd_index_reply.
+	 */
+	RELAYD_FEATURE_BACKPRESSURE = (1ULL << 3),
+	/* The relayd accepts RELAYD_ADD_STREAMS and RELAYD_CLOSE_STREAMS. */
+	RELAYD_FEATURE_BULK_STREAMS = (1ULL << 4),
+	/*
+	 * The relayd writes the indexes sent with RELAYD_SEND_INDEX for the
+	 * streams of the snapshot sessions.
+	 */
+	RELAYD_FEATURE_SNAPSHOT_INDEX = (1ULL << 5),
+	/*
+	 * The events count of the packets is sent with RELAYD_SEND_INDEX and
+	 * written in CTF index 1.2 files.
+	 */
+	RELAYD_FEATURE_INDEX_EVENTS = (1ULL << 6),
+	/* The relayd accepts RELAYD_SEND_INDEXES. */
+	RELAYD_FEATURE_BULK_INDEXES = (1ULL << 7),
+};
+
+/* Features known by this version of the protocol. */
+#define RELAYD_FEATURES_KNOWN \
+	(RELAYD_FEATURE_WIRE_COMPRESSION | RELAYD_FEATURE_BEACONS | \
+	RELAYD_FEATURE_STREAMS_DATA_PENDING | RELAYD_FEATURE_BACKPRESSURE | \
+	RELAYD_FEATURE_BULK_STREAMS | RELAYD_FEATURE_SNAPSHOT_INDEX | \
+	RELAYD_FEATURE_INDEX_EVENTS | RELAYD_FEATURE_BULK_INDEXES)
+
+/* Flags of a data header. */
+enum lttcomm_relayd_data_flag {
+	/*
+	 * The payload is a compressed packet frame, see consumer-compress.h,
+	 * of the packet content. The padding size remains the one of the
+	 * uncompressed packet.
+	 */
+	RELAYD_DATA_COMPRESSED = (1U << 0),
+};
+
 /*
  * lttng-relayd communication header.
  */
@@ -44,8 +118,11 @@ struct lttcomm_relayd_hdr {
  * lttng-relayd data header.
  */
 struct lttcomm_relayd_data_hdr {
-	/* Circuit ID not used for now so always ignored */
-	uint64_t circuit_id;
+	/*
+	 * Flags of the packet, enum lttcomm_relayd_data_flag. Formerly an
+	 * unused circuit ID always zeroed.
+	 */
+	uint64_t flags;
 	uint64_t stream_id;     /* Stream ID known by the relayd */
 	uint64_t net_seq_num;   /* Network sequence number, per stream. */
 	uint32_t data_size;     /* data size following this header */
@@ -94,6 +171,29 @@ struct lttcomm_relayd_generic_reply {
 	uint32_t ret_code;
 } LTTNG_PACKED;
 
+/*
+ * Backpressure level of a session, advertised by the relayd to its consumers
+ * from the write lag of the session.
+ */
+enum lttcomm_relayd_backpressure {
+	/* The relayd writes the data of the session as it is received. */
+	RELAYD_BACKPRESSURE_NONE        = 0,
+	/* The write lag of the session exceeds the relayd threshold. */
+	RELAYD_BACKPRESSURE_SLOW        = 1,
+	/* The write lag of the session exceeds four times the threshold. */
+	RELAYD_BACKPRESSURE_SATURATED   = 2,
+};
+
+/*
+ * Reply to RELAYD_SEND_INDEX with RELAYD_FEATURE_BACKPRESSURE.
+ */
+struct lttcomm_relayd_index_reply {
+	uint32_t ret_code;
+	uint32_t backpressure;		/* enum lttcomm_relayd_backpressure */
+	/* Moving average of the time to write a packet of the session (nsec). */
+	uint64_t write_lag_ns;
+} LTTNG_PACKED;
+
 /*
  * Used to update synchronization information.
  */
@@ -109,6 +209,14 @@ struct lttcomm_relayd_version {
 	uint32_t minor;
 } LTTNG_PACKED;
 
+/*
+ * Follows the RELAYD_VERSION reply flagged RELAYD_VERSION_FEATURES_FLAG, and
+ * the peer's answer to it.
+ */
+struct lttcomm_relayd_version_features {
+	uint64_t features;	/* enum lttcomm_relayd_feature */
+} LTTNG_PACKED;
+
 /*
  * Metadata payload used when metadata command is sent.
  */
@@ -162,6 +270,8 @@ struct lttcomm_relayd_index {
 	/* 2.8+ */
 	uint64_t stream_instance_id;
 	uint64_t packet_seq_num;
+	/* RELAYD_FEATURE_INDEX_EVENTS */
+	uint64_t events_count;
 } LTTNG_PACKED;
 
 static inline size_t lttcomm_relayd_index_len(uint32_t major, uint32_t minor)
@@ -176,6 +286,10 @@ static inline size_t lttcomm_relayd_index_len(uint32_t major, uint32_t minor)
 			return offsetof(struct lttcomm_relayd_index, packet_seq_num)
 				+ member_sizeof(struct lttcomm_relayd_index,
 						packet_seq_num);
+		case 2:
+			return offsetof(struct lttcomm_relayd_index, events_count)
+				+ member_sizeof(struct lttcomm_relayd_index,
+						events_count);
 		default:
 			abort();
 		}
@@ -183,6 +297,19 @@ static inline size_t lttcomm_relayd_index_len(uint32_t major, uint32_t minor)
 	abort();
 }
 
+/*
+ * Minor version of the CTF index of the packets sent with the protocol
+ * version "major.minor" and the negotiated "features".
+ */
+static inline uint32_t lttcomm_relayd_index_minor(uint32_t major,
+		uint32_t minor, uint64_t features)
+{
+	if (features & RELAYD_FEATURE_INDEX_EVENTS) {
+		return 2;
+	}
+	return lttng_to_index_minor(major, minor);
+}
+
 /*
  * Create session in 2.4 adds additionnal parameters for live reading.
  */
@@ -202,4 +329,74 @@ struct lttcomm_relayd_reset_metadata {
 	uint64_t version;
 } LTTNG_PACKED;
 
+/*
+ * Live beacon of a stream: the stream has no data up to timestamp_end.
+ */
+struct lttcomm_relayd_beacon {
+	uint64_t relay_stream_id;
+	uint64_t timestamp_end;
+} LTTNG_PACKED;
+
+/*
+ * Header of a RELAYD_SEND_BEACONS message, followed by nb_beacons
+ * struct lttcomm_relayd_beacon.
+ */
+struct lttcomm_relayd_beacons {
+	uint32_t nb_beacons;
+} LTTNG_PACKED;
+
+/*
+ * Data pending check of a stream. A metadata stream only needs the control
+ * socket to be quiescent, like RELAYD_QUIESCENT_CONTROL, and its
+ * last_net_seq_num is ignored.
+ */
+struct lttcomm_relayd_stream_data_pending {
+	uint64_t stream_id;
+	uint64_t last_net_seq_num;
+	uint8_t metadata;
+} LTTNG_PACKED;
+
+/*
+ * Header of a RELAYD_STREAMS_DATA_PENDING message, followed by nb_streams
+ * struct lttcomm_relayd_stream_data_pending.
+ */
+struct lttcomm_relayd_streams_data_pending {
+	uint32_t nb_streams;
+} LTTNG_PACKED;
+
+/*
+ * Header of a RELAYD_ADD_STREAMS message, followed by nb_streams struct
+ * lttcomm_relayd_add_streams_entry. The streams share the path and tracefile
+ * settings, as the streams of a channel. The reply is nb_streams struct
+ * lttcomm_relayd_status_stream, in the order of the entries.
+ */
+struct lttcomm_relayd_add_streams {
+	char pathname[LTTNG_PATH_MAX];
+	uint64_t tracefile_size;
+	uint64_t tracefile_count;
+	uint32_t nb_streams;
+} LTTNG_PACKED;
+
+struct lttcomm_relayd_add_streams_entry {
+	char channel_name[DEFAULT_STREAM_NAME_LEN];
+} LTTNG_PACKED;
+
+/*
+ * Header of a RELAYD_CLOSE_STREAMS message, followed by nb_streams struct
+ * lttcomm_relayd_close_stream. The reply is a generic reply, LTTNG_OK if all
+ * the streams are closed.
+ */
+struct lttcomm_relayd_close_streams {
+	uint32_t nb_streams;
+} LTTNG_PACKED;
+
+/*
+ * Header of a RELAYD_SEND_INDEXES message, followed by nb_indexes complete
+ * struct lttcomm_relayd_index. The reply is a struct
+ * lttcomm_relayd_index_reply, LTTNG_OK if all the indexes are accepted.
+ */
+struct lttcomm_relayd_indexes {
+	uint32_t nb_indexes;
+} LTTNG_PACKED;
+
 #endif	/* _RELAYD_COMM */
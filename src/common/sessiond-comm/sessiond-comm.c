@@ -26,6 +26,7 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include <errno.h>
+#include <netinet/tcp.h>
 
 #include <common/common.h>
 
@@ -37,12 +38,15 @@
 #include "inet.h"
 /* For Inet6 socket */
 #include "inet6.h"
+/* For local socket */
+#include "local.h"
 
 #define NETWORK_TIMEOUT_ENV	"LTTNG_NETWORK_SOCKET_TIMEOUT"
 
 static struct lttcomm_net_family net_families[] = {
 	{ LTTCOMM_INET, lttcomm_create_inet_sock },
 	{ LTTCOMM_INET6, lttcomm_create_inet6_sock },
+	{ LTTCOMM_UNIX, lttcomm_create_local_sock },
 };
 
 /*
@@ -104,7 +108,8 @@ int lttcomm_create_sock(struct lttcomm_sock *sock)
 	assert(sock);
 
 	domain = sock->sockaddr.type;
-	if (domain != LTTCOMM_INET && domain != LTTCOMM_INET6) {
+	if (domain != LTTCOMM_INET && domain != LTTCOMM_INET6 &&
+			domain != LTTCOMM_UNIX) {
 		ERR("Create socket of unknown domain %d", domain);
 		ret = -1;
 		goto error;
@@ -128,6 +133,10 @@ int lttcomm_create_sock(struct lttcomm_sock *sock)
 	if (ret < 0) {
 		goto error;
 	}
+	/* Before connect(2) or listen(2) for the buffers to be effective. */
+	if (sock->proto == LTTCOMM_SOCK_TCP && domain != LTTCOMM_UNIX) {
+		lttcomm_sock_apply_profile(sock->fd, sock->profile);
+	}
 
 error:
 	return ret;
@@ -196,6 +205,7 @@ void lttcomm_copy_sock(struct lttcomm_sock *dst, struct lttcomm_sock *src)
 	dst->proto = src->proto;
 	dst->fd = src->fd;
 	dst->ops = src->ops;
+	dst->profile = src->profile;
 	/* Copy sockaddr information from original socket */
 	memcpy(&dst->sockaddr, &src->sockaddr, sizeof(dst->sockaddr));
 }
@@ -260,6 +270,34 @@ error:
 	return ret;
 }
 
+/*
+ * Init Unix sockaddr structure.
+ */
+LTTNG_HIDDEN
+int lttcomm_init_local_sockaddr(struct lttcomm_sockaddr *sockaddr,
+		const char *path)
+{
+	int ret = 0;
+
+	assert(sockaddr);
+	assert(path);
+
+	memset(sockaddr, 0, sizeof(struct lttcomm_sockaddr));
+
+	if (strlen(path) >= sizeof(sockaddr->addr.un.sun_path)) {
+		ERR("Unix socket path too long: %s", path);
+		ret = -1;
+		goto error;
+	}
+
+	sockaddr->type = LTTCOMM_UNIX;
+	sockaddr->addr.un.sun_family = AF_UNIX;
+	strcpy(sockaddr->addr.un.sun_path, path);
+
+error:
+	return ret;
+}
+
 /*
  * Return allocated lttcomm socket structure from lttng URI.
  */
@@ -285,6 +323,7 @@ struct lttcomm_sock *lttcomm_alloc_sock_from_uri(struct lttng_uri *uri)
 	if (sock == NULL) {
 		goto alloc_error;
 	}
+	sock->profile = uri->profile;
 
 	/* Check destination type */
 	if (uri->dtype == LTTNG_DST_IPV4) {
@@ -299,6 +338,12 @@ struct lttcomm_sock *lttcomm_alloc_sock_from_uri(struct lttng_uri *uri)
 		if (ret < 0) {
 			goto error;
 		}
+	} else if (uri->dtype == LTTNG_DST_UNIX) {
+		ret = lttcomm_init_local_sockaddr(&sock->sockaddr,
+				uri->dst.path);
+		if (ret < 0) {
+			goto error;
+		}
 	} else {
 		/* Command URI is invalid */
 		ERR("Relayd invalid URI dst type: %d", uri->dtype);
@@ -413,6 +458,76 @@ int lttcomm_setsockopt_snd_timeout(int sock, unsigned int msec)
 	return ret;
 }
 
+/*
+ * Enable TCP keepalive so that a dead peer is detected without traffic.
+ */
+static void set_keepalive(int sock)
+{
+	int val = 1;
+
+	if (setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &val, sizeof(val)) < 0) {
+		PERROR("setsockopt SO_KEEPALIVE");
+		return;
+	}
+	val = DEFAULT_SOCK_KEEPALIVE_IDLE;
+	if (setsockopt(sock, IPPROTO_TCP, TCP_KEEPIDLE, &val, sizeof(val)) < 0) {
+		PERROR("setsockopt TCP_KEEPIDLE");
+	}
+	val = DEFAULT_SOCK_KEEPALIVE_INTVL;
+	if (setsockopt(sock, IPPROTO_TCP, TCP_KEEPINTVL, &val, sizeof(val)) < 0) {
+		PERROR("setsockopt TCP_KEEPINTVL");
+	}
+	val = DEFAULT_SOCK_KEEPALIVE_CNT;
+	if (setsockopt(sock, IPPROTO_TCP, TCP_KEEPCNT, &val, sizeof(val)) < 0) {
+		PERROR("setsockopt TCP_KEEPCNT");
+	}
+}
+
+/*
+ * Set the options of a tuning profile on a TCP socket. The profile is a
+ * hint: an option that can't be set is reported and skipped.
+ */
+LTTNG_HIDDEN
+void lttcomm_sock_apply_profile(int sock, enum lttng_sock_profile profile)
+{
+	int val;
+
+	switch (profile) {
+	case LTTNG_SOCK_PROFILE_LATENCY:
+		val = 1;
+		if (setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &val,
+				sizeof(val)) < 0) {
+			PERROR("setsockopt TCP_NODELAY");
+		}
+#ifdef SO_BUSY_POLL
+		val = DEFAULT_SOCK_LATENCY_BUSY_POLL;
+		if (setsockopt(sock, SOL_SOCKET, SO_BUSY_POLL, &val,
+				sizeof(val)) < 0) {
+			/* Above net.core.busy_read, CAP_NET_ADMIN is required. */
+			DBG("Busy polling unavailable on socket %d: %s", sock,
+					strerror(errno));
+		}
+#endif
+		set_keepalive(sock);
+		break;
+	case LTTNG_SOCK_PROFILE_THROUGHPUT:
+		val = DEFAULT_SOCK_THROUGHPUT_BUF_SIZE;
+		if (setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &val,
+				sizeof(val)) < 0) {
+			PERROR("setsockopt SO_SNDBUF");
+		}
+		if (setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &val,
+				sizeof(val)) < 0) {
+			PERROR("setsockopt SO_RCVBUF");
+		}
+		set_keepalive(sock);
+		break;
+	case LTTNG_SOCK_PROFILE_DEFAULT:
+	default:
+		break;
+	}
+}
+
 LTTNG_HIDDEN
 void lttcomm_init(void)
 {
@@ -439,3 +554,64 @@ unsigned long lttcomm_get_network_timeout(void)
 {
 	return network_timeout;
 }
+
+/*
+ * Send all the iovecs of "msg" on the socket "fd", resuming a partial send
+ * after the last byte sent. The iovecs of "msg" are consumed.
+ *
+ * Return the total size sent or else -1 with errno set.
+ */
+LTTNG_HIDDEN
+ssize_t lttcomm_sendmsg_all(int fd, struct msghdr *msg, int flags)
+{
+	return lttcomm_sendmsg_all_count(fd, msg, flags, NULL);
+}
+
+/*
+ * Same as lttcomm_sendmsg_all(), also adding to "nr_zerocopy" (if not NULL)
+ * the number of sendmsg() calls made with MSG_ZEROCOPY, each of which gets a
+ * completion notification on the error queue of the socket. When the kernel
+ * runs out of memory to pin the pages, the rest is sent without MSG_ZEROCOPY.
+ */
+LTTNG_HIDDEN
+ssize_t lttcomm_sendmsg_all_count(int fd, struct msghdr *msg, int flags,
+		unsigned int *nr_zerocopy)
+{
+	ssize_t ret;
+	size_t total = 0;
+
+	while (msg->msg_iovlen > 0) {
+		size_t sent;
+
+		do {
+			ret = sendmsg(fd, msg, flags);
+		} while (ret < 0 && errno == EINTR);
+#ifdef MSG_ZEROCOPY
+		if (ret < 0 && errno == ENOBUFS && (flags & MSG_ZEROCOPY)) {
+			flags &= ~MSG_ZEROCOPY;
+			continue;
+		}
+		if (ret > 0 && (flags & MSG_ZEROCOPY) && nr_zerocopy) {
+			(*nr_zerocopy)++;
+		}
+#endif
+		if (ret < 0) {
+			return ret;
+		}
+		total += ret;
+
+		/* Skip the iovecs sent, the first one left may be partial. */
+		sent = ret;
+		while (msg->msg_iovlen > 0 && sent >= msg->msg_iov->iov_len) {
+			sent -= msg->msg_iov->iov_len;
+			msg->msg_iov++;
+			msg->msg_iovlen--;
+		}
+		if (msg->msg_iovlen > 0) {
+			msg->msg_iov->iov_base =
+				(char *) msg->msg_iov->iov_base + sent;
+			msg->msg_iov->iov_len -= sent;
+		}
+	}
+	return total;
+}
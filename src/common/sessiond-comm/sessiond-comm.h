@@ -42,6 +42,7 @@
 
 #include "inet.h"
 #include "inet6.h"
+#include "local.h"
 #include <common/unix.h>
 
 /* Queue size of listen(2) */
@@ -49,6 +50,10 @@
 
 /* Maximum number of FDs that can be sent over a Unix socket */
 #define LTTCOMM_MAX_SEND_FDS           4
+/* Fds per message of the batched transfers, SCM_MAX_FD of Linux. */
+#define LTTCOMM_MAX_SEND_FDS_BATCH     253
+/* Maximum number of streams of a LTTNG_CONSUMER_ADD_STREAMS command. */
+#define LTTCOMM_CONSUMER_MAX_STREAMS   65536
 
 /*
  * Get the error code index from 0 since LTTCOMM_OK start at 1000
@@ -100,6 +105,13 @@ enum lttcomm_sessiond_command {
 	LTTNG_REGENERATE_STATEDUMP          = 42,
 	LTTNG_REGISTER_TRIGGER              = 43,
 	LTTNG_UNREGISTER_TRIGGER            = 44,
+	LTTNG_LIST_STREAM_STATS             = 45,
+	LTTNG_LOAD_SESSION_DEFINITION       = 46,
+	LTTNG_PERSISTENT_CONNECTION         = 47,
+	LTTNG_TRACK_PID_RANGES              = 48,
+	LTTNG_UNTRACK_PID_RANGES            = 49,
+	LTTNG_ROTATE_SESSION                = 50,
+	LTTNG_LIST_MEMORY_USAGE             = 51,
 };
 
 enum lttcomm_relayd_command {
@@ -123,6 +135,16 @@ enum lttcomm_relayd_command {
 	RELAYD_STREAMS_SENT                 = 16,
 	/* Ask the relay to reset the metadata trace file (2.8+) */
 	RELAYD_RESET_METADATA               = 17,
+	/* Live beacons of many streams in a single message (feature) */
+	RELAYD_SEND_BEACONS                 = 18,
+	/* Data pending check of many streams in a single message (feature) */
+	RELAYD_STREAMS_DATA_PENDING         = 19,
+	/* Add of many streams of a channel in a single message (feature) */
+	RELAYD_ADD_STREAMS                  = 20,
+	/* Close of many streams in a single message (feature) */
+	RELAYD_CLOSE_STREAMS                = 21,
+	/* Indexes of many packets in a single message (feature) */
+	RELAYD_SEND_INDEXES                 = 22,
 };
 
 /*
@@ -168,6 +190,7 @@ enum lttcomm_sock_proto {
 enum lttcomm_sock_domain {
 	LTTCOMM_INET      = 0,
 	LTTCOMM_INET6     = 1,
+	LTTCOMM_UNIX      = 2,
 };
 
 enum lttcomm_metadata_command {
@@ -187,6 +210,7 @@ struct lttcomm_metadata_request_msg {
 	uint32_t bits_per_long; /* Consumer ABI */
 	uint32_t uid;
 	uint64_t key; /* Metadata channel key. */
+	uint8_t reload; /* Send the whole metadata again. */
 } LTTNG_PACKED;
 
 struct lttcomm_sockaddr {
@@ -194,6 +218,7 @@ struct lttcomm_sockaddr {
 	union {
 		struct sockaddr_in sin;
 		struct sockaddr_in6 sin6;
+		struct sockaddr_un un;
 	} addr;
 } LTTNG_PACKED;
 
@@ -202,6 +227,8 @@ struct lttcomm_sock {
 	enum lttcomm_sock_proto proto;
 	struct lttcomm_sockaddr sockaddr;
 	const struct lttcomm_proto_ops *ops;
+	/* Applied on creation and inherited by the accepted sockets. */
+	enum lttng_sock_profile profile;
 } LTTNG_PACKED;
 
 /*
@@ -212,6 +239,8 @@ struct lttcomm_relayd_sock {
 	struct lttcomm_sock sock;
 	uint32_t major;
 	uint32_t minor;
+	/* Features of the relayd, enum lttcomm_relayd_feature. */
+	uint64_t features;
 } LTTNG_PACKED;
 
 struct lttcomm_net_family {
@@ -229,6 +258,9 @@ struct lttcomm_proto_ops {
 			int flags);
 	ssize_t (*sendmsg) (struct lttcomm_sock *sock, const void *buf,
 			size_t len, int flags);
+	/* Send all the iovecs at once, consuming them. */
+	ssize_t (*sendmsg_iov) (struct lttcomm_sock *sock, struct iovec *iov,
+			int iovcnt, int flags);
 };
 
 /*
@@ -291,6 +323,9 @@ struct lttcomm_session_msg {
 		/* List */
 		struct {
 			char channel_name[LTTNG_SYMBOL_NAME_LEN];
+			/* LTTNG_LIST_TRACEPOINTS, 0 to list everything at once. */
+			uint32_t page_len;
+			int32_t pid_cursor;
 		} LTTNG_PACKED list;
 		struct lttng_calibrate calibrate;
 		/* Used by the set_consumer_url and used by create_session also call */
@@ -304,6 +339,8 @@ struct lttcomm_session_msg {
 		struct {
 			uint32_t wait;
 			struct lttng_snapshot_output output LTTNG_PACKED;
+			/* Only write the packets produced since the last snapshot. */
+			uint32_t incremental;
 		} LTTNG_PACKED snapshot_record;
 		struct {
 			uint32_t nb_uri;
@@ -318,13 +355,28 @@ struct lttcomm_session_msg {
 		struct {
 			uint32_t pid;
 		} LTTNG_PACKED pid_tracker;
+		struct {
+			/* Number of struct lttng_pid_range that follow. */
+			uint32_t nb_ranges;
+		} LTTNG_PACKED pid_ranges;
+		struct {
+			/* Path of the new trace chunk, empty for the default. */
+			char path[PATH_MAX];
+		} LTTNG_PACKED rotate_session;
 		struct {
 			uint32_t length;
 		} LTTNG_PACKED trigger;
+		struct {
+			/* Size of the session configuration document that follows. */
+			uint32_t size;
+			uint32_t overwrite;
+		} LTTNG_PACKED load_definition;
 	} u;
 } LTTNG_PACKED;
 
 #define LTTNG_FILTER_MAX_LEN	65536
+/* Maximal number of ranges of a LTTNG_TRACK_PID_RANGES command. */
+#define LTTNG_PID_RANGES_MAX	65536
 
 /*
  * Filter bytecode data. The reloc table is located at the end of the
@@ -398,6 +450,13 @@ struct lttcomm_lttng_output_id {
 	uint32_t id;
 } LTTNG_PACKED;
 
+/*
+ * Maximal number of usage thresholds filtering the monitoring samples of a
+ * channel. The session daemon asks for every sample of a channel whose
+ * triggers need more.
+ */
+#define LTTCOMM_CONSUMER_MONITOR_THRESHOLDS_MAX	16
+
 /*
  * lttcomm_consumer_msg is the message sent from sessiond to consumerd
  * to either add a channel, add a stream, update a stream, or stop
@@ -427,6 +486,8 @@ struct lttcomm_consumer_msg {
 			unsigned int live_timer_interval;
 			/* timer to sample a channel's positions (usec). */
 			unsigned int monitor_timer_interval;
+			/* enum lttng_channel_compression of the packets. */
+			uint32_t compression;
 		} LTTNG_PACKED channel; /* Only used by Kernel. */
 		struct {
 			uint64_t stream_key;
@@ -435,6 +496,15 @@ struct lttcomm_consumer_msg {
 			/* Tells the consumer if the stream should be or not monitored. */
 			uint32_t no_monitor;
 		} LTTNG_PACKED stream;	/* Only used by Kernel. */
+		/*
+		 * The message is followed by the CPU (int32_t) of each stream,
+		 * then by their fds sent with
+		 * lttcomm_send_fds_batch_unix_sock().
+		 */
+		struct {
+			uint64_t channel_key;
+			uint32_t nb_streams;
+		} LTTNG_PACKED streams;	/* Only used by Kernel. */
 		struct {
 			uint64_t net_index;
 			enum lttng_stream_type type;
@@ -483,6 +553,8 @@ struct lttcomm_consumer_msg {
 			 */
 			uint32_t ust_app_uid;
 			int64_t blocking_timeout;
+			uint32_t compression;			/* enum lttng_channel_compression */
+			uint8_t huge_pages;
 			char root_shm_path[PATH_MAX];
 			char shm_path[PATH_MAX];
 		} LTTNG_PACKED ask_channel;
@@ -518,6 +590,12 @@ struct lttcomm_consumer_msg {
 			uint64_t relayd_id;		/* Relayd id if apply. */
 			uint64_t key;
 			uint64_t nb_packets_per_stream;
+			/*
+			 * Start from the position reached by the last snapshot
+			 * of the stream to the same output.
+			 */
+			uint32_t incremental;
+			uint64_t output_id;
 		} LTTNG_PACKED snapshot_channel;
 		struct {
 			uint64_t channel_key;
@@ -534,12 +612,59 @@ struct lttcomm_consumer_msg {
 		struct {
 			uint64_t session_id;
 		} LTTNG_PACKED regenerate_metadata;
+		struct {
+			uint64_t channel_key;
+		} LTTNG_PACKED stream_stats;
+		struct {
+			uint64_t session_id;
+		} LTTNG_PACKED channel_stats;
+		struct {
+			uint64_t key;
+			/* Send every sample, the thresholds are ignored. */
+			uint32_t forward_all;
+			uint32_t nr_thresholds;
+			uint64_t thresholds[LTTCOMM_CONSUMER_MONITOR_THRESHOLDS_MAX];
+		} LTTNG_PACKED channel_monitor_filter;
+		struct {
+			/* Stop consuming the channels of priority 0 if set. */
+			uint32_t enable;
+		} LTTNG_PACKED overload_shedding;
+		struct {
+			uint64_t session_id;
+			/* Output directory of the current and new trace chunks. */
+			char old_root[PATH_MAX];
+			char new_root[PATH_MAX];
+		} LTTNG_PACKED rotate_session;
 	} u;
 } LTTNG_PACKED;
 
 /*
- * Channel monitoring message returned to the session daemon on every
- * monitor timer expiration.
+ * Consumption statistics of a stream. The reply to LTTNG_CONSUMER_STREAM_STATS
+ * is the number of streams (uint64_t) followed by one of those per stream.
+ */
+struct lttcomm_consumer_stream_stats {
+	int32_t cpu;
+	uint64_t bytes_consumed;
+	uint64_t subbufs_consumed;
+	uint64_t write_latency_hist[LTTNG_STREAM_STATS_LATENCY_BUCKETS];
+	uint64_t wakeup_delay_total;
+	uint64_t wakeup_delay_max;
+	uint64_t lag_bytes;
+} LTTNG_PACKED;
+
+/*
+ * Runtime statistics of a channel. The reply to LTTNG_CONSUMER_CHANNEL_STATS
+ * is the number of channels (uint64_t) followed by one of those per data
+ * channel of the session.
+ */
+struct lttcomm_consumer_channel_stats {
+	uint64_t key;
+	uint64_t discarded_events;
+	uint64_t lost_packets;
+} LTTNG_PACKED;
+
+/*
+ * Channel monitoring sample taken on every monitor timer expiration.
  */
 struct lttcomm_consumer_channel_monitor_msg {
 	/* Key of the sampled channel. */
@@ -548,6 +673,36 @@ struct lttcomm_consumer_channel_monitor_msg {
 	 * Lowest and highest usage (bytes) at the moment the sample was taken.
 	 */
 	uint64_t lowest, highest;
+	/*
+	 * Running totals of the channel, used to compute its rates: bytes
+	 * consumed by its current streams, discarded events and lost packets.
+	 */
+	uint64_t consumed_bytes;
+	uint64_t discarded_events;
+	uint64_t lost_packets;
+	/* CLOCK_MONOTONIC time (nsec) at which the sample was taken. */
+	uint64_t timestamp;
+	/* Consumption priority of the channel in the consumer daemon. */
+	uint32_t priority;
+} LTTNG_PACKED;
+
+/*
+ * Maximal number of samples of a batch so that it is written atomically to
+ * the channel monitoring pipe.
+ */
+#define LTTCOMM_CONSUMER_CHANNEL_MONITOR_BATCH_MAX \
+	((PIPE_BUF - sizeof(uint32_t)) / \
+		sizeof(struct lttcomm_consumer_channel_monitor_msg))
+
+/*
+ * Channel monitoring message returned to the session daemon. It holds the
+ * samples of all the channels whose monitor timer expired on the same timer
+ * wakeup: the number of samples (uint32_t) is followed by the samples.
+ */
+struct lttcomm_consumer_channel_monitor_batch_msg {
+	uint32_t nb_samples;
+	struct lttcomm_consumer_channel_monitor_msg samples[
+			LTTCOMM_CONSUMER_CHANNEL_MONITOR_BATCH_MAX];
 } LTTNG_PACKED;
 
 /*
@@ -610,6 +765,8 @@ extern int lttcomm_init_inet_sockaddr(struct lttcomm_sockaddr *sockaddr,
 		const char *ip, unsigned int port);
 extern int lttcomm_init_inet6_sockaddr(struct lttcomm_sockaddr *sockaddr,
 		const char *ip, unsigned int port);
+extern int lttcomm_init_local_sockaddr(struct lttcomm_sockaddr *sockaddr,
+		const char *path);
 
 extern struct lttcomm_sock *lttcomm_alloc_sock(enum lttcomm_sock_proto proto);
 extern int lttcomm_create_sock(struct lttcomm_sock *sock);
@@ -625,9 +782,15 @@ extern struct lttcomm_relayd_sock *lttcomm_alloc_relayd_sock(
 
 extern int lttcomm_setsockopt_rcv_timeout(int sock, unsigned int msec);
 extern int lttcomm_setsockopt_snd_timeout(int sock, unsigned int msec);
+extern void lttcomm_sock_apply_profile(int sock,
+		enum lttng_sock_profile profile);
 
 extern void lttcomm_init(void);
 /* Get network timeout, in milliseconds */
 extern unsigned long lttcomm_get_network_timeout(void);
 
+extern ssize_t lttcomm_sendmsg_all(int fd, struct msghdr *msg, int flags);
+extern ssize_t lttcomm_sendmsg_all_count(int fd, struct msghdr *msg,
+		int flags, unsigned int *nr_zerocopy);
+
 #endif	/* _LTTNG_SESSIOND_COMM_H */
@@ -0,0 +1,232 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <urcu/uatomic.h>
+
+#include <common/common.h>
+#include <common/defaults.h>
+#include <common/runas.h>
+#include <common/utils.h>
+
+#include "stripe.h"
+
+static char **stripe_roots;
+static unsigned int nr_stripe_roots;
+/* Sequence number of the last striped file created by this process. */
+static unsigned long stripe_seq;
+
+LTTNG_HIDDEN
+int stripe_set_roots(const char *paths)
+{
+	int ret;
+	char *copy, *root, *saveptr = NULL;
+	char **roots = NULL, **new_roots;
+	unsigned int nr_roots = 0;
+
+	copy = strdup(paths);
+	if (!copy) {
+		PERROR("strdup stripe roots");
+		ret = -1;
+		goto end;
+	}
+
+	for (root = strtok_r(copy, ":", &saveptr); root;
+			root = strtok_r(NULL, ":", &saveptr)) {
+		size_t len = strlen(root);
+
+		if (*root != '/') {
+			ERR("Stripe root %s is not an absolute path", root);
+			ret = -1;
+			goto error;
+		}
+		/* The paths under a root start with a slash. */
+		while (len > 1 && root[len - 1] == '/') {
+			root[--len] = '\0';
+		}
+		new_roots = realloc(roots, (nr_roots + 1) * sizeof(*roots));
+		if (!new_roots) {
+			PERROR("realloc stripe roots");
+			ret = -1;
+			goto error;
+		}
+		roots = new_roots;
+		roots[nr_roots] = strdup(len == 1 ? "" : root);
+		if (!roots[nr_roots]) {
+			PERROR("strdup stripe root");
+			ret = -1;
+			goto error;
+		}
+		nr_roots++;
+	}
+	if (!nr_roots) {
+		ERR("No stripe root in %s", paths);
+		ret = -1;
+		goto error;
+	}
+
+	stripe_roots = roots;
+	nr_stripe_roots = nr_roots;
+	roots = NULL;
+	nr_roots = 0;
+	ret = 0;
+
+error:
+	while (nr_roots > 0) {
+		free(roots[--nr_roots]);
+	}
+	free(roots);
+	free(copy);
+end:
+	return ret;
+}
+
+LTTNG_HIDDEN
+bool stripe_tracefile(const char *file_name, const char *suffix)
+{
+	return nr_stripe_roots && !suffix &&
+			strcmp(file_name, DEFAULT_METADATA_NAME) != 0;
+}
+
+/*
+ * Return true if the path is the path of a striped file.
+ */
+static bool is_stripe_target(const char *path)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr_stripe_roots; i++) {
+		size_t len = strlen(stripe_roots[i]);
+
+		if (!strncmp(path, stripe_roots[i], len) && path[len] == '/') {
+			return true;
+		}
+	}
+	return false;
+}
+
+static int unlink_as(const char *path, int uid, int gid)
+{
+	if (uid < 0 || gid < 0) {
+		return unlink(path);
+	}
+	return run_as_unlink(path, uid, gid);
+}
+
+LTTNG_HIDDEN
+void stripe_unlink_target(const char *path, int uid, int gid)
+{
+	ssize_t len;
+	char target[PATH_MAX];
+
+	len = readlink(path, target, sizeof(target) - 1);
+	if (len < 0) {
+		return;
+	}
+	target[len] = '\0';
+	/* Only the files created by the striping are unlinked. */
+	if (!is_stripe_target(target)) {
+		return;
+	}
+	if (unlink_as(target, uid, gid) < 0 && errno != ENOENT) {
+		PERROR("unlink striped file %s", target);
+	}
+}
+
+LTTNG_HIDDEN
+int stripe_create_file(const char *path, int flags, mode_t mode, int uid,
+		int gid)
+{
+	int ret, fd = -1;
+	unsigned long seq;
+	char target[PATH_MAX];
+	char *dir_end;
+
+	seq = uatomic_add_return(&stripe_seq, 1);
+	/*
+	 * The streams are spread over the roots in turn, as are the
+	 * successive tracefiles of a stream. The name is unique so that a
+	 * tracefile replacing another one never truncates its file, which a
+	 * live reader may still have opened.
+	 */
+	ret = snprintf(target, sizeof(target), "%s%s.%d-%lu",
+			stripe_roots[seq % nr_stripe_roots], path,
+			(int) getpid(), seq);
+	if (ret < 0 || ret >= sizeof(target)) {
+		ERR("Striped path of %s too long", path);
+		ret = -1;
+		goto end;
+	}
+
+	dir_end = strrchr(target, '/');
+	*dir_end = '\0';
+	ret = utils_mkdir_recursive(target, S_IRWXU | S_IRWXG, uid, gid);
+	*dir_end = '/';
+	if (ret < 0) {
+		goto end;
+	}
+
+	flags = (flags & ~O_TRUNC) | O_CREAT | O_EXCL;
+	if (uid < 0 || gid < 0) {
+		fd = open(target, flags, mode);
+	} else {
+		fd = run_as_open(target, flags, mode, uid, gid);
+	}
+	if (fd < 0) {
+		PERROR("open striped file %s", target);
+		ret = -1;
+		goto end;
+	}
+
+	/* Replace the file or link of this name, as O_TRUNC would. */
+	stripe_unlink_target(path, uid, gid);
+	ret = unlink_as(path, uid, gid);
+	if (ret < 0 && errno != ENOENT) {
+		PERROR("unlink tracefile %s", path);
+		goto error;
+	}
+	if (uid < 0 || gid < 0) {
+		ret = symlink(target, path);
+	} else {
+		ret = run_as_symlink(target, path, uid, gid);
+	}
+	if (ret < 0) {
+		PERROR("symlink tracefile %s to %s", path, target);
+		goto error;
+	}
+	DBG("Tracefile %s striped in %s", path, target);
+	ret = fd;
+	goto end;
+
+error:
+	(void) unlink_as(target, uid, gid);
+	if (close(fd)) {
+		PERROR("close striped file");
+	}
+	ret = -1;
+end:
+	return ret;
+}
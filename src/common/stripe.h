@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _COMMON_STRIPE_H
+#define _COMMON_STRIPE_H
+
+/*
+ * Striped output of the tracefiles.
+ *
+ * The tracefiles of the streams are written under several stripe roots, in
+ * turn, typically on distinct devices. Each file mirrors the path of its
+ * tracefile under its root, and the trace directory holds a symbolic link to
+ * it in place of the tracefile. The trace directory remains the manifest of
+ * the trace: a viewer reads it as is, and the links give the location of
+ * each file. The metadata and index files are not striped.
+ */
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include <common/macros.h>
+
+/*
+ * Set the stripe roots from a colon-separated list of absolute paths. The
+ * roots are set once, before any tracefile is created.
+ *
+ * Return 0 on success or else a negative value.
+ */
+LTTNG_HIDDEN
+int stripe_set_roots(const char *paths);
+
+/*
+ * Return true if the tracefile named file_name, with the suffix suffix, is
+ * striped.
+ */
+LTTNG_HIDDEN
+bool stripe_tracefile(const char *file_name, const char *suffix);
+
+/*
+ * Create a tracefile of the absolute path "path" under the next stripe root,
+ * and link it from "path" in place of any file of this name.
+ *
+ * Return the file descriptor or else a negative value.
+ */
+LTTNG_HIDDEN
+int stripe_create_file(const char *path, int flags, mode_t mode, int uid,
+		int gid);
+
+/*
+ * Unlink the striped file linked from the absolute path "path", if any. The
+ * link itself is left in place.
+ */
+LTTNG_HIDDEN
+void stripe_unlink_target(const char *path, int uid, int gid);
+
+#endif /* _COMMON_STRIPE_H */
@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <common/compat/time.h>
+#include <common/macros.h>
+
+#include "time.h"
+
+/*
+ * Return the current CLOCK_MONOTONIC time in nsec or 0 on error.
+ */
+LTTNG_HIDDEN
+uint64_t lttng_monotonic_time_ns(void)
+{
+	struct timespec ts;
+
+	if (lttng_clock_gettime(CLOCK_MONOTONIC, &ts)) {
+		return 0;
+	}
+	return (uint64_t) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
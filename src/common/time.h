@@ -19,9 +19,13 @@
 #ifndef LTTNG_TIME_H
 #define LTTNG_TIME_H
 
+#include <stdint.h>
+
 #define MSEC_PER_SEC	1000ULL
 #define NSEC_PER_SEC	1000000000ULL
 #define NSEC_PER_MSEC	1000000ULL
 #define NSEC_PER_USEC	1000ULL
 
+uint64_t lttng_monotonic_time_ns(void);
+
 #endif /* LTTNG_TIME_H */
@@ -79,10 +79,9 @@ void lttng_trigger_destroy(struct lttng_trigger *trigger)
 	free(trigger);
 }
 
-LTTNG_HIDDEN
-ssize_t lttng_trigger_create_from_buffer(
-		const struct lttng_buffer_view *src_view,
-		struct lttng_trigger **trigger)
+static
+ssize_t trigger_create_from_buffer(const struct lttng_buffer_view *src_view,
+		struct lttng_trigger **trigger, bool borrow)
 {
 	ssize_t ret, offset = 0, condition_size, action_size;
 	struct lttng_condition *condition = NULL;
@@ -103,8 +102,11 @@ ssize_t lttng_trigger_create_from_buffer(
 	condition_view = lttng_buffer_view_from_view(src_view, offset, -1);
 
 	/* struct lttng_condition */
-	condition_size = lttng_condition_create_from_buffer(&condition_view,
-			&condition);
+	condition_size = borrow ?
+			lttng_condition_create_from_buffer_borrowed(
+				&condition_view, &condition) :
+			lttng_condition_create_from_buffer(&condition_view,
+				&condition);
 	if (condition_size < 0) {
 		ret = condition_size;
 		goto end;
@@ -140,6 +142,22 @@ error:
 	return ret;
 }
 
+LTTNG_HIDDEN
+ssize_t lttng_trigger_create_from_buffer(
+		const struct lttng_buffer_view *src_view,
+		struct lttng_trigger **trigger)
+{
+	return trigger_create_from_buffer(src_view, trigger, false);
+}
+
+LTTNG_HIDDEN
+ssize_t lttng_trigger_create_from_buffer_borrowed(
+		const struct lttng_buffer_view *src_view,
+		struct lttng_trigger **trigger)
+{
+	return trigger_create_from_buffer(src_view, trigger, true);
+}
+
 /*
  * Returns the size of a trigger (header + condition + action).
  * Both elements are stored contiguously, see their "*_comm" structure
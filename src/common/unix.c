@@ -369,12 +369,10 @@ int lttcomm_close_unix_sock(int sock)
 }
 
 /*
- * Send a message accompanied by fd(s) over a unix socket.
- *
- * Returns the size of data sent, or negative error value.
+ * Send a one byte message accompanied by nb_fd fds, without bound on nb_fd
+ * other than the one of the kernel.
  */
-LTTNG_HIDDEN
-ssize_t lttcomm_send_fds_unix_sock(int sock, int *fds, size_t nb_fd)
+static ssize_t send_fds_msg(int sock, int *fds, size_t nb_fd)
 {
 	struct msghdr msg;
 	struct cmsghdr *cmptr;
@@ -387,9 +385,6 @@ ssize_t lttcomm_send_fds_unix_sock(int sock, int *fds, size_t nb_fd)
 	memset(&msg, 0, sizeof(msg));
 	memset(tmp, 0, CMSG_SPACE(sizeof_fds) * sizeof(char));
 
-	if (nb_fd > LTTCOMM_MAX_SEND_FDS)
-		return -EINVAL;
-
 	msg.msg_control = (caddr_t)tmp;
 	msg.msg_controllen = CMSG_LEN(sizeof_fds);
 
@@ -425,15 +420,49 @@ ssize_t lttcomm_send_fds_unix_sock(int sock, int *fds, size_t nb_fd)
 }
 
 /*
- * Recv a message accompanied by fd(s) from a unix socket.
+ * Send a message accompanied by fd(s) over a unix socket.
  *
- * Returns the size of received data, or negative error value.
+ * Returns the size of data sent, or negative error value.
+ */
+LTTNG_HIDDEN
+ssize_t lttcomm_send_fds_unix_sock(int sock, int *fds, size_t nb_fd)
+{
+	if (nb_fd > LTTCOMM_MAX_SEND_FDS)
+		return -EINVAL;
+
+	return send_fds_msg(sock, fds, nb_fd);
+}
+
+/*
+ * Send any number of fds over a unix socket, in as few messages of up to
+ * LTTCOMM_MAX_SEND_FDS_BATCH fds as possible. The receiver must expect the
+ * same number of fds with lttcomm_recv_fds_batch_unix_sock().
  *
- * Expect at most "nb_fd" file descriptors. Returns the number of fd
- * actually received in nb_fd.
+ * Returns the number of fds sent, or negative error value.
  */
 LTTNG_HIDDEN
-ssize_t lttcomm_recv_fds_unix_sock(int sock, int *fds, size_t nb_fd)
+ssize_t lttcomm_send_fds_batch_unix_sock(int sock, int *fds, size_t nb_fd)
+{
+	size_t sent = 0;
+
+	while (sent < nb_fd) {
+		size_t nb = min_t(size_t, nb_fd - sent,
+				LTTCOMM_MAX_SEND_FDS_BATCH);
+		ssize_t ret;
+
+		ret = send_fds_msg(sock, fds + sent, nb);
+		if (ret < 0) {
+			return ret;
+		}
+		sent += nb;
+	}
+	return sent;
+}
+
+/*
+ * Receive a one byte message accompanied by exactly nb_fd fds.
+ */
+static ssize_t recv_fds_msg(int sock, int *fds, size_t nb_fd)
 {
 	struct iovec iov[1];
 	ssize_t ret = 0;
@@ -493,6 +522,53 @@ end:
 	return ret;
 }
 
+/*
+ * Recv a message accompanied by fd(s) from a unix socket.
+ *
+ * Returns the size of received data, or negative error value.
+ *
+ * Expect at most "nb_fd" file descriptors. Returns the number of fd
+ * actually received in nb_fd.
+ */
+LTTNG_HIDDEN
+ssize_t lttcomm_recv_fds_unix_sock(int sock, int *fds, size_t nb_fd)
+{
+	return recv_fds_msg(sock, fds, nb_fd);
+}
+
+/*
+ * Receive the nb_fd fds sent by lttcomm_send_fds_batch_unix_sock(). On error,
+ * the fds received so far are closed.
+ *
+ * Returns the number of fds received, or negative error value.
+ */
+LTTNG_HIDDEN
+ssize_t lttcomm_recv_fds_batch_unix_sock(int sock, int *fds, size_t nb_fd)
+{
+	size_t received = 0, i;
+	ssize_t ret;
+
+	while (received < nb_fd) {
+		size_t nb = min_t(size_t, nb_fd - received,
+				LTTCOMM_MAX_SEND_FDS_BATCH);
+
+		ret = recv_fds_msg(sock, fds + received, nb);
+		if (ret != (ssize_t) (nb * sizeof(int))) {
+			goto error;
+		}
+		received += nb;
+	}
+	return received;
+
+error:
+	for (i = 0; i < received; i++) {
+		if (close(fds[i])) {
+			PERROR("close received fd");
+		}
+	}
+	return ret < 0 ? ret : -1;
+}
+
 /*
  * Send a message with credentials over a unix socket.
  *
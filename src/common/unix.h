@@ -43,6 +43,11 @@ ssize_t lttcomm_send_fds_unix_sock(int sock, int *fds, size_t nb_fd);
 /* Recv a message accompanied by fd(s) from a unix socket */
 LTTNG_HIDDEN
 ssize_t lttcomm_recv_fds_unix_sock(int sock, int *fds, size_t nb_fd);
+/* Send and recv any number of fds in as few messages as possible. */
+LTTNG_HIDDEN
+ssize_t lttcomm_send_fds_batch_unix_sock(int sock, int *fds, size_t nb_fd);
+LTTNG_HIDDEN
+ssize_t lttcomm_recv_fds_batch_unix_sock(int sock, int *fds, size_t nb_fd);
 
 LTTNG_HIDDEN
 ssize_t lttcomm_recv_unix_sock(int sock, void *buf, size_t len);
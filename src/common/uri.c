@@ -33,7 +33,7 @@
 #define LOOPBACK_ADDR_IPV6 "::1"
 
 enum uri_proto_code {
-	P_NET, P_NET6, P_FILE, P_TCP, P_TCP6,
+	P_NET, P_NET6, P_FILE, P_TCP, P_TCP6, P_UNIX,
 };
 
 struct uri_proto {
@@ -53,6 +53,7 @@ static const struct uri_proto proto_uri[] = {
 	{ .name = "tcp", .leading_string = "tcp://", .code = P_TCP, .type = LTTNG_TCP, .dtype = LTTNG_DST_IPV4 },
 	{ .name = "tcp4", .leading_string = "tcp4://", .code = P_TCP, .type = LTTNG_TCP, .dtype = LTTNG_DST_IPV4 },
 	{ .name = "tcp6", .leading_string = "tcp6://", .code = P_TCP6, .type = LTTNG_TCP, .dtype = LTTNG_DST_IPV6 },
+	{ .name = "unix", .leading_string = "unix://", .code = P_UNIX, .type = LTTNG_TCP, .dtype = LTTNG_DST_UNIX },
 	/* Invalid proto marking the end of the array. */
 	{ NULL, NULL, 0, 0, 0 }
 };
@@ -71,6 +72,41 @@ static const inline char *strpbrk_or_eos(const char *s, const char *accept)
 	return p;
 }
 
+/* Socket tuning profiles, indexed by enum lttng_sock_profile. */
+static const char *sock_profile_names[] = {
+	[ LTTNG_SOCK_PROFILE_DEFAULT ] = "default",
+	[ LTTNG_SOCK_PROFILE_LATENCY ] = "latency",
+	[ LTTNG_SOCK_PROFILE_THROUGHPUT ] = "throughput",
+};
+
+/*
+ * Parse the query of a network URI, "profile=NAME" being the only supported
+ * parameter.
+ *
+ * Return 0 on success or else -1.
+ */
+static int parse_query(const char *query, enum lttng_sock_profile *profile)
+{
+	unsigned int i;
+	const char *name;
+
+	if (strncmp(query, "profile=", strlen("profile="))) {
+		ERR("Unknown URI parameter: %s", query);
+		goto error;
+	}
+	name = query + strlen("profile=");
+
+	for (i = 0; i < ARRAY_SIZE(sock_profile_names); i++) {
+		if (!strcmp(name, sock_profile_names[i])) {
+			*profile = i;
+			return 0;
+		}
+	}
+	ERR("Unknown socket profile: %s", name);
+error:
+	return -1;
+}
+
 /*
  * Validate if proto is a supported protocol from proto_uri array.
  */
@@ -178,7 +214,8 @@ static void set_default_uri_attr(struct lttng_uri *uri,
 		enum lttng_stream_type stype)
 {
 	uri->stype = stype;
-	if (uri->dtype != LTTNG_DST_PATH && uri->port == 0) {
+	if (uri->dtype != LTTNG_DST_PATH && uri->dtype != LTTNG_DST_UNIX &&
+			uri->port == 0) {
 		uri->port = (stype == LTTNG_STREAM_CONTROL) ?
 			DEFAULT_NETWORK_CONTROL_PORT : DEFAULT_NETWORK_DATA_PORT;
 	}
@@ -203,6 +240,10 @@ static int compare_destination(struct lttng_uri *ctrl, struct lttng_uri *data)
 	case LTTNG_DST_IPV6:
 		ret = strncmp(ctrl->dst.ipv6, data->dst.ipv6, sizeof(ctrl->dst.ipv6));
 		break;
+	case LTTNG_DST_UNIX:
+		/* The control and data sockets of a relayd have their own path. */
+		ret = data->dtype == LTTNG_DST_UNIX ? 0 : -1;
+		break;
 	default:
 		ret = -1;
 		break;
@@ -219,26 +260,43 @@ int uri_to_str_url(struct lttng_uri *uri, char *dst, size_t size)
 {
 	int ipver, ret;
 	const char *addr;
-	char proto[5], port[7];
+	char proto[5], port[7], query[32];
 
 	assert(uri);
 	assert(dst);
 
+	if (uri->dtype == LTTNG_DST_UNIX) {
+		/* A socket path has no port nor subdirectory. */
+		ret = snprintf(dst, size, "unix://%s", uri->dst.path);
+		if (ret < 0) {
+			PERROR("snprintf uri to url");
+		}
+		return ret;
+	}
+
 	if (uri->dtype == LTTNG_DST_PATH) {
 		ipver = 0;
 		addr = uri->dst.path;
 		(void) snprintf(proto, sizeof(proto), "file");
 		(void) snprintf(port, sizeof(port), "%s", "");
+		query[0] = '\0';
 	} else {
 		ipver = (uri->dtype == LTTNG_DST_IPV4) ? 4 : 6;
 		addr = (ipver == 4) ?  uri->dst.ipv4 : uri->dst.ipv6;
 		(void) snprintf(proto, sizeof(proto), "tcp%d", ipver);
 		(void) snprintf(port, sizeof(port), ":%d", uri->port);
+		if (uri->profile != LTTNG_SOCK_PROFILE_DEFAULT &&
+				uri->profile < ARRAY_SIZE(sock_profile_names)) {
+			(void) snprintf(query, sizeof(query), "?profile=%s",
+					sock_profile_names[uri->profile]);
+		} else {
+			query[0] = '\0';
+		}
 	}
 
-	ret = snprintf(dst, size, "%s://%s%s%s%s/%s", proto,
+	ret = snprintf(dst, size, "%s://%s%s%s%s/%s%s", proto,
 			(ipver == 6) ? "[" : "", addr, (ipver == 6) ? "]" : "",
-			port, uri->subdir);
+			port, uri->subdir, query);
 	if (ret < 0) {
 		PERROR("snprintf uri to url");
 	}
@@ -310,8 +368,9 @@ ssize_t uri_parse(const char *str_uri, struct lttng_uri **uris)
 	struct lttng_uri *tmp_uris;
 	char *addr_f = NULL;
 	const struct uri_proto *proto;
-	const char *purl, *addr_e, *addr_b, *subdir_b = NULL;
-	const char *seps = ":/\0";
+	const char *purl, *addr_e, *addr_b, *subdir_b = NULL, *query = NULL;
+	const char *seps = ":/?\0";
+	enum lttng_sock_profile profile = LTTNG_SOCK_PROFILE_DEFAULT;
 
 	/*
 	 * The first part is the protocol portion of a maximum of 5 bytes for now.
@@ -350,7 +409,7 @@ ssize_t uri_parse(const char *str_uri, struct lttng_uri **uris)
 	tmp_uris[0].dtype = proto->dtype;
 	tmp_uris[0].proto = proto->type;
 
-	if (proto->code == P_FILE) {
+	if (proto->code == P_FILE || proto->code == P_UNIX) {
 		if (*purl != '/') {
 			ERR("Missing destination full path.");
 			goto free_error;
@@ -471,6 +530,8 @@ ssize_t uri_parse(const char *str_uri, struct lttng_uri **uris)
 		 */
 		++purl;
 		subdir_b = purl;
+	} else if (*purl == '?') {
+		query = purl + 1;
 	} else if (*purl != '\0') {
 		ERR("Trailing characters not recognized: %s", purl);
 		goto free_error;
@@ -483,8 +544,25 @@ ssize_t uri_parse(const char *str_uri, struct lttng_uri **uris)
 
 	/* Copy subdirectory if one. */
 	if (subdir_b) {
+		char *subdir_query;
+
 		strncpy(tmp_uris[0].subdir, subdir_b, sizeof(tmp_uris[0].subdir));
 		tmp_uris[0].subdir[sizeof(tmp_uris[0].subdir) - 1] = '\0';
+
+		/* proto://addr_host/foo/bar?profile=latency */
+		subdir_query = strchr(tmp_uris[0].subdir, '?');
+		if (subdir_query) {
+			*subdir_query = '\0';
+			query = subdir_b + (subdir_query - tmp_uris[0].subdir) + 1;
+		}
+	}
+
+	if (query) {
+		ret = parse_query(query, &profile);
+		if (ret < 0) {
+			goto free_error;
+		}
+		tmp_uris[0].profile = profile;
 	}
 
 	switch (proto->code) {
@@ -500,6 +578,7 @@ ssize_t uri_parse(const char *str_uri, struct lttng_uri **uris)
 		tmp_uris[1].dtype = proto->dtype;
 		tmp_uris[1].proto = proto->type;
 		tmp_uris[1].port = data_port;
+		tmp_uris[1].profile = profile;
 		break;
 	case P_NET6:
 		ret = set_ip_address(addr_f, AF_INET6, tmp_uris[0].dst.ipv6,
@@ -513,6 +592,7 @@ ssize_t uri_parse(const char *str_uri, struct lttng_uri **uris)
 		tmp_uris[1].dtype = proto->dtype;
 		tmp_uris[1].proto = proto->type;
 		tmp_uris[1].port = data_port;
+		tmp_uris[1].profile = profile;
 		break;
 	case P_TCP:
 		ret = set_ip_address(addr_f, AF_INET, tmp_uris[0].dst.ipv4,
@@ -26,6 +26,8 @@ enum lttng_dst_type {
 	LTTNG_DST_IPV4                        = 1,
 	LTTNG_DST_IPV6                        = 2,
 	LTTNG_DST_PATH                        = 3,
+	/* Unix socket of a relayd of the same host, at dst.path. */
+	LTTNG_DST_UNIX                        = 4,
 };
 
 /* Type of lttng URI where it is a final destination or a hop */
@@ -57,6 +59,18 @@ enum lttng_proto_type {
 	 */
 };
 
+/*
+ * Tuning profile of the sockets of a network URI, set with the "?profile="
+ * suffix of the URI. The value 0 keeps the defaults of the operating system.
+ */
+enum lttng_sock_profile {
+	LTTNG_SOCK_PROFILE_DEFAULT            = 0,
+	/* TCP_NODELAY and busy polling, for the live sessions. */
+	LTTNG_SOCK_PROFILE_LATENCY            = 1,
+	/* Large socket buffers and corked data headers, for bulk transfers. */
+	LTTNG_SOCK_PROFILE_THROUGHPUT         = 2,
+};
+
 /*
  * Structure representing an URI supported by lttng.
  */
@@ -66,6 +80,7 @@ struct lttng_uri {
 	enum lttng_stream_type stype;
 	enum lttng_proto_type proto;
 	in_port_t port;
+	enum lttng_sock_profile profile;
 	char subdir[PATH_MAX];
 	union {
 		char ipv4[INET_ADDRSTRLEN];
@@ -40,6 +40,7 @@
 #include <common/compat/fcntl.h>
 #include <common/compat/endian.h>
 #include <common/consumer/consumer-metadata-cache.h>
+#include <common/consumer/consumer-snapshot.h>
 #include <common/consumer/consumer-stream.h>
 #include <common/consumer/consumer-timer.h>
 #include <common/utils.h>
@@ -194,7 +195,8 @@ error:
 }
 
 /*
- * Send the given stream pointer to the corresponding thread.
+ * Send the given stream pointer to the corresponding thread. A data stream is
+ * only queued to its thread, woken up by consumer_wakeup_data_shards().
  *
  * Returns 0 on success else a negative value.
  */
@@ -204,24 +206,28 @@ static int send_stream_to_thread(struct lttng_consumer_stream *stream,
 	int ret;
 	struct lttng_pipe *stream_pipe;
 
-	/* Get the right pipe where the stream will be sent. */
-	if (stream->metadata_flag) {
-		ret = consumer_add_metadata_stream(stream);
-		if (ret) {
-			ERR("Consumer add metadata stream %" PRIu64 " failed.",
-					stream->key);
-			goto error;
-		}
-		stream_pipe = ctx->consumer_metadata_pipe;
-	} else {
-		ret = consumer_add_data_stream(stream);
+	if (!stream->metadata_flag) {
+		ret = consumer_add_data_stream(stream, ctx);
 		if (ret) {
 			ERR("Consumer add stream %" PRIu64 " failed.",
 					stream->key);
-			goto error;
+			goto end;
 		}
-		stream_pipe = ctx->consumer_data_pipe;
+
+		/* Globally visible from now on, like a metadata stream below. */
+		stream->globally_visible = 1;
+		consumer_handover_data_stream(stream);
+		goto end;
+	}
+
+	/* Get the right pipe where the stream will be sent. */
+	ret = consumer_add_metadata_stream(stream, ctx);
+	if (ret) {
+		ERR("Consumer add metadata stream %" PRIu64 " failed.",
+				stream->key);
+		goto end;
 	}
+	stream_pipe = stream->metadata_shard->metadata_pipe;
 
 	/*
 	 * From this point on, the stream's ownership has been moved away from
@@ -231,16 +237,11 @@ static int send_stream_to_thread(struct lttng_consumer_stream *stream,
 
 	ret = lttng_pipe_write(stream_pipe, &stream, sizeof(stream));
 	if (ret < 0) {
-		ERR("Consumer write %s stream to pipe %d",
-				stream->metadata_flag ? "metadata" : "data",
+		ERR("Consumer write metadata stream to pipe %d",
 				lttng_pipe_get_writefd(stream_pipe));
-		if (stream->metadata_flag) {
-			consumer_del_stream_for_metadata(stream);
-		} else {
-			consumer_del_stream_for_data(stream);
-		}
+		consumer_del_stream_for_metadata(stream);
 	}
-error:
+end:
 	return ret;
 }
 
@@ -264,6 +265,122 @@ end:
 	return ret;
 }
 
+/*
+ * Return the size of the transparent huge pages or 0 if they are not
+ * supported.
+ */
+static unsigned long get_huge_page_size(void)
+{
+	FILE *fp;
+	unsigned long size = 0;
+
+	fp = fopen(DEFAULT_CONSUMERD_THP_SIZE_PATH, "r");
+	if (!fp) {
+		goto end;
+	}
+	if (fscanf(fp, "%lu", &size) != 1) {
+		size = 0;
+	}
+	fclose(fp);
+end:
+	return size;
+}
+
+/*
+ * Ask for the consumer's mapping of the ring buffer of a stream to be backed
+ * by huge pages. This is a hint, errors are ignored.
+ */
+static void advise_huge_pages(struct lttng_consumer_stream *stream)
+{
+#ifdef MADV_HUGEPAGE
+	int ret;
+	void *base;
+	unsigned long len;
+
+	base = ustctl_get_mmap_base(stream->ustream);
+	ret = ustctl_get_mmap_len(stream->ustream, &len);
+	if (!base || ret < 0) {
+		return;
+	}
+	ret = madvise(base, len, MADV_HUGEPAGE);
+	if (ret < 0) {
+		DBG("madvise MADV_HUGEPAGE of stream %s: %s", stream->name,
+				strerror(errno));
+	}
+#endif /* MADV_HUGEPAGE */
+}
+
+/*
+ * Fault in the beginning of the shm of a stream through a MADV_HUGEPAGE
+ * mapping so that it is backed by transparent huge pages. The tracer then
+ * lays its ring buffer over the pages already in the shm. Up to "size" bytes,
+ * rounded down to the huge page size, are faulted in.
+ *
+ * Return 0 on success or else a negative value, in which case the shm is
+ * left empty and regular pages are used.
+ */
+static int prefault_huge_pages(int shmfd, uint64_t size)
+{
+#ifdef MADV_HUGEPAGE
+	int ret;
+	char *map;
+	uint64_t offset;
+	unsigned long huge_page_size = get_huge_page_size();
+
+	if (!huge_page_size) {
+		DBG("Transparent huge pages are not supported");
+		goto error;
+	}
+	size -= size % huge_page_size;
+	if (!size) {
+		DBG("Ring buffer smaller than a huge page");
+		goto error;
+	}
+
+	ret = ftruncate(shmfd, size);
+	if (ret < 0) {
+		PERROR("ftruncate huge pages shm");
+		goto error;
+	}
+	map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, shmfd, 0);
+	if (map == MAP_FAILED) {
+		PERROR("mmap huge pages shm");
+		goto error_truncate;
+	}
+	ret = madvise(map, size, MADV_HUGEPAGE);
+	if (ret < 0) {
+		DBG("madvise MADV_HUGEPAGE: %s", strerror(errno));
+		(void) munmap(map, size);
+		goto error_truncate;
+	}
+	/* A single write fault allocates a whole huge page. */
+	for (offset = 0; offset < size; offset += huge_page_size) {
+		((volatile char *) map)[offset] = 0;
+	}
+	ret = munmap(map, size);
+	if (ret < 0) {
+		PERROR("munmap huge pages shm");
+	}
+	return 0;
+
+error_truncate:
+	ret = ftruncate(shmfd, 0);
+	if (ret < 0) {
+		PERROR("ftruncate huge pages shm");
+	}
+error:
+#endif /* MADV_HUGEPAGE */
+	return -1;
+}
+
+/* Do the actions of a stream once it has been received. */
+static int recv_stream_work(struct lttng_consumer_stream *stream, void *data)
+{
+	struct lttng_consumer_local_data *ctx = data;
+
+	return ctx->on_recv_stream(stream);
+}
+
 /*
  * Create streams for the given channel using liblttng-ust-ctl.
  *
@@ -335,12 +452,8 @@ static int create_ust_streams(struct lttng_consumer_channel *channel,
 			goto error;
 		}
 
-		/* Do actions once stream has been received. */
-		if (ctx->on_recv_stream) {
-			ret = ctx->on_recv_stream(stream);
-			if (ret < 0) {
-				goto error;
-			}
+		if (channel->huge_pages) {
+			advise_huge_pages(stream);
 		}
 
 		DBG("UST consumer add stream %s (key: %" PRIu64 ") with relayd id %" PRIu64,
@@ -361,6 +474,19 @@ static int create_ust_streams(struct lttng_consumer_channel *channel,
 		}
 	}
 
+	/*
+	 * Do actions once the streams have been created, which open their
+	 * output files, in parallel since it is the slow part of the setup on
+	 * machines with many CPUs.
+	 */
+	if (ctx->on_recv_stream) {
+		ret = consumer_channel_streams_run(channel,
+				consumer_data.setup_threads, recv_stream_work, ctx);
+		if (ret < 0) {
+			goto error;
+		}
+	}
+
 	return 0;
 
 error:
@@ -410,26 +536,81 @@ error_shm_open:
 	return -1;
 }
 
-static int open_ust_stream_fd(struct lttng_consumer_channel *channel,
-		struct ustctl_consumer_channel_attr *attr,
-		int cpu)
+static int prefault_ust_stream_fd(struct lttng_consumer_channel *channel,
+		struct ustctl_consumer_channel_attr *attr, int fd)
 {
-	char shm_path[PATH_MAX];
 	int ret;
 
-	if (!channel->shm_path[0]) {
-		return create_posix_shm();
+	if (fd < 0 || !channel->huge_pages ||
+			channel->type == CONSUMER_CHANNEL_TYPE_METADATA) {
+		return fd;
 	}
-	ret = get_stream_shm_path(shm_path, channel->shm_path, cpu);
-	if (ret) {
-		goto error_shm_path;
+
+	ret = prefault_huge_pages(fd, attr->subbuf_size * attr->num_subbuf);
+	if (ret < 0) {
+		DBG("Huge pages unavailable for channel %s, using regular pages",
+				channel->name);
 	}
-	return run_as_open(shm_path,
-		O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR,
-		channel->uid, channel->gid);
+	return fd;
+}
 
-error_shm_path:
-	return -1;
+/*
+ * Open the shm files of the streams of a channel in a single run_as batch.
+ *
+ * Return the number of files opened, in order, before the first failure.
+ */
+static int open_ust_stream_shm_fds(struct lttng_consumer_channel *channel,
+		struct ustctl_consumer_channel_attr *attr,
+		int *stream_fds, int nr_stream_fds)
+{
+	int i, j, ret;
+	char *paths;
+	struct run_as_batch_op *ops;
+
+	paths = zmalloc(nr_stream_fds * PATH_MAX);
+	ops = zmalloc(nr_stream_fds * sizeof(*ops));
+	if (!paths || !ops) {
+		i = 0;
+		goto end;
+	}
+	for (i = 0; i < nr_stream_fds; i++) {
+		ret = get_stream_shm_path(paths + i * PATH_MAX,
+				channel->shm_path, i);
+		if (ret) {
+			nr_stream_fds = i;
+			break;
+		}
+		ops[i].type = RUN_AS_BATCH_OPEN;
+		ops[i].path = paths + i * PATH_MAX;
+		ops[i].flags = O_RDWR | O_CREAT | O_EXCL;
+		ops[i].mode = S_IRUSR | S_IWUSR;
+	}
+	(void) run_as_batch(ops, nr_stream_fds, channel->uid, channel->gid);
+
+	for (i = 0; i < nr_stream_fds && ops[i].ret >= 0; i++) {
+		stream_fds[i] = prefault_ust_stream_fd(channel, attr,
+				ops[i].ret);
+	}
+	if (i < nr_stream_fds) {
+		errno = ops[i]._errno;
+		PERROR("open %s", ops[i].path);
+	}
+	/* Remove the files opened after the first failure. */
+	for (j = i + 1; j < nr_stream_fds; j++) {
+		if (ops[j].ret < 0) {
+			continue;
+		}
+		if (close(ops[j].ret)) {
+			PERROR("close");
+		}
+		if (run_as_unlink(ops[j].path, channel->uid, channel->gid)) {
+			PERROR("unlink %s", ops[j].path);
+		}
+	}
+end:
+	free(ops);
+	free(paths);
+	return i;
 }
 
 /*
@@ -466,12 +647,22 @@ static int create_ust_channel(struct lttng_consumer_channel *channel,
 		ret = -1;
 		goto error_alloc;
 	}
-	for (i = 0; i < nr_stream_fds; i++) {
-		stream_fds[i] = open_ust_stream_fd(channel, attr, i);
-		if (stream_fds[i] < 0) {
+	if (channel->shm_path[0]) {
+		i = open_ust_stream_shm_fds(channel, attr, stream_fds,
+				nr_stream_fds);
+		if (i < nr_stream_fds) {
 			ret = -1;
 			goto error_open;
 		}
+	} else {
+		for (i = 0; i < nr_stream_fds; i++) {
+			stream_fds[i] = prefault_ust_stream_fd(channel, attr,
+					create_posix_shm());
+			if (stream_fds[i] < 0) {
+				ret = -1;
+				goto error_open;
+			}
+		}
 	}
 	ust_channel = ustctl_create_channel(attr, stream_fds, nr_stream_fds);
 	if (!ust_channel) {
@@ -553,7 +744,6 @@ static int send_sessiond_channel(int sock,
 {
 	int ret, ret_code = LTTCOMM_CONSUMERD_SUCCESS;
 	struct lttng_consumer_stream *stream;
-	uint64_t net_seq_idx = -1ULL;
 
 	assert(channel);
 	assert(ctx);
@@ -562,25 +752,20 @@ static int send_sessiond_channel(int sock,
 	DBG("UST consumer sending channel %s to sessiond", channel->name);
 
 	if (channel->relayd_id != (uint64_t) -1ULL) {
-		cds_list_for_each_entry(stream, &channel->streams.head, send_node) {
-
-			health_code_update();
+		health_code_update();
 
-			/* Try to send the stream to the relayd if one is available. */
-			ret = consumer_send_relayd_stream(stream, stream->chan->pathname);
-			if (ret < 0) {
-				/*
-				 * Flag that the relayd was the problem here probably due to a
-				 * communicaton error on the socket.
-				 */
-				if (relayd_error) {
-					*relayd_error = 1;
-				}
-				ret_code = LTTCOMM_CONSUMERD_RELAYD_FAIL;
-			}
-			if (net_seq_idx == -1ULL) {
-				net_seq_idx = stream->net_seq_idx;
+		/* Try to send the streams to the relayd if one is available. */
+		ret = consumer_send_relayd_channel_streams(channel,
+				channel->pathname);
+		if (ret < 0) {
+			/*
+			 * Flag that the relayd was the problem here probably due to a
+			 * communicaton error on the socket.
+			 */
+			if (relayd_error) {
+				*relayd_error = 1;
 			}
+			ret_code = LTTCOMM_CONSUMERD_RELAYD_FAIL;
 		}
 	}
 
@@ -732,6 +917,10 @@ static int send_streams_to_thread(struct lttng_consumer_channel *channel,
 	}
 
 error:
+	/* A single wakeup for all the data streams of the channel. */
+	if (consumer_wakeup_data_shards(ctx) < 0 && !ret) {
+		ret = -1;
+	}
 	return ret;
 }
 
@@ -821,6 +1010,79 @@ error:
 	return ret;
 }
 
+/*
+ * Switch the local streams of the channels of a session to a new trace chunk,
+ * moving their output from under "old_root" to under "new_root".
+ *
+ * The data streams switch on their next packet. The metadata streams switch
+ * once their buffers are drained and then write the whole metadata cache in
+ * the new trace chunk, so they are woken up right away.
+ *
+ * Return 0 on success else an LTTng error code.
+ */
+static int rotate_session(uint64_t session_id, const char *old_root,
+		const char *new_root, struct lttng_consumer_local_data *ctx)
+{
+	int ret = 0;
+	struct lttng_consumer_channel *channel;
+	struct lttng_ht_iter iter;
+
+	DBG("UST consumer rotate session %" PRIu64 " from %s to %s",
+			session_id, old_root, new_root);
+
+	rcu_read_lock();
+	cds_lfht_for_each_entry(consumer_data.channel_ht->ht, &iter.iter,
+			channel, node.node) {
+		int rotate_ret, reload;
+
+		health_code_update();
+
+		if (channel->session_id != session_id) {
+			continue;
+		}
+		rotate_ret = consumer_rotate_channel(channel, old_root, new_root);
+		if (rotate_ret < 0) {
+			ret = LTTCOMM_CONSUMERD_FATAL;
+			goto end;
+		} else if (rotate_ret > 0) {
+			continue;
+		}
+
+		if (channel->type != CONSUMER_CHANNEL_TYPE_METADATA ||
+				!channel->metadata_cache) {
+			continue;
+		}
+		pthread_mutex_lock(&channel->metadata_cache->lock);
+		/*
+		 * The metadata stream commits the whole metadata again in the
+		 * new trace chunk: reload what was trimmed before it rotates.
+		 */
+		reload = channel->metadata_cache->trimmed_offset > 0;
+		if (reload) {
+			channel->metadata_cache->reload_pending = 1;
+		}
+		if (channel->metadata_stream &&
+				channel->metadata_stream->ust_metadata_poll_pipe[1] >= 0) {
+			char dummy = 'r';
+
+			if (lttng_write(channel->metadata_stream->ust_metadata_poll_pipe[1],
+					&dummy, 1) < 1) {
+				ERR("Wakeup UST metadata pipe");
+			}
+		}
+		pthread_mutex_unlock(&channel->metadata_cache->lock);
+
+		if (reload && lttng_ustconsumer_request_metadata(ctx, channel,
+				0, 0) < 0) {
+			ERR("Reloading the trimmed metadata of channel %" PRIu64,
+					channel->key);
+		}
+	}
+end:
+	rcu_read_unlock();
+	return ret;
+}
+
 /*
  * Close metadata stream wakeup_fd using the given key to retrieve the channel.
  * RCU read side lock MUST be acquired before calling this function.
@@ -1043,189 +1305,231 @@ error:
 	return ret;
 }
 
+/* Parameters of the snapshot of a channel, shared by its streams. */
+struct snapshot_channel_data {
+	char *path;
+	uint64_t relayd_id;
+	unsigned int use_relayd:1;
+	unsigned int incremental:1;
+	uint64_t output_id;
+	struct lttng_consumer_local_data *ctx;
+};
+
+static int get_index_values(struct ctf_packet_index *index,
+		struct ustctl_consumer_stream *ustream);
+
 /*
- * Take a snapshot of all the stream of a channel.
+ * Sample the positions of a stream for the planning of a snapshot.
  *
  * Returns 0 on success, < 0 on error
  */
-static int snapshot_channel(uint64_t key, char *path, uint64_t relayd_id,
-		uint64_t nb_packets_per_stream, struct lttng_consumer_local_data *ctx)
+static int sample_stream(struct lttng_consumer_stream *stream,
+		unsigned long *produced_pos, unsigned long *consumed_pos)
 {
 	int ret;
-	unsigned use_relayd = 0;
+
+	ret = lttng_ustconsumer_take_snapshot(stream);
+	if (ret < 0) {
+		goto end;
+	}
+	ret = lttng_ustconsumer_get_produced_snapshot(stream, produced_pos);
+	if (ret < 0) {
+		goto end;
+	}
+	ret = lttng_ustconsumer_get_consumed_snapshot(stream, consumed_pos);
+end:
+	return ret;
+}
+
+/*
+ * Take a snapshot of a stream of a channel.
+ *
+ * Returns 0 on success, < 0 on error
+ */
+static int snapshot_stream(struct lttng_consumer_stream *stream, void *data,
+		uint64_t *lost_packets)
+{
+	int ret, write_index;
+	/* Are we at a position _before_ the first available packet ? */
+	bool before_first_packet = true;
 	unsigned long consumed_pos, produced_pos;
-	struct lttng_consumer_channel *channel;
-	struct lttng_consumer_stream *stream;
+	struct snapshot_channel_data *snapshot = data;
+	struct ctf_packet_index index;
 
-	assert(path);
-	assert(ctx);
+	health_code_update();
 
-	rcu_read_lock();
+	/* Lock stream because we are about to change its state. */
+	pthread_mutex_lock(&stream->lock);
+	/*
+	 * The streams were added on the relayd by
+	 * consumer_snapshot_send_relayd_streams().
+	 */
+	stream->net_seq_idx = snapshot->relayd_id;
 
-	if (relayd_id != (uint64_t) -1ULL) {
-		use_relayd = 1;
+	if (!snapshot->use_relayd) {
+		ret = utils_create_stream_file(snapshot->path, stream->name,
+				stream->chan->tracefile_size,
+				stream->tracefile_count_current,
+				stream->uid, stream->gid, NULL);
+		if (ret < 0) {
+			goto error_unlock;
+		}
+		stream->out_fd = ret;
+		stream->tracefile_size_current = 0;
+		consumer_stream_setup_output_file(stream);
+
+		DBG("UST consumer snapshot stream %s/%s (%" PRIu64 ")",
+				snapshot->path, stream->name, stream->key);
 	}
 
-	channel = consumer_find_channel(key);
-	if (!channel) {
-		ERR("UST snapshot channel not found for key %" PRIu64, key);
-		ret = -1;
-		goto error;
+	/* Indexed so that the viewers seek in the snapshot without a scan. */
+	ret = consumer_stream_open_snapshot_index(stream, snapshot->path);
+	if (ret < 0) {
+		goto error_close_stream;
 	}
-	assert(!channel->monitor);
-	DBG("UST consumer snapshot channel %" PRIu64, key);
+	write_index = ret;
 
-	cds_list_for_each_entry(stream, &channel->streams.head, send_node) {
-		/* Are we at a position _before_ the first available packet ? */
-		bool before_first_packet = true;
+	/*
+	 * If tracing is active, we want to perform a "full" buffer flush.
+	 * Else, if quiescent, it has already been done by the prior stop.
+	 */
+	if (!stream->quiescent) {
+		ustctl_flush_buffer(stream->ustream, 0);
+	}
 
-		health_code_update();
+	ret = lttng_ustconsumer_take_snapshot(stream);
+	if (ret < 0) {
+		ERR("Taking UST snapshot");
+		goto error_unlock;
+	}
 
-		/* Lock stream because we are about to change its state. */
-		pthread_mutex_lock(&stream->lock);
-		stream->net_seq_idx = relayd_id;
+	ret = lttng_ustconsumer_get_produced_snapshot(stream, &produced_pos);
+	if (ret < 0) {
+		ERR("Produced UST snapshot position");
+		goto error_unlock;
+	}
 
-		if (use_relayd) {
-			ret = consumer_send_relayd_stream(stream, path);
-			if (ret < 0) {
-				goto error_unlock;
-			}
-		} else {
-			ret = utils_create_stream_file(path, stream->name,
-					stream->chan->tracefile_size,
-					stream->tracefile_count_current,
-					stream->uid, stream->gid, NULL);
-			if (ret < 0) {
-				goto error_unlock;
-			}
-			stream->out_fd = ret;
-			stream->tracefile_size_current = 0;
+	ret = lttng_ustconsumer_get_consumed_snapshot(stream, &consumed_pos);
+	if (ret < 0) {
+		ERR("Consumerd UST snapshot position");
+		goto error_unlock;
+	}
 
-			DBG("UST consumer snapshot stream %s/%s (%" PRIu64 ")", path,
-					stream->name, stream->key);
-		}
-		if (relayd_id != -1ULL) {
-			ret = consumer_send_relayd_streams_sent(relayd_id);
-			if (ret < 0) {
-				goto error_unlock;
-			}
-		}
+	/*
+	 * The original value is sent back if max stream size is larger than
+	 * the possible size of the snapshot. Also, we assume that the session
+	 * daemon should never send a maximum stream size that is lower than
+	 * subbuffer size.
+	 */
+	consumed_pos = consumer_get_consume_start_pos(consumed_pos,
+			produced_pos, stream->snapshot_nb_packets,
+			stream->max_sb_size);
+	if (snapshot->incremental) {
+		consumed_pos = consumer_get_incremental_start_pos(stream,
+				consumed_pos, snapshot->output_id);
+	}
 
-		/*
-		 * If tracing is active, we want to perform a "full" buffer flush.
-		 * Else, if quiescent, it has already been done by the prior stop.
-		 */
-		if (!stream->quiescent) {
-			ustctl_flush_buffer(stream->ustream, 0);
-		}
+	while (consumed_pos < produced_pos) {
+		ssize_t read_len;
+		unsigned long len, padded_len;
+		int lost_packet = 0;
+
+		health_code_update();
 
-		ret = lttng_ustconsumer_take_snapshot(stream);
+		DBG("UST consumer taking snapshot at pos %lu", consumed_pos);
+
+		ret = ustctl_get_subbuf(stream->ustream, &consumed_pos);
 		if (ret < 0) {
-			ERR("Taking UST snapshot");
-			goto error_unlock;
+			if (ret != -EAGAIN) {
+				PERROR("ustctl_get_subbuf snapshot");
+				goto error_close_stream;
+			}
+			DBG("UST consumer get subbuf failed. Skipping it.");
+			consumed_pos += stream->max_sb_size;
+
+			/*
+			 * Start accounting lost packets only when we
+			 * already have extracted packets (to match the
+			 * content of the final snapshot).
+			 */
+			if (!before_first_packet) {
+				lost_packet = 1;
+			}
+			continue;
 		}
 
-		ret = lttng_ustconsumer_get_produced_snapshot(stream, &produced_pos);
+		ret = ustctl_get_subbuf_size(stream->ustream, &len);
 		if (ret < 0) {
-			ERR("Produced UST snapshot position");
-			goto error_unlock;
+			ERR("Snapshot ustctl_get_subbuf_size");
+			goto error_put_subbuf;
 		}
 
-		ret = lttng_ustconsumer_get_consumed_snapshot(stream, &consumed_pos);
+		ret = ustctl_get_padded_subbuf_size(stream->ustream, &padded_len);
 		if (ret < 0) {
-			ERR("Consumerd UST snapshot position");
-			goto error_unlock;
+			ERR("Snapshot ustctl_get_padded_subbuf_size");
+			goto error_put_subbuf;
 		}
 
-		/*
-		 * The original value is sent back if max stream size is larger than
-		 * the possible size of the snapshot. Also, we assume that the session
-		 * daemon should never send a maximum stream size that is lower than
-		 * subbuffer size.
-		 */
-		consumed_pos = consumer_get_consume_start_pos(consumed_pos,
-				produced_pos, nb_packets_per_stream,
-				stream->max_sb_size);
-
-		while (consumed_pos < produced_pos) {
-			ssize_t read_len;
-			unsigned long len, padded_len;
-			int lost_packet = 0;
-
-			health_code_update();
-
-			DBG("UST consumer taking snapshot at pos %lu", consumed_pos);
-
-			ret = ustctl_get_subbuf(stream->ustream, &consumed_pos);
+		if (write_index) {
+			index.offset = htobe64(stream->out_fd_offset);
+			ret = get_index_values(&index, stream->ustream);
 			if (ret < 0) {
-				if (ret != -EAGAIN) {
-					PERROR("ustctl_get_subbuf snapshot");
-					goto error_close_stream;
-				}
-				DBG("UST consumer get subbuf failed. Skipping it.");
-				consumed_pos += stream->max_sb_size;
-
-				/*
-				 * Start accounting lost packets only when we
-				 * already have extracted packets (to match the
-				 * content of the final snapshot).
-				 */
-				if (!before_first_packet) {
-					lost_packet = 1;
-				}
-				continue;
+				goto error_put_subbuf;
 			}
+		}
 
-			ret = ustctl_get_subbuf_size(stream->ustream, &len);
-			if (ret < 0) {
-				ERR("Snapshot ustctl_get_subbuf_size");
+		read_len = lttng_consumer_on_read_subbuffer_mmap(snapshot->ctx,
+				stream, len, padded_len - len,
+				write_index ? &index : NULL);
+		if (snapshot->use_relayd) {
+			if (read_len != len) {
+				ret = -EPERM;
 				goto error_put_subbuf;
 			}
-
-			ret = ustctl_get_padded_subbuf_size(stream->ustream, &padded_len);
-			if (ret < 0) {
-				ERR("Snapshot ustctl_get_padded_subbuf_size");
+		} else {
+			if (read_len != padded_len) {
+				ret = -EPERM;
 				goto error_put_subbuf;
 			}
+		}
 
-			read_len = lttng_consumer_on_read_subbuffer_mmap(ctx, stream, len,
-					padded_len - len, NULL);
-			if (use_relayd) {
-				if (read_len != len) {
-					ret = -EPERM;
-					goto error_put_subbuf;
-				}
-			} else {
-				if (read_len != padded_len) {
-					ret = -EPERM;
-					goto error_put_subbuf;
-				}
-			}
+		ret = ustctl_put_subbuf(stream->ustream);
+		if (ret < 0) {
+			ERR("Snapshot ustctl_put_subbuf");
+			goto error_close_stream;
+		}
+		consumed_pos += stream->max_sb_size;
 
-			ret = ustctl_put_subbuf(stream->ustream);
+		if (write_index) {
+			ret = consumer_stream_write_index(stream, &index);
 			if (ret < 0) {
-				ERR("Snapshot ustctl_put_subbuf");
 				goto error_close_stream;
 			}
-			consumed_pos += stream->max_sb_size;
-
-			/*
-			 * Only account lost packets located between
-			 * succesfully extracted packets (do not account before
-			 * and after since they are not visible in the
-			 * resulting snapshot).
-			 */
-			stream->chan->lost_packets += lost_packet;
-			lost_packet = 0;
-			before_first_packet = false;
 		}
 
-		/* Simply close the stream so we can use it on the next snapshot. */
-		consumer_stream_close(stream);
-		pthread_mutex_unlock(&stream->lock);
+		/*
+		 * Only account lost packets located between
+		 * succesfully extracted packets (do not account before
+		 * and after since they are not visible in the
+		 * resulting snapshot).
+		 */
+		*lost_packets += lost_packet;
+		lost_packet = 0;
+		before_first_packet = false;
 	}
 
-	rcu_read_unlock();
+	consumer_set_last_snapshot_pos(stream, snapshot->output_id,
+			produced_pos);
+
+	/*
+	 * Simply close the stream so we can use it on the next snapshot. It
+	 * is closed on the relayd with the other streams of the channel.
+	 */
+	if (snapshot->use_relayd) {
+		stream->net_seq_idx = (uint64_t) -1ULL;
+	}
+	consumer_stream_close(stream);
+	pthread_mutex_unlock(&stream->lock);
 	return 0;
 
 error_put_subbuf:
@@ -1236,6 +1540,60 @@ error_close_stream:
 	consumer_stream_close(stream);
 error_unlock:
 	pthread_mutex_unlock(&stream->lock);
+	return ret;
+}
+
+/*
+ * Take a snapshot of all the stream of a channel.
+ *
+ * Returns 0 on success, < 0 on error
+ */
+static int snapshot_channel(uint64_t key, char *path, uint64_t relayd_id,
+		uint64_t nb_packets_per_stream, int incremental, uint64_t output_id,
+		struct lttng_consumer_local_data *ctx)
+{
+	int ret;
+	struct lttng_consumer_channel *channel;
+	struct snapshot_channel_data snapshot = {
+		.path = path,
+		.relayd_id = relayd_id,
+		.incremental = !!incremental,
+		.output_id = output_id,
+		.ctx = ctx,
+	};
+
+	assert(path);
+	assert(ctx);
+
+	rcu_read_lock();
+
+	if (relayd_id != (uint64_t) -1ULL) {
+		snapshot.use_relayd = 1;
+	}
+
+	channel = consumer_find_channel(key);
+	if (!channel) {
+		ERR("UST snapshot channel not found for key %" PRIu64, key);
+		ret = -1;
+		goto error;
+	}
+	assert(!channel->monitor);
+	DBG("UST consumer snapshot channel %" PRIu64, key);
+
+	consumer_snapshot_plan_streams(channel, nb_packets_per_stream,
+			snapshot.incremental, output_id, sample_stream);
+	if (snapshot.use_relayd) {
+		ret = consumer_snapshot_send_relayd_streams(channel, path,
+				relayd_id);
+		if (ret < 0) {
+			goto error;
+		}
+	}
+	ret = consumer_snapshot_streams(channel, snapshot_stream, &snapshot);
+	if (snapshot.use_relayd) {
+		consumer_close_relayd_channel_streams(channel, relayd_id);
+	}
+
 error:
 	rcu_read_unlock();
 	return ret;
@@ -1422,6 +1780,7 @@ int lttng_ustconsumer_recv_cmd(struct lttng_consumer_local_data *ctx,
 	{
 		int ret;
 		struct ustctl_consumer_channel_attr attr;
+		unsigned int switch_timer_interval = 0;
 
 		/* Create a plain object and reserve a channel key. */
 		channel = allocate_channel(msg.u.ask_channel.session_id,
@@ -1446,6 +1805,9 @@ int lttng_ustconsumer_recv_cmd(struct lttng_consumer_local_data *ctx,
 		 * allocation.
 		 */
 		channel->ust_app_uid = msg.u.ask_channel.ust_app_uid;
+		channel->compression = msg.u.ask_channel.compression;
+		channel->huge_pages = msg.u.ask_channel.huge_pages;
+		channel->num_subbuf = msg.u.ask_channel.num_subbuf;
 
 		/* Build channel attributes from received message. */
 		attr.subbuf_size = msg.u.ask_channel.subbuf_size;
@@ -1488,6 +1850,13 @@ int lttng_ustconsumer_recv_cmd(struct lttng_consumer_local_data *ctx,
 
 		health_code_update();
 
+		if (channel->type == CONSUMER_CHANNEL_TYPE_DATA &&
+				consumer_data.switch_skip_max) {
+			/* The consumer runs the load-aware switch timer instead. */
+			switch_timer_interval = attr.switch_timer_interval;
+			attr.switch_timer_interval = 0;
+		}
+
 		ret = ask_channel(ctx, sock, channel, &attr);
 		if (ret < 0) {
 			goto end_channel_error;
@@ -1504,6 +1873,7 @@ int lttng_ustconsumer_recv_cmd(struct lttng_consumer_local_data *ctx,
 		} else {
 			int monitor_start_ret;
 
+			consumer_timer_switch_start(channel, switch_timer_interval);
 			consumer_timer_live_start(channel,
 					msg.u.ask_channel.live_timer_interval);
 			monitor_start_ret = consumer_timer_monitor_start(
@@ -1526,10 +1896,10 @@ int lttng_ustconsumer_recv_cmd(struct lttng_consumer_local_data *ctx,
 		 */
 		ret = add_channel(channel, ctx);
 		if (ret < 0) {
+			if (channel->switch_timer_enabled == 1) {
+				consumer_timer_switch_stop(channel);
+			}
 			if (msg.u.ask_channel.type == LTTNG_UST_CHAN_METADATA) {
-				if (channel->switch_timer_enabled == 1) {
-					consumer_timer_switch_stop(channel);
-				}
 				consumer_metadata_cache_destroy(channel);
 			}
 			if (channel->live_timer_enabled == 1) {
@@ -1660,6 +2030,23 @@ int lttng_ustconsumer_recv_cmd(struct lttng_consumer_local_data *ctx,
 
 		goto end_msg_sessiond;
 	}
+	case LTTNG_CONSUMER_ROTATE_SESSION:
+	{
+		int ret;
+
+		msg.u.rotate_session.old_root[
+				sizeof(msg.u.rotate_session.old_root) - 1] = '\0';
+		msg.u.rotate_session.new_root[
+				sizeof(msg.u.rotate_session.new_root) - 1] = '\0';
+		ret = rotate_session(msg.u.rotate_session.session_id,
+				msg.u.rotate_session.old_root,
+				msg.u.rotate_session.new_root, ctx);
+		if (ret != 0) {
+			ret_code = ret;
+		}
+
+		goto end_msg_sessiond;
+	}
 	case LTTNG_CONSUMER_PUSH_METADATA:
 	{
 		int ret;
@@ -1752,6 +2139,8 @@ int lttng_ustconsumer_recv_cmd(struct lttng_consumer_local_data *ctx,
 					msg.u.snapshot_channel.pathname,
 					msg.u.snapshot_channel.relayd_id,
 					msg.u.snapshot_channel.nb_packets_per_stream,
+					msg.u.snapshot_channel.incremental,
+					msg.u.snapshot_channel.output_id,
 					ctx);
 			if (ret < 0) {
 				ERR("Snapshot channel failed");
@@ -1781,7 +2170,6 @@ int lttng_ustconsumer_recv_cmd(struct lttng_consumer_local_data *ctx,
 		DBG("UST consumer discarded events command for session id %"
 				PRIu64, id);
 		rcu_read_lock();
-		pthread_mutex_lock(&consumer_data.lock);
 
 		ht = consumer_data.stream_list_ht;
 
@@ -1802,7 +2190,6 @@ int lttng_ustconsumer_recv_cmd(struct lttng_consumer_local_data *ctx,
 				break;
 			}
 		}
-		pthread_mutex_unlock(&consumer_data.lock);
 		rcu_read_unlock();
 
 		DBG("UST consumer discarded events command for session id %"
@@ -1832,7 +2219,6 @@ int lttng_ustconsumer_recv_cmd(struct lttng_consumer_local_data *ctx,
 		DBG("UST consumer lost packets command for session id %"
 				PRIu64, id);
 		rcu_read_lock();
-		pthread_mutex_lock(&consumer_data.lock);
 
 		ht = consumer_data.stream_list_ht;
 
@@ -1852,7 +2238,6 @@ int lttng_ustconsumer_recv_cmd(struct lttng_consumer_local_data *ctx,
 				break;
 			}
 		}
-		pthread_mutex_unlock(&consumer_data.lock);
 		rcu_read_unlock();
 
 		DBG("UST consumer lost packets command for session id %"
@@ -1870,6 +2255,63 @@ int lttng_ustconsumer_recv_cmd(struct lttng_consumer_local_data *ctx,
 
 		break;
 	}
+	case LTTNG_CONSUMER_STREAM_STATS:
+	{
+		uint64_t key = msg.u.stream_stats.channel_key;
+
+		DBG("UST consumer stream stats command for channel key %" PRIu64,
+				key);
+
+		health_code_update();
+
+		/* Send back the statistics to the session daemon */
+		ret = lttng_consumer_send_stream_stats(sock, key);
+		if (ret < 0) {
+			PERROR("send stream stats");
+			goto error_fatal;
+		}
+
+		break;
+	}
+	case LTTNG_CONSUMER_CHANNEL_STATS:
+	{
+		uint64_t id = msg.u.channel_stats.session_id;
+
+		DBG("UST consumer channel stats command for session id %" PRIu64,
+				id);
+
+		health_code_update();
+
+		/* Send back the statistics to the session daemon */
+		ret = lttng_consumer_send_channel_stats(sock, id);
+		if (ret < 0) {
+			PERROR("send channel stats");
+			goto error_fatal;
+		}
+
+		break;
+	}
+	case LTTNG_CONSUMER_SET_CHANNEL_MONITOR_FILTER:
+	{
+		int ret;
+
+		ret = consumer_set_channel_monitor_filter(
+				msg.u.channel_monitor_filter.key,
+				msg.u.channel_monitor_filter.forward_all,
+				msg.u.channel_monitor_filter.thresholds,
+				msg.u.channel_monitor_filter.nr_thresholds);
+		if (ret != 0) {
+			ret_code = ret;
+		}
+
+		goto end_msg_sessiond;
+	}
+	case LTTNG_CONSUMER_SET_OVERLOAD_SHEDDING:
+	{
+		consumer_set_overload_shedding(ctx,
+				!!msg.u.overload_shedding.enable);
+		goto end_msg_sessiond;
+	}
 	case LTTNG_CONSUMER_SET_CHANNEL_MONITOR_PIPE:
 	{
 		int channel_monitor_pipe;
@@ -2150,7 +2592,11 @@ void lttng_ustconsumer_del_stream(struct lttng_consumer_stream *stream)
 	assert(stream);
 	assert(stream->ustream);
 
-	if (stream->chan->switch_timer_enabled == 1) {
+	/*
+	 * The switch timer of a data channel skips the deleted streams; it is
+	 * stopped with the channel.
+	 */
+	if (stream->metadata_flag && stream->chan->switch_timer_enabled == 1) {
 		consumer_timer_switch_stop(stream->chan);
 	}
 	ustctl_destroy_stream(stream->ustream);
@@ -2238,6 +2684,18 @@ static int get_index_values(struct ctf_packet_index *index,
 	}
 	index->packet_seq_num = htobe64(index->packet_seq_num);
 
+#ifdef HAVE_USTCTL_GET_EVENTS_COUNT
+	ret = ustctl_get_events_count(ustream, &index->events_count);
+	if (ret < 0) {
+		PERROR("ustctl_get_events_count");
+		goto error;
+	}
+#else
+	/* Not provided by this lttng-ust. */
+	index->events_count = -1ULL;
+#endif
+	index->events_count = htobe64(index->events_count);
+
 error:
 	return ret;
 }
@@ -2275,43 +2733,99 @@ end:
 }
 
 /*
- * Write up to one packet from the metadata cache to the channel.
+ * Return the maximum number of packets committed at once from the metadata
+ * cache to the channel of a metadata stream: all the sub-buffers but the one
+ * which may still be held by the reader.
+ */
+static
+unsigned int metadata_commit_batch(struct lttng_consumer_stream *stream)
+{
+	if (stream->chan->num_subbuf <= 1) {
+		return 1;
+	}
+	return (unsigned int) min_t(uint64_t, stream->chan->num_subbuf - 1,
+			UINT_MAX);
+}
+
+/*
+ * Write up to max_packets packets from the metadata cache to the channel. The
+ * metadata cache lock is taken once for the whole batch.
+ *
+ * The batch stops early once the cache is entirely pushed or, after at least
+ * one packet was written, when the channel has no room left for a packet: the
+ * rest is committed once the reader has consumed the packets written.
  *
  * Returns the number of bytes pushed in the cache, or a negative value
  * on error.
  */
 static
-int commit_one_metadata_packet(struct lttng_consumer_stream *stream)
+int commit_metadata_packets(struct lttng_consumer_stream *stream,
+		unsigned int max_packets)
 {
 	ssize_t write_len;
 	int ret;
+	const char *metadata;
+	size_t len;
+	unsigned int nb_packets;
+	int pushed = 0;
 
 	pthread_mutex_lock(&stream->chan->metadata_cache->lock);
 	ret = metadata_stream_check_version(stream);
 	if (ret < 0) {
 		goto end;
 	}
-	if (stream->chan->metadata_cache->max_offset
-			== stream->ust_metadata_pushed) {
-		ret = 0;
-		goto end;
-	}
 
-	write_len = ustctl_write_one_packet_to_channel(stream->chan->uchan,
-			&stream->chan->metadata_cache->data[stream->ust_metadata_pushed],
-			stream->chan->metadata_cache->max_offset
-			- stream->ust_metadata_pushed);
-	assert(write_len != 0);
-	if (write_len < 0) {
-		ERR("Writing one metadata packet");
+	if (stream->ust_metadata_pushed <
+			stream->chan->metadata_cache->trimmed_offset) {
+		ERR("Metadata of stream %" PRIu64 " from offset %" PRIu64
+				" was trimmed and not reloaded",
+				stream->key, stream->ust_metadata_pushed);
 		ret = -1;
 		goto end;
 	}
-	stream->ust_metadata_pushed += write_len;
 
-	assert(stream->chan->metadata_cache->max_offset >=
-			stream->ust_metadata_pushed);
-	ret = write_len;
+	for (nb_packets = 0; nb_packets < max_packets; nb_packets++) {
+		if (stream->chan->metadata_cache->max_offset
+				== stream->ust_metadata_pushed) {
+			break;
+		}
+
+		metadata = consumer_metadata_cache_read(
+				stream->chan->metadata_cache,
+				stream->ust_metadata_pushed, stream->max_sb_size,
+				&len);
+		if (!metadata) {
+			ret = -1;
+			goto end;
+		}
+		write_len = ustctl_write_one_packet_to_channel(
+				stream->chan->uchan, metadata, len);
+		assert(write_len != 0);
+		if (write_len < 0) {
+			if (pushed) {
+				/* The channel is full, commit the rest later. */
+				break;
+			}
+			ERR("Writing one metadata packet");
+			ret = -1;
+			goto end;
+		}
+		stream->ust_metadata_pushed += write_len;
+		pushed += write_len;
+
+		assert(stream->chan->metadata_cache->max_offset >=
+				stream->ust_metadata_pushed);
+	}
+	if (nb_packets > 1) {
+		DBG3("Committed %u metadata packets (%d bytes) of stream %" PRIu64,
+				nb_packets, pushed, stream->key);
+	}
+	/* A pending rotation commits the whole metadata again. */
+	if (!stream->rotate_path) {
+		consumer_metadata_cache_trim(stream->chan,
+				stream->ust_metadata_pushed);
+	}
+	ret = pushed;
 
 end:
 	pthread_mutex_unlock(&stream->chan->metadata_cache->lock);
@@ -2319,6 +2833,34 @@ end:
 }
 
 
+/*
+ * Switch a drained local metadata stream to the trace chunk of its pending
+ * rotation. The whole metadata cache is then pushed again, so that the trace
+ * chunk is self-contained.
+ *
+ * The stream lock MUST be acquired.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static
+int rotate_metadata_stream(struct lttng_consumer_stream *stream)
+{
+	int ret;
+
+	ret = consumer_stream_rotate_chunk(stream);
+	if (ret < 0) {
+		ERR("Rotating metadata stream %" PRIu64 " to a new trace chunk",
+				stream->key);
+		goto end;
+	}
+
+	pthread_mutex_lock(&stream->chan->metadata_cache->lock);
+	stream->ust_metadata_pushed = 0;
+	pthread_mutex_unlock(&stream->chan->metadata_cache->lock);
+end:
+	return ret;
+}
+
 /*
  * Sync metadata meaning request them to the session daemon and snapshot to the
  * metadata thread can consumer them.
@@ -2350,7 +2892,7 @@ int lttng_ustconsumer_sync_metadata(struct lttng_consumer_local_data *ctx,
 		goto end;
 	}
 
-	ret = commit_one_metadata_packet(metadata);
+	ret = commit_metadata_packets(metadata, metadata_commit_batch(metadata));
 	if (ret <= 0) {
 		goto end;
 	} else if (ret > 0) {
@@ -2414,17 +2956,19 @@ static int notify_if_more_data(struct lttng_consumer_stream *stream,
 	/* This stream still has data. Flag it and wake up the data thread. */
 	stream->has_data = 1;
 
-	if (stream->monitor && !stream->hangup_flush_done && !ctx->has_wakeup) {
+	if (stream->monitor && !stream->hangup_flush_done &&
+			!stream->data_shard->has_wakeup) {
 		ssize_t writelen;
 
-		writelen = lttng_pipe_write(ctx->consumer_wakeup_pipe, "!", 1);
+		writelen = lttng_pipe_write(stream->data_shard->wakeup_pipe,
+				"!", 1);
 		if (writelen < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
 			ret = writelen;
 			goto end;
 		}
 
-		/* The wake up pipe has been notified. */
-		ctx->has_wakeup = 1;
+		/* The wake up pipe of the stream's shard has been notified. */
+		stream->data_shard->has_wakeup = 1;
 	}
 	ret = 0;
 
@@ -2498,7 +3042,7 @@ int lttng_ustconsumer_read_subbuffer(struct lttng_consumer_stream *stream,
 		struct lttng_consumer_local_data *ctx)
 {
 	unsigned long len, subbuf_size, padding;
-	int err, write_index = 1;
+	int err, write_index = 1, rotate_flushed = 0;
 	long ret = 0;
 	struct ustctl_consumer_stream *ustream;
 	struct ctf_packet_index index;
@@ -2540,10 +3084,25 @@ retry:
 	if (err != 0) {
 		/*
 		 * Populate metadata info if the existing info has
-		 * already been read.
+		 * already been read. As the reader holds no sub-buffer, a batch
+		 * of packets fills the channel so that they are all consumed on
+		 * this wakeup.
 		 */
 		if (stream->metadata_flag) {
-			ret = commit_one_metadata_packet(stream);
+			if (stream->rotate_path) {
+				if (!rotate_flushed) {
+					/* Consume what is left for the current chunk. */
+					ustctl_flush_buffer(stream->ustream, 1);
+					rotate_flushed = 1;
+					goto retry;
+				}
+				ret = rotate_metadata_stream(stream);
+				if (ret < 0) {
+					goto end;
+				}
+			}
+			ret = commit_metadata_packets(stream,
+					metadata_commit_batch(stream));
 			if (ret <= 0) {
 				goto end;
 			}
@@ -2562,7 +3121,8 @@ retry:
 				"it is due to concurrency) [ret: %d]", err);
 		goto end;
 	}
-	assert(stream->chan->output == CONSUMER_CHANNEL_MMAP);
+	assert(stream->chan->output == CONSUMER_CHANNEL_MMAP ||
+			stream->chan->output == CONSUMER_CHANNEL_MMAP_URING);
 
 	if (!stream->metadata_flag) {
 		index.offset = htobe64(stream->out_fd_offset);
@@ -2694,6 +3254,8 @@ int lttng_ustconsumer_on_recv_stream(struct lttng_consumer_stream *stream)
 		}
 		stream->out_fd = ret;
 		stream->tracefile_size_current = 0;
+		consumer_stream_setup_output_file(stream);
+		consumer_stream_open_output_dir(stream);
 
 		if (!stream->metadata_flag) {
 			struct lttng_index_file *index_file;
@@ -2718,8 +3280,7 @@ error:
 
 /*
  * Check if data is still being extracted from the buffers for a specific
- * stream. Consumer data lock MUST be acquired before calling this function
- * and the stream lock.
+ * stream. The stream lock MUST be acquired before calling this function.
  *
  * Return 1 if the traced data are still getting read else 0 meaning that the
  * data is available for trace viewer reading.
@@ -2912,6 +3473,9 @@ int lttng_ustconsumer_request_metadata(struct lttng_consumer_local_data *ctx,
 	 */
 	request.uid = channel->ust_app_uid;
 	request.key = channel->key;
+	pthread_mutex_lock(&channel->metadata_cache->lock);
+	request.reload = channel->metadata_cache->reload_pending;
+	pthread_mutex_unlock(&channel->metadata_cache->lock);
 
 	DBG("Sending metadata request to sessiond, session id %" PRIu64
 			", per-pid %" PRIu64 ", app UID %u and channek key %" PRIu64,
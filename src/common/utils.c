@@ -37,6 +37,7 @@
 #include <common/compat/getenv.h>
 #include <common/compat/string.h>
 #include <common/compat/dirent.h>
+#include <common/stripe.h>
 #include <lttng/constant.h>
 
 #include "utils.h"
@@ -708,11 +709,13 @@ int utils_mkdir_recursive(const char *path, mode_t mode, int uid, int gid)
 }
 
 /*
- * path is the output parameter. It needs to be PATH_MAX len.
+ * path is the output parameter. It needs to be PATH_MAX len. A NULL path_name
+ * gives the name of the file relative to its directory.
  *
  * Return 0 on success or else a negative value.
  */
-static int utils_stream_file_name(char *path,
+LTTNG_HIDDEN
+int utils_stream_file_name(char *path,
 		const char *path_name, const char *file_name,
 		uint64_t size, uint64_t count,
 		const char *suffix)
@@ -722,8 +725,12 @@ static int utils_stream_file_name(char *path,
 	char *path_name_suffix = NULL;
 	char *extra = NULL;
 
-	ret = snprintf(full_path, sizeof(full_path), "%s/%s",
-			path_name, file_name);
+	if (path_name) {
+		ret = snprintf(full_path, sizeof(full_path), "%s/%s",
+				path_name, file_name);
+	} else {
+		ret = snprintf(full_path, sizeof(full_path), "%s", file_name);
+	}
 	if (ret < 0) {
 		PERROR("snprintf create output file");
 		goto error;
@@ -768,57 +775,132 @@ error:
 }
 
 /*
- * Create the stream file on disk.
+ * Open the output directory of a stream, relative to which its files can be
+ * created, unlinked and rotated without resolving the directory again.
  *
- * Return 0 on success or else a negative value.
+ * Return the directory file descriptor or else a negative value.
  */
 LTTNG_HIDDEN
-int utils_create_stream_file(const char *path_name, char *file_name, uint64_t size,
-		uint64_t count, int uid, int gid, char *suffix)
+int utils_open_stream_dir(const char *path_name, int uid, int gid)
 {
-	int ret, flags, mode;
-	char path[PATH_MAX];
+	int ret, flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
 
-	ret = utils_stream_file_name(path, path_name, file_name,
-			size, count, suffix);
+	if (uid < 0 || gid < 0) {
+		ret = open(path_name, flags);
+	} else {
+		ret = run_as_open(path_name, flags, 0, uid, gid);
+	}
 	if (ret < 0) {
-		goto error;
+		PERROR("open stream directory %s", path_name);
 	}
+	return ret;
+}
+
+/*
+ * Create the stream file on disk, relative to the directory dir_fd when it is
+ * not negative. path_name is then only used in the messages and to link the
+ * striped tracefiles, which are created under a stripe root (see stripe.h).
+ *
+ * Return 0 on success or else a negative value.
+ */
+LTTNG_HIDDEN
+int utils_create_stream_file_at(int dir_fd, const char *path_name,
+		char *file_name, uint64_t size, uint64_t count, int uid,
+		int gid, char *suffix)
+{
+	int ret, flags, mode;
+	char path[PATH_MAX];
 
 	flags = O_WRONLY | O_CREAT | O_TRUNC;
 	/* Open with 660 mode */
 	mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP;
 
-	if (uid < 0 || gid < 0) {
+	if (stripe_tracefile(file_name, suffix) && path_name &&
+			*path_name == '/') {
+		/* The striped files are linked by their absolute path. */
+		ret = utils_stream_file_name(path, path_name, file_name, size,
+				count, suffix);
+		if (ret < 0) {
+			goto error;
+		}
+		ret = stripe_create_file(path, flags, mode, uid, gid);
+		goto error;
+	}
+
+	ret = utils_stream_file_name(path, dir_fd < 0 ? path_name : NULL,
+			file_name, size, count, suffix);
+	if (ret < 0) {
+		goto error;
+	}
+
+	if (dir_fd >= 0) {
+		if (uid < 0 || gid < 0) {
+			ret = openat(dir_fd, path, flags, mode);
+		} else {
+			ret = run_as_openat(dir_fd, path, flags, mode, uid, gid);
+		}
+	} else if (uid < 0 || gid < 0) {
 		ret = open(path, flags, mode);
 	} else {
 		ret = run_as_open(path, flags, mode, uid, gid);
 	}
 	if (ret < 0) {
-		PERROR("open stream path %s", path);
+		PERROR("open stream path %s%s%s", dir_fd >= 0 ? path_name : "",
+				dir_fd >= 0 ? "/" : "", path);
 	}
 error:
 	return ret;
 }
 
 /*
- * Unlink the stream tracefile from disk.
+ * Create the stream file on disk.
  *
  * Return 0 on success or else a negative value.
  */
 LTTNG_HIDDEN
-int utils_unlink_stream_file(const char *path_name, char *file_name, uint64_t size,
+int utils_create_stream_file(const char *path_name, char *file_name, uint64_t size,
 		uint64_t count, int uid, int gid, char *suffix)
+{
+	return utils_create_stream_file_at(-1, path_name, file_name, size,
+			count, uid, gid, suffix);
+}
+
+/*
+ * Unlink the stream tracefile from disk, relative to the directory dir_fd
+ * when it is not negative.
+ *
+ * Return 0 on success or else a negative value.
+ */
+LTTNG_HIDDEN
+int utils_unlink_stream_file_at(int dir_fd, const char *path_name,
+		char *file_name, uint64_t size, uint64_t count, int uid,
+		int gid, char *suffix)
 {
 	int ret;
 	char path[PATH_MAX];
 
-	ret = utils_stream_file_name(path, path_name, file_name,
-			size, count, suffix);
+	if (stripe_tracefile(file_name, suffix) && path_name &&
+			*path_name == '/') {
+		ret = utils_stream_file_name(path, path_name, file_name, size,
+				count, suffix);
+		if (ret < 0) {
+			goto error;
+		}
+		stripe_unlink_target(path, uid, gid);
+	}
+
+	ret = utils_stream_file_name(path, dir_fd < 0 ? path_name : NULL,
+			file_name, size, count, suffix);
 	if (ret < 0) {
 		goto error;
 	}
-	if (uid < 0 || gid < 0) {
+	if (dir_fd >= 0) {
+		if (uid < 0 || gid < 0) {
+			ret = unlinkat(dir_fd, path, 0);
+		} else {
+			ret = run_as_unlinkat(dir_fd, path, uid, gid);
+		}
+	} else if (uid < 0 || gid < 0) {
 		ret = unlink(path);
 	} else {
 		ret = run_as_unlink(path, uid, gid);
@@ -831,9 +913,23 @@ error:
 	return ret;
 }
 
+/*
+ * Unlink the stream tracefile from disk.
+ *
+ * Return 0 on success or else a negative value.
+ */
+LTTNG_HIDDEN
+int utils_unlink_stream_file(const char *path_name, char *file_name, uint64_t size,
+		uint64_t count, int uid, int gid, char *suffix)
+{
+	return utils_unlink_stream_file_at(-1, path_name, file_name, size,
+			count, uid, gid, suffix);
+}
+
 /*
  * Change the output tracefile according to the given size and count The
- * new_count pointer is set during this operation.
+ * new_count pointer is set during this operation. The files are unlinked
+ * and created relative to the directory dir_fd when it is not negative.
  *
  * From the consumer, the stream lock MUST be held before calling this function
  * because we are modifying the stream status.
@@ -841,9 +937,9 @@ error:
  * Return 0 on success or else a negative value.
  */
 LTTNG_HIDDEN
-int utils_rotate_stream_file(char *path_name, char *file_name, uint64_t size,
-		uint64_t count, int uid, int gid, int out_fd, uint64_t *new_count,
-		int *stream_fd)
+int utils_rotate_stream_file_at(int dir_fd, char *path_name, char *file_name,
+		uint64_t size, uint64_t count, int uid, int gid, int out_fd,
+		uint64_t *new_count, int *stream_fd)
 {
 	int ret;
 
@@ -873,8 +969,8 @@ int utils_rotate_stream_file(char *path_name, char *file_name, uint64_t size,
 		if (new_count) {
 			*new_count = (*new_count + 1) % count;
 		}
-		ret = utils_unlink_stream_file(path_name, file_name, size,
-				new_count ? *new_count : 0, uid, gid, 0);
+		ret = utils_unlink_stream_file_at(dir_fd, path_name, file_name,
+				size, new_count ? *new_count : 0, uid, gid, 0);
 		if (ret < 0 && errno != ENOENT) {
 			goto error;
 		}
@@ -884,7 +980,7 @@ int utils_rotate_stream_file(char *path_name, char *file_name, uint64_t size,
 		}
 	}
 
-	ret = utils_create_stream_file(path_name, file_name, size,
+	ret = utils_create_stream_file_at(dir_fd, path_name, file_name, size,
 			new_count ? *new_count : 0, uid, gid, 0);
 	if (ret < 0) {
 		goto error;
@@ -898,6 +994,15 @@ error:
 	return ret;
 }
 
+LTTNG_HIDDEN
+int utils_rotate_stream_file(char *path_name, char *file_name, uint64_t size,
+		uint64_t count, int uid, int gid, int out_fd, uint64_t *new_count,
+		int *stream_fd)
+{
+	return utils_rotate_stream_file_at(-1, path_name, file_name, size,
+			count, uid, gid, out_fd, new_count, stream_fd);
+}
+
 
 /**
  * Parse a string that represents a size in human readable format. It
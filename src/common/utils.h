@@ -39,6 +39,9 @@ int utils_set_fd_cloexec(int fd);
 int utils_create_pid_file(pid_t pid, const char *filepath);
 int utils_mkdir(const char *path, mode_t mode, int uid, int gid);
 int utils_mkdir_recursive(const char *path, mode_t mode, int uid, int gid);
+int utils_stream_file_name(char *path, const char *path_name,
+		const char *file_name, uint64_t size, uint64_t count,
+		const char *suffix);
 int utils_create_stream_file(const char *path_name, char *file_name, uint64_t size,
 		uint64_t count, int uid, int gid, char *suffix);
 int utils_unlink_stream_file(const char *path_name, char *file_name, uint64_t size,
@@ -46,6 +49,16 @@ int utils_unlink_stream_file(const char *path_name, char *file_name, uint64_t si
 int utils_rotate_stream_file(char *path_name, char *file_name, uint64_t size,
 		uint64_t count, int uid, int gid, int out_fd, uint64_t *new_count,
 		int *stream_fd);
+int utils_open_stream_dir(const char *path_name, int uid, int gid);
+int utils_create_stream_file_at(int dir_fd, const char *path_name,
+		char *file_name, uint64_t size, uint64_t count, int uid,
+		int gid, char *suffix);
+int utils_unlink_stream_file_at(int dir_fd, const char *path_name,
+		char *file_name, uint64_t size, uint64_t count, int uid,
+		int gid, char *suffix);
+int utils_rotate_stream_file_at(int dir_fd, char *path_name, char *file_name,
+		uint64_t size, uint64_t count, int uid, int gid, int out_fd,
+		uint64_t *new_count, int *stream_fd);
 int utils_parse_size_suffix(char const * const str, uint64_t * const size);
 int utils_get_count_order_u32(uint32_t x);
 int utils_get_count_order_u64(uint64_t x);
@@ -25,11 +25,20 @@
 #include <common/utils.h>
 #include <common/defaults.h>
 #include <assert.h>
+#include <sys/socket.h>
 #include "lttng-ctl-helper.h"
 
 static
 int handshake(struct lttng_notification_channel *channel);
 
+static
+int enqueue_notification(struct lttng_notification_channel *channel,
+		struct lttng_notification *notification);
+
+static
+int enqueue_dropped_notification(
+		struct lttng_notification_channel *channel);
+
 /*
  * Populates the reception buffer with the next complete message.
  * The caller must acquire the client's lock.
@@ -237,6 +246,10 @@ lttng_notification_channel_get_next_notification(
 
 	pthread_mutex_lock(&channel->lock);
 
+	if (channel->error) {
+		status = LTTNG_NOTIFICATION_CHANNEL_STATUS_ERROR;
+		goto end_unlock;
+	}
 	ret = receive_message(channel);
 	if (ret) {
 		status = LTTNG_NOTIFICATION_CHANNEL_STATUS_ERROR;
@@ -271,6 +284,222 @@ end:
 	return status;
 }
 
+/*
+ * Receive the bytes available on the socket, up to a message of maximal size,
+ * in the reception buffer. If "block" is set, wait until bytes are available.
+ * The caller must acquire the client's lock.
+ *
+ * Return the number of bytes received or else a negative value on error or
+ * if the session daemon hung up.
+ */
+static
+ssize_t receive_available(struct lttng_notification_channel *channel,
+		bool block)
+{
+	ssize_t ret;
+	const size_t len = sizeof(struct lttng_notification_channel_message) +
+			DEFAULT_MAX_NOTIFICATION_CLIENT_MESSAGE_PAYLOAD_SIZE;
+
+	ret = lttng_dynamic_buffer_set_size(&channel->reception_buffer, len);
+	if (ret) {
+		goto error;
+	}
+
+	do {
+		ret = recv(channel->socket, channel->reception_buffer.data,
+				len, block ? 0 : MSG_DONTWAIT);
+	} while (ret < 0 && errno == EINTR);
+	if (ret < 0 && !block && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+		ret = 0;
+	} else if (ret <= 0) {
+		goto error;
+	}
+
+	if (lttng_dynamic_buffer_set_size(&channel->reception_buffer, ret)) {
+		goto error;
+	}
+end:
+	return ret;
+error:
+	(void) lttng_dynamic_buffer_set_size(&channel->reception_buffer, 0);
+	ret = -1;
+	goto end;
+}
+
+/*
+ * Complete the message starting at "offset" in the reception buffer with a
+ * blocking receive if only part of it was available.
+ * The caller must acquire the client's lock.
+ *
+ * Return the size of the message, header included, or else a negative value.
+ */
+static
+ssize_t complete_buffered_message(struct lttng_notification_channel *channel,
+		size_t offset)
+{
+	ssize_t ret;
+	size_t buffered, msg_size;
+	struct lttng_notification_channel_message *msg;
+
+	buffered = channel->reception_buffer.size - offset;
+	if (buffered < sizeof(*msg)) {
+		ret = lttng_dynamic_buffer_set_size(&channel->reception_buffer,
+				offset + sizeof(*msg));
+		if (ret) {
+			goto end;
+		}
+		ret = lttcomm_recv_unix_sock(channel->socket,
+				channel->reception_buffer.data + offset +
+					buffered,
+				sizeof(*msg) - buffered);
+		if (ret <= 0) {
+			ret = -1;
+			goto end;
+		}
+		buffered = sizeof(*msg);
+	}
+
+	msg = (struct lttng_notification_channel_message *)
+			(channel->reception_buffer.data + offset);
+	if (msg->size > DEFAULT_MAX_NOTIFICATION_CLIENT_MESSAGE_PAYLOAD_SIZE) {
+		ret = -1;
+		goto end;
+	}
+	msg_size = sizeof(*msg) + msg->size;
+
+	if (buffered < msg_size) {
+		ret = lttng_dynamic_buffer_set_size(&channel->reception_buffer,
+				offset + msg_size);
+		if (ret) {
+			goto end;
+		}
+		ret = lttcomm_recv_unix_sock(channel->socket,
+				channel->reception_buffer.data + offset +
+					buffered,
+				msg_size - buffered);
+		if (ret <= 0) {
+			ret = -1;
+			goto end;
+		}
+	}
+	ret = msg_size;
+end:
+	return ret;
+}
+
+enum lttng_notification_channel_status
+lttng_notification_channel_get_next_notifications(
+		struct lttng_notification_channel *channel,
+		struct lttng_notification **notifications,
+		unsigned int max_count, unsigned int *_count)
+{
+	ssize_t ret;
+	size_t offset = 0;
+	unsigned int count = 0;
+	enum lttng_notification_channel_status status =
+			LTTNG_NOTIFICATION_CHANNEL_STATUS_OK;
+
+	if (!channel || !notifications || !max_count || !_count) {
+		status = LTTNG_NOTIFICATION_CHANNEL_STATUS_INVALID;
+		goto end;
+	}
+
+	pthread_mutex_lock(&channel->lock);
+
+	/* Deliver the pending notifications first. */
+	while (count < max_count && channel->pending_notifications.count) {
+		struct pending_notification *pending_notification;
+
+		pending_notification = cds_list_first_entry(
+				&channel->pending_notifications.list,
+				struct pending_notification,
+				node);
+		if (pending_notification->notification) {
+			notifications[count++] =
+					pending_notification->notification;
+		} else {
+			status = LTTNG_NOTIFICATION_CHANNEL_STATUS_NOTIFICATIONS_DROPPED;
+		}
+		cds_list_del(&pending_notification->node);
+		channel->pending_notifications.count--;
+		free(pending_notification);
+	}
+	if (count == max_count) {
+		goto end_unlock;
+	}
+	if (channel->error) {
+		goto error;
+	}
+
+	/* Only wait for the session daemon if there is nothing to return. */
+	ret = receive_available(channel, !count &&
+			status == LTTNG_NOTIFICATION_CHANNEL_STATUS_OK);
+	if (ret < 0) {
+		if (!count && status == LTTNG_NOTIFICATION_CHANNEL_STATUS_OK) {
+			status = LTTNG_NOTIFICATION_CHANNEL_STATUS_ERROR;
+		}
+		/* Otherwise, the error is reported by the next call. */
+		goto end_unlock;
+	}
+
+	while (offset < channel->reception_buffer.size) {
+		struct lttng_notification_channel_message *msg;
+		struct lttng_notification *notification = NULL;
+		struct lttng_buffer_view view;
+
+		ret = complete_buffered_message(channel, offset);
+		if (ret < 0) {
+			goto error;
+		}
+
+		msg = (struct lttng_notification_channel_message *)
+				(channel->reception_buffer.data + offset);
+		switch ((enum lttng_notification_channel_message_type) msg->type) {
+		case LTTNG_NOTIFICATION_CHANNEL_MESSAGE_TYPE_NOTIFICATION:
+			view = lttng_buffer_view_from_dynamic_buffer(
+					&channel->reception_buffer,
+					offset + sizeof(*msg), msg->size);
+			if (lttng_notification_create_from_buffer(&view,
+					&notification) != msg->size) {
+				lttng_notification_destroy(notification);
+				goto error;
+			}
+			if (count < max_count) {
+				notifications[count++] = notification;
+			} else if (enqueue_notification(channel,
+					notification)) {
+				goto error;
+			}
+			break;
+		case LTTNG_NOTIFICATION_CHANNEL_MESSAGE_TYPE_NOTIFICATION_DROPPED:
+			if (count < max_count) {
+				status = LTTNG_NOTIFICATION_CHANNEL_STATUS_NOTIFICATIONS_DROPPED;
+			} else if (enqueue_dropped_notification(channel)) {
+				goto error;
+			}
+			break;
+		default:
+			/* Protocol error. */
+			goto error;
+		}
+		offset += ret;
+	}
+
+end_unlock:
+	(void) lttng_dynamic_buffer_set_size(&channel->reception_buffer, 0);
+	pthread_mutex_unlock(&channel->lock);
+	*_count = count;
+end:
+	return status;
+error:
+	channel->error = true;
+	if (!count && status == LTTNG_NOTIFICATION_CHANNEL_STATUS_OK) {
+		status = LTTNG_NOTIFICATION_CHANNEL_STATUS_ERROR;
+	}
+	/* Otherwise, the error is reported by the next call. */
+	goto end_unlock;
+}
+
 static
 int enqueue_dropped_notification(
 		struct lttng_notification_channel *channel)
@@ -282,7 +511,8 @@ int enqueue_dropped_notification(
 
 	pending_notification = caa_container_of(last_element,
 			struct pending_notification, node);
-	if (!pending_notification->notification) {
+	if (channel->pending_notifications.count &&
+			!pending_notification->notification) {
 		/*
 		 * The last enqueued notification indicates dropped
 		 * notifications; there is nothing to do as we group
@@ -292,8 +522,7 @@ int enqueue_dropped_notification(
 	}
 
 	if (channel->pending_notifications.count >=
-			DEFAULT_CLIENT_MAX_QUEUED_NOTIFICATIONS_COUNT &&
-			pending_notification->notification) {
+			DEFAULT_CLIENT_MAX_QUEUED_NOTIFICATIONS_COUNT) {
 		/*
 		 * Discard the last enqueued notification to indicate
 		 * that notifications were dropped at this point.
@@ -317,43 +546,63 @@ end:
 	return ret;
 }
 
+/*
+ * Enqueue a notification, of which ownership is transferred to the
+ * pending_notifications list, or drop it if the list is full.
+ */
 static
-int enqueue_notification_from_current_message(
-		struct lttng_notification_channel *channel)
+int enqueue_notification(struct lttng_notification_channel *channel,
+		struct lttng_notification *notification)
 {
 	int ret = 0;
-	struct lttng_notification *notification;
 	struct pending_notification *pending_notification;
 
 	if (channel->pending_notifications.count >=
 			DEFAULT_CLIENT_MAX_QUEUED_NOTIFICATIONS_COUNT) {
 		/* Drop the notification. */
+		lttng_notification_destroy(notification);
 		ret = enqueue_dropped_notification(channel);
 		goto end;
 	}
 
 	pending_notification = zmalloc(sizeof(*pending_notification));
 	if (!pending_notification) {
+		lttng_notification_destroy(notification);
 		ret = -1;
-		goto error;
+		goto end;
 	}
 	CDS_INIT_LIST_HEAD(&pending_notification->node);
+	pending_notification->notification = notification;
+	cds_list_add(&pending_notification->node,
+			&channel->pending_notifications.list);
+	channel->pending_notifications.count++;
+end:
+	return ret;
+}
+
+static
+int enqueue_notification_from_current_message(
+		struct lttng_notification_channel *channel)
+{
+	int ret = 0;
+	struct lttng_notification *notification;
+
+	if (channel->pending_notifications.count >=
+			DEFAULT_CLIENT_MAX_QUEUED_NOTIFICATIONS_COUNT) {
+		/* Drop the notification. */
+		ret = enqueue_dropped_notification(channel);
+		goto end;
+	}
 
 	notification = create_notification_from_current_message(channel);
 	if (!notification) {
 		ret = -1;
-		goto error;
+		goto end;
 	}
 
-	pending_notification->notification = notification;
-	cds_list_add(&pending_notification->node,
-			&channel->pending_notifications.list);
-	channel->pending_notifications.count++;
+	ret = enqueue_notification(channel, notification);
 end:
 	return ret;
-error:
-	free(pending_notification);
-	goto end;
 }
 
 static
@@ -481,11 +730,16 @@ enum lttng_notification_channel_status send_condition_command(
 	ssize_t command_size, ret;
 	enum lttng_notification_channel_status status =
 			LTTNG_NOTIFICATION_CHANNEL_STATUS_OK;
-	char *command_buffer = NULL;
+	struct lttng_dynamic_buffer command_buffer;
+	/* Most commands fit, sparing the heap allocation. */
+	char command_storage[512];
 	struct lttng_notification_channel_message cmd_message = {
 		.type = type,
 	};
 
+	lttng_dynamic_buffer_init_with_storage(&command_buffer,
+			command_storage, sizeof(command_storage));
+
 	if (!channel) {
 		status = LTTNG_NOTIFICATION_CHANNEL_STATUS_INVALID;
 		goto end;
@@ -510,19 +764,27 @@ enum lttng_notification_channel_status send_condition_command(
 	cmd_message.size = (uint32_t) ret;
 	command_size = ret + sizeof(
 			struct lttng_notification_channel_message);
-	command_buffer = zmalloc(command_size);
-	if (!command_buffer) {
+	ret = lttng_dynamic_buffer_append(&command_buffer, &cmd_message,
+			sizeof(cmd_message));
+	if (ret) {
+		status = LTTNG_NOTIFICATION_CHANNEL_STATUS_ERROR;
+		goto end_unlock;
+	}
+	/* The condition is serialized in place. */
+	ret = lttng_dynamic_buffer_set_size_no_zero(&command_buffer,
+			command_size);
+	if (ret) {
+		status = LTTNG_NOTIFICATION_CHANNEL_STATUS_ERROR;
 		goto end_unlock;
 	}
-
-	memcpy(command_buffer, &cmd_message, sizeof(cmd_message));
 	ret = lttng_condition_serialize(condition,
-			command_buffer + sizeof(cmd_message));
+			command_buffer.data + sizeof(cmd_message));
 	if (ret < 0) {
 		goto end_unlock;
 	}
 
-	ret = lttcomm_send_unix_sock(socket, command_buffer, command_size);
+	ret = lttcomm_send_unix_sock(socket, command_buffer.data,
+			command_size);
 	if (ret < 0) {
 		status = LTTNG_NOTIFICATION_CHANNEL_STATUS_ERROR;
 		goto end_unlock;
@@ -536,7 +798,7 @@ enum lttng_notification_channel_status send_condition_command(
 end_unlock:
 	pthread_mutex_unlock(&channel->lock);
 end:
-	free(command_buffer);
+	lttng_dynamic_buffer_reset(&command_buffer);
 	return status;
 }
 
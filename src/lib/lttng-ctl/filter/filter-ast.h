@@ -81,6 +81,9 @@ enum op_type {
 	AST_OP_LT,
 	AST_OP_GE,
 	AST_OP_LE,
+
+	/* rchild is the first constant of the set, linked by next. */
+	AST_OP_IN,
 };
 
 enum unary_op_type {
@@ -189,5 +192,7 @@ int filter_visitor_ir_check_binary_comparator(struct filter_parser_ctx *ctx);
 int filter_visitor_ir_validate_string(struct filter_parser_ctx *ctx);
 int filter_visitor_ir_normalize_glob_patterns(struct filter_parser_ctx *ctx);
 int filter_visitor_ir_validate_globbing(struct filter_parser_ctx *ctx);
+int filter_visitor_ir_optimize(struct filter_parser_ctx *ctx);
+int filter_visitor_ir_reorder(struct filter_parser_ctx *ctx);
 
 #endif /* _FILTER_AST_H */
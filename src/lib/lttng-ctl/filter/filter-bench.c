@@ -0,0 +1,516 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * Benchmark and fuzzer of the filter compiler pipeline, as run by
+ * lttng_enable_event_with_exclusions(): parsing, IR generation, validation,
+ * optimization and bytecode generation.
+ *
+ * Usage: filter-bench [-r REPEAT] [-s SHAPE] TERMS...
+ *        filter-bench -f ITERATIONS [-S SEED]
+ *
+ * The first form compiles a generated expression of each number of terms
+ * REPEAT times (5 by default) and prints, on a line per expression, a JSON
+ * object with the best time of each stage in microseconds and the size of the
+ * bytecode. The shapes are:
+ *
+ *   or		intfield == 0 || intfield == 1 || ...
+ *   and	strfield != "s0*" && strfield != "s1*" && ...
+ *   groups	(intfield == 0 || ... || intfield == 3) && (...) && ...
+ *   mixed	strfield == "s0" || intfield == 0 || strfield == "s1" || ...
+ *   nested	((intfield == 0 || intfield == 1) && intfield == 2) || ...
+ *   in		intfield in {0, 1, ...}
+ *
+ * The second form compiles random, possibly invalid, expressions and checks
+ * the bytecode of the valid ones. It exits with a failure status if a
+ * bytecode is inconsistent; a crash or an assertion is a failure as well.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <common/macros.h>
+#include <common/time.h>
+
+#include "filter-ast.h"
+#include "filter-parser.h"
+#include "filter-bytecode.h"
+
+#define DEFAULT_REPEAT		5
+#define GROUP_TERMS		4
+#define FUZZ_MAX_DEPTH		8
+
+enum stage {
+	STAGE_PARSE,
+	STAGE_IR,
+	STAGE_BYTECODE,
+	NR_STAGES,
+};
+
+static const char *stage_names[NR_STAGES] = {
+	[STAGE_PARSE] = "parse_us",
+	[STAGE_IR] = "ir_us",
+	[STAGE_BYTECODE] = "bytecode_us",
+};
+
+struct expr_buf {
+	char *s;
+	size_t len;
+	size_t alloc_len;
+};
+
+static void expr_append(struct expr_buf *buf, const char *fmt, ...)
+{
+	va_list ap;
+	int len;
+
+	for (;;) {
+		size_t avail = buf->alloc_len - buf->len;
+
+		va_start(ap, fmt);
+		len = vsnprintf(buf->s ? buf->s + buf->len : NULL, avail, fmt,
+				ap);
+		va_end(ap);
+		if (len < 0) {
+			perror("vsnprintf");
+			exit(EXIT_FAILURE);
+		}
+		if ((size_t) len < avail) {
+			buf->len += len;
+			return;
+		}
+		buf->alloc_len = (buf->alloc_len + len + 1) * 2;
+		buf->s = realloc(buf->s, buf->alloc_len);
+		if (!buf->s) {
+			perror("realloc");
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+/*
+ * Compile "expr" like generate_filter() in lttng-ctl, without the XML
+ * output, recording the time of each stage in "times" if not NULL. The
+ * expression is read from a temporary file rather than from memory, which
+ * needs a fallback on the systems without fmemopen().
+ *
+ * Return the parser context holding the bytecode, or NULL if the expression
+ * is rejected.
+ */
+static struct filter_parser_ctx *compile(char *expr, uint64_t *times)
+{
+	struct filter_parser_ctx *ctx = NULL;
+	uint64_t start;
+	size_t len = strlen(expr);
+	FILE *fmem;
+	int ret;
+
+	fmem = tmpfile();
+	if (!fmem || fwrite(expr, 1, len, fmem) != len) {
+		perror("Writing the expression to a temporary file");
+		exit(EXIT_FAILURE);
+	}
+	rewind(fmem);
+
+	start = lttng_monotonic_time_ns();
+	ctx = filter_parser_ctx_alloc(fmem);
+	if (!ctx) {
+		fprintf(stderr, "Error allocating parser\n");
+		exit(EXIT_FAILURE);
+	}
+	ret = filter_parser_ctx_append_ast(ctx);
+	if (ret) {
+		goto error;
+	}
+	ret = filter_visitor_set_parent(ctx);
+	if (ret) {
+		goto error;
+	}
+	if (times) {
+		times[STAGE_PARSE] = lttng_monotonic_time_ns() - start;
+		start = lttng_monotonic_time_ns();
+	}
+
+	ret = filter_visitor_ir_generate(ctx);
+	if (ret) {
+		goto error;
+	}
+	ret = filter_visitor_ir_check_binary_op_nesting(ctx);
+	if (ret) {
+		goto error;
+	}
+	ret = filter_visitor_ir_normalize_glob_patterns(ctx);
+	if (ret) {
+		goto error;
+	}
+	ret = filter_visitor_ir_validate_string(ctx);
+	if (ret) {
+		goto error;
+	}
+	ret = filter_visitor_ir_validate_globbing(ctx);
+	if (ret) {
+		goto error;
+	}
+	ret = filter_visitor_ir_optimize(ctx);
+	if (ret) {
+		goto error;
+	}
+	ret = filter_visitor_ir_reorder(ctx);
+	if (ret) {
+		goto error;
+	}
+	if (times) {
+		times[STAGE_IR] = lttng_monotonic_time_ns() - start;
+		start = lttng_monotonic_time_ns();
+	}
+
+	ret = filter_visitor_bytecode_generate(ctx);
+	if (ret) {
+		goto error;
+	}
+	if (times) {
+		times[STAGE_BYTECODE] = lttng_monotonic_time_ns() - start;
+	}
+	filter_ir_free(ctx);
+	fclose(fmem);
+	return ctx;
+
+error:
+	filter_bytecode_free(ctx);
+	filter_ir_free(ctx);
+	filter_parser_ctx_free(ctx);
+	fclose(fmem);
+	return NULL;
+}
+
+static void release(struct filter_parser_ctx *ctx)
+{
+	filter_bytecode_free(ctx);
+	filter_parser_ctx_free(ctx);
+}
+
+static int generate_shape(struct expr_buf *buf, const char *shape,
+		unsigned long nr_terms)
+{
+	unsigned long i;
+
+	buf->len = 0;
+	if (!strcmp(shape, "or")) {
+		for (i = 0; i < nr_terms; i++) {
+			expr_append(buf, "%sintfield == %lu", i ? " || " : "",
+					i);
+		}
+	} else if (!strcmp(shape, "and")) {
+		for (i = 0; i < nr_terms; i++) {
+			expr_append(buf, "%sstrfield != \"s%lu*\"",
+					i ? " && " : "", i);
+		}
+	} else if (!strcmp(shape, "groups")) {
+		for (i = 0; i < nr_terms; i++) {
+			expr_append(buf, "%sintfield == %lu",
+					i % GROUP_TERMS ? " || " :
+						(i ? ") && (" : "("), i);
+		}
+		expr_append(buf, ")");
+	} else if (!strcmp(shape, "mixed")) {
+		/* The costly string comparisons come first in the chain. */
+		for (i = 0; i < nr_terms; i++) {
+			if (i % 2) {
+				expr_append(buf, " || intfield == %lu", i / 2);
+			} else {
+				expr_append(buf, "%sstrfield == \"s%lu\"",
+						i ? " || " : "", i / 2);
+			}
+		}
+	} else if (!strcmp(shape, "nested")) {
+		/* Alternate the operators so that no chain can be flattened. */
+		for (i = 1; i < nr_terms; i++) {
+			expr_append(buf, "(");
+		}
+		expr_append(buf, "intfield == 0");
+		for (i = 1; i < nr_terms; i++) {
+			expr_append(buf, "%sintfield == %lu)",
+					i % 2 ? " || " : " && ", i);
+		}
+	} else if (!strcmp(shape, "in")) {
+		expr_append(buf, "intfield in {");
+		for (i = 0; i < nr_terms; i++) {
+			expr_append(buf, "%s%lu", i ? ", " : "", i);
+		}
+		expr_append(buf, "}");
+	} else {
+		fprintf(stderr, "Unknown shape: %s\n", shape);
+		return -1;
+	}
+	return 0;
+}
+
+static int bench(const char *shape, unsigned int repeat, int argc,
+		char **argv)
+{
+	struct expr_buf buf = { 0 };
+	int i;
+
+	for (i = 0; i < argc; i++) {
+		unsigned long nr_terms = strtoul(argv[i], NULL, 10);
+		uint64_t best[NR_STAGES];
+		uint32_t bytecode_len = 0;
+		unsigned int r, s;
+		int rejected = 0;
+
+		if (!nr_terms || generate_shape(&buf, shape, nr_terms)) {
+			free(buf.s);
+			return -1;
+		}
+		for (s = 0; s < NR_STAGES; s++) {
+			best[s] = UINT64_MAX;
+		}
+		for (r = 0; r < repeat; r++) {
+			struct filter_parser_ctx *ctx;
+			uint64_t times[NR_STAGES];
+
+			ctx = compile(buf.s, times);
+			if (!ctx) {
+				rejected = 1;
+				break;
+			}
+			bytecode_len = bytecode_get_len(&ctx->bytecode->b);
+			release(ctx);
+			for (s = 0; s < NR_STAGES; s++) {
+				if (times[s] < best[s]) {
+					best[s] = times[s];
+				}
+			}
+		}
+
+		printf("{\"shape\": \"%s\", \"terms\": %lu, \"expr_bytes\": %zu",
+				shape, nr_terms, buf.len);
+		if (rejected) {
+			/* Typically a bytecode larger than the maximum. */
+			printf(", \"rejected\": true}\n");
+			continue;
+		}
+		for (s = 0; s < NR_STAGES; s++) {
+			printf(", \"%s\": %.1f", stage_names[s],
+					(double) best[s] / NSEC_PER_USEC);
+		}
+		printf(", \"bytecode_bytes\": %" PRIu32 "}\n", bytecode_len);
+	}
+	free(buf.s);
+	return 0;
+}
+
+static const char *fuzz_atoms[] = {
+	"intfield", "strfield", "a.b", "a->b", "$ctx.vtid", "$ctx.procname",
+	"$app.provider:ctx", "$unknown.x", "0", "1", "-1", "42", "0x7f", "017",
+	"9223372036854775807", "1.5", ".5e3", "\"\"", "\"abc\"", "\"abc*\"",
+	"\"*abc\"", "\"a*b*\"", "\"a\\\\*b\"", "\"**\"",
+};
+
+static const char *fuzz_binary_ops[] = {
+	"==", "!=", "<", ">", "<=", ">=", "&&", "||", "+", "-", "*", "/", "%",
+	"<<", ">>", "&", "|", "^",
+};
+
+static const char *fuzz_unary_ops[] = { "!", "-", "+", "~" };
+
+static void fuzz_expr(struct expr_buf *buf, unsigned int depth)
+{
+	unsigned int choice = rand() % 8, i, nr;
+
+	if (depth >= FUZZ_MAX_DEPTH || choice < 2) {
+		expr_append(buf, "%s",
+				fuzz_atoms[rand() % ARRAY_SIZE(fuzz_atoms)]);
+		return;
+	}
+	switch (choice) {
+	case 2:
+		expr_append(buf, "%s",
+				fuzz_unary_ops[rand() % ARRAY_SIZE(fuzz_unary_ops)]);
+		fuzz_expr(buf, depth + 1);
+		break;
+	case 3:
+		expr_append(buf, "(");
+		fuzz_expr(buf, depth + 1);
+		expr_append(buf, ")");
+		break;
+	case 4:
+		fuzz_expr(buf, depth + 1);
+		expr_append(buf, " in {");
+		nr = rand() % 12;
+		for (i = 0; i < nr; i++) {
+			expr_append(buf, "%s%d", i ? ", " : "", rand() % 16 - 8);
+		}
+		expr_append(buf, "}");
+		break;
+	default:
+		fuzz_expr(buf, depth + 1);
+		expr_append(buf, " %s ", fuzz_binary_ops[rand() %
+				ARRAY_SIZE(fuzz_binary_ops)]);
+		fuzz_expr(buf, depth + 1);
+		break;
+	}
+}
+
+/* Replace, insert or drop a few characters of the expression. */
+static void fuzz_mutate(struct expr_buf *buf)
+{
+	static const char chars[] = "()!&|=<>\"*\\{},.$ 0123456789ab";
+	unsigned int i, nr = rand() % 4;
+
+	for (i = 0; i < nr && buf->len; i++) {
+		size_t pos = rand() % buf->len;
+
+		switch (rand() % 3) {
+		case 0:
+			buf->s[pos] = chars[rand() % (sizeof(chars) - 1)];
+			break;
+		case 1:
+			memmove(&buf->s[pos], &buf->s[pos + 1], buf->len - pos);
+			buf->len--;
+			break;
+		default:
+			expr_append(buf, " ");
+			memmove(&buf->s[pos + 1], &buf->s[pos],
+					buf->len - 1 - pos);
+			buf->s[pos] = chars[rand() % (sizeof(chars) - 1)];
+			break;
+		}
+	}
+}
+
+/*
+ * Check the layout of a generated bytecode: a return instruction ends the
+ * instructions, followed by the relocation table entries, each an offset of
+ * a load instruction and a NULL-terminated name.
+ *
+ * Return 0 if the bytecode is consistent or else -1.
+ */
+static int check_bytecode(const struct lttng_filter_bytecode *b)
+{
+	uint32_t offset = b->reloc_table_offset;
+
+	if (b->len > LTTNG_FILTER_MAX_LEN || !offset || offset > b->len ||
+			(filter_opcode_t) b->data[offset - 1] != FILTER_OP_RETURN) {
+		return -1;
+	}
+	while (offset < b->len) {
+		uint16_t insn_offset;
+		const char *end;
+
+		if (offset + sizeof(insn_offset) >= b->len) {
+			return -1;
+		}
+		memcpy(&insn_offset, &b->data[offset], sizeof(insn_offset));
+		if (insn_offset >= b->reloc_table_offset ||
+				((filter_opcode_t) b->data[insn_offset] !=
+					FILTER_OP_LOAD_FIELD_REF &&
+				 (filter_opcode_t) b->data[insn_offset] !=
+					FILTER_OP_GET_CONTEXT_REF)) {
+			return -1;
+		}
+		offset += sizeof(insn_offset);
+		end = memchr(&b->data[offset], '\0', b->len - offset);
+		if (!end) {
+			return -1;
+		}
+		offset = end - b->data + 1;
+	}
+	return 0;
+}
+
+static int fuzz(unsigned long iterations, unsigned int seed)
+{
+	struct expr_buf buf = { 0 };
+	unsigned long i, nr_valid = 0;
+	int ret = 0;
+
+	srand(seed);
+	for (i = 0; i < iterations; i++) {
+		struct filter_parser_ctx *ctx;
+
+		buf.len = 0;
+		fuzz_expr(&buf, 0);
+		if (rand() % 2) {
+			fuzz_mutate(&buf);
+		}
+		ctx = compile(buf.s, NULL);
+		if (!ctx) {
+			continue;
+		}
+		nr_valid++;
+		if (check_bytecode(&ctx->bytecode->b)) {
+			fprintf(stderr, "Inconsistent bytecode for: %s\n",
+					buf.s);
+			ret = -1;
+		}
+		release(ctx);
+	}
+	printf("{\"iterations\": %lu, \"seed\": %u, \"valid\": %lu}\n",
+			iterations, seed, nr_valid);
+	free(buf.s);
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	const char *shape = "or";
+	unsigned int repeat = DEFAULT_REPEAT, seed = 0;
+	unsigned long iterations = 0;
+	int opt, ret;
+
+	while ((opt = getopt(argc, argv, "r:s:f:S:")) != -1) {
+		switch (opt) {
+		case 'r':
+			repeat = strtoul(optarg, NULL, 10);
+			break;
+		case 's':
+			shape = optarg;
+			break;
+		case 'f':
+			iterations = strtoul(optarg, NULL, 10);
+			break;
+		case 'S':
+			seed = strtoul(optarg, NULL, 10);
+			break;
+		default:
+			goto usage;
+		}
+	}
+
+	if (iterations) {
+		ret = fuzz(iterations, seed);
+	} else {
+		if (optind == argc || !repeat) {
+			goto usage;
+		}
+		ret = bench(shape, repeat, argc - optind, argv + optind);
+	}
+	exit(ret ? EXIT_FAILURE : EXIT_SUCCESS);
+
+usage:
+	fprintf(stderr, "Usage: %s [-r REPEAT] [-s SHAPE] TERMS...\n"
+			"       %s -f ITERATIONS [-S SEED]\n",
+			argv[0], argv[0]);
+	exit(EXIT_FAILURE);
+}
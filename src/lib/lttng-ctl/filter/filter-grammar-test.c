@@ -90,6 +90,14 @@ int main(int argc, char **argv)
 		if (ret) {
 			goto parse_error;
 		}
+		ret = filter_visitor_ir_optimize(ctx);
+		if (ret) {
+			goto parse_error;
+		}
+		ret = filter_visitor_ir_reorder(ctx);
+		if (ret) {
+			goto parse_error;
+		}
 		printf("done\n");
 	}
 	if (generate_bytecode) {
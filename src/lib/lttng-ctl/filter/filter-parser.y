@@ -319,7 +319,7 @@ void filter_parser_ctx_free(struct filter_parser_ctx *parser_ctx)
 %token LSBRAC RSBRAC LPAREN RPAREN LBRAC RBRAC RARROW
 %token STAR PLUS MINUS
 %token MOD_OP DIV_OP RIGHT_OP LEFT_OP
-%token EQ_OP NE_OP LE_OP GE_OP LT_OP GT_OP AND_OP OR_OP NOT_OP
+%token EQ_OP NE_OP LE_OP GE_OP LT_OP GT_OP AND_OP OR_OP NOT_OP IN_OP
 %token ASSIGN COLON SEMICOLON DOTDOTDOT DOT EQUAL COMMA
 %token XOR_BIN AND_BIN OR_BIN NOT_BIN
 
@@ -343,6 +343,7 @@ void filter_parser_ctx_free(struct filter_parser_ctx *parser_ctx)
 %type <n> additive_expression
 %type <n> shift_expression
 %type <n> relational_expression
+%type <n> set_expression
 %type <n> equality_expression
 %type <n> and_expression
 %type <n> exclusive_or_expression
@@ -584,6 +585,30 @@ relational_expression
 		{
 			$$ = make_op_node(parser_ctx, AST_OP_GE, $1, $3);
 		}
+	| relational_expression IN_OP LBRAC set_expression RBRAC
+		{
+			$$ = make_op_node(parser_ctx, AST_OP_IN, $1, $4);
+		}
+	;
+
+set_expression
+	: primary_expression
+		{
+			if ($1->type != NODE_EXPRESSION
+					|| $1->u.expression.type != AST_EXP_CONSTANT) {
+				parse_error(parser_ctx, "set elements must be integer constants");
+			}
+			$$ = $1;
+		}
+	| set_expression COMMA primary_expression
+		{
+			if ($3->type != NODE_EXPRESSION
+					|| $3->u.expression.type != AST_EXP_CONSTANT) {
+				parse_error(parser_ctx, "set elements must be integer constants");
+			}
+			$3->u.expression.next = $1;
+			$$ = $3;
+		}
 	;
 
 equality_expression
@@ -157,11 +157,36 @@ int visit_node_root(struct filter_parser_ctx *ctx, struct ir_op *node)
 	return bytecode_push(&ctx->bytecode, &insn, 1, sizeof(insn));
 }
 
+/*
+ * Reserve an instruction of "len" bytes at the end of the bytecode, to be
+ * written in place. The reserved bytes are zeroed.
+ *
+ * Return the instruction or NULL with "*ret" set to a negative errno.
+ */
+static
+struct load_op *bytecode_reserve_load(struct lttng_filter_bytecode_alloc **fb,
+		uint32_t len, int *ret)
+{
+	int32_t offset;
+
+	offset = bytecode_reserve(fb, 1, len);
+	if (offset < 0) {
+		*ret = offset;
+		return NULL;
+	}
+	return (struct load_op *) &(*fb)->b.data[offset];
+}
+
 static
 int visit_node_load(struct filter_parser_ctx *ctx, struct ir_op *node)
 {
-	int ret;
+	int ret = 0;
 
+	/*
+	 * The instructions are written in place rather than through a
+	 * temporary allocation, generated filters may load thousands of
+	 * operands.
+	 */
 	switch (node->data_type) {
 	case IR_DATA_UNKNOWN:
 	default:
@@ -172,12 +197,15 @@ int visit_node_load(struct filter_parser_ctx *ctx, struct ir_op *node)
 	case IR_DATA_STRING:
 	{
 		struct load_op *insn;
-		uint32_t insn_len = sizeof(struct load_op)
-			+ strlen(node->u.load.u.string.value) + 1;
+		size_t value_len = strlen(node->u.load.u.string.value) + 1;
+		uint32_t insn_len;
 
-		insn = calloc(insn_len, 1);
+		if (value_len > LTTNG_FILTER_MAX_LEN)
+			return -EINVAL;
+		insn_len = sizeof(struct load_op) + value_len;
+		insn = bytecode_reserve_load(&ctx->bytecode, insn_len, &ret);
 		if (!insn)
-			return -ENOMEM;
+			return ret;
 
 		switch (node->u.load.u.string.type) {
 		case IR_LOAD_STRING_TYPE_GLOB_STAR:
@@ -204,54 +232,54 @@ int visit_node_load(struct filter_parser_ctx *ctx, struct ir_op *node)
 			break;
 		}
 
-		strcpy(insn->data, node->u.load.u.string.value);
-		ret = bytecode_push(&ctx->bytecode, insn, 1, insn_len);
-		free(insn);
-		return ret;
+		memcpy(insn->data, node->u.load.u.string.value, value_len);
+		return 0;
 	}
 	case IR_DATA_NUMERIC:
 	{
 		struct load_op *insn;
-		uint32_t insn_len = sizeof(struct load_op)
-			+ sizeof(struct literal_numeric);
 
-		insn = calloc(insn_len, 1);
+		insn = bytecode_reserve_load(&ctx->bytecode,
+				sizeof(struct load_op)
+					+ sizeof(struct literal_numeric), &ret);
 		if (!insn)
-			return -ENOMEM;
+			return ret;
 		insn->op = FILTER_OP_LOAD_S64;
 		memcpy(insn->data, &node->u.load.u.num, sizeof(int64_t));
-		ret = bytecode_push(&ctx->bytecode, insn, 1, insn_len);
-		free(insn);
-		return ret;
+		return 0;
 	}
 	case IR_DATA_FLOAT:
 	{
 		struct load_op *insn;
-		uint32_t insn_len = sizeof(struct load_op)
-			+ sizeof(struct literal_double);
 
-		insn = calloc(insn_len, 1);
+		insn = bytecode_reserve_load(&ctx->bytecode,
+				sizeof(struct load_op)
+					+ sizeof(struct literal_double), &ret);
 		if (!insn)
-			return -ENOMEM;
+			return ret;
 		insn->op = FILTER_OP_LOAD_DOUBLE;
 		memcpy(insn->data, &node->u.load.u.flt, sizeof(double));
-		ret = bytecode_push(&ctx->bytecode, insn, 1, insn_len);
-		free(insn);
-		return ret;
+		return 0;
 	}
 	case IR_DATA_FIELD_REF:	/* fall-through */
 	case IR_DATA_GET_CONTEXT_REF:
 	{
 		struct load_op *insn;
-		uint32_t insn_len = sizeof(struct load_op)
-			+ sizeof(struct field_ref);
 		struct field_ref ref_offset;
 		uint32_t reloc_offset_u32;
 		uint16_t reloc_offset;
 
-		insn = calloc(insn_len, 1);
+		/* reloc_offset points to struct load_op */
+		reloc_offset_u32 = bytecode_get_len(&ctx->bytecode->b);
+		if (reloc_offset_u32 > LTTNG_FILTER_MAX_LEN - 1) {
+			return -EINVAL;
+		}
+		reloc_offset = (uint16_t) reloc_offset_u32;
+		insn = bytecode_reserve_load(&ctx->bytecode,
+				sizeof(struct load_op) + sizeof(struct field_ref),
+				&ret);
 		if (!insn)
-			return -ENOMEM;
+			return ret;
 		switch(node->data_type) {
 		case IR_DATA_FIELD_REF:
 			insn->op = FILTER_OP_LOAD_FIELD_REF;
@@ -260,34 +288,17 @@ int visit_node_load(struct filter_parser_ctx *ctx, struct ir_op *node)
 			insn->op = FILTER_OP_GET_CONTEXT_REF;
 			break;
 		default:
-			free(insn);
 			return -EINVAL;
 		}
 		ref_offset.offset = (uint16_t) -1U;
 		memcpy(insn->data, &ref_offset, sizeof(ref_offset));
-		/* reloc_offset points to struct load_op */
-		reloc_offset_u32 = bytecode_get_len(&ctx->bytecode->b);
-		if (reloc_offset_u32 > LTTNG_FILTER_MAX_LEN - 1) {
-			free(insn);
-			return -EINVAL;
-		}
-		reloc_offset = (uint16_t) reloc_offset_u32;
-		ret = bytecode_push(&ctx->bytecode, insn, 1, insn_len);
-		if (ret) {
-			free(insn);
-			return ret;
-		}
 		/* append reloc */
 		ret = bytecode_push(&ctx->bytecode_reloc, &reloc_offset,
 					1, sizeof(reloc_offset));
-		if (ret) {
-			free(insn);
+		if (ret)
 			return ret;
-		}
-		ret = bytecode_push(&ctx->bytecode_reloc, node->u.load.u.ref,
+		return bytecode_push(&ctx->bytecode_reloc, node->u.load.u.ref,
 					1, strlen(node->u.load.u.ref) + 1);
-		free(insn);
-		return ret;
 	}
 	}
 }
@@ -367,7 +367,7 @@ struct ir_op *make_op_binary_logical_or(struct ir_op *left, struct ir_op *right,
 	return make_op_binary_logical(AST_OP_OR, "||", left, right, side);
 }
 
-static
+LTTNG_HIDDEN
 void filter_free_ir_recursive(struct ir_op *op)
 {
 	if (!op)
@@ -409,6 +409,92 @@ void filter_free_ir_recursive(struct ir_op *op)
 	free(op);
 }
 
+static
+int is_constant_load(struct ir_op *op)
+{
+	return op->op == IR_OP_LOAD && (op->data_type == IR_DATA_NUMERIC
+			|| op->data_type == IR_DATA_FLOAT);
+}
+
+/*
+ * The bytecode has no arithmetic instructions: arithmetic operators are
+ * only accepted between constants, and computed here. Integer arithmetic
+ * wraps around.
+ */
+static
+struct ir_op *make_op_binary_arith_constant(enum op_type bin_op_type,
+		const char *op_str, struct ir_op *left, struct ir_op *right,
+		enum ir_side side)
+{
+	int64_t l, r;
+	double lf, rf;
+
+	if (!is_constant_load(left) || !is_constant_load(right)) {
+		fprintf(stderr, "[error] binary operation '%s' not supported on non-constant operands\n", op_str);
+		return NULL;
+	}
+
+	if (left->data_type == IR_DATA_FLOAT
+			|| right->data_type == IR_DATA_FLOAT) {
+		lf = left->data_type == IR_DATA_FLOAT ?
+			left->u.load.u.flt : (double) left->u.load.u.num;
+		rf = right->data_type == IR_DATA_FLOAT ?
+			right->u.load.u.flt : (double) right->u.load.u.num;
+
+		switch (bin_op_type) {
+		case AST_OP_MUL:
+			return make_op_load_float(lf * rf, side);
+		case AST_OP_DIV:
+			return make_op_load_float(lf / rf, side);
+		case AST_OP_PLUS:
+			return make_op_load_float(lf + rf, side);
+		case AST_OP_MINUS:
+			return make_op_load_float(lf - rf, side);
+		default:
+			fprintf(stderr, "[error] binary operation '%s' not allowed on float constant\n", op_str);
+			return NULL;
+		}
+	}
+
+	l = left->u.load.u.num;
+	r = right->u.load.u.num;
+	switch (bin_op_type) {
+	case AST_OP_MUL:
+		return make_op_load_numeric((int64_t) ((uint64_t) l * (uint64_t) r),
+				side);
+	case AST_OP_DIV:
+	case AST_OP_MOD:
+		if (r == 0 || (l == INT64_MIN && r == -1)) {
+			fprintf(stderr, "[error] binary operation '%s' overflows or divides by zero\n", op_str);
+			return NULL;
+		}
+		return make_op_load_numeric(bin_op_type == AST_OP_DIV ?
+				l / r : l % r, side);
+	case AST_OP_PLUS:
+		return make_op_load_numeric((int64_t) ((uint64_t) l + (uint64_t) r),
+				side);
+	case AST_OP_MINUS:
+		return make_op_load_numeric((int64_t) ((uint64_t) l - (uint64_t) r),
+				side);
+	case AST_OP_RSHIFT:
+	case AST_OP_LSHIFT:
+		if (r < 0 || r > 63) {
+			fprintf(stderr, "[error] binary operation '%s' shift count out of range\n", op_str);
+			return NULL;
+		}
+		return make_op_load_numeric(bin_op_type == AST_OP_RSHIFT ?
+				l >> r : (int64_t) ((uint64_t) l << r), side);
+	case AST_OP_BIN_AND:
+		return make_op_load_numeric(l & r, side);
+	case AST_OP_BIN_OR:
+		return make_op_load_numeric(l | r, side);
+	case AST_OP_BIN_XOR:
+		return make_op_load_numeric(l ^ r, side);
+	default:
+		return NULL;
+	}
+}
+
 static
 struct ir_op *make_expression(struct filter_parser_ctx *ctx,
 		struct filter_node *node, enum ir_side side)
@@ -468,6 +554,146 @@ struct ir_op *make_expression(struct filter_parser_ctx *ctx,
 	}
 }
 
+/*
+ * Sets up to this size are looked up with a chain of equality tests.
+ */
+#define SET_LINEAR_MAX	4
+
+static
+int compare_set_values(const void *a, const void *b)
+{
+	int64_t va = *(const int64_t *) a, vb = *(const int64_t *) b;
+
+	return va < vb ? -1 : va > vb;
+}
+
+static
+struct ir_op *make_set_compare(struct filter_parser_ctx *ctx,
+		struct filter_node *expr, enum op_type bin_op_type,
+		const char *op_str, int64_t value)
+{
+	struct ir_op *op, *left, *right;
+
+	left = generate_ir_recursive(ctx, expr, IR_LEFT);
+	if (!left)
+		return NULL;
+	right = make_op_load_numeric(value, IR_RIGHT);
+	if (!right) {
+		filter_free_ir_recursive(left);
+		return NULL;
+	}
+	op = make_op_binary_compare(bin_op_type, op_str, left, right, IR_LEFT);
+	if (!op) {
+		filter_free_ir_recursive(right);
+		filter_free_ir_recursive(left);
+	}
+	return op;
+}
+
+/*
+ * Takes ownership of both children, which may be NULL on a previous error.
+ */
+static
+struct ir_op *make_set_logical(enum op_type bin_op_type, const char *op_str,
+		struct ir_op *left, struct ir_op *right, enum ir_side side)
+{
+	struct ir_op *op = NULL;
+
+	if (left && right)
+		op = make_op_binary_logical(bin_op_type, op_str, left, right,
+				side);
+	if (!op) {
+		if (right)
+			filter_free_ir_recursive(right);
+		if (left)
+			filter_free_ir_recursive(left);
+	}
+	return op;
+}
+
+/*
+ * Look up "expr" in the "nr" sorted distinct values with a balanced
+ * search tree of comparisons:
+ *
+ *   (expr < mid && lookup(lower half)) || (expr >= mid && lookup(upper half))
+ *
+ * so that an event only goes through O(log n) comparisons.
+ */
+static
+struct ir_op *make_set_lookup(struct filter_parser_ctx *ctx,
+		struct filter_node *expr, const int64_t *values, size_t nr,
+		enum ir_side side)
+{
+	struct ir_op *lower, *upper;
+	size_t mid, i;
+
+	if (nr <= SET_LINEAR_MAX) {
+		struct ir_op *op;
+
+		op = make_set_compare(ctx, expr, AST_OP_EQ, "==", values[0]);
+		if (nr == 1) {
+			if (op)
+				op->side = side;
+			return op;
+		}
+		for (i = 1; i < nr; i++) {
+			op = make_set_logical(AST_OP_OR, "||", op,
+					make_set_compare(ctx, expr, AST_OP_EQ,
+						"==", values[i]),
+					i == nr - 1 ? side : IR_LEFT);
+		}
+		return op;
+	}
+
+	mid = nr / 2;
+	lower = make_set_logical(AST_OP_AND, "&&",
+			make_set_compare(ctx, expr, AST_OP_LT, "<",
+				values[mid]),
+			make_set_lookup(ctx, expr, values, mid, IR_LEFT),
+			IR_LEFT);
+	upper = make_set_logical(AST_OP_AND, "&&",
+			make_set_compare(ctx, expr, AST_OP_GE, ">=",
+				values[mid]),
+			make_set_lookup(ctx, expr, values + mid, nr - mid,
+				IR_LEFT),
+			IR_LEFT);
+	return make_set_logical(AST_OP_OR, "||", lower, upper, side);
+}
+
+/*
+ * The tracers have no set lookup instruction: the set is sorted and
+ * expanded into comparisons they already interpret.
+ */
+static
+struct ir_op *make_op_set(struct filter_parser_ctx *ctx,
+		struct filter_node *node, enum ir_side side)
+{
+	struct ir_op *op;
+	struct filter_node *elem;
+	int64_t *values;
+	size_t nr = 0, nr_distinct, i;
+
+	for (elem = node->u.op.rchild; elem; elem = elem->u.expression.next)
+		nr++;
+	values = calloc(nr, sizeof(*values));
+	if (!values)
+		return NULL;
+	i = 0;
+	for (elem = node->u.op.rchild; elem; elem = elem->u.expression.next)
+		values[i++] = (int64_t) elem->u.expression.u.constant;
+	qsort(values, nr, sizeof(*values), compare_set_values);
+	nr_distinct = 1;
+	for (i = 1; i < nr; i++) {
+		if (values[i] != values[nr_distinct - 1])
+			values[nr_distinct++] = values[i];
+	}
+
+	op = make_set_lookup(ctx, node->u.op.lchild, values, nr_distinct,
+			side);
+	free(values);
+	return op;
+}
+
 static
 struct ir_op *make_op(struct filter_parser_ctx *ctx,
 		struct filter_node *node, enum ir_side side)
@@ -483,40 +709,44 @@ struct ir_op *make_op(struct filter_parser_ctx *ctx,
 
 	/*
 	 * Binary operators other than comparators and logical and/or
-	 * are not supported. If we ever want to support those, we will
+	 * are only supported between constants, and folded into a
+	 * constant. If we ever want to support those on fields, we will
 	 * need a stack for the general case rather than just 2
 	 * registers (see bytecode).
 	 */
 	case AST_OP_MUL:
 		op_str = "*";
-		goto error_not_supported;
+		goto arith_constant;
 	case AST_OP_DIV:
 		op_str = "/";
-		goto error_not_supported;
+		goto arith_constant;
 	case AST_OP_MOD:
 		op_str = "%";
-		goto error_not_supported;
+		goto arith_constant;
 	case AST_OP_PLUS:
 		op_str = "+";
-		goto error_not_supported;
+		goto arith_constant;
 	case AST_OP_MINUS:
 		op_str = "-";
-		goto error_not_supported;
+		goto arith_constant;
 	case AST_OP_RSHIFT:
 		op_str = ">>";
-		goto error_not_supported;
+		goto arith_constant;
 	case AST_OP_LSHIFT:
 		op_str = "<<";
-		goto error_not_supported;
+		goto arith_constant;
 	case AST_OP_BIN_AND:
 		op_str = "&";
-		goto error_not_supported;
+		goto arith_constant;
 	case AST_OP_BIN_OR:
 		op_str = "|";
-		goto error_not_supported;
+		goto arith_constant;
 	case AST_OP_BIN_XOR:
 		op_str = "^";
-		goto error_not_supported;
+		goto arith_constant;
+
+	case AST_OP_IN:
+		return make_op_set(ctx, node, side);
 
 	case AST_OP_EQ:
 	case AST_OP_NE:
@@ -586,10 +816,20 @@ struct ir_op *make_op(struct filter_parser_ctx *ctx,
 	}
 	return op;
 
-error_not_supported:
-	fprintf(stderr, "[error] %s: binary operation '%s' not supported\n",
-		__func__, op_str);
-	return NULL;
+arith_constant:
+	lchild = generate_ir_recursive(ctx, node->u.op.lchild, side);
+	if (!lchild)
+		return NULL;
+	rchild = generate_ir_recursive(ctx, node->u.op.rchild, side);
+	if (!rchild) {
+		filter_free_ir_recursive(lchild);
+		return NULL;
+	}
+	op = make_op_binary_arith_constant(node->u.op.type, op_str,
+			lchild, rchild, side);
+	filter_free_ir_recursive(rchild);
+	filter_free_ir_recursive(lchild);
+	return op;
 }
 
 static
@@ -651,8 +891,22 @@ struct ir_op *make_unary_op(struct filter_parser_ctx *ctx,
 	}
 	case AST_UNARY_BIN_NOT:
 	{
+		struct ir_op *op, *child;
+
+		/* Only supported on integer constants, see make_op(). */
 		op_str = "~";
-		goto error_not_supported;
+		child = generate_ir_recursive(ctx, node->u.unary_op.child,
+					side);
+		if (!child)
+			return NULL;
+		if (child->op != IR_OP_LOAD
+				|| child->data_type != IR_DATA_NUMERIC) {
+			filter_free_ir_recursive(child);
+			goto error_not_supported;
+		}
+		op = make_op_load_numeric(~child->u.load.u.num, side);
+		filter_free_ir_recursive(child);
+		return op;
 	}
 	}
 
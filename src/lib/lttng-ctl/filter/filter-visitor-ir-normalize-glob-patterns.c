@@ -55,6 +55,19 @@ int normalize_glob_patterns(struct ir_op *node)
 				assert(node->u.load.u.string.value);
 				strutils_normalize_star_glob_pattern(
 					node->u.load.u.string.value);
+
+				/*
+				 * A pattern such as `foo**` only has a star
+				 * at the end once normalized: it is matched
+				 * as a prefix by the tracer rather than by
+				 * the generic star globbing matcher.
+				 */
+				if (type == IR_LOAD_STRING_TYPE_GLOB_STAR &&
+						strutils_is_star_at_the_end_only_glob_pattern(
+							node->u.load.u.string.value)) {
+					node->u.load.u.string.type =
+						IR_LOAD_STRING_TYPE_GLOB_STAR_END;
+				}
 			}
 		}
 
@@ -86,6 +99,9 @@ int normalize_glob_patterns(struct ir_op *node)
  * This function normalizes all the globbing literal strings with
  * utils_normalize_glob_pattern(). See the documentation of
  * utils_normalize_glob_pattern() for more details.
+ *
+ * The full star globbing patterns which end up with a single star at
+ * their end are downgraded to IR_LOAD_STRING_TYPE_GLOB_STAR_END.
  */
 LTTNG_HIDDEN
 int filter_visitor_ir_normalize_glob_patterns(struct filter_parser_ctx *ctx)
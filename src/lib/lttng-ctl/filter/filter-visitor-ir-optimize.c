@@ -0,0 +1,313 @@
+/*
+ * filter-visitor-ir-optimize.c
+ *
+ * LTTng filter IR constant folding
+ *
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License, version 2.1 only,
+ * as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include "filter-ast.h"
+#include "filter-parser.h"
+#include "filter-ir.h"
+
+#include <common/macros.h>
+
+static
+int is_constant(struct ir_op *node)
+{
+	return node->op == IR_OP_LOAD && (node->data_type == IR_DATA_NUMERIC
+			|| node->data_type == IR_DATA_FLOAT);
+}
+
+/*
+ * Operands of a logical operator are evaluated to a signed integer, a float
+ * being cast (see the bytecode generation). The logical operator evaluates
+ * to the value of its last evaluated operand.
+ */
+static
+int64_t constant_value(struct ir_op *node)
+{
+	if (node->data_type == IR_DATA_FLOAT) {
+		return (int64_t) node->u.load.u.flt;
+	}
+	return node->u.load.u.num;
+}
+
+static
+int constant_is_true(struct ir_op *node)
+{
+	return constant_value(node) != 0;
+}
+
+/*
+ * Comparators and the logical not evaluate to 0 or 1: these can replace a
+ * logical operator of which they are an operand.
+ */
+static
+int is_boolean(struct ir_op *node)
+{
+	switch (node->op) {
+	case IR_OP_BINARY:
+		return 1;
+	case IR_OP_UNARY:
+		return node->u.unary.type == AST_UNARY_NOT;
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Turn a node into a numeric constant, freeing its children.
+ */
+static
+void set_numeric_constant(struct ir_op *node, int64_t v)
+{
+	switch (node->op) {
+	case IR_OP_UNARY:
+		filter_free_ir_recursive(node->u.unary.child);
+		break;
+	case IR_OP_BINARY:
+		filter_free_ir_recursive(node->u.binary.left);
+		filter_free_ir_recursive(node->u.binary.right);
+		break;
+	case IR_OP_LOGICAL:
+		filter_free_ir_recursive(node->u.logical.left);
+		filter_free_ir_recursive(node->u.logical.right);
+		break;
+	case IR_OP_LOAD:
+		/* Numeric or float, nothing to free. */
+		break;
+	default:
+		assert(0);
+	}
+	node->op = IR_OP_LOAD;
+	node->data_type = IR_DATA_NUMERIC;
+	node->signedness = IR_SIGNED;
+	node->u.load.u.num = v;
+}
+
+/*
+ * Replace "*node_p" by "child", one of its children, freeing the others.
+ */
+static
+void replace_by_child(struct ir_op **node_p, struct ir_op **child_p)
+{
+	struct ir_op *child = *child_p;
+
+	*child_p = NULL;
+	child->side = (*node_p)->side;
+	filter_free_ir_recursive(*node_p);
+	*node_p = child;
+}
+
+static
+int compare_constants(enum op_type type, struct ir_op *left,
+		struct ir_op *right)
+{
+	if (left->data_type == IR_DATA_FLOAT
+			|| right->data_type == IR_DATA_FLOAT) {
+		double l, r;
+
+		l = left->data_type == IR_DATA_FLOAT ?
+			left->u.load.u.flt : (double) left->u.load.u.num;
+		r = right->data_type == IR_DATA_FLOAT ?
+			right->u.load.u.flt : (double) right->u.load.u.num;
+		switch (type) {
+		case AST_OP_EQ:
+			return l == r;
+		case AST_OP_NE:
+			return l != r;
+		case AST_OP_GT:
+			return l > r;
+		case AST_OP_LT:
+			return l < r;
+		case AST_OP_GE:
+			return l >= r;
+		case AST_OP_LE:
+		default:
+			return l <= r;
+		}
+	} else {
+		int64_t l = left->u.load.u.num, r = right->u.load.u.num;
+
+		switch (type) {
+		case AST_OP_EQ:
+			return l == r;
+		case AST_OP_NE:
+			return l != r;
+		case AST_OP_GT:
+			return l > r;
+		case AST_OP_LT:
+			return l < r;
+		case AST_OP_GE:
+			return l >= r;
+		case AST_OP_LE:
+		default:
+			return l <= r;
+		}
+	}
+}
+
+static
+int optimize_recursive(struct ir_op **node_p);
+
+static
+int optimize_unary(struct ir_op **node_p)
+{
+	int ret;
+	struct ir_op *node = *node_p, *child;
+
+	ret = optimize_recursive(&node->u.unary.child);
+	if (ret)
+		return ret;
+	child = node->u.unary.child;
+
+	switch (node->u.unary.type) {
+	case AST_UNARY_PLUS:
+		replace_by_child(node_p, &node->u.unary.child);
+		break;
+	case AST_UNARY_MINUS:
+		if (!is_constant(child))
+			break;
+		if (child->data_type == IR_DATA_FLOAT) {
+			child->u.load.u.flt = -child->u.load.u.flt;
+		} else {
+			child->u.load.u.num = (int64_t) -(uint64_t) child->u.load.u.num;
+		}
+		replace_by_child(node_p, &node->u.unary.child);
+		break;
+	case AST_UNARY_NOT:
+		if (is_constant(child)) {
+			set_numeric_constant(node,
+				child->data_type == IR_DATA_FLOAT ?
+					child->u.load.u.flt == 0 :
+					child->u.load.u.num == 0);
+		} else if (child->op == IR_OP_UNARY
+				&& child->u.unary.type == AST_UNARY_NOT
+				&& is_boolean(child->u.unary.child)) {
+			/* !!X is X when X is 0 or 1. */
+			replace_by_child(&node->u.unary.child,
+					&child->u.unary.child);
+			replace_by_child(node_p, &node->u.unary.child);
+		}
+		break;
+	default:
+		break;
+	}
+	return 0;
+}
+
+/*
+ * An operand known to be true for || or false for && decides the result.
+ * Only the left operand can be dropped that way: the right operand is
+ * evaluated after the left one, which may fail at runtime (e.g. missing
+ * field), and must be kept. An operand which doesn't decide the result can be
+ * dropped if the other operand already evaluates to 0 or 1.
+ */
+static
+int optimize_logical(struct ir_op **node_p)
+{
+	int ret, decides;
+	struct ir_op *node = *node_p, *left, *right;
+
+	ret = optimize_recursive(&node->u.logical.left);
+	if (ret)
+		return ret;
+	ret = optimize_recursive(&node->u.logical.right);
+	if (ret)
+		return ret;
+	left = node->u.logical.left;
+	right = node->u.logical.right;
+
+	if (is_constant(left)) {
+		decides = constant_is_true(left) ==
+				(node->u.logical.type == AST_OP_OR);
+		if (decides) {
+			set_numeric_constant(node, constant_value(left));
+		} else if (is_constant(right)) {
+			set_numeric_constant(node, constant_value(right));
+		} else if (is_boolean(right)) {
+			replace_by_child(node_p, &node->u.logical.right);
+		}
+	} else if (is_constant(right)) {
+		decides = constant_is_true(right) ==
+				(node->u.logical.type == AST_OP_OR);
+		if (!decides && is_boolean(left)) {
+			replace_by_child(node_p, &node->u.logical.left);
+		}
+	}
+	return 0;
+}
+
+static
+int optimize_recursive(struct ir_op **node_p)
+{
+	int ret;
+	struct ir_op *node = *node_p;
+
+	switch (node->op) {
+	case IR_OP_UNKNOWN:
+	default:
+		fprintf(stderr, "[error] %s: unknown op type\n", __func__);
+		return -EINVAL;
+
+	case IR_OP_ROOT:
+		ret = optimize_recursive(&node->u.root.child);
+		if (ret)
+			return ret;
+		node->data_type = node->u.root.child->data_type;
+		node->signedness = node->u.root.child->signedness;
+		return 0;
+	case IR_OP_LOAD:
+		return 0;
+	case IR_OP_UNARY:
+		return optimize_unary(node_p);
+	case IR_OP_BINARY:
+		ret = optimize_recursive(&node->u.binary.left);
+		if (ret)
+			return ret;
+		ret = optimize_recursive(&node->u.binary.right);
+		if (ret)
+			return ret;
+		if (is_constant(node->u.binary.left)
+				&& is_constant(node->u.binary.right)) {
+			set_numeric_constant(node,
+				compare_constants(node->u.binary.type,
+					node->u.binary.left,
+					node->u.binary.right));
+		}
+		return 0;
+	case IR_OP_LOGICAL:
+		return optimize_logical(node_p);
+	}
+}
+
+/*
+ * Fold the operators whose operands are constants and drop the logical
+ * operands which don't change the result.
+ */
+LTTNG_HIDDEN
+int filter_visitor_ir_optimize(struct filter_parser_ctx *ctx)
+{
+	return optimize_recursive(&ctx->ir_root);
+}
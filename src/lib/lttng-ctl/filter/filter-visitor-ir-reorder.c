@@ -0,0 +1,310 @@
+/*
+ * filter-visitor-ir-reorder.c
+ *
+ * LTTng filter IR logical operand reordering
+ *
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License, version 2.1 only,
+ * as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include "filter-ast.h"
+#include "filter-parser.h"
+#include "filter-ir.h"
+
+#include <common/macros.h>
+
+/*
+ * Relative evaluation costs of the operands, loosely based on the work of
+ * the interpreter.
+ */
+#define COST_LOAD		1
+#define COST_COMPARE		1
+#define COST_COMPARE_UNKNOWN	5
+#define COST_COMPARE_STRING	10
+#define COST_COMPARE_GLOB	20
+
+/*
+ * Estimated probabilities, in percent, that a comparison is true: an
+ * equality is assumed to be selective.
+ */
+#define PROBABILITY_EQ		10
+#define PROBABILITY_NE		90
+#define PROBABILITY_DEFAULT	50
+
+struct chain_operand {
+	struct ir_op *op;
+	unsigned long rank;
+	/* Position in the chain, to keep the sort stable. */
+	unsigned int index;
+};
+
+static
+int is_string(struct ir_op *node)
+{
+	return node->op == IR_OP_LOAD && node->data_type == IR_DATA_STRING;
+}
+
+static
+int is_ref(struct ir_op *node)
+{
+	return node->op == IR_OP_LOAD &&
+		(node->data_type == IR_DATA_FIELD_REF ||
+			node->data_type == IR_DATA_GET_CONTEXT_REF);
+}
+
+/*
+ * Cost of a comparison itself, without the cost of its operands.
+ */
+static
+unsigned long compare_cost(struct ir_op *node)
+{
+	struct ir_op *left = node->u.binary.left, *right = node->u.binary.right;
+
+	if ((is_string(left) && left->u.load.u.string.type ==
+				IR_LOAD_STRING_TYPE_GLOB_STAR) ||
+			(is_string(right) && right->u.load.u.string.type ==
+				IR_LOAD_STRING_TYPE_GLOB_STAR)) {
+		return COST_COMPARE_GLOB;
+	} else if (is_string(left) || is_string(right)) {
+		return COST_COMPARE_STRING;
+	} else if (is_ref(left) && is_ref(right)) {
+		/* Both may be strings. */
+		return COST_COMPARE_UNKNOWN;
+	}
+	return COST_COMPARE;
+}
+
+static
+unsigned int estimate_probability(struct ir_op *node)
+{
+	if (node->op != IR_OP_BINARY) {
+		return PROBABILITY_DEFAULT;
+	}
+	switch (node->u.binary.type) {
+	case AST_OP_EQ:
+		return PROBABILITY_EQ;
+	case AST_OP_NE:
+		return PROBABILITY_NE;
+	default:
+		return PROBABILITY_DEFAULT;
+	}
+}
+
+/*
+ * The expected cost of a chain is the lowest when its operands are sorted by
+ * cost over the probability that they end the evaluation: being false for &&,
+ * being true for ||.
+ */
+static
+unsigned long operand_rank(struct ir_op *node, unsigned long cost,
+		enum op_type type)
+{
+	unsigned int probability = estimate_probability(node);
+
+	if (type == AST_OP_AND) {
+		probability = 100 - probability;
+	}
+	return cost * 100 * 100 / probability;
+}
+
+static
+int compare_chain_operands(const void *a, const void *b)
+{
+	const struct chain_operand *oa = a, *ob = b;
+
+	if (oa->rank != ob->rank) {
+		return oa->rank < ob->rank ? -1 : 1;
+	}
+	return oa->index < ob->index ? -1 : oa->index > ob->index;
+}
+
+static
+unsigned int count_chain_operands(struct ir_op *node, enum op_type type)
+{
+	if (node->op != IR_OP_LOGICAL || node->u.logical.type != type) {
+		return 1;
+	}
+	return count_chain_operands(node->u.logical.left, type) +
+		count_chain_operands(node->u.logical.right, type);
+}
+
+/*
+ * Collect the operands of the chain in evaluation order, and its logical
+ * operators children first.
+ */
+static
+void collect_chain(struct ir_op *node, enum op_type type,
+		struct chain_operand *operands, unsigned int *nr_operands,
+		struct ir_op **nodes, unsigned int *nr_nodes)
+{
+	if (node->op != IR_OP_LOGICAL || node->u.logical.type != type) {
+		operands[(*nr_operands)++].op = node;
+		return;
+	}
+	collect_chain(node->u.logical.left, type, operands, nr_operands,
+			nodes, nr_nodes);
+	collect_chain(node->u.logical.right, type, operands, nr_operands,
+			nodes, nr_nodes);
+	nodes[(*nr_nodes)++] = node;
+}
+
+static
+int reorder_recursive(struct ir_op *node, int truth, unsigned long *cost);
+
+/*
+ * Reorder a chain of logical operators of the same type whose value is only
+ * used as a truth value. The filter expressions have no side effect, hence
+ * only the truth value of the chain is kept.
+ *
+ * The estimated cost of the chain, an upper bound with all its operands
+ * evaluated, is returned in "cost".
+ */
+static
+int reorder_chain(struct ir_op *node, unsigned long *cost)
+{
+	int ret = 0;
+	enum op_type type = node->u.logical.type;
+	unsigned int nr_operands = 0, nr_nodes = 0, i;
+	struct chain_operand *operands;
+	struct ir_op **nodes;
+
+	i = count_chain_operands(node, type);
+	operands = calloc(i, sizeof(*operands));
+	nodes = calloc(i - 1, sizeof(*nodes));
+	if (!operands || !nodes) {
+		ret = -ENOMEM;
+		goto end;
+	}
+	collect_chain(node, type, operands, &nr_operands, nodes, &nr_nodes);
+	assert(nodes[nr_nodes - 1] == node);
+
+	*cost = 0;
+	for (i = 0; i < nr_operands; i++) {
+		unsigned long operand_cost;
+
+		ret = reorder_recursive(operands[i].op, 1, &operand_cost);
+		if (ret) {
+			goto end;
+		}
+		operands[i].rank = operand_rank(operands[i].op, operand_cost,
+				type);
+		operands[i].index = i;
+		*cost += operand_cost;
+	}
+
+	/*
+	 * Generated filters may chain thousands of operands, often already
+	 * in order.
+	 */
+	for (i = 1; i < nr_operands; i++) {
+		if (operands[i - 1].rank > operands[i].rank) {
+			qsort(operands, nr_operands, sizeof(*operands),
+					compare_chain_operands);
+			break;
+		}
+	}
+
+	/* Rebuild a left-deep chain, keeping the same top node. */
+	for (i = 0; i < nr_nodes; i++) {
+		struct ir_op *logical = nodes[i];
+
+		logical->u.logical.left = i ? nodes[i - 1] : operands[0].op;
+		logical->u.logical.left->side = IR_LEFT;
+		logical->u.logical.right = operands[i + 1].op;
+		/* Both children are left, see the IR generation. */
+		logical->u.logical.right->side = IR_LEFT;
+	}
+end:
+	free(operands);
+	free(nodes);
+	return ret;
+}
+
+/*
+ * "truth" is set when only the truth value of the node is used: at the
+ * root, under a logical not, or as operand of a logical operator itself used
+ * as a truth value. A logical operator evaluates to the value of its last
+ * evaluated operand, which a comparison may use.
+ *
+ * The estimated evaluation cost of the node is returned in "cost", computed
+ * along the reordering so that each node is only visited once.
+ */
+static
+int reorder_recursive(struct ir_op *node, int truth, unsigned long *cost)
+{
+	int ret;
+	unsigned long left_cost, right_cost;
+
+	switch (node->op) {
+	case IR_OP_UNKNOWN:
+	default:
+		fprintf(stderr, "[error] %s: unknown op type\n", __func__);
+		return -EINVAL;
+
+	case IR_OP_ROOT:
+		return reorder_recursive(node->u.root.child, 1, cost);
+	case IR_OP_LOAD:
+		*cost = is_ref(node) ? COST_LOAD : 0;
+		return 0;
+	case IR_OP_UNARY:
+		ret = reorder_recursive(node->u.unary.child,
+				node->u.unary.type == AST_UNARY_NOT, cost);
+		if (ret)
+			return ret;
+		*cost += 1;
+		return 0;
+	case IR_OP_BINARY:
+		ret = reorder_recursive(node->u.binary.left, 0, &left_cost);
+		if (ret)
+			return ret;
+		ret = reorder_recursive(node->u.binary.right, 0, &right_cost);
+		if (ret)
+			return ret;
+		*cost = left_cost + right_cost + compare_cost(node);
+		return 0;
+	case IR_OP_LOGICAL:
+		if (truth) {
+			return reorder_chain(node, cost);
+		}
+		ret = reorder_recursive(node->u.logical.left, 0, &left_cost);
+		if (ret)
+			return ret;
+		ret = reorder_recursive(node->u.logical.right, 0, &right_cost);
+		if (ret)
+			return ret;
+		/* Upper bound, both operands evaluated. */
+		*cost = left_cost + right_cost;
+		return 0;
+	}
+}
+
+/*
+ * Evaluate the cheap and selective operands of the && and || chains first,
+ * e.g. the integer comparisons before the string ones.
+ */
+LTTNG_HIDDEN
+int filter_visitor_ir_reorder(struct filter_parser_ctx *ctx)
+{
+	unsigned long cost;
+
+	return reorder_recursive(ctx->ir_root, 1, &cost);
+}
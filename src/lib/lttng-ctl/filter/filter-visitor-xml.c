@@ -210,16 +210,31 @@ int recursive_visit_print(struct filter_node *node, FILE *stream, int indent)
 		case AST_OP_LE:
 			fprintf(stream, "\"<=\"");
 			break;
+		case AST_OP_IN:
+			fprintf(stream, "\"in\"");
+			break;
 		}
 		fprintf(stream, ">\n");
 		ret = recursive_visit_print(node->u.op.lchild,
 					stream, indent + 1);
 		if (ret)
 			return ret;
-		ret = recursive_visit_print(node->u.op.rchild,
-					stream, indent + 1);
-		if (ret)
-			return ret;
+		if (node->u.op.type == AST_OP_IN) {
+			struct filter_node *elem;
+
+			for (elem = node->u.op.rchild; elem;
+					elem = elem->u.expression.next) {
+				ret = recursive_visit_print(elem,
+						stream, indent + 1);
+				if (ret)
+					return ret;
+			}
+		} else {
+			ret = recursive_visit_print(node->u.op.rchild,
+						stream, indent + 1);
+			if (ret)
+				return ret;
+		}
 		print_tabs(stream, indent);
 		fprintf(stream, "</op>\n");
 		return ret;
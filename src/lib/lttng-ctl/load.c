@@ -629,8 +629,30 @@ int lttng_load_session(struct lttng_load_session_attr *attr)
 			attr->session_name : NULL;
 
 	ret = config_load_session(url, session_name, attr->overwrite, 0,
-			attr->override_attr);
+			attr->override_attr, 1, 1);
 
 end:
 	return ret;
 }
+
+int lttng_load_session_definition(const char *definition, size_t size,
+		int overwrite)
+{
+	int ret;
+	struct lttcomm_session_msg lsm;
+
+	if (!definition || !size || size > UINT32_MAX) {
+		ret = -LTTNG_ERR_INVALID;
+		goto end;
+	}
+
+	memset(&lsm, 0, sizeof(lsm));
+	lsm.cmd_type = LTTNG_LOAD_SESSION_DEFINITION;
+	lsm.u.load_definition.size = (uint32_t) size;
+	lsm.u.load_definition.overwrite = !!overwrite;
+
+	ret = lttng_ctl_ask_sessiond_varlen_no_cmd_header(&lsm,
+			(void *) definition, size, NULL);
+end:
+	return ret;
+}
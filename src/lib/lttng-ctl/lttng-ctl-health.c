@@ -48,6 +48,11 @@ enum health_component {
 struct lttng_health_thread {
 	struct lttng_health *p;
 	int state;
+	/* Set if the component sent the statistics of the thread type. */
+	int has_stats;
+	uint64_t busy_ns;
+	uint64_t idle_ns;
+	uint64_t latency[LTTNG_HEALTH_LATENCY_NR_BUCKETS];
 };
 
 struct lttng_health {
@@ -70,6 +75,9 @@ const char *sessiond_thread_name[NR_HEALTH_SESSIOND_TYPES] = {
 	[ HEALTH_SESSIOND_TYPE_HT_CLEANUP ] = "Session daemon hash table cleanup",
 	[ HEALTH_SESSIOND_TYPE_APP_MANAGE_NOTIFY ] = "Session daemon application notification manager",
 	[ HEALTH_SESSIOND_TYPE_APP_REG_DISPATCH ] = "Session daemon application registration dispatcher",
+	[ HEALTH_SESSIOND_TYPE_APP_UPDATE ] = "Session daemon application update",
+	[ HEALTH_SESSIOND_TYPE_CMD_WORKER ] = "Session daemon command worker",
+	[ HEALTH_SESSIOND_TYPE_NOTIFICATION_EVALUATOR ] = "Session daemon notification evaluator",
 };
 
 static
@@ -79,6 +87,8 @@ const char *consumerd_thread_name[NR_HEALTH_CONSUMERD_TYPES] = {
 	[ HEALTH_CONSUMERD_TYPE_DATA ] = "Consumer daemon data",
 	[ HEALTH_CONSUMERD_TYPE_SESSIOND ] = "Consumer daemon session daemon command manager",
 	[ HEALTH_CONSUMERD_TYPE_METADATA_TIMER ] = "Consumer daemon metadata timer",
+	[ HEALTH_CONSUMERD_TYPE_WRITEBACK ] = "Consumer daemon writeback",
+	[ HEALTH_CONSUMERD_TYPE_SPOOL ] = "Consumer daemon spool",
 };
 
 static
@@ -89,6 +99,7 @@ const char *relayd_thread_name[NR_HEALTH_RELAYD_TYPES] = {
 	[ HEALTH_RELAYD_TYPE_LIVE_DISPATCHER ] = "Relay daemon live dispatcher",
 	[ HEALTH_RELAYD_TYPE_LIVE_WORKER ] = "Relay daemon live worker",
 	[ HEALTH_RELAYD_TYPE_LIVE_LISTENER ] = "Relay daemon live listener",
+	[ HEALTH_RELAYD_TYPE_TRACEFILE_MANAGER ] = "Relay daemon tracefile manager",
 };
 
 static
@@ -98,6 +109,47 @@ const char **thread_name[NR_HEALTH_COMPONENT] = {
 	[ HEALTH_COMPONENT_RELAYD ] = relayd_thread_name,
 };
 
+/*
+ * Receive the statistics following the reply of the components supporting
+ * them. The older ones close the socket after the reply.
+ */
+static
+void recv_health_stats(struct lttng_health *health, int sock)
+{
+	struct health_comm_stats stats;
+	struct health_comm_type_stats type_stats;
+	uint32_t i;
+	ssize_t ret;
+
+	for (i = 0; i < health->nr_threads; i++) {
+		health->thread[i].has_stats = 0;
+	}
+
+	ret = lttcomm_recv_unix_sock(sock, &stats, sizeof(stats));
+	if (ret != sizeof(stats) ||
+			stats.nr_buckets != LTTNG_HEALTH_LATENCY_NR_BUCKETS) {
+		return;
+	}
+	for (i = 0; i < stats.nr_types; i++) {
+		struct lttng_health_thread *thread;
+
+		ret = lttcomm_recv_unix_sock(sock, &type_stats,
+				sizeof(type_stats));
+		if (ret != sizeof(type_stats)) {
+			return;
+		}
+		if (i >= health->nr_threads) {
+			continue;
+		}
+		thread = &health->thread[i];
+		thread->busy_ns = type_stats.busy_ns;
+		thread->idle_ns = type_stats.idle_ns;
+		memcpy(thread->latency, type_stats.latency,
+				sizeof(thread->latency));
+		thread->has_stats = 1;
+	}
+}
+
 /*
  * Set health socket path.
  *
@@ -297,6 +349,7 @@ retry:
 			health->thread[i].state = 0;
 		}
 	}
+	recv_health_stats(health, sock);
 
 close_error:
 	{
@@ -361,3 +414,31 @@ const char *lttng_health_thread_name(const struct lttng_health_thread *thread)
 	nr = thread - &thread->p->thread[0];
 	return thread_name[thread->p->component][nr];
 }
+
+int lttng_health_thread_get_busy_time(const struct lttng_health_thread *thread,
+		uint64_t *busy_ns, uint64_t *idle_ns)
+{
+	if (!thread || !busy_ns || !idle_ns) {
+		return -EINVAL;
+	}
+	if (!thread->has_stats) {
+		return -ENOENT;
+	}
+	*busy_ns = thread->busy_ns;
+	*idle_ns = thread->idle_ns;
+	return 0;
+}
+
+int lttng_health_thread_get_latency_histogram(
+		const struct lttng_health_thread *thread,
+		const uint64_t **buckets)
+{
+	if (!thread || !buckets) {
+		return -EINVAL;
+	}
+	if (!thread->has_stats) {
+		return -ENOENT;
+	}
+	*buckets = thread->latency;
+	return 0;
+}
@@ -28,6 +28,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <urcu/tls-compat.h>
 
 #include <common/common.h>
 #include <common/defaults.h>
@@ -61,13 +62,23 @@ do {								\
 #endif
 
 
-/* Socket to session daemon for communication */
-static int sessiond_socket;
-static char sessiond_sock_path[PATH_MAX];
+/*
+ * Connection to the session daemon. Each thread has its own so that commands
+ * can be sent concurrently.
+ */
+struct sessiond_connection {
+	/* Socket to session daemon for communication */
+	int socket;
+	int connected;
+	/* Kept open across commands by lttng_persistent_connection_open(). */
+	int persistent;
+	char sock_path[PATH_MAX];
+};
+
+static DEFINE_URCU_TLS(struct sessiond_connection, sessiond_connection);
 
 /* Variables */
 static char *tracing_group;
-static int connected;
 
 /* Global */
 
@@ -130,15 +141,15 @@ static int send_session_msg(struct lttcomm_session_msg *lsm)
 {
 	int ret;
 
-	if (!connected) {
+	if (!URCU_TLS(sessiond_connection).connected) {
 		ret = -LTTNG_ERR_NO_SESSIOND;
 		goto end;
 	}
 
 	DBG("LSM cmd type : %d", lsm->cmd_type);
 
-	ret = lttcomm_send_creds_unix_sock(sessiond_socket, lsm,
-			sizeof(struct lttcomm_session_msg));
+	ret = lttcomm_send_creds_unix_sock(URCU_TLS(sessiond_connection).socket,
+			lsm, sizeof(struct lttcomm_session_msg));
 	if (ret < 0) {
 		ret = -LTTNG_ERR_FATAL;
 	}
@@ -157,7 +168,7 @@ static int send_session_varlen(const void *data, size_t len)
 {
 	int ret;
 
-	if (!connected) {
+	if (!URCU_TLS(sessiond_connection).connected) {
 		ret = -LTTNG_ERR_NO_SESSIOND;
 		goto end;
 	}
@@ -167,7 +178,8 @@ static int send_session_varlen(const void *data, size_t len)
 		goto end;
 	}
 
-	ret = lttcomm_send_unix_sock(sessiond_socket, data, len);
+	ret = lttcomm_send_unix_sock(URCU_TLS(sessiond_connection).socket,
+			data, len);
 	if (ret < 0) {
 		ret = -LTTNG_ERR_FATAL;
 	}
@@ -186,12 +198,13 @@ static int recv_data_sessiond(void *buf, size_t len)
 {
 	int ret;
 
-	if (!connected) {
+	if (!URCU_TLS(sessiond_connection).connected) {
 		ret = -LTTNG_ERR_NO_SESSIOND;
 		goto end;
 	}
 
-	ret = lttcomm_recv_unix_sock(sessiond_socket, buf, len);
+	ret = lttcomm_recv_unix_sock(URCU_TLS(sessiond_connection).socket,
+			buf, len);
 	if (ret < 0) {
 		ret = -LTTNG_ERR_FATAL;
 	}
@@ -288,7 +301,8 @@ error:
 }
 
 /*
- * Set sessiond socket path by putting it in the global sessiond_sock_path
+ * Set sessiond socket path by putting it in the sock_path of the connection
+ * of the calling thread
  * variable.
  *
  * Returns 0 on success, negative value on failure (the sessiond socket path
@@ -307,8 +321,9 @@ static int set_session_daemon_path(void)
 	}
 
 	if ((uid == 0) || in_tgroup) {
-		lttng_ctl_copy_string(sessiond_sock_path,
-				DEFAULT_GLOBAL_CLIENT_UNIX_SOCK, sizeof(sessiond_sock_path));
+		lttng_ctl_copy_string(URCU_TLS(sessiond_connection).sock_path,
+				DEFAULT_GLOBAL_CLIENT_UNIX_SOCK,
+				sizeof(URCU_TLS(sessiond_connection).sock_path));
 	}
 
 	if (uid != 0) {
@@ -316,7 +331,7 @@ static int set_session_daemon_path(void)
 
 		if (in_tgroup) {
 			/* Tracing group. */
-			ret = try_connect_sessiond(sessiond_sock_path);
+			ret = try_connect_sessiond(URCU_TLS(sessiond_connection).sock_path);
 			if (ret >= 0) {
 				goto end;
 			}
@@ -330,9 +345,11 @@ static int set_session_daemon_path(void)
 		 * With GNU C >= 2.1, snprintf returns the required size
 		 * (excluding closing null)
 		 */
-		ret = snprintf(sessiond_sock_path, sizeof(sessiond_sock_path),
+		ret = snprintf(URCU_TLS(sessiond_connection).sock_path,
+				sizeof(URCU_TLS(sessiond_connection).sock_path),
 				DEFAULT_HOME_CLIENT_UNIX_SOCK, utils_get_home_dir());
-		if ((ret < 0) || (ret >= sizeof(sessiond_sock_path))) {
+		if ((ret < 0) || (ret >=
+				sizeof(URCU_TLS(sessiond_connection).sock_path))) {
 			goto error;
 		}
 	}
@@ -343,6 +360,36 @@ error:
 	return -1;
 }
 
+static int disconnect_sessiond(void);
+
+/*
+ * Ask the session daemon to keep the connection open after the replies.
+ *
+ * On success, return 0. On error, return -1.
+ */
+static int request_persistent_connection(void)
+{
+	int ret;
+	struct lttcomm_session_msg lsm;
+	struct lttcomm_lttng_msg llm;
+
+	memset(&lsm, 0, sizeof(lsm));
+	lsm.cmd_type = LTTNG_PERSISTENT_CONNECTION;
+	ret = send_session_msg(&lsm);
+	if (ret < 0) {
+		goto error;
+	}
+	ret = recv_data_sessiond(&llm, sizeof(llm));
+	if (ret < 0 || llm.ret_code != LTTNG_OK || llm.data_size ||
+			llm.cmd_header_size) {
+		goto error;
+	}
+	return 0;
+
+error:
+	return -1;
+}
+
 /*
  * Connect to the LTTng session daemon.
  *
@@ -353,7 +400,7 @@ static int connect_sessiond(void)
 	int ret;
 
 	/* Don't try to connect if already connected. */
-	if (connected) {
+	if (URCU_TLS(sessiond_connection).connected) {
 		return 0;
 	}
 
@@ -363,13 +410,21 @@ static int connect_sessiond(void)
 	}
 
 	/* Connect to the sesssion daemon. */
-	ret = lttcomm_connect_unix_sock(sessiond_sock_path);
+	ret = lttcomm_connect_unix_sock(URCU_TLS(sessiond_connection).sock_path);
 	if (ret < 0) {
 		goto error;
 	}
 
-	sessiond_socket = ret;
-	connected = 1;
+	URCU_TLS(sessiond_connection).socket = ret;
+	URCU_TLS(sessiond_connection).connected = 1;
+
+	if (URCU_TLS(sessiond_connection).persistent) {
+		ret = request_persistent_connection();
+		if (ret < 0) {
+			disconnect_sessiond();
+			goto error;
+		}
+	}
 
 	return 0;
 
@@ -386,10 +441,10 @@ static int disconnect_sessiond(void)
 {
 	int ret = 0;
 
-	if (connected) {
-		ret = lttcomm_close_unix_sock(sessiond_socket);
-		sessiond_socket = 0;
-		connected = 0;
+	if (URCU_TLS(sessiond_connection).connected) {
+		ret = lttcomm_close_unix_sock(URCU_TLS(sessiond_connection).socket);
+		URCU_TLS(sessiond_connection).socket = 0;
+		URCU_TLS(sessiond_connection).connected = 0;
 	}
 
 	return ret;
@@ -455,7 +510,7 @@ int lttng_ctl_ask_sessiond_varlen(struct lttcomm_session_msg *lsm,
 		void **user_payload_buf, void **user_cmd_header_buf,
 		size_t *user_cmd_header_len)
 {
-	int ret;
+	int ret, sock_error = 1;
 	size_t payload_len;
 	struct lttcomm_lttng_msg llm;
 
@@ -488,6 +543,8 @@ int lttng_ctl_ask_sessiond_varlen(struct lttcomm_session_msg *lsm,
 	/* Check error code if OK */
 	if (llm.ret_code != LTTNG_OK) {
 		ret = -llm.ret_code;
+		/* A persistent connection is reused if no data is left. */
+		sock_error = llm.cmd_header_size || llm.data_size;
 		goto end;
 	}
 
@@ -506,9 +563,12 @@ int lttng_ctl_ask_sessiond_varlen(struct lttcomm_session_msg *lsm,
 	}
 
 	ret = llm.data_size;
+	sock_error = 0;
 
 end:
-	disconnect_sessiond();
+	if (!URCU_TLS(sessiond_connection).persistent || sock_error) {
+		disconnect_sessiond();
+	}
 	return ret;
 }
 
@@ -604,6 +664,7 @@ static int _lttng_stop_tracing(const char *session_name, int wait)
 {
 	int ret, data_ret;
 	struct lttcomm_session_msg lsm;
+	useconds_t wait_time = DEFAULT_DATA_AVAILABILITY_MIN_WAIT_TIME;
 
 	if (session_name == NULL) {
 		return -LTTNG_ERR_INVALID;
@@ -638,7 +699,9 @@ static int _lttng_stop_tracing(const char *session_name, int wait)
 		 * call returned value indicates availability.
 		 */
 		if (data_ret) {
-			usleep(DEFAULT_DATA_AVAILABILITY_WAIT_TIME);
+			usleep(wait_time);
+			wait_time = min_t(useconds_t, wait_time * 2,
+					DEFAULT_DATA_AVAILABILITY_WAIT_TIME);
 		}
 	} while (data_ret != 0);
 
@@ -942,6 +1005,18 @@ static int generate_filter(char *filter_expression,
 		goto parse_error;
 	}
 
+	ret = filter_visitor_ir_optimize(ctx);
+	if (ret) {
+		ret = -LTTNG_ERR_FILTER_INVAL;
+		goto parse_error;
+	}
+
+	ret = filter_visitor_ir_reorder(ctx);
+	if (ret) {
+		ret = -LTTNG_ERR_FILTER_INVAL;
+		goto parse_error;
+	}
+
 	dbg_printf("done\n");
 
 	dbg_printf("Generating bytecode... ");
@@ -1529,6 +1604,58 @@ int lttng_untrack_pid(struct lttng_handle *handle, int pid)
 	return lttng_ctl_ask_sessiond(&lsm, NULL);
 }
 
+/*
+ * Send a PID ranges command of type "cmd_type".
+ * Return 0 on success else a negative LTTng error code.
+ */
+static int pid_ranges_cmd(struct lttng_handle *handle,
+		enum lttcomm_sessiond_command cmd_type,
+		const struct lttng_pid_range *ranges, unsigned int nb_ranges)
+{
+	struct lttcomm_session_msg lsm;
+
+	/* NULL arguments are forbidden. No default values. */
+	if (handle == NULL || ranges == NULL || !nb_ranges ||
+			nb_ranges > LTTNG_PID_RANGES_MAX) {
+		return -LTTNG_ERR_INVALID;
+	}
+
+	memset(&lsm, 0, sizeof(lsm));
+
+	lsm.cmd_type = cmd_type;
+	lsm.u.pid_ranges.nb_ranges = nb_ranges;
+
+	lttng_ctl_copy_lttng_domain(&lsm.domain, &handle->domain);
+
+	lttng_ctl_copy_string(lsm.session.name, handle->session_name,
+			sizeof(lsm.session.name));
+
+	return lttng_ctl_ask_sessiond_varlen_no_cmd_header(&lsm,
+			(void *) ranges, nb_ranges * sizeof(*ranges), NULL);
+}
+
+/*
+ * Add PID ranges to session tracker.
+ * Return 0 on success else a negative LTTng error code.
+ */
+int lttng_track_pid_ranges(struct lttng_handle *handle,
+		const struct lttng_pid_range *ranges, unsigned int nb_ranges)
+{
+	return pid_ranges_cmd(handle, LTTNG_TRACK_PID_RANGES, ranges,
+			nb_ranges);
+}
+
+/*
+ * Remove PID ranges from session tracker.
+ * Return 0 on success else a negative LTTng error code.
+ */
+int lttng_untrack_pid_ranges(struct lttng_handle *handle,
+		const struct lttng_pid_range *ranges, unsigned int nb_ranges)
+{
+	return pid_ranges_cmd(handle, LTTNG_UNTRACK_PID_RANGES, ranges,
+			nb_ranges);
+}
+
 /*
  * Lists all available tracepoints of domain.
  * Sets the contents of the events array.
@@ -1557,6 +1684,54 @@ int lttng_list_tracepoints(struct lttng_handle *handle,
 	return ret / sizeof(struct lttng_event);
 }
 
+/*
+ * Lists a page of the available UST tracepoints.
+ * Sets the contents of the events array and updates the pid cursor.
+ * Returns the number of lttng_event entries in events, 0 once done;
+ * on error, returns a negative value.
+ */
+int lttng_list_tracepoints_page(struct lttng_handle *handle,
+		pid_t *pid_cursor, unsigned int page_len,
+		struct lttng_event **events)
+{
+	int ret, count, i;
+	struct lttcomm_session_msg lsm;
+
+	if (handle == NULL || pid_cursor == NULL || page_len == 0 ||
+			handle->domain.type != LTTNG_DOMAIN_UST) {
+		return -LTTNG_ERR_INVALID;
+	}
+
+	memset(&lsm, 0, sizeof(lsm));
+	lsm.cmd_type = LTTNG_LIST_TRACEPOINTS;
+	lttng_ctl_copy_lttng_domain(&lsm.domain, &handle->domain);
+	lsm.u.list.page_len = page_len;
+	lsm.u.list.pid_cursor = *pid_cursor;
+
+	ret = lttng_ctl_ask_sessiond(&lsm, (void **) events);
+	if (ret < 0) {
+		return ret;
+	}
+
+	count = ret / sizeof(struct lttng_event);
+	for (i = 0; i < count; i++) {
+		if ((*events)[i].pid <= *pid_cursor) {
+			/*
+			 * A session daemon which does not list by pages
+			 * replies with every tracepoint, already returned
+			 * for the first page.
+			 */
+			free(*events);
+			*events = NULL;
+			return 0;
+		}
+	}
+	if (count > 0) {
+		*pid_cursor = (*events)[count - 1].pid;
+	}
+	return count;
+}
+
 /*
  * Lists all available tracepoint fields of domain.
  * Sets the contents of the event field array.
@@ -1585,6 +1760,54 @@ int lttng_list_tracepoint_fields(struct lttng_handle *handle,
 	return ret / sizeof(struct lttng_event_field);
 }
 
+/*
+ * Lists a page of the available UST tracepoint fields.
+ * Sets the contents of the event field array and updates the pid cursor.
+ * Returns the number of lttng_event_field entries in fields, 0 once done;
+ * on error, returns a negative value.
+ */
+int lttng_list_tracepoint_fields_page(struct lttng_handle *handle,
+		pid_t *pid_cursor, unsigned int page_len,
+		struct lttng_event_field **fields)
+{
+	int ret, count, i;
+	struct lttcomm_session_msg lsm;
+
+	if (handle == NULL || pid_cursor == NULL || page_len == 0 ||
+			handle->domain.type != LTTNG_DOMAIN_UST) {
+		return -LTTNG_ERR_INVALID;
+	}
+
+	memset(&lsm, 0, sizeof(lsm));
+	lsm.cmd_type = LTTNG_LIST_TRACEPOINT_FIELDS;
+	lttng_ctl_copy_lttng_domain(&lsm.domain, &handle->domain);
+	lsm.u.list.page_len = page_len;
+	lsm.u.list.pid_cursor = *pid_cursor;
+
+	ret = lttng_ctl_ask_sessiond(&lsm, (void **) fields);
+	if (ret < 0) {
+		return ret;
+	}
+
+	count = ret / sizeof(struct lttng_event_field);
+	for (i = 0; i < count; i++) {
+		if ((*fields)[i].event.pid <= *pid_cursor) {
+			/*
+			 * A session daemon which does not list by pages
+			 * replies with every field, already returned for
+			 * the first page.
+			 */
+			free(*fields);
+			*fields = NULL;
+			return 0;
+		}
+	}
+	if (count > 0) {
+		*pid_cursor = (*fields)[count - 1].event.pid;
+	}
+	return count;
+}
+
 /*
  * Lists all available kernel system calls. Allocates and sets the contents of
  * the events array.
@@ -1850,6 +2073,93 @@ end:
 	return ret;
 }
 
+/*
+ * Lists the memory used by the session daemon for the applications of a
+ * session.
+ *
+ * Returns the number of lttng_memory_usage entries in usage;
+ * on error, returns a negative value.
+ */
+int lttng_list_memory_usage(struct lttng_handle *handle,
+		struct lttng_memory_usage **usage)
+{
+	int ret;
+	struct lttcomm_session_msg lsm;
+
+	if (handle == NULL || usage == NULL) {
+		ret = -LTTNG_ERR_INVALID;
+		goto end;
+	}
+
+	memset(&lsm, 0, sizeof(lsm));
+	lsm.cmd_type = LTTNG_LIST_MEMORY_USAGE;
+	lttng_ctl_copy_string(lsm.session.name, handle->session_name,
+			sizeof(lsm.session.name));
+
+	lttng_ctl_copy_lttng_domain(&lsm.domain, &handle->domain);
+
+	*usage = NULL;
+	ret = lttng_ctl_ask_sessiond(&lsm, (void **) usage);
+	if (ret < 0) {
+		goto end;
+	}
+
+	if (ret % sizeof(struct lttng_memory_usage)) {
+		ret = -LTTNG_ERR_UNK;
+		free(*usage);
+		*usage = NULL;
+		goto end;
+	}
+
+	ret = ret / (int) sizeof(struct lttng_memory_usage);
+end:
+	return ret;
+}
+
+/*
+ * Lists the consumption statistics of the streams of a channel.
+ *
+ * Returns the number of lttng_stream_stats entries in stats;
+ * on error, returns a negative value.
+ */
+int lttng_list_stream_stats(struct lttng_handle *handle,
+		const char *channel_name, struct lttng_stream_stats **stats)
+{
+	int ret;
+	struct lttcomm_session_msg lsm;
+
+	if (handle == NULL || channel_name == NULL || stats == NULL) {
+		ret = -LTTNG_ERR_INVALID;
+		goto end;
+	}
+
+	memset(&lsm, 0, sizeof(lsm));
+	lsm.cmd_type = LTTNG_LIST_STREAM_STATS;
+	lttng_ctl_copy_string(lsm.session.name, handle->session_name,
+			sizeof(lsm.session.name));
+	lttng_ctl_copy_string(lsm.u.list.channel_name, channel_name,
+			sizeof(lsm.u.list.channel_name));
+
+	lttng_ctl_copy_lttng_domain(&lsm.domain, &handle->domain);
+
+	*stats = NULL;
+	ret = lttng_ctl_ask_sessiond(&lsm, (void **) stats);
+	if (ret < 0) {
+		goto end;
+	}
+
+	if (ret % sizeof(struct lttng_stream_stats)) {
+		ret = -LTTNG_ERR_UNK;
+		free(*stats);
+		*stats = NULL;
+		goto end;
+	}
+
+	ret = ret / (int) sizeof(struct lttng_stream_stats);
+end:
+	return ret;
+}
+
 /*
  * Ask the session daemon for all available events of a session channel.
  * Sets the contents of the events array.
@@ -2264,6 +2574,116 @@ end:
 	return ret;
 }
 
+int lttng_channel_get_compression(struct lttng_channel *chan,
+		enum lttng_channel_compression *compression)
+{
+	int ret = 0;
+
+	if (!chan || !compression) {
+		ret = -LTTNG_ERR_INVALID;
+		goto end;
+	}
+
+	if (!chan->attr.extended.ptr) {
+		ret = -LTTNG_ERR_INVALID;
+		goto end;
+	}
+
+	*compression = ((struct lttng_channel_extended *)
+			chan->attr.extended.ptr)->compression;
+end:
+	return ret;
+}
+
+int lttng_channel_set_compression(struct lttng_channel *chan,
+		enum lttng_channel_compression compression)
+{
+	int ret = 0;
+
+	if (!chan || !chan->attr.extended.ptr) {
+		ret = -LTTNG_ERR_INVALID;
+		goto end;
+	}
+
+	switch (compression) {
+	case LTTNG_CHANNEL_COMPRESSION_NONE:
+	case LTTNG_CHANNEL_COMPRESSION_ZLIB:
+		break;
+	default:
+		ret = -LTTNG_ERR_INVALID;
+		goto end;
+	}
+
+	((struct lttng_channel_extended *)
+			chan->attr.extended.ptr)->compression = compression;
+end:
+	return ret;
+}
+
+int lttng_channel_get_huge_pages(struct lttng_channel *chan,
+		int *huge_pages)
+{
+	int ret = 0;
+
+	if (!chan || !huge_pages) {
+		ret = -LTTNG_ERR_INVALID;
+		goto end;
+	}
+
+	if (!chan->attr.extended.ptr) {
+		ret = -LTTNG_ERR_INVALID;
+		goto end;
+	}
+
+	*huge_pages = ((struct lttng_channel_extended *)
+			chan->attr.extended.ptr)->huge_pages;
+end:
+	return ret;
+}
+
+int lttng_channel_set_huge_pages(struct lttng_channel *chan,
+		int huge_pages)
+{
+	int ret = 0;
+
+	if (!chan || !chan->attr.extended.ptr) {
+		ret = -LTTNG_ERR_INVALID;
+		goto end;
+	}
+
+	((struct lttng_channel_extended *)
+			chan->attr.extended.ptr)->huge_pages = !!huge_pages;
+end:
+	return ret;
+}
+
+/*
+ * Keep the connection of the calling thread to the session daemon open
+ * across its commands.
+ */
+int lttng_persistent_connection_open(void)
+{
+	int ret;
+
+	disconnect_sessiond();
+	URCU_TLS(sessiond_connection).persistent = 1;
+	ret = connect_sessiond();
+	if (ret < 0) {
+		URCU_TLS(sessiond_connection).persistent = 0;
+		ret = -LTTNG_ERR_NO_SESSIOND;
+	}
+	return ret;
+}
+
+/*
+ * Close the persistent connection of the calling thread.
+ */
+void lttng_persistent_connection_close(void)
+{
+	URCU_TLS(sessiond_connection).persistent = 0;
+	disconnect_sessiond();
+}
+
 /*
  * Check if session daemon is alive.
  *
@@ -2280,7 +2700,7 @@ int lttng_session_daemon_alive(void)
 		return ret;
 	}
 
-	if (*sessiond_sock_path == '\0') {
+	if (*URCU_TLS(sessiond_connection).sock_path == '\0') {
 		/*
 		 * No socket path set. Weird error which means the constructor
 		 * was not called.
@@ -2288,7 +2708,7 @@ int lttng_session_daemon_alive(void)
 		assert(0);
 	}
 
-	ret = try_connect_sessiond(sessiond_sock_path);
+	ret = try_connect_sessiond(URCU_TLS(sessiond_connection).sock_path);
 	if (ret < 0) {
 		/* Not alive. */
 		return 0;
@@ -2655,6 +3075,51 @@ end:
 	return ret;
 }
 
+/*
+ * Rotate a session to a new trace chunk.
+ * Return 0 on success, a negative error code on error.
+ */
+int lttng_rotate_session(const char *session_name, const char *path,
+		char **chunk_path)
+{
+	int ret;
+	struct lttcomm_session_msg lsm;
+	char *reply = NULL;
+
+	if (!session_name) {
+		ret = -LTTNG_ERR_INVALID;
+		goto end;
+	}
+
+	memset(&lsm, 0, sizeof(lsm));
+	lsm.cmd_type = LTTNG_ROTATE_SESSION;
+
+	lttng_ctl_copy_string(lsm.session.name, session_name,
+			sizeof(lsm.session.name));
+	if (path) {
+		lttng_ctl_copy_string(lsm.u.rotate_session.path, path,
+				sizeof(lsm.u.rotate_session.path));
+	}
+
+	ret = lttng_ctl_ask_sessiond(&lsm, (void **) &reply);
+	if (ret < 0) {
+		goto end;
+	}
+	if (ret == 0 || reply[ret - 1] != '\0') {
+		ret = -LTTNG_ERR_UNK;
+		goto end;
+	}
+
+	if (chunk_path) {
+		*chunk_path = reply;
+		reply = NULL;
+	}
+	ret = 0;
+end:
+	free(reply);
+	return ret;
+}
+
 int lttng_register_trigger(struct lttng_trigger *trigger)
 {
 	int ret;
@@ -80,6 +80,12 @@ int lttng_save_session_attr_get_omit_output(
 	return attr ? attr->omit_output : -LTTNG_ERR_INVALID;
 }
 
+int lttng_save_session_attr_get_binary(
+	struct lttng_save_session_attr *attr)
+{
+	return attr ? attr->binary : -LTTNG_ERR_INVALID;
+}
+
 int lttng_save_session_attr_set_session_name(
 	struct lttng_save_session_attr *attr, const char *session_name)
 {
@@ -193,6 +199,21 @@ end:
 	return ret;
 }
 
+int lttng_save_session_attr_set_binary(
+	struct lttng_save_session_attr *attr, int binary)
+{
+	int ret = 0;
+
+	if (!attr) {
+		ret = -LTTNG_ERR_INVALID;
+		goto end;
+	}
+
+	attr->binary = !!binary;
+end:
+	return ret;
+}
+
 /*
  * The lttng-ctl API does not expose all the information needed to save the
  * session configurations. Thus, we must send a save command to the session
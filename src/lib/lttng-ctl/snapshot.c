@@ -175,19 +175,12 @@ void lttng_snapshot_output_list_destroy(struct lttng_snapshot_output_list *list)
 }
 
 /*
- * Snapshot a trace for the given session.
- *
- * The output object can be NULL but an add output MUST be done prior to this
- * call. If it's not NULL, it will be used to snapshot a trace.
- *
- * The wait parameter is ignored for now. The snapshot record command will
- * ALWAYS wait for the snapshot to complete before returning meaning the
- * snapshot has been written on disk or streamed over the network to a relayd.
+ * Ask the session daemon to snapshot a trace for the given session.
  *
  * Return 0 on success or else a negative LTTNG_ERR value.
  */
-int lttng_snapshot_record(const char *session_name,
-		struct lttng_snapshot_output *output, int wait)
+static int snapshot_record(const char *session_name,
+		struct lttng_snapshot_output *output, uint32_t incremental)
 {
 	struct lttcomm_session_msg lsm;
 
@@ -211,11 +204,41 @@ int lttng_snapshot_record(const char *session_name,
 				sizeof(lsm.u.snapshot_record.output));
 	}
 
-	/* The wait param is ignored. */
+	lsm.u.snapshot_record.incremental = incremental;
 
 	return lttng_ctl_ask_sessiond(&lsm, NULL);
 }
 
+/*
+ * Snapshot a trace for the given session.
+ *
+ * The output object can be NULL but an add output MUST be done prior to this
+ * call. If it's not NULL, it will be used to snapshot a trace.
+ *
+ * The wait parameter is ignored for now. The snapshot record command will
+ * ALWAYS wait for the snapshot to complete before returning meaning the
+ * snapshot has been written on disk or streamed over the network to a relayd.
+ *
+ * Return 0 on success or else a negative LTTNG_ERR value.
+ */
+int lttng_snapshot_record(const char *session_name,
+		struct lttng_snapshot_output *output, int wait)
+{
+	return snapshot_record(session_name, output, 0);
+}
+
+/*
+ * Snapshot a trace for the given session, only writing the packets produced
+ * since the last snapshot to the same output.
+ *
+ * Return 0 on success or else a negative LTTNG_ERR value.
+ */
+int lttng_snapshot_record_incremental(const char *session_name,
+		struct lttng_snapshot_output *output, int wait)
+{
+	return snapshot_record(session_name, output, 1);
+}
+
 /*
  * Return an newly allocated snapshot output object or NULL on error.
  */
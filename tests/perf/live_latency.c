@@ -0,0 +1,426 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Live viewer measuring the end-to-end latency of a live session: it attaches
+ * to the session from its last packets and polls the next indexes of all its
+ * streams. The latency of a packet is the time at which its index reaches the
+ * viewer minus the end timestamp of the packet, hence the session must use the
+ * default monotonic trace clock.
+ *
+ * Usage: live_latency HOSTNAME SESSION_NAME DURATION_S
+ *
+ * The latency percentiles, in microseconds, and the number of discarded events
+ * are printed on the standard output as a JSON object.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <common/compat/endian.h>
+#include <bin/lttng-relayd/lttng-viewer-abi.h>
+
+#define LIVE_PORT		5344
+#define NSEC_PER_SEC		1000000000ULL
+/* Delay between the polls of the indexes when none is available. */
+#define POLL_DELAY_US		1000
+
+struct stream_discard {
+	uint64_t id;
+	/* The discarded events count of the packets is cumulative. */
+	uint64_t events_discarded;
+};
+
+static int sock = -1;
+static uint64_t session_id;
+
+static uint64_t *latencies;
+static size_t nr_latencies, alloc_latencies;
+
+static struct stream_discard *discards;
+static size_t nr_discards, alloc_discards;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static int recv_all(void *buf, size_t len)
+{
+	size_t copied = 0;
+
+	while (copied < len) {
+		ssize_t ret = recv(sock, (char *) buf + copied, len - copied, 0);
+
+		if (ret < 0 && errno == EINTR) {
+			continue;
+		}
+		if (ret <= 0) {
+			fprintf(stderr, "Relay daemon connection lost\n");
+			return -1;
+		}
+		copied += ret;
+	}
+	return 0;
+}
+
+static int send_cmd(uint32_t cmd, const void *payload, size_t len)
+{
+	struct lttng_viewer_cmd hdr;
+	ssize_t ret;
+
+	hdr.data_size = htobe64(len);
+	hdr.cmd = htobe32(cmd);
+	hdr.cmd_version = htobe32(0);
+	do {
+		ret = send(sock, &hdr, sizeof(hdr), MSG_NOSIGNAL);
+	} while (ret < 0 && errno == EINTR);
+	if (ret != sizeof(hdr)) {
+		goto error;
+	}
+	if (!len) {
+		return 0;
+	}
+	do {
+		ret = send(sock, payload, len, MSG_NOSIGNAL);
+	} while (ret < 0 && errno == EINTR);
+	if (ret != len) {
+		goto error;
+	}
+	return 0;
+error:
+	perror("send viewer command");
+	return -1;
+}
+
+static int connect_relayd(const char *hostname)
+{
+	struct addrinfo hints, *res = NULL;
+	struct lttng_viewer_connect connect_cmd;
+	struct lttng_viewer_features features;
+	char port[16];
+	int ret;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	snprintf(port, sizeof(port), "%d", LIVE_PORT);
+	ret = getaddrinfo(hostname, port, &hints, &res);
+	if (ret) {
+		fprintf(stderr, "Resolve %s: %s\n", hostname, gai_strerror(ret));
+		return -1;
+	}
+	sock = socket(res->ai_family, res->ai_socktype, 0);
+	if (sock < 0 || connect(sock, res->ai_addr, res->ai_addrlen) < 0) {
+		perror("connect relay daemon");
+		freeaddrinfo(res);
+		return -1;
+	}
+	freeaddrinfo(res);
+
+	memset(&connect_cmd, 0, sizeof(connect_cmd));
+	connect_cmd.viewer_session_id = htobe64(LTTNG_VIEWER_FEATURES_MAGIC);
+	connect_cmd.major = htobe32(VERSION_MAJOR);
+	connect_cmd.minor = htobe32(VERSION_MINOR);
+	connect_cmd.type = htobe32(LTTNG_VIEWER_CLIENT_COMMAND);
+	if (send_cmd(LTTNG_VIEWER_CONNECT, &connect_cmd, sizeof(connect_cmd)) ||
+			recv_all(&connect_cmd, sizeof(connect_cmd))) {
+		return -1;
+	}
+	memset(&features, 0, sizeof(features));
+	if ((be32toh(connect_cmd.minor) & LTTNG_VIEWER_FEATURES_FLAG) &&
+			recv_all(&features, sizeof(features))) {
+		return -1;
+	}
+	if (!(be64toh(features.features) & LTTNG_VIEWER_FEATURE_NEXT_INDEXES)) {
+		fprintf(stderr, "The relay daemon does not support get_next_indexes\n");
+		return -1;
+	}
+	return 0;
+}
+
+static int find_session(const char *session_name)
+{
+	struct lttng_viewer_create_session_response create;
+	struct lttng_viewer_list_sessions list;
+	uint32_t i;
+	int found = 0;
+
+	if (send_cmd(LTTNG_VIEWER_CREATE_SESSION, NULL, 0) ||
+			recv_all(&create, sizeof(create))) {
+		return -1;
+	}
+	if (be32toh(create.status) != LTTNG_VIEWER_CREATE_SESSION_OK) {
+		fprintf(stderr, "Viewer session creation failed\n");
+		return -1;
+	}
+
+	if (send_cmd(LTTNG_VIEWER_LIST_SESSIONS, NULL, 0) ||
+			recv_all(&list, sizeof(list))) {
+		return -1;
+	}
+	for (i = 0; i < be32toh(list.sessions_count); i++) {
+		struct lttng_viewer_session session;
+
+		if (recv_all(&session, sizeof(session))) {
+			return -1;
+		}
+		session.session_name[sizeof(session.session_name) - 1] = '\0';
+		if (!found && !strcmp(session.session_name, session_name)) {
+			session_id = be64toh(session.id);
+			found = 1;
+		}
+	}
+	if (!found) {
+		fprintf(stderr, "Live session %s not found\n", session_name);
+		return -1;
+	}
+	return 0;
+}
+
+/* The streams are only sent to be acknowledged, their IDs are not needed. */
+static int skip_streams(uint32_t nr_streams)
+{
+	uint32_t i;
+
+	for (i = 0; i < nr_streams; i++) {
+		struct lttng_viewer_stream stream;
+
+		if (recv_all(&stream, sizeof(stream))) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int attach_session(void)
+{
+	struct lttng_viewer_attach_session_request request;
+	struct lttng_viewer_attach_session_response response;
+
+	memset(&request, 0, sizeof(request));
+	request.session_id = htobe64(session_id);
+	request.seek = htobe32(LTTNG_VIEWER_SEEK_LAST);
+	if (send_cmd(LTTNG_VIEWER_ATTACH_SESSION, &request, sizeof(request)) ||
+			recv_all(&response, sizeof(response))) {
+		return -1;
+	}
+	if (be32toh(response.status) != LTTNG_VIEWER_ATTACH_OK) {
+		fprintf(stderr, "Attach failed with status %" PRIu32 "\n",
+				be32toh(response.status));
+		return -1;
+	}
+	return skip_streams(be32toh(response.streams_count));
+}
+
+static int get_new_streams(void)
+{
+	struct lttng_viewer_new_streams_request request;
+	struct lttng_viewer_new_streams_response response;
+
+	request.session_id = htobe64(session_id);
+	if (send_cmd(LTTNG_VIEWER_GET_NEW_STREAMS, &request, sizeof(request)) ||
+			recv_all(&response, sizeof(response))) {
+		return -1;
+	}
+	return skip_streams(be32toh(response.streams_count));
+}
+
+static int add_latency(uint64_t latency)
+{
+	if (nr_latencies == alloc_latencies) {
+		size_t new_alloc = alloc_latencies ? alloc_latencies << 1 : 4096;
+		uint64_t *new_latencies;
+
+		new_latencies = realloc(latencies,
+				new_alloc * sizeof(*latencies));
+		if (!new_latencies) {
+			perror("realloc latencies");
+			return -1;
+		}
+		latencies = new_latencies;
+		alloc_latencies = new_alloc;
+	}
+	latencies[nr_latencies++] = latency;
+	return 0;
+}
+
+static int set_discarded(uint64_t id, uint64_t events_discarded)
+{
+	size_t i;
+
+	for (i = 0; i < nr_discards; i++) {
+		if (discards[i].id == id) {
+			if (events_discarded > discards[i].events_discarded) {
+				discards[i].events_discarded = events_discarded;
+			}
+			return 0;
+		}
+	}
+	if (nr_discards == alloc_discards) {
+		size_t new_alloc = alloc_discards ? alloc_discards << 1 : 64;
+		struct stream_discard *new_discards;
+
+		new_discards = realloc(discards, new_alloc * sizeof(*discards));
+		if (!new_discards) {
+			perror("realloc discards");
+			return -1;
+		}
+		discards = new_discards;
+		alloc_discards = new_alloc;
+	}
+	discards[nr_discards].id = id;
+	discards[nr_discards].events_discarded = events_discarded;
+	nr_discards++;
+	return 0;
+}
+
+/*
+ * Get the next index of every stream of the session without their packets.
+ *
+ * Return the number of indexes available, or a negative value on error or
+ * once the session is gone.
+ */
+static int poll_indexes(void)
+{
+	struct lttng_viewer_get_next_indexes request;
+	struct lttng_viewer_next_indexes response;
+	uint32_t i, nr_indexes;
+	int nr_ok = 0, new_streams = 0;
+
+	memset(&request, 0, sizeof(request));
+	request.session_id = htobe64(session_id);
+	if (send_cmd(LTTNG_VIEWER_GET_NEXT_INDEXES, &request, sizeof(request)) ||
+			recv_all(&response, sizeof(response))) {
+		return -1;
+	}
+	if (be32toh(response.status) != LTTNG_VIEWER_NEXT_INDEXES_OK) {
+		return -1;
+	}
+
+	nr_indexes = be32toh(response.indexes_count);
+	for (i = 0; i < nr_indexes; i++) {
+		struct lttng_viewer_stream_index entry;
+		uint64_t now;
+
+		if (recv_all(&entry, sizeof(entry))) {
+			return -1;
+		}
+		now = now_ns();
+		if (be32toh(entry.index.flags) & LTTNG_VIEWER_FLAG_NEW_STREAM) {
+			new_streams = 1;
+		}
+		if (be32toh(entry.index.status) != LTTNG_VIEWER_INDEX_OK) {
+			continue;
+		}
+		nr_ok++;
+		if (add_latency(now - be64toh(entry.index.timestamp_end)) ||
+				set_discarded(be64toh(entry.id),
+					be64toh(entry.index.events_discarded))) {
+			return -1;
+		}
+	}
+	if (new_streams && get_new_streams()) {
+		return -1;
+	}
+	return nr_ok;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+static double percentile_us(unsigned int p)
+{
+	size_t i;
+
+	if (!nr_latencies) {
+		return 0;
+	}
+	i = (nr_latencies - 1) * p / 100;
+	return (double) latencies[i] / 1000;
+}
+
+static void print_results(void)
+{
+	uint64_t events_discarded = 0;
+	size_t i;
+
+	for (i = 0; i < nr_discards; i++) {
+		events_discarded += discards[i].events_discarded;
+	}
+	qsort(latencies, nr_latencies, sizeof(*latencies), cmp_u64);
+	printf("{\"packets\": %zu, \"latency_p50_us\": %.1f, "
+			"\"latency_p90_us\": %.1f, \"latency_p99_us\": %.1f, "
+			"\"latency_max_us\": %.1f, \"events_discarded\": %" PRIu64 "}\n",
+			nr_latencies, percentile_us(50), percentile_us(90),
+			percentile_us(99), percentile_us(100), events_discarded);
+}
+
+int main(int argc, char **argv)
+{
+	uint64_t deadline;
+	int ret = EXIT_FAILURE;
+
+	if (argc != 4) {
+		fprintf(stderr, "Usage: %s HOSTNAME SESSION_NAME DURATION_S\n",
+				argv[0]);
+		goto end;
+	}
+	if (connect_relayd(argv[1]) || find_session(argv[2]) ||
+			attach_session()) {
+		goto end;
+	}
+
+	deadline = now_ns() + strtoull(argv[3], NULL, 10) * NSEC_PER_SEC;
+	while (now_ns() < deadline) {
+		int nr_ok = poll_indexes();
+
+		if (nr_ok < 0) {
+			/* The session is destroyed at the end of a run. */
+			break;
+		}
+		if (!nr_ok) {
+			usleep(POLL_DELAY_US);
+		}
+	}
+	print_results();
+	ret = EXIT_SUCCESS;
+end:
+	if (sock >= 0) {
+		close(sock);
+	}
+	free(latencies);
+	free(discards);
+	return ret;
+}
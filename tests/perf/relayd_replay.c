@@ -0,0 +1,638 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Replay of a recorded trace to a relay daemon through the consumer protocol,
+ * to load the relay daemon and its storage with production-shaped traffic.
+ *
+ * Usage: relayd_replay [-s SPEED] [-l LIVE_TIMER_US] [-n SESSION_NAME]
+ *		[-p PATH] TRACE_DIR URL
+ *
+ * TRACE_DIR is a channel directory of a trace, holding the stream files, the
+ * metadata file and the index directory, without tracefile rotation. URL is
+ * the relay daemon URL, net://localhost for instance.
+ *
+ * The metadata is sent first, then the packets of all the streams, in the
+ * order of their end timestamp, each followed by its index as the consumer
+ * daemon does. A packet is sent once the time elapsed since the first one
+ * reaches the difference of their end timestamps divided by SPEED, 1 by
+ * default, hence the timestamps are expected in nanoseconds, as with the
+ * default trace clock. A SPEED of 0 sends the packets as fast as possible.
+ *
+ * The throughput, the lateness of the packets relative to their schedule and
+ * the round trip times of the indexes, in microseconds, are printed on the
+ * standard output as a JSON object.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <common/common.h>
+#include <common/compat/endian.h>
+#include <common/index/index.h>
+#include <common/relayd/relayd.h>
+#include <common/uri.h>
+
+#define NSEC_PER_SEC		1000000000ULL
+#define METADATA_NAME		"metadata"
+#define METADATA_CHUNK_LEN	65536
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+int lttng_opt_mi;
+
+struct replay_stream {
+	char name[NAME_MAX + 1];
+	int fd;
+	struct lttng_index_file *index_file;
+	struct lttng_index_map map;
+	/* Position of the next packet in the index map. */
+	uint64_t pos;
+	/* End timestamp of the next packet. */
+	uint64_t next_timestamp;
+	uint64_t relay_stream_id;
+	uint64_t next_net_seq_num;
+};
+
+struct samples {
+	uint64_t *values;
+	size_t count;
+	size_t alloc;
+};
+
+static struct lttcomm_relayd_sock *control_sock, *data_sock;
+static struct replay_stream *streams;
+static size_t nr_streams, alloc_streams;
+static uint64_t metadata_stream_id;
+
+static double speed = 1;
+static int live_timer;
+static char session_name[NAME_MAX] = "replay";
+static const char *stream_path = "replay";
+
+static char *packet_buf;
+static size_t packet_buf_len;
+
+static struct samples lateness, index_rtt;
+static uint64_t nr_packets, nr_bytes, nr_backpressure;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t deadline)
+{
+	struct timespec ts;
+	int ret;
+
+	ts.tv_sec = deadline / NSEC_PER_SEC;
+	ts.tv_nsec = deadline % NSEC_PER_SEC;
+	do {
+		ret = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+	} while (ret == EINTR);
+}
+
+static int add_sample(struct samples *samples, uint64_t value)
+{
+	if (samples->count == samples->alloc) {
+		size_t new_alloc = samples->alloc ? samples->alloc << 1 : 4096;
+		uint64_t *new_values;
+
+		new_values = realloc(samples->values,
+				new_alloc * sizeof(*new_values));
+		if (!new_values) {
+			perror("realloc samples");
+			return -1;
+		}
+		samples->values = new_values;
+		samples->alloc = new_alloc;
+	}
+	samples->values[samples->count++] = value;
+	return 0;
+}
+
+/* Set the end timestamp of the next packet of a stream, -1ULL at its end. */
+static void stream_peek(struct replay_stream *stream)
+{
+	struct ctf_packet_index index;
+
+	if (lttng_index_map_read(&stream->map, stream->pos, &index)) {
+		stream->next_timestamp = -1ULL;
+		return;
+	}
+	stream->next_timestamp = be64toh(index.timestamp_end);
+}
+
+static int add_stream(const char *trace_dir, const char *name)
+{
+	char path[PATH_MAX];
+	struct replay_stream *stream;
+	int ret;
+
+	if (nr_streams == alloc_streams) {
+		size_t new_alloc = alloc_streams ? alloc_streams << 1 : 64;
+		struct replay_stream *new_streams;
+
+		new_streams = realloc(streams, new_alloc * sizeof(*streams));
+		if (!new_streams) {
+			perror("realloc streams");
+			return -1;
+		}
+		streams = new_streams;
+		alloc_streams = new_alloc;
+	}
+	stream = &streams[nr_streams];
+	memset(stream, 0, sizeof(*stream));
+	stream->fd = -1;
+
+	ret = snprintf(path, sizeof(path), "%s/%s", trace_dir, name);
+	if (ret < 0 || ret >= sizeof(path)) {
+		fprintf(stderr, "Stream path of %s is too long\n", name);
+		return -1;
+	}
+	stream->index_file = lttng_index_file_open(trace_dir, name, 0, 0);
+	if (!stream->index_file) {
+		/* Not a stream file, or a stream without indexes. */
+		fprintf(stderr, "Skipping %s, it has no index\n", name);
+		return 0;
+	}
+	if (lttng_index_map(stream->index_file, &stream->map)) {
+		goto error;
+	}
+	stream->fd = open(path, O_RDONLY);
+	if (stream->fd < 0) {
+		perror("open stream file");
+		goto error;
+	}
+	strcpy(stream->name, name);
+	stream_peek(stream);
+	nr_streams++;
+	return 0;
+
+error:
+	lttng_index_unmap(&stream->map);
+	lttng_index_file_put(stream->index_file);
+	return -1;
+}
+
+static int load_streams(const char *trace_dir)
+{
+	DIR *dir;
+	struct dirent *entry;
+	int ret = -1;
+
+	dir = opendir(trace_dir);
+	if (!dir) {
+		perror("opendir trace directory");
+		return -1;
+	}
+	while ((entry = readdir(dir))) {
+		char path[PATH_MAX];
+		struct stat st;
+
+		if (entry->d_name[0] == '.' ||
+				!strcmp(entry->d_name, METADATA_NAME)) {
+			continue;
+		}
+		ret = snprintf(path, sizeof(path), "%s/%s", trace_dir,
+				entry->d_name);
+		if (ret < 0 || ret >= sizeof(path) || stat(path, &st) ||
+				!S_ISREG(st.st_mode)) {
+			continue;
+		}
+		ret = add_stream(trace_dir, entry->d_name);
+		if (ret) {
+			goto end;
+		}
+	}
+	if (!nr_streams) {
+		fprintf(stderr, "No stream with indexes in %s\n", trace_dir);
+		goto end;
+	}
+	ret = 0;
+end:
+	closedir(dir);
+	return ret;
+}
+
+static struct lttcomm_relayd_sock *connect_sock(struct lttng_uri *uri)
+{
+	struct lttcomm_relayd_sock *rsock;
+
+	rsock = lttcomm_alloc_relayd_sock(uri, RELAYD_VERSION_COMM_MAJOR,
+			RELAYD_VERSION_COMM_MINOR);
+	if (!rsock) {
+		fprintf(stderr, "Failed to allocate a relayd socket\n");
+		return NULL;
+	}
+	if (relayd_connect(rsock) < 0) {
+		fprintf(stderr, "Unable to reach lttng-relayd\n");
+		goto error;
+	}
+	if (uri->stype == LTTNG_STREAM_CONTROL &&
+			relayd_version_check(rsock) < 0) {
+		fprintf(stderr, "Incompatible lttng-relayd version\n");
+		(void) relayd_close(rsock);
+		goto error;
+	}
+	return rsock;
+
+error:
+	free(rsock);
+	return NULL;
+}
+
+static int connect_relayd(const char *url)
+{
+	struct lttng_uri *uris = NULL;
+	ssize_t nr_uris;
+	int ret = -1;
+
+	nr_uris = uri_parse_str_urls(url, NULL, &uris);
+	if (nr_uris != 2 || uris[0].dtype == LTTNG_DST_PATH) {
+		fprintf(stderr, "Invalid relayd URL %s\n", url);
+		goto end;
+	}
+	control_sock = connect_sock(&uris[0]);
+	if (!control_sock) {
+		goto end;
+	}
+	data_sock = connect_sock(&uris[1]);
+	if (!data_sock) {
+		goto end;
+	}
+	ret = 0;
+end:
+	free(uris);
+	return ret;
+}
+
+static int create_session(void)
+{
+	char hostname[HOST_NAME_MAX];
+	uint64_t session_id;
+	size_t i;
+	int ret;
+
+	if (gethostname(hostname, sizeof(hostname))) {
+		perror("gethostname");
+		return -1;
+	}
+	ret = relayd_create_session(control_sock, &session_id, session_name,
+			hostname, live_timer, 0);
+	if (ret < 0) {
+		fprintf(stderr, "Failed to create the relayd session\n");
+		return -1;
+	}
+	for (i = 0; i < nr_streams; i++) {
+		ret = relayd_add_stream(control_sock, streams[i].name,
+				stream_path, &streams[i].relay_stream_id, 0, 0);
+		if (ret < 0) {
+			fprintf(stderr, "Failed to add the stream %s\n",
+					streams[i].name);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int send_metadata(const char *trace_dir)
+{
+	char path[PATH_MAX];
+	int fd, ret;
+
+	ret = snprintf(path, sizeof(path), "%s/" METADATA_NAME, trace_dir);
+	if (ret < 0 || ret >= sizeof(path)) {
+		fprintf(stderr, "Metadata path is too long\n");
+		return -1;
+	}
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		perror("open metadata");
+		return -1;
+	}
+	ret = relayd_add_stream(control_sock, METADATA_NAME, stream_path,
+			&metadata_stream_id, 0, 0);
+	if (ret < 0) {
+		fprintf(stderr, "Failed to add the metadata stream\n");
+		goto end;
+	}
+	/* The stream list is complete, let the live viewers see it. */
+	ret = relayd_streams_sent(control_sock);
+	if (ret < 0) {
+		fprintf(stderr, "Failed to end the stream list\n");
+		goto end;
+	}
+
+	for (;;) {
+		char buf[METADATA_CHUNK_LEN];
+		ssize_t len;
+
+		len = lttng_read(fd, buf, sizeof(buf));
+		if (len < 0) {
+			perror("read metadata");
+			ret = -1;
+			goto end;
+		} else if (len == 0) {
+			break;
+		}
+		if (relayd_send_metadata_packet(control_sock,
+				metadata_stream_id, 0, buf, len) < 0) {
+			perror("send metadata");
+			ret = -1;
+			goto end;
+		}
+	}
+	ret = 0;
+end:
+	close(fd);
+	return ret;
+}
+
+/* Return the stream with the earliest next packet, NULL once all are sent. */
+static struct replay_stream *next_stream(void)
+{
+	struct replay_stream *next = NULL;
+	size_t i;
+
+	for (i = 0; i < nr_streams; i++) {
+		if (streams[i].next_timestamp == -1ULL) {
+			continue;
+		}
+		if (!next || streams[i].next_timestamp < next->next_timestamp) {
+			next = &streams[i];
+		}
+	}
+	return next;
+}
+
+static int send_packet(struct replay_stream *stream)
+{
+	struct ctf_packet_index index;
+	struct lttcomm_relayd_data_hdr hdr;
+	uint64_t packet_len, content_len, start;
+	uint32_t backpressure;
+	uint64_t write_lag_ns;
+	ssize_t ret;
+
+	(void) lttng_index_map_read(&stream->map, stream->pos, &index);
+	packet_len = be64toh(index.packet_size) / CHAR_BIT;
+	content_len = (be64toh(index.content_size) + CHAR_BIT - 1) / CHAR_BIT;
+	if (content_len > packet_len || packet_len > UINT32_MAX) {
+		fprintf(stderr, "Invalid packet %" PRIu64 " of %s\n",
+				stream->pos, stream->name);
+		return -1;
+	}
+	if (packet_len > packet_buf_len) {
+		char *new_buf = realloc(packet_buf, packet_len);
+
+		if (!new_buf) {
+			perror("realloc packet buffer");
+			return -1;
+		}
+		packet_buf = new_buf;
+		packet_buf_len = packet_len;
+	}
+	ret = pread(stream->fd, packet_buf, content_len,
+			be64toh(index.offset));
+	if (ret != content_len) {
+		fprintf(stderr, "Short read of packet %" PRIu64 " of %s\n",
+				stream->pos, stream->name);
+		return -1;
+	}
+
+	/* The padding is not sent, the relayd writes it. */
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.stream_id = htobe64(stream->relay_stream_id);
+	hdr.net_seq_num = htobe64(stream->next_net_seq_num);
+	hdr.data_size = htobe32(content_len);
+	hdr.padding_size = htobe32(packet_len - content_len);
+	ret = relayd_send_data_packet(data_sock, &hdr, packet_buf,
+			content_len);
+	if (ret < 0) {
+		perror("send data packet");
+		return -1;
+	}
+	stream->next_net_seq_num++;
+
+	start = now_ns();
+	ret = relayd_send_index(control_sock, &index, stream->relay_stream_id,
+			stream->next_net_seq_num - 1, &backpressure,
+			&write_lag_ns);
+	if (ret < 0) {
+		fprintf(stderr, "Failed to send the index of %s\n",
+				stream->name);
+		return -1;
+	}
+	if (add_sample(&index_rtt, now_ns() - start)) {
+		return -1;
+	}
+	if (backpressure != RELAYD_BACKPRESSURE_NONE) {
+		nr_backpressure++;
+	}
+
+	nr_packets++;
+	nr_bytes += packet_len;
+	stream->pos++;
+	stream_peek(stream);
+	return 0;
+}
+
+static int replay(void)
+{
+	struct replay_stream *stream;
+	uint64_t first_timestamp = 0, start = 0;
+
+	while ((stream = next_stream())) {
+		uint64_t now;
+
+		if (!start) {
+			first_timestamp = stream->next_timestamp;
+			start = now_ns();
+		}
+		if (speed > 0) {
+			uint64_t due = start + (uint64_t) ((stream->next_timestamp -
+					first_timestamp) / speed);
+
+			sleep_until(due);
+			now = now_ns();
+			if (add_sample(&lateness, now > due ? now - due : 0)) {
+				return -1;
+			}
+		}
+		if (send_packet(stream)) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int close_streams(void)
+{
+	size_t i;
+	int ret = 0;
+
+	for (i = 0; i < nr_streams; i++) {
+		if (relayd_send_close_stream(control_sock,
+				streams[i].relay_stream_id,
+				streams[i].next_net_seq_num - 1) < 0) {
+			fprintf(stderr, "Failed to close the stream %s\n",
+					streams[i].name);
+			ret = -1;
+		}
+	}
+	/* The metadata is sent on the control socket, without sequence number. */
+	if (relayd_send_close_stream(control_sock, metadata_stream_id,
+			-1ULL) < 0) {
+		fprintf(stderr, "Failed to close the metadata stream\n");
+		ret = -1;
+	}
+	return ret;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+static double percentile_us(const struct samples *samples, unsigned int p)
+{
+	size_t i;
+
+	if (!samples->count) {
+		return 0;
+	}
+	i = (samples->count - 1) * p / 100;
+	return (double) samples->values[i] / 1000;
+}
+
+static void print_results(uint64_t duration_ns)
+{
+	qsort(lateness.values, lateness.count, sizeof(*lateness.values),
+			cmp_u64);
+	qsort(index_rtt.values, index_rtt.count, sizeof(*index_rtt.values),
+			cmp_u64);
+	printf("{\"streams\": %zu, \"packets\": %" PRIu64 ", \"bytes\": %" PRIu64
+			", \"duration_s\": %.3f, \"mb_per_s\": %.3f, "
+			"\"lateness_p50_us\": %.1f, \"lateness_p99_us\": %.1f, "
+			"\"lateness_max_us\": %.1f, \"index_rtt_p50_us\": %.1f, "
+			"\"index_rtt_p99_us\": %.1f, \"index_rtt_max_us\": %.1f, "
+			"\"backpressure_replies\": %" PRIu64 "}\n",
+			nr_streams, nr_packets, nr_bytes,
+			(double) duration_ns / NSEC_PER_SEC,
+			duration_ns ? nr_bytes / 1e6 / ((double) duration_ns /
+				NSEC_PER_SEC) : 0,
+			percentile_us(&lateness, 50), percentile_us(&lateness, 99),
+			percentile_us(&lateness, 100),
+			percentile_us(&index_rtt, 50),
+			percentile_us(&index_rtt, 99),
+			percentile_us(&index_rtt, 100), nr_backpressure);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-s SPEED] [-l LIVE_TIMER_US] "
+			"[-n SESSION_NAME] [-p PATH] TRACE_DIR URL\n", name);
+}
+
+int main(int argc, char **argv)
+{
+	uint64_t start;
+	size_t i;
+	int opt, ret = EXIT_FAILURE;
+
+	while ((opt = getopt(argc, argv, "s:l:n:p:")) != -1) {
+		switch (opt) {
+		case 's':
+			speed = strtod(optarg, NULL);
+			break;
+		case 'l':
+			live_timer = atoi(optarg);
+			break;
+		case 'n':
+			if (lttng_strncpy(session_name, optarg,
+					sizeof(session_name))) {
+				fprintf(stderr, "Session name is too long\n");
+				goto end;
+			}
+			break;
+		case 'p':
+			stream_path = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			goto end;
+		}
+	}
+	if (argc - optind != 2 || speed < 0) {
+		usage(argv[0]);
+		goto end;
+	}
+
+	if (load_streams(argv[optind]) || connect_relayd(argv[optind + 1]) ||
+			create_session() || send_metadata(argv[optind])) {
+		goto end;
+	}
+
+	start = now_ns();
+	if (replay()) {
+		goto end;
+	}
+	if (close_streams()) {
+		goto end;
+	}
+	print_results(now_ns() - start);
+	ret = EXIT_SUCCESS;
+end:
+	if (data_sock) {
+		(void) relayd_close(data_sock);
+		free(data_sock);
+	}
+	if (control_sock) {
+		(void) relayd_close(control_sock);
+		free(control_sock);
+	}
+	for (i = 0; i < nr_streams; i++) {
+		close(streams[i].fd);
+		lttng_index_unmap(&streams[i].map);
+		lttng_index_file_put(streams[i].index_file);
+	}
+	free(streams);
+	free(packet_buf);
+	free(lateness.values);
+	free(index_rtt.values);
+	return ret;
+}
@@ -20,9 +20,54 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <inttypes.h>
 #include <lttng/health.h>
 
 static const char *relayd_path;
+static int print_stats;
+
+/*
+ * Print the busy ratio and the non-empty latency buckets of each thread type.
+ */
+static
+void print_component_stats(struct lttng_health *lh,
+		const char *component_name, int nr_threads)
+{
+	int i;
+
+	for (i = 0; i < nr_threads; i++) {
+		const struct lttng_health_thread *thread;
+		const uint64_t *buckets;
+		uint64_t busy_ns, idle_ns;
+		unsigned int j;
+
+		thread = lttng_health_get_thread(lh, i);
+		if (!thread || lttng_health_thread_get_busy_time(thread,
+					&busy_ns, &idle_ns) ||
+				lttng_health_thread_get_latency_histogram(
+					thread, &buckets)) {
+			continue;
+		}
+		if (!busy_ns && !idle_ns) {
+			continue;
+		}
+		printf("%s: \"%s\" busy %.1f%%, iterations:", component_name,
+			lttng_health_thread_name(thread),
+			100.0 * busy_ns / (busy_ns + idle_ns));
+		for (j = 0; j < LTTNG_HEALTH_LATENCY_NR_BUCKETS; j++) {
+			if (!buckets[j]) {
+				continue;
+			}
+			if (j == LTTNG_HEALTH_LATENCY_NR_BUCKETS - 1) {
+				printf(" >=%" PRIu64 "us:", UINT64_C(1) << (j - 1));
+			} else {
+				printf(" <%" PRIu64 "us:", UINT64_C(1) << j);
+			}
+			printf("%" PRIu64, buckets[j]);
+		}
+		printf("\n");
+	}
+}
 
 static
 int check_component(struct lttng_health *lh, const char *component_name,
@@ -40,15 +85,17 @@ int check_component(struct lttng_health *lh, const char *component_name,
 		return -1;
 	}
 	status = lttng_health_state(lh);
-	if (!status) {
-		return status;
-	}
-
 	nr_threads = lttng_health_get_nr_threads(lh);
 	if (nr_threads < 0) {
 		fprintf(stderr, "Error getting number of threads\n");
 		return -1;
 	}
+	if (print_stats) {
+		print_component_stats(lh, component_name, nr_threads);
+	}
+	if (!status) {
+		return status;
+	}
 
 	printf("Component \"%s\" is in error.\n", component_name);
 	for (i = 0; i < nr_threads; i++) {
@@ -142,8 +189,10 @@ int main(int argc, char *argv[])
 		if (!strncmp(argv[i], "--relayd-path=",
 				relayd_path_arg_len)) {
 			relayd_path = &argv[i][relayd_path_arg_len];
+		} else if (!strcmp(argv[i], "--stats")) {
+			print_stats = 1;
 		} else {
-			fprintf(stderr, "Unknown option \"%s\". Try --relayd-path=PATH.\n", argv[i]);
+			fprintf(stderr, "Unknown option \"%s\". Try --relayd-path=PATH or --stats.\n", argv[i]);
 			exit(EXIT_FAILURE);
 		}
 	}
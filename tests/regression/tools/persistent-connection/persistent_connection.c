@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <lttng/lttng.h>
+
+#include <tap/tap.h>
+
+/* Number of TAP tests in this file */
+#define NUM_TESTS 5
+
+/* No session of this name exists in the session daemon. */
+#define SESSION_NAME "persistent_connection_missing"
+
+static struct lttng_handle *handle;
+
+/*
+ * Enable an event with a filter and exclusions: its payload follows the
+ * command message and is left unread by the session daemon since the session
+ * does not exist.
+ */
+static int enable_event_with_payload(void)
+{
+	struct lttng_event event;
+	char *exclusions[] = { "tp:excluded" };
+
+	memset(&event, 0, sizeof(event));
+	strcpy(event.name, "tp:*");
+	event.type = LTTNG_EVENT_TRACEPOINT;
+	event.loglevel_type = LTTNG_EVENT_LOGLEVEL_ALL;
+	return lttng_enable_event_with_exclusions(handle, &event, NULL,
+			"intfield > 0", 1, exclusions);
+}
+
+static void test_failed_command_payload(void)
+{
+	int ret;
+	struct lttng_session *sessions = NULL;
+
+	diag("Failed command with a payload on a persistent connection");
+	ret = enable_event_with_payload();
+	ok(ret == -LTTNG_ERR_SESS_NOT_FOUND,
+			"Event with a filter not enabled in a missing session (%d)",
+			ret);
+
+	ret = lttng_list_sessions(&sessions);
+	ok(ret >= 0, "Next command on the same connection succeeds (%d)", ret);
+	free(sessions);
+	sessions = NULL;
+
+	ret = enable_event_with_payload();
+	ok(ret == -LTTNG_ERR_SESS_NOT_FOUND,
+			"Failed command repeated on the same connection (%d)", ret);
+
+	ret = lttng_list_sessions(&sessions);
+	ok(ret >= 0, "Connection still in sync after the repeated failure (%d)",
+			ret);
+	free(sessions);
+}
+
+int main(int argc, char **argv)
+{
+	int ret;
+	struct lttng_domain domain;
+
+	plan_tests(NUM_TESTS);
+
+	memset(&domain, 0, sizeof(domain));
+	domain.type = LTTNG_DOMAIN_UST;
+	domain.buf_type = LTTNG_BUFFER_PER_UID;
+	handle = lttng_create_handle(SESSION_NAME, &domain);
+	if (!handle) {
+		fail("Handle created");
+		skip(NUM_TESTS - 1, "No handle to send the commands");
+		goto end;
+	}
+
+	ret = lttng_persistent_connection_open();
+	ok(ret == 0, "Persistent connection opened (%d)", ret);
+	if (ret) {
+		skip(NUM_TESTS - 1, "No persistent connection");
+		goto end;
+	}
+	test_failed_command_payload();
+	lttng_persistent_connection_close();
+end:
+	lttng_destroy_handle(handle);
+	return exit_status();
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include <common/common.h>
+#include <common/time.h>
+#include <bin/lttng-sessiond/buffer-advisor.h>
+#include <tap/tap.h>
+
+/* Number of TAP tests in this file */
+#define NUM_TESTS 7
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+int lttng_opt_mi;
+
+static const struct buffer_geometry geometry = {
+	.subbuf_size = 1UL << 20,
+	.num_subbuf = 4,
+};
+
+/* Feed one sample per second, the usage and discarded events being constant. */
+static void feed(struct buffer_advisor *advisor, unsigned int nr_samples,
+		uint64_t usage, uint64_t discarded_per_sample)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr_samples; i++) {
+		buffer_advisor_sample(advisor, usage,
+				advisor->last_discarded_events +
+					(advisor->nr_samples ? discarded_per_sample : 0),
+				advisor->last_timestamp + NSEC_PER_SEC);
+	}
+}
+
+static bool is_geometry(const struct buffer_geometry *g, uint64_t subbuf_size,
+		uint64_t num_subbuf)
+{
+	return g->subbuf_size == subbuf_size && g->num_subbuf == num_subbuf;
+}
+
+static void test_grow(void)
+{
+	struct buffer_advisor advisor;
+	struct buffer_geometry rec;
+
+	buffer_advisor_init(&advisor);
+	feed(&advisor, 10, 4UL << 20, 100);
+	ok(!buffer_advisor_recommend(&advisor, &geometry, 100, false, &rec) &&
+			is_geometry(&rec, 1UL << 20, 4),
+			"No advice at the target discard rate");
+	ok(buffer_advisor_recommend(&advisor, &geometry, 10, false, &rec) &&
+			is_geometry(&rec, 1UL << 20, 8),
+			"Twice the sub-buffers above the target discard rate");
+}
+
+static void test_shrink(void)
+{
+	struct buffer_advisor advisor;
+	struct buffer_geometry rec;
+
+	buffer_advisor_init(&advisor);
+	feed(&advisor, 10, 300000, 0);
+	ok(!buffer_advisor_recommend(&advisor, &geometry, 0, false, &rec),
+			"No smaller buffers before enough samples");
+	ok(buffer_advisor_recommend(&advisor, &geometry, 0, true, &rec) &&
+			is_geometry(&rec, 512UL << 10, 2),
+			"Smaller sub-buffers at the end of the observation");
+
+	feed(&advisor, BUFFER_ADVISOR_MIN_SAMPLES, 900000, 0);
+	ok(buffer_advisor_recommend(&advisor, &geometry, 0, false, &rec) &&
+			is_geometry(&rec, 1UL << 20, 2),
+			"Fewer sub-buffers after enough samples");
+
+	feed(&advisor, 1, 3UL << 20, 0);
+	ok(!buffer_advisor_recommend(&advisor, &geometry, 0, true, &rec),
+			"No smaller buffers above a quarter of the capacity");
+}
+
+static void test_restart(void)
+{
+	struct buffer_advisor advisor;
+	struct buffer_geometry rec;
+	uint64_t restart_ts;
+
+	buffer_advisor_init(&advisor);
+	feed(&advisor, 10, 4UL << 20, 1000);
+	/* The discarded events counter goes backward: a new channel. */
+	restart_ts = advisor.last_timestamp + NSEC_PER_SEC;
+	buffer_advisor_sample(&advisor, 4UL << 20, 500, restart_ts);
+	feed(&advisor, 10, 4UL << 20, 5);
+	ok(advisor.first_timestamp == restart_ts &&
+			!buffer_advisor_recommend(&advisor, &geometry, 10,
+				false, &rec),
+			"Restart of the observation when the counter goes backward");
+}
+
+int main(int argc, char **argv)
+{
+	plan_tests(NUM_TESTS);
+
+	diag("Buffer advisor unit tests");
+
+	test_grow();
+	test_shrink();
+	test_restart();
+
+	return exit_status();
+}
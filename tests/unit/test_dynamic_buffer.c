@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <tap/tap.h>
+
+#include <common/dynamic-buffer.h>
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+int lttng_opt_mi;
+
+/* Number of TAP tests in this file */
+#define NUM_TESTS 11
+
+static const char payload[] = "0123456789abcdef";
+
+static int all_zero(const char *buf, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		if (buf[i]) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static void test_heap(void)
+{
+	struct lttng_dynamic_buffer buffer;
+	int ret;
+
+	lttng_dynamic_buffer_init(&buffer);
+	ret = lttng_dynamic_buffer_append(&buffer, payload, sizeof(payload));
+	ok(!ret && buffer.size == sizeof(payload) &&
+			!memcmp(buffer.data, payload, sizeof(payload)),
+			"Append to a heap buffer");
+
+	/* Grow past the capacity, to be zeroed up to the new size. */
+	ret = lttng_dynamic_buffer_set_size(&buffer, 1000);
+	ok(!ret && buffer.size == 1000 &&
+			all_zero(buffer.data + sizeof(payload),
+				1000 - sizeof(payload)),
+			"Size increases are zeroed");
+
+	lttng_dynamic_buffer_reset(&buffer);
+	ok(buffer.size == 0 && !buffer.data, "Reset a heap buffer");
+	ret = lttng_dynamic_buffer_append(&buffer, payload, sizeof(payload));
+	ok(!ret && buffer.size == sizeof(payload),
+			"Append to a reset heap buffer");
+	lttng_dynamic_buffer_reset(&buffer);
+}
+
+static void test_storage(void)
+{
+	struct lttng_dynamic_buffer buffer;
+	char storage[64];
+	int ret;
+
+	lttng_dynamic_buffer_init_with_storage(&buffer, storage,
+			sizeof(storage));
+	ret = lttng_dynamic_buffer_append(&buffer, payload, sizeof(payload));
+	ok(!ret && buffer.data == storage &&
+			!memcmp(storage, payload, sizeof(payload)),
+			"Small content stays in the storage");
+
+	ret = lttng_dynamic_buffer_set_size_no_zero(&buffer, sizeof(storage));
+	ok(!ret && buffer.data == storage && buffer.size == sizeof(storage),
+			"Grow up to the storage length without allocation");
+
+	ret = lttng_dynamic_buffer_set_size(&buffer, 4 * sizeof(storage));
+	ok(!ret && buffer.data != storage &&
+			!memcmp(buffer.data, payload, sizeof(payload)) &&
+			all_zero(buffer.data + sizeof(storage),
+				3 * sizeof(storage)),
+			"Outgrowing the storage moves the content to the heap");
+
+	lttng_dynamic_buffer_reset(&buffer);
+	ok(buffer.data == storage && buffer.size == 0,
+			"Reset returns to the storage");
+	lttng_dynamic_buffer_reset(&buffer);
+}
+
+static void test_move_steal(void)
+{
+	struct lttng_dynamic_buffer src, dst;
+	char storage[64];
+	char *content;
+	size_t size = 0;
+	int ret;
+
+	lttng_dynamic_buffer_init_with_storage(&src, storage, sizeof(storage));
+	lttng_dynamic_buffer_init(&dst);
+	ret = lttng_dynamic_buffer_append(&src, payload, sizeof(payload));
+	ret |= lttng_dynamic_buffer_move(&dst, &src);
+	ok(!ret && src.size == 0 && dst.data != storage &&
+			dst.size == sizeof(payload) &&
+			!memcmp(dst.data, payload, sizeof(payload)),
+			"Move the content of a storage");
+
+	ret = lttng_dynamic_buffer_move(&src, &dst);
+	ok(!ret && dst.size == 0 && src.size == sizeof(payload) &&
+			src.data != storage,
+			"Move heap content");
+
+	content = lttng_dynamic_buffer_steal(&src, &size);
+	ok(content && size == sizeof(payload) &&
+			!memcmp(content, payload, sizeof(payload)) &&
+			src.size == 0 && src.data == storage,
+			"Steal the content of a buffer");
+	free(content);
+	lttng_dynamic_buffer_reset(&src);
+	lttng_dynamic_buffer_reset(&dst);
+}
+
+int main(int argc, char **argv)
+{
+	plan_tests(NUM_TESTS);
+
+	diag("Dynamic buffer unit tests");
+
+	test_heap();
+	test_storage();
+	test_move_steal();
+
+	return exit_status();
+}
@@ -0,0 +1,286 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <tap/tap.h>
+
+#include <common/common.h>
+#include <common/hashtable/hashtable.h>
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+int lttng_opt_mi;
+
+/* Number of TAP tests in this file */
+#define NUM_TESTS 8
+
+#define NR_KEYS		100000
+#define NR_ROUNDS	20
+
+static struct lttng_ht_node_u64 *nodes;
+static unsigned long nr_freed;
+
+/* Keys spread on the low, high and all the bits. */
+static uint64_t test_key(unsigned int i)
+{
+	switch (i % 3) {
+	case 0:
+		return i;
+	case 1:
+		return (uint64_t) i << 40;
+	default:
+		return (uint64_t) i * 0x9e3779b97f4a7c15ULL;
+	}
+}
+
+static void fill_ht(struct lttng_ht *ht)
+{
+	unsigned int i;
+
+	for (i = 0; i < NR_KEYS; i++) {
+		lttng_ht_node_init_u64(&nodes[i], test_key(i));
+		lttng_ht_add_unique_u64(ht, &nodes[i]);
+	}
+}
+
+static void empty_ht(struct lttng_ht *ht)
+{
+	struct lttng_ht_iter iter;
+	struct lttng_ht_node_u64 *node;
+
+	rcu_read_lock();
+	cds_lfht_for_each_entry(ht->ht, &iter.iter, node, node) {
+		int ret = lttng_ht_del(ht, &iter);
+
+		assert(!ret);
+	}
+	rcu_read_unlock();
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void test_lookups(struct lttng_ht *ht)
+{
+	unsigned int i, nr_inline = 0, nr_generic = 0, nr_missing = 0;
+
+	rcu_read_lock();
+	for (i = 0; i < NR_KEYS; i++) {
+		uint64_t key = test_key(i);
+		struct lttng_ht_iter iter;
+
+		lttng_ht_lookup_fast_u64(ht, key, &iter);
+		if (lttng_ht_iter_get_node_u64(&iter) == &nodes[i]) {
+			nr_inline++;
+		}
+		lttng_ht_lookup(ht, &key, &iter);
+		if (lttng_ht_iter_get_node_u64(&iter) == &nodes[i]) {
+			nr_generic++;
+		}
+		/* The keys past NR_KEYS are never added. */
+		lttng_ht_lookup_fast_u64(ht, test_key(NR_KEYS + i), &iter);
+		if (!lttng_ht_iter_get_node_u64(&iter)) {
+			nr_missing++;
+		}
+	}
+	rcu_read_unlock();
+
+	ok(nr_inline == NR_KEYS, "Inline lookups find every key");
+	ok(nr_generic == NR_KEYS, "Generic lookups find every key");
+	ok(nr_missing == NR_KEYS, "Inline lookups find no missing key");
+}
+
+static void test_removal(struct lttng_ht *ht)
+{
+	unsigned int i, nr_found = 0;
+
+	rcu_read_lock();
+	for (i = 0; i < NR_KEYS; i += 2) {
+		struct lttng_ht_iter iter;
+
+		lttng_ht_lookup_fast_u64(ht, test_key(i), &iter);
+		(void) lttng_ht_del(ht, &iter);
+	}
+	for (i = 0; i < NR_KEYS; i++) {
+		struct lttng_ht_iter iter;
+
+		lttng_ht_lookup_fast_u64(ht, test_key(i), &iter);
+		if (lttng_ht_iter_get_node_u64(&iter)) {
+			nr_found++;
+		}
+	}
+	rcu_read_unlock();
+
+	ok(nr_found == NR_KEYS / 2 && lttng_ht_get_count(ht) == NR_KEYS / 2,
+			"Removed keys are no longer found");
+}
+
+static void test_mixing(void)
+{
+	unsigned int i, nr_distinct = 0;
+	uint8_t *seen;
+
+	seen = zmalloc(1 << 16);
+	assert(seen);
+
+	/* Keys differing in their high bits only spread on the low bits. */
+	for (i = 0; i < (1 << 16); i++) {
+		unsigned long hash = lttng_ht_mix_u64((uint64_t) i << 48,
+				lttng_ht_seed);
+
+		if (!seen[hash & 0xffff]) {
+			seen[hash & 0xffff] = 1;
+			nr_distinct++;
+		}
+	}
+	free(seen);
+
+	/* A random function gives about 63% of distinct values. */
+	ok(nr_distinct > (1 << 16) / 2,
+			"High key bits are mixed into the low hash bits (%u distinct)",
+			nr_distinct);
+}
+
+static void count_free_rcu(struct rcu_head *head)
+{
+	uatomic_inc(&nr_freed);
+}
+
+static void test_free_batch(struct lttng_ht *ht)
+{
+	struct lttng_ht_free_batch free_batch = { 0 };
+	struct lttng_ht_iter iter;
+	struct lttng_ht_node_u64 *node;
+
+	rcu_read_lock();
+	cds_lfht_for_each_entry(ht->ht, &iter.iter, node, node) {
+		int ret = lttng_ht_del(ht, &iter);
+
+		assert(!ret);
+		lttng_ht_free_batch_add(&free_batch, &node->head,
+				count_free_rcu);
+	}
+	rcu_read_unlock();
+	lttng_ht_free_batch_commit(&free_batch);
+	rcu_barrier();
+
+	ok(nr_freed == NR_KEYS && lttng_ht_get_count(ht) == 0,
+			"Free batch frees every node after a grace period");
+}
+
+/*
+ * Compare the lookups of the U64 tables, through lttng_ht_lookup(), with the
+ * inline lookups of the FAST_U64 tables.
+ */
+static void bench_lookups(struct lttng_ht *u64_ht, struct lttng_ht *fast_ht)
+{
+	unsigned int i, round;
+	uint64_t start, u64_ns, fast_ns;
+	unsigned long nr_found = 0;
+
+	rcu_read_lock();
+	start = now_ns();
+	for (round = 0; round < NR_ROUNDS; round++) {
+		for (i = 0; i < NR_KEYS; i++) {
+			uint64_t key = test_key(i);
+			struct lttng_ht_iter iter;
+
+			lttng_ht_lookup(u64_ht, &key, &iter);
+			nr_found += !!lttng_ht_iter_get_node_u64(&iter);
+		}
+	}
+	u64_ns = now_ns() - start;
+
+	start = now_ns();
+	for (round = 0; round < NR_ROUNDS; round++) {
+		for (i = 0; i < NR_KEYS; i++) {
+			struct lttng_ht_iter iter;
+
+			lttng_ht_lookup_fast_u64(fast_ht, test_key(i), &iter);
+			nr_found += !!lttng_ht_iter_get_node_u64(&iter);
+		}
+	}
+	fast_ns = now_ns() - start;
+	rcu_read_unlock();
+
+	diag("U64 lookups: %.1f ns, FAST_U64 lookups: %.1f ns",
+			(double) u64_ns / (NR_ROUNDS * NR_KEYS),
+			(double) fast_ns / (NR_ROUNDS * NR_KEYS));
+	ok(nr_found == 2UL * NR_ROUNDS * NR_KEYS,
+			"Both table types find every key in the benchmark");
+}
+
+int main(int argc, char **argv)
+{
+	struct lttng_ht *u64_ht, *fast_ht;
+
+	plan_tests(NUM_TESTS);
+
+	rcu_register_thread();
+
+	nodes = zmalloc(NR_KEYS * sizeof(*nodes));
+	assert(nodes);
+
+	fast_ht = lttng_ht_new(0, LTTNG_HT_TYPE_FAST_U64);
+	ok(fast_ht != NULL, "Create a FAST_U64 hash table");
+	if (!fast_ht) {
+		goto end;
+	}
+	fill_ht(fast_ht);
+	test_lookups(fast_ht);
+	test_removal(fast_ht);
+	test_mixing();
+
+	/* The benchmark needs every key in each table. */
+	empty_ht(fast_ht);
+	fill_ht(fast_ht);
+	u64_ht = lttng_ht_new(0, LTTNG_HT_TYPE_U64);
+	assert(u64_ht);
+	{
+		struct lttng_ht_node_u64 *u64_nodes;
+		unsigned int i;
+
+		u64_nodes = zmalloc(NR_KEYS * sizeof(*u64_nodes));
+		assert(u64_nodes);
+		for (i = 0; i < NR_KEYS; i++) {
+			lttng_ht_node_init_u64(&u64_nodes[i], test_key(i));
+			lttng_ht_add_unique_u64(u64_ht, &u64_nodes[i]);
+		}
+		bench_lookups(u64_ht, fast_ht);
+		test_free_batch(u64_ht);
+		lttng_ht_destroy(u64_ht);
+		free(u64_nodes);
+	}
+
+	empty_ht(fast_ht);
+	lttng_ht_destroy(fast_ht);
+end:
+	free(nodes);
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -23,6 +23,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <time.h>
+#include <urcu.h>
 
 #include <bin/lttng-sessiond/trace-kernel.h>
 #include <common/defaults.h>
@@ -32,7 +33,7 @@
 #define RANDOM_STRING_LEN	11
 
 /* Number of TAP tests in this file */
-#define NUM_TESTS 11
+#define NUM_TESTS 15
 
 /* For error.h */
 int lttng_opt_quiet = 1;
@@ -193,6 +194,61 @@ static void test_create_kernel_stream(void)
 	trace_kernel_destroy_stream(stream);
 }
 
+static void test_kernel_lookups(void)
+{
+	struct ltt_kernel_session *ksess;
+	struct ltt_kernel_channel *chan;
+	struct ltt_kernel_event *tp_event, *sc_event;
+	struct lttng_channel attr;
+	struct lttng_channel_extended extended;
+	struct lttng_event ev;
+	char name[] = "lookup_event";
+
+	memset(&attr, 0, sizeof(attr));
+	memset(&extended, 0, sizeof(extended));
+	attr.attr.extended.ptr = &extended;
+	strcpy(attr.name, "lookup_chan");
+	memset(&ev, 0, sizeof(ev));
+	strcpy(ev.name, name);
+
+	ksess = trace_kernel_create_session();
+	chan = trace_kernel_create_channel(&attr);
+	ev.type = LTTNG_EVENT_TRACEPOINT;
+	tp_event = trace_kernel_create_event(&ev, NULL, NULL);
+	ev.type = LTTNG_EVENT_SYSCALL;
+	sc_event = trace_kernel_create_event(&ev, NULL, NULL);
+	if (!ksess || !chan || !tp_event || !sc_event) {
+		skip(4, "Failed to create the kernel objects");
+		return;
+	}
+	tp_event->type = LTTNG_EVENT_TRACEPOINT;
+	sc_event->type = LTTNG_EVENT_SYSCALL;
+
+	trace_kernel_add_channel(ksess, chan);
+	trace_kernel_add_event(chan, tp_event);
+	trace_kernel_add_event(chan, sc_event);
+
+	ok(trace_kernel_get_channel_by_name(attr.name, ksess) == chan &&
+	   !trace_kernel_get_channel_by_name("unknown", ksess),
+	   "Find kernel channel by name");
+	ok(trace_kernel_find_event(name, chan, LTTNG_EVENT_SYSCALL, NULL) ==
+			sc_event &&
+	   trace_kernel_find_event(name, chan, LTTNG_EVENT_TRACEPOINT,
+			NULL) == tp_event,
+	   "Find kernel events of the same name by type");
+	ok(trace_kernel_get_event_by_name(name, chan, LTTNG_EVENT_ALL) != NULL &&
+	   !trace_kernel_get_event_by_name("unknown", chan, LTTNG_EVENT_ALL),
+	   "Find kernel event by name");
+
+	trace_kernel_destroy_event(tp_event);
+	ok(trace_kernel_find_event(name, chan, LTTNG_EVENT_TRACEPOINT,
+			NULL) == NULL && chan->events_list.head.next ==
+			&sc_event->list,
+	   "Destroyed kernel event is not found");
+
+	trace_kernel_destroy_session(ksess);
+}
+
 int main(int argc, char **argv)
 {
 	plan_tests(NUM_TESTS);
@@ -205,6 +261,10 @@ int main(int argc, char **argv)
 	test_create_kernel_event();
 	test_create_kernel_stream();
 
+	rcu_register_thread();
+	test_kernel_lookups();
+	rcu_unregister_thread();
+
 	/* Success */
 	return 0;
 }
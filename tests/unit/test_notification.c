@@ -35,6 +35,7 @@
 #include <lttng/action/action.h>
 #include <lttng/action/notify.h>
 #include <lttng/condition/buffer-usage.h>
+#include <lttng/condition/channel-rate.h>
 #include <lttng/condition/condition.h>
 #include <lttng/domain.h>
 #include <lttng/notification/notification.h>
@@ -45,7 +46,7 @@ int lttng_opt_quiet = 1;
 int lttng_opt_verbose;
 int lttng_opt_mi;
 
-#define NUM_TESTS 182
+#define NUM_TESTS 212
 
 void test_condition_buffer_usage(struct lttng_condition *buffer_usage_condition)
 {
@@ -56,6 +57,8 @@ void test_condition_buffer_usage(struct lttng_condition *buffer_usage_condition)
 	/* Start at a non zero value to validate initialization */
 	double threshold_ratio;
 	uint64_t threshold_bytes;
+	double hysteresis_ratio;
+	uint64_t interval_us;
 
 	assert(buffer_usage_condition);
 
@@ -259,6 +262,26 @@ void test_condition_buffer_usage(struct lttng_condition *buffer_usage_condition)
 	status = lttng_condition_buffer_usage_get_domain_type(buffer_usage_condition, &domain_type);
 	ok(status == LTTNG_CONDITION_STATUS_OK, "Domain type is set");
 	ok(domain_type == LTTNG_DOMAIN_UST, "Domain type is LTTNG_DOMAIN_UST");
+
+	diag("Testing hysteresis ratio set/get");
+	status = lttng_condition_buffer_usage_get_hysteresis_ratio(buffer_usage_condition, &hysteresis_ratio);
+	ok(status == LTTNG_CONDITION_STATUS_UNSET, "Hysteresis ratio is unset");
+	status = lttng_condition_buffer_usage_set_hysteresis_ratio(buffer_usage_condition, -0.1);
+	ok(status == LTTNG_CONDITION_STATUS_INVALID, "Set hysteresis ratio < 0");
+	status = lttng_condition_buffer_usage_set_hysteresis_ratio(buffer_usage_condition, 1.1);
+	ok(status == LTTNG_CONDITION_STATUS_INVALID, "Set hysteresis ratio > 1");
+	status = lttng_condition_buffer_usage_set_hysteresis_ratio(buffer_usage_condition, 0.05);
+	ok(status == LTTNG_CONDITION_STATUS_OK, "Set hysteresis ratio == 0.05");
+	status = lttng_condition_buffer_usage_get_hysteresis_ratio(buffer_usage_condition, &hysteresis_ratio);
+	ok(status == LTTNG_CONDITION_STATUS_OK && hysteresis_ratio == 0.05, "Hysteresis ratio is 0.05");
+
+	diag("Testing minimal notification interval set/get");
+	status = lttng_condition_buffer_usage_get_min_notification_interval(buffer_usage_condition, &interval_us);
+	ok(status == LTTNG_CONDITION_STATUS_OK && interval_us == 0, "Minimal notification interval is 0 by default");
+	status = lttng_condition_buffer_usage_set_min_notification_interval(buffer_usage_condition, 500000);
+	ok(status == LTTNG_CONDITION_STATUS_OK, "Set minimal notification interval == 500000");
+	status = lttng_condition_buffer_usage_get_min_notification_interval(buffer_usage_condition, &interval_us);
+	ok(status == LTTNG_CONDITION_STATUS_OK && interval_us == 500000, "Minimal notification interval is 500000");
 }
 
 
@@ -292,6 +315,55 @@ void test_condition_buffer_usage_high(void)
 	lttng_condition_destroy(buffer_usage_high);
 }
 
+void test_condition_channel_rate(void)
+{
+	enum lttng_condition_status status;
+	enum lttng_condition_channel_rate_metric metric;
+	struct lttng_condition *channel_rate_low = NULL;
+	struct lttng_condition *channel_rate_high = NULL;
+	uint64_t threshold;
+	const char *channel_name = NULL;
+
+	diag("Testing lttng_condition_channel_rate_low_create");
+	channel_rate_low = lttng_condition_channel_rate_low_create();
+	ok(channel_rate_low, "Low channel rate condition allocated");
+	ok(lttng_condition_get_type(channel_rate_low) == LTTNG_CONDITION_TYPE_CHANNEL_RATE_LOW, "Condition is of type \"low channel rate\"");
+
+	diag("Testing lttng_condition_channel_rate_high_create");
+	channel_rate_high = lttng_condition_channel_rate_high_create();
+	ok(channel_rate_high, "High channel rate condition allocated");
+	ok(lttng_condition_get_type(channel_rate_high) == LTTNG_CONDITION_TYPE_CHANNEL_RATE_HIGH, "Condition is of type \"high channel rate\"");
+
+	diag("Testing metric set/get");
+	status = lttng_condition_channel_rate_get_metric(channel_rate_high, &metric);
+	ok(status == LTTNG_CONDITION_STATUS_UNSET, "Metric is unset");
+	status = lttng_condition_channel_rate_set_metric(channel_rate_high, LTTNG_CONDITION_CHANNEL_RATE_METRIC_UNKNOWN);
+	ok(status == LTTNG_CONDITION_STATUS_INVALID, "Set metric as LTTNG_CONDITION_CHANNEL_RATE_METRIC_UNKNOWN");
+	status = lttng_condition_channel_rate_set_metric(channel_rate_high, LTTNG_CONDITION_CHANNEL_RATE_METRIC_DISCARDED_EVENTS);
+	ok(status == LTTNG_CONDITION_STATUS_OK, "Set metric as LTTNG_CONDITION_CHANNEL_RATE_METRIC_DISCARDED_EVENTS");
+	status = lttng_condition_channel_rate_get_metric(channel_rate_high, &metric);
+	ok(status == LTTNG_CONDITION_STATUS_OK && metric == LTTNG_CONDITION_CHANNEL_RATE_METRIC_DISCARDED_EVENTS, "Metric is LTTNG_CONDITION_CHANNEL_RATE_METRIC_DISCARDED_EVENTS");
+
+	diag("Testing threshold set/get");
+	status = lttng_condition_channel_rate_get_threshold(channel_rate_high, &threshold);
+	ok(status == LTTNG_CONDITION_STATUS_UNSET, "Threshold is unset");
+	status = lttng_condition_channel_rate_set_threshold(channel_rate_high, 1000);
+	ok(status == LTTNG_CONDITION_STATUS_OK, "Set threshold == 1000");
+	status = lttng_condition_channel_rate_get_threshold(channel_rate_high, &threshold);
+	ok(status == LTTNG_CONDITION_STATUS_OK && threshold == 1000, "Threshold is 1000");
+
+	diag("Testing channel name set/get");
+	status = lttng_condition_channel_rate_set_channel_name(channel_rate_high, "");
+	ok(status == LTTNG_CONDITION_STATUS_INVALID, "Set empty channel name");
+	status = lttng_condition_channel_rate_set_channel_name(channel_rate_high, "channel420");
+	ok(status == LTTNG_CONDITION_STATUS_OK, "Set channel name");
+	status = lttng_condition_channel_rate_get_channel_name(channel_rate_high, &channel_name);
+	ok(status == LTTNG_CONDITION_STATUS_OK && channel_name && !strcmp(channel_name, "channel420"), "Channel name is %s", "channel420");
+
+	lttng_condition_destroy(channel_rate_low);
+	lttng_condition_destroy(channel_rate_high);
+}
+
 void test_action(void)
 {
 	struct lttng_action *notify_action = NULL;
@@ -332,6 +404,7 @@ int main(int argc, const char *argv[])
 	plan_tests(NUM_TESTS);
 	test_condition_buffer_usage_low();
 	test_condition_buffer_usage_high();
+	test_condition_channel_rate();
 	test_action();
 	test_trigger();
 	return exit_status();
@@ -0,0 +1,331 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <common/common.h>
+#include <common/dynamic-buffer.h>
+#include <lttng/condition/buffer-usage-internal.h>
+#include <lttng/condition/condition.h>
+#include <lttng/condition/evaluation.h>
+#include <lttng/domain.h>
+#include <lttng/notification/channel-internal.h>
+#include <lttng/notification/notification-internal.h>
+#include <tap/tap.h>
+
+/* Number of TAP tests in this file */
+#define NUM_TESTS 11
+
+/* Notifications sent at once by the fake session daemon. */
+#define NR_NOTIFICATIONS 4
+
+#define CAPACITY 4096
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+int lttng_opt_mi;
+
+static struct lttng_condition *condition;
+
+/*
+ * Create a notification channel reading from "fd", as if the handshake with
+ * the session daemon was done.
+ */
+static struct lttng_notification_channel *create_channel(int fd)
+{
+	struct lttng_notification_channel *channel;
+
+	channel = zmalloc(sizeof(*channel));
+	if (!channel) {
+		return NULL;
+	}
+	channel->socket = fd;
+	pthread_mutex_init(&channel->lock, NULL);
+	lttng_dynamic_buffer_init(&channel->reception_buffer);
+	CDS_INIT_LIST_HEAD(&channel->pending_notifications.list);
+	channel->version.set = true;
+	channel->version.major = LTTNG_NOTIFICATION_CHANNEL_VERSION_MAJOR;
+	channel->version.minor = LTTNG_NOTIFICATION_CHANNEL_VERSION_MINOR;
+	return channel;
+}
+
+static int send_message(int fd, int8_t type, const char *payload,
+		uint32_t size)
+{
+	int ret;
+	struct lttng_dynamic_buffer buffer;
+	struct lttng_notification_channel_message msg = {
+		.type = type,
+		.size = size,
+	};
+
+	lttng_dynamic_buffer_init(&buffer);
+	ret = lttng_dynamic_buffer_append(&buffer, &msg, sizeof(msg));
+	if (ret) {
+		goto end;
+	}
+	ret = lttng_dynamic_buffer_append(&buffer, payload, size);
+	if (ret) {
+		goto end;
+	}
+	ret = write(fd, buffer.data, buffer.size) == buffer.size ? 0 : -1;
+end:
+	lttng_dynamic_buffer_reset(&buffer);
+	return ret;
+}
+
+/*
+ * Send a notification of the test condition with a buffer usage of "use"
+ * bytes.
+ */
+static int send_notification(int fd, uint64_t use)
+{
+	int ret = -1;
+	ssize_t size;
+	char *payload = NULL;
+	struct lttng_evaluation *evaluation;
+	struct lttng_notification *notification = NULL;
+
+	evaluation = lttng_evaluation_buffer_usage_create(
+			LTTNG_CONDITION_TYPE_BUFFER_USAGE_HIGH, use, CAPACITY);
+	if (!evaluation) {
+		goto end;
+	}
+	notification = lttng_notification_create(condition, evaluation);
+	if (!notification) {
+		goto end;
+	}
+	size = lttng_notification_serialize(notification, NULL);
+	if (size < 0) {
+		goto end;
+	}
+	payload = zmalloc(size);
+	if (!payload) {
+		goto end;
+	}
+	if (lttng_notification_serialize(notification, payload) != size) {
+		goto end;
+	}
+	ret = send_message(fd,
+			LTTNG_NOTIFICATION_CHANNEL_MESSAGE_TYPE_NOTIFICATION,
+			payload, size);
+end:
+	free(payload);
+	lttng_notification_destroy(notification);
+	lttng_evaluation_destroy(evaluation);
+	return ret;
+}
+
+/*
+ * Check that the notifications carry the buffer usages "first", "first + 1",
+ * and so on, then destroy them.
+ */
+static bool check_notifications(struct lttng_notification **notifications,
+		unsigned int count, uint64_t first)
+{
+	bool valid = true;
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		uint64_t use;
+		const struct lttng_evaluation *evaluation;
+
+		evaluation = lttng_notification_get_evaluation(
+				notifications[i]);
+		if (!evaluation || lttng_evaluation_buffer_usage_get_usage(
+				evaluation, &use) != LTTNG_EVALUATION_STATUS_OK ||
+				use != first + i) {
+			valid = false;
+		}
+		lttng_notification_destroy(notifications[i]);
+	}
+	return valid;
+}
+
+static void test_batch(void)
+{
+	int fds[2] = { -1, -1 }, ret = 0;
+	unsigned int i, count = 0;
+	struct lttng_notification *notifications[2 * NR_NOTIFICATIONS];
+	struct lttng_notification_channel *channel = NULL;
+	enum lttng_notification_channel_status status;
+
+	diag("Queued notifications returned in one batch");
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds)) {
+		PERROR("socketpair");
+		goto end;
+	}
+	channel = create_channel(fds[0]);
+	if (!channel) {
+		goto end;
+	}
+	fds[0] = -1;
+	for (i = 0; i < NR_NOTIFICATIONS; i++) {
+		ret |= send_notification(fds[1], i);
+	}
+	/* A regression makes the calls fail instead of blocking. */
+	ret |= shutdown(fds[1], SHUT_WR);
+	ok(!ret, "%d notifications sent", NR_NOTIFICATIONS);
+
+	status = lttng_notification_channel_get_next_notifications(channel,
+			notifications, 2 * NR_NOTIFICATIONS, &count);
+	ok(status == LTTNG_NOTIFICATION_CHANNEL_STATUS_OK,
+			"Notifications received");
+	ok(count == NR_NOTIFICATIONS &&
+			check_notifications(notifications, count, 0),
+			"Every queued notification returned in order (%u)", count);
+end:
+	lttng_notification_channel_destroy(channel);
+	if (fds[0] >= 0) {
+		close(fds[0]);
+	}
+	if (fds[1] >= 0) {
+		close(fds[1]);
+	}
+}
+
+static void test_batch_pending(void)
+{
+	int fds[2] = { -1, -1 }, ret = 0;
+	unsigned int i, count = 0;
+	struct lttng_notification *notifications[NR_NOTIFICATIONS];
+	struct lttng_notification_channel *channel = NULL;
+	enum lttng_notification_channel_status status;
+
+	diag("Notifications beyond the batch size kept for the next call");
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds)) {
+		PERROR("socketpair");
+		goto end;
+	}
+	channel = create_channel(fds[0]);
+	if (!channel) {
+		goto end;
+	}
+	fds[0] = -1;
+	for (i = 0; i < NR_NOTIFICATIONS; i++) {
+		ret |= send_notification(fds[1], i);
+	}
+	/* A regression makes the calls fail instead of blocking. */
+	ret |= shutdown(fds[1], SHUT_WR);
+	ok(!ret, "%d notifications sent", NR_NOTIFICATIONS);
+
+	status = lttng_notification_channel_get_next_notifications(channel,
+			notifications, NR_NOTIFICATIONS - 1, &count);
+	ok(status == LTTNG_NOTIFICATION_CHANNEL_STATUS_OK &&
+			count == NR_NOTIFICATIONS - 1 &&
+			check_notifications(notifications, count, 0),
+			"First batch limited to its size (%u)", count);
+
+	count = 0;
+	status = lttng_notification_channel_get_next_notifications(channel,
+			notifications, NR_NOTIFICATIONS, &count);
+	ok(status == LTTNG_NOTIFICATION_CHANNEL_STATUS_OK && count == 1 &&
+			check_notifications(notifications, count,
+				NR_NOTIFICATIONS - 1),
+			"Remaining notification returned by the next call (%u)",
+			count);
+end:
+	lttng_notification_channel_destroy(channel);
+	if (fds[0] >= 0) {
+		close(fds[0]);
+	}
+	if (fds[1] >= 0) {
+		close(fds[1]);
+	}
+}
+
+static void test_batch_error(void)
+{
+	int fds[2] = { -1, -1 }, ret = 0;
+	unsigned int count = 0;
+	struct lttng_notification *notifications[NR_NOTIFICATIONS];
+	struct lttng_notification_channel *channel = NULL;
+	enum lttng_notification_channel_status status;
+
+	diag("Protocol error after valid notifications");
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds)) {
+		PERROR("socketpair");
+		goto end;
+	}
+	channel = create_channel(fds[0]);
+	if (!channel) {
+		goto end;
+	}
+	fds[0] = -1;
+	ret |= send_notification(fds[1], 0);
+	ret |= send_notification(fds[1], 1);
+	/* Unknown message type. */
+	ret |= send_message(fds[1], INT8_MAX, NULL, 0);
+	ret |= shutdown(fds[1], SHUT_WR);
+	ok(!ret, "Two notifications and an invalid message sent");
+
+	status = lttng_notification_channel_get_next_notifications(channel,
+			notifications, NR_NOTIFICATIONS, &count);
+	ok(status == LTTNG_NOTIFICATION_CHANNEL_STATUS_OK,
+			"Error not reported along with valid notifications");
+	ok(count == 2 && check_notifications(notifications, count, 0),
+			"Notifications received before the error returned (%u)",
+			count);
+
+	count = 0;
+	status = lttng_notification_channel_get_next_notifications(channel,
+			notifications, NR_NOTIFICATIONS, &count);
+	ok(status == LTTNG_NOTIFICATION_CHANNEL_STATUS_ERROR && !count,
+			"Error reported by the next call");
+end:
+	lttng_notification_channel_destroy(channel);
+	if (fds[0] >= 0) {
+		close(fds[0]);
+	}
+	if (fds[1] >= 0) {
+		close(fds[1]);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	bool created;
+
+	plan_tests(NUM_TESTS);
+
+	condition = lttng_condition_buffer_usage_high_create();
+	created = condition &&
+			lttng_condition_buffer_usage_set_threshold(condition,
+				CAPACITY / 2) == LTTNG_CONDITION_STATUS_OK &&
+			lttng_condition_buffer_usage_set_session_name(condition,
+				"session") == LTTNG_CONDITION_STATUS_OK &&
+			lttng_condition_buffer_usage_set_channel_name(condition,
+				"channel") == LTTNG_CONDITION_STATUS_OK &&
+			lttng_condition_buffer_usage_set_domain_type(condition,
+				LTTNG_DOMAIN_UST) == LTTNG_CONDITION_STATUS_OK;
+	ok(created, "Buffer usage condition created");
+	if (!created) {
+		skip(NUM_TESTS - 1, "No condition to notify");
+		goto end;
+	}
+	test_batch();
+	test_batch_pending();
+	test_batch_error();
+end:
+	lttng_condition_destroy(condition);
+	return exit_status();
+}
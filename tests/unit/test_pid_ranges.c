@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include <common/common.h>
+#include <bin/lttng-sessiond/pid-ranges.h>
+#include <tap/tap.h>
+
+/* Number of TAP tests in this file */
+#define NUM_TESTS 14
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+int lttng_opt_mi;
+
+static bool ranges_are(const struct pid_ranges *set,
+		const struct lttng_pid_range *expected, unsigned int nb)
+{
+	unsigned int i;
+
+	if (set->nb_ranges != nb) {
+		return false;
+	}
+	for (i = 0; i < nb; i++) {
+		if (set->ranges[i].start != expected[i].start ||
+				set->ranges[i].end != expected[i].end) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void test_add(struct pid_ranges *set)
+{
+	bool added;
+	int ret;
+	const struct lttng_pid_range merged[] = { { 1, 10 }, { 20, 20 } };
+
+	ret = pid_ranges_add(set, 5, 10, &added);
+	ok(ret == LTTNG_OK && added, "Add a range");
+	ret = pid_ranges_add(set, 20, 20, &added);
+	ok(ret == LTTNG_OK && added, "Add a single PID");
+	ret = pid_ranges_add(set, 6, 8, &added);
+	ok(ret == LTTNG_OK && !added, "Add an already tracked range");
+	ret = pid_ranges_add(set, 1, 4, &added);
+	ok(ret == LTTNG_OK && added && ranges_are(set, merged, 2),
+			"Adjacent ranges are merged");
+	ok(pid_ranges_count(set) == 11, "Count the PIDs of the ranges");
+	ok(pid_ranges_lookup(set, 1) && pid_ranges_lookup(set, 10) &&
+			pid_ranges_lookup(set, 20) && !pid_ranges_lookup(set, 0) &&
+			!pid_ranges_lookup(set, 11) && !pid_ranges_lookup(set, 21),
+			"Lookup of the PIDs in and around the ranges");
+	ret = pid_ranges_add(set, 9, 2, &added);
+	ok(ret == LTTNG_ERR_INVALID, "Reject a reversed range");
+	ret = pid_ranges_add(set, -1, 2, &added);
+	ok(ret == LTTNG_ERR_INVALID, "Reject a negative PID");
+}
+
+static void test_del(struct pid_ranges *set)
+{
+	bool added, removed;
+	int ret;
+	const struct lttng_pid_range split[] = { { 1, 4 }, { 7, 10 }, { 20, 20 } };
+	const struct lttng_pid_range trimmed[] = { { 1, 3 }, { 21, INT32_MAX } };
+
+	ret = pid_ranges_del(set, 5, 6, &removed);
+	ok(ret == LTTNG_OK && removed && ranges_are(set, split, 3),
+			"Remove the middle of a range");
+	ret = pid_ranges_del(set, 11, 19, &removed);
+	ok(ret == LTTNG_OK && !removed, "Remove untracked PIDs");
+
+	ret = pid_ranges_add(set, 21, INT32_MAX, &added);
+	ok(ret == LTTNG_OK && added, "Add a range up to the maximal PID");
+	ret = pid_ranges_del(set, 4, 20, &removed);
+	ok(ret == LTTNG_OK && removed && ranges_are(set, trimmed, 2),
+			"Remove a range overlapping many ranges");
+	ret = pid_ranges_del(set, 0, INT32_MAX, &removed);
+	ok(ret == LTTNG_OK && removed && !set->nb_ranges,
+			"Remove all the PIDs");
+	ok(!pid_ranges_lookup(set, 1) && !pid_ranges_count(set),
+			"Empty set");
+}
+
+int main(int argc, char **argv)
+{
+	struct pid_ranges set;
+
+	plan_tests(NUM_TESTS);
+
+	diag("PID ranges unit tests");
+
+	pid_ranges_init(&set);
+	test_add(&set);
+	test_del(&set);
+	pid_ranges_fini(&set);
+
+	return exit_status();
+}
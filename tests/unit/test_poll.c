@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <unistd.h>
+
+#include <common/common.h>
+#include <common/compat/poll.h>
+#include <tap/tap.h>
+
+/* Number of TAP tests in this file */
+#define NUM_TESTS 6
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+int lttng_opt_mi;
+
+static int nr_ready(struct lttng_poll_event *events, int fd, uint32_t mask)
+{
+	int i, ret, nr = 0;
+
+	ret = lttng_poll_wait(events, 0);
+	for (i = 0; i < ret; i++) {
+		if (LTTNG_POLL_GETFD(events, i) == fd &&
+				(LTTNG_POLL_GETEV(events, i) & mask)) {
+			nr++;
+		}
+	}
+	return nr;
+}
+
+static void test_data(struct lttng_poll_event *events, int *fds)
+{
+	int i, ret;
+	void *data = NULL;
+	static int object;
+
+	ret = lttng_poll_add_data(events, fds[0], LPOLLIN, &object);
+	ok(ret == 0, "Add a fd with a user data pointer");
+
+	(void) write(fds[1], "x", 1);
+	ret = lttng_poll_wait(events, 0);
+	for (i = 0; i < ret; i++) {
+		if (LTTNG_POLL_GETFD(events, i) == fds[0]) {
+			data = LTTNG_POLL_GETDATA(events, i);
+		}
+	}
+	ok(data == &object, "The user data pointer is returned with the event");
+
+	(void) lttng_poll_del(events, fds[0]);
+	(void) lttng_poll_add(events, fds[0], LPOLLIN);
+	ret = lttng_poll_wait(events, 0);
+	data = &object;
+	for (i = 0; i < ret; i++) {
+		if (LTTNG_POLL_GETFD(events, i) == fds[0]) {
+			data = LTTNG_POLL_GETDATA(events, i);
+		}
+	}
+	ok(data == NULL, "The user data pointer is cleared on removal");
+	(void) lttng_poll_del(events, fds[0]);
+}
+
+static void test_edge_triggered(struct lttng_poll_event *events, int *fds)
+{
+	(void) lttng_poll_add(events, fds[0], LPOLLIN | LPOLLET);
+	(void) nr_ready(events, fds[0], LPOLLIN);
+#ifdef HAVE_EPOLL
+	ok(nr_ready(events, fds[0], LPOLLIN) == 0,
+			"An edge-triggered fd is reported once");
+#else
+	skip(1, "Edge-triggered registration needs epoll");
+#endif
+	(void) lttng_poll_del(events, fds[0]);
+}
+
+static void test_mod(struct lttng_poll_event *events, int *fds)
+{
+	(void) lttng_poll_add(events, fds[1], LPOLLIN);
+	ok(nr_ready(events, fds[1], LPOLLOUT) == 0,
+			"A writable fd is not reported without LPOLLOUT");
+	(void) lttng_poll_mod(events, fds[1], LPOLLIN | LPOLLOUT);
+	ok(nr_ready(events, fds[1], LPOLLOUT) == 1,
+			"A writable fd is reported once LPOLLOUT is set");
+	(void) lttng_poll_del(events, fds[1]);
+}
+
+int main(int argc, char **argv)
+{
+	int fds[2];
+	struct lttng_poll_event events;
+
+	plan_tests(NUM_TESTS);
+
+	diag("Poll abstraction unit tests");
+
+	lttng_poll_init(&events);
+	if (pipe(fds) || lttng_poll_create(&events, 2, LTTNG_CLOEXEC)) {
+		diag("Failed to create the pipe and poll set");
+		return exit_status();
+	}
+
+	test_data(&events, fds);
+	test_edge_triggered(&events, fds);
+	test_mod(&events, fds);
+
+	lttng_poll_clean(&events);
+	(void) close(fds[0]);
+	(void) close(fds[1]);
+	return exit_status();
+}
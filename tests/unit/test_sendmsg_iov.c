@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <common/common.h>
+#include <common/sessiond-comm/sessiond-comm.h>
+#include <tap/tap.h>
+
+/* Number of TAP tests in this file */
+#define NUM_TESTS 5
+
+/* Large enough for sendmsg() to return partial sends. */
+#define PAYLOAD_LEN (4 * 1024 * 1024)
+#define HDR_LEN 24
+#define PADDING_LEN 13
+#define TOTAL_LEN (HDR_LEN + PAYLOAD_LEN + PADDING_LEN)
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+int lttng_opt_mi;
+
+static char hdr[HDR_LEN];
+static char *payload;
+static char padding[PADDING_LEN];
+static char *received;
+
+struct reader {
+	int fd;
+	size_t len;
+};
+
+static void *read_all(void *data)
+{
+	struct reader *reader = data;
+
+	while (reader->len < TOTAL_LEN) {
+		ssize_t ret = read(reader->fd, received + reader->len,
+				TOTAL_LEN - reader->len);
+
+		if (ret <= 0) {
+			break;
+		}
+		reader->len += ret;
+	}
+	return NULL;
+}
+
+static bool same_content(void)
+{
+	return !memcmp(received, hdr, HDR_LEN) &&
+		!memcmp(received + HDR_LEN, payload, PAYLOAD_LEN) &&
+		!memcmp(received + HDR_LEN + PAYLOAD_LEN, padding,
+			PADDING_LEN);
+}
+
+int main(int argc, char **argv)
+{
+	int sv[2], sndbuf = 4096;
+	size_t i;
+	ssize_t ret;
+	pthread_t thread;
+	struct reader reader = { 0 };
+	struct iovec iov[3];
+	struct msghdr msg;
+
+	plan_tests(NUM_TESTS);
+
+	diag("Vectored send unit tests");
+
+	payload = malloc(PAYLOAD_LEN);
+	received = malloc(TOTAL_LEN);
+	if (!payload || !received ||
+			socketpair(AF_UNIX, SOCK_STREAM, 0, sv)) {
+		diag("Failed to allocate the buffers or the socket pair");
+		return exit_status();
+	}
+	(void) setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &sndbuf,
+			sizeof(sndbuf));
+	memset(hdr, 'h', sizeof(hdr));
+	for (i = 0; i < PAYLOAD_LEN; i++) {
+		payload[i] = (char) i;
+	}
+	memset(padding, 'p', sizeof(padding));
+
+	reader.fd = sv[1];
+	if (pthread_create(&thread, NULL, read_all, &reader)) {
+		diag("Failed to create the reader thread");
+		return exit_status();
+	}
+
+	iov[0].iov_base = hdr;
+	iov[0].iov_len = HDR_LEN;
+	iov[1].iov_base = payload;
+	iov[1].iov_len = PAYLOAD_LEN;
+	iov[2].iov_base = padding;
+	iov[2].iov_len = PADDING_LEN;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 3;
+
+	ret = lttcomm_sendmsg_all(sv[0], &msg, MSG_NOSIGNAL);
+	ok(ret == TOTAL_LEN, "Send the header, payload and padding together");
+	ok(msg.msg_iovlen == 0, "Every iovec is consumed");
+
+	pthread_join(thread, NULL);
+	ok(reader.len == TOTAL_LEN, "Receive %d bytes", TOTAL_LEN);
+	ok(reader.len == TOTAL_LEN && same_content(),
+			"The received bytes are the sent ones in order");
+
+	(void) close(sv[1]);
+	iov[0].iov_base = hdr;
+	iov[0].iov_len = HDR_LEN;
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 1;
+	ret = lttcomm_sendmsg_all(sv[0], &msg, MSG_NOSIGNAL);
+	ok(ret == -1 && errno == EPIPE, "Send to a closed peer fails");
+
+	(void) close(sv[0]);
+	free(payload);
+	free(received);
+	return exit_status();
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <common/common.h>
+#include <common/config/config-internal.h>
+#include <tap/tap.h>
+
+/* Number of TAP tests in this file */
+#define NUM_TESTS 9
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+int lttng_opt_mi;
+
+static char doc_buf[4096];
+
+static bool element_is(xmlNodePtr node, const char *name, const char *content)
+{
+	xmlChar *node_content;
+	bool same;
+
+	if (!node || strcmp((const char *) node->name, name)) {
+		return false;
+	}
+	node_content = xmlNodeGetContent(node);
+	same = node_content && !strcmp((const char *) node_content, content);
+	xmlFree(node_content);
+	return same;
+}
+
+/* Write a document in a temporary file and read it back in doc_buf. */
+static ssize_t write_document(void)
+{
+	struct config_binary_writer *writer;
+	char path[] = "/tmp/test_session_config_binary.XXXXXX";
+	ssize_t len = -1;
+	int fd, ret = 0;
+
+	writer = config_binary_writer_create();
+	fd = mkstemp(path);
+	if (!writer || fd < 0) {
+		goto end;
+	}
+	(void) unlink(path);
+
+	ret |= config_binary_writer_open_element(writer, "sessions");
+	ret |= config_binary_writer_open_element(writer, "session");
+	ret |= config_binary_writer_write_attribute(writer, "id", "1");
+	ret |= config_binary_writer_write_element_string(writer, "name",
+			"a<&>b");
+	ret |= config_binary_writer_write_element_unsigned_int(writer,
+			"size", UINT64_MAX);
+	ret |= config_binary_writer_write_element_signed_int(writer,
+			"offset", INT64_MIN);
+	ret |= config_binary_writer_write_element_bool(writer, "started", 1);
+	/* The names are shared by the elements of the document. */
+	ret |= config_binary_writer_write_element_string(writer, "name",
+			"c");
+	ret |= config_binary_writer_close_element(writer);
+	ret |= config_binary_writer_close_element(writer);
+	ret |= config_binary_writer_write(writer, fd);
+	if (ret || lseek(fd, 0, SEEK_SET)) {
+		goto end;
+	}
+	len = read(fd, doc_buf, sizeof(doc_buf));
+end:
+	if (fd >= 0) {
+		(void) close(fd);
+	}
+	config_binary_writer_destroy(writer);
+	return len;
+}
+
+int main(int argc, char **argv)
+{
+	xmlDocPtr doc;
+	xmlNodePtr root, node = NULL;
+	xmlChar *id = NULL;
+	ssize_t len;
+
+	plan_tests(NUM_TESTS);
+
+	diag("Binary session configuration unit tests");
+
+	len = write_document();
+	ok(len > CONFIG_BINARY_MAGIC_LEN && config_binary_is_document(doc_buf, len),
+			"Write a binary document");
+	ok(!config_binary_is_document("<?xml", 5),
+			"An XML document is not a binary one");
+
+	doc = config_binary_read_document(doc_buf, len);
+	root = doc ? xmlDocGetRootElement(doc) : NULL;
+	ok(root && !strcmp((const char *) root->name, "sessions"),
+			"Read the root element");
+	if (root) {
+		node = xmlFirstElementChild(root);
+		id = node ? xmlGetProp(node, BAD_CAST "id") : NULL;
+	}
+	ok(id && !strcmp((const char *) id, "1"), "Read an attribute");
+	xmlFree(id);
+	node = node ? xmlFirstElementChild(node) : NULL;
+	ok(element_is(node, "name", "a<&>b"), "Read a string element");
+	node = node ? xmlNextElementSibling(node) : NULL;
+	ok(element_is(node, "size", "18446744073709551615"),
+			"Read an unsigned integer element");
+	node = node ? xmlNextElementSibling(node) : NULL;
+	ok(element_is(node, "offset", "-9223372036854775808"),
+			"Read a signed integer element");
+	node = node ? xmlNextElementSibling(node) : NULL;
+	ok(element_is(node, "started", "true") &&
+			element_is(xmlNextElementSibling(node), "name", "c"),
+			"Read a boolean element and a shared name");
+	xmlFreeDoc(doc);
+
+	ok(!config_binary_read_document(doc_buf, len - 1),
+			"A truncated document is refused");
+	return exit_status();
+}
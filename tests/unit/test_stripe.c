@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <common/common.h>
+#include <common/stripe.h>
+#include <common/utils.h>
+#include <tap/tap.h>
+
+/* Number of TAP tests in this file */
+#define NUM_TESTS 10
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+int lttng_opt_mi;
+
+static char trace_dir[] = "/tmp/test-stripe-trace-XXXXXX";
+static char roots[2][sizeof("/tmp/test-stripe-root-XXXXXX")] = {
+	"/tmp/test-stripe-root-XXXXXX",
+	"/tmp/test-stripe-root-XXXXXX",
+};
+
+/*
+ * Get the target of the tracefile "name" of the trace directory in "target".
+ *
+ * Return the index of the root of the target or else -1.
+ */
+static int tracefile_root(const char *name, char *target)
+{
+	int i;
+	ssize_t len;
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/%s", trace_dir, name);
+	len = readlink(path, target, PATH_MAX - 1);
+	if (len < 0) {
+		return -1;
+	}
+	target[len] = '\0';
+	for (i = 0; i < 2; i++) {
+		if (!strncmp(target, roots[i], strlen(roots[i]))) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+int main(int argc, char **argv)
+{
+	int fd, first_root, root;
+	char paths[2 * sizeof(roots[0]) + 1];
+	char target[PATH_MAX], old_target[PATH_MAX], path[PATH_MAX];
+	struct stat st;
+
+	plan_tests(NUM_TESTS);
+
+	diag("Striped output unit tests");
+
+	if (!mkdtemp(trace_dir) || !mkdtemp(roots[0]) || !mkdtemp(roots[1])) {
+		diag("Failed to create the temporary directories");
+		return exit_status();
+	}
+	snprintf(paths, sizeof(paths), "%s:%s", roots[0], roots[1]);
+
+	ok(stripe_set_roots("relative/root") < 0,
+			"A relative stripe root is refused");
+	ok(stripe_set_roots(paths) == 0, "Set the stripe roots");
+	ok(!stripe_tracefile("metadata", NULL) &&
+			!stripe_tracefile("chan_0", ".idx") &&
+			stripe_tracefile("chan_0", NULL),
+			"Only the data tracefiles are striped");
+
+	fd = utils_create_stream_file(trace_dir, "chan_0", 0, 0, -1, -1, NULL);
+	ok(fd >= 0 && write(fd, "x", 1) == 1 && !close(fd),
+			"Create and write a striped tracefile");
+	first_root = tracefile_root("chan_0", target);
+	ok(first_root >= 0 && !strncmp(target + strlen(roots[first_root]),
+			trace_dir, strlen(trace_dir)),
+			"The tracefile links its path under a stripe root");
+	snprintf(path, sizeof(path), "%s/chan_0", trace_dir);
+	ok(!stat(path, &st) && st.st_size == 1,
+			"The tracefile is read through its link");
+
+	fd = utils_create_stream_file(trace_dir, "chan_1", 0, 0, -1, -1, NULL);
+	ok(fd >= 0 && !close(fd), "Create another striped tracefile");
+	root = tracefile_root("chan_1", target);
+	ok(root >= 0 && root != first_root,
+			"The tracefiles are spread over the roots in turn");
+
+	strcpy(old_target, target);
+	fd = utils_create_stream_file(trace_dir, "chan_1", 0, 0, -1, -1, NULL);
+	root = tracefile_root("chan_1", target);
+	ok(fd >= 0 && !close(fd) && root >= 0 && access(old_target, F_OK) &&
+			!access(target, F_OK),
+			"Replacing a tracefile unlinks its striped file");
+
+	(void) utils_unlink_stream_file(trace_dir, "chan_0", 0, 0, -1, -1,
+			NULL);
+	(void) utils_unlink_stream_file(trace_dir, "chan_1", 0, 0, -1, -1,
+			NULL);
+	ok(access(target, F_OK) && tracefile_root("chan_1", target) < 0,
+			"Unlinking a tracefile unlinks its striped file");
+
+	(void) utils_recursive_rmdir(trace_dir);
+	(void) utils_recursive_rmdir(roots[0]);
+	(void) utils_recursive_rmdir(roots[1]);
+	return exit_status();
+}
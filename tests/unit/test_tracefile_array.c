@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <bin/lttng-relayd/tracefile-array.h>
+#include <tap/tap.h>
+
+/* Number of TAP tests in this file */
+#define NUM_TESTS 9
+
+#define NR_FILES	4
+#define NR_PER_FILE	3
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+int lttng_opt_mi;
+
+/* Commit "nr" indexes in each of "nr_files" files, rotating between them. */
+static void fill(struct tracefile_array *tfa, int nr_files, int nr)
+{
+	int i, j;
+
+	for (i = 0; i < nr_files; i++) {
+		if (i) {
+			tracefile_array_file_rotate(tfa);
+		}
+		for (j = 0; j < nr; j++) {
+			tracefile_array_commit_seq(tfa);
+		}
+	}
+}
+
+/* Check that find_seq agrees with seq_in_file for every seq of the array. */
+static bool find_all(struct tracefile_array *tfa)
+{
+	uint64_t seq, file, index;
+
+	for (seq = tfa->seq_tail; seq <= tfa->seq_head; seq++) {
+		if (!tracefile_array_find_seq(tfa, seq, &file, &index)) {
+			return false;
+		}
+		if (!tracefile_array_seq_in_file(tfa, file, seq) ||
+				tfa->tf[file].seq_tail + index != seq) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void test_no_rotation(void)
+{
+	struct tracefile_array *tfa;
+	uint64_t file, index;
+
+	tfa = tracefile_array_create(0);
+	ok(!tracefile_array_find_seq(tfa, 0, &file, &index),
+			"No index found before the first commit");
+	fill(tfa, 1, 10);
+	ok(tracefile_array_find_seq(tfa, 7, &file, &index) &&
+			file == 0 && index == 7,
+			"Without rotation, the index is found in the single file");
+	tracefile_array_destroy(tfa);
+}
+
+static void test_rotation(void)
+{
+	struct tracefile_array *tfa;
+	uint64_t file, index;
+
+	tfa = tracefile_array_create(NR_FILES);
+	fill(tfa, NR_FILES - 1, NR_PER_FILE);
+	ok(find_all(tfa), "Every index is found before overwrite");
+	ok(tracefile_array_find_seq(tfa, NR_PER_FILE + 1, &file, &index) &&
+			file == 1 && index == 1,
+			"An index is found at its offset in its file");
+	ok(!tracefile_array_find_seq(tfa, tfa->seq_head + 1, &file, &index),
+			"An index not received yet is not found");
+
+	/* Wrap around twice, overwriting the oldest files. */
+	fill(tfa, 2 * NR_FILES + 1, NR_PER_FILE);
+	ok(find_all(tfa), "Every index is found after overwrite");
+	ok(!tracefile_array_find_seq(tfa, tfa->seq_tail - 1, &file, &index),
+			"An overwritten index is not found");
+
+	/* The head file has no index yet right after a rotation. */
+	tracefile_array_file_rotate(tfa);
+	ok(find_all(tfa), "Every index is found with an empty head file");
+	ok(tracefile_array_find_seq(tfa, tfa->seq_head, &file, &index) &&
+			index == NR_PER_FILE - 1,
+			"The newest index is found past the empty head file");
+	tracefile_array_destroy(tfa);
+}
+
+int main(int argc, char **argv)
+{
+	plan_tests(NUM_TESTS);
+
+	diag("Tracefile array unit tests");
+
+	test_no_rotation();
+	test_rotation();
+	return exit_status();
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <common/common.h>
+#include <common/sessiond-comm/sessiond-comm.h>
+#include <common/unix.h>
+#include <tap/tap.h>
+
+/* Number of TAP tests in this file */
+#define NUM_TESTS 7
+
+/* More than two batches of fds. */
+#define NR_FDS (2 * LTTCOMM_MAX_SEND_FDS_BATCH + 10)
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+int lttng_opt_mi;
+
+static int sent_fds[NR_FDS];
+static int recv_fds[NR_FDS];
+
+static bool same_file(int fd, const struct stat *ref)
+{
+	struct stat st;
+
+	if (fstat(fd, &st)) {
+		return false;
+	}
+	return st.st_dev == ref->st_dev && st.st_ino == ref->st_ino;
+}
+
+static void close_fds(int *fds, size_t nb_fd)
+{
+	size_t i;
+
+	for (i = 0; i < nb_fd; i++) {
+		if (fds[i] >= 0) {
+			(void) close(fds[i]);
+		}
+	}
+}
+
+static void test_batch(int *sv, const struct stat *ref, size_t nb_fd)
+{
+	ssize_t ret;
+	size_t i;
+	bool all_same = true;
+
+	ret = lttcomm_send_fds_batch_unix_sock(sv[0], sent_fds, nb_fd);
+	ok(ret == (ssize_t) nb_fd, "Send %zu fds in a batch", nb_fd);
+
+	ret = lttcomm_recv_fds_batch_unix_sock(sv[1], recv_fds, nb_fd);
+	ok(ret == (ssize_t) nb_fd, "Receive %zu fds in a batch", nb_fd);
+	if (ret != (ssize_t) nb_fd) {
+		return;
+	}
+
+	for (i = 0; i < nb_fd; i++) {
+		all_same &= same_file(recv_fds[i], ref);
+	}
+	ok(all_same, "The %zu received fds are the sent ones", nb_fd);
+	close_fds(recv_fds, nb_fd);
+}
+
+int main(int argc, char **argv)
+{
+	int sv[2], pipe_fds[2];
+	struct stat ref;
+	size_t i;
+	ssize_t ret;
+
+	plan_tests(NUM_TESTS);
+
+	diag("Batched fd passing unit tests");
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) || pipe(pipe_fds) ||
+			fstat(pipe_fds[1], &ref)) {
+		diag("Failed to create the socket pair and pipe");
+		return exit_status();
+	}
+	for (i = 0; i < NR_FDS; i++) {
+		sent_fds[i] = dup(pipe_fds[1]);
+		if (sent_fds[i] < 0) {
+			diag("Failed to duplicate the pipe fd");
+			return exit_status();
+		}
+	}
+
+	ret = lttcomm_send_fds_unix_sock(sv[0], sent_fds,
+			LTTCOMM_MAX_SEND_FDS + 1);
+	ok(ret == -EINVAL, "Unbatched send of more than %d fds is refused",
+			LTTCOMM_MAX_SEND_FDS);
+
+	test_batch(sv, &ref, 1);
+	test_batch(sv, &ref, NR_FDS);
+
+	close_fds(sent_fds, NR_FDS);
+	close_fds(pipe_fds, 2);
+	close_fds(sv, 2);
+	return exit_status();
+}
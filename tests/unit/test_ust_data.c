@@ -40,7 +40,7 @@
 #define RANDOM_STRING_LEN	11
 
 /* Number of TAP tests in this file */
-#define NUM_TESTS 16
+#define NUM_TESTS 18
 
 /* For error.h */
 int lttng_opt_quiet = 1;
@@ -53,6 +53,7 @@ int ust_consumerd64_fd;
 /* Global variables required by sessiond objects being linked-in */
 struct lttng_ht *agent_apps_ht_by_sock;
 struct notification_thread_handle *notification_thread_handle;
+struct health_app *health_sessiond;
 
 static const char alphanum[] =
 	"0123456789"
@@ -241,6 +242,52 @@ end:
 	return;
 }
 
+static void test_compile_ust_event_exclusion(void)
+{
+	struct ltt_ust_event *event;
+	struct lttng_event ev;
+	struct lttng_event_exclusion *exclusion;
+	const char *names[] = { "myapp_foo_bar", "other_event", "myapp_foo*",
+		"myapp_bar" };
+	const int exclusion_count = sizeof(names) / sizeof(names[0]);
+	int i;
+
+	memset(&ev, 0, sizeof(ev));
+	strcpy(ev.name, "myapp_*");
+	ev.type = LTTNG_EVENT_TRACEPOINT;
+	ev.loglevel_type = LTTNG_EVENT_LOGLEVEL_ALL;
+
+	exclusion = zmalloc(sizeof(*exclusion) +
+		LTTNG_SYMBOL_NAME_LEN * exclusion_count);
+	if (!exclusion) {
+		skip(2, "zmalloc failed");
+		return;
+	}
+	exclusion->count = exclusion_count;
+	for (i = 0; i < exclusion_count; i++) {
+		strncpy(LTTNG_EVENT_EXCLUSION_NAME_AT(exclusion, i), names[i],
+			LTTNG_SYMBOL_NAME_LEN);
+	}
+
+	event = trace_ust_create_event(&ev, NULL, NULL, exclusion, false);
+	ok(event != NULL && event->exclusion->count == exclusion_count,
+	   "Create UST event with exclusions");
+	if (!event) {
+		skip(1, "UST event with exclusion is null");
+		return;
+	}
+
+	/* The unrelated and the implied exclusions are not sent. */
+	ok(event->uexclusion->compiled &&
+	   event->uexclusion->compiled->count == 2 &&
+	   !strcmp(LTTNG_EVENT_EXCLUSION_NAME_AT(
+		   event->uexclusion->compiled, 0), "myapp_bar") &&
+	   !strcmp(LTTNG_EVENT_EXCLUSION_NAME_AT(
+		   event->uexclusion->compiled, 1), "myapp_foo*"),
+	   "Validate compiled UST exclusions");
+
+	trace_ust_destroy_event(event);
+}
 
 static void test_create_ust_context(void)
 {
@@ -270,6 +317,7 @@ int main(int argc, char **argv)
 	test_create_ust_event();
 	test_create_ust_context();
 	test_create_ust_event_exclusion();
+	test_compile_ust_event_exclusion();
 
 	rcu_unregister_thread();
 
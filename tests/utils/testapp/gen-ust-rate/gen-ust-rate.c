@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2026 - The LTTng Project
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * Synthetic producer of the benchmarks: each thread emits events at a fixed
+ * rate for a fixed duration, then the total number of events emitted is
+ * printed on the standard output.
+ *
+ * Usage: gen-ust-rate RATE DURATION_S [NR_THREADS [PAYLOAD_LEN]]
+ *
+ * RATE is the number of events per second of each thread, 0 to emit them as
+ * fast as possible.
+ */
+
+#define _LGPL_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TRACEPOINT_DEFINE
+#include "tp.h"
+
+#define NSEC_PER_SEC		1000000000ULL
+/* The events of a thread are emitted in bursts of this period. */
+#define BURST_PERIOD_NS		1000000ULL
+#define MAX_PAYLOAD_LEN		65536
+
+struct producer {
+	pthread_t thread;
+	unsigned int id;
+	unsigned long nr_events;
+};
+
+static uint64_t rate;
+static uint64_t duration_ns;
+static size_t payload_len = 64;
+static char payload[MAX_PAYLOAD_LEN];
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t deadline)
+{
+	struct timespec ts;
+	int ret;
+
+	ts.tv_sec = deadline / NSEC_PER_SEC;
+	ts.tv_nsec = deadline % NSEC_PER_SEC;
+	do {
+		ret = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+	} while (ret == EINTR);
+}
+
+static void *produce(void *data)
+{
+	struct producer *producer = data;
+	uint64_t start, now;
+
+	start = now = now_ns();
+	while (now - start < duration_ns) {
+		uint64_t target;
+
+		/*
+		 * Catch up on the events due since the start rather than
+		 * since the last burst, so that a late wakeup does not lower
+		 * the rate.
+		 */
+		if (rate) {
+			target = (now - start) * rate / NSEC_PER_SEC + 1;
+		} else {
+			target = producer->nr_events + 1024;
+		}
+		while (producer->nr_events < target) {
+			tracepoint(tp, tprate, producer->id,
+					producer->nr_events, payload,
+					payload_len);
+			producer->nr_events++;
+		}
+		if (rate) {
+			sleep_until(now + BURST_PERIOD_NS);
+		}
+		now = now_ns();
+	}
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int i, nr_threads = 1;
+	unsigned long nr_events = 0;
+	struct producer *producers;
+	int ret;
+
+	if (argc < 3) {
+		fprintf(stderr, "Usage: %s RATE DURATION_S [NR_THREADS [PAYLOAD_LEN]]\n",
+				argv[0]);
+		exit(EXIT_FAILURE);
+	}
+	rate = strtoull(argv[1], NULL, 10);
+	duration_ns = strtoull(argv[2], NULL, 10) * NSEC_PER_SEC;
+	if (argc >= 4) {
+		nr_threads = atoi(argv[3]);
+	}
+	if (argc >= 5) {
+		payload_len = strtoul(argv[4], NULL, 10);
+	}
+	if (!nr_threads || payload_len > MAX_PAYLOAD_LEN) {
+		fprintf(stderr, "Invalid number of threads or payload length\n");
+		exit(EXIT_FAILURE);
+	}
+	memset(payload, 'x', payload_len);
+
+	producers = calloc(nr_threads, sizeof(*producers));
+	if (!producers) {
+		perror("calloc");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < nr_threads; i++) {
+		producers[i].id = i;
+		ret = pthread_create(&producers[i].thread, NULL, produce,
+				&producers[i]);
+		if (ret) {
+			errno = ret;
+			perror("pthread_create");
+			exit(EXIT_FAILURE);
+		}
+	}
+	for (i = 0; i < nr_threads; i++) {
+		pthread_join(producers[i].thread, NULL);
+		nr_events += producers[i].nr_events;
+	}
+	free(producers);
+
+	printf("%lu\n", nr_events);
+	exit(EXIT_SUCCESS);
+}